@@ -0,0 +1 @@
+../../../contrib/devtools/security-check.py
\ No newline at end of file
@@ -0,0 +1 @@
+../../../contrib/devtools/symbol-check.py
\ No newline at end of file
@@ -0,0 +1 @@
+../../../contrib/devtools/test-security-check.py
\ No newline at end of file
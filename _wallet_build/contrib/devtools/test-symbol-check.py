@@ -0,0 +1 @@
+../../../contrib/devtools/test-symbol-check.py
\ No newline at end of file
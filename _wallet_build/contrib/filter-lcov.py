@@ -0,0 +1 @@
+../../contrib/filter-lcov.py
\ No newline at end of file
@@ -0,0 +1,2 @@
+static unsigned const char asmap_raw[] = {
+};
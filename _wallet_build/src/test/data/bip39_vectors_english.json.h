@@ -0,0 +1,3 @@
+namespace json_tests{
+static unsigned const char bip39_vectors_english[] = {
+};};
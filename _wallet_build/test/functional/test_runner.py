@@ -0,0 +1 @@
+../../../test/functional/test_runner.py
\ No newline at end of file
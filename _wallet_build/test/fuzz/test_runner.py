@@ -0,0 +1 @@
+../../../test/fuzz/test_runner.py
\ No newline at end of file
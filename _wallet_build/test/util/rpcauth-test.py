@@ -0,0 +1 @@
+../../../test/util/rpcauth-test.py
\ No newline at end of file
@@ -0,0 +1 @@
+../../../test/util/test_runner.py
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include <anon.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <secp256k1.h>
 #include <secp256k1_rangeproof.h>
@@ -21,6 +22,9 @@
 #include <chainparams.h>
 #include <txmempool.h>
 #include <node/blockstorage.h>
+#include <util/time.h>
+#include <util/trace.h>
+#include <validationstats.h>
 
 
 bool CheckAnonInputMempoolConflicts(const CTxIn &txin, const uint256 txhash, CTxMemPool *pmempool, TxValidationState &state)
@@ -57,7 +61,52 @@ bool CheckAnonInputMempoolConflicts(const CTxIn &txin, const uint256 txhash, CTx
     return true;
 };
 
-bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
+bool CAnonCheck::operator()()
+{
+    assert(ptxTo);
+    size_t nInputs = nRows - 1;
+    const CTxIn &txin = ptxTo->vin[nIn];
+    const std::vector<uint8_t> &vKeyImages = txin.scriptData.stack[0];
+    const std::vector<uint8_t> &vDL = txin.scriptWitness.stack[1];
+
+    std::vector<const uint8_t*> vpInCommits(nCols * nInputs);
+    for (size_t i = 0; i < vpInCommits.size(); ++i) {
+        vpInCommits[i] = &vInCommits[i * 33];
+    }
+    std::vector<const uint8_t*> vpOutCommits(vOutCommits.size() / 33);
+    for (size_t i = 0; i < vpOutCommits.size(); ++i) {
+        vpOutCommits[i] = &vOutCommits[i * 33];
+    }
+
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
+    int rv;
+    if (0 != (rv = secp256k1_prepare_mlsag(&vM[0], nullptr,
+        vpOutCommits.size(), 0, nCols, nRows,
+        &vpInCommits[0], &vpOutCommits[0], nullptr))) {
+        LogPrintf("ERROR: %s: prepare-mlsag-failed %d\n", __func__, rv);
+        error = "prepare-mlsag-failed";
+    } else
+    if (0 != (rv = secp256k1_verify_mlsag(
+        ptxTo->GetHash().begin(), nCols, nRows,
+        &vM[0], &vKeyImages[0], &vDL[0], &vDL[32]))) {
+        LogPrintf("ERROR: %s: verify-mlsag-failed %d\n", __func__, rv);
+        error = "verify-mlsag-failed";
+    }
+
+    TRACE6(rct, verify_mlsag,
+        ptxTo->GetHash().data(),
+        nIn,
+        (uint64_t)nCols,
+        (uint64_t)nInputs,
+        error == nullptr,
+        GetTimeMicros() - start_us);
+    if (m_validation_stats) {
+        m_validation_stats->AddTiming(BVS_MLSAGS_VERIFIED, BVS_MLSAG_US, start_us);
+    }
+    return error == nullptr;
+};
+
+bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state, std::vector<CAnonCheck> *pvChecks)
 {
     assert(state.m_chainstate);
     auto &pblocktree{state.m_chainstate->m_blockman.m_block_tree_db};
@@ -88,8 +137,8 @@ bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
     uint8_t zeroBlind[32] = {0};
     secp256k1_pedersen_commitment plainCommitment;
     if (nPlainValueOut > 0) {
-        if (!secp256k1_pedersen_commit(secp256k1_ctx_blind,
-            &plainCommitment, zeroBlind, (uint64_t) nPlainValueOut, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+        if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind,
+            &plainCommitment, zeroBlind, (uint64_t) nPlainValueOut, blind_precomp_h)) {
             return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-plain-commitment");
         }
     }
@@ -99,8 +148,10 @@ bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
         vpInputSplitCommits.reserve(tx.vin.size());
     }
     uint256 txhash = tx.GetHash();
+    BlockValidationStats *validation_stats = state.m_validation_stats;
 
-    for (const auto &txin : tx.vin) {
+    for (unsigned int nIn = 0; nIn < tx.vin.size(); ++nIn) {
+        const CTxIn &txin = tx.vin[nIn];
         if (!txin.IsAnonInput()) {
             return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-anon-input");
         }
@@ -137,22 +188,21 @@ bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
             return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-anonin-sig-size");
         }
 
-        std::vector<secp256k1_pedersen_commitment> vCommitments;
-        vCommitments.reserve(nCols * nInputs);
-        std::vector<const uint8_t*> vpOutCommits;
-        std::vector<const uint8_t*> vpInCommits(nCols * nInputs);
+        std::vector<uint8_t> vInCommits(nCols * nInputs * 33);
+        std::vector<uint8_t> vOutCommits;
         std::vector<uint8_t> vM(nCols * nRows * 33);
 
         if (fSplitCommitments) {
-            vpOutCommits.push_back(&vDL[(1 + (nInputs+1) * nRingSize) * 32]);
-            vpInputSplitCommits.push_back(&vDL[(1 + (nInputs+1) * nRingSize) * 32]);
+            const uint8_t *pSplitCommit = &vDL[(1 + (nInputs+1) * nRingSize) * 32];
+            vOutCommits.insert(vOutCommits.end(), pSplitCommit, pSplitCommit + 33);
+            vpInputSplitCommits.push_back(pSplitCommit);
         } else {
-            vpOutCommits.push_back(plainCommitment.data);
+            vOutCommits.insert(vOutCommits.end(), plainCommitment.data, plainCommitment.data + 33);
 
             secp256k1_pedersen_commitment *pc;
             for (const auto &txout : tx.vpout) {
                 if ((pc = txout->GetPCommitment())) {
-                    vpOutCommits.push_back(pc->data);
+                    vOutCommits.insert(vOutCommits.end(), pc->data, pc->data + 33);
                 }
             }
         }
@@ -173,13 +223,21 @@ bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
             }
 
             CAnonOutput ao;
+            int64_t read_start_us = validation_stats ? GetTimeMicros() : 0;
             if (!pblocktree->ReadRCTOutput(nIndex, ao)) {
                 LogPrintf("%s: ReadRCTOutput failed: %ld\n", __func__, nIndex);
+                if (!state.m_in_block && nIndex > 0) {
+                    // The ring member may be in a block not connected yet, a loose txn can wait as an orphan
+                    state.m_missing_anon_index = nIndex;
+                    return state.Invalid(TxValidationResult::TX_MISSING_INPUTS, "bad-anonin-unknown-i");
+                }
                 return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-anonin-unknown-i");
             }
+            if (validation_stats) {
+                validation_stats->AddTiming(BVS_RING_MEMBERS_READ, BVS_RING_MEMBERS_READ_US, read_start_us);
+            }
             memcpy(&vM[(i+k*nCols)*33], ao.pubkey.begin(), 33);
-            vCommitments.push_back(ao.commitment);
-            vpInCommits[i+k*nCols] = vCommitments.back().data;
+            memcpy(&vInCommits[(i+k*nCols)*33], ao.commitment.data, 33);
 
             if (state.m_spend_height - ao.nBlockHeight + 1 < consensus.nMinRCTOutputDepth) {
                 LogPrint(BCLog::RINGCT, "%s: Low input depth %s\n", __func__, state.m_spend_height - ao.nBlockHeight);
@@ -198,7 +256,12 @@ bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
             }
 
             CAnonKeyImageInfo ki_data;
-            if (pblocktree->ReadRCTKeyImage(ki, ki_data)) {
+            int64_t lookup_start_us = validation_stats ? GetTimeMicros() : 0;
+            bool have_ki = pblocktree->ReadRCTKeyImage(ki, ki_data);
+            if (validation_stats) {
+                validation_stats->AddTiming(BVS_KEY_IMAGE_LOOKUPS, BVS_KEY_IMAGE_LOOKUP_US, lookup_start_us);
+            }
+            if (have_ki) {
                 if (LogAcceptCategory(BCLog::RINGCT, BCLog::Level::Debug)) {
                     LogPrintf("%s: Duplicate keyimage detected %s, used in %s.\n", __func__,
                               HexStr(ki), ki_data.txid.ToString());
@@ -213,17 +276,20 @@ bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
                 }
             }
         }
-        if (0 != (rv = secp256k1_prepare_mlsag(&vM[0], nullptr,
-            vpOutCommits.size(), 0, nCols, nRows,
-            &vpInCommits[0], &vpOutCommits[0], nullptr))) {
-            LogPrintf("ERROR: %s: prepare-mlsag-failed %d\n", __func__, rv);
-            return state.Invalid(TxValidationResult::TX_CONSENSUS, "prepare-mlsag-failed");
+
+        if (validation_stats) {
+            validation_stats->Add(BVS_ANON_INPUTS, nInputs);
+        }
+        if (state.m_assume_valid) {
+            continue; // Ring members, key images and the commitment sum are still checked
         }
-        if (0 != (rv = secp256k1_verify_mlsag(
-            txhash.begin(), nCols, nRows,
-            &vM[0], &vKeyImages[0], &vDL[0], &vDL[32]))) {
-            LogPrintf("ERROR: %s: verify-mlsag-failed %d\n", __func__, rv);
-            return state.Invalid(TxValidationResult::TX_CONSENSUS, "verify-mlsag-failed");
+        CAnonCheck check(tx, nIn, nCols, nRows, std::move(vM), std::move(vInCommits), std::move(vOutCommits), validation_stats);
+        if (pvChecks) {
+            pvChecks->push_back(CAnonCheck());
+            check.swap(pvChecks->back());
+        } else
+        if (!check()) {
+            return state.Invalid(TxValidationResult::TX_CONSENSUS, check.GetError());
         }
     }
 
@@ -250,11 +316,99 @@ bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state)
     return true;
 };
 
+void PrefetchAnonInputs(CBlockTreeDB &block_tree_db, const CTransaction &tx)
+{
+    if (!block_tree_db.HaveRCTOutputCache()) {
+        return;
+    }
+    // Malformed inputs are left for VerifyMLSAG to reject
+    std::vector<int64_t> indices;
+    for (const auto &txin : tx.vin) {
+        if (!txin.IsAnonInput()) {
+            return;
+        }
+        uint32_t nInputs, nRingSize;
+        txin.GetAnonInfo(nInputs, nRingSize);
+        if (nInputs < 1 || nInputs > MAX_ANON_INPUTS ||
+            nRingSize < MIN_RINGSIZE || nRingSize > MAX_RINGSIZE ||
+            txin.scriptWitness.stack.size() != 2) {
+            return;
+        }
+        const std::vector<uint8_t> &vMI = txin.scriptWitness.stack[0];
+        size_t ofs = 0, nB = 0;
+        for (size_t k = 0; k < nInputs * nRingSize; ++k) {
+            uint64_t nIndex;
+            if (0 != part::GetVarInt(vMI, ofs, nIndex, nB)) {
+                return;
+            }
+            ofs += nB;
+            indices.push_back(nIndex);
+        }
+        if (indices.size() >= MAX_PREFETCH_ANON_OUTPUTS) {
+            break;
+        }
+    }
+    if (indices.size() > MAX_PREFETCH_ANON_OUTPUTS) {
+        indices.resize(MAX_PREFETCH_ANON_OUTPUTS);
+    }
+
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    CAnonOutput ao;
+    for (const auto i : indices) {
+        if (!block_tree_db.ReadRCTOutput(i, ao)) {
+            break;
+        }
+    }
+};
+
 int GetKeyImage(CCmpPubKey &ki, const CCmpPubKey &pubkey, const CKey &key)
 {
     return secp256k1_get_keyimage(ki.ncbegin(), pubkey.begin(), key.begin());
 };
 
+void GetKeyImageStates(CBlockTreeDB &block_tree_db, const CTxMemPool *pmempool, const std::vector<CCmpPubKey> &key_images, std::vector<CKeyImageSpend> &states)
+{
+    AssertLockHeld(cs_main);
+    states.assign(key_images.size(), CKeyImageSpend());
+
+    // Sorted reads touch neighbouring db blocks, duplicates are read once
+    std::vector<size_t> order(key_images.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&key_images](size_t a, size_t b) { return key_images[a] < key_images[b]; });
+
+    bool have_unknown = false;
+    CAnonKeyImageInfo ki_data;
+    for (size_t k = 0; k < order.size(); ++k) {
+        size_t i = order[k];
+        if (k > 0 && key_images[i] == key_images[order[k - 1]]) {
+            states[i] = states[order[k - 1]];
+            continue;
+        }
+        if (block_tree_db.ReadRCTKeyImage(key_images[i], ki_data)) {
+            states[i].state = CKeyImageSpend::IN_CHAIN;
+            states[i].txid = ki_data.txid;
+            states[i].height = ki_data.height;
+        } else {
+            have_unknown = true;
+        }
+    }
+    if (!have_unknown || !pmempool) {
+        return;
+    }
+
+    for (size_t i = 0; i < key_images.size(); ++i) {
+        if (states[i].state != CKeyImageSpend::UNKNOWN) {
+            continue;
+        }
+        if (pmempool->HaveKeyImage(key_images[i], states[i].txid)) {
+            states[i].state = CKeyImageSpend::IN_MEMPOOL;
+        }
+    }
+}
+
 bool AddKeyImagesToMempool(const CTransaction &tx, CTxMemPool &pool)
 {
     for (const CTxIn &txin : tx.vin) {
@@ -274,7 +428,7 @@ bool AddKeyImagesToMempool(const CTransaction &tx, CTxMemPool &pool)
 
         for (size_t k = 0; k < nInputs; ++k) {
             const CCmpPubKey &ki = *((CCmpPubKey*)&vKeyImages[k*33]);
-            pool.mapKeyImages[ki] = txhash;
+            pool.mapKeyImages.Add(ki, txhash);
         }
     }
 
@@ -298,7 +452,7 @@ bool RemoveKeyImagesFromMempool(const uint256 &hash, const CTxIn &txin, CTxMemPo
 
     for (size_t k = 0; k < nInputs; ++k) {
         const CCmpPubKey &ki = *((CCmpPubKey*)&vKeyImages[k*33]);
-        pool.mapKeyImages.erase(ki);
+        pool.mapKeyImages.Remove(ki);
     }
 
     return true;
@@ -308,17 +462,29 @@ bool RemoveKeyImagesFromMempool(const uint256 &hash, const CTxIn &txin, CTxMemPo
 bool AllAnonOutputsUnknown(CChainState &active_chainstate, const CTransaction &tx, TxValidationState &state)
 {
     state.m_has_anon_output = false;
+    std::vector<CCmpPubKey> pks;
+    std::vector<unsigned int> output_n;
     for (unsigned int k = 0; k < tx.vpout.size(); k++) {
         if (!tx.vpout[k]->IsType(OUTPUT_RINGCT)) {
             continue;
         }
-        state.m_has_anon_output = true;
-        auto &pblocktree{active_chainstate.m_blockman.m_block_tree_db};
+        pks.push_back(((CTxOutRingCT*)tx.vpout[k].get())->pk);
+        output_n.push_back(k);
+    }
+    if (pks.empty()) {
+        return true;
+    }
+    state.m_has_anon_output = true;
+    auto &pblocktree{active_chainstate.m_blockman.m_block_tree_db};
+    std::vector<int64_t> indices;
+    pblocktree->ReadRCTOutputLinks(pks, indices);
 
+    for (size_t i = 0; i < pks.size(); ++i) {
+        const unsigned int k = output_n[i];
         CTxOutRingCT *txout = (CTxOutRingCT*)tx.vpout[k].get();
 
-        int64_t nTestExists;
-        if (pblocktree->ReadRCTOutputLink(txout->pk, nTestExists)) {
+        int64_t nTestExists = indices[i];
+        if (nTestExists >= 0) {
             COutPoint op(tx.GetHash(), k);
             CAnonOutput ao;
             if (!pblocktree->ReadRCTOutput(nTestExists, ao) || ao.outpoint != op) {
@@ -389,14 +555,29 @@ bool RewindToHeight(ChainstateManager &chainman, CTxMemPool &mempool, int nToHei
     LogPrintf("%s: height %d\n", __func__, nToHeight);
 
     auto &pblocktree{chainman.m_blockman.m_block_tree_db};
+    CChainState &chainstate = chainman.ActiveChainstate();
     nBlocks = 0;
     int64_t nLastRCTOutput = 0;
 
     const CChainParams &chainparams = Params();
-    CCoinsViewCache &view = chainman.ActiveChainstate().CoinsTip();
+    // Undo effects of many blocks accumulate in one view and are written with few flushes,
+    // the coins tip and the index dbs stay consistent with the chain tip at every flush.
+    CCoinsViewCache view(&chainstate.CoinsTip());
     view.fForceDisconnect = true;
     BlockValidationState state;
     state.m_chainman = &chainman;
+    size_t num_pending = 0;
+
+    auto flush_pending = [&]() -> bool {
+        if (num_pending == 0) {
+            return true;
+        }
+        num_pending = 0;
+        if (!FlushView(&view, state, chainstate, true)) {
+            return false;
+        }
+        return chainstate.FlushStateToDisk(state, FlushStateMode::IF_NEEDED);
+    };
 
     CBlockIndex *pindex_tip = chainman.ActiveChain().Tip();
     for (CBlockIndex *pindex = pindex_tip; pindex && pindex->pprev; pindex = pindex->pprev) {
@@ -404,40 +585,73 @@ bool RewindToHeight(ChainstateManager &chainman, CTxMemPool &mempool, int nToHei
             break;
         }
 
-        nBlocks++;
-
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         CBlock& block = *pblock;
         if (!node::ReadBlockFromDisk(block, pindex, chainparams.GetConsensus())) {
+            flush_pending();
             return errorN(false, sError, __func__, "ReadBlockFromDisk failed.");
         }
-        if (DISCONNECT_OK != chainman.ActiveChainstate().DisconnectBlock(block, pindex, view)) {
+        if (DISCONNECT_OK != chainstate.DisconnectBlock(block, pindex, view)) {
+            // Blocks disconnected before this one are complete in the view
+            flush_pending();
             return errorN(false, sError, __func__, "DisconnectBlock failed.");
         }
-        if (!FlushView(&view, state, chainman.ActiveChainstate(), true)) {
-            return errorN(false, sError, __func__, "FlushView failed.");
-        }
-        if (!chainman.ActiveChainstate().FlushStateToDisk(state, FlushStateMode::IF_NEEDED)) {
-            return errorN(false, sError, __func__, "FlushStateToDisk failed.");
-        }
+        nBlocks++;
+        num_pending++;
 
         chainman.ActiveChain().SetTip(pindex->pprev);
-        chainman.ActiveChainstate().UpdateTip(pindex->pprev);
+        chainstate.UpdateTip(pindex->pprev);
         GetMainSignals().BlockDisconnected(pblock, pindex);
+
+        if (num_pending >= REWIND_FLUSH_BLOCKS ||
+            view.DynamicMemoryUsage() > REWIND_FLUSH_MEMORY) {
+            if (!flush_pending()) {
+                return errorN(false, sError, __func__, "Flush failed.");
+            }
+        }
+    }
+    if (!flush_pending()) {
+        return errorN(false, sError, __func__, "Flush failed.");
     }
     nLastRCTOutput = pindex_tip ? pindex_tip->nAnonOutputs : 0;
 
-    int nRemoveOutput = nLastRCTOutput + 1;
+    // Remove outputs left past the old tip by an earlier failed rewind
+    CDBBatch batch(*pblocktree);
+    int64_t nRemoveOutput = nLastRCTOutput + 1;
     CAnonOutput ao;
     while (pblocktree->ReadRCTOutput(nRemoveOutput, ao)) {
-        pblocktree->EraseRCTOutput(nRemoveOutput);
-        pblocktree->EraseRCTOutputLink(ao.pubkey);
+        pblocktree->EraseRCTOutput(batch, nRemoveOutput);
+        pblocktree->EraseRCTOutputLink(batch, ao.pubkey);
         nRemoveOutput++;
     }
+    if (!pblocktree->WriteBatch(batch)) {
+        return errorN(false, sError, __func__, "WriteBatch failed.");
+    }
 
     return true;
 };
 
+int GetAnonOutputHeight(const CChain &chain, int64_t anon_index)
+{
+    AssertLockHeld(cs_main);
+
+    const CBlockIndex *tip = chain.Tip();
+    if (!tip || anon_index < 1 || anon_index > tip->nAnonOutputs) {
+        return -1;
+    }
+    // nAnonOutputs is the running total, find the first block reaching anon_index
+    int low = 0, high = tip->nHeight;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (chain[mid]->nAnonOutputs >= anon_index) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+};
+
 bool RewindRangeProof(const std::vector<uint8_t> &rangeproof, const std::vector<uint8_t> &commitment, const uint256 &nonce,
                       std::vector<uint8_t> &blind_out, CAmount &value_out)
 {
@@ -9,6 +9,7 @@
 #include <pubkey.h>
 #include <consensus/amount.h>
 #include <set>
+#include <vector>
 
 
 extern RecursiveMutex cs_main;
@@ -21,23 +22,82 @@ class CTxMemPool;
 class TxValidationState;
 class ChainstateManager;
 class CChainState;
+class CChain;
+class CBlockTreeDB;
+class CKeyImageSpend;
+class BlockValidationStats;
 
 const size_t MIN_RINGSIZE = 1;
 const size_t MAX_RINGSIZE = 32;
 // const size_t MIN_RINGSIZE_AFTER_FORK = 3; // Moved to consensusParams to avoid circular dependency
 
 const size_t MAX_ANON_INPUTS = 32; // To raise see MLSAG_MAX_ROWS also
+const size_t MAX_PREFETCH_ANON_OUTPUTS = MAX_ANON_INPUTS * MAX_RINGSIZE * 4;
 
 const size_t ANON_FEE_MULTIPLIER = 2;
 
+/** RewindToHeight flushes the accumulated undo effects after this many blocks, or when the view grows past REWIND_FLUSH_MEMORY */
+const size_t REWIND_FLUSH_BLOCKS = 1000;
+const size_t REWIND_FLUSH_MEMORY = 256 << 20;
+
 const size_t DEFAULT_RING_SIZE = 12;
 const size_t DEFAULT_INPUTS_PER_SIG = 1;
 
+/**
+ * Closure representing one anon input's MLSAG verification.
+ * Ring members are resolved by VerifyMLSAG, so running the check needs no db access or cs_main.
+ */
+class CAnonCheck
+{
+private:
+    const CTransaction *ptxTo;
+    unsigned int nIn;
+    size_t nCols;
+    size_t nRows;
+    std::vector<uint8_t> vM;
+    std::vector<uint8_t> vInCommits;
+    std::vector<uint8_t> vOutCommits;
+    const char *error;
+    BlockValidationStats *m_validation_stats;
+public:
+    CAnonCheck() : ptxTo(nullptr), nIn(0), nCols(0), nRows(0), error(nullptr), m_validation_stats(nullptr) {}
+    CAnonCheck(const CTransaction &txToIn, unsigned int nInIn, size_t nColsIn, size_t nRowsIn,
+               std::vector<uint8_t> &&vMIn, std::vector<uint8_t> &&vInCommitsIn, std::vector<uint8_t> &&vOutCommitsIn,
+               BlockValidationStats *validation_stats = nullptr) :
+        ptxTo(&txToIn), nIn(nInIn), nCols(nColsIn), nRows(nRowsIn),
+        vM(std::move(vMIn)), vInCommits(std::move(vInCommitsIn)), vOutCommits(std::move(vOutCommitsIn)), error(nullptr),
+        m_validation_stats(validation_stats) {}
+
+    bool operator()();
+
+    void swap(CAnonCheck &check) noexcept
+    {
+        std::swap(ptxTo, check.ptxTo);
+        std::swap(nIn, check.nIn);
+        std::swap(nCols, check.nCols);
+        std::swap(nRows, check.nRows);
+        std::swap(vM, check.vM);
+        std::swap(vInCommits, check.vInCommits);
+        std::swap(vOutCommits, check.vOutCommits);
+        std::swap(error, check.error);
+        std::swap(m_validation_stats, check.m_validation_stats);
+    }
+
+    const char *GetError() const { return error ? error : "verify-mlsag-failed"; }
+};
+
 bool CheckAnonInputMempoolConflicts(const CTxIn &txin, const uint256 txhash, CTxMemPool *pmempool, TxValidationState &state);
 
-bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+/** If pvChecks is not nullptr the ring signature checks are pushed onto it instead of being performed inline. */
+bool VerifyMLSAG(const CTransaction &tx, TxValidationState &state, std::vector<CAnonCheck> *pvChecks = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** Read the ring members of tx into the anon output cache, call before cs_main is taken so VerifyMLSAG doesn't wait on the db. */
+void PrefetchAnonInputs(CBlockTreeDB &block_tree_db, const CTransaction &tx) LOCKS_EXCLUDED(cs_main);
 
 int GetKeyImage(CCmpPubKey &ki, const CCmpPubKey &pubkey, const CKey &key);
+
+/** Look up the spent state of many key images at once, reading the db in key order. states is resized to match key_images. */
+void GetKeyImageStates(CBlockTreeDB &block_tree_db, const CTxMemPool *pmempool, const std::vector<CCmpPubKey> &key_images, std::vector<CKeyImageSpend> &states) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 bool AddKeyImagesToMempool(const CTransaction &tx, CTxMemPool &pool);
 bool RemoveKeyImagesFromMempool(const uint256 &hash, const CTxIn &txin, CTxMemPool &pool);
 
@@ -47,6 +107,9 @@ bool RollBackRCTIndex(ChainstateManager &chainman, int64_t nLastValidRCTOutput,
 
 bool RewindToHeight(ChainstateManager &chainman, CTxMemPool &mempool, int nToHeight, int &nBlocks, std::string &sError) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** Height of the block containing anon_index, from the anon output counts in the block index. -1 if not in chain. */
+int GetAnonOutputHeight(const CChain &chain, int64_t anon_index) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 bool RewindRangeProof(const std::vector<uint8_t> &rangeproof, const std::vector<uint8_t> &commitment, const uint256 &nonce,
                       std::vector<uint8_t> &blind_out, CAmount &value_out);
 
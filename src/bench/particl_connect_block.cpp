@@ -0,0 +1,227 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/test/hdwallet_test_fixture.h>
+#include <bench/bench.h>
+#include <wallet/hdwallet.h>
+#include <interfaces/chain.h>
+#include <interfaces/wallet.h>
+
+#include <blind.h>
+#include <chain.h>
+#include <consensus/validation.h>
+#include <validation.h>
+#include <rpc/rpcutil.h>
+#include <timedata.h>
+#include <node/miner.h>
+#include <pos/miner.h>
+#include <util/string.h>
+#include <util/time.h>
+#include <util/translation.h>
+
+/** Outputs per funding txn */
+static const size_t FUNDING_OUTPUTS_PER_TXN = 50;
+
+/** Contents of the block under test */
+struct BlockLayout {
+    size_t num_anon_txns;
+    size_t num_anon_inputs;     // Inputs per anon txn, each with its own ring
+    size_t ring_size;
+    size_t num_blind_txns;
+    size_t num_coldstake_outputs;
+};
+
+static std::shared_ptr<CHDWallet> CreateBlockWallet(wallet::WalletContext& wallet_context, std::string wallet_name)
+{
+    DatabaseOptions options;
+    DatabaseStatus status;
+    bilingual_str error;
+    std::vector<bilingual_str> warnings;
+    options.create_flags = WALLET_FLAG_BLANK_WALLET;
+    auto database = MakeWalletDatabase(wallet_name, options, status, error);
+    auto wallet = CWallet::Create(wallet_context, wallet_name, std::move(database), options.create_flags, error, warnings);
+
+    return std::static_pointer_cast<CHDWallet>(wallet);
+}
+
+/** Attempt to stake the next block at mock_time, block_out is set instead of submitting the block */
+static bool TryStakeBlock(CHDWallet *pwallet, ChainstateManager &chainman, int64_t mock_time, CBlock *block_out = nullptr)
+{
+    SetMockTime(mock_time);
+    int nBestHeight = WITH_LOCK(cs_main, return chainman.ActiveChain().Height());
+    int64_t nSearchTime = GetAdjustedTime() & ~Params().GetStakeTimestampMask(nBestHeight + 1);
+
+    std::unique_ptr<node::CBlockTemplate> pblocktemplate = pwallet->CreateNewBlock();
+    assert(pblocktemplate.get());
+    if (!pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime)) {
+        return false;
+    }
+    if (block_out) {
+        *block_out = pblocktemplate->block;
+        return true;
+    }
+    bool accepted = CheckStake(chainman, &pblocktemplate->block);
+    SyncWithValidationInterfaceQueue();
+    return accepted;
+}
+
+static void StakeBlocks(CHDWallet *pwallet, ChainstateManager &chainman, int64_t &mock_time, size_t num_blocks)
+{
+    size_t num_staked = 0;
+    for (size_t k = 0; k < 10000 && num_staked < num_blocks; ++k) {
+        num_staked += TryStakeBlock(pwallet, chainman, ++mock_time);
+    }
+    assert(num_staked == num_blocks);
+}
+
+static void FundOutputs(const std::any &context, const std::string &type_out, const std::string &address, size_t num_outputs)
+{
+    for (size_t i = 0; i < num_outputs; i += FUNDING_OUTPUTS_PER_TXN) {
+        std::string outputs;
+        for (size_t k = i; k < std::min(num_outputs, i + FUNDING_OUTPUTS_PER_TXN); ++k) {
+            if (!outputs.empty()) {
+                outputs += ",";
+            }
+            outputs += strprintf("{\"address\":\"%s\",\"amount\":1}", address);
+        }
+        CallRPC("sendtypeto part " + type_out + " [" + outputs + "]", context, "a");
+    }
+}
+
+/**
+ * Regtest block full of RingCT spends to CT outputs, CT spends and cold stake outputs.
+ * The txns pass through the mempool first, cold_caches sets the rangeproof, signature,
+ * script execution and anon output caches to their minimum sizes so nothing verified
+ * on mempool acceptance is found again.
+ */
+static void ParticlConnectBlock(benchmark::Bench& bench, const BlockLayout &layout, bool check_block_only, bool cold_caches)
+{
+    std::vector<const char*> extra_args;
+    if (cold_caches) {
+        extra_args = {"-maxrangeproofcachesize=0", "-maxsigcachesize=0", "-rctcache=0"};
+    }
+    TestingSetup test_setup{CBaseChainParams::REGTEST, extra_args, true};
+    const auto context = util::AnyPtr<node::NodeContext>(&test_setup.m_node);
+    ChainstateManager &chainman = *test_setup.m_node.chainman;
+
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(test_setup.m_node);
+    std::unique_ptr<interfaces::WalletLoader> wallet_loader = interfaces::MakeWalletLoader(*chain, *Assert(test_setup.m_node.args));
+    wallet_loader->registerRpcs();
+    WalletContext& wallet_context = *wallet_loader->context();
+
+    ECC_Start_Stealth();
+    ECC_Start_Blinding();
+
+    std::shared_ptr<CHDWallet> pwallet_a = CreateBlockWallet(wallet_context, "a");
+    assert(pwallet_a.get());
+    AddWallet(wallet_context, pwallet_a);
+    std::shared_ptr<CHDWallet> pwallet_b = CreateBlockWallet(wallet_context, "b");
+    assert(pwallet_b.get());
+    AddWallet(wallet_context, pwallet_b);
+    {
+        int last_height = chainman.ActiveChain().Height();
+        uint256 last_hash = chainman.ActiveChain().Tip()->GetBlockHash();
+        LOCK2(pwallet_a->cs_wallet, pwallet_b->cs_wallet);
+        pwallet_a->SetLastBlockProcessed(last_height, last_hash);
+        pwallet_b->SetLastBlockProcessed(last_height, last_hash);
+    }
+
+    CallRPC("extkeyimportmaster tprv8ZgxMBicQKsPeK5mCpvMsd1cwyT1JZsrBN82XkoYuZY1EVK7EwDaiL9sDfqUU5SntTfbRfnRedFWjg5xkDG5i3iwd3yP7neX5F2dtdCojk4", context, "a");
+    CallRPC("extkeyimportmaster \"expect trouble pause odor utility palace ignore arena disorder frog helmet addict\"", context, "b");
+
+    int64_t mock_time = WITH_LOCK(cs_main, return chainman.ActiveChain().Tip()->nTime);
+    StakeBlocks(pwallet_a.get(), chainman, mock_time, 1);
+
+    // Extra anon outputs to pick ring members from
+    std::string sx_a = part::StripQuotes(CallRPC("getnewstealthaddress", context, "a").write());
+    size_t num_anon_spent = layout.num_anon_txns * layout.num_anon_inputs;
+    FundOutputs(context, "anon", sx_a, num_anon_spent + layout.ring_size * 2);
+    FundOutputs(context, "blind", sx_a, layout.num_blind_txns);
+    SyncWithValidationInterfaceQueue();
+
+    // Mine the funding txns and let them mature
+    StakeBlocks(pwallet_a.get(), chainman, mock_time, Params().GetStakeMinConfirmations() + 1);
+
+    // Fill the mempool, every funding output holds 1 coin
+    std::string sx_b = part::StripQuotes(CallRPC("getnewstealthaddress", context, "b").write());
+    for (size_t i = 0; i < layout.num_anon_txns; ++i) {
+        CallRPC(strprintf("sendtypeto anon blind [{\"address\":\"%s\",\"amount\":%d.5}] \"\" \"\" %d 1",
+                sx_b, layout.num_anon_inputs - 1, layout.ring_size), context, "a");
+    }
+    for (size_t i = 0; i < layout.num_blind_txns; ++i) {
+        CallRPC(strprintf("sendtypeto blind blind [{\"address\":\"%s\",\"amount\":0.5}]", sx_b), context, "a");
+    }
+    if (layout.num_coldstake_outputs > 0) {
+        std::string addr_stake = part::StripQuotes(CallRPC("getnewaddress", context, "a").write());
+        std::string addr_spend = part::StripQuotes(CallRPC("getnewaddress \"\" false false true", context, "b").write());
+        std::string outputs;
+        for (size_t i = 0; i < layout.num_coldstake_outputs; ++i) {
+            if (!outputs.empty()) {
+                outputs += ",";
+            }
+            outputs += strprintf("{\"address\":\"%s\",\"amount\":1,\"stakeaddress\":\"%s\"}", addr_spend, addr_stake);
+        }
+        CallRPC("sendtypeto part part [" + outputs + "]", context, "a");
+    }
+    SyncWithValidationInterfaceQueue();
+
+    CBlock block;
+    for (size_t k = 0; k < 10000 && !TryStakeBlock(pwallet_a.get(), chainman, ++mock_time, &block); ++k) {
+    }
+    assert(block.IsProofOfStake());
+    assert(block.vtx.size() > layout.num_anon_txns + layout.num_blind_txns);
+
+    if (check_block_only) {
+        bench.unit("block").run([&] {
+            CBlock block_copy = block; // CBlock caches its checked state
+            BlockValidationState state;
+            bool rv = CheckBlock(block_copy, state, Params().GetConsensus());
+            assert(rv);
+        });
+    } else {
+        // Same as TestBlockValidity, the view is discarded
+        bench.unit("block").run([&] {
+            LOCK(cs_main);
+            CChainState &chainstate = chainman.ActiveChainstate();
+            CCoinsViewCache view(&chainstate.CoinsTip());
+            uint256 block_hash(block.GetHash());
+            CBlockIndex index_dummy(block);
+            index_dummy.pprev = chainstate.m_chain.Tip();
+            index_dummy.nHeight = index_dummy.pprev->nHeight + 1;
+            index_dummy.phashBlock = &block_hash;
+
+            BlockValidationState state;
+            state.m_chainman = &chainman;
+            bool rv = chainstate.ConnectBlock(block, state, &index_dummy, view, true);
+            chainstate.m_blockman.m_dirty_blockindex.erase(&index_dummy);
+            assert(rv);
+        });
+    }
+
+    RemoveWallet(wallet_context, pwallet_a, std::nullopt);
+    pwallet_a.reset();
+    RemoveWallet(wallet_context, pwallet_b, std::nullopt);
+    pwallet_b.reset();
+    SetMockTime(0);
+
+    ECC_Stop_Stealth();
+    ECC_Stop_Blinding();
+}
+
+static const BlockLayout LAYOUT_ANON{50, 2, 12, 20, 100};
+static const BlockLayout LAYOUT_ANON_RING32{20, 2, 32, 0, 0};
+
+static void ParticlConnectBlockAnon(benchmark::Bench& bench) { ParticlConnectBlock(bench, LAYOUT_ANON, false, false); }
+static void ParticlConnectBlockAnonColdCache(benchmark::Bench& bench) { ParticlConnectBlock(bench, LAYOUT_ANON, false, true); }
+static void ParticlConnectBlockAnonRing32(benchmark::Bench& bench) { ParticlConnectBlock(bench, LAYOUT_ANON_RING32, false, false); }
+static void ParticlConnectBlockAnonRing32ColdCache(benchmark::Bench& bench) { ParticlConnectBlock(bench, LAYOUT_ANON_RING32, false, true); }
+static void ParticlCheckBlockAnon(benchmark::Bench& bench) { ParticlConnectBlock(bench, LAYOUT_ANON, true, false); }
+static void ParticlCheckBlockAnonColdCache(benchmark::Bench& bench) { ParticlConnectBlock(bench, LAYOUT_ANON, true, true); }
+
+BENCHMARK(ParticlConnectBlockAnon);
+BENCHMARK(ParticlConnectBlockAnonColdCache);
+BENCHMARK(ParticlConnectBlockAnonRing32);
+BENCHMARK(ParticlConnectBlockAnonRing32ColdCache);
+BENCHMARK(ParticlCheckBlockAnon);
+BENCHMARK(ParticlCheckBlockAnonColdCache);
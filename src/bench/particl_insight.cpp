@@ -0,0 +1,247 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/test/hdwallet_test_fixture.h>
+#include <bench/bench.h>
+#include <wallet/hdwallet.h>
+#include <interfaces/chain.h>
+#include <interfaces/wallet.h>
+
+#include <blind.h>
+#include <chain.h>
+#include <index/timestampindex.h>
+#include <insight/insight.h>
+#include <insight/rpc.h>
+#include <rpc/server.h>
+#include <validation.h>
+#include <rpc/rpcutil.h>
+#include <timedata.h>
+#include <node/miner.h>
+#include <pos/miner.h>
+#include <util/string.h>
+#include <util/time.h>
+#include <util/translation.h>
+
+/** Outputs per funding txn */
+static const size_t FUNDING_OUTPUTS_PER_TXN = 50;
+
+/** Txns sent before a block is staked, keeps unconfirmed chains under the mempool ancestor limit */
+static const size_t TXNS_PER_BLOCK = 20;
+
+/** Outputs of the indexed address spent per spending txn, a quarter of the received outputs are spent */
+static const size_t INPUTS_PER_SPEND = 10;
+
+enum class InsightOp {
+    ADDRESS_DELTAS,
+    ADDRESS_UTXOS,
+    ADDRESS_BALANCE,
+    SPENT_INFO,
+    BLOCK_DELTAS,
+    BLOCK_HASHES,
+};
+
+static std::shared_ptr<CHDWallet> CreateInsightWallet(wallet::WalletContext& wallet_context, std::string wallet_name)
+{
+    DatabaseOptions options;
+    DatabaseStatus status;
+    bilingual_str error;
+    std::vector<bilingual_str> warnings;
+    options.create_flags = WALLET_FLAG_BLANK_WALLET;
+    auto database = MakeWalletDatabase(wallet_name, options, status, error);
+    auto wallet = CWallet::Create(wallet_context, wallet_name, std::move(database), options.create_flags, error, warnings);
+
+    return std::static_pointer_cast<CHDWallet>(wallet);
+}
+
+static void StakeBlocks(CHDWallet *pwallet, ChainstateManager &chainman, int64_t &mock_time, size_t num_blocks)
+{
+    size_t num_staked = 0;
+    for (size_t k = 0; k < 10000 && num_staked < num_blocks; ++k) {
+        SetMockTime(++mock_time);
+        int nBestHeight = WITH_LOCK(cs_main, return chainman.ActiveChain().Height());
+        int64_t nSearchTime = GetAdjustedTime() & ~Params().GetStakeTimestampMask(nBestHeight + 1);
+
+        std::unique_ptr<node::CBlockTemplate> pblocktemplate = pwallet->CreateNewBlock();
+        assert(pblocktemplate.get());
+        if (pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime) &&
+            CheckStake(chainman, &pblocktemplate->block)) {
+            num_staked++;
+        }
+        SyncWithValidationInterfaceQueue();
+    }
+    assert(num_staked == num_blocks);
+}
+
+/**
+ * Regtest chain where one reused address receives history_size outputs from wallet a, FUNDING_OUTPUTS_PER_TXN per txn.
+ * Wallet b owns the address and spends a quarter of its outputs back to a, change goes to fresh addresses.
+ * The address, spent, timestamp and balances indices are enabled, each benchmark times one insight RPC.
+ */
+static void ParticlInsight(benchmark::Bench& bench, size_t history_size, InsightOp op)
+{
+    TestingSetup test_setup{CBaseChainParams::REGTEST, {"-addressindex", "-spentindex", "-timestampindex", "-balancesindex"}, true};
+    const auto context = util::AnyPtr<node::NodeContext>(&test_setup.m_node);
+    ChainstateManager &chainman = *test_setup.m_node.chainman;
+    assert(fAddressIndex && fSpentIndex && fBalancesIndex);
+
+    static bool registered_insight_rpcs = false;
+    if (!registered_insight_rpcs) {
+        RegisterInsightRPCCommands(tableRPC);
+        registered_insight_rpcs = true;
+    }
+    g_timestamp_index = std::make_unique<TimestampIndex>(0, false, true);
+    bool started = g_timestamp_index->Start(chainman.ActiveChainstate());
+    assert(started);
+
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(test_setup.m_node);
+    std::unique_ptr<interfaces::WalletLoader> wallet_loader = interfaces::MakeWalletLoader(*chain, *Assert(test_setup.m_node.args));
+    wallet_loader->registerRpcs();
+    WalletContext& wallet_context = *wallet_loader->context();
+
+    ECC_Start_Stealth();
+    ECC_Start_Blinding();
+
+    std::shared_ptr<CHDWallet> pwallet_a = CreateInsightWallet(wallet_context, "a");
+    assert(pwallet_a.get());
+    AddWallet(wallet_context, pwallet_a);
+    std::shared_ptr<CHDWallet> pwallet_b = CreateInsightWallet(wallet_context, "b");
+    assert(pwallet_b.get());
+    AddWallet(wallet_context, pwallet_b);
+    {
+        int last_height = chainman.ActiveChain().Height();
+        uint256 last_hash = chainman.ActiveChain().Tip()->GetBlockHash();
+        LOCK2(pwallet_a->cs_wallet, pwallet_b->cs_wallet);
+        pwallet_a->SetLastBlockProcessed(last_height, last_hash);
+        pwallet_b->SetLastBlockProcessed(last_height, last_hash);
+    }
+
+    CallRPC("extkeyimportmaster tprv8ZgxMBicQKsPeK5mCpvMsd1cwyT1JZsrBN82XkoYuZY1EVK7EwDaiL9sDfqUU5SntTfbRfnRedFWjg5xkDG5i3iwd3yP7neX5F2dtdCojk4", context, "a");
+    CallRPC("extkeyimportmaster \"expect trouble pause odor utility palace ignore arena disorder frog helmet addict\"", context, "b");
+
+    int64_t mock_time = WITH_LOCK(cs_main, return chainman.ActiveChain().Tip()->nTime);
+    StakeBlocks(pwallet_a.get(), chainman, mock_time, 1);
+
+    std::string addr_a = part::StripQuotes(CallRPC("getnewaddress", context, "a").write());
+    std::string addr_b = part::StripQuotes(CallRPC("getnewaddress", context, "b").write());
+
+    std::vector<std::string> funding_txids;
+    size_t num_unconfirmed = 0;
+    auto stake = [&]() {
+        SyncWithValidationInterfaceQueue();
+        StakeBlocks(pwallet_a.get(), chainman, mock_time, 1);
+        num_unconfirmed = 0;
+    };
+    auto send = [&](const std::string &outputs, const std::string &wallet) {
+        std::string txid = part::StripQuotes(CallRPC("sendtypeto part part [" + outputs + "]", context, wallet).write());
+        if (++num_unconfirmed >= TXNS_PER_BLOCK) {
+            stake();
+        }
+        return txid;
+    };
+    for (size_t i = 0; i < history_size; i += FUNDING_OUTPUTS_PER_TXN) {
+        std::string outputs;
+        for (size_t k = i; k < std::min(history_size, i + FUNDING_OUTPUTS_PER_TXN); ++k) {
+            outputs += strprintf("%s{\"address\":\"%s\",\"amount\":1}", outputs.empty() ? "" : ",", addr_b);
+        }
+        funding_txids.push_back(send(outputs, "a"));
+    }
+    if (num_unconfirmed > 0) {
+        stake();
+    }
+    uint256 funded_block_hash = WITH_LOCK(cs_main, return chainman.ActiveChain().Tip()->GetBlockHash());
+
+    for (size_t i = 0; i < history_size / 4; i += INPUTS_PER_SPEND) {
+        send(strprintf("{\"address\":\"%s\",\"amount\":%d}", addr_a, INPUTS_PER_SPEND - 1), "b");
+    }
+    if (num_unconfirmed > 0) {
+        stake();
+    }
+    bool synced = g_timestamp_index->BlockUntilSyncedToCurrentChain();
+    assert(synced);
+
+    std::string addresses = strprintf("{\"addresses\":[\"%s\"]}", addr_b);
+    std::string spent_inputs;
+    for (const auto &txid : funding_txids) {
+        for (size_t n = 0; n < FUNDING_OUTPUTS_PER_TXN; ++n) {
+            spent_inputs += strprintf("%s{\"txid\":\"%s\",\"index\":%d}", spent_inputs.empty() ? "" : ",", txid, n);
+        }
+    }
+    int64_t tip_time = WITH_LOCK(cs_main, return chainman.ActiveChain().Tip()->nTime);
+
+    switch (op) {
+        case InsightOp::ADDRESS_DELTAS:
+            bench.run([&] {
+                UniValue rv = CallRPC("getaddressdeltas " + addresses, context);
+                assert(rv.size() >= history_size);
+            });
+            break;
+        case InsightOp::ADDRESS_UTXOS:
+            bench.run([&] {
+                UniValue rv = CallRPC("getaddressutxos " + addresses, context);
+                assert(rv.size() > 0);
+            });
+            break;
+        case InsightOp::ADDRESS_BALANCE:
+            bench.run([&] {
+                UniValue rv = CallRPC("getaddressbalance " + addresses, context);
+                ankerl::nanobench::doNotOptimizeAway(rv);
+            });
+            break;
+        case InsightOp::SPENT_INFO:
+            // Every output of the funding txns, most are unspent
+            bench.run([&] {
+                UniValue rv = CallRPC("getspentinfo [" + spent_inputs + "]", context);
+                assert(rv.size() == funding_txids.size() * FUNDING_OUTPUTS_PER_TXN);
+            });
+            break;
+        case InsightOp::BLOCK_DELTAS:
+            // The last block holding funding txns, at most TXNS_PER_BLOCK
+            bench.run([&] {
+                UniValue rv = CallRPC("getblockdeltas " + funded_block_hash.ToString(), context);
+                ankerl::nanobench::doNotOptimizeAway(rv);
+            });
+            break;
+        case InsightOp::BLOCK_HASHES:
+            bench.run([&] {
+                UniValue rv = CallRPC(strprintf("getblockhashes %d 0", tip_time + 1), context);
+                assert(rv.size() > 0);
+            });
+            break;
+    }
+
+    RemoveWallet(wallet_context, pwallet_a, std::nullopt);
+    pwallet_a.reset();
+    RemoveWallet(wallet_context, pwallet_b, std::nullopt);
+    pwallet_b.reset();
+    g_timestamp_index->Stop();
+    g_timestamp_index.reset();
+    SetMockTime(0);
+
+    ECC_Stop_Stealth();
+    ECC_Stop_Blinding();
+}
+
+static void ParticlInsightAddressDeltas1k(benchmark::Bench& bench) { ParticlInsight(bench, 1000, InsightOp::ADDRESS_DELTAS); }
+static void ParticlInsightAddressDeltas10k(benchmark::Bench& bench) { ParticlInsight(bench, 10000, InsightOp::ADDRESS_DELTAS); }
+static void ParticlInsightAddressUtxos1k(benchmark::Bench& bench) { ParticlInsight(bench, 1000, InsightOp::ADDRESS_UTXOS); }
+static void ParticlInsightAddressUtxos10k(benchmark::Bench& bench) { ParticlInsight(bench, 10000, InsightOp::ADDRESS_UTXOS); }
+static void ParticlInsightAddressBalance1k(benchmark::Bench& bench) { ParticlInsight(bench, 1000, InsightOp::ADDRESS_BALANCE); }
+static void ParticlInsightAddressBalance10k(benchmark::Bench& bench) { ParticlInsight(bench, 10000, InsightOp::ADDRESS_BALANCE); }
+static void ParticlInsightSpentInfo1k(benchmark::Bench& bench) { ParticlInsight(bench, 1000, InsightOp::SPENT_INFO); }
+static void ParticlInsightSpentInfo10k(benchmark::Bench& bench) { ParticlInsight(bench, 10000, InsightOp::SPENT_INFO); }
+static void ParticlInsightBlockDeltas1k(benchmark::Bench& bench) { ParticlInsight(bench, 1000, InsightOp::BLOCK_DELTAS); }
+static void ParticlInsightBlockHashes1k(benchmark::Bench& bench) { ParticlInsight(bench, 1000, InsightOp::BLOCK_HASHES); }
+static void ParticlInsightBlockHashes10k(benchmark::Bench& bench) { ParticlInsight(bench, 10000, InsightOp::BLOCK_HASHES); }
+
+BENCHMARK(ParticlInsightAddressDeltas1k);
+BENCHMARK(ParticlInsightAddressDeltas10k);
+BENCHMARK(ParticlInsightAddressUtxos1k);
+BENCHMARK(ParticlInsightAddressUtxos10k);
+BENCHMARK(ParticlInsightAddressBalance1k);
+BENCHMARK(ParticlInsightAddressBalance10k);
+BENCHMARK(ParticlInsightSpentInfo1k);
+BENCHMARK(ParticlInsightSpentInfo10k);
+BENCHMARK(ParticlInsightBlockDeltas1k);
+BENCHMARK(ParticlInsightBlockHashes1k);
+BENCHMARK(ParticlInsightBlockHashes10k);
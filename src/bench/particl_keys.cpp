@@ -0,0 +1,272 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <key.h>
+#include <key/extkey.h>
+#include <key/mnemonic.h>
+#include <key/stealth.h>
+#include <random.h>
+#include <script/script.h>
+
+static void MakeStealthAddress(CStealthAddress &sx, CKey &spend_secret)
+{
+    sx.scan_secret.MakeNewKey(true);
+    assert(0 == SecretToPublicKey(sx.scan_secret, sx.scan_pubkey));
+    spend_secret.MakeNewKey(true);
+    assert(0 == SecretToPublicKey(spend_secret, sx.spend_pubkey));
+}
+
+/** Ephemeral pubkey of an output sent to sx */
+static void MakeStealthOutput(const CStealthAddress &sx, ec_point &ephem_pubkey, CKeyID &id)
+{
+    CKey ephem_secret, shared_secret;
+    ec_point pk_send_to;
+    int k, nTries = 24;
+    for (k = 0; k < nTries; ++k) {
+        ephem_secret.MakeNewKey(true);
+        if (StealthSecret(ephem_secret, sx.scan_pubkey, sx.spend_pubkey, shared_secret, pk_send_to) == 0) {
+            break;
+        }
+    }
+    assert(k < nTries);
+    assert(0 == SecretToPublicKey(ephem_secret, ephem_pubkey));
+    id = CPubKey(pk_send_to).GetID();
+}
+
+static void StealthSecretSend(benchmark::Bench& bench)
+{
+    ECC_Start();
+    ECC_Start_Stealth();
+
+    CStealthAddress sx;
+    CKey spend_secret, ephem_secret, shared_secret;
+    MakeStealthAddress(sx, spend_secret);
+    ephem_secret.MakeNewKey(true);
+    ec_point pk_send_to;
+
+    bench.run([&] {
+        StealthSecret(ephem_secret, sx.scan_pubkey, sx.spend_pubkey, shared_secret, pk_send_to);
+    });
+
+    ECC_Stop_Stealth();
+    ECC_Stop();
+}
+
+static void StealthSecretSpendKey(benchmark::Bench& bench)
+{
+    ECC_Start();
+    ECC_Start_Stealth();
+
+    CStealthAddress sx;
+    CKey spend_secret, secret_out;
+    MakeStealthAddress(sx, spend_secret);
+    ec_point ephem_pubkey;
+    CKeyID id;
+    MakeStealthOutput(sx, ephem_pubkey, id);
+
+    bench.run([&] {
+        int rv = StealthSecretSpend(sx.scan_secret, ephem_pubkey, spend_secret, secret_out);
+        assert(rv == 0);
+    });
+    assert(secret_out.GetPubKey().GetID() == id);
+
+    ECC_Stop_Stealth();
+    ECC_Stop();
+}
+
+static void StealthPrepareOutput(benchmark::Bench& bench)
+{
+    ECC_Start();
+    ECC_Start_Stealth();
+
+    CStealthAddress sx;
+    CKey spend_secret;
+    MakeStealthAddress(sx, spend_secret);
+
+    bench.run([&] {
+        CScript script_pubkey;
+        std::vector<uint8_t> data;
+        std::string error;
+        int rv = PrepareStealthOutput(sx, "narration", script_pubkey, data, error);
+        assert(rv == 0);
+    });
+
+    ECC_Stop_Stealth();
+    ECC_Stop();
+}
+
+/**
+ * Test an output that doesn't belong to the wallet against num_addresses stealth addresses,
+ * the common case when scanning blocks. Compares one ECDH per address with CStealthScanner.
+ */
+static void StealthScan(benchmark::Bench& bench, size_t num_addresses, bool use_scanner)
+{
+    ECC_Start();
+    ECC_Start_Stealth();
+
+    std::vector<CStealthAddress> addresses(num_addresses);
+    CKey spend_secret;
+    CStealthScanner scanner;
+    for (auto &sx : addresses) {
+        MakeStealthAddress(sx, spend_secret);
+        assert(scanner.AddKey(sx.scan_secret, sx.spend_pubkey, 0, 0));
+    }
+
+    CStealthAddress sx_other;
+    MakeStealthAddress(sx_other, spend_secret);
+    ec_point ephem_pubkey;
+    CKeyID id;
+    MakeStealthOutput(sx_other, ephem_pubkey, id);
+
+    bench.unit("output").run([&] {
+        CKey shared_secret;
+        if (use_scanner) {
+            int rv = scanner.Match(ephem_pubkey, 0, false, id, shared_secret);
+            assert(rv == CStealthScanner::NO_MATCH);
+            return;
+        }
+        for (const auto &sx : addresses) {
+            ec_point pk_extracted;
+            if (StealthShared(sx.scan_secret, ephem_pubkey, shared_secret) != 0 ||
+                StealthSharedToPublicKey(sx.spend_pubkey, shared_secret, pk_extracted) != 0) {
+                assert(false);
+            }
+            assert(CPubKey(pk_extracted).GetID() != id);
+        }
+    });
+
+    ECC_Stop_Stealth();
+    ECC_Stop();
+}
+
+static void StealthScan1(benchmark::Bench& bench) { StealthScan(bench, 1, false); }
+static void StealthScan10(benchmark::Bench& bench) { StealthScan(bench, 10, false); }
+static void StealthScan100(benchmark::Bench& bench) { StealthScan(bench, 100, false); }
+static void StealthScanner1(benchmark::Bench& bench) { StealthScan(bench, 1, true); }
+static void StealthScanner10(benchmark::Bench& bench) { StealthScan(bench, 10, true); }
+static void StealthScanner100(benchmark::Bench& bench) { StealthScan(bench, 100, true); }
+
+/** Derive a path of the given depth from a master key, as when loading an account chain */
+static void ExtKeyDerivePath(benchmark::Bench& bench, size_t depth, bool hardened)
+{
+    ECC_Start();
+
+    uint8_t seed[32];
+    GetRandBytes(seed);
+    CExtKeyPair master;
+    master.SetSeed(seed, sizeof(seed));
+
+    bench.run([&] {
+        CExtKeyPair ek = master;
+        for (size_t i = 0; i < depth; ++i) {
+            CExtKey ek_child;
+            bool rv = hardened ? ek.Derive(ek_child, (uint32_t)i | (uint32_t)1 << 31) : ek.Derive(ek_child, (uint32_t)i);
+            assert(rv);
+            ek = CExtKeyPair(ek_child);
+        }
+    });
+
+    ECC_Stop();
+}
+
+static void ExtKeyDerivePubPath(benchmark::Bench& bench, size_t depth)
+{
+    ECC_Start();
+
+    uint8_t seed[32];
+    GetRandBytes(seed);
+    CExtKeyPair master;
+    master.SetSeed(seed, sizeof(seed));
+    CExtKeyPair master_public = master.Neutered();
+
+    bench.run([&] {
+        CExtKeyPair ek = master_public;
+        for (size_t i = 0; i < depth; ++i) {
+            CExtPubKey ek_child;
+            bool rv = ek.Derive(ek_child, (uint32_t)i);
+            assert(rv);
+            ek = CExtKeyPair(ek_child);
+        }
+    });
+
+    ECC_Stop();
+}
+
+static void ExtKeyDerive1(benchmark::Bench& bench) { ExtKeyDerivePath(bench, 1, false); }
+static void ExtKeyDerive5(benchmark::Bench& bench) { ExtKeyDerivePath(bench, 5, false); }
+static void ExtKeyDeriveHardened1(benchmark::Bench& bench) { ExtKeyDerivePath(bench, 1, true); }
+static void ExtKeyDeriveHardened5(benchmark::Bench& bench) { ExtKeyDerivePath(bench, 5, true); }
+static void ExtKeyDerivePub1(benchmark::Bench& bench) { ExtKeyDerivePubPath(bench, 1); }
+static void ExtKeyDerivePub5(benchmark::Bench& bench) { ExtKeyDerivePubPath(bench, 5); }
+
+/** Lookahead batch of a chain, see CStoredExtKey::DeriveKeys */
+static void ExtKeyDeriveLookahead(benchmark::Bench& bench, size_t num_threads)
+{
+    ECC_Start();
+
+    uint8_t seed[32];
+    GetRandBytes(seed);
+    CStoredExtKey sek;
+    sek.kp.SetSeed(seed, sizeof(seed));
+
+    const uint32_t num_keys = 100;
+    bench.batch(num_keys).unit("key").run([&] {
+        std::vector<std::pair<uint32_t, CPubKey> > derived;
+        int rv = sek.DeriveKeys(derived, 0, num_keys, num_threads);
+        assert(rv == 0 && derived.size() == num_keys);
+    });
+
+    ECC_Stop();
+}
+
+static void ExtKeyDeriveLookahead100(benchmark::Bench& bench) { ExtKeyDeriveLookahead(bench, 1); }
+static void ExtKeyDeriveLookahead100Threaded(benchmark::Bench& bench) { ExtKeyDeriveLookahead(bench, 0); }
+
+static void MnemonicEncode(benchmark::Bench& bench)
+{
+    std::vector<uint8_t> entropy(32);
+    GetRandBytes(entropy);
+
+    bench.run([&] {
+        std::string words, error;
+        int rv = mnemonic::Encode(mnemonic::WLL_ENGLISH, entropy, words, error);
+        assert(rv == 0);
+    });
+}
+
+static void MnemonicToSeed(benchmark::Bench& bench)
+{
+    std::vector<uint8_t> entropy(32);
+    GetRandBytes(entropy);
+    std::string words, error;
+    assert(0 == mnemonic::Encode(mnemonic::WLL_ENGLISH, entropy, words, error));
+
+    bench.run([&] {
+        std::vector<uint8_t> seed;
+        int rv = mnemonic::ToSeed(words, "", seed);
+        assert(rv == 0);
+    });
+}
+
+BENCHMARK(StealthSecretSend);
+BENCHMARK(StealthSecretSpendKey);
+BENCHMARK(StealthPrepareOutput);
+BENCHMARK(StealthScan1);
+BENCHMARK(StealthScan10);
+BENCHMARK(StealthScan100);
+BENCHMARK(StealthScanner1);
+BENCHMARK(StealthScanner10);
+BENCHMARK(StealthScanner100);
+BENCHMARK(ExtKeyDerive1);
+BENCHMARK(ExtKeyDerive5);
+BENCHMARK(ExtKeyDeriveHardened1);
+BENCHMARK(ExtKeyDeriveHardened5);
+BENCHMARK(ExtKeyDerivePub1);
+BENCHMARK(ExtKeyDerivePub5);
+BENCHMARK(ExtKeyDeriveLookahead100);
+BENCHMARK(ExtKeyDeriveLookahead100Threaded);
+BENCHMARK(MnemonicEncode);
+BENCHMARK(MnemonicToSeed);
@@ -0,0 +1,172 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/test/hdwallet_test_fixture.h>
+#include <bench/bench.h>
+#include <wallet/hdwallet.h>
+#include <interfaces/chain.h>
+#include <interfaces/wallet.h>
+
+#include <blind.h>
+#include <consensus/validation.h>
+#include <validation.h>
+#include <rpc/rpcutil.h>
+#include <timedata.h>
+#include <node/miner.h>
+#include <pos/kernel.h>
+#include <pos/miner.h>
+#include <util/string.h>
+#include <util/time.h>
+#include <util/translation.h>
+
+/** Outputs per funding txn */
+static const size_t FUNDING_OUTPUTS_PER_TXN = 100;
+
+static std::shared_ptr<CHDWallet> CreateStakeWallet(wallet::WalletContext& wallet_context, std::string wallet_name)
+{
+    DatabaseOptions options;
+    DatabaseStatus status;
+    bilingual_str error;
+    std::vector<bilingual_str> warnings;
+    options.create_flags = WALLET_FLAG_BLANK_WALLET;
+    auto database = MakeWalletDatabase(wallet_name, options, status, error);
+    auto wallet = CWallet::Create(wallet_context, wallet_name, std::move(database), options.create_flags, error, warnings);
+
+    return std::static_pointer_cast<CHDWallet>(wallet);
+}
+
+/** Attempt to stake the next block at mock_time, returns true if a block was accepted */
+static bool TryStakeBlock(CHDWallet *pwallet, ChainstateManager &chainman, int64_t mock_time, CBlock *block_out = nullptr)
+{
+    SetMockTime(mock_time);
+    int nBestHeight = WITH_LOCK(cs_main, return chainman.ActiveChain().Height());
+    int64_t nSearchTime = GetAdjustedTime() & ~Params().GetStakeTimestampMask(nBestHeight + 1);
+
+    std::unique_ptr<node::CBlockTemplate> pblocktemplate = pwallet->CreateNewBlock();
+    assert(pblocktemplate.get());
+    if (!pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime)) {
+        return false;
+    }
+    if (block_out) {
+        *block_out = pblocktemplate->block;
+        return true;
+    }
+    bool accepted = CheckStake(chainman, &pblocktemplate->block);
+    SyncWithValidationInterfaceQueue();
+    return accepted;
+}
+
+static void StakeBlocks(CHDWallet *pwallet, ChainstateManager &chainman, int64_t &mock_time, size_t num_blocks)
+{
+    size_t num_staked = 0;
+    for (size_t k = 0; k < 10000 && num_staked < num_blocks; ++k) {
+        num_staked += TryStakeBlock(pwallet, chainman, ++mock_time);
+    }
+    assert(num_staked == num_blocks);
+}
+
+static void FundOutputs(const std::any &context, const std::string &address_or_script, bool is_script, size_t num_outputs)
+{
+    for (size_t i = 0; i < num_outputs; i += FUNDING_OUTPUTS_PER_TXN) {
+        std::string outputs;
+        for (size_t k = i; k < std::min(num_outputs, i + FUNDING_OUTPUTS_PER_TXN); ++k) {
+            if (!outputs.empty()) {
+                outputs += ",";
+            }
+            outputs += is_script ? strprintf("{\"address\":\"script\",\"amount\":10,\"script\":\"%s\"}", address_or_script)
+                                 : strprintf("{\"address\":\"%s\",\"amount\":10}", address_or_script);
+        }
+        CallRPC("sendtypeto part part [" + outputs + "]", context, "a");
+    }
+}
+
+/**
+ * Regtest chain with a wallet holding num_utxos stakeable outputs and num_delegations
+ * outputs cold staked to it. A block is only submitted after a kernel was found.
+ */
+static void ParticlStake(benchmark::Bench& bench, size_t num_utxos, size_t num_delegations, bool check_proof_only)
+{
+    TestingSetup test_setup{CBaseChainParams::REGTEST, {}, true};
+    const auto context = util::AnyPtr<node::NodeContext>(&test_setup.m_node);
+    ChainstateManager &chainman = *test_setup.m_node.chainman;
+
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(test_setup.m_node);
+    std::unique_ptr<interfaces::WalletLoader> wallet_loader = interfaces::MakeWalletLoader(*chain, *Assert(test_setup.m_node.args));
+    wallet_loader->registerRpcs();
+    WalletContext& wallet_context = *wallet_loader->context();
+
+    ECC_Start_Stealth();
+    ECC_Start_Blinding();
+
+    std::shared_ptr<CHDWallet> pwallet_a = CreateStakeWallet(wallet_context, "a");
+    assert(pwallet_a.get());
+    AddWallet(wallet_context, pwallet_a);
+    std::shared_ptr<CHDWallet> pwallet_b = CreateStakeWallet(wallet_context, "b");
+    assert(pwallet_b.get());
+    AddWallet(wallet_context, pwallet_b);
+    {
+        int last_height = chainman.ActiveChain().Height();
+        uint256 last_hash = chainman.ActiveChain().Tip()->GetBlockHash();
+        LOCK2(pwallet_a->cs_wallet, pwallet_b->cs_wallet);
+        pwallet_a->SetLastBlockProcessed(last_height, last_hash);
+        pwallet_b->SetLastBlockProcessed(last_height, last_hash);
+    }
+
+    CallRPC("extkeyimportmaster tprv8ZgxMBicQKsPeK5mCpvMsd1cwyT1JZsrBN82XkoYuZY1EVK7EwDaiL9sDfqUU5SntTfbRfnRedFWjg5xkDG5i3iwd3yP7neX5F2dtdCojk4", context, "a");
+    CallRPC("extkeyimportmaster \"expect trouble pause odor utility palace ignore arena disorder frog helmet addict\"", context, "b");
+
+    int64_t mock_time = WITH_LOCK(cs_main, return chainman.ActiveChain().Tip()->nTime);
+    StakeBlocks(pwallet_a.get(), chainman, mock_time, 1);
+
+    std::string addr_utxos = part::StripQuotes(CallRPC("getnewaddress", context, "a").write());
+    FundOutputs(context, addr_utxos, false, num_utxos);
+    if (num_delegations > 0) {
+        std::string addr_stake = part::StripQuotes(CallRPC("getnewaddress", context, "a").write());
+        std::string addr_spend = part::StripQuotes(CallRPC("getnewaddress \"\" false false true", context, "b").write());
+        UniValue script = CallRPC(strprintf("buildscript {\"recipe\":\"ifcoinstake\",\"addrstake\":\"%s\",\"addrspend\":\"%s\"}", addr_stake, addr_spend), context, "a");
+        FundOutputs(context, script["hex"].get_str(), true, num_delegations);
+    }
+    SyncWithValidationInterfaceQueue();
+
+    // Mine the funding txns and let them mature
+    StakeBlocks(pwallet_a.get(), chainman, mock_time, Params().GetStakeMinConfirmations() + 1);
+
+    if (check_proof_only) {
+        CBlock block;
+        for (size_t k = 0; k < 10000 && !TryStakeBlock(pwallet_a.get(), chainman, ++mock_time, &block); ++k) {
+        }
+        assert(block.IsProofOfStake());
+        bench.run([&] {
+            LOCK(cs_main);
+            BlockValidationState state;
+            uint256 hash_proof, hash_target;
+            bool rv = CheckProofOfStake(chainman.ActiveChainstate(), state, chainman.ActiveChain().Tip(), *block.vtx[0], block.nTime, block.nBits, hash_proof, hash_target);
+            assert(rv);
+        });
+    } else {
+        // CreateNewBlock, CreateCoinStake and SignBlock for every slot, CheckStake when a kernel was found
+        bench.run([&] {
+            TryStakeBlock(pwallet_a.get(), chainman, ++mock_time);
+        });
+    }
+
+    RemoveWallet(wallet_context, pwallet_a, std::nullopt);
+    pwallet_a.reset();
+    RemoveWallet(wallet_context, pwallet_b, std::nullopt);
+    pwallet_b.reset();
+    SetMockTime(0);
+
+    ECC_Stop_Stealth();
+    ECC_Stop_Blinding();
+}
+
+static void ParticlStake50(benchmark::Bench& bench) { ParticlStake(bench, 50, 0, false); }
+static void ParticlStake500(benchmark::Bench& bench) { ParticlStake(bench, 500, 0, false); }
+static void ParticlStake500Delegated250(benchmark::Bench& bench) { ParticlStake(bench, 500, 250, false); }
+static void ParticlCheckProofOfStake(benchmark::Bench& bench) { ParticlStake(bench, 50, 0, true); }
+
+BENCHMARK(ParticlStake50);
+BENCHMARK(ParticlStake500);
+BENCHMARK(ParticlStake500Delegated250);
+BENCHMARK(ParticlCheckProofOfStake);
@@ -0,0 +1,337 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/test/hdwallet_test_fixture.h>
+#include <bench/bench.h>
+#include <wallet/hdwallet.h>
+#include <wallet/hdwalletdb.h>
+#include <wallet/coincontrol.h>
+#include <interfaces/chain.h>
+#include <interfaces/wallet.h>
+
+#include <blind.h>
+#include <hash.h>
+#include <key_io.h>
+#include <validation.h>
+#include <rpc/rpcutil.h>
+#include <timedata.h>
+#include <node/miner.h>
+#include <pos/miner.h>
+#include <util/string.h>
+#include <util/time.h>
+#include <util/translation.h>
+
+/** Synthetic records per chain of spends, the last output of a chain is left unspent or sent away */
+static const size_t RECORDS_PER_CHAIN = 10;
+
+/** Real outputs of each type for the CreateTransaction benchmarks */
+static const size_t NUM_REAL_OUTPUTS = 10;
+
+enum class LargeWalletOp {
+    LOAD,
+    BALANCES,
+    FILTER_TRANSACTIONS,
+    AVAILABLE_ANON_COINS,
+    CREATE_PLAIN,
+    CREATE_BLIND,
+    CREATE_ANON,
+    RESCAN,
+};
+
+static std::shared_ptr<CHDWallet> OpenLargeWallet(wallet::WalletContext& wallet_context, const std::string &wallet_name)
+{
+    DatabaseOptions options;
+    DatabaseStatus status;
+    bilingual_str error;
+    std::vector<bilingual_str> warnings;
+    options.create_flags = WALLET_FLAG_BLANK_WALLET;
+    auto database = MakeWalletDatabase(wallet_name, options, status, error);
+    assert(database);
+    auto wallet = CWallet::Create(wallet_context, wallet_name, std::move(database), options.create_flags, error, warnings);
+    assert(wallet);
+    AddWallet(wallet_context, wallet);
+
+    return std::static_pointer_cast<CHDWallet>(wallet);
+}
+
+static void CloseLargeWallet(wallet::WalletContext& wallet_context, std::shared_ptr<CHDWallet> &&pwallet)
+{
+    SyncWithValidationInterfaceQueue();
+    RemoveWallet(wallet_context, pwallet, std::nullopt);
+    pwallet->m_chain_notifications_handler.reset();
+    UnloadWallet(std::move(pwallet));
+}
+
+static void StakeBlocks(CHDWallet *pwallet, ChainstateManager &chainman, int64_t &mock_time, size_t num_blocks)
+{
+    size_t num_staked = 0;
+    for (size_t k = 0; k < 10000 && num_staked < num_blocks; ++k) {
+        SetMockTime(++mock_time);
+        int nBestHeight = WITH_LOCK(cs_main, return chainman.ActiveChain().Height());
+        int64_t nSearchTime = GetAdjustedTime() & ~Params().GetStakeTimestampMask(nBestHeight + 1);
+
+        std::unique_ptr<node::CBlockTemplate> pblocktemplate = pwallet->CreateNewBlock();
+        assert(pblocktemplate.get());
+        if (pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime) &&
+            CheckStake(chainman, &pblocktemplate->block)) {
+            num_staked++;
+        }
+        SyncWithValidationInterfaceQueue();
+    }
+    assert(num_staked == num_blocks);
+}
+
+/**
+ * Write num_records records straight to the wallet db, cycling through plain, stealth, blind and anon.
+ * Each record spends the owned output of the previous record in its chain, so most records are history.
+ * If !leave_unspent the last record of each chain sends the coin away and no synthetic output is spendable.
+ */
+static void WriteSyntheticRecords(const std::any &context, CHDWallet *pwallet, size_t num_records, bool leave_unspent)
+{
+    const CScript script_owned = GetScriptForDestination(DecodeDestination(part::StripQuotes(CallRPC("getnewaddress", context, pwallet->GetName()).write())));
+    CKey key_external;
+    key_external.MakeNewKey(true);
+    const CScript script_external = GetScriptForDestination(PKHash(key_external.GetPubKey()));
+    CStealthAddress sx = std::get<CStealthAddress>(DecodeDestination(part::StripQuotes(CallRPC("getnewstealthaddress", context, pwallet->GetName()).write())));
+
+    LOCK(pwallet->cs_wallet);
+    CStealthAddressIndexed sxi;
+    sx.ToRaw(sxi.addrRaw);
+    uint32_t sx_id;
+    assert(pwallet->GetStealthKeyIndex(sxi, sx_id));
+
+    const uint256 block_hash = pwallet->GetLastBlockHash();
+    int64_t block_time;
+    assert(pwallet->chain().findBlock(block_hash, interfaces::FoundBlock().time(block_time)));
+
+    CHDWalletDB wdb(pwallet->GetDatabase());
+    assert(wdb.TxnBegin());
+    uint256 prev_txid;
+    for (size_t i = 0; i < num_records; ++i) {
+        size_t chain_pos = i % RECORDS_PER_CHAIN;
+        bool chain_end = chain_pos == RECORDS_PER_CHAIN - 1 || i == num_records - 1;
+        const uint8_t types[] = {OUTPUT_STANDARD, OUTPUT_STANDARD, OUTPUT_CT, OUTPUT_RINGCT};
+        size_t type_index = (i / RECORDS_PER_CHAIN) % 4;
+
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << std::string("synthetic") << (uint64_t)i;
+        const uint256 txid = ss.GetHash();
+
+        CTransactionRecord rtx;
+        rtx.blockHash = block_hash;
+        rtx.nIndex = 1 + i % 1000;
+        rtx.nBlockTime = block_time;
+        rtx.nTimeReceived = block_time;
+        if (chain_pos > 0) {
+            rtx.vin.emplace_back(prev_txid, 1);
+            rtx.nFee = 10000;
+            if (types[type_index] == OUTPUT_CT) {
+                rtx.nFlags |= ORF_BLIND_IN;
+            } else
+            if (types[type_index] == OUTPUT_RINGCT) {
+                rtx.nFlags |= ORF_ANON_IN;
+            }
+        }
+
+        COutputRecord r;
+        r.nType = types[type_index];
+        r.n = 1;
+        r.nValue = COIN;
+        if (chain_end && !leave_unspent && chain_pos > 0) {
+            r.nFlags = ORF_FROM;
+            r.scriptPubKey = script_external;
+        } else {
+            r.nFlags = ORF_OWNED;
+            r.scriptPubKey = script_owned;
+            if (type_index == 1) {
+                r.vPath.resize(5);
+                r.vPath[0] = ORA_STEALTH;
+                memcpy(&r.vPath[1], &sx_id, 4);
+            }
+        }
+        rtx.InsertOutput(r);
+        assert(wdb.WriteTxRecord(txid, rtx));
+        prev_txid = txid;
+    }
+    assert(wdb.TxnCommit());
+}
+
+static CTransactionRef CreateWalletTxn(CHDWallet *pwallet, const CTxDestination &dest, int type_in, int type_out)
+{
+    LOCK(pwallet->cs_wallet);
+
+    std::vector<CTempRecipient> vecSend;
+    std::string sError;
+    CTempRecipient r;
+    r.nType = type_out;
+    r.SetAmount(COIN / 2);
+    r.address = dest;
+    vecSend.push_back(r);
+
+    CTransactionRef tx_new;
+    CWalletTx wtx(tx_new, TxStateInactive{});
+    CTransactionRecord rtx;
+    CAmount nFee;
+    CCoinControl coinControl;
+    if (type_in == OUTPUT_STANDARD) {
+        assert(0 == pwallet->AddStandardInputs(wtx, rtx, vecSend, true, nFee, &coinControl, sError));
+    } else
+    if (type_in == OUTPUT_CT) {
+        assert(0 == pwallet->AddBlindedInputs(wtx, rtx, vecSend, true, nFee, &coinControl, sError));
+    } else {
+        assert(0 == pwallet->AddAnonInputs(wtx, rtx, vecSend, true, 5, 1, nFee, &coinControl, sError));
+    }
+    return wtx.tx;
+}
+
+/**
+ * Regtest wallet with num_records synthetic records next to a few real plain, blind and anon outputs.
+ * Synthetic records have no stored txns, they're left spent for the ops that could select them as inputs.
+ */
+static void ParticlLargeWallet(benchmark::Bench& bench, size_t num_records, LargeWalletOp op)
+{
+    TestingSetup test_setup{CBaseChainParams::REGTEST, {}, true};
+    const auto context = util::AnyPtr<node::NodeContext>(&test_setup.m_node);
+    ChainstateManager &chainman = *test_setup.m_node.chainman;
+
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(test_setup.m_node);
+    std::unique_ptr<interfaces::WalletLoader> wallet_loader = interfaces::MakeWalletLoader(*chain, *Assert(test_setup.m_node.args));
+    wallet_loader->registerRpcs();
+    WalletContext& wallet_context = *wallet_loader->context();
+
+    ECC_Start_Stealth();
+    ECC_Start_Blinding();
+
+    std::shared_ptr<CHDWallet> pwallet = OpenLargeWallet(wallet_context, "a");
+    {
+        int last_height = chainman.ActiveChain().Height();
+        uint256 last_hash = chainman.ActiveChain().Tip()->GetBlockHash();
+        LOCK(pwallet->cs_wallet);
+        pwallet->SetLastBlockProcessed(last_height, last_hash);
+    }
+    CallRPC("extkeyimportmaster tprv8ZgxMBicQKsPeK5mCpvMsd1cwyT1JZsrBN82XkoYuZY1EVK7EwDaiL9sDfqUU5SntTfbRfnRedFWjg5xkDG5i3iwd3yP7neX5F2dtdCojk4", context, "a");
+
+    int64_t mock_time = WITH_LOCK(cs_main, return chainman.ActiveChain().Tip()->nTime);
+    StakeBlocks(pwallet.get(), chainman, mock_time, 1);
+
+    std::string sx_real = part::StripQuotes(CallRPC("getnewstealthaddress", context, "a").write());
+    for (const auto &type_out : {"blind", "anon"}) {
+        std::string outputs;
+        for (size_t i = 0; i < NUM_REAL_OUTPUTS; ++i) {
+            outputs += strprintf("%s{\"address\":\"%s\",\"amount\":1}", outputs.empty() ? "" : ",", sx_real);
+        }
+        CallRPC(strprintf("sendtypeto part %s [%s]", type_out, outputs), context, "a");
+    }
+    SyncWithValidationInterfaceQueue();
+    StakeBlocks(pwallet.get(), chainman, mock_time, Params().GetConsensus().nMinRCTOutputDepth + 1);
+
+    bool leave_unspent = op == LargeWalletOp::LOAD || op == LargeWalletOp::BALANCES ||
+                         op == LargeWalletOp::FILTER_TRANSACTIONS || op == LargeWalletOp::AVAILABLE_ANON_COINS;
+    CTxDestination dest_plain = DecodeDestination(part::StripQuotes(CallRPC("getnewaddress", context, "a").write()));
+    CTxDestination dest_sx = DecodeDestination(sx_real);
+    WriteSyntheticRecords(context, pwallet.get(), num_records, leave_unspent);
+
+    // Reopen to read the records into memory
+    CloseLargeWallet(wallet_context, std::move(pwallet));
+    if (op == LargeWalletOp::LOAD) {
+        bench.run([&] {
+            pwallet = OpenLargeWallet(wallet_context, "a");
+            CloseLargeWallet(wallet_context, std::move(pwallet));
+        });
+    } else {
+        pwallet = OpenLargeWallet(wallet_context, "a");
+    }
+
+    switch (op) {
+        case LargeWalletOp::LOAD:
+            break;
+        case LargeWalletOp::BALANCES:
+            bench.run([&] {
+                // Drop the per txn caches, as after loading the wallet
+                WITH_LOCK(pwallet->cs_wallet, pwallet->ResetTxnCaches());
+                CHDWalletBalances bal;
+                assert(pwallet->GetBalances(bal));
+            });
+            break;
+        case LargeWalletOp::FILTER_TRANSACTIONS:
+            bench.run([&] {
+                CallRPC("filtertransactions {\"count\":100}", context, "a");
+            });
+            break;
+        case LargeWalletOp::AVAILABLE_ANON_COINS:
+            bench.run([&] {
+                LOCK(pwallet->cs_wallet);
+                std::vector<COutputR> vCoins;
+                pwallet->AvailableAnonCoins(vCoins);
+                assert(vCoins.size() >= NUM_REAL_OUTPUTS);
+            });
+            break;
+        case LargeWalletOp::CREATE_PLAIN:
+            bench.run([&] {
+                CreateWalletTxn(pwallet.get(), dest_plain, OUTPUT_STANDARD, OUTPUT_STANDARD);
+            });
+            break;
+        case LargeWalletOp::CREATE_BLIND:
+            bench.run([&] {
+                CreateWalletTxn(pwallet.get(), dest_sx, OUTPUT_CT, OUTPUT_CT);
+            });
+            break;
+        case LargeWalletOp::CREATE_ANON:
+            bench.run([&] {
+                CreateWalletTxn(pwallet.get(), dest_sx, OUTPUT_RINGCT, OUTPUT_RINGCT);
+            });
+            break;
+        case LargeWalletOp::RESCAN:
+            bench.run([&] {
+                CallRPC("rescanblockchain", context, "a");
+            });
+            break;
+    }
+
+    if (pwallet) {
+        CloseLargeWallet(wallet_context, std::move(pwallet));
+    }
+    SetMockTime(0);
+
+    ECC_Stop_Stealth();
+    ECC_Stop_Blinding();
+}
+
+static void ParticlLargeWalletLoad10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::LOAD); }
+static void ParticlLargeWalletLoad100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::LOAD); }
+static void ParticlLargeWalletLoad1M(benchmark::Bench& bench) { ParticlLargeWallet(bench, 1000000, LargeWalletOp::LOAD); }
+static void ParticlLargeWalletBalances10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::BALANCES); }
+static void ParticlLargeWalletBalances100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::BALANCES); }
+static void ParticlLargeWalletBalances1M(benchmark::Bench& bench) { ParticlLargeWallet(bench, 1000000, LargeWalletOp::BALANCES); }
+static void ParticlLargeWalletFilterTransactions10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::FILTER_TRANSACTIONS); }
+static void ParticlLargeWalletFilterTransactions100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::FILTER_TRANSACTIONS); }
+static void ParticlLargeWalletAvailableAnonCoins10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::AVAILABLE_ANON_COINS); }
+static void ParticlLargeWalletAvailableAnonCoins100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::AVAILABLE_ANON_COINS); }
+static void ParticlLargeWalletCreatePlain10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::CREATE_PLAIN); }
+static void ParticlLargeWalletCreatePlain100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::CREATE_PLAIN); }
+static void ParticlLargeWalletCreateBlind10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::CREATE_BLIND); }
+static void ParticlLargeWalletCreateBlind100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::CREATE_BLIND); }
+static void ParticlLargeWalletCreateAnon10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::CREATE_ANON); }
+static void ParticlLargeWalletCreateAnon100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::CREATE_ANON); }
+static void ParticlLargeWalletRescan10k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 10000, LargeWalletOp::RESCAN); }
+static void ParticlLargeWalletRescan100k(benchmark::Bench& bench) { ParticlLargeWallet(bench, 100000, LargeWalletOp::RESCAN); }
+
+BENCHMARK(ParticlLargeWalletLoad10k);
+BENCHMARK(ParticlLargeWalletLoad100k);
+BENCHMARK(ParticlLargeWalletLoad1M);
+BENCHMARK(ParticlLargeWalletBalances10k);
+BENCHMARK(ParticlLargeWalletBalances100k);
+BENCHMARK(ParticlLargeWalletBalances1M);
+BENCHMARK(ParticlLargeWalletFilterTransactions10k);
+BENCHMARK(ParticlLargeWalletFilterTransactions100k);
+BENCHMARK(ParticlLargeWalletAvailableAnonCoins10k);
+BENCHMARK(ParticlLargeWalletAvailableAnonCoins100k);
+BENCHMARK(ParticlLargeWalletCreatePlain10k);
+BENCHMARK(ParticlLargeWalletCreatePlain100k);
+BENCHMARK(ParticlLargeWalletCreateBlind10k);
+BENCHMARK(ParticlLargeWalletCreateBlind100k);
+BENCHMARK(ParticlLargeWalletCreateAnon10k);
+BENCHMARK(ParticlLargeWalletCreateAnon100k);
+BENCHMARK(ParticlLargeWalletRescan10k);
+BENCHMARK(ParticlLargeWalletRescan100k);
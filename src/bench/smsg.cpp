@@ -0,0 +1,221 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <key_io.h>
+#include <random.h>
+#include <smsg/smessage.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+
+static const std::string BENCH_MESSAGE(1024, 'a');
+
+/** Regtest node with secure messaging started and num_keys receiving keys in the smsg keystore */
+class SmsgBenchSetup
+{
+public:
+    TestingSetup test_setup{CBaseChainParams::REGTEST};
+    std::vector<CKeyID> local_keys;
+
+    explicit SmsgBenchSetup(size_t num_keys)
+    {
+        smsgModule.m_node = &test_setup.m_node;
+        std::vector<std::shared_ptr<wallet::CWallet>> vpwallets;
+        bool started = smsgModule.Start(nullptr, vpwallets, false);
+        assert(started);
+        for (size_t i = 0; i < num_keys; ++i) {
+            local_keys.push_back(AddKey());
+        }
+    }
+    ~SmsgBenchSetup()
+    {
+        smsgModule.Shutdown();
+    }
+
+    CKeyID AddKey()
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        int rv = smsgModule.ImportPrivkey(CBitcoinSecret(key), "");
+        assert(rv == smsg::SMSG_NO_ERROR);
+        return key.GetPubKey().GetID();
+    }
+
+    /** Encrypt a free message to address_to from the first local key, needs the wallet's AES */
+    void MakeMessage(smsg::SecureMessage &smsg, const CKeyID &address_to)
+    {
+        smsg.m_ttl = smsg::SMSG_SECONDS_IN_DAY;
+        int rv = smsgModule.Encrypt(smsg, local_keys[0], address_to, BENCH_MESSAGE);
+        assert(rv == smsg::SMSG_NO_ERROR);
+    }
+};
+
+/** Free message with a random payload and MAC, not addressed to any local key */
+static void MakeNotOwnedMessage(smsg::SecureMessage &smsg)
+{
+    FastRandomContext rng(true);
+    CKey key_r;
+    key_r.MakeNewKey(true);
+    memcpy(smsg.cpkR, key_r.GetPubKey().begin(), 33);
+    std::vector<unsigned char> random_bytes = rng.randbytes(sizeof(smsg.iv) + sizeof(smsg.mac) + BENCH_MESSAGE.size());
+    memcpy(smsg.iv, random_bytes.data(), sizeof(smsg.iv));
+    memcpy(smsg.mac, random_bytes.data() + sizeof(smsg.iv), sizeof(smsg.mac));
+    smsg.timestamp = GetTime();
+    smsg.m_ttl = smsg::SMSG_SECONDS_IN_DAY;
+    smsg.nPayload = BENCH_MESSAGE.size();
+    smsg.pPayload = new uint8_t[smsg.nPayload];
+    memcpy(smsg.pPayload, random_bytes.data() + sizeof(smsg.iv) + sizeof(smsg.mac), smsg.nPayload);
+}
+
+#ifdef ENABLE_WALLET
+static void SmsgEncrypt(benchmark::Bench& bench)
+{
+    SmsgBenchSetup setup(2);
+    bench.unit("message").run([&] {
+        smsg::SecureMessage smsg;
+        setup.MakeMessage(smsg, setup.local_keys[1]);
+    });
+}
+#endif
+
+static void SmsgDecrypt(benchmark::Bench& bench, bool owned)
+{
+    SmsgBenchSetup setup(2);
+    smsg::SecureMessage smsg;
+    CKeyID address = setup.local_keys[1];
+    if (owned) {
+        setup.MakeMessage(smsg, address);
+    } else {
+        MakeNotOwnedMessage(smsg);
+    }
+    bench.unit("message").run([&] {
+        smsg::MessageData msg;
+        int rv = smsgModule.Decrypt(false, address, smsg, msg);
+        assert((rv == smsg::SMSG_NO_ERROR) == owned);
+    });
+}
+
+static void SmsgScanMessage(benchmark::Bench& bench, size_t num_keys)
+{
+    SmsgBenchSetup setup(num_keys);
+    smsg::SecureMessage smsg;
+    MakeNotOwnedMessage(smsg);
+    std::vector<uint8_t> header(smsg::SMSG_HDR_LEN);
+    smsg.WriteHeader(header.data());
+
+    // Worst case, every key is tried
+    bench.unit("message").run([&] {
+        bool own_message;
+        smsgModule.ScanMessage(header.data(), smsg.pPayload, smsg.nPayload, false, own_message);
+        assert(!own_message);
+    });
+}
+
+static void SmsgSetHash(benchmark::Bench& bench)
+{
+    SmsgBenchSetup setup(2);
+    smsg::SecureMessage smsg;
+    MakeNotOwnedMessage(smsg);
+
+    bench.unit("message").run([&] {
+        memset(smsg.nonce, 0, 4);
+        int rv = smsgModule.SetHash(&smsg, smsg.pPayload, smsg.nPayload);
+        assert(rv == smsg::SMSG_NO_ERROR);
+    });
+}
+
+/** Store a copy of smsg with the token sample set from n, returns the token */
+static smsg::SecMsgToken StoreMessage(const smsg::SecureMessage &smsg, const std::vector<uint8_t> &header, std::vector<uint8_t> &payload, uint64_t n)
+{
+    memcpy(payload.data(), &n, 8);
+    LOCK(smsgModule.cs_smsg);
+    int rv = smsgModule.Store(header.data(), payload.data(), payload.size(), false);
+    assert(rv == smsg::SMSG_NO_ERROR);
+    return smsg::SecMsgToken(smsg.timestamp, payload.data(), payload.size(), 0, smsg.m_ttl);
+}
+
+static void SmsgStore(benchmark::Bench& bench)
+{
+    SmsgBenchSetup setup(2);
+    smsg::SecureMessage smsg;
+    MakeNotOwnedMessage(smsg);
+    std::vector<uint8_t> header(smsg::SMSG_HDR_LEN);
+    smsg.WriteHeader(header.data());
+    std::vector<uint8_t> payload(smsg.pPayload, smsg.pPayload + smsg.nPayload);
+
+    uint64_t n = 0;
+    bench.unit("message").run([&] {
+        StoreMessage(smsg, header, payload, ++n);
+    });
+}
+
+static void SmsgRetrieve(benchmark::Bench& bench)
+{
+    SmsgBenchSetup setup(2);
+    smsg::SecureMessage smsg;
+    MakeNotOwnedMessage(smsg);
+    std::vector<uint8_t> header(smsg::SMSG_HDR_LEN);
+    smsg.WriteHeader(header.data());
+    std::vector<uint8_t> payload(smsg.pPayload, smsg.pPayload + smsg.nPayload);
+
+    for (uint64_t n = 1; n <= 1000; ++n) {
+        StoreMessage(smsg, header, payload, n);
+    }
+    int64_t bucket_time = smsg.timestamp - (smsg.timestamp % smsg::SMSG_BUCKET_LEN);
+    std::vector<smsg::SecMsgToken> tokens;
+    {
+        LOCK(smsgModule.cs_smsg);
+        for (const auto &token : smsgModule.buckets[bucket_time].setTokens) {
+            tokens.push_back(token);
+        }
+    }
+    assert(tokens.size() == 1000);
+
+    FastRandomContext rng(true);
+    std::vector<uint8_t> data;
+    bench.unit("message").run([&] {
+        const auto &token = tokens[rng.randrange(tokens.size())];
+        LOCK(smsgModule.cs_smsg);
+        int rv = smsgModule.Retrieve(token, data);
+        assert(rv == smsg::SMSG_NO_ERROR);
+    });
+}
+
+static void SmsgBucketHash(benchmark::Bench& bench)
+{
+    FastRandomContext rng(true);
+    int64_t now = GetTime();
+    int64_t bucket_time = now - (now % smsg::SMSG_BUCKET_LEN);
+    smsg::SecMsgBucket bucket;
+    for (size_t i = 0; i < 1000; ++i) {
+        uint64_t sample = rng.rand64();
+        bucket.AddToken(smsg::SecMsgToken(bucket_time + rng.randrange(smsg::SMSG_BUCKET_LEN), (const uint8_t*)&sample, 8, 0, 86400), now);
+    }
+
+    // Recompute from all tokens, as after tokens expire
+    bench.unit("bucket").run([&] {
+        bucket.hashBucket(bucket_time);
+        ankerl::nanobench::doNotOptimizeAway(bucket.hash);
+    });
+}
+
+#ifdef ENABLE_WALLET
+static void SmsgDecryptOwned(benchmark::Bench& bench) { SmsgDecrypt(bench, true); }
+#endif
+static void SmsgDecryptNotOwned(benchmark::Bench& bench) { SmsgDecrypt(bench, false); }
+static void SmsgScanMessage1(benchmark::Bench& bench) { SmsgScanMessage(bench, 1); }
+static void SmsgScanMessage100(benchmark::Bench& bench) { SmsgScanMessage(bench, 100); }
+
+#ifdef ENABLE_WALLET
+BENCHMARK(SmsgEncrypt);
+BENCHMARK(SmsgDecryptOwned);
+#endif
+BENCHMARK(SmsgDecryptNotOwned);
+BENCHMARK(SmsgScanMessage1);
+BENCHMARK(SmsgScanMessage100);
+BENCHMARK(SmsgSetHash);
+BENCHMARK(SmsgStore);
+BENCHMARK(SmsgRetrieve);
+BENCHMARK(SmsgBucketHash);
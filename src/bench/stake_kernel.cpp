@@ -0,0 +1,61 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chain.h>
+#include <pos/kernel.h>
+#include <random.h>
+
+static const size_t NUM_KERNEL_CANDIDATES = 1000;
+static const size_t NUM_KERNEL_SLOTS = 32;
+
+static void SetupKernelCandidates(CBlockIndex &index_prev, std::vector<StakeKernelCandidate> &candidates, std::vector<int64_t> &times)
+{
+    FastRandomContext rng(true);
+    index_prev.nHeight = 100;
+    index_prev.bnStakeModifier = rng.rand256();
+    candidates.resize(NUM_KERNEL_CANDIDATES);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        candidates[i].prevout = COutPoint(rng.rand256(), i);
+        candidates[i].amount = COIN;
+        candidates[i].block_time = 1000;
+    }
+    for (size_t i = 0; i < NUM_KERNEL_SLOTS; ++i) {
+        times.push_back(2000 + i * 16);
+    }
+}
+
+static void StakeKernelHashScalar(benchmark::Bench& bench)
+{
+    CBlockIndex index_prev;
+    std::vector<StakeKernelCandidate> candidates;
+    std::vector<int64_t> times;
+    SetupKernelCandidates(index_prev, candidates, times);
+
+    uint256 hash_proof, target_proof;
+    bench.batch(candidates.size() * times.size()).unit("kernel").run([&] {
+        for (const auto &c : candidates) {
+            for (const auto t : times) {
+                CheckStakeKernelHash(&index_prev, 0x1a00ffff, c.block_time, c.amount, c.prevout, t, hash_proof, target_proof);
+            }
+        }
+    });
+}
+
+static void StakeKernelHashBatch(benchmark::Bench& bench)
+{
+    CBlockIndex index_prev;
+    std::vector<StakeKernelCandidate> candidates;
+    std::vector<int64_t> times;
+    SetupKernelCandidates(index_prev, candidates, times);
+
+    std::vector<int64_t> kernel_times;
+    bench.batch(candidates.size() * times.size()).unit("kernel").run([&] {
+        CheckKernelBatch(&index_prev, 0x1a00ffff, candidates, times, kernel_times);
+    });
+}
+
+BENCHMARK(StakeKernelHashScalar);
+BENCHMARK(StakeKernelHashBatch);
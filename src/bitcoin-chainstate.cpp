@@ -10,52 +10,267 @@
 //                 it may diverge from Bitcoin Core's coding style.
 //
 // It is part of the libbitcoinkernel project.
+//
+// Particl: With -replayblocksdir the blocks in the blk?????.dat files of another
+// datadir are imported into DATADIR and connected on top of its chainstate, the
+// time spent connecting is reported with the Particl specific validation work
+// collected by g_block_validation_stats. Run it on a copy of a datadir.
 
+#include <blind.h>
 #include <chainparams.h>
+#include <chainparamsbase.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <fs.h>
 #include <init/common.h>
 #include <node/blockstorage.h>
+#include <node/caches.h>
 #include <node/chainstate.h>
 #include <scheduler.h>
 #include <script/sigcache.h>
+#include <shutdown.h>
+#include <smsg/manager.h>
+#include <txdb.h>
+#include <util/strencodings.h>
 #include <util/system.h>
 #include <util/thread.h>
+#include <util/time.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <validationstats.h>
 
+#include <array>
 #include <filesystem>
 #include <functional>
+#include <iomanip>
 #include <iosfwd>
 
+static void SetupChainstateArgs(ArgsManager& argsman)
+{
+    SetupHelpOptions(argsman);
+    SetupChainParamsBaseOptions(argsman);
+    init::AddLoggingArgs(argsman);
+
+    argsman.AddArg("-addressindex", strprintf("Must match the address index state of DATADIR (default: %u)", particl::DEFAULT_ADDRESSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-spentindex", strprintf("Must match the spent index state of DATADIR (default: %u)", particl::DEFAULT_SPENTINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-balancesindex", strprintf("Must match the balances index state of DATADIR (default: %u)", particl::DEFAULT_BALANCESINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockrewardindex", strprintf("Must match the block reward index state of DATADIR (default: %u)", particl::DEFAULT_BLOCKREWARDINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d)", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
+        -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-rctcache=<n>", strprintf("Maximum number of anon outputs to keep in the in-memory lookup cache, 0 to disable (default: %u)", DEFAULT_RCTCACHE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-rctoutputfile", strprintf("Mirror anon outputs in a memory mapped flat file table to speed up ring member lookups (default: %u)", DEFAULT_RCTOUTPUTFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-skiprangeproofverify", "Skip verifying rangeproofs of the replayed blocks (default: false)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-replayblocksdir=<dir>", "Import the blocks from the blk?????.dat files in <dir> and connect them on top of the chainstate of DATADIR, instead of reading hex-encoded blocks on standard input", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-replayto=<n>", "Stop connecting blocks at height <n>, a few more blocks may be connected (default: 0 = connect all imported blocks)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+}
+
+/** Sums the stats of the connected blocks, called from the scheduler thread */
+class ReplayStatsCollector final : public CValidationInterface
+{
+public:
+    std::array<int64_t, BVS_MAX> m_totals{};
+    int m_num_blocks{0};
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override
+    {
+        auto stats = g_block_validation_stats.Find(pindex->GetBlockHash());
+        if (!stats) {
+            return;
+        }
+        m_num_blocks++;
+        for (size_t i = 0; i < BVS_MAX; ++i) {
+            m_totals[i] += stats->Get((BlockValidationStat)i);
+        }
+    }
+};
+
+static bool IsTimeStat(BlockValidationStat stat)
+{
+    std::string name = GetBlockValidationStatName(stat);
+    return name.size() > 3 && name.compare(name.size() - 3, 3, "_us") == 0;
+}
+
+/**
+ * Import the blocks from the blk files of blocks_dir and connect them.
+ * Blocks are only imported when their parent is known, the files are read
+ * again until a pass adds no blocks to pick up blocks stored out of order.
+ */
+static bool ReplayBlocks(ChainstateManager& chainman, const fs::path& blocks_dir, int replay_to)
+{
+    CChainState& chainstate = WITH_LOCK(::cs_main, return chainman.ActiveChainstate());
+    const CBlockIndex* start_tip = WITH_LOCK(::cs_main, return chainman.ActiveTip());
+    auto best_header_height = [&]() {
+        LOCK(::cs_main);
+        return chainman.m_best_header ? chainman.m_best_header->nHeight : -1;
+    };
+
+    int64_t import_start = GetTimeMicros();
+    fBusyImporting = true;
+    for (int pass = 0;; ++pass) {
+        size_t num_indexed = WITH_LOCK(::cs_main, return chainman.BlockIndex().size());
+        int num_files = 0;
+        for (;; ++num_files) {
+            if (replay_to > 0 && best_header_height() >= replay_to) {
+                break;
+            }
+            fs::path path = blocks_dir / fs::u8path(strprintf("blk%05u.dat", num_files));
+            FILE* file = fsbridge::fopen(path, "rb");
+            if (!file) {
+                break;
+            }
+            chainstate.LoadExternalBlockFile(file, nullptr, &chainman);
+            if (ShutdownRequested()) {
+                std::cerr << "Failed to import " << fs::PathToString(path) << std::endl;
+                fBusyImporting = false;
+                return false;
+            }
+        }
+        if (pass == 0 && num_files == 0 && !(replay_to > 0 && best_header_height() >= replay_to)) {
+            std::cerr << "No blk?????.dat files found in " << fs::PathToString(blocks_dir) << std::endl;
+            fBusyImporting = false;
+            return false;
+        }
+        if (WITH_LOCK(::cs_main, return chainman.BlockIndex().size()) == num_indexed ||
+            (replay_to > 0 && best_header_height() >= replay_to)) {
+            break;
+        }
+    }
+    int64_t import_us = GetTimeMicros() - import_start;
+
+    auto collector = std::make_shared<ReplayStatsCollector>();
+    RegisterSharedValidationInterface(collector);
+    if (replay_to > 0) {
+        gArgs.ForceSetArg("-stopatheight", ToString(replay_to));
+    }
+
+    int64_t connect_start = GetTimeMicros();
+    BlockValidationState state;
+    state.m_chainman = &chainman;
+    bool connected = chainstate.ActivateBestChain(state, nullptr);
+    int64_t connect_us = GetTimeMicros() - connect_start;
+    fBusyImporting = false;
+
+    SyncWithValidationInterfaceQueue();
+    UnregisterSharedValidationInterface(collector);
+    if (!connected) {
+        std::cerr << "Failed to connect best block (" << state.ToString() << ")" << std::endl;
+        return false;
+    }
+
+    const CBlockIndex* end_tip = WITH_LOCK(::cs_main, return chainman.ActiveTip());
+    int start_height = start_tip ? start_tip->nHeight : -1;
+    int num_blocks = end_tip->nHeight - start_height;
+    uint64_t num_txns = end_tip->nChainTx - (start_tip ? start_tip->nChainTx : 0);
+    double connect_s = connect_us * 0.000001;
+
+    std::cout << std::fixed << std::setprecision(2)
+        << "Replayed blocks " << start_height + 1 << " to " << end_tip->nHeight << std::endl
+        << "	" << "Import: " << import_us * 0.000001 << "s" << std::endl
+        << "	" << "Connect: " << connect_s << "s, " << num_blocks << " blocks, " << num_txns << " txns" << std::endl;
+    if (connect_s > 0.0) {
+        std::cout
+            << "	" << num_blocks / connect_s << " blocks/s, " << num_txns / connect_s << " txns/s" << std::endl;
+    }
+
+    if (collector->m_num_blocks < 1) {
+        return true;
+    }
+    const auto& totals = collector->m_totals;
+    int64_t connect_block_us = totals[BVS_CONNECT_BLOCK_US];
+    std::cout << "Per feature breakdown over " << collector->m_num_blocks << " blocks:" << std::endl;
+    for (size_t i = 0; i < BVS_MAX; ++i) {
+        BlockValidationStat stat = (BlockValidationStat)i;
+        std::cout << "	" << std::left << std::setw(22) << GetBlockValidationStatName(stat) << std::right;
+        if (IsTimeStat(stat)) {
+            std::cout << std::setw(12) << totals[i] * 0.001 << "ms";
+            if (stat != BVS_CONNECT_BLOCK_US && connect_block_us > 0) {
+                std::cout << std::setw(8) << totals[i] * 100.0 / connect_block_us << "%";
+            }
+        } else {
+            std::cout << std::setw(12) << totals[i]
+                << std::setw(10) << (double)totals[i] / collector->m_num_blocks << "/block";
+        }
+        std::cout << std::endl;
+    }
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
     // SETUP: Argument parsing and handling
-    if (argc != 2) {
+    SetupChainstateArgs(gArgs);
+    std::string error;
+    if (!gArgs.ParseParameters(argc, argv, error)) {
+        std::cerr << "Error parsing command line arguments: " << error << std::endl;
+        return 1;
+    }
+    const auto command = gArgs.GetCommand();
+    if (HelpRequested(gArgs) || !command || command->args.size() != 1) {
         std::cerr
-            << "Usage: " << argv[0] << " DATADIR" << std::endl
+            << "Usage: " << argv[0] << " [options] DATADIR" << std::endl
             << "Display DATADIR information, and process hex-encoded blocks on standard input." << std::endl
+            << "With -replayblocksdir, import and connect the blocks of another datadir and" << std::endl
+            << "print the throughput and the Particl specific validation work." << std::endl
             << std::endl
             << "IMPORTANT: THIS EXECUTABLE IS EXPERIMENTAL, FOR TESTING ONLY, AND EXPECTED TO" << std::endl
-            << "           BREAK IN FUTURE VERSIONS. DO NOT USE ON YOUR ACTUAL DATADIR." << std::endl;
+            << "           BREAK IN FUTURE VERSIONS. DO NOT USE ON YOUR ACTUAL DATADIR." << std::endl
+            << std::endl
+            << gArgs.GetHelpMessage();
         return 1;
     }
-    std::filesystem::path abs_datadir = std::filesystem::absolute(argv[1]);
+    std::filesystem::path abs_datadir = std::filesystem::absolute(command->args[0]);
     std::filesystem::create_directories(abs_datadir);
     gArgs.ForceSetArg("-datadir", abs_datadir.string());
+    const fs::path replay_blocks_dir = gArgs.GetPathArg("-replayblocksdir");
+    const int replay_to = gArgs.GetIntArg("-replayto", 0);
 
 
     // SETUP: Misc Globals
-    SelectParams(CBaseChainParams::MAIN);
+    try {
+        SelectParams(gArgs.GetChainName());
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
     const CChainParams& chainparams = Params();
 
-    init::SetGlobals(); // ECC_Start, etc.
+    if (!InitShutdownState()) {
+        std::cerr << "Failed to initialize the shutdown state." << std::endl;
+        return 1;
+    }
+    gArgs.SoftSetBoolArg("-printtoconsole", false);
+    init::SetLoggingOptions(gArgs);
+    init::SetLoggingCategories(gArgs);
+    if (!init::StartLogging(gArgs)) {
+        std::cerr << "Failed to open the debug log file." << std::endl;
+        return 1;
+    }
+
+    init::SetGlobals(); // ECC_Start, ECC_Start_Stealth, ECC_Start_Blinding, etc.
+    fSkipRangeproof = gArgs.GetBoolArg("-skiprangeproofverify", false);
 
     // Necessary for CheckInputScripts (eventually called by ProcessNewBlock),
     // which will try the script cache first and fall back to actually
     // performing the check with the signature cache.
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitRangeProofCache();
+
+    int script_threads = gArgs.GetIntArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+    if (script_threads <= 0) {
+        script_threads += GetNumCores();
+    }
+    script_threads = std::min(std::max(script_threads - 1, 0), MAX_SCRIPTCHECK_THREADS);
+    if (script_threads >= 1) {
+        g_parallel_script_checks = true;
+        StartScriptCheckWorkerThreads(script_threads);
+    }
+    if (!replay_blocks_dir.empty()) {
+        // Keep the stats until the scheduler thread has summed them, see LimitValidationInterfaceQueue
+        g_block_validation_stats.SetMaxBlocks(10000);
+    }
 
 
     // SETUP: Scheduling and Background Signals
@@ -76,19 +291,25 @@ int main(int argc, char* argv[])
     };
     ChainstateManager chainman{chainman_opts};
 
+    // ConnectBlock and the flushes call into the smsg module, funding txns
+    // are not tracked as smsg is not initialised.
+    std::unique_ptr<SmsgManager> smsgman = SmsgManager::make();
+    chainman.m_smsgman = smsgman.get();
+
+    const node::CacheSizes cache_sizes = node::CalculateCacheSizes(gArgs);
     auto rv = node::LoadChainstate(false,
                                    std::ref(chainman),
                                    nullptr,
                                    false,
                                    false,
-                                   2 << 20,
-                                   2 << 22,
-                                   (450 << 20) - (2 << 20) - (2 << 22),
+                                   cache_sizes.block_tree_db,
+                                   cache_sizes.coins_db,
+                                   cache_sizes.coins,
                                    false,
                                    false,
                                    []() { return false; });
     if (rv.has_value()) {
-        std::cerr << "Failed to load Chain state from your datadir." << std::endl;
+        std::cerr << "Failed to load Chain state from your datadir, the index options must match the datadir." << std::endl;
         goto epilogue;
     } else {
         auto maybe_verify_error = node::VerifyLoadedChainstate(std::ref(chainman),
@@ -125,6 +346,11 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (!replay_blocks_dir.empty()) {
+        ReplayBlocks(chainman, fs::absolute(replay_blocks_dir), replay_to);
+        goto epilogue;
+    }
+
     for (std::string line; std::getline(std::cin, line);) {
         if (line.empty()) {
             std::cerr << "Empty line found" << std::endl;
@@ -269,6 +495,7 @@ epilogue:
         }
     }
     GetMainSignals().UnregisterBackgroundSignalScheduler();
+    chainman.m_smsgman = nullptr;
 
     init::UnsetGlobals();
 }
@@ -53,6 +53,9 @@ static void SetupWalletToolArgs(ArgsManager& argsman)
 
     // Particl
     argsman.AddCommand("generatemnemonic", "Generate a new mnemonic: <language> <bytes_entropy>");
+    argsman.AddCommand("verify", "Check the consistency of the Particl wallet records, without loading the wallet");
+    argsman.AddCommand("reindex", "Rebuild the stealth and extkey indices of a Particl wallet");
+    argsman.AddCommand("compact", "Remove orphaned stored transactions and key packs from a Particl wallet, then rewrite the database file");
     argsman.AddArg("-btcmode", "", ArgsManager::ALLOW_ANY, OptionsCategory::HIDDEN);
 }
 
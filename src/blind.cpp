@@ -15,21 +15,141 @@
 #include <version.h>
 
 #include <common/bloom.h>
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <primitives/transaction.h>
+#include <uint256.h>
+#include <util/hasher.h>
+#include <util/time.h>
+#include <util/trace.h>
 #include <chain/ct_tainted.h>
 #include <chain/tx_blacklist.h>
 #include <chain/tx_whitelist.h>
-#include <set>
+#include <algorithm>
+#include <map>
+#include <shared_mutex>
 
 
 secp256k1_context *secp256k1_ctx_blind = nullptr;
 secp256k1_scratch_space *blind_scratch = nullptr;
 secp256k1_bulletproof_generators *blind_gens = nullptr;
+secp256k1_pedersen_precomp *blind_precomp_h = nullptr;
 
+// The filter lists are static, kept sorted to be searched without per node allocations
 static CBloomFilter ct_tainted_filter;
-static std::set<uint256> ct_whitelist;
-static std::set<int64_t> rct_whitelist;
-static std::set<int64_t> rct_blacklist;
-static std::set<int64_t> rct_whitelist2;
+static std::vector<uint256> ct_whitelist;
+static std::vector<int64_t> rct_whitelist;
+static std::vector<int64_t> rct_blacklist;
+static std::vector<int64_t> rct_whitelist2;
+
+template <typename T>
+static void LoadSortedList(std::vector<T> &list, const T *begin, const T *end)
+{
+    list.assign(begin, end);
+    if (!std::is_sorted(list.begin(), list.end())) {
+        std::sort(list.begin(), list.end());
+    }
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+    list.shrink_to_fit();
+}
+
+static bool SortedListContains(const std::vector<int64_t> &list, int64_t v)
+{
+    if (list.empty() || v < list.front() || v > list.back()) {
+        return false;
+    }
+    return std::binary_search(list.begin(), list.end(), v);
+}
+
+namespace {
+/**
+ * Valid rangeproof cache, proofs are verified once when accepted into the mempool and again when accepted into the block chain.
+ */
+class CRangeProofCache
+{
+private:
+    //! Entries are SHA256(nonce || 'R' || 31 zero bytes || proof type || commitment || rangeproof)
+    CSHA256 m_salted_hasher;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    std::shared_mutex cs_rangeproofcache;
+
+public:
+    CRangeProofCache()
+    {
+        uint256 nonce = GetRandHash();
+        static constexpr unsigned char PADDING_RANGEPROOF[32] = {'R'};
+        m_salted_hasher.Write(nonce.begin(), 32);
+        m_salted_hasher.Write(PADDING_RANGEPROOF, 32);
+    }
+
+    void ComputeEntry(uint256 &entry, const secp256k1_pedersen_commitment &commitment, const std::vector<uint8_t> &rangeproof, bool is_bulletproof) const
+    {
+        CSHA256 hasher = m_salted_hasher;
+        const uint8_t proof_type = is_bulletproof ? 1 : 0;
+        hasher.Write(&proof_type, 1).Write(commitment.data, 33).Write(rangeproof.data(), rangeproof.size()).Finalize(entry.begin());
+    }
+
+    void ComputeEntry(uint256 &entry, const secp256k1_pedersen_commitment *commitments, size_t n_commits, const std::vector<uint8_t> &rangeproof) const
+    {
+        CSHA256 hasher = m_salted_hasher;
+        const uint8_t proof_type = 2, n = n_commits;
+        hasher.Write(&proof_type, 1).Write(&n, 1);
+        for (size_t i = 0; i < n_commits; ++i) {
+            hasher.Write(commitments[i].data, 33);
+        }
+        hasher.Write(rangeproof.data(), rangeproof.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256 &entry, const bool erase)
+    {
+        std::shared_lock<std::shared_mutex> lock(cs_rangeproofcache);
+        return setValid.contains(entry, erase);
+    }
+
+    void Set(const uint256 &entry)
+    {
+        std::unique_lock<std::shared_mutex> lock(cs_rangeproofcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CRangeProofCache rangeProofCache;
+} // namespace
+
+void InitRangeProofCache()
+{
+    // If -maxrangeproofcachesize is set to zero, setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetIntArg("-maxrangeproofcachesize", DEFAULT_MAX_RANGEPROOF_CACHE_SIZE)), MAX_MAX_RANGEPROOF_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = rangeProofCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for rangeproof cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+void ComputeRangeProofCacheEntry(uint256 &entry, const secp256k1_pedersen_commitment &commitment, const std::vector<uint8_t> &rangeproof, bool is_bulletproof)
+{
+    rangeProofCache.ComputeEntry(entry, commitment, rangeproof, is_bulletproof);
+}
+
+void ComputeRangeProofCacheEntry(uint256 &entry, const secp256k1_pedersen_commitment *commitments, size_t n_commits, const std::vector<uint8_t> &rangeproof)
+{
+    rangeProofCache.ComputeEntry(entry, commitments, n_commits, rangeproof);
+}
+
+bool RangeProofCacheContains(const uint256 &entry, bool erase)
+{
+    return rangeProofCache.Get(entry, erase);
+}
+
+void RangeProofCacheInsert(const uint256 &entry)
+{
+    rangeProofCache.Set(entry);
+}
 
 static int CountLeadingZeros(uint64_t nValueIn)
 {
@@ -142,9 +262,156 @@ int GetRangeProofInfo(const std::vector<uint8_t> &vRangeproof, int &rexp, int &r
         &vRangeproof[0], vRangeproof.size()) == 1));
 }
 
+bool VerifyBulletproofBatch(const std::vector<CBulletproofBatchEntry> &batch, size_t &n_failed)
+{
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
+    // All proofs in a multi-proof call must be the same length
+    std::map<size_t, std::vector<size_t> > by_length;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        by_length[batch[i].proof_len].push_back(i);
+    }
+
+    // Use a private scratch space so batches can be verified concurrently
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(secp256k1_ctx_blind, 1024 * 1024);
+    assert(scratch);
+
+    bool rv = true;
+    std::vector<const uint8_t*> proofs;
+    std::vector<const secp256k1_pedersen_commitment*> commits;
+    std::vector<secp256k1_generator> value_gens(BULLETPROOF_BATCH_SIZE, secp256k1_generator_const_h);
+    for (const auto &group : by_length) {
+        const std::vector<size_t> &indices = group.second;
+        for (size_t ofs = 0; rv && ofs < indices.size(); ofs += BULLETPROOF_BATCH_SIZE) {
+            size_t n_proofs = std::min(BULLETPROOF_BATCH_SIZE, indices.size() - ofs);
+            proofs.clear();
+            commits.clear();
+            for (size_t k = ofs; k < ofs + n_proofs; ++k) {
+                proofs.push_back(batch[indices[k]].proof);
+                commits.push_back(batch[indices[k]].commitment);
+            }
+            if (1 == secp256k1_bulletproof_rangeproof_verify_multi(secp256k1_ctx_blind, scratch, blind_gens,
+                proofs.data(), n_proofs, group.first, nullptr, commits.data(), 1, 64, value_gens.data(), nullptr, nullptr)) {
+                continue;
+            }
+            // Find the invalid proof
+            for (size_t k = ofs; k < ofs + n_proofs; ++k) {
+                const CBulletproofBatchEntry &entry = batch[indices[k]];
+                if (1 != secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind, scratch, blind_gens,
+                    entry.proof, entry.proof_len, nullptr, entry.commitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0)) {
+                    n_failed = indices[k];
+                    rv = false;
+                    break;
+                }
+            }
+        }
+        if (!rv) {
+            break;
+        }
+    }
+
+    secp256k1_scratch_space_destroy(secp256k1_ctx_blind, scratch);
+
+    TRACE3(rct, verify_rangeproof_batch,
+        (uint64_t)batch.size(),
+        rv,
+        GetTimeMicros() - start_us);
+    return rv;
+}
+
+size_t GetBulletproofSize(size_t n_commits)
+{
+    // 64 + 128 + 1 bytes of rangeproof data, then the inner product proof over 64 * n_commits scalars with 4 ab scalars
+    size_t log = 0;
+    for (size_t n = 64 * n_commits / 2; n > 1; n >>= 1) {
+        log++;
+    }
+    return 64 + 128 + 1 + 32 * (1 + 2 * log + 4) + (2 * log + 7) / 8;
+}
+
+bool IsValidAggregateSize(size_t n)
+{
+    return n >= 2 && n <= MAX_AGGREGATE_RANGEPROOFS && (n & (n - 1)) == 0;
+}
+
+int GetAggregateAmountOffset(const std::vector<uint8_t> &vData)
+{
+    size_t o = 33;
+    if (vData.size() > o && vData[o] == DO_STEALTH_PREFIX) {
+        o += 5;
+    }
+    if (vData.size() < o + AGGREGATE_AMOUNT_SIZE || vData[o] != DO_AGG_AMOUNT) {
+        return -1;
+    }
+    return (int)o;
+}
+
+static void GetAggregateAmountMask(const uint256 &nonce, uint8_t *mask)
+{
+    static constexpr uint8_t tag_value[1] = {'V'}, tag_blind[1] = {'B'};
+    uint8_t hash[32];
+    CSHA256().Write(nonce.begin(), 32).Write(tag_value, 1).Finalize(hash);
+    memcpy(mask, hash, 8);
+    CSHA256().Write(nonce.begin(), 32).Write(tag_blind, 1).Finalize(mask + 8);
+}
+
+void PutAggregateAmount(const uint256 &nonce, uint64_t value, const uint8_t *blind, std::vector<uint8_t> &vData)
+{
+    uint8_t mask[40];
+    GetAggregateAmountMask(nonce, mask);
+
+    size_t o = vData.size();
+    vData.resize(o + AGGREGATE_AMOUNT_SIZE);
+    vData[o++] = DO_AGG_AMOUNT;
+    for (size_t k = 0; k < 8; ++k) {
+        vData[o++] = ((value >> (k * 8)) & 0xFF) ^ mask[k];
+    }
+    for (size_t k = 0; k < 32; ++k) {
+        vData[o++] = blind[k] ^ mask[8 + k];
+    }
+}
+
+bool GetAggregateAmount(const uint256 &nonce, const std::vector<uint8_t> &vData, uint64_t &value, uint8_t *blind)
+{
+    int o = GetAggregateAmountOffset(vData);
+    if (o < 0) {
+        return false;
+    }
+    o++;
+
+    uint8_t mask[40];
+    GetAggregateAmountMask(nonce, mask);
+
+    value = 0;
+    for (size_t k = 0; k < 8; ++k) {
+        value |= ((uint64_t)(vData[o + k] ^ mask[k])) << (k * 8);
+    }
+    for (size_t k = 0; k < 32; ++k) {
+        blind[k] = vData[o + 8 + k] ^ mask[8 + k];
+    }
+    return true;
+}
+
+int RewindBulletproofOutput(const std::vector<uint8_t> &vRangeproof, const std::vector<uint8_t> &vData,
+    const secp256k1_pedersen_commitment *commitment, const uint256 &nonce, uint64_t &value, uint8_t *blind)
+{
+    if (vRangeproof.empty() || GetAggregateAmountOffset(vData) >= 0) {
+        // Covered by an aggregated proof, check the stored amount opens the commitment
+        secp256k1_pedersen_commitment test_commitment;
+        if (!GetAggregateAmount(nonce, vData, value, blind) ||
+            !secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind, &test_commitment, blind, value, blind_precomp_h) ||
+            memcmp(test_commitment.data, commitment->data, 33) != 0) {
+            return 0;
+        }
+        return 1;
+    }
+    return secp256k1_bulletproof_rangeproof_rewind(secp256k1_ctx_blind, blind_gens,
+        &value, blind, vRangeproof.data(), vRangeproof.size(),
+        0, commitment, &secp256k1_generator_const_h, nonce.begin(), nullptr, 0);
+}
+
 void LoadRCTBlacklist(const int64_t indices[], size_t num_indices)
 {
-    rct_blacklist = std::set<int64_t>(indices, indices + num_indices);
+    LoadSortedList(rct_blacklist, indices, indices + num_indices);
     LogPrintf("RCT blacklist size %d\n", rct_blacklist.size());
 }
 
@@ -152,11 +419,11 @@ void LoadRCTWhitelist(const int64_t indices[], size_t num_indices, int list_id)
 {
     switch (list_id) {
         case 1:
-            rct_whitelist = std::set<int64_t>(indices, indices + num_indices);
+            LoadSortedList(rct_whitelist, indices, indices + num_indices);
             LogPrintf("RCT whitelist size %d\n", rct_whitelist.size());
             break;
         case 2:
-            rct_whitelist2 = std::set<int64_t>(indices, indices + num_indices);
+            LoadSortedList(rct_whitelist2, indices, indices + num_indices);
             LogPrintf("RCT whitelist2 size %d\n", rct_whitelist2.size());
             break;
         default:
@@ -169,10 +436,12 @@ void LoadCTWhitelist(const unsigned char *data, size_t data_length)
 {
     assert(data_length % 32 == 0);
 
-    ct_whitelist.clear();
+    std::vector<uint256> txids;
+    txids.reserve(data_length / 32);
     for (size_t i = 0; i < data_length; i += 32) {
-        ct_whitelist.insert(uint256(&data[i], 32));
+        txids.emplace_back(&data[i], 32);
     }
+    LoadSortedList(ct_whitelist, txids.data(), txids.data() + txids.size());
     LogPrintf("CT whitelist size %d\n", ct_whitelist.size());
 }
 
@@ -194,23 +463,23 @@ void LoadBlindedOutputFilters()
 bool IsFrozenBlindOutput(const uint256 &txid)
 {
     if (ct_tainted_filter.contains(txid)) {
-        return !ct_whitelist.count(txid);
+        return !std::binary_search(ct_whitelist.begin(), ct_whitelist.end(), txid);
     }
     return false;
 }
 
 bool IsBlacklistedAnonOutput(int64_t anon_index)
 {
-    return rct_blacklist.count(anon_index);
+    return SortedListContains(rct_blacklist, anon_index);
 }
 
 bool IsWhitelistedAnonOutput(int64_t anon_index, int64_t time, const Consensus::Params &consensus_params)
 {
     if (time >= consensus_params.exploit_fix_3_time &&
-        rct_whitelist2.count(anon_index)) {
+        SortedListContains(rct_whitelist2, anon_index)) {
         return true;
     }
-    return rct_whitelist.count(anon_index);
+    return SortedListContains(rct_whitelist, anon_index);
 }
 
 void ECC_Start_Blinding()
@@ -232,12 +501,16 @@ void ECC_Start_Blinding()
 
     blind_scratch = secp256k1_scratch_space_create(secp256k1_ctx_blind, 1024 * 1024);
     assert(blind_scratch);
-    blind_gens = secp256k1_bulletproof_generators_create(secp256k1_ctx_blind, &secp256k1_generator_const_g, 128);
+    blind_gens = secp256k1_bulletproof_generators_create(secp256k1_ctx_blind, &secp256k1_generator_const_g, 2 * 64 * MAX_AGGREGATE_RANGEPROOFS);
     assert(blind_gens);
+    blind_precomp_h = secp256k1_pedersen_precomp_create(secp256k1_ctx_blind, &secp256k1_generator_const_h);
+    assert(blind_precomp_h);
 }
 
 void ECC_Stop_Blinding()
 {
+    secp256k1_pedersen_precomp_destroy(secp256k1_ctx_blind, blind_precomp_h);
+    blind_precomp_h = nullptr;
     secp256k1_bulletproof_generators_destroy(secp256k1_ctx_blind, blind_gens);
     secp256k1_scratch_space_destroy(secp256k1_ctx_blind, blind_scratch);
 
@@ -15,14 +15,65 @@
 
 class uint256;
 
+// Rangeproof cache size in MiB
+static const unsigned int DEFAULT_MAX_RANGEPROOF_CACHE_SIZE = 16;
+// Maximum rangeproof cache size allowed
+static const int64_t MAX_MAX_RANGEPROOF_CACHE_SIZE = 16384;
+
 extern secp256k1_context *secp256k1_ctx_blind;
 extern secp256k1_scratch_space *blind_scratch;
 extern secp256k1_bulletproof_generators *blind_gens;
+/** Multiples of secp256k1_generator_const_h for secp256k1_pedersen_commit_precomp */
+extern secp256k1_pedersen_precomp *blind_precomp_h;
 
 int SelectRangeProofParameters(uint64_t nValueIn, uint64_t &minValue, int &exponent, int &nBits);
 
 int GetRangeProofInfo(const std::vector<uint8_t> &vRangeproof, int &rexp, int &rmantissa, CAmount &min_value, CAmount &max_value);
 
+/** Bulletproof rangeproof collected for batch verification, points into the owning output. */
+struct CBulletproofBatchEntry
+{
+    const uint8_t *proof;
+    size_t proof_len;
+    const secp256k1_pedersen_commitment *commitment;
+    bool is_anon;
+};
+
+/** Max number of proofs passed to one secp256k1_bulletproof_rangeproof_verify_multi call. */
+static constexpr size_t BULLETPROOF_BATCH_SIZE = 64;
+
+/** Max number of consecutive blinded outputs covered by one aggregated bulletproof, a power of two. */
+static constexpr size_t MAX_AGGREGATE_RANGEPROOFS = 16;
+/** Outputs covered by an aggregated bulletproof store their value and blinding factor in vData: DO_AGG_AMOUNT, 8 + 32 bytes */
+static constexpr size_t AGGREGATE_AMOUNT_SIZE = 1 + 8 + 32;
+
+/** Serialised length of a bulletproof over n_commits 64 bit ranges */
+size_t GetBulletproofSize(size_t n_commits);
+/** True if n outputs may share an aggregated bulletproof */
+bool IsValidAggregateSize(size_t n);
+/** Offset of the DO_AGG_AMOUNT record in vData, after the ephemeral pubkey and stealth prefix, or -1 */
+int GetAggregateAmountOffset(const std::vector<uint8_t> &vData);
+/** Append the value and blinding factor of an aggregated output to vData, masked with keys derived from nonce */
+void PutAggregateAmount(const uint256 &nonce, uint64_t value, const uint8_t *blind, std::vector<uint8_t> &vData);
+/** Recover the value and blinding factor of an aggregated output, false if vData has no DO_AGG_AMOUNT record */
+bool GetAggregateAmount(const uint256 &nonce, const std::vector<uint8_t> &vData, uint64_t &value, uint8_t *blind);
+/** Recover the value and blinding factor of a bulletproof output, returns 1 on success as secp256k1_bulletproof_rangeproof_rewind */
+int RewindBulletproofOutput(const std::vector<uint8_t> &vRangeproof, const std::vector<uint8_t> &vData,
+    const secp256k1_pedersen_commitment *commitment, const uint256 &nonce, uint64_t &value, uint8_t *blind);
+
+/**
+ * Verify all proofs in batch with chunked multi-proof calls.
+ * If a chunk fails its proofs are checked one by one and the index of the first invalid proof is returned in n_failed.
+ */
+bool VerifyBulletproofBatch(const std::vector<CBulletproofBatchEntry> &batch, size_t &n_failed);
+
+/** Initialise the valid rangeproof cache, to avoid verifying proofs again when a block containing mempool txns is connected. */
+void InitRangeProofCache();
+void ComputeRangeProofCacheEntry(uint256 &entry, const secp256k1_pedersen_commitment &commitment, const std::vector<uint8_t> &rangeproof, bool is_bulletproof);
+void ComputeRangeProofCacheEntry(uint256 &entry, const secp256k1_pedersen_commitment *commitments, size_t n_commits, const std::vector<uint8_t> &rangeproof);
+bool RangeProofCacheContains(const uint256 &entry, bool erase);
+void RangeProofCacheInsert(const uint256 &entry);
+
 void LoadRCTBlacklist(const int64_t indices[], size_t num_indices);
 void LoadRCTWhitelist(const int64_t indices[], size_t num_indices, int list_id);
 void LoadCTWhitelist(const unsigned char *data, size_t data_length);
@@ -14,18 +14,77 @@
 #include <validation.h>
 #include <util/system.h>
 
+#include <algorithm>
 #include <unordered_map>
 
+static Mutex g_compact_block_stats_mutex;
+static CompactBlockStats g_compact_block_stats GUARDED_BY(g_compact_block_stats_mutex);
+
+CompactBlockStats GetCompactBlockStats()
+{
+    LOCK(g_compact_block_stats_mutex);
+    return g_compact_block_stats;
+}
+
+bool IsBlindedTransaction(const CTransaction& tx)
+{
+    if (!tx.IsParticlVersion()) {
+        return false;
+    }
+    for (const auto& txin : tx.vin) {
+        if (txin.IsAnonInput()) {
+            return true;
+        }
+    }
+    for (const auto& txout : tx.vpout) {
+        if (txout->IsType(OUTPUT_CT) || txout->IsType(OUTPUT_RINGCT)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block) :
-        nonce(GetRand<uint64_t>()),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
+        CBlockHeaderAndShortTxIDs(block, nullptr, 0) {}
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, const std::function<int(const CTransaction&)>& prefill_tier, size_t max_prefill_size) :
+        nonce(GetRand<uint64_t>()), header(block) {
     vchBlockSig = block.vchBlockSig;
     FillShortTxIDSelector();
-    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
-    prefilledtxn[0] = {0, block.vtx[0]};
-    for (size_t i = 1; i < block.vtx.size(); i++) {
-        const CTransaction& tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(tx.GetWitnessHash());
+
+    // The coinbase or coinstake is always prefilled
+    std::vector<bool> prefill(block.vtx.size(), false);
+    prefill[0] = true;
+    if (prefill_tier && max_prefill_size > 0) {
+        std::vector<std::pair<int, size_t>> candidates;
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            int tier = prefill_tier(*block.vtx[i]);
+            if (tier >= 0) {
+                candidates.emplace_back(tier, i);
+            }
+        }
+        std::stable_sort(candidates.begin(), candidates.end(),
+            [](const std::pair<int, size_t>& a, const std::pair<int, size_t>& b) { return a.first < b.first; });
+        size_t prefill_size = 0;
+        for (const auto& candidate : candidates) {
+            size_t tx_size = block.vtx[candidate.second]->GetTotalSize();
+            if (prefill_size + tx_size > max_prefill_size) {
+                continue;
+            }
+            prefill_size += tx_size;
+            prefill[candidate.second] = true;
+        }
+    }
+
+    // Prefilled indices are differentially encoded
+    size_t last_prefilled = 0;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        if (prefill[i]) {
+            prefilledtxn.push_back({uint16_t(prefilledtxn.empty() ? i : i - last_prefilled - 1), block.vtx[i]});
+            last_prefilled = i;
+        } else {
+            shorttxids.push_back(GetShortID(block.vtx[i]->GetWitnessHash()));
+        }
     }
 }
 
@@ -210,6 +269,19 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
         return READ_STATUS_CHECKBLOCK_FAILED;
     }
 
+    {
+        LOCK(g_compact_block_stats_mutex);
+        g_compact_block_stats.blocks++;
+        g_compact_block_stats.txn += block.vtx.size();
+        g_compact_block_stats.txn_prefilled += prefilled_count;
+        if (!vtx_missing.empty()) {
+            g_compact_block_stats.blocks_requested_txn++;
+            g_compact_block_stats.txn_requested += vtx_missing.size();
+            g_compact_block_stats.blinded_txn_requested += std::count_if(vtx_missing.begin(), vtx_missing.end(),
+                [](const CTransactionRef& tx) { return IsBlindedTransaction(*tx); });
+        }
+    }
+
     LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size());
     if (vtx_missing.size() < 5) {
         for (const auto& tx : vtx_missing) {
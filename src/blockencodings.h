@@ -7,6 +7,8 @@
 
 #include <primitives/block.h>
 
+#include <functional>
+
 
 class CTxMemPool;
 
@@ -106,6 +108,11 @@ public:
     CBlockHeaderAndShortTxIDs() {}
 
     CBlockHeaderAndShortTxIDs(const CBlock& block);
+    /**
+     * Prefill the coinbase or coinstake and the transactions prefill_tier returns a tier >= 0 for,
+     * lower tiers first until max_prefill_size bytes of transactions are prefilled.
+     */
+    CBlockHeaderAndShortTxIDs(const CBlock& block, const std::function<int(const CTransaction&)>& prefill_tier, size_t max_prefill_size);
 
     uint64_t GetShortID(const uint256& txhash) const;
 
@@ -129,6 +136,20 @@ public:
     }
 };
 
+/** Reconstruction stats of received compact blocks */
+struct CompactBlockStats {
+    uint64_t blocks{0};
+    uint64_t blocks_requested_txn{0};
+    uint64_t txn{0};
+    uint64_t txn_prefilled{0};
+    uint64_t txn_requested{0};
+    uint64_t blinded_txn_requested{0};
+};
+CompactBlockStats GetCompactBlockStats();
+
+/** True for transactions with anon inputs or blinded outputs, likely missing at peers which were syncing when they were relayed */
+bool IsBlindedTransaction(const CTransaction& tx);
+
 class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
@@ -10,6 +10,7 @@
 #include <crypto/siphash.h>
 #include <hash.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <script/script.h>
 #include <streams.h>
 #include <util/golombrice.h>
@@ -22,6 +23,7 @@ static constexpr int GCS_SER_VERSION = 0;
 
 static const std::map<BlockFilterType, std::string> g_filter_types = {
     {BlockFilterType::BASIC, "basic"},
+    {BlockFilterType::PARTICL, "particl"},
 };
 
 uint64_t GCSFilter::HashToRange(const Element& element) const
@@ -218,6 +220,51 @@ static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
     return elements;
 }
 
+static void AddParticlScript(GCSFilter::ElementSet& elements, const CScript& script)
+{
+    elements.emplace(script.begin(), script.end());
+    // Let wallets match coldstake scripts by either of their keys
+    if (HasIsCoinstakeOp(script)) {
+        CScript path;
+        if (GetCoinstakeScriptPath(script, path)) {
+            elements.emplace(path.begin(), path.end());
+        }
+        if (GetNonCoinstakeScriptPath(script, path)) {
+            elements.emplace(path.begin(), path.end());
+        }
+    }
+}
+
+/** The basic elements extended with the scripts of standard and CT outputs in vpout */
+static GCSFilter::ElementSet ParticlFilterElements(const CBlock& block,
+                                                   const CBlockUndo& block_undo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CTransactionRef& tx : block.vtx) {
+        for (const CTxOut& txout : tx->vout) {
+            const CScript& script = txout.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN) continue;
+            AddParticlScript(elements, script);
+        }
+        for (const auto& txout : tx->vpout) {
+            const CScript* script = txout->GetPScriptPubKey();
+            if (!script || script->empty() || (*script)[0] == OP_RETURN) continue;
+            AddParticlScript(elements, *script);
+        }
+    }
+
+    for (const CTxUndo& tx_undo : block_undo.vtxundo) {
+        for (const Coin& prevout : tx_undo.vprevout) {
+            const CScript& script = prevout.out.scriptPubKey;
+            if (script.empty()) continue;
+            AddParticlScript(elements, script);
+        }
+    }
+
+    return elements;
+}
+
 BlockFilter::BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
                          std::vector<unsigned char> filter)
     : m_filter_type(filter_type), m_block_hash(block_hash)
@@ -236,13 +283,16 @@ BlockFilter::BlockFilter(BlockFilterType filter_type, const CBlock& block, const
     if (!BuildParams(params)) {
         throw std::invalid_argument("unknown filter_type");
     }
-    m_filter = GCSFilter(params, BasicFilterElements(block, block_undo));
+    m_filter = GCSFilter(params, m_filter_type == BlockFilterType::PARTICL ?
+                                 ParticlFilterElements(block, block_undo) :
+                                 BasicFilterElements(block, block_undo));
 }
 
 bool BlockFilter::BuildParams(GCSFilter::Params& params) const
 {
     switch (m_filter_type) {
     case BlockFilterType::BASIC:
+    case BlockFilterType::PARTICL:
         params.m_siphash_k0 = m_block_hash.GetUint64(0);
         params.m_siphash_k1 = m_block_hash.GetUint64(1);
         params.m_P = BASIC_FILTER_P;
@@ -88,6 +88,7 @@ constexpr uint32_t BASIC_FILTER_M = 784931;
 enum class BlockFilterType : uint8_t
 {
     BASIC = 0,
+    PARTICL = 100,  //!< Also commits to the scripts of vpout, not served to peers
     INVALID = 255,
 };
 
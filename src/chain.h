@@ -23,6 +23,8 @@ enum eBlockFlags
     BLOCK_DELAYED                   = (1 << 4),
     BLOCK_ACCEPTED                  = (1 << 5),
     BLOCK_STAKE_KERNEL_SPENT        = (1 << 6),
+
+    BLOCK_INDEX_COMPACT             = (1u << 31), // disk only: record is in the compact format
 };
 
 /**
@@ -205,7 +207,6 @@ public:
     // proof-of-stake specific fields
     unsigned int nFlags{0}; // pos: block index flags
     uint256 bnStakeModifier{}; // hash modifier for proof-of-stake
-    COutPoint prevoutStake{};
     //uint256 hashProof;
     CAmount nMoneySupply{0};
     int64_t nAnonOutputs{0}; // last index
@@ -429,11 +430,21 @@ public:
         if (obj.nStatus & BLOCK_HAVE_DATA) READWRITE(VARINT(obj.nDataPos));
         if (obj.nStatus & BLOCK_HAVE_UNDO) READWRITE(VARINT(obj.nUndoPos));
 
-        READWRITE(obj.nFlags);
+        // Compact records drop the stake kernel, it's read from the coinstake when needed,
+        // and store the supply and anon output counts as varints.
+        uint32_t disk_flags = obj.nFlags | BLOCK_INDEX_COMPACT;
+        READWRITE(disk_flags);
+        SER_READ(obj, obj.nFlags = disk_flags & ~(uint32_t)BLOCK_INDEX_COMPACT);
         READWRITE(obj.bnStakeModifier);
-        READWRITE(obj.prevoutStake);
-        READWRITE(obj.nMoneySupply);
-        READWRITE(obj.nAnonOutputs);
+        if (disk_flags & BLOCK_INDEX_COMPACT) {
+            READWRITE(VARINT_MODE(obj.nMoneySupply, VarIntMode::NONNEGATIVE_SIGNED));
+            READWRITE(VARINT_MODE(obj.nAnonOutputs, VarIntMode::NONNEGATIVE_SIGNED));
+        } else {
+            COutPoint prevout_stake;
+            READWRITE(prevout_stake);
+            READWRITE(obj.nMoneySupply);
+            READWRITE(obj.nAnonOutputs);
+        }
 
         // block header
         READWRITE(obj.nVersion);
@@ -1128,6 +1128,11 @@ void CRegTestParams::UpdateActivationParametersFromArgs(const ArgsManager& args)
 {
     MaybeUpdateHeights(args, consensus);
 
+    if (args.IsArgSet("-aggregatebulletprooftime")) {
+        consensus.aggregate_bulletproof_time = (uint32_t)args.GetIntArg("-aggregatebulletprooftime", consensus.aggregate_bulletproof_time);
+        LogPrintf("Setting aggregate_bulletproof_time to %u\n", consensus.aggregate_bulletproof_time);
+    }
+
     if (!args.IsArgSet("-vbparams")) return;
 
     for (const std::string& strDeployment : args.GetArgs("-vbparams")) {
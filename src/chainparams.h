@@ -50,6 +50,10 @@ struct AssumeutxoData {
     //! We need to hardcode the value here because this is computed cumulatively using block data,
     //! which we do not necessarily have at the time of snapshot load.
     const unsigned int nChainTx;
+
+    //! The expected hash of the Particl section following the coins, anon outputs, key images and spent cache.
+    //! Snapshots of chains in Particl mode are refused while this is null.
+    const uint256 hash_particl{};
 };
 
 using MapAssumeutxo = std::map<int, const AssumeutxoData>;
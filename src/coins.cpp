@@ -36,7 +36,22 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage + DynamicMemoryUsageRCT();
+}
+
+size_t CCoinsViewCache::DynamicMemoryUsageRCT() const {
+    size_t usage = memusage::DynamicUsage(anonOutputs) + memusage::DynamicUsage(spent_cache);
+    // Empty hash maps use their inline bucket, nothing is allocated
+    if (!anonOutputLinks.empty()) {
+        usage += memusage::DynamicUsage(anonOutputLinks);
+    }
+    if (!keyImages.empty()) {
+        usage += memusage::DynamicUsage(keyImages);
+    }
+    for (const auto &it : spent_cache) {
+        usage += it.second.coin.DynamicMemoryUsage();
+    }
+    return usage;
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
@@ -296,14 +296,14 @@ public:
     mutable bool fForceDisconnect = false; // Disconnect even if rct mismatch
     mutable int64_t nLastRCTOutput = 0;
     mutable std::vector<std::pair<int64_t, CAnonOutput> > anonOutputs;
-    mutable std::map<CCmpPubKey, int64_t> anonOutputLinks;
-    mutable std::map<CCmpPubKey, uint256> keyImages;
+    mutable std::unordered_map<CCmpPubKey, int64_t, SaltedCmpPubKeyHasher> anonOutputLinks;
+    mutable std::unordered_map<CCmpPubKey, uint256, SaltedCmpPubKeyHasher> keyImages;
     mutable std::vector<std::pair<COutPoint, SpentCoin> > spent_cache;
     mutable smsg::ChainSyncCache smsg_cache;
 
     bool ReadRCTOutputLink(CCmpPubKey &pk, int64_t &index)
     {
-        std::map<CCmpPubKey, int64_t>::iterator it = anonOutputLinks.find(pk);
+        auto it = anonOutputLinks.find(pk);
         if (it != anonOutputLinks.end()) {
             index = it->second;
             return true;
@@ -311,6 +311,9 @@ public:
         return false;
     };
 
+    //! Memory used by the RCT and spent coin data waiting to be flushed
+    size_t DynamicMemoryUsageRCT() const;
+
     void ClearFlushed()
     {
         // Clear data that would normally be flushed to disk, for VerifyDB
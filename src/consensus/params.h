@@ -119,6 +119,8 @@ struct Params {
     uint32_t exploit_fix_2_height = 0;
     /** Exploit fix 3 */
     uint32_t exploit_fix_3_time = 0xffffffff;
+    /** Time at which consecutive blinded outputs may share an aggregated bulletproof */
+    uint32_t aggregate_bulletproof_time = 0xffffffff;
     /** Last prefork anonoutput index */
     int64_t m_frozen_anon_index = 0;
     /** Last block height of prefork blinded txns */
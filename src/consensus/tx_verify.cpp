@@ -13,6 +13,8 @@
 #include <script/interpreter.h>
 #include <util/check.h>
 #include <util/moneystr.h>
+#include <util/time.h>
+#include <util/trace.h>
 
 
 #include <policy/policy.h>
@@ -25,6 +27,7 @@
 #include <consensus/params.h>
 #include <chainparams.h>
 #include <timedata.h>
+#include <validationstats.h>
 #include <util/system.h>
 
 
@@ -493,7 +496,7 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, TxValidationState& state,
         secp256k1_pedersen_commitment plainInCommitment, plainOutCommitment;
         uint8_t blindPlain[32] = {0};
         if (nValueIn > 0) {
-            if (!secp256k1_pedersen_commit(secp256k1_ctx_blind, &plainInCommitment, blindPlain, (uint64_t) nValueIn, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+            if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind, &plainInCommitment, blindPlain, (uint64_t) nValueIn, blind_precomp_h)) {
                 return state.Invalid(TxValidationResult::TX_CONSENSUS, "commit-failed");
             }
             vpCommitsIn.push_back(&plainInCommitment);
@@ -510,7 +513,7 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, TxValidationState& state,
                 }
                 memcpy(blindPlain, &vData[1 + nb + 1], 32);
             }
-            if (!secp256k1_pedersen_commit(secp256k1_ctx_blind, &plainOutCommitment, blindPlain, (uint64_t) nPlainValueOut, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+            if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind, &plainOutCommitment, blindPlain, (uint64_t) nPlainValueOut, blind_precomp_h)) {
                 return state.Invalid(TxValidationResult::TX_CONSENSUS, "commit-failed");
             }
             vpCommitsOut.push_back(&plainOutCommitment);
@@ -558,6 +561,34 @@ static bool CheckStandardOutput(TxValidationState &state, const CTxOutStandard *
     return true;
 }
 
+static int VerifyRangeProof(const TxValidationState &state, const std::vector<uint8_t> &proof, const secp256k1_pedersen_commitment &commitment, bool bulletproof, bool anon,
+    uint64_t &min_value, uint64_t &max_value)
+{
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
+    int rv;
+    if (bulletproof) {
+        rv = secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind,
+            state.m_scratch ? state.m_scratch : blind_scratch, blind_gens, proof.data(), proof.size(),
+            nullptr, &commitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0);
+    } else {
+        rv = secp256k1_rangeproof_verify(secp256k1_ctx_blind, &min_value, &max_value,
+            &commitment, proof.data(), proof.size(),
+            nullptr, 0,
+            secp256k1_generator_h);
+    }
+
+    TRACE5(rct, verify_rangeproof,
+        anon,
+        bulletproof,
+        (uint64_t)proof.size(),
+        rv == 1,
+        GetTimeMicros() - start_us);
+    if (state.m_validation_stats) {
+        state.m_validation_stats->AddTiming(BVS_RANGEPROOFS_VERIFIED, BVS_RANGEPROOF_US, start_us);
+    }
+    return rv;
+}
+
 static bool CheckBlindOutput(TxValidationState &state, const CTxOutCT *p)
 {
     if (p->vData.size() < 33 || p->vData.size() > 33 + 5 + 33) {
@@ -572,19 +603,21 @@ static bool CheckBlindOutput(TxValidationState &state, const CTxOutCT *p)
         return true;
     }
 
+    // Proofs are cached when accepted to the mempool and erased when checked in a block
+    uint256 cache_entry;
+    ComputeRangeProofCacheEntry(cache_entry, p->commitment, p->vRangeproof, state.fBulletproofsActive);
+    if (RangeProofCacheContains(cache_entry, state.m_in_block)) {
+        return true;
+    }
+
     uint64_t min_value = 0, max_value = 0;
     int rv = 0;
 
-    if (state.fBulletproofsActive) {
-        rv = secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind,
-            blind_scratch, blind_gens, p->vRangeproof.data(), p->vRangeproof.size(),
-            nullptr, &p->commitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0);
-    } else {
-        rv = secp256k1_rangeproof_verify(secp256k1_ctx_blind, &min_value, &max_value,
-            &p->commitment, p->vRangeproof.data(), p->vRangeproof.size(),
-            nullptr, 0,
-            secp256k1_generator_h);
+    if (state.fBulletproofsActive && state.m_bulletproof_batch) {
+        state.m_bulletproof_batch->push_back({p->vRangeproof.data(), p->vRangeproof.size(), &p->commitment, false});
+        return true;
     }
+    rv = VerifyRangeProof(state, p->vRangeproof, p->commitment, state.fBulletproofsActive, false, min_value, max_value);
 
     if (LogAcceptCategory(BCLog::RINGCT, BCLog::Level::Debug)) {
         LogPrintf("%s: rv, min_value, max_value %d, %s, %s\n", __func__,
@@ -594,6 +627,9 @@ static bool CheckBlindOutput(TxValidationState &state, const CTxOutCT *p)
     if (rv != 1) {
         return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-ctout-rangeproof-verify");
     }
+    if (!state.m_in_block) {
+        RangeProofCacheInsert(cache_entry);
+    }
 
     return true;
 }
@@ -616,19 +652,21 @@ bool CheckAnonOutput(TxValidationState &state, const CTxOutRingCT *p)
         return true;
     }
 
+    // Proofs are cached when accepted to the mempool and erased when checked in a block
+    uint256 cache_entry;
+    ComputeRangeProofCacheEntry(cache_entry, p->commitment, p->vRangeproof, state.fBulletproofsActive);
+    if (RangeProofCacheContains(cache_entry, state.m_in_block)) {
+        return true;
+    }
+
     uint64_t min_value = 0, max_value = 0;
     int rv = 0;
 
-    if (state.fBulletproofsActive) {
-        rv = secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind,
-            blind_scratch, blind_gens, p->vRangeproof.data(), p->vRangeproof.size(),
-            nullptr, &p->commitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0);
-    } else {
-        rv = secp256k1_rangeproof_verify(secp256k1_ctx_blind, &min_value, &max_value,
-            &p->commitment, p->vRangeproof.data(), p->vRangeproof.size(),
-            nullptr, 0,
-            secp256k1_generator_h);
+    if (state.fBulletproofsActive && state.m_bulletproof_batch) {
+        state.m_bulletproof_batch->push_back({p->vRangeproof.data(), p->vRangeproof.size(), &p->commitment, true});
+        return true;
     }
+    rv = VerifyRangeProof(state, p->vRangeproof, p->commitment, state.fBulletproofsActive, true, min_value, max_value);
 
     if (LogAcceptCategory(BCLog::RINGCT, BCLog::Level::Debug)) {
         LogPrintf("%s: rv, min_value, max_value %d, %s, %s\n", __func__,
@@ -638,6 +676,83 @@ bool CheckAnonOutput(TxValidationState &state, const CTxOutRingCT *p)
     if (rv != 1) {
         return state.Invalid(TxValidationResult::TX_CONSENSUS, "bad-rctout-rangeproof-verify");
     }
+    if (!state.m_in_block) {
+        RangeProofCacheInsert(cache_entry);
+    }
+
+    return true;
+}
+
+/** Number of outputs covered by the rangeproof of vpout[first], 1 unless consecutive outputs of the same type have no rangeproof */
+static size_t GetRangeProofGroupSize(const std::vector<CTxOutBaseRef> &vpout, size_t first)
+{
+    const std::vector<uint8_t> *pvRangeproof = vpout[first]->GetPRangeproof();
+    if (!pvRangeproof || pvRangeproof->empty()) {
+        return 1;
+    }
+    size_t n = 1;
+    for (size_t k = first + 1; k < vpout.size(); ++k) {
+        pvRangeproof = vpout[k]->GetPRangeproof();
+        if (vpout[k]->nVersion != vpout[first]->nVersion || !pvRangeproof || !pvRangeproof->empty()) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+static bool CheckAggregateOutputs(TxValidationState &state, const std::vector<CTxOutBaseRef> &vpout, size_t first, size_t n)
+{
+    bool is_anon = vpout[first]->nVersion == OUTPUT_RINGCT;
+    if (is_anon && !state.rct_active) {
+        return state.Invalid(TxValidationResult::TX_CONSENSUS, "rctout-before-active");
+    }
+    if (!state.m_aggregate_bulletproofs || !IsValidAggregateSize(n)) {
+        return state.Invalid(TxValidationResult::TX_CONSENSUS, is_anon ? "bad-rctout-aggregate" : "bad-ctout-aggregate");
+    }
+
+    std::vector<secp256k1_pedersen_commitment> commitments(n);
+    for (size_t k = 0; k < n; ++k) {
+        CTxOutBase *txout = vpout[first + k].get();
+        const std::vector<uint8_t> &vData = *txout->GetPData();
+        // Each output carries its own value and blinding factor as the aggregated proof can't be rewound
+        if (vData.size() < 33 + AGGREGATE_AMOUNT_SIZE || vData.size() > 33 + 5 + 33 + AGGREGATE_AMOUNT_SIZE ||
+            GetAggregateAmountOffset(vData) < 0) {
+            return state.Invalid(TxValidationResult::TX_CONSENSUS, is_anon ? "bad-rctout-ephem-size" : "bad-ctout-ephem-size");
+        }
+        commitments[k] = *txout->GetPCommitment();
+    }
+
+    const std::vector<uint8_t> &vRangeproof = *vpout[first]->GetPRangeproof();
+    if (vRangeproof.size() < 500 || vRangeproof.size() > 5134) {
+        return state.Invalid(TxValidationResult::TX_CONSENSUS, is_anon ? "bad-rctout-rangeproof-size" : "bad-ctout-rangeproof-size");
+    }
+
+    if (state.m_skip_rangeproof) {
+        return true;
+    }
+
+    uint256 cache_entry;
+    ComputeRangeProofCacheEntry(cache_entry, commitments.data(), n, vRangeproof);
+    if (RangeProofCacheContains(cache_entry, state.m_in_block)) {
+        return true;
+    }
+
+    // Aggregated proofs are verified directly, batches only hold single-commitment proofs
+    int rv = secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind,
+        state.m_scratch ? state.m_scratch : blind_scratch, blind_gens, vRangeproof.data(), vRangeproof.size(),
+        nullptr, commitments.data(), n, 64, &secp256k1_generator_const_h, nullptr, 0);
+
+    if (LogAcceptCategory(BCLog::RINGCT, BCLog::Level::Debug)) {
+        LogPrintf("%s: rv, n %d, %d\n", __func__, rv, n);
+    }
+
+    if (rv != 1) {
+        return state.Invalid(TxValidationResult::TX_CONSENSUS, is_anon ? "bad-rctout-rangeproof-verify" : "bad-ctout-rangeproof-verify");
+    }
+    if (!state.m_in_block) {
+        RangeProofCacheInsert(cache_entry);
+    }
 
     return true;
 }
@@ -678,7 +793,9 @@ bool CheckTransaction(const CTransaction& tx, TxValidationState &state)
 
         size_t nStandardOutputs = 0, nDataOutputs = 0, nBlindOutputs = 0, nAnonOutputs = 0;
         CAmount nValueOut = 0;
-        for (const auto &txout : tx.vpout) {
+        for (size_t k = 0; k < tx.vpout.size(); ++k) {
+            const auto &txout = tx.vpout[k];
+            size_t n_group = 1;
             switch (txout->nVersion) {
                 case OUTPUT_STANDARD:
                     if (!CheckStandardOutput(state, (CTxOutStandard*) txout.get(), nValueOut)) {
@@ -687,16 +804,30 @@ bool CheckTransaction(const CTransaction& tx, TxValidationState &state)
                     nStandardOutputs++;
                     break;
                 case OUTPUT_CT:
+                    n_group = GetRangeProofGroupSize(tx.vpout, k);
+                    if (n_group > 1) {
+                        if (!CheckAggregateOutputs(state, tx.vpout, k, n_group)) {
+                            return false;
+                        }
+                        k += n_group - 1;
+                    } else
                     if (!CheckBlindOutput(state, (CTxOutCT*) txout.get())) {
                         return false;
                     }
-                    nBlindOutputs++;
+                    nBlindOutputs += n_group;
                     break;
                 case OUTPUT_RINGCT:
+                    n_group = GetRangeProofGroupSize(tx.vpout, k);
+                    if (n_group > 1) {
+                        if (!CheckAggregateOutputs(state, tx.vpout, k, n_group)) {
+                            return false;
+                        }
+                        k += n_group - 1;
+                    } else
                     if (!CheckAnonOutput(state, (CTxOutRingCT*) txout.get())) {
                         return false;
                     }
-                    nAnonOutputs++;
+                    nAnonOutputs += n_group;
                     break;
                 case OUTPUT_DATA:
                     if (!CheckDataOutput(state, (CTxOutData*) txout.get())) {
@@ -17,6 +17,9 @@ class PeerManager;
 class ChainstateManager;
 class CChainState;
 class SmsgManager;
+struct CBulletproofBatchEntry;
+typedef struct secp256k1_scratch_space_struct secp256k1_scratch_space;
+class BlockValidationStats;
 
 /** Index marker for when no witness commitment is present in a coinbase transaction. */
 static constexpr int NO_WITNESS_COMMITMENT{-1};
@@ -163,9 +166,11 @@ public:
     bool fEnforceSmsgFees = false;
     bool fBulletproofsActive = false;
     bool rct_active = false;
+    bool m_aggregate_bulletproofs = false;
     int m_spend_height = 0;
     bool m_particl_mode = false;
     bool m_skip_rangeproof = false;
+    bool m_assume_valid = false; // Block is under -assumevalid, rangeproofs and MLSAG signatures aren't verified
     const Consensus::Params *m_consensus_params = nullptr;
     bool m_preserve_state = false; // Don't clear error during ActivateBestChain (debug)
 
@@ -181,8 +186,12 @@ public:
     bool m_in_block = false;
     bool m_check_equal_rct_txid = true;
     bool m_punish_for_duplicates = false;
+    int64_t m_missing_anon_index = 0; // Ring member index not yet in the chain, set for loose txns failing with TX_MISSING_INPUTS
     CAmount tx_balances[6] = {0};
     std::set<CCmpPubKey> m_setHaveKI;
+    std::vector<CBulletproofBatchEntry> *m_bulletproof_batch = nullptr; // Defer bulletproof checks to VerifyBulletproofBatch if set
+    BlockValidationStats *m_validation_stats = nullptr; // Set while validating a block with -blockvalidationstats
+    secp256k1_scratch_space *m_scratch = nullptr; // Bulletproofs are verified in blind_scratch if not set, which is guarded by cs_main
 
     void SetStateInfo(int64_t time, int spend_height, const Consensus::Params& consensusParams, bool particl_mode, bool skip_rangeproof, bool in_block=false)
     {
@@ -192,6 +201,7 @@ public:
         fEnforceSmsgFees = time >= consensusParams.nPaidSmsgTime;
         fBulletproofsActive = time >= consensusParams.bulletproof_time;
         rct_active = time >= consensusParams.rct_time;
+        m_aggregate_bulletproofs = fBulletproofsActive && time >= consensusParams.aggregate_bulletproof_time;
         if (spend_height > -1) {
             m_spend_height = spend_height; // Pass through connectblock->checkblock
         }
@@ -218,10 +228,12 @@ public:
         fEnforceSmsgFees = state_from.fEnforceSmsgFees;
         fBulletproofsActive = state_from.fBulletproofsActive;
         rct_active = state_from.rct_active;
+        m_aggregate_bulletproofs = state_from.m_aggregate_bulletproofs;
         m_spend_height = state_from.m_spend_height;
 
         m_particl_mode = state_from.m_particl_mode;
         m_skip_rangeproof = state_from.m_skip_rangeproof;
+        m_assume_valid = state_from.m_assume_valid;
 
         m_clamp_tx_version = state_from.m_clamp_tx_version;
         m_exploit_fix_1 = state_from.m_exploit_fix_1;
@@ -16,12 +16,14 @@
 #include <shutdown.h>
 #include <sync.h>
 #include <util/strencodings.h>
+#include <util/string.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
 #include <util/threadnames.h>
 #include <util/translation.h>
 
 #include <deque>
+#include <map>
 #include <memory>
 #include <optional>
 #include <stdio.h>
@@ -42,6 +44,8 @@
 
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
+/** Bytes of the request body searched for the JSON-RPC method when selecting a -rpcworkclass */
+static const size_t MAX_WORK_CLASS_PEEK_SIZE = 512;
 
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
@@ -63,6 +67,20 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item running a function queued with QueueHTTPWork */
+class HTTPFunctionItem final : public HTTPClosure
+{
+public:
+    explicit HTTPFunctionItem(std::function<void()> _func) : func(std::move(_func)) {}
+    void operator()() override
+    {
+        func();
+    }
+
+private:
+    std::function<void()> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -72,13 +90,17 @@ class WorkQueue
 private:
     Mutex cs;
     std::condition_variable cond GUARDED_BY(cs);
-    std::deque<std::unique_ptr<WorkItem>> queue GUARDED_BY(cs);
+    //! Work items and the time they were queued
+    std::deque<std::pair<std::unique_ptr<WorkItem>, int64_t>> queue GUARDED_BY(cs);
     bool running GUARDED_BY(cs){true};
     const size_t maxDepth;
+    HTTPWorkQueueStats stats GUARDED_BY(cs);
 
 public:
-    explicit WorkQueue(size_t _maxDepth) : maxDepth(_maxDepth)
+    WorkQueue(const std::string& name, int threads, size_t _maxDepth) : maxDepth(_maxDepth)
     {
+        stats.name = name;
+        stats.threads = threads;
     }
     /** Precondition: worker threads have all stopped (they have been joined).
      */
@@ -88,9 +110,10 @@ public:
     {
         LOCK(cs);
         if (!running || queue.size() >= maxDepth) {
+            stats.rejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(std::unique_ptr<WorkItem>(item), GetTimeMicros());
         cond.notify_one();
         return true;
     }
@@ -99,18 +122,36 @@ public:
     {
         while (true) {
             std::unique_ptr<WorkItem> i;
+            int64_t queued_time;
             {
                 WAIT_LOCK(cs, lock);
                 while (running && queue.empty())
                     cond.wait(lock);
                 if (!running && queue.empty())
                     break;
-                i = std::move(queue.front());
+                i = std::move(queue.front().first);
+                queued_time = queue.front().second;
                 queue.pop_front();
             }
+            const int64_t start_time = GetTimeMicros();
             (*i)();
+            const int64_t end_time = GetTimeMicros();
+
+            LOCK(cs);
+            stats.requests++;
+            stats.total_wait += start_time - queued_time;
+            stats.total_duration += end_time - start_time;
+            stats.max_latency = std::max(stats.max_latency, end_time - queued_time);
         }
     }
+    HTTPWorkQueueStats GetStats() EXCLUSIVE_LOCKS_REQUIRED(!cs)
+    {
+        LOCK(cs);
+        HTTPWorkQueueStats rv = stats;
+        rv.depth = queue.size();
+        rv.max_depth = maxDepth;
+        return rv;
+    }
     /** Interrupt and exit loops */
     void Interrupt() EXCLUSIVE_LOCKS_REQUIRED(!cs)
     {
@@ -141,6 +182,11 @@ static struct evhttp* eventHTTP = nullptr;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static std::unique_ptr<WorkQueue<HTTPClosure>> g_work_queue{nullptr};
+//! Work queues of each -rpcworkclass, requests not matching a class use g_work_queue
+static std::vector<std::unique_ptr<WorkQueue<HTTPClosure>>> g_work_class_queues;
+//! Index into g_work_class_queues of the RPC methods and URI prefixes of each -rpcworkclass
+static std::map<std::string, size_t> g_work_class_methods;
+static std::vector<std::pair<std::string, size_t>> g_work_class_prefixes;
 //! Handlers for (sub)paths
 static std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -185,6 +231,63 @@ static bool InitHTTPAllowList()
     return true;
 }
 
+/** Parse -rpcworkclass=<name>:<threads>:<queuedepth>:<method or /uriprefix>,... */
+static bool InitHTTPWorkClasses()
+{
+    g_work_class_queues.clear();
+    g_work_class_methods.clear();
+    g_work_class_prefixes.clear();
+    for (const std::string& str_class : gArgs.GetArgs("-rpcworkclass")) {
+        const std::vector<std::string> parts = SplitString(str_class, ':');
+        int32_t threads, depth;
+        if (parts.size() != 4 || parts[0].empty() ||
+            !ParseInt32(parts[1], &threads) || threads < 1 ||
+            !ParseInt32(parts[2], &depth) || depth < 1) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf(Untranslated("Invalid -rpcworkclass specification: %s. The format is <name>:<threads>:<queuedepth>:<method or /uriprefix>,..."), str_class),
+                "", CClientUIInterface::MSG_ERROR);
+            return false;
+        }
+        const size_t class_index = g_work_class_queues.size();
+        for (const std::string& match : SplitString(parts[3], ',')) {
+            if (match.empty()) {
+                continue;
+            }
+            if (match[0] == '/') {
+                g_work_class_prefixes.emplace_back(match, class_index);
+            } else {
+                g_work_class_methods.emplace(match, class_index);
+            }
+        }
+        LogPrintf("HTTP: creating work queue %s of depth %d with %d threads\n", parts[0], depth, threads);
+        g_work_class_queues.push_back(std::make_unique<WorkQueue<HTTPClosure>>(parts[0], threads, depth));
+    }
+    return true;
+}
+
+/** Select the work queue of the -rpcworkclass matching the uri or the JSON-RPC method of the request */
+static WorkQueue<HTTPClosure>* SelectWorkQueue(const HTTPRequest& req, const std::string& uri)
+{
+    if (g_work_class_queues.empty()) {
+        return g_work_queue.get();
+    }
+    for (const auto& prefix : g_work_class_prefixes) {
+        if (uri.compare(0, prefix.first.size(), prefix.first) == 0) {
+            return g_work_class_queues[prefix.second].get();
+        }
+    }
+    if (req.GetRequestMethod() == HTTPRequest::POST && !g_work_class_methods.empty()) {
+        const std::optional<std::string> method = GetJSONRPCMethodFromBody(req.PeekBody(MAX_WORK_CLASS_PEEK_SIZE));
+        if (method) {
+            const auto it = g_work_class_methods.find(*method);
+            if (it != g_work_class_methods.end()) {
+                return g_work_class_queues[it->second].get();
+            }
+        }
+    }
+    return g_work_queue.get();
+}
+
 /** HTTP request method as string - use for logging only */
 std::string RequestMethodString(HTTPRequest::RequestMethod m)
 {
@@ -262,12 +365,13 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
-        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(g_work_queue);
-        if (g_work_queue->Enqueue(item.get())) {
+        WorkQueue<HTTPClosure>* work_queue = SelectWorkQueue(*hreq, strURI);
+        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
+        if (work_queue->Enqueue(item.get())) {
             item.release(); /* if true, queue took ownership */
         } else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= or -rpcworkclass= settings\n");
             item->req->WriteReply(HTTP_SERVICE_UNAVAILABLE, "Work queue depth exceeded");
         }
     } else {
@@ -337,9 +441,9 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, int worker_num)
+static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, std::string thread_name)
 {
-    util::ThreadRename(strprintf("httpworker.%i", worker_num));
+    util::ThreadRename(std::move(thread_name));
     SetSyscallSandboxPolicy(SyscallSandboxPolicy::NET_HTTP_SERVER_WORKER);
     queue->Run();
 }
@@ -405,9 +509,13 @@ bool InitHTTPServer()
 
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)gArgs.GetIntArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
+    int rpcThreads = std::max((long)gArgs.GetIntArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    g_work_queue = std::make_unique<WorkQueue<HTTPClosure>>(workQueueDepth);
+    g_work_queue = std::make_unique<WorkQueue<HTTPClosure>>("default", rpcThreads, workQueueDepth);
+    if (!InitHTTPWorkClasses()) {
+        return false;
+    }
     // transfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -433,7 +541,14 @@ void StartHTTPServer()
     g_thread_http = std::thread(ThreadHTTP, eventBase);
 
     for (int i = 0; i < rpcThreads; i++) {
-        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, g_work_queue.get(), i);
+        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, g_work_queue.get(), strprintf("httpworker.%i", i));
+    }
+    for (const auto& work_queue : g_work_class_queues) {
+        const HTTPWorkQueueStats stats = work_queue->GetStats();
+        LogPrintf("HTTP: starting %d %s worker threads\n", stats.threads, stats.name);
+        for (int i = 0; i < stats.threads; i++) {
+            g_thread_http_workers.emplace_back(HTTPWorkQueueRun, work_queue.get(), strprintf("http.%s.%i", stats.name, i));
+        }
     }
 }
 
@@ -447,6 +562,9 @@ void InterruptHTTPServer()
     if (g_work_queue) {
         g_work_queue->Interrupt();
     }
+    for (const auto& work_queue : g_work_class_queues) {
+        work_queue->Interrupt();
+    }
 }
 
 void StopHTTPServer()
@@ -478,9 +596,37 @@ void StopHTTPServer()
         eventBase = nullptr;
     }
     g_work_queue.reset();
+    g_work_class_queues.clear();
+    g_work_class_methods.clear();
+    g_work_class_prefixes.clear();
     LogPrint(BCLog::HTTP, "Stopped HTTP server\n");
 }
 
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats()
+{
+    std::vector<HTTPWorkQueueStats> rv;
+    if (g_work_queue) {
+        rv.push_back(g_work_queue->GetStats());
+    }
+    for (const auto& work_queue : g_work_class_queues) {
+        rv.push_back(work_queue->GetStats());
+    }
+    return rv;
+}
+
+bool QueueHTTPWork(std::function<void()> func)
+{
+    if (!g_work_queue) {
+        return false;
+    }
+    std::unique_ptr<HTTPClosure> item(new HTTPFunctionItem(std::move(func)));
+    if (!g_work_queue->Enqueue(item.get())) {
+        return false;
+    }
+    item.release(); /* if true, queue took ownership */
+    return true;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -557,6 +703,18 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t max_size) const
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf) {
+        return "";
+    }
+    std::string rv(std::min(max_size, evbuffer_get_length(buf)), '\0');
+    ev_ssize_t copied = evbuffer_copyout(buf, rv.data(), rv.size());
+    rv.resize(copied > 0 ? copied : 0);
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -679,6 +837,56 @@ std::optional<std::string> GetQueryParameterFromUri(const char* uri, const std::
     return result;
 }
 
+std::optional<std::string> GetJSONRPCMethodFromBody(std::string_view body)
+{
+    auto skip_space = [&body](size_t pos) {
+        while (pos < body.size() && IsSpace(body[pos])) {
+            pos++;
+        }
+        return pos;
+    };
+    size_t pos = skip_space(0);
+    if (pos >= body.size() || body[pos] != '{') {
+        return std::nullopt;
+    }
+    // Keys are only matched at the top level of the object
+    constexpr std::string_view key{"\"method\""};
+    int level = 0;
+    bool in_string = false;
+    for (; pos < body.size(); ++pos) {
+        const char c = body[pos];
+        if (in_string) {
+            if (c == '\\') {
+                pos++;
+            } else if (c == '"') {
+                in_string = false;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            level++;
+        } else if (c == '}' || c == ']') {
+            level--;
+        } else if (c == '"') {
+            size_t value_pos = skip_space(pos + key.size());
+            if (level == 1 && body.compare(pos, key.size(), key) == 0 &&
+                value_pos < body.size() && body[value_pos] == ':') {
+                value_pos = skip_space(value_pos + 1);
+                if (value_pos >= body.size() || body[value_pos] != '"') {
+                    return std::nullopt;
+                }
+                const size_t end = body.find_first_of("\"\\", value_pos + 1);
+                if (end == std::string_view::npos || body[end] != '"') {
+                    return std::nullopt;
+                }
+                return std::string(body.substr(value_pos + 1, end - value_pos - 1));
+            }
+            in_string = true;
+        }
+    }
+    return std::nullopt;
+}
+
 void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
 {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
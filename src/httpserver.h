@@ -8,6 +8,8 @@
 #include <functional>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
@@ -32,6 +34,26 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Request counts, queue depth and latencies of a pool of HTTP worker threads, times in microseconds */
+struct HTTPWorkQueueStats
+{
+    std::string name;
+    int threads{0};
+    size_t depth{0};
+    size_t max_depth{0};
+    uint64_t requests{0};
+    uint64_t rejected{0};
+    int64_t total_wait{0};
+    int64_t total_duration{0};
+    int64_t max_latency{0};
+};
+
+/** Stats of the default worker pool followed by the pool of each -rpcworkclass */
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats();
+
+/** Run func on a thread of the default worker pool, returns false if the pool is not running or is full */
+bool QueueHTTPWork(std::function<void()> func);
+
 /** Change logging level for libevent. */
 void UpdateHTTPServerLogging(bool enable);
 
@@ -109,6 +131,11 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Return up to max_size bytes from the start of the request body without consuming it.
+     */
+    std::string PeekBody(size_t max_size) const;
+
     /**
      * Write output header.
      *
@@ -141,6 +168,11 @@ public:
  */
 std::optional<std::string> GetQueryParameterFromUri(const char* uri, const std::string& key);
 
+/** Find the "method" of a JSON-RPC request object in body without parsing the whole request.
+ * Returns std::nullopt if body does not begin with an object or the method is not a plain string.
+ */
+std::optional<std::string> GetJSONRPCMethodFromBody(std::string_view body);
+
 /** Event handler closure.
  */
 class HTTPClosure
@@ -130,6 +130,12 @@ void BaseIndex::ThreadSync()
     if (!m_synced) {
         auto& consensus_params = Params().GetConsensus();
 
+        if (!SyncFromBlockIndex(pindex)) {
+            FatalError("%s: Failed to sync index %s from the block index",
+                       __func__, GetName());
+            return;
+        }
+
         std::chrono::steady_clock::time_point last_log_time{0s};
         std::chrono::steady_clock::time_point last_locator_write_time{0s};
         while (true) {
@@ -95,6 +95,10 @@ protected:
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    /// Called by the sync thread before it reads blocks from disk. Indices needing only the
+    /// block index entries can index the active chain after pindex here and advance pindex.
+    virtual bool SyncFromBlockIndex(const CBlockIndex*& pindex) { return true; }
+
     /// Virtual method called internally by Commit that can be overridden to atomically
     /// commit more index state.
     virtual bool CommitInternal(CDBBatch& batch);
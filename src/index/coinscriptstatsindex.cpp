@@ -0,0 +1,232 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/coinscriptstatsindex.h>
+
+#include <chain.h>
+#include <coins.h>
+#include <node/blockstorage.h>
+#include <undo.h>
+#include <util/system.h>
+
+using node::UndoReadFromDisk;
+
+static constexpr uint8_t DB_BLOCK_HASH{'s'};
+static constexpr uint8_t DB_BLOCK_HEIGHT{'t'};
+
+namespace {
+
+struct DBHeightKey {
+    int height;
+
+    explicit DBHeightKey(int height_in) : height(height_in) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_BLOCK_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        const uint8_t prefix{ser_readdata8(s)};
+        if (prefix != DB_BLOCK_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for coinscriptstatsindex DB height key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+struct DBHashKey {
+    uint256 block_hash;
+
+    explicit DBHashKey(const uint256& hash_in) : block_hash(hash_in) {}
+
+    SERIALIZE_METHODS(DBHashKey, obj)
+    {
+        uint8_t prefix{DB_BLOCK_HASH};
+        READWRITE(prefix);
+        if (prefix != DB_BLOCK_HASH) {
+            throw std::ios_base::failure("Invalid format for coinscriptstatsindex DB hash key");
+        }
+
+        READWRITE(obj.block_hash);
+    }
+};
+
+}; // namespace
+
+std::unique_ptr<CoinScriptStatsIndex> g_coin_script_stats_index;
+
+CoinScriptType GetCoinScriptType(const CScript& script)
+{
+    if (script.IsPayToPublicKeyHash()) {
+        return COIN_SCRIPT_PUBKEYHASH;
+    }
+    if (script.IsPayToScriptHash()) {
+        return COIN_SCRIPT_SCRIPTHASH;
+    }
+    if (script.IsPayToPublicKeyHash256_CS()) {
+        return COIN_SCRIPT_CS_PUBKEYHASH;
+    }
+    if (script.IsPayToScriptHash256_CS() || script.IsPayToScriptHash_CS()) {
+        return COIN_SCRIPT_CS_SCRIPTHASH;
+    }
+    return COIN_SCRIPT_OTHER;
+}
+
+void CoinScriptStats::Update(const Coin& coin, bool add)
+{
+    ScriptTypeStats& type_stats = types[GetCoinScriptType(coin.out.scriptPubKey)];
+    const int64_t n = add ? 1 : -1;
+    if (coin.nType == OUTPUT_STANDARD) {
+        type_stats.num_plain += n;
+        type_stats.total_amount += n * coin.out.nValue;
+    } else
+    if (coin.nType == OUTPUT_CT) {
+        type_stats.num_blinded += n;
+    }
+}
+
+CoinScriptStatsIndex::CoinScriptStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+{
+    fs::path path{gArgs.GetDataDirNet() / "indexes" / "coinscriptstats"};
+    fs::create_directories(path);
+
+    m_db = std::make_unique<BaseIndex::DB>(path / "db", n_cache_size, f_memory, f_wipe);
+}
+
+bool CoinScriptStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The genesis block outputs are not added to the UTXO set
+    if (pindex->nHeight > 0) {
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+
+        size_t undo_pos = 0;
+        for (const auto& tx : block.vtx) {
+            if (tx->IsParticlVersion()) {
+                for (const auto& txout : tx->vpout) {
+                    if (!txout->IsStandardOutput() && !txout->IsType(OUTPUT_CT)) {
+                        continue;
+                    }
+                    Coin coin{CTxOut(txout->IsStandardOutput() ? txout->GetValue() : 0, *txout->GetPScriptPubKey()), pindex->nHeight, false};
+                    coin.nType = txout->GetType();
+                    if (!coin.out.scriptPubKey.IsUnspendable()) {
+                        m_stats.Update(coin, true);
+                    }
+                }
+            } else {
+                for (const auto& txout : tx->vout) {
+                    if (!txout.scriptPubKey.IsUnspendable()) {
+                        m_stats.Update(Coin{txout, pindex->nHeight, false}, true);
+                    }
+                }
+            }
+
+            // Coinbase txns have no undo data
+            if (tx->IsCoinBase()) {
+                continue;
+            }
+            if (undo_pos >= block_undo.vtxundo.size()) {
+                return error("%s: undo data for block %s is inconsistent", __func__, pindex->GetBlockHash().ToString());
+            }
+            for (const Coin& coin : block_undo.vtxundo[undo_pos++].vprevout) {
+                m_stats.Update(coin, false);
+            }
+        }
+    }
+
+    std::pair<uint256, CoinScriptStats> value{pindex->GetBlockHash(), m_stats};
+    return m_db->Write(DBHeightKey(pindex->nHeight), value);
+}
+
+static bool CopyHeightIndexToHashIndex(CDBIterator& db_it, CDBBatch& batch,
+                                       const std::string& index_name,
+                                       int start_height, int stop_height)
+{
+    DBHeightKey key{start_height};
+    db_it.Seek(key);
+
+    for (int height = start_height; height <= stop_height; ++height) {
+        if (!db_it.GetKey(key) || key.height != height) {
+            return error("%s: unexpected key in %s: expected (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        std::pair<uint256, CoinScriptStats> value;
+        if (!db_it.GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        batch.Write(DBHashKey(value.first), std::move(value.second));
+
+        db_it.Next();
+    }
+    return true;
+}
+
+bool CoinScriptStatsIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+
+    // Keep the stats of the disconnected blocks reachable by hash, their height entries are overwritten
+    if (!CopyHeightIndexToHashIndex(*db_it, batch, GetName(), new_tip->nHeight, current_tip->nHeight)) {
+        return false;
+    }
+
+    if (!m_db->WriteBatch(batch)) return false;
+
+    // Totals are stored per block, no need to reverse the disconnected blocks
+    std::optional<CoinScriptStats> stats = LookUpStats(new_tip);
+    if (!stats) {
+        return error("%s: Cannot read stats of block %s", __func__, new_tip->GetBlockHash().ToString());
+    }
+    m_stats = *stats;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+std::optional<CoinScriptStats> CoinScriptStatsIndex::LookUpStats(const CBlockIndex* block_index) const
+{
+    std::pair<uint256, CoinScriptStats> read_out;
+    if (!m_db->Read(DBHeightKey(block_index->nHeight), read_out)) {
+        return std::nullopt;
+    }
+    if (read_out.first == block_index->GetBlockHash()) {
+        return read_out.second;
+    }
+
+    CoinScriptStats stats;
+    if (!m_db->Read(DBHashKey(block_index->GetBlockHash()), stats)) {
+        return std::nullopt;
+    }
+    return stats;
+}
+
+bool CoinScriptStatsIndex::Init()
+{
+    if (!BaseIndex::Init()) return false;
+
+    const CBlockIndex* pindex{CurrentIndex()};
+
+    if (pindex) {
+        std::optional<CoinScriptStats> stats = LookUpStats(pindex);
+        if (!stats) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+        m_stats = *stats;
+    }
+
+    return true;
+}
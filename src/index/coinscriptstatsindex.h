@@ -0,0 +1,92 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_INDEX_COINSCRIPTSTATSINDEX_H
+#define PARTICL_INDEX_COINSCRIPTSTATSINDEX_H
+
+#include <consensus/amount.h>
+#include <index/base.h>
+#include <serialize.h>
+
+#include <array>
+#include <optional>
+
+class CScript;
+class Coin;
+
+static constexpr bool DEFAULT_COINSCRIPTSTATSINDEX{false};
+
+enum CoinScriptType : uint8_t {
+    COIN_SCRIPT_PUBKEYHASH,
+    COIN_SCRIPT_SCRIPTHASH,
+    COIN_SCRIPT_CS_PUBKEYHASH,
+    COIN_SCRIPT_CS_SCRIPTHASH,
+    COIN_SCRIPT_OTHER,
+    COIN_SCRIPT_TYPE_COUNT,
+};
+
+CoinScriptType GetCoinScriptType(const CScript& script);
+
+struct ScriptTypeStats {
+    int64_t num_plain{0};
+    int64_t num_blinded{0};
+    CAmount total_amount{0};
+
+    SERIALIZE_METHODS(ScriptTypeStats, obj)
+    {
+        READWRITE(obj.num_plain, obj.num_blinded, obj.total_amount);
+    }
+};
+
+/** Unspent output counts and plain amounts per script type */
+struct CoinScriptStats {
+    std::array<ScriptTypeStats, COIN_SCRIPT_TYPE_COUNT> types;
+
+    /** Count coin as created, or as spent if !add */
+    void Update(const Coin& coin, bool add);
+
+    SERIALIZE_METHODS(CoinScriptStats, obj)
+    {
+        for (auto& type_stats : obj.types) {
+            READWRITE(type_stats);
+        }
+    }
+};
+
+/**
+ * CoinScriptStatsIndex keeps the UTXO set statistics of gettxoutsetinfobyscript for every block.
+ * Spent outputs are read from the undo data, so the index can be built on a pruned node.
+ */
+class CoinScriptStatsIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    CoinScriptStats m_stats;
+
+    bool AllowPrune() const override { return true; }
+
+protected:
+    bool Init() override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "coinscriptstatsindex"; }
+
+public:
+    // Constructs the index, which becomes available to be queried.
+    explicit CoinScriptStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Look up the stats after block_index was connected
+    std::optional<CoinScriptStats> LookUpStats(const CBlockIndex* block_index) const;
+};
+
+/// The global per script type UTXO stats index, used by gettxoutsetinfobyscript. May be null.
+extern std::unique_ptr<CoinScriptStatsIndex> g_coin_script_stats_index;
+
+#endif // PARTICL_INDEX_COINSCRIPTSTATSINDEX_H
@@ -0,0 +1,146 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/timestampindex.h>
+
+#include <chain.h>
+#include <insight/timestampindex.h>
+#include <primitives/block.h>
+#include <shutdown.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <limits>
+
+constexpr uint8_t DB_TIMESTAMPINDEX{'s'};
+
+std::unique_ptr<TimestampIndex> g_timestamp_index;
+
+
+/** Access to the timestampindex database (indexes/timestampindex/) */
+class TimestampIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool WriteTimestamp(const CTimestampIndexKey &key);
+    /// Write keys and the locator of the last block they cover in one batch
+    bool WriteTimestamps(const std::vector<CTimestampIndexKey> &keys, const CBlockLocator &locator);
+    void Compact();
+    bool ReadRange(unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                   size_t max_results, const CTimestampIndexKey *after);
+};
+
+TimestampIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "timestampindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool TimestampIndex::DB::WriteTimestamp(const CTimestampIndexKey &key)
+{
+    return Write(std::make_pair(DB_TIMESTAMPINDEX, key), 0);
+}
+
+bool TimestampIndex::DB::WriteTimestamps(const std::vector<CTimestampIndexKey> &keys, const CBlockLocator &locator)
+{
+    CDBBatch batch(*this);
+    for (const auto &key : keys) {
+        batch.Write(std::make_pair(DB_TIMESTAMPINDEX, key), 0);
+    }
+    WriteBestBlock(batch, locator);
+    return WriteBatch(batch);
+}
+
+void TimestampIndex::DB::Compact()
+{
+    CompactRange(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(0)),
+                 std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(std::numeric_limits<unsigned int>::max())));
+}
+
+bool TimestampIndex::DB::ReadRange(unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                                   size_t max_results, const CTimestampIndexKey *after)
+{
+    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    if (after && after->timestamp >= low) {
+        pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, *after));
+    } else {
+        pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+    }
+
+    while (pcursor->Valid()) {
+        if (ShutdownRequested()) return false;
+        if (max_results && hashes.size() >= max_results) {
+            break;
+        }
+        std::pair<uint8_t, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
+            if (!after || key.second.timestamp != after->timestamp || key.second.blockHash != after->blockHash) {
+                hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
+            }
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+TimestampIndex::TimestampIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(std::make_unique<TimestampIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+TimestampIndex::~TimestampIndex() = default;
+
+bool TimestampIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return m_db->WriteTimestamp(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+}
+
+bool TimestampIndex::SyncFromBlockIndex(const CBlockIndex*& pindex)
+{
+    size_t num_written = 0;
+    while (!m_interrupt) {
+        std::vector<CTimestampIndexKey> keys;
+        const CBlockIndex* pindex_last = pindex;
+        CBlockLocator locator;
+        {
+            LOCK(cs_main);
+            const CChain& chain = m_chainstate->m_chain;
+            if (pindex && !chain.Contains(pindex)) {
+                // Leave rewinding from a fork to the block by block sync
+                break;
+            }
+            for (const CBlockIndex* pnext = pindex ? chain.Next(pindex) : chain.Genesis();
+                 pnext && keys.size() < TIMESTAMP_SYNC_BATCH_SIZE; pnext = chain.Next(pnext)) {
+                keys.emplace_back(pnext->nTime, pnext->GetBlockHash());
+                pindex_last = pnext;
+            }
+            if (keys.empty()) {
+                break;
+            }
+            locator = chain.GetLocator(pindex_last);
+        }
+        if (!m_db->WriteTimestamps(keys, locator)) {
+            return error("%s: Failed to write batch ending at height %d", __func__, pindex_last->nHeight);
+        }
+        SetBestBlockIndex(pindex_last);
+        pindex = pindex_last;
+        num_written += keys.size();
+    }
+
+    if (num_written > 0) {
+        LogPrintf("%s: Indexed %d blocks from the block index, compacting\n", GetName(), num_written);
+        m_db->Compact();
+    }
+    return true;
+}
+
+BaseIndex::DB& TimestampIndex::GetDB() const { return *m_db; }
+
+bool TimestampIndex::FindBlockHashes(unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                                     size_t max_results, const CTimestampIndexKey *after) const
+{
+    return m_db->ReadRange(high, low, hashes, max_results, after);
+}
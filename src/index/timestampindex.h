@@ -0,0 +1,60 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_INDEX_TIMESTAMPINDEX_H
+#define PARTICL_INDEX_TIMESTAMPINDEX_H
+
+#include <index/base.h>
+
+#include <utility>
+#include <vector>
+
+class uint256;
+struct CTimestampIndexKey;
+
+/** Blocks written per batch when building the index, each batch also stores the resume point */
+static constexpr size_t TIMESTAMP_SYNC_BATCH_SIZE{10000};
+
+/**
+ * TimestampIndex is used to look up block hashes by a range of block times.
+ * Synced in the background, enabling it does not require a reindex.
+ */
+class TimestampIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    bool AllowPrune() const override { return true; }
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    /// Build from the block times in the block index, TIMESTAMP_SYNC_BATCH_SIZE blocks per batch
+    bool SyncFromBlockIndex(const CBlockIndex*& pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "timestampindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit TimestampIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~TimestampIndex() override;
+
+    /// Look up the blocks with low <= nTime < high, ordered by time.
+    /// Stops after max_results if set, starts after the key after if set.
+    /// Blocks that were disconnected are not removed, callers filter by the active chain.
+    bool FindBlockHashes(unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                         size_t max_results = 0, const CTimestampIndexKey *after = nullptr) const;
+};
+
+/// The global timestamp index, used by getblockhashes. May be null.
+extern std::unique_ptr<TimestampIndex> g_timestamp_index;
+
+#endif // PARTICL_INDEX_TIMESTAMPINDEX_H
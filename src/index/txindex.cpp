@@ -16,7 +16,7 @@
 #include <wallet/ismine.h>
 #include <key_io.h>
 
-using node::OpenBlockFile;
+using node::OpenBlockRecord;
 
 constexpr uint8_t DB_TXINDEX{'t'};
 
@@ -24,6 +24,9 @@ constexpr uint8_t DB_TXINDEX{'t'};
 constexpr uint8_t DB_TXINDEX_CSOUTPUT{'O'};
 constexpr uint8_t DB_TXINDEX_CSLINK{'L'};
 constexpr uint8_t DB_TXINDEX_CSBESTBLOCK{'C'};
+constexpr uint8_t DB_TXINDEX_CSSTAKETOTAL{'A'};
+constexpr uint8_t DB_TXINDEX_CSSPENDTOTAL{'P'};
+constexpr uint8_t DB_TXINDEX_CSTOTALSVERSION{'V'};
 */
 
 std::unique_ptr<TxIndex> g_txindex;
@@ -92,6 +95,9 @@ bool TxIndex::Init()
                 m_best_block_index = best_cs_block_index;
             }
         }
+        if (!BuildCSTotals()) {
+            return false;
+        }
     }
 
     return true;
@@ -124,6 +130,7 @@ bool TxIndex::DisconnectBlock(const CBlock& block)
     }
 
     std::set<COutPoint> erasedCSOuts;
+    std::map<ColdStakeIndexSpendKey, ColdStakeIndexTotal> totals;
     CDBBatch batch(*m_db);
     for (const auto &tx : block.vtx) {
         int n = -1;
@@ -138,6 +145,12 @@ bool TxIndex::DisconnectBlock(const CBlock& block)
             }
 
             ColdStakeIndexOutputKey ok(tx->GetHash(), n);
+            ColdStakeIndexOutputValue ov;
+            ColdStakeIndexLinkKey lk;
+            if (m_db->Read(std::make_pair(DB_TXINDEX_CSOUTPUT, ok), ov) &&
+                ov.m_spend_height == -1 && GetCSLinkKey(*ps, lk)) {
+                AddCSTotal(totals, lk, ov.m_value, -1);
+            }
             batch.Erase(std::make_pair(DB_TXINDEX_CSOUTPUT, ok));
             erasedCSOuts.insert(COutPoint(ok.m_txnid, ok.m_n));
         }
@@ -149,12 +162,19 @@ bool TxIndex::DisconnectBlock(const CBlock& block)
                 continue;
             }
             if (m_db->Read(std::make_pair(DB_TXINDEX_CSOUTPUT, ok), ov)) {
+                ColdStakeIndexLinkKey lk;
+                if (ov.m_spend_height != -1 && GetCSOutputLink(ok, ov, lk)) {
+                    AddCSTotal(totals, lk, ov.m_value, 1);
+                }
                 ov.m_spend_height = -1;
                 ov.m_spend_txid.SetNull();
                 batch.Write(std::make_pair(DB_TXINDEX_CSOUTPUT, ok), ov);
             }
         }
     }
+    if (!UpdateCSTotals(batch, totals)) {
+        return false;
+    }
 
     if (!m_db->WriteBatch(batch)) {
         return error("%s: WriteBatch failed.", __func__);
@@ -163,11 +183,164 @@ bool TxIndex::DisconnectBlock(const CBlock& block)
     return true;
 }
 
+bool TxIndex::GetCSLinkKey(const CScript &script, ColdStakeIndexLinkKey &lk) const
+{
+    CScript scriptStake, scriptSpend;
+    if (!SplitConditionalCoinstakeScript(script, scriptStake, scriptSpend)) {
+        return false;
+    }
+
+    std::vector<valtype> vSolutions;
+    lk.m_stake_type = Solver(scriptStake, vSolutions);
+
+    if (m_cs_index_whitelist.size() > 0
+        && !m_cs_index_whitelist.count(vSolutions[0])) {
+        return false;
+    }
+
+    if (lk.m_stake_type == TxoutType::PUBKEYHASH) {
+        memcpy(lk.m_stake_id.begin(), vSolutions[0].data(), 20);
+    } else
+    if (lk.m_stake_type == TxoutType::PUBKEYHASH256) {
+        lk.m_stake_id = CKeyID256(uint256(vSolutions[0]));
+    } else {
+        LogPrint(BCLog::COINDB, "%s: Ignoring unexpected stakescript type=%d.\n", __func__, particl::FromTxoutType(lk.m_stake_type));
+        return false;
+    }
+
+    lk.m_spend_type = Solver(scriptSpend, vSolutions);
+
+    if (lk.m_spend_type == TxoutType::PUBKEYHASH || lk.m_spend_type == TxoutType::SCRIPTHASH) {
+        memcpy(lk.m_spend_id.begin(), vSolutions[0].data(), 20);
+    } else
+    if (lk.m_spend_type == TxoutType::PUBKEYHASH256 || lk.m_spend_type == TxoutType::SCRIPTHASH256) {
+        lk.m_spend_id = CKeyID256(uint256(vSolutions[0]));
+    } else {
+        LogPrint(BCLog::COINDB, "%s: Ignoring unexpected spendscript type=%d.\n", __func__, particl::FromTxoutType(lk.m_spend_type));
+        return false;
+    }
+
+    return true;
+}
+
+bool TxIndex::GetCSOutputLink(const ColdStakeIndexOutputKey &ok, const ColdStakeIndexOutputValue &ov, ColdStakeIndexLinkKey &lk) const
+{
+    if (ov.m_have_link) {
+        lk = ov.m_link;
+        return true;
+    }
+
+    // Rows written before the totals were added don't store their keys
+    uint256 block_hash;
+    CTransactionRef tx;
+    if (!FindTx(ok.m_txnid, block_hash, tx) ||
+        ok.m_n < 0 || (size_t)ok.m_n >= tx->vpout.size()) {
+        return false;
+    }
+    const CScript *ps = tx->vpout[ok.m_n]->GetPScriptPubKey();
+    return ps && GetCSLinkKey(*ps, lk);
+}
+
+void TxIndex::AddCSTotal(std::map<ColdStakeIndexSpendKey, ColdStakeIndexTotal> &totals, const ColdStakeIndexLinkKey &lk, CAmount value, int n)
+{
+    ColdStakeIndexTotal &total = totals[ColdStakeIndexSpendKey(lk)];
+    total.m_num_unspent += n;
+    total.m_value += n * value;
+}
+
+bool TxIndex::UpdateCSTotals(CDBBatch &batch, const std::map<ColdStakeIndexSpendKey, ColdStakeIndexTotal> &totals) const
+{
+    std::map<ColdStakeIndexStakeKey, ColdStakeIndexTotal> stake_totals;
+
+    for (const auto &it : totals) {
+        if (it.second.IsNull()) {
+            continue;
+        }
+        ColdStakeIndexTotal spend_total;
+        m_db->Read(std::make_pair(DB_TXINDEX_CSSPENDTOTAL, it.first), spend_total);
+        spend_total.m_num_unspent += it.second.m_num_unspent;
+        spend_total.m_value += it.second.m_value;
+        if (spend_total.m_num_unspent < 0 || spend_total.m_value < 0) {
+            return error("%s: Negative coldstake totals.", __func__);
+        }
+        if (spend_total.m_num_unspent == 0) {
+            batch.Erase(std::make_pair(DB_TXINDEX_CSSPENDTOTAL, it.first));
+        } else {
+            batch.Write(std::make_pair(DB_TXINDEX_CSSPENDTOTAL, it.first), spend_total);
+        }
+
+        ColdStakeIndexTotal &stake_delta = stake_totals[it.first];
+        stake_delta.m_num_unspent += it.second.m_num_unspent;
+        stake_delta.m_value += it.second.m_value;
+    }
+
+    for (const auto &it : stake_totals) {
+        const ColdStakeIndexStakeKey &sk = it.first;
+        ColdStakeIndexTotal stake_total;
+        m_db->Read(std::make_pair(DB_TXINDEX_CSSTAKETOTAL, sk), stake_total);
+        stake_total.m_num_unspent += it.second.m_num_unspent;
+        stake_total.m_value += it.second.m_value;
+        if (stake_total.m_num_unspent < 0 || stake_total.m_value < 0) {
+            return error("%s: Negative coldstake totals.", __func__);
+        }
+        if (stake_total.m_num_unspent == 0) {
+            batch.Erase(std::make_pair(DB_TXINDEX_CSSTAKETOTAL, sk));
+        } else {
+            batch.Write(std::make_pair(DB_TXINDEX_CSSTAKETOTAL, sk), stake_total);
+        }
+    }
+
+    return true;
+}
+
+bool TxIndex::BuildCSTotals()
+{
+    int version = 0;
+    if (m_db->Read(DB_TXINDEX_CSTOTALSVERSION, version) && version >= CSINDEX_TOTALS_VERSION) {
+        return true;
+    }
+
+    // Csindex synced before the totals were added, sum the unspent outputs once
+    LogPrintf("Building csindex totals.\n");
+    std::map<ColdStakeIndexSpendKey, ColdStakeIndexTotal> totals;
+    std::unique_ptr<CDBIterator> it(m_db->NewIterator());
+    it->Seek(DB_TXINDEX_CSLINK);
+    for (; it->Valid(); it->Next()) {
+        std::pair<uint8_t, ColdStakeIndexLinkKey> key;
+        if (!it->GetKey(key) || key.first != DB_TXINDEX_CSLINK) {
+            break;
+        }
+        std::vector<ColdStakeIndexOutputKey> oks;
+        if (!it->GetValue(oks)) {
+            return error("%s: Cannot read link value.", __func__);
+        }
+        for (const auto &ok : oks) {
+            ColdStakeIndexOutputValue ov;
+            if (m_db->Read(std::make_pair(DB_TXINDEX_CSOUTPUT, ok), ov) && ov.m_spend_height == -1) {
+                AddCSTotal(totals, key.second, ov.m_value, 1);
+            }
+        }
+    }
+
+    CDBBatch batch(*m_db);
+    if (!UpdateCSTotals(batch, totals)) {
+        return false;
+    }
+    batch.Write(DB_TXINDEX_CSTOTALSVERSION, CSINDEX_TOTALS_VERSION);
+    if (!m_db->WriteBatch(batch)) {
+        return error("%s: WriteBatch failed.", __func__);
+    }
+    LogPrintf("Built csindex totals for %d key pairs.\n", totals.size());
+
+    return true;
+}
+
 bool TxIndex::IndexCSOutputs(const CBlock& block, const CBlockIndex* pindex)
 {
     CDBBatch batch(*m_db);
     std::map<ColdStakeIndexOutputKey, ColdStakeIndexOutputValue> newCSOuts;
     std::map<ColdStakeIndexLinkKey, std::vector<ColdStakeIndexOutputKey> > newCSLinks;
+    std::map<ColdStakeIndexSpendKey, ColdStakeIndexTotal> totals;
 
     for (const auto &tx : block.vtx) {
         int n = -1;
@@ -181,46 +354,13 @@ bool TxIndex::IndexCSOutputs(const CBlock& block, const CBlockIndex* pindex)
                 continue;
             }
 
-            CScript scriptStake, scriptSpend;
-            if (!SplitConditionalCoinstakeScript(*ps, scriptStake, scriptSpend)) {
-                continue;
-            }
-
-            std::vector<valtype> vSolutions;
-
             ColdStakeIndexOutputKey ok;
             ColdStakeIndexOutputValue ov;
             ColdStakeIndexLinkKey lk;
-            lk.m_height = pindex->nHeight;
-            lk.m_stake_type = Solver(scriptStake, vSolutions);
-
-            if (m_cs_index_whitelist.size() > 0
-                && !m_cs_index_whitelist.count(vSolutions[0])) {
-                continue;
-            }
-
-            if (lk.m_stake_type == TxoutType::PUBKEYHASH) {
-                memcpy(lk.m_stake_id.begin(), vSolutions[0].data(), 20);
-            } else
-            if (lk.m_stake_type == TxoutType::PUBKEYHASH256) {
-                lk.m_stake_id = CKeyID256(uint256(vSolutions[0]));
-            } else {
-                LogPrint(BCLog::COINDB, "%s: Ignoring unexpected stakescript type=%d.\n", __func__, particl::FromTxoutType(lk.m_stake_type));
-                continue;
-            }
-
-
-            lk.m_spend_type = Solver(scriptSpend, vSolutions);
-
-            if (lk.m_spend_type == TxoutType::PUBKEYHASH || lk.m_spend_type == TxoutType::SCRIPTHASH) {
-                memcpy(lk.m_spend_id.begin(), vSolutions[0].data(), 20);
-            } else
-            if (lk.m_spend_type == TxoutType::PUBKEYHASH256 || lk.m_spend_type == TxoutType::SCRIPTHASH256) {
-                lk.m_spend_id = CKeyID256(uint256(vSolutions[0]));
-            } else {
-                LogPrint(BCLog::COINDB, "%s: Ignoring unexpected spendscript type=%d.\n", __func__, particl::FromTxoutType(lk.m_spend_type));
+            if (!GetCSLinkKey(*ps, lk)) {
                 continue;
             }
+            lk.m_height = pindex->nHeight;
 
             ok.m_txnid = tx->GetHash();
             ok.m_n = n;
@@ -229,9 +369,12 @@ bool TxIndex::IndexCSOutputs(const CBlock& block, const CBlockIndex* pindex)
             if (tx->IsCoinStake()) {
                 ov.m_flags |= CSI_FROM_STAKE;
             }
+            ov.m_have_link = true;
+            ov.m_link = lk;
 
             newCSOuts[ok] = ov;
             newCSLinks[lk].push_back(ok);
+            AddCSTotal(totals, lk, ov.m_value, 1);
         }
 
         for (const auto &in : tx->vin) {
@@ -245,14 +388,22 @@ bool TxIndex::IndexCSOutputs(const CBlock& block, const CBlockIndex* pindex)
             if (it != newCSOuts.end()) {
                 it->second.m_spend_height = pindex->nHeight;
                 it->second.m_spend_txid = tx->GetHash();
+                AddCSTotal(totals, it->second.m_link, it->second.m_value, -1);
             } else
             if (m_db->Read(std::make_pair(DB_TXINDEX_CSOUTPUT, ok), ov)) {
+                ColdStakeIndexLinkKey lk;
+                if (ov.m_spend_height == -1 && GetCSOutputLink(ok, ov, lk)) {
+                    AddCSTotal(totals, lk, ov.m_value, -1);
+                }
                 ov.m_spend_height = pindex->nHeight;
                 ov.m_spend_txid = tx->GetHash();
                 batch.Write(std::make_pair(DB_TXINDEX_CSOUTPUT, ok), ov);
             }
         }
     }
+    if (!UpdateCSTotals(batch, totals)) {
+        return false;
+    }
 
     for (const auto &it : newCSOuts) {
         batch.Write(std::make_pair(DB_TXINDEX_CSOUTPUT, it.first), it.second);
@@ -273,19 +424,24 @@ bool TxIndex::IndexCSOutputs(const CBlock& block, const CBlockIndex* pindex)
 
 BaseIndex::DB& TxIndex::GetDB() const { return *m_db; }
 
-bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
+/** Read the header and the txn at postx, of a plain or compressed block record */
+static bool ReadTxAtPos(const CDiskTxPos& postx, CBlockHeader& header, CTransactionRef& tx)
 {
-    CDiskTxPos postx;
-    if (!m_db->ReadTxPos(tx_hash, postx)) {
-        return false;
-    }
-
-    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+    std::vector<uint8_t> data;
+    bool compressed;
+    CAutoFile file(OpenBlockRecord(postx, data, compressed), SER_DISK, CLIENT_VERSION);
     if (file.IsNull()) {
         return error("%s: OpenBlockFile failed", __func__);
     }
-    CBlockHeader header;
     try {
+        if (compressed) {
+            // nTxOffset is into the uncompressed block
+            CDataStream ss{data, SER_DISK, CLIENT_VERSION};
+            ss >> header;
+            ss.ignore(postx.nTxOffset);
+            ss >> tx;
+            return true;
+        }
         file >> header;
         if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
             return error("%s: fseek(...) failed", __func__);
@@ -294,6 +450,20 @@ bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRe
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
+    return true;
+}
+
+bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
+{
+    CDiskTxPos postx;
+    if (!m_db->ReadTxPos(tx_hash, postx)) {
+        return false;
+    }
+
+    CBlockHeader header;
+    if (!ReadTxAtPos(postx, header, tx)) {
+        return false;
+    }
     if (tx->GetHash() != tx_hash) {
         return error("%s: txid mismatch", __func__);
     }
@@ -308,18 +478,8 @@ bool TxIndex::FindTx(const uint256& tx_hash, CBlockHeader& header, CTransactionR
         return false;
     }
 
-    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
-        return error("%s: OpenBlockFile failed", __func__);
-    }
-    try {
-        file >> header;
-        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
-            return error("%s: fseek(...) failed", __func__);
-        }
-        file >> tx;
-    } catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    if (!ReadTxAtPos(postx, header, tx)) {
+        return false;
     }
     if (tx->GetHash() != tx_hash) {
         return error("%s: txid mismatch", __func__);
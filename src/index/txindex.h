@@ -5,9 +5,18 @@
 #ifndef BITCOIN_INDEX_TXINDEX_H
 #define BITCOIN_INDEX_TXINDEX_H
 
+#include <consensus/amount.h>
 #include <index/base.h>
 
+#include <map>
+
 class CBlockHeader;
+class CScript;
+class ColdStakeIndexLinkKey;
+class ColdStakeIndexOutputKey;
+class ColdStakeIndexOutputValue;
+class ColdStakeIndexSpendKey;
+class ColdStakeIndexTotal;
 
 /**
  * TxIndex is used to look up transactions included in the blockchain by hash.
@@ -36,6 +45,16 @@ protected:
 
     bool IndexCSOutputs(const CBlock& block, const CBlockIndex* pindex);
 
+    /// Parse the staking and spending keys of a coldstake script, false if not indexed.
+    bool GetCSLinkKey(const CScript &script, ColdStakeIndexLinkKey &lk) const;
+    bool GetCSOutputLink(const ColdStakeIndexOutputKey &ok, const ColdStakeIndexOutputValue &ov, ColdStakeIndexLinkKey &lk) const;
+
+    static void AddCSTotal(std::map<ColdStakeIndexSpendKey, ColdStakeIndexTotal> &totals, const ColdStakeIndexLinkKey &lk, CAmount value, int n);
+    /// Apply the changes in totals to the per spend key and per stake key rows.
+    bool UpdateCSTotals(CDBBatch &batch, const std::map<ColdStakeIndexSpendKey, ColdStakeIndexTotal> &totals) const;
+    /// Sum the unspent outputs of a csindex synced before the totals were added.
+    bool BuildCSTotals();
+
 public:
     BaseIndex::DB& GetDB() const override;
 
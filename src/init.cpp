@@ -21,7 +21,9 @@
 #include <httprpc.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/coinscriptstatsindex.h>
 #include <index/coinstatsindex.h>
+#include <index/timestampindex.h>
 #include <index/txindex.h>
 #include <init/common.h>
 #include <interfaces/chain.h>
@@ -72,11 +74,14 @@
 #include <util/translation.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <validationstats.h>
 #include <blind.h>
+#include <key/stealth.h>
 #include <smsg/smessage.h>
 #include <smsg/manager.h>
 #include <smsg/rpcsmessage.h>
 #include <insight/rpc.h>
+#include <insight/blockdeltas.h>
 #include <pos/miner.h>
 #include <pos/kernel.h>
 #include <core_io.h>
@@ -118,17 +123,20 @@
 
 #include <insight/insight.h>
 
+using node::BlockTemplateCache;
 using node::CacheSizes;
 using node::CalculateCacheSizes;
 using node::ChainstateLoadVerifyError;
 using node::ChainstateLoadingError;
 using node::CleanupBlockRevFiles;
+using node::DEFAULT_BLOCKFILE_COMPRESSION;
 using node::DEFAULT_PRINTPRIORITY;
 using node::DEFAULT_STOPAFTERBLOCKIMPORT;
 using node::LoadChainstate;
 using node::NodeContext;
 using node::ThreadImport;
 using node::VerifyLoadedChainstate;
+using node::fCompressBlockFiles;
 using node::fPruneMode;
 using node::fReindex;
 using node::nPruneTarget;
@@ -287,6 +295,12 @@ void Interrupt(NodeContext& node)
     if (g_coin_stats_index) {
         g_coin_stats_index->Interrupt();
     }
+    if (g_coin_script_stats_index) {
+        g_coin_script_stats_index->Interrupt();
+    }
+    if (g_timestamp_index) {
+        g_timestamp_index->Interrupt();
+    }
 }
 
 void Shutdown(NodeContext& node)
@@ -312,6 +326,7 @@ void Shutdown(NodeContext& node)
 #ifdef ENABLE_WALLET
     StopThreadStakeMiner();
 #endif
+    StopEphemeralKeyPool();
     for (const auto& client : node.chain_clients) {
         client->flush();
     }
@@ -320,6 +335,8 @@ void Shutdown(NodeContext& node)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (node.peerman) UnregisterValidationInterface(node.peerman.get());
+    if (node.block_template_cache) UnregisterValidationInterface(node.block_template_cache.get());
+    if (node.block_deltas_cache) UnregisterValidationInterface(node.block_deltas_cache.get());
     if (node.connman) node.connman->Stop();
 
     StopTorControl();
@@ -333,6 +350,8 @@ void Shutdown(NodeContext& node)
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     node.peerman.reset();
+    node.block_template_cache.reset();
+    node.block_deltas_cache.reset();
     node.connman.reset();
     node.banman.reset();
     node.addrman.reset();
@@ -368,6 +387,14 @@ void Shutdown(NodeContext& node)
         g_coin_stats_index->Stop();
         g_coin_stats_index.reset();
     }
+    if (g_coin_script_stats_index) {
+        g_coin_script_stats_index->Stop();
+        g_coin_script_stats_index.reset();
+    }
+    if (g_timestamp_index) {
+        g_timestamp_index->Stop();
+        g_timestamp_index.reset();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
 
@@ -501,7 +528,8 @@ void SetupServerArgs(ArgsManager& argsman)
 #if HAVE_SYSTEM
     argsman.AddArg("-alertnotify=<cmd>", "Execute command when an alert is raised (%s in cmd is replaced by message)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
-    argsman.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex(), signetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script, rangeproof, MLSAG signature and stake kernel verification (0 to verify all, default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex(), signetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockfilecompression", strprintf("Write new block and undo data to disk compressed with LZ4 where that saves space. Existing files stay readable either way, versions without support can't read compressed blocks (default: %u)", DEFAULT_BLOCKFILE_COMPRESSION), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksdir=<dir>", "Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-fastprune", "Use smaller block files and lower minimum prune height for testing purposes", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
 #if HAVE_SYSTEM
@@ -514,12 +542,16 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-ephemeralkeypool=<n>", strprintf("Keep <n> ephemeral keypairs generated ahead for stealth outputs and secure messages, 0 to disable (default: %u)", DEFAULT_EPHEMERAL_KEYPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-loadblock=<file>", "Imports blocks from external file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-mempoolspillproofs", strprintf("Move the rangeproofs of validated mempool transactions to a file in the data directory until they are relayed or mined (default: %u)", DEFAULT_MEMPOOL_SPILL_PROOFS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex(), signetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-notificationthreads=<n>", strprintf("Set the number of threads running the notification queues of wallets and ZMQ, which process each block concurrently, 0 to run them on the scheduler thread (0 to %d, default: %d)",
+        MAX_NOTIFICATION_THREADS, DEFAULT_NOTIFICATION_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -546,14 +578,21 @@ void SetupServerArgs(ArgsManager& argsman)
 
     // Particl specific
     argsman.AddArg("-addressindex", strprintf("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)", particl::DEFAULT_ADDRESSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-coinscriptstatsindex", strprintf("Maintain UTXO set statistics per script type for every block, used by the gettxoutsetinfobyscript RPC (default: %u)", DEFAULT_COINSCRIPTSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-timestampindex", strprintf("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)", particl::DEFAULT_TIMESTAMPINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
-    argsman.AddArg("-spentindex", strprintf("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)", particl::DEFAULT_SPENTINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-spentindex", strprintf("Maintain a full spent index, used to query the spending txid and input index for an outpoint. With -prune getblockdeltas is served from a compact record of each block (default: %u)", particl::DEFAULT_SPENTINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-balancesindex", strprintf("Maintain a balances index per block (default: %u)", particl::DEFAULT_BALANCESINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockrewardindex", strprintf("Maintain the reward breakdown of every block, used by getblockreward and getblockrewards (default: %u)", particl::DEFAULT_BLOCKREWARDINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-csindex", strprintf("Maintain an index of outputs by coldstaking address (default: %u)", particl::DEFAULT_CSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-cswhitelist", strprintf("Only index coldstaked outputs with matching stake address. Can be specified multiple times."), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 
     argsman.AddArg("-dbmaxopenfiles", strprintf("Maximum number of open files parameter passed to level-db (default: %u)", particl::DEFAULT_DB_MAX_OPEN_FILES), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbcompression", strprintf("Database compression parameter passed to level-db (default: %s)", particl::DEFAULT_DB_COMPRESSION ? "true" : "false"), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-rctoutputfile", strprintf("Mirror anon outputs in a memory mapped flat file table to speed up ring member lookups (default: %u)", DEFAULT_RCTOUTPUTFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-indexdbdir=<dir>", "Keep the address, spent and balances indexes in a separate database in <dir>, relative paths are prefixed by the net specific datadir. Existing index data is moved on startup, in either direction", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-indexdbcache=<n>", strprintf("Database cache in MiB for the separate index database, by default it takes 3/4 of the block index database cache (minimum: %u)", nMinDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-spentcache=<n>", strprintf("Number of recent blocks to keep the spent coins of in memory, used by reorgs and kernel checks, 0 to disable (default: %u)", DEFAULT_SPENTCACHE_BLOCKS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-rctcache=<n>", strprintf("Maximum number of anon outputs to keep in the in-memory lookup cache, 0 to disable (default: %u)", DEFAULT_RCTCACHE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 
     argsman.AddArg("-findpeers", "Node will search for peers (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
 
@@ -572,6 +611,9 @@ void SetupServerArgs(ArgsManager& argsman)
 
     hidden_args.emplace_back("-btcmode");
     hidden_args.emplace_back("-debugdevice");  // Disable to allow usbdevices in regtest mode
+#if ENABLE_USBDEVICE
+    argsman.AddArg("-devicetimeout=<n>", strprintf("Seconds to wait for a hardware device to complete a request (default: %u)", usb_device::DEFAULT_DEVICE_TIMEOUT), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+#endif
     // end Particl specific
 
     argsman.AddArg("-addnode=<ip>", strprintf("Add a node to connect to and attempt to keep the connection open (see the addnode RPC help for more info). This option can be specified multiple times to add multiple nodes; connections are limited to %u at a time and are counted separately from the -maxconnections limit.", MAX_ADDNODE_CONNECTIONS), ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::CONNECTION);
@@ -657,6 +699,11 @@ void SetupServerArgs(ArgsManager& argsman)
     // Particl
     argsman.AddArg("-zmqpubhashwtx=<address>", "Enable publish hash transaction received by wallets in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     argsman.AddArg("-zmqpubsmsg=<address>", "Enable publish secure message in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubsmsgfunded=<address>", "Enable publish the funding txid of paid secure messages sent with batchfund in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubkeyimage=<address>", "Enable publish key images spent in connected and disconnected blocks in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubcoldstake=<address>", "Enable publish cold staking outputs in connected and disconnected blocks in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqpubanonoutputs=<address>", "Enable publish the anon output index range of connected and disconnected blocks in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    argsman.AddArg("-zmqbatchperblock", strprintf("Publish the keyimage and coldstake items of a block as one multipart message (default: %u)", DEFAULT_ZMQ_BATCH_PER_BLOCK), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     argsman.AddArg("-serverkeyzmq=<secret_key>", "Base64 encoded string of the z85 encoded secret key for CurveZMQ.", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     argsman.AddArg("-newserverkeypairzmq", "Generate new key pair for CurveZMQ, print and exit.", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     argsman.AddArg("-whitelistzmq=<IP address or network>", "Whitelist peers connecting from the given IP address (e.g. 1.2.3.4) or CIDR notated network (e.g. 1.2.3.0/24). Can be specified multiple times.", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
@@ -675,6 +722,11 @@ void SetupServerArgs(ArgsManager& argsman)
     // Particl
     hidden_args.emplace_back("-zmqpubhashwtx=<address>");
     hidden_args.emplace_back("-zmqpubsmsg=<address>");
+    hidden_args.emplace_back("-zmqpubsmsgfunded=<address>");
+    hidden_args.emplace_back("-zmqpubkeyimage=<address>");
+    hidden_args.emplace_back("-zmqpubcoldstake=<address>");
+    hidden_args.emplace_back("-zmqpubanonoutputs=<address>");
+    hidden_args.emplace_back("-zmqbatchperblock");
     hidden_args.emplace_back("-serverkeyzmq=<secret_key>");
     hidden_args.emplace_back("-newserverkeypairzmq");
     hidden_args.emplace_back("-whitelistzmq=<IP address or network>");
@@ -688,6 +740,7 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-checkpoints", strprintf("Enable rejection of any forks from the known historical chain until block %s (default: %u)", defaultChainParams->Checkpoints().GetHeight(), DEFAULT_CHECKPOINTS_ENABLED), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-blockvalidationstats=<n>", strprintf("Keep counters and timings of the Particl specific validation work for the last <n> blocks, see getblockvalidationstats (default: %u)", DEFAULT_BLOCK_VALIDATION_STATS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-limitancestorcount=<n>", strprintf("Do not accept transactions if number of in-mempool ancestors is <n> or more (default: %u)", DEFAULT_ANCESTOR_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -697,6 +750,7 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-capturemessages", "Capture all P2P messages to disk", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-mocktime=<n>", "Replace actual time with " + UNIX_EPOCH_TIME + " (default: 0)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-maxrangeproofcachesize=<n>", strprintf("Limit the size of the valid rangeproof cache to <n> MiB (default: %u)", DEFAULT_MAX_RANGEPROOF_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-printpriority", strprintf("Log transaction fee rate in " + CURRENCY_UNIT + "/kvB when mining blocks (default: %u)", DEFAULT_PRINTPRIORITY), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-uacomment=<cmt>", "Append comment to the user agent string", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
@@ -733,6 +787,7 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-rpcuser=<user>", "Username for JSON-RPC connections", ArgsManager::ALLOW_ANY | ArgsManager::SENSITIVE, OptionsCategory::RPC);
     argsman.AddArg("-rpcwhitelist=<whitelist>", "Set a whitelist to filter incoming RPC calls for a specific user. The field <whitelist> comes in the format: <USERNAME>:<rpc 1>,<rpc 2>,...,<rpc n>. If multiple whitelists are set for a given user, they are set-intersected. See -rpcwhitelistdefault documentation for information on default whitelist behavior.", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     argsman.AddArg("-rpcwhitelistdefault", "Sets default behavior for rpc whitelisting. Unless rpcwhitelistdefault is set to 0, if any -rpcwhitelist is set, the rpc server acts as if all rpc users are subject to empty-unless-otherwise-specified whitelists. If rpcwhitelistdefault is set to 1 and no -rpcwhitelist is set, rpc server acts as if all rpc users are subject to empty whitelists.", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    argsman.AddArg("-rpcworkclass=<name>:<threads>:<queuedepth>:<methods>", "Serve the comma separated RPC methods, or URI prefixes starting with /, with a separate pool of <threads> worker threads and a work queue of depth <queuedepth>. Other requests use the -rpcthreads pool. Can be specified multiple times.", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     argsman.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::RPC);
     argsman.AddArg("-server", "Accept command line and JSON-RPC commands", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
 
@@ -1032,9 +1087,7 @@ bool AppInitParameterInteraction(const ArgsManager& args, bool use_syscall_sandb
         #define CHECK_ARG_FOR_PRUNE_MODE(name, default_mode)                                \
         if (gArgs.GetBoolArg(name, default_mode)) {                                         \
             return InitError(_("Prune mode is incompatible with " name ".")); }
-        CHECK_ARG_FOR_PRUNE_MODE("-addressindex", particl::DEFAULT_ADDRESSINDEX)
-        CHECK_ARG_FOR_PRUNE_MODE("-timestampindex", particl::DEFAULT_TIMESTAMPINDEX)
-        CHECK_ARG_FOR_PRUNE_MODE("-spentindex", particl::DEFAULT_SPENTINDEX)
+        // The address and spent indexes keep what their RPCs need, the csindex is kept with the txindex
         CHECK_ARG_FOR_PRUNE_MODE("-csindex", particl::DEFAULT_CSINDEX)
         #undef CHECK_ARG_FOR_PRUNE_MODE
     }
@@ -1135,6 +1188,7 @@ bool AppInitParameterInteraction(const ArgsManager& args, bool use_syscall_sandb
         LogPrintf("Prune configured to target %u MiB on disk for block and undo files.\n", nPruneTarget / 1024 / 1024);
         fPruneMode = true;
     }
+    fCompressBlockFiles = args.GetBoolArg("-blockfilecompression", DEFAULT_BLOCKFILE_COMPRESSION);
 
     nConnectTimeout = args.GetIntArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0) {
@@ -1215,6 +1269,9 @@ bool AppInitParameterInteraction(const ArgsManager& args, bool use_syscall_sandb
         if (args.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
             return InitError(_("-reindex-chainstate option is not compatible with -coinstatsindex. Please temporarily disable coinstatsindex while using -reindex-chainstate, or replace -reindex-chainstate with -reindex to fully rebuild all indexes."));
         }
+        if (args.GetBoolArg("-coinscriptstatsindex", DEFAULT_COINSCRIPTSTATSINDEX)) {
+            return InitError(_("-reindex-chainstate option is not compatible with -coinscriptstatsindex. Please temporarily disable coinscriptstatsindex while using -reindex-chainstate, or replace -reindex-chainstate with -reindex to fully rebuild all indexes."));
+        }
         if (g_enabled_filter_types.count(BlockFilterType::BASIC)) {
             return InitError(_("-reindex-chainstate option is not compatible with -blockfilterindex. Please temporarily disable blockfilterindex while using -reindex-chainstate, or replace -reindex-chainstate with -reindex to fully rebuild all indexes."));
         }
@@ -1343,6 +1400,10 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitRangeProofCache();
+    if (fParticlMode) {
+        StartEphemeralKeyPool(std::max<int64_t>(0, args.GetIntArg("-ephemeralkeypool", DEFAULT_EPHEMERAL_KEYPOOL)));
+    }
 
     int script_threads = args.GetIntArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (script_threads <= 0) {
@@ -1358,6 +1419,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     script_threads = std::min(script_threads, MAX_SCRIPTCHECK_THREADS);
 
     LogPrintf("Script verification uses %d additional threads\n", script_threads);
+    g_block_validation_stats.SetMaxBlocks(std::max<int64_t>(0, args.GetIntArg("-blockvalidationstats", DEFAULT_BLOCK_VALIDATION_STATS)));
     if (script_threads >= 1) {
         g_parallel_script_checks = true;
         StartScriptCheckWorkerThreads(script_threads);
@@ -1374,7 +1436,8 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         RandAddPeriodic();
     }, std::chrono::minutes{1});
 
-    GetMainSignals().RegisterBackgroundSignalScheduler(*node.scheduler);
+    const int notification_threads = std::clamp<int64_t>(args.GetIntArg("-notificationthreads", DEFAULT_NOTIFICATION_THREADS), 0, MAX_NOTIFICATION_THREADS);
+    GetMainSignals().RegisterBackgroundSignalScheduler(*node.scheduler, notification_threads);
 
     // Create client interfaces for wallets that are supposed to be loaded
     // according to -wallet and -disablewallet options. This only constructs
@@ -1581,7 +1644,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
-        RegisterValidationInterface(g_zmq_notification_interface);
+        RegisterValidationInterface(g_zmq_notification_interface, /*own_queue=*/true);
     }
 #endif
 
@@ -1625,6 +1688,10 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
 
     for (bool fLoaded = false; !fLoaded && !ShutdownRequestedMainThread();) {
         node.mempool = std::make_unique<CTxMemPool>(node.fee_estimator.get(), mempool_check_ratio);
+        if (args.GetBoolArg("-mempoolspillproofs", DEFAULT_MEMPOOL_SPILL_PROOFS) &&
+            !node.mempool->EnableProofSpill(args.GetDataDirNet() / "mempool_proofs.dat")) {
+            return InitError(_("Unable to open the mempool proofs file."));
+        }
 
         const ChainstateManager::Options chainman_opts{
             chainparams,
@@ -1681,14 +1748,11 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
             case ChainstateLoadingError::ERROR_SPENTINDEX_NEEDS_REINDEX:
                 strLoadError = _("You need to rebuild the database using -reindex to change -spentindex.  This will redownload the entire blockchain");
                 break;
-            case ChainstateLoadingError::ERROR_TIMESTAMPINDEX_NEEDS_REINDEX:
-                strLoadError = _("You need to rebuild the database using -reindex to change -timestampindex.  This will redownload the entire blockchain");
-                break;
             case ChainstateLoadingError::ERROR_BALANCESINDEX_NEEDS_REINDEX:
                 strLoadError = _("You need to rebuild the database using -reindex to change -balancesindex.  This will redownload the entire blockchain");
                 break;
-            case ChainstateLoadingError::ERROR_REBUILD_ROLLING_FAILED:
-                strLoadError = _("Error rebuilding rolling indices by rewinding the chain, a reindex is required.");
+            case ChainstateLoadingError::ERROR_BLOCKREWARDINDEX_NEEDS_REINDEX:
+                strLoadError = _("You need to rebuild the database using -reindex to change -blockrewardindex.  This will redownload the entire blockchain");
                 break;
             case ChainstateLoadingError::ERROR_LOAD_GENESIS_BLOCK_FAILED:
                 strLoadError = _("Error initializing block database");
@@ -1787,6 +1851,16 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     RegisterValidationInterface(node.peerman.get());
     chainman.m_peerman = node.peerman.get();
 
+    assert(!node.block_template_cache);
+    node.block_template_cache = std::make_unique<BlockTemplateCache>(chainman, *node.mempool, *node.scheduler);
+    RegisterValidationInterface(node.block_template_cache.get());
+
+    if (args.GetBoolArg("-spentindex", particl::DEFAULT_SPENTINDEX)) {
+        assert(!node.block_deltas_cache);
+        node.block_deltas_cache = std::make_unique<BlockDeltasCache>(chainman);
+        RegisterValidationInterface(node.block_deltas_cache.get());
+    }
+
     // ********************************************************* Step 8: start indexers
     if (args.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         if (const auto error{WITH_LOCK(cs_main, return CheckLegacyTxindex(*Assert(chainman.m_blockman.m_block_tree_db)))}) {
@@ -1820,6 +1894,20 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         }
     }
 
+    if (args.GetBoolArg("-coinscriptstatsindex", DEFAULT_COINSCRIPTSTATSINDEX)) {
+        g_coin_script_stats_index = std::make_unique<CoinScriptStatsIndex>(/* cache size */ 0, false, fReindex);
+        if (!g_coin_script_stats_index->Start(chainman.ActiveChainstate())) {
+            return false;
+        }
+    }
+
+    if (args.GetBoolArg("-timestampindex", particl::DEFAULT_TIMESTAMPINDEX)) {
+        g_timestamp_index = std::make_unique<TimestampIndex>(/* cache size */ 0, false, fReindex);
+        if (!g_timestamp_index->Start(chainman.ActiveChainstate())) {
+            return false;
+        }
+    }
+
     // ********************************************************* Step 9: load wallet
     for (const auto& client : node.chain_clients) {
         if (!client->load()) {
@@ -10,6 +10,9 @@
 #include <consensus/amount.h>
 #include <script/script.h>
 
+#include <limits>
+#include <utility>
+
 enum AddressIndexType {
     ADDR_INDT_UNKNOWN                = 0,
     ADDR_INDT_PUBKEY_ADDRESS         = 1,
@@ -97,6 +100,86 @@ struct CAddressUnspentValue {
     }
 };
 
+/** CAddressUnspentKey ordered by value as stored under DB_ADDRESSUNSPENTVALUEINDEX, largest value first */
+struct CAddressUnspentValueKey {
+    unsigned int type;
+    uint256 hashBytes;
+    CAmount satoshis;
+    uint256 txhash;
+    uint32_t index;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s);
+        // Inverted big-endian so larger values sort first
+        uint64_t inverted = ~(uint64_t)satoshis;
+        ser_writedata32be(s, inverted >> 32);
+        ser_writedata32be(s, inverted & 0xffffffff);
+        txhash.Serialize(s);
+        ser_writedata32(s, index);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s);
+        uint64_t inverted = (uint64_t)ser_readdata32be(s) << 32;
+        inverted |= ser_readdata32be(s);
+        satoshis = (CAmount)~inverted;
+        txhash.Unserialize(s);
+        index = ser_readdata32(s);
+    }
+
+    CAddressUnspentValueKey(const CAddressUnspentKey &key, CAmount value) {
+        type = key.type;
+        hashBytes = key.hashBytes;
+        satoshis = value;
+        txhash = key.txhash;
+        index = key.index;
+    }
+
+    CAddressUnspentValueKey(unsigned int addressType, uint256 addressHash, CAmount value) {
+        type = addressType;
+        hashBytes = addressHash;
+        satoshis = value;
+        txhash.SetNull();
+        index = 0;
+    }
+
+    CAddressUnspentValueKey() : CAddressUnspentValueKey(ADDR_INDT_UNKNOWN, uint256(), 0) {}
+};
+
+/** The order of DB_ADDRESSUNSPENTVALUEINDEX, largest value first and then by outpoint */
+inline bool AddressUnspentValueOrder(const std::pair<CAddressUnspentKey, CAddressUnspentValue> &a,
+                                     const std::pair<CAddressUnspentKey, CAddressUnspentValue> &b)
+{
+    if (a.second.satoshis != b.second.satoshis) {
+        return a.second.satoshis > b.second.satoshis;
+    }
+    if (a.first.txhash != b.first.txhash) {
+        return a.first.txhash < b.first.txhash;
+    }
+    return a.first.index < b.first.index;
+}
+
+/** Unspent outputs getaddressutxos returns, applied while the index is read */
+struct CAddressUnspentFilter {
+    CAmount min_satoshis = 0;
+    CAmount max_satoshis = MAX_MONEY;
+    int min_height = 0;
+    int max_height = std::numeric_limits<int>::max();
+    bool standard = true;
+    bool blind = true;      // Blinded outputs are indexed with a zero value
+
+    bool Matches(const CAddressUnspentValue &value) const {
+        if (value.satoshis == 0 ? !blind : !standard) {
+            return false;
+        }
+        return value.satoshis >= min_satoshis && value.satoshis <= max_satoshis
+            && value.blockHeight >= min_height && value.blockHeight <= max_height;
+    }
+};
+
 struct CAddressIndexKey {
     unsigned int type;
     uint256 hashBytes;
@@ -192,6 +275,31 @@ struct CAddressIndexIteratorKey {
     }
 };
 
+/** Running totals per address, keyed by CAddressIndexIteratorKey */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+
+    SERIALIZE_METHODS(CAddressBalanceValue, obj)
+    {
+        READWRITE(obj.balance);
+        READWRITE(obj.received);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+    }
+
+    bool IsNull() const {
+        return balance == 0 && received == 0;
+    }
+};
+
 struct CAddressIndexIteratorHeightKey {
     unsigned int type;
     uint256 hashBytes;
@@ -230,6 +338,133 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/**
+ * Order preserving variable length integer, values below 0xf0 take one byte.
+ * Larger values are prefixed by 0xef + the number of big-endian bytes that follow.
+ */
+template<typename Stream>
+void WriteOrderedVarInt(Stream& s, uint32_t v)
+{
+    if (v < 0xf0) {
+        ser_writedata8(s, v);
+        return;
+    }
+    int n = v <= 0xff ? 1 : v <= 0xffff ? 2 : v <= 0xffffff ? 3 : 4;
+    ser_writedata8(s, 0xef + n);
+    for (int i = n - 1; i >= 0; --i) {
+        ser_writedata8(s, (v >> (8 * i)) & 0xff);
+    }
+}
+
+template<typename Stream>
+uint32_t ReadOrderedVarInt(Stream& s)
+{
+    uint8_t prefix = ser_readdata8(s);
+    if (prefix < 0xf0) {
+        return prefix;
+    }
+    int n = prefix - 0xef;
+    if (n > 4) {
+        throw std::ios_base::failure("ReadOrderedVarInt(): invalid prefix");
+    }
+    uint32_t v = 0;
+    for (int i = 0; i < n; ++i) {
+        v = (v << 8) | ser_readdata8(s);
+    }
+    return v;
+}
+
+/** 160 bit address types are stored without the zero padding in compact keys */
+inline size_t GetAddressIndexHashSize(unsigned int type)
+{
+    switch (type) {
+        case ADDR_INDT_PUBKEY_ADDRESS:
+        case ADDR_INDT_SCRIPT_ADDRESS:
+        case ADDR_INDT_WITNESS_V0_KEYHASH:
+            return 20;
+        default:
+            return 32;
+    }
+}
+
+template<typename Stream>
+void SerializeAddressIndexHash(Stream& s, unsigned int type, const uint256& hash)
+{
+    ser_writedata8(s, type);
+    s.write(AsBytes(Span{hash.begin(), GetAddressIndexHashSize(type)}));
+}
+
+template<typename Stream>
+void UnserializeAddressIndexHash(Stream& s, unsigned int& type, uint256& hash)
+{
+    type = ser_readdata8(s);
+    hash.SetNull();
+    s.read(AsWritableBytes(Span{hash.begin(), GetAddressIndexHashSize(type)}));
+}
+
+/**
+ * CAddressIndexKey as stored under DB_ADDRESSINDEX_COMPACT.
+ * Heights, txindex and the output index are ordered varints so keys still sort by height.
+ */
+struct CAddressIndexCompactKey {
+    CAddressIndexKey key;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        SerializeAddressIndexHash(s, key.type, key.hashBytes);
+        WriteOrderedVarInt(s, key.blockHeight);
+        WriteOrderedVarInt(s, key.txindex);
+        key.txhash.Serialize(s);
+        WriteOrderedVarInt(s, (key.index << 1) | key.spending);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        UnserializeAddressIndexHash(s, key.type, key.hashBytes);
+        key.blockHeight = (int)ReadOrderedVarInt(s);
+        key.txindex = ReadOrderedVarInt(s);
+        key.txhash.Unserialize(s);
+        uint32_t index_spending = ReadOrderedVarInt(s);
+        key.index = index_spending >> 1;
+        key.spending = index_spending & 1;
+    }
+
+    explicit CAddressIndexCompactKey(const CAddressIndexKey& k) : key(k) {}
+    CAddressIndexCompactKey() {}
+};
+
+struct CAddressIndexCompactIteratorKey {
+    unsigned int type;
+    uint256 hashBytes;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        SerializeAddressIndexHash(s, type, hashBytes);
+    }
+
+    CAddressIndexCompactIteratorKey(unsigned int addressType, uint256 addressHash) {
+        type = addressType;
+        hashBytes = addressHash;
+    }
+};
+
+struct CAddressIndexCompactIteratorHeightKey {
+    unsigned int type;
+    uint256 hashBytes;
+    int blockHeight;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        SerializeAddressIndexHash(s, type, hashBytes);
+        WriteOrderedVarInt(s, blockHeight);
+    }
+
+    CAddressIndexCompactIteratorHeightKey(unsigned int addressType, uint256 addressHash, int height) {
+        type = addressType;
+        hashBytes = addressHash;
+        blockHeight = height;
+    }
+};
+
 struct CMempoolAddressDelta
 {
     int64_t time;
@@ -40,4 +40,21 @@ public:
     }
 };
 
+/** Height keyed copy of the balances index, big endian so a cursor walks the heights in order */
+struct BlockBalancesHeightKey {
+    uint32_t height = 0;
+
+    explicit BlockBalancesHeightKey(uint32_t height_in) : height(height_in) {}
+    BlockBalancesHeightKey() {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata32be(s, height);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        height = ser_readdata32be(s);
+    }
+};
+
 #endif // PARTICL_INSIGHT_BALANCEINDEX_H
@@ -0,0 +1,248 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <insight/blockdeltas.h>
+
+#include <insight/insight.h>
+#include <insight/spentindex.h>
+#include <key_io.h>
+#include <logging.h>
+#include <primitives/block.h>
+#include <rpc/protocol.h>
+#include <rpc/request.h>
+#include <script/standard.h>
+#include <util/strencodings.h>
+#include <version.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <thread>
+
+/** The address types getblockdeltas reports for outputs */
+static void SetAddress(const CScript &script, BlockDeltasOutput &output)
+{
+    if (script.IsPayToScriptHash()) {
+        output.address_type = ADDR_INDT_SCRIPT_ADDRESS;
+        memcpy(output.address_hash.begin(), script.data() + 2, 20);
+    } else
+    if (script.IsPayToPublicKeyHash()) {
+        output.address_type = ADDR_INDT_PUBKEY_ADDRESS;
+        memcpy(output.address_hash.begin(), script.data() + 3, 20);
+    } else
+    if (script.IsPayToScriptHash256()) {
+        output.address_type = ADDR_INDT_SCRIPT_ADDRESS_256;
+        memcpy(output.address_hash.begin(), script.data() + 2, 32);
+    } else
+    if (script.IsPayToPublicKeyHash256()) {
+        output.address_type = ADDR_INDT_PUBKEY_ADDRESS_256;
+        memcpy(output.address_hash.begin(), script.data() + 3, 32);
+    }
+}
+
+static void AddAddress(const BlockDeltasOutput &output, UniValue &uv)
+{
+    std::string address;
+    if (output.address_type != ADDR_INDT_UNKNOWN && getAddressFromIndex(output.address_type, output.address_hash, address)) {
+        uv.pushKV("address", address);
+    }
+}
+
+/** Resolve the prevouts of the block's inputs, large blocks are split over threads */
+static bool ResolvePrevouts(ChainstateManager &chainman, const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values, const CTxMemPool *pmempool)
+{
+    size_t num_threads = std::min<size_t>(MAX_BLOCK_DELTAS_THREADS, (keys.size() + BLOCK_DELTAS_KEYS_PER_THREAD - 1) / BLOCK_DELTAS_KEYS_PER_THREAD);
+    if (num_threads <= 1) {
+        return GetSpentIndex(chainman, keys, values, pmempool);
+    }
+    values.resize(keys.size());
+    size_t per_thread = (keys.size() + num_threads - 1) / num_threads;
+    std::vector<char> ok(num_threads, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            size_t begin = t * per_thread, end = std::min(keys.size(), begin + per_thread);
+            std::vector<CSpentIndexKey> part(keys.begin() + begin, keys.begin() + end);
+            std::vector<CSpentIndexValue> part_values;
+            ok[t] = GetSpentIndex(chainman, part, part_values, pmempool);
+            std::move(part_values.begin(), part_values.end(), values.begin() + begin);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return std::all_of(ok.begin(), ok.end(), [](char v) { return v; });
+}
+
+void GetBlockDeltasRecord(const CBlock &block, BlockDeltasRecord &record)
+{
+    record.block_size = ::GetSerializeSize(block, PROTOCOL_VERSION);
+    record.txns.clear();
+    record.txns.reserve(block.vtx.size());
+    for (const auto &tx : block.vtx) {
+        BlockDeltasTx &entry = record.txns.emplace_back();
+        entry.txid = tx->GetHash();
+        if (!tx->IsCoinBase()) {
+            for (const auto &input : tx->vin) {
+                entry.prevouts.push_back(input.prevout);
+            }
+        }
+        for (unsigned int k = 0; k < tx->vpout.size(); k++) {
+            const CTxOutBase *out = tx->vpout[k].get();
+            BlockDeltasOutput output;
+            output.n = k;
+            output.type = out->GetType();
+            switch (output.type) {
+                case OUTPUT_STANDARD:
+                    {
+                    const CTxOutStandard *s = (const CTxOutStandard*) out;
+                    output.value = s->nValue;
+                    SetAddress(s->scriptPubKey, output);
+                    }
+                    break;
+                case OUTPUT_CT:
+                    {
+                    const CTxOutCT *s = (const CTxOutCT*) out;
+                    output.data.assign(s->commitment.data, s->commitment.data + 33);
+                    SetAddress(s->scriptPubKey, output);
+                    }
+                    break;
+                case OUTPUT_RINGCT:
+                    {
+                    const CTxOutRingCT *s = (const CTxOutRingCT*) out;
+                    output.data.assign(s->pk.begin(), s->pk.begin() + 33);
+                    output.data.insert(output.data.end(), s->commitment.data, s->commitment.data + 33);
+                    }
+                    break;
+                default:
+                    continue;
+            }
+            entry.outputs.push_back(std::move(output));
+        }
+    }
+}
+
+UniValue BlockToDeltas(ChainstateManager &chainman, const BlockDeltasRecord &record, const CTxMemPool *pmempool)
+{
+    std::vector<CSpentIndexKey> keys;
+    for (const auto &tx : record.txns) {
+        for (const auto &prevout : tx.prevouts) {
+            keys.emplace_back(prevout.hash, prevout.n);
+        }
+    }
+    std::vector<CSpentIndexValue> spent_values;
+    if (!ResolvePrevouts(chainman, keys, spent_values, pmempool)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Spent information not available");
+    }
+
+    UniValue deltas(UniValue::VARR);
+    size_t spent_pos = 0;
+    for (unsigned int i = 0; i < record.txns.size(); i++) {
+        const BlockDeltasTx &tx = record.txns[i];
+
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", tx.txid.GetHex());
+        entry.pushKV("index", (int)i);
+
+        UniValue inputs(UniValue::VARR);
+
+        for (size_t j = 0; j < tx.prevouts.size(); j++) {
+            const COutPoint &prevout = tx.prevouts[j];
+            const CSpentIndexValue &spentInfo = spent_values[spent_pos++];
+
+            UniValue delta(UniValue::VOBJ);
+
+            if (spentInfo.IsNull()) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Spent information not available");
+            }
+            std::string address;
+            if (!getAddressFromIndex(spentInfo.addressType, spentInfo.addressHash, address)) {
+                continue;
+            }
+            delta.pushKV("address", address);
+            delta.pushKV("satoshis", -1 * spentInfo.satoshis);
+            delta.pushKV("index", (int)j);
+            delta.pushKV("prevtxid", prevout.hash.GetHex());
+            delta.pushKV("prevout", (int)prevout.n);
+
+            inputs.push_back(delta);
+        }
+
+        entry.pushKV("inputs", inputs);
+
+        UniValue outputs(UniValue::VARR);
+
+        for (const auto &out : tx.outputs) {
+            UniValue delta(UniValue::VOBJ);
+
+            delta.pushKV("index", (int)out.n);
+
+            switch (out.type)
+            {
+                case OUTPUT_STANDARD:
+                    delta.pushKV("type", "standard");
+                    delta.pushKV("satoshis", out.value);
+                    AddAddress(out, delta);
+                    break;
+                case OUTPUT_CT:
+                    delta.pushKV("type", "blind");
+                    delta.pushKV("valueCommitment", HexStr(out.data));
+                    AddAddress(out, delta);
+                    break;
+                case OUTPUT_RINGCT:
+                    if (out.data.size() != 66) {
+                        continue;
+                    }
+                    delta.pushKV("type", "anon");
+                    delta.pushKV("pubkey", HexStr(Span<const uint8_t>(out.data.data(), 33)));
+                    delta.pushKV("valueCommitment", HexStr(Span<const uint8_t>(out.data.data() + 33, 33)));
+                    break;
+                default:
+                    continue;
+            };
+
+            outputs.push_back(delta);
+        }
+
+        entry.pushKV("outputs", outputs);
+        deltas.push_back(entry);
+    }
+    return deltas;
+}
+
+bool BlockDeltasCache::Lookup(const uint256 &block_hash, UniValue &deltas, unsigned int &block_size)
+{
+    std::pair<UniValue, unsigned int> entry;
+    if (!WITH_LOCK(m_mutex, return m_deltas.Get(block_hash, entry))) {
+        return false;
+    }
+    deltas = std::move(entry.first);
+    block_size = entry.second;
+    return true;
+}
+
+void BlockDeltasCache::Add(const uint256 &block_hash, const UniValue &deltas, unsigned int block_size)
+{
+    LOCK(m_mutex);
+    m_deltas.Insert(block_hash, std::make_pair(deltas, block_size));
+}
+
+void BlockDeltasCache::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+{
+    if (m_chainman.ActiveChainstate().IsInitialBlockDownload()) {
+        return;
+    }
+    try {
+        BlockDeltasRecord record;
+        GetBlockDeltasRecord(*block, record);
+        Add(block->GetHash(), BlockToDeltas(m_chainman, record, nullptr), record.block_size);
+    } catch (const UniValue &e) {
+        // The block may have been disconnected since, its spent info is gone
+        LogPrint(BCLog::RPC, "%s: Skipped block %s, %s\n", __func__, block->GetHash().ToString(), find_value(e, "message").get_str());
+    }
+}
+
+void BlockDeltasCache::BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+{
+    WITH_LOCK(m_mutex, m_deltas.Erase(block->GetHash()));
+}
@@ -0,0 +1,143 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_INSIGHT_BLOCKDELTAS_H
+#define PARTICL_INSIGHT_BLOCKDELTAS_H
+
+#include <compressor.h>
+#include <insight/addressindex.h>
+#include <lrucache.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+#include <univalue.h>
+#include <util/hasher.h>
+#include <validationinterface.h>
+
+#include <utility>
+#include <vector>
+
+class CBlock;
+class CTxMemPool;
+class ChainstateManager;
+
+/** Connected blocks getblockdeltas keeps the deltas of */
+static constexpr size_t BLOCK_DELTAS_CACHE_SIZE{100};
+/** Prevouts resolved per thread when building the deltas of a large block */
+static constexpr size_t BLOCK_DELTAS_KEYS_PER_THREAD{500};
+static constexpr int MAX_BLOCK_DELTAS_THREADS{4};
+
+/** An output as reported by getblockdeltas */
+struct BlockDeltasOutput
+{
+    uint32_t n = 0;
+    uint8_t type = 0;                   // OUTPUT_STANDARD, OUTPUT_CT or OUTPUT_RINGCT
+    CAmount value = 0;                  // Standard outputs only
+    std::vector<uint8_t> data;          // Value commitment, prefixed by the public key of anon outputs
+    uint8_t address_type = ADDR_INDT_UNKNOWN;
+    uint256 address_hash;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << VARINT(n);
+        ser_writedata8(s, type);
+        if (type == OUTPUT_STANDARD) {
+            s << Using<AmountCompression>(value);
+        }
+        s << data;
+        // 160 bit hashes are stored without the zero padding
+        ser_writedata8(s, address_type);
+        if (address_type != ADDR_INDT_UNKNOWN) {
+            s.write(AsBytes(Span{address_hash.begin(), GetAddressIndexHashSize(address_type)}));
+        }
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> VARINT(n);
+        type = ser_readdata8(s);
+        value = 0;
+        if (type == OUTPUT_STANDARD) {
+            s >> Using<AmountCompression>(value);
+        }
+        s >> data;
+        address_type = ser_readdata8(s);
+        address_hash.SetNull();
+        if (address_type != ADDR_INDT_UNKNOWN) {
+            s.read(AsWritableBytes(Span{address_hash.begin(), GetAddressIndexHashSize(address_type)}));
+        }
+    }
+};
+
+struct BlockDeltasTx
+{
+    uint256 txid;
+    std::vector<COutPoint> prevouts;    // Empty for the coinbase
+    std::vector<BlockDeltasOutput> outputs;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << txid;
+        WriteCompactSize(s, prevouts.size());
+        for (const auto &prevout : prevouts) {
+            s << prevout.hash << VARINT(prevout.n);
+        }
+        s << outputs;
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> txid;
+        prevouts.resize(ReadCompactSize(s));
+        for (auto &prevout : prevouts) {
+            s >> prevout.hash >> VARINT(prevout.n);
+        }
+        s >> outputs;
+    }
+};
+
+/**
+ * What getblockdeltas reports of a block, kept in the index db when pruning so the deltas outlive the block file.
+ * Signatures, rangeproofs, scripts and data outputs are left out, the inputs are resolved through the spent index.
+ */
+struct BlockDeltasRecord
+{
+    uint32_t block_size = 0;
+    std::vector<BlockDeltasTx> txns;
+
+    SERIALIZE_METHODS(BlockDeltasRecord, obj)
+    {
+        READWRITE(VARINT(obj.block_size), obj.txns);
+    }
+};
+
+/** Extract the fields getblockdeltas reports */
+void GetBlockDeltasRecord(const CBlock &block, BlockDeltasRecord &record);
+
+/** Build the deltas array of getblockdeltas, throws a JSONRPCError if the spent info of an input is missing */
+UniValue BlockToDeltas(ChainstateManager &chainman, const BlockDeltasRecord &record, const CTxMemPool *pmempool);
+
+/**
+ * Deltas of recent blocks for getblockdeltas, explorers request the same blocks many times.
+ * Built when a block is connected after the initial sync, dropped when it's disconnected.
+ */
+class BlockDeltasCache final : public CValidationInterface
+{
+public:
+    explicit BlockDeltasCache(ChainstateManager &chainman) : m_chainman(chainman) {}
+
+    /** The deltas and serialized size of the block, false if not cached */
+    bool Lookup(const uint256 &block_hash, UniValue &deltas, unsigned int &block_size) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void Add(const uint256 &block_hash, const UniValue &deltas, unsigned int block_size) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    ChainstateManager &m_chainman;
+    Mutex m_mutex;
+    LRUCache<uint256, std::pair<UniValue, unsigned int>, SaltedTxidHasher> m_deltas GUARDED_BY(m_mutex){BLOCK_DELTAS_CACHE_SIZE};
+};
+
+#endif // PARTICL_INSIGHT_BLOCKDELTAS_H
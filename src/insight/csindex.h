@@ -5,11 +5,19 @@
 #ifndef PARTICL_INSIGHT_CSINDEX_H
 #define PARTICL_INSIGHT_CSINDEX_H
 
+#include <consensus/amount.h>
 #include <script/standard.h>
+#include <serialize.h>
 
 constexpr uint8_t DB_TXINDEX_CSOUTPUT{'O'};
 constexpr uint8_t DB_TXINDEX_CSLINK{'L'};
 constexpr uint8_t DB_TXINDEX_CSBESTBLOCK{'C'};
+constexpr uint8_t DB_TXINDEX_CSSTAKETOTAL{'A'};
+constexpr uint8_t DB_TXINDEX_CSSPENDTOTAL{'P'};
+constexpr uint8_t DB_TXINDEX_CSTOTALSVERSION{'V'};
+
+/** Bumped to rebuild the totals from the indexed outputs on startup */
+constexpr int CSINDEX_TOTALS_VERSION{1};
 
 enum CSIndexFlags
 {
@@ -42,22 +50,15 @@ public:
     }
 };
 
-class ColdStakeIndexOutputValue
+inline size_t GetCSStakeIdSize(TxoutType stake_type)
 {
-public:
-    CAmount m_value = 0;
-    uint8_t m_flags = 0; // Mark outputs resulting from coldstaking
-    int m_spend_height = -1;
-    uint256 m_spend_txid;
+    return stake_type == TxoutType::PUBKEYHASH256 ? 32 : 20;
+}
 
-    SERIALIZE_METHODS(ColdStakeIndexOutputValue, obj)
-    {
-        READWRITE(obj.m_value);
-        READWRITE(obj.m_flags);
-        READWRITE(obj.m_spend_height);
-        READWRITE(obj.m_spend_txid);
-    }
-};
+inline size_t GetCSSpendIdSize(TxoutType spend_type)
+{
+    return (spend_type == TxoutType::PUBKEYHASH256 || spend_type == TxoutType::SCRIPTHASH256) ? 32 : 20;
+}
 
 class ColdStakeIndexLinkKey
 {
@@ -69,22 +70,22 @@ public:
     template<typename Stream>
     void Serialize(Stream& s) const {
         ser_writedata8(s, particl::FromTxoutType(m_stake_type));
-        s.write(AsBytes(Span{(char*)m_stake_id.begin(), size_t((m_stake_type == TxoutType::PUBKEYHASH256) ? 32 : 20)}));
+        s.write(AsBytes(Span{(char*)m_stake_id.begin(), GetCSStakeIdSize(m_stake_type)}));
         ser_writedata32be(s, m_height);
         ser_writedata8(s, particl::FromTxoutType(m_spend_type));
-        s.write(AsBytes(Span{(char*)m_spend_id.begin(), size_t((m_spend_type == TxoutType::PUBKEYHASH256 || m_spend_type == TxoutType::SCRIPTHASH256) ? 32 : 20)}));
+        s.write(AsBytes(Span{(char*)m_spend_id.begin(), GetCSSpendIdSize(m_spend_type)}));
     }
     template<typename Stream>
     void Unserialize(Stream& s) {
         uint8_t stake_type = ser_readdata8(s);
         m_stake_type = particl::ToTxoutType(stake_type);
         m_stake_id.SetNull();
-        s.read(AsWritableBytes(Span{m_stake_id.begin(), size_t((m_stake_type == TxoutType::PUBKEYHASH256) ? 32 : 20)}));
+        s.read(AsWritableBytes(Span{m_stake_id.begin(), GetCSStakeIdSize(m_stake_type)}));
         m_height = ser_readdata32be(s);
         uint8_t spend_type = ser_readdata8(s);
         m_spend_type = particl::ToTxoutType(spend_type);
         m_spend_id.SetNull();
-        s.read(AsWritableBytes(Span{m_spend_id.begin(), size_t((m_spend_type == TxoutType::PUBKEYHASH256 || m_spend_type == TxoutType::SCRIPTHASH256) ? 32 : 20)}));
+        s.read(AsWritableBytes(Span{m_spend_id.begin(), GetCSSpendIdSize(m_spend_type)}));
     }
 
     friend bool operator<(const ColdStakeIndexLinkKey& a, const ColdStakeIndexLinkKey& b) {
@@ -98,4 +99,112 @@ public:
     }
 };
 
+class ColdStakeIndexOutputValue
+{
+public:
+    CAmount m_value = 0;
+    uint8_t m_flags = 0; // Mark outputs resulting from coldstaking
+    int m_spend_height = -1;
+    uint256 m_spend_txid;
+    // Rows written before the totals were added end here
+    bool m_have_link = false;
+    ColdStakeIndexLinkKey m_link;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << m_value << m_flags << m_spend_height << m_spend_txid;
+        if (m_have_link) {
+            s << m_link;
+        }
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> m_value >> m_flags >> m_spend_height >> m_spend_txid;
+        m_have_link = !s.empty();
+        if (m_have_link) {
+            s >> m_link;
+        }
+    }
+};
+
+/** Key of the totals per staking key (DB_TXINDEX_CSSTAKETOTAL), also the prefix of ColdStakeIndexSpendKey */
+class ColdStakeIndexStakeKey
+{
+public:
+    TxoutType m_stake_type = TxoutType::NONSTANDARD;
+    CKeyID256 m_stake_id;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, particl::FromTxoutType(m_stake_type));
+        s.write(AsBytes(Span{m_stake_id.begin(), GetCSStakeIdSize(m_stake_type)}));
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        m_stake_type = particl::ToTxoutType(ser_readdata8(s));
+        m_stake_id.SetNull();
+        s.read(AsWritableBytes(Span{m_stake_id.begin(), GetCSStakeIdSize(m_stake_type)}));
+    }
+
+    friend bool operator<(const ColdStakeIndexStakeKey& a, const ColdStakeIndexStakeKey& b) {
+        if (a.m_stake_type != b.m_stake_type) return a.m_stake_type < b.m_stake_type;
+        return a.m_stake_id.Compare(b.m_stake_id) < 0;
+    }
+};
+
+/** Key of the totals per staking and spending key pair (DB_TXINDEX_CSSPENDTOTAL) */
+class ColdStakeIndexSpendKey : public ColdStakeIndexStakeKey
+{
+public:
+    TxoutType m_spend_type = TxoutType::NONSTANDARD;
+    CKeyID256 m_spend_id;
+
+    ColdStakeIndexSpendKey() {};
+    explicit ColdStakeIndexSpendKey(const ColdStakeIndexLinkKey &lk)
+    {
+        m_stake_type = lk.m_stake_type;
+        m_stake_id = lk.m_stake_id;
+        m_spend_type = lk.m_spend_type;
+        m_spend_id = lk.m_spend_id;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ColdStakeIndexStakeKey::Serialize(s);
+        ser_writedata8(s, particl::FromTxoutType(m_spend_type));
+        s.write(AsBytes(Span{m_spend_id.begin(), GetCSSpendIdSize(m_spend_type)}));
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        ColdStakeIndexStakeKey::Unserialize(s);
+        m_spend_type = particl::ToTxoutType(ser_readdata8(s));
+        m_spend_id.SetNull();
+        s.read(AsWritableBytes(Span{m_spend_id.begin(), GetCSSpendIdSize(m_spend_type)}));
+    }
+
+    friend bool operator<(const ColdStakeIndexSpendKey& a, const ColdStakeIndexSpendKey& b) {
+        if (a.m_stake_type != b.m_stake_type) return a.m_stake_type < b.m_stake_type;
+        int cmp = a.m_stake_id.Compare(b.m_stake_id);
+        if (cmp != 0) return cmp < 0;
+        if (a.m_spend_type != b.m_spend_type) return a.m_spend_type < b.m_spend_type;
+        return a.m_spend_id.Compare(b.m_spend_id) < 0;
+    }
+};
+
+/** Unspent coldstake outputs and their value */
+class ColdStakeIndexTotal
+{
+public:
+    int64_t m_num_unspent = 0;
+    CAmount m_value = 0;
+
+    SERIALIZE_METHODS(ColdStakeIndexTotal, obj)
+    {
+        READWRITE(obj.m_num_unspent);
+        READWRITE(obj.m_value);
+    }
+
+    bool IsNull() const { return m_num_unspent == 0 && m_value == 0; }
+};
+
 #endif // PARTICL_INSIGHT_CSINDEX_H
@@ -6,6 +6,7 @@
 #include <insight/addressindex.h>
 #include <insight/spentindex.h>
 #include <insight/timestampindex.h>
+#include <index/timestampindex.h>
 #include <validation.h>
 #include <txdb.h>
 #include <txmempool.h>
@@ -18,10 +19,13 @@
 #include <script/interpreter.h>
 #include <util/system.h>
 
+#include <algorithm>
+
 bool fAddressIndex = false;
-bool fTimestampIndex = false;
+bool fAddressBalanceIndex = false;
 bool fSpentIndex = false;
 bool fBalancesIndex = false;
+bool fBlockRewardIndex = false;
 
 bool ExtractIndexInfo(const CScript *pScript, int &scriptType, std::vector<uint8_t> &hashBytes)
 {
@@ -82,35 +86,51 @@ bool ExtractIndexInfo(const CTxOutBase *out, int &scriptType, std::vector<uint8_
     return true;
 };
 
-static bool HashOnchainActive(ChainstateManager &chainman, const uint256 &hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+/** Active chain blocks with low <= nTime < high from the block index, ordered as the timestamp index orders them */
+static void GetActiveChainTimestamps(const CChain &chain, unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> > &hashes) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    CBlockIndex* pblockindex = chainman.m_blockman.LookupBlockIndex(hash);
-
-    if (!chainman.ActiveChain().Contains(pblockindex)) {
-        return false;
+    // nTimeMax is monotonic, earlier blocks are all older than low
+    for (const CBlockIndex *pindex = chain.FindEarliestAtLeast(low, 0); pindex; pindex = chain.Next(pindex)) {
+        if (pindex->nTime >= high) {
+            // Later blocks must be newer than this median time past
+            if (pindex->GetMedianTimePast() >= high) {
+                break;
+            }
+            continue;
+        }
+        if (pindex->nTime >= low) {
+            hashes.emplace_back(pindex->GetBlockHash(), pindex->nTime);
+        }
     }
+    std::sort(hashes.begin(), hashes.end(), [](const std::pair<uint256, unsigned int> &a, const std::pair<uint256, unsigned int> &b) {
+        return a.second != b.second ? a.second < b.second : a.first < b.first;
+    });
+}
 
-    return true;
-};
-
-bool GetTimestampIndex(ChainstateManager &chainman, const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
+bool GetTimestampIndex(ChainstateManager &chainman, unsigned int high, unsigned int low, bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                       size_t max_results, const CTimestampIndexKey *after)
 {
-    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
-    if (!fTimestampIndex) {
-        return error("Timestamp index not enabled");
-    }
-    if (!pblocktree->ReadTimestampIndex(high, low, hashes)) {
-        return error("Unable to get hashes for timestamps");
-    }
-
     if (fActiveOnly) {
-        for (auto it = hashes.begin(); it != hashes.end(); ) {
-            if (!HashOnchainActive(chainman, it->first)) {
-                it = hashes.erase(it);
-            } else {
-                ++it;
+        // The block index holds every active chain block time, skip the db
+        std::vector<std::pair<uint256, unsigned int> > active_hashes;
+        WITH_LOCK(cs_main, GetActiveChainTimestamps(chainman.ActiveChain(), high, after ? std::max(low, after->timestamp) : low, active_hashes));
+        for (const auto &entry : active_hashes) {
+            if (after && (entry.second < after->timestamp || (entry.second == after->timestamp && !(after->blockHash < entry.first)))) {
+                continue;
             }
+            if (max_results && hashes.size() >= max_results) {
+                break;
+            }
+            hashes.push_back(entry);
         }
+        return true;
+    }
+
+    if (!g_timestamp_index) {
+        return error("Timestamp index not enabled");
+    }
+    if (!g_timestamp_index->FindBlockHashes(high, low, hashes, max_results, after)) {
+        return error("Unable to get hashes for timestamps");
     }
 
     return true;
@@ -132,34 +152,107 @@ bool GetSpentIndex(ChainstateManager &chainman, const CSpentIndexKey &key, CSpen
     return true;
 };
 
+bool GetSpentIndex(ChainstateManager &chainman, const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values, const CTxMemPool *pmempool)
+{
+    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
+    if (!fSpentIndex) {
+        return false;
+    }
+    values.assign(keys.size(), CSpentIndexValue());
+    std::vector<CSpentIndexKey> db_keys;
+    std::vector<size_t> db_pos;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (pmempool && pmempool->getSpentIndex(keys[i], values[i])) {
+            continue;
+        }
+        db_keys.push_back(keys[i]);
+        db_pos.push_back(i);
+    }
+    std::vector<CSpentIndexValue> db_values;
+    pblocktree->ReadSpentIndex(db_keys, db_values);
+    for (size_t k = 0; k < db_pos.size(); ++k) {
+        values[db_pos[k]] = db_values[k];
+    }
+
+    return true;
+};
+
 bool GetAddressIndex(ChainstateManager &chainman, const uint256 &addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     size_t max_results, const CAddressIndexKey *from)
 {
     auto& pblocktree{chainman.m_blockman.m_block_tree_db};
     if (!fAddressIndex) {
         return error("Address index not enabled");
     }
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end)) {
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, max_results, from)) {
         return error("Unable to get txids for address");
     }
 
     return true;
 };
 
+bool GetAddressBalance(ChainstateManager &chainman, const uint256 &addressHash, int type, CAddressBalanceValue &value)
+{
+    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
+    if (!fAddressBalanceIndex) {
+        return error("Address balance index not enabled");
+    }
+    if (!pblocktree->ReadAddressBalanceIndex(addressHash, type, value)) {
+        return error("Unable to get balance for address");
+    }
+
+    return true;
+};
+
 bool GetAddressUnspent(ChainstateManager &chainman, const uint256 &addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentFilter *filter)
 {
     auto& pblocktree{chainman.m_blockman.m_block_tree_db};
     if (!fAddressIndex) {
         return error("Address index not enabled");
     }
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs)) {
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, filter)) {
         return error("Unable to get txids for address");
     }
 
     return true;
 };
 
+bool GetAddressUnspentByValue(ChainstateManager &chainman, const uint256 &addressHash, int type,
+                              std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                              const CAddressUnspentFilter &filter, size_t max_results, const CAddressUnspentValueKey *after)
+{
+    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
+    if (!fAddressIndex) {
+        return error("Address index not enabled");
+    }
+    if (pblocktree->HaveAddressUnspentValueIndex()) {
+        if (!pblocktree->ReadAddressUnspentByValue(addressHash, type, unspentOutputs, filter, max_results, after)) {
+            return error("Unable to get txids for address");
+        }
+        return true;
+    }
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > outputs;
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, outputs, &filter)) {
+        return error("Unable to get txids for address");
+    }
+    std::sort(outputs.begin(), outputs.end(), AddressUnspentValueOrder);
+    auto it = outputs.begin();
+    if (after) {
+        const std::pair<CAddressUnspentKey, CAddressUnspentValue> after_output(
+            CAddressUnspentKey(type, addressHash, after->txhash, after->index), CAddressUnspentValue(after->satoshis, CScript(), 0));
+        it = std::upper_bound(outputs.begin(), outputs.end(), after_output, AddressUnspentValueOrder);
+    }
+    for (size_t n = 0; it != outputs.end() && (max_results == 0 || n < max_results); ++it, ++n) {
+        unspentOutputs.push_back(*it);
+    }
+
+    return true;
+};
+
 bool GetBlockBalances(ChainstateManager &chainman, const uint256 &block_hash, BlockBalances &balances)
 {
     auto& pblocktree{chainman.m_blockman.m_block_tree_db};
@@ -173,6 +266,53 @@ bool GetBlockBalances(ChainstateManager &chainman, const uint256 &block_hash, Bl
     return true;
 };
 
+bool GetBlockBalancesRange(ChainstateManager &chainman, int start_height, int end_height, int step,
+                           std::vector<std::pair<const CBlockIndex*, BlockBalances> > &balances)
+{
+    AssertLockHeld(cs_main);
+    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
+    const CChain &active_chain = chainman.ActiveChain();
+    if (!fBalancesIndex) {
+        return error("Balances index not enabled");
+    }
+    std::vector<std::pair<int, std::pair<uint256, BlockBalances> > > entries;
+    if (!pblocktree->ReadBlockBalancesRange(start_height, end_height, step, entries)) {
+        return error("Unable to read balances range");
+    }
+
+    auto it = entries.begin();
+    for (int height = start_height; height <= end_height; height += step) {
+        const CBlockIndex *pindex = active_chain[height];
+        if (!pindex) {
+            break;
+        }
+        while (it != entries.end() && it->first < height) {
+            ++it;
+        }
+        // Rows from a reorged out block, or from before the height keys were written, resolve the hash instead
+        if (it != entries.end() && it->first == height && it->second.first == pindex->GetBlockHash()) {
+            balances.emplace_back(pindex, it->second.second);
+            continue;
+        }
+        BlockBalances block_balances;
+        if (!pblocktree->ReadBlockBalancesIndex(pindex->GetBlockHash(), block_balances)) {
+            return error("Unable to get balances for block %s", pindex->GetBlockHash().ToString());
+        }
+        balances.emplace_back(pindex, block_balances);
+    }
+
+    return true;
+};
+
+bool GetBlockReward(ChainstateManager &chainman, const uint256 &block_hash, BlockReward &reward)
+{
+    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
+    if (!fBlockRewardIndex) {
+        return false;
+    }
+    return pblocktree->ReadBlockRewardIndex(block_hash, reward);
+};
+
 bool getAddressFromIndex(const int &type, const uint256 &hash, std::string &address)
 {
     if (type == ADDR_INDT_SCRIPT_ADDRESS) {
@@ -19,34 +19,57 @@
 extern RecursiveMutex cs_main;
 
 extern bool fAddressIndex;
+extern bool fAddressBalanceIndex;
 extern bool fSpentIndex;
-extern bool fTimestampIndex;
 extern bool fBalancesIndex;
+extern bool fBlockRewardIndex;
 
 class ChainstateManager;
+class CBlockIndex;
 class CTxOutBase;
 class CScript;
 class uint256;
 class CTxMemPool;
 class BlockBalances;
+class BlockReward;
 struct CAddressIndexKey;
+struct CAddressBalanceValue;
 struct CAddressUnspentKey;
 struct CAddressUnspentValue;
+struct CAddressUnspentValueKey;
+struct CAddressUnspentFilter;
 struct CSpentIndexKey;
 struct CSpentIndexValue;
+struct CTimestampIndexKey;
 
 bool ExtractIndexInfo(const CScript *pScript, int &scriptType, std::vector<uint8_t> &hashBytes);
 bool ExtractIndexInfo(const CTxOutBase *out, int &scriptType, std::vector<uint8_t> &hashBytes, CAmount &nValue, const CScript *&pScript);
 
 /** Functions for insight block explorer */
-bool GetTimestampIndex(ChainstateManager &chainman, const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+/** Blocks with low <= nTime < high ordered by time, at most max_results if set and starting after the after key if set.
+ *  Active chain only lookups are served from the block index, others read the timestamp index. */
+bool GetTimestampIndex(ChainstateManager &chainman, unsigned int high, unsigned int low, bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                       size_t max_results = 0, const CTimestampIndexKey *after = nullptr) LOCKS_EXCLUDED(cs_main);
 bool GetSpentIndex(ChainstateManager &chainman, const CSpentIndexKey &key, CSpentIndexValue &value, const CTxMemPool *pmempool);
+/** Resolve many outputs at once, the mempool first and the rest in one sorted read. values are null for outputs not known to be spent. */
+bool GetSpentIndex(ChainstateManager &chainman, const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values, const CTxMemPool *pmempool);
 bool GetAddressIndex(ChainstateManager &chainman, const uint256 &addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0, size_t max_results = 0, const CAddressIndexKey *from = nullptr);
+bool GetAddressBalance(ChainstateManager &chainman, const uint256 &addressHash, int type, CAddressBalanceValue &value);
 bool GetAddressUnspent(ChainstateManager &chainman, const uint256 &addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentFilter *filter = nullptr);
+/** Outputs passing filter largest first, at most max_results if set and starting after the after key if set.
+ *  Sorts all outputs of the address while the value ordered rows are being built. */
+bool GetAddressUnspentByValue(ChainstateManager &chainman, const uint256 &addressHash, int type,
+                              std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                              const CAddressUnspentFilter &filter, size_t max_results = 0, const CAddressUnspentValueKey *after = nullptr);
 bool GetBlockBalances(ChainstateManager &chainman, const uint256 &block_hash, BlockBalances &balances);
+/** Balances of every step'th active chain block in [start_height, end_height] */
+bool GetBlockBalancesRange(ChainstateManager &chainman, int start_height, int end_height, int step,
+                           std::vector<std::pair<const CBlockIndex*, BlockBalances> > &balances) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+bool GetBlockReward(ChainstateManager &chainman, const uint256 &block_hash, BlockReward &reward);
 
 bool getAddressFromIndex(const int &type, const uint256 &hash, std::string &address);
 
@@ -0,0 +1,176 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <insight/mempoolindex.h>
+
+#include <memusage.h>
+#include <random.h>
+
+#include <algorithm>
+
+SaltedAddressHasher::SaltedAddressHasher() :
+    k0(GetRand<uint64_t>()),
+    k1(GetRand<uint64_t>()) {}
+
+void MempoolInsightIndex::AddAddressDeltas(const uint256 &txhash, const std::vector<AddressDelta> &deltas)
+{
+    std::vector<CMempoolAddressDeltaKey> inserted;
+    inserted.reserve(deltas.size());
+    for (const auto &delta : deltas) {
+        const CMempoolAddressDeltaKey &key = delta.first;
+        AddressShard &shard = m_address_shards[ShardIndex(key.addressBytes)];
+        LOCK(shard.cs);
+        std::vector<AddressDelta> &address_deltas = shard.deltas[std::make_pair(key.addressBytes, key.type)];
+        shard.vector_usage -= memusage::DynamicUsage(address_deltas);
+        address_deltas.push_back(delta);
+        shard.vector_usage += memusage::DynamicUsage(address_deltas);
+        inserted.push_back(key);
+    }
+
+    TxShard &shard = m_tx_shards[ShardIndex(txhash)];
+    LOCK(shard.cs);
+    auto ret = shard.address_keys.emplace(txhash, std::move(inserted));
+    if (ret.second) {
+        shard.vector_usage += memusage::DynamicUsage(ret.first->second);
+    }
+}
+
+void MempoolInsightIndex::GetAddressDeltas(const std::vector<std::pair<uint256, int> > &addresses, std::vector<AddressDelta> &results) const
+{
+    for (const auto &address : addresses) {
+        const AddressShard &shard = m_address_shards[ShardIndex(address.first)];
+        LOCK(shard.cs);
+        auto it = shard.deltas.find(address);
+        if (it != shard.deltas.end()) {
+            results.insert(results.end(), it->second.begin(), it->second.end());
+        }
+    }
+}
+
+void MempoolInsightIndex::RemoveAddressDeltas(const uint256 &txhash)
+{
+    std::vector<CMempoolAddressDeltaKey> keys;
+    {
+        TxShard &shard = m_tx_shards[ShardIndex(txhash)];
+        LOCK(shard.cs);
+        auto it = shard.address_keys.find(txhash);
+        if (it == shard.address_keys.end()) {
+            return;
+        }
+        shard.vector_usage -= memusage::DynamicUsage(it->second);
+        keys = std::move(it->second);
+        shard.address_keys.erase(it);
+    }
+
+    for (const auto &key : keys) {
+        AddressShard &shard = m_address_shards[ShardIndex(key.addressBytes)];
+        LOCK(shard.cs);
+        auto it = shard.deltas.find(std::make_pair(key.addressBytes, key.type));
+        if (it == shard.deltas.end()) {
+            continue;
+        }
+        std::vector<AddressDelta> &address_deltas = it->second;
+        shard.vector_usage -= memusage::DynamicUsage(address_deltas);
+        address_deltas.erase(std::remove_if(address_deltas.begin(), address_deltas.end(), [&key](const AddressDelta &delta) {
+            return delta.first.txhash == key.txhash && delta.first.index == key.index && delta.first.spending == key.spending;
+        }), address_deltas.end());
+        if (address_deltas.empty()) {
+            shard.deltas.erase(it);
+        } else {
+            shard.vector_usage += memusage::DynamicUsage(address_deltas);
+        }
+    }
+}
+
+void MempoolInsightIndex::AddSpentOutputs(const uint256 &txhash, const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &spent)
+{
+    std::vector<COutPoint> inserted;
+    inserted.reserve(spent.size());
+    for (const auto &it : spent) {
+        COutPoint outpoint(it.first.txid, it.first.outputIndex);
+        SpentShard &shard = m_spent_shards[ShardIndex(outpoint.hash)];
+        LOCK(shard.cs);
+        shard.spent.emplace(outpoint, it.second);
+        inserted.push_back(outpoint);
+    }
+
+    TxShard &shard = m_tx_shards[ShardIndex(txhash)];
+    LOCK(shard.cs);
+    auto ret = shard.spent_keys.emplace(txhash, std::move(inserted));
+    if (ret.second) {
+        shard.vector_usage += memusage::DynamicUsage(ret.first->second);
+    }
+}
+
+bool MempoolInsightIndex::GetSpent(const CSpentIndexKey &key, CSpentIndexValue &value) const
+{
+    COutPoint outpoint(key.txid, key.outputIndex);
+    const SpentShard &shard = m_spent_shards[ShardIndex(outpoint.hash)];
+    LOCK(shard.cs);
+    auto it = shard.spent.find(outpoint);
+    if (it == shard.spent.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+void MempoolInsightIndex::RemoveSpentOutputs(const uint256 &txhash)
+{
+    std::vector<COutPoint> keys;
+    {
+        TxShard &shard = m_tx_shards[ShardIndex(txhash)];
+        LOCK(shard.cs);
+        auto it = shard.spent_keys.find(txhash);
+        if (it == shard.spent_keys.end()) {
+            return;
+        }
+        shard.vector_usage -= memusage::DynamicUsage(it->second);
+        keys = std::move(it->second);
+        shard.spent_keys.erase(it);
+    }
+
+    for (const auto &outpoint : keys) {
+        SpentShard &shard = m_spent_shards[ShardIndex(outpoint.hash)];
+        LOCK(shard.cs);
+        shard.spent.erase(outpoint);
+    }
+}
+
+void MempoolInsightIndex::Clear()
+{
+    for (auto &shard : m_address_shards) {
+        LOCK(shard.cs);
+        shard.deltas.clear();
+        shard.vector_usage = 0;
+    }
+    for (auto &shard : m_spent_shards) {
+        LOCK(shard.cs);
+        shard.spent.clear();
+    }
+    for (auto &shard : m_tx_shards) {
+        LOCK(shard.cs);
+        shard.address_keys.clear();
+        shard.spent_keys.clear();
+        shard.vector_usage = 0;
+    }
+}
+
+size_t MempoolInsightIndex::DynamicMemoryUsage() const
+{
+    size_t usage = 0;
+    for (const auto &shard : m_address_shards) {
+        LOCK(shard.cs);
+        usage += memusage::DynamicUsage(shard.deltas) + shard.vector_usage;
+    }
+    for (const auto &shard : m_spent_shards) {
+        LOCK(shard.cs);
+        usage += memusage::DynamicUsage(shard.spent);
+    }
+    for (const auto &shard : m_tx_shards) {
+        LOCK(shard.cs);
+        usage += memusage::DynamicUsage(shard.address_keys) + memusage::DynamicUsage(shard.spent_keys) + shard.vector_usage;
+    }
+    return usage;
+}
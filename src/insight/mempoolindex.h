@@ -0,0 +1,83 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_INSIGHT_MEMPOOLINDEX_H
+#define PARTICL_INSIGHT_MEMPOOLINDEX_H
+
+#include <insight/addressindex.h>
+#include <insight/spentindex.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+#include <uint256.h>
+#include <util/hasher.h>
+
+#include <array>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class SaltedAddressHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressHasher();
+
+    size_t operator()(const std::pair<uint256, int>& address) const noexcept {
+        return SipHashUint256Extra(k0, k1, address.first, address.second);
+    }
+};
+
+/**
+ * Address and spent indices for mempool transactions.
+ * Kept apart from CTxMemPool::cs, each shard has its own lock and no two are held at once,
+ * so explorer queries don't hold up transaction acceptance.
+ */
+class MempoolInsightIndex
+{
+public:
+    static constexpr size_t NUM_SHARDS{16};
+
+    typedef std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> AddressDelta;
+
+    void AddAddressDeltas(const uint256 &txhash, const std::vector<AddressDelta> &deltas);
+    void GetAddressDeltas(const std::vector<std::pair<uint256, int> > &addresses, std::vector<AddressDelta> &results) const;
+    void RemoveAddressDeltas(const uint256 &txhash);
+
+    void AddSpentOutputs(const uint256 &txhash, const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &spent);
+    bool GetSpent(const CSpentIndexKey &key, CSpentIndexValue &value) const;
+    void RemoveSpentOutputs(const uint256 &txhash);
+
+    void Clear();
+    size_t DynamicMemoryUsage() const;
+
+private:
+    struct AddressShard {
+        mutable Mutex cs;
+        std::unordered_map<std::pair<uint256, int>, std::vector<AddressDelta>, SaltedAddressHasher> deltas GUARDED_BY(cs);
+        /** Heap usage of the vectors in deltas */
+        size_t vector_usage GUARDED_BY(cs){0};
+    };
+    struct SpentShard {
+        mutable Mutex cs;
+        std::unordered_map<COutPoint, CSpentIndexValue, SaltedOutpointHasher> spent GUARDED_BY(cs);
+    };
+    /** Keys inserted per transaction, for removal */
+    struct TxShard {
+        mutable Mutex cs;
+        std::unordered_map<uint256, std::vector<CMempoolAddressDeltaKey>, SaltedTxidHasher> address_keys GUARDED_BY(cs);
+        std::unordered_map<uint256, std::vector<COutPoint>, SaltedTxidHasher> spent_keys GUARDED_BY(cs);
+        size_t vector_usage GUARDED_BY(cs){0};
+    };
+
+    static size_t ShardIndex(const uint256 &hash) { return hash.GetUint64(0) % NUM_SHARDS; }
+
+    std::array<AddressShard, NUM_SHARDS> m_address_shards;
+    std::array<SpentShard, NUM_SHARDS> m_spent_shards;
+    std::array<TxShard, NUM_SHARDS> m_tx_shards;
+};
+
+#endif // PARTICL_INSIGHT_MEMPOOLINDEX_H
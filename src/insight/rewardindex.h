@@ -0,0 +1,37 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_INSIGHT_REWARDINDEX_H
+#define PARTICL_INSIGHT_REWARDINDEX_H
+
+#include <consensus/amount.h>
+#include <script/script.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <utility>
+#include <vector>
+
+/** Reward breakdown of a proof of stake block, written by ConnectBlock when -blockrewardindex is set */
+class BlockReward
+{
+public:
+    uint256 coinstake_txid;
+    CAmount stake_reward = 0;       // Newly minted coin
+    CAmount block_reward = 0;       // Value paid to the staker, including fees
+    CAmount treasury_reward = 0;    // Accumulated treasury payout, if any
+    CAmount fees = 0;               // Fees of the non-coinstake txns
+    CScript kernel_script;
+    std::vector<std::pair<CScript, CAmount> > outputs; // Standard coinstake outputs
+    CAmount smsg_fee_rate = 0;      // 0 if not set
+    uint32_t smsg_difficulty = 0;   // 0 if not set
+
+    SERIALIZE_METHODS(BlockReward, obj)
+    {
+        READWRITE(obj.coinstake_txid, obj.stake_reward, obj.block_reward, obj.treasury_reward, obj.fees);
+        READWRITE(obj.kernel_script, obj.outputs, obj.smsg_fee_rate, obj.smsg_difficulty);
+    }
+};
+
+#endif // PARTICL_INSIGHT_REWARDINDEX_H
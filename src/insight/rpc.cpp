@@ -2,6 +2,8 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <insight/rpc.h>
+
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <rpc/server_util.h>
@@ -9,16 +11,24 @@
 
 #include <util/strencodings.h>
 #include <insight/insight.h>
+#include <insight/blockdeltas.h>
+#include <insight/addressindex.h>
 #include <insight/csindex.h>
+#include <insight/timestampindex.h>
+#include <index/coinscriptstatsindex.h>
+#include <index/timestampindex.h>
 #include <index/txindex.h>
 #include <node/blockstorage.h>
 #include <validation.h>
 #include <txmempool.h>
 #include <key_io.h>
 #include <core_io.h>
+#include <clientversion.h>
+#include <consensus/consensus.h>
 #include <node/context.h>
 #include <script/standard.h>
 #include <shutdown.h>
+#include <streams.h>
 
 #include <univalue.h>
 
@@ -106,10 +116,100 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint25
     return true;
 }
 
-bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
-                std::pair<CAddressUnspentKey, CAddressUnspentValue> b)
+/** Lowest height first and then by outpoint, a total order so pages of getaddressutxos don't overlap */
+bool heightSort(const std::pair<CAddressUnspentKey, CAddressUnspentValue> &a,
+                const std::pair<CAddressUnspentKey, CAddressUnspentValue> &b)
+{
+    if (a.second.blockHeight != b.second.blockHeight) {
+        return a.second.blockHeight < b.second.blockHeight;
+    }
+    if (a.first.txhash != b.first.txhash) {
+        return a.first.txhash < b.first.txhash;
+    }
+    return a.first.index < b.first.index;
+}
+
+/** The last output of a getaddressutxos page */
+struct AddressUtxoCursor {
+    bool sort_by_value = false;
+    int64_t position = 0;       // Height or value of the output, by the sort order
+    uint256 txhash;
+    uint32_t index = 0;
+
+    SERIALIZE_METHODS(AddressUtxoCursor, obj)
+    {
+        READWRITE(obj.sort_by_value, obj.position, obj.txhash, obj.index);
+    }
+};
+
+static void ParseAddressUtxoOptions(const UniValue &options, CAddressUnspentFilter &filter, bool &sort_by_value,
+                                    std::optional<AddressUtxoCursor> &cursor, size_t &limit)
 {
-    return a.second.blockHeight < b.second.blockHeight;
+    if (!options["minSatoshis"].isNull()) {
+        filter.min_satoshis = options["minSatoshis"].getInt<int64_t>();
+    }
+    if (!options["maxSatoshis"].isNull()) {
+        filter.max_satoshis = options["maxSatoshis"].getInt<int64_t>();
+    }
+    if (filter.min_satoshis < 0 || filter.max_satoshis < filter.min_satoshis) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid \"minSatoshis\" or \"maxSatoshis\"");
+    }
+    if (!options["minHeight"].isNull()) {
+        filter.min_height = options["minHeight"].getInt<int>();
+    }
+    if (!options["maxHeight"].isNull()) {
+        filter.max_height = options["maxHeight"].getInt<int>();
+    }
+    if (filter.max_height < filter.min_height) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "\"maxHeight\" is expected to be greater than \"minHeight\"");
+    }
+    if (!options["types"].isNull()) {
+        filter.standard = false;
+        filter.blind = false;
+        for (const auto &type : options["types"].get_array().getValues()) {
+            if (type.get_str() == "standard") {
+                filter.standard = true;
+            } else
+            if (type.get_str() == "blind") {
+                filter.blind = true;
+            } else {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown output type: " + type.get_str());
+            }
+        }
+    }
+    if (!options["sort"].isNull()) {
+        const std::string &sort = options["sort"].get_str();
+        if (sort == "value") {
+            sort_by_value = true;
+        } else
+        if (sort != "height") {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown sort: " + sort);
+        }
+    }
+    if (options["cursor"].isStr()) {
+        const std::string &str_cursor = options["cursor"].get_str();
+        if (!IsHex(str_cursor)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "\"cursor\" must be a hex string");
+        }
+        CDataStream ss(ParseHex(str_cursor), SER_DISK, CLIENT_VERSION);
+        AddressUtxoCursor key;
+        try {
+            ss >> key;
+        } catch (const std::exception &e) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid \"cursor\"");
+        }
+        if (!ss.empty() || key.sort_by_value != sort_by_value) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid \"cursor\"");
+        }
+        cursor = key;
+    }
+    if (!options["limit"].isNull()) {
+        int n = options["limit"].getInt<int>();
+        if (n < 1) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "\"limit\" must be greater than zero");
+        }
+        limit = n;
+    }
 }
 
 bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
@@ -207,6 +307,18 @@ return RPCHelpMan{"getaddressutxos",
                         },
                     },
                     {"chainInfo", RPCArg::Type::BOOL, RPCArg::Default{false}, "Include chain info in results, only applies if start and end specified."},
+                    {"minSatoshis", RPCArg::Type::NUM, RPCArg::Default{0}, "Skip outputs with a lower value."},
+                    {"maxSatoshis", RPCArg::Type::NUM, RPCArg::DefaultHint{"MAX_MONEY"}, "Skip outputs with a higher value."},
+                    {"minHeight", RPCArg::Type::NUM, RPCArg::Default{0}, "Skip outputs confirmed below this height."},
+                    {"maxHeight", RPCArg::Type::NUM, RPCArg::DefaultHint{"unlimited"}, "Skip outputs confirmed above this height."},
+                    {"types", RPCArg::Type::ARR, RPCArg::DefaultHint{"all"}, "Output types to include.",
+                        {
+                            {"type", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "\"standard\" or \"blind\", blinded outputs are indexed with a zero value."},
+                        },
+                    },
+                    {"sort", RPCArg::Type::STR, RPCArg::Default{"height"}, "\"height\" for the lowest height first, \"value\" for the largest value first."},
+                    {"cursor", RPCArg::Type::STR_HEX, RPCArg::DefaultHint{"first output"}, "Continue from \"next\" of the previous result, the other options must not change."},
+                    {"limit", RPCArg::Type::NUM, RPCArg::DefaultHint{"unlimited"}, "Return at most \"limit\" outputs, results are an object with \"next\" set if more outputs remain."},
                 },
                 {
                     RPCResult{"Default",
@@ -221,18 +333,20 @@ return RPCHelpMan{"getaddressutxos",
                             }}
                         }
                     },
-                    RPCResult{"With chainInfo", RPCResult::Type::OBJ, "", "", {
-                        {RPCResult::Type::STR_HEX, "hash", "Start hash"},
-                        {RPCResult::Type::NUM, "height", "Chain height"},
+                    RPCResult{"With chainInfo or limit", RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::STR_HEX, "hash", /*optional=*/true, "Start hash, set if chainInfo is requested"},
+                        {RPCResult::Type::NUM, "height", /*optional=*/true, "Chain height, set if chainInfo is requested"},
                         {RPCResult::Type::ARR, "utxos", "", {
                             {RPCResult::Type::OBJ, "", "", {
                                 {RPCResult::Type::ELISION, "", "Same as Default"},
                             }}
-                        }}
+                        }},
+                        {RPCResult::Type::STR_HEX, "next", /*optional=*/true, "Cursor to pass to continue listing, set if the listing stopped at the limit"},
                     }}
                 },
                 RPCExamples{
             HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"]}'") +
+            HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"], \"sort\": \"value\", \"limit\": 50}'") +
             "\nAs a JSON-RPC call\n"
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"]}")
                 },
@@ -257,14 +371,51 @@ return RPCHelpMan{"getaddressutxos",
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CAddressUnspentFilter filter;
+    bool sort_by_value = false;
+    std::optional<AddressUtxoCursor> cursor;
+    size_t limit = 0;
+    if (request.params[0].isObject()) {
+        ParseAddressUtxoOptions(request.params[0].get_obj(), filter, sort_by_value, cursor, limit);
+    }
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent(chainman, it->first, it->second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (sort_by_value) {
+        // Each address is read up to one past the limit, the merged outputs are cut to the limit
+        for (const auto &address : addresses) {
+            std::optional<CAddressUnspentValueKey> after;
+            if (cursor) {
+                after = CAddressUnspentValueKey(address.second, address.first, cursor->position);
+                after->txhash = cursor->txhash;
+                after->index = cursor->index;
+            }
+            if (!GetAddressUnspentByValue(chainman, address.first, address.second, unspentOutputs, filter,
+                                          limit > 0 ? limit + 1 : 0, after ? &*after : nullptr)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), AddressUnspentValueOrder);
+    } else {
+        for (const auto &address : addresses) {
+            if (!GetAddressUnspent(chainman, address.first, address.second, unspentOutputs, &filter)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        if (cursor) {
+            const std::pair<CAddressUnspentKey, CAddressUnspentValue> last(
+                CAddressUnspentKey(ADDR_INDT_UNKNOWN, uint256(), cursor->txhash, cursor->index),
+                CAddressUnspentValue(0, CScript(), cursor->position));
+            unspentOutputs.erase(unspentOutputs.begin(), std::upper_bound(unspentOutputs.begin(), unspentOutputs.end(), last, heightSort));
         }
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    std::optional<AddressUtxoCursor> next;
+    if (limit > 0 && unspentOutputs.size() > limit) {
+        unspentOutputs.resize(limit);
+        const auto &last = unspentOutputs.back();
+        next = AddressUtxoCursor{sort_by_value, sort_by_value ? last.second.satoshis : last.second.blockHeight, last.first.txhash, (uint32_t)last.first.index};
+    }
 
     UniValue utxos(UniValue::VARR);
 
@@ -284,13 +435,20 @@ return RPCHelpMan{"getaddressutxos",
         utxos.push_back(output);
     }
 
-    if (includeChainInfo) {
+    if (includeChainInfo || limit > 0) {
         UniValue result(UniValue::VOBJ);
         result.pushKV("utxos", utxos);
 
-        LOCK(cs_main);
-        result.pushKV("hash", chainman.ActiveChain().Tip()->GetBlockHash().GetHex());
-        result.pushKV("height", (int)chainman.ActiveChain().Height());
+        if (includeChainInfo) {
+            LOCK(cs_main);
+            result.pushKV("hash", chainman.ActiveChain().Tip()->GetBlockHash().GetHex());
+            result.pushKV("height", (int)chainman.ActiveChain().Height());
+        }
+        if (next) {
+            CDataStream ss(SER_DISK, CLIENT_VERSION);
+            ss << *next;
+            result.pushKV("next", HexStr(ss));
+        }
         return result;
     } else {
         return utxos;
@@ -299,6 +457,79 @@ return RPCHelpMan{"getaddressutxos",
     };
 }
 
+void ParseAddressPageOptions(const UniValue &params, std::optional<CAddressIndexKey> &cursor, size_t &limit)
+{
+    if (!params[0].isObject()) {
+        return;
+    }
+    const UniValue &options = params[0].get_obj();
+    if (options["cursor"].isStr()) {
+        const std::string &str_cursor = options["cursor"].get_str();
+        if (!IsHex(str_cursor)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "\"cursor\" must be a hex string");
+        }
+        CDataStream ss(ParseHex(str_cursor), SER_DISK, CLIENT_VERSION);
+        CAddressIndexKey key;
+        try {
+            ss >> key;
+        } catch (const std::exception &e) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid \"cursor\"");
+        }
+        if (!ss.empty()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid \"cursor\"");
+        }
+        cursor = key;
+    }
+    if (!options["limit"].isNull()) {
+        int n = options["limit"].getInt<int>();
+        if (n < 1) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "\"limit\" must be greater than zero");
+        }
+        limit = n;
+    }
+}
+
+static std::string EncodeAddressCursor(const CAddressIndexKey &key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return HexStr(ss);
+}
+
+void ReadAddressIndexPage(ChainstateManager &chainman, const std::vector<std::pair<uint256, int> > &addresses,
+                          int start, int end, const std::optional<CAddressIndexKey> &cursor, size_t limit,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          std::optional<CAddressIndexKey> &next)
+{
+    size_t first = 0;
+    if (cursor) {
+        for (first = 0; first < addresses.size(); ++first) {
+            if (addresses[first].first == cursor->hashBytes && addresses[first].second == (int)cursor->type) {
+                break;
+            }
+        }
+        if (first >= addresses.size()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "\"cursor\" does not match any of the addresses");
+        }
+    }
+
+    for (size_t i = first; i < addresses.size(); ++i) {
+        // Read one more than the limit to know if there is a next page
+        size_t max_results = limit > 0 ? limit + 1 - addressIndex.size() : 0;
+        const CAddressIndexKey *from = cursor && i == first ? &*cursor : nullptr;
+        int address_start = start > 0 && end > 0 ? start : 0;
+        int address_end = start > 0 && end > 0 ? end : 0;
+        if (!GetAddressIndex(chainman, addresses[i].first, addresses[i].second, addressIndex, address_start, address_end, max_results, from)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (limit > 0 && addressIndex.size() > limit) {
+            next = addressIndex.back().first;
+            addressIndex.pop_back();
+            return;
+        }
+    }
+}
+
 static RPCHelpMan getaddressdeltas()
 {
     return RPCHelpMan{"getaddressdeltas",
@@ -312,6 +543,8 @@ static RPCHelpMan getaddressdeltas()
                     {"start", RPCArg::Type::NUM, RPCArg::Default{0}, "The start block height."},
                     {"end", RPCArg::Type::NUM, RPCArg::Default{0}, "The end block height."},
                     {"chainInfo", RPCArg::Type::BOOL, RPCArg::Default{false}, "Include chain info in results, only applies if start and end specified."},
+                    {"cursor", RPCArg::Type::STR_HEX, RPCArg::DefaultHint{"first delta"}, "Continue from \"next\" of the previous result."},
+                    {"limit", RPCArg::Type::NUM, RPCArg::DefaultHint{"unlimited"}, "Return at most \"limit\" deltas, results are an object with \"next\" set if more deltas remain."},
                 },
                 {
                     RPCResult{"Default",
@@ -340,10 +573,25 @@ static RPCHelpMan getaddressdeltas()
                             {RPCResult::Type::STR_HEX, "hash", "End hash"},
                             {RPCResult::Type::NUM, "height", "End height"},
                         }},
+                    }},
+                    RPCResult{"With limit", RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::ARR, "deltas", "", {
+                            {RPCResult::Type::OBJ, "", "", {
+                                {RPCResult::Type::ELISION, "", "Same output as Default output"},
+                            }}
+                        }},
+                        {RPCResult::Type::OBJ, "start", /*optional=*/true, "Set if chainInfo is requested", {
+                            {RPCResult::Type::ELISION, "", "Same output as With chainInfo"},
+                        }},
+                        {RPCResult::Type::OBJ, "end", /*optional=*/true, "Set if chainInfo is requested", {
+                            {RPCResult::Type::ELISION, "", "Same output as With chainInfo"},
+                        }},
+                        {RPCResult::Type::STR_HEX, "next", /*optional=*/true, "Cursor to pass to continue listing, set if the listing stopped at the limit"},
                     }}
                 },
                 RPCExamples{
             HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"]}'") +
+            HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"], \"limit\": 1000}'") +
             "\nAs a JSON-RPC call\n"
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"]}")
                 },
@@ -383,19 +631,12 @@ static RPCHelpMan getaddressdeltas()
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::optional<CAddressIndexKey> cursor, next;
+    size_t limit = 0;
+    ParseAddressPageOptions(request.params, cursor, limit);
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex(chainman, it->first, it->second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex(chainman, it->first, it->second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    ReadAddressIndexPage(chainman, addresses, start, end, cursor, limit, addressIndex, next);
 
     UniValue deltas(UniValue::VARR);
 
@@ -439,15 +680,31 @@ static RPCHelpMan getaddressdeltas()
         result.pushKV("deltas", deltas);
         result.pushKV("start", startInfo);
         result.pushKV("end", endInfo);
-
-        return result;
+    } else
+    if (limit > 0) {
+        result.pushKV("deltas", deltas);
     } else {
         return deltas;
     }
+    if (next) {
+        result.pushKV("next", EncodeAddressCursor(*next));
+    }
+
+    return result;
 },
     };
 }
 
+/** Coinbase and coinstake outputs are always the first transaction in the block */
+static bool IsImmatureDelta(const CAddressIndexKey &key, CAmount value, int spend_height)
+{
+    if (key.txindex != 0 || key.spending || value <= 0) {
+        return false;
+    }
+    int required_depth = std::min(COINBASE_MATURITY, (int)(key.blockHeight / 2));
+    return spend_height - key.blockHeight < required_depth;
+}
+
 static RPCHelpMan getaddressbalance()
 {
     return RPCHelpMan{"getaddressbalance",
@@ -463,6 +720,7 @@ static RPCHelpMan getaddressbalance()
                     RPCResult::Type::OBJ, "", "", {
                         {RPCResult::Type::STR_AMOUNT, "balance", "The current balance in satoshis"},
                         {RPCResult::Type::STR_AMOUNT, "received", "The total number of satoshis received (including change)"},
+                        {RPCResult::Type::STR_AMOUNT, "immature", "The part of the balance in coinbase or coinstake outputs that can't be spent yet"},
                     }
                 },
                 RPCExamples{
@@ -483,27 +741,50 @@ static RPCHelpMan getaddressbalance()
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CAmount balance = 0;
+    CAmount received = 0;
+    CAmount immature = 0;
+
+    const int tip_height = WITH_LOCK(cs_main, return chainman.ActiveChain().Height());
+    const int spend_height = tip_height + 1;
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex(chainman, it->first, it->second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (fAddressBalanceIndex) {
+        // Totals are a point read, only the deltas young enough to be immature are scanned
+        int start = std::max(1, spend_height - COINBASE_MATURITY);
+        for (const auto &address : addresses) {
+            CAddressBalanceValue value;
+            if (!GetAddressBalance(chainman, address.first, address.second, value) ||
+                !GetAddressIndex(chainman, address.first, address.second, addressIndex, start, std::max(start, tip_height))) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+            balance += value.balance;
+            received += value.received;
+        }
+    } else {
+        for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressIndex(chainman, it->first, it->second, addressIndex)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
     }
 
-    CAmount balance = 0;
-    CAmount received = 0;
-
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+        if (!fAddressBalanceIndex) {
+            if (it->second > 0) {
+                received += it->second;
+            }
+            balance += it->second;
+        }
+        if (IsImmatureDelta(it->first, it->second, spend_height)) {
+            immature += it->second;
         }
-        balance += it->second;
     }
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("balance", balance);
     result.pushKV("received", received);
+    result.pushKV("immature", immature);
 
     return result;
 },
@@ -522,11 +803,22 @@ static RPCHelpMan getaddresstxids()
                     },
                     {"start", RPCArg::Type::NUM, RPCArg::Default{0}, "The start block height."},
                     {"end", RPCArg::Type::NUM, RPCArg::Default{0}, "The end block height."},
+                    {"cursor", RPCArg::Type::STR_HEX, RPCArg::DefaultHint{"first delta"}, "Continue from \"next\" of the previous result."},
+                    {"limit", RPCArg::Type::NUM, RPCArg::DefaultHint{"unlimited"}, "Read at most \"limit\" deltas, results are an object with \"next\" set if more deltas remain.\n"
+                        "Pages list txids per address in the order given and a txid may repeat on the next page."},
                 },
-                RPCResult{
-                    RPCResult::Type::ARR, "", "", {
-                        {RPCResult::Type::STR_HEX, "transactionid", "The transaction txid"},
-                    }
+                {
+                    RPCResult{"Default",
+                        RPCResult::Type::ARR, "", "", {
+                            {RPCResult::Type::STR_HEX, "transactionid", "The transaction txid"},
+                        }
+                    },
+                    RPCResult{"With limit", RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::ARR, "txids", "", {
+                            {RPCResult::Type::STR_HEX, "transactionid", "The transaction txid"},
+                        }},
+                        {RPCResult::Type::STR_HEX, "next", /*optional=*/true, "Cursor to pass to continue listing, set if the listing stopped at the limit"},
+                    }}
                 },
                 RPCExamples{
             HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"]}'") +
@@ -557,19 +849,12 @@ static RPCHelpMan getaddresstxids()
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::optional<CAddressIndexKey> cursor, next;
+    size_t limit = 0;
+    ParseAddressPageOptions(request.params, cursor, limit);
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex(chainman, it->first, it->second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex(chainman, it->first, it->second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    ReadAddressIndexPage(chainman, addresses, start, end, cursor, limit, addressIndex, next);
 
     std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
@@ -578,7 +863,7 @@ static RPCHelpMan getaddresstxids()
         int height = it->first.blockHeight;
         std::string txid = it->first.txhash.GetHex();
 
-        if (addresses.size() > 1) {
+        if (addresses.size() > 1 && limit == 0) {
             txids.insert(std::make_pair(height, txid));
         } else {
             if (txids.insert(std::make_pair(height, txid)).second) {
@@ -587,12 +872,21 @@ static RPCHelpMan getaddresstxids()
         }
     }
 
-    if (addresses.size() > 1) {
+    if (addresses.size() > 1 && limit == 0) {
         for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
             result.push_back(it->second);
         }
     }
 
+    if (limit > 0) {
+        UniValue page(UniValue::VOBJ);
+        page.pushKV("txids", result);
+        if (next) {
+            page.pushKV("next", EncodeAddressCursor(*next));
+        }
+        return page;
+    }
+
     return result;
 },
     };
@@ -601,24 +895,38 @@ static RPCHelpMan getaddresstxids()
 static RPCHelpMan getspentinfo()
 {
     return RPCHelpMan{"getspentinfo",
-                "\nReturns the txid and index where an output is spent.\n",
+                "\nReturns the txid and index where an output is spent.\n"
+                "Pass an array of inputs to resolve many outputs in one call.\n",
                 {
-                    {"inputs", RPCArg::Type::OBJ, RPCArg::Optional::NO, "",
+                    {"inputs", RPCArg::Type::OBJ, RPCArg::Optional::NO, "An output, or a json array of outputs",
                         {
                             {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The hex string of the txid."},
                             {"index", RPCArg::Type::NUM, RPCArg::Optional::NO, "The output number."},
                         },
+                        "", {"", "json object or array"}
                     },
                 },
-                RPCResult{
-                    RPCResult::Type::OBJ, "", "", {
-                        {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
-                        {RPCResult::Type::NUM, "index", "The spending input index"},
-                        {RPCResult::Type::NUM, "height", "The height of the block containing the spending tx"},
-                    }
+                {
+                    RPCResult{"For a single input",
+                        RPCResult::Type::OBJ, "", "", {
+                            {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+                            {RPCResult::Type::NUM, "index", "The spending input index"},
+                            {RPCResult::Type::NUM, "height", "The height of the block containing the spending tx"},
+                        }
+                    },
+                    RPCResult{"For an array of inputs",
+                        RPCResult::Type::ARR, "", "In the order of the inputs, null for outputs not known to be spent", {
+                            {RPCResult::Type::OBJ, "", "", {
+                                {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+                                {RPCResult::Type::NUM, "index", "The spending input index"},
+                                {RPCResult::Type::NUM, "height", "The height of the block containing the spending tx"},
+                            }},
+                        }
+                    },
                 },
                 RPCExamples{
             HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'") +
+            HelpExampleCli("getspentinfo", "'[{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}, {\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 1}]'") +
             "\nAs a JSON-RPC call\n"
             + HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}")
                 },
@@ -628,166 +936,76 @@ static RPCHelpMan getspentinfo()
     const CTxMemPool& mempool = EnsureMemPool(node);
     ChainstateManager &chainman = EnsureChainman(node);
 
-    UniValue txidValue = find_value(request.params[0].get_obj(), "txid");
-    UniValue indexValue = find_value(request.params[0].get_obj(), "index");
+    auto parse_key = [](const UniValue &input) {
+        if (!input.isObject()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an object with txid and index");
+        }
+        UniValue txidValue = find_value(input.get_obj(), "txid");
+        UniValue indexValue = find_value(input.get_obj(), "index");
+
+        if (!txidValue.isStr() || !indexValue.isNum()) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid txid or index");
+        }
 
-    if (!txidValue.isStr() || !indexValue.isNum()) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid txid or index");
-    }
+        uint256 txid = ParseHashV(txidValue, "txid");
+        int outputIndex = indexValue.getInt<int>();
+        return CSpentIndexKey(txid, outputIndex);
+    };
+    auto to_obj = [](const CSpentIndexValue &value) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("txid", value.txid.GetHex());
+        obj.pushKV("index", (int)value.inputIndex);
+        obj.pushKV("height", value.blockHeight);
+        return obj;
+    };
 
-    uint256 txid = ParseHashV(txidValue, "txid");
-    int outputIndex = indexValue.getInt<int>();
+    if (request.params[0].isArray()) {
+        std::vector<CSpentIndexKey> keys;
+        for (const auto &input : request.params[0].getValues()) {
+            keys.push_back(parse_key(input));
+        }
+        std::vector<CSpentIndexValue> values;
+        if (!GetSpentIndex(chainman, keys, values, &mempool)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled");
+        }
+        UniValue result(UniValue::VARR);
+        for (const auto &value : values) {
+            result.push_back(value.IsNull() ? UniValue(UniValue::VNULL) : to_obj(value));
+        }
+        return result;
+    }
 
-    CSpentIndexKey key(txid, outputIndex);
+    CSpentIndexKey key = parse_key(request.params[0]);
     CSpentIndexValue value;
 
     if (!GetSpentIndex(chainman, key, value, &mempool)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
     }
 
-    UniValue obj(UniValue::VOBJ);
-    obj.pushKV("txid", value.txid.GetHex());
-    obj.pushKV("index", (int)value.inputIndex);
-    obj.pushKV("height", value.blockHeight);
-
-    return obj;
+    return to_obj(value);
 },
     };
 }
 
-static void AddAddress(CScript *script, UniValue &uv)
-{
-    if (script->IsPayToScriptHash()) {
-        std::vector<unsigned char> hashBytes(script->begin()+2, script->begin()+22);
-        uv.pushKV("address", EncodeDestination(ScriptHash(uint160(hashBytes))));
-    } else
-    if (script->IsPayToPublicKeyHash()) {
-        std::vector<unsigned char> hashBytes(script->begin()+3, script->begin()+23);
-        uv.pushKV("address", EncodeDestination(PKHash(uint160(hashBytes))));
-    } else
-    if (script->IsPayToScriptHash256()) {
-        std::vector<unsigned char> hashBytes(script->begin()+2, script->begin()+34);
-        uv.pushKV("address", EncodeDestination(CScriptID256(uint256(hashBytes))));
-    } else
-    if (script->IsPayToPublicKeyHash256()) {
-        std::vector<unsigned char> hashBytes(script->begin()+3, script->begin()+35);
-        uv.pushKV("address", EncodeDestination(CKeyID256(uint256(hashBytes))));
-    }
-}
-
-static UniValue blockToDeltasJSON(ChainstateManager& chainman, const CBlock& block, const CBlockIndex* blockindex, const CTxMemPool *pmempool)
+/** The header fields are taken from blockindex, so a cached result doesn't need the block read */
+static UniValue blockToDeltasJSON(ChainstateManager& chainman, const CBlockIndex* blockindex, const UniValue &deltas, unsigned int block_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     CChain &active_chain = chainman.ActiveChain();
     UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", block.GetHash().GetHex());
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (active_chain.Contains(blockindex)) {
-        confirmations = active_chain.Height() - blockindex->nHeight + 1;
-    } else {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block is an orphan");
-    }
+    result.pushKV("hash", blockindex->GetBlockHash().GetHex());
+    int confirmations = active_chain.Height() - blockindex->nHeight + 1;
     result.pushKV("confirmations", confirmations);
-    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
+    result.pushKV("size", (int)block_size);
     result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    result.pushKV("witnessmerkleroot", block.hashWitnessMerkleRoot.GetHex());
-
-    UniValue deltas(UniValue::VARR);
-
-    for (unsigned int i = 0; i < block.vtx.size(); i++) {
-        const CTransaction &tx = *(block.vtx[i]);
-        const uint256 txhash = tx.GetHash();
-
-        UniValue entry(UniValue::VOBJ);
-        entry.pushKV("txid", txhash.GetHex());
-        entry.pushKV("index", (int)i);
-
-        UniValue inputs(UniValue::VARR);
-
-        if (!tx.IsCoinBase()) {
-
-            for (size_t j = 0; j < tx.vin.size(); j++) {
-                const CTxIn input = tx.vin[j];
-
-                UniValue delta(UniValue::VOBJ);
-
-                CSpentIndexValue spentInfo;
-                CSpentIndexKey spentKey(input.prevout.hash, input.prevout.n);
-
-                if (GetSpentIndex(chainman, spentKey, spentInfo, pmempool)) {
-                    std::string address;
-                    if (!getAddressFromIndex(spentInfo.addressType, spentInfo.addressHash, address)) {
-                        continue;
-                    }
-                    delta.pushKV("address", address);
-                    delta.pushKV("satoshis", -1 * spentInfo.satoshis);
-                    delta.pushKV("index", (int)j);
-                    delta.pushKV("prevtxid", input.prevout.hash.GetHex());
-                    delta.pushKV("prevout", (int)input.prevout.n);
-
-                    inputs.push_back(delta);
-                } else {
-                    throw JSONRPCError(RPC_INTERNAL_ERROR, "Spent information not available");
-                }
-            }
-        }
-
-        entry.pushKV("inputs", inputs);
+    result.pushKV("version", blockindex->nVersion);
+    result.pushKV("merkleroot", blockindex->hashMerkleRoot.GetHex());
+    result.pushKV("witnessmerkleroot", blockindex->hashWitnessMerkleRoot.GetHex());
 
-        UniValue outputs(UniValue::VARR);
-
-        for (unsigned int k = 0; k < tx.vpout.size(); k++) {
-            const CTxOutBase *out = tx.vpout[k].get();
-
-            UniValue delta(UniValue::VOBJ);
-
-            delta.pushKV("index", (int)k);
-
-            switch (out->GetType())
-            {
-                case OUTPUT_STANDARD:
-                    {
-                    delta.pushKV("type", "standard");
-                    CTxOutStandard *s = (CTxOutStandard*) out;
-                    delta.pushKV("satoshis", s->nValue);
-                    AddAddress(&s->scriptPubKey, delta);
-                    }
-                    break;
-                case OUTPUT_CT:
-                    {
-                    CTxOutCT *s = (CTxOutCT*) out;
-                    delta.pushKV("type", "blind");
-                    delta.pushKV("valueCommitment", HexStr(Span<const unsigned char>(s->commitment.data, 33)));
-                    AddAddress(&s->scriptPubKey, delta);
-                    }
-                    break;
-                case OUTPUT_RINGCT:
-                    {
-                    CTxOutRingCT *s = (CTxOutRingCT*) out;
-                    delta.pushKV("type", "anon");
-                    delta.pushKV("pubkey", HexStr(s->pk));
-                    delta.pushKV("valueCommitment", HexStr(Span<const unsigned char>(s->commitment.data, 33)));
-                    }
-                    break;
-                default:
-                    continue;
-                    break;
-            };
-
-            outputs.push_back(delta);
-        }
-
-        entry.pushKV("outputs", outputs);
-        deltas.push_back(entry);
-
-    }
     result.pushKV("deltas", deltas);
-    PushTime(result, "time", block.GetBlockTime());
+    PushTime(result, "time", blockindex->GetBlockTime());
     PushTime(result, "mediantime", blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
+    result.pushKV("nonce", (uint64_t)blockindex->nNonce);
+    result.pushKV("bits", strprintf("%08x", blockindex->nBits));
     result.pushKV("difficulty", GetDifficulty(blockindex));
     result.pushKV("chainwork", blockindex->nChainWork.GetHex());
 
@@ -829,18 +1047,38 @@ return RPCHelpMan{"getblockdeltas",
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
     }
 
-    CBlock block;
     CBlockIndex *pblockindex = chainman.m_blockman.LookupBlockIndex(hash);
 
-    if (chainman.m_blockman.m_have_pruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0) {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+    // Only report blocks on the main chain
+    if (!chainman.ActiveChain().Contains(pblockindex)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block is an orphan");
     }
 
-    if (!node::ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    UniValue deltas;
+    unsigned int block_size = 0;
+    BlockDeltasCache *deltas_cache = node.block_deltas_cache.get();
+    if (!deltas_cache || !deltas_cache->Lookup(hash, deltas, block_size)) {
+        BlockDeltasRecord record;
+        if (chainman.m_blockman.m_have_pruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0) {
+            if (!fSpentIndex || !chainman.m_blockman.m_block_tree_db->ReadBlockDeltasIndex(hash, record)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+            }
+        } else {
+            CBlock block;
+            if (!node::ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+            }
+            GetBlockDeltasRecord(block, record);
+        }
+
+        deltas = BlockToDeltas(chainman, record, &mempool);
+        block_size = record.block_size;
+        if (deltas_cache) {
+            deltas_cache->Add(hash, deltas, block_size);
+        }
     }
 
-    return blockToDeltasJSON(chainman, block, pblockindex, &mempool);
+    return blockToDeltasJSON(chainman, pblockindex, deltas, block_size);
 },
     };
 }
@@ -848,7 +1086,8 @@ return RPCHelpMan{"getblockdeltas",
 static RPCHelpMan getblockhashes()
 {
     return RPCHelpMan{"getblockhashes",
-                "\nReturns array of hashes of blocks within the timestamp range provided.\n",
+                "\nReturns array of hashes of blocks within the timestamp range provided.\n"
+                "Requires -timestampindex unless noOrphans is set.\n",
                 {
                     {"high", RPCArg::Type::NUM, RPCArg::Optional::NO, "The newer block timestamp."},
                     {"low", RPCArg::Type::NUM, RPCArg::Optional::NO, "The older block timestamp."},
@@ -856,6 +1095,9 @@ static RPCHelpMan getblockhashes()
                         {
                             {"noOrphans", RPCArg::Type::BOOL, RPCArg::Default{false}, "Only include blocks on the main chain."},
                             {"logicalTimes", RPCArg::Type::BOOL, RPCArg::Default{false}, "Include logical timestamps with hashes."},
+                            {"limit", RPCArg::Type::NUM, RPCArg::Default{0}, "Maximum number of hashes to return, 0 for no limit."},
+                            {"afterTime", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "Continue after the block with this logical timestamp and afterHash, from the last entry of a limited query."},
+                            {"afterHash", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "Continue after the block with this hash and afterTime."},
                         },
                         "options"},
                 },
@@ -884,11 +1126,16 @@ static RPCHelpMan getblockhashes()
     unsigned int low = request.params[1].getInt<int>();
     bool fActiveOnly = false;
     bool fLogicalTS = false;
+    size_t max_results = 0;
+    std::optional<CTimestampIndexKey> after;
 
     if (request.params.size() > 2) {
         if (request.params[2].isObject()) {
             UniValue noOrphans = find_value(request.params[2].get_obj(), "noOrphans");
             UniValue returnLogical = find_value(request.params[2].get_obj(), "logicalTimes");
+            UniValue limit = find_value(request.params[2].get_obj(), "limit");
+            UniValue after_time = find_value(request.params[2].get_obj(), "afterTime");
+            UniValue after_hash = find_value(request.params[2].get_obj(), "afterHash");
 
             if (noOrphans.isBool()) {
                 fActiveOnly = noOrphans.get_bool();
@@ -896,16 +1143,31 @@ static RPCHelpMan getblockhashes()
             if (returnLogical.isBool()) {
                 fLogicalTS = returnLogical.get_bool();
             }
+            if (limit.isNum()) {
+                int64_t n = limit.getInt<int64_t>();
+                if (n < 0) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "limit must not be negative");
+                }
+                max_results = n;
+            }
+            if (after_time.isNull() != after_hash.isNull()) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "afterTime and afterHash must be set together");
+            }
+            if (!after_time.isNull()) {
+                after = CTimestampIndexKey(after_time.getInt<int>(), ParseHashV(after_hash, "afterHash"));
+            }
         }
     }
 
     std::vector<std::pair<uint256, unsigned int> > blockHashes;
 
-    {
-        LOCK(cs_main);
-        if (!GetTimestampIndex(chainman, high, low, fActiveOnly, blockHashes)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
-        }
+    if (!fActiveOnly && g_timestamp_index && !g_timestamp_index->BlockUntilSyncedToCurrentChain()) {
+        const IndexSummary summary{g_timestamp_index->GetSummary()};
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Unable to get data because timestampindex is still syncing. Current height: %d", summary.best_block_height));
+    }
+
+    if (!GetTimestampIndex(chainman, high, low, fActiveOnly, blockHashes, max_results, after ? &*after : nullptr)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
     }
 
     UniValue result(UniValue::VARR);
@@ -926,17 +1188,27 @@ static RPCHelpMan getblockhashes()
     };
 }
 
+static UniValue ScriptTypeStatsToJSON(const ScriptTypeStats &stats)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("num_plain", stats.num_plain);
+    ret.pushKV("num_blinded", stats.num_blinded);
+    ret.pushKV("total_amount", ValueFromAmount(stats.total_amount));
+    return ret;
+}
+
 static RPCHelpMan gettxoutsetinfobyscript()
 {
     return RPCHelpMan{"gettxoutsetinfobyscript",
                 "\nReturns statistics about the unspent transaction output set per script type.\n"
-                "This call may take some time.\n",
+                "This call may take some time without -coinscriptstatsindex.\n",
                 {
+                    {"hash_or_height", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The block hash or height of the target height (only available with coinscriptstatsindex).", "", {"", "string or numeric"}},
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "", {
-                        {RPCResult::Type::NUM, "height", "The current block height (index)"},
-                        {RPCResult::Type::STR_HEX, "bestblock", "The best block hash hex"},
+                        {RPCResult::Type::NUM, "height", "The block height (index) of the returned statistics"},
+                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at which these statistics are calculated"},
                         {RPCResult::Type::OBJ, "paytopubkeyhash", "", {
                             {RPCResult::Type::NUM, "num_plain", "Number of plain outputs"},
                             {RPCResult::Type::NUM, "num_blinded", "Number of blinded outputs"},
@@ -958,6 +1230,7 @@ static RPCHelpMan gettxoutsetinfobyscript()
                 },
                 RPCExamples{
             HelpExampleCli("gettxoutsetinfobyscript", "") +
+            HelpExampleCli("gettxoutsetinfobyscript", "1000") +
             "\nAs a JSON-RPC call\n"
             + HelpExampleRpc("gettxoutsetinfobyscript", "")
                 },
@@ -966,78 +1239,60 @@ static RPCHelpMan gettxoutsetinfobyscript()
     ChainstateManager &chainman = EnsureAnyChainman(request.context);
     UniValue ret(UniValue::VOBJ);
 
-    int nHeight;
-    uint256 hashBlock;
-
-    std::unique_ptr<CCoinsViewCursor> pcursor;
-    {
-        LOCK(cs_main);
-        chainman.ActiveChainstate().ForceFlushStateToDisk();
-        pcursor = std::unique_ptr<CCoinsViewCursor>(chainman.ActiveChainstate().CoinsDB().Cursor());
-        assert(pcursor);
-        hashBlock = pcursor->GetBestBlock();
+    const CBlockIndex *pindex{nullptr};
+    CoinScriptStats stats;
 
-        nHeight = chainman.m_blockman.LookupBlockIndex(hashBlock)->nHeight;
+    if (!request.params[0].isNull()) {
+        if (!g_coin_script_stats_index) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires coinscriptstatsindex");
+        }
+        pindex = ParseHashOrHeight(request.params[0], chainman);
     }
 
-    class PerScriptTypeStats {
-    public:
-        int64_t nPlain = 0;
-        int64_t nBlinded = 0;
-        int64_t nPlainValue = 0;
-
-        UniValue ToUV()
+    // Use the index when it has caught up, or for a block it has already passed
+    if (g_coin_script_stats_index && (g_coin_script_stats_index->BlockUntilSyncedToCurrentChain() || pindex)) {
+        if (!pindex) {
+            pindex = WITH_LOCK(cs_main, return chainman.ActiveChain().Tip());
+        }
+        const IndexSummary summary{g_coin_script_stats_index->GetSummary()};
+        if (pindex->nHeight > summary.best_block_height) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Unable to get data because coinscriptstatsindex is still syncing. Current height: %d", summary.best_block_height));
+        }
+        std::optional<CoinScriptStats> index_stats = g_coin_script_stats_index->LookUpStats(pindex);
+        if (!index_stats) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        stats = *index_stats;
+    } else {
+        std::unique_ptr<CCoinsViewCursor> pcursor;
         {
-            UniValue ret(UniValue::VOBJ);
-            ret.pushKV("num_plain", nPlain);
-            ret.pushKV("num_blinded", nBlinded);
-            ret.pushKV("total_amount", ValueFromAmount(nPlainValue));
-            return ret;
+            LOCK(cs_main);
+            chainman.ActiveChainstate().ForceFlushStateToDisk();
+            pcursor = std::unique_ptr<CCoinsViewCursor>(chainman.ActiveChainstate().CoinsDB().Cursor());
+            assert(pcursor);
+            pindex = chainman.m_blockman.LookupBlockIndex(pcursor->GetBestBlock());
         }
-    };
-
-    PerScriptTypeStats statsPKH;
-    PerScriptTypeStats statsSH;
-    PerScriptTypeStats statsCSPKH;
-    PerScriptTypeStats statsCSSH;
-    PerScriptTypeStats statsOther;
-
-    while (pcursor->Valid()) {
-        if (ShutdownRequested()) return false;
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            PerScriptTypeStats *ps = &statsOther;
-            if (coin.out.scriptPubKey.IsPayToPublicKeyHash()) {
-                ps = &statsPKH;
-            } else if (coin.out.scriptPubKey.IsPayToScriptHash()) {
-                ps = &statsSH;
-            } else if (coin.out.scriptPubKey.IsPayToPublicKeyHash256_CS()) {
-                ps = &statsCSPKH;
-            } else if (coin.out.scriptPubKey.IsPayToScriptHash256_CS() || coin.out.scriptPubKey.IsPayToScriptHash_CS()) {
-                ps = &statsCSSH;
-            }
 
-            if (coin.nType == OUTPUT_STANDARD) {
-                ps->nPlain++;
-                ps->nPlainValue += coin.out.nValue;
-            } else
-            if (coin.nType == OUTPUT_CT) {
-                ps->nBlinded++;
+        while (pcursor->Valid()) {
+            if (ShutdownRequested()) return false;
+            COutPoint key;
+            Coin coin;
+            if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+                stats.Update(coin, true);
+            } else {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
             }
-        } else {
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            pcursor->Next();
         }
-        pcursor->Next();
     }
 
-    ret.pushKV("height", (int64_t)nHeight);
-    ret.pushKV("bestblock", hashBlock.GetHex());
-    ret.pushKV("paytopubkeyhash", statsPKH.ToUV());
-    ret.pushKV("paytoscripthash", statsSH.ToUV());
-    ret.pushKV("coldstake_paytopubkeyhash", statsCSPKH.ToUV());
-    ret.pushKV("coldstake_paytoscripthash", statsCSSH.ToUV());
-    ret.pushKV("other", statsOther.ToUV());
+    ret.pushKV("height", (int64_t)pindex->nHeight);
+    ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
+    ret.pushKV("paytopubkeyhash", ScriptTypeStatsToJSON(stats.types[COIN_SCRIPT_PUBKEYHASH]));
+    ret.pushKV("paytoscripthash", ScriptTypeStatsToJSON(stats.types[COIN_SCRIPT_SCRIPTHASH]));
+    ret.pushKV("coldstake_paytopubkeyhash", ScriptTypeStatsToJSON(stats.types[COIN_SCRIPT_CS_PUBKEYHASH]));
+    ret.pushKV("coldstake_paytoscripthash", ScriptTypeStatsToJSON(stats.types[COIN_SCRIPT_CS_SCRIPTHASH]));
+    ret.pushKV("other", ScriptTypeStatsToJSON(stats.types[COIN_SCRIPT_OTHER]));
 
     return ret;
 },
@@ -1072,65 +1327,20 @@ static void pushScript(UniValue &uv, const std::string &name, const CScript *scr
     uv.pushKV(name, uvs);
 }
 
-static RPCHelpMan getblockreward()
+static constexpr int MAX_BLOCK_REWARDS{10000};
+
+/** Collect the reward breakdown of the block at pblockindex, from the block reward index when enabled */
+static bool GetBlockRewardInfo(node::NodeContext &node, ChainstateManager &chainman, const CBlockIndex *pblockindex, BlockReward &reward) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    return RPCHelpMan{"getblockreward",
-                "\nReturns the blockreward for block at height.\n",
-                {
-                    {"height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The chain height of the block."},
-                },
-                RPCResult{
-                    RPCResult::Type::OBJ, "", "", {
-                        {RPCResult::Type::STR_HEX, "blockhash", "The hash of the block"},
-                        {RPCResult::Type::STR_HEX, "coinstake", "The hash of the coinstake transaction"},
-                        {RPCResult::Type::NUM_TIME, "blocktime", "The block time expressed in " _UNIX_EPOCH_TIME},
-                        {RPCResult::Type::STR_AMOUNT, "stakereward", "The stake reward portion, newly minted coin"},
-                        {RPCResult::Type::STR_AMOUNT, "blockreward", "The block reward, value paid to staker, including fees"},
-                        {RPCResult::Type::STR_AMOUNT, "treasuryreward", /*optional=*/true, "The accumulated treasury reward payout, if any"},
-                        {RPCResult::Type::OBJ, "kernelscript", "", {
-                            {RPCResult::Type::STR_HEX, "hex", "The script from the kernel output"},
-                            {RPCResult::Type::STR, "stakeaddr", /*optional=*/true, "The stake address, if output script is coldstake"},
-                            {RPCResult::Type::STR, "spendaddr", "The spend address"},
-                        }},
-                        {RPCResult::Type::ARR, "outputs", "", {
-                            {RPCResult::Type::OBJ, "", "", {
-                                {RPCResult::Type::OBJ, "script", "", {
-                                    {RPCResult::Type::STR_HEX, "hex", "The script from the kernel output"},
-                                    {RPCResult::Type::STR, "stakeaddr", /*optional=*/true, "The stake address, if output script is coldstake"},
-                                    {RPCResult::Type::STR, "spendaddr", "The spend address"},
-                                }},
-                                {RPCResult::Type::STR_AMOUNT, "value", "The value of the output"},
-                            }},
-                        }}
-                    }
-                },
-                RPCExamples{
-            HelpExampleCli("getblockreward", "1000") +
-            "\nAs a JSON-RPC call\n"
-            + HelpExampleRpc("getblockreward", "1000")
-                },
-        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
-{
-    RPCTypeCheck(request.params, {UniValue::VNUM});
-
-    node::NodeContext &node = EnsureAnyNodeContext(request.context);
-    ChainstateManager &chainman = EnsureAnyChainman(request.context);
-    if (!g_txindex) {
-        throw JSONRPCError(RPC_MISC_ERROR, "Requires -txindex enabled");
+    if (GetBlockReward(chainman, pblockindex->GetBlockHash(), reward)) {
+        return true;
     }
-
-    int nHeight = request.params[0].getInt<int>();
-    if (nHeight < 0 || nHeight > chainman.ActiveChain().Height()) {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+    if (!g_txindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Requires -txindex or -blockrewardindex enabled");
     }
 
-    LOCK(cs_main);
-
-    CBlockIndex *pblockindex = chainman.ActiveChain()[nHeight];
-
-    CAmount stake_reward = 0;
     if (pblockindex->pprev) {
-        stake_reward = Params().GetProofOfStakeReward(pblockindex->pprev, 0);
+        reward.stake_reward = Params().GetProofOfStakeReward(pblockindex->pprev, 0);
     }
 
     CBlock block;
@@ -1146,28 +1356,28 @@ static RPCHelpMan getblockreward()
     }
 
     const auto &tx = block.vtx[0];
+    if (tx->IsCoinStake()) {
+        reward.coinstake_txid = tx->GetHash();
+        tx->GetSmsgFeeRate(reward.smsg_fee_rate);
+        tx->GetSmsgDifficulty(reward.smsg_difficulty);
+    }
 
-    UniValue outputs(UniValue::VARR);
-    CAmount value_out = 0, value_in = 0, value_treasury = 0;
+    CAmount value_out = 0, value_in = 0;
     for (const auto &txout : tx->vpout) {
         if (!txout->IsStandardOutput()) {
             continue;
         }
 
-        UniValue output(UniValue::VOBJ);
-        pushScript(output, "script", txout->GetPScriptPubKey());
-        output.pushKV("value", ValueFromAmount(txout->GetValue()));
-        outputs.push_back(output);
+        reward.outputs.emplace_back(*txout->GetPScriptPubKey(), txout->GetValue());
 
         if (fundconf && *txout->GetPScriptPubKey() == fundScriptPubKey) {
-            value_treasury += txout->GetValue();
+            reward.treasury_reward += txout->GetValue();
             continue;
         }
 
         value_out += txout->GetValue();
     }
 
-    CScript kernel_script;
     int n = -1;
     for (const auto& txin : tx->vin) {
         n++;
@@ -1186,31 +1396,174 @@ static RPCHelpMan getblockreward()
         }
         value_in += tx_prev->vpout[txin.prevout.n]->GetValue();
         if (n == 0) {
-            kernel_script = *tx_prev->vpout[txin.prevout.n]->GetPScriptPubKey();
+            reward.kernel_script = *tx_prev->vpout[txin.prevout.n]->GetPScriptPubKey();
         }
     }
 
-    CAmount block_reward = value_out - value_in;
+    reward.block_reward = value_out - value_in;
+    return false;
+}
 
+static UniValue BlockRewardToJSON(const CBlockIndex *pblockindex, const BlockReward &reward, bool from_index)
+{
     UniValue rv(UniValue::VOBJ);
+    rv.pushKV("height", pblockindex->nHeight);
     rv.pushKV("blockhash", pblockindex->GetBlockHash().ToString());
-    if (tx->IsCoinStake()) {
-        rv.pushKV("coinstake", tx->GetHash().ToString());
+    if (!reward.coinstake_txid.IsNull()) {
+        rv.pushKV("coinstake", reward.coinstake_txid.ToString());
     }
 
     rv.pushKV("blocktime", pblockindex->GetBlockTime());
-    rv.pushKV("stakereward", ValueFromAmount(stake_reward));
-    rv.pushKV("blockreward", ValueFromAmount(block_reward));
+    rv.pushKV("difficulty", GetDifficulty(pblockindex));
+    rv.pushKV("stakereward", ValueFromAmount(reward.stake_reward));
+    rv.pushKV("blockreward", ValueFromAmount(reward.block_reward));
 
-    if (value_treasury > 0) {
-        rv.pushKV("treasuryreward", ValueFromAmount(value_treasury));
+    if (reward.treasury_reward > 0) {
+        rv.pushKV("treasuryreward", ValueFromAmount(reward.treasury_reward));
+    }
+    if (from_index) {
+        rv.pushKV("fees", ValueFromAmount(reward.fees));
+    }
+    if (reward.smsg_fee_rate > 0) {
+        rv.pushKV("smsgfeerate", ValueFromAmount(reward.smsg_fee_rate));
+    }
+    if (reward.smsg_difficulty > 0) {
+        rv.pushKV("smsgdifficulty", strprintf("%08x", reward.smsg_difficulty));
     }
 
-    if (tx->IsCoinStake()) {
-        pushScript(rv, "kernelscript", &kernel_script);
+    if (!reward.coinstake_txid.IsNull()) {
+        pushScript(rv, "kernelscript", &reward.kernel_script);
+    }
+    UniValue outputs(UniValue::VARR);
+    for (const auto &output : reward.outputs) {
+        UniValue uv_output(UniValue::VOBJ);
+        pushScript(uv_output, "script", &output.first);
+        uv_output.pushKV("value", ValueFromAmount(output.second));
+        outputs.push_back(uv_output);
     }
     rv.pushKV("outputs", outputs);
 
+    return rv;
+}
+
+static std::vector<RPCResult> BlockRewardResultFields()
+{
+    return {
+        {RPCResult::Type::NUM, "height", "The chain height of the block"},
+        {RPCResult::Type::STR_HEX, "blockhash", "The hash of the block"},
+        {RPCResult::Type::STR_HEX, "coinstake", "The hash of the coinstake transaction"},
+        {RPCResult::Type::NUM_TIME, "blocktime", "The block time expressed in " _UNIX_EPOCH_TIME},
+        {RPCResult::Type::NUM, "difficulty", "The proof-of-stake difficulty"},
+        {RPCResult::Type::STR_AMOUNT, "stakereward", "The stake reward portion, newly minted coin"},
+        {RPCResult::Type::STR_AMOUNT, "blockreward", "The block reward, value paid to staker, including fees"},
+        {RPCResult::Type::STR_AMOUNT, "treasuryreward", /*optional=*/true, "The accumulated treasury reward payout, if any"},
+        {RPCResult::Type::STR_AMOUNT, "fees", /*optional=*/true, "The fees paid by the other transactions in the block, if -blockrewardindex is enabled"},
+        {RPCResult::Type::STR_AMOUNT, "smsgfeerate", /*optional=*/true, "The smsg fee rate set by the coinstake, if any"},
+        {RPCResult::Type::STR_HEX, "smsgdifficulty", /*optional=*/true, "The compact smsg difficulty set by the coinstake, if any"},
+        {RPCResult::Type::OBJ, "kernelscript", "", {
+            {RPCResult::Type::STR_HEX, "hex", "The script from the kernel output"},
+            {RPCResult::Type::STR, "stakeaddr", /*optional=*/true, "The stake address, if output script is coldstake"},
+            {RPCResult::Type::STR, "spendaddr", "The spend address"},
+        }},
+        {RPCResult::Type::ARR, "outputs", "", {
+            {RPCResult::Type::OBJ, "", "", {
+                {RPCResult::Type::OBJ, "script", "", {
+                    {RPCResult::Type::STR_HEX, "hex", "The script from the kernel output"},
+                    {RPCResult::Type::STR, "stakeaddr", /*optional=*/true, "The stake address, if output script is coldstake"},
+                    {RPCResult::Type::STR, "spendaddr", "The spend address"},
+                }},
+                {RPCResult::Type::STR_AMOUNT, "value", "The value of the output"},
+            }},
+        }}
+    };
+}
+
+static RPCHelpMan getblockreward()
+{
+    return RPCHelpMan{"getblockreward",
+                "\nReturns the blockreward for block at height.\n"
+                "Read from the block reward index if -blockrewardindex is enabled, otherwise requires -txindex.\n",
+                {
+                    {"height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The chain height of the block."},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "", BlockRewardResultFields()
+                },
+                RPCExamples{
+            HelpExampleCli("getblockreward", "1000") +
+            "\nAs a JSON-RPC call\n"
+            + HelpExampleRpc("getblockreward", "1000")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    RPCTypeCheck(request.params, {UniValue::VNUM});
+
+    node::NodeContext &node = EnsureAnyNodeContext(request.context);
+    ChainstateManager &chainman = EnsureAnyChainman(request.context);
+
+    int nHeight = request.params[0].getInt<int>();
+
+    LOCK(cs_main);
+    if (nHeight < 0 || nHeight > chainman.ActiveChain().Height()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+    }
+
+    const CBlockIndex *pblockindex = chainman.ActiveChain()[nHeight];
+    BlockReward reward;
+    bool from_index = GetBlockRewardInfo(node, chainman, pblockindex, reward);
+
+    return BlockRewardToJSON(pblockindex, reward, from_index);
+},
+    };
+}
+
+static RPCHelpMan getblockrewards()
+{
+    return RPCHelpMan{"getblockrewards",
+                "\nReturns the blockrewards for a range of heights.\n"
+                "Read from the block reward index if -blockrewardindex is enabled, otherwise requires -txindex.\n",
+                {
+                    {"start_height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The chain height of the first block."},
+                    {"count", RPCArg::Type::NUM, RPCArg::Default{100}, strprintf("The number of blocks to return, at most %d. Stops at the chain tip.", MAX_BLOCK_REWARDS)},
+                },
+                RPCResult{
+                    RPCResult::Type::ARR, "", "", {
+                        {RPCResult::Type::OBJ, "", "", BlockRewardResultFields()},
+                    }
+                },
+                RPCExamples{
+            HelpExampleCli("getblockrewards", "1000 500") +
+            "\nAs a JSON-RPC call\n"
+            + HelpExampleRpc("getblockrewards", "1000, 500")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VNUM});
+
+    node::NodeContext &node = EnsureAnyNodeContext(request.context);
+    ChainstateManager &chainman = EnsureAnyChainman(request.context);
+
+    int start_height = request.params[0].getInt<int>();
+    int count = request.params[1].isNull() ? 100 : request.params[1].getInt<int>();
+    if (count < 1 || count > MAX_BLOCK_REWARDS) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %d", MAX_BLOCK_REWARDS));
+    }
+
+    LOCK(cs_main);
+    const CChain &active_chain = chainman.ActiveChain();
+    if (start_height < 0 || start_height > active_chain.Height()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+    }
+
+    UniValue rv(UniValue::VARR);
+    int end_height = std::min(active_chain.Height(), start_height + count - 1);
+    for (int height = start_height; height <= end_height; ++height) {
+        const CBlockIndex *pblockindex = active_chain[height];
+        BlockReward reward;
+        bool from_index = GetBlockRewardInfo(node, chainman, pblockindex, reward);
+        rv.push_back(BlockRewardToJSON(pblockindex, reward, from_index));
+    }
+
     return rv;
 },
     };
@@ -1281,6 +1634,166 @@ return RPCHelpMan{"getblockbalances",
     };
 }
 
+static void ParseCSStakeAddress(const std::string &address, TxoutType &stake_type, CKeyID256 &stake_id)
+{
+    CTxDestination stake_dest = DecodeDestination(address, true);
+    if (stake_dest.index() == DI::_PKHash) {
+        stake_type = TxoutType::PUBKEYHASH;
+        PKHash id = std::get<PKHash>(stake_dest);
+        stake_id.SetNull();
+        memcpy(stake_id.begin(), id.begin(), 20);
+    } else
+    if (stake_dest.index() == DI::_CKeyID256) {
+        stake_type = TxoutType::PUBKEYHASH256;
+        stake_id = std::get<CKeyID256>(stake_dest);
+    } else {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unrecognised stake address type.");
+    }
+}
+
+static std::string EncodeCSSpendAddress(TxoutType spend_type, const CKeyID256 &spend_id)
+{
+    switch (spend_type) {
+        case TxoutType::PUBKEYHASH: {
+            PKHash idk;
+            memcpy(idk.begin(), spend_id.begin(), 20);
+            return EncodeDestination(idk);
+            }
+        case TxoutType::PUBKEYHASH256:
+            return EncodeDestination(spend_id);
+        case TxoutType::SCRIPTHASH: {
+            ScriptHash ids;
+            memcpy(ids.begin(), spend_id.begin(), 20);
+            return EncodeDestination(ids);
+            }
+        case TxoutType::SCRIPTHASH256: {
+            CScriptID256 ids;
+            memcpy(ids.begin(), spend_id.begin(), 32);
+            return EncodeDestination(ids);
+            }
+        default:
+            break;
+    }
+    return "unknown_type";
+}
+
+static constexpr int MAX_BLOCK_BALANCES{10000};
+
+static RPCHelpMan getblockbalancesrange()
+{
+return RPCHelpMan{"getblockbalancesrange",
+        "\nReturns the block balances of a range of active chain blocks.\n",
+        {
+            {"start", RPCArg::Type::NUM, RPCArg::Optional::NO, "The height of the first block, or the earliest block time if bytime is set"},
+            {"end", RPCArg::Type::NUM, RPCArg::Optional::NO, "The height of the last block, or the latest block time if bytime is set"},
+            {"options", RPCArg::Type::OBJ, RPCArg::Default{UniValue::VOBJ}, "",
+                {
+                    {"in_sats", RPCArg::Type::BOOL, RPCArg::Default{false}, "Display values in satoshis"},
+                    {"bytime", RPCArg::Type::BOOL, RPCArg::Default{false}, "start and end are block times expressed in " + UNIX_EPOCH_TIME},
+                    {"step", RPCArg::Type::NUM, RPCArg::Default{1}, "Return every step'th block from start"},
+                },
+                "options"},
+        },
+        RPCResult{
+            RPCResult::Type::ARR, "", "", {
+                {RPCResult::Type::OBJ, "", "", {
+                    {RPCResult::Type::NUM, "height", "The height of the block"},
+                    {RPCResult::Type::STR_HEX, "blockhash", "The hash of the block"},
+                    {RPCResult::Type::NUM_TIME, "time", "The block time expressed in " + UNIX_EPOCH_TIME},
+                    {RPCResult::Type::STR_AMOUNT, "plain", "Total in plain balance."},
+                    {RPCResult::Type::STR_AMOUNT, "blind", "Total in blind balance."},
+                    {RPCResult::Type::STR_AMOUNT, "anon", "Total in anon balance."}
+                }},
+            }
+        },
+        RPCExamples{
+        HelpExampleCli("getblockbalancesrange", "1000 2000 \"{\\\"step\\\":100}\"") +
+        "\nAs a JSON-RPC call\n"
+        + HelpExampleRpc("getblockbalancesrange", "1000, 2000, {\"step\":100}")
+        },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VNUM, UniValue::VOBJ}, true);
+    ChainstateManager &chainman = EnsureAnyChainman(request.context);
+
+    bool in_sats = false, by_time = false;
+    int step = 1;
+    if (request.params[2].isObject()) {
+        const UniValue &options = request.params[2];
+        RPCTypeCheckObj(options,
+            {
+                {"in_sats", UniValueType(UniValue::VBOOL)},
+                {"bytime", UniValueType(UniValue::VBOOL)},
+                {"step", UniValueType(UniValue::VNUM)},
+            },
+            true, true);
+        if (options["in_sats"].isBool()) {
+            in_sats = options["in_sats"].get_bool();
+        }
+        if (options["bytime"].isBool()) {
+            by_time = options["bytime"].get_bool();
+        }
+        if (options["step"].isNum()) {
+            step = options["step"].getInt<int>();
+        }
+    }
+    if (step < 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "step must be positive");
+    }
+
+    LOCK(cs_main);
+
+    if (!fBalancesIndex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Balances index is not enabled.");
+    }
+
+    const CChain &active_chain = chainman.ActiveChain();
+    int64_t start = request.params[0].getInt<int64_t>();
+    int64_t end = request.params[1].getInt<int64_t>();
+    int start_height, end_height;
+    if (by_time) {
+        const CBlockIndex *pindex_start = active_chain.FindEarliestAtLeast(start, 0);
+        const CBlockIndex *pindex_end = active_chain.FindEarliestAtLeast(end + 1, 0);
+        start_height = pindex_start ? pindex_start->nHeight : active_chain.Height() + 1;
+        end_height = pindex_end ? pindex_end->nHeight - 1 : active_chain.Height();
+    } else {
+        if (start < 0 || start > active_chain.Height()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+        }
+        start_height = start;
+        end_height = std::min(end, (int64_t)active_chain.Height());
+    }
+
+    UniValue rv(UniValue::VARR);
+    if (end_height < start_height) {
+        return rv;
+    }
+    if ((end_height - start_height) / step >= MAX_BLOCK_BALANCES) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Range returns more than %d blocks, increase step", MAX_BLOCK_BALANCES));
+    }
+
+    std::vector<std::pair<const CBlockIndex*, BlockBalances> > block_balances;
+    if (!GetBlockBalancesRange(chainman, start_height, end_height, step, block_balances)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unable to get balances info");
+    }
+
+    for (auto &entry : block_balances) {
+        BlockBalances &balances = entry.second;
+        UniValue uv(UniValue::VOBJ);
+        uv.pushKV("height", entry.first->nHeight);
+        uv.pushKV("blockhash", entry.first->GetBlockHash().ToString());
+        uv.pushKV("time", entry.first->GetBlockTime());
+        uv.pushKV("plain", in_sats ? balances.plain() : ValueFromAmount(balances.plain()));
+        uv.pushKV("blind", in_sats ? balances.blind() : ValueFromAmount(balances.blind()));
+        uv.pushKV("anon",  in_sats ? balances.anon()  : ValueFromAmount(balances.anon()));
+        rv.push_back(uv);
+    }
+
+    return rv;
+},
+    };
+}
+
 static RPCHelpMan listcoldstakeunspent()
 {
     return RPCHelpMan{"listcoldstakeunspent",
@@ -1325,18 +1838,7 @@ static RPCHelpMan listcoldstakeunspent()
     ChainstateManager &chainman = EnsureAnyChainman(request.context);
 
     ColdStakeIndexLinkKey seek_key;
-    CTxDestination stake_dest = DecodeDestination(request.params[0].get_str(), true);
-    if (stake_dest.index() == DI::_PKHash) {
-        seek_key.m_stake_type = TxoutType::PUBKEYHASH;
-        PKHash id = std::get<PKHash>(stake_dest);
-        memcpy(seek_key.m_stake_id.begin(), id.begin(), 20);
-    } else
-    if (stake_dest.index() == DI::_CKeyID256) {
-        seek_key.m_stake_type = TxoutType::PUBKEYHASH256;
-        seek_key.m_stake_id = std::get<CKeyID256>(stake_dest);
-    } else {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unrecognised stake address type.");
-    }
+    ParseCSStakeAddress(request.params[0].get_str(), seek_key.m_stake_type, seek_key.m_stake_id);
 
     CDBWrapper &db = g_txindex->GetDB();
 
@@ -1412,32 +1914,7 @@ static RPCHelpMan listcoldstakeunspent()
                         output.pushKV("n", ok.m_n);
                     }
 
-                    switch (lk.m_spend_type) {
-                        case TxoutType::PUBKEYHASH: {
-                            PKHash idk;
-                            memcpy(idk.begin(), lk.m_spend_id.begin(), 20);
-                            output.pushKV("addrspend", EncodeDestination(idk));
-                            }
-                            break;
-                        case TxoutType::PUBKEYHASH256:
-                            output.pushKV("addrspend", EncodeDestination(lk.m_spend_id));
-                            break;
-                        case TxoutType::SCRIPTHASH: {
-                            ScriptHash ids;
-                            memcpy(ids.begin(), lk.m_spend_id.begin(), 20);
-                            output.pushKV("addrspend", EncodeDestination(ids));
-                            }
-                            break;
-                        case TxoutType::SCRIPTHASH256: {
-                            CScriptID256 ids;
-                            memcpy(ids.begin(), lk.m_spend_id.begin(), 32);
-                            output.pushKV("addrspend", EncodeDestination(ids));
-                            }
-                            break;
-                        default:
-                            output.pushKV("addrspend", "unknown_type");
-                            break;
-                    }
+                    output.pushKV("addrspend", EncodeCSSpendAddress(lk.m_spend_type, lk.m_spend_id));
 
                     rv.push_back(output);
                 }
@@ -1451,6 +1928,147 @@ static RPCHelpMan listcoldstakeunspent()
     };
 }
 
+static RPCHelpMan listcoldstakedelegations()
+{
+    return RPCHelpMan{"listcoldstakedelegations",
+                "\nReturns the unspent totals of \"stakeaddress\" at the current height, per spending address.\n"
+                "Read from totals kept by the csindex, the outputs are not scanned.\n",
+                {
+                    {"stakeaddress", RPCArg::Type::STR, RPCArg::Optional::NO, "The stakeaddress to list delegations of."},
+                    {"options", RPCArg::Type::OBJ, RPCArg::Default{UniValue::VOBJ}, "",
+                        {
+                            {"cursor", RPCArg::Type::STR_HEX, RPCArg::DefaultHint{"first spending address"}, "Continue from \"next\" of the previous result."},
+                            {"limit", RPCArg::Type::NUM, RPCArg::Default{1000}, "Return at most \"limit\" spending addresses."},
+                        },
+                        "options"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::NUM, "num_unspent", "The number of unspent outputs of stakeaddress"},
+                        {RPCResult::Type::STR_AMOUNT, "value", "The total value of the unspent outputs"},
+                        {RPCResult::Type::ARR, "delegations", "", {
+                            {RPCResult::Type::OBJ, "", "", {
+                                {RPCResult::Type::STR, "addrspend", "The spending address"},
+                                {RPCResult::Type::NUM, "num_unspent", "The number of unspent outputs"},
+                                {RPCResult::Type::STR_AMOUNT, "value", "The total value of the unspent outputs"},
+                            }}
+                        }},
+                        {RPCResult::Type::STR_HEX, "next", /*optional=*/true, "Pass as \"cursor\" to continue, set if more spending addresses remain"},
+                    }
+                },
+                RPCExamples{
+            HelpExampleCli("listcoldstakedelegations", "\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"") +
+            HelpExampleCli("listcoldstakedelegations", "\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\" \"{\\\"limit\\\":100}\"") +
+            "\nAs a JSON-RPC call\n"
+            + HelpExampleRpc("listcoldstakedelegations", "\"Pb7FLL3DyaAVP2eGfRiEkj4U8ZJ3RHLY9g\"")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    RPCTypeCheck(request.params, {UniValue::VSTR, UniValue::VOBJ}, true);
+
+    if (!g_txindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Requires -txindex enabled");
+    }
+    if (!g_txindex->m_cs_index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Requires -csindex enabled");
+    }
+
+    ColdStakeIndexSpendKey seek_key;
+    ParseCSStakeAddress(request.params[0].get_str(), seek_key.m_stake_type, seek_key.m_stake_id);
+
+    size_t limit = 1000;
+    std::optional<ColdStakeIndexSpendKey> cursor;
+    if (request.params[1].isObject()) {
+        const UniValue &options = request.params[1];
+        RPCTypeCheckObj(options,
+            {
+                {"cursor", UniValueType(UniValue::VSTR)},
+                {"limit", UniValueType(UniValue::VNUM)},
+            },
+            true, true);
+        if (options["cursor"].isStr()) {
+            const std::string &str_cursor = options["cursor"].get_str();
+            if (!IsHex(str_cursor)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "\"cursor\" must be a hex string");
+            }
+            CDataStream ss(ParseHex(str_cursor), SER_DISK, CLIENT_VERSION);
+            ColdStakeIndexSpendKey key;
+            try {
+                ss >> key;
+            } catch (const std::exception &e) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid \"cursor\"");
+            }
+            if (!ss.empty() || key.m_stake_type != seek_key.m_stake_type || key.m_stake_id != seek_key.m_stake_id) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid \"cursor\"");
+            }
+            cursor = key;
+        }
+        if (!options["limit"].isNull()) {
+            int n = options["limit"].getInt<int>();
+            if (n < 1) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "\"limit\" must be greater than zero");
+            }
+            limit = n;
+        }
+    }
+
+    CDBWrapper &db = g_txindex->GetDB();
+
+    const ColdStakeIndexStakeKey &stake_key = seek_key;
+    ColdStakeIndexTotal stake_total;
+    db.Read(std::make_pair(DB_TXINDEX_CSSTAKETOTAL, stake_key), stake_total);
+
+    UniValue delegations(UniValue::VARR);
+    std::optional<ColdStakeIndexSpendKey> next;
+    size_t num_spendaddresses = 0;
+
+    std::unique_ptr<CDBIterator> it(db.NewIterator());
+    if (cursor) {
+        it->Seek(std::make_pair(DB_TXINDEX_CSSPENDTOTAL, *cursor));
+    } else {
+        it->Seek(std::make_pair(DB_TXINDEX_CSSPENDTOTAL, stake_key));
+    }
+    std::pair<uint8_t, ColdStakeIndexSpendKey> key;
+    while (it->Valid() && it->StartsWith(DB_TXINDEX_CSSPENDTOTAL) && it->GetKey(key)) {
+        const ColdStakeIndexSpendKey &sk = key.second;
+        if (key.first != DB_TXINDEX_CSSPENDTOTAL ||
+            sk.m_stake_type != seek_key.m_stake_type ||
+            sk.m_stake_id != seek_key.m_stake_id) {
+            break;
+        }
+        if (num_spendaddresses >= limit) {
+            next = sk;
+            break;
+        }
+
+        ColdStakeIndexTotal total;
+        if (!it->GetValue(total)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Cannot read coldstake totals.");
+        }
+        UniValue delegation(UniValue::VOBJ);
+        delegation.pushKV("addrspend", EncodeCSSpendAddress(sk.m_spend_type, sk.m_spend_id));
+        delegation.pushKV("num_unspent", total.m_num_unspent);
+        delegation.pushKV("value", ValueFromAmount(total.m_value));
+        delegations.push_back(delegation);
+        num_spendaddresses++;
+        it->Next();
+    }
+
+    UniValue rv(UniValue::VOBJ);
+    rv.pushKV("num_unspent", stake_total.m_num_unspent);
+    rv.pushKV("value", ValueFromAmount(stake_total.m_value));
+    rv.pushKV("delegations", delegations);
+    if (next) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << *next;
+        rv.pushKV("next", HexStr(ss));
+    }
+
+    return rv;
+},
+    };
+}
+
 static RPCHelpMan getinsightinfo()
 {
     return RPCHelpMan{"getinsightinfo",
@@ -1461,10 +2079,19 @@ static RPCHelpMan getinsightinfo()
                 RPCResult::Type::OBJ, "", "", {
                     {RPCResult::Type::BOOL, "txindex", "True if txindex is enabled"},
                     {RPCResult::Type::BOOL, "addressindex", "True if addressindex is enabled"},
+                    {RPCResult::Type::BOOL, "addressbalanceindex", "True if getaddressbalance reads the per address totals, false for databases indexed before they were added"},
                     {RPCResult::Type::BOOL, "spentindex", "True if spentindex is enabled"},
                     {RPCResult::Type::BOOL, "timestampindex", "True if timestampindex is enabled"},
                     {RPCResult::Type::BOOL, "coldstakeindex", "True if coldstakeindex is enabled"},
                     {RPCResult::Type::BOOL, "balancesindex", "True if balancesindex is enabled"},
+                    {RPCResult::Type::BOOL, "blockrewardindex", "True if blockrewardindex is enabled"},
+                    {RPCResult::Type::OBJ, "rctcache", /*optional=*/true, "Anon output cache, omitted if disabled",
+                    {
+                        {RPCResult::Type::NUM, "entries", "Number of cached anon outputs"},
+                        {RPCResult::Type::NUM, "maxentries", "Maximum number of cached anon outputs"},
+                        {RPCResult::Type::NUM, "hits", "Lookups served from the cache"},
+                        {RPCResult::Type::NUM, "misses", "Lookups read from the db"},
+                    }},
                 }
             },
             RPCExamples{
@@ -1478,11 +2105,24 @@ static RPCHelpMan getinsightinfo()
 
     ret.pushKV("txindex", (g_txindex ? true : false));
     ret.pushKV("addressindex", fAddressIndex);
+    ret.pushKV("addressbalanceindex", fAddressBalanceIndex);
     ret.pushKV("spentindex", fSpentIndex);
-    ret.pushKV("timestampindex", fTimestampIndex);
+    ret.pushKV("timestampindex", (bool) g_timestamp_index);
     ret.pushKV("balancesindex", fBalancesIndex);
+    ret.pushKV("blockrewardindex", fBlockRewardIndex);
     ret.pushKV("coldstakeindex", (bool) (g_txindex && g_txindex->m_cs_index));
 
+    ChainstateManager &chainman = EnsureAnyChainman(request.context);
+    CRCTOutputCache::Stats rct_cache_stats;
+    if (WITH_LOCK(cs_main, return chainman.m_blockman.m_block_tree_db->GetRCTOutputCacheStats(rct_cache_stats))) {
+        UniValue rct_cache(UniValue::VOBJ);
+        rct_cache.pushKV("entries", (uint64_t)rct_cache_stats.entries);
+        rct_cache.pushKV("maxentries", (uint64_t)rct_cache_stats.max_entries);
+        rct_cache.pushKV("hits", rct_cache_stats.hits);
+        rct_cache.pushKV("misses", rct_cache_stats.misses);
+        ret.pushKV("rctcache", rct_cache);
+    }
+
     return ret;
 },
     };
@@ -1491,20 +2131,23 @@ static RPCHelpMan getinsightinfo()
 void RegisterInsightRPCCommands(CRPCTable &t)
 {
     static const CRPCCommand commands[]{
-        {"addressindex", &getaddressmempool},
-        {"addressindex", &getaddressutxos},
-        {"addressindex", &getaddressdeltas},
-        {"addressindex", &getaddresstxids},
-        {"addressindex", &getaddressbalance},
-
-        {"blockchain", &getspentinfo},
-        {"blockchain", &getblockdeltas},
+        {"addressindex", &getaddressmempool, true},
+        {"addressindex", &getaddressutxos, true},
+        {"addressindex", &getaddressdeltas, true},
+        {"addressindex", &getaddresstxids, true},
+        {"addressindex", &getaddressbalance, true},
+
+        {"blockchain", &getspentinfo, true},
+        {"blockchain", &getblockdeltas, true},
         {"blockchain", &getblockhashes},
         {"blockchain", &gettxoutsetinfobyscript},
         {"blockchain", &getblockreward},
+        {"blockchain", &getblockrewards},
         {"blockchain", &getblockbalances},
+        {"blockchain", &getblockbalancesrange},
 
         {"csindex", &listcoldstakeunspent},
+        {"csindex", &listcoldstakedelegations},
 
         {"blockchain", &getinsightinfo},
     };
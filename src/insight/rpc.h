@@ -5,8 +5,31 @@
 #ifndef PARTICL_INSIGHT_RPC_H
 #define PARTICL_INSIGHT_RPC_H
 
+#include <consensus/amount.h>
+#include <uint256.h>
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+class ChainstateManager;
 class CRPCTable;
+class UniValue;
+struct CAddressIndexKey;
 
 void RegisterInsightRPCCommands(CRPCTable &t);
 
+/** Parse the "addresses" of params[0], throws a JSONRPCError on an invalid address */
+bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint256, int> > &addresses);
+/** Parse the "cursor" and "limit" paging options shared by getaddressdeltas and getaddresstxids */
+void ParseAddressPageOptions(const UniValue &params, std::optional<CAddressIndexKey> &cursor, size_t &limit);
+/**
+ * Read the deltas of addresses in order, starting at cursor if set.
+ * Stops after limit entries if limit is nonzero, next is set to the first entry not returned.
+ */
+void ReadAddressIndexPage(ChainstateManager &chainman, const std::vector<std::pair<uint256, int> > &addresses,
+                          int start, int end, const std::optional<CAddressIndexKey> &cursor, size_t limit,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          std::optional<CAddressIndexKey> &next);
+
 #endif // PARTICL_INSIGHT_RPC_H
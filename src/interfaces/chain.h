@@ -5,6 +5,7 @@
 #ifndef BITCOIN_INTERFACES_CHAIN_H
 #define BITCOIN_INTERFACES_CHAIN_H
 
+#include <blockfilter.h>
 #include <primitives/transaction.h> // For CTransactionRef
 #include <util/settings.h>          // For util::SettingsValue
 
@@ -39,6 +40,7 @@ class CBlockIndex;
 class CCmpPubKey;
 class CAnonOutput;
 class CAnonKeyImageInfo;
+class CKeyImageSpend;
 
 namespace interfaces {
 
@@ -63,6 +65,8 @@ public:
     //! Read block data from disk. If the block exists but doesn't have data
     //! (for example due to pruning), the CBlock variable will be set to null.
     FoundBlock& data(CBlock& data) { m_data = &data; return *this; }
+    //! Return a locator for the block, reaching back through its ancestors.
+    FoundBlock& locator(CBlockLocator& locator) { m_locator = &locator; return *this; }
 
     uint256* m_hash = nullptr;
     int* m_height = nullptr;
@@ -72,6 +76,7 @@ public:
     bool* m_in_active_chain = nullptr;
     const FoundBlock* m_next_block = nullptr;
     CBlock* m_data = nullptr;
+    CBlockLocator* m_locator = nullptr;
     mutable bool found = false;
 };
 
@@ -171,6 +176,13 @@ public:
     //! the height range from min_height to max_height, inclusive.
     virtual bool hasBlocks(const uint256& block_hash, int min_height = 0, std::optional<int> max_height = {}) = 0;
 
+    //! Returns whether a block filter index is available.
+    virtual bool hasBlockFilterIndex(BlockFilterType filter_type) = 0;
+
+    //! Returns whether any of the elements match the block via a BIP 157 block filter
+    //! or std::nullopt if the block filter for this block couldn't be found.
+    virtual std::optional<bool> blockFilterMatchesAny(BlockFilterType filter_type, const uint256& block_hash, const GCSFilter::ElementSet& filter_set) = 0;
+
     //! Check if transaction is RBF opt in.
     virtual RBFTransactionState isRBFOptIn(const CTransaction& tx) = 0;
 
@@ -304,6 +316,10 @@ public:
     //! Particl Specific
     virtual int getHeightInt() = 0;
     virtual size_t getAnonOutputs() = 0;
+    //! Number of anon outputs in the chain up to and including height, -1 if height is not in the chain
+    virtual int64_t getAnonOutputsAtHeight(int height) = 0;
+    //! Height of the block containing anon output i, -1 if not in the chain
+    virtual int getAnonOutputHeight(int64_t i) = 0;
     virtual int64_t getSmsgFeeRate(ChainstateManager &chainman, const CBlockIndex *pindex, bool reduce_height=false) = 0;
     virtual CTransactionRef transactionFromMempool(const uint256 &txhash) = 0;
     virtual std::unique_ptr<node::CBlockTemplate> createNewBlock() = 0;
@@ -313,6 +329,8 @@ public:
     virtual bool readRCTOutput(int64_t i, CAnonOutput &ao) = 0;
     virtual bool readRCTOutputLink(const CCmpPubKey &pk, int64_t &i) = 0;
     virtual bool readRCTKeyImage(const CCmpPubKey &ki, CAnonKeyImageInfo &ki_data) = 0;
+    //! Spent state of each key image from the chain and mempool, in one call
+    virtual void checkKeyImages(const std::vector<CCmpPubKey> &key_images, std::vector<CKeyImageSpend> &states) = 0;
 };
 
 //! Interface to let node manage chain clients (wallets, or maybe tools for
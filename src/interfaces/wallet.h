@@ -58,6 +58,7 @@ struct WalletTxStatus;
 
 using WalletOrderForm = std::vector<std::pair<std::string, std::string>>;
 using WalletValueMap = std::map<std::string, std::string>;
+using WalletTxChanges = std::vector<std::pair<uint256, ChangeType>>;
 
 //! Interface for accessing a wallet.
 class Wallet
@@ -193,6 +194,12 @@ public:
     //! Get list of all wallet transactions.
     virtual std::vector<WalletTx> getWalletTxs() = 0;
 
+    //! Get the txids of all wallet transactions and records, newest first.
+    virtual std::vector<uint256> getWalletTxHashes() = 0;
+
+    //! Get transaction information of txids, txids not in the wallet are skipped.
+    virtual std::vector<WalletTx> getWalletTxs(const std::vector<uint256>& txids) = 0;
+
     //! Try to get updated status for a particular transaction, if possible without blocking.
     virtual bool tryGetTxStatus(const uint256& txid,
         WalletTxStatus& tx_status,
@@ -310,6 +317,10 @@ public:
     using TransactionChangedFn = std::function<void(const uint256& txid, ChangeType status)>;
     virtual std::unique_ptr<Handler> handleTransactionChanged(TransactionChangedFn fn) = 0;
 
+    //! Register handler for transaction changed messages coalesced per connected block or rescan chunk.
+    using TransactionsChangedFn = std::function<void(const WalletTxChanges& changes)>;
+    virtual std::unique_ptr<Handler> handleTransactionsChanged(TransactionsChangedFn fn) = 0;
+
     //! Register handler for watchonly changed messages.
     using WatchOnlyChangedFn = std::function<void(bool have_watch_only)>;
     virtual std::unique_ptr<Handler> handleWatchOnlyChanged(WatchOnlyChangedFn fn) = 0;
@@ -340,6 +351,8 @@ public:
     virtual bool isHardwareLinkedWallet() = 0;
     virtual CAmount getCredit(const CTxOutBase *txout, wallet::isminefilter filter) = 0;
     virtual wallet::isminetype txoutIsMine(const CTxOutBase *txout) = 0;
+    //! Memory held by the wallet's records, key maps and caches, empty for non Particl wallets.
+    virtual std::map<std::string, size_t> getMemoryUsage() = 0;
 };
 
 //! Wallet chain client that in addition to having chain client methods for
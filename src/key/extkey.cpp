@@ -9,6 +9,7 @@
 #include <crypto/hmac_sha512.h>
 
 #include <stdint.h>
+#include <thread>
 
 RecursiveMutex cs_extKey;
 
@@ -607,6 +608,51 @@ std::string CStoredExtKey::GetIDString58() const
     return HDKeyIDToString(kp.GetID());
 };
 
+//! Keys each DeriveKeys thread should derive at least
+static constexpr uint32_t MIN_KEYS_PER_DERIVE_THREAD = 64;
+
+int CStoredExtKey::DeriveKeys(std::vector<std::pair<uint32_t, CPubKey> > &vOut, uint32_t nChildIn, uint32_t nKeys, size_t nThreads) const
+{
+    vOut.clear();
+    if ((nChildIn >> 31) == 1) {
+        return errorN(1, "No more keys can be derived from master.");
+    }
+    nKeys = std::min(nKeys, ((uint32_t)1 << 31) - nChildIn);
+
+    std::vector<CPubKey> vKeys(nKeys);
+    std::vector<uint8_t> vValid(nKeys, 0);
+    auto derive_range = [&](uint32_t nBegin, uint32_t nEnd) {
+        for (uint32_t i = nBegin; i < nEnd; ++i) {
+            vValid[i] = kp.Derive(vKeys[i], nChildIn + i);
+        }
+    };
+
+    if (nThreads == 0) {
+        nThreads = std::max(1, GetNumCores());
+    }
+    nThreads = std::min(nThreads, (size_t)(nKeys / MIN_KEYS_PER_DERIVE_THREAD));
+    if (nThreads < 2) {
+        derive_range(0, nKeys);
+    } else {
+        std::vector<std::thread> vThreads;
+        uint32_t nPerThread = (nKeys + nThreads - 1) / nThreads;
+        for (uint32_t nBegin = 0; nBegin < nKeys; nBegin += nPerThread) {
+            vThreads.emplace_back(derive_range, nBegin, std::min(nKeys, nBegin + nPerThread));
+        }
+        for (auto &t : vThreads) {
+            t.join();
+        }
+    }
+
+    vOut.reserve(nKeys);
+    for (uint32_t i = 0; i < nKeys; ++i) {
+        if (vValid[i]) {
+            vOut.emplace_back(nChildIn + i, vKeys[i]);
+        }
+    }
+    return 0;
+};
+
 int CStoredExtKey::SetPath(const std::vector<uint32_t> &vPath_)
 {
     if (vPath_.size() < 1) {
@@ -632,27 +678,105 @@ int CExtKeyAccount::HaveSavedKey(const CKeyID &id)
 {
     LOCK(cs_account);
 
-    AccKeyMap::const_iterator mi = mapKeys.find(id);
-    if (mi != mapKeys.end()) {
+    if (FindSavedKey(id)) {
         return HK_YES;
     }
     return HK_NO;
 };
 
+const CEKAKey *CExtKeyAccount::FindSavedKey(const CKeyID &id) const
+{
+    LOCK(cs_account);
+
+    AccKeyMap::const_iterator mi = mapKeys.find(id);
+    if (mi != mapKeys.end()) {
+        return &mi->second;
+    }
+
+    std::vector<uint32_t> vPacks;
+    if (!m_read_key_pack || !m_key_pack_index.GetPacks(id, vPacks)) {
+        return nullptr;
+    }
+    const CEKAKey *pak = m_key_cache.Get(id);
+    if (pak) {
+        return pak;
+    }
+    std::vector<CEKAKeyPack> ekPak;
+    for (auto nPack : vPacks) {
+        if (!m_read_key_pack(nPack, ekPak)) {
+            LogPrintf("%s: Read key pack %u failed, account %s.\n", __func__, nPack, GetIDString58());
+            continue;
+        }
+        for (const auto &entry : ekPak) {
+            if (entry.id == id) {
+                return m_key_cache.Put(id, entry.ak);
+            }
+        }
+    }
+    return nullptr;
+};
+
+const CEKASCKey *CExtKeyAccount::FindStealthChildKey(const CKeyID &id) const
+{
+    LOCK(cs_account);
+
+    AccKeySCMap::const_iterator mi = mapStealthChildKeys.find(id);
+    if (mi != mapStealthChildKeys.end()) {
+        return &mi->second;
+    }
+
+    std::vector<uint32_t> vPacks;
+    if (!m_read_stealth_child_key_pack || !m_stealth_child_pack_index.GetPacks(id, vPacks)) {
+        return nullptr;
+    }
+    const CEKASCKey *pasc = m_stealth_child_key_cache.Get(id);
+    if (pasc) {
+        return pasc;
+    }
+    std::vector<CEKASCKeyPack> asckPak;
+    for (auto nPack : vPacks) {
+        if (!m_read_stealth_child_key_pack(nPack, asckPak)) {
+            LogPrintf("%s: Read stealth child key pack %u failed, account %s.\n", __func__, nPack, GetIDString58());
+            continue;
+        }
+        for (const auto &entry : asckPak) {
+            if (entry.id == id) {
+                return m_stealth_child_key_cache.Put(id, entry.asck);
+            }
+        }
+    }
+    return nullptr;
+};
+
+size_t CExtKeyAccount::NumStealthChildKeys(const CKeyID &idStealthKey) const
+{
+    LOCK(cs_account);
+
+    size_t nKeys = 0;
+    for (const auto &entry : mapStealthChildKeys) {
+        if (entry.second.idStealthKey == idStealthKey) {
+            nKeys++;
+        }
+    }
+    auto it = m_num_packed_stealth_child_keys.find(idStealthKey);
+    if (it != m_num_packed_stealth_child_keys.end()) {
+        nKeys += it->second;
+    }
+    return nKeys;
+};
+
 int CExtKeyAccount::HaveKey(const CKeyID &id, bool fUpdate, const CEKAKey *&pak, const CEKASCKey *&pasc, wallet::isminetype &ismine)
 {
     // If fUpdate, promote key if found in look ahead
     LOCK(cs_account);
 
     pasc = nullptr;
-    AccKeyMap::const_iterator mi = mapKeys.find(id);
-    if (mi != mapKeys.end()) {
-        pak = &mi->second;
+    if ((pak = FindSavedKey(id)) != nullptr) {
         ismine = IsMine(pak->nParent);
         return HK_YES;
     }
 
-    mi = mapLookAhead.find(id);
+    AccKeyMap::const_iterator mi = mapLookAhead.find(id);
     if (mi != mapLookAhead.end()) {
         pak = &mi->second;
         ismine = IsMine(pak->nParent);
@@ -670,9 +794,7 @@ int CExtKeyAccount::HaveStealthKey(const CKeyID &id, const CEKASCKey *&pasc, wal
 {
     LOCK(cs_account);
 
-    AccKeySCMap::const_iterator miSck = mapStealthChildKeys.find(id);
-    if (miSck != mapStealthChildKeys.end()) {
-        pasc = &miSck->second;
+    if ((pasc = FindStealthChildKey(id)) != nullptr) {
         AccStealthKeyMap::const_iterator miSk = mapStealthKeys.find(pasc->idStealthKey);
         if (miSk == mapStealthKeys.end()) {
             ismine = wallet::ISMINE_NO;
@@ -730,18 +852,18 @@ int CExtKeyAccount::GetKey(const CKeyID &id, CKey &keyOut, CEKAKey &ak, CKeyID &
     LOCK(cs_account);
 
     int rv = KS_NONE;
-    AccKeyMap::const_iterator mi;
-    AccKeySCMap::const_iterator miSck;
-    if ((mi = mapKeys.find(id)) != mapKeys.end()) {
-        ak = mi->second;
+    const CEKAKey *pak;
+    const CEKASCKey *pasc;
+    if ((pak = FindSavedKey(id)) != nullptr) {
+        ak = *pak;
         if (!GetKey(ak, keyOut)) {
             return KS_NONE;
         }
         rv = KS_ACCOUNT_CHAIN;
     } else
-    if ((miSck = mapStealthChildKeys.find(id)) != mapStealthChildKeys.end()) {
-        idStealth = miSck->second.idStealthKey;
-        if (!GetKey(miSck->second, keyOut)) {
+    if ((pasc = FindStealthChildKey(id)) != nullptr) {
+        idStealth = pasc->idStealthKey;
+        if (!GetKey(*pasc, keyOut)) {
             return KS_NONE;
         }
         rv = KS_STEALTH;
@@ -758,15 +880,15 @@ int CExtKeyAccount::GetKey(const CKeyID &id, CKey &keyOut, CEKAKey &ak, CKeyID &
 bool CExtKeyAccount::GetPubKey(const CKeyID &id, CPubKey &pkOut) const
 {
     LOCK(cs_account);
-    AccKeyMap::const_iterator mi;
-    AccKeySCMap::const_iterator miSck;
-    if ((mi = mapKeys.find(id)) != mapKeys.end()) {
-        if (!GetPubKey(mi->second, pkOut)) {
+    const CEKAKey *pak;
+    const CEKASCKey *pasc;
+    if ((pak = FindSavedKey(id)) != nullptr) {
+        if (!GetPubKey(*pak, pkOut)) {
             return false;
         }
     } else
-    if ((miSck = mapStealthChildKeys.find(id)) != mapStealthChildKeys.end()) {
-        if (!GetPubKey(miSck->second, pkOut)) {
+    if ((pasc = FindStealthChildKey(id)) != nullptr) {
+        if (!GetPubKey(*pasc, pkOut)) {
             return false;
         }
     } else {
@@ -819,8 +941,7 @@ bool CExtKeyAccount::SaveKey(const CKeyID &id, const CEKAKey &keyIn)
 {
     // Take a key from lookahead and save it to the wallet.
     LOCK(cs_account);
-    AccKeyMap::const_iterator mi = mapKeys.find(id);
-    if (mi != mapKeys.end()) {
+    if (FindSavedKey(id)) {
         return false; // Already saved
     }
 
@@ -897,8 +1018,7 @@ bool CExtKeyAccount::SaveKey(const CKeyID &id, const CEKAKey &keyIn)
 bool CExtKeyAccount::SaveKey(const CKeyID &id, const CEKASCKey &keyIn)
 {
     LOCK(cs_account);
-    AccKeySCMap::const_iterator mi = mapStealthChildKeys.find(id);
-    if (mi != mapStealthChildKeys.end()) {
+    if (FindStealthChildKey(id)) {
         return false; // already saved
     }
 
@@ -964,7 +1084,7 @@ int CExtKeyAccount::AddLookBehind(uint32_t nChain, uint32_t nKeys)
             nChild = nChildOut-1;
 
             keyId = pk.GetID();
-            if ((mi = mapKeys.find(keyId)) != mapKeys.end()) {
+            if (FindSavedKey(keyId)) {
                 if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
                     LogPrintf("%s: key exists in map skipping %s.\n", __func__, EncodeDestination(PKHash(keyId)));
                 }
@@ -1002,54 +1122,54 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
         return errorN(1, "%s: Unknown chain, %d.", __func__, nChain);
     }
 
-    AccKeyMap::const_iterator mi;
     uint32_t nChild = std::max(pc->nGenerated, pc->nLastLookAhead);
-    uint32_t nChildOut = nChild;
 
     if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-        LogPrintf("%s: chain %s, keys %d, from %d.\n", __func__, pc->GetIDString58(), nKeys, nChildOut);
+        LogPrintf("%s: chain %s, keys %d, from %d.\n", __func__, pc->GetIDString58(), nKeys, nChild);
     }
 
-    CKeyID keyId;
-    CPubKey pk;
-    for (uint32_t k = 0; k < nKeys; ++k) {
-        bool fGotKey = false;
-
-        uint32_t nMaxTries = 1000; // TODO: link to lookahead size
-        for (uint32_t i = 0; i < nMaxTries; ++i) { // nMaxTries > lookahead pool
-            if (pc->DeriveKey(pk, nChild, nChildOut, false) != 0) {
-                LogPrintf("Warning: %s - DeriveKey failed, chain %d, child %d.\n", __func__, nChain, nChild);
-                nChild = nChildOut + 1;
-                continue;
-            }
-            nChild = nChildOut + 1;
+    // Derive the keys still needed in one batch, keys already in the maps are skipped and replaced by the next batch
+    uint32_t nAdded = 0, nSkipped = 0;
+    uint32_t nMaxSkipped = 1000; // TODO: link to lookahead size
+    std::vector<std::pair<uint32_t, CPubKey> > vDerived;
+    while (nAdded < nKeys) {
+        uint32_t nBatch = nKeys - nAdded;
+        if (pc->DeriveKeys(vDerived, nChild, nBatch) != 0) {
+            LogPrintf("Error: %s - DeriveKeys failed, chain %d, child %d.\n", __func__, nChain, nChild);
+            break;
+        }
+        if (vDerived.size() < nBatch) {
+            LogPrintf("Warning: %s - DeriveKey failed for %d keys, chain %d, from child %d.\n", __func__, nBatch - vDerived.size(), nChain, nChild);
+        }
+        nSkipped += nBatch - vDerived.size();
+        nChild += nBatch;
 
-            keyId = pk.GetID();
-            if ((mi = mapKeys.find(keyId)) != mapKeys.end()) {
+        for (const auto &derived : vDerived) {
+            CKeyID keyId = derived.second.GetID();
+            if (FindSavedKey(keyId)) {
                 if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
                     LogPrintf("%s: key exists in map skipping %s.\n", __func__, EncodeDestination(PKHash(keyId)));
                 }
+                nSkipped++;
                 continue;
             }
-
-            if ((mi = mapLookAhead.find(keyId)) != mapLookAhead.end()) {
+            if (mapLookAhead.count(keyId)) {
+                nSkipped++;
                 continue;
             }
 
-            fGotKey = true;
-            break;
-        }
+            mapLookAhead[keyId] = CEKAKey(nChain, derived.first);
+            pc->nLastLookAhead = derived.first;
+            nAdded++;
 
-        if (!fGotKey) {
-            LogPrintf("Error: %s - DeriveKey loop failed, chain %d, child %d.\n", __func__, nChain, nChild);
-            continue;
+            if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
+                LogPrintf("%s: Added %s, look-ahead size %u.\n", __func__, EncodeDestination(PKHash(keyId)), mapLookAhead.size());
+            }
         }
 
-        mapLookAhead[keyId] = CEKAKey(nChain, nChildOut);
-        pc->nLastLookAhead = nChildOut;
-
-        if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-            LogPrintf("%s: Added %s, look-ahead size %u.\n", __func__, EncodeDestination(PKHash(keyId)), mapLookAhead.size());
+        if (nSkipped > nMaxSkipped) {
+            LogPrintf("Error: %s - DeriveKey loop failed, chain %d, child %d.\n", __func__, nChain, nChild);
+            break;
         }
     }
 
@@ -7,6 +7,7 @@
 #define PARTICL_KEY_EXTKEY_H
 
 #include <util/system.h>
+#include <crypto/common.h>
 #include <key.h>
 #include <key/stealth.h>
 #include <key/types.h>
@@ -14,11 +15,16 @@
 #include <sync.h>
 #include <script/ismine.h>
 
+#include <algorithm>
+#include <functional>
+#include <list>
+
 static const uint32_t MAX_DERIVE_TRIES = 16;
 static const uint32_t BIP32_KEY_LEN = 82;       // Raw, 74 + 4 bytes id + 4 checksum
 static const uint32_t BIP32_KEY_N_BYTES = 74;   // Raw without id and checksum
 
 static const uint32_t MAX_KEY_PACK_SIZE = 128;
+static const uint32_t DEFAULT_KEY_PACK_CACHE_SIZE = 10000;
 static const uint32_t DEFAULT_LOOKAHEAD_SIZE = 64;
 
 static const uint32_t BIP44_PURPOSE = (((uint32_t)44) | (1 << 31));
@@ -365,6 +371,12 @@ public:
         return 0;
     };
 
+    /**
+     * Derive the non-hardened pubkeys of children nChildIn to nChildIn + nKeys - 1, split across up to nThreads threads, 0 for one per core.
+     * Children that fail to derive are left out, vOut is in child order.
+     */
+    int DeriveKeys(std::vector<std::pair<uint32_t, CPubKey> > &vOut, uint32_t nChildIn, uint32_t nKeys, size_t nThreads = 0) const;
+
     int SetCounter(uint32_t nC, bool fHardened)
     {
         if (fHardened) {
@@ -683,6 +695,79 @@ typedef std::map<CKeyID, CEKAKey> AccKeyMap;
 typedef std::map<CKeyID, CEKASCKey> AccKeySCMap;
 typedef std::map<CKeyID, CEKAStealthKey> AccStealthKeyMap;
 
+/**
+ * Ids of the saved keys left in the wallet db, 12 bytes per key.
+ * Ids are truncated to 64 bits, a match gives the packs that may hold the key.
+ */
+class CKeyPackIndex
+{
+public:
+    void Add(const CKeyID &id, uint32_t nPack)
+    {
+        m_entries.emplace_back(ReadLE64(id.begin()), nPack);
+    };
+    /** Must be called after adding and before GetPacks */
+    void Sort()
+    {
+        std::sort(m_entries.begin(), m_entries.end());
+    };
+    bool GetPacks(const CKeyID &id, std::vector<uint32_t> &vPacks) const
+    {
+        vPacks.clear();
+        uint64_t nShortId = ReadLE64(id.begin());
+        auto it = std::lower_bound(m_entries.begin(), m_entries.end(), std::make_pair(nShortId, (uint32_t)0));
+        for (; it != m_entries.end() && it->first == nShortId; ++it) {
+            vPacks.push_back(it->second);
+        }
+        return !vPacks.empty();
+    };
+    size_t size() const { return m_entries.size(); };
+    bool empty() const { return m_entries.empty(); };
+    void clear() { m_entries.clear(); };
+
+private:
+    std::vector<std::pair<uint64_t, uint32_t> > m_entries;
+};
+
+/** Least recently used entries read from key packs */
+template<typename T>
+class CKeyPackCache
+{
+public:
+    const T *Get(const CKeyID &id)
+    {
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) {
+            return nullptr;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+        return &it->second.first;
+    };
+    const T *Put(const CKeyID &id, const T &entry)
+    {
+        const T *p = Get(id);
+        if (p) {
+            return p;
+        }
+        // Evict before inserting, a pointer returned by the last call stays valid
+        while (m_max_size > 0 && m_entries.size() >= m_max_size) {
+            m_entries.erase(m_lru.back());
+            m_lru.pop_back();
+        }
+        m_lru.push_front(id);
+        auto it = m_entries.emplace(id, std::make_pair(entry, m_lru.begin())).first;
+        return &it->second.first;
+    };
+    void SetMaxSize(size_t nMaxSize) { m_max_size = std::max(nMaxSize, (size_t)2); };
+    size_t size() const { return m_entries.size(); };
+    void clear() { m_entries.clear(); m_lru.clear(); };
+
+private:
+    size_t m_max_size = DEFAULT_KEY_PACK_CACHE_SIZE;
+    std::map<CKeyID, std::pair<T, std::list<CKeyID>::iterator> > m_entries;
+    std::list<CKeyID> m_lru;
+};
+
 class CExtKeyAccount
 { // stored by idAccount
 public:
@@ -818,6 +903,19 @@ public:
 
     int ClearLookAhead();
 
+    /** Saved key, from mapKeys or read from the key packs when they are loaded on demand */
+    const CEKAKey *FindSavedKey(const CKeyID &id) const;
+    const CEKASCKey *FindStealthChildKey(const CKeyID &id) const;
+    size_t NumSavedKeys() const
+    {
+        return mapKeys.size() + m_key_pack_index.size();
+    };
+    size_t NumStealthChildKeys() const
+    {
+        return mapStealthChildKeys.size() + m_stealth_child_pack_index.size();
+    };
+    size_t NumStealthChildKeys(const CKeyID &idStealthKey) const;
+
     int ExpandStealthChildKey(const CEKAStealthKey *aks, const CKey &sShared, CKey &kOut) const;
     int ExpandStealthChildPubKey(const CEKAStealthKey *aks, const CKey &sShared, CPubKey &pkOut) const;
 
@@ -860,12 +958,20 @@ public:
         s >> mapValue;
     };
 
-    // TODO: Could store used keys in archived packs, which don't get loaded into memory
     AccKeyMap mapKeys;
     AccKeyMap mapLookAhead;
 
     AccKeySCMap mapStealthChildKeys; // keys derived from stealth addresses
 
+    // Set when key packs are loaded on demand, saved keys not in mapKeys or mapStealthChildKeys are read through these
+    std::function<bool(uint32_t nPack, std::vector<CEKAKeyPack> &ekPak)> m_read_key_pack;
+    std::function<bool(uint32_t nPack, std::vector<CEKASCKeyPack> &asckPak)> m_read_stealth_child_key_pack;
+    CKeyPackIndex m_key_pack_index;
+    CKeyPackIndex m_stealth_child_pack_index;
+    std::map<CKeyID, size_t> m_num_packed_stealth_child_keys; // by idStealthKey
+    mutable CKeyPackCache<CEKAKey> m_key_cache;
+    mutable CKeyPackCache<CEKASCKey> m_stealth_child_key_cache;
+
     AccStealthKeyMap mapStealthKeys;
     std::set<const CEKAStealthKey*> setLookAheadStealth;
     std::set<const CEKAStealthKey*> setLookAheadStealthV2;
@@ -873,6 +979,9 @@ public:
     std::string sLabel; // account name
     CKeyID idMaster;
 
+    // Address book path of the keys of each chain, without the child index, set by CHDWallet::GetChainAddressPath
+    std::map<uint32_t, std::vector<uint32_t> > mapChainAddressPaths;
+
     uint32_t nActiveExternal;
     uint32_t nActiveInternal;
     uint32_t nActiveStealth;
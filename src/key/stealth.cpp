@@ -5,6 +5,8 @@
 
 #include <key/stealth.h>
 
+#include <crypto/sha256.h>
+#include <hash.h>
 #include <key_io.h>
 #include <key/keyutil.h>
 #include <key/crypter.h>
@@ -12,10 +14,16 @@
 #include <random.h>
 #include <script/script.h>
 #include <serialize.h>
+#include <sync.h>
+#include <util/thread.h>
 
 #include <support/allocators/secure.h>
 
+#include <algorithm>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 #include <secp256k1.h>
 #include <secp256k1_ecdh.h>
 
@@ -353,6 +361,167 @@ bool IsStealthAddress(const std::string &encodedAddress)
     return true;
 };
 
+bool CStealthScanner::AddKey(const CKey &scan_secret, const ec_point &spend_pubkey, uint8_t prefix_bits, uint32_t prefix)
+{
+    if (!scan_secret.IsValid()
+        || spend_pubkey.size() != EC_COMPRESSED_SIZE) {
+        return false;
+    }
+
+    static_assert(sizeof(secp256k1_pubkey) == sizeof(ScanKey::spend_pubkey));
+    secp256k1_pubkey R;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_ctx_stealth, &R, spend_pubkey.data(), EC_COMPRESSED_SIZE)) {
+        return false;
+    }
+
+    uint256 secret_id;
+    CSHA256().Write(scan_secret.begin(), scan_secret.size()).Finalize(secret_id.begin());
+    auto it = m_secret_index.find(secret_id);
+    if (it == m_secret_index.end()) {
+        it = m_secret_index.emplace(secret_id, m_secrets.size()).first;
+        m_secrets.push_back(ScanSecret{scan_secret, {}});
+    }
+
+    ScanKey key;
+    memcpy(key.spend_pubkey.data(), R.data, sizeof(R.data));
+    key.prefix_bits = prefix_bits;
+    key.prefix = prefix;
+    m_secrets[it->second].keys.push_back(m_keys.size());
+    m_keys.push_back(key);
+    return true;
+};
+
+int CStealthScanner::Match(const ec_point &ephem_pubkey, uint32_t prefix, bool have_prefix, const CKeyID &id, CKey &shared_out) const
+{
+    if (ephem_pubkey.size() != EC_COMPRESSED_SIZE) {
+        return MATCH_FAILED;
+    }
+
+    // P, parsed once for all scan secrets
+    secp256k1_pubkey P;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_ctx_stealth, &P, ephem_pubkey.data(), EC_COMPRESSED_SIZE)) {
+        return MATCH_FAILED;
+    }
+
+    int rv = NO_MATCH;
+    for (const auto &scan_secret : m_secrets) {
+        bool any_prefix = false;
+        for (size_t k : scan_secret.keys) {
+            if (MatchStealthPrefix(m_keys[k].prefix_bits, m_keys[k].prefix, prefix, have_prefix)) {
+                any_prefix = true;
+                break;
+            }
+        }
+        if (!any_prefix) {
+            continue;
+        }
+
+        // c = H(dP) and C = cG, once per scan secret
+        CKey shared;
+        secp256k1_pubkey C;
+        if (!secp256k1_ecdh(secp256k1_ctx_stealth, shared.begin_nc(), &P, scan_secret.secret.begin(), nullptr, nullptr)
+            || !secp256k1_ec_pubkey_create(secp256k1_ctx_stealth, &C, shared.begin())) {
+            rv = MATCH_FAILED;
+            continue;
+        }
+
+        for (size_t k : scan_secret.keys) {
+            const ScanKey &key = m_keys[k];
+            if (!MatchStealthPrefix(key.prefix_bits, key.prefix, prefix, have_prefix)) {
+                continue;
+            }
+
+            // R' = R + C
+            secp256k1_pubkey R, R_out;
+            memcpy(R.data, key.spend_pubkey.data(), sizeof(R.data));
+            const secp256k1_pubkey *points[2] = {&R, &C};
+            if (!secp256k1_ec_pubkey_combine(secp256k1_ctx_stealth, &R_out, points, 2)) {
+                rv = MATCH_FAILED;
+                continue;
+            }
+
+            uint8_t pk_out[EC_COMPRESSED_SIZE];
+            size_t len = EC_COMPRESSED_SIZE;
+            secp256k1_ec_pubkey_serialize(secp256k1_ctx_stealth, pk_out, &len, &R_out, SECP256K1_EC_COMPRESSED);
+            if (CKeyID(Hash160(pk_out)) == id) {
+                memcpy(shared_out.begin_nc(), shared.begin(), 32);
+                return static_cast<int>(k);
+            }
+        }
+    }
+
+    return rv;
+};
+
+void CStealthScanner::clear()
+{
+    m_keys.clear();
+    m_secrets.clear();
+    m_secret_index.clear();
+};
+
+void CStealthPrefixIndex::Add(const CStealthAddress *sx)
+{
+    uint8_t nBits = sx->prefix.number_bits;
+    if (nBits < 1) {
+        m_unprefixed.push_back(sx);
+        return;
+    }
+    m_prefixed[nBits].emplace(sx->prefix.bitfield & SetStealthMask(nBits), sx);
+};
+
+void CStealthPrefixIndex::Remove(const CStealthAddress *sx)
+{
+    uint8_t nBits = sx->prefix.number_bits;
+    if (nBits < 1) {
+        m_unprefixed.erase(std::remove(m_unprefixed.begin(), m_unprefixed.end(), sx), m_unprefixed.end());
+        return;
+    }
+    auto mi = m_prefixed.find(nBits);
+    if (mi == m_prefixed.end()) {
+        return;
+    }
+    auto range = mi->second.equal_range(sx->prefix.bitfield & SetStealthMask(nBits));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == sx) {
+            mi->second.erase(it);
+            break;
+        }
+    }
+    if (mi->second.empty()) {
+        m_prefixed.erase(mi);
+    }
+};
+
+void CStealthPrefixIndex::GetCandidates(uint32_t prefix, bool have_prefix, std::vector<const CStealthAddress*> &candidates) const
+{
+    candidates = m_unprefixed;
+    if (!have_prefix) {
+        return;
+    }
+    for (const auto &mi : m_prefixed) {
+        auto range = mi.second.equal_range(prefix & SetStealthMask(mi.first));
+        for (auto it = range.first; it != range.second; ++it) {
+            candidates.push_back(it->second);
+        }
+    }
+};
+
+size_t CStealthPrefixIndex::size() const
+{
+    size_t rv = m_unprefixed.size();
+    for (const auto &mi : m_prefixed) {
+        rv += mi.second.size();
+    }
+    return rv;
+};
+
+void CStealthPrefixIndex::clear()
+{
+    m_unprefixed.clear();
+    m_prefixed.clear();
+};
+
 uint32_t FillStealthPrefix(uint8_t nBits, uint32_t nBitfield)
 {
     uint32_t prefix, mask = SetStealthMask(nBits);
@@ -436,10 +605,11 @@ int PrepareStealthOutput(const CStealthAddress &sx, const std::string &sNarratio
     CScript &scriptPubKey, std::vector<uint8_t> &vData, std::string &sError)
 {
     CKey sShared, sEphem;
+    CPubKey pkEphem;
     ec_point pkSendTo;
     int k, nTries = 24;
     for (k = 0; k < nTries; ++k) { // if StealthSecret fails try again with new ephem key
-        sEphem.MakeNewKey(true);
+        GetEphemeralKey(sEphem, pkEphem);
         if (StealthSecret(sEphem, sx.scan_pubkey, sx.spend_pubkey, sShared, pkSendTo) == 0) {
             break;
         }
@@ -447,7 +617,6 @@ int PrepareStealthOutput(const CStealthAddress &sx, const std::string &sNarratio
     if (k >= nTries) {
         return errorN(1, sError, __func__, "Could not generate receiving public key.");
     }
-    CPubKey pkEphem = sEphem.GetPubKey();
     scriptPubKey = GetScriptForDestination(PKHash(CPubKey(pkSendTo)));
 
     uint32_t nStealthPrefix;
@@ -484,3 +653,130 @@ void ECC_Stop_Stealth()
         secp256k1_context_destroy(ctx);
     }
 };
+
+namespace {
+class EphemeralKeyPool
+{
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::pair<CKey, CPubKey> > m_keys GUARDED_BY(m_mutex);
+    size_t m_target_size GUARDED_BY(m_mutex) = 0;
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    std::thread m_thread;
+
+    static constexpr size_t REFILL_BATCH_SIZE = 16;
+
+    void ThreadRefill()
+    {
+        std::vector<std::pair<CKey, CPubKey> > batch;
+        while (true) {
+            size_t n;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                // Wake when half the pool is used to refill in batches
+                m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_keys.size() <= m_target_size / 2; });
+                if (m_stop) {
+                    return;
+                }
+                n = std::min(REFILL_BATCH_SIZE, m_target_size - m_keys.size());
+            }
+            batch.resize(n);
+            for (auto &kp : batch) {
+                kp.first.MakeNewKey(true);
+                kp.second = kp.first.GetPubKey();
+            }
+            LOCK(m_mutex);
+            for (auto &kp : batch) {
+                m_keys.emplace_back(std::move(kp));
+            }
+            batch.clear();
+        }
+    }
+
+public:
+    ~EphemeralKeyPool()
+    {
+        Stop();
+    }
+
+    bool Get(CKey &key, CPubKey &pubkey)
+    {
+        {
+            LOCK(m_mutex);
+            if (m_keys.empty()) {
+                return false;
+            }
+            key = std::move(m_keys.front().first);
+            pubkey = m_keys.front().second;
+            m_keys.pop_front();
+        }
+        m_cv.notify_one();
+        return true;
+    }
+
+    void Start(size_t target_size)
+    {
+        if (m_thread.joinable() || target_size < 1) {
+            return;
+        }
+        {
+            LOCK(m_mutex);
+            m_target_size = target_size;
+            m_stop = false;
+        }
+        m_thread = std::thread(&util::TraceThread, "ephemkeys", [this]() { ThreadRefill(); });
+    }
+
+    void Stop()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+            m_keys.clear();
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    size_t Size()
+    {
+        LOCK(m_mutex);
+        return m_keys.size();
+    }
+};
+
+EphemeralKeyPool g_ephemeral_key_pool;
+} // namespace
+
+void GetEphemeralKey(CKey &key, CPubKey &pubkey)
+{
+    if (g_ephemeral_key_pool.Get(key, pubkey)) {
+        return;
+    }
+    key.MakeNewKey(true);
+    pubkey = key.GetPubKey();
+};
+
+void GetEphemeralKey(CKey &key)
+{
+    CPubKey pubkey;
+    GetEphemeralKey(key, pubkey);
+};
+
+void StartEphemeralKeyPool(size_t target_size)
+{
+    g_ephemeral_key_pool.Start(target_size);
+};
+
+void StopEphemeralKeyPool()
+{
+    g_ephemeral_key_pool.Stop();
+};
+
+size_t GetEphemeralKeyPoolSize()
+{
+    return g_ephemeral_key_pool.Size();
+};
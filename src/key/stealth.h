@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <array>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -136,11 +138,85 @@ int StealthSharedToPublicKey(const ec_point &pkSpend, const CKey &sharedS, ec_po
 
 bool IsStealthAddress(const std::string &encodedAddress);
 
+/**
+ * Matches stealth outputs against many scan keys.
+ * Spend pubkeys are parsed once when added and the ephemeral pubkey once per output,
+ * keys sharing a scan secret share one ECDH.
+ */
+class CStealthScanner
+{
+public:
+    static constexpr int NO_MATCH = -1;
+    static constexpr int MATCH_FAILED = -2;
+
+    /** Returns false if spend_pubkey is invalid */
+    bool AddKey(const CKey &scan_secret, const ec_point &spend_pubkey, uint8_t prefix_bits, uint32_t prefix);
+
+    /**
+     * Index of the key, in order added, that derives id from ephem_pubkey, with its shared secret in shared_out.
+     * NO_MATCH if none, MATCH_FAILED if the output could not be tested.
+     */
+    int Match(const ec_point &ephem_pubkey, uint32_t prefix, bool have_prefix, const CKeyID &id, CKey &shared_out) const;
+
+    size_t size() const { return m_keys.size(); }
+    bool empty() const { return m_keys.empty(); }
+    void clear();
+
+private:
+    struct ScanKey {
+        std::array<uint8_t, 64> spend_pubkey; // parsed secp256k1_pubkey
+        uint8_t prefix_bits;
+        uint32_t prefix;
+    };
+    struct ScanSecret {
+        CKey secret;
+        std::vector<size_t> keys;
+    };
+    std::vector<ScanKey> m_keys;
+    std::vector<ScanSecret> m_secrets;
+    std::map<uint256, size_t> m_secret_index;
+};
+
+/**
+ * Stealth addresses bucketed by prefix, an output only visits the addresses its prefix can match.
+ * Holds pointers into a container that must outlive the index, such as a std::set.
+ */
+class CStealthPrefixIndex
+{
+public:
+    void Add(const CStealthAddress *sx);
+    void Remove(const CStealthAddress *sx);
+
+    /** Sets candidates to the addresses without a prefix and those matching prefix */
+    void GetCandidates(uint32_t prefix, bool have_prefix, std::vector<const CStealthAddress*> &candidates) const;
+
+    size_t size() const;
+    void clear();
+
+private:
+    std::vector<const CStealthAddress*> m_unprefixed;
+    std::map<uint8_t, std::multimap<uint32_t, const CStealthAddress*> > m_prefixed; // number_bits -> masked bitfield
+};
+
 inline uint32_t SetStealthMask(uint8_t nBits)
 {
     return (nBits == 32 ? 0xFFFFFFFF : ((1<<nBits)-1));
 };
 
+inline bool MatchStealthPrefix(uint32_t nAddrBits, uint32_t addrPrefix, uint32_t outputPrefix, bool fHavePrefix)
+{
+    if (nAddrBits < 1) { // addresses without prefixes scan all incoming stealth outputs
+        return true;
+    }
+    if (!fHavePrefix) { // don't check when address has a prefix and no prefix on output
+        return false;
+    }
+
+    uint32_t mask = SetStealthMask(nAddrBits);
+
+    return (addrPrefix & mask) == (outputPrefix & mask);
+};
+
 uint32_t FillStealthPrefix(uint8_t nBits, uint32_t nBitfield);
 
 bool ExtractStealthPrefix(const char *pPrefix, uint32_t &nPrefix);
@@ -154,6 +230,18 @@ int PrepareStealthOutput(const CStealthAddress &sx, const std::string &sNarratio
 void ECC_Start_Stealth();
 void ECC_Stop_Stealth();
 
+/** Default number of ephemeral keypairs kept ready by the background thread, 0 disables the pool */
+static constexpr size_t DEFAULT_EPHEMERAL_KEYPOOL{256};
+
+/** Take a keypair from the ephemeral key pool, generated inline if the pool is empty or not running.
+ *  Each keypair is handed out once, the secret keys are held in secure memory. */
+void GetEphemeralKey(CKey &key, CPubKey &pubkey);
+void GetEphemeralKey(CKey &key);
+/** Start the thread refilling the ephemeral key pool up to target_size keypairs */
+void StartEphemeralKeyPool(size_t target_size);
+void StopEphemeralKeyPool();
+size_t GetEphemeralKeyPoolSize();
+
 
 #endif // PARTICL_KEY_STEALTH_H
 
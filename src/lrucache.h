@@ -0,0 +1,125 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_LRUCACHE_H
+#define PARTICL_LRUCACHE_H
+
+#include <memusage.h>
+
+#include <functional>
+#include <list>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+
+struct LRUCacheStats {
+    size_t entries{0};
+    size_t max_entries{0};
+    uint64_t hits{0};
+    uint64_t misses{0};
+};
+
+/**
+ * Bounded cache evicting the least recently used entry.
+ *
+ * Lookups are hashed, insertion and eviction are constant time.
+ * Not thread safe, callers must hold the lock guarding the cache.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key> >
+class LRUCache
+{
+public:
+    explicit LRUCache(size_t max_size) : m_max_size(max_size) {}
+
+    /** Copy the value for key into v and mark the entry most recently used. */
+    bool Get(const Key &key, Value &v)
+    {
+        auto mi = m_map.find(key);
+        if (mi == m_map.end()) {
+            m_misses++;
+            return false;
+        }
+        m_list.splice(m_list.begin(), m_list, mi->second);
+        v = mi->second->second;
+        m_hits++;
+        return true;
+    }
+
+    /** Returns the value for key without changing the eviction order, nullptr if not present. */
+    const Value *Peek(const Key &key) const
+    {
+        auto mi = m_map.find(key);
+        if (mi == m_map.end()) {
+            m_misses++;
+            return nullptr;
+        }
+        m_hits++;
+        return &mi->second->second;
+    }
+
+    /** Inserts or overwrites key as the most recently used entry. */
+    void Insert(const Key &key, const Value &v)
+    {
+        auto mi = m_map.find(key);
+        if (mi != m_map.end()) {
+            mi->second->second = v;
+            m_list.splice(m_list.begin(), m_list, mi->second);
+            return;
+        }
+        m_list.emplace_front(key, v);
+        m_map.emplace(key, m_list.begin());
+        while (m_list.size() > m_max_size) {
+            m_map.erase(m_list.back().first);
+            m_list.pop_back();
+        }
+    }
+
+    bool Erase(const Key &key)
+    {
+        auto mi = m_map.find(key);
+        if (mi == m_map.end()) {
+            return false;
+        }
+        m_list.erase(mi->second);
+        m_map.erase(mi);
+        return true;
+    }
+
+    /** Removes all entries, statistics are kept. */
+    void Clear()
+    {
+        m_list.clear();
+        m_map.clear();
+    }
+
+    size_t size() const { return m_list.size(); }
+    size_t max_size() const { return m_max_size; }
+
+    /** Memory held by the entries, heap owned by the keys and values isn't counted. */
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::MallocUsage(sizeof(std::pair<Key, Value>) + 2 * sizeof(void*)) * m_list.size() + memusage::DynamicUsage(m_map);
+    }
+
+    LRUCacheStats GetStats() const
+    {
+        LRUCacheStats stats;
+        stats.entries = m_list.size();
+        stats.max_entries = m_max_size;
+        stats.hits = m_hits;
+        stats.misses = m_misses;
+        return stats;
+    }
+
+private:
+    typedef std::list<std::pair<Key, Value> > List;
+
+    const size_t m_max_size;
+    List m_list;
+    std::unordered_map<Key, typename List::iterator, Hash> m_map;
+    mutable uint64_t m_hits{0};
+    mutable uint64_t m_misses{0};
+};
+
+#endif // PARTICL_LRUCACHE_H
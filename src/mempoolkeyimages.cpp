@@ -0,0 +1,85 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempoolkeyimages.h>
+
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <random.h>
+
+#include <algorithm>
+
+size_t CMempoolKeyImages::Hasher::operator()(const CCmpPubKey &ki) const noexcept
+{
+    // Consistent with operator==, which compares only the header byte of an invalid key
+    return CSipHasher(m_k0, m_k1).Write(ki.begin(), std::max(ki.size(), 1u)).Finalize();
+}
+
+CMempoolKeyImages::CMempoolKeyImages()
+    : m_hasher(GetRand<uint64_t>(), GetRand<uint64_t>())
+{
+    for (auto &shard : m_shards) {
+        shard = std::make_unique<Shard>(m_hasher);
+    }
+}
+
+CMempoolKeyImages::Shard &CMempoolKeyImages::GetShard(const CCmpPubKey &ki) const
+{
+    // Use the high bits, the maps select buckets from the low bits
+    return *m_shards[(m_hasher(ki) >> 56) % NUM_SHARDS];
+}
+
+bool CMempoolKeyImages::Get(const CCmpPubKey &ki, uint256 &txid) const
+{
+    Shard &shard = GetShard(ki);
+    LOCK(shard.m_mutex);
+    const auto mi = shard.m_map.find(ki);
+    if (mi == shard.m_map.end()) {
+        return false;
+    }
+    txid = mi->second;
+    return true;
+}
+
+void CMempoolKeyImages::Add(const CCmpPubKey &ki, const uint256 &txid)
+{
+    Shard &shard = GetShard(ki);
+    LOCK(shard.m_mutex);
+    shard.m_map[ki] = txid;
+}
+
+void CMempoolKeyImages::Remove(const CCmpPubKey &ki)
+{
+    Shard &shard = GetShard(ki);
+    LOCK(shard.m_mutex);
+    shard.m_map.erase(ki);
+}
+
+void CMempoolKeyImages::Clear()
+{
+    for (auto &shard : m_shards) {
+        LOCK(shard->m_mutex);
+        shard->m_map.clear();
+    }
+}
+
+size_t CMempoolKeyImages::Size() const
+{
+    size_t rv = 0;
+    for (const auto &shard : m_shards) {
+        LOCK(shard->m_mutex);
+        rv += shard->m_map.size();
+    }
+    return rv;
+}
+
+size_t CMempoolKeyImages::DynamicMemoryUsage() const
+{
+    size_t rv = 0;
+    for (const auto &shard : m_shards) {
+        LOCK(shard->m_mutex);
+        rv += memusage::DynamicUsage(shard->m_map);
+    }
+    return rv;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_MEMPOOLKEYIMAGES_H
+#define PARTICL_MEMPOOLKEYIMAGES_H
+
+#include <pubkey.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <array>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+
+/**
+ * Key images spent by mempool transactions, mapped to the spending txid.
+ *
+ * Split into shards with their own lock, lookups don't take the mempool lock
+ * and only contend with writes to the same shard.
+ * Writers must hold the mempool lock so the set follows the mempool contents.
+ */
+class CMempoolKeyImages
+{
+public:
+    static constexpr size_t NUM_SHARDS = 16;
+
+    CMempoolKeyImages();
+
+    /** Set txid to the spender of ki and return true if ki is spent in the mempool */
+    bool Get(const CCmpPubKey &ki, uint256 &txid) const;
+    void Add(const CCmpPubKey &ki, const uint256 &txid);
+    void Remove(const CCmpPubKey &ki);
+    void Clear();
+
+    size_t Size() const;
+    size_t DynamicMemoryUsage() const;
+
+private:
+    class Hasher
+    {
+    public:
+        Hasher(uint64_t k0, uint64_t k1) : m_k0(k0), m_k1(k1) {}
+        size_t operator()(const CCmpPubKey &ki) const noexcept;
+    private:
+        uint64_t m_k0, m_k1;
+    };
+
+    struct Shard {
+        explicit Shard(const Hasher &hasher) : m_map(0, hasher) {}
+        mutable Mutex m_mutex;
+        std::unordered_map<CCmpPubKey, uint256, Hasher> m_map GUARDED_BY(m_mutex);
+    };
+
+    Shard &GetShard(const CCmpPubKey &ki) const;
+
+    const Hasher m_hasher;
+    std::array<std::unique_ptr<Shard>, NUM_SHARDS> m_shards;
+};
+
+#endif // PARTICL_MEMPOOLKEYIMAGES_H
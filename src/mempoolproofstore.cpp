@@ -0,0 +1,178 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempoolproofstore.h>
+
+#include <clientversion.h>
+#include <logging.h>
+#include <memusage.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <util/system.h>
+
+CMempoolProofStore::CMempoolProofStore(const fs::path &path)
+    : m_path(path)
+{
+    LOCK(m_mutex);
+    m_file = fsbridge::fopen(m_path, "wb+");
+    if (!m_file) {
+        LogPrintf("%s: Failed to open %s\n", __func__, fs::PathToString(m_path));
+    }
+}
+
+CMempoolProofStore::~CMempoolProofStore()
+{
+    LOCK(m_mutex);
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+        fs::remove(m_path);
+    }
+}
+
+bool CMempoolProofStore::IsOpen() const
+{
+    LOCK(m_mutex);
+    return m_file != nullptr;
+}
+
+static bool SharesOwner(const CTxOutBaseRef &a, const CTxOutBaseRef &b)
+{
+    return !a.owner_before(b) && !b.owner_before(a);
+}
+
+bool CMempoolProofStore::Spill(const CTransaction &tx, Slot &slot, size_t &freed)
+{
+    freed = 0;
+    const std::vector<CTxOutBaseRef> &vpout = tx.vpout;
+    if (vpout.empty() || !slot.IsNull()) {
+        return false;
+    }
+
+    // Outputs in a CTxOutArena share one reference count
+    long num_shared_with_first = 0;
+    for (const auto &txout : vpout) {
+        if (SharesOwner(txout, vpout[0])) {
+            num_shared_with_first++;
+        }
+    }
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    std::vector<std::vector<uint8_t>*> spilled;
+    for (size_t i = 0; i < vpout.size(); ++i) {
+        std::vector<uint8_t> *rangeproof = vpout[i]->GetPRangeproof();
+        if (!rangeproof || rangeproof->empty()) {
+            continue;
+        }
+        long expect_refs = SharesOwner(vpout[i], vpout[0]) ? num_shared_with_first : 1;
+        if (vpout[i].use_count() != expect_refs) {
+            continue;
+        }
+        ss << (uint32_t)i << *rangeproof;
+        spilled.push_back(rangeproof);
+    }
+    if (spilled.empty()) {
+        return false;
+    }
+
+    LOCK(m_mutex);
+    if (!m_file ||
+        fseek(m_file, m_file_bytes, SEEK_SET) != 0 ||
+        fwrite(ss.data(), 1, ss.size(), m_file) != ss.size()) {
+        LogPrintf("%s: Failed to write %s\n", __func__, fs::PathToString(m_path));
+        return false;
+    }
+    slot.pos = m_file_bytes;
+    slot.size = ss.size();
+    m_file_bytes += ss.size();
+    m_stats.live_bytes += ss.size();
+    m_stats.spilled_txns++;
+
+    for (auto *rangeproof : spilled) {
+        freed += memusage::DynamicUsage(*rangeproof);
+        std::vector<uint8_t>().swap(*rangeproof);
+    }
+    return true;
+}
+
+bool CMempoolProofStore::Restore(const CTransaction &tx, Slot &slot)
+{
+    if (slot.IsNull()) {
+        return true;
+    }
+    {
+        LOCK(m_mutex);
+        std::vector<uint8_t> data(slot.size);
+        if (!m_file ||
+            fseek(m_file, slot.pos, SEEK_SET) != 0 ||
+            fread(data.data(), 1, data.size(), m_file) != data.size()) {
+            LogPrintf("%s: Failed to read %s\n", __func__, fs::PathToString(m_path));
+            return false;
+        }
+        try {
+            CDataStream ss(data, SER_DISK, CLIENT_VERSION);
+            while (!ss.empty()) {
+                uint32_t n;
+                ss >> n;
+                if (n >= tx.vpout.size() || !tx.vpout[n]->GetPRangeproof()) {
+                    throw std::ios_base::failure("Bad output index");
+                }
+                ss >> *tx.vpout[n]->GetPRangeproof();
+            }
+        } catch (const std::exception &e) {
+            LogPrintf("%s: Failed to restore the proofs of %s: %s\n", __func__, tx.GetHash().ToString(), e.what());
+            return false;
+        }
+        m_stats.restores++;
+        ReleaseLocked(slot);
+    }
+    Queue(tx.GetHash());
+    return true;
+}
+
+void CMempoolProofStore::ReleaseLocked(Slot &slot)
+{
+    AssertLockHeld(m_mutex);
+    if (slot.IsNull()) {
+        return;
+    }
+    m_stats.live_bytes -= slot.size;
+    m_stats.spilled_txns--;
+    slot = Slot();
+    if (m_stats.spilled_txns == 0 && m_file && m_file_bytes > 0) {
+        if (!TruncateFile(m_file, 0)) {
+            LogPrintf("%s: Failed to truncate %s\n", __func__, fs::PathToString(m_path));
+            return;
+        }
+        m_file_bytes = 0;
+    }
+}
+
+void CMempoolProofStore::Release(Slot &slot)
+{
+    LOCK(m_mutex);
+    ReleaseLocked(slot);
+}
+
+void CMempoolProofStore::Queue(const uint256 &txid, int attempts)
+{
+    LOCK(m_mutex);
+    m_queue.emplace_back(txid, attempts);
+}
+
+std::vector<std::pair<uint256, int> > CMempoolProofStore::TakeQueue()
+{
+    LOCK(m_mutex);
+    std::vector<std::pair<uint256, int> > rv(m_queue.begin(), m_queue.end());
+    m_queue.clear();
+    return rv;
+}
+
+CMempoolProofStore::Stats CMempoolProofStore::GetStats() const
+{
+    LOCK(m_mutex);
+    Stats stats = m_stats;
+    stats.file_bytes = m_file_bytes;
+    return stats;
+}
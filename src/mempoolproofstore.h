@@ -0,0 +1,77 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_MEMPOOLPROOFSTORE_H
+#define PARTICL_MEMPOOLPROOFSTORE_H
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <deque>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+class CTransaction;
+
+/** Default for -mempoolspillproofs */
+static const bool DEFAULT_MEMPOOL_SPILL_PROOFS = false;
+
+/**
+ * Side file holding the rangeproofs of mempool transactions, see -mempoolspillproofs.
+ *
+ * Rangeproofs are only needed again to relay a transaction or to add it to a block,
+ * CTxMemPoolEntry::GetSharedTx puts them back before the transaction leaves the mempool.
+ * The file is emptied when no spilled rangeproofs remain and isn't kept across restarts.
+ */
+class CMempoolProofStore
+{
+public:
+    struct Slot {
+        int64_t pos{-1};
+        uint32_t size{0};
+        bool IsNull() const { return pos < 0; }
+    };
+
+    struct Stats {
+        size_t spilled_txns{0};
+        uint64_t live_bytes{0};
+        uint64_t file_bytes{0};
+        uint64_t restores{0};
+    };
+
+    explicit CMempoolProofStore(const fs::path &path);
+    ~CMempoolProofStore();
+
+    bool IsOpen() const;
+
+    /**
+     * Move the rangeproofs of tx to the file, skips outputs referenced outside the transaction.
+     * The caller must hold the only reference to tx, freed is set to the memory released.
+     */
+    bool Spill(const CTransaction &tx, Slot &slot, size_t &freed);
+    /** Put the rangeproofs back into tx, the slot is released and the txid queued to spill again. */
+    bool Restore(const CTransaction &tx, Slot &slot);
+    /** Release the slot of a transaction leaving the mempool without its rangeproofs */
+    void Release(Slot &slot);
+
+    /** Queue a transaction to be spilled when nothing else holds a reference to it */
+    void Queue(const uint256 &txid, int attempts=0);
+    std::vector<std::pair<uint256, int> > TakeQueue();
+
+    Stats GetStats() const;
+
+private:
+    void ReleaseLocked(Slot &slot) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    const fs::path m_path;
+    FILE *m_file GUARDED_BY(m_mutex){nullptr};
+    uint64_t m_file_bytes GUARDED_BY(m_mutex){0};
+    Stats m_stats GUARDED_BY(m_mutex);
+    std::deque<std::pair<uint256, int> > m_queue GUARDED_BY(m_mutex);
+};
+
+#endif // PARTICL_MEMPOOLPROOFSTORE_H
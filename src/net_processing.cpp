@@ -47,6 +47,7 @@
 #include <typeinfo>
 
 // Particl includes
+#include <anon.h>
 #include <smsg/smessage.h>
 
 using node::ReadBlockFromDisk;
@@ -119,6 +120,10 @@ static const unsigned int MAX_HEADERS_RESULTS = 2000;
 static const int MAX_CMPCTBLOCK_DEPTH = 5;
 /** Maximum depth of blocks we're willing to respond to GETBLOCKTXN requests for. */
 static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Maximum size of the transactions prefilled in the compact blocks we announce, besides the coinstake. */
+static constexpr size_t MAX_CMPCTBLOCK_PREFILL_SIZE = 20000;
+/** Blinded transactions that entered our mempool more recently than this are prefilled in compact blocks. */
+static constexpr auto CMPCTBLOCK_PREFILL_RECENT{10s};
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
@@ -183,6 +188,10 @@ static constexpr uint64_t CMPCTBLOCKS_VERSION{2};
 
 namespace particl {
 static constexpr size_t MAX_LOOSE_HEADERS = 1000;
+/** Loose headers held over all peers, bounds the header only entries in the block index under a flood */
+static constexpr size_t MAX_LOOSE_HEADERS_TOTAL = 8000;
+/** Peers holding fewer loose headers may still add while the total is full, so honest tips aren't refused */
+static constexpr size_t MIN_LOOSE_HEADERS_PER_PEER = 50;
 static constexpr int MAX_DUPLICATE_HEADERS = 2000;
 static constexpr int64_t MAX_LOOSE_HEADER_TIME = 120;
 static constexpr int64_t MIN_DOS_STATE_TTL = 60 * 10; // seconds
@@ -487,7 +496,7 @@ public:
 
     /** Overridden from CValidationInterface. */
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected) override
-        EXCLUSIVE_LOCKS_REQUIRED(!m_recent_confirmed_transactions_mutex);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_recent_confirmed_transactions_mutex);
     void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex* pindex) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_recent_confirmed_transactions_mutex);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override
@@ -570,6 +579,8 @@ private:
 
     void ProcessOrphanTx(std::set<uint256>& orphan_work_set) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex);
+    /** Revalidate the held anon txns in one batch once the chain has caught up with peers */
+    void ProcessHeldAnonTxns() EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex);
     /** Process a single headers message from a peer. */
     void ProcessHeadersMessage(CNode& pfrom, const Peer& peer,
                                const std::vector<CBlockHeader>& headers,
@@ -810,6 +821,11 @@ private:
     /** Storage for orphan information */
     TxOrphanage m_orphanage;
 
+    /** Anon txns that passed CheckTransaction but were rejected as the chain is behind peers.
+     *  Kept by wtxid with the peer that sent them, up to MAX_HELD_ANON_TRANSACTIONS. */
+    std::map<uint256, std::pair<CTransactionRef, NodeId>> m_held_anon_txns GUARDED_BY(g_cs_orphans);
+    bool HaveHeldAnonTx(const GenTxid& gtxid) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+
     void AddToCompactExtraTransactions(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
 
     /** Orphan/conflicted/etc transactions that are kept for compact block reconstruction.
@@ -935,6 +951,8 @@ public:
 
 /** Map maintaining per-addr DOS state. */
 static std::map<CNetAddr, CNodeDOS> map_dos_state GUARDED_BY(cs_main);
+//! Sum of m_map_loose_headers.size() over map_dos_state
+static size_t num_loose_headers GUARDED_BY(cs_main) = 0;
 
 const CNodeState* PeerManagerImpl::State(NodeId pnode) const EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
@@ -1841,6 +1859,7 @@ void PeerManagerImpl::CheckUnreceivedHeaders(int64_t now) EXCLUSIVE_LOCKS_REQUIR
                     dos_counters.m_misbehavior += 5;
                 }
                 dos_counters.m_map_loose_headers.erase(it_headers++);
+                num_loose_headers--;
                 continue;
             }
             ++it_headers;
@@ -1888,15 +1907,23 @@ bool PeerManagerImpl::AddNodeHeader(NodeId node_id, const uint256 &hash) EXCLUSI
     }
     auto it = map_dos_state.find(state->m_address);
     if (it != map_dos_state.end()) {
-        if (it->second.m_map_loose_headers.size() > particl::MAX_LOOSE_HEADERS) {
+        size_t peer_loose_headers = it->second.m_map_loose_headers.size();
+        if (peer_loose_headers > particl::MAX_LOOSE_HEADERS) {
+            return false;
+        }
+        if (num_loose_headers >= particl::MAX_LOOSE_HEADERS_TOTAL &&
+            peer_loose_headers >= particl::MIN_LOOSE_HEADERS_PER_PEER) {
             return false;
         }
-        it->second.m_map_loose_headers.insert(std::make_pair(hash, GetTime()));
+        if (it->second.m_map_loose_headers.insert(std::make_pair(hash, GetTime())).second) {
+            num_loose_headers++;
+        }
         it->second.m_last_used_time = GetTime();
         return true;
     }
     map_dos_state[state->m_address].m_map_loose_headers.insert(std::make_pair(hash, GetTime()));
     map_dos_state[state->m_address].m_last_used_time = GetTime();
+    num_loose_headers++;
     return true;
 }
 
@@ -1904,7 +1931,7 @@ void PeerManagerImpl::RemoveNodeHeader(const uint256 &hash) EXCLUSIVE_LOCKS_REQU
 {
     auto it = map_dos_state.begin();
     for (; it != map_dos_state.end(); ++it) {
-        it->second.m_map_loose_headers.erase(hash);
+        num_loose_headers -= it->second.m_map_loose_headers.erase(hash);
     }
 }
 
@@ -1923,9 +1950,15 @@ int GetNumDOSStates()
     return map_dos_state.size();
 }
 
+size_t GetNumLooseHeaders()
+{
+    return num_loose_headers;
+}
+
 void ClearDOSStates()
 {
     map_dos_state.clear();
+    num_loose_headers = 0;
 }
 
 bool PeerManagerImpl::BlockRequestAllowed(const CBlockIndex* pindex)
@@ -2012,10 +2045,27 @@ void PeerManagerImpl::StartScheduledTasks(CScheduler& scheduler)
  * Evict orphan txn pool entries based on a newly connected
  * block, remember the recently confirmed transactions, and delete tracked
  * announcements for them. Also save the time of the last tip update.
+ * Orphans awaiting the block's anon outputs are queued to be retried.
  */
 void PeerManagerImpl::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex)
 {
     m_orphanage.EraseForBlock(*pblock);
+    std::vector<std::pair<uint256, NodeId>> anon_orphans;
+    {
+        LOCK(g_cs_orphans);
+        for (const auto& ptx : pblock->vtx) {
+            m_held_anon_txns.erase(ptx->GetWitnessHash());
+        }
+        anon_orphans = m_orphanage.ReleaseForAnonIndex(pindex->nAnonOutputs);
+    }
+    // Orphan anon txns whose ring members are now in the chain are retried from their peers' work sets
+    for (const auto& [txid, from_peer] : anon_orphans) {
+        PeerRef peer = GetPeerRef(from_peer);
+        if (peer) {
+            LOCK(g_cs_orphans);
+            peer->m_orphan_work_set.insert(txid);
+        }
+    }
     m_last_tip_update = GetTime<std::chrono::seconds>();
 
     {
@@ -2056,7 +2106,25 @@ void PeerManagerImpl::BlockDisconnected(const std::shared_ptr<const CBlock> &blo
  */
 void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
 {
-    auto pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock);
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock;
+    {
+        // Prefill the transactions peers likely lack: those missing from our mempool, blinded first,
+        // then blinded transactions which arrived too recently to have propagated.
+        LOCK(m_mempool.cs);
+        const auto now{GetTime<std::chrono::seconds>()};
+        pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock, [&](const CTransaction& tx) {
+            AssertLockHeld(m_mempool.cs);
+            const bool blinded = IsBlindedTransaction(tx);
+            auto it = m_mempool.GetIter(tx.GetHash());
+            if (!it) {
+                return blinded ? 0 : 1;
+            }
+            if (blinded && (*it)->GetTime() + CMPCTBLOCK_PREFILL_RECENT > now) {
+                return 2;
+            }
+            return -1;
+        }, MAX_CMPCTBLOCK_PREFILL_SIZE);
+    }
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
 
     LOCK(cs_main);
@@ -2109,6 +2177,8 @@ void PeerManagerImpl::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlock
     SetBestHeight(pindexNew->nHeight);
     SetServiceFlagsIBDCache(!fInitialDownload);
 
+    ProcessHeldAnonTxns();
+
     // Don't relay inventory during initial block download.
     if (fInitialDownload) return;
 
@@ -2203,6 +2273,8 @@ bool PeerManagerImpl::AlreadyHaveTx(const GenTxid& gtxid)
 
     if (m_orphanage.HaveTx(gtxid)) return true;
 
+    if (HaveHeldAnonTx(gtxid)) return true;
+
     {
         LOCK(m_recent_confirmed_transactions_mutex);
         if (m_recent_confirmed_transactions.contains(hash)) return true;
@@ -2211,6 +2283,54 @@ bool PeerManagerImpl::AlreadyHaveTx(const GenTxid& gtxid)
     return m_recent_rejects.contains(hash) || m_mempool.exists(gtxid);
 }
 
+bool PeerManagerImpl::HaveHeldAnonTx(const GenTxid& gtxid)
+{
+    if (gtxid.IsWtxid()) {
+        return m_held_anon_txns.count(gtxid.GetHash());
+    }
+    return std::any_of(m_held_anon_txns.begin(), m_held_anon_txns.end(), [&gtxid](const auto& it) {
+        return it.second.first->GetHash() == gtxid.GetHash();
+    });
+}
+
+void PeerManagerImpl::ProcessHeldAnonTxns()
+{
+    LOCK2(cs_main, g_cs_orphans);
+    if (m_held_anon_txns.empty() ||
+        particl::IsChainBehindPeers(m_chainman.ActiveChain().Height())) {
+        return;
+    }
+
+    auto held_txns = std::move(m_held_anon_txns);
+    m_held_anon_txns.clear();
+    size_t num_accepted = 0;
+    for (const auto& it : held_txns) {
+        const CTransactionRef& ptx = it.second.first;
+        if (m_mempool.exists(GenTxid::Wtxid(it.first))) {
+            continue;
+        }
+        // Rangeproofs were verified by CheckTransaction when the tx was received
+        const MempoolAcceptResult result = m_chainman.ProcessTransaction(ptx, /*test_accept=*/false, /*ignore_locks=*/false, /*skip_rangeproof=*/true);
+        const TxValidationState& state = result.m_state;
+        if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+            RelayTransaction(ptx->GetHash(), ptx->GetWitnessHash());
+            num_accepted++;
+            continue;
+        }
+        if (state.IsError() && state.GetRejectReason() == "Syncing") {
+            m_held_anon_txns.emplace(it.first, it.second);
+            continue;
+        }
+        m_recent_rejects.insert(ptx->GetWitnessHash());
+        if (state.IsInvalid()) {
+            LogPrint(BCLog::MEMPOOLREJ, "held %s from peer=%d was not accepted: %s\n", ptx->GetHash().ToString(),
+                it.second.second, state.ToString());
+            MaybePunishNodeForTx(it.second.second, state);
+        }
+    }
+    LogPrint(BCLog::MEMPOOL, "Revalidated %u held anon txns, accepted %u\n", held_txns.size(), num_accepted);
+}
+
 bool PeerManagerImpl::AlreadyHaveBlock(const uint256& block_hash)
 {
     return m_chainman.m_blockman.LookupBlockIndex(block_hash) != nullptr;
@@ -2854,6 +2974,8 @@ void PeerManagerImpl::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
             }
             m_orphanage.EraseTx(orphanHash);
             break;
+        } else if (state.m_missing_anon_index > 0) {
+            m_orphanage.AwaitAnonIndex(orphanHash, state.m_missing_anon_index);
         }
     }
 }
@@ -3824,6 +3946,10 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             AddKnownTx(*peer, txid);
         }
 
+        if (tx.IsParticlVersion()) {
+            PrefetchAnonInputs(*m_chainman.m_blockman.m_block_tree_db, tx);
+        }
+
         LOCK2(cs_main, g_cs_orphans);
 
         m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
@@ -3921,6 +4047,9 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                 if (m_orphanage.AddTx(ptx, pfrom.GetId())) {
                     AddToCompactExtraTransactions(ptx);
                 }
+                if (state.m_missing_anon_index > 0) {
+                    m_orphanage.AwaitAnonIndex(tx.GetHash(), state.m_missing_anon_index);
+                }
 
                 // Once added to the orphan pool, a tx is considered AlreadyHave, and we shouldn't request it anymore.
                 m_txrequest.ForgetTxHash(tx.GetHash());
@@ -3945,6 +4074,14 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                 m_txrequest.ForgetTxHash(tx.GetHash());
                 m_txrequest.ForgetTxHash(tx.GetWitnessHash());
             }
+        } else if (state.IsError() && state.GetRejectReason() == "Syncing") {
+            // Anon txn received while the chain is behind peers, keep it to revalidate once synced
+            // instead of downloading it again from the next peer to announce it.
+            if (m_held_anon_txns.size() < MAX_HELD_ANON_TRANSACTIONS &&
+                m_held_anon_txns.emplace(wtxid, std::make_pair(ptx, pfrom.GetId())).second) {
+                m_txrequest.ForgetTxHash(tx.GetHash());
+                m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+            }
         } else {
             if (state.GetResult() != TxValidationResult::TX_WITNESS_STRIPPED) {
                 // We can add the wtxid of this transaction to our reject filter.
@@ -4332,6 +4469,9 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom.GetId());
 
+        // Start verifying the block signature while this thread waits for cs_main
+        particl::QueueBlockSignatureCheck(pblock);
+
         bool forceProcessing = false;
         const uint256 hash(pblock->GetHash());
         {
@@ -8,9 +8,11 @@
 #include <chainparams.h>
 #include <clientversion.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <flatfile.h>
 #include <fs.h>
 #include <hash.h>
+#include <lz4/lz4.h>
 #include <pow.h>
 #include <reverse_iterator.h>
 #include <shutdown.h>
@@ -19,20 +21,23 @@
 #include <undo.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/translation.h>
 #include <validation.h>
 
 #include <unordered_map>
 
 extern bool fAddressIndex;
+extern bool fAddressBalanceIndex;
 extern bool fSpentIndex;
-extern bool fTimestampIndex;
 extern bool fBalancesIndex;
+extern bool fBlockRewardIndex;
 
 namespace node {
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fPruneMode = false;
 uint64_t nPruneTarget = 0;
+bool fCompressBlockFiles = DEFAULT_BLOCKFILE_COMPRESSION;
 
 bool CBlockIndexWorkComparator::operator()(const CBlockIndex* pa, const CBlockIndex* pb) const
 {
@@ -377,12 +382,16 @@ bool BlockManager::LoadBlockIndexDB()
     // Check whether we have indices
     m_block_tree_db->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-    m_block_tree_db->ReadFlag("timestampindex", fTimestampIndex);
-    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
+    // Databases indexed before the balance index was added don't have the flag
+    fAddressBalanceIndex = false;
+    m_block_tree_db->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+    fAddressBalanceIndex &= fAddressIndex;
     m_block_tree_db->ReadFlag("spentindex", fSpentIndex);
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
     m_block_tree_db->ReadFlag("balancesindex", fBalancesIndex);
     LogPrintf("%s: balances index %s\n", __func__, fBalancesIndex ? "enabled" : "disabled");
+    m_block_tree_db->ReadFlag("blockrewardindex", fBlockRewardIndex);
+    LogPrintf("%s: block reward index %s\n", __func__, fBlockRewardIndex ? "enabled" : "disabled");
 
     return true;
 }
@@ -467,7 +476,130 @@ CBlockFileInfo* BlockManager::GetBlockFileInfo(size_t n)
     return &m_blockfile_info.at(n);
 }
 
-static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+void GetCompressedMessageStart(const CMessageHeader::MessageStartChars& message_start, CMessageHeader::MessageStartChars& out)
+{
+    // The first byte is kept so scanning for records with FindByte finds both kinds
+    out[0] = message_start[0];
+    for (size_t i = 1; i < CMessageHeader::MESSAGE_START_SIZE; ++i) {
+        out[i] = message_start[i] ^ 0xff;
+    }
+}
+
+/** Serialize and compress obj into a record payload, returns false if compressing doesn't save space */
+template <typename T>
+static bool CompressRecord(const T& obj, std::vector<uint8_t>& payload)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << obj;
+    if (ss.size() > MAX_SIZE) {
+        return false;
+    }
+    const int bound = LZ4_compressBound(ss.size());
+    payload.resize(4 + bound);
+    WriteLE32(payload.data(), ss.size());
+    const int n = LZ4_compress_default((const char*)ss.data(), (char*)payload.data() + 4, ss.size(), bound);
+    if (n <= 0 || 4 + (size_t)n >= ss.size()) {
+        payload.clear();
+        return false;
+    }
+    payload.resize(4 + n);
+    return true;
+}
+
+bool DecompressRecord(Span<const uint8_t> payload, std::vector<uint8_t>& data)
+{
+    if (payload.size() < 4) {
+        return false;
+    }
+    const uint32_t raw_size = ReadLE32(payload.data());
+    if (raw_size > MAX_SIZE) {
+        return false;
+    }
+    data.resize(raw_size);
+    const int n = LZ4_decompress_safe((const char*)payload.data() + 4, (char*)data.data(), payload.size() - 4, raw_size);
+    return n >= 0 && (uint32_t)n == raw_size;
+}
+
+/** Open the blk or rev file at the record header before pos, see OpenBlockRecord */
+static FILE* OpenRecord(FILE* (*open_file)(const FlatFilePos&, bool), const FlatFilePos& pos, std::vector<uint8_t>& data, bool& compressed)
+{
+    compressed = false;
+    if (pos.nPos < 8) {
+        return open_file(pos, true);
+    }
+    FlatFilePos hpos = pos;
+    hpos.nPos -= 8; // Seek back 8 bytes for meta header
+    FILE* file = open_file(hpos, true);
+    if (!file) {
+        return nullptr;
+    }
+    uint8_t header[8];
+    CMessageHeader::MessageStartChars compressed_start;
+    GetCompressedMessageStart(Params().MessageStart(), compressed_start);
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        LogPrintf("%s: Failed to read record header at %s\n", __func__, pos.ToString());
+        fclose(file);
+        return nullptr;
+    }
+    if (memcmp(header, compressed_start, CMessageHeader::MESSAGE_START_SIZE)) {
+        return file; // Plain record, the file is at pos
+    }
+    const uint32_t size = ReadLE32(header + CMessageHeader::MESSAGE_START_SIZE);
+    std::vector<uint8_t> payload;
+    if (size <= MAX_SIZE) {
+        payload.resize(size);
+    }
+    if (payload.empty() ||
+        fread(payload.data(), 1, size, file) != size ||
+        !DecompressRecord(payload, data)) {
+        LogPrintf("%s: Failed to read compressed record at %s\n", __func__, pos.ToString());
+        fclose(file);
+        return nullptr;
+    }
+    compressed = true;
+    return file;
+}
+
+FILE* OpenBlockRecord(const FlatFilePos& pos, std::vector<uint8_t>& data, bool& compressed)
+{
+    return OpenRecord(OpenBlockFile, pos, data, compressed);
+}
+
+/** Return the size of the record at pos as written in its header, 0 on failure */
+static unsigned int ReadBlockRecordSize(const FlatFilePos& pos)
+{
+    if (pos.nPos < 8) {
+        return 0;
+    }
+    FlatFilePos hpos = pos;
+    hpos.nPos -= 8;
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return 0;
+    }
+    CMessageHeader::MessageStartChars rec_start;
+    unsigned int size = 0;
+    try {
+        filein >> rec_start >> size;
+    } catch (const std::exception&) {
+        return 0;
+    }
+    return size;
+}
+
+/** Write the record header, with the compressed message start if payload is set */
+static void WriteRecordHeader(CAutoFile& fileout, const CMessageHeader::MessageStartChars& messageStart, const std::vector<uint8_t>& payload, unsigned int nSize)
+{
+    if (payload.empty()) {
+        fileout << messageStart << nSize;
+        return;
+    }
+    CMessageHeader::MessageStartChars compressed_start;
+    GetCompressedMessageStart(messageStart, compressed_start);
+    fileout << compressed_start << (unsigned int)payload.size();
+}
+
+static bool UndoWriteToDisk(const CBlockUndo& blockundo, const std::vector<uint8_t>& payload, FlatFilePos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
@@ -476,8 +608,7 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
     }
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(blockundo, fileout.GetVersion());
-    fileout << messageStart << nSize;
+    WriteRecordHeader(fileout, messageStart, payload, payload.empty() ? GetSerializeSize(blockundo, fileout.GetVersion()) : 0);
 
     // Write undo data
     long fileOutPos = ftell(fileout.Get());
@@ -485,7 +616,11 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
         return error("%s: ftell failed", __func__);
     }
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    if (payload.empty()) {
+        fileout << blockundo;
+    } else {
+        fileout.write(MakeByteSpan(payload));
+    }
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
@@ -500,29 +635,45 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
 {
     const FlatFilePos pos{WITH_LOCK(::cs_main, return pindex->GetUndoPos())};
 
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev ? pindex->pprev->GetBlockHash() : uint256());
+}
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hash_prev)
+{
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
 
     // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    std::vector<uint8_t> data;
+    bool compressed;
+    CAutoFile filein(OpenRecord(OpenUndoFile, pos, data, compressed), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull()) {
         return error("%s: OpenUndoFile failed", __func__);
     }
 
     // Read block
-    uint256 hashChecksum, null_hash;;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    uint256 hashChecksum, hash_data;
     try {
-        verifier << (pindex->pprev ? pindex->pprev->GetBlockHash() : null_hash);
-        verifier >> blockundo;
+        if (compressed) {
+            CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+            hasher << hash_prev;
+            hasher.write(MakeByteSpan(data));
+            hash_data = hasher.GetHash();
+            CDataStream{data, SER_DISK, CLIENT_VERSION} >> blockundo;
+        } else {
+            CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+            verifier << hash_prev;
+            verifier >> blockundo;
+            hash_data = verifier.GetHash();
+        }
         filein >> hashChecksum;
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
 
     // Verify checksum
-    if (hashChecksum != verifier.GetHash()) {
+    if (hashChecksum != hash_data) {
         return error("%s: Checksum mismatch", __func__);
     }
 
@@ -673,7 +824,7 @@ bool BlockManager::FindUndoPos(BlockValidationState& state, int nFile, FlatFileP
     return true;
 }
 
-static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessageHeader::MessageStartChars& messageStart)
+static bool WriteBlockToDisk(const CBlock& block, const std::vector<uint8_t>& payload, FlatFilePos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
@@ -682,8 +833,7 @@ static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessa
     }
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(block, fileout.GetVersion());
-    fileout << messageStart << nSize;
+    WriteRecordHeader(fileout, messageStart, payload, payload.empty() ? GetSerializeSize(block, fileout.GetVersion()) : 0);
 
     // Write block
     long fileOutPos = ftell(fileout.Get());
@@ -691,7 +841,11 @@ static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessa
         return error("WriteBlockToDisk: ftell failed");
     }
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    if (payload.empty()) {
+        fileout << block;
+    } else {
+        fileout.write(MakeByteSpan(payload));
+    }
 
     return true;
 }
@@ -701,15 +855,20 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValid
     AssertLockHeld(::cs_main);
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull()) {
+        std::vector<uint8_t> payload;
+        if (fCompressBlockFiles) {
+            CompressRecord(blockundo, payload);
+        }
         FlatFilePos _pos;
-        if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, CLIENT_VERSION) + 40)) {
+        unsigned int nUndoSize = payload.empty() ? ::GetSerializeSize(blockundo, CLIENT_VERSION) : payload.size();
+        if (!FindUndoPos(state, pindex->nFile, _pos, nUndoSize + 40)) {
             return error("ConnectBlock(): FindUndoPos failed");
         }
         uint256 prev_hash; // Particl genesis block txns are valid
         if (pindex->pprev) {
             prev_hash = pindex->pprev->GetBlockHash();
         }
-        if (!UndoWriteToDisk(blockundo, _pos, prev_hash, chainparams.MessageStart())) {
+        if (!UndoWriteToDisk(blockundo, payload, _pos, prev_hash, chainparams.MessageStart())) {
             return AbortNode(state, "Failed to write undo data");
         }
         // rev files are written in block height order, whereas blk files are written as blocks come in (often out of order)
@@ -735,14 +894,20 @@ bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::P
     block.SetNull();
 
     // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    std::vector<uint8_t> data;
+    bool compressed;
+    CAutoFile filein(OpenBlockRecord(pos, data, compressed), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull()) {
         return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
     }
 
     // Read block
     try {
-        filein >> block;
+        if (compressed) {
+            CDataStream{data, SER_DISK, CLIENT_VERSION} >> block;
+        } else {
+            filein >> block;
+        }
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
@@ -786,21 +951,30 @@ bool ReadTransactionFromDiskBlock(const CBlockIndex* pindex, int nIndex, CTransa
     const FlatFilePos block_pos{WITH_LOCK(cs_main, return pindex->GetBlockPos())};
 
     // Open history file to read
-    CAutoFile filein(OpenBlockFile(block_pos, true), SER_DISK, CLIENT_VERSION);
+    std::vector<uint8_t> data;
+    bool compressed;
+    CAutoFile filein(OpenBlockRecord(block_pos, data, compressed), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("%s: OpenBlockFile failed for %s", __func__, block_pos.ToString());
 
     CBlockHeader blockHeader;
     try {
-        filein >> blockHeader;
+        CDataStream ss{data, SER_DISK, CLIENT_VERSION};
+        auto read_txn = [&](auto& stream) {
+            stream >> blockHeader;
 
-        int nTxns = ReadCompactSize(filein);
+            int nTxns = ReadCompactSize(stream);
 
-        if (nTxns <= nIndex || nIndex < 0)
-            return error("%s: Block %s, txn %d not in available range %d.", __func__, block_pos.ToString(), nIndex, nTxns);
+            if (nTxns <= nIndex || nIndex < 0)
+                return error("%s: Block %s, txn %d not in available range %d.", __func__, block_pos.ToString(), nIndex, nTxns);
 
-        for (int k = 0; k <= nIndex; ++k)
-            filein >> txOut;
+            for (int k = 0; k <= nIndex; ++k)
+                stream >> txOut;
+            return true;
+        };
+        if (!(compressed ? read_txn(ss) : read_txn(filein))) {
+            return false;
+        }
     } catch (const std::exception& e)
     {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), block_pos.ToString());
@@ -827,6 +1001,20 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
 
         filein >> blk_start >> blk_size;
 
+        CMessageHeader::MessageStartChars compressed_start;
+        GetCompressedMessageStart(message_start, compressed_start);
+        if (!memcmp(blk_start, compressed_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            if (blk_size > MAX_SIZE) {
+                return error("%s: Compressed block data is larger than maximum deserialization size for %s", __func__, pos.ToString());
+            }
+            std::vector<uint8_t> payload(blk_size);
+            filein.read(MakeWritableByteSpan(payload));
+            if (!DecompressRecord(payload, block)) {
+                return error("%s: Failed to decompress block data for %s", __func__, pos.ToString());
+            }
+            return true;
+        }
+
         if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
             return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
                          HexStr(blk_start),
@@ -850,17 +1038,26 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
 FlatFilePos BlockManager::SaveBlockToDisk(const CBlock& block, int nHeight, CChain& active_chain, const CChainParams& chainparams, const FlatFilePos* dbp)
 {
-    unsigned int nBlockSize = ::GetSerializeSize(block, CLIENT_VERSION);
+    std::vector<uint8_t> payload;
+    if (dbp == nullptr && fCompressBlockFiles) {
+        CompressRecord(block, payload);
+    }
+    unsigned int nBlockSize = payload.empty() ? ::GetSerializeSize(block, CLIENT_VERSION) : payload.size();
     FlatFilePos blockPos;
     if (dbp != nullptr) {
         blockPos = *dbp;
+        // Known records may be compressed, take the size from the header
+        unsigned int nRecordSize = ReadBlockRecordSize(blockPos);
+        if (nRecordSize > 0 && nRecordSize < nBlockSize) {
+            nBlockSize = nRecordSize;
+        }
     }
     if (!FindBlockPos(blockPos, nBlockSize + 8, nHeight, active_chain, block.GetBlockTime(), dbp != nullptr)) {
         error("%s: FindBlockPos failed", __func__);
         return FlatFilePos();
     }
     if (dbp == nullptr) {
-        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart())) {
+        if (!WriteBlockToDisk(block, payload, blockPos, chainparams.MessageStart())) {
             AbortNode("Failed to write block");
             return FlatFilePos();
         }
@@ -933,6 +1130,16 @@ void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFile
             }
         }
 
+        // Particl: Rebuild the temporary indices if required, RPC calls are served meanwhile
+        if (!particl::RebuildRollingIndices(chainman, chainman.ActiveChainstate().GetMempool())) {
+            AbortNode("Failed to rebuild the rolling indices", _("Error rebuilding rolling indices by rewinding the chain, a reindex is required."));
+            return;
+        }
+        if (ShutdownRequested()) {
+            LogPrintf("Shutdown requested. Exit %s\n", __func__);
+            return;
+        }
+
         // scan for better chains in the block chain database, that are not yet connected in the active best chain
 
         // We can't hold cs_main during ActivateBestChain even though we're accessing
@@ -55,6 +55,10 @@ extern bool fPruneMode;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
 
+static constexpr bool DEFAULT_BLOCKFILE_COMPRESSION{false};
+/** Particl: Write new blk and rev records compressed with LZ4 where that saves space, see -blockfilecompression */
+extern bool fCompressBlockFiles;
+
 // Because validation code takes pointers to the map's CBlockIndex objects, if
 // we ever switch to another associative container, we need to either use a
 // container that has stable addressing (true of all std associative
@@ -200,6 +204,19 @@ void CleanupBlockRevFiles();
 
 /** Open a block file (blk?????.dat) */
 FILE* OpenBlockFile(const FlatFilePos& pos, bool fReadOnly = false);
+
+/**
+ * Particl: Compressed blk and rev records start with GetCompressedMessageStart() in place of the
+ * message start, the size field counts the payload: the uncompressed size (uint32 LE) followed
+ * by the LZ4 block. Records are compressed whole, so block and undo positions stay seekable.
+ */
+void GetCompressedMessageStart(const CMessageHeader::MessageStartChars& message_start, CMessageHeader::MessageStartChars& out);
+/** Decompress the payload of a compressed record into the serialized block or undo data */
+bool DecompressRecord(Span<const uint8_t> payload, std::vector<uint8_t>& data);
+/** Open the block file for the record at pos. Plain records are left at pos to be read from the file,
+ *  compressed records are read and decompressed into data, compressed is set to match.
+ *  Returns nullptr on failure. */
+FILE* OpenBlockRecord(const FlatFilePos& pos, std::vector<uint8_t>& data, bool& compressed);
 /** Translation to a filesystem path */
 fs::path GetBlockPosFilename(const FlatFilePos& pos);
 
@@ -215,6 +232,8 @@ bool ReadTransactionFromDiskBlock(const CBlockIndex* pindex, int nIndex, CTransa
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Read the undo data at pos of the block following hash_prev, doesn't lock cs_main */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hash_prev);
 
 void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFiles, const ArgsManager& args);
 } // namespace node
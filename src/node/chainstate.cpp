@@ -76,12 +76,12 @@ std::optional<ChainstateLoadingError> LoadChainstate(bool fReset,
     if (fSpentIndex != gArgs.GetBoolArg("-spentindex", particl::DEFAULT_SPENTINDEX)) {
         return ChainstateLoadingError::ERROR_SPENTINDEX_NEEDS_REINDEX;
     }
-    if (fTimestampIndex != gArgs.GetBoolArg("-timestampindex", particl::DEFAULT_TIMESTAMPINDEX)) {
-        return ChainstateLoadingError::ERROR_TIMESTAMPINDEX_NEEDS_REINDEX;
-    }
     if (fBalancesIndex != gArgs.GetBoolArg("-balancesindex", particl::DEFAULT_BALANCESINDEX)) {
         return ChainstateLoadingError::ERROR_BALANCESINDEX_NEEDS_REINDEX;
     }
+    if (fBlockRewardIndex != gArgs.GetBoolArg("-blockrewardindex", particl::DEFAULT_BLOCKREWARDINDEX)) {
+        return ChainstateLoadingError::ERROR_BLOCKREWARDINDEX_NEEDS_REINDEX;
+    }
 
     // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
     // in the past, but is now trying to run unpruned.
@@ -134,10 +134,14 @@ std::optional<ChainstateLoadingError> LoadChainstate(bool fReset,
         }
     }
 
+    // Reads fall through to leveldb for rows missing from the flat file
+    const CBlockIndex *tip = chainman.ActiveChain().Tip();
+    if (!pblocktree->SyncRCTOutputFile(tip ? tip->nAnonOutputs : 0)) {
+        LogPrintf("Warning: %s: SyncRCTOutputFile failed.\n", __func__);
     }
-    // Initialise temporary indices if required
-    if (!particl::RebuildRollingIndices(chainman, mempool)) {
-        return ChainstateLoadingError::ERROR_REBUILD_ROLLING_FAILED;
+    pblocktree->StartRCTKeyImageFilterBuild();
+    pblocktree->StartAddressIndexMigration();
+
     }
     LOCK(cs_main);
 
@@ -28,9 +28,8 @@ enum class ChainstateLoadingError {
     ERROR_BLOCKS_WITNESS_INSUFFICIENTLY_VALIDATED,
     ERROR_ADDRESSINDEX_NEEDS_REINDEX,
     ERROR_SPENTINDEX_NEEDS_REINDEX,
-    ERROR_TIMESTAMPINDEX_NEEDS_REINDEX,
     ERROR_BALANCESINDEX_NEEDS_REINDEX,
-    ERROR_REBUILD_ROLLING_FAILED,
+    ERROR_BLOCKREWARDINDEX_NEEDS_REINDEX,
     SHUTDOWN_PROBED,
 };
 
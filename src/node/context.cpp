@@ -6,10 +6,12 @@
 
 #include <addrman.h>
 #include <banman.h>
+#include <insight/blockdeltas.h>
 #include <interfaces/chain.h>
 #include <net.h>
 #include <net_processing.h>
 #include <netgroup.h>
+#include <node/miner.h>
 #include <policy/fees.h>
 #include <scheduler.h>
 #include <txmempool.h>
@@ -13,6 +13,7 @@
 class ArgsManager;
 class BanMan;
 class AddrMan;
+class BlockDeltasCache;
 class CBlockPolicyEstimator;
 class CConnman;
 class CScheduler;
@@ -29,6 +30,8 @@ class WalletLoader;
 } // namespace interfaces
 
 namespace node {
+class BlockTemplateCache;
+
 //! NodeContext struct containing references to chain state and connection
 //! state.
 //!
@@ -51,6 +54,8 @@ struct NodeContext {
     std::unique_ptr<ChainstateManager> chainman;
     std::unique_ptr<BanMan> banman;
     std::unique_ptr<SmsgManager> smsgman;
+    std::unique_ptr<BlockTemplateCache> block_template_cache;
+    std::unique_ptr<BlockDeltasCache> block_deltas_cache;
     ArgsManager* args{nullptr}; // Currently a raw pointer because the memory is not managed by this struct
     std::unique_ptr<interfaces::Chain> chain;
     //! List of all chain clients (wallet processes or other client) connected to node.
@@ -3,11 +3,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <addrdb.h>
+#include <anon.h>
 #include <banman.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <deploymentstatus.h>
 #include <external_signer.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <interfaces/chain.h>
 #include <interfaces/handler.h>
@@ -400,6 +402,7 @@ bool FillBlock(const CBlockIndex* index, const FoundBlock& block, UniqueLock<Rec
     if (block.m_max_time) *block.m_max_time = index->GetBlockTimeMax();
     if (block.m_mtp_time) *block.m_mtp_time = index->GetMedianTimePast();
     if (block.m_in_active_chain) *block.m_in_active_chain = active[index->nHeight] == index;
+    if (block.m_locator) *block.m_locator = active.GetLocator(index);
     if (block.m_next_block) FillBlock(active[index->nHeight] == index ? active[index->nHeight + 1] : nullptr, *block.m_next_block, lock, active);
     if (block.m_data) {
         REVERSE_LOCK(lock);
@@ -446,7 +449,8 @@ public:
     explicit NotificationsHandlerImpl(std::shared_ptr<Chain::Notifications> notifications)
         : m_proxy(std::make_shared<NotificationsProxy>(std::move(notifications)))
     {
-        RegisterSharedValidationInterface(m_proxy);
+        // Wallets are independent of each other, their notifications run concurrently
+        RegisterSharedValidationInterface(m_proxy, /*own_queue=*/true);
     }
     ~NotificationsHandlerImpl() override { disconnect(); }
     void disconnect() override
@@ -625,6 +629,20 @@ public:
         }
         return false;
     }
+    bool hasBlockFilterIndex(BlockFilterType filter_type) override
+    {
+        return GetBlockFilterIndex(filter_type) != nullptr;
+    }
+    std::optional<bool> blockFilterMatchesAny(BlockFilterType filter_type, const uint256& block_hash, const GCSFilter::ElementSet& filter_set) override
+    {
+        const BlockFilterIndex* block_filter_index{GetBlockFilterIndex(filter_type)};
+        if (!block_filter_index) return std::nullopt;
+
+        BlockFilter filter;
+        const CBlockIndex* index{WITH_LOCK(::cs_main, return chainman().m_blockman.LookupBlockIndex(block_hash))};
+        if (index == nullptr || !block_filter_index->LookupFilter(index, filter)) return std::nullopt;
+        return filter.GetFilter().MatchAny(filter_set);
+    }
     RBFTransactionState isRBFOptIn(const CTransaction& tx) override
     {
         if (!m_node.mempool) return IsRBFOptInEmptyMempool(tx);
@@ -797,6 +815,18 @@ public:
         const CChain& active = Assert(m_node.chainman)->ActiveChain();
         return active.Tip()->nAnonOutputs;
     }
+    int64_t getAnonOutputsAtHeight(int height) override
+    {
+        LOCK(::cs_main);
+        const CChain& active = Assert(m_node.chainman)->ActiveChain();
+        const CBlockIndex *pindex = active[height];
+        return pindex ? pindex->nAnonOutputs : -1;
+    }
+    int getAnonOutputHeight(int64_t i) override
+    {
+        LOCK(::cs_main);
+        return GetAnonOutputHeight(Assert(m_node.chainman)->ActiveChain(), i);
+    }
     int64_t getSmsgFeeRate(ChainstateManager &chainman, const CBlockIndex *pindex, bool reduce_height) override
     {
         LOCK(::cs_main);
@@ -811,6 +841,7 @@ public:
     std::unique_ptr<CBlockTemplate> createNewBlock() override
     {
         if (!m_node.mempool) return nullptr;
+        if (m_node.block_template_cache) return m_node.block_template_cache->Get();
         CScript coinbaseScript;
         CChainState& active = Assert(m_node.chainman)->ActiveChainstate();
         return BlockAssembler(active, *m_node.mempool.get()).CreateNewBlock(coinbaseScript, false);
@@ -844,6 +875,11 @@ public:
         LOCK(::cs_main);
         return m_node.chainman->m_blockman.m_block_tree_db->ReadRCTKeyImage(ki, ki_data);
     }
+    void checkKeyImages(const std::vector<CCmpPubKey> &key_images, std::vector<CKeyImageSpend> &states) override
+    {
+        LOCK(::cs_main);
+        GetKeyImageStates(*m_node.chainman->m_blockman.m_block_tree_db, m_node.mempool.get(), key_images, states);
+    }
 };
 } // namespace
 } // namespace node
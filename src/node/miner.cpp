@@ -18,9 +18,11 @@
 #include <policy/policy.h>
 #include <pow.h>
 #include <primitives/transaction.h>
+#include <scheduler.h>
 #include <timedata.h>
 #include <util/moneystr.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <algorithm>
@@ -438,4 +440,114 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
         nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
     }
 }
+BlockTemplateCache::BlockTemplateCache(ChainstateManager& chainman, const CTxMemPool& mempool, CScheduler& scheduler)
+    : m_chainman(chainman), m_mempool(mempool), m_scheduler(scheduler)
+{
+}
+
+std::shared_ptr<const CBlockTemplate> BlockTemplateCache::Build()
+{
+    // Read before assembling, a change made while building leaves the template marked as stale
+    unsigned int txns_updated = m_mempool.GetTransactionsUpdated();
+    std::shared_ptr<const CBlockTemplate> block_template = BlockAssembler(m_chainman.ActiveChainstate(), m_mempool).CreateNewBlock(CScript(), false);
+    if (!block_template) {
+        return nullptr;
+    }
+    LOCK(m_mutex);
+    m_template = block_template;
+    m_txns_updated = txns_updated;
+    m_built_time = GetTime<std::chrono::seconds>();
+    return block_template;
+}
+
+bool BlockTemplateCache::IsUsable(const CBlockTemplate& block_template, unsigned int txns_updated, std::chrono::seconds built_time) const
+{
+    const CBlockIndex* tip = WITH_LOCK(::cs_main, return m_chainman.ActiveChain().Tip());
+    if (!tip || block_template.block.hashPrevBlock != tip->GetBlockHash()) {
+        return false;
+    }
+    if (txns_updated == m_mempool.GetTransactionsUpdated()) {
+        return true;
+    }
+    if (GetTime<std::chrono::seconds>() - built_time > TEMPLATE_MAX_STALE) {
+        return false;
+    }
+    // Transactions were added or removed, the block is still valid if none of its transactions left the mempool
+    LOCK(m_mempool.cs);
+    for (size_t i = 1; i < block_template.block.vtx.size(); ++i) {
+        if (!m_mempool.exists(GenTxid::Txid(block_template.block.vtx[i]->GetHash()))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<CBlockTemplate> BlockTemplateCache::Get()
+{
+    std::shared_ptr<const CBlockTemplate> block_template;
+    unsigned int txns_updated;
+    std::chrono::seconds built_time;
+    {
+        LOCK(m_mutex);
+        m_last_request = GetTime<std::chrono::seconds>();
+        block_template = m_template;
+        txns_updated = m_txns_updated;
+        built_time = m_built_time;
+    }
+    if (!block_template || !IsUsable(*block_template, txns_updated, built_time)) {
+        block_template = Build();
+        if (!block_template) {
+            return nullptr;
+        }
+    }
+    return std::make_unique<CBlockTemplate>(*block_template);
+}
+
+void BlockTemplateCache::ScheduleRefresh()
+{
+    LOCK(m_mutex);
+    if (m_refresh_pending ||
+        GetTime<std::chrono::seconds>() - m_last_request > TEMPLATE_REQUEST_WINDOW) {
+        return;
+    }
+    m_refresh_pending = true;
+    m_scheduler.scheduleFromNow([this] { Refresh(); }, TEMPLATE_REFRESH_DELAY);
+}
+
+void BlockTemplateCache::Refresh()
+{
+    {
+        LOCK(m_mutex);
+        m_refresh_pending = false;
+        if (GetTime<std::chrono::seconds>() - m_last_request > TEMPLATE_REQUEST_WINDOW) {
+            m_template.reset();
+            return;
+        }
+    }
+    try {
+        Build();
+    } catch (const std::exception& e) {
+        LogPrintf("%s: Failed to build block template: %s\n", __func__, e.what());
+    }
+}
+
+void BlockTemplateCache::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (!fInitialDownload) {
+        ScheduleRefresh();
+    }
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence)
+{
+    ScheduleRefresh();
+}
+
+void BlockTemplateCache::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    // Removals for a connected block are followed by UpdatedBlockTip
+    if (reason != MemPoolRemovalReason::BLOCK) {
+        ScheduleRefresh();
+    }
+}
 } // namespace node
@@ -7,7 +7,9 @@
 #define BITCOIN_NODE_MINER_H
 
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
 #include <memory>
 #include <optional>
@@ -19,6 +21,7 @@
 class ChainstateManager;
 class CBlockIndex;
 class CChainParams;
+class CScheduler;
 class CScript;
 
 namespace Consensus { struct Params; };
@@ -204,6 +207,50 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 
 /** Update an old GenerateCoinbaseCommitment from CreateNewBlock after the block txs have changed */
 void RegenerateCommitments(CBlock& block, ChainstateManager& chainman);
+
+/**
+ * Block template for the staker, rebuilt in the background on tip and mempool changes.
+ *
+ * Templates are only refreshed while one was requested recently, a staker with a kernel
+ * then only has to add its coinstake and sign. A template missing new mempool
+ * transactions is served for up to TEMPLATE_MAX_STALE, one with a transaction that left
+ * the mempool or built on an old tip never is.
+ */
+class BlockTemplateCache final : public CValidationInterface
+{
+public:
+    static constexpr std::chrono::seconds TEMPLATE_MAX_STALE{30};
+    static constexpr std::chrono::seconds TEMPLATE_REQUEST_WINDOW{300};
+    static constexpr std::chrono::milliseconds TEMPLATE_REFRESH_DELAY{250};
+
+    explicit BlockTemplateCache(ChainstateManager& chainman, const CTxMemPool& mempool, CScheduler& scheduler);
+
+    /** Return a copy of the current template, built now if the cached one can't be used */
+    std::unique_ptr<CBlockTemplate> Get() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex, !::cs_main);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    std::shared_ptr<const CBlockTemplate> Build() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex, !::cs_main);
+    bool IsUsable(const CBlockTemplate& block_template, unsigned int txns_updated, std::chrono::seconds built_time) const EXCLUSIVE_LOCKS_REQUIRED(!::cs_main);
+    void ScheduleRefresh() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void Refresh() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex, !::cs_main);
+
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+    CScheduler& m_scheduler;
+
+    Mutex m_mutex;
+    std::shared_ptr<const CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    //! Value of CTxMemPool::GetTransactionsUpdated read before m_template was built
+    unsigned int m_txns_updated GUARDED_BY(m_mutex){0};
+    std::chrono::seconds m_built_time GUARDED_BY(m_mutex){0};
+    std::chrono::seconds m_last_request GUARDED_BY(m_mutex){0};
+    bool m_refresh_pending GUARDED_BY(m_mutex){false};
+};
 } // namespace node
 
 #endif // BITCOIN_NODE_MINER_H
@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <anon.h>
 #include <consensus/validation.h>
 #include <index/txindex.h>
 #include <net.h>
@@ -44,6 +45,10 @@ TransactionError BroadcastTransaction(NodeContext& node, const CTransactionRef t
     uint256 wtxid = tx->GetWitnessHash();
     bool callback_set = false;
 
+    if (node.chainman && tx->IsParticlVersion()) {
+        PrefetchAnonInputs(*node.chainman->m_blockman.m_block_tree_db, *tx);
+    }
+
     {
         assert(node.chainman);
         LOCK(cs_main);
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
 #define BITCOIN_NODE_UTXO_SNAPSHOT_H
 
+#include <consensus/amount.h>
 #include <uint256.h>
 #include <serialize.h>
 
@@ -33,6 +34,24 @@ public:
 
     SERIALIZE_METHODS(SnapshotMetadata, obj) { READWRITE(obj.m_base_blockhash, obj.m_coins_count); }
 };
+
+//! Particl state of the snapshot base block, written after the coins.
+//! Followed by the anon outputs, key images and spent cache rows, see CBlockTreeDB::DumpSnapshotRCTState.
+class ParticlSnapshotHeader
+{
+public:
+    CAmount m_money_supply = 0;
+    int64_t m_anon_outputs = 0;
+    uint256 m_stake_modifier;
+
+    ParticlSnapshotHeader() { }
+    ParticlSnapshotHeader(CAmount money_supply, int64_t anon_outputs, const uint256 &stake_modifier) :
+        m_money_supply(money_supply),
+        m_anon_outputs(anon_outputs),
+        m_stake_modifier(stake_modifier) { }
+
+    SERIALIZE_METHODS(ParticlSnapshotHeader, obj) { READWRITE(obj.m_money_supply, obj.m_anon_outputs, obj.m_stake_modifier); }
+};
 } // namespace node
 
 #endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
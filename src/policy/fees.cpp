@@ -11,6 +11,7 @@
 #include <streams.h>
 #include <txmempool.h>
 #include <util/serfloat.h>
+#include <util/strencodings.h>
 #include <util/system.h>
 #include <anon.h>
 
@@ -28,6 +29,48 @@ std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon)
     assert(false);
 }
 
+std::string StringForFeeEstimateTxType(FeeEstimateTxType type)
+{
+    switch (type) {
+    case FeeEstimateTxType::ALL: return "all";
+    case FeeEstimateTxType::PLAIN: return "plain";
+    case FeeEstimateTxType::BLIND: return "blind";
+    case FeeEstimateTxType::ANON: return "anon";
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+bool FeeEstimateTxTypeFromString(const std::string& str, FeeEstimateTxType& type)
+{
+    for (const auto t : ALL_FEE_ESTIMATE_TX_TYPES) {
+        if (ToLower(str) == StringForFeeEstimateTxType(t)) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+FeeEstimateTxType GetFeeEstimateTxType(const CTxMemPoolEntry& entry)
+{
+    const CTransaction &tx = entry.GetTx();
+    bool has_blind = entry.m_spends_blind;
+    for (const auto &txin : tx.vin) {
+        if (txin.IsAnonInput()) {
+            return FeeEstimateTxType::ANON;
+        }
+    }
+    for (const auto &txout : tx.vpout) {
+        if (txout->IsType(OUTPUT_RINGCT)) {
+            return FeeEstimateTxType::ANON;
+        }
+        if (txout->IsType(OUTPUT_CT)) {
+            has_blind = true;
+        }
+    }
+    return has_blind ? FeeEstimateTxType::BLIND : FeeEstimateTxType::PLAIN;
+}
+
 namespace {
 
 struct EncodedDoubleFormatter
@@ -497,6 +540,12 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
     return _removeTx(hash, inBlock);
 }
 
+static size_t TypeStatsIndex(FeeEstimateTxType type)
+{
+    assert(type != FeeEstimateTxType::ALL);
+    return static_cast<size_t>(type) - 1;
+}
+
 bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
 {
     AssertLockHeld(m_cs_fee_estimator);
@@ -505,6 +554,10 @@ bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        TypeConfirmStats& stats = typeStats[TypeStatsIndex(pos->second.type)];
+        stats.feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.typeBucketIndex, inBlock);
+        stats.shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.typeBucketIndex, inBlock);
+        stats.longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.typeBucketIndex, inBlock);
         mapMemPoolTxs.erase(hash);
         return true;
     } else {
@@ -529,6 +582,7 @@ CBlockPolicyEstimator::CBlockPolicyEstimator()
     feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
     shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
     longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+    ResetTypeStats(typeStats, buckets, bucketMap);
 
     // If the fee estimation file is present, read recorded estimations
     fs::path est_filepath = gArgs.GetDataDirNet() / FEE_ESTIMATES_FILENAME;
@@ -540,7 +594,37 @@ CBlockPolicyEstimator::CBlockPolicyEstimator()
 
 CBlockPolicyEstimator::~CBlockPolicyEstimator() = default;
 
-bool GetFeeRate(const CTxMemPoolEntry *entry, CFeeRate &feeRate)
+void CBlockPolicyEstimator::ResetTypeStats(std::array<TypeConfirmStats, ALL_FEE_ESTIMATE_TX_TYPES.size() - 1>& stats,
+                                           const std::vector<double>& defaultBuckets, const std::map<double, unsigned int>& defaultBucketMap)
+{
+    for (auto& s : stats) {
+        s.feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(defaultBuckets, defaultBucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+        s.shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(defaultBuckets, defaultBucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+        s.longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(defaultBuckets, defaultBucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+    }
+}
+
+const TxConfirmStats& CBlockPolicyEstimator::GetStats(FeeEstimateTxType type, FeeEstimateHorizon horizon) const
+{
+    if (type == FeeEstimateTxType::ALL) {
+        switch (horizon) {
+        case FeeEstimateHorizon::SHORT_HALFLIFE: return *shortStats;
+        case FeeEstimateHorizon::MED_HALFLIFE: return *feeStats;
+        case FeeEstimateHorizon::LONG_HALFLIFE: return *longStats;
+        } // no default case, so the compiler can warn about missing cases
+        assert(false);
+    }
+    const TypeConfirmStats& stats = typeStats[TypeStatsIndex(type)];
+    switch (horizon) {
+    case FeeEstimateHorizon::SHORT_HALFLIFE: return *stats.shortStats;
+    case FeeEstimateHorizon::MED_HALFLIFE: return *stats.feeStats;
+    case FeeEstimateHorizon::LONG_HALFLIFE: return *stats.longStats;
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+/** Set feeRate for the ALL stats and typeFeeRate, without the anon fee multiplier scaling, for the stats of the tx type */
+static bool GetFeeRate(const CTxMemPoolEntry *entry, CFeeRate &feeRate, CFeeRate &typeFeeRate)
 {
     const CTransaction &tx = entry->GetTx();
     CAmount tx_fee = entry->GetFee();
@@ -560,6 +644,7 @@ bool GetFeeRate(const CTxMemPoolEntry *entry, CFeeRate &feeRate)
         }
     }
 
+    CAmount type_fee = tx_fee;
     if (has_anon_outputs) {
         tx_fee /= ANON_FEE_MULTIPLIER;
     }
@@ -571,6 +656,7 @@ bool GetFeeRate(const CTxMemPoolEntry *entry, CFeeRate &feeRate)
     }
 
     feeRate = CFeeRate(tx_fee - smsg_fees, entry->GetTxSize());
+    typeFeeRate = CFeeRate(type_fee - smsg_fees, entry->GetTxSize());
     return true;
 }
 
@@ -601,21 +687,31 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     }
 
     // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate;
-    if (!GetFeeRate(&entry, feeRate)) {
+    CFeeRate feeRate, typeFeeRate;
+    if (!GetFeeRate(&entry, feeRate, typeFeeRate)) {
         untrackedTxs++;
         return;
     }
 
     trackedTxs++;
 
-    mapMemPoolTxs[hash].blockHeight = txHeight;
+    TxStatsInfo& info = mapMemPoolTxs[hash];
+    info.blockHeight = txHeight;
     unsigned int bucketIndex = feeStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
-    mapMemPoolTxs[hash].bucketIndex = bucketIndex;
+    info.bucketIndex = bucketIndex;
     unsigned int bucketIndex2 = shortStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
     assert(bucketIndex == bucketIndex2);
     unsigned int bucketIndex3 = longStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
     assert(bucketIndex == bucketIndex3);
+
+    info.type = GetFeeEstimateTxType(entry);
+    TypeConfirmStats& stats = typeStats[TypeStatsIndex(info.type)];
+    unsigned int typeBucketIndex = stats.feeStats->NewTx(txHeight, (double)typeFeeRate.GetFeePerK());
+    info.typeBucketIndex = typeBucketIndex;
+    unsigned int typeBucketIndex2 = stats.shortStats->NewTx(txHeight, (double)typeFeeRate.GetFeePerK());
+    assert(typeBucketIndex == typeBucketIndex2);
+    unsigned int typeBucketIndex3 = stats.longStats->NewTx(txHeight, (double)typeFeeRate.GetFeePerK());
+    assert(typeBucketIndex == typeBucketIndex3);
 }
 
 bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
@@ -638,14 +734,19 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     }
 
     // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate;
-    if (!GetFeeRate(entry, feeRate)) {
+    CFeeRate feeRate, typeFeeRate;
+    if (!GetFeeRate(entry, feeRate, typeFeeRate)) {
         return false;
     }
 
     feeStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
     shortStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
     longStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
+
+    TypeConfirmStats& stats = typeStats[TypeStatsIndex(GetFeeEstimateTxType(*entry))];
+    stats.feeStats->Record(blocksToConfirm, (double)typeFeeRate.GetFeePerK());
+    stats.shortStats->Record(blocksToConfirm, (double)typeFeeRate.GetFeePerK());
+    stats.longStats->Record(blocksToConfirm, (double)typeFeeRate.GetFeePerK());
     return true;
 }
 
@@ -671,11 +772,21 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     feeStats->ClearCurrent(nBlockHeight);
     shortStats->ClearCurrent(nBlockHeight);
     longStats->ClearCurrent(nBlockHeight);
+    for (auto& stats : typeStats) {
+        stats.feeStats->ClearCurrent(nBlockHeight);
+        stats.shortStats->ClearCurrent(nBlockHeight);
+        stats.longStats->ClearCurrent(nBlockHeight);
+    }
 
     // Decay all exponential averages
     feeStats->UpdateMovingAverages();
     shortStats->UpdateMovingAverages();
     longStats->UpdateMovingAverages();
+    for (auto& stats : typeStats) {
+        stats.feeStats->UpdateMovingAverages();
+        stats.shortStats->UpdateMovingAverages();
+        stats.longStats->UpdateMovingAverages();
+    }
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
@@ -788,32 +899,35 @@ unsigned int CBlockPolicyEstimator::MaxUsableEstimate() const
  * time horizon which tracks confirmations up to the desired target.  If
  * checkShorterHorizon is requested, also allow short time horizon estimates
  * for a lower target to reduce the given answer */
-double CBlockPolicyEstimator::estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const
+double CBlockPolicyEstimator::estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result, FeeEstimateTxType type) const
 {
+    const TxConfirmStats& short_stats = GetStats(type, FeeEstimateHorizon::SHORT_HALFLIFE);
+    const TxConfirmStats& med_stats = GetStats(type, FeeEstimateHorizon::MED_HALFLIFE);
+    const TxConfirmStats& long_stats = GetStats(type, FeeEstimateHorizon::LONG_HALFLIFE);
     double estimate = -1;
-    if (confTarget >= 1 && confTarget <= longStats->GetMaxConfirms()) {
+    if (confTarget >= 1 && confTarget <= long_stats.GetMaxConfirms()) {
         // Find estimate from shortest time horizon possible
-        if (confTarget <= shortStats->GetMaxConfirms()) { // short horizon
-            estimate = shortStats->EstimateMedianVal(confTarget, SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, result);
+        if (confTarget <= short_stats.GetMaxConfirms()) { // short horizon
+            estimate = short_stats.EstimateMedianVal(confTarget, SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, result);
         }
-        else if (confTarget <= feeStats->GetMaxConfirms()) { // medium horizon
-            estimate = feeStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
+        else if (confTarget <= med_stats.GetMaxConfirms()) { // medium horizon
+            estimate = med_stats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
         }
         else { // long horizon
-            estimate = longStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
+            estimate = long_stats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, result);
         }
         if (checkShorterHorizon) {
             EstimationResult tempResult;
             // If a lower confTarget from a more recent horizon returns a lower answer use it.
-            if (confTarget > feeStats->GetMaxConfirms()) {
-                double medMax = feeStats->EstimateMedianVal(feeStats->GetMaxConfirms(), SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, &tempResult);
+            if (confTarget > med_stats.GetMaxConfirms()) {
+                double medMax = med_stats.EstimateMedianVal(med_stats.GetMaxConfirms(), SUFFICIENT_FEETXS, successThreshold, nBestSeenHeight, &tempResult);
                 if (medMax > 0 && (estimate == -1 || medMax < estimate)) {
                     estimate = medMax;
                     if (result) *result = tempResult;
                 }
             }
-            if (confTarget > shortStats->GetMaxConfirms()) {
-                double shortMax = shortStats->EstimateMedianVal(shortStats->GetMaxConfirms(), SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, &tempResult);
+            if (confTarget > short_stats.GetMaxConfirms()) {
+                double shortMax = short_stats.EstimateMedianVal(short_stats.GetMaxConfirms(), SUFFICIENT_TXS_SHORT, successThreshold, nBestSeenHeight, &tempResult);
                 if (shortMax > 0 && (estimate == -1 || shortMax < estimate)) {
                     estimate = shortMax;
                     if (result) *result = tempResult;
@@ -827,15 +941,18 @@ double CBlockPolicyEstimator::estimateCombinedFee(unsigned int confTarget, doubl
 /** Ensure that for a conservative estimate, the DOUBLE_SUCCESS_PCT is also met
  * at 2 * target for any longer time horizons.
  */
-double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result) const
+double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result, FeeEstimateTxType type) const
 {
+    const TxConfirmStats& short_stats = GetStats(type, FeeEstimateHorizon::SHORT_HALFLIFE);
+    const TxConfirmStats& med_stats = GetStats(type, FeeEstimateHorizon::MED_HALFLIFE);
+    const TxConfirmStats& long_stats = GetStats(type, FeeEstimateHorizon::LONG_HALFLIFE);
     double estimate = -1;
     EstimationResult tempResult;
-    if (doubleTarget <= shortStats->GetMaxConfirms()) {
-        estimate = feeStats->EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, result);
+    if (doubleTarget <= short_stats.GetMaxConfirms()) {
+        estimate = med_stats.EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, result);
     }
-    if (doubleTarget <= feeStats->GetMaxConfirms()) {
-        double longEstimate = longStats->EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, &tempResult);
+    if (doubleTarget <= med_stats.GetMaxConfirms()) {
+        double longEstimate = long_stats.EstimateMedianVal(doubleTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, nBestSeenHeight, &tempResult);
         if (longEstimate > estimate) {
             estimate = longEstimate;
             if (result) *result = tempResult;
@@ -850,8 +967,9 @@ double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget,
  * shortest time horizon which tracks the required target.  Conservative
  * estimates, however, required the 95% threshold at 2 * target be met for any
  * longer time horizons also.
+ * Only transactions of type contribute to the estimate.
  */
-CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
+CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative, FeeEstimateTxType type) const
 {
     LOCK(m_cs_fee_estimator);
 
@@ -890,13 +1008,13 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
      * the purpose of conservative estimates is not to let short term
      * fluctuations lower our estimates by too much.
      */
-    double halfEst = estimateCombinedFee(confTarget/2, HALF_SUCCESS_PCT, true, &tempResult);
+    double halfEst = estimateCombinedFee(confTarget/2, HALF_SUCCESS_PCT, true, &tempResult, type);
     if (feeCalc) {
         feeCalc->est = tempResult;
         feeCalc->reason = FeeReason::HALF_ESTIMATE;
     }
     median = halfEst;
-    double actualEst = estimateCombinedFee(confTarget, SUCCESS_PCT, true, &tempResult);
+    double actualEst = estimateCombinedFee(confTarget, SUCCESS_PCT, true, &tempResult, type);
     if (actualEst > median) {
         median = actualEst;
         if (feeCalc) {
@@ -904,7 +1022,7 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
             feeCalc->reason = FeeReason::FULL_ESTIMATE;
         }
     }
-    double doubleEst = estimateCombinedFee(2 * confTarget, DOUBLE_SUCCESS_PCT, !conservative, &tempResult);
+    double doubleEst = estimateCombinedFee(2 * confTarget, DOUBLE_SUCCESS_PCT, !conservative, &tempResult, type);
     if (doubleEst > median) {
         median = doubleEst;
         if (feeCalc) {
@@ -914,7 +1032,7 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
     }
 
     if (conservative || median == -1) {
-        double consEst =  estimateConservativeFee(2 * confTarget, &tempResult);
+        double consEst =  estimateConservativeFee(2 * confTarget, &tempResult, type);
         if (consEst > median) {
             median = consEst;
             if (feeCalc) {
@@ -956,6 +1074,11 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
         feeStats->Write(fileout);
         shortStats->Write(fileout);
         longStats->Write(fileout);
+        for (const auto& stats : typeStats) {
+            stats.feeStats->Write(fileout);
+            stats.shortStats->Write(fileout);
+            stats.longStats->Write(fileout);
+        }
     }
     catch (const std::exception&) {
         LogPrintf("CBlockPolicyEstimator::Write(): unable to write policy estimator data (non-fatal)\n");
@@ -1001,6 +1124,20 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
             fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
 
+            // Files written before the per type stats were added end here, start those empty
+            std::array<TypeConfirmStats, ALL_FEE_ESTIMATE_TX_TYPES.size() - 1> fileTypeStats;
+            ResetTypeStats(fileTypeStats, buckets, bucketMap);
+            try {
+                for (auto& stats : fileTypeStats) {
+                    stats.feeStats->Read(filein, nVersionThatWrote, numBuckets);
+                    stats.shortStats->Read(filein, nVersionThatWrote, numBuckets);
+                    stats.longStats->Read(filein, nVersionThatWrote, numBuckets);
+                }
+            } catch (const std::exception& e) {
+                LogPrint(BCLog::ESTIMATEFEE, "%s: no per type fee estimates (%s)\n", __func__, e.what());
+                ResetTypeStats(fileTypeStats, buckets, bucketMap);
+            }
+
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
             buckets = fileBuckets;
@@ -1013,6 +1150,7 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             feeStats = std::move(fileFeeStats);
             shortStats = std::move(fileShortStats);
             longStats = std::move(fileLongStats);
+            typeStats = std::move(fileTypeStats);
 
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
@@ -39,6 +39,27 @@ static constexpr auto ALL_FEE_ESTIMATE_HORIZONS = std::array{
 
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon);
 
+/* Transaction classes with their own estimates, a transaction with anon
+ * inputs or outputs is ANON, else one with blinded inputs or outputs is BLIND.
+ * ALL tracks every transaction with anon fees scaled down by ANON_FEE_MULTIPLIER. */
+enum class FeeEstimateTxType {
+    ALL,
+    PLAIN,
+    BLIND,
+    ANON,
+};
+
+static constexpr auto ALL_FEE_ESTIMATE_TX_TYPES = std::array{
+    FeeEstimateTxType::ALL,
+    FeeEstimateTxType::PLAIN,
+    FeeEstimateTxType::BLIND,
+    FeeEstimateTxType::ANON,
+};
+
+std::string StringForFeeEstimateTxType(FeeEstimateTxType type);
+bool FeeEstimateTxTypeFromString(const std::string& str, FeeEstimateTxType& type);
+FeeEstimateTxType GetFeeEstimateTxType(const CTxMemPoolEntry& entry);
+
 /* Enumeration of reason for returned fee estimate */
 enum class FeeReason {
     NONE,
@@ -206,7 +227,8 @@ public:
      *  the closest target where one can be given.  'conservative' estimates are
      *  valid over longer time horizons also.
      */
-    CFeeRate estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
+    CFeeRate estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative,
+                              FeeEstimateTxType type = FeeEstimateTxType::ALL) const
         EXCLUSIVE_LOCKS_REQUIRED(!m_cs_fee_estimator);
 
     /** Return a specific fee estimate calculation with a given success
@@ -249,7 +271,9 @@ private:
     {
         unsigned int blockHeight;
         unsigned int bucketIndex;
-        TxStatsInfo() : blockHeight(0), bucketIndex(0) {}
+        FeeEstimateTxType type;
+        unsigned int typeBucketIndex; // Bucket in the stats of type, differs from bucketIndex for anon txns
+        TxStatsInfo() : blockHeight(0), bucketIndex(0), type(FeeEstimateTxType::PLAIN), typeBucketIndex(0) {}
     };
 
     // map of txids to information about that transaction
@@ -260,6 +284,15 @@ private:
     std::unique_ptr<TxConfirmStats> shortStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> longStats PT_GUARDED_BY(m_cs_fee_estimator);
 
+    /** Stats for each FeeEstimateTxType other than ALL */
+    struct TypeConfirmStats
+    {
+        std::unique_ptr<TxConfirmStats> feeStats;
+        std::unique_ptr<TxConfirmStats> shortStats;
+        std::unique_ptr<TxConfirmStats> longStats;
+    };
+    std::array<TypeConfirmStats, ALL_FEE_ESTIMATE_TX_TYPES.size() - 1> typeStats GUARDED_BY(m_cs_fee_estimator);
+
     unsigned int trackedTxs GUARDED_BY(m_cs_fee_estimator);
     unsigned int untrackedTxs GUARDED_BY(m_cs_fee_estimator);
 
@@ -269,10 +302,15 @@ private:
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 
+    /** Create empty stats for every type in typeStats */
+    static void ResetTypeStats(std::array<TypeConfirmStats, ALL_FEE_ESTIMATE_TX_TYPES.size() - 1>& stats,
+                               const std::vector<double>& defaultBuckets, const std::map<double, unsigned int>& defaultBucketMap);
+    /** Return the stats tracking type over horizon */
+    const TxConfirmStats& GetStats(FeeEstimateTxType type, FeeEstimateHorizon horizon) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Helper for estimateSmartFee */
-    double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result, FeeEstimateTxType type) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Helper for estimateSmartFee */
-    double estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    double estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result, FeeEstimateTxType type) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Number of blocks of data recorded while fee estimates have been running */
     unsigned int BlockSpan() const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Number of blocks of recorded fee estimate data represented in saved data file */
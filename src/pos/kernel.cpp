@@ -7,10 +7,14 @@
 #include <pos/kernel.h>
 
 #include <chainparams.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
 #include <serialize.h>
 #include <streams.h>
 #include <hash.h>
 #include <util/system.h>
+#include <util/time.h>
+#include <util/trace.h>
 #include <script/interpreter.h>
 #include <script/script.h>
 #include <policy/policy.h>
@@ -21,6 +25,8 @@
 #include <node/transaction.h>
 #include <validation.h>
 
+#include <deque>
+
 /* Calculate the difficulty for a given block index.
  * Duplicated from rpc/blockchain.cpp for linking
  */
@@ -46,34 +52,153 @@ static double GetDifficulty(const CBlockIndex* blockindex)
     return dDiff;
 }
 
-double GetPoSKernelPS(CBlockIndex *pindex)
+namespace {
+/** Number of stake intervals GetPoSKernelPS averages over */
+constexpr size_t POS_KERNELPS_INTERVAL = 72;
+
+struct StakeSample {
+    uint256 hash;
+    int height;
+    double kernels;
+    int64_t time;
+};
+
+/**
+ * The most recent proof-of-stake blocks of the active chain, updated as tips connect and
+ * disconnect so polling the network weight at the tip doesn't walk the block index.
+ */
+class StakeWindow
 {
-    LOCK(cs_main);
+public:
+    void Reset()
+    {
+        m_samples.clear();
+        m_kernels_sum = 0.0;
+        m_tip.SetNull();
+        m_complete = false;
+    }
 
-    CBlockIndex *pindexPrevStake = nullptr;
+    bool IsTip(const CBlockIndex *pindex) const { return !m_tip.IsNull() && m_tip == pindex->GetBlockHash(); }
 
-    int nBestHeight = pindex->nHeight;
+    void Rebuild(const CBlockIndex *pindex)
+    {
+        Reset();
+        m_tip = pindex->GetBlockHash();
+        const CBlockIndex *pindex_front = pindex;
+        while (pindex_front && m_samples.size() <= POS_KERNELPS_INTERVAL) {
+            if (pindex_front->IsProofOfStake()) {
+                PushFront(pindex_front);
+            }
+            pindex_front = pindex_front->pprev;
+        }
+        m_complete = m_samples.size() > POS_KERNELPS_INTERVAL || !pindex_front;
+    }
+
+    void ConnectTip(const CBlockIndex *pindex)
+    {
+        if (!pindex->pprev || !IsTip(pindex->pprev)) {
+            // Refilled from the new tip on the next query
+            Reset();
+        }
+        m_tip = pindex->GetBlockHash();
+        if (!pindex->IsProofOfStake()) {
+            return;
+        }
+        if (!m_samples.empty()) {
+            m_kernels_sum += KernelsTried(pindex);
+        }
+        m_samples.push_back({pindex->GetBlockHash(), pindex->nHeight, KernelsTried(pindex), pindex->nTime});
+        while (m_samples.size() > POS_KERNELPS_INTERVAL + 1) {
+            m_samples.pop_front();
+            m_kernels_sum -= m_samples.front().kernels;
+        }
+    }
 
-    int nPoSInterval = 72; // blocks sampled
-    double dStakeKernelsTriedAvg = 0;
-    int nStakesHandled = 0, nStakesTime = 0;
+    void DisconnectTip(const CBlockIndex *pindex)
+    {
+        if (!IsTip(pindex)) {
+            Reset();
+        }
+        m_tip = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+        if (!m_samples.empty() && m_samples.back().hash == pindex->GetBlockHash()) {
+            double kernels = m_samples.back().kernels;
+            m_samples.pop_back();
+            if (!m_samples.empty()) {
+                m_kernels_sum -= kernels;
+            }
+            m_complete = false;
+        }
+    }
 
-    while (pindex && nStakesHandled < nPoSInterval) {
-        if (pindex->IsProofOfStake()) {
-            if (pindexPrevStake) {
-                dStakeKernelsTriedAvg += GetDifficulty(pindexPrevStake) * 4294967296.0;
-                nStakesTime += pindexPrevStake->nTime - pindex->nTime;
-                nStakesHandled++;
+    /** Extend the window to the full interval after disconnects, pindex must be the tip */
+    void Refill(const CBlockIndex *pindex)
+    {
+        if (m_complete) {
+            return;
+        }
+        if (m_samples.empty()) {
+            Rebuild(pindex);
+            return;
+        }
+        const CBlockIndex *pindex_front = pindex->GetAncestor(m_samples.front().height);
+        if (!pindex_front || pindex_front->GetBlockHash() != m_samples.front().hash) {
+            Rebuild(pindex);
+            return;
+        }
+        pindex_front = pindex_front->pprev;
+        while (pindex_front && m_samples.size() <= POS_KERNELPS_INTERVAL) {
+            if (pindex_front->IsProofOfStake()) {
+                PushFront(pindex_front);
             }
-            pindexPrevStake = pindex;
+            pindex_front = pindex_front->pprev;
+        }
+        m_complete = m_samples.size() > POS_KERNELPS_INTERVAL || !pindex_front;
+    }
+
+    double GetKernelsPerSecond() const
+    {
+        if (m_samples.size() < 2) {
+            return 0.0;
         }
-        pindex = pindex->pprev;
+        int64_t nStakesTime = m_samples.back().time - m_samples.front().time;
+        return nStakesTime ? m_kernels_sum / nStakesTime : 0.0;
     }
 
+private:
+    static double KernelsTried(const CBlockIndex *pindex) { return GetDifficulty(pindex) * 4294967296.0; }
+
+    void PushFront(const CBlockIndex *pindex)
+    {
+        if (!m_samples.empty()) {
+            m_kernels_sum += m_samples.front().kernels;
+        }
+        m_samples.push_front({pindex->GetBlockHash(), pindex->nHeight, KernelsTried(pindex), pindex->nTime});
+    }
+
+    std::deque<StakeSample> m_samples; // oldest first
+    double m_kernels_sum = 0.0; // kernels tried over all samples but the oldest
+    uint256 m_tip;
+    bool m_complete = false;
+};
+
+StakeWindow g_stake_window GUARDED_BY(cs_main);
+} // namespace
+
+double GetPoSKernelPS(CBlockIndex *pindex)
+{
+    LOCK(cs_main);
+
+    int nBestHeight = pindex->nHeight;
     double result = 0;
 
-    if (nStakesTime) {
-        result = dStakeKernelsTriedAvg / nStakesTime;
+    if (g_stake_window.IsTip(pindex)) {
+        g_stake_window.Refill(pindex);
+        result = g_stake_window.GetKernelsPerSecond();
+    } else {
+        // Not the tip the window follows, walk back from pindex
+        StakeWindow window;
+        window.Rebuild(pindex);
+        result = window.GetKernelsPerSecond();
     }
 
     result *= Params().GetStakeTimestampMask(nBestHeight) + 1;
@@ -81,6 +206,18 @@ double GetPoSKernelPS(CBlockIndex *pindex)
     return result;
 }
 
+void PoSKernelPSConnectTip(const CBlockIndex *pindex)
+{
+    AssertLockHeld(cs_main);
+    g_stake_window.ConnectTip(pindex);
+}
+
+void PoSKernelPSDisconnectTip(const CBlockIndex *pindex)
+{
+    AssertLockHeld(cs_main);
+    g_stake_window.DisconnectTip(pindex);
+}
+
 /**
  * Stake Modifier (hash modifier of proof-of-stake):
  * The purpose of stake modifier is to prevent a txout (coin) owner from
@@ -186,6 +323,31 @@ bool CheckStakeKernelHash(const CBlockIndex *pindexPrev,
     return true;
 }
 
+void GetStakeKernelHashes(const uint256 &stake_modifier, uint32_t nBlockFromTime,
+    const COutPoint &prevout, const std::vector<int64_t> &times, std::vector<uint256> &hashes)
+{
+    // Preimage is modifier (32) | nBlockFromTime (4) | txid (32) | n (4) | nTime (4)
+    // The first 64 bytes don't depend on the time, their midstate is computed once
+    uint8_t prefix[64];
+    memcpy(prefix, stake_modifier.begin(), 32);
+    WriteLE32(prefix + 32, nBlockFromTime);
+    memcpy(prefix + 36, prevout.hash.begin(), 28);
+    CSHA256 midstate;
+    midstate.Write(prefix, sizeof(prefix));
+
+    uint8_t suffix[12];
+    memcpy(suffix, prevout.hash.begin() + 28, 4);
+    WriteLE32(suffix + 4, prevout.n);
+
+    hashes.resize(times.size());
+    for (size_t i = 0; i < times.size(); ++i) {
+        uint8_t inner[CSHA256::OUTPUT_SIZE];
+        WriteLE32(suffix + 8, (uint32_t)times[i]);
+        CSHA256(midstate).Write(suffix, sizeof(suffix)).Finalize(inner);
+        CSHA256().Write(inner, sizeof(inner)).Finalize(hashes[i].begin());
+    }
+}
+
 bool GetKernelInfo(const CBlockIndex *blockindex, const CTransaction &tx, uint256 &hash, CAmount &value, CScript &script, uint256 &blockhash)
 {
     if (!blockindex->pprev) {
@@ -220,8 +382,7 @@ bool GetKernelInfo(const CBlockIndex *blockindex, const CTransaction &tx, uint25
     return true;
 };
 
-// Check kernel hash target and coinstake signature
-bool CheckProofOfStake(CChainState &chain_state, BlockValidationState &state, const CBlockIndex *pindexPrev, const CTransaction &tx, int64_t nTime, unsigned int nBits, uint256 &hashProofOfStake, uint256 &targetProofOfStake)
+static bool CheckProofOfStakeInternal(CChainState &chain_state, BlockValidationState &state, const CBlockIndex *pindexPrev, const CTransaction &tx, int64_t nTime, unsigned int nBits, uint256 &hashProofOfStake, uint256 &targetProofOfStake)
 {
     // pindexPrev is the current tip, the block the new block will connect on to
     // nTime is the time of the new/next block
@@ -354,6 +515,20 @@ bool CheckProofOfStake(CChainState &chain_state, BlockValidationState &state, co
     return true;
 }
 
+// Check kernel hash target and coinstake signature
+bool CheckProofOfStake(CChainState &chain_state, BlockValidationState &state, const CBlockIndex *pindexPrev, const CTransaction &tx, int64_t nTime, unsigned int nBits, uint256 &hashProofOfStake, uint256 &targetProofOfStake)
+{
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
+    bool rv = CheckProofOfStakeInternal(chain_state, state, pindexPrev, tx, nTime, nBits, hashProofOfStake, targetProofOfStake);
+
+    TRACE4(staking, check_proof_of_stake,
+        tx.GetHash().data(),
+        pindexPrev ? pindexPrev->nHeight + 1 : -1,
+        rv,
+        GetTimeMicros() - start_us);
+    return rv;
+}
+
 
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(int nHeight, int64_t nTimeBlock)
@@ -400,3 +575,66 @@ bool CheckKernel(CChainState &chain_state, const CBlockIndex *pindexPrev, unsign
         amount, prevout, nTime, hashProofOfStake, targetProofOfStake);
 }
 
+
+void GetKernelCandidates(CChainState &chain_state, const CBlockIndex *pindexPrev, const std::vector<COutPoint> &prevouts, std::vector<StakeKernelCandidate> &candidates)
+{
+    int nRequiredDepth = std::min((int)(Params().GetStakeMinConfirmations()-1), (int)(pindexPrev->nHeight / 2));
+
+    candidates.clear();
+    candidates.resize(prevouts.size());
+
+    LOCK(::cs_main);
+    for (size_t i = 0; i < prevouts.size(); ++i) {
+        StakeKernelCandidate &candidate = candidates[i];
+        candidate.prevout = prevouts[i];
+
+        Coin coin;
+        if (!chain_state.CoinsTip().GetCoin(prevouts[i], coin) ||
+            coin.nType != OUTPUT_STANDARD || coin.IsSpent()) {
+            continue;
+        }
+        const CBlockIndex *pindex = chain_state.m_chain[coin.nHeight];
+        if (!pindex) {
+            continue;
+        }
+        if (nRequiredDepth > pindexPrev->nHeight - (int)coin.nHeight) {
+            continue;
+        }
+        candidate.amount = coin.out.nValue;
+        candidate.block_time = pindex->GetBlockTime();
+    }
+}
+
+size_t CheckKernelBatch(const CBlockIndex *pindexPrev, unsigned int nBits, const std::vector<StakeKernelCandidate> &candidates, const std::vector<int64_t> &times, std::vector<int64_t> &kernel_times)
+{
+    size_t num_found = 0;
+    kernel_times.assign(candidates.size(), 0);
+
+    arith_uint256 bnTargetPerCoin;
+    bool fNegative, fOverflow;
+    bnTargetPerCoin.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || bnTargetPerCoin == 0) {
+        return 0;
+    }
+
+    std::vector<uint256> hashes;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const StakeKernelCandidate &candidate = candidates[i];
+        if (candidate.amount <= 0) {
+            continue;
+        }
+        arith_uint256 bnTarget = bnTargetPerCoin * arith_uint256(candidate.amount);
+        GetStakeKernelHashes(pindexPrev->bnStakeModifier, candidate.block_time, candidate.prevout, times, hashes);
+        for (size_t k = 0; k < times.size(); ++k) {
+            if (times[k] < candidate.block_time) {
+                continue;
+            }
+            if (UintToArith256(hashes[k]) <= bnTarget) {
+                kernel_times[i] = times[k];
+                num_found++;
+                break;
+            }
+        }
+    }
+    return num_found;
+}
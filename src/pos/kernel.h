@@ -8,22 +8,26 @@
 #define PARTICL_POS_KERNEL_H
 
 #include <consensus/amount.h>
+#include <primitives/transaction.h>
 #include <sync.h>
 
+#include <vector>
+
 extern RecursiveMutex cs_main;
 
 class CScript;
 class uint256;
-class COutPoint;
 class CBlockIndex;
 class CChainState;
-class CTransaction;
 class BlockValidationState;
 
 
 static const int MAX_REORG_DEPTH = 1024;
 
 double GetPoSKernelPS(CBlockIndex *pindex);
+/** Keep the network stake weight window in step with the active chain tip */
+void PoSKernelPSConnectTip(const CBlockIndex *pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+void PoSKernelPSDisconnectTip(const CBlockIndex *pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 /**
  * Compute the hash modifier for proof-of-stake
@@ -40,6 +44,13 @@ bool CheckStakeKernelHash(const CBlockIndex *pindexPrev,
     uint256 &hashProofOfStake, uint256 &targetProofOfStake,
     bool fPrintProofOfStake=false);
 
+/**
+ * Compute the kernel hashes of one prevout for several timestamps
+ * Matches the hashProofOfStake of CheckStakeKernelHash() for each time
+ */
+void GetStakeKernelHashes(const uint256 &stake_modifier, uint32_t nBlockFromTime,
+    const COutPoint &prevout, const std::vector<int64_t> &times, std::vector<uint256> &hashes);
+
 /**
  * Get kernel hash and value for blockindex and coinstake tx
  */
@@ -63,4 +74,28 @@ bool CheckCoinStakeTimestamp(int nHeight, int64_t nTimeBlock);
  */
 bool CheckKernel(CChainState &chain_state, const CBlockIndex *pindexPrev, unsigned int nBits, int64_t nTime, const COutPoint &prevout, int64_t* pBlockTime = nullptr);
 
-#endif // PARTICL_POS_KERNEL_H
+/**
+ * Coin data needed to compute a stake kernel hash
+ * amount is 0 for coins that can't stake on the snapshot tip
+ */
+struct StakeKernelCandidate
+{
+    COutPoint prevout;
+    CAmount amount = 0;
+    uint32_t block_time = 0;
+};
+
+/**
+ * Snapshot the kernel data of prevouts under a single cs_main lock
+ * Applies the same existence and min depth checks as CheckKernel()
+ */
+void GetKernelCandidates(CChainState &chain_state, const CBlockIndex *pindexPrev, const std::vector<COutPoint> &prevouts, std::vector<StakeKernelCandidate> &candidates) LOCKS_EXCLUDED(cs_main);
+
+/**
+ * Check every candidate against every timestamp without taking locks
+ * kernel_times[i] is set to the first time candidate i meets the target, or 0
+ * Returns the number of candidates found
+ */
+size_t CheckKernelBatch(const CBlockIndex *pindexPrev, unsigned int nBits, const std::vector<StakeKernelCandidate> &candidates, const std::vector<int64_t> &times, std::vector<int64_t> &kernel_times);
+
+#endif // PARTICL_POS_KERNEL_H
\ No newline at end of file
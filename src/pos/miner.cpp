@@ -5,11 +5,13 @@
 #include <pos/miner.h>
 
 #include <pos/kernel.h>
+#include <pos/stakingperf.h>
 #include <node/miner.h>
 #include <chainparams.h>
 #include <util/thread.h>
 #include <util/syserror.h>
 #include <util/moneystr.h>
+#include <util/trace.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 
@@ -23,6 +25,8 @@
 #include <wallet/hdwallet.h>
 #include <wallet/spend.h>
 
+#include <condition_variable>
+#include <limits>
 #include <stdint.h>
 
 typedef CWallet* CWalletRef;
@@ -47,27 +51,34 @@ bool CheckStake(ChainstateManager &chainman, const CBlock *pblock)
     }
 
     if (!particl::CheckStakeUnique(*pblock, false)) { // Check in SignBlock also
+        g_staking_perf.stakes_rejected++;
         return error("%s: %s CheckStakeUnique failed.", __func__, hashBlock.GetHex());
     }
 
     // Verify hash target and signature of coinstake tx
     {
+        int64_t nLockStart = GetTimeMicros();
         LOCK(cs_main);
+        g_staking_perf.cs_main_wait.Add(GetTimeMicros() - nLockStart);
 
         node::BlockMap::const_iterator mi = chainman.BlockIndex().find(pblock->hashPrevBlock);
         if (mi == chainman.BlockIndex().end()) {
+            g_staking_perf.stakes_rejected++;
             return error("%s: %s prev block not found: %s.", __func__, hashBlock.GetHex(), pblock->hashPrevBlock.GetHex());
         }
 
         if (!chainman.ActiveChain().Contains(&mi->second)) {
+            g_staking_perf.stakes_stale++;
             return error("%s: %s prev block in active chain: %s.", __func__, hashBlock.GetHex(), pblock->hashPrevBlock.GetHex());
         }
 
         BlockValidationState state;
         if (!CheckProofOfStake(chainman.ActiveChainstate(), state, &mi->second, *pblock->vtx[0], pblock->nTime, pblock->nBits, proofHash, hashTarget)) {
+            g_staking_perf.stakes_rejected++;
             return error("%s: proof-of-stake checking failed.", __func__);
         }
         if (pblock->hashPrevBlock != chainman.ActiveChain().Tip()->GetBlockHash()) { // hashbestchain
+            g_staking_perf.stakes_stale++;
             return error("%s: Generated block is stale.", __func__);
         }
     }
@@ -81,8 +92,10 @@ bool CheckStake(ChainstateManager &chainman, const CBlock *pblock)
 
     std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
     if (!chainman.ProcessNewBlock(shared_pblock, true, nullptr)) {
+        g_staking_perf.stakes_rejected++;
         return error("%s: Block not accepted.", __func__);
     }
+    g_staking_perf.stakes_accepted++;
 
     return true;
 }
@@ -179,10 +192,23 @@ bool ImportOutputs(node::CBlockTemplate *pblocktemplate, int nHeight)
     return true;
 }
 
+/** Per wallet staking task, run on any thread of the staking pool */
+struct StakeTask
+{
+    std::shared_ptr<wallet::CWallet> wallet;
+    int64_t next_attempt_ms = 0;
+    bool running = false;
+};
+
+static Mutex cs_stake_tasks;
+static std::condition_variable cv_stake_tasks;
+static std::vector<StakeTask> vStakeTasks GUARDED_BY(cs_stake_tasks);
+
 void StartThreadStakeMiner(wallet::WalletContext &wallet_context, ChainstateManager &chainman)
 {
     nMinStakeInterval = gArgs.GetIntArg("-minstakeinterval", 0);
     nMinerSleep = gArgs.GetIntArg("-minersleep", 500);
+    fStopMinerProc = false;
 
     if (!gArgs.GetBoolArg("-staking", true)) {
         LogPrintf("Staking disabled\n");
@@ -193,21 +219,27 @@ void StartThreadStakeMiner(wallet::WalletContext &wallet_context, ChainstateMana
         if (nWallets < 1) {
             return;
         }
-        size_t nThreads = std::min(nWallets, (size_t)gArgs.GetIntArg("-stakingthreads", 1));
+        int64_t nThreadsArg = gArgs.GetIntArg("-stakingthreads", DEFAULT_STAKING_THREADS);
+        size_t nThreads = nThreadsArg > 0 ? nThreadsArg : std::max(GetNumCores(), 1);
+        nThreads = std::min(nWallets, nThreads);
 
-        size_t nPerThread = nWallets / nThreads;
+        {
+            LOCK(cs_stake_tasks);
+            vStakeTasks.clear();
+            for (size_t i = 0; i < nWallets; ++i) {
+                GetParticlWallet(vpwallets[i].get())->nStakeThread = i;
+                StakeTask task;
+                task.wallet = vpwallets[i];
+                vStakeTasks.push_back(task);
+            }
+        }
         for (size_t i = 0; i < nThreads; ++i) {
-            size_t nStart = nPerThread * i;
-            size_t nEnd = (i == nThreads-1) ? nWallets : nPerThread * (i+1);
             StakeThread *t = new StakeThread();
             vStakeThreads.push_back(t);
-            GetParticlWallet(vpwallets[i].get())->nStakeThread = i;
             t->sName = strprintf("miner%d", i);
-            t->thread = std::thread(&util::TraceThread, t->sName.c_str(), std::function<void()>(std::bind(&ThreadStakeMiner, i, vpwallets, nStart, nEnd, &chainman)));
+            t->thread = std::thread(&util::TraceThread, t->sName.c_str(), std::function<void()>(std::bind(&ThreadStakeMiner, i, &chainman)));
         }
     }
-
-    fStopMinerProc = false;
 }
 
 void StopThreadStakeMiner()
@@ -217,7 +249,11 @@ void StopThreadStakeMiner()
         return;
     }
     LogPrint(BCLog::POS, "StopThreadStakeMiner\n");
-    fStopMinerProc = true;
+    {
+        LOCK(cs_stake_tasks);
+        fStopMinerProc = true;
+    }
+    cv_stake_tasks.notify_all();
 
     for (auto t : vStakeThreads) {
         t->m_thread_interrupt();
@@ -225,6 +261,9 @@ void StopThreadStakeMiner()
         delete t;
     }
     vStakeThreads.clear();
+
+    LOCK(cs_stake_tasks);
+    vStakeTasks.clear();
 }
 
 void WakeThreadStakeMiner(CHDWallet *pwallet)
@@ -233,14 +272,21 @@ void WakeThreadStakeMiner(CHDWallet *pwallet)
     {
     LOCK(pwallet->cs_wallet);
     nStakeThread = pwallet->nStakeThread;
-    if (nStakeThread >= vStakeThreads.size() || pwallet->IsScanning()) {
+    if (vStakeThreads.empty() || pwallet->IsScanning()) {
         return;
     }
     pwallet->nLastCoinStakeSearchTime = 0;
-    LogPrint(BCLog::POS, "WakeThreadStakeMiner: wallet %s, thread %d\n", pwallet->GetName(), nStakeThread);
+    LogPrint(BCLog::POS, "WakeThreadStakeMiner: wallet %s, task %d\n", pwallet->GetName(), nStakeThread);
     }
-    StakeThread *t = vStakeThreads[nStakeThread];
-    t->m_thread_interrupt();
+    {
+        LOCK(cs_stake_tasks);
+        if (nStakeThread >= vStakeTasks.size() ||
+            vStakeTasks[nStakeThread].wallet.get() != pwallet) {
+            return;
+        }
+        vStakeTasks[nStakeThread].next_attempt_ms = 0;
+    }
+    cv_stake_tasks.notify_one();
 }
 
 void WakeAllThreadStakeMiner()
@@ -249,6 +295,13 @@ void WakeAllThreadStakeMiner()
     for (auto t : vStakeThreads) {
         t->m_thread_interrupt();
     }
+    {
+        LOCK(cs_stake_tasks);
+        for (auto &task : vStakeTasks) {
+            task.next_attempt_ms = 0;
+        }
+    }
+    cv_stake_tasks.notify_all();
 }
 
 bool ThreadStakeMinerStopped()
@@ -264,14 +317,163 @@ static inline void condWaitFor(size_t nThreadID, int ms)
     t->m_thread_interrupt.sleep_for(std::chrono::milliseconds(ms));
 }
 
-void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<wallet::CWallet>> &vpwallets, size_t nStart, size_t nEnd, ChainstateManager *chainman)
+/**
+ * Claim the wallet whose next stake attempt is due soonest
+ * Waits for at most max_wait_ms and returns false if no task became due
+ */
+static bool ClaimStakeTask(size_t &nTask, int64_t max_wait_ms)
 {
-    LogPrintf("Starting staking thread %d, %d wallet%s.\n", nThreadID, nEnd - nStart, (nEnd - nStart) > 1 ? "s" : "");
+    WAIT_LOCK(cs_stake_tasks, lock);
+    if (fStopMinerProc) {
+        return false;
+    }
+    size_t nBest = vStakeTasks.size();
+    for (size_t i = 0; i < vStakeTasks.size(); ++i) {
+        if (vStakeTasks[i].running) {
+            continue;
+        }
+        if (nBest == vStakeTasks.size() || vStakeTasks[i].next_attempt_ms < vStakeTasks[nBest].next_attempt_ms) {
+            nBest = i;
+        }
+    }
+    int64_t nNow = GetTimeMillis();
+    if (nBest == vStakeTasks.size() ||
+        vStakeTasks[nBest].next_attempt_ms > nNow) {
+        int64_t nWait = max_wait_ms;
+        if (nBest < vStakeTasks.size()) {
+            nWait = std::min(nWait, vStakeTasks[nBest].next_attempt_ms - nNow);
+        }
+        cv_stake_tasks.wait_for(lock, std::chrono::milliseconds(nWait));
+        return false;
+    }
+    vStakeTasks[nBest].running = true;
+    vStakeTasks[nBest].next_attempt_ms = std::numeric_limits<int64_t>::max();
+    nTask = nBest;
+    return true;
+}
 
-    int nBestHeight; // TODO: set from new block signal?
-    int64_t nBestTime;
+static void ReleaseStakeTask(size_t nTask, size_t nWaitFor)
+{
+    {
+        LOCK(cs_stake_tasks);
+        if (nTask >= vStakeTasks.size()) {
+            return;
+        }
+        StakeTask &task = vStakeTasks[nTask];
+        task.running = false;
+        // Left at 0 if the wallet was woken during the attempt
+        if (task.next_attempt_ms != 0) {
+            task.next_attempt_ms = GetTimeMillis() + nWaitFor;
+        }
+    }
+    cv_stake_tasks.notify_one();
+}
 
+/**
+ * Run one stake attempt for pwallet
+ * Returns the number of milliseconds until the wallet should be tried again
+ */
+static size_t TryToStakeWallet(CHDWallet *pwallet, ChainstateManager *chainman, int nBestHeight, int64_t nSearchTime, size_t stake_thread_cond_delay_ms)
+{
     int nLastImportHeight = Params().GetLastImportHeight();
+    CAmount reserve_balance;
+
+    if (!pwallet->fStakingEnabled) {
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_DISABLED;
+        return stake_thread_cond_delay_ms;
+    }
+
+    {
+    int64_t nLockStart = GetTimeMicros();
+    LOCK(pwallet->cs_wallet);
+    g_staking_perf.cs_wallet_wait.Add(GetTimeMicros() - nLockStart);
+    if (nSearchTime <= pwallet->nLastCoinStakeSearchTime) {
+        return std::min(stake_thread_cond_delay_ms, (size_t)nMinerSleep);
+    }
+
+    if (pwallet->nStakeLimitHeight && nBestHeight >= pwallet->nStakeLimitHeight) {
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_LIMITED;
+        return std::min(stake_thread_cond_delay_ms, (size_t)30000);
+    }
+
+    if (pwallet->IsLocked()) {
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_LOCKED;
+        return std::min(stake_thread_cond_delay_ms, (size_t)30000);
+    }
+    reserve_balance = pwallet->nReserveBalance;
+    }
+    CAmount balance = pwallet->GetSpendableBalance();
+
+    if (balance <= reserve_balance) {
+        LOCK(pwallet->cs_wallet);
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_BALANCE;
+        pwallet->nLastCoinStakeSearchTime = nSearchTime + stake_thread_cond_delay_ms / 1000;
+        LogPrint(BCLog::POS, "%s: %s, low balance.\n", __func__, pwallet->GetName());
+        return std::min(stake_thread_cond_delay_ms, (size_t)60000);
+    }
+
+    // Sleep until the next slot a kernel is known to exist, instead of building a block every tick
+    int64_t nNextKernelTime = pwallet->GetNextStakeKernelTime(nSearchTime, nBestHeight + 1);
+    if (nNextKernelTime > nSearchTime) {
+        LOCK(pwallet->cs_wallet);
+        pwallet->m_is_staking = CHDWallet::IS_STAKING;
+        pwallet->nLastCoinStakeSearchTime = nSearchTime;
+        fIsStaking = true;
+        int64_t nWaitMs = nNextKernelTime * 1000 - (GetTimeMillis() + GetTimeOffset() * 1000);
+        return std::min(stake_thread_cond_delay_ms, (size_t)std::max(nWaitMs, (int64_t)0));
+    }
+
+    std::unique_ptr<node::CBlockTemplate> pblocktemplate = pwallet->CreateNewBlock();
+    if (!pblocktemplate.get()) {
+        fIsStaking = false;
+        LogPrint(BCLog::POS, "%s: Couldn't create new block.\n", __func__);
+        return std::min(stake_thread_cond_delay_ms, (size_t)nMinerSleep);
+    }
+
+    if (nBestHeight + 1 <= nLastImportHeight &&
+        !ImportOutputs(pblocktemplate.get(), nBestHeight + 1)) {
+        fIsStaking = false;
+        LogPrint(BCLog::POS, "%s: ImportOutputs failed.\n", __func__);
+        return std::min(stake_thread_cond_delay_ms, (size_t)30000);
+    }
+    pwallet->m_is_staking = CHDWallet::IS_STAKING;
+
+    size_t nWaitFor = nMinerSleep;
+    fIsStaking = true;
+    if (pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime)) {
+        CBlock *pblock = &pblocktemplate->block;
+        g_staking_perf.stakes_found++;
+        bool accepted = CheckStake(*chainman, pblock);
+        int64_t nLatency = GetTimeMicros() - pwallet->m_kernel_found_us;
+        if (accepted) {
+            nTimeLastStake = GetTime();
+            g_staking_perf.kernel_to_broadcast.Add(nLatency);
+        }
+        TRACE4(staking, stake_submitted,
+            pwallet->GetName().c_str(),
+            pblock->GetHash().data(),
+            accepted,
+            nLatency);
+    } else {
+        int nRequiredDepth = std::min((int)(Params().GetStakeMinConfirmations() - 1), (int)(nBestHeight / 2));
+        LOCK(pwallet->cs_wallet);
+        if (pwallet->m_greatest_txn_depth < nRequiredDepth - 4) {
+            pwallet->m_is_staking = CHDWallet::NOT_STAKING_DEPTH;
+            size_t nSleep = (nRequiredDepth - pwallet->m_greatest_txn_depth) / 4;
+            nWaitFor = std::min(nWaitFor, (size_t)(nSleep * 1000));
+            pwallet->nLastCoinStakeSearchTime = nSearchTime + nSleep;
+            LogPrint(BCLog::POS, "%s: %s, no outputs with required depth. Sleeping for %ds.\n", __func__, pwallet->GetName(), nSleep);
+        }
+    }
+    return nWaitFor;
+}
+
+void ThreadStakeMiner(size_t nThreadID, ChainstateManager *chainman)
+{
+    LogPrintf("Starting staking thread %d.\n", nThreadID);
+
+    int nBestHeight; // TODO: set from new block signal?
+    int64_t nBestTime;
 
     if (!gArgs.GetBoolArg("-staking", true)) {
         LogPrint(BCLog::POS, "%s: -staking is false.\n", __func__);
@@ -292,7 +494,9 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<wallet::CWal
 
         int num_blocks_of_peers, num_nodes;
         {
+            int64_t nLockStart = GetTimeMicros();
             LOCK(cs_main);
+            g_staking_perf.cs_main_wait.Add(GetTimeMicros() - nLockStart);
             nBestHeight = chainman->ActiveChain().Height();
             nBestTime = chainman->ActiveChain().Tip()->nTime;
             num_blocks_of_peers = particl::GetNumBlocksOfPeers();
@@ -345,91 +549,17 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<wallet::CWal
             continue;
         }
 
-        std::unique_ptr<node::CBlockTemplate> pblocktemplate;
-
-        size_t nWaitFor = stake_thread_cond_delay_ms;
-        CAmount reserve_balance;
-
-        for (size_t i = nStart; i < nEnd; ++i) {
-            auto pwallet = GetParticlWallet(vpwallets[i].get());
-
-            if (!pwallet->fStakingEnabled) {
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_DISABLED;
-                continue;
-            }
-
-            {
-            LOCK(pwallet->cs_wallet);
-            if (nSearchTime <= pwallet->nLastCoinStakeSearchTime) {
-                nWaitFor = std::min(nWaitFor, (size_t)nMinerSleep);
-                continue;
-            }
-
-            if (pwallet->nStakeLimitHeight && nBestHeight >= pwallet->nStakeLimitHeight) {
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_LIMITED;
-                nWaitFor = std::min(nWaitFor, (size_t)30000);
-                continue;
-            }
-
-            if (pwallet->IsLocked()) {
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_LOCKED;
-                nWaitFor = std::min(nWaitFor, (size_t)30000);
-                continue;
-            }
-            reserve_balance = pwallet->nReserveBalance;
-            }
-            CAmount balance = pwallet->GetSpendableBalance();
-
-            if (balance <= reserve_balance) {
-                LOCK(pwallet->cs_wallet);
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_BALANCE;
-                nWaitFor = std::min(nWaitFor, (size_t)60000);
-                pwallet->nLastCoinStakeSearchTime = nSearchTime + stake_thread_cond_delay_ms / 1000;
-                LogPrint(BCLog::POS, "%s: %s, low balance.\n", __func__, pwallet->GetName());
-                continue;
-            }
-
-            if (!pblocktemplate.get()) {
-                pblocktemplate = pwallet->CreateNewBlock();
-                if (!pblocktemplate.get()) {
-                    fIsStaking = false;
-                    nWaitFor = std::min(nWaitFor, (size_t)nMinerSleep);
-                    LogPrint(BCLog::POS, "%s: Couldn't create new block.\n", __func__);
-                    continue;
-                }
-
-                if (nBestHeight + 1 <= nLastImportHeight &&
-                    !ImportOutputs(pblocktemplate.get(), nBestHeight + 1)) {
-                    fIsStaking = false;
-                    nWaitFor = std::min(nWaitFor, (size_t)30000);
-                    LogPrint(BCLog::POS, "%s: ImportOutputs failed.\n", __func__);
-                    continue;
-                }
-            }
-            pwallet->m_is_staking = CHDWallet::IS_STAKING;
-
-            nWaitFor = nMinerSleep;
-            fIsStaking = true;
-            if (pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime)) {
-                CBlock *pblock = &pblocktemplate->block;
-                if (CheckStake(*chainman, pblock)) {
-                     nTimeLastStake = GetTime();
-                     break;
-                }
-            } else {
-                int nRequiredDepth = std::min((int)(Params().GetStakeMinConfirmations() - 1), (int)(nBestHeight / 2));
-                LOCK(pwallet->cs_wallet);
-                if (pwallet->m_greatest_txn_depth < nRequiredDepth - 4) {
-                    pwallet->m_is_staking = CHDWallet::NOT_STAKING_DEPTH;
-                    size_t nSleep = (nRequiredDepth - pwallet->m_greatest_txn_depth) / 4;
-                    nWaitFor = std::min(nWaitFor, (size_t)(nSleep * 1000));
-                    pwallet->nLastCoinStakeSearchTime = nSearchTime + nSleep;
-                    LogPrint(BCLog::POS, "%s: %s, no outputs with required depth. Sleeping for %ds.\n", __func__, pwallet->GetName(), nSleep);
-                    continue;
-                }
-            }
+        // Any idle thread takes the next due wallet, so one slow wallet can't hold up the rest
+        size_t nTask;
+        if (!ClaimStakeTask(nTask, nMinerSleep)) {
+            continue;
         }
-
-        condWaitFor(nThreadID, nWaitFor);
+        std::shared_ptr<wallet::CWallet> pwallet;
+        {
+            LOCK(cs_stake_tasks);
+            pwallet = vStakeTasks[nTask].wallet;
+        }
+        size_t nWaitFor = TryToStakeWallet(GetParticlWallet(pwallet.get()), chainman, nBestHeight, nSearchTime, stake_thread_cond_delay_ms);
+        ReleaseStakeTask(nTask, nWaitFor);
     }
 }
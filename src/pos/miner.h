@@ -34,6 +34,9 @@ extern std::vector<StakeThread*> vStakeThreads;
 
 extern std::atomic<bool> fIsStaking;
 
+//! -stakingthreads default, 0 to use one thread per core
+static const int DEFAULT_STAKING_THREADS = 0;
+
 extern int nMinStakeInterval;
 extern int nMinerSleep;
 
@@ -49,6 +52,6 @@ void WakeThreadStakeMiner(CHDWallet *pwallet);
 void WakeAllThreadStakeMiner();
 bool ThreadStakeMinerStopped();
 
-void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<wallet::CWallet>> &vpwallets, size_t nStart, size_t nEnd, ChainstateManager *chainman);
+void ThreadStakeMiner(size_t nThreadID, ChainstateManager *chainman);
 
 #endif // PARTICL_POS_MINER_H
@@ -0,0 +1,85 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pos/stakingperf.h>
+
+#include <util/time.h>
+#include <util/trace.h>
+
+StakingPerf g_staking_perf;
+
+void StakingPerfHistogram::Add(int64_t micros)
+{
+    uint64_t v = micros > 0 ? micros : 0;
+    size_t n = 0;
+    while (n < NUM_BUCKETS - 1 && (v >> n) != 0) {
+        n++;
+    }
+    m_buckets[n].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum_us.fetch_add(v, std::memory_order_relaxed);
+    uint64_t max_us = m_max_us.load(std::memory_order_relaxed);
+    while (v > max_us && !m_max_us.compare_exchange_weak(max_us, v, std::memory_order_relaxed)) {
+    }
+}
+
+StakingPerfHistogram::Snapshot StakingPerfHistogram::GetSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.count = m_count.load(std::memory_order_relaxed);
+    snapshot.sum_us = m_sum_us.load(std::memory_order_relaxed);
+    snapshot.max_us = m_max_us.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+void StakingPerfHistogram::Reset()
+{
+    m_count = 0;
+    m_sum_us = 0;
+    m_max_us = 0;
+    for (auto &b : m_buckets) {
+        b = 0;
+    }
+}
+
+void StakingPerf::NotifyTip()
+{
+    tip_arrival_us = GetTimeMicros();
+}
+
+void StakingPerf::RecordKernelSearch(const char *wallet_name, uint64_t n_kernels, int64_t start_us)
+{
+    int64_t now_us = GetTimeMicros();
+    int64_t tip_us = tip_arrival_us.exchange(0);
+    if (tip_us != 0) {
+        tip_to_kernel_check.Add(start_us - tip_us);
+    }
+    kernel_search.Add(now_us - start_us);
+    kernels_evaluated += n_kernels;
+    kernel_search_us += now_us - start_us;
+
+    TRACE3(staking, kernel_search,
+        wallet_name,
+        n_kernels,
+        now_us - start_us);
+}
+
+void StakingPerf::Reset()
+{
+    tip_to_kernel_check.Reset();
+    kernel_to_broadcast.Reset();
+    kernel_search.Reset();
+    cs_main_wait.Reset();
+    cs_wallet_wait.Reset();
+    kernels_evaluated = 0;
+    kernel_search_us = 0;
+    stakes_found = 0;
+    stakes_accepted = 0;
+    stakes_stale = 0;
+    stakes_rejected = 0;
+    stakes_orphaned = 0;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_POS_STAKINGPERF_H
+#define PARTICL_POS_STAKINGPERF_H
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Latency histogram, bucket i counts samples below 2^i microseconds.
+ * The last bucket also holds all larger samples.
+ */
+class StakingPerfHistogram
+{
+public:
+    static constexpr size_t NUM_BUCKETS = 28;
+
+    struct Snapshot {
+        uint64_t count{0};
+        uint64_t sum_us{0};
+        uint64_t max_us{0};
+        std::array<uint64_t, NUM_BUCKETS> buckets{};
+    };
+
+    void Add(int64_t micros);
+    Snapshot GetSnapshot() const;
+    void Reset();
+
+private:
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_sum_us{0};
+    std::atomic<uint64_t> m_max_us{0};
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> m_buckets{};
+};
+
+/** Counters shared by all staking threads, reported by getstakingperf */
+struct StakingPerf
+{
+    /** Tip notification to the first kernel search against the new tip */
+    StakingPerfHistogram tip_to_kernel_check;
+    /** Kernel found in CreateCoinStake to the block being accepted by CheckStake */
+    StakingPerfHistogram kernel_to_broadcast;
+    /** Duration of each kernel search */
+    StakingPerfHistogram kernel_search;
+    StakingPerfHistogram cs_main_wait;
+    StakingPerfHistogram cs_wallet_wait;
+
+    std::atomic<uint64_t> kernels_evaluated{0};
+    std::atomic<uint64_t> kernel_search_us{0};
+    std::atomic<uint64_t> stakes_found{0};
+    std::atomic<uint64_t> stakes_accepted{0};
+    /** Tip moved before the staked block was submitted */
+    std::atomic<uint64_t> stakes_stale{0};
+    std::atomic<uint64_t> stakes_rejected{0};
+    /** Accepted stakes later disconnected from the chain */
+    std::atomic<uint64_t> stakes_orphaned{0};
+
+    /** Set when the tip changes, cleared by the next kernel search */
+    std::atomic<int64_t> tip_arrival_us{0};
+
+    void NotifyTip();
+    /** Record a search over n_kernels kernels started at start_us */
+    void RecordKernelSearch(const char *wallet_name, uint64_t n_kernels, int64_t start_us);
+    void Reset();
+};
+
+extern StakingPerf g_staking_perf;
+
+#endif // PARTICL_POS_STAKINGPERF_H
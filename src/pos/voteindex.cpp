@@ -0,0 +1,122 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pos/voteindex.h>
+
+#include <chain.h>
+#include <compat/endian.h>
+#include <node/blockstorage.h>
+#include <primitives/block.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <string.h>
+
+VoteIndex g_vote_index;
+
+bool GetBlockVoteToken(const CBlock &block, uint32_t &vote_token)
+{
+    vote_token = 0;
+    if (block.vtx.size() < 1
+        || !block.vtx[0]->IsCoinStake()
+        || block.vtx[0]->vpout.size() < 1
+        || !block.vtx[0]->vpout[0]->IsType(OUTPUT_DATA)) {
+        return false;
+    }
+
+    const std::vector<uint8_t> &vData = ((CTxOutData*)block.vtx[0]->vpout[0].get())->vData;
+    if (vData.size() < 9 || vData[4] != DO_VOTE) {
+        return true;
+    }
+    memcpy(&vote_token, &vData[5], 4);
+    vote_token = le32toh(vote_token);
+    return true;
+}
+
+void VoteIndex::Rewind(int height)
+{
+    AssertLockHeld(m_mutex);
+    m_counted.resize(std::max(height + 1, 0));
+    for (auto it = m_votes.begin(); it != m_votes.end(); ) {
+        auto &v = it->second;
+        while (!v.empty() && v.back().first > height) {
+            v.pop_back();
+        }
+        if (v.empty()) {
+            it = m_votes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void VoteIndex::Append(const CBlockIndex *pindex, const Consensus::Params &consensus_params)
+{
+    AssertLockHeld(m_mutex);
+    int counted = m_counted.empty() ? 0 : m_counted.back();
+
+    CBlock block;
+    uint32_t vote_token;
+    if (node::ReadBlockFromDisk(block, pindex, consensus_params) &&
+        GetBlockVoteToken(block, vote_token)) {
+        counted++;
+        int option = (vote_token >> 16) & 0xFFFF;
+        if (option != 0) {
+            m_votes[vote_token & 0xFFFF].emplace_back(pindex->nHeight, option);
+        }
+    }
+    m_counted.push_back(counted);
+}
+
+void VoteIndex::Sync(ChainstateManager &chainman, const Consensus::Params &consensus_params)
+{
+    LOCK(m_mutex);
+    const CBlockIndex *tip, *fork;
+    {
+        LOCK(cs_main);
+        tip = chainman.ActiveChain().Tip();
+        fork = m_tip ? chainman.ActiveChain().FindFork(m_tip) : nullptr;
+    }
+    if (tip == m_tip) {
+        return;
+    }
+
+    Rewind(fork ? fork->nHeight : -1);
+
+    std::vector<const CBlockIndex*> connect;
+    for (const CBlockIndex *pindex = tip; pindex && pindex != fork; pindex = pindex->pprev) {
+        connect.push_back(pindex);
+    }
+    for (auto it = connect.rbegin(); it != connect.rend(); ++it) {
+        Append(*it, consensus_params);
+    }
+    m_tip = tip;
+}
+
+VoteIndex::Tally VoteIndex::TallyVotes(int proposal, int height_start, int height_end) const
+{
+    LOCK(m_mutex);
+    Tally tally;
+    height_start = std::max(height_start, 0);
+    height_end = std::min(height_end, (int)m_counted.size() - 1);
+    if (height_start > height_end) {
+        return tally;
+    }
+    tally.blocks_counted = m_counted[height_end] - (height_start > 0 ? m_counted[height_start - 1] : 0);
+
+    int abstain = tally.blocks_counted;
+    const auto mi = m_votes.find(proposal);
+    if (mi != m_votes.end()) {
+        const auto &v = mi->second;
+        auto it = std::lower_bound(v.begin(), v.end(), std::make_pair(height_start, 0));
+        for (; it != v.end() && it->first <= height_end; ++it) {
+            tally.votes[it->second]++;
+            abstain--;
+        }
+    }
+    if (abstain > 0) {
+        tally.votes[0] = abstain;
+    }
+    return tally;
+}
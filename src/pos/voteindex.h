@@ -0,0 +1,58 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_POS_VOTEINDEX_H
+#define PARTICL_POS_VOTEINDEX_H
+
+#include <sync.h>
+
+#include <map>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class ChainstateManager;
+namespace Consensus {
+struct Params;
+}
+
+/** Extract the vote token from the coinstake of block, false if the block has no coinstake */
+bool GetBlockVoteToken(const CBlock &block, uint32_t &vote_token);
+
+/**
+ * In memory index of the votes in the coinstakes of the active chain.
+ * Blocks are read from disk once, later syncs only connect and disconnect
+ * the blocks that changed since the indexed tip.
+ */
+class VoteIndex
+{
+public:
+    struct Tally {
+        int blocks_counted{0};
+        /** Votes per option, option 0 is abstain and includes votes for other proposals */
+        std::map<int, int> votes;
+    };
+
+    /** Bring the index up to the active chain tip */
+    void Sync(ChainstateManager &chainman, const Consensus::Params &consensus_params) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex, !::cs_main);
+    /** Count the votes for proposal in the indexed blocks from height_start to height_end inclusive */
+    Tally TallyVotes(int proposal, int height_start, int height_end) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    void Rewind(int height) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    void Append(const CBlockIndex *pindex, const Consensus::Params &consensus_params) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    const CBlockIndex *m_tip GUARDED_BY(m_mutex){nullptr};
+    /** Number of blocks with a coinstake at or below each height */
+    std::vector<int> m_counted GUARDED_BY(m_mutex);
+    /** Heights and options of the votes cast for each proposal, ascending by height, abstain votes are not stored */
+    std::map<int, std::vector<std::pair<int, int>>> m_votes GUARDED_BY(m_mutex);
+};
+
+extern VoteIndex g_vote_index;
+
+#endif // PARTICL_POS_VOTEINDEX_H
@@ -9,6 +9,7 @@
 #include <hash.h>
 #include <tinyformat.h>
 #include <util/strencodings.h>
+#include <algorithm>
 #include <assert.h>
 
 bool ExtractCoinStakeInt64(const std::vector<uint8_t> &vData, DataOutputTypes get_type, CAmount &out)
@@ -181,6 +182,63 @@ CTxOutStandard::CTxOutStandard(const CAmount& nValueIn, CScript scriptPubKeyIn)
     scriptPubKey = scriptPubKeyIn;
 }
 
+CTxOutArena::CTxOutArena(size_t num_outputs) : m_outputs_left(num_outputs)
+{
+    m_outputs.reserve(std::min(num_outputs, MAX_CHUNK_OUTPUTS));
+}
+
+CTxOutArena::~CTxOutArena()
+{
+    for (auto *output : m_outputs) {
+        if (output) {
+            output->~CTxOutBase();
+        }
+    }
+}
+
+static constexpr size_t ArenaSlotSize(size_t size)
+{
+    return (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+}
+
+void *CTxOutArena::Allocate(size_t size)
+{
+    size = ArenaSlotSize(size);
+    if (m_chunk_used + size > m_chunk_size) {
+        // Most outputs are plain, the first chunk is sized for them.
+        // Later chunks are only needed for blinded outputs and fit any type.
+        size_t max_size = std::max({sizeof(CTxOutStandard), sizeof(CTxOutCT), sizeof(CTxOutRingCT), sizeof(CTxOutData)});
+        size_t slot_size = ArenaSlotSize(m_chunks.empty() ? sizeof(CTxOutStandard) : max_size);
+        size_t num_slots = std::min(std::max(m_outputs_left, size_t{1}), MAX_CHUNK_OUTPUTS);
+        m_chunk_size = std::max(num_slots * slot_size, size);
+        m_chunks.emplace_back(new std::byte[m_chunk_size]);
+        m_chunk_used = 0;
+    }
+    void *p = m_chunks.back().get() + m_chunk_used;
+    m_chunk_used += size;
+    if (m_outputs_left > 0) {
+        m_outputs_left--;
+    }
+    return p;
+}
+
+CTxOutBaseRef MakeArenaOutput(const std::shared_ptr<CTxOutArena> &arena, uint8_t output_type)
+{
+    switch (output_type) {
+        case OUTPUT_STANDARD:
+            return CTxOutArena::MakeOutput<CTxOutStandard>(arena);
+        case OUTPUT_CT:
+            return CTxOutArena::MakeOutput<CTxOutCT>(arena);
+        case OUTPUT_RINGCT:
+            return CTxOutArena::MakeOutput<CTxOutRingCT>(arena);
+        case OUTPUT_DATA:
+            return CTxOutArena::MakeOutput<CTxOutData>(arena);
+        default:
+            break;
+    }
+    return nullptr;
+}
+
 void DeepCopy(CTxOutBaseRef &to, const CTxOutBaseRef &from)
 {
     switch (from->GetType()) {
@@ -210,8 +268,31 @@ std::vector<CTxOutBaseRef> DeepCopy(const std::vector<CTxOutBaseRef> &from)
 {
     std::vector<CTxOutBaseRef> vpout;
     vpout.resize(from.size());
+    std::shared_ptr<CTxOutArena> arena;
+    if (!from.empty()) {
+        arena = std::make_shared<CTxOutArena>(from.size());
+    }
     for (size_t i = 0; i < from.size(); ++i) {
-        DeepCopy(vpout[i], from[i]);
+        switch (from[i]->GetType()) {
+            case OUTPUT_STANDARD:
+                vpout[i] = CTxOutArena::MakeOutput<CTxOutStandard>(arena);
+                *((CTxOutStandard*)vpout[i].get()) = *((CTxOutStandard*)from[i].get());
+                break;
+            case OUTPUT_CT:
+                vpout[i] = CTxOutArena::MakeOutput<CTxOutCT>(arena);
+                *((CTxOutCT*)vpout[i].get()) = *((CTxOutCT*)from[i].get());
+                break;
+            case OUTPUT_RINGCT:
+                vpout[i] = CTxOutArena::MakeOutput<CTxOutRingCT>(arena);
+                *((CTxOutRingCT*)vpout[i].get()) = *((CTxOutRingCT*)from[i].get());
+                break;
+            case OUTPUT_DATA:
+                vpout[i] = CTxOutArena::MakeOutput<CTxOutData>(arena);
+                *((CTxOutData*)vpout[i].get()) = *((CTxOutData*)from[i].get());
+                break;
+            default:
+                break;
+        }
     }
 
     return vpout;
@@ -240,8 +321,25 @@ uint256 CTransaction::ComputeWitnessHash() const
     return SerializeHash(*this, SER_GETHASH, 0);
 }
 
-CTransaction::CTransaction(const CMutableTransaction& tx) : vin(tx.vin), vout(tx.vout), vpout{DeepCopy(tx.vpout)}, nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
-CTransaction::CTransaction(CMutableTransaction&& tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), vpout(std::move(tx.vpout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
+void CTransaction::ComputeHashes()
+{
+    if (!IsParticlVersion()) {
+        hash = ComputeHash();
+        m_witness_hash = ComputeWitnessHash();
+        return;
+    }
+    // The witness serialization only appends to the serialization without witness,
+    // the outputs and rangeproofs are hashed once and both hashes finish from the same state
+    CHashWriter ss(SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS);
+    SerializeTransaction(*this, ss);
+    CHashWriter ss_witness{ss};
+    hash = ss.GetHash();
+    SerializeParticlWitness(*this, ss_witness);
+    m_witness_hash = ss_witness.GetHash();
+}
+
+CTransaction::CTransaction(const CMutableTransaction& tx) : vin(tx.vin), vout(tx.vout), vpout{DeepCopy(tx.vpout)}, nVersion(tx.nVersion), nLockTime(tx.nLockTime) { ComputeHashes(); }
+CTransaction::CTransaction(CMutableTransaction&& tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), vpout(std::move(tx.vpout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime) { ComputeHashes(); }
 
 CAmount CTransaction::GetValueOut() const
 {
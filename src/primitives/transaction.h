@@ -16,6 +16,7 @@
 
 #include <secp256k1_rangeproof.h>
 
+#include <memory>
 #include <tuple>
 
 /**
@@ -62,6 +63,7 @@ enum DataOutputTypes
     DO_SMSG_FEE             = 9,
     DO_SMSG_DIFFICULTY      = 10,
     DO_MASK                 = 11,
+    DO_AGG_AMOUNT           = 12,
 };
 
 bool ExtractCoinStakeInt64(const std::vector<uint8_t> &vData, DataOutputTypes get_type, CAmount &out);
@@ -672,6 +674,53 @@ public:
     }
 };
 
+/**
+ * Owns the outputs of one transaction, packed into a few contiguous chunks instead of one allocation per output.
+ * Output refs share ownership of the arena through the aliasing shared_ptr constructor,
+ * the arena is freed when the last ref to any of its outputs is released.
+ */
+class CTxOutArena
+{
+public:
+    explicit CTxOutArena(size_t num_outputs);
+    ~CTxOutArena();
+    CTxOutArena(const CTxOutArena&) = delete;
+    CTxOutArena& operator=(const CTxOutArena&) = delete;
+
+    /** Construct an output of type T, num_outputs sizes the chunks but isn't a limit. */
+    template<typename T>
+    T *Emplace()
+    {
+        static_assert(std::is_base_of<CTxOutBase, T>::value, "Not an output type");
+        void *p = Allocate(sizeof(T));
+        m_outputs.emplace_back(nullptr);
+        T *output = new (p) T();
+        m_outputs.back() = output;
+        return output;
+    }
+
+    /** Construct an output of type T and return a ref sharing ownership of the arena. */
+    template<typename T>
+    static CTxOutBaseRef MakeOutput(const std::shared_ptr<CTxOutArena> &arena)
+    {
+        return CTxOutBaseRef(arena, arena->Emplace<T>());
+    }
+
+private:
+    void *Allocate(size_t size);
+
+    //! Bounds the up front allocation for an untrusted output count
+    static constexpr size_t MAX_CHUNK_OUTPUTS = 256;
+
+    std::vector<std::unique_ptr<std::byte[]>> m_chunks;
+    size_t m_chunk_size = 0;
+    size_t m_chunk_used = 0;
+    size_t m_outputs_left;
+    std::vector<CTxOutBase*> m_outputs;
+};
+
+/** Construct an output of the type given by output_type in arena, returns null for an unknown type. */
+CTxOutBaseRef MakeArenaOutput(const std::shared_ptr<CTxOutArena> &arena, uint8_t output_type);
 
 struct CMutableTransaction;
 
@@ -714,24 +763,17 @@ inline void UnserializeTransaction(TxType& tx, Stream& s) {
         size_t nOutputs = ReadCompactSize(s);
         tx.vpout.clear();
         tx.vpout.reserve(nOutputs);
+        std::shared_ptr<CTxOutArena> arena;
+        if (nOutputs > 0) {
+            arena = std::make_shared<CTxOutArena>(nOutputs);
+        }
         for (size_t k = 0; k < nOutputs; ++k) {
             s >> bv;
-            switch (bv) {
-                case OUTPUT_STANDARD:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>());
-                    break;
-                case OUTPUT_CT:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutCT>());
-                    break;
-                case OUTPUT_RINGCT:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutRingCT>());
-                    break;
-                case OUTPUT_DATA:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutData>());
-                    break;
-                default:
-                    throw std::ios_base::failure("Unknown transaction output type");
+            CTxOutBaseRef txout = MakeArenaOutput(arena, bv);
+            if (!txout) {
+                throw std::ios_base::failure("Unknown transaction output type");
             }
+            tx.vpout.push_back(std::move(txout));
             tx.vpout[k]->nVersion = bv;
             s >> *tx.vpout[k];
         }
@@ -785,6 +827,14 @@ inline void UnserializeTransaction(TxType& tx, Stream& s) {
     s >> tx.nLockTime;
 }
 
+/** The witness data, appended to the serialization of a Particl transaction without witness */
+template<typename Stream, typename TxType>
+inline void SerializeParticlWitness(const TxType& tx, Stream& s) {
+    for (auto &txin : tx.vin) {
+        s << txin.scriptWitness.stack;
+    }
+}
+
 template<typename Stream, typename TxType>
 inline void SerializeTransaction(const TxType& tx, Stream& s) {
     const bool fAllowWitness = !(s.GetVersion() & SERIALIZE_TRANSACTION_NO_WITNESS);
@@ -806,9 +856,7 @@ inline void SerializeTransaction(const TxType& tx, Stream& s) {
         }
 
         if (fAllowWitness) {
-            for (auto &txin : tx.vin) {
-                s << txin.scriptWitness.stack;
-            }
+            SerializeParticlWitness(tx, s);
         }
         return;
     }
@@ -862,12 +910,14 @@ public:
     const uint32_t nLockTime;
 
 private:
-    /** Memory only. */
-    const uint256 hash;
-    const uint256 m_witness_hash;
+    /** Memory only. Set once by the constructors, through ComputeHashes. */
+    uint256 hash;
+    uint256 m_witness_hash;
 
     uint256 ComputeHash() const;
     uint256 ComputeWitnessHash() const;
+    /** Particl txns are serialized once for both hashes */
+    void ComputeHashes();
 
 public:
     /** Convert a CMutableTransaction into a CTransaction. */
@@ -86,6 +86,7 @@ static void RegisterMetaTypes()
     qRegisterMetaType<SynchronizationState>();
   #ifdef ENABLE_WALLET
     qRegisterMetaType<WalletModel*>();
+    qRegisterMetaType<interfaces::WalletTxChanges>("interfaces::WalletTxChanges");
   #endif
     // Register typedefs (see https://doc.qt.io/qt-5/qmetatype.html#qRegisterMetaType)
     // IMPORTANT: if CAmount is no longer a typedef use the normal variant above (see https://doc.qt.io/qt-5/qmetatype.html#qRegisterMetaType-1)
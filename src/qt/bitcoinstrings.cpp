@@ -156,6 +156,9 @@ QT_TRANSLATE_NOOP("bitcoin-core", ""
 "You need to rebuild the database using -reindex to change -balancesindex.  "
 "This will redownload the entire blockchain"),
 QT_TRANSLATE_NOOP("bitcoin-core", ""
+"You need to rebuild the database using -reindex to change -blockrewardindex.  "
+"This will redownload the entire blockchain"),
+QT_TRANSLATE_NOOP("bitcoin-core", ""
 "You need to rebuild the database using -reindex to change -spentindex.  This "
 "will redownload the entire blockchain"),
 QT_TRANSLATE_NOOP("bitcoin-core", ""
@@ -31,6 +31,7 @@
 #include <QFlags>
 #include <QIcon>
 #include <QSettings>
+#include <QSignalBlocker>
 #include <QTreeWidget>
 
 using wallet::CCoinControl;
@@ -90,15 +91,12 @@ CoinControlDialog::CoinControlDialog(CCoinControl& coin_control, WalletModel* _m
     ui->labelCoinControlLowOutput->addAction(clipboardLowOutputAction);
     ui->labelCoinControlChange->addAction(clipboardChangeAction);
 
-    // toggle tree/list mode
-    connect(ui->radioTreeMode, &QRadioButton::toggled, this, &CoinControlDialog::radioTreeMode);
-    connect(ui->radioListMode, &QRadioButton::toggled, this, &CoinControlDialog::radioListMode);
-
-    connect(ui->cbxType, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &CoinControlDialog::cbxTypeChanged);
-
     // click on checkbox
     connect(ui->treeWidget, &QTreeWidget::itemChanged, this, &CoinControlDialog::viewItemChanged);
 
+    // outputs of an address are added when first expanded
+    connect(ui->treeWidget, &QTreeWidget::itemExpanded, this, &CoinControlDialog::viewItemExpanded);
+
     // click on header
     ui->treeWidget->header()->setSectionsClickable(true);
     connect(ui->treeWidget->header(), &QHeaderView::sectionClicked, this, &CoinControlDialog::headerSectionClicked);
@@ -134,10 +132,17 @@ CoinControlDialog::CoinControlDialog(CCoinControl& coin_control, WalletModel* _m
         ui->cbxType->setCurrentIndex(2);
     }
 
+    // toggle tree/list mode, connected after restoring the settings so the view is built once
+    connect(ui->radioTreeMode, &QRadioButton::toggled, this, &CoinControlDialog::radioTreeMode);
+    connect(ui->radioListMode, &QRadioButton::toggled, this, &CoinControlDialog::radioListMode);
+
+    connect(ui->cbxType, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &CoinControlDialog::cbxTypeChanged);
+
     GUIUtil::handleCloseWindowShortcut(this);
 
     if(_model->getOptionsModel() && _model->getAddressTableModel())
     {
+        loadCoins();
         updateView();
         updateLabelLocked();
         CoinControlDialog::updateLabels(m_coin_control, _model, this);
@@ -260,6 +265,7 @@ void CoinControlDialog::lockCoin()
 
     COutPoint outpt(uint256S(contextMenuItem->data(COLUMN_ADDRESS, TxHashRole).toString().toStdString()), contextMenuItem->data(COLUMN_ADDRESS, VOutRole).toUInt());
     model->wallet().lockCoin(outpt, /* write_to_db = */ true);
+    m_locked_coins.insert(outpt);
     contextMenuItem->setDisabled(true);
     contextMenuItem->setIcon(COLUMN_CHECKBOX, platformStyle->SingleColorIcon(":/icons/lock_closed"));
     updateLabelLocked();
@@ -270,6 +276,7 @@ void CoinControlDialog::unlockCoin()
 {
     COutPoint outpt(uint256S(contextMenuItem->data(COLUMN_ADDRESS, TxHashRole).toString().toStdString()), contextMenuItem->data(COLUMN_ADDRESS, VOutRole).toUInt());
     model->wallet().unlockCoin(outpt);
+    m_locked_coins.erase(outpt);
     contextMenuItem->setDisabled(false);
     contextMenuItem->setIcon(COLUMN_CHECKBOX, QIcon());
     updateLabelLocked();
@@ -367,6 +374,7 @@ void CoinControlDialog::cbxTypeChanged(int index)
         m_coin_control.nCoinType = index+1;
         m_coin_control.UnSelectAll();
         CoinControlDialog::updateLabels(m_coin_control, model, this);
+        loadCoins();
         updateView();
     }
 }
@@ -389,6 +397,29 @@ void CoinControlDialog::viewItemChanged(QTreeWidgetItem* item, int column)
         if (ui->treeWidget->isEnabled()) // do not update on every click for (un)select all
             CoinControlDialog::updateLabels(m_coin_control, model, this);
     }
+    else if (column == COLUMN_CHECKBOX && item->childCount() == 0 && item->data(COLUMN_ADDRESS, GroupRole).isValid())
+    {
+        // address in tree mode that was not expanded yet, (un)select its outputs directly
+        Qt::CheckState state = item->checkState(COLUMN_CHECKBOX);
+        if (state == Qt::PartiallyChecked)
+            return;
+        for (const auto& outpair : m_groups[item->data(COLUMN_ADDRESS, GroupRole).toUInt()]->second) {
+            const COutPoint& output = std::get<0>(outpair);
+            if (state == Qt::Unchecked)
+                m_coin_control.UnSelect(output);
+            else if (!m_locked_coins.count(output))
+                m_coin_control.Select(output);
+        }
+
+        if (ui->treeWidget->isEnabled())
+            CoinControlDialog::updateLabels(m_coin_control, model, this);
+    }
+}
+
+void CoinControlDialog::viewItemExpanded(QTreeWidgetItem* item)
+{
+    if (item->childCount() == 0 && item->data(COLUMN_ADDRESS, GroupRole).isValid())
+        populateGroup(item);
 }
 
 // shows count of locked unspent outputs
@@ -438,11 +469,11 @@ void CoinControlDialog::updateLabels(CCoinControl& m_coin_control, WalletModel *
 
     size_t i = 0;
     for (const auto& out : model->wallet().getCoins(vCoinControl)) {
+        const COutPoint& outpt = vCoinControl[i++];
         if (out.depth_in_main_chain < 0) continue;
 
         // unselect already spent, very unlikely scenario, this could happen
         // when selected are spent elsewhere, like rpc or another computer
-        const COutPoint& outpt = vCoinControl[i++];
         if (out.is_spent)
         {
             m_coin_control.UnSelect(outpt);
@@ -598,6 +629,110 @@ void CoinControlDialog::changeEvent(QEvent* e)
     QDialog::changeEvent(e);
 }
 
+void CoinControlDialog::loadCoins()
+{
+    QString sType = ui->cbxType->currentText().toLower();
+    m_coins = model->wallet().listCoins(
+        sType == "anon" ? OUTPUT_RINGCT : sType == "blind" ? OUTPUT_CT : OUTPUT_STANDARD);
+
+    std::vector<COutPoint> vOutpts;
+    model->wallet().listLockedCoins(vOutpts);
+    m_locked_coins = std::set<COutPoint>(vOutpts.begin(), vOutpts.end());
+    m_labels.clear();
+}
+
+QString CoinControlDialog::labelForAddress(const QString& address)
+{
+    auto it = m_labels.find(address);
+    if (it == m_labels.end())
+        it = m_labels.insert(address, model->getAddressTableModel()->labelForAddress(address));
+    return it.value();
+}
+
+void CoinControlDialog::addOutputItem(QTreeWidgetItem* parent, const COutPoint& output, const interfaces::WalletTxOut& out,
+                                      const QString& sWalletAddress, const QString& sWalletLabel)
+{
+    BitcoinUnit nDisplayUnit = model->getOptionsModel()->getDisplayUnit();
+    bool treeMode = parent != nullptr;
+
+    CCoinControlWidgetItem *itemOutput;
+    if (treeMode)    itemOutput = new CCoinControlWidgetItem(parent);
+    else             itemOutput = new CCoinControlWidgetItem(ui->treeWidget);
+    itemOutput->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+    itemOutput->setCheckState(COLUMN_CHECKBOX,Qt::Unchecked);
+
+    // address
+    CTxDestination outputAddress;
+    QString sAddress = "";
+    if(ExtractDestination(out.txout.scriptPubKey, outputAddress))
+    {
+        sAddress = QString::fromStdString(EncodeDestination(outputAddress));
+
+        // if listMode or change => show bitcoin address. In tree mode, address is not shown again for direct wallet address outputs
+        if (!treeMode || (!(sAddress == sWalletAddress)))
+            itemOutput->setText(COLUMN_ADDRESS, sAddress);
+    }
+
+    // label
+    if (!(sAddress == sWalletAddress)) // change
+    {
+        // tooltip from where the change comes from
+        itemOutput->setToolTip(COLUMN_LABEL, tr("change from %1 (%2)").arg(sWalletLabel).arg(sWalletAddress));
+        itemOutput->setText(COLUMN_LABEL, tr("(change)"));
+    }
+    else if (!treeMode)
+    {
+        QString sLabel = labelForAddress(sAddress);
+        if (sLabel.isEmpty())
+            sLabel = tr("(no label)");
+        itemOutput->setText(COLUMN_LABEL, sLabel);
+    }
+
+    // amount
+    itemOutput->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, out.txout.nValue));
+    itemOutput->setData(COLUMN_AMOUNT, Qt::UserRole, QVariant((qlonglong)out.txout.nValue)); // padding so that sorting works correctly
+
+    // date
+    itemOutput->setText(COLUMN_DATE, GUIUtil::dateTimeStr(out.time));
+    itemOutput->setData(COLUMN_DATE, Qt::UserRole, QVariant((qlonglong)out.time));
+
+    // confirmations
+    itemOutput->setText(COLUMN_CONFIRMATIONS, QString::number(out.depth_in_main_chain));
+    itemOutput->setData(COLUMN_CONFIRMATIONS, Qt::UserRole, QVariant((qlonglong)out.depth_in_main_chain));
+
+    // transaction hash
+    itemOutput->setData(COLUMN_ADDRESS, TxHashRole, QString::fromStdString(output.hash.GetHex()));
+
+    // vout index
+    itemOutput->setData(COLUMN_ADDRESS, VOutRole, output.n);
+
+     // disable locked coins
+    if (m_locked_coins.count(output))
+    {
+        m_coin_control.UnSelect(output); // just to be sure
+        itemOutput->setDisabled(true);
+        itemOutput->setIcon(COLUMN_CHECKBOX, platformStyle->SingleColorIcon(":/icons/lock_closed"));
+    };
+
+    // set checkbox
+    if (m_coin_control.IsSelected(output))
+        itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
+}
+
+void CoinControlDialog::populateGroup(QTreeWidgetItem* item)
+{
+    const auto& coins = *m_groups[item->data(COLUMN_ADDRESS, GroupRole).toUInt()];
+    QString sWalletAddress = item->text(COLUMN_ADDRESS);
+    QString sWalletLabel = item->text(COLUMN_LABEL);
+
+    // The selection is already in m_coin_control, don't handle the check states as clicks
+    const QSignalBlocker blocker(ui->treeWidget);
+    for (const auto& outpair : coins.second) {
+        addOutputItem(item, std::get<0>(outpair), std::get<1>(outpair), sWalletAddress, sWalletLabel);
+    }
+    item->sortChildren(sortColumn, sortOrder);
+}
+
 void CoinControlDialog::updateView()
 {
     if (!model || !model->getOptionsModel() || !model->getAddressTableModel())
@@ -606,120 +741,63 @@ void CoinControlDialog::updateView()
     bool treeMode = ui->radioTreeMode->isChecked();
 
     ui->treeWidget->clear();
+    m_groups.clear();
     ui->treeWidget->setEnabled(false); // performance, otherwise updateLabels would be called for every checked checkbox
     ui->treeWidget->setAlternatingRowColors(!treeMode);
-    QFlags<Qt::ItemFlag> flgCheckbox = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
     QFlags<Qt::ItemFlag> flgTristate = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable | Qt::ItemIsAutoTristate;
 
     BitcoinUnit nDisplayUnit = model->getOptionsModel()->getDisplayUnit();
 
-    QString sType = ui->cbxType->currentText().toLower();
-
-    for (const auto& coins : model->wallet().listCoins(
-        sType == "anon" ? OUTPUT_RINGCT : sType == "blind" ? OUTPUT_CT : OUTPUT_STANDARD)) {
-
-        CCoinControlWidgetItem* itemWalletAddress{nullptr};
+    for (auto it = m_coins.cbegin(); it != m_coins.cend(); ++it) {
+        const auto& coins = *it;
         QString sWalletAddress = QString::fromStdString(EncodeDestination(coins.first));
-        QString sWalletLabel = model->getAddressTableModel()->labelForAddress(sWalletAddress);
+        QString sWalletLabel = labelForAddress(sWalletAddress);
         if (sWalletLabel.isEmpty())
             sWalletLabel = tr("(no label)");
 
-        if (treeMode)
+        if (!treeMode)
         {
-            // wallet address
-            itemWalletAddress = new CCoinControlWidgetItem(ui->treeWidget);
+            for (const auto& outpair : coins.second) {
+                addOutputItem(nullptr, std::get<0>(outpair), std::get<1>(outpair), sWalletAddress, sWalletLabel);
+            }
+            continue;
+        }
 
-            itemWalletAddress->setFlags(flgTristate);
-            itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
+        // wallet address, the outputs are added when the item is expanded
+        CCoinControlWidgetItem* itemWalletAddress = new CCoinControlWidgetItem(ui->treeWidget);
+        itemWalletAddress->setFlags(flgTristate);
+        itemWalletAddress->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+        itemWalletAddress->setData(COLUMN_ADDRESS, GroupRole, (uint)m_groups.size());
+        m_groups.push_back(it);
 
-            // label
-            itemWalletAddress->setText(COLUMN_LABEL, sWalletLabel);
+        // label
+        itemWalletAddress->setText(COLUMN_LABEL, sWalletLabel);
 
-            // address
-            itemWalletAddress->setText(COLUMN_ADDRESS, sWalletAddress);
-        }
+        // address
+        itemWalletAddress->setText(COLUMN_ADDRESS, sWalletAddress);
 
         CAmount nSum = 0;
-        int nChildren = 0;
+        int nChildren = 0, nSelected = 0, nSelectable = 0;
         for (const auto& outpair : coins.second) {
             const COutPoint& output = std::get<0>(outpair);
-            const interfaces::WalletTxOut& out = std::get<1>(outpair);
-            nSum += out.txout.nValue;
-
+            nSum += std::get<1>(outpair).txout.nValue;
             nChildren++;
-
-            CCoinControlWidgetItem *itemOutput;
-            if (treeMode)    itemOutput = new CCoinControlWidgetItem(itemWalletAddress);
-            else             itemOutput = new CCoinControlWidgetItem(ui->treeWidget);
-            itemOutput->setFlags(flgCheckbox);
-            itemOutput->setCheckState(COLUMN_CHECKBOX,Qt::Unchecked);
-
-            // address
-            CTxDestination outputAddress;
-            QString sAddress = "";
-            if(ExtractDestination(out.txout.scriptPubKey, outputAddress))
-            {
-                sAddress = QString::fromStdString(EncodeDestination(outputAddress));
-
-                // if listMode or change => show bitcoin address. In tree mode, address is not shown again for direct wallet address outputs
-                if (!treeMode || (!(sAddress == sWalletAddress)))
-                    itemOutput->setText(COLUMN_ADDRESS, sAddress);
-            }
-
-            // label
-            if (!(sAddress == sWalletAddress)) // change
-            {
-                // tooltip from where the change comes from
-                itemOutput->setToolTip(COLUMN_LABEL, tr("change from %1 (%2)").arg(sWalletLabel).arg(sWalletAddress));
-                itemOutput->setText(COLUMN_LABEL, tr("(change)"));
-            }
-            else if (!treeMode)
-            {
-                QString sLabel = model->getAddressTableModel()->labelForAddress(sAddress);
-                if (sLabel.isEmpty())
-                    sLabel = tr("(no label)");
-                itemOutput->setText(COLUMN_LABEL, sLabel);
-            }
-
-            // amount
-            itemOutput->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, out.txout.nValue));
-            itemOutput->setData(COLUMN_AMOUNT, Qt::UserRole, QVariant((qlonglong)out.txout.nValue)); // padding so that sorting works correctly
-
-            // date
-            itemOutput->setText(COLUMN_DATE, GUIUtil::dateTimeStr(out.time));
-            itemOutput->setData(COLUMN_DATE, Qt::UserRole, QVariant((qlonglong)out.time));
-
-            // confirmations
-            itemOutput->setText(COLUMN_CONFIRMATIONS, QString::number(out.depth_in_main_chain));
-            itemOutput->setData(COLUMN_CONFIRMATIONS, Qt::UserRole, QVariant((qlonglong)out.depth_in_main_chain));
-
-            // transaction hash
-            itemOutput->setData(COLUMN_ADDRESS, TxHashRole, QString::fromStdString(output.hash.GetHex()));
-
-            // vout index
-            itemOutput->setData(COLUMN_ADDRESS, VOutRole, output.n);
-
-             // disable locked coins
-            if (model->wallet().isLockedCoin(output))
-            {
+            if (m_locked_coins.count(output)) {
                 m_coin_control.UnSelect(output); // just to be sure
-                itemOutput->setDisabled(true);
-                itemOutput->setIcon(COLUMN_CHECKBOX, platformStyle->SingleColorIcon(":/icons/lock_closed"));
-            };
-
-            // set checkbox
+                continue;
+            }
+            nSelectable++;
             if (m_coin_control.IsSelected(output))
-                itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
+                nSelected++;
         }
+        itemWalletAddress->setCheckState(COLUMN_CHECKBOX, nSelected == 0 ? Qt::Unchecked :
+                                         nSelected == nSelectable && nSelectable == nChildren ? Qt::Checked : Qt::PartiallyChecked);
 
         // amount
-        if (treeMode)
-        {
-            itemWalletAddress->setText(COLUMN_CHECKBOX, "(" + QString::number(nChildren) + ")");
-            itemWalletAddress->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, nSum));
-            itemWalletAddress->setData(COLUMN_AMOUNT, Qt::UserRole, QVariant((qlonglong)nSum));
-            itemWalletAddress->setTextAlignment(COLUMN_AMOUNT, Qt::AlignRight);
-        }
+        itemWalletAddress->setText(COLUMN_CHECKBOX, "(" + QString::number(nChildren) + ")");
+        itemWalletAddress->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, nSum));
+        itemWalletAddress->setData(COLUMN_AMOUNT, Qt::UserRole, QVariant((qlonglong)nSum));
+        itemWalletAddress->setTextAlignment(COLUMN_AMOUNT, Qt::AlignRight);
     }
 
 
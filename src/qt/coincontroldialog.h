@@ -6,10 +6,16 @@
 #define BITCOIN_QT_COINCONTROLDIALOG_H
 
 #include <consensus/amount.h>
+#include <interfaces/wallet.h>
+#include <primitives/transaction.h>
+
+#include <set>
+#include <vector>
 
 #include <QAbstractButton>
 #include <QAction>
 #include <QDialog>
+#include <QHash>
 #include <QList>
 #include <QMenu>
 #include <QPoint>
@@ -71,8 +77,21 @@ private:
 
     const PlatformStyle *platformStyle;
 
+    /** Spendable outputs of the selected type by address, tree items are built from these */
+    interfaces::Wallet::CoinsList m_coins;
+    /** Groups of m_coins in the order of the tree mode items, see GroupRole */
+    std::vector<interfaces::Wallet::CoinsList::const_iterator> m_groups;
+    std::set<COutPoint> m_locked_coins;
+    /** Address book labels, looked up when first displayed */
+    QHash<QString, QString> m_labels;
+
     void sortView(int, Qt::SortOrder);
+    void loadCoins();
     void updateView();
+    QString labelForAddress(const QString& address);
+    void addOutputItem(QTreeWidgetItem* parent, const COutPoint& output, const interfaces::WalletTxOut& out,
+                       const QString& sWalletAddress, const QString& sWalletLabel);
+    void populateGroup(QTreeWidgetItem* item);
 
     enum
     {
@@ -87,7 +106,8 @@ private:
     enum
     {
         TxHashRole = Qt::UserRole,
-        VOutRole
+        VOutRole,
+        GroupRole
     };
 
     friend class CCoinControlWidgetItem;
@@ -111,6 +131,7 @@ private Q_SLOTS:
     void radioListMode(bool);
     void cbxTypeChanged(int);
     void viewItemChanged(QTreeWidgetItem*, int);
+    void viewItemExpanded(QTreeWidgetItem*);
     void headerSectionClicked(int);
     void buttonBoxClicked(QAbstractButton*);
     void buttonSelectAllClicked();
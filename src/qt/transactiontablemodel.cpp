@@ -31,6 +31,9 @@
 #include <QList>
 
 
+// Number of wallet txns decomposed into records per fetchMore, newest first
+static const size_t TRANSACTION_PAGE_SIZE = 1000;
+
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
         Qt::AlignLeft|Qt::AlignVCenter, /*status=*/
@@ -102,32 +105,90 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
+    /* Txids of the wallet txns not yet in cachedWallet, newest first.
+     * Pages are decomposed as the view scrolls down, see fetchMore.
+     */
+    std::vector<uint256> m_pending_hashes;
+    size_t m_pending_pos = 0;
+
     /** True when model finishes loading all wallet transactions on start */
     bool m_loaded = false;
     /** True when transactions are being notified, for instance when scanning */
     bool m_loading = false;
     std::vector< TransactionNotification > vQueueNotifications;
 
-    void NotifyTransactionChanged(const uint256 &hash, ChangeType status);
+    void NotifyTransactionsChanged(const interfaces::WalletTxChanges &changes);
     void DispatchNotifications();
 
-    /* Query entire wallet anew from core.
+    /* Query the txids of the entire wallet anew from core, only the newest page is decomposed.
      */
     void refreshWallet(interfaces::Wallet& wallet)
     {
-        assert(!m_loaded);
-        {
-            for (const auto& wtx : wallet.getWalletTxs()) {
-                if (TransactionRecord::showTransaction()) {
-                    if (!show_zero_value_coinstakes && wtx.is_coinstake && wtx.credit == wtx.debit) {
-                        continue;
-                    }
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wtx));
-                }
+        cachedWallet.clear();
+        m_pending_hashes = wallet.getWalletTxHashes();
+        m_pending_pos = 0;
+        fetchMore(wallet, /*notify=*/false);
+        if (!m_loaded) {
+            m_loaded = true;
+            DispatchNotifications();
+        }
+    }
+
+    bool canFetchMore() const
+    {
+        return m_pending_pos < m_pending_hashes.size();
+    }
+
+    /* Decompose the next page of txns into cachedWallet.
+       Txns already in the model, e.g. through updateWallet, are skipped.
+     */
+    void fetchMore(interfaces::Wallet& wallet, bool notify)
+    {
+        size_t page_end = std::min(m_pending_hashes.size(), m_pending_pos + TRANSACTION_PAGE_SIZE);
+        std::vector<uint256> txids(m_pending_hashes.begin() + m_pending_pos, m_pending_hashes.begin() + page_end);
+        m_pending_pos = page_end;
+        if (!canFetchMore()) {
+            std::vector<uint256>().swap(m_pending_hashes);
+            m_pending_pos = 0;
+        }
+
+        QList<TransactionRecord> to_insert;
+        for (const auto& wtx : wallet.getWalletTxs(txids)) {
+            if (!TransactionRecord::showTransaction()) {
+                continue;
+            }
+            if (!show_zero_value_coinstakes && wtx.is_coinstake && wtx.credit == wtx.debit) {
+                continue;
             }
+            QList<TransactionRecord> records = TransactionRecord::decomposeTransaction(wtx);
+            if (records.isEmpty() ||
+                std::binary_search(cachedWallet.begin(), cachedWallet.end(), records[0].hash, TxLessThan())) {
+                continue;
+            }
+            to_insert.append(records);
+        }
+        std::stable_sort(to_insert.begin(), to_insert.end(), TxLessThan());
+
+        // Insert runs of records which fall between the same rows
+        int i = 0;
+        while (i < to_insert.size()) {
+            int pos = std::lower_bound(cachedWallet.begin(), cachedWallet.end(), to_insert[i].hash, TxLessThan()) - cachedWallet.begin();
+            int run_end = i + 1;
+            while (run_end < to_insert.size() &&
+                   (pos == cachedWallet.size() || to_insert[run_end].hash < cachedWallet[pos].hash)) {
+                run_end++;
+            }
+            if (notify) {
+                parent->beginInsertRows(QModelIndex(), pos, pos + run_end - i - 1);
+            }
+            for (int k = i; k < run_end; ++k) {
+                cachedWallet.insert(pos + k - i, to_insert[k]);
+            }
+            if (notify) {
+                parent->endInsertRows();
+            }
+            i = run_end;
         }
-        m_loaded = true;
-        DispatchNotifications();
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -242,6 +303,26 @@ public:
         return cachedWallet.size();
     }
 
+    /* Ranges of rows with a status that can change when blocks come in.
+       Rows which were never displayed or filtered are updated when first read.
+     */
+    std::vector<std::pair<int, int>> unsettledRanges() const
+    {
+        std::vector<std::pair<int, int>> ranges;
+        for (int i = 0; i < cachedWallet.size(); ++i) {
+            const TransactionStatus &status = cachedWallet[i].status;
+            if (status.m_cur_block_hash.IsNull() || (status.status == TransactionStatus::Confirmed && !status.needsUpdate)) {
+                continue;
+            }
+            if (!ranges.empty() && ranges.back().second == i - 1) {
+                ranges.back().second = i;
+            } else {
+                ranges.emplace_back(i, i);
+            }
+        }
+        return ranges;
+    }
+
     TransactionRecord* index(interfaces::Wallet& wallet, const uint256& cur_block_hash, const int idx)
     {
         if (idx >= 0 && idx < cachedWallet.size()) {
@@ -315,14 +396,28 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
     priv->updateWallet(walletModel->wallet(), updated, status, showTransaction);
 }
 
+void TransactionTableModel::updateTransactions(const interfaces::WalletTxChanges &changes, bool showTransaction)
+{
+    // As when a queue is dispatched, only the last 10 txns of a large batch show balloons
+    bool processing_queued = fProcessingQueuedTransactions;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        fProcessingQueuedTransactions = processing_queued || changes.size() - i > 10;
+        priv->updateWallet(walletModel->wallet(), changes[i].first, changes[i].second, showTransaction);
+    }
+    fProcessingQueuedTransactions = processing_queued;
+}
+
 void TransactionTableModel::updateConfirmations()
 {
     // Blocks came in since last poll.
     // Invalidate status (number of confirmations) and (possibly) description
-    //  for all rows. Qt is smart enough to only actually request the data for the
-    //  visible rows.
-    Q_EMIT dataChanged(index(0, Status), index(priv->size()-1, Status));
-    Q_EMIT dataChanged(index(0, ToAddress), index(priv->size()-1, ToAddress));
+    //  for the rows which are not yet confirmed. Signalling every row makes the
+    //  filter proxy read the status of every row from the wallet. Confirmed rows
+    //  update their number of confirmations when next read.
+    for (const auto& range : priv->unsettledRanges()) {
+        Q_EMIT dataChanged(index(range.first, Status), index(range.second, Status));
+        Q_EMIT dataChanged(index(range.first, ToAddress), index(range.second, ToAddress));
+    }
 }
 
 int TransactionTableModel::rowCount(const QModelIndex &parent) const
@@ -333,6 +428,29 @@ int TransactionTableModel::rowCount(const QModelIndex &parent) const
     return priv->size();
 }
 
+bool TransactionTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return false;
+    }
+    return priv->canFetchMore();
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid()) {
+        return;
+    }
+    priv->fetchMore(walletModel->wallet(), /*notify=*/true);
+}
+
+void TransactionTableModel::fetchAll()
+{
+    while (priv->canFetchMore()) {
+        priv->fetchMore(walletModel->wallet(), /*notify=*/true);
+    }
+}
+
 int TransactionTableModel::columnCount(const QModelIndex &parent) const
 {
     if (parent.isValid()) {
@@ -758,18 +876,21 @@ void TransactionTableModel::updateDisplayUnit()
     Q_EMIT dataChanged(index(0, Amount), index(priv->size()-1, Amount));
 }
 
-void TransactionTablePriv::NotifyTransactionChanged(const uint256 &hash, ChangeType status)
+void TransactionTablePriv::NotifyTransactionsChanged(const interfaces::WalletTxChanges &changes)
 {
     bool showTransaction = TransactionRecord::showTransaction();
 
-    TransactionNotification notification(hash, status, showTransaction);
-
     if (!m_loaded || m_loading)
     {
-        vQueueNotifications.push_back(notification);
+        for (const auto &change : changes) {
+            vQueueNotifications.emplace_back(change.first, change.second, showTransaction);
+        }
         return;
     }
-    notification.invoke(parent);
+    bool invoked = QMetaObject::invokeMethod(parent, "updateTransactions", Qt::QueuedConnection,
+                              Q_ARG(interfaces::WalletTxChanges, changes),
+                              Q_ARG(bool, showTransaction));
+    assert(invoked);
 }
 
 void TransactionTablePriv::DispatchNotifications()
@@ -795,7 +916,7 @@ void TransactionTablePriv::DispatchNotifications()
 void TransactionTableModel::subscribeToCoreSignals()
 {
     // Connect signals to wallet
-    m_handler_transaction_changed = walletModel->wallet().handleTransactionChanged(std::bind(&TransactionTablePriv::NotifyTransactionChanged, priv, std::placeholders::_1, std::placeholders::_2));
+    m_handler_transaction_changed = walletModel->wallet().handleTransactionsChanged(std::bind(&TransactionTablePriv::NotifyTransactionsChanged, priv, std::placeholders::_1));
     m_handler_show_progress = walletModel->wallet().handleShowProgress([this](const std::string&, int progress) {
         priv->m_loading = progress < 100;
         priv->DispatchNotifications();
@@ -6,6 +6,7 @@
 #define BITCOIN_QT_TRANSACTIONTABLEMODEL_H
 
 #include <qt/bitcoinunits.h>
+#include <interfaces/wallet.h>
 #include <primitives/transaction.h>
 
 #include <QAbstractTableModel>
@@ -13,10 +14,6 @@
 
 #include <memory>
 
-namespace interfaces {
-class Handler;
-}
-
 class PlatformStyle;
 class TransactionRecord;
 class TransactionTablePriv;
@@ -88,6 +85,11 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const override;
+    /** Wallet txns are decomposed a page at a time, newest first */
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    /** Decompose all remaining wallet txns, e.g. before exporting */
+    void fetchAll();
     bool processingQueuedTransactions() const { return fProcessingQueuedTransactions; }
 
 private:
@@ -117,6 +119,8 @@ private:
 public Q_SLOTS:
     /* New transaction, or transaction changed status */
     void updateTransaction(const QString &hash, int status, bool showTransaction);
+    /* Changes of a connected block or rescan chunk, applied in one pass */
+    void updateTransactions(const interfaces::WalletTxChanges &changes, bool showTransaction);
     void updateConfirmations();
     void updateDisplayUnit();
     /** Updates the column title to "Amount (DisplayUnit)" and emits headerDataChanged() signal for table headers to react. */
@@ -367,6 +367,9 @@ void TransactionView::exportClicked()
     if (filename.isNull())
         return;
 
+    // Rows are loaded as the view scrolls, export every transaction
+    model->getTransactionTableModel()->fetchAll();
+
     CSVModelWriter writer(filename);
 
     // name, column, role
@@ -51,5 +51,42 @@ public:
     }
 };
 
+class CKeyImageSpend
+{
+// Spent state of a key image, looked up in the chain then the mempool
+public:
+    enum State : uint8_t {
+        UNKNOWN     = 0,
+        IN_MEMPOOL  = 1,
+        IN_CHAIN    = 2,
+    };
+    uint8_t state = UNKNOWN;
+    uint256 txid;
+    int height = -1; // Set if IN_CHAIN, 0 if spent before the height was indexed
+};
+
+class CAnonKeyImageHeightKey
+{
+// Secondary key for key images, height is big endian to iterate in height order
+public:
+    CAnonKeyImageHeightKey() {};
+    CAnonKeyImageHeightKey(int height_, const CCmpPubKey &ki_) : height(height_), ki(ki_) {};
+    int height = 0;
+    CCmpPubKey ki;
+
+    template<typename Stream>
+    void Serialize(Stream &s) const
+    {
+        ser_writedata32be(s, (uint32_t)height);
+        s << ki;
+    }
+    template<typename Stream>
+    void Unserialize(Stream &s)
+    {
+        height = (int)ser_readdata32be(s);
+        s >> ki;
+    }
+};
+
 
 #endif // PARTICL_RCTINDEX_H
@@ -0,0 +1,59 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rctkeyimagefilter.h>
+
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <pubkey.h>
+#include <random.h>
+
+CRCTKeyImageFilter::CRCTKeyImageFilter(unsigned int n_bits_log2)
+    : m_k0(GetRand<uint64_t>()), m_k1(GetRand<uint64_t>()),
+      m_mask((uint64_t{1} << n_bits_log2) - 1),
+      m_words(new std::atomic<uint64_t>[(m_mask >> 6) + 1])
+{
+    for (uint64_t i = 0; i <= (m_mask >> 6); ++i) {
+        m_words[i] = 0;
+    }
+}
+
+void CRCTKeyImageFilter::GetPositions(const CCmpPubKey &ki, uint64_t (&pos)[NUM_HASHES]) const
+{
+    // Derive all positions from two hashes (Kirsch-Mitzenmacher)
+    uint64_t h = CSipHasher(m_k0, m_k1).Write(ki.begin(), ki.size()).Finalize();
+    uint64_t h1 = h & 0xffffffff, h2 = h >> 32;
+    for (unsigned int i = 0; i < NUM_HASHES; ++i) {
+        pos[i] = (h1 + i * h2) & m_mask;
+    }
+}
+
+void CRCTKeyImageFilter::Insert(const CCmpPubKey &ki)
+{
+    uint64_t pos[NUM_HASHES];
+    GetPositions(ki, pos);
+    for (const auto p : pos) {
+        m_words[p >> 6].fetch_or(uint64_t{1} << (p & 63), std::memory_order_relaxed);
+    }
+}
+
+bool CRCTKeyImageFilter::MaybeContains(const CCmpPubKey &ki) const
+{
+    if (!m_ready) {
+        return true;
+    }
+    uint64_t pos[NUM_HASHES];
+    GetPositions(ki, pos);
+    for (const auto p : pos) {
+        if (!(m_words[p >> 6].load(std::memory_order_relaxed) & (uint64_t{1} << (p & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t CRCTKeyImageFilter::DynamicMemoryUsage() const
+{
+    return memusage::MallocUsage(((m_mask >> 6) + 1) * sizeof(std::atomic<uint64_t>));
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_RCTKEYIMAGEFILTER_H
+#define PARTICL_RCTKEYIMAGEFILTER_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+class CCmpPubKey;
+
+/**
+ * Bloom filter of key images spent in the chain, also used for the anon output pubkeys in the link index.
+ *
+ * Used to answer "not spent" or "unknown" without a db read. Entries are never
+ * removed, a key image erased from the db only costs a false positive.
+ * Until the filter is marked ready every key image may be present.
+ */
+class CRCTKeyImageFilter
+{
+public:
+    static constexpr unsigned int NUM_HASHES = 4;
+
+    explicit CRCTKeyImageFilter(unsigned int n_bits_log2 = 25);
+
+    void Insert(const CCmpPubKey &ki);
+    /** Returns false only if ki was never inserted. */
+    bool MaybeContains(const CCmpPubKey &ki) const;
+
+    void SetReady() { m_ready = true; }
+    bool IsReady() const { return m_ready; }
+
+    size_t DynamicMemoryUsage() const;
+
+private:
+    void GetPositions(const CCmpPubKey &ki, uint64_t (&pos)[NUM_HASHES]) const;
+
+    const uint64_t m_k0, m_k1;
+    const uint64_t m_mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+    std::atomic<bool> m_ready{false};
+};
+
+#endif // PARTICL_RCTKEYIMAGEFILTER_H
@@ -0,0 +1,83 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rctoutputcache.h>
+
+#include <memusage.h>
+
+#include <algorithm>
+
+CRCTOutputCache::CRCTOutputCache(size_t max_entries)
+    : m_max_per_shard(std::max<size_t>(1, (max_entries + NUM_SHARDS - 1) / NUM_SHARDS))
+{
+}
+
+bool CRCTOutputCache::Get(int64_t i, CAnonOutput &ao)
+{
+    Shard &shard = GetShard(i);
+    LOCK(shard.m_mutex);
+    auto mi = shard.m_map.find(i);
+    if (mi == shard.m_map.end()) {
+        m_misses++;
+        return false;
+    }
+    shard.m_lru.splice(shard.m_lru.begin(), shard.m_lru, mi->second);
+    ao = mi->second->second;
+    m_hits++;
+    return true;
+}
+
+void CRCTOutputCache::Put(int64_t i, const CAnonOutput &ao)
+{
+    Shard &shard = GetShard(i);
+    LOCK(shard.m_mutex);
+    auto mi = shard.m_map.find(i);
+    if (mi != shard.m_map.end()) {
+        mi->second->second = ao;
+        shard.m_lru.splice(shard.m_lru.begin(), shard.m_lru, mi->second);
+        return;
+    }
+    shard.m_lru.emplace_front(i, ao);
+    shard.m_map.emplace(i, shard.m_lru.begin());
+    if (shard.m_lru.size() > m_max_per_shard) {
+        shard.m_map.erase(shard.m_lru.back().first);
+        shard.m_lru.pop_back();
+    }
+}
+
+void CRCTOutputCache::Erase(int64_t i)
+{
+    Shard &shard = GetShard(i);
+    LOCK(shard.m_mutex);
+    auto mi = shard.m_map.find(i);
+    if (mi == shard.m_map.end()) {
+        return;
+    }
+    shard.m_lru.erase(mi->second);
+    shard.m_map.erase(mi);
+}
+
+void CRCTOutputCache::Clear()
+{
+    for (auto &shard : m_shards) {
+        LOCK(shard.m_mutex);
+        shard.m_lru.clear();
+        shard.m_map.clear();
+    }
+}
+
+CRCTOutputCache::Stats CRCTOutputCache::GetStats() const
+{
+    Stats stats;
+    for (const auto &shard : m_shards) {
+        LOCK(shard.m_mutex);
+        stats.entries += shard.m_lru.size();
+        stats.usage += memusage::MallocUsage(sizeof(std::pair<int64_t, CAnonOutput>) + 2 * sizeof(void*)) * shard.m_lru.size() +
+                       memusage::DynamicUsage(shard.m_map);
+    }
+    stats.max_entries = m_max_per_shard * NUM_SHARDS;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    return stats;
+}
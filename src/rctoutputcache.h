@@ -0,0 +1,60 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_RCTOUTPUTCACHE_H
+#define PARTICL_RCTOUTPUTCACHE_H
+
+#include <rctindex.h>
+#include <sync.h>
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <stdint.h>
+#include <unordered_map>
+
+/**
+ * Sharded LRU cache of anon outputs read from the block tree db.
+ *
+ * Ring member selection favours recent outputs, the same indices are read repeatedly.
+ * Shards are selected by index so neighbouring outputs don't contend on one lock.
+ */
+class CRCTOutputCache
+{
+public:
+    static constexpr size_t NUM_SHARDS = 16;
+
+    struct Stats {
+        size_t entries{0};
+        size_t max_entries{0};
+        size_t usage{0}; // bytes held by the entries
+        uint64_t hits{0};
+        uint64_t misses{0};
+    };
+
+    explicit CRCTOutputCache(size_t max_entries);
+
+    bool Get(int64_t i, CAnonOutput &ao);
+    void Put(int64_t i, const CAnonOutput &ao);
+    void Erase(int64_t i);
+    void Clear();
+
+    Stats GetStats() const;
+
+private:
+    struct Shard {
+        mutable Mutex m_mutex;
+        std::list<std::pair<int64_t, CAnonOutput> > m_lru GUARDED_BY(m_mutex);
+        std::unordered_map<int64_t, std::list<std::pair<int64_t, CAnonOutput> >::iterator> m_map GUARDED_BY(m_mutex);
+    };
+
+    Shard &GetShard(int64_t i) { return m_shards[(uint64_t)i % NUM_SHARDS]; }
+
+    const size_t m_max_per_shard;
+    std::array<Shard, NUM_SHARDS> m_shards;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
+
+#endif // PARTICL_RCTOUTPUTCACHE_H
@@ -0,0 +1,167 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rctoutputfile.h>
+
+#include <crypto/common.h>
+#include <logging.h>
+#include <rctindex.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <string.h>
+
+namespace {
+constexpr size_t OFS_PUBKEY = 0;
+constexpr size_t OFS_COMMITMENT = OFS_PUBKEY + 33;
+constexpr size_t OFS_TXID = OFS_COMMITMENT + 33;
+constexpr size_t OFS_N = OFS_TXID + 32;
+constexpr size_t OFS_HEIGHT = OFS_N + 4;
+constexpr size_t OFS_COMPROMISED = OFS_HEIGHT + 4;
+static_assert(OFS_COMPROMISED + 1 == CRCTOutputFile::RECORD_SIZE);
+} // namespace
+
+CRCTOutputFile::CRCTOutputFile(const fs::path &dir, int64_t last_index)
+    : m_seq(dir, "rct", FILE_SIZE), m_last_index(last_index < 0 ? 0 : last_index)
+{
+    fs::create_directories(dir);
+}
+
+CRCTOutputFile::~CRCTOutputFile()
+{
+    LOCK(m_mutex);
+#ifndef WIN32
+    for (auto &f : m_files) {
+        if (f.data) {
+            msync(f.data, FILE_SIZE, MS_SYNC);
+            munmap(f.data, FILE_SIZE);
+        }
+        if (f.fd != -1) {
+            close(f.fd);
+        }
+    }
+#endif
+    m_files.clear();
+}
+
+uint8_t *CRCTOutputFile::GetRecord(int64_t i) const
+{
+    AssertLockHeld(m_mutex);
+#ifdef WIN32
+    return nullptr;
+#else
+    if (i < 1) {
+        return nullptr;
+    }
+    size_t n_file = i / RECORDS_PER_FILE;
+    if (n_file >= m_files.size()) {
+        m_files.resize(n_file + 1);
+    }
+    MappedFile &f = m_files[n_file];
+    if (!f.data) {
+        if (f.fd != -1) {
+            return nullptr; // Mapping failed previously
+        }
+        fs::path path = m_seq.FileName(FlatFilePos(n_file, 0));
+        f.fd = open(fs::PathToString(path).c_str(), O_RDWR | O_CREAT, 0644);
+        if (f.fd == -1) {
+            LogPrintf("%s: Unable to open file %s\n", __func__, fs::PathToString(path));
+            return nullptr;
+        }
+        // Grows sparse, unwritten records read as zero
+        if (ftruncate(f.fd, FILE_SIZE) != 0) {
+            LogPrintf("%s: Unable to resize file %s\n", __func__, fs::PathToString(path));
+            return nullptr;
+        }
+        void *p = mmap(nullptr, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, f.fd, 0);
+        if (p == MAP_FAILED) {
+            LogPrintf("%s: Unable to map file %s\n", __func__, fs::PathToString(path));
+            return nullptr;
+        }
+        f.data = (uint8_t*)p;
+    }
+    return f.data + (i % RECORDS_PER_FILE) * RECORD_SIZE;
+#endif
+}
+
+int64_t CRCTOutputFile::GetLastIndex() const
+{
+    LOCK(m_mutex);
+    return m_last_index;
+}
+
+bool CRCTOutputFile::Read(int64_t i, CAnonOutput &ao) const
+{
+    LOCK(m_mutex);
+    if (i > m_last_index) {
+        return false;
+    }
+    const uint8_t *p = GetRecord(i);
+    if (!p) {
+        return false;
+    }
+    ao.pubkey.Set(p + OFS_PUBKEY, p + OFS_PUBKEY + 33);
+    memcpy(ao.commitment.data, p + OFS_COMMITMENT, 33);
+    memcpy(ao.outpoint.hash.begin(), p + OFS_TXID, 32);
+    ao.outpoint.n = ReadLE32(p + OFS_N);
+    ao.nBlockHeight = (int)ReadLE32(p + OFS_HEIGHT);
+    ao.nCompromised = p[OFS_COMPROMISED];
+    return true;
+}
+
+bool CRCTOutputFile::Write(int64_t i, const CAnonOutput &ao)
+{
+    LOCK(m_mutex);
+    if (i > m_last_index + 1) {
+        return false;
+    }
+    uint8_t *p = GetRecord(i);
+    if (!p) {
+        return false;
+    }
+    memcpy(p + OFS_PUBKEY, ao.pubkey.begin(), 33);
+    memcpy(p + OFS_COMMITMENT, ao.commitment.data, 33);
+    memcpy(p + OFS_TXID, ao.outpoint.hash.begin(), 32);
+    WriteLE32(p + OFS_N, ao.outpoint.n);
+    WriteLE32(p + OFS_HEIGHT, (uint32_t)ao.nBlockHeight);
+    p[OFS_COMPROMISED] = ao.nCompromised;
+    m_files[i / RECORDS_PER_FILE].dirty = true;
+    if (i > m_last_index) {
+        m_last_index = i;
+    }
+    return true;
+}
+
+void CRCTOutputFile::Truncate(int64_t last_valid)
+{
+    LOCK(m_mutex);
+    if (last_valid < 0) {
+        last_valid = 0;
+    }
+    if (last_valid < m_last_index) {
+        m_last_index = last_valid;
+    }
+}
+
+bool CRCTOutputFile::Flush()
+{
+    LOCK(m_mutex);
+#ifndef WIN32
+    for (auto &f : m_files) {
+        if (!f.dirty) {
+            continue;
+        }
+        if (msync(f.data, FILE_SIZE, MS_SYNC) != 0) {
+            LogPrintf("%s: msync failed\n", __func__);
+            return false;
+        }
+        f.dirty = false;
+    }
+#endif
+    return true;
+}
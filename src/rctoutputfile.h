@@ -0,0 +1,64 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_RCTOUTPUTFILE_H
+#define PARTICL_RCTOUTPUTFILE_H
+
+#include <flatfile.h>
+#include <fs.h>
+#include <sync.h>
+
+#include <stdint.h>
+#include <vector>
+
+class CAnonOutput;
+
+/**
+ * Flat file table of anon outputs addressed by anon index.
+ *
+ * Rows mirror the DB_RCTOUTPUT entries in the block tree db, which remain the canonical copy.
+ * Records are fixed size and the files are memory mapped, a lookup is a pointer dereference.
+ * Indices above GetLastIndex() are not present in the table and must be read from the db.
+ */
+class CRCTOutputFile
+{
+public:
+    //! pubkey, commitment, outpoint, block height, compromised flag
+    static constexpr size_t RECORD_SIZE = 33 + 33 + 32 + 4 + 4 + 1;
+    static constexpr size_t RECORDS_PER_FILE = 1 << 16;
+    static constexpr size_t FILE_SIZE = RECORD_SIZE * RECORDS_PER_FILE;
+
+    CRCTOutputFile(const fs::path &dir, int64_t last_index);
+    ~CRCTOutputFile();
+
+    CRCTOutputFile(const CRCTOutputFile&) = delete;
+    CRCTOutputFile& operator=(const CRCTOutputFile&) = delete;
+
+    int64_t GetLastIndex() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    bool Read(int64_t i, CAnonOutput &ao) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Write the output at index i, which must follow the last index or replace an existing row. */
+    bool Write(int64_t i, const CAnonOutput &ao) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Drop all rows after last_valid. */
+    void Truncate(int64_t last_valid) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Commit written rows to disk. */
+    bool Flush() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    uint8_t *GetRecord(int64_t i) const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    const FlatFileSeq m_seq;
+    struct MappedFile {
+        int fd{-1};
+        uint8_t *data{nullptr};
+        bool dirty{false};
+    };
+    mutable std::vector<MappedFile> m_files GUARDED_BY(m_mutex);
+    int64_t m_last_index GUARDED_BY(m_mutex);
+};
+
+#endif // PARTICL_RCTOUTPUTFILE_H
@@ -34,6 +34,15 @@
 
 #include <univalue.h>
 
+// Particl
+#include <insight/addressindex.h>
+#include <insight/insight.h>
+#include <insight/rpc.h>
+#include <insight/spentindex.h>
+#include <rctindex.h>
+#include <txdb.h>
+#include <util/string.h>
+
 using node::GetTransaction;
 using node::NodeContext;
 using node::ReadBlockFromDisk;
@@ -936,6 +945,299 @@ static bool rest_blockhash_by_height(const std::any& context, HTTPRequest* req,
     }
 }
 
+// Particl
+
+/** Reply with the result of an RPC method, the json format of an endpoint matches the RPC */
+static bool rest_rpc_reply(const std::any& context, HTTPRequest* req, const std::string& method, const UniValue& params)
+{
+    JSONRPCRequest jsonRequest;
+    jsonRequest.context = context;
+    jsonRequest.strMethod = method;
+    jsonRequest.params = params;
+    UniValue result = tableRPC.execute(jsonRequest);
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, result.write() + "\n");
+    return true;
+}
+
+static bool rest_serialized_reply(HTTPRequest* req, RESTResponseFormat rf, const CDataStream& ss)
+{
+    switch (rf) {
+    case RESTResponseFormat::BINARY: {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ss.str());
+        return true;
+    }
+    case RESTResponseFormat::HEX: {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ss) + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+/** Run an insight endpoint, errors thrown as JSONRPCError are returned as bad requests */
+template <typename Function>
+static bool rest_insight(HTTPRequest* req, const Function& func)
+{
+    try {
+        return func();
+    } catch (const UniValue& objError) {
+        return RESTERR(req, HTTP_BAD_REQUEST, find_value(objError, "message").getValStr());
+    } catch (const std::runtime_error& e) {
+        return RESTERR(req, HTTP_BAD_REQUEST, e.what());
+    }
+}
+
+/** Build the RPC params for a list of comma separated addresses, options are read from the query string */
+static UniValue rest_address_params(HTTPRequest* req, const std::string& param)
+{
+    UniValue options(UniValue::VOBJ);
+    UniValue addresses(UniValue::VARR);
+    for (const std::string& address : SplitString(param, ',')) {
+        addresses.push_back(address);
+    }
+    options.pushKV("addresses", addresses);
+    for (const char* key : {"start", "end", "limit"}) {
+        const auto value = req->GetQueryParameter(key);
+        if (!value) {
+            continue;
+        }
+        int32_t n;
+        if (!ParseInt32(*value, &n)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid %s: %s", key, SanitizeString(*value)));
+        }
+        options.pushKV(key, n);
+    }
+    const auto cursor = req->GetQueryParameter("cursor");
+    if (cursor) {
+        options.pushKV("cursor", *cursor);
+    }
+    UniValue params(UniValue::VARR);
+    params.push_back(options);
+    return params;
+}
+
+static bool rest_address_utxos(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string param;
+    const RESTResponseFormat rf = ParseDataFormat(param, strURIPart);
+    ChainstateManager* chainman = GetChainman(context, req);
+    if (!chainman) return false;
+
+    return rest_insight(req, [&]() {
+        const UniValue params = rest_address_params(req, param);
+        if (rf == RESTResponseFormat::JSON) {
+            return rest_rpc_reply(context, req, "getaddressutxos", params);
+        }
+        if (!fAddressIndex) {
+            return RESTERR(req, HTTP_NOT_FOUND, "Address index is not enabled");
+        }
+        std::vector<std::pair<uint256, int> > addresses;
+        getAddressesFromParams(params, addresses);
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspent_outputs;
+        for (const auto& address : addresses) {
+            if (!GetAddressUnspent(*chainman, address.first, address.second, unspent_outputs)) {
+                return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+            }
+        }
+        std::sort(unspent_outputs.begin(), unspent_outputs.end(), [](const auto& a, const auto& b) {
+            return a.second.blockHeight < b.second.blockHeight;
+        });
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << unspent_outputs;
+        return rest_serialized_reply(req, rf, ss);
+    });
+}
+
+static bool rest_address_deltas(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string param;
+    const RESTResponseFormat rf = ParseDataFormat(param, strURIPart);
+    ChainstateManager* chainman = GetChainman(context, req);
+    if (!chainman) return false;
+
+    return rest_insight(req, [&]() {
+        const UniValue params = rest_address_params(req, param);
+        if (rf == RESTResponseFormat::JSON) {
+            return rest_rpc_reply(context, req, "getaddressdeltas", params);
+        }
+        if (!fAddressIndex) {
+            return RESTERR(req, HTTP_NOT_FOUND, "Address index is not enabled");
+        }
+        const UniValue& options = params[0];
+        int start = 0, end = 0;
+        if (options["start"].isNum() && options["end"].isNum()) {
+            start = options["start"].getInt<int>();
+            end = options["end"].getInt<int>();
+            if (start <= 0 || end <= 0 || end < start) {
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid start and end heights");
+            }
+        }
+        std::vector<std::pair<uint256, int> > addresses;
+        getAddressesFromParams(params, addresses);
+
+        std::optional<CAddressIndexKey> cursor, next;
+        size_t limit = 0;
+        ParseAddressPageOptions(params, cursor, limit);
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > address_index;
+        ReadAddressIndexPage(*chainman, addresses, start, end, cursor, limit, address_index, next);
+
+        // The deltas are followed by a flag and the cursor of the next page if more deltas remain
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << address_index;
+        ss << (uint8_t)(next ? 1 : 0);
+        if (next) {
+            ss << *next;
+        }
+        return rest_serialized_reply(req, rf, ss);
+    });
+}
+
+static bool rest_spent_info(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string param;
+    const RESTResponseFormat rf = ParseDataFormat(param, strURIPart);
+
+    // <txid>-<n>
+    const std::vector<std::string> parts = SplitString(param, '-');
+    uint256 txid;
+    int32_t n;
+    if (parts.size() != 2 || !ParseHashStr(parts[0], txid) || !ParseInt32(parts[1], &n) || n < 0) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+    }
+    ChainstateManager* chainman = GetChainman(context, req);
+    if (!chainman) return false;
+    const CTxMemPool* mempool = GetMemPool(context, req);
+    if (!mempool) return false;
+
+    return rest_insight(req, [&]() {
+        if (rf == RESTResponseFormat::JSON) {
+            UniValue input(UniValue::VOBJ);
+            input.pushKV("txid", txid.GetHex());
+            input.pushKV("index", n);
+            UniValue params(UniValue::VARR);
+            params.push_back(input);
+            return rest_rpc_reply(context, req, "getspentinfo", params);
+        }
+        CSpentIndexKey key(txid, n);
+        CSpentIndexValue value;
+        if (!GetSpentIndex(*chainman, key, value, mempool)) {
+            return RESTERR(req, HTTP_NOT_FOUND, "Unable to get spent info");
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << value;
+        return rest_serialized_reply(req, rf, ss);
+    });
+}
+
+static bool rest_block_deltas(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string hashStr;
+    const RESTResponseFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+    }
+    ChainstateManager* chainman = GetChainman(context, req);
+    if (!chainman) return false;
+    const CTxMemPool* mempool = GetMemPool(context, req);
+    if (!mempool) return false;
+
+    return rest_insight(req, [&]() {
+        if (rf == RESTResponseFormat::JSON) {
+            UniValue params(UniValue::VARR);
+            params.push_back(hashStr);
+            return rest_rpc_reply(context, req, "getblockdeltas", params);
+        }
+        CBlock block;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pblockindex = chainman->m_blockman.LookupBlockIndex(hash);
+            if (!pblockindex || !chainman->ActiveChain().Contains(pblockindex)) {
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            }
+            if (chainman->m_blockman.IsBlockPruned(pblockindex)) {
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
+            }
+            if (!ReadBlockFromDisk(block, pblockindex, chainman->GetParams().GetConsensus())) {
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            }
+        }
+
+        // The block is followed by the spent info of each input, in order, skipping the coinbase
+        std::vector<CSpentIndexValue> spent_info;
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) {
+                continue;
+            }
+            for (const auto& txin : tx->vin) {
+                CSpentIndexValue value;
+                CSpentIndexKey key(txin.prevout.hash, txin.prevout.n);
+                if (!txin.IsAnonInput() && !GetSpentIndex(*chainman, key, value, mempool)) {
+                    return RESTERR(req, HTTP_NOT_FOUND, "Spent information not available");
+                }
+                spent_info.push_back(value);
+            }
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ss << block;
+        ss << spent_info;
+        return rest_serialized_reply(req, rf, ss);
+    });
+}
+
+static bool rest_anon_output(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string param;
+    const RESTResponseFormat rf = ParseDataFormat(param, strURIPart);
+    ChainstateManager* chainman = GetChainman(context, req);
+    if (!chainman) return false;
+
+    return rest_insight(req, [&]() {
+        if (rf == RESTResponseFormat::JSON) {
+            UniValue params(UniValue::VARR);
+            params.push_back(param);
+            return rest_rpc_reply(context, req, "anonoutput", params);
+        }
+        // <index> or <hex of publickey>
+        int64_t index;
+        if (!ParseInt64(param, &index)) {
+            if (!IsHex(param)) {
+                return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+            }
+            std::vector<uint8_t> pubkey_bytes = ParseHex(param);
+            CCmpPubKey pk(pubkey_bytes.begin(), pubkey_bytes.end());
+            if (!pk.IsValid()) {
+                return RESTERR(req, HTTP_BAD_REQUEST, param + " is not a valid compressed public key");
+            }
+            if (!chainman->m_blockman.m_block_tree_db->ReadRCTOutputLink(pk, index)) {
+                return RESTERR(req, HTTP_NOT_FOUND, "Output not indexed");
+            }
+        }
+        CAnonOutput ao;
+        if (!chainman->m_blockman.m_block_tree_db->ReadRCTOutput(index, ao)) {
+            return RESTERR(req, HTTP_NOT_FOUND, "Unknown index");
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << index;
+        ss << ao;
+        return rest_serialized_reply(req, rf, ss);
+    });
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(const std::any& context, HTTPRequest* req, const std::string& strReq);
@@ -951,6 +1253,11 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/addressutxos/", rest_address_utxos},
+      {"/rest/addressdeltas/", rest_address_deltas},
+      {"/rest/spentinfo/", rest_spent_info},
+      {"/rest/blockdeltas/", rest_block_deltas},
+      {"/rest/anonoutput/", rest_anon_output},
 };
 
 void StartREST(const std::any& context)
@@ -9,7 +9,9 @@
 
 #include <validation.h>
 #include <txdb.h>
+#include <txmempool.h>
 #include <anon.h>
+#include <rctindex.h>
 
 
 static bool IsDigits(const std::string &str)
@@ -17,13 +19,36 @@ static bool IsDigits(const std::string &str)
     return str.length() && std::all_of(str.begin(), str.end(), IsDigit);
 };
 
+/** Max outputs returned by one anonoutput range call */
+static constexpr size_t MAX_ANON_OUTPUT_RANGE{100000};
+
+static void AnonOutputToJSON(int64_t index, const CAnonOutput &ao, bool include_compromised, UniValue &result)
+{
+    result.pushKV("index", (int)index);
+    result.pushKV("publickey", HexStr(Span<const unsigned char>(ao.pubkey.begin(), 33)));
+    result.pushKV("txnhash", ao.outpoint.hash.ToString());
+    result.pushKV("n", (int)ao.outpoint.n);
+    result.pushKV("blockheight", ao.nBlockHeight);
+    if (include_compromised) {
+        result.pushKV("compromised", ao.nCompromised != 0);
+    }
+}
+
 static RPCHelpMan anonoutput()
 {
     return RPCHelpMan{"anonoutput",
                 "\nReturns an anon output at index or by publickey hex.\n"
-                "If no output is provided returns the last index.\n",
+                "If no output is provided returns the last index.\n"
+                "If count is set returns up to count consecutive outputs from the output index.\n",
                 {
                     {"output", RPCArg::Type::STR, RPCArg::Default{""}, "Output to view, specified by index or hex of publickey."},
+                    {"count", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, strprintf("Number of outputs to return from output, at most %d.", MAX_ANON_OUTPUT_RANGE)},
+                    {"options", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED_NAMED_ARG, "",
+                        {
+                            {"format", RPCArg::Type::STR, RPCArg::Default{"json"}, "\"json\" or \"hex\", with count set \"hex\" returns the serialized outputs concatenated, 108 bytes each."},
+                            {"include_compromised", RPCArg::Type::BOOL, RPCArg::Default{false}, "Include the compromised flag, set when the output was revealed as the real spend of a ring."},
+                        },
+                    },
                 },
                 {
                 RPCResult{"No arguments",
@@ -37,10 +62,21 @@ static RPCHelpMan anonoutput()
                         {RPCResult::Type::STR_HEX, "txnhash", "Hash of transaction found in"},
                         {RPCResult::Type::NUM, "n", "Offset in transaction found in"},
                         {RPCResult::Type::NUM, "blockheight", "Height of block found in"},
+                        {RPCResult::Type::BOOL, "compromised", /*optional=*/true, "Output is known to be spent, if include_compromised"},
+                }},
+                RPCResult{"With count",
+                    RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::NUM, "start", "Index of the first output"},
+                        {RPCResult::Type::NUM, "count", "Number of outputs returned, less than requested past the last index"},
+                        {RPCResult::Type::ARR, "outputs", /*optional=*/true, "If format is json", {
+                            {RPCResult::Type::ELISION, "", "Output objects as above"},
+                        }},
+                        {RPCResult::Type::STR_HEX, "hex", /*optional=*/true, "If format is hex, the serialized outputs"},
                 }}
                 },
                 RPCExamples{
             HelpExampleCli("anonoutput", "\"1\"")
+            + HelpExampleCli("anonoutput", "\"1\" 1000 '{\"format\":\"hex\"}'")
             + HelpExampleRpc("anonoutput", "\"2\"")
             },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
@@ -57,6 +93,26 @@ static RPCHelpMan anonoutput()
     std::string sIn = request.params[0].get_str();
     auto& pblocktree{chainman.m_blockman.m_block_tree_db};
 
+    bool include_compromised = false, format_hex = false;
+    if (!request.params[2].isNull()) {
+        const UniValue &options = request.params[2].get_obj();
+        RPCTypeCheckObj(options,
+            {
+                {"format", UniValueType(UniValue::VSTR)},
+                {"include_compromised", UniValueType(UniValue::VBOOL)},
+            }, true, true);
+        if (options.exists("format")) {
+            const std::string format = options["format"].get_str();
+            if (format != "json" && format != "hex") {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown format: " + format);
+            }
+            format_hex = format == "hex";
+        }
+        if (options.exists("include_compromised")) {
+            include_compromised = options["include_compromised"].get_bool();
+        }
+    }
+
     int64_t nIndex;
     if (IsDigits(sIn)) {
         if (!ParseInt64(sIn, &nIndex)) {
@@ -78,16 +134,41 @@ static RPCHelpMan anonoutput()
         }
     }
 
+    if (!request.params[1].isNull()) {
+        int64_t count = request.params[1].getInt<int64_t>();
+        if (count < 1 || count > (int64_t)MAX_ANON_OUTPUT_RANGE) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %d", MAX_ANON_OUTPUT_RANGE));
+        }
+        std::vector<CAnonOutput> outputs;
+        size_t num_read = pblocktree->ReadRCTOutputs(nIndex, count, outputs);
+
+        result.pushKV("start", (int)nIndex);
+        result.pushKV("count", (int)num_read);
+        if (format_hex) {
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss.reserve(num_read * 108);
+            for (const auto &ao : outputs) {
+                ss << ao;
+            }
+            result.pushKV("hex", HexStr(ss));
+            return result;
+        }
+        UniValue rv(UniValue::VARR);
+        for (size_t k = 0; k < num_read; ++k) {
+            UniValue obj(UniValue::VOBJ);
+            AnonOutputToJSON(nIndex + k, outputs[k], include_compromised, obj);
+            rv.push_back(obj);
+        }
+        result.pushKV("outputs", rv);
+        return result;
+    }
+
     CAnonOutput ao;
     if (!pblocktree->ReadRCTOutput(nIndex, ao)) {
         throw JSONRPCError(RPC_MISC_ERROR, "Unknown index.");
     }
 
-    result.pushKV("index", (int)nIndex);
-    result.pushKV("publickey", HexStr(Span<const unsigned char>(ao.pubkey.begin(), 33)));
-    result.pushKV("txnhash", ao.outpoint.hash.ToString());
-    result.pushKV("n", (int)ao.outpoint.n);
-    result.pushKV("blockheight", ao.nBlockHeight);
+    AnonOutputToJSON(nIndex, ao, include_compromised, result);
 
     return result;
 },
@@ -143,6 +224,82 @@ static RPCHelpMan checkkeyimage()
     };
 }
 
+static RPCHelpMan checkkeyimages()
+{
+    return RPCHelpMan{"checkkeyimages",
+            "\nCheck if keyimages are spent in the chain or the mempool.\n",
+            {
+                {"keyimages", RPCArg::Type::ARR, RPCArg::Optional::NO, "A json array of hex encoded keyimages.",
+                    {
+                        {"keyimage", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "Hex encoded keyimage."},
+                    },
+                },
+            },
+            RPCResult{
+                RPCResult::Type::ARR, "", "", {
+                    {RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::STR_HEX, "keyimage", "The keyimage"},
+                        {RPCResult::Type::STR, "state", "\"spent\", \"mempool\" or \"unknown\""},
+                        {RPCResult::Type::STR_HEX, "txid", /*optional=*/true, "ID of spending transaction"},
+                        {RPCResult::Type::NUM, "height", /*optional=*/true, "Chain height of containing block"},
+                    }},
+            }},
+            RPCExamples{
+        HelpExampleCli("checkkeyimages", "\"[\\\"keyimage\\\",...]\"")
+        + HelpExampleRpc("checkkeyimages", "[\"keyimage\",...]")
+        },
+    [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    ChainstateManager& chainman = EnsureAnyChainman(request.context);
+    const CTxMemPool& mempool = EnsureAnyMemPool(request.context);
+    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
+
+    RPCTypeCheck(request.params, {UniValue::VARR}, true);
+
+    const UniValue &inputs = request.params[0].get_array();
+    std::vector<CCmpPubKey> key_images;
+    key_images.reserve(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const std::string &s = inputs[i].get_str();
+        if (!IsHex(s) || !(s.size() == 66)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Keyimage must be 33 bytes and hex encoded.");
+        }
+        std::vector<uint8_t> v = ParseHex(s);
+        key_images.emplace_back(v.begin(), v.end());
+    }
+
+    std::vector<CKeyImageSpend> states;
+    {
+        LOCK(cs_main);
+        GetKeyImageStates(*pblocktree, &mempool, key_images, states);
+    }
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < key_images.size(); ++i) {
+        const CKeyImageSpend &ks = states[i];
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("keyimage", HexStr(key_images[i]));
+        if (ks.state == CKeyImageSpend::IN_CHAIN) {
+            entry.pushKV("state", "spent");
+            entry.pushKV("txid", ks.txid.ToString());
+            if (ks.height > 0) {
+                entry.pushKV("height", ks.height);
+            }
+        } else
+        if (ks.state == CKeyImageSpend::IN_MEMPOOL) {
+            entry.pushKV("state", "mempool");
+            entry.pushKV("txid", ks.txid.ToString());
+        } else {
+            entry.pushKV("state", "unknown");
+        }
+        result.push_back(entry);
+    }
+
+    return result;
+},
+    };
+}
+
 static RPCHelpMan rollbackrctindex()
 {
     return RPCHelpMan{"rollbackrctindex",
@@ -175,12 +332,47 @@ static RPCHelpMan rollbackrctindex()
     };
 }
 
+static RPCHelpMan rebuildrctkeyimageheightindex()
+{
+    return RPCHelpMan{"rebuildrctkeyimageheightindex",
+            "\nRebuild the index of key images by spend height, used to roll back the RCT index.\n",
+            {
+            },
+            RPCResult{
+                RPCResult::Type::OBJ, "", "", {
+                    {RPCResult::Type::NUM, "indexed", "Number of key images indexed"},
+            }},
+            RPCExamples{
+        HelpExampleCli("rebuildrctkeyimageheightindex", "")
+        + HelpExampleRpc("rebuildrctkeyimageheightindex", "")
+        },
+    [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    ChainstateManager& chainman = EnsureAnyChainman(request.context);
+    LOCK(cs_main);
+    auto& pblocktree{chainman.m_blockman.m_block_tree_db};
+
+    size_t num_indexed = 0;
+    if (!pblocktree->RebuildRCTKeyImageHeightIndex(num_indexed)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "RebuildRCTKeyImageHeightIndex failed.");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("indexed", (uint64_t)num_indexed);
+
+    return result;
+},
+    };
+}
+
 void RegisterAnonRPCCommands(CRPCTable &t)
 {
     static const CRPCCommand commands[]{
-        {"anon", &anonoutput},
-        {"anon", &checkkeyimage},
+        {"anon", &anonoutput, true},
+        {"anon", &checkkeyimage, true},
+        {"anon", &checkkeyimages, true},
         {"anon", &rollbackrctindex},
+        {"hidden", &rebuildrctkeyimageheightindex},
     };
     for (const auto& c : commands) {
         t.appendCommand(c.name, &c);
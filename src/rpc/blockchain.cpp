@@ -53,12 +53,14 @@
 
 #include <pos/kernel.h>
 #include <pos/miner.h>
+#include <validationstats.h>
 
 using kernel::CCoinsStats;
 using kernel::CoinStatsHashType;
 
 using node::BlockManager;
 using node::NodeContext;
+using node::ParticlSnapshotHeader;
 using node::ReadBlockFromDisk;
 using node::SnapshotMetadata;
 using node::UndoReadFromDisk;
@@ -107,7 +109,7 @@ static int ComputeNextBlockAndDepth(const CBlockIndex* tip, const CBlockIndex* b
     return blockindex == tip ? 1 : -1;
 }
 
-static const CBlockIndex* ParseHashOrHeight(const UniValue& param, ChainstateManager& chainman)
+const CBlockIndex* ParseHashOrHeight(const UniValue& param, ChainstateManager& chainman)
 {
     LOCK(::cs_main);
     CChain& active_chain = chainman.ActiveChain();
@@ -1291,6 +1293,13 @@ RPCHelpMan getblockchaininfo()
                 {RPCResult::Type::NUM, "pruneheight", /*optional=*/true, "height of the last block pruned, plus one (only present if pruning is enabled)"},
                 {RPCResult::Type::BOOL, "automatic_pruning", /*optional=*/true, "whether automatic pruning is enabled (only present if pruning is enabled)"},
                 {RPCResult::Type::NUM, "prune_target_size", /*optional=*/true, "the target size used by pruning (only present if automatic pruning is enabled)"},
+                {RPCResult::Type::OBJ, "rollingindicesrebuild", /*optional=*/true, "the rebuild of the rolling indices started at startup (only present if one was required)",
+                {
+                    {RPCResult::Type::STR, "status", "one of \"rewinding\", \"reconnecting\", \"done\", \"failed\""},
+                    {RPCResult::Type::NUM, "rewindheight", "the height the chain is rewound to"},
+                    {RPCResult::Type::NUM, "startheight", "the chain height when the rebuild started"},
+                    {RPCResult::Type::NUM, "progress", "estimate of the rebuild progress [0..1]"},
+                }},
                 {RPCResult::Type::STR, "warnings", "any network and blockchain warnings"},
             }},
         RPCExamples{
@@ -1335,6 +1344,25 @@ RPCHelpMan getblockchaininfo()
         }
     }
 
+    const particl::RollingIndicesRebuildStatus rebuild_status = particl::GetRollingIndicesRebuildStatus();
+    if (rebuild_status.state != particl::RollingIndicesRebuildStatus::NONE) {
+        UniValue rebuild(UniValue::VOBJ);
+        rebuild.pushKV("status", particl::RollingIndicesRebuildStateName(rebuild_status.state));
+        rebuild.pushKV("rewindheight", rebuild_status.rewind_height);
+        rebuild.pushKV("startheight", rebuild_status.start_height);
+        // Rewinding and reconnecting count as one half each
+        double progress = 1.0;
+        int num_blocks = rebuild_status.start_height - rebuild_status.rewind_height;
+        if (num_blocks > 0 && rebuild_status.state == particl::RollingIndicesRebuildStatus::REWINDING) {
+            progress = 0.5 * std::clamp(rebuild_status.start_height - height, 0, num_blocks) / num_blocks;
+        } else
+        if (num_blocks > 0 && rebuild_status.state == particl::RollingIndicesRebuildStatus::RECONNECTING) {
+            progress = 0.5 + 0.5 * std::clamp(height - rebuild_status.rewind_height, 0, num_blocks) / num_blocks;
+        }
+        rebuild.pushKV("progress", progress);
+        obj.pushKV("rollingindicesrebuild", rebuild);
+    }
+
     obj.pushKV("warnings", GetWarnings(false).original);
     return obj;
 },
@@ -2109,6 +2137,70 @@ public:
     }
 };
 
+static RPCHelpMan getblockvalidationstats()
+{
+    std::vector<RPCResult> stat_fields{
+        {RPCResult::Type::STR_HEX, "blockhash", "The block hash"},
+        {RPCResult::Type::NUM, "height", "The block height, -1 if the block was checked but not connected"},
+    };
+    const std::vector<std::pair<BlockValidationStat, std::string> > stat_docs{
+        {BVS_ANON_INPUTS, "Anon prevouts spent"},
+        {BVS_RING_MEMBERS_READ, "Ring members read from the anon output index"},
+        {BVS_RING_MEMBERS_READ_US, "Time reading ring members"},
+        {BVS_KEY_IMAGE_LOOKUPS, "Key images looked up in the key image index"},
+        {BVS_KEY_IMAGE_LOOKUP_US, "Time looking up key images"},
+        {BVS_MLSAGS_VERIFIED, "MLSAG signatures verified"},
+        {BVS_MLSAG_US, "Time verifying MLSAG signatures, summed over the check threads"},
+        {BVS_RANGEPROOFS_VERIFIED, "Rangeproofs verified, proofs found in the rangeproof cache are not counted"},
+        {BVS_RANGEPROOF_US, "Time verifying rangeproofs"},
+        {BVS_RCT_INDEX_WRITES, "Key images and anon outputs written to the RingCT index"},
+        {BVS_RCT_INDEX_WRITE_US, "Time writing the RingCT index"},
+        {BVS_INSIGHT_INDEX_WRITES, "Address, spent and balances index entries written"},
+        {BVS_INSIGHT_INDEX_WRITE_US, "Time writing the address, spent and balances indices"},
+        {BVS_COINSTAKE_CHECK_US, "Time checking the proof of stake, stake reward, treasury fund and smsg fee rules"},
+        {BVS_SMSG_FUNDING_TXNS, "Smsg funding transactions stored"},
+        {BVS_SMSG_FUNDING_US, "Time storing smsg funding transactions"},
+        {BVS_CONNECT_BLOCK_US, "Time connecting the block, including flushing the block's view and indices"},
+    };
+    for (const auto &doc : stat_docs) {
+        stat_fields.push_back({RPCResult::Type::NUM, GetBlockValidationStatName(doc.first), doc.second});
+    }
+
+    return RPCHelpMan{"getblockvalidationstats",
+                "\nReturns counters and timings of the Particl specific work done to validate a recent block.\n"
+                "Stats are kept for the last -blockvalidationstats blocks checked, times are in microseconds.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The block hash"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "", stat_fields},
+                RPCExamples{
+                    HelpExampleCli("getblockvalidationstats", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+            + HelpExampleRpc("getblockvalidationstats", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    if (!g_block_validation_stats.IsEnabled()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block validation stats are disabled, see -blockvalidationstats");
+    }
+    const uint256 hash{ParseHashV(request.params[0], "blockhash")};
+    std::shared_ptr<const BlockValidationStats> stats = g_block_validation_stats.Find(hash);
+    if (!stats) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No validation stats for block");
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("blockhash", hash.GetHex());
+    obj.pushKV("height", stats->m_height.load());
+    for (size_t i = 0; i < BVS_MAX; ++i) {
+        BlockValidationStat stat = (BlockValidationStat)i;
+        obj.pushKV(GetBlockValidationStatName(stat), stats->Get(stat));
+    }
+    return obj;
+},
+    };
+}
+
 static RPCHelpMan scantxoutset()
 {
     // scriptPubKey corresponding to mainnet address 12cbQLTFMXRnSzktFkuoG3eHoMeFtpTu3S
@@ -2424,6 +2516,7 @@ static RPCHelpMan dumptxoutset()
                     {RPCResult::Type::STR, "path", "the absolute path that the snapshot was written to"},
                     {RPCResult::Type::STR_HEX, "txoutset_hash", "the hash of the UTXO set contents"},
                     {RPCResult::Type::NUM, "nchaintx", "the number of transactions in the chain up to and including the base block"},
+                    {RPCResult::Type::STR_HEX, "particl_state_hash", /*optional=*/true, "the hash of the money supply, stake modifier, anon outputs, key images and spent cache rows"},
                 }
         },
         RPCExamples{
@@ -2471,8 +2564,10 @@ UniValue CreateUTXOSnapshot(
     const fs::path& temppath)
 {
     std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::unique_ptr<CDBIterator> rct_cursor;
     std::optional<CCoinsStats> maybe_stats;
     const CBlockIndex* tip;
+    CBlockTreeDB* block_tree_db;
 
     {
         // We need to lock cs_main to ensure that the coinsdb isn't written to
@@ -2498,6 +2593,13 @@ UniValue CreateUTXOSnapshot(
 
         pcursor = chainstate.CoinsDB().Cursor();
         tip = CHECK_NONFATAL(chainstate.m_blockman.LookupBlockIndex(maybe_stats->hashBlock));
+
+        // The anon outputs, key images and spent cache rows must match the coins
+        block_tree_db = chainstate.m_blockman.m_block_tree_db.get();
+        if (!block_tree_db->FlushRCTBulkLoad()) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to flush RCT index");
+        }
+        rct_cursor.reset(block_tree_db->NewIterator());
     }
 
     LOG_TIME_SECONDS(strprintf("writing UTXO snapshot at height %s (%s) to file %s (via %s)",
@@ -2523,6 +2625,16 @@ UniValue CreateUTXOSnapshot(
         pcursor->Next();
     }
 
+    CHashWriter particl_hasher(SER_GETHASH, 0);
+    if (fParticlMode) {
+        ParticlSnapshotHeader particl_header{tip->nMoneySupply, tip->nAnonOutputs, tip->bnStakeModifier};
+        afile << particl_header;
+        particl_hasher << particl_header;
+        if (!block_tree_db->DumpSnapshotRCTState(*rct_cursor, tip->nAnonOutputs, afile, particl_hasher, node.rpc_interruption_point)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read RCT index");
+        }
+    }
+
     afile.fclose();
 
     UniValue result(UniValue::VOBJ);
@@ -2534,6 +2646,9 @@ UniValue CreateUTXOSnapshot(
     // Cast required because univalue doesn't have serialization specified for
     // `unsigned int`, nChainTx's type.
     result.pushKV("nchaintx", uint64_t{tip->nChainTx});
+    if (fParticlMode) {
+        result.pushKV("particl_state_hash", particl_hasher.GetHash().ToString());
+    }
     return result;
 }
 
@@ -2543,13 +2658,14 @@ void RegisterBlockchainRPCCommands(CRPCTable& t)
         {"blockchain", &getblockchaininfo},
         {"blockchain", &getchaintxstats},
         {"blockchain", &getblockstats},
-        {"blockchain", &getbestblockhash},
-        {"blockchain", &getblockcount},
-        {"blockchain", &getblock},
+        {"blockchain", &getblockvalidationstats},
+        {"blockchain", &getbestblockhash, true},
+        {"blockchain", &getblockcount, true},
+        {"blockchain", &getblock, true},
         {"blockchain", &getblockfrompeer},
-        {"blockchain", &getblockhash},
+        {"blockchain", &getblockhash, true},
         {"blockchain", &getblockhashafter},
-        {"blockchain", &getblockheader},
+        {"blockchain", &getblockheader, true},
         {"blockchain", &getchaintips},
         {"blockchain", &getdifficulty},
         {"blockchain", &getdeploymentinfo},
@@ -45,6 +45,9 @@ UniValue blockToJSON(node::BlockManager& blockman, const CBlock& block, const CB
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex) LOCKS_EXCLUDED(cs_main);
 
+/** Block at a height of the active chain or with a hash, throws if not found */
+const CBlockIndex* ParseHashOrHeight(const UniValue& param, ChainstateManager& chainman);
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
@@ -143,6 +143,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "gettxout", 2, "include_mempool" },
     { "gettxoutproof", 0, "txids" },
     { "gettxoutsetinfo", 1, "hash_or_height" },
+    { "gettxoutsetinfobyscript", 0, "hash_or_height" },
     { "gettxoutsetinfo", 2, "use_index"},
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
@@ -176,6 +177,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "estimaterawfee", 1, "threshold" },
     { "prioritisetransaction", 1, "dummy" },
     { "prioritisetransaction", 2, "fee_delta" },
+    { "getstakingperf", 0, "reset" },
     { "setban", 2, "bantime" },
     { "setban", 3, "absolute" },
     { "setnetworkactive", 0, "state" },
@@ -199,6 +201,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getposdifficulty", 0, "height" },
     { "filteraddresses", 2, "sort_code" },
     { "filteraddresses", 5, "show_path" },
+    { "filteraddresses", 6, "show_totals" },
     { "reservebalance", 0, "enabled" },
     { "deriverangekeys", 0, "start" },
     { "deriverangekeys", 1, "end" },
@@ -226,15 +229,21 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "createsignaturewithkey", 4, "options" },
 
     { "walletsettings", 1, "setting_value" },
+    { "getcoldstakinginfo", 0, "show_keys" },
 
+    { "getnewaddress", 5, "count" },
     { "getnewextaddress", 2, "bech32" },
     { "getnewextaddress", 3, "hardened" },
     { "getnewstealthaddress", 1, "num_prefix_bits" },
     { "getnewstealthaddress", 3, "bech32" },
     { "getnewstealthaddress", 4, "makeV2" },
+    { "getnewstealthaddress", 5, "count" },
     { "importstealthaddress", 5, "bech32" },
     { "liststealthaddresses", 1, "options" },
 
+    { "anonoutput", 1, "count" },
+    { "anonoutput", 2, "options" },
+    { "checkkeyimages", 0, "keyimages" },
     { "listunspentanon", 0, "minconf" },
     { "listunspentanon", 1, "maxconf" },
     { "listunspentanon", 2, "addresses" },
@@ -316,8 +325,14 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getaddressmempool", 0, "addresses"},
     { "listcoldstakeunspent", 1, "height"},
     { "listcoldstakeunspent", 2, "options"},
+    { "listcoldstakedelegations", 1, "options"},
     { "getblockreward", 0, "height"},
+    { "getblockrewards", 0, "start_height"},
+    { "getblockrewards", 1, "count"},
     { "getblockbalances", 1, "options"},
+    { "getblockbalancesrange", 0, "start"},
+    { "getblockbalancesrange", 1, "end"},
+    { "getblockbalancesrange", 2, "options"},
     { "getaddresstxids", 0, "addresses"},
     { "getaddresstxids", 1, "start" },
     { "getaddresstxids", 2, "end" },
@@ -345,6 +360,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "echojson", 9, "arg9" },
     { "rescanblockchain", 0, "start_height"},
     { "rescanblockchain", 1, "stop_height"},
+    { "rescanblockchain", 2, "options"},
     { "createwallet", 1, "disable_private_keys"},
     { "createwallet", 2, "blank"},
     { "createwallet", 4, "avoid_reuse"},
@@ -17,6 +17,7 @@
 #include <util/fees.h>
 #include <util/system.h>
 #include <validation.h>
+#include <anon.h>
 
 #include <algorithm>
 #include <array>
@@ -45,6 +46,10 @@ static RPCHelpMan estimatesmartfee()
             "target, but is not as responsive to short term drops in the\n"
             "prevailing fee market. Must be one of (case insensitive):\n"
              "\"" + FeeModes("\"\n\"") + "\""},
+            {"tx_type", RPCArg::Type::STR, RPCArg::Default{"all"}, "Estimate from transactions of this type only.\n"
+            "\"anon\" transactions have anon inputs or outputs, \"blind\" transactions blinded inputs or outputs.\n"
+            "\"all\" estimates from every transaction with anon fees scaled down by the anon fee multiplier.\n"
+            "Must be one of: \"all\", \"plain\", \"blind\", \"anon\""},
         },
         RPCResult{
             RPCResult::Type::OBJ, "", "",
@@ -62,11 +67,12 @@ static RPCHelpMan estimatesmartfee()
         }},
         RPCExamples{
             HelpExampleCli("estimatesmartfee", "6") +
+            HelpExampleCli("estimatesmartfee", "6 conservative anon") +
             HelpExampleRpc("estimatesmartfee", "6")
         },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
         {
-            RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VSTR});
+            RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VSTR, UniValue::VSTR});
             RPCTypeCheckArgument(request.params[0], UniValue::VNUM);
 
             CBlockPolicyEstimator& fee_estimator = EnsureAnyFeeEstimator(request.context);
@@ -83,14 +89,22 @@ static RPCHelpMan estimatesmartfee()
                 }
                 if (fee_mode == FeeEstimateMode::ECONOMICAL) conservative = false;
             }
+            FeeEstimateTxType tx_type = FeeEstimateTxType::ALL;
+            if (!request.params[2].isNull() && !FeeEstimateTxTypeFromString(request.params[2].get_str(), tx_type)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid tx_type parameter, must be one of: \"all\", \"plain\", \"blind\", \"anon\"");
+            }
 
             UniValue result(UniValue::VOBJ);
             UniValue errors(UniValue::VARR);
             FeeCalculation feeCalc;
-            CFeeRate feeRate{fee_estimator.estimateSmartFee(conf_target, &feeCalc, conservative)};
+            CFeeRate feeRate{fee_estimator.estimateSmartFee(conf_target, &feeCalc, conservative, tx_type)};
             if (feeRate != CFeeRate(0)) {
                 CFeeRate min_mempool_feerate{mempool.GetMinFee(gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000)};
                 CFeeRate min_relay_feerate{::minRelayTxFee};
+                if (tx_type == FeeEstimateTxType::ANON) {
+                    // Anon transactions must pay ANON_FEE_MULTIPLIER times the mempool minimum fee
+                    min_mempool_feerate = CFeeRate(min_mempool_feerate.GetFeePerK() * ANON_FEE_MULTIPLIER);
+                }
                 feeRate = std::max({feeRate, min_mempool_feerate, min_relay_feerate});
                 result.pushKV("feerate", ValueFromAmount(feeRate.GetFeePerK()));
             } else {
@@ -661,12 +661,20 @@ UniValue MempoolInfoToJSON(const CTxMemPool& pool)
     ret.pushKV("size", (int64_t)pool.size());
     ret.pushKV("bytes", (int64_t)pool.GetTotalTxSize());
     ret.pushKV("usage", (int64_t)pool.DynamicMemoryUsage());
+    ret.pushKV("insightusage", (int64_t)pool.InsightIndexUsage());
+    ret.pushKV("keyimages", (uint64_t)pool.mapKeyImages.Size());
+    ret.pushKV("keyimageusage", (int64_t)pool.KeyImageUsage());
     ret.pushKV("total_fee", ValueFromAmount(pool.GetTotalFee()));
     int64_t maxmempool{gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000};
     ret.pushKV("maxmempool", maxmempool);
     ret.pushKV("mempoolminfee", ValueFromAmount(std::max(pool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
     ret.pushKV("unbroadcastcount", uint64_t{pool.GetUnbroadcastTxs().size()});
+    const auto proof_spill_stats = pool.GetProofSpillStats();
+    if (proof_spill_stats) {
+        ret.pushKV("spilledproofs", (uint64_t)proof_spill_stats->spilled_txns);
+        ret.pushKV("spilledproofbytes", proof_spill_stats->live_bytes);
+    }
     return ret;
 }
 
@@ -682,11 +690,16 @@ static RPCHelpMan getmempoolinfo()
                 {RPCResult::Type::NUM, "size", "Current tx count"},
                 {RPCResult::Type::NUM, "bytes", "Sum of all virtual transaction sizes as defined in BIP 141. Differs from actual serialized size because witness data is discounted"},
                 {RPCResult::Type::NUM, "usage", "Total memory usage for the mempool"},
+                {RPCResult::Type::NUM, "insightusage", "Memory usage of the mempool address and spent indices"},
+                {RPCResult::Type::NUM, "keyimages", "Number of key images spent by mempool transactions"},
+                {RPCResult::Type::NUM, "keyimageusage", "Memory usage of the key image map, included in usage"},
                 {RPCResult::Type::STR_AMOUNT, "total_fee", "Total fees for the mempool in " + CURRENCY_UNIT + ", ignoring modified fees through prioritisetransaction"},
                 {RPCResult::Type::NUM, "maxmempool", "Maximum memory usage for the mempool"},
                 {RPCResult::Type::STR_AMOUNT, "mempoolminfee", "Minimum fee rate in " + CURRENCY_UNIT + "/kvB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee"},
                 {RPCResult::Type::STR_AMOUNT, "minrelaytxfee", "Current minimum relay fee for transactions"},
-                {RPCResult::Type::NUM, "unbroadcastcount", "Current number of transactions that haven't passed initial broadcast yet"}
+                {RPCResult::Type::NUM, "unbroadcastcount", "Current number of transactions that haven't passed initial broadcast yet"},
+                {RPCResult::Type::NUM, "spilledproofs", /*optional=*/true, "Number of transactions with rangeproofs moved to the side file, with -mempoolspillproofs"},
+                {RPCResult::Type::NUM, "spilledproofbytes", /*optional=*/true, "Bytes of rangeproofs in the side file, with -mempoolspillproofs"},
             }},
         RPCExamples{
             HelpExampleCli("getmempoolinfo", "")
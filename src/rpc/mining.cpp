@@ -17,6 +17,7 @@
 #include <net.h>
 #include <node/context.h>
 #include <node/miner.h>
+#include <pos/stakingperf.h>
 #include <pow.h>
 #include <rpc/blockchain.h>
 #include <rpc/mining.h>
@@ -434,6 +435,96 @@ static RPCHelpMan getmininginfo()
     };
 }
 
+static UniValue HistogramToJSON(const StakingPerfHistogram &histogram)
+{
+    StakingPerfHistogram::Snapshot snapshot = histogram.GetSnapshot();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", snapshot.count);
+    obj.pushKV("mean_us", snapshot.count ? snapshot.sum_us / snapshot.count : 0);
+    obj.pushKV("max_us", snapshot.max_us);
+    UniValue buckets(UniValue::VARR);
+    for (size_t i = 0; i < StakingPerfHistogram::NUM_BUCKETS; ++i) {
+        if (snapshot.buckets[i] == 0) {
+            continue;
+        }
+        UniValue bucket(UniValue::VOBJ);
+        if (i < StakingPerfHistogram::NUM_BUCKETS - 1) {
+            bucket.pushKV("below_us", uint64_t{1} << i);
+        }
+        bucket.pushKV("count", snapshot.buckets[i]);
+        buckets.push_back(bucket);
+    }
+    obj.pushKV("buckets", buckets);
+    return obj;
+}
+
+static RPCHelpMan getstakingperf()
+{
+    const std::vector<RPCResult> histogram_fields{
+        {RPCResult::Type::NUM, "count", "Number of samples"},
+        {RPCResult::Type::NUM, "mean_us", "Mean in microseconds"},
+        {RPCResult::Type::NUM, "max_us", "Largest sample in microseconds"},
+        {RPCResult::Type::ARR, "buckets", "Non empty buckets, each bucket starts at the previous bucket's limit",
+        {
+            {RPCResult::Type::OBJ, "", "",
+            {
+                {RPCResult::Type::NUM, "below_us", /*optional=*/true, "Upper limit of the bucket in microseconds, omitted for the last bucket"},
+                {RPCResult::Type::NUM, "count", "Number of samples in the bucket"},
+            }},
+        }},
+    };
+    return RPCHelpMan{"getstakingperf",
+                "\nReturns staking latency and kernel search metrics, summed over all staking threads.\n"
+                "Can be used to tune -minersleep and -stakingthreads.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, RPCArg::Default{false}, "Clear the metrics after reading them."},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::NUM, "kernelsevaluated", "Number of stake kernels hashed"},
+                        {RPCResult::Type::NUM, "kernelspersecond", "Kernels hashed per second of search time"},
+                        {RPCResult::Type::NUM, "stakesfound", "Blocks signed after finding a kernel"},
+                        {RPCResult::Type::NUM, "stakesaccepted", "Staked blocks accepted by the node"},
+                        {RPCResult::Type::NUM, "stakesstale", "Staked blocks dropped because the tip moved"},
+                        {RPCResult::Type::NUM, "stakesrejected", "Staked blocks failing validation"},
+                        {RPCResult::Type::NUM, "stakesorphaned", "Wallet coinstakes disconnected from the chain"},
+                        {RPCResult::Type::OBJ, "tiptokernelcheck", "Time from a tip notification to the first kernel search", histogram_fields},
+                        {RPCResult::Type::OBJ, "kerneltobroadcast", "Time from finding a kernel to the block being accepted", histogram_fields},
+                        {RPCResult::Type::OBJ, "kernelsearch", "Duration of each kernel search", histogram_fields},
+                        {RPCResult::Type::OBJ, "csmainwait", "Time staking threads waited for cs_main", histogram_fields},
+                        {RPCResult::Type::OBJ, "cswalletwait", "Time staking threads waited for cs_wallet", histogram_fields},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getstakingperf", "")
+            + HelpExampleRpc("getstakingperf", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const StakingPerf &perf = g_staking_perf;
+    uint64_t search_us = perf.kernel_search_us;
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("kernelsevaluated", perf.kernels_evaluated.load());
+    obj.pushKV("kernelspersecond", search_us ? (double)perf.kernels_evaluated * 1000000.0 / search_us : 0.0);
+    obj.pushKV("stakesfound", perf.stakes_found.load());
+    obj.pushKV("stakesaccepted", perf.stakes_accepted.load());
+    obj.pushKV("stakesstale", perf.stakes_stale.load());
+    obj.pushKV("stakesrejected", perf.stakes_rejected.load());
+    obj.pushKV("stakesorphaned", perf.stakes_orphaned.load());
+    obj.pushKV("tiptokernelcheck", HistogramToJSON(perf.tip_to_kernel_check));
+    obj.pushKV("kerneltobroadcast", HistogramToJSON(perf.kernel_to_broadcast));
+    obj.pushKV("kernelsearch", HistogramToJSON(perf.kernel_search));
+    obj.pushKV("csmainwait", HistogramToJSON(perf.cs_main_wait));
+    obj.pushKV("cswalletwait", HistogramToJSON(perf.cs_wallet_wait));
+
+    if (!request.params[0].isNull() && request.params[0].get_bool()) {
+        g_staking_perf.Reset();
+    }
+    return obj;
+},
+    };
+}
 
 // NOTE: Unlike wallet RPC (which use BTC values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
 static RPCHelpMan prioritisetransaction()
@@ -1056,6 +1147,7 @@ void RegisterMiningRPCCommands(CRPCTable& t)
     static const CRPCCommand commands[]{
         {"mining", &getnetworkhashps},
         {"mining", &getmininginfo},
+        {"mining", &getstakingperf},
         {"mining", &prioritisetransaction},
         {"mining", &getblocktemplate},
         {"mining", &submitblock},
@@ -6,6 +6,7 @@
 
 #include <addrman.h>
 #include <banman.h>
+#include <blockencodings.h>
 #include <chainparams.h>
 #include <clientversion.h>
 #include <core_io.h>
@@ -602,6 +603,7 @@ static RPCHelpMan getnetworkinfo()
                         {RPCResult::Type::NUM, "connections_in", "the number of inbound connections"},
                         {RPCResult::Type::NUM, "connections_out", "the number of outbound connections"},
                         {RPCResult::Type::NUM, "dos_states", "the number of DOS states in memory"},
+                        {RPCResult::Type::NUM, "loose_headers", "the number of block headers without blocks held over all peers"},
                         {RPCResult::Type::BOOL, "networkactive", "whether p2p networking is enabled"},
                         {RPCResult::Type::ARR, "networks", "information per network",
                         {
@@ -625,6 +627,15 @@ static RPCHelpMan getnetworkinfo()
                                 {RPCResult::Type::NUM, "score", "relative score"},
                             }},
                         }},
+                        {RPCResult::Type::OBJ, "compactblocks", "reconstruction of received compact blocks",
+                        {
+                            {RPCResult::Type::NUM, "blocks", "the number of compact blocks reconstructed"},
+                            {RPCResult::Type::NUM, "blocks_requested_txn", "the number of those which needed a getblocktxn round trip"},
+                            {RPCResult::Type::NUM, "txn", "the number of transactions in those blocks"},
+                            {RPCResult::Type::NUM, "txn_prefilled", "the number of transactions prefilled by the sender"},
+                            {RPCResult::Type::NUM, "txn_requested", "the number of transactions requested with getblocktxn"},
+                            {RPCResult::Type::NUM, "blinded_txn_requested", "the number of requested transactions with anon inputs or blinded outputs"},
+                        }},
                         {RPCResult::Type::STR, "warnings", "any network and blockchain warnings"},
                     }
                 },
@@ -656,6 +667,7 @@ static RPCHelpMan getnetworkinfo()
         obj.pushKV("connections_out", (int)node.connman->GetNodeCount(ConnectionDirection::Out));
     }
     obj.pushKV("dos_states",    GetNumDOSStates());
+    obj.pushKV("loose_headers", (uint64_t)GetNumLooseHeaders());
     obj.pushKV("networks",      GetNetworksInfo());
     obj.pushKV("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK()));
     obj.pushKV("incrementalfee", ValueFromAmount(::incrementalRelayFee.GetFeePerK()));
@@ -672,6 +684,15 @@ static RPCHelpMan getnetworkinfo()
         }
     }
     obj.pushKV("localaddresses", localAddresses);
+    const CompactBlockStats cmpctblock_stats = GetCompactBlockStats();
+    UniValue cmpctblock_obj(UniValue::VOBJ);
+    cmpctblock_obj.pushKV("blocks", cmpctblock_stats.blocks);
+    cmpctblock_obj.pushKV("blocks_requested_txn", cmpctblock_stats.blocks_requested_txn);
+    cmpctblock_obj.pushKV("txn", cmpctblock_stats.txn);
+    cmpctblock_obj.pushKV("txn_prefilled", cmpctblock_stats.txn_prefilled);
+    cmpctblock_obj.pushKV("txn_requested", cmpctblock_stats.txn_requested);
+    cmpctblock_obj.pushKV("blinded_txn_requested", cmpctblock_stats.blinded_txn_requested);
+    obj.pushKV("compactblocks", cmpctblock_obj);
     obj.pushKV("warnings",       GetWarnings(false).original);
     return obj;
 },
@@ -6,7 +6,9 @@
 #include <chainparams.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/coinscriptstatsindex.h>
 #include <index/coinstatsindex.h>
+#include <index/timestampindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <interfaces/echo.h>
@@ -29,6 +31,12 @@
 
 #include <rpc/rpcutil.h>
 #include <rpc/client.h>
+#include <smsg/pubkeyindex.h>
+#include <smsg/smessage.h>
+#include <interfaces/wallet.h>
+#include <txdb.h>
+#include <txmempool.h>
+#include <validation.h>
 
 using node::NodeContext;
 
@@ -209,6 +217,74 @@ static std::string RPCMallocInfo()
 }
 #endif
 
+static UniValue RPCParticlMemoryInfo(node::NodeContext &node)
+{
+    UniValue obj(UniValue::VOBJ);
+    ChainstateManager &chainman = EnsureChainman(node);
+    {
+        LOCK(cs_main);
+        const CCoinsViewCache &coins_tip = chainman.ActiveChainstate().CoinsTip();
+        UniValue coins(UniValue::VOBJ);
+        coins.pushKV("cache", (uint64_t)coins_tip.DynamicMemoryUsage());
+        coins.pushKV("rct", (uint64_t)coins_tip.DynamicMemoryUsageRCT());
+        obj.pushKV("coins", coins);
+
+        auto &block_tree_db = chainman.m_blockman.m_block_tree_db;
+        CRCTOutputCache::Stats rct_cache_stats;
+        CSpentCoinCache::Stats spent_cache_stats;
+        UniValue rct(UniValue::VOBJ);
+        rct.pushKV("output_cache", block_tree_db->GetRCTOutputCacheStats(rct_cache_stats) ? (uint64_t)rct_cache_stats.usage : 0);
+        rct.pushKV("spent_coin_cache", block_tree_db->GetSpentCoinCacheStats(spent_cache_stats) ? (uint64_t)spent_cache_stats.usage : 0);
+        rct.pushKV("key_image_filters", (uint64_t)block_tree_db->KeyImageFilterUsage());
+        rct.pushKV("bulk_load", (uint64_t)block_tree_db->RCTBulkLoadUsage());
+        rct.pushKV("spent_index_cache", (uint64_t)block_tree_db->SpentIndexCacheUsage());
+        obj.pushKV("rct", rct);
+
+        UniValue stake(UniValue::VOBJ);
+        stake.pushKV("coinstake_cache", (uint64_t)particl::coinStakeCache.DynamicMemoryUsage());
+        stake.pushKV("smsg_fee_coinstake_cache", (uint64_t)particl::smsgFeeCoinstakeCache.DynamicMemoryUsage());
+        stake.pushKV("smsg_difficulty_coinstake_cache", (uint64_t)particl::smsgDifficultyCoinstakeCache.DynamicMemoryUsage());
+        stake.pushKV("stake_seen", (uint64_t)particl::StakeSeenUsage());
+        stake.pushKV("stake_conflicts", (uint64_t)particl::StakeConflictUsage());
+        stake.pushKV("delayed_blocks", (uint64_t)particl::DelayedBlocksUsage());
+        obj.pushKV("stake", stake);
+    }
+
+    if (node.mempool) {
+        const CTxMemPool &pool = *node.mempool;
+        LOCK(pool.cs);
+        UniValue mempool(UniValue::VOBJ);
+        mempool.pushKV("usage", (uint64_t)pool.DynamicMemoryUsage());
+        mempool.pushKV("key_images", (uint64_t)pool.KeyImageUsage());
+        mempool.pushKV("insight", (uint64_t)pool.InsightIndexUsage());
+        obj.pushKV("mempool", mempool);
+    }
+
+    if (smsg::fSecMsgEnabled) {
+        std::map<std::string, size_t> usage;
+        smsgModule.GetMemoryUsage(usage);
+        UniValue smsg_usage(UniValue::VOBJ);
+        for (const auto &it : usage) {
+            smsg_usage.pushKV(it.first, (uint64_t)it.second);
+        }
+        obj.pushKV("smsg", smsg_usage);
+    }
+
+    if (node.wallet_loader) {
+        UniValue wallets(UniValue::VARR);
+        for (const auto &wallet : node.wallet_loader->getWallets()) {
+            UniValue wallet_usage(UniValue::VOBJ);
+            wallet_usage.pushKV("name", wallet->getWalletName());
+            for (const auto &it : wallet->getMemoryUsage()) {
+                wallet_usage.pushKV(it.first, (uint64_t)it.second);
+            }
+            wallets.push_back(wallet_usage);
+        }
+        obj.pushKV("wallets", wallets);
+    }
+    return obj;
+}
+
 static RPCHelpMan getmemoryinfo()
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -219,7 +295,8 @@ static RPCHelpMan getmemoryinfo()
                 {
                     {"mode", RPCArg::Type::STR, RPCArg::Default{"stats"}, "determines what kind of information is returned.\n"
             "  - \"stats\" returns general statistics about memory usage in the daemon.\n"
-            "  - \"mallocinfo\" returns an XML string describing low-level heap state (only available if compiled with glibc 2.10+)."},
+            "  - \"mallocinfo\" returns an XML string describing low-level heap state (only available if compiled with glibc 2.10+).\n"
+            "  - \"particl\" returns the bytes held by the Particl caches and indices, approximated from container sizes."},
                 },
                 {
                     RPCResult{"mode \"stats\"",
@@ -239,6 +316,57 @@ static RPCHelpMan getmemoryinfo()
                     RPCResult{"mode \"mallocinfo\"",
                         RPCResult::Type::STR, "", "\"<malloc version=\"1\">...\""
                     },
+                    RPCResult{"mode \"particl\"",
+                        RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::OBJ, "coins", "",
+                            {
+                                {RPCResult::Type::NUM, "cache", "Coins tip cache, including the RCT data"},
+                                {RPCResult::Type::NUM, "rct", "Anon outputs, links and key images waiting to be flushed"},
+                            }},
+                            {RPCResult::Type::OBJ, "rct", "",
+                            {
+                                {RPCResult::Type::NUM, "output_cache", "Anon output cache"},
+                                {RPCResult::Type::NUM, "spent_coin_cache", "Recently spent coins"},
+                                {RPCResult::Type::NUM, "key_image_filters", "Key image and output link filters"},
+                                {RPCResult::Type::NUM, "bulk_load", "Rows buffered while bulk loading"},
+                                {RPCResult::Type::NUM, "spent_index_cache", "Spent index lookups"},
+                            }},
+                            {RPCResult::Type::OBJ, "mempool", "",
+                            {
+                                {RPCResult::Type::NUM, "usage", "Mempool, including the key images"},
+                                {RPCResult::Type::NUM, "key_images", "Key images of the mempool txns"},
+                                {RPCResult::Type::NUM, "insight", "Mempool address and spent indices"},
+                            }},
+                            {RPCResult::Type::OBJ, "stake", "",
+                            {
+                                {RPCResult::Type::NUM, "coinstake_cache", "Recent coinstakes"},
+                                {RPCResult::Type::NUM, "smsg_fee_coinstake_cache", "Coinstakes read for smsg fee rates"},
+                                {RPCResult::Type::NUM, "smsg_difficulty_coinstake_cache", "Coinstakes read for smsg difficulties"},
+                                {RPCResult::Type::NUM, "stake_seen", "Recently seen stake kernels"},
+                                {RPCResult::Type::NUM, "stake_conflicts", "Peers sending conflicting stakes"},
+                                {RPCResult::Type::NUM, "delayed_blocks", "Blocks received before their parent"},
+                            }},
+                            {RPCResult::Type::OBJ, "smsg", /*optional=*/true, "Omitted if secure messaging is disabled",
+                            {
+                                {RPCResult::Type::NUM, "buckets", "Bucket map"},
+                                {RPCResult::Type::NUM, "tokens", "Token sets of the buckets"},
+                                {RPCResult::Type::NUM, "purged", "Purged token markers"},
+                                {RPCResult::Type::NUM, "addresses", "Receiving addresses"},
+                            }},
+                            {RPCResult::Type::ARR, "wallets", /*optional=*/true, "Loaded wallets, omitted if wallets are disabled",
+                            {
+                                {RPCResult::Type::OBJ, "", "",
+                                {
+                                    {RPCResult::Type::STR, "name", "The wallet name"},
+                                    {RPCResult::Type::NUM, "transactions", /*optional=*/true, "mapWallet and the spends index"},
+                                    {RPCResult::Type::NUM, "records", /*optional=*/true, "mapRecords of the blinded and anon txns"},
+                                    {RPCResult::Type::NUM, "keys", /*optional=*/true, "Extended keys, accounts and their key maps"},
+                                    {RPCResult::Type::NUM, "caches", /*optional=*/true, "Balance, unspent, stake and address caches"},
+                                }},
+                            }},
+                        }
+                    },
                 },
                 RPCExamples{
                     HelpExampleCli("getmemoryinfo", "")
@@ -257,6 +385,8 @@ static RPCHelpMan getmemoryinfo()
 #else
         throw JSONRPCError(RPC_INVALID_PARAMETER, "mallocinfo mode not available");
 #endif
+    } else if (mode == "particl") {
+        return RPCParticlMemoryInfo(EnsureAnyNodeContext(request.context));
     } else {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "unknown mode " + mode);
     }
@@ -464,6 +594,18 @@ static RPCHelpMan getindexinfo()
         result.pushKVs(SummaryToJSON(g_coin_stats_index->GetSummary(), index_name));
     }
 
+    if (g_coin_script_stats_index) {
+        result.pushKVs(SummaryToJSON(g_coin_script_stats_index->GetSummary(), index_name));
+    }
+
+    if (g_timestamp_index) {
+        result.pushKVs(SummaryToJSON(g_timestamp_index->GetSummary(), index_name));
+    }
+
+    if (smsg::g_pubkey_index) {
+        result.pushKVs(SummaryToJSON(smsg::g_pubkey_index->GetSummary(), index_name));
+    }
+
     ForEachBlockFilterIndex([&result, &index_name](const BlockFilterIndex& index) {
         result.pushKVs(SummaryToJSON(index.GetSummary(), index_name));
     });
@@ -2017,7 +2017,7 @@ static RPCHelpMan analyzepsbt()
 void RegisterRawTransactionRPCCommands(CRPCTable& t)
 {
     static const CRPCCommand commands[]{
-        {"rawtransactions", &getrawtransaction},
+        {"rawtransactions", &getrawtransaction, true},
         {"rawtransactions", &createrawtransaction},
         {"rawtransactions", &decoderawtransaction},
         {"rawtransactions", &decodescript},
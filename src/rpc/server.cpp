@@ -5,6 +5,7 @@
 
 #include <rpc/server.h>
 
+#include <httpserver.h>
 #include <rpc/util.h>
 #include <shutdown.h>
 #include <sync.h>
@@ -14,7 +15,9 @@
 
 #include <boost/signals2/signal.hpp>
 
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <memory> // for unique_ptr
 #include <mutex>
 #include <unordered_map>
@@ -221,6 +224,21 @@ static RPCHelpMan getrpcinfo()
                             }},
                         }},
                         {RPCResult::Type::STR, "logpath", "The complete file path to the debug log"},
+                        {RPCResult::Type::ARR, "work_queues", "The default worker pool followed by the pool of each -rpcworkclass",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                 {RPCResult::Type::STR, "name", "The name of the pool"},
+                                 {RPCResult::Type::NUM, "threads", "The number of worker threads"},
+                                 {RPCResult::Type::NUM, "queue_depth", "The number of queued requests"},
+                                 {RPCResult::Type::NUM, "max_queue_depth", "The number of queued requests at which requests are rejected"},
+                                 {RPCResult::Type::NUM, "requests", "The number of requests served"},
+                                 {RPCResult::Type::NUM, "rejected", "The number of requests rejected because the queue was full"},
+                                 {RPCResult::Type::NUM, "average_wait", "The average time requests were queued in microseconds"},
+                                 {RPCResult::Type::NUM, "average_duration", "The average running time in microseconds"},
+                                 {RPCResult::Type::NUM, "max_latency", "The longest time from queueing to completion in microseconds"},
+                            }},
+                        }},
                     }
                 },
                 RPCExamples{
@@ -244,6 +262,22 @@ static RPCHelpMan getrpcinfo()
     UniValue log_path(UniValue::VSTR, path);
     result.pushKV("logpath", log_path);
 
+    UniValue work_queues(UniValue::VARR);
+    for (const HTTPWorkQueueStats& stats : GetHTTPWorkQueueStats()) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("name", stats.name);
+        entry.pushKV("threads", stats.threads);
+        entry.pushKV("queue_depth", (uint64_t)stats.depth);
+        entry.pushKV("max_queue_depth", (uint64_t)stats.max_depth);
+        entry.pushKV("requests", stats.requests);
+        entry.pushKV("rejected", stats.rejected);
+        entry.pushKV("average_wait", stats.requests ? stats.total_wait / (int64_t)stats.requests : 0);
+        entry.pushKV("average_duration", stats.requests ? stats.total_duration / (int64_t)stats.requests : 0);
+        entry.pushKV("max_latency", stats.max_latency);
+        work_queues.push_back(entry);
+    }
+    result.pushKV("work_queues", work_queues);
+
     return result;
 }
     };
@@ -376,11 +410,95 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
+/** A run of consecutive batch entries executed concurrently, shared by the threads working on it */
+struct JSONRPCBatchRun
+{
+    JSONRPCBatchRun(const JSONRPCRequest& jreq, std::vector<const UniValue*> requests)
+        : jreq(jreq), requests(std::move(requests)), results(this->requests.size()) {}
+
+    const JSONRPCRequest jreq;
+    //! Only dereferenced for claimed entries, vReq outlives the run while any are unfinished
+    const std::vector<const UniValue*> requests;
+    std::vector<UniValue> results;
+    std::atomic<size_t> next{0};
+
+    Mutex mutex;
+    std::condition_variable cond;
+    size_t completed GUARDED_BY(mutex){0};
+
+    void Work() EXCLUSIVE_LOCKS_REQUIRED(!mutex)
+    {
+        size_t i;
+        while ((i = next++) < requests.size()) {
+            results[i] = JSONRPCExecOne(jreq, *requests[i]);
+            LOCK(mutex);
+            if (++completed == requests.size()) {
+                cond.notify_all();
+            }
+        }
+    }
+};
+
+static bool IsBatchConcurrentRequest(const UniValue& req)
+{
+    if (!req.isObject()) {
+        return false;
+    }
+    const UniValue& method = find_value(req.get_obj(), "method");
+    return method.isStr() && tableRPC.isBatchConcurrent(method.get_str());
+}
+
+static void JSONRPCExecConcurrent(const JSONRPCRequest& jreq, std::vector<const UniValue*> requests, UniValue& ret)
+{
+    size_t num_helpers = 0;
+    const std::vector<HTTPWorkQueueStats> work_queues = GetHTTPWorkQueueStats();
+    if (!work_queues.empty() && work_queues[0].threads > 1) {
+        num_helpers = std::min(requests.size() - 1, (size_t)work_queues[0].threads - 1);
+    }
+    if (num_helpers == 0) {
+        for (const UniValue* req : requests) {
+            ret.push_back(JSONRPCExecOne(jreq, *req));
+        }
+        return;
+    }
+
+    // Helpers that start late find nothing left to claim, the calling thread
+    // works on the run too so it only ever waits on entries already executing.
+    auto run = std::make_shared<JSONRPCBatchRun>(jreq, std::move(requests));
+    for (size_t i = 0; i < num_helpers; ++i) {
+        if (!QueueHTTPWork([run]() { run->Work(); })) {
+            break;
+        }
+    }
+    run->Work();
+    {
+        WAIT_LOCK(run->mutex, lock);
+        run->cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(run->mutex) { return run->completed == run->requests.size(); });
+    }
+    for (auto& result : run->results) {
+        ret.push_back(std::move(result));
+    }
+}
+
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
 {
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size();) {
+        std::vector<const UniValue*> concurrent;
+        while (reqIdx < vReq.size() && IsBatchConcurrentRequest(vReq[reqIdx])) {
+            concurrent.push_back(&vReq[reqIdx++]);
+        }
+        if (concurrent.size() > 1) {
+            JSONRPCExecConcurrent(jreq, std::move(concurrent), ret);
+            continue;
+        }
+        if (concurrent.size() == 1) {
+            ret.push_back(JSONRPCExecOne(jreq, *concurrent[0]));
+            continue;
+        }
+        // Other methods run alone and in order
+        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx++]));
+    }
 
     return ret.write() + "\n";
 }
@@ -489,6 +607,20 @@ std::vector<std::string> CRPCTable::listCommands() const
     return commandList;
 }
 
+bool CRPCTable::isBatchConcurrent(const std::string& name) const
+{
+    auto it = mapCommands.find(name);
+    if (it == mapCommands.end() || it->second.empty()) {
+        return false;
+    }
+    for (const auto* command : it->second) {
+        if (!command->batch_concurrent) {
+            return false;
+        }
+    }
+    return true;
+}
+
 UniValue CRPCTable::dumpArgMap(const JSONRPCRequest& args_request) const
 {
     JSONRPCRequest request = args_request;
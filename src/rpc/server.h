@@ -113,11 +113,20 @@ public:
     {
     }
 
+    //! Constructor for commands that may run concurrently with other such commands of a batch request.
+    CRPCCommand(std::string category, RpcMethodFnType fn, bool batch_concurrent)
+        : CRPCCommand(std::move(category), fn)
+    {
+        this->batch_concurrent = batch_concurrent;
+    }
+
     std::string category;
     std::string name;
     Actor actor;
     std::vector<std::string> argNames;
     intptr_t unique_id;
+    //! Read only command that is safe to run in parallel with other entries of a JSON-RPC batch
+    bool batch_concurrent{false};
 };
 
 /**
@@ -145,6 +154,12 @@ public:
     */
     std::vector<std::string> listCommands() const;
 
+    /**
+     * Returns true if every handler of the method may run concurrently within a
+     * batch request.
+     */
+    bool isBatchConcurrent(const std::string& name) const;
+
     /**
      * Return all named arguments that need to be converted by the client from string to another JSON type
      */
@@ -173,6 +188,10 @@ extern CRPCTable tableRPC;
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
+/**
+ * Execute a batch request, consecutive entries calling batch_concurrent methods
+ * are spread over the idle HTTP worker threads. Replies are returned in request order.
+ */
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
 
 // Retrieves any serialization flags requested in command line argument
@@ -5,11 +5,25 @@
 
 #include <script/particlconsensus.h>
 
+#include <anon.h>
+#include <blind.h>
 #include <primitives/transaction.h>
 #include <pubkey.h>
 #include <script/interpreter.h>
 #include <version.h>
 
+#include <secp256k1.h>
+#include <secp256k1_bulletproofs.h>
+#include <secp256k1_commitment.h>
+#include <secp256k1_mlsag.h>
+#include <secp256k1_rangeproof.h>
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -68,6 +82,171 @@ struct ECCryptoClosure
 };
 
 ECCryptoClosure instance_of_eccryptoclosure;
+
+/** Context for the blinded output checks, separate from secp256k1_ctx_blind as blind.cpp is not part of the library */
+struct BlindVerifyContext
+{
+    secp256k1_context *ctx;
+    secp256k1_bulletproof_generators *gens;
+
+    BlindVerifyContext()
+    {
+        ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY);
+        assert(ctx);
+        gens = secp256k1_bulletproof_generators_create(ctx, &secp256k1_generator_const_g, 2 * 64 * MAX_AGGREGATE_RANGEPROOFS);
+        assert(gens);
+    }
+    ~BlindVerifyContext()
+    {
+        secp256k1_bulletproof_generators_destroy(ctx, gens);
+        secp256k1_context_destroy(ctx);
+    }
+};
+
+/** Created on first use, building the bulletproof generators is too slow to do on load */
+const BlindVerifyContext& GetBlindVerifyContext()
+{
+    static const BlindVerifyContext instance;
+    return instance;
+}
+
+/** Runs a set of independent checks, on the caller's thread pool if one is provided. */
+class CheckGroup
+{
+public:
+    explicit CheckGroup(std::vector<std::function<bool()>> checks) : m_checks(std::move(checks)) {}
+
+    /** Returns true if all checks passed, waits for every submitted task */
+    bool Run(bitcoinconsensus_submit_task submit, void* pool)
+    {
+        if (!submit) {
+            for (const auto &check : m_checks) {
+                if (!check()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        m_pending = m_checks.size();
+        m_tasks.reserve(m_checks.size());
+        for (size_t i = 0; i < m_checks.size(); ++i) {
+            m_tasks.push_back({this, i});
+        }
+        for (auto &task : m_tasks) {
+            submit(pool, &CheckGroup::RunTask, &task);
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_pending == 0; });
+        return !m_failed;
+    }
+
+private:
+    struct Task {
+        CheckGroup *group;
+        size_t index;
+    };
+
+    static void RunTask(void* task_data)
+    {
+        const Task &task = *static_cast<Task*>(task_data);
+        CheckGroup &group = *task.group;
+        // Tasks still queued after a failure return without checking
+        if (!group.m_failed && !group.m_checks[task.index]()) {
+            group.m_failed = true;
+        }
+        // Notify under the lock, the group is destroyed as soon as Run sees m_pending reach 0
+        std::lock_guard<std::mutex> lock(group.m_mutex);
+        if (--group.m_pending == 0) {
+            group.m_cv.notify_all();
+        }
+    }
+
+    std::vector<std::function<bool()>> m_checks;
+    std::vector<Task> m_tasks;
+    std::atomic<bool> m_failed{false};
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    size_t m_pending{0};
+};
+
+/** Deserialize txTo, returns false and sets err if it is malformed */
+bool ReadTransaction(const unsigned char *txTo, unsigned int txToLen, CTransactionRef &tx, bitcoinconsensus_error* err)
+{
+    try {
+        TxInputStream stream(PROTOCOL_VERSION, txTo, txToLen);
+        tx = MakeTransactionRef(CTransaction(deserialize, stream));
+    } catch (const std::exception&) {
+        set_error(err, bitcoinconsensus_ERR_TX_DESERIALIZE);
+        return false;
+    }
+    if (GetSerializeSize(*tx, PROTOCOL_VERSION) != txToLen) {
+        set_error(err, bitcoinconsensus_ERR_TX_SIZE_MISMATCH);
+        return false;
+    }
+    return true;
+}
+
+/** Number of outputs covered by the rangeproof of vpout[first], matches GetRangeProofGroupSize in consensus/tx_verify.cpp */
+size_t GetRangeProofGroupSize(const std::vector<CTxOutBaseRef> &vpout, size_t first)
+{
+    const std::vector<uint8_t> *pvRangeproof = vpout[first]->GetPRangeproof();
+    if (!pvRangeproof || pvRangeproof->empty()) {
+        return 1;
+    }
+    size_t n = 1;
+    for (size_t k = first + 1; k < vpout.size(); ++k) {
+        pvRangeproof = vpout[k]->GetPRangeproof();
+        if (vpout[k]->nVersion != vpout[first]->nVersion || !pvRangeproof || !pvRangeproof->empty()) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+/** Verify the proof of vpout[first] over the commitments of n outputs, proofs from 500 to 1000 bytes are bulletproofs as in GetRangeProofInfo */
+bool VerifyRangeProofGroup(const CTransaction &tx, size_t first, size_t n)
+{
+    const BlindVerifyContext &verify = GetBlindVerifyContext();
+    const std::vector<uint8_t> &proof = *tx.vpout[first]->GetPRangeproof();
+    std::vector<secp256k1_pedersen_commitment> commitments(n);
+    for (size_t k = 0; k < n; ++k) {
+        commitments[k] = *tx.vpout[first + k]->GetPCommitment();
+    }
+    if (n == 1 && !(proof.size() > 500 && proof.size() < 1000)) {
+        uint64_t min_value = 0, max_value = 0;
+        return 1 == secp256k1_rangeproof_verify(verify.ctx, &min_value, &max_value,
+            &commitments[0], proof.data(), proof.size(), nullptr, 0, secp256k1_generator_h);
+    }
+    // Each check has its own scratch space so checks can run concurrently
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(verify.ctx, 1024 * 1024);
+    if (!scratch) {
+        return false;
+    }
+    int rv = secp256k1_bulletproof_rangeproof_verify(verify.ctx, scratch, verify.gens,
+        proof.data(), proof.size(), nullptr, commitments.data(), n, 64, &secp256k1_generator_const_h, nullptr, 0);
+    secp256k1_scratch_space_destroy(verify.ctx, scratch);
+    return rv == 1;
+}
+
+/** Commit to the plain value out and fee with a zero blinding factor */
+bool GetPlainOutCommitment(const CTransaction &tx, secp256k1_pedersen_commitment &commitment, CAmount &plain_value_out)
+{
+    size_t nStandard = 0, nCt = 0, nRingCT = 0;
+    plain_value_out = tx.GetPlainValueOut(nStandard, nCt, nRingCT);
+    CAmount txfee = 0;
+    if (!tx.GetCTFee(txfee)) {
+        return false;
+    }
+    plain_value_out += txfee;
+    if (!MoneyRange(plain_value_out)) {
+        return false;
+    }
+    const uint8_t zero_blind[32] = {0};
+    return plain_value_out == 0 ||
+        secp256k1_pedersen_commit(GetBlindVerifyContext().ctx, &commitment, zero_blind, (uint64_t)plain_value_out,
+                                  &secp256k1_generator_const_h, &secp256k1_generator_const_g);
+}
 } // namespace
 
 /** Check that all specified flags are part of the libconsensus interface. */
@@ -123,6 +302,178 @@ int bitcoinconsensus_verify_script(const unsigned char *scriptPubKey, unsigned i
     return ::verify_script(scriptPubKey, scriptPubKeyLen, am, txTo, txToLen, nIn, flags, err);
 }
 
+int bitcoinconsensus_verify_rangeproofs(const unsigned char *txTo, unsigned int txToLen,
+                                        bitcoinconsensus_submit_task submit, void* pool,
+                                        bitcoinconsensus_error* err)
+{
+    CTransactionRef tx;
+    if (!ReadTransaction(txTo, txToLen, tx, err)) {
+        return 0;
+    }
+    set_error(err, bitcoinconsensus_ERR_OK);
+
+    std::vector<std::function<bool()>> checks;
+    for (size_t k = 0; k < tx->vpout.size(); ++k) {
+        const CTxOutBase *txout = tx->vpout[k].get();
+        if (!txout->IsType(OUTPUT_CT) && !txout->IsType(OUTPUT_RINGCT)) {
+            continue;
+        }
+        size_t n = GetRangeProofGroupSize(tx->vpout, k);
+        // As IsValidAggregateSize, blind.cpp is not linked
+        if (n > 1 && (n > MAX_AGGREGATE_RANGEPROOFS || (n & (n - 1)) != 0)) {
+            return 0;
+        }
+        const std::vector<uint8_t> &proof = *txout->GetPRangeproof();
+        if (proof.size() < 500 || proof.size() > 5134) {
+            return 0;
+        }
+        checks.push_back([&tx = *tx, k, n]() { return VerifyRangeProofGroup(tx, k, n); });
+        k += n - 1;
+    }
+    return CheckGroup(std::move(checks)).Run(submit, pool) ? 1 : 0;
+}
+
+int bitcoinconsensus_verify_commitment_sum(const unsigned char *txTo, unsigned int txToLen,
+                                           int64_t plainValueIn,
+                                           const unsigned char *commitmentsIn, unsigned int nCommitmentsIn,
+                                           bitcoinconsensus_error* err)
+{
+    CTransactionRef tx;
+    if (!ReadTransaction(txTo, txToLen, tx, err)) {
+        return 0;
+    }
+    set_error(err, bitcoinconsensus_ERR_OK);
+    if (!MoneyRange(plainValueIn)) {
+        return 0;
+    }
+
+    const secp256k1_context *ctx = GetBlindVerifyContext().ctx;
+    std::vector<secp256k1_pedersen_commitment> commits_in(nCommitmentsIn);
+    for (size_t i = 0; i < nCommitmentsIn; ++i) {
+        memcpy(commits_in[i].data, commitmentsIn + i * 33, 33);
+    }
+    secp256k1_pedersen_commitment plain_in, plain_out;
+    const uint8_t zero_blind[32] = {0};
+    if (plainValueIn > 0) {
+        if (!secp256k1_pedersen_commit(ctx, &plain_in, zero_blind, (uint64_t)plainValueIn,
+                                       &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+            return 0;
+        }
+        commits_in.push_back(plain_in);
+    }
+    std::vector<const secp256k1_pedersen_commitment*> vpCommitsIn, vpCommitsOut;
+    for (const auto &c : commits_in) {
+        vpCommitsIn.push_back(&c);
+    }
+
+    CAmount plain_value_out = 0;
+    if (!GetPlainOutCommitment(*tx, plain_out, plain_value_out)) {
+        return 0;
+    }
+    if (plain_value_out > 0) {
+        vpCommitsOut.push_back(&plain_out);
+    }
+    for (const auto &txout : tx->vpout) {
+        const secp256k1_pedersen_commitment *pc = txout->GetPCommitment();
+        if (pc) {
+            vpCommitsOut.push_back(pc);
+        }
+    }
+    return secp256k1_pedersen_verify_tally(ctx, vpCommitsIn.data(), vpCommitsIn.size(),
+                                           vpCommitsOut.data(), vpCommitsOut.size()) == 1 ? 1 : 0;
+}
+
+int bitcoinconsensus_verify_mlsag(const unsigned char *txTo, unsigned int txToLen,
+                                  const unsigned char *ringPubkeys, const unsigned char *ringCommitments,
+                                  unsigned int nRingMembers,
+                                  bitcoinconsensus_submit_task submit, void* pool,
+                                  bitcoinconsensus_error* err)
+{
+    CTransactionRef tx;
+    if (!ReadTransaction(txTo, txToLen, tx, err)) {
+        return 0;
+    }
+
+    // Validate the shape of every input before any signature is checked
+    const bool split_commitments = tx->vin.size() > 1;
+    size_t ring_ofs = 0;
+    for (const auto &txin : tx->vin) {
+        uint32_t nInputs, nRingSize;
+        if (!txin.IsAnonInput() || !txin.GetAnonInfo(nInputs, nRingSize) ||
+            nInputs < 1 || nInputs > MAX_ANON_INPUTS ||
+            nRingSize < MIN_RINGSIZE || nRingSize > MAX_RINGSIZE ||
+            txin.scriptData.stack.size() != 1 || txin.scriptWitness.stack.size() != 2 ||
+            txin.scriptData.stack[0].size() != nInputs * 33 ||
+            txin.scriptWitness.stack[1].size() != (1 + (nInputs + 1) * nRingSize) * 32 + (split_commitments ? 33 : 0)) {
+            return set_error(err, bitcoinconsensus_ERR_TX_NOT_ANON);
+        }
+        ring_ofs += nInputs * nRingSize;
+    }
+    if (ring_ofs != nRingMembers) {
+        return set_error(err, bitcoinconsensus_ERR_RING_MEMBERS);
+    }
+    set_error(err, bitcoinconsensus_ERR_OK);
+
+    secp256k1_pedersen_commitment plain_out;
+    CAmount plain_value_out = 0;
+    if (!GetPlainOutCommitment(*tx, plain_out, plain_value_out) || plain_value_out == 0) {
+        return 0;
+    }
+    std::vector<const uint8_t*> vpOutCommits{plain_out.data};
+    for (const auto &txout : tx->vpout) {
+        const secp256k1_pedersen_commitment *pc = txout->GetPCommitment();
+        if (pc) {
+            vpOutCommits.push_back(pc->data);
+        }
+    }
+
+    std::vector<std::function<bool()>> checks;
+    std::vector<const uint8_t*> vpInputSplitCommits;
+    ring_ofs = 0;
+    for (size_t nIn = 0; nIn < tx->vin.size(); ++nIn) {
+        uint32_t nInputs, nRingSize;
+        tx->vin[nIn].GetAnonInfo(nInputs, nRingSize);
+        const std::vector<uint8_t> &vDL = tx->vin[nIn].scriptWitness.stack[1];
+        const uint8_t *split_commit = split_commitments ? &vDL[(1 + (nInputs + 1) * nRingSize) * 32] : nullptr;
+        if (split_commit) {
+            vpInputSplitCommits.push_back(split_commit);
+        }
+        const unsigned char *pubkeys = ringPubkeys + ring_ofs * 33;
+        const unsigned char *commitments = ringCommitments + ring_ofs * 33;
+        ring_ofs += nInputs * nRingSize;
+
+        checks.push_back([&, nIn, nInputs, nRingSize, split_commit, pubkeys, commitments]() {
+            size_t nCols = nRingSize, nRows = nInputs + 1;
+            std::vector<uint8_t> vM(nCols * nRows * 33);
+            memcpy(vM.data(), pubkeys, nCols * nInputs * 33);
+            std::vector<const uint8_t*> vpInCommits(nCols * nInputs);
+            for (size_t i = 0; i < vpInCommits.size(); ++i) {
+                vpInCommits[i] = commitments + i * 33;
+            }
+            std::vector<const uint8_t*> out_commits = split_commit ? std::vector<const uint8_t*>{split_commit} : vpOutCommits;
+            const CTxIn &txin = tx->vin[nIn];
+            const std::vector<uint8_t> &vDL = txin.scriptWitness.stack[1];
+            return 0 == secp256k1_prepare_mlsag(vM.data(), nullptr,
+                out_commits.size(), 0, nCols, nRows,
+                vpInCommits.data(), out_commits.data(), nullptr) &&
+                0 == secp256k1_verify_mlsag(tx->GetHash().begin(), nCols, nRows,
+                vM.data(), txin.scriptData.stack[0].data(), vDL.data(), vDL.data() + 32);
+        });
+    }
+    if (!CheckGroup(std::move(checks)).Run(submit, pool)) {
+        return 0;
+    }
+
+    // Verify commitment sums match
+    if (split_commitments &&
+        1 != secp256k1_pedersen_verify_tally(GetBlindVerifyContext().ctx,
+            (const secp256k1_pedersen_commitment* const*)vpInputSplitCommits.data(), vpInputSplitCommits.size(),
+            (const secp256k1_pedersen_commitment* const*)vpOutCommits.data(), vpOutCommits.size())) {
+        return 0;
+    }
+    return 1;
+}
+
 unsigned int bitcoinconsensus_version()
 {
     // Just use the API version for now
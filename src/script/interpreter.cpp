@@ -1385,22 +1385,23 @@ uint256 GetOutputsSHA256(const T& txTo)
 
     bool have_non_plain = false;
     if (txTo.IsParticlVersion()) {
+        // Output types are collected in the same pass, they're committed to after all outputs
+        std::vector<uint8_t> types(txTo.vpout.size());
         for (unsigned int n = 0; n < txTo.vpout.size(); n++) {
             ss << *txTo.vpout[n];
-            if (txTo.vpout[n]->GetType() != OUTPUT_STANDARD) {
+            types[n] = txTo.vpout[n]->GetType();
+            if (types[n] != OUTPUT_STANDARD) {
                 have_non_plain = true;
             }
         }
+        if (have_non_plain && (txTo.nVersion & 0xFF) > PARTICL_TXN_VERSION) {
+            ss.write(MakeByteSpan(types));
+        }
     } else {
         for (const auto& txout : txTo.vout) {
             ss << txout;
         }
     }
-    if (have_non_plain && (txTo.nVersion & 0xFF) > PARTICL_TXN_VERSION) {
-        for (unsigned int n = 0; n < txTo.vpout.size(); n++) {
-            ss << txTo.vpout[n]->GetType();
-        }
-    }
     return ss.GetSHA256();
 }
 
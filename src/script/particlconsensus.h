@@ -31,7 +31,7 @@
 extern "C" {
 #endif
 
-#define BITCOINCONSENSUS_API_VER 1
+#define BITCOINCONSENSUS_API_VER 2
 
 typedef enum bitcoinconsensus_error_t
 {
@@ -41,6 +41,8 @@ typedef enum bitcoinconsensus_error_t
     bitcoinconsensus_ERR_TX_DESERIALIZE,
     bitcoinconsensus_ERR_AMOUNT_REQUIRED,
     bitcoinconsensus_ERR_INVALID_FLAGS,
+    bitcoinconsensus_ERR_TX_NOT_ANON,
+    bitcoinconsensus_ERR_RING_MEMBERS,
 } bitcoinconsensus_error;
 
 /** Script verification flags */
@@ -70,6 +72,41 @@ EXPORT_SYMBOL int bitcoinconsensus_verify_script_with_amount(const unsigned char
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, bitcoinconsensus_error* err);
 
+/// Runs task(task_data) on a caller provided thread pool, the task may run
+/// before submit returns. The library waits for all tasks it submitted.
+typedef void (*bitcoinconsensus_task)(void* task_data);
+typedef void (*bitcoinconsensus_submit_task)(void* pool, bitcoinconsensus_task task, void* task_data);
+
+/// Returns 1 if all rangeproofs of the blinded and anon outputs of the
+/// serialized transaction pointed to by txTo are valid.
+/// Outputs sharing an aggregated bulletproof are checked together, one task per
+/// proof is passed to submit if not nullptr, else the proofs are checked in turn.
+/// If not nullptr, err will contain an error/success code for the operation
+EXPORT_SYMBOL int bitcoinconsensus_verify_rangeproofs(const unsigned char *txTo, unsigned int txToLen,
+                                                      bitcoinconsensus_submit_task submit, void* pool,
+                                                      bitcoinconsensus_error* err);
+
+/// Returns 1 if the plain value spent plus the nCommitmentsIn 33 byte
+/// commitments pointed to by commitmentsIn balance the plain outputs, fee and
+/// output commitments of the serialized transaction pointed to by txTo.
+/// Blinded outputs spent by frozen outputs are not supported.
+EXPORT_SYMBOL int bitcoinconsensus_verify_commitment_sum(const unsigned char *txTo, unsigned int txToLen,
+                                                         int64_t plainValueIn,
+                                                         const unsigned char *commitmentsIn, unsigned int nCommitmentsIn,
+                                                         bitcoinconsensus_error* err);
+
+/// Returns 1 if the MLSAG signatures of all anon inputs of the serialized
+/// transaction pointed to by txTo are valid and, for transactions with more than
+/// one input, the split commitments balance the outputs.
+/// ringPubkeys and ringCommitments hold nRingMembers 33 byte points, the ring
+/// members of every input in the order their indices appear in the input.
+/// Ring membership, depth and key image spends are left to the caller.
+EXPORT_SYMBOL int bitcoinconsensus_verify_mlsag(const unsigned char *txTo, unsigned int txToLen,
+                                                const unsigned char *ringPubkeys, const unsigned char *ringCommitments,
+                                                unsigned int nRingMembers,
+                                                bitcoinconsensus_submit_task submit, void* pool,
+                                                bitcoinconsensus_error* err);
+
 EXPORT_SYMBOL unsigned int bitcoinconsensus_version();
 
 #ifdef __cplusplus
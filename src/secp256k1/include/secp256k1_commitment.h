@@ -81,6 +81,48 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_pedersen_commit(
   const secp256k1_generator *blind_gen
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(5) SECP256K1_ARG_NONNULL(6);
 
+/** Opaque table of precomputed multiples of a value generator, used by secp256k1_pedersen_commit_precomp. */
+typedef struct secp256k1_pedersen_precomp secp256k1_pedersen_precomp;
+
+/** Allocate and fill a table of multiples of a value generator, 16KiB in size.
+ *  Returns a pointer to the table on success, NULL on failure.
+ *  In:     ctx:        pointer to a context object (cannot be NULL)
+ *          value_gen:  value generator 'h'
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT secp256k1_pedersen_precomp *secp256k1_pedersen_precomp_create(
+  const secp256k1_context* ctx,
+  const secp256k1_generator *value_gen
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2);
+
+/** Destroy a table made by secp256k1_pedersen_precomp_create.
+ *  In:     ctx:        pointer to a context object (cannot be NULL)
+ *          precomp:    table to destroy, may be NULL
+ */
+SECP256K1_API void secp256k1_pedersen_precomp_destroy(
+  const secp256k1_context* ctx,
+  secp256k1_pedersen_precomp *precomp
+) SECP256K1_ARG_NONNULL(1);
+
+/** Generate a Pedersen commitment with a precomputed value generator, blind * G + value * h.
+ *  The result is the same as secp256k1_pedersen_commit with blind_gen secp256k1_generator_const_g.
+ *  Both multiplications are table based and constant time, G uses the table of the signing context.
+ *  Returns 1: Commitment successfully created.
+ *          0: Error. The blinding factor is larger than the group order or results in the point
+ *             at infinity.
+ *  In:     ctx:        pointer to a context object initialized for signing (cannot be NULL)
+ *          blind:      pointer to a 32-byte blinding factor (cannot be NULL)
+ *          value:      unsigned 64-bit integer value to commit to.
+ *          precomp:    table for the value generator 'h' (cannot be NULL)
+ *  Out:    commit:     pointer to the commitment (cannot be NULL)
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_pedersen_commit_precomp(
+  const secp256k1_context* ctx,
+  secp256k1_pedersen_commitment *commit,
+  const unsigned char *blind,
+  uint64_t value,
+  const secp256k1_pedersen_precomp *precomp
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(5);
+
 /** Computes the sum of multiple positive and negative blinding factors.
  *  Returns 1: Sum successfully computed.
  *          0: Error. A blinding factor is larger than the group order
@@ -108,6 +108,87 @@ int secp256k1_pedersen_commit(const secp256k1_context* ctx, secp256k1_pedersen_c
     return ret;
 }
 
+secp256k1_pedersen_precomp *secp256k1_pedersen_precomp_create(const secp256k1_context* ctx, const secp256k1_generator *value_gen) {
+    const size_t n = PEDERSEN_PRECOMP_WINDOWS * PEDERSEN_PRECOMP_POINTS;
+    secp256k1_pedersen_precomp *ret;
+    secp256k1_gej *pointsj;
+    secp256k1_ge *points;
+    secp256k1_gej basej, sumj;
+    secp256k1_ge gen;
+    size_t j, k;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(value_gen != NULL);
+
+    ret = (secp256k1_pedersen_precomp *)checked_malloc(&ctx->error_callback, sizeof(*ret));
+    pointsj = (secp256k1_gej *)checked_malloc(&ctx->error_callback, (n + 1) * sizeof(*pointsj));
+    points = (secp256k1_ge *)checked_malloc(&ctx->error_callback, (n + 1) * sizeof(*points));
+    if (ret == NULL || pointsj == NULL || points == NULL) {
+        free(ret);
+        free(pointsj);
+        free(points);
+        return NULL;
+    }
+
+    /* The generator is public, variable time is fine. */
+    secp256k1_generator_load(&gen, value_gen);
+    secp256k1_gej_set_ge(&basej, &gen);
+    secp256k1_gej_set_infinity(&sumj);
+    for (j = 0; j < PEDERSEN_PRECOMP_WINDOWS; j++) {
+        /* basej = 16^j * G2 */
+        secp256k1_gej_add_var(&sumj, &sumj, &basej, NULL);
+        pointsj[j * PEDERSEN_PRECOMP_POINTS] = basej;
+        for (k = 1; k < PEDERSEN_PRECOMP_POINTS; k++) {
+            secp256k1_gej_add_var(&pointsj[j * PEDERSEN_PRECOMP_POINTS + k], &pointsj[j * PEDERSEN_PRECOMP_POINTS + k - 1], &basej, NULL);
+        }
+        basej = pointsj[j * PEDERSEN_PRECOMP_POINTS + PEDERSEN_PRECOMP_POINTS - 1];
+    }
+    secp256k1_gej_neg(&pointsj[n], &sumj);
+    secp256k1_ge_set_all_gej_var(points, pointsj, n + 1);
+
+    for (j = 0; j < PEDERSEN_PRECOMP_WINDOWS; j++) {
+        for (k = 0; k < PEDERSEN_PRECOMP_POINTS; k++) {
+            secp256k1_ge_to_storage(&ret->table[j][k], &points[j * PEDERSEN_PRECOMP_POINTS + k]);
+        }
+    }
+    secp256k1_ge_to_storage(&ret->offset, &points[n]);
+
+    free(pointsj);
+    free(points);
+    return ret;
+}
+
+void secp256k1_pedersen_precomp_destroy(const secp256k1_context* ctx, secp256k1_pedersen_precomp *precomp) {
+    (void) ctx;
+    free(precomp);
+}
+
+int secp256k1_pedersen_commit_precomp(const secp256k1_context* ctx, secp256k1_pedersen_commitment *commit, const unsigned char *blind, uint64_t value, const secp256k1_pedersen_precomp *precomp) {
+    secp256k1_gej rj;
+    secp256k1_ge r;
+    secp256k1_scalar sec;
+    int overflow;
+    int ret = 0;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_gen_context_is_built(&ctx->ecmult_gen_ctx));
+    ARG_CHECK(commit != NULL);
+    ARG_CHECK(blind != NULL);
+    ARG_CHECK(precomp != NULL);
+    secp256k1_scalar_set_b32(&sec, blind, &overflow);
+    if (!overflow) {
+        secp256k1_ecmult_gen(&ctx->ecmult_gen_ctx, &rj, &sec);
+        secp256k1_pedersen_ecmult_precomp(&rj, value, precomp);
+        if (!secp256k1_gej_is_infinity(&rj)) {
+            secp256k1_ge_set_gej(&r, &rj);
+            secp256k1_pedersen_commitment_save(commit, &r);
+            ret = 1;
+        }
+        secp256k1_gej_clear(&rj);
+        secp256k1_ge_clear(&r);
+    }
+    secp256k1_scalar_clear(&sec);
+    return ret;
+}
+
 /** Takes a list of n pointers to 32 byte blinding values, the first negs of which are treated with positive sign and the rest
  *  negative, then calculates an additional blinding value that adds to zero.
  */
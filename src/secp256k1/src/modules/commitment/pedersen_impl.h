@@ -35,4 +35,36 @@ SECP256K1_INLINE static void secp256k1_pedersen_ecmult(secp256k1_gej *rj, const
     secp256k1_scalar_clear(&vs);
 }
 
+/* 4 bit windows over a 64 bit value. */
+#define PEDERSEN_PRECOMP_WINDOWS 16
+#define PEDERSEN_PRECOMP_POINTS 16
+
+struct secp256k1_pedersen_precomp {
+    /* table[j][k] = (k + 1) * 16^j * G2, every window adds a point so no entry is infinity. */
+    secp256k1_ge_storage table[PEDERSEN_PRECOMP_WINDOWS][PEDERSEN_PRECOMP_POINTS];
+    /* -(sum of 16^j) * G2, removes the + 1 of every window. */
+    secp256k1_ge_storage offset;
+};
+
+/* Add value * G2 to rj in constant time. */
+static void secp256k1_pedersen_ecmult_precomp(secp256k1_gej *rj, uint64_t value, const secp256k1_pedersen_precomp *precomp) {
+    secp256k1_ge_storage entry;
+    secp256k1_ge add;
+    size_t j, k;
+
+    secp256k1_ge_from_storage(&add, &precomp->offset);
+    secp256k1_gej_add_ge(rj, rj, &add);
+    for (j = 0; j < PEDERSEN_PRECOMP_WINDOWS; j++) {
+        unsigned int bits = (value >> (4 * j)) & 0xf;
+        entry = precomp->table[j][0];
+        for (k = 1; k < PEDERSEN_PRECOMP_POINTS; k++) {
+            secp256k1_ge_storage_cmov(&entry, &precomp->table[j][k], k == bits);
+        }
+        secp256k1_ge_from_storage(&add, &entry);
+        secp256k1_gej_add_ge(rj, rj, &add);
+    }
+    secp256k1_ge_clear(&add);
+    memset(&entry, 0, sizeof(entry));
+}
+
 #endif
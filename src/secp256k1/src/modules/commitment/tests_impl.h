@@ -218,6 +218,33 @@ void test_multiple_generators(void) {
 }
 #undef MAX_N_GENS
 
+static void test_pedersen_precomp(void) {
+    secp256k1_pedersen_precomp *precomp;
+    secp256k1_pedersen_commitment commit, commit_precomp;
+    unsigned char blind[32];
+    const uint64_t values[] = {0, 1, 15, 16, 0xffffffffffffffffULL, 0x8000000000000000ULL};
+    size_t i;
+
+    precomp = secp256k1_pedersen_precomp_create(ctx, &secp256k1_generator_const_h);
+    CHECK(precomp != NULL);
+    for (i = 0; i < sizeof(values) / sizeof(values[0]) + 10; i++) {
+        uint64_t value = i < sizeof(values) / sizeof(values[0]) ? values[i] : secp256k1_testrand64();
+        secp256k1_testrand256(blind);
+        CHECK(secp256k1_pedersen_commit(ctx, &commit, blind, value, &secp256k1_generator_const_h, &secp256k1_generator_const_g));
+        CHECK(secp256k1_pedersen_commit_precomp(ctx, &commit_precomp, blind, value, precomp));
+        CHECK(secp256k1_memcmp_var(&commit, &commit_precomp, sizeof(commit)) == 0);
+    }
+
+    /* A zero blinding factor commits to value * h only */
+    memset(blind, 0, 32);
+    CHECK(secp256k1_pedersen_commit(ctx, &commit, blind, 12345, &secp256k1_generator_const_h, &secp256k1_generator_const_g));
+    CHECK(secp256k1_pedersen_commit_precomp(ctx, &commit_precomp, blind, 12345, precomp));
+    CHECK(secp256k1_memcmp_var(&commit, &commit_precomp, sizeof(commit)) == 0);
+    CHECK(!secp256k1_pedersen_commit_precomp(ctx, &commit_precomp, blind, 0, precomp));
+
+    secp256k1_pedersen_precomp_destroy(ctx, precomp);
+}
+
 void run_commitment_tests(void) {
     int i;
     test_commitment_api();
@@ -225,6 +252,7 @@ void run_commitment_tests(void) {
         test_pedersen();
     }
     test_multiple_generators();
+    test_pedersen_precomp();
 }
 
 #endif
@@ -0,0 +1,217 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <smsg/bucketfile.h>
+
+#include <smsg/smessage.h>
+#include <logging.h>
+#include <util/syserror.h>
+#include <util/system.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace smsg {
+
+BucketFileReader::BucketFileReader(const fs::path &path)
+{
+#ifndef WIN32
+    int fd = open(fs::PathToString(path).c_str(), O_RDONLY);
+    if (fd == -1) {
+        LogPrintf("Error opening file: %s\n", SysErrorString(errno));
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        m_size = st.st_size;
+        m_open = true;
+        if (m_size > 0) {
+            void *p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                posix_madvise(p, m_size, POSIX_MADV_SEQUENTIAL);
+                m_mapped = p;
+                m_data = (const uint8_t*)p;
+            }
+        }
+    }
+    close(fd);
+    if (m_data || (m_open && m_size == 0)) {
+        return;
+    }
+    m_open = false;
+    m_size = 0;
+#endif
+    FILE *fp = fsbridge::fopen(path, "rb");
+    if (!fp) {
+        LogPrintf("Error opening file: %s\n", SysErrorString(errno));
+        return;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        m_buffer.insert(m_buffer.end(), buf, buf + n);
+    }
+    fclose(fp);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    m_open = true;
+}
+
+BucketFileReader::~BucketFileReader()
+{
+#ifndef WIN32
+    if (m_mapped) {
+        munmap(m_mapped, m_size);
+    }
+#endif
+}
+
+bool BucketFileReader::Next(SecureMessage &smsg, const uint8_t *&pHeader, const uint8_t *&pPayload, size_t &offset)
+{
+    if (m_size - m_pos < SMSG_HDR_LEN) {
+        return false;
+    }
+    smsg.set(m_data + m_pos);
+    if (m_size - m_pos - SMSG_HDR_LEN < smsg.nPayload) {
+        LogPrintf("%s: Truncated message at offset %u.\n", __func__, m_pos);
+        return false;
+    }
+    offset = m_pos;
+    pHeader = m_data + m_pos;
+    pPayload = pHeader + SMSG_HDR_LEN;
+    m_pos += SMSG_HDR_LEN + smsg.nPayload;
+    return true;
+}
+
+BucketFileWriters::~BucketFileWriters()
+{
+    CloseAll(true);
+}
+
+void BucketFileWriters::CloseWriter(std::map<std::string, Writer>::iterator it, bool sync)
+{
+    AssertLockHeld(m_mutex);
+    Writer &writer = it->second;
+    if (fflush(writer.fp) != 0) {
+        LogPrintf("%s: fflush failed: %s.\n", __func__, SysErrorString(errno));
+    } else
+    if (sync && writer.unsynced && !FileCommit(writer.fp)) {
+        LogPrintf("%s: FileCommit failed for %s.\n", __func__, it->first);
+    }
+    fclose(writer.fp);
+    m_writers.erase(it);
+}
+
+bool BucketFileWriters::Append(const fs::path &path, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, size_t &offset)
+{
+    LOCK(m_mutex);
+    std::string key = fs::PathToString(path);
+    auto it = m_writers.find(key);
+    if (it == m_writers.end()) {
+        while (m_writers.size() >= std::max<size_t>(1, m_max_open)) {
+            auto it_lru = m_writers.begin();
+            for (auto itw = m_writers.begin(); itw != m_writers.end(); ++itw) {
+                if (itw->second.last_used < it_lru->second.last_used) {
+                    it_lru = itw;
+                }
+            }
+            CloseWriter(it_lru, true);
+        }
+
+        Writer writer;
+        errno = 0;
+        if (!(writer.fp = fsbridge::fopen(path, "ab"))) {
+            return error("%s: fopen failed: %s.", __func__, SysErrorString(errno));
+        }
+        writer.buffer = std::make_unique<char[]>(m_buffer_size);
+        setvbuf(writer.fp, writer.buffer.get(), _IOFBF, m_buffer_size);
+
+        // On windows ftell will always return 0 after fopen(ab), call fseek to set.
+        long ofs;
+        if (fseek(writer.fp, 0, SEEK_END) != 0 || (ofs = ftell(writer.fp)) < 0) {
+            fclose(writer.fp);
+            return error("%s: fseek failed: %s.", __func__, SysErrorString(errno));
+        }
+        writer.size = ofs;
+        it = m_writers.emplace(key, std::move(writer)).first;
+    }
+
+    Writer &writer = it->second;
+    errno = 0;
+    if (fwrite(pHeader, sizeof(uint8_t), SMSG_HDR_LEN, writer.fp) != (size_t)SMSG_HDR_LEN
+        || fwrite(pPayload, sizeof(uint8_t), nPayload, writer.fp) != nPayload) {
+        // Part of the record may have been written, the size is read again on reopening
+        int err = errno;
+        CloseWriter(it, false);
+        return error("%s: fwrite failed: %s.", __func__, SysErrorString(err));
+    }
+    offset = writer.size;
+    writer.size += SMSG_HDR_LEN + nPayload;
+    writer.last_used = ++m_use_counter;
+    writer.used = true;
+    writer.unsynced = true;
+    return true;
+}
+
+bool BucketFileWriters::Flush(const fs::path &path)
+{
+    LOCK(m_mutex);
+    auto it = m_writers.find(fs::PathToString(path));
+    if (it == m_writers.end()) {
+        return true;
+    }
+    if (fflush(it->second.fp) != 0) {
+        return error("%s: fflush failed: %s.", __func__, SysErrorString(errno));
+    }
+    return true;
+}
+
+bool BucketFileWriters::FlushAll(bool sync, bool close_idle)
+{
+    LOCK(m_mutex);
+    bool rv = true;
+    for (auto it = m_writers.begin(); it != m_writers.end(); ) {
+        Writer &writer = it->second;
+        if (close_idle && !writer.used) {
+            CloseWriter(it++, sync);
+            continue;
+        }
+        if (fflush(writer.fp) != 0) {
+            rv = error("%s: fflush failed: %s.", __func__, SysErrorString(errno));
+        } else
+        if (sync && writer.unsynced) {
+            if (FileCommit(writer.fp)) {
+                writer.unsynced = false;
+            } else {
+                rv = false;
+            }
+        }
+        writer.used = false;
+        ++it;
+    }
+    return rv;
+}
+
+void BucketFileWriters::Close(const fs::path &path)
+{
+    LOCK(m_mutex);
+    auto it = m_writers.find(fs::PathToString(path));
+    if (it != m_writers.end()) {
+        CloseWriter(it, false);
+    }
+}
+
+void BucketFileWriters::CloseAll(bool sync)
+{
+    LOCK(m_mutex);
+    while (!m_writers.empty()) {
+        CloseWriter(m_writers.begin(), sync);
+    }
+}
+
+} // namespace smsg
@@ -0,0 +1,103 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_SMSG_BUCKETFILE_H
+#define PARTICL_SMSG_BUCKETFILE_H
+
+#include <fs.h>
+#include <sync.h>
+
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace smsg {
+
+class SecureMessage;
+
+/**
+ * Sequential reader over a bucket file of concatenated header+payload records.
+ *
+ * The file is memory mapped where possible, the header and payload pointers
+ * returned by Next point into the mapping and are valid for the lifetime of
+ * the reader.  Falls back to reading the whole file into memory.
+ * The caller must hold cs_smsg so the file is not appended to concurrently.
+ */
+class BucketFileReader
+{
+public:
+    explicit BucketFileReader(const fs::path &path);
+    ~BucketFileReader();
+
+    BucketFileReader(const BucketFileReader&) = delete;
+    BucketFileReader& operator=(const BucketFileReader&) = delete;
+
+    bool IsOpen() const { return m_open; }
+
+    /** Returns false at the end of the file or on a truncated record. */
+    bool Next(SecureMessage &smsg, const uint8_t *&pHeader, const uint8_t *&pPayload, size_t &offset);
+
+private:
+    bool m_open{false};
+    const uint8_t *m_data{nullptr};
+    size_t m_size{0};
+    size_t m_pos{0};
+    void *m_mapped{nullptr};
+    std::vector<uint8_t> m_buffer;
+};
+
+/**
+ * Pool of open append handles to recently written bucket files.
+ *
+ * Records are buffered, FlushAll pushes them to the OS and optionally syncs.
+ * Other access to a pooled file must Flush it first to read it, or Close it
+ * to modify, rename or remove it.  The least recently used handle is closed
+ * when more than max_open files are written.
+ */
+class BucketFileWriters
+{
+public:
+    explicit BucketFileWriters(size_t max_open, size_t buffer_size) : m_max_open(max_open), m_buffer_size(buffer_size) {}
+    ~BucketFileWriters();
+
+    BucketFileWriters(const BucketFileWriters&) = delete;
+    BucketFileWriters& operator=(const BucketFileWriters&) = delete;
+
+    /** Append header and payload, offset is set to the position of the header in the file. */
+    bool Append(const fs::path &path, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, size_t &offset) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Write out the buffered records of path, if open. */
+    bool Flush(const fs::path &path) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Write out all buffered records, sync commits them to disk. close_idle closes handles unused since the last call. */
+    bool FlushAll(bool sync, bool close_idle) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void Close(const fs::path &path) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void CloseAll(bool sync) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    size_t NumOpen() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) { return WITH_LOCK(m_mutex, return m_writers.size()); }
+
+private:
+    struct Writer {
+        FILE *fp{nullptr};
+        std::unique_ptr<char[]> buffer;
+        size_t size{0};         // File size including buffered records
+        uint64_t last_used{0};
+        bool used{false};       // Appended to since the last FlushAll
+        bool unsynced{false};
+    };
+
+    void CloseWriter(std::map<std::string, Writer>::iterator it, bool sync) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    std::map<std::string, Writer> m_writers GUARDED_BY(m_mutex);
+    uint64_t m_use_counter GUARDED_BY(m_mutex) = 0;
+    const size_t m_max_open;
+    const size_t m_buffer_size;
+};
+
+} // namespace smsg
+
+#endif // PARTICL_SMSG_BUCKETFILE_H
@@ -0,0 +1,98 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <smsg/compress.h>
+
+#include <lz4/lz4.h>
+
+
+namespace smsg {
+
+/**
+ * Fragments common in the JSON sent between applications over smsg.
+ * LZ4 matches against the end of the dictionary first, frequent fragments are last.
+ * The content of a dictionary must never change once released, add a new id instead.
+ */
+static const char DICT_JSON_1[] =
+    "{\"jsonrpc\":\"2.0\",\"method\":\"\",\"params\":[],\"id\":1}"
+    "{\"result\":null,\"error\":{\"code\":-1,\"message\":\"\"}}"
+    "\"shippingDestinations\":[],\"images\":[],\"options\":[],\"featuredImage\":"
+    "\"location\":{\"country\":\"\",\"address\":\"\",\"gps\":{\"lng\":0,\"lat\":0,\"title\":\"\",\"description\":\"\"}},"
+    "\"shippingPrice\":{\"domestic\":0,\"international\":0},"
+    "\"escrow\":{\"type\":\"MAD_CT\",\"ratio\":{\"buyer\":100,\"seller\":100},\"releaseType\":\"ANON\"},"
+    "\"cryptocurrency\":[{\"currency\":\"PART\",\"basePrice\":"
+    "\"payment\":{\"type\":\"SALE\",\"escrow\":"
+    "\"information\":{\"title\":\"\",\"shortDescription\":\"\",\"longDescription\":\"\",\"category\":[\"\"],"
+    "\"item\":{\"information\":"
+    "\"messaging\":[{\"protocol\":\"SMSG\",\"publicKey\":\"\"}],"
+    "\"objects\":[{\"type\":\"\",\"description\":\"\",\"value\":\"\"}],"
+    "{\"action\":{\"type\":\"MPA_LISTING_ADD\",\"MPA_BID\",\"MPA_ACCEPT\",\"MPA_REJECT\",\"MPA_CANCEL\","
+    "\"MPA_LOCK\",\"MPA_COMPLETE\",\"MPA_SHIP\",\"MPA_RELEASE\",\"MPA_REFUND\",\"MPA_PROPOSAL_ADD\",\"MPA_VOTE\","
+    "\"MPA_COMMENT_ADD\",\"MPA_MARKET_ADD\",\"MPA_MARKET_IMAGE_ADD\",\"MPA_LISTING_IMAGE_ADD\","
+    "\"hashedItem\":\"\",\"bidder\":\"\",\"seller\":\"\",\"buyer\":\"\",\"receiver\":\"\",\"market\":\"\","
+    "\"sender\":\"\",\"address\":\"\",\"amount\":0,\"fee\":0,\"txid\":\"\",\"vout\":0,\"pubkey\":\"\","
+    "\"signature\":\"\",\"hash\":\"\",\"objectHash\":\"\",\"target\":\"\",\"title\":\"\",\"description\":\"\","
+    "\"data\":\"\",\"encoding\":\"BASE64\",\"contentReference\":\"\",\"protocol\":\"LOCAL\",\"imageHash\":\"\","
+    "\"created\":0,\"updated\":0,\"expires\":0,\"expiredAt\":0,\"postedAt\":0,\"receivedAt\":0,"
+    "\"status\":\"ok\",\"state\":\"\",\"result\":{},\"error\":null,\"value\":\"\",\"values\":[],\"items\":[],"
+    "\"version\":\"\",\"name\":\"\",\"key\":\"\",\"content\":\"\",\"payload\":{},\"timestamp\":0,"
+    "\"from\":\"\",\"to\":\"\",\"type\":\"\",\"id\":\"\",\"generated\":,\"hash\":\""
+    ":true,:false,:null,\":\"\",\"\":\"";
+
+struct Dictionary {
+    const char *data;
+    int size;
+};
+
+static bool GetDict(uint8_t dict_id, Dictionary &dict)
+{
+    switch (dict_id) {
+        case SMSG_DICT_JSON_1:
+            dict = {DICT_JSON_1, (int)sizeof(DICT_JSON_1) - 1};
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+bool IsKnownDict(uint8_t dict_id)
+{
+    Dictionary dict;
+    return GetDict(dict_id, dict);
+}
+
+bool CompressWithDict(uint8_t dict_id, const uint8_t *data, size_t len, std::vector<uint8_t> &compressed)
+{
+    Dictionary dict;
+    if (!GetDict(dict_id, dict) || len > SMSG_PLAIN_LEN_MASK) {
+        return false;
+    }
+    compressed.resize(LZ4_compressBound(len));
+
+    LZ4_stream_t *stream = LZ4_createStream();
+    if (!stream) {
+        return false;
+    }
+    LZ4_loadDict(stream, dict.data, dict.size);
+    int len_compressed = LZ4_compress_fast_continue(stream, (const char*)data, (char*)compressed.data(), len, compressed.size(), 1);
+    LZ4_freeStream(stream);
+    if (len_compressed < 1) {
+        return false;
+    }
+    compressed.resize(len_compressed);
+    return true;
+}
+
+bool DecompressWithDict(uint8_t dict_id, const uint8_t *data, size_t len, uint8_t *out, size_t len_plain)
+{
+    Dictionary dict;
+    if (!GetDict(dict_id, dict)) {
+        return false;
+    }
+    int rv = LZ4_decompress_safe_usingDict((const char*)data, (char*)out, len, len_plain, dict.data, dict.size);
+    return rv >= 0 && (size_t)rv == len_plain;
+}
+
+} // namespace smsg
@@ -0,0 +1,38 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_SMSG_COMPRESS_H
+#define PARTICL_SMSG_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace smsg {
+
+/**
+ * The length of the plain text in the encrypted payload header is below 2^24,
+ * the top byte selects the dictionary the text was compressed with.
+ * 0 is plain LZ4, used for texts longer than 128 bytes, shorter texts are stored as is.
+ * Receivers that predate a dictionary fail to decompress messages using it.
+ */
+const uint8_t SMSG_DICT_NONE = 0;
+const uint8_t SMSG_DICT_JSON_1 = 1; // Machine to machine JSON, marketplace messages
+const uint32_t SMSG_PLAIN_LEN_MASK = 0x00FFFFFF;
+
+inline uint32_t PackPlainLength(uint32_t len, uint8_t dict_id) { return len | ((uint32_t)dict_id << 24); }
+inline uint8_t UnpackDictId(uint32_t field) { return field >> 24; }
+inline uint32_t UnpackPlainLength(uint32_t field) { return field & SMSG_PLAIN_LEN_MASK; }
+
+/** Returns false if dict_id is not a known dictionary */
+bool IsKnownDict(uint8_t dict_id);
+
+/** LZ4 compress data using the built in dictionary dict_id, returns false on failure */
+bool CompressWithDict(uint8_t dict_id, const uint8_t *data, size_t len, std::vector<uint8_t> &compressed);
+/** Decompress to exactly len_plain bytes in out */
+bool DecompressWithDict(uint8_t dict_id, const uint8_t *data, size_t len, uint8_t *out, size_t len_plain);
+
+} // namespace smsg
+
+#endif // PARTICL_SMSG_COMPRESS_H
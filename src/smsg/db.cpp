@@ -8,10 +8,14 @@
 #include <streams.h>
 #include <clientversion.h>
 #include <compat/endian.h>
+#include <logging.h>
+#include <util/time.h>
 
 #include <leveldb/db.h>
 #include <string.h>
 
+#include <atomic>
+
 namespace smsg {
 
 const std::string DBK_PUBLICKEY         = "pk";
@@ -23,11 +27,56 @@ const std::string DBK_STASHED           = "TM";
 const std::string DBK_PURGED_TOKEN      = "pm";
 const std::string DBK_FUNDING_TX_DATA   = "fd";
 const std::string DBK_FUNDING_TX_LINK   = "fl";
+const std::string DBK_FUNDING_UNDO      = "fu";
 const std::string DBK_BEST_BLOCK        = "bb";
+const std::string DBK_INDEX_ADDRESS     = "ia";
+const std::string DBK_INDEX_UNREAD      = "iu";
+const std::string DBK_COUNTER           = "cn";
+const std::string DBK_INDEX_VERSION     = "iv";
+const std::string DBK_NOTIFY_CURSOR     = "nc";
 
 RecursiveMutex cs_smsgDB;
 leveldb::DB *smsgDB = nullptr;
 
+static std::atomic<size_t> nUnsyncedWrites{0};
+static std::atomic<int64_t> nLastSyncTime{0};
+
+/** Single record writes are not synced individually, every SMSG_DB_SYNC_WRITES'th
+ *  write, or FlushDB, syncs the log and with it all the writes before it. */
+static leveldb::WriteOptions GroupWriteOptions()
+{
+    leveldb::WriteOptions writeOptions;
+    if (++nUnsyncedWrites >= SMSG_DB_SYNC_WRITES) {
+        writeOptions.sync = true;
+        nUnsyncedWrites = 0;
+        nLastSyncTime = GetTime();
+    }
+    return writeOptions;
+}
+
+bool FlushDB(bool force)
+{
+    LOCK(cs_smsgDB);
+    if (!smsgDB || nUnsyncedWrites == 0) {
+        return true;
+    }
+    int64_t now = GetTime();
+    if (!force && now - nLastSyncTime < SMSG_DB_SYNC_INTERVAL) {
+        return true;
+    }
+
+    leveldb::WriteBatch batch;
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    leveldb::Status s = smsgDB->Write(writeOptions, &batch);
+    if (!s.ok()) {
+        return error("%s failed: %s\n", __func__, s.ToString());
+    }
+    nUnsyncedWrites = 0;
+    nLastSyncTime = now;
+    return true;
+}
+
 bool SecMsgDB::Open(const char *pszMode)
 {
     if (smsgDB) {
@@ -99,6 +148,9 @@ bool SecMsgDB::ScanBatch(const CDataStream &key, std::string *value, bool *delet
     }
 
     *deleted = false;
+    if (m_batch_keys.count(key.str()) == 0) {
+        return false;
+    }
     SecMsgBatchScanner scanner;
     scanner.needle = key.str();
     scanner.deleted = deleted;
@@ -111,6 +163,240 @@ bool SecMsgDB::ScanBatch(const CDataStream &key, std::string *value, bool *delet
     return scanner.foundEntry;
 }
 
+void SecMsgDB::BatchPut(const std::string &key, const std::string &value)
+{
+    activeBatch->Put(key, value);
+    m_batch_keys.insert(key);
+}
+
+void SecMsgDB::BatchDelete(const std::string &key)
+{
+    activeBatch->Delete(key);
+    m_batch_keys.insert(key);
+}
+
+void SecMsgDB::PutKey(leveldb::WriteBatch &batch, const std::string &key, const std::string &value)
+{
+    if (&batch == activeBatch) {
+        BatchPut(key, value);
+        return;
+    }
+    batch.Put(key, value);
+}
+
+void SecMsgDB::DeleteKey(leveldb::WriteBatch &batch, const std::string &key)
+{
+    if (&batch == activeBatch) {
+        BatchDelete(key);
+        return;
+    }
+    batch.Delete(key);
+}
+
+static std::string CounterKey(const uint8_t *folder, bool unread)
+{
+    std::string key = DBK_COUNTER;
+    key.append((const char*)folder, 2);
+    key.push_back(unread ? 'u' : 't');
+    return key;
+}
+
+static std::string EncodeCount(uint64_t v)
+{
+    v = htole64(v);
+    return std::string((const char*)&v, 8);
+}
+
+static uint64_t DecodeCount(const std::string &value)
+{
+    uint64_t v = 0;
+    if (value.size() == 8) {
+        memcpy(&v, value.data(), 8);
+    }
+    return le64toh(v);
+}
+
+uint64_t SecMsgDB::ReadCounter(const std::string &key) const
+{
+    std::string value;
+    if (!pdb || !pdb->Get(leveldb::ReadOptions(), key, &value).ok()) {
+        return 0;
+    }
+    return DecodeCount(value);
+}
+
+void SecMsgDB::AddCount(leveldb::WriteBatch &batch, const std::string &key, int64_t delta)
+{
+    if (&batch == activeBatch) {
+        // Applied in TxnCommit
+        m_counter_deltas[key] += delta;
+        return;
+    }
+    int64_t v = (int64_t)ReadCounter(key) + delta;
+    batch.Put(key, EncodeCount(v < 0 ? 0 : v));
+}
+
+void SecMsgDB::UpdateIndexes(leveldb::WriteBatch &batch, const uint8_t *chKey, const SecMsgStored *prev, const SecMsgStored *next)
+{
+    // prev and next are the old and new values stored at chKey, nullptr if not present
+    std::string msgid((const char*)chKey + 2, 28);
+    auto address_key = [&](const CKeyID &addr) {
+        std::string key = DBK_INDEX_ADDRESS;
+        key.append((const char*)chKey, 2);
+        key.append((const char*)addr.begin(), 20);
+        return key + msgid;
+    };
+    std::string unread_key = DBK_INDEX_UNREAD;
+    unread_key.append((const char*)chKey, 2);
+    unread_key += msgid;
+
+    bool prev_unread = prev && (prev->status & SMSG_MASK_UNREAD);
+    bool next_unread = next && (next->status & SMSG_MASK_UNREAD);
+
+    if (prev && !prev->addrTo.IsNull() && (!next || next->addrTo != prev->addrTo)) {
+        DeleteKey(batch, address_key(prev->addrTo));
+    }
+    if (next && !next->addrTo.IsNull() && (!prev || next->addrTo != prev->addrTo)) {
+        PutKey(batch, address_key(next->addrTo), "");
+    }
+    if (prev_unread && !next_unread) {
+        DeleteKey(batch, unread_key);
+        AddCount(batch, CounterKey(chKey, true), -1);
+    } else
+    if (!prev_unread && next_unread) {
+        PutKey(batch, unread_key, "");
+        AddCount(batch, CounterKey(chKey, true), 1);
+    }
+    if (!prev && next) {
+        AddCount(batch, CounterKey(chKey, false), 1);
+    } else
+    if (prev && !next) {
+        AddCount(batch, CounterKey(chKey, false), -1);
+    }
+}
+
+uint64_t SecMsgDB::GetCount(const std::string &folder, bool unread)
+{
+    LOCK(cs_smsgDB);
+    std::string key = CounterKey((const uint8_t*)folder.data(), unread);
+    int64_t v = ReadCounter(key);
+    const auto mi = m_counter_deltas.find(key);
+    if (mi != m_counter_deltas.end()) {
+        v += mi->second;
+    }
+    return v < 0 ? 0 : v;
+}
+
+bool SecMsgDB::NextIndexKey(leveldb::Iterator *it, const std::string &prefix, const std::string &folder, const uint8_t *from_msgid, uint8_t *chKey)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    if (!it->Valid()) { // First run
+        if (from_msgid) {
+            std::string from_key = prefix + std::string((const char*)from_msgid, 28);
+            it->Seek(from_key);
+            if (it->Valid() && it->key() == from_key) {
+                it->Next();
+            }
+        } else {
+            it->Seek(prefix);
+        }
+    } else {
+        it->Next();
+    }
+
+    if (!(it->Valid()
+        && it->key().size() == prefix.size() + 28
+        && memcmp(it->key().data(), prefix.data(), prefix.size()) == 0)) {
+        return false;
+    }
+
+    memcpy(chKey, folder.data(), 2);
+    memcpy(chKey + 2, it->key().data() + prefix.size(), 28);
+
+    return true;
+};
+
+bool SecMsgDB::BuildIndexes()
+{
+    if (!pdb) {
+        return false;
+    }
+    LOCK(cs_smsgDB);
+
+    std::string value;
+    if (pdb->Get(leveldb::ReadOptions(), DBK_INDEX_VERSION, &value).ok()
+        && DecodeCount(value) == SMSG_DB_INDEX_VERSION) {
+        return true;
+    }
+    LogPrintf("Building secure message db indexes.\n");
+    int64_t nStart = GetTimeMillis();
+
+    const size_t MAX_BATCH_KEYS = 10000;
+    leveldb::WriteBatch batch;
+    size_t num_batched = 0;
+    auto commit_if_full = [&]() {
+        if (++num_batched < MAX_BATCH_KEYS) {
+            return true;
+        }
+        num_batched = 0;
+        bool rv = CommitBatch(&batch);
+        batch.Clear();
+        return rv;
+    };
+
+    // Remove any partial indexes
+    std::unique_ptr<leveldb::Iterator> it(pdb->NewIterator(leveldb::ReadOptions()));
+    for (const auto &prefix : {DBK_INDEX_ADDRESS, DBK_INDEX_UNREAD, DBK_COUNTER}) {
+        for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            batch.Delete(it->key());
+            if (!commit_if_full()) {
+                return false;
+            }
+        }
+    }
+    if (!CommitBatch(&batch)) {
+        return false;
+    }
+    batch.Clear();
+    num_batched = 0;
+
+    size_t num_messages = 0;
+    for (const auto &folder : {DBK_INBOX, DBK_OUTBOX, DBK_QUEUED, DBK_STASHED}) {
+        uint64_t num_total = 0, num_unread = 0;
+        uint8_t chKey[30];
+        SecMsgStored smsgStored;
+        std::unique_ptr<leveldb::Iterator> it_folder(pdb->NewIterator(leveldb::ReadOptions()));
+        while (NextSmesg(it_folder.get(), folder, chKey, smsgStored)) {
+            // Counters are written once the folder is done
+            std::string msgid((const char*)chKey + 2, 28);
+            if (!smsgStored.addrTo.IsNull()) {
+                batch.Put(DBK_INDEX_ADDRESS + folder + std::string((const char*)smsgStored.addrTo.begin(), 20) + msgid, "");
+            }
+            if (smsgStored.status & SMSG_MASK_UNREAD) {
+                batch.Put(DBK_INDEX_UNREAD + folder + msgid, "");
+                num_unread++;
+            }
+            num_total++;
+            if (!commit_if_full()) {
+                return false;
+            }
+        }
+        batch.Put(CounterKey((const uint8_t*)folder.data(), false), EncodeCount(num_total));
+        batch.Put(CounterKey((const uint8_t*)folder.data(), true), EncodeCount(num_unread));
+        num_messages += num_total;
+    }
+    batch.Put(DBK_INDEX_VERSION, EncodeCount(SMSG_DB_INDEX_VERSION));
+    if (!CommitBatch(&batch)) {
+        return false;
+    }
+
+    LogPrintf("Indexed %u secure messages in %d ms.\n", num_messages, GetTimeMillis() - nStart);
+    return true;
+};
+
 bool SecMsgDB::TxnBegin()
 {
     if (activeBatch) {
@@ -126,11 +412,16 @@ bool SecMsgDB::TxnCommit()
         return false;
     }
 
+    LOCK(cs_smsgDB);
+    for (const auto &delta : m_counter_deltas) {
+        int64_t v = (int64_t)ReadCounter(delta.first) + delta.second;
+        activeBatch->Put(delta.first, EncodeCount(v < 0 ? 0 : v));
+    }
+
     leveldb::WriteOptions writeOptions;
     writeOptions.sync = true;
     leveldb::Status status = pdb->Write(writeOptions, activeBatch);
-    delete activeBatch;
-    activeBatch = nullptr;
+    TxnAbort();
 
     if (!status.ok()) {
         return error("SecMsgDB batch commit failure: %s\n", status.ToString());
@@ -143,18 +434,23 @@ bool SecMsgDB::TxnAbort()
 {
     delete activeBatch;
     activeBatch = nullptr;
+    m_batch_keys.clear();
+    m_counter_deltas.clear();
     return true;
 };
 
-bool SecMsgDB::CommitBatch(leveldb::WriteBatch *batch)
+bool SecMsgDB::CommitBatch(leveldb::WriteBatch *batch, bool sync)
 {
     if (!batch) {
         return false;
     }
 
     leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    writeOptions.sync = sync;
     leveldb::Status status = pdb->Write(writeOptions, batch);
+    if (!sync) {
+        nUnsyncedWrites++;
+    }
 
     if (!status.ok()) {
         return error("SecMsgDB batch commit failure: %s\n", status.ToString());
@@ -223,12 +519,11 @@ bool SecMsgDB::WritePK(const CKeyID &addr, const CPubKey &pubkey)
     ssValue << pubkey;
 
     if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
+        BatchPut(ssKey.str(), ssValue.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
     leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
     if (!s.ok()) {
         return error("SecMsgDB write failure: %s\n", s.ToString());
@@ -321,12 +616,11 @@ bool SecMsgDB::WriteKey(const CKeyID &idk, const SecMsgKey &key)
     ssValue << key;
 
     if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
+        BatchPut(ssKey.str(), ssValue.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
     leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
     if (!s.ok()) {
         return error("%s failed: %s\n", __func__, s.ToString());
@@ -442,14 +736,21 @@ bool SecMsgDB::WriteSmesg(const uint8_t *chKey, const SecMsgStored &smsgStored)
     CDataStream ssValue(SER_DISK, CLIENT_VERSION);
     ssValue << smsgStored;
 
+    // Message, indexes and counters are written together
+    LOCK(cs_smsgDB);
+    SecMsgStored prev;
+    bool have_prev = ReadSmesg(chKey, prev);
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch &write_batch = activeBatch ? *activeBatch : batch;
+    PutKey(write_batch, ssKey.str(), ssValue.str());
+    UpdateIndexes(write_batch, chKey, have_prev ? &prev : nullptr, &smsgStored);
+
     if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
-    leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
+    leveldb::Status s = pdb->Write(writeOptions, &batch);
     if (!s.ok()) {
         return error("SecMsgDB write failed: %s\n", s.ToString());
     }
@@ -483,16 +784,24 @@ bool SecMsgDB::EraseSmesg(const uint8_t *chKey)
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
     ssKey.write(AsBytes(Span{(const char*)chKey, 30}));
 
+    LOCK(cs_smsgDB);
+    SecMsgStored prev;
+    bool have_prev = ReadSmesg(chKey, prev);
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch &write_batch = activeBatch ? *activeBatch : batch;
+    DeleteKey(write_batch, ssKey.str());
+    if (have_prev) {
+        UpdateIndexes(write_batch, chKey, &prev, nullptr);
+    }
+
     if (activeBatch) {
-        activeBatch->Delete(ssKey.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
-    leveldb::Status s = pdb->Delete(writeOptions, ssKey.str());
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
+    leveldb::Status s = pdb->Write(writeOptions, &batch);
 
-    if (s.ok() || s.IsNotFound()) {
+    if (s.ok()) {
         return true;
     }
     return error("SecMsgDB erase failed: %s\n", s.ToString());
@@ -550,12 +859,11 @@ bool SecMsgDB::WritePurged(const uint8_t *chKey, const SecMsgPurged &smsgPurged)
     ssValue << smsgPurged;
 
     if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
+        BatchPut(ssKey.str(), ssValue.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
     leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
     if (!s.ok()) {
         return error("SecMsgDB write failed: %s\n", s.ToString());
@@ -694,13 +1002,12 @@ bool SecMsgDB::WriteFundingData(const uint256 &key, int height, const std::vecto
     CDataStream ssValueI(SER_DISK, CLIENT_VERSION);
 
     if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
-        activeBatch->Put(ssKeyI.str(), ssValueI.str());
+        BatchPut(ssKey.str(), ssValue.str());
+        BatchPut(ssKeyI.str(), ssValueI.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
     leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
     if (!s.ok()) {
         return error("SecMsgDB write failed: %s\n", s.ToString());
@@ -726,13 +1033,12 @@ bool SecMsgDB::EraseFundingData(int height, const uint256 &key)
     ssKeyI.write(AsBytes(Span{(const char*)key.begin(), 32}));
 
     if (activeBatch) {
-        activeBatch->Delete(ssKey.str());
-        activeBatch->Delete(ssKeyI.str());
+        BatchDelete(ssKey.str());
+        BatchDelete(ssKeyI.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
     leveldb::Status s = pdb->Delete(writeOptions, ssKey.str());
     leveldb::Status s1 = pdb->Delete(writeOptions, ssKeyI.str());
     if ((s.ok() || s.IsNotFound()) && (s1.ok() || s1.IsNotFound())) {
@@ -767,6 +1073,82 @@ bool SecMsgDB::NextFundingDataLink(leveldb::Iterator *it, int &height, uint256 &
     return true;
 };
 
+static std::string FundingUndoKey(int height, const uint256 &block_hash)
+{
+    uint32_t be_height = htobe32((uint32_t)height);
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey.write(AsBytes(Span{(const char*)DBK_FUNDING_UNDO.data(), DBK_FUNDING_UNDO.size()}));
+    ssKey.write(AsBytes(Span{(const char*)&be_height, 4}));
+    ssKey.write(AsBytes(Span{(const char*)block_hash.begin(), 32}));
+    return ssKey.str();
+}
+
+bool SecMsgDB::ReadFundingUndo(int height, const uint256 &block_hash, std::vector<uint256> &txids)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    std::string strValue;
+    leveldb::Status s = pdb->Get(leveldb::ReadOptions(), FundingUndoKey(height, block_hash), &strValue);
+    if (!s.ok()) {
+        if (s.IsNotFound()) {
+            return false;
+        }
+        return error("LevelDB read failure: %s\n", s.ToString());
+    }
+
+    try {
+        CDataStream ssValue(MakeUCharSpan(strValue), SER_DISK, CLIENT_VERSION);
+        ssValue >> txids;
+    } catch (std::exception &e) {
+        LogPrintf("%s unserialize threw: %s.\n", __func__, e.what());
+        return false;
+    }
+
+    return true;
+};
+
+bool SecMsgDB::EraseFundingUndo(int height, const uint256 &block_hash)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
+    leveldb::Status s = pdb->Delete(writeOptions, FundingUndoKey(height, block_hash));
+    if (s.ok() || s.IsNotFound()) {
+        return true;
+    }
+    return error("SecMsgDB erase failed: %s\n", s.ToString());
+};
+
+bool SecMsgDB::NextFundingUndo(leveldb::Iterator *it, int &height, uint256 &block_hash)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    if (!it->Valid()) { // First run
+        it->Seek(DBK_FUNDING_UNDO);
+    } else {
+        it->Next();
+    }
+
+    if (!(it->Valid()
+        && it->key().size() == DBK_FUNDING_UNDO.size() + 4 + 32
+        && memcmp(it->key().data(), DBK_FUNDING_UNDO.data(), DBK_FUNDING_UNDO.size()) == 0)) {
+        return false;
+    }
+
+    uint32_t be_height;
+    memcpy(&be_height, it->key().data() + DBK_FUNDING_UNDO.size(), 4);
+    height = (int) be32toh(be_height);
+    memcpy(block_hash.begin(), it->key().data() + DBK_FUNDING_UNDO.size() + 4, 32);
+
+    return true;
+};
+
 bool SecMsgDB::WriteBestBlock(const uint256 &block_hash, int height)
 {
     if (!pdb) {
@@ -780,12 +1162,11 @@ bool SecMsgDB::WriteBestBlock(const uint256 &block_hash, int height)
     ssValue << height;
 
     if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
+        BatchPut(ssKey.str(), ssValue.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
     leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
     if (!s.ok()) {
         return error("SecMsgDB write failed: %s\n", s.ToString());
@@ -832,18 +1213,68 @@ bool SecMsgDB::ReadBestBlock(uint256 &block_hash, int &height)
     return true;
 };
 
+bool SecMsgDB::WriteNotifyCursor(int64_t time, const uint160 &hash)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << time;
+    ssValue << hash;
+
+    if (activeBatch) {
+        BatchPut(DBK_NOTIFY_CURSOR, ssValue.str());
+        return true;
+    }
+
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
+    leveldb::Status s = pdb->Put(writeOptions, DBK_NOTIFY_CURSOR, ssValue.str());
+    if (!s.ok()) {
+        return error("SecMsgDB write failed: %s\n", s.ToString());
+    }
+
+    return true;
+};
+
+bool SecMsgDB::ReadNotifyCursor(int64_t &time, uint160 &hash)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    std::string strValue;
+    leveldb::Status s = pdb->Get(leveldb::ReadOptions(), DBK_NOTIFY_CURSOR, &strValue);
+    if (!s.ok()) {
+        if (s.IsNotFound()) {
+            return false;
+        }
+        return error("LevelDB read failure: %s\n", s.ToString());
+    }
+
+    try {
+        CDataStream ssValue(MakeUCharSpan(strValue), SER_DISK, CLIENT_VERSION);
+        ssValue >> time;
+        ssValue >> hash;
+    } catch (std::exception &e) {
+        LogPrintf("%s unserialize threw: %s.\n", __func__, e.what());
+        return false;
+    }
+
+    return true;
+};
+
 bool SecMsgDB::EraseBestBlock()
 {
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
     ssKey.write(AsBytes(Span{(const char*)DBK_BEST_BLOCK.data(), DBK_BEST_BLOCK.size()}));
 
     if (activeBatch) {
-        activeBatch->Delete(ssKey.str());
+        BatchDelete(ssKey.str());
         return true;
     }
 
-    leveldb::WriteOptions writeOptions;
-    writeOptions.sync = true;
+    leveldb::WriteOptions writeOptions = GroupWriteOptions();
     leveldb::Status s = pdb->Delete(writeOptions, ssKey.str());
     if (s.ok() || s.IsNotFound()) {
         return true;
@@ -888,4 +1319,36 @@ bool PutFundingData(leveldb::WriteBatch *batch, const uint256 &key, int height,
     return true;
 };
 
+bool DeleteFundingData(leveldb::WriteBatch *batch, const uint256 &key, int height)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey.write(AsBytes(Span{(const char*)DBK_FUNDING_TX_DATA.data(), DBK_FUNDING_TX_DATA.size()}));
+    ssKey.write(AsBytes(Span{(const char*)key.begin(), 32}));
+
+    uint32_t be_height = htobe32((uint32_t)height);
+    CDataStream ssKeyI(SER_DISK, CLIENT_VERSION);
+    ssKeyI.write(AsBytes(Span{(const char*)DBK_FUNDING_TX_LINK.data(), DBK_FUNDING_TX_LINK.size()}));
+    ssKeyI.write(AsBytes(Span{(const char*)&be_height, 4}));
+    ssKeyI.write(AsBytes(Span{(const char*)key.begin(), 32}));
+
+    batch->Delete(ssKey.str());
+    batch->Delete(ssKeyI.str());
+    return true;
+};
+
+bool PutFundingUndo(leveldb::WriteBatch *batch, int height, const uint256 &block_hash, const std::vector<uint256> &txids)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << txids;
+
+    batch->Put(FundingUndoKey(height, block_hash), ssValue.str());
+    return true;
+};
+
+bool DeleteFundingUndo(leveldb::WriteBatch *batch, int height, const uint256 &block_hash)
+{
+    batch->Delete(FundingUndoKey(height, block_hash));
+    return true;
+};
+
 } // namespace smsg
@@ -11,6 +11,10 @@
 #include <sync.h>
 #include <pubkey.h>
 
+#include <map>
+#include <set>
+#include <string>
+
 class CDataStream;
 class uint256;
 
@@ -23,6 +27,13 @@ class SecMsgPurged;
 extern RecursiveMutex cs_smsgDB;
 extern leveldb::DB *smsgDB;
 
+static constexpr size_t SMSG_DB_SYNC_WRITES = 256;
+static constexpr int64_t SMSG_DB_SYNC_INTERVAL = 2; // seconds
+static constexpr uint64_t SMSG_DB_INDEX_VERSION = 1;
+
+/** Sync unsynced writes to disk, unless the last sync was less than SMSG_DB_SYNC_INTERVAL ago and !force */
+bool FlushDB(bool force);
+
 extern const std::string DBK_PUBLICKEY;
 extern const std::string DBK_SECRETKEY;
 extern const std::string DBK_INBOX;
@@ -32,6 +43,12 @@ extern const std::string DBK_STASHED;
 extern const std::string DBK_PURGED_TOKEN;
 extern const std::string DBK_FUNDING_TX_DATA;
 extern const std::string DBK_FUNDING_TX_LINK;
+extern const std::string DBK_FUNDING_UNDO;      // height|block hash, the funding txns stored by the block
+extern const std::string DBK_INDEX_ADDRESS;     // folder|addrTo|msgid
+extern const std::string DBK_INDEX_UNREAD;      // folder|msgid
+extern const std::string DBK_COUNTER;           // folder|('t'otal or 'u'nread)
+extern const std::string DBK_INDEX_VERSION;
+extern const std::string DBK_NOTIFY_CURSOR;     // time received and hash of the last notified message
 
 class SecMsgDB
 {
@@ -45,7 +62,10 @@ public:
         // Deletes only data scoped to this SecMsgDB object.
         if (activeBatch) {
             delete activeBatch;
+            activeBatch = nullptr;
         }
+        m_batch_keys.clear();
+        m_counter_deltas.clear();
         pdb = nullptr;
     }
 
@@ -57,7 +77,8 @@ public:
     bool TxnBegin();
     bool TxnCommit();
     bool TxnAbort();
-    bool CommitBatch(leveldb::WriteBatch *batch);
+    /** Write batch, if !sync the write is synced by the next FlushDB */
+    bool CommitBatch(leveldb::WriteBatch *batch, bool sync = true);
 
     bool ReadPK(const CKeyID &addr, CPubKey &pubkey);
     bool WritePK(const CKeyID &addr, const CPubKey &pubkey);
@@ -73,6 +94,14 @@ public:
     bool ExistsSmesg(const uint8_t *chKey);
     bool EraseSmesg(const uint8_t *chKey);
 
+    /** Number of messages, or unread messages, in folder from the persisted counters */
+    uint64_t GetCount(const std::string &folder, bool unread);
+    /** Iterate index keys of the form prefix|msgid in msgid order, starting after from_msgid if set.
+     *  chKey is set to the key of the message, folder|msgid. */
+    bool NextIndexKey(leveldb::Iterator *it, const std::string &prefix, const std::string &folder, const uint8_t *from_msgid, uint8_t *chKey);
+    /** Rebuild the secondary indexes and counters if they are missing or out of date */
+    bool BuildIndexes();
+
     bool NextPrivKey(leveldb::Iterator *it, const std::string &prefix, CKeyID &idk, SecMsgKey &key);
 
     bool ReadPurged(const uint8_t *chKey, SecMsgPurged &smsgPurged);
@@ -85,10 +114,17 @@ public:
     bool EraseFundingData(int height, const uint256 &key);
     bool NextFundingDataLink(leveldb::Iterator *it, int &height, uint256 &key);
 
+    bool ReadFundingUndo(int height, const uint256 &block_hash, std::vector<uint256> &txids);
+    bool EraseFundingUndo(int height, const uint256 &block_hash);
+    bool NextFundingUndo(leveldb::Iterator *it, int &height, uint256 &block_hash);
+
     bool WriteBestBlock(const uint256 &hash, int height);
     bool ReadBestBlock(uint256 &hash, int &height);
     bool EraseBestBlock();
 
+    bool WriteNotifyCursor(int64_t time, const uint160 &hash);
+    bool ReadNotifyCursor(int64_t &time, uint160 &hash);
+
     /**
      * Compact a certain range of keys in the database.
      */
@@ -96,10 +132,25 @@ public:
 
     leveldb::DB *pdb{nullptr};  // Points to the global instance
     leveldb::WriteBatch *activeBatch{nullptr};
+
+private:
+    void BatchPut(const std::string &key, const std::string &value);
+    void BatchDelete(const std::string &key);
+    void PutKey(leveldb::WriteBatch &batch, const std::string &key, const std::string &value);
+    void DeleteKey(leveldb::WriteBatch &batch, const std::string &key);
+    uint64_t ReadCounter(const std::string &key) const;
+    void AddCount(leveldb::WriteBatch &batch, const std::string &key, int64_t delta);
+    void UpdateIndexes(leveldb::WriteBatch &batch, const uint8_t *chKey, const SecMsgStored *prev, const SecMsgStored *next);
+
+    std::set<std::string> m_batch_keys;     // Keys written to activeBatch, ScanBatch skips others
+    std::map<std::string, int64_t> m_counter_deltas; // Applied to the counters in TxnCommit
 };
 
 bool PutBestBlock(leveldb::WriteBatch *batch, const uint256 &block_hash, int height);
 bool PutFundingData(leveldb::WriteBatch *batch, const uint256 &key, int height, const std::vector<uint8_t> &data);
+bool DeleteFundingData(leveldb::WriteBatch *batch, const uint256 &key, int height);
+bool PutFundingUndo(leveldb::WriteBatch *batch, int height, const uint256 &block_hash, const std::vector<uint256> &txids);
+bool DeleteFundingUndo(leveldb::WriteBatch *batch, int height, const uint256 &block_hash);
 
 } // namespace smsg
 
@@ -20,11 +20,21 @@ public:
         return smsgModule.SetBestBlock(cache, block_hash, height, time);
     }
 
+    int DisconnectBlock(ChainSyncCache &cache, const uint256 &block_hash, int height, int64_t time, const uint256 &prev_hash, int prev_height) override
+    {
+        return smsgModule.DisconnectBlock(cache, block_hash, height, time, prev_hash, prev_height);
+    }
+
     int WriteCache(ChainSyncCache &cache) override
     {
         return smsgModule.WriteCache(cache);
     }
 
+    int FlushChainSync() override
+    {
+        return smsgModule.FlushChainSync();
+    }
+
     bool ScanBlock(const CBlock &block) override
     {
         return smsgModule.ScanBlock(block);
@@ -25,7 +25,9 @@ public:
 
     virtual int StoreFundingTx(smsg::ChainSyncCache &cache, const CTransaction &tx, const CBlockIndex *pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main) = 0;
     virtual int SetBestBlock(smsg::ChainSyncCache &cache, const uint256 &block_hash, int height, int64_t time) = 0;
+    virtual int DisconnectBlock(smsg::ChainSyncCache &cache, const uint256 &block_hash, int height, int64_t time, const uint256 &prev_hash, int prev_height) = 0;
     virtual int WriteCache(smsg::ChainSyncCache &cache) = 0;
+    virtual int FlushChainSync() = 0;
     virtual bool ScanBlock(const CBlock &block) = 0;
     virtual int ReadBestBlock(uint256 &block_hash, int &height) = 0;
     virtual bool TrackFundingTxns() = 0;
@@ -8,6 +8,8 @@
 #include <sync.h>
 #include <threadsafety.h>
 
+#include <algorithm>
+
 const uint32_t SMSG_RCVCOUNT_REDUCE = 200;
 
 namespace SMSGMsgType {
@@ -20,6 +22,7 @@ extern const char *HAVE;
 extern const char *WANT;
 extern const char *MSG;
 extern const char *IGNORING;
+extern const char *SKETCH;
 };
 
 class PeerBucket
@@ -30,6 +33,29 @@ public:
     uint32_t m_hash;
 };
 
+/** Token bucket refilled at rate per second up to burst, starts full. A rate of 0 is unlimited. */
+class SmsgRateLimit
+{
+public:
+    bool Available(double cost, double rate, double burst, int64_t now_us)
+    {
+        if (rate <= 0) {
+            return true;
+        }
+        if (m_last_us == 0) {
+            m_tokens = burst;
+        } else {
+            m_tokens = std::min(burst, m_tokens + std::max<int64_t>(0, now_us - m_last_us) * rate / 1000000.0);
+        }
+        m_last_us = now_us;
+        return m_tokens >= cost;
+    }
+    void Spend(double cost) { m_tokens -= cost; }
+
+    double m_tokens = 0;
+    int64_t m_last_us = 0;
+};
+
 class SecMsgNode
 {
 public:
@@ -46,6 +72,16 @@ public:
     std::map<int64_t, PeerBucket> m_buckets GUARDED_BY(cs_smsg_net);
     std::map<int64_t, int64_t> m_buckets_last_shown;
 
+    // Totals since the peer connected
+    uint64_t m_bytes_received GUARDED_BY(cs_smsg_net) = 0;
+    uint64_t m_msgs_received GUARDED_BY(cs_smsg_net) = 0;      // smsg network messages
+    uint64_t m_smsgs_received GUARDED_BY(cs_smsg_net) = 0;     // Secure messages in bunches
+    uint64_t m_receive_us GUARDED_BY(cs_smsg_net) = 0;         // Time spent validating and storing bunches
+    uint64_t m_dropped_over_quota GUARDED_BY(cs_smsg_net) = 0; // Network messages dropped by the rate limits or a full receive queue
+    uint32_t m_receive_queued GUARDED_BY(cs_smsg_net) = 0;     // Bunches waiting for the receive threads
+    SmsgRateLimit m_bytes_limit GUARDED_BY(cs_smsg_net);
+    SmsgRateLimit m_smsgs_limit GUARDED_BY(cs_smsg_net);
+
     void DecSmsgMisbehaving() {
         LOCK(cs_smsg_net);
         if (m_receive_counter < SMSG_RCVCOUNT_REDUCE) {
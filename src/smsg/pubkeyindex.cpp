@@ -0,0 +1,194 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <smsg/pubkeyindex.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <node/blockstorage.h>
+#include <primitives/block.h>
+#include <pubkey.h>
+#include <smsg/db.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <atomic>
+#include <set>
+#include <thread>
+
+namespace smsg {
+
+std::unique_ptr<PubKeyIndex> g_pubkey_index;
+
+size_t GetBlockPubKeys(const CBlock &block, std::vector<CPubKey> &pubkeys)
+{
+    size_t num_txns = 0;
+    for (const auto &tx : block.vtx) {
+        if (!tx->IsParticlVersion()) {
+            continue;
+        }
+        for (const auto &txin : tx->vin) {
+            if (txin.IsAnonInput()
+                || txin.scriptWitness.stack.size() != 2
+                || txin.scriptWitness.stack[1].size() != 33) {
+                continue;
+            }
+            CPubKey pubkey(txin.scriptWitness.stack[1]);
+            if (!pubkey.IsValid() || !pubkey.IsCompressed()) {
+                LogPrintf("Public key is invalid %s.\n", HexStr(pubkey));
+                continue;
+            }
+            pubkeys.push_back(pubkey);
+            if (tx->IsCoinStake()) {
+                break;
+            }
+        }
+        num_txns++;
+    }
+    return num_txns;
+}
+
+/** Write the keys not yet in smsgdb in one batch */
+static bool WritePubKeys(const std::vector<CPubKey> &pubkeys, size_t &num_added)
+{
+    if (pubkeys.empty()) {
+        return true;
+    }
+
+    LOCK(cs_smsgDB);
+    SecMsgDB db;
+    if (!db.Open("cw") || !db.TxnBegin()) {
+        return false;
+    }
+    std::set<CKeyID> seen;
+    for (const auto &pubkey : pubkeys) {
+        CKeyID id = pubkey.GetID();
+        if (!seen.insert(id).second || db.ExistsPK(id)) {
+            continue;
+        }
+        if (!db.WritePK(id, pubkey)) {
+            db.TxnAbort();
+            return false;
+        }
+        num_added++;
+    }
+    return db.TxnCommit();
+}
+
+
+/** Access to the smsgpubkeyindex database (indexes/smsgpubkeyindex/), holds only the best block */
+class PubKeyIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+PubKeyIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "smsgpubkeyindex", n_cache_size, f_memory, f_wipe)
+{}
+
+PubKeyIndex::PubKeyIndex(size_t n_cache_size, bool f_memory, bool f_wipe, int num_threads)
+    : m_db(std::make_unique<PubKeyIndex::DB>(n_cache_size, f_memory, f_wipe)),
+      m_num_threads(num_threads > 0 ? num_threads : std::max(1, GetNumCores()))
+{}
+
+PubKeyIndex::~PubKeyIndex() = default;
+
+bool PubKeyIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    std::vector<CPubKey> pubkeys;
+    GetBlockPubKeys(block, pubkeys);
+    size_t num_added = 0;
+    if (!WritePubKeys(pubkeys, num_added)) {
+        return error("%s: Failed to write public keys of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
+bool PubKeyIndex::SyncFromBlockIndex(const CBlockIndex*& pindex)
+{
+    const Consensus::Params &consensus_params = Params().GetConsensus();
+    size_t num_blocks = 0, num_added = 0;
+    while (!m_interrupt) {
+        std::vector<const CBlockIndex*> batch;
+        CBlockLocator locator;
+        {
+            LOCK(cs_main);
+            const CChain& chain = m_chainstate->m_chain;
+            if (pindex && !chain.Contains(pindex)) {
+                // Leave rewinding from a fork to the block by block sync
+                break;
+            }
+            for (const CBlockIndex* pnext = pindex ? chain.Next(pindex) : chain.Genesis();
+                 pnext && batch.size() < PUBKEY_SYNC_BATCH_SIZE; pnext = chain.Next(pnext)) {
+                batch.push_back(pnext);
+            }
+            if (batch.empty()) {
+                break;
+            }
+            locator = chain.GetLocator(batch.back());
+        }
+
+        // Reading and decoding the blocks dominates, the keys are written in chain order after
+        std::vector<std::vector<CPubKey> > block_pubkeys(batch.size());
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        auto decode = [&]() {
+            for (size_t i = next++; i < batch.size() && !failed && !m_interrupt; i = next++) {
+                CBlock block;
+                if (!node::ReadBlockFromDisk(block, batch[i], consensus_params)) {
+                    LogPrintf("%s: Failed to read block %s from disk\n", __func__, batch[i]->GetBlockHash().ToString());
+                    failed = true;
+                    return;
+                }
+                GetBlockPubKeys(block, block_pubkeys[i]);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int i = 1; i < std::min<int>(m_num_threads, batch.size()); ++i) {
+            threads.emplace_back([&decode, i]() {
+                util::ThreadRename(strprintf("smsgpkidx.%i", i));
+                decode();
+            });
+        }
+        decode();
+        for (auto &t : threads) {
+            t.join();
+        }
+        if (failed) {
+            return false;
+        }
+        if (m_interrupt) {
+            break;
+        }
+
+        std::vector<CPubKey> pubkeys;
+        for (const auto &v : block_pubkeys) {
+            pubkeys.insert(pubkeys.end(), v.begin(), v.end());
+        }
+        // Keys are committed before the locator, a batch rewritten after a crash is skipped by ExistsPK
+        if (!WritePubKeys(pubkeys, num_added)) {
+            return error("%s: Failed to write batch ending at height %d", __func__, batch.back()->nHeight);
+        }
+        CDBBatch db_batch(*m_db);
+        m_db->WriteBestBlock(db_batch, locator);
+        if (!m_db->WriteBatch(db_batch)) {
+            return error("%s: Failed to write locator at height %d", __func__, batch.back()->nHeight);
+        }
+        SetBestBlockIndex(batch.back());
+        pindex = batch.back();
+        num_blocks += batch.size();
+    }
+
+    if (num_blocks > 0) {
+        LogPrintf("%s: Scanned %d blocks, found %d new public keys\n", GetName(), num_blocks, num_added);
+    }
+    return true;
+}
+
+BaseIndex::DB& PubKeyIndex::GetDB() const { return *m_db; }
+
+} // namespace smsg
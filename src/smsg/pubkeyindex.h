@@ -0,0 +1,66 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_SMSG_PUBKEYINDEX_H
+#define PARTICL_SMSG_PUBKEYINDEX_H
+
+#include <index/base.h>
+
+#include <vector>
+
+class CPubKey;
+
+namespace smsg {
+
+/** Blocks decoded per batch when catching up, each batch is committed with its resume point */
+static constexpr size_t PUBKEY_SYNC_BATCH_SIZE{1000};
+static constexpr bool DEFAULT_PUBKEYINDEX{false};
+
+/** Append the public keys revealed by the standard inputs of block's txns, returns the number of txns scanned.
+ *  Coinstake inputs all spend from the same address, only the first is taken.
+ */
+size_t GetBlockPubKeys(const CBlock &block, std::vector<CPubKey> &pubkeys);
+
+/**
+ * PubKeyIndex harvests public keys from the chain into the smsg address db so
+ * messages can be sent to addresses the wallet has not seen a key for.
+ * Synced in the background, replacing full rescans by smsgscanchain.
+ * Only the best block is stored in indexes/smsgpubkeyindex, the keys are
+ * written to smsgdb. Keys are not removed when blocks are disconnected.
+ */
+class PubKeyIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+    const int m_num_threads;
+
+    bool AllowPrune() const override { return true; }
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    /// Decode PUBKEY_SYNC_BATCH_SIZE blocks at a time over m_num_threads threads
+    bool SyncFromBlockIndex(const CBlockIndex*& pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "smsgpubkeyindex"; }
+
+public:
+    /// Constructs the index, num_threads <= 0 uses all cores.
+    explicit PubKeyIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false, int num_threads = 0);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~PubKeyIndex() override;
+};
+
+/// The global public key index, started with secure messaging when -smsgpubkeyindex is set. May be null.
+extern std::unique_ptr<PubKeyIndex> g_pubkey_index;
+
+} // namespace smsg
+
+#endif // PARTICL_SMSG_PUBKEYINDEX_H
@@ -50,6 +50,39 @@ static void EnsureSMSGIsEnabled()
     }
 };
 
+/** Parse the "from", "limit" and "address" paging options shared by smsginbox and smsgoutbox */
+static void ParsePageOptions(const UniValue &options, std::vector<uint8_t> &from, int &max_results, CKeyID &address)
+{
+    if (options["from"].isStr()) {
+        const std::string &str_from = options["from"].get_str();
+        if (!IsHex(str_from) || str_from.size() != 56) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "\"from\" must be a msgid.");
+        }
+        from = ParseHex(str_from);
+    }
+    if (options["limit"].isNum()) {
+        max_results = options["limit"].getInt<int>();
+    }
+    if (options["address"].isStr()) {
+        CBitcoinAddress coinAddress(options["address"].get_str());
+        if (!coinAddress.IsValid() || !coinAddress.GetKeyID(address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address.");
+        }
+    }
+};
+
+/** Index to iterate over messages in folder, optionally unread or sent to address only */
+static std::string GetIndexPrefix(const std::string &folder, bool unread, const CKeyID &address)
+{
+    if (!address.IsNull()) {
+        return smsg::DBK_INDEX_ADDRESS + folder + std::string((const char*)address.begin(), 20);
+    }
+    if (unread) {
+        return smsg::DBK_INDEX_UNREAD + folder;
+    }
+    return folder;
+};
+
 static RPCHelpMan smsgenable()
 {
     return RPCHelpMan{"smsgenable",
@@ -518,7 +551,8 @@ static RPCHelpMan smsglocalkeys()
 static RPCHelpMan smsgscanchain()
 {
     return RPCHelpMan{"smsgscanchain",
-                "\nLook for public keys in the block chain.\n",
+                "\nLook for public keys in the block chain.\n"
+                "Returns immediately if -smsgpubkeyindex is set, the index is kept in sync in the background, see getindexinfo.\n",
                 {},
                 RPCResult{
                     RPCResult::Type::ANY, "", ""
@@ -551,7 +585,7 @@ static RPCHelpMan smsgscanbuckets()
                 {
                     {"options", RPCArg::Type::OBJ, RPCArg::Default{UniValue::VOBJ}, "",
                         {
-                            {"scanexpired", RPCArg::Type::BOOL, RPCArg::Default{false}, "Scan all messages."},
+                            {"scanexpired", RPCArg::Type::BOOL, RPCArg::Default{false}, "Scan all messages, expired messages in compacted bucket files can't be scanned."},
                         },
                         "options"},
                 },
@@ -836,6 +870,10 @@ static RPCHelpMan smsgsend()
                             {"fund_from_rct", RPCArg::Type::BOOL, RPCArg::Default{false}, "Fund message from anon balance."},
                             {"rct_ring_size", RPCArg::Type::NUM, RPCArg::Default{(int)DEFAULT_RING_SIZE}, "Ring size to use with fund_from_rct."},
                             {"fundmsg", RPCArg::Type::BOOL, RPCArg::Default{true}, "Fund paid message, if false message will be stashed for later funding."},
+                            {"batchfund", RPCArg::Type::BOOL, RPCArg::Default{false}, "Stash the paid message and fund it with others queued from the same balance in one transaction.\n"
+                                "The batch is funded when -smsgfundbatchsize messages are queued or the oldest has waited -smsgfundbatchwindow seconds. See smsgfundqueue."},
+                            {"compression_dict", RPCArg::Type::NUM, RPCArg::Default{0}, "Compress with a built in dictionary, 1: JSON. Used only if smaller than plain compression.\n"
+                                "Receivers running versions without the dictionary can't read the message."},
                         },
                         "options"},
                     {"coin_control", RPCArg::Type::OBJ, RPCArg::Default{UniValue::VOBJ}, "",
@@ -866,8 +904,9 @@ static RPCHelpMan smsgsend()
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "", {
-                        {RPCResult::Type::STR, "result", "\"Sent\"/\"Not Sent\""},
+                        {RPCResult::Type::STR, "result", "\"Sent\"/\"Not Sent\"/\"Queued\""},
                         {RPCResult::Type::STR_HEX, "msgid", /*optional=*/true, "Message id, if sent"},
+                        {RPCResult::Type::NUM_TIME, "eta", /*optional=*/true, "Time the message is expected to be funded, if queued with batchfund"},
                         {RPCResult::Type::STR_HEX, "msg", /*optional=*/true, "Hex encoded message"},
                         {RPCResult::Type::STR_HEX, "txid", /*optional=*/true, "txnid of the funding transaction, if paid msg"},
                         {RPCResult::Type::NUM, "tx_vsize", /*optional=*/true, "Virtual size of funding transaction, if paid msg"},
@@ -902,7 +941,9 @@ static RPCHelpMan smsgsend()
     bool ttl_in_seconds = false;
     bool fund_from_rct = false;
     bool fund_paid_msg = true;
+    bool batch_fund = false;
     size_t rct_ring_size = DEFAULT_RING_SIZE;
+    uint8_t dict_id = smsg::SMSG_DICT_NONE;
 
     UniValue options = request.params[6];
     if (options.isObject()) {
@@ -916,6 +957,8 @@ static RPCHelpMan smsgsend()
             {"fund_from_rct",     UniValueType(UniValue::VBOOL)},
             {"rct_ring_size",     UniValueType(UniValue::VNUM)},
             {"fundmsg",           UniValueType(UniValue::VBOOL)},
+            {"batchfund",         UniValueType(UniValue::VBOOL)},
+            {"compression_dict",  UniValueType(UniValue::VNUM)},
         }, true, false);
         if (!options["fromfile"].isNull()) {
             fFromFile = options["fromfile"].get_bool();
@@ -941,11 +984,31 @@ static RPCHelpMan smsgsend()
         if (!options["fundmsg"].isNull()) {
             fund_paid_msg = options["fundmsg"].get_bool();
         }
+        if (!options["batchfund"].isNull()) {
+            batch_fund = options["batchfund"].get_bool();
+        }
+        if (!options["compression_dict"].isNull()) {
+            int n = options["compression_dict"].getInt<int>();
+            if (n < 0 || n > 255 || (n != smsg::SMSG_DICT_NONE && !smsg::IsKnownDict(n))) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown compression_dict.");
+            }
+            dict_id = n;
+        }
     }
 
     if (fFromFile && fDecodeHex) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Can't use decodehex with fromfile.");
     }
+    if (batch_fund) {
+        if (!fPaid || fTestFee || !submit_msg || !fund_paid_msg) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "batchfund requires a paid message with submitmsg and fundmsg set, and testfee unset.");
+        }
+        if (request.params[7].isObject() && !request.params[7].empty()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Can't use coin_control with batchfund.");
+        }
+        // Stashed now, moved to the send queue once the batch is funded
+        fund_paid_msg = false;
+    }
 
     if (fDecodeHex) {
         if (!IsHex(msg)) {
@@ -996,14 +1059,22 @@ static RPCHelpMan smsgsend()
         }
     }
     if (smsgModule.Send(kiFrom, kiTo, msg, smsgOut, sError, fPaid, nRetention, fTestFee, &nFee, &nTxBytes,
-                        fFromFile, submit_msg, save_msg, fund_from_rct, rct_ring_size, &cctl, fund_paid_msg) != 0) {
+                        fFromFile, submit_msg, save_msg, fund_from_rct, rct_ring_size, &cctl, fund_paid_msg, dict_id) != 0) {
 #else
     if (smsgModule.Send(kiFrom, kiTo, msg, smsgOut, sError, fPaid, nRetention, fTestFee, &nFee, &nTxBytes,
-                        fFromFile, submit_msg, save_msg) != 0) {
+                        fFromFile, submit_msg, save_msg, false, DEFAULT_RING_SIZE, nullptr, true, dict_id) != 0) {
 #endif
         result.pushKV("result", "Send failed.");
         result.pushKV("error", sError);
     } else {
+        if (batch_fund) {
+            std::vector<uint8_t> msgid = smsgModule.GetMsgID(smsgOut);
+            int64_t eta = smsgModule.QueueFunding(msgid, fund_from_rct, rct_ring_size);
+            result.pushKV("result", "Queued.");
+            result.pushKV("msgid", HexStr(msgid));
+            result.pushKV("eta", eta);
+            return result;
+        }
         result.pushKV("result", (!submit_msg || fTestFee || !fund_paid_msg) ? "Not Sent." : "Sent.");
 
         if (!fTestFee) {
@@ -1107,55 +1178,19 @@ static RPCHelpMan smsgfund()
 
     RPCTypeCheckArgument(request.params[0], UniValue::VARR);
     UniValue uv_msgids = request.params[0].get_array();
-    std::vector<smsg::SecureMessage> v_smsgs(uv_msgids.size());
-    std::vector<smsg::SecureMessage*> v_psmsgs(uv_msgids.size());
-    std::vector<CKeyID> v_msg_addr_to(uv_msgids.size()); // Not required
-    {
-        LOCK(smsg::cs_smsgDB);
-        smsg::SecMsgDB dbMsg;
-        if (!dbMsg.Open("cr+")) {
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Could not open DB");
-        }
-
-        for (unsigned int idx = 0; idx < uv_msgids.size(); idx++) {
-            const UniValue &uv_msgid = uv_msgids[idx];
-
-            std::string sMsgId = uv_msgid.get_str();
-            if (!IsHex(sMsgId) || sMsgId.size() != 56) {
-                throw JSONRPCError(RPC_INVALID_PARAMETER, "msgid must be 28 bytes in hex string.");
-            }
-            std::vector<uint8_t> vMsgId = ParseHex(sMsgId.c_str());
-
-            uint8_t chKey[30];
-            chKey[0] = 'T'; // stashed
-            chKey[1] = 'M';
-            memcpy(chKey + 2, vMsgId.data(), 28);
-            smsg::SecMsgStored smsgStored;
-            if (!dbMsg.ReadSmesg(chKey, smsgStored)) {
-                throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Unknown message id '%s'", sMsgId));
-            }
-            v_smsgs[idx] = smsg::SecureMessage(smsgStored.vchMessage.data());
-            auto &smsg = v_smsgs[idx];
-            if (!smsg.IsPaidVersion()) {
-                throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Non-paid message id '%s'", sMsgId));
-            }
-            try { smsg.pPayload = new uint8_t[smsg.nPayload]; } catch (std::exception &e) {
-                throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Could not allocate payload %s", e.what()));
-            }
-            memcpy(smsg.pPayload, &smsgStored.vchMessage[smsg::SMSG_HDR_LEN], smsg.nPayload);
-            v_msg_addr_to[idx] = smsgStored.addrTo;
+    std::vector<std::vector<uint8_t> > msgids;
+    for (unsigned int idx = 0; idx < uv_msgids.size(); idx++) {
+        std::string sMsgId = uv_msgids[idx].get_str();
+        if (!IsHex(sMsgId) || sMsgId.size() != 56) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "msgid must be 28 bytes in hex string.");
         }
+        msgids.push_back(ParseHex(sMsgId));
     }
-    for (size_t k = 0; k < v_smsgs.size(); ++k) {
-        v_psmsgs[k] = &v_smsgs[k];
-    }
-
-    if (v_psmsgs.size() < 1) {
+    if (msgids.size() < 1) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Must specify one or more message ids");
     }
-    size_t max_messages = (MAX_DATA_OUTPUT_SIZE - 1) / 24;
-    if (v_psmsgs.size() > max_messages) {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Too many messages, max %d", max_messages));
+    if (msgids.size() > smsg::SMSG_MAX_FUND_BATCH) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Too many messages, max %d", smsg::SMSG_MAX_FUND_BATCH));
     }
 
     OutputTypes fund_from = OUTPUT_STANDARD;
@@ -1203,47 +1238,106 @@ static RPCHelpMan smsgfund()
     }
 
     bool fund_from_rct = (fund_from == OUTPUT_RINGCT) ? true : false;
-    if (0 != smsgModule.FundMsgs(v_psmsgs, sError, test_fee, &nTxFee, &nTxBytes, fund_from_rct, rct_ring_size, &cctl)) {
+    uint256 txid;
+    int rv = smsgModule.FundStashedMsgs(msgids, sError, test_fee, &nTxFee, &nTxBytes, fund_from_rct, rct_ring_size, &cctl, txid);
+    if (rv == smsg::SMSG_UNKNOWN_MESSAGE) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, sError);
+    }
+    if (rv != 0) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("SecureMsgFund failed %s", sError));
     }
-
+    if (!test_fee) {
+        result.pushKV("txid", txid.ToString());
+    }
 #else
     throw JSONRPCError(RPC_MISC_ERROR, "Wallet is disabled.");
 #endif
 
-    if (!test_fee) {
-        for (size_t k = 0; k < v_psmsgs.size(); ++k) {
-            const smsg::SecureMessage &smsg = *v_psmsgs[k];
-            if (0 != smsgModule.SubmitMsg(smsg, v_msg_addr_to[k], false, sError)) {
-                LogPrintf("SubmitMsg failed: %s.\n", HexStr(smsgModule.GetMsgID(smsg)));
-                // throw
-            } else {
-                 // Erase from stash
-                LOCK(smsg::cs_smsgDB);
-                smsg::SecMsgDB dbMsg;
-                if (!dbMsg.Open("cr+")) {
-                    throw JSONRPCError(RPC_INTERNAL_ERROR, "Could not open DB");
-                }
-                auto vMsgId = smsgModule.GetMsgID(smsg);
+    result.pushKV("fee", ValueFromAmount(nTxFee));
+    result.pushKV("tx_vsize", (int)nTxBytes);
+
+    return result;
+},
+    };
+}
 
-                uint8_t chKey[30];
-                chKey[0] = 'T'; // stashed
-                chKey[1] = 'M';
-                memcpy(chKey + 2, vMsgId.data(), 28);
-                dbMsg.EraseSmesg(chKey);
+static RPCHelpMan smsgfundqueue()
+{
+    return RPCHelpMan{"smsgfundqueue",
+        "\nList paid messages sent with batchfund waiting to be funded, and the outcome of recently funded batches.\n",
+        {
+        },
+        RPCResult{
+            RPCResult::Type::OBJ, "", "", {
+                {RPCResult::Type::NUM, "batch_size", "Messages funded in one transaction when the batch fills"},
+                {RPCResult::Type::NUM, "batch_window", "Max seconds a message waits for its batch to fill"},
+                {RPCResult::Type::ARR, "queued", "", {
+                    {RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::STR_HEX, "msgid", "Message id"},
+                        {RPCResult::Type::STR, "fundtype", "\"plain\" or \"anon\""},
+                        {RPCResult::Type::NUM, "rct_ring_size", /*optional=*/true, "Ring size, if funded from anon balance"},
+                        {RPCResult::Type::NUM_TIME, "time_queued", "Time the message was queued"},
+                        {RPCResult::Type::NUM_TIME, "eta", "Time the message is expected to be funded"},
+                    }},
+                }},
+                {RPCResult::Type::ARR, "funded", "Oldest first", {
+                    {RPCResult::Type::OBJ, "", "", {
+                        {RPCResult::Type::STR_HEX, "msgid", "Message id"},
+                        {RPCResult::Type::STR_HEX, "txid", /*optional=*/true, "Funding txid"},
+                        {RPCResult::Type::STR, "error", /*optional=*/true, "Error if funding failed, the message is left stashed"},
+                        {RPCResult::Type::NUM_TIME, "time", "Time the batch was funded"},
+                        {RPCResult::Type::NUM, "batch_size", "Number of messages in the batch"},
+                    }},
+                }},
+        }},
+        RPCExamples{
+    HelpExampleCli("smsgfundqueue", "") +
+    "\nAs a JSON-RPC call\n"
+    + HelpExampleRpc("smsgfundqueue", "")
+        },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    EnsureSMSGIsEnabled();
+
+    UniValue result(UniValue::VOBJ);
+    UniValue queued(UniValue::VARR);
+    UniValue funded(UniValue::VARR);
+    {
+        LOCK(smsgModule.cs_fund_queue);
+        result.pushKV("batch_size", (int)smsgModule.m_fund_batch_size);
+        result.pushKV("batch_window", smsgModule.m_fund_batch_window);
+        for (const auto &group : smsgModule.m_fund_queue) {
+            const auto &items = group.second;
+            for (size_t k = 0; k < items.size(); ++k) {
+                UniValue uv(UniValue::VOBJ);
+                uv.pushKV("msgid", HexStr(items[k].msgid));
+                uv.pushKV("fundtype", group.first.first ? "anon" : "plain");
+                if (group.first.first) {
+                    uv.pushKV("rct_ring_size", (int)group.first.second);
+                }
+                uv.pushKV("time_queued", items[k].time_queued);
+                // Messages taken a full batch at a time from the front
+                size_t batch_end = (k / smsgModule.m_fund_batch_size + 1) * smsgModule.m_fund_batch_size;
+                bool batch_full = items.size() >= batch_end;
+                uv.pushKV("eta", batch_full ? GetTime() : items[batch_end - smsgModule.m_fund_batch_size].time_queued + smsgModule.m_fund_batch_window);
+                queued.push_back(uv);
             }
         }
+        for (const auto &entry : smsgModule.m_fund_results) {
+            UniValue uv(UniValue::VOBJ);
+            uv.pushKV("msgid", HexStr(entry.msgid));
+            if (entry.txid.IsNull()) {
+                uv.pushKV("error", entry.error);
+            } else {
+                uv.pushKV("txid", entry.txid.ToString());
+            }
+            uv.pushKV("time", entry.time);
+            uv.pushKV("batch_size", (int)entry.batch_size);
+            funded.push_back(uv);
+        }
     }
-
-    if (!test_fee) {
-        uint256 txid;
-        const smsg::SecureMessage &smsg = *v_psmsgs[0];
-        smsg.GetFundingTxid(txid);
-        result.pushKV("txid", txid.ToString());
-    }
-
-    result.pushKV("fee", ValueFromAmount(nTxFee));
-    result.pushKV("tx_vsize", (int)nTxBytes);
+    result.pushKV("queued", queued);
+    result.pushKV("funded", funded);
 
     return result;
 },
@@ -1307,6 +1401,9 @@ static RPCHelpMan smsginbox()
                             {"offset", RPCArg::Type::NUM, RPCArg::Default{""}, "Skip the first \"offset\" messages"},
                             {"max_results", RPCArg::Type::NUM, RPCArg::Default{""}, "Return only \"max_results\" messages"},
                             {"unread_only", RPCArg::Type::BOOL, RPCArg::Default{false}, "Count only unread messages"},
+                            {"from", RPCArg::Type::STR_HEX, RPCArg::Default{""}, "Start after the message with msgid \"from\", pass \"next\" from the previous result to page through messages"},
+                            {"limit", RPCArg::Type::NUM, RPCArg::Default{""}, "Return at most \"limit\" messages, overrides \"max_results\""},
+                            {"address", RPCArg::Type::STR, RPCArg::Default{""}, "Only messages received on \"address\""},
                         },
                         "options"},
                 },
@@ -1339,6 +1436,7 @@ static RPCHelpMan smsginbox()
                                 {RPCResult::Type::STR, "error", /*optional=*/true, "Message error"},
                             }},
                         }},
+                        {RPCResult::Type::STR_HEX, "next", /*optional=*/true, "msgid to pass as \"from\" to continue listing, set if the listing stopped at the limit"},
                         {RPCResult::Type::STR, "expected", /*optional=*/true, "values understood"},
                         {RPCResult::Type::NUM, "num_messages", /*optional=*/true, "Number of messages counted"},
                 }},
@@ -1349,7 +1447,9 @@ static RPCHelpMan smsginbox()
                     + HelpExampleCli("smsginbox", "\"all\" \"address\"")
                     + HelpExampleRpc("smsginbox", "\"all\", \"address\"") +
                     "Count unread messages:"
-                    + HelpExampleCli("smsginbox", "\"count\" \"\" \"{\\\"unread_only\\\":true}\"")
+                    + HelpExampleCli("smsginbox", "\"count\" \"\" \"{\\\"unread_only\\\":true}\"") +
+                    "Display the next 100 messages:"
+                    + HelpExampleCli("smsginbox", "\"all\" \"\" \"{\\\"from\\\":\\\"msgid\\\",\\\"limit\\\":100}\"")
                 },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
@@ -1364,6 +1464,8 @@ static RPCHelpMan smsginbox()
     bool update_status = true;
     bool unread_only = false;
     int offset = 0, max_results = -1;
+    std::vector<uint8_t> from;
+    CKeyID address;
     if (request.params[2].isObject()) {
         UniValue options = request.params[2].get_obj();
         if (options["updatestatus"].isBool()) {
@@ -1381,6 +1483,7 @@ static RPCHelpMan smsginbox()
         if (options["max_results"].isNum()) {
             max_results = options["max_results"].getInt<int>();
         }
+        ParsePageOptions(options, from, max_results, address);
     }
 
     UniValue result(UniValue::VOBJ);
@@ -1397,16 +1500,21 @@ static RPCHelpMan smsginbox()
         if (mode == "count") {
             LOCK(smsg::cs_smsgDB);
 
-            smsg::SecMsgStored smsgStored;
-            leveldb::Iterator *it = dbInbox.pdb->NewIterator(leveldb::ReadOptions());
-            while (dbInbox.NextSmesg(it, smsg::DBK_INBOX, chKey, smsgStored)) {
-                if (unread_only &&
-                    !(smsgStored.status & SMSG_MASK_UNREAD)) {
-                    continue;
+            if (address.IsNull()) {
+                nMessages = dbInbox.GetCount(smsg::DBK_INBOX, unread_only);
+            } else {
+                smsg::SecMsgStored smsgStored;
+                std::string prefix = GetIndexPrefix(smsg::DBK_INBOX, false, address);
+                leveldb::Iterator *it = dbInbox.pdb->NewIterator(leveldb::ReadOptions());
+                while (dbInbox.NextIndexKey(it, prefix, smsg::DBK_INBOX, nullptr, chKey)) {
+                    if (unread_only &&
+                        !(dbInbox.ReadSmesg(chKey, smsgStored) && (smsgStored.status & SMSG_MASK_UNREAD))) {
+                        continue;
+                    }
+                    nMessages++;
                 }
-                nMessages++;
+                delete it;
             }
-            delete it;
 
             result.pushKV("result", strprintf("Counted %s messages", unread_only ? "unread" : "all"));
             result.pushKV("num_messages", (int)nMessages);
@@ -1437,7 +1545,19 @@ static RPCHelpMan smsginbox()
             leveldb::Iterator *it = dbInbox.pdb->NewIterator(leveldb::ReadOptions());
             UniValue messageList(UniValue::VARR);
 
-            while (dbInbox.NextSmesg(it, smsg::DBK_INBOX, chKey, smsgStored)) {
+            std::string prefix = GetIndexPrefix(smsg::DBK_INBOX, fCheckReadStatus, address);
+            uint8_t chLastKey[30];
+            bool have_last = false, have_more = false;
+            while (dbInbox.NextIndexKey(it, prefix, smsg::DBK_INBOX, from.empty() ? nullptr : from.data(), chKey)) {
+                if (max_results >= 0 && (int)nMessages >= max_results) {
+                    have_more = true;
+                    break;
+                }
+                memcpy(chLastKey, chKey, 30);
+                have_last = true;
+                if (!dbInbox.ReadSmesg(chKey, smsgStored)) {
+                    continue;
+                }
                 if (fCheckReadStatus &&
                     !(smsgStored.status & SMSG_MASK_UNREAD)) {
                     continue;
@@ -1446,9 +1566,6 @@ static RPCHelpMan smsginbox()
                     offset--;
                     continue;
                 }
-                if (max_results >= 0 && (int)nMessages >= max_results) {
-                    break;
-                }
                 const unsigned char *pHeader = smsgStored.vchMessage.data();
                 smsg::SecureMessage smsg(pHeader);
                 const smsg::SecureMessage *psmsg = &smsg;
@@ -1517,6 +1634,9 @@ static RPCHelpMan smsginbox()
 
             result.pushKV("messages", messageList);
             result.pushKV("result", strprintf("%u", nMessages));
+            if (have_more && have_last) {
+                result.pushKV("next", HexStr(Span<const unsigned char>(&chLastKey[2], 28)));
+            }
         } else {
             result.pushKV("result", "Unknown Mode.");
             result.pushKV("expected", "all|unread|clear.");
@@ -1543,6 +1663,9 @@ static RPCHelpMan smsgoutbox()
                             {"stashed", RPCArg::Type::BOOL, RPCArg::Default{false}, "Display stashed messages."},
                             {"offset", RPCArg::Type::NUM, RPCArg::Default{""}, "Skip the first \"offset\" messages"},
                             {"max_results", RPCArg::Type::NUM, RPCArg::Default{""}, "Return only \"max_results\" messages"},
+                            {"from", RPCArg::Type::STR_HEX, RPCArg::Default{""}, "Start after the message with msgid \"from\", pass \"next\" from the previous result to page through messages"},
+                            {"limit", RPCArg::Type::NUM, RPCArg::Default{""}, "Return at most \"limit\" messages, overrides \"max_results\""},
+                            {"address", RPCArg::Type::STR, RPCArg::Default{""}, "Only messages sent to \"address\""},
                         },
                         "options"},
                 },
@@ -1572,6 +1695,7 @@ static RPCHelpMan smsgoutbox()
                                 {RPCResult::Type::STR, "error", /*optional=*/true, "Message error"},
                             }},
                         }},
+                        {RPCResult::Type::STR_HEX, "next", /*optional=*/true, "msgid to pass as \"from\" to continue listing, set if the listing stopped at the limit"},
                         {RPCResult::Type::STR, "expected", /*optional=*/true, "values understood"},
                         {RPCResult::Type::NUM, "num_messages", /*optional=*/true, "Number of messages counted"},
                 }},
@@ -1592,6 +1716,8 @@ static RPCHelpMan smsgoutbox()
     bool show_stashed = false;
     std::string sEnc = "text";
     int offset = 0, max_results = -1;
+    std::vector<uint8_t> from;
+    CKeyID address;
     if (request.params[2].isObject()) {
         UniValue options = request.params[2].get_obj();
         if (options["encoding"].isStr()) {
@@ -1609,6 +1735,7 @@ static RPCHelpMan smsgoutbox()
         if (options["max_results"].isNum()) {
             max_results = options["max_results"].getInt<int>();
         }
+        ParsePageOptions(options, from, max_results, address);
     }
 
     if (show_sending && show_stashed) {
@@ -1632,11 +1759,16 @@ static RPCHelpMan smsgoutbox()
 
         std::string db_prefix = show_sending ? smsg::DBK_QUEUED : show_stashed ? smsg::DBK_STASHED : smsg::DBK_OUTBOX;
         if (mode == "count") {
-            leveldb::Iterator *it = dbOutbox.pdb->NewIterator(leveldb::ReadOptions());
-            while (dbOutbox.NextSmesgKey(it, db_prefix, chKey)) {
-                nMessages++;
+            if (address.IsNull()) {
+                nMessages = dbOutbox.GetCount(db_prefix, false);
+            } else {
+                std::string prefix = GetIndexPrefix(db_prefix, false, address);
+                leveldb::Iterator *it = dbOutbox.pdb->NewIterator(leveldb::ReadOptions());
+                while (dbOutbox.NextIndexKey(it, prefix, db_prefix, nullptr, chKey)) {
+                    nMessages++;
+                }
+                delete it;
             }
-            delete it;
 
             result.pushKV("result", "Counted sent messages");
             result.pushKV("num_messages", (int)nMessages);
@@ -1661,14 +1793,23 @@ static RPCHelpMan smsgoutbox()
 
             UniValue messageList(UniValue::VARR);
 
-            while (dbOutbox.NextSmesg(it, db_prefix, chKey, smsgStored)) {
+            std::string prefix = GetIndexPrefix(db_prefix, false, address);
+            uint8_t chLastKey[30];
+            bool have_last = false, have_more = false;
+            while (dbOutbox.NextIndexKey(it, prefix, db_prefix, from.empty() ? nullptr : from.data(), chKey)) {
+                if (max_results >= 0 && (int)nMessages >= max_results) {
+                    have_more = true;
+                    break;
+                }
+                memcpy(chLastKey, chKey, 30);
+                have_last = true;
+                if (!dbOutbox.ReadSmesg(chKey, smsgStored)) {
+                    continue;
+                }
                 if (offset > 0) {
                     offset--;
                     continue;
                 }
-                if (max_results >= 0 && (int)nMessages >= max_results) {
-                    break;
-                }
                 const unsigned char *pHeader = smsgStored.vchMessage.data();
                 smsg::SecureMessage smsg(pHeader);
                 const smsg::SecureMessage *psmsg = &smsg;
@@ -1728,6 +1869,9 @@ static RPCHelpMan smsgoutbox()
 
             result.pushKV("messages" ,messageList);
             result.pushKV("result", strprintf("%u", nMessages));
+            if (have_more && have_last) {
+                result.pushKV("next", HexStr(Span<const unsigned char>(&chLastKey[2], 28)));
+            }
         } else {
             result.pushKV("result", "Unknown Mode.");
             result.pushKV("expected", "all|clear.");
@@ -1744,7 +1888,7 @@ static RPCHelpMan smsgbuckets()
     return RPCHelpMan{"smsgbuckets",
                 "\nDisplay message bucket information.\n",
                 {
-                    {"mode", RPCArg::Type::STR, RPCArg::Default{"stats"}, "stats|total|dump. \"dump\" will remove all buckets."},
+                    {"mode", RPCArg::Type::STR, RPCArg::Default{"stats"}, "stats|total|compact|dump. \"compact\" will rewrite all bucket files with expired or purged messages. \"dump\" will remove all buckets."},
                 },
                 RPCResult{
                     RPCResult::Type::ANY, "", ""
@@ -1769,22 +1913,32 @@ static RPCHelpMan smsgbuckets()
     if (mode == "stats" || mode == "total") {
         bool show_buckets = mode != "total" ? true : false;
         uint32_t nBuckets = 0;
-        uint32_t nMessages = 0;
-        uint64_t nBytes = 0;
+        uint32_t nMessages = 0, nPaidMessages = 0;
+        uint64_t nBytes = 0, nActiveBytes = 0;
+        uint64_t nDeadBytes = 0;
+        uint64_t nCompactedFiles = 0, nCompactedBytes = 0;
         {
             LOCK(smsgModule.cs_smsg);
+            smsgModule.m_bucket_writers.FlushAll(false, false); // For the file sizes
+            int64_t now = GetAdjustedTime();
+            nCompactedFiles = smsgModule.m_compacted_files;
+            nCompactedBytes = smsgModule.m_compacted_bytes;
             std::map<int64_t, smsg::SecMsgBucket>::const_iterator it;
             for (it = smsgModule.buckets.begin(); it != smsgModule.buckets.end(); ++it) {
-                const std::set<smsg::SecMsgToken> &tokenSet = it->second.setTokens;
+                const smsg::SecMsgTokenSet &tokenSet = it->second.setTokens;
 
                 std::string sBucket = ToString(it->first);
                 std::string sFile = sBucket + "_01.dat";
                 std::string sHash = ToString((int64_t)it->second.hash);
 
                 size_t nActiveMessages = it->second.CountActive();
+                uint64_t nBucketDeadBytes = it->second.CountDeadBytes(now);
 
                 nBuckets++;
                 nMessages += nActiveMessages;
+                nPaidMessages += it->second.m_active_paid;
+                nActiveBytes += it->second.m_active_bytes;
+                nDeadBytes += nBucketDeadBytes;
 
                 UniValue objM(UniValue::VOBJ);
                 if (show_buckets) {
@@ -1792,8 +1946,14 @@ static RPCHelpMan smsgbuckets()
                     PushTime(objM, "time", it->first);
                     objM.pushKV("no. messages", strprintf("%u", tokenSet.size()));
                     objM.pushKV("active messages", strprintf("%u", nActiveMessages));
+                    objM.pushKV("paid messages", strprintf("%u", it->second.m_active_paid));
+                    objM.pushKV("active size", part::BytesReadable(it->second.m_active_bytes));
+                    if (nActiveMessages > 0) {
+                        objM.pushKV("next expiry", part::GetTimeString(it->second.m_next_expiry, cbuf, sizeof(cbuf)));
+                    }
                     objM.pushKV("hash", sHash);
                     objM.pushKV("last changed", part::GetTimeString(it->second.timeChanged, cbuf, sizeof(cbuf)));
+                    objM.pushKV("reclaimable", part::BytesReadable(nBucketDeadBytes));
                 }
 
                 fs::path fullPath = gArgs.GetDataDirNet() / fs::PathFromString(smsg::STORE_DIR) / fs::PathFromString(sFile);
@@ -1825,15 +1985,29 @@ static RPCHelpMan smsgbuckets()
         objM.pushKV("numbuckets", (int)nBuckets);
         objM.pushKV("numpurged", (int)smsgModule.setPurged.size());
         objM.pushKV("messages", (int)nMessages);
+        objM.pushKV("paid_messages", (int)nPaidMessages);
+        objM.pushKV("active_bytes", nActiveBytes);
         objM.pushKV("size", part::BytesReadable(nBytes));
+        objM.pushKV("reclaimable", part::BytesReadable(nDeadBytes));
+        objM.pushKV("compacted_files", nCompactedFiles);
+        objM.pushKV("reclaimed", part::BytesReadable(nCompactedBytes));
+        objM.pushKV("reclaimed_bytes", nCompactedBytes);
         if (arrBuckets.size() > 0) {
             result.pushKV("buckets", arrBuckets);
         }
         result.pushKV("total", objM);
     } else
+    if (mode == "compact") {
+        uint64_t nReclaimed = 0;
+        size_t nCompacted = smsgModule.CompactBuckets(0, nReclaimed);
+        result.pushKV("result", "Compacted bucket files.");
+        result.pushKV("compacted_files", (uint64_t)nCompacted);
+        result.pushKV("reclaimed_bytes", nReclaimed);
+    } else
     if (mode == "dump") {
         {
             LOCK(smsgModule.cs_smsg);
+            smsgModule.m_bucket_writers.CloseAll(false);
             std::map<int64_t, smsg::SecMsgBucket>::iterator it;
             for (it = smsgModule.buckets.begin(); it != smsgModule.buckets.end(); ++it) {
                 std::string sFile = ToString(it->first) + "_01.dat";
@@ -1853,7 +2027,7 @@ static RPCHelpMan smsgbuckets()
         result.pushKV("result", "Removed all buckets.");
     } else {
         result.pushKV("result", "Unknown Mode.");
-        result.pushKV("expected", "stats|total|dump.");
+        result.pushKV("expected", "stats|total|compact|dump.");
     }
 
     return result;
@@ -2563,7 +2737,52 @@ static RPCHelpMan smsggetinfo()
                         {RPCResult::Type::ARR, "enabled_wallets", /*optional=*/true, "Names of enabled wallets",
                         {
                             {RPCResult::Type::STR_HEX, "", "wallet_name"},
-                        }}
+                        }},
+                        {RPCResult::Type::OBJ, "trial_decryption", /*optional=*/true, "Cost of checking received messages against the receiving keys",
+                        {
+                            {RPCResult::Type::NUM, "messages", "Messages checked"},
+                            {RPCResult::Type::NUM, "key_attempts", "Keys tried"},
+                            {RPCResult::Type::NUM, "total_us", "Total time spent in microseconds"},
+                            {RPCResult::Type::NUM, "avg_us_per_message", "Average time per message in microseconds"},
+                            {RPCResult::Type::NUM, "avg_us_per_attempt", "Average time per key tried in microseconds"},
+                        }},
+                        {RPCResult::Type::OBJ, "pow", /*optional=*/true, "Proof of work of outgoing free messages",
+                        {
+                            {RPCResult::Type::NUM, "threads", "Threads searching for a valid nonce"},
+                            {RPCResult::Type::NUM, "queued", "Messages waiting for proof of work"},
+                            {RPCResult::Type::NUM, "solved", "Messages solved since startup"},
+                            {RPCResult::Type::NUM, "hashes", "Hashes computed since startup"},
+                            {RPCResult::Type::NUM, "avg_ms_per_message", "Average time to solve a message in milliseconds"},
+                            {RPCResult::Type::NUM, "hashes_per_second", "Average proof of work hash rate"},
+                            {RPCResult::Type::NUM, "current_ms", /*optional=*/true, "Time spent on the message being solved in milliseconds"},
+                            {RPCResult::Type::NUM, "eta_seconds", /*optional=*/true, "Estimated seconds until the queue is empty, from the average time per message"},
+                        }},
+                        {RPCResult::Type::OBJ, "receive", /*optional=*/true, "Validation of message bunches received from peers",
+                        {
+                            {RPCResult::Type::NUM, "threads", "Threads validating and storing received messages"},
+                            {RPCResult::Type::NUM, "queued", "Bunches waiting to be validated"},
+                            {RPCResult::Type::NUM, "queued_bytes", "Size of the bunches waiting or being validated"},
+                            {RPCResult::Type::NUM, "processed", "Bunches validated since startup"},
+                            {RPCResult::Type::NUM, "dropped", "Bunches dropped as the queue was full"},
+                        }},
+                        {RPCResult::Type::OBJ, "notifications", /*optional=*/true, "New message notifications",
+                        {
+                            {RPCResult::Type::NUM, "queued", "New messages waiting to be published"},
+                            {RPCResult::Type::NUM, "replay_queued", "Messages from smsgzmqpush waiting to be published"},
+                            {RPCResult::Type::NUM, "sent", "Notifications published since startup"},
+                            {RPCResult::Type::NUM, "dropped", "Notifications dropped as the queue was full"},
+                            {RPCResult::Type::NUM_TIME, "cursor_time", "Time received of the last notified message"},
+                            {RPCResult::Type::STR_HEX, "cursor_hash", "Hash of the last notified message"},
+                        }},
+                        {RPCResult::Type::OBJ, "store", /*optional=*/true, "Messages held in the buckets",
+                        {
+                            {RPCResult::Type::NUM, "buckets", "Number of buckets"},
+                            {RPCResult::Type::NUM, "messages", "Active messages"},
+                            {RPCResult::Type::NUM, "paid_messages", "Active paid messages"},
+                            {RPCResult::Type::NUM, "free_messages", "Active free messages"},
+                            {RPCResult::Type::NUM, "active_bytes", "Payload size of the active messages"},
+                            {RPCResult::Type::NUM_TIME, "next_expiry", /*optional=*/true, "Time the first active message expires"},
+                        }},
                     },
                 },
                 RPCExamples{
@@ -2585,6 +2804,83 @@ static RPCHelpMan smsggetinfo()
         }
         obj.pushKV("enabled_wallets", wallet_names);
 #endif
+        uint64_t n_messages = smsgModule.m_trial_messages, n_keys = smsgModule.m_trial_keys, n_us = smsgModule.m_trial_us;
+        UniValue trial(UniValue::VOBJ);
+        trial.pushKV("messages", n_messages);
+        trial.pushKV("key_attempts", n_keys);
+        trial.pushKV("total_us", n_us);
+        trial.pushKV("avg_us_per_message", n_messages > 0 ? (double)n_us / n_messages : 0.0);
+        trial.pushKV("avg_us_per_attempt", n_keys > 0 ? (double)n_us / n_keys : 0.0);
+        obj.pushKV("trial_decryption", trial);
+
+        size_t n_queued = smsgModule.CountQueued();
+        uint64_t n_solved = smsgModule.m_pow_messages, n_hashes = smsgModule.m_pow_hashes, n_pow_us = smsgModule.m_pow_us;
+        int64_t current_start = smsgModule.m_pow_current_start;
+        UniValue pow(UniValue::VOBJ);
+        pow.pushKV("threads", smsgModule.m_pow_threads);
+        pow.pushKV("queued", (uint64_t)n_queued);
+        pow.pushKV("solved", n_solved);
+        pow.pushKV("hashes", n_hashes);
+        pow.pushKV("avg_ms_per_message", n_solved > 0 ? (double)n_pow_us / n_solved / 1000.0 : 0.0);
+        pow.pushKV("hashes_per_second", n_pow_us > 0 ? (double)n_hashes * 1000000.0 / n_pow_us : 0.0);
+        int64_t current_us = current_start > 0 ? GetTimeMicros() - current_start : 0;
+        if (current_start > 0) {
+            pow.pushKV("current_ms", current_us / 1000);
+        }
+        if (n_solved > 0) {
+            double avg_us = (double)n_pow_us / n_solved;
+            double eta_us = std::max(0.0, avg_us * n_queued - current_us);
+            pow.pushKV("eta_seconds", (int64_t)(eta_us / 1000000.0));
+        }
+        obj.pushKV("pow", pow);
+
+        UniValue receive(UniValue::VOBJ);
+        {
+            LOCK(smsgModule.cs_receive);
+            receive.pushKV("threads", smsgModule.m_receive_threads);
+            receive.pushKV("queued", (uint64_t)smsgModule.m_receive_queue.size());
+            receive.pushKV("queued_bytes", (uint64_t)smsgModule.m_receive_queue_bytes);
+            receive.pushKV("processed", smsgModule.m_receive_processed);
+            receive.pushKV("dropped", smsgModule.m_receive_dropped);
+        }
+        obj.pushKV("receive", receive);
+
+        UniValue notifications(UniValue::VOBJ);
+        {
+            LOCK(smsgModule.cs_notify);
+            notifications.pushKV("queued", (uint64_t)smsgModule.m_notify_queue.size());
+            notifications.pushKV("replay_queued", (uint64_t)smsgModule.m_notify_replay.size());
+            notifications.pushKV("sent", smsgModule.m_notify_sent);
+            notifications.pushKV("dropped", smsgModule.m_notify_dropped);
+            notifications.pushKV("cursor_time", smsgModule.m_notify_cursor_time);
+            notifications.pushKV("cursor_hash", smsgModule.m_notify_cursor_hash.ToString());
+        }
+        obj.pushKV("notifications", notifications);
+
+        UniValue store(UniValue::VOBJ);
+        {
+            LOCK(smsgModule.cs_smsg);
+            uint64_t n_active = 0, n_paid = 0, n_bytes = 0;
+            int64_t next_expiry = 0;
+            for (const auto &it : smsgModule.buckets) {
+                const smsg::SecMsgBucket &bucket = it.second;
+                n_active += bucket.nActive;
+                n_paid += bucket.m_active_paid;
+                n_bytes += bucket.m_active_bytes;
+                if (bucket.nActive > 0 && (next_expiry == 0 || bucket.m_next_expiry < next_expiry)) {
+                    next_expiry = bucket.m_next_expiry;
+                }
+            }
+            store.pushKV("buckets", (uint64_t)smsgModule.buckets.size());
+            store.pushKV("messages", n_active);
+            store.pushKV("paid_messages", n_paid);
+            store.pushKV("free_messages", n_active - n_paid);
+            store.pushKV("active_bytes", n_bytes);
+            if (next_expiry > 0) {
+                store.pushKV("next_expiry", next_expiry);
+            }
+        }
+        obj.pushKV("store", store);
     }
 
     return obj;
@@ -2614,6 +2910,12 @@ static RPCHelpMan smsgpeers()
                     {RPCResult::Type::NUM, "ignoredcounter", "Number of times peer has been ignored"},
                     {RPCResult::Type::NUM, "num_pending_inv", "Number of buckets peer has to show"},
                     {RPCResult::Type::NUM, "num_shown_buckets", "Number of buckets peer showed last"},
+                    {RPCResult::Type::NUM, "bytes_received", "Bytes of smsg traffic received from peer"},
+                    {RPCResult::Type::NUM, "msgs_received", "Number of smsg network messages received from peer"},
+                    {RPCResult::Type::NUM, "smsgs_received", "Number of secure messages received from peer and accepted for validation"},
+                    {RPCResult::Type::NUM, "receive_time_us", "Microseconds spent validating and storing secure messages from peer"},
+                    {RPCResult::Type::NUM, "dropped_over_quota", "Number of network messages dropped by -smsgpeerbytesrate and -smsgpeermsgrate, or as the receive queue was full"},
+                    {RPCResult::Type::NUM, "receive_queued", "Number of message bunches from peer waiting to be validated"},
                     {RPCResult::Type::OBJ, "pending_inv_buckets", /*optional=*/true, "", {
                         {RPCResult::Type::NUM, "active", "Active messages in bucket"},
                         {RPCResult::Type::STR, "hash", "Bucket hash"},
@@ -2648,19 +2950,23 @@ static RPCHelpMan smsgpeers()
 static RPCHelpMan smsgzmqpush()
 {
     return RPCHelpMan{"smsgzmqpush",
-            "\nResend ZMQ notifications.\n",
+            "\nResend ZMQ notifications.\n"
+            "Notifications are queued and published in the background.\n",
             {
                 {"options", RPCArg::Type::OBJ, RPCArg::Default{UniValue::VOBJ}, "",
                     {
                         {"timefrom", RPCArg::Type::NUM, RPCArg::Default{0}, "Skip messages received before timestamp."},
                         {"timeto", RPCArg::Type::NUM, RPCArg::Default{"max_int"}, "Skip messages received after timestamp."},
                         {"unreadonly", RPCArg::Type::BOOL, RPCArg::Default{true}, "Resend only unread messages."},
+                        {"resume", RPCArg::Type::BOOL, RPCArg::Default{false}, "Resend only messages received after the last notified message, overrides \"timefrom\"."},
                     },
                     "options"},
             },
             RPCResult{
                 RPCResult::Type::OBJ, "", "", {
-                    {RPCResult::Type::NUM, "numsent", "Number of notifications sent"},
+                    {RPCResult::Type::NUM, "numsent", "Number of notifications queued"},
+                    {RPCResult::Type::NUM_TIME, "cursor_time", "Time received of the last notified message"},
+                    {RPCResult::Type::STR_HEX, "cursor_hash", "Hash of the last notified message"},
             }},
             RPCExamples{
         HelpExampleCli("smsgzmqpush", "'{ \"unreadonly\": false }'") +
@@ -2677,6 +2983,7 @@ static RPCHelpMan smsgzmqpush()
     int64_t timefrom = 0;
     int64_t timeto = std::numeric_limits<int64_t>::max();
     int num_sent = 0;
+    bool resume = false;
 
     UniValue options = request.params[0];
     if (options.isObject()) {
@@ -2685,6 +2992,7 @@ static RPCHelpMan smsgzmqpush()
             {"timefrom",        UniValueType(UniValue::VNUM)},
             {"timeto",          UniValueType(UniValue::VNUM)},
             {"unreadonly",      UniValueType(UniValue::VBOOL)},
+            {"resume",          UniValueType(UniValue::VBOOL)},
         }, true, true);
         if (options["timefrom"].isNum()) {
             timefrom = options["timefrom"].getInt<int64_t>();
@@ -2695,8 +3003,23 @@ static RPCHelpMan smsgzmqpush()
         if (options["unreadonly"].isBool()) {
             unreadonly = options["unreadonly"].get_bool();
         }
+        if (options["resume"].isBool()) {
+            resume = options["resume"].get_bool();
+        }
     }
 
+    int64_t cursor_time;
+    uint160 cursor_hash;
+    {
+        LOCK(smsgModule.cs_notify);
+        cursor_time = smsgModule.m_notify_cursor_time;
+        cursor_hash = smsgModule.m_notify_cursor_hash;
+    }
+    if (resume) {
+        timefrom = cursor_time;
+    }
+
+    std::deque<smsg::SecMsgNotification> items;
     {
         LOCK(smsg::cs_smsgDB);
 
@@ -2718,23 +3041,32 @@ static RPCHelpMan smsgzmqpush()
                 continue;
             }
 
-            smsg::SecureMessage smsg(smsgStored.vchMessage.data());
-            const smsg::SecureMessage *psmsg = &smsg;
-
-            std::vector<uint8_t> vchUint160;
-            vchUint160.resize(20);
-            memcpy(vchUint160.data(), &chKey[10], 20);
-            uint160 hash(vchUint160);
+            if (smsgStored.vchMessage.size() < smsg::SMSG_HDR_LEN) {
+                continue;
+            }
 
-            GetMainSignals().NewSecureMessage(psmsg, hash);
+            smsg::SecMsgNotification item;
+            item.timeReceived = smsgStored.timeReceived;
+            memcpy(item.hash.begin(), &chKey[10], 20);
+            if (resume && item.timeReceived == cursor_time && !(cursor_hash < item.hash)) {
+                continue;
+            }
+            item.vchHeader.assign(smsgStored.vchMessage.begin(), smsgStored.vchMessage.begin() + smsg::SMSG_HDR_LEN);
+            items.push_back(std::move(item));
             num_sent++;
         }
         delete it;
     } // cs_smsgDB
 
+    if (!items.empty() && !smsgModule.QueueReplay(std::move(items))) {
+        throw JSONRPCError(RPC_MISC_ERROR, "A previous replay is still being sent.");
+    }
+
     UniValue result(UniValue::VOBJ);
 
     result.pushKV("numsent", num_sent);
+    result.pushKV("cursor_time", cursor_time);
+    result.pushKV("cursor_hash", cursor_hash.ToString());
 
     return result;
 },
@@ -2792,7 +3124,7 @@ static RPCHelpMan smsgdebug()
         std::map<int64_t, smsg::SecMsgBucket>::const_iterator it;
         std::vector<uint8_t> vch_msg;
         for (it = smsgModule.buckets.begin(); it != smsgModule.buckets.end(); ++it) {
-            const std::set<smsg::SecMsgToken> &token_set = it->second.setTokens;
+            const smsg::SecMsgTokenSet &token_set = it->second.setTokens;
             for (auto token : token_set) {
                 if (active_only && token.timestamp + token.ttl < now) {
                     continue; // Skip expired
@@ -2884,6 +3216,7 @@ void RegisterSmsgRPCCommands(CRPCTable &t)
         {"smsg", &smsggetpubkey},
         {"smsg", &smsgsend},
         {"smsg", &smsgfund},
+        {"smsg", &smsgfundqueue},
         {"smsg", &smsgsendanon},
         {"smsg", &smsginbox},
         {"smsg", &smsgoutbox},
@@ -27,17 +27,25 @@ Notes:
 #include <secp256k1.h>
 #include <secp256k1_ecdh.h>
 #include <crypto/hmac_sha256.h>
+#include <crypto/siphash.h>
 #include <crypto/sha512.h>
+#include <key/stealth.h>
+#include <memusage.h>
 #include <wallet/ismine.h>
 #include <support/allocators/secure.h>
 #include <util/thread.h>
+#include <util/threadnames.h>
+#include <util/translation.h>
 #include <util/strencodings.h>
 #include <consensus/validation.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <smsg/bucketfile.h>
 #include <smsg/crypter.h>
 #include <smsg/db.h>
+#include <smsg/pubkeyindex.h>
 #include <random.h>
+#include <scheduler.h>
 #include <chain.h>
 #include <netmessagemaker.h>
 #include <net.h>
@@ -46,9 +54,12 @@ Notes:
 #include <univalue.h>
 #include <node/context.h>
 #include <node/blockstorage.h>
+#include <node/ui_interface.h>
 #include <util/string.h>
 #include <util/system.h>
 #include <util/syserror.h>
+#include <util/time.h>
+#include <util/trace.h>
 #include <timedata.h>
 
 #ifdef ENABLE_WALLET
@@ -66,6 +77,7 @@ Notes:
 #include <errno.h>
 #include <limits>
 
+#include <minisketch.h>
 #include <xxhash/xxhash.h>
 #include <boost/algorithm/string/replace.hpp>
 
@@ -81,9 +93,10 @@ const char *HAVE="smsgHave";
 const char *WANT="smsgWant";
 const char *MSG="smsgMsg";
 const char *IGNORING="smsgIgnore";
+const char *SKETCH="smsgSketch";
 
 const static std::string allTypes[] = {
-    PING, PONG, DISABLED, INV, SHOW, HAVE, WANT, MSG, IGNORING
+    PING, PONG, DISABLED, INV, SHOW, HAVE, WANT, MSG, IGNORING, SKETCH
 };
 } // namespace SMSGMsgType
 
@@ -100,8 +113,15 @@ uint32_t SMSG_RETENTION         = SMSG_MAX_PAID_TTL;
 
 const size_t MAX_BUNCH_MESSAGES = 500;
 const size_t MAX_BUNCH_BYTES = SMSG_MAX_MSG_BYTES_PAID * 4;
+const double PEER_BYTES_BURST = MAX_BUNCH_BYTES * 4;
+const double PEER_MSGS_BURST = MAX_BUNCH_MESSAGES * 2;
 const uint16_t MAX_WANT_SENT = 16000;
 const size_t SMSG_MAX_SHOW = 64;
+const size_t SMSG_MAX_SCAN_THREADS = 8;
+const size_t SMSG_SCAN_CHUNK = 64;        // Messages claimed by a scan thread at a time
+const size_t SMSG_SCAN_BATCH_SIZE = 256;  // Inbox records per db write batch
+const size_t SMSG_MAX_SKETCH_CAPACITY = 256;
+const size_t SMSG_SKETCH_MARGIN = 8;      // Added to the expected difference when sizing a sketch
 
 boost::signals2::signal<void (SecMsgStored &inboxHdr)> NotifySecMsgInboxChanged;
 boost::signals2::signal<void (SecMsgStored &outboxHdr)> NotifySecMsgOutboxChanged;
@@ -122,7 +142,7 @@ inline static void memput_int64_le(uint8_t *p, int64_t v) {
     memcpy(p, &v, 8);
 }
 
-inline static uint32_t memget_int64_le(uint8_t *p) {
+inline static uint32_t memget_int64_le(const uint8_t *p) {
     int64_t v = 0;
     memcpy(&v, p, 8);
     v = (int64_t) le64toh((uint64_t) v);
@@ -134,198 +154,483 @@ inline static void memput_uint32_le(uint8_t *p, uint32_t v) {
     memcpy(p, &v, 4);
 }
 
-inline static uint32_t memget_uint32_le(uint8_t *p) {
+inline static uint32_t memget_uint32_le(const uint8_t *p) {
     uint32_t v = 0;
     memcpy(&v, p, 4);
     v = le32toh(v);
     return v;
 }
 
-void SecMsgBucket::hashBucket(int64_t bucket_time)
+std::pair<SecMsgTokenSet::const_iterator, bool> SecMsgTokenSet::insert(const SecMsgToken &token)
+{
+    assert(m_num_sorted == m_tokens.size());
+    if (m_tokens.empty() || m_tokens.back() < token) {
+        m_tokens.push_back(token);
+        m_num_sorted++;
+        return {std::prev(m_tokens.cend()), true};
+    }
+    auto it = std::lower_bound(m_tokens.begin(), m_tokens.end(), token);
+    if (!(token < *it)) {
+        return {it, false};
+    }
+    it = m_tokens.insert(it, token);
+    m_num_sorted++;
+    return {it, true};
+};
+
+void SecMsgTokenSet::merge()
+{
+    if (m_num_sorted == m_tokens.size()) {
+        return;
+    }
+    auto mid = m_tokens.begin() + m_num_sorted;
+    std::sort(mid, m_tokens.end());
+    std::inplace_merge(m_tokens.begin(), mid, m_tokens.end()); // Stable, existing tokens sort first
+    auto last = std::unique(m_tokens.begin(), m_tokens.end(), [](const SecMsgToken &a, const SecMsgToken &b) {
+        return !(a < b) && !(b < a);
+    });
+    m_tokens.erase(last, m_tokens.end());
+    m_num_sorted = m_tokens.size();
+};
+
+size_t SecMsgTokenSet::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(m_tokens);
+};
+
+SecMsgTokenSet::const_iterator SecMsgTokenSet::find(const SecMsgToken &token) const
+{
+    assert(m_num_sorted == m_tokens.size());
+    auto it = std::lower_bound(m_tokens.begin(), m_tokens.end(), token);
+    if (it == m_tokens.end() || token < *it) {
+        return m_tokens.end();
+    }
+    return it;
+};
+
+std::pair<SecMsgTokenSet::const_iterator, SecMsgTokenSet::const_iterator> SecMsgTokenSet::equal_range(int64_t timestamp) const
 {
-    XXH32_state_t *state = XXH32_createState();
-    XXH32_reset(state, 1);
+    assert(m_num_sorted == m_tokens.size());
+    auto it_begin = std::partition_point(m_tokens.begin(), m_tokens.end(), [timestamp](const SecMsgToken &t) { return t.timestamp < timestamp; });
+    auto it_end = std::partition_point(it_begin, m_tokens.end(), [timestamp](const SecMsgToken &t) { return t.timestamp <= timestamp; });
+    return {it_begin, it_end};
+};
+
+static uint32_t GetTokenHash(const SecMsgToken &token)
+{
+    return XXH32(token.sample, 8, 1);
+};
 
+void SecMsgBucket::AddActive(const SecMsgToken &token)
+{
+    hash += GetTokenHash(token);
+    nActive++;
+    m_active_paid += token.m_paid ? 1 : 0;
+    m_active_bytes += token.m_payload_size;
+    if (nActive == 1 || token.timestamp + token.ttl < m_next_expiry) {
+        m_next_expiry = token.timestamp + token.ttl;
+    }
+    m_hash_ordered_valid = false;
+};
+
+void SecMsgBucket::hashBucket(int64_t bucket_time)
+{
     int64_t now = GetAdjustedTime();
 
+    hash = 0;
     nActive = 0;
-    nLeastTTL = 0;
-    for (auto it = setTokens.begin(); it != setTokens.end(); ++it) {
-        if (it->timestamp + it->ttl < now) {
+    m_active_paid = 0;
+    m_active_bytes = 0;
+    m_next_expiry = 0;
+    for (const auto &token : setTokens) {
+        if (token.timestamp + token.ttl < now) {
             continue;
         }
+        AddActive(token);
+    }
+    MarkChanged(bucket_time);
+};
 
-        XXH32_update(state, it->sample, 8);
-        if (it->ttl > 0 && (nLeastTTL == 0 || it->ttl < nLeastTTL)) {
-            nLeastTTL = it->ttl;
+bool SecMsgBucket::AddToken(const SecMsgToken &token, int64_t now)
+{
+    if (!setTokens.insert(token).second) {
+        return false;
+    }
+    if (token.timestamp + token.ttl >= now) {
+        AddActive(token);
+    }
+    return true;
+};
+
+void SecMsgBucket::ExpireToken(const SecMsgToken &token, int64_t now)
+{
+    if (token.timestamp + token.ttl >= now) {
+        hash -= GetTokenHash(token);
+        nActive--;
+        m_active_paid -= token.m_paid ? 1 : 0;
+        m_active_bytes -= token.m_payload_size;
+        m_hash_ordered_valid = false;
+        if (nActive == 0) {
+            m_next_expiry = 0;
         }
-        nActive++;
     }
+    token.ttl = 0;
+};
 
-    uint32_t hash_new = XXH32_digest(state);
-    XXH32_freeState(state);
+void SecMsgBucket::MarkChanged(int64_t bucket_time)
+{
+    if (timeChanged != 0 && hash == m_hash_changed) {
+        return;
+    }
+    LogPrint(BCLog::SMSG, "Bucket %d hashed %u messages updated from %u to %u.\n", bucket_time, nActive, m_hash_changed, hash);
+    m_hash_changed = hash;
+    timeChanged = GetTime();
+};
 
-    if (hash != hash_new) {
-        LogPrint(BCLog::SMSG, "Bucket %d hashed %u messages updated from %u to %u.\n", bucket_time, nActive, hash, hash_new);
+uint32_t SecMsgBucket::GetHash(int version) const
+{
+    if (version >= SMSG_VERSION_TOKEN_HASH) {
+        return hash;
+    }
+    if (!m_hash_ordered_valid) {
+        int64_t now = GetAdjustedTime();
+        XXH32_state_t *state = XXH32_createState();
+        XXH32_reset(state, 1);
+        for (const auto &token : setTokens) {
+            if (token.timestamp + token.ttl < now) {
+                continue;
+            }
+            XXH32_update(state, token.sample, 8);
+        }
+        m_hash_ordered = XXH32_digest(state);
+        XXH32_freeState(state);
+        m_hash_ordered_valid = true;
+    }
+    return m_hash_ordered;
+};
 
-        hash = hash_new;
-        timeChanged = GetTime();
+uint64_t SecMsgBucket::CountDeadBytes(int64_t now) const
+{
+    uint64_t nBytes = 0;
+    for (const auto &token : setTokens) {
+        // Purged tokens have ttl 0
+        if (token.timestamp + token.ttl < now && token.m_payload_size > 8) {
+            nBytes += token.m_payload_size - 8;
+        }
     }
-    return;
+    return nBytes;
 };
 
-size_t SecMsgBucket::CountActive() const
+uint32_t GetTokenShortId(int64_t bucket_time, const SecMsgToken &token)
 {
-    size_t nMessages = 0;
+    uint64_t h = CSipHasher(0x534d5347, bucket_time).Write(token.timestamp).Write(token.sample, 8).Finalize();
+    uint32_t short_id = h & 0xffffffff;
+    return short_id == 0 ? 1 : short_id; // 0 is not a valid sketch element
+};
 
-    int64_t now = GetAdjustedTime();
-    for (auto it = setTokens.begin(); it != setTokens.end(); ++it) {
-        if (it->timestamp + it->ttl < now) {
+Minisketch MakeTokenSketch(int64_t bucket_time, const SecMsgTokenSet &tokens, size_t capacity, int64_t now, uint32_t &n_tokens)
+{
+    // Portable implementation, the node minisketch wrapper isn't available to libparticl_smsg
+    Minisketch sketch(32, 0, capacity);
+    n_tokens = 0;
+    for (const auto &token : tokens) {
+        if (token.timestamp + token.ttl < now) {
             continue;
         }
-        nMessages++;
+        sketch.Add(GetTokenShortId(bucket_time, token));
+        n_tokens++;
     }
+    return sketch;
+};
 
-    return nMessages;
+static void RemoveBucketFiles(BucketFileWriters &writers, int64_t bucket_time)
+{
+    std::string fileName = ToString(bucket_time);
+
+    fs::path fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01.dat");
+    writers.Close(fullPath);
+    if (fs::exists(fullPath)) {
+        try { fs::remove(fullPath);
+        } catch (const fs::filesystem_error &ex) {
+            LogPrintf("Error removing bucket file %s.\n", ex.what());
+        }
+    } else {
+        LogPrintf("Path %s does not exist.\n", fs::PathToString(fullPath));
+    }
+
+    // Look for a wl file, it stores incoming messages when wallet is locked
+    fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01_wl.dat");
+    writers.Close(fullPath);
+    if (fs::exists(fullPath)) {
+        try { fs::remove(fullPath);
+        } catch (const fs::filesystem_error &ex) {
+            LogPrintf("Error removing wallet locked file %s.\n", ex.what());
+        }
+    }
 };
 
-/** Bucket management thread
-  */
-void ThreadSecureMsg(smsg::CSMSG *smsg_module)
+/** Ignore peers that locked a bucket and never sent the messages */
+static void IgnoreTimedOutPeers(smsg::CSMSG *smsg_module, const std::vector<std::pair<int64_t, NodeId> > &timed_out_locks)
 {
-    int64_t nLastPrunedFundingTxns = 0;
-    uint32_t nLoop = 0;
-    std::vector<std::pair<int64_t, NodeId> > vTimedOutLocks;
-    while (fSecMsgEnabled) {
-        nLoop++;
-        int64_t now = GetAdjustedTime();
+    for (const auto &lock : timed_out_locks) {
+        NodeId nPeerId = lock.second;
+        LogPrint(BCLog::SMSG, "Lock on bucket %d for peer %d timed out.\n", lock.first, nPeerId);
+
+        // Look through the nodes for the peer that locked this bucket
+        LOCK(smsg_module->m_node->connman->m_nodes_mutex);
+        for (auto *pnode : smsg_module->m_node->connman->m_nodes) {
+            if (pnode->GetId() != nPeerId) {
+                continue;
+            }
 
-        vTimedOutLocks.resize(0);
-        int64_t cutoffTime = now - SMSG_RETENTION;
-        {
-            LOCK(smsg_module->cs_smsg);
-            for (std::map<int64_t, SecMsgBucket>::iterator it(smsg_module->buckets.begin()); it != smsg_module->buckets.end(); ) {
-                bool fErase = it->first < cutoffTime;
+            LOCK(pnode->smsgData.cs_smsg_net);
+            int64_t ignoreUntil = GetTime() + SMSG_TIME_IGNORE;
+            pnode->smsgData.ignoreUntil = ignoreUntil;
 
-                if (!fErase
-                    && it->first + it->second.nLeastTTL < now) {
-                    it->second.hashBucket(it->first);
+            // Alert peer that they are being ignored
+            std::vector<uint8_t> vchData;
+            vchData.resize(8);
+            memput_int64_le(&vchData[0], ignoreUntil);
+            smsg_module->m_node->connman->PushMessage(pnode,
+                CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::IGNORING, vchData));
 
-                    // TODO: periodically prune files
-                    if (it->second.nActive < 1) {
-                        fErase = true;
-                    }
-                }
+            LogPrint(BCLog::SMSG, "This node will ignore peer %d until %d.\n", nPeerId, ignoreUntil);
+            break;
+        }
+    }
+};
 
-                if (fErase) {
-                    LogPrint(BCLog::SMSG, "Removing bucket %d.\n", it->first);
+void CSMSG::ScheduleBucketExpiry(int64_t bucket_time, SecMsgBucket &bucket, int64_t now)
+{
+    // Buckets without active tokens are removed once unlocked
+    int64_t due = bucket.nActive > 0 ? bucket.m_next_expiry + 1
+        : bucket.nLockCount > 0 ? bucket.m_lock_timeout : now;
+    due = std::min(due, bucket_time + (int64_t)SMSG_RETENTION + 1);
+    if (bucket.m_expiry_queued != 0 && bucket.m_expiry_queued <= due) {
+        return; // The earlier event queues the next
+    }
+    bucket.m_expiry_queued = due;
+    m_bucket_expiry_queue.emplace(due, bucket_time);
+    ScheduleHousekeeping(due, now);
+};
 
-                    std::string fileName = ToString(it->first);
+void CSMSG::LockBucket(int64_t bucket_time, SecMsgBucket &bucket, NodeId peer_id, int64_t now)
+{
+    bucket.nLockCount = 1;
+    bucket.nLockPeerId = peer_id;
+    bucket.m_lock_timeout = now + SMSG_BUCKET_LOCK_TIMEOUT;
+    m_bucket_lock_queue.emplace(bucket.m_lock_timeout, bucket_time);
+    ScheduleHousekeeping(bucket.m_lock_timeout, now);
+};
 
-                    fs::path fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01.dat");
-                    if (fs::exists(fullPath)) {
-                        try { fs::remove(fullPath);
-                        } catch (const fs::filesystem_error &ex) {
-                            LogPrintf("Error removing bucket file %s.\n", ex.what());
-                        }
-                    } else {
-                        LogPrintf("Path %s does not exist.\n", fs::PathToString(fullPath));
-                    }
+void CSMSG::ScheduleHousekeeping(int64_t wake_time, int64_t now)
+{
+    if (!m_housekeeping_scheduler) {
+        return;
+    }
+    // A wake time in the past was missed through a clock change, the tick catches up
+    if (m_housekeeping_wake > now && m_housekeeping_wake <= wake_time) {
+        return;
+    }
+    m_housekeeping_wake = wake_time;
+    uint64_t epoch = m_housekeeping_epoch;
+    m_housekeeping_scheduler->scheduleFromNow([this, epoch, wake_time] { RunBucketEvents(epoch, wake_time); },
+        std::chrono::seconds{std::max<int64_t>(0, wake_time - now)});
+};
 
-                    // Look for a wl file, it stores incoming messages when wallet is locked
-                    fullPath = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR) / fs::PathFromString(fileName + "_01_wl.dat");
-                    if (fs::exists(fullPath)) {
-                        try { fs::remove(fullPath);
-                        } catch (const fs::filesystem_error &ex) {
-                            LogPrintf("Error removing wallet locked file %s.\n", ex.what());
-                        }
-                    }
+void CSMSG::ProcessBucketEvents(int64_t now, std::vector<std::pair<int64_t, NodeId> > &timed_out_locks)
+{
+    while (!m_bucket_lock_queue.empty() && m_bucket_lock_queue.top().first <= now) {
+        const BucketEvent event = m_bucket_lock_queue.top();
+        m_bucket_lock_queue.pop();
+        auto it = buckets.find(event.second);
+        if (it == buckets.end()) {
+            continue;
+        }
+        SecMsgBucket &bucket = it->second;
+        if (bucket.nLockCount == 0 || bucket.m_lock_timeout != event.first) {
+            continue; // Released or locked again since
+        }
+        timed_out_locks.push_back(std::make_pair(it->first, bucket.nLockPeerId));
+        bucket.nLockCount = 0;
+        bucket.nLockPeerId = -1;
+        bucket.m_lock_timeout = 0;
+        ScheduleBucketExpiry(it->first, bucket, now);
+    }
 
-                    smsg_module->buckets.erase(it++);
-                } else {
-                    if (it->second.nLockCount > 0) { // Tick down nLockCount, to eventually expire if peer never sends data
-                        it->second.nLockCount--;
+    int64_t cutoffTime = now - SMSG_RETENTION;
+    while (!m_bucket_expiry_queue.empty() && m_bucket_expiry_queue.top().first <= now) {
+        const BucketEvent event = m_bucket_expiry_queue.top();
+        m_bucket_expiry_queue.pop();
+        auto it = buckets.find(event.second);
+        if (it == buckets.end() || it->second.m_expiry_queued != event.first) {
+            continue; // Superseded by an earlier event
+        }
+        SecMsgBucket &bucket = it->second;
+        bucket.m_expiry_queued = 0;
 
-                        if (it->second.nLockCount == 0) { // lock timed out
-                            vTimedOutLocks.push_back(std::make_pair(it->first, it->second.nLockPeerId)); // g_connman->m_nodes_mutex
-                            it->second.nLockPeerId = -1;
-                        }
-                    }
-                    ++it;
-                }
-            }
+        bool fErase = it->first < cutoffTime;
+        if (!fErase
+            && (bucket.nActive < 1 || bucket.m_next_expiry < now)) {
+            bucket.hashBucket(it->first);
 
-            if (smsg_module->nLastProcessedPurged + SMSG_SECONDS_IN_DAY < now) {
-                smsg_module->BuildPurgedSets();
+            // TODO: periodically prune files
+            if (bucket.nActive < 1 && bucket.nLockCount == 0) {
+                fErase = true;
             }
+        }
 
-            if (nLoop % 20 == 0) {
-                // Erase any unreceived show_requests
-                int64_t local_time = GetTime();
-                for (auto it = smsg_module->m_show_requests.begin(); it != smsg_module->m_show_requests.end(); ) {
-                    if (it->second < local_time) {
-                        it = smsg_module->m_show_requests.erase(it);
-                    } else {
-                        ++it;
-                    }
-                }
-            }
-        } // cs_smsg
+        if (fErase) {
+            LogPrint(BCLog::SMSG, "Removing bucket %d.\n", it->first);
+            RemoveBucketFiles(m_bucket_writers, it->first);
+            buckets.erase(it);
+            continue;
+        }
+        ScheduleBucketExpiry(it->first, bucket, now);
+    }
 
-        if (nLoop % 20 == 0) {
-            LOCK(smsg_module->m_node->connman->m_nodes_mutex);
-            for (auto *pnode : smsg_module->m_node->connman->m_nodes) {
-                LOCK(pnode->smsgData.cs_smsg_net);
-                int64_t cutoffTime = now - SMSG_SECONDS_IN_DAY;
-                for (auto it = pnode->smsgData.m_buckets_last_shown.begin(); it != pnode->smsgData.m_buckets_last_shown.end(); ) {
-                    if (it->first < cutoffTime) {
-                        it = pnode->smsgData.m_buckets_last_shown.erase(it);
-                    } else {
-                        ++it;
-                    }
-                }
-            }
+    int64_t next_wake = 0;
+    for (const auto *queue : {&m_bucket_lock_queue, &m_bucket_expiry_queue}) {
+        if (!queue->empty() && (next_wake == 0 || queue->top().first < next_wake)) {
+            next_wake = queue->top().first;
         }
+    }
+    if (next_wake != 0) {
+        ScheduleHousekeeping(next_wake, now);
+    }
+};
 
-        for (std::vector<std::pair<int64_t, NodeId> >::iterator it(vTimedOutLocks.begin()); it != vTimedOutLocks.end(); it++) {
-            NodeId nPeerId = it->second;
-            LogPrint(BCLog::SMSG, "Lock on bucket %d for peer %d timed out.\n", it->first, nPeerId);
+void CSMSG::RunBucketEvents(uint64_t epoch, int64_t wake_time)
+{
+    std::vector<std::pair<int64_t, NodeId> > timed_out_locks;
+    {
+        LOCK(cs_smsg);
+        if (!fSecMsgEnabled || epoch != m_housekeeping_epoch) {
+            return;
+        }
+        if (wake_time == m_housekeeping_wake) {
+            m_housekeeping_wake = 0;
+        }
+        ProcessBucketEvents(GetAdjustedTime(), timed_out_locks);
+    } // cs_smsg
 
-            // Look through the nodes for the peer that locked this bucket
+    IgnoreTimedOutPeers(this, timed_out_locks);
+};
 
-            {
-                LOCK(smsg_module->m_node->connman->m_nodes_mutex);
-                for (auto *pnode : smsg_module->m_node->connman->m_nodes) {
-                    if (pnode->GetId() != nPeerId) {
-                        continue;
-                    }
+/** Periodic tasks, buckets are only visited through the event queues */
+void CSMSG::HousekeepingTick(uint64_t epoch)
+{
+    int64_t now = GetAdjustedTime();
+    std::vector<std::pair<int64_t, NodeId> > timed_out_locks;
+    bool prune_peers = false, prune_funding_txns = false;
+    {
+        LOCK(cs_smsg);
+        if (!fSecMsgEnabled || epoch != m_housekeeping_epoch) {
+            return;
+        }
+        m_housekeeping_ticks++;
 
-                    LOCK(pnode->smsgData.cs_smsg_net);
-                    int64_t ignoreUntil = GetTime() + SMSG_TIME_IGNORE;
-                    pnode->smsgData.ignoreUntil = ignoreUntil;
+        // Catch up events delayed by a clock change
+        ProcessBucketEvents(now, timed_out_locks);
 
-                    // Alert peer that they are being ignored
-                    std::vector<uint8_t> vchData;
-                    vchData.resize(8);
-                    memput_int64_le(&vchData[0], ignoreUntil);
-                    smsg_module->m_node->connman->PushMessage(pnode,
-                        CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::IGNORING, vchData));
+        if (nLastProcessedPurged + SMSG_SECONDS_IN_DAY < now) {
+            BuildPurgedSets();
+        }
 
-                    LogPrint(BCLog::SMSG, "This node will ignore peer %d until %d.\n", nPeerId, ignoreUntil);
-                    break;
+        if (m_housekeeping_ticks % 20 == 0) {
+            // Erase any unreceived show_requests
+            int64_t local_time = GetTime();
+            for (auto it = m_show_requests.begin(); it != m_show_requests.end(); ) {
+                if (it->second < local_time) {
+                    it = m_show_requests.erase(it);
+                } else {
+                    ++it;
                 }
-            } // g_connman->m_nodes_mutex
+            }
+            prune_peers = true;
         }
 
-        if (now > nLastPrunedFundingTxns + PRUNE_FUNDING_TX_DATA) {
-            smsg_module->PruneFundingTxData();
-            nLastPrunedFundingTxns = now;
+        if (now > m_last_pruned_funding_txns + PRUNE_FUNDING_TX_DATA) {
+            m_last_pruned_funding_txns = now;
+            prune_funding_txns = true;
         }
 
-        // Check every SMSG_THREAD_DELAY seconds
-        smsg_module->m_thread_interrupt.sleep_for(std::chrono::milliseconds(SMSG_THREAD_DELAY * 1000));
+        if (m_compact_percent > 0 && now > m_last_compacted + SMSG_COMPACT_INTERVAL) {
+            m_last_compacted = now;
+            uint64_t reclaimed = 0;
+            CompactBuckets(m_compact_percent, reclaimed);
+        }
+
+        // Bulk bucket sync appends through the open handles, commit what arrived since the last tick
+        m_bucket_writers.FlushAll(true, true);
+
+        m_housekeeping_scheduler->scheduleFromNow([this, epoch] { HousekeepingTick(epoch); },
+            std::chrono::seconds{SMSG_THREAD_DELAY});
+    } // cs_smsg
+
+    if (prune_peers) {
+        LOCK(m_node->connman->m_nodes_mutex);
+        for (auto *pnode : m_node->connman->m_nodes) {
+            LOCK(pnode->smsgData.cs_smsg_net);
+            int64_t cutoffTime = now - SMSG_SECONDS_IN_DAY;
+            for (auto it = pnode->smsgData.m_buckets_last_shown.begin(); it != pnode->smsgData.m_buckets_last_shown.end(); ) {
+                if (it->first < cutoffTime) {
+                    it = pnode->smsgData.m_buckets_last_shown.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
     }
-    return;
+
+    IgnoreTimedOutPeers(this, timed_out_locks);
+
+    if (prune_funding_txns) {
+        PruneFundingTxData();
+    }
+};
+
+void CSMSG::StartHousekeeping()
+{
+    LOCK(cs_smsg);
+    m_housekeeping_epoch++;
+    m_housekeeping_scheduler = m_node && m_node->scheduler ? m_node->scheduler.get() : nullptr;
+    m_housekeeping_wake = 0;
+    m_housekeeping_ticks = 0;
+    m_last_pruned_funding_txns = 0;
+    m_last_compacted = GetAdjustedTime(); // First run after SMSG_COMPACT_INTERVAL
+    m_bucket_expiry_queue = BucketEventQueue();
+    m_bucket_lock_queue = BucketEventQueue();
+    if (!m_housekeeping_scheduler) {
+        LogPrintf("%s: No scheduler, buckets will not expire.\n", __func__);
+        return;
+    }
+
+    int64_t now = GetAdjustedTime();
+    for (auto &it : buckets) {
+        it.second.m_expiry_queued = 0;
+        ScheduleBucketExpiry(it.first, it.second, now);
+    }
+    uint64_t epoch = m_housekeeping_epoch;
+    m_housekeeping_scheduler->scheduleFromNow([this, epoch] { HousekeepingTick(epoch); }, std::chrono::seconds{0});
+};
+
+void CSMSG::StopHousekeeping()
+{
+    // Pending events see the changed epoch and return
+    LOCK(cs_smsg);
+    m_housekeeping_epoch++;
+    m_housekeeping_scheduler = nullptr;
+    m_housekeeping_wake = 0;
+    m_bucket_expiry_queue = BucketEventQueue();
+    m_bucket_lock_queue = BucketEventQueue();
+};
+
+void CSMSG::NotifyOutbox()
+{
+    LOCK(cs_outbox_wake);
+    m_outbox_wake = true;
+    m_outbox_cv.notify_all();
 };
 
 /** Proof of work thread
@@ -340,7 +645,8 @@ void ThreadSecureMsgPow(smsg::CSMSG *smsg_module)
 
     const Consensus::Params &consensus_params = Params().GetConsensus();
     while (fSecMsgEnabled) {
-        // Sleep at end, then fSecMsgEnabled is tested on wake
+        // Wait at end, then fSecMsgEnabled is tested on wake
+        size_t num_unfunded = 0;
 
         SecMsgDB dbOutbox;
         leveldb::Iterator *it;
@@ -381,12 +687,16 @@ void ThreadSecureMsgPow(smsg::CSMSG *smsg_module)
                         LogPrintf("%s: Funding txn timeout, dropping message %s\n", __func__, msgId.ToString());
                         LOCK(cs_smsgDB);
                         dbOutbox.EraseSmesg(chKey);
+                    } else {
+                        num_unfunded++;
                     }
                     continue;
                 }
             } else {
                 // Do proof of work
+                smsg_module->m_pow_current_start = GetTimeMicros();
                 rv = smsgModule.SetHash(&smsg, pPayload, smsg.nPayload);
+                smsg_module->m_pow_current_start = 0;
                 if (rv == SMSG_SHUTDOWN_DETECTED) {
                     break; // Leave message in db when terminated due to shutdown
                 }
@@ -424,19 +734,197 @@ void ThreadSecureMsgPow(smsg::CSMSG *smsg_module)
 
         delete it;
 
-        smsg_module->m_thread_interrupt.sleep_for(std::chrono::milliseconds(2000));
+        // Woken when a message is queued, or a block is connected while messages wait for their funding txn
+        smsg_module->m_outbox_unfunded = num_unfunded > 0;
+        WAIT_LOCK(smsg_module->cs_outbox_wake, lock);
+        while (!smsg_module->m_outbox_wake && fSecMsgEnabled) {
+            smsg_module->m_outbox_cv.wait(lock);
+        }
+        smsg_module->m_outbox_wake = false;
     }
     return;
 };
 
+void ThreadSecureMsgDB(smsg::CSMSG *smsg_module)
+{
+    // Group commit, sync writes left unsynced by GroupWriteOptions
+    while (fSecMsgEnabled) {
+        if (!smsg_module->m_thread_interrupt.sleep_for(std::chrono::seconds(SMSG_DB_SYNC_INTERVAL))) {
+            break;
+        }
+        FlushDB(false);
+    }
+};
+
+void ThreadSecureMsgReceive(smsg::CSMSG *smsg_module)
+{
+    // Validate and store bunches queued by the message handler thread
+    while (true) {
+        SecMsgReceiveItem item;
+        {
+            WAIT_LOCK(smsg_module->cs_receive, lock);
+            while (!smsg_module->m_receive_stop && smsg_module->m_receive_queue.empty()) {
+                smsg_module->m_receive_cv.wait(lock);
+            }
+            if (smsg_module->m_receive_stop) {
+                break;
+            }
+            item = std::move(smsg_module->m_receive_queue.front());
+            smsg_module->m_receive_queue.pop_front();
+        }
+
+        smsg_module->ProcessBunch(item.peer_logic, item.pfrom, item.bucket_time, item.num_messages, item.data);
+
+        WITH_LOCK(item.pfrom->smsgData.cs_smsg_net, item.pfrom->smsgData.m_receive_queued--);
+        item.pfrom->Release();
+        {
+            LOCK(smsg_module->cs_receive);
+            smsg_module->m_receive_queue_bytes -= item.data.size();
+            smsg_module->m_receive_processed++;
+        }
+    }
+};
+
+void CSMSG::StartReceiveThreads()
+{
+    WITH_LOCK(cs_receive, m_receive_stop = false);
+    for (int i = 0; i < m_receive_threads; ++i) {
+        threads_smsg_receive.emplace_back([this, name = strprintf("smsg-rcv.%i", i)]() {
+            util::TraceThread(name.c_str(), [this]() { ThreadSecureMsgReceive(this); });
+        });
+    }
+};
+
+void CSMSG::StopReceiveThreads()
+{
+    WITH_LOCK(cs_receive, m_receive_stop = true; m_receive_cv.notify_all());
+    for (auto &t : threads_smsg_receive) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads_smsg_receive.clear();
+
+    // Bucket locks held for the dropped bunches time out
+    LOCK(cs_receive);
+    for (auto &item : m_receive_queue) {
+        WITH_LOCK(item.pfrom->smsgData.cs_smsg_net, item.pfrom->smsgData.m_receive_queued--);
+        item.pfrom->Release();
+        m_receive_queue_bytes -= item.data.size();
+    }
+    m_receive_queue.clear();
+};
+
+void ThreadSecureMsgFund(smsg::CSMSG *smsg_module)
+{
+    // Fund queued paid messages when their batch fills or the oldest has waited the batch window
+    while (true) {
+        std::vector<std::pair<SecMsgFundKey, std::vector<SecMsgFundItem> > > batches;
+        {
+            WAIT_LOCK(smsg_module->cs_fund_queue, lock);
+            if (smsg_module->m_fund_stop) {
+                break;
+            }
+            int64_t now = GetTime();
+            int64_t next_due = smsg_module->TakeFundBatches(now, batches);
+            if (batches.empty()) {
+                int64_t wait = next_due > 0 ? next_due - now : SMSG_THREAD_DELAY;
+                smsg_module->m_fund_cv.wait_for(lock, std::chrono::seconds(std::max<int64_t>(1, wait)));
+                continue;
+            }
+        }
+        for (const auto &batch : batches) {
+            smsg_module->FundBatch(batch.first, batch.second);
+        }
+    }
+};
+
+void CSMSG::StopFundThread()
+{
+    WITH_LOCK(cs_fund_queue, m_fund_stop = true; m_fund_cv.notify_all());
+    if (thread_smsg_fund.joinable()) {
+        thread_smsg_fund.join();
+    }
+    // Messages left in the queue stay stashed, they can be funded with smsgfund
+    LOCK(cs_fund_queue);
+    size_t num_left = 0;
+    for (const auto &group : m_fund_queue) {
+        num_left += group.second.size();
+    }
+    if (num_left > 0) {
+        LogPrintf("%s: %d queued paid messages left unfunded in the stash.\n", __func__, num_left);
+    }
+    m_fund_queue.clear();
+};
+
+void ThreadSecureMsgNotify(smsg::CSMSG *smsg_module)
+{
+    // Publish new messages first, replays when idle
+    while (fSecMsgEnabled) {
+        std::vector<SecMsgNotification> batch;
+        {
+            WAIT_LOCK(smsg_module->cs_notify, lock);
+            if (smsg_module->m_notify_queue.empty() && smsg_module->m_notify_replay.empty()) {
+                smsg_module->m_notify_cv.wait_for(lock, std::chrono::seconds(1));
+                continue;
+            }
+            for (auto *queue : {&smsg_module->m_notify_queue, &smsg_module->m_notify_replay}) {
+                while (!queue->empty() && batch.size() < SMSG_NOTIFY_BATCH_SIZE) {
+                    batch.push_back(std::move(queue->front()));
+                    queue->pop_front();
+                }
+            }
+        }
+
+        int64_t cursor_time = 0;
+        uint160 cursor_hash;
+        for (const auto &item : batch) {
+            SecureMessage smsg(item.vchHeader.data());
+            GetMainSignals().NewSecureMessage(&smsg, item.hash);
+            if (item.timeReceived > cursor_time ||
+                (item.timeReceived == cursor_time && cursor_hash < item.hash)) {
+                cursor_time = item.timeReceived;
+                cursor_hash = item.hash;
+            }
+        }
+
+        bool cursor_moved = false;
+        {
+            LOCK(smsg_module->cs_notify);
+            smsg_module->m_notify_sent += batch.size();
+            if (cursor_time > smsg_module->m_notify_cursor_time ||
+                (cursor_time == smsg_module->m_notify_cursor_time && smsg_module->m_notify_cursor_hash < cursor_hash)) {
+                smsg_module->m_notify_cursor_time = cursor_time;
+                smsg_module->m_notify_cursor_hash = cursor_hash;
+                cursor_moved = true;
+            }
+        }
+        if (cursor_moved) {
+            LOCK(cs_smsgDB);
+            SecMsgDB db;
+            if (db.Open("cw")) {
+                db.WriteNotifyCursor(cursor_time, cursor_hash);
+            }
+        }
+    }
+};
+
 void AddOptions(ArgsManager& argsman)
 {
     argsman.AddArg("-smsg", "Enable secure messaging. (default: true)", ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     argsman.AddArg("-smsgscanchain", "Scan the block chain for public key addresses on startup. (default: false)", ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     argsman.AddArg("-smsgscanincoming", "Scan incoming blocks for public key addresses. (default: false)", ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgpubkeyindex", strprintf("Maintain an index of the public keys in the block chain in the background, replaces -smsgscanchain and -smsgscanincoming (default: %u)", DEFAULT_PUBKEYINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     argsman.AddArg("-smsgnotify=<cmd>", "Execute command when a message is received. (%s in cmd is replaced by receiving address)", ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     argsman.AddArg("-smsgsaddnewkeys", "Scan for incoming messages on new wallet keys. (default: false)", ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     argsman.AddArg("-smsgbantime=<n>", strprintf("Number of seconds to ignore misbehaving peers for (default: %u)", SMSG_DEFAULT_BANTIME), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgpowthreads=<n>", strprintf("Number of threads to compute the proof of work of outgoing free messages, 0 = all cores, max %d (default: %d)", SMSG_MAX_POW_THREADS, SMSG_DEFAULT_POW_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgreceivethreads=<n>", strprintf("Number of threads to validate and store messages received from peers, 0 = all cores, max %d (default: %d)", SMSG_MAX_RECEIVE_THREADS, SMSG_DEFAULT_RECEIVE_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgfundbatchsize=<n>", strprintf("Number of paid messages sent with batchfund to fund in one transaction, max %d (default: %u)", SMSG_MAX_FUND_BATCH, SMSG_DEFAULT_FUND_BATCH_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgfundbatchwindow=<n>", strprintf("Max number of seconds a paid message sent with batchfund waits for its batch to fill (default: %u)", SMSG_DEFAULT_FUND_BATCH_WINDOW), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgcompact=<n>", strprintf("Rewrite message bucket files when at least <n> percent of the file is expired or purged message payloads, 0 to disable (default: %u)", SMSG_DEFAULT_COMPACT_PERCENT), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgpeerbytesrate=<n>", strprintf("Max bytes per second to accept from each peer, traffic over the limit is dropped before validation, 0 for no limit (default: %u)", SMSG_DEFAULT_PEER_BYTES_RATE), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    argsman.AddArg("-smsgpeermsgrate=<n>", strprintf("Max received messages per second to validate from each peer, bunches over the limit are dropped, 0 for no limit (default: %u)", SMSG_DEFAULT_PEER_MSGS_RATE), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     argsman.AddArg("-smsgmaxreceive=<n>", strprintf("Max number of data messages to tolerate from peers, counter decreases over time (default: %u)", SMSG_DEFAULT_MAXRCV), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     argsman.AddArg("-smsgsregtestadjust", "Adjust durations in regtest (default: true)", ArgsManager::ALLOW_ANY, OptionsCategory::HIDDEN);
     return;
@@ -513,7 +1001,6 @@ int CSMSG::BuildBucketSet()
     int64_t  now            = GetAdjustedTime();
     uint32_t nFiles         = 0;
     uint32_t nMessages      = 0;
-    unsigned char header_buffer[SMSG_HDR_LEN];
 
     fs::path pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
     fs::directory_iterator itend;
@@ -531,6 +1018,14 @@ int CSMSG::BuildBucketSet()
 
         std::string fileType = itd->path().extension().string();
 
+        if (fileType.compare(".tmp") == 0) {
+            // Left by an interrupted compaction, the original file is intact
+            try { fs::remove(itd->path());
+            } catch (const fs::filesystem_error &ex) {
+                LogPrintf("Error removing temporary file %s.\n", ex.what());
+            }
+            continue;
+        }
         if (fileType.compare(".dat") != 0) {
             continue;
         }
@@ -575,50 +1070,31 @@ int CSMSG::BuildBucketSet()
             LOCK(cs_smsg);
 
             SecMsgBucket &bucket = buckets[fileTime];
-            std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+            SecMsgTokenSet &tokenSet = bucket.setTokens;
 
-            FILE *fp;
-            if (!(fp = fopen(itd->path().string().c_str(), "rb"))) {
-                LogPrintf("Error opening file: %s\n", SysErrorString(errno));
+            BucketFileReader file(itd->path());
+            if (!file.IsOpen()) {
                 continue;
             }
 
-            for (;;) {
-                long int ofs = ftell(fp);
+            const uint8_t *pHeader, *pPayload;
+            size_t ofs;
+            while (file.Next(smsg, pHeader, pPayload, ofs)) {
                 SecMsgToken token;
                 token.offset = ofs;
-                errno = 0;
-                if (fread(header_buffer, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN) {
-                    if (errno != 0) {
-                        LogPrintf("fread header failed: %s\n", SysErrorString(errno));
-                    } else {
-                        //LogPrintf("End of file.\n");
-                    }
-                    break;
-                }
-                smsg.set(header_buffer);
                 token.timestamp = smsg.timestamp;
                 token.ttl = smsg.version[0] == 0 && smsg.version[1] == 0 ? 0  // Purged message header
                     : smsg.m_ttl;
                 token.m_changed = now - fileTime;
-                if (smsg.m_ttl > 0 && (bucket.nLeastTTL == 0 || smsg.m_ttl < bucket.nLeastTTL)) {
-                    bucket.nLeastTTL = smsg.m_ttl;
-                }
                 if (smsg.nPayload < 8) {
                     continue;
                 }
-                if (fread(token.sample, sizeof(uint8_t), 8, fp) != 8) {
-                    LogPrintf("fread failed: %s\n", SysErrorString(errno));
-                    break;
-                }
-                if (fseek(fp, smsg.nPayload-8, SEEK_CUR) != 0) {
-                    LogPrintf("fseek failed: %s.\n", SysErrorString(errno));
-                    break;
-                }
-                tokenSet.insert(token);
+                token.m_payload_size = smsg.nPayload;
+                token.m_paid = smsg.IsPaidVersion();
+                memcpy(token.sample, pPayload, 8);
+                tokenSet.append(token);
             }
-
-            fclose(fp);
+            tokenSet.merge();
             bucket.hashBucket(fileTime);
             nTokenSetSize = tokenSet.size();
         } // cs_smsg
@@ -898,6 +1374,21 @@ bool CSMSG::Start(std::shared_ptr<wallet::CWallet> pwalletIn, std::vector<std::s
     }
 
     m_smsg_max_receive_count = gArgs.GetIntArg("-smsgmaxreceive", SMSG_DEFAULT_MAXRCV);
+    m_peer_bytes_rate = std::max<int64_t>(0, gArgs.GetIntArg("-smsgpeerbytesrate", SMSG_DEFAULT_PEER_BYTES_RATE));
+    m_peer_msgs_rate = std::max<int64_t>(0, gArgs.GetIntArg("-smsgpeermsgrate", SMSG_DEFAULT_PEER_MSGS_RATE));
+    m_pow_threads = gArgs.GetIntArg("-smsgpowthreads", SMSG_DEFAULT_POW_THREADS);
+    if (m_pow_threads <= 0) {
+        m_pow_threads = GetNumCores();
+    }
+    m_pow_threads = std::max(1, std::min(m_pow_threads, SMSG_MAX_POW_THREADS));
+    m_receive_threads = gArgs.GetIntArg("-smsgreceivethreads", SMSG_DEFAULT_RECEIVE_THREADS);
+    if (m_receive_threads <= 0) {
+        m_receive_threads = GetNumCores();
+    }
+    m_receive_threads = std::max(1, std::min(m_receive_threads, SMSG_MAX_RECEIVE_THREADS));
+    m_compact_percent = std::min<int64_t>(100, std::max<int64_t>(0, gArgs.GetIntArg("-smsgcompact", SMSG_DEFAULT_COMPACT_PERCENT)));
+    m_fund_batch_size = std::min<int64_t>(SMSG_MAX_FUND_BATCH, std::max<int64_t>(1, gArgs.GetIntArg("-smsgfundbatchsize", SMSG_DEFAULT_FUND_BATCH_SIZE)));
+    m_fund_batch_window = std::max<int64_t>(0, gArgs.GetIntArg("-smsgfundbatchwindow", SMSG_DEFAULT_FUND_BATCH_WINDOW));
 
 #ifdef ENABLE_WALLET
     UnloadAllWallets();
@@ -950,10 +1441,27 @@ bool CSMSG::Start(std::shared_ptr<wallet::CWallet> pwalletIn, std::vector<std::s
         assert(ret);
     }
 
+    if (gArgs.GetBoolArg("-smsgpubkeyindex", DEFAULT_PUBKEYINDEX)) {
+        g_pubkey_index = std::make_unique<PubKeyIndex>(/* cache size */ 0, false, node::fReindex);
+        if (!g_pubkey_index->Start(m_node->chainman->ActiveChainstate())) {
+            g_pubkey_index.reset();
+            LogPrintf("%s: Failed to start the public key index.\n", __func__);
+        }
+    }
+
     if (fScanChain) {
         ScanBlockChain();
     }
 
+    {
+        LOCK(cs_smsgDB);
+        SecMsgDB db;
+        if (!db.Open("cw") || !db.BuildIndexes()) {
+            Disable();
+            return error("%s: Could not index message db, secure messaging disabled.", __func__);
+        }
+    }
+
     if (BuildBucketSet() != 0) {
         Disable();
         return error("%s: Could not load bucket sets, secure messaging disabled.", __func__);
@@ -964,11 +1472,28 @@ bool CSMSG::Start(std::shared_ptr<wallet::CWallet> pwalletIn, std::vector<std::s
         return error("%s: Could not load purged sets, secure messaging disabled.", __func__);
     }
 
+    {
+        LOCK(cs_smsgDB);
+        SecMsgDB db;
+        int64_t cursor_time;
+        uint160 cursor_hash;
+        if (db.Open("cw") && db.ReadNotifyCursor(cursor_time, cursor_hash)) {
+            LOCK(cs_notify);
+            m_notify_cursor_time = cursor_time;
+            m_notify_cursor_hash = cursor_hash;
+        }
+    }
+
     start_time = GetAdjustedTime();
 
     m_thread_interrupt.reset();
-    thread_smsg = std::thread(&util::TraceThread, "smsg", std::function<void()>(std::bind(&ThreadSecureMsg, this)));
+    StartHousekeeping();
     thread_smsg_pow = std::thread(&util::TraceThread, "smsg-pow", std::function<void()>(std::bind(&ThreadSecureMsgPow, this)));
+    thread_smsg_db = std::thread(&util::TraceThread, "smsg-db", std::function<void()>(std::bind(&ThreadSecureMsgDB, this)));
+    thread_smsg_notify = std::thread(&util::TraceThread, "smsg-notify", std::function<void()>(std::bind(&ThreadSecureMsgNotify, this)));
+    WITH_LOCK(cs_fund_queue, m_fund_stop = false);
+    thread_smsg_fund = std::thread(&util::TraceThread, "smsg-fund", std::function<void()>(std::bind(&ThreadSecureMsgFund, this)));
+    StartReceiveThreads();
 
 #ifdef ENABLE_WALLET
     m_wallet_load_handler = interfaces::MakeHandler(wallet::NotifyWalletAdded.connect(std::bind(&ListenWalletAdded, this, std::placeholders::_1)));
@@ -981,6 +1506,7 @@ void CSMSG::Finalise()
 {
     if (smsgDB) {
         LOCK(cs_smsgDB);
+        FlushDB(true);
         delete smsgDB;
         smsgDB = nullptr;
     }
@@ -999,13 +1525,32 @@ bool CSMSG::Shutdown()
     fSecMsgEnabled = false;
 
     m_thread_interrupt();
-    if (thread_smsg.joinable()) {
-        thread_smsg.join();
-    }
+    StopReceiveThreads();
+    StopFundThread();
+    StopHousekeeping();
+    if (g_pubkey_index) {
+        g_pubkey_index->Interrupt();
+        g_pubkey_index->Stop();
+        g_pubkey_index.reset();
+    }
+    WITH_LOCK(cs_outbox_wake, m_outbox_cv.notify_all());
     if (thread_smsg_pow.joinable()) {
         thread_smsg_pow.join();
     }
+    if (thread_smsg_db.joinable()) {
+        thread_smsg_db.join();
+    }
+    WITH_LOCK(cs_notify, m_notify_cv.notify_all());
+    if (thread_smsg_notify.joinable()) {
+        thread_smsg_notify.join();
+    }
+    {
+        LOCK(cs_notify);
+        m_notify_queue.clear();
+        m_notify_replay.clear();
+    }
 
+    m_bucket_writers.CloseAll(true);
     Finalise();
     keyStore.Clear();
 
@@ -1072,6 +1617,10 @@ bool CSMSG::Disable()
         return error("%s: Secure messaging is already disabled.", __func__);
     }
 
+    // The receive and funding threads take cs_smsg, stop them before Shutdown is called under the lock
+    StopReceiveThreads();
+    StopFundThread();
+
     {
         LOCK(cs_smsg);
 
@@ -1217,6 +1766,12 @@ void CSMSG::GetNodesStats(int node_id, UniValue &result)
         obj.pushKV("ignoredcounter", (int) pnode->smsgData.m_ignored_counter);
         obj.pushKV("num_pending_inv", (int) pnode->smsgData.m_buckets.size());
         obj.pushKV("num_shown_buckets", (int) pnode->smsgData.m_buckets_last_shown.size());
+        obj.pushKV("bytes_received", pnode->smsgData.m_bytes_received);
+        obj.pushKV("msgs_received", pnode->smsgData.m_msgs_received);
+        obj.pushKV("smsgs_received", pnode->smsgData.m_smsgs_received);
+        obj.pushKV("receive_time_us", pnode->smsgData.m_receive_us);
+        obj.pushKV("dropped_over_quota", pnode->smsgData.m_dropped_over_quota);
+        obj.pushKV("receive_queued", (int) pnode->smsgData.m_receive_queued);
         if (node_id > -1) {
             UniValue pending_inv_buckets(UniValue::VARR);
             for (auto it = pnode->smsgData.m_buckets.begin(); it != pnode->smsgData.m_buckets.end(); ++it) {
@@ -1302,6 +1857,9 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
         + smsgShow =
             (1) received a list of requested bucket hashes which the other party does not have.
             (2) respond with smsgHave - contains all the message hashes within the requested buckets.
+        + smsgSketch =
+            (1) received a minisketch of the tokens in one of our buckets, from peers running SMSG_VERSION_SKETCH or later.
+            (2) respond with smsgHave - contains only the message hashes missing from the sketch, or all of them if the sketch can't be decoded.
         + smsgHave =
             (1) A list of all the message hashes which a node has in response to smsgShow.
         + smsgWant =
@@ -1348,6 +1906,18 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
             return SMSG_GENERAL_ERROR;
         }
 
+        pfrom->smsgData.m_msgs_received++;
+        pfrom->smsgData.m_bytes_received += vRecv.size();
+        // Bunches are limited in Receive, which can release the bucket lock
+        if (strCommand != SMSGMsgType::MSG) {
+            if (!pfrom->smsgData.m_bytes_limit.Available(vRecv.size(), m_peer_bytes_rate, PEER_BYTES_BURST, GetTimeMicros())) {
+                LogPrint(BCLog::SMSG, "Peer %d over byte quota, dropping %s.\n", pfrom->GetId(), strCommand);
+                pfrom->smsgData.m_dropped_over_quota++;
+                return SMSG_GENERAL_ERROR;
+            }
+            pfrom->smsgData.m_bytes_limit.Spend(vRecv.size());
+        }
+
         if (pfrom->smsgData.m_receive_counter >= m_smsg_max_receive_count) {
             LogPrintf("Peer %d exceeded rate limit.\n", pfrom->GetId());
             pfrom->smsgData.m_ignored_counter += 1;
@@ -1391,6 +1961,7 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
             return SMSG_GENERAL_ERROR;
         }
 
+        int peer_version = WITH_LOCK(pfrom->smsgData.cs_smsg_net, return pfrom->smsgData.m_version);
         uint8_t *p = &vchData[4];
         for (uint32_t i = 0; i < nInvBuckets; ++i) {
             int64_t time = memget_int64_le(p);
@@ -1430,7 +2001,7 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
                     LogPrintf("Peer bucket %d %u %u.\n", time, ncontent, hash);
                     if (it_lb != buckets.end()) {
-                        LogPrintf("This bucket %d %u %u.\n", time, it_lb->second.setTokens.size(), it_lb->second.hash);
+                        LogPrintf("This bucket %d %u %u.\n", time, it_lb->second.setTokens.size(), it_lb->second.GetHash(peer_version));
                     }
                 }
 
@@ -1446,7 +2017,7 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 if (it_lb == buckets.end()
                     || it_lb->second.nActive < ncontent
                     || (it_lb->second.nActive == ncontent
-                        && it_lb->second.hash != hash)) { // if same amount in buckets check hash
+                        && it_lb->second.GetHash(peer_version) != hash)) { // if same amount in buckets check hash
                         LOCK(pfrom->smsgData.cs_smsg_net);
                         auto nv = PeerBucket(ncontent, hash);
                         auto ret = pfrom->smsgData.m_buckets.insert(std::pair<int64_t, PeerBucket>(time, nv));
@@ -1474,7 +2045,7 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
         LogPrint(BCLog::SMSG, "Peer %d requests contents of %u buckets.\n", pfrom->GetId(), nBuckets);
 
         std::map<int64_t, SecMsgBucket>::iterator itb;
-        std::set<SecMsgToken>::iterator it;
+        SecMsgTokenSet::const_iterator it;
 
         std::vector<uint8_t> vchDataOut;
         int64_t time;
@@ -1499,7 +2070,7 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                     continue;
                 }
 
-                std::set<SecMsgToken> &tokenSet = itb->second.setTokens;
+                const SecMsgTokenSet &tokenSet = itb->second.setTokens;
 
                 try { vchDataOut.resize(8 + 16 * tokenSet.size());
                 } catch (std::exception &e) {
@@ -1541,6 +2112,80 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::HAVE, vchDataOut));
         }
     } else
+    if (strCommand == SMSGMsgType::SKETCH) {
+        // Peer sent a sketch of a bucket, reply with the tokens it's missing
+        std::vector<uint8_t> vchData;
+        vRecv >> vchData;
+
+        if (vchData.size() < 16) {
+            return SMSG_GENERAL_ERROR;
+        }
+
+        int64_t time = memget_int64_le(&vchData[0]);
+        uint32_t peer_tokens = memget_uint32_le(&vchData[8]);
+        uint32_t capacity = memget_uint32_le(&vchData[12]);
+
+        if (capacity < 1 || capacity > SMSG_MAX_SKETCH_CAPACITY
+            || vchData.size() != 16 + capacity * 4) {
+            LogPrint(BCLog::SMSG, "Peer %d sent malformed sketch.\n", pfrom->GetId());
+            peerLogic->Misbehaving(pfrom->GetId(), 1, "smsg-sketch");
+            return SMSG_GENERAL_ERROR;
+        }
+        if (time < now - SMSG_RETENTION) {
+            LogPrint(BCLog::SMSG, "Not interested in peer %d bucket %d, has expired.\n", pfrom->GetId(), time);
+            return SMSG_GENERAL_ERROR;
+        }
+        if (time > now + SMSG_TIME_LEEWAY) {
+            LogPrint(BCLog::SMSG, "Not interested in peer %d bucket %d, in the future.\n", pfrom->GetId(), time);
+            peerLogic->Misbehaving(pfrom->GetId(), 1, "smsg-time");
+            return SMSG_GENERAL_ERROR;
+        }
+
+        std::vector<uint8_t> vchDataOut;
+        {
+            LOCK(cs_smsg);
+            auto itb = buckets.find(time);
+            if (itb == buckets.end()) {
+                LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", time);
+                return SMSG_NO_ERROR;
+            }
+            const SecMsgTokenSet &tokenSet = itb->second.setTokens;
+
+            uint32_t n_tokens;
+            Minisketch sketch = MakeTokenSketch(time, tokenSet, capacity, now, n_tokens);
+            Minisketch peer_sketch(32, 0, capacity);
+            peer_sketch.Deserialize(std::vector<uint8_t>(vchData.begin() + 16, vchData.end()));
+            sketch.Merge(peer_sketch);
+
+            std::optional<std::vector<uint64_t> > differences = sketch.Decode(capacity);
+            bool decoded = differences.has_value();
+            std::set<uint32_t> setDifferences;
+            if (!decoded) {
+                LogPrint(BCLog::SMSG, "Sketch of bucket %d from peer %d failed to decode, sending full list.\n", time, pfrom->GetId());
+            } else {
+                setDifferences.insert(differences->begin(), differences->end());
+                LogPrint(BCLog::SMSG, "Sketch of bucket %d from peer %d (%u tokens) differs by %u.\n", time, pfrom->GetId(), peer_tokens, differences->size());
+            }
+
+            vchDataOut.resize(8);
+            memput_int64_le(&vchDataOut[0], time);
+            for (const auto &token : tokenSet) {
+                if (token.timestamp + token.ttl < now) {
+                    continue;
+                }
+                if (decoded && setDifferences.count(GetTokenShortId(time, token)) == 0) {
+                    continue;
+                }
+                size_t nd = vchDataOut.size();
+                vchDataOut.resize(nd + 16);
+                memput_int64_le(&vchDataOut[nd], token.timestamp);
+                memcpy(&vchDataOut[nd + 8], token.sample, 8);
+            }
+        }
+
+        m_node->connman->PushMessage(pfrom,
+            CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::HAVE, vchDataOut));
+    } else
     if (strCommand == SMSGMsgType::HAVE) {
         // Peer has these messages in bucket
         std::vector<uint8_t> vchData;
@@ -1588,7 +2233,7 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
             vchDataOut.resize(8);
             memcpy(&vchDataOut[0], &vchData[0], 8);
 
-            std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+            const SecMsgTokenSet &tokenSet = bucket.setTokens;
             SecMsgToken token;
             SecMsgPurged purgedToken;
             uint8_t *p = &vchData[8];
@@ -1605,7 +2250,7 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                     }
                 }
 
-                std::set<SecMsgToken>::const_iterator it = tokenSet.find(token);
+                auto it = tokenSet.find(token);
                 if (it == tokenSet.end()) {
                     int nd = vchDataOut.size();
                     try {
@@ -1626,11 +2271,11 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                     LogPrintf("Asking peer for %u messages.\n", n_messages);
                     LogPrintf("Locking bucket %u for peer %d.\n", time, pfrom->GetId());
                 }
-                bucket.nLockCount   = 3; // lock this bucket for at most 3 * SMSG_THREAD_DELAY seconds, unset when peer sends smsgMsg
-                bucket.nLockPeerId  = pfrom->GetId();
+                LockBucket(time, bucket, pfrom->GetId(), GetAdjustedTime()); // Unset when peer sends smsgMsg
                 m_node->connman->PushMessage(pfrom,
                     CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::WANT, vchDataOut));
             }
+            ScheduleBucketExpiry(time, bucket, GetAdjustedTime());
         } // cs_smsg
     } else
     if (strCommand == SMSGMsgType::WANT) {
@@ -1658,8 +2303,8 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
                 return SMSG_GENERAL_ERROR;
             }
 
-            std::set<SecMsgToken> &tokenSet = itb->second.setTokens;
-            std::set<SecMsgToken>::iterator it;
+            const SecMsgTokenSet &tokenSet = itb->second.setTokens;
+            SecMsgTokenSet::const_iterator it;
             SecMsgToken token;
             uint8_t *p = &vchData[8];
             for (int i = 0; i < n; ++i) {
@@ -1700,12 +2345,17 @@ int CSMSG::ReceiveData(PeerManager *peerLogic, CNode *pfrom, const std::string &
         }
     } else
     if (strCommand == SMSGMsgType::MSG) {
-        std::vector<uint8_t> vchData;
-        vRecv >> vchData;
+        // Receive checks the envelope in place in the received message buffer and queues a copy
+        uint64_t nData = ReadCompactSize(vRecv);
+        if (nData > vRecv.size()) {
+            throw std::ios_base::failure("smsgMsg size exceeds message");
+        }
+        Span<const uint8_t> vchData{UCharCast(vRecv.data()), (size_t)nData};
 
         LogPrint(BCLog::SMSG, "smsgMsg vchData.size() %u.\n", vchData.size());
 
         Receive(peerLogic, pfrom, vchData);
+        vRecv.ignore(nData);
     } else
     if (strCommand == SMSGMsgType::PING) {
         // smsgPing is the initial message, send reply
@@ -1846,7 +2496,7 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
                     continue;
                 }
 
-                uint32_t hash = bkt.hash;
+                uint32_t hash = bkt.GetHash(pto->smsgData.m_version);
 
                 if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
                     LogPrintf("Preparing bucket with hash %d for transfer to node %d. timeChanged=%d > lastMatched=%d\n", hash, pto->GetId(), bkt.timeChanged, pto->smsgData.lastMatched);
@@ -1885,10 +2535,11 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
     }
 
     size_t nBucketsContestReq = 0;
+    std::vector<std::vector<uint8_t> > vSketches;
     if (buckets_to_process > 0) {
         LOCK2(cs_smsg, pto->smsgData.cs_smsg_net);
         for (auto it = pto->smsgData.m_buckets.begin(); it != pto->smsgData.m_buckets.end();) {
-            if (nBucketsContestReq >= SMSG_MAX_SHOW) {
+            if (nBucketsContestReq + vSketches.size() >= SMSG_MAX_SHOW) {
                  break;
             }
 
@@ -1903,9 +2554,28 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
 
             if (it_lb == buckets.end()
                 || (it_lb->second.nLockPeerId < 0 || it_lb->second.nLockPeerId == pto->GetId())) {
+                // The difference in active counts is a lower bound on the size of the set difference
+                size_t sketch_capacity = it_lb == buckets.end() ? 0 :
+                    2 * (size_t)std::abs((int64_t)it_lb->second.nActive - (int64_t)bkt.m_active) + SMSG_SKETCH_MARGIN;
                 if (it_lb != buckets.end() &&
-                    (it_lb->second.nActive > bkt.m_active || (it_lb->second.nActive == bkt.m_active && it_lb->second.hash == bkt.m_hash))) {
+                    (it_lb->second.nActive > bkt.m_active || (it_lb->second.nActive == bkt.m_active && it_lb->second.GetHash(pto->smsgData.m_version) == bkt.m_hash))) {
                     LogPrint(BCLog::SMSG, "Not requesting list of bucket %d.\n", it->first);
+                } else
+                if (it_lb != buckets.end() && pto->smsgData.m_version >= SMSG_VERSION_SKETCH &&
+                    sketch_capacity <= SMSG_MAX_SKETCH_CAPACITY) {
+                    // Peer replies with only the tokens missing from our sketch, falls back to the full list if it can't be decoded
+                    uint32_t n_tokens;
+                    Minisketch sketch = MakeTokenSketch(it->first, it_lb->second.setTokens, sketch_capacity, GetAdjustedTime(), n_tokens);
+                    std::vector<uint8_t> vchSketch(16);
+                    memput_int64_le(&vchSketch[0], it->first);
+                    memput_uint32_le(&vchSketch[8], n_tokens);
+                    memput_uint32_le(&vchSketch[12], sketch_capacity);
+                    std::vector<uint8_t> vchSerialised = sketch.Serialize();
+                    vchSketch.insert(vchSketch.end(), vchSerialised.begin(), vchSerialised.end());
+                    vSketches.push_back(std::move(vchSketch));
+
+                    LogPrint(BCLog::SMSG, "Sending sketch of bucket %d, capacity %u to peer %d.\n", it->first, sketch_capacity, pto->GetId());
+                    m_show_requests[it->first] = now + 10;
                 } else {
                     LogPrint(BCLog::SMSG, "Requesting list of bucket %d from peer %d.\n", it->first, pto->GetId());
                     size_t sz = vchData.size();
@@ -1931,6 +2601,10 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
         m_node->connman->PushMessage(pto,
             CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::SHOW, vchData));
     }
+    for (const auto &vchSketch : vSketches) {
+        m_node->connman->PushMessage(pto,
+            CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::SKETCH, vchSketch));
+    }
 
     {
         LOCK(pto->smsgData.cs_smsg_net);
@@ -1982,51 +2656,22 @@ static bool ScanBlock(CSMSG &smsg, const CBlock &block, SecMsgDB &addrpkdb,
 {
     AssertLockHeld(cs_smsgDB);
 
-    std::string reason;
-
     // Only scan inputs of standard txns and coinstakes
-    for (const auto &tx : block.vtx) {
-        // Harvest public keys from coinstake txns
+    std::vector<CPubKey> pubkeys;
+    uint32_t nTransactionsBefore = nTransactions;
+    nTransactions += GetBlockPubKeys(block, pubkeys);
+    nElements += pubkeys.size();
 
-        if (!tx->IsParticlVersion()) {
-            continue;
+    for (auto &pubKey : pubkeys) {
+        CKeyID addrKey = pubKey.GetID();
+        switch (InsertAddress(addrKey, pubKey, addrpkdb)) {
+            case SMSG_NO_ERROR: nPubkeys++; break;          // added key
+            case SMSG_PUBKEY_EXISTS: nDuplicates++; break;  // duplicate key
         }
+    }
 
-        for (const auto &txin : tx->vin) {
-            if (txin.IsAnonInput()) {
-                continue;
-            }
-            if (txin.scriptWitness.stack.size() != 2) {
-                continue;
-            }
-            if (txin.scriptWitness.stack[1].size() != 33) {
-                continue;
-            }
-
-            CPubKey pubKey(txin.scriptWitness.stack[1]);
-
-            if (!pubKey.IsValid()
-                || !pubKey.IsCompressed()) {
-                LogPrintf("Public key is invalid %s.\n", HexStr(pubKey));
-                continue;
-            }
-
-            CKeyID addrKey = pubKey.GetID();
-            switch (InsertAddress(addrKey, pubKey, addrpkdb)) {
-                case SMSG_NO_ERROR: nPubkeys++; break;          // added key
-                case SMSG_PUBKEY_EXISTS: nDuplicates++; break;  // duplicate key
-            }
-
-            if (tx->IsCoinStake()) { // coinstake inputs are always from the same address/pubkey
-                break;
-            }
-        }
-
-        nTransactions++;
-
-        if (nTransactions % 10000 == 0) { // for ScanChainForPublicKeys
-            LogPrintf("Scanning transaction no. %u.\n", nTransactions);
-        }
+    if (nTransactions / 10000 != nTransactionsBefore / 10000) { // for ScanChainForPublicKeys
+        LogPrintf("Scanning transaction no. %u.\n", nTransactions);
     }
     return true;
 };
@@ -2035,7 +2680,8 @@ static bool ScanBlock(CSMSG &smsg, const CBlock &block, SecMsgDB &addrpkdb,
   */
 bool CSMSG::ScanBlock(const CBlock &block)
 {
-    if (!options.fScanIncoming) {
+    if (!options.fScanIncoming || g_pubkey_index) {
+        // The index receives connected blocks itself
         return true;
     }
 
@@ -2117,6 +2763,11 @@ bool CSMSG::ScanChainForPublicKeys(CBlockIndex *pindexStart)
 
 bool CSMSG::ScanBlockChain()
 {
+    if (g_pubkey_index) {
+        LogPrintf("%s: Public keys are harvested by %s.\n", __func__, g_pubkey_index->GetSummary().name);
+        return true;
+    }
+
     TRY_LOCK(cs_main, lockMain);
     if (lockMain) {
         CBlockIndex *pindexScan = m_node->chainman->ActiveChain().Genesis();
@@ -2151,7 +2802,9 @@ bool CSMSG::ScanBuckets(bool scan_all)
     uint32_t nFiles         = 0;
     uint32_t nMessages      = 0;
     uint32_t nFoundMessages = 0;
-    unsigned char header_buffer[SMSG_HDR_LEN];
+
+    // Files are read and the wl files removed
+    m_bucket_writers.CloseAll(false);
 
     fs::path pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
     fs::directory_iterator itend;
@@ -2163,7 +2816,7 @@ bool CSMSG::ScanBuckets(bool scan_all)
     }
 
     SecureMessage smsg;
-    std::vector<uint8_t> vchData;
+    std::vector<fs::path> vPaths;
 
     for (fs::directory_iterator itd(pathSmsgDir); itd != itend; ++itd) {
         if (!fs::is_regular_file(itd->status())) {
@@ -2215,58 +2868,38 @@ bool CSMSG::ScanBuckets(bool scan_all)
             continue;
         }
 
-        {
-            LOCK(cs_smsg);
-            FILE *fp;
-            errno = 0;
-            if (!(fp = fopen(itd->path().string().c_str(), "rb"))) {
-                LogPrintf("Error opening file: %s\n", SysErrorString(errno));
+        vPaths.push_back(itd->path());
+    }
+
+    {
+        LOCK(cs_smsg);
+        std::vector<std::unique_ptr<BucketFileReader> > vFiles;
+        std::vector<SecMsgScanItem> vItems;
+        for (const auto &path : vPaths) {
+            vFiles.push_back(std::make_unique<BucketFileReader>(path));
+            BucketFileReader &file = *vFiles.back();
+            if (!file.IsOpen()) {
                 continue;
             }
 
-            for (;;) {
-                errno = 0;
-                if (fread(header_buffer, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN) {
-                    if (errno != 0) {
-                        LogPrintf("fread header failed: %s\n", SysErrorString(errno));
-                    } else {
-                        //LogPrintf("End of file.\n");
-                    }
-                    break;
-                }
-                smsg.set(header_buffer);
-
-                try { vchData.resize(smsg.nPayload); } catch (std::exception &e) {
-                    LogPrintf("SecureMsgWalletUnlocked(): Could not resize vchData, %u, %s\n", smsg.nPayload, e.what());
-                    fclose(fp);
-                    return false;
-                }
-
-                if (fread(vchData.data(), sizeof(uint8_t), smsg.nPayload, fp) != smsg.nPayload) {
-                    LogPrintf("fread data failed: %s\n", SysErrorString(errno));
-                    break;
-                }
-
+            const uint8_t *pHeader, *pPayload;
+            size_t ofs;
+            while (file.Next(smsg, pHeader, pPayload, ofs)) {
                 if (smsg.version[0] == 0 && smsg.version[1] == 0) {
                     // Purged message header
                 } else
                 if (!scan_all && smsg.timestamp + smsg.m_ttl < now) {
                     // Expired message
                 } else {
-                    bool fOwnMessage;
-                    int rv = ScanMessage(header_buffer, vchData.data(), smsg.nPayload, false, fOwnMessage);
-                    if (rv == SMSG_NO_ERROR) {
-                        nFoundMessages++;
-                    } else {
-                        // SecureMsgScanMessage failed
-                    }
+                    vItems.emplace_back(pHeader, pPayload, smsg.nPayload);
                 }
                 nMessages++;
             }
-
-            fclose(fp);
-        } // cs_smsg
-    }
+        }
+        if (SMSG_NO_ERROR != ScanMessages(vItems, false, nFoundMessages)) {
+            return false;
+        }
+    } // cs_smsg
 
     LogPrintf("Processed %u files, scanned %u messages, received %u messages.\n", nFiles, nMessages, nFoundMessages);
     LogPrintf("Took %d ms\n", GetTimeMillis() - mStart);
@@ -2331,7 +2964,9 @@ int CSMSG::WalletUnlocked(wallet::CWallet *pwallet)
     uint32_t nFiles         = 0;
     uint32_t nMessages      = 0;
     uint32_t nFoundMessages = 0;
-    unsigned char header_buffer[SMSG_HDR_LEN];
+
+    // The wl files are read and removed
+    m_bucket_writers.CloseAll(false);
 
     fs::path pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
     fs::directory_iterator itend;
@@ -2343,7 +2978,7 @@ int CSMSG::WalletUnlocked(wallet::CWallet *pwallet)
     }
 
     SecureMessage smsg;
-    std::vector<uint8_t> vchData;
+    std::vector<fs::path> vPaths;
 
     for (fs::directory_iterator itd(pathSmsgDir); itd != itend; ++itd) {
         if (!fs::is_regular_file(itd->status())) {
@@ -2376,79 +3011,56 @@ int CSMSG::WalletUnlocked(wallet::CWallet *pwallet)
 
         if (fileTime < now - SMSG_RETENTION) {
             LogPrintf("Dropping wallet locked file %s, expired.\n", fileName);
-            try {
-                fs::remove(itd->path());
-            } catch (const fs::filesystem_error &ex) {
-                return errorN(SMSG_GENERAL_ERROR, "%s: Could not remove file %s - %s.", __func__, fileName, ex.what());
-            }
-            continue;
-        }
-
-        bool remove_file = true;
-        {
-            LOCK(cs_smsg);
-            FILE *fp;
-            errno = 0;
-            if (!(fp = fopen(itd->path().string().c_str(), "rb"))) {
-                LogPrintf("Error opening file: %s\n", SysErrorString(errno));
-                continue;
-            }
-
-            for (;;) {
-                errno = 0;
-                if (fread(header_buffer, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN) {
-                    if (errno != 0) {
-                        LogPrintf("fread header failed: %s\n", SysErrorString(errno));
-                    } else {
-                        //LogPrintf("End of file.\n");
-                    }
-                    break;
-                }
-                smsg.set(header_buffer);
-
-                try { vchData.resize(smsg.nPayload); } catch (std::exception &e) {
-                    LogPrintf("%s: Could not resize vchData, %u, %s\n", __func__, smsg.nPayload, e.what());
-                    fclose(fp);
-                    return SMSG_GENERAL_ERROR;
-                }
+            try {
+                fs::remove(itd->path());
+            } catch (const fs::filesystem_error &ex) {
+                return errorN(SMSG_GENERAL_ERROR, "%s: Could not remove file %s - %s.", __func__, fileName, ex.what());
+            }
+            continue;
+        }
 
-                if (fread(&vchData[0], sizeof(uint8_t), smsg.nPayload, fp) != smsg.nPayload) {
-                    LogPrintf("fread data failed: %s\n", SysErrorString(errno));
-                    break;
-                }
+        vPaths.push_back(itd->path());
+    }
 
-                if (now > smsg.timestamp + smsg.m_ttl) {
-                    LogPrint(BCLog::SMSG, "Time expired %d, ttl %d.\n", smsg.timestamp, smsg.m_ttl);
+    {
+        LOCK(cs_smsg);
+        {
+            std::vector<std::unique_ptr<BucketFileReader> > vFiles;
+            std::vector<SecMsgScanItem> vItems;
+            for (const auto &path : vPaths) {
+                vFiles.push_back(std::make_unique<BucketFileReader>(path));
+                BucketFileReader &file = *vFiles.back();
+                if (!file.IsOpen()) {
                     continue;
                 }
 
-                // Don't report to gui,
-                bool fOwnMessage;
-                int rv = ScanMessage(header_buffer, &vchData[0], smsg.nPayload, false, fOwnMessage, true);
-                if (rv == 0) {
-                    nFoundMessages++;
-                } else
-                if (rv == SMSG_WALLET_LOCKED) {
-                    remove_file = false;
-                } else {
-                    // SecureMsgScanMessage failed
+                const uint8_t *pHeader, *pPayload;
+                size_t ofs;
+                while (file.Next(smsg, pHeader, pPayload, ofs)) {
+                    if (now > smsg.timestamp + smsg.m_ttl) {
+                        LogPrint(BCLog::SMSG, "Time expired %d, ttl %d.\n", smsg.timestamp, smsg.m_ttl);
+                        continue;
+                    }
+                    vItems.emplace_back(pHeader, pPayload, smsg.nPayload);
+                    nMessages++;
                 }
-
-                nMessages++;
             }
+            int rv = ScanMessages(vItems, true, nFoundMessages);
+            if (rv != SMSG_NO_ERROR) {
+                return rv;
+            }
+        }
 
-            fclose(fp);
-
-            // Remove wl file when scanned
-            if (remove_file) {
-                try {
-                    fs::remove(itd->path());
-                } catch (const fs::filesystem_error &ex) {
-                    return errorN(SMSG_GENERAL_ERROR, "%s: Could not remove file %s - %s.", __func__, fileName, ex.what());
-                }
+        // Remove wl files when scanned
+        for (const auto &path : vPaths) {
+            m_bucket_writers.Close(path);
+            try {
+                fs::remove(path);
+            } catch (const fs::filesystem_error &ex) {
+                return errorN(SMSG_GENERAL_ERROR, "%s: Could not remove file %s - %s.", __func__, fs::PathToString(path), ex.what());
             }
-        } // cs_smsg
-    }
+        }
+    } // cs_smsg
 
     LogPrintf("Processed %u files, scanned %u messages, received %u messages.\n", nFiles, nMessages, nFoundMessages);
 
@@ -2480,175 +3092,315 @@ int CSMSG::WalletKeyChanged(CKeyID &keyId, const std::string &sLabel, ChangeType
     return ManageLocalKey(keyId, mode);
 };
 
-/** Check if message belongs to this node.
-  * If so add to inbox db.
-  *
-  * if !reportToGui don't fire NotifySecMsgInboxChanged
-  *  - loads messages received when wallet locked in bulk.
-  */
-int CSMSG::ScanMessage(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool reportToGui, bool &fOwnMessage, bool unlocking)
+void CSMSG::GetScanKeys(std::vector<SecMsgScanKey> &keys, bool &was_locked)
 {
-    LogPrint(BCLog::SMSG, "%s\n", __func__);
-
-    fOwnMessage = false;
-    MessageData msg; // placeholder
-    CKeyID addressTo;
-    for (auto &p : smsgModule.keyStore.mapKeys) {
+    AssertLockHeld(cs_smsg);
+    was_locked = false;
+    for (auto &p : keyStore.mapKeys) {
         auto &address = p.first;
         auto &key = p.second;
 
         if (!(key.nFlags & SMK_RECEIVE_ON)) {
             continue;
         }
+        keys.emplace_back(key.key, address, key.nFlags & SMK_RECEIVE_ANON);
+    }
 
-        if (!(key.nFlags & SMK_RECEIVE_ANON)) {
-            // Have to do full decrypt to see address from
-            if (Decrypt(false, key.key, address, pHeader, pPayload, nPayload, msg) == 0) {
-                if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
-                    LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                }
-                if (msg.sFromAddress.compare("anon") != 0) {
-                    fOwnMessage = true;
+#ifdef ENABLE_WALLET
+    for (std::vector<SecMsgAddress>::iterator it = addresses.begin(); it != addresses.end(); ++it) {
+        if (!it->fReceiveEnabled) {
+            continue;
+        }
+
+        CKey keyDest;
+        for (const auto &pw : m_vpwallets) {
+            if (pw->IsLocked()) {
+                if (pw->HaveKey(it->address)) {
+                    was_locked = true;
                 }
-                addressTo = address;
-                break;
+                continue;
             }
-        } else {
-            if (Decrypt(true, key.key, address, pHeader, pPayload, nPayload, msg) == 0) {
-                if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
-                    LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                }
-                fOwnMessage = true;
-                addressTo = address;
+            if (pw->GetKey(it->address, keyDest)) {
                 break;
             }
         }
+        if (!keyDest.IsValid()) {
+            continue;
+        }
+        keys.emplace_back(keyDest, it->address, it->fReceiveAnon);
     }
+#endif
+}
 
-    bool was_locked = false;
-    if (!fOwnMessage) {
-#ifdef ENABLE_WALLET
+/** Fast reject check, the MAC only needs the ECDH shared secret. */
+static bool CheckMessageMAC(const secp256k1_pubkey &R, const SecureMessage &smsg, const uint8_t *pPayload, uint32_t nPayload, const CKey &keyDest)
+{
+    uint8_t P[32], H[64], MAC[32];
+    if (!secp256k1_ecdh(secp256k1_context_smsg, P, &R, keyDest.begin(), nullptr, nullptr)) {
+        return false;
+    }
+    CSHA512().Write(P, 32).Finalize(H);
 
-        for (std::vector<SecMsgAddress>::iterator it = addresses.begin(); it != addresses.end(); ++it) {
-            if (!it->fReceiveEnabled) {
-                continue;
-            }
+    CHMAC_SHA256 ctx(&H[32], 32);
+    int64_t tmp64 = htole64(smsg.timestamp);
+    ctx.Write((uint8_t*) &tmp64, sizeof(tmp64));
+    ctx.Write((uint8_t*) smsg.iv, sizeof(smsg.iv));
+    ctx.Write(pPayload, nPayload);
+    ctx.Finalize(MAC);
 
-            addressTo = it->address;
+    return part::memcmp_nta(MAC, smsg.mac, 32) == 0;
+}
 
-            CKey keyDest;
-            for (const auto &pw : m_vpwallets) {
-                if (pw->IsLocked()) {
-                    if (pw->HaveKey(addressTo)) {
-                        was_locked = true;
-                    }
-                    continue;
-                }
-                if (pw->GetKey(addressTo, keyDest)) {
-                    break;
-                }
-            }
-            if (!keyDest.IsValid()) {
-                continue;
+int CSMSG::FindScanKey(const std::vector<SecMsgScanKey> &keys, size_t nStart, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload)
+{
+    if (nStart >= keys.size()) {
+        return -1;
+    }
+    int64_t nTimeStart = GetTimeMicros();
+
+    SecureMessage smsg(pHeader);
+    if (smsg.IsPaidVersion()) {
+        if (nPayload < 32) {
+            return -1;
+        }
+        nPayload -= 32; // Exclude funding txid
+    } else
+    if (smsg.version[0] != 2) {
+        return -1;
+    }
+
+    // Parse the ephemeral public key once for all keys
+    secp256k1_pubkey R;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_smsg, &R, smsg.cpkR, 33)) {
+        return -1;
+    }
+
+    int rv = -1;
+    size_t nTried = 0;
+    for (size_t i = nStart; i < keys.size(); ++i) {
+        nTried++;
+        if (CheckMessageMAC(R, smsg, pPayload, nPayload, keys[i].key)) {
+            rv = i;
+            break;
+        }
+    }
+
+    m_trial_messages++;
+    m_trial_keys += nTried;
+    m_trial_us += GetTimeMicros() - nTimeStart;
+    return rv;
+}
+
+bool CSMSG::ResolveScanKey(const std::vector<SecMsgScanKey> &keys, int nKey, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, CKeyID &addressTo)
+{
+    MessageData msg;
+    while (nKey >= 0) {
+        const SecMsgScanKey &key = keys[nKey];
+        // Have to do full decrypt to see address from
+        if (key.fReceiveAnon
+            || (Decrypt(false, key.key, key.address, pHeader, pPayload, nPayload, msg) == 0
+                && msg.sFromAddress.compare("anon") != 0)) {
+            if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
+                LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(key.address)));
             }
+            addressTo = key.address;
+            return true;
+        }
+        nKey = FindScanKey(keys, nKey + 1, pHeader, pPayload, nPayload);
+    }
+    return false;
+}
 
-            if (!it->fReceiveAnon) {
-                // Have to do full decrypt to see address from
-                if (Decrypt(false, keyDest, addressTo, pHeader, pPayload, nPayload, msg) == 0) {
-                    if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
-                        LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                    }
-                    if (msg.sFromAddress.compare("anon") != 0) {
-                        fOwnMessage = true;
-                    }
-                    break;
-                }
+int CSMSG::StoreInbox(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, const CKeyID &addressTo, bool reportToGui, SecMsgDB *pdb)
+{
+    SecureMessage smsg(pHeader);
+
+    uint160 hash;
+    HashMsg(smsg, pPayload, nPayload-(smsg.IsPaidVersion() ? 32 : 0), hash);
+
+    uint8_t chKey[30];
+    int64_t timestamp_be = (int64_t)htobe64(smsg.timestamp);
+    memcpy(&chKey[0], DBK_INBOX.data(), 2);
+    memcpy(&chKey[2], &timestamp_be, 8);
+    memcpy(&chKey[10], hash.begin(), 20);
+
+    SecMsgStored smsgInbox;
+    smsgInbox.timeReceived  = GetTime();
+    smsgInbox.status        = (SMSG_MASK_UNREAD) & 0xFF;
+    smsgInbox.addrTo        = addressTo;
+
+    try { smsgInbox.vchMessage.resize(SMSG_HDR_LEN + nPayload); } catch (std::exception &e) {
+        return errorN(SMSG_ALLOCATE_FAILED, "%s: Could not resize vchData, %u, %s.", __func__, SMSG_HDR_LEN + nPayload, e.what());
+    }
+    memcpy(&smsgInbox.vchMessage[0], pHeader, SMSG_HDR_LEN);
+    memcpy(&smsgInbox.vchMessage[SMSG_HDR_LEN], pPayload, nPayload);
+
+    bool fExisted = false;
+    {
+        LOCK(cs_smsgDB);
+        SecMsgDB dbLocal;
+        SecMsgDB &dbInbox = pdb ? *pdb : dbLocal;
+
+        if (dbInbox.IsOpen() || dbInbox.Open("cw")) {
+            if (dbInbox.ExistsSmesg(chKey)) {
+                fExisted = true;
+                LogPrint(BCLog::SMSG, "Message already exists in inbox db.\n");
             } else {
-                if (Decrypt(true, keyDest, addressTo, pHeader, pPayload, nPayload, msg) == 0) {
-                    if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
-                        LogPrintf("Decrypted message with %s.\n", EncodeDestination(PKHash(addressTo)));
-                    }
-                    fOwnMessage = true;
-                    break;
+                dbInbox.WriteSmesg(chKey, smsgInbox);
+                if (reportToGui) {
+                    NotifySecMsgInboxChanged(smsgInbox);
                 }
+                LogPrintf("SecureMsg saved to inbox, received with %s.\n", EncodeDestination(PKHash(addressTo)));
             }
         }
+    } // cs_smsgDB
+
+#if HAVE_SYSTEM
+    if (!fExisted) {
+        // notify an external script when a message comes in
+        std::string strCmd = gArgs.GetArg("-smsgnotify", "");
+
+        //TODO: Format message
+        if (!strCmd.empty()) {
+            boost::replace_all(strCmd, "%s", EncodeDestination(PKHash(addressTo)));
+            std::thread t(runCommand, strCmd);
+            t.detach(); // thread runs free
+        }
+
+        QueueNotification(pHeader, hash, smsgInbox.timeReceived);
+    }
 #endif
+
+    return SMSG_NO_ERROR;
+};
+
+/** Check if message belongs to this node.
+  * If so add to inbox db.
+  *
+  * if !reportToGui don't fire NotifySecMsgInboxChanged
+  *  - loads messages received when wallet locked in bulk.
+  */
+int CSMSG::ScanMessage(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool reportToGui, bool &fOwnMessage, bool unlocking)
+{
+    LogPrint(BCLog::SMSG, "%s\n", __func__);
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
+
+    std::vector<SecMsgScanKey> keys;
+    bool was_locked = false;
+    {
+        LOCK(cs_smsg);
+        GetScanKeys(keys, was_locked);
     }
 
+    CKeyID addressTo;
+    int nKey = FindScanKey(keys, 0, pHeader, pPayload, nPayload);
+    fOwnMessage = ResolveScanKey(keys, nKey, pHeader, pPayload, nPayload, addressTo);
+
+    int rv = SMSG_NO_ERROR;
     if (!fOwnMessage && was_locked && !unlocking) {
         LogPrint(BCLog::SMSG, "%s: Wallet is locked, storing message to scan later.\n", __func__);
         // Only save unscanned if there are addresses
         // was_locked will onlye be set if addresses.size() > 0
-        int rv;
-        if ((rv = StoreUnscanned(pHeader, pPayload, nPayload)) != 0) {
-            return SMSG_GENERAL_ERROR;
-        }
-        return SMSG_WALLET_LOCKED;
+        rv = StoreUnscanned(pHeader, pPayload, nPayload) != 0 ? SMSG_GENERAL_ERROR : SMSG_WALLET_LOCKED;
+    } else
+    if (fOwnMessage) {
+        rv = StoreInbox(pHeader, pPayload, nPayload, addressTo, reportToGui, nullptr);
     }
 
-    if (fOwnMessage) {
-        // Save to inbox
-        SecureMessage smsg(pHeader);
+    TRACE5(smsg, scan_message,
+        (uint64_t)keys.size(),
+        nPayload,
+        fOwnMessage,
+        rv,
+        GetTimeMicros() - start_us);
+    return rv;
+};
 
-        uint160 hash;
-        HashMsg(smsg, pPayload, nPayload-(smsg.IsPaidVersion() ? 32 : 0), hash);
+int CSMSG::ScanMessages(std::vector<SecMsgScanItem> &items, bool unlocking, uint32_t &nFoundMessages)
+{
+    AssertLockHeld(cs_smsg);
 
-        uint8_t chKey[30];
-        int64_t timestamp_be = (int64_t)htobe64(smsg.timestamp);
-        memcpy(&chKey[0], DBK_INBOX.data(), 2);
-        memcpy(&chKey[2], &timestamp_be, 8);
-        memcpy(&chKey[10], hash.begin(), 20);
+    std::vector<SecMsgScanKey> keys;
+    bool was_locked = false;
+    GetScanKeys(keys, was_locked);
 
-        SecMsgStored smsgInbox;
-        smsgInbox.timeReceived  = GetTime();
-        smsgInbox.status        = (SMSG_MASK_UNREAD) & 0xFF;
-        smsgInbox.addrTo        = addressTo;
+    // Trial decryption is independent per message, split it over threads
+    const size_t nItems = items.size();
+    size_t nThreads = 1;
+    if (keys.size() > 0 && nItems > SMSG_SCAN_CHUNK) {
+        nThreads = std::min<size_t>({(size_t)std::max(GetNumCores(), 1), SMSG_MAX_SCAN_THREADS, nItems / SMSG_SCAN_CHUNK});
+    }
 
-        try { smsgInbox.vchMessage.resize(SMSG_HDR_LEN + nPayload); } catch (std::exception &e) {
-            return errorN(SMSG_ALLOCATE_FAILED, "%s: Could not resize vchData, %u, %s.", __func__, SMSG_HDR_LEN + nPayload, e.what());
+    const std::string sProgress = _("Scanning messages…").translated;
+    std::atomic<size_t> nNext{0}, nDone{0};
+    auto scan = [&](bool report) {
+        int nLastReported = -1;
+        for (;;) {
+            size_t i = nNext.fetch_add(SMSG_SCAN_CHUNK);
+            if (i >= nItems) {
+                break;
+            }
+            size_t end = std::min(nItems, i + SMSG_SCAN_CHUNK);
+            for (size_t k = i; k < end; ++k) {
+                items[k].nKey = keys.empty() ? -1 : FindScanKey(keys, 0, items[k].pHeader, items[k].pPayload, items[k].nPayload);
+            }
+            size_t nDoneNow = nDone.fetch_add(end - i) + (end - i);
+            int nProgress = (int)(nDoneNow * 100 / nItems);
+            if (report && nProgress != nLastReported) {
+                uiInterface.ShowProgress(sProgress, std::min(nProgress, 99), false);
+                nLastReported = nProgress;
+            }
         }
-        memcpy(&smsgInbox.vchMessage[0], pHeader, SMSG_HDR_LEN);
-        memcpy(&smsgInbox.vchMessage[SMSG_HDR_LEN], pPayload, nPayload);
+    };
 
-        bool fExisted = false;
-        {
-            LOCK(cs_smsgDB);
-            SecMsgDB dbInbox;
+    if (nItems > 0) {
+        std::vector<std::thread> vThreads;
+        for (size_t i = 1; i < nThreads; ++i) {
+            vThreads.emplace_back([&, i]() {
+                util::ThreadRename(strprintf("smsgscan.%i", i));
+                scan(false);
+            });
+        }
+        scan(true);
+        for (auto &t : vThreads) {
+            t.join();
+        }
+        uiInterface.ShowProgress(sProgress, 100, false);
+    }
 
-            if (dbInbox.Open("cw")) {
-                if (dbInbox.ExistsSmesg(chKey)) {
-                    fExisted = true;
-                    LogPrint(BCLog::SMSG, "Message already exists in inbox db.\n");
-                } else {
-                    dbInbox.WriteSmesg(chKey, smsgInbox);
-                    if (reportToGui) {
-                        NotifySecMsgInboxChanged(smsgInbox);
-                    }
-                    LogPrintf("SecureMsg saved to inbox, received with %s.\n", EncodeDestination(PKHash(addressTo)));
-                }
+    // Store received messages in file order, committing in batches
+    LOCK(cs_smsgDB);
+    SecMsgDB db;
+    if (!db.Open("cw")) {
+        return errorN(SMSG_GENERAL_ERROR, "%s: Failed to open db.", __func__);
+    }
+    db.TxnBegin();
+    size_t nBatched = 0;
+    for (const auto &item : items) {
+        CKeyID addressTo;
+        if (!ResolveScanKey(keys, item.nKey, item.pHeader, item.pPayload, item.nPayload, addressTo)) {
+            if (was_locked && !unlocking) {
+                StoreUnscanned(item.pHeader, item.pPayload, item.nPayload);
             }
-        } // cs_smsgDB
-
-#if HAVE_SYSTEM
-        if (!fExisted) {
-            // notify an external script when a message comes in
-            std::string strCmd = gArgs.GetArg("-smsgnotify", "");
-
-            //TODO: Format message
-            if (!strCmd.empty()) {
-                boost::replace_all(strCmd, "%s", EncodeDestination(PKHash(addressTo)));
-                std::thread t(runCommand, strCmd);
-                t.detach(); // thread runs free
+            continue;
+        }
+        if (StoreInbox(item.pHeader, item.pPayload, item.nPayload, addressTo, false, &db) == SMSG_NO_ERROR) {
+            nFoundMessages++;
+        }
+        if (++nBatched >= SMSG_SCAN_BATCH_SIZE) {
+            if (!db.TxnCommit()) {
+                return errorN(SMSG_GENERAL_ERROR, "%s: Batch commit failed.", __func__);
             }
-
-            GetMainSignals().NewSecureMessage(&smsg, hash);
+            db.TxnBegin();
+            nBatched = 0;
         }
-#endif
+    }
+    if (!db.TxnCommit()) {
+        return errorN(SMSG_GENERAL_ERROR, "%s: Batch commit failed.", __func__);
     }
 
     return SMSG_NO_ERROR;
-};
+}
 
 int CSMSG::GetLocalKey(const CKeyID &ckid, CPubKey &cpkOut)
 {
@@ -2714,6 +3466,10 @@ int CSMSG::GetStoredKey(const CKeyID &ckid, CPubKey &cpkOut)
 {
     LogPrint(BCLog::SMSG, "%s\n", __func__);
 
+    if (WITH_LOCK(cs_pubkey_cache, return m_pubkey_cache.Get(ckid, cpkOut))) {
+        return SMSG_NO_ERROR;
+    }
+
     {
         LOCK(cs_smsgDB);
         SecMsgDB addrpkdb;
@@ -2728,6 +3484,8 @@ int CSMSG::GetStoredKey(const CKeyID &ckid, CPubKey &cpkOut)
         }
     } // cs_smsgDB
 
+    // The id is the hash of the key, a cached entry can't go stale
+    WITH_LOCK(cs_pubkey_cache, m_pubkey_cache.Insert(ckid, cpkOut));
     return SMSG_NO_ERROR;
 };
 
@@ -2946,6 +3704,7 @@ int CSMSG::Retrieve(const SecMsgToken &token, std::vector<uint8_t> &vchData)
     int64_t bucket = token.timestamp - (token.timestamp % SMSG_BUCKET_LEN);
     std::string fileName = ToString(bucket) + "_01.dat";
     fs::path fullpath = pathSmsgDir / fs::PathFromString(fileName);
+    m_bucket_writers.Flush(fullpath);
 
     FILE *fp;
     errno = 0;
@@ -2998,6 +3757,8 @@ int CSMSG::Remove(const SecMsgToken &token)
     int64_t bucket = token.timestamp - (token.timestamp % SMSG_BUCKET_LEN);
     std::string fileName = ToString(bucket) + "_01.dat";
     fs::path fullpath = pathSmsgDir / fs::PathFromString(fileName);
+    // Appends are O_APPEND and can't overwrite the edit, the record only needs to be on disk
+    m_bucket_writers.Flush(fullpath);
 
     FILE *fp;
     errno = 0;
@@ -3025,22 +3786,145 @@ int CSMSG::Remove(const SecMsgToken &token)
         return errorN(SMSG_GENERAL_ERROR, "%s - zero version error: %s.", __func__, SysErrorString(errno));
     }
 
+    if (smsg.nPayload == 8) {
+        // Compacted record, only the sample is left
+        fclose(fp);
+        return SMSG_NO_ERROR;
+    }
+
     if (fseek(fp, token.offset + SMSG_HDR_LEN + 8, SEEK_SET) != 0) {
         fclose(fp);
         return errorN(SMSG_GENERAL_ERROR, "%s - fseek, error: %s.", __func__, SysErrorString(errno));
     }
-
-    size_t zlen = smsg.nPayload - 8;
-    std::vector<uint8_t> zbuf;
-    zbuf.resize(zlen);
-    memset(zbuf.data(), 0, zlen);
-    if (smsg.nPayload <= 8 ||  zlen != fwrite(zbuf.data(), 1, zlen, fp)) {
-        fclose(fp);
-        return errorN(SMSG_GENERAL_ERROR, "%s - fwrite, zlen %d, error: %s.", __func__, zlen, SysErrorString(errno));
+
+    size_t zlen = smsg.nPayload - 8;
+    std::vector<uint8_t> zbuf;
+    zbuf.resize(zlen);
+    memset(zbuf.data(), 0, zlen);
+    if (smsg.nPayload <= 8 ||  zlen != fwrite(zbuf.data(), 1, zlen, fp)) {
+        fclose(fp);
+        return errorN(SMSG_GENERAL_ERROR, "%s - fwrite, zlen %d, error: %s.", __func__, zlen, SysErrorString(errno));
+    }
+
+    fclose(fp);
+    return SMSG_NO_ERROR;
+};
+
+int CSMSG::CompactBucket(int64_t bucket_time, SecMsgBucket &bucket, int64_t now, uint64_t &reclaimed)
+{
+    AssertLockHeld(cs_smsg);
+
+    fs::path pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
+    std::string fileName = ToString(bucket_time) + "_01.dat";
+    fs::path fullpath = pathSmsgDir / fs::PathFromString(fileName);
+    fs::path tmppath = pathSmsgDir / fs::PathFromString(fileName + ".tmp");
+    m_bucket_writers.Close(fullpath);
+
+    // Old offset to new offset and payload size, applied to the tokens once the file is replaced
+    std::map<int64_t, std::pair<int64_t, uint32_t> > moved;
+    uint64_t nBytesIn = 0, nBytesOut = 0;
+    {
+        BucketFileReader file(fullpath);
+        if (!file.IsOpen()) {
+            return errorN(SMSG_GENERAL_ERROR, "%s - Can't open file: %s.", __func__, fs::PathToString(fullpath));
+        }
+
+        FILE *fp;
+        errno = 0;
+        if (!(fp = fsbridge::fopen(tmppath, "wb"))) {
+            return errorN(SMSG_GENERAL_ERROR, "%s - Can't open file: %s\nPath %s.", __func__, SysErrorString(errno), fs::PathToString(tmppath));
+        }
+
+        SecureMessage smsg;
+        uint8_t header_buffer[SMSG_HDR_LEN];
+        const uint8_t *pHeader, *pPayload;
+        size_t ofs;
+        bool fOk = true;
+        while (file.Next(smsg, pHeader, pPayload, ofs)) {
+            nBytesIn += SMSG_HDR_LEN + smsg.nPayload;
+            bool fPurged = smsg.version[0] == 0 && smsg.version[1] == 0;
+            if ((fPurged || smsg.timestamp + smsg.m_ttl < now) && smsg.nPayload > 8) {
+                // Keep the sample so the token is still known, loads as a purged token
+                smsg.version[0] = 0;
+                smsg.version[1] = 0;
+                smsg.nPayload = 8;
+                smsg.WriteHeader(header_buffer);
+                pHeader = header_buffer;
+            }
+            moved[ofs] = std::make_pair((int64_t)nBytesOut, smsg.nPayload);
+            if (fwrite(pHeader, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN
+                || fwrite(pPayload, sizeof(uint8_t), smsg.nPayload, fp) != smsg.nPayload) {
+                fOk = false;
+                break;
+            }
+            nBytesOut += SMSG_HDR_LEN + smsg.nPayload;
+        }
+        if (fOk && !FileCommit(fp)) {
+            fOk = false;
+        }
+        fclose(fp);
+        if (!fOk) {
+            try { fs::remove(tmppath);
+            } catch (const fs::filesystem_error &ex) {
+                LogPrintf("Error removing temporary file %s.\n", ex.what());
+            }
+            return errorN(SMSG_GENERAL_ERROR, "%s - fwrite failed: %s.", __func__, fs::PathToString(tmppath));
+        }
+    } // Unmap before replacing the file
+
+    if (!RenameOver(tmppath, fullpath)) {
+        return errorN(SMSG_GENERAL_ERROR, "%s - Rename failed: %s.", __func__, fs::PathToString(tmppath));
+    }
+
+    for (const auto &token : bucket.setTokens) {
+        auto it = moved.find(token.offset);
+        if (it == moved.end()) {
+            LogPrintf("%s: Token %s not found in bucket %d.\n", __func__, token.ToString(), bucket_time);
+            continue;
+        }
+        token.offset = it->second.first;
+        token.m_payload_size = it->second.second;
+    }
+    // Tokens that expired since the last hash were shrunk, recount the active totals
+    bucket.hashBucket(bucket_time);
+    ScheduleBucketExpiry(bucket_time, bucket, now);
+
+    reclaimed = nBytesIn - nBytesOut;
+    LogPrint(BCLog::SMSG, "Compacted bucket %d from %u to %u bytes.\n", bucket_time, nBytesIn, nBytesOut);
+    return SMSG_NO_ERROR;
+};
+
+size_t CSMSG::CompactBuckets(uint32_t min_dead_percent, uint64_t &reclaimed)
+{
+    LOCK(cs_smsg);
+    int64_t now = GetAdjustedTime();
+    size_t nCompacted = 0;
+    reclaimed = 0;
+    for (auto &it : buckets) {
+        uint64_t nDead = it.second.CountDeadBytes(now);
+        if (nDead == 0) {
+            continue;
+        }
+        uint64_t nFileBytes = 0;
+        for (const auto &token : it.second.setTokens) {
+            nFileBytes += SMSG_HDR_LEN + token.m_payload_size;
+        }
+        if (nDead * 100 < nFileBytes * min_dead_percent) {
+            continue;
+        }
+        uint64_t nReclaimed = 0;
+        if (CompactBucket(it.first, it.second, now, nReclaimed) != SMSG_NO_ERROR) {
+            continue;
+        }
+        nCompacted++;
+        reclaimed += nReclaimed;
+    }
+    m_compacted_files += nCompacted;
+    m_compacted_bytes += reclaimed;
+    if (nCompacted > 0) {
+        LogPrintf("Compacted %u bucket files, reclaimed %u bytes.\n", nCompacted, reclaimed);
     }
-
-    fclose(fp);
-    return SMSG_NO_ERROR;
+    return nCompacted;
 };
 
 int CSMSG::SmsgMisbehaving(CNode *pfrom, uint8_t n)
@@ -3058,7 +3942,7 @@ int CSMSG::SmsgMisbehaving(CNode *pfrom, uint8_t n)
     return 0;
 };
 
-int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &vchData)
+int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, Span<const uint8_t> vchData)
 {
     LogPrint(BCLog::SMSG, "%s\n", __func__);
 
@@ -3087,29 +3971,100 @@ int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &v
         return SMSG_GENERAL_ERROR;
     }
 
-    if (nBunch > pfrom->smsgData.m_num_want_sent) {
-        LogPrintf("Error: Received unsolicited message bunch from peer %d: %d, %d.\n", pfrom->GetId(), nBunch, pfrom->smsgData.m_num_want_sent);
-        SmsgMisbehaving(pfrom, 20);
+    {
+        LOCK(pfrom->smsgData.cs_smsg_net);
+        if (nBunch > pfrom->smsgData.m_num_want_sent) {
+            LogPrintf("Error: Received unsolicited message bunch from peer %d: %d, %d.\n", pfrom->GetId(), nBunch, pfrom->smsgData.m_num_want_sent);
+            SmsgMisbehaving(pfrom, 20);
+        }
+        pfrom->smsgData.m_num_want_sent -= nBunch;
     }
-    pfrom->smsgData.m_num_want_sent -= nBunch;
+
+    auto release_bucket = [&]() {
+        ReleaseBucketLock(bktTime);
+    };
 
     if (nBunch == 0 || nBunch > MAX_BUNCH_MESSAGES || vchData.size() > MAX_BUNCH_BYTES) {
         LogPrintf("Error: Invalid message bunch received for bucket %d: %d, %d.\n", bktTime, nBunch, vchData.size());
         SmsgMisbehaving(pfrom, 20);
+        release_bucket();
+        return SMSG_GENERAL_ERROR;
+    }
 
-        {
-            LOCK(cs_smsg);
-            // Release lock on bucket if it exists
-            auto itb = buckets.find(bktTime);
-            if (itb != buckets.end()) {
-                itb->second.nLockCount = 0;
-                itb->second.nLockPeerId = -1;
-            }
-        } // cs_smsg
+    bool over_quota = false;
+    {
+        // Drop the bunch before any proof of work, funding txn or decryption checks, the bucket can be requested again
+        LOCK(pfrom->smsgData.cs_smsg_net);
+        int64_t now_us = GetTimeMicros();
+        SecMsgNode &peer = pfrom->smsgData;
+        if (!peer.m_bytes_limit.Available(vchData.size(), m_peer_bytes_rate, PEER_BYTES_BURST, now_us)
+            || !peer.m_smsgs_limit.Available(nBunch, m_peer_msgs_rate, PEER_MSGS_BURST, now_us)) {
+            peer.m_dropped_over_quota++;
+            over_quota = true;
+        } else {
+            peer.m_bytes_limit.Spend(vchData.size());
+            peer.m_smsgs_limit.Spend(nBunch);
+            peer.m_smsgs_received += nBunch;
+        }
+    }
+    if (over_quota) {
+        LogPrint(BCLog::SMSG, "Peer %d over quota, dropping bunch of %d messages for bucket %d.\n", pfrom->GetId(), nBunch, bktTime);
+        release_bucket();
+        return SMSG_GENERAL_ERROR;
+    }
+
+    // Proof of work, funding txn, decryption and storage run in the receive threads
+    bool queue_full = false;
+    {
+        LOCK(cs_receive);
+        LOCK(pfrom->smsgData.cs_smsg_net);
+        if (m_receive_stop
+            || m_receive_queue_bytes + vchData.size() > SMSG_RECEIVE_QUEUE_BYTES
+            || pfrom->smsgData.m_receive_queued >= SMSG_RECEIVE_QUEUE_PEER) {
+            pfrom->smsgData.m_dropped_over_quota++;
+            m_receive_dropped++;
+            queue_full = true;
+        } else {
+            SecMsgReceiveItem item;
+            item.pfrom = pfrom->AddRef();
+            item.peer_logic = peerLogic;
+            item.bucket_time = bktTime;
+            item.num_messages = nBunch;
+            item.data.assign(vchData.begin(), vchData.end());
+            pfrom->smsgData.m_receive_queued++;
+            m_receive_queue_bytes += item.data.size();
+            m_receive_queue.push_back(std::move(item));
+            m_receive_cv.notify_one();
+        }
+    }
+    if (queue_full) {
+        LogPrint(BCLog::SMSG, "Receive queue full, dropping bunch of %d messages for bucket %d from peer %d.\n", nBunch, bktTime, pfrom->GetId());
+        release_bucket();
         return SMSG_GENERAL_ERROR;
     }
 
+    return SMSG_NO_ERROR;
+};
+
+void CSMSG::ReleaseBucketLock(int64_t bucket_time)
+{
+    LOCK(cs_smsg);
+    // Release lock on bucket if it exists
+    auto itb = buckets.find(bucket_time);
+    if (itb != buckets.end()) {
+        itb->second.nLockCount = 0;
+        itb->second.nLockPeerId = -1;
+        ScheduleBucketExpiry(itb->first, itb->second, GetAdjustedTime());
+    }
+};
+
+int CSMSG::ProcessBunch(PeerManager *peerLogic, CNode *pfrom, int64_t bktTime, uint32_t nBunch, Span<const uint8_t> vchData)
+{
+    // The bunch may have waited in the queue
+    int64_t now = GetAdjustedTime();
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
     uint32_t n = 12;
+    [[maybe_unused]] uint32_t n_stored = 0;
 
     for (uint32_t i = 0; i < nBunch; ++i) {
         if (vchData.size() - n < SMSG_HDR_LEN) {
@@ -3118,7 +4073,13 @@ int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &v
         }
 
         SecureMessage smsg(&vchData[n]);
+        if (vchData.size() - n - SMSG_HDR_LEN < smsg.nPayload) {
+            LogPrintf("Error: not enough data sent for payload, n = %u, payload %u.\n", n, smsg.nPayload);
+            break;
+        }
+        const uint8_t *pHeader = &vchData[n];
         const uint8_t *pPayload = &vchData[n + SMSG_HDR_LEN];
+        n += SMSG_HDR_LEN + smsg.nPayload; // Advance before any message is skipped
         if (!smsg.IsPaidVersion() &&
             now - start_time > SMSG_BUCKET_LEN * 2) { // buckets should be fully matched after time
             if (smsg.timestamp < now - SMSG_BUCKET_LEN * 3) {
@@ -3159,20 +4120,28 @@ int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &v
         {
             LOCK(cs_smsg);
             // Store message, but don't hash bucket
-            if (Store(&vchData[n], &vchData[n + SMSG_HDR_LEN], smsg.nPayload, false) != 0) {
+            if (Store(pHeader, pPayload, smsg.nPayload, false) != 0) {
                 // Message dropped
                 break;
             }
+            n_stored++;
 
             bool fOwnMessage;
-            if (ScanMessage(&vchData[n], &vchData[n + SMSG_HDR_LEN], smsg.nPayload, true, fOwnMessage) != 0) {
+            if (ScanMessage(pHeader, pPayload, smsg.nPayload, true, fOwnMessage) != 0) {
                 // message recipient is not this node (or failed)
             }
         } // cs_smsg
-
-        n += SMSG_HDR_LEN + smsg.nPayload;
     }
 
+    WITH_LOCK(pfrom->smsgData.cs_smsg_net, pfrom->smsgData.m_receive_us += GetTimeMicros() - start_us);
+
+    TRACE5(smsg, receive,
+        pfrom->GetId(),
+        bktTime,
+        nBunch,
+        n_stored,
+        GetTimeMicros() - start_us);
+
     {
         LOCK(cs_smsg);
         // If messages have been added, bucket must exist now
@@ -3184,7 +4153,8 @@ int CSMSG::Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &v
 
         itb->second.nLockCount  = 0; // This node has received data from peer, release lock
         itb->second.nLockPeerId = -1;
-        itb->second.hashBucket(itb->first);
+        itb->second.MarkChanged(itb->first);
+        ScheduleBucketExpiry(itb->first, itb->second, GetAdjustedTime());
     } // cs_smsg
 
     return SMSG_NO_ERROR;
@@ -3264,19 +4234,10 @@ int CSMSG::StoreUnscanned(const uint8_t *pHeader, const uint8_t *pPayload, uint3
     std::string fileName = ToString(bucket) + "_01_wl.dat";
     fs::path fullpath = pathSmsgDir / fs::PathFromString(fileName);
 
-    FILE *fp;
-    errno = 0;
-    if (!(fp = fopen(fs::PathToString(fullpath).c_str(), "ab"))) {
-        return errorN(SMSG_GENERAL_ERROR, "%s - Can't open file, error: %s.", __func__, SysErrorString(errno));
-    }
-
-    if (fwrite(pHeader, sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN
-        || fwrite(pPayload, sizeof(uint8_t), nPayload, fp) != nPayload) {
-        fclose(fp);
-        return errorN(SMSG_GENERAL_ERROR, "%s - fwrite failed, error: %s.", __func__, SysErrorString(errno));
+    size_t ofs;
+    if (!m_bucket_writers.Append(fullpath, pHeader, pPayload, nPayload, ofs)) {
+        return errorN(SMSG_GENERAL_ERROR, "%s - Write to %s failed.", __func__, fileName);
     }
-
-    fclose(fp);
     return SMSG_NO_ERROR;
 };
 
@@ -3285,6 +4246,7 @@ int CSMSG::Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayl
 {
     LogPrint(BCLog::SMSG, "%s\n", __func__);
     AssertLockHeld(cs_smsg);
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
 
     if (!pHeader || !pPayload) {
         return errorN(SMSG_GENERAL_ERROR, "Null pointer to header or payload.");
@@ -3296,7 +4258,7 @@ int CSMSG::Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayl
         return errorN(SMSG_PURGED_MSG, "%s: Purged message.", __func__);
     }
 
-    long int ofs;
+    size_t ofs;
     fs::path pathSmsgDir;
     try {
         pathSmsgDir = gArgs.GetDataDirNet() / fs::PathFromString(STORE_DIR);
@@ -3317,10 +4279,10 @@ int CSMSG::Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayl
     uint32_t nTTL = smsg.m_ttl;
     SecMsgToken token(smsg.timestamp, pPayload, nPayload, 0, nTTL);
     token.m_changed = now - bucketTime;
+    token.m_paid = smsg.IsPaidVersion();
 
     SecMsgBucket &bucket = buckets[bucketTime];
-    std::set<SecMsgToken> &tokenSet = bucket.setTokens;
-    if (tokenSet.find(token) != tokenSet.end()) {
+    if (bucket.setTokens.find(token) != bucket.setTokens.end()) {
         LogPrint(BCLog::SMSG, "Already have message.\n");
         if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
             LogPrintf("bucketTime: %d\n", bucketTime);
@@ -3332,43 +4294,28 @@ int CSMSG::Store(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayl
     std::string fileName = ToString(bucketTime) + "_01.dat";
     fs::path fullpath = pathSmsgDir / fs::PathFromString(fileName);
 
-    FILE *fp;
-    errno = 0;
-    if (!(fp = fopen(fs::PathToString(fullpath).c_str(), "ab"))) {
-        return errorN(SMSG_GENERAL_ERROR, "fopen failed: %s.", SysErrorString(errno));
-    }
-
-    // On windows ftell will always return 0 after fopen(ab), call fseek to set.
-    errno = 0;
-    if (fseek(fp, 0, SEEK_END) != 0) {
-        fclose(fp);
-        return errorN(SMSG_GENERAL_ERROR, "fseek failed: %s.", SysErrorString(errno));
-    }
-
-    ofs = ftell(fp);
-    if (fwrite(pHeader,  sizeof(uint8_t), SMSG_HDR_LEN, fp) != (size_t)SMSG_HDR_LEN
-        || fwrite(pPayload, sizeof(uint8_t), nPayload, fp) != nPayload) {
-        fclose(fp);
-        return errorN(SMSG_GENERAL_ERROR, "fwrite failed: %s.", SysErrorString(errno));
+    // The offset includes records still buffered by the writer
+    if (!m_bucket_writers.Append(fullpath, pHeader, pPayload, nPayload, ofs)) {
+        return errorN(SMSG_GENERAL_ERROR, "%s - Write to %s failed.", __func__, fileName);
     }
 
-    fclose(fp);
-
     token.offset = ofs;
-    tokenSet.insert(token);
-
-    if (nTTL > 0 && (bucket.nLeastTTL == 0 || nTTL < bucket.nLeastTTL)) {
-        bucket.nLeastTTL = nTTL;
-    }
+    bucket.AddToken(token, now);
+    ScheduleBucketExpiry(bucketTime, bucket, now);
 
     if (fHashBucket) {
-        bucket.hashBucket(bucketTime);
+        bucket.MarkChanged(bucketTime);
     }
 
     LogPrint(BCLog::SMSG, "SecureMsg added to bucket %d.\n", bucketTime);
 
     m_last_changed = GetTime();
 
+    TRACE4(smsg, store,
+        bucketTime,
+        nPayload,
+        fHashBucket,
+        GetTimeMicros() - start_us);
     return SMSG_NO_ERROR;
 };
 
@@ -3405,14 +4352,10 @@ int CSMSG::Purge(std::vector<uint8_t> &vMsgId, std::string &sError)
     int64_t bucketTime = msgtime - (msgtime % SMSG_BUCKET_LEN);
 
     SecMsgBucket &bucket = buckets[bucketTime];
-    std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+    auto range = bucket.setTokens.equal_range(msgtime);
 
     std::vector<uint8_t> vchOne;
-    for (auto it = tokenSet.begin(); it != tokenSet.end(); ++it) {
-        if (it->timestamp != msgtime) {
-            continue;
-        }
-
+    for (auto it = range.first; it != range.second; ++it) {
         if (Retrieve(*it, vchOne) != SMSG_NO_ERROR) {
             LogPrintf("%s: Retrieve failed, msgid: %s\n", __func__, HexStr(vMsgId));
             continue;
@@ -3428,7 +4371,9 @@ int CSMSG::Purge(std::vector<uint8_t> &vMsgId, std::string &sError)
             break;
         }
         //memcpy(purged.sample, vchOne.data() + SMSG_HDR_LEN, 8);
-        it->ttl = 0;
+        bucket.ExpireToken(*it, GetAdjustedTime());
+        bucket.MarkChanged(bucketTime);
+        ScheduleBucketExpiry(bucketTime, bucket, GetAdjustedTime());
         LogPrint(BCLog::SMSG, "Purged message %s in bucket %d\n", it->ToString(), bucketTime);
         memcpy(purged.sample, it->sample, 8);
 
@@ -3513,6 +4458,7 @@ int CSMSG::StoreFundingTx(ChainSyncCache &cache, const CTransaction &tx, const C
     if (!PutFundingData(&cache.m_connect_block_batch, tx.GetHash(), pindex->nHeight, db_data)) {
         return errorN(SMSG_GENERAL_ERROR, "%s - PutFundingData failed.", __func__);
     }
+    cache.m_funded_txids.push_back(tx.GetHash());
 
     return SMSG_NO_ERROR;
 }
@@ -3529,32 +4475,54 @@ int CSMSG::CheckFundingTx(const Consensus::Params &consensusParams, const Secure
         return SMSG_GENERAL_ERROR;
     }
 
-    std::vector<uint8_t> db_data;
-    {
-        LOCK(cs_smsgDB);
-        SecMsgDB db;
-        if (!db.Open("r")) {
-            return SMSG_GENERAL_ERROR;
+    // Many messages can share one funding txn
+    SecMsgFundingTx funding_tx;
+    bool cached = WITH_LOCK(cs_funding_cache, return m_funding_cache.Get(txid, funding_tx));
+    if (!cached) {
+        std::vector<uint8_t> db_data;
+        {
+            LOCK(cs_smsgDB);
+            SecMsgDB db;
+            if (!db.Open("r")) {
+                return SMSG_GENERAL_ERROR;
+            }
+            if (!db.ReadFundingData(txid, db_data)) {
+                LogPrint(BCLog::SMSG, "ReadFundingData failed for smsg: %s, txn: %s.\n", msgId.ToString(), txid.ToString());
+                return SMSG_FUND_DATA_NOT_FOUND;
+            }
+        }
+        if (db_data.size() < 32) {
+            return errorN(SMSG_GENERAL_ERROR, "%s: Bad funding data for txn %s.\n", __func__, txid.ToString());
+        }
+        const uint256 &hashBlock = *((const uint256*) db_data.data());
+
+        size_t n = (db_data.size() - 32) / 24;
+        funding_tx.outputs.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            memcpy(funding_tx.outputs[k].first.begin(), &db_data[32 + k * 24], 20);
+            funding_tx.outputs[k].second = memget_uint32_le(&db_data[32 + k * 24 + 20]);
+        }
+        {
+            LOCK(cs_main);
+            node::BlockMap::iterator mi = m_node->chainman->BlockIndex().find(hashBlock);
+            if (mi != m_node->chainman->BlockIndex().end()) {
+                funding_tx.pindex = &mi->second;
+            }
         }
-        if (!db.ReadFundingData(txid, db_data)) {
-            LogPrint(BCLog::SMSG, "ReadFundingData failed for smsg: %s, txn: %s.\n", msgId.ToString(), txid.ToString());
-            return SMSG_FUND_DATA_NOT_FOUND;
+        if (funding_tx.pindex) {
+            LOCK(cs_funding_cache);
+            m_funding_cache.Insert(txid, funding_tx);
         }
     }
-    const uint256 &hashBlock = *((const uint256*) db_data.data());
 
     int blockDepth = -1;
-    const CBlockIndex *pindex = nullptr;
+    const CBlockIndex *pindex = funding_tx.pindex;
     int64_t nMsgFeePerKPerDay = 0;
-    {
+    if (pindex) {
         LOCK(cs_main);
-        node::BlockMap::iterator mi = m_node->chainman->BlockIndex().find(hashBlock);
-        if (mi != m_node->chainman->BlockIndex().end()) {
-            pindex = &mi->second;
-            if (pindex && m_node->chainman->ActiveChain().Contains(pindex)) {
-                blockDepth = m_node->chainman->ActiveChain().Height() - pindex->nHeight + 1;
-                nMsgFeePerKPerDay = particl::GetSmsgFeeRate(*m_node->chainman, pindex);
-            }
+        if (m_node->chainman->ActiveChain().Contains(pindex)) {
+            blockDepth = m_node->chainman->ActiveChain().Height() - pindex->nHeight + 1;
+            nMsgFeePerKPerDay = particl::GetSmsgFeeRate(*m_node->chainman, pindex);
         }
     }
 
@@ -3565,11 +4533,9 @@ int CSMSG::CheckFundingTx(const Consensus::Params &consensusParams, const Secure
     // blockDepth >= 1 -> nMsgFeePerKPerDay must have been set
     int64_t nExpectFee = ((nMsgFeePerKPerDay * nMsgBytes) / 1000) * nDaysRetention;
 
-    size_t n = (db_data.size() - 32) / 24;
-    for (size_t k = 0; k < n; ++k) {
-        const uint8_t *pMsgIdTxStart = &db_data[32 + k * 24];
-        if (memcmp(pMsgIdTxStart, msgId.begin(), 20) == 0) {
-            uint32_t nAmount = memget_uint32_le(&db_data[32 + k * 24 + 20]);
+    for (const auto &output : funding_tx.outputs) {
+        if (output.first == msgId) {
+            uint32_t nAmount = output.second;
 
             if (nAmount < nExpectFee) {
                 LOCK(cs_main);
@@ -3632,9 +4598,22 @@ int CSMSG::PruneFundingTxData()
         }
         delete it;
 
+        it = db.pdb->NewIterator(leveldb::ReadOptions());
+        while (db.NextFundingUndo(it, height, key)) {
+            if (height >= min_height_to_keep) {
+                break;
+            }
+            db.EraseFundingUndo(height, key);
+        }
+        delete it;
+
         LogPrint(BCLog::SMSG, "Compacting DB\n");
         db.Compact();
     }
+    if (num_removed > 0) {
+        LOCK(cs_funding_cache);
+        m_funding_cache.Clear();
+    }
     if (num_removed > 0) {
         LogPrintf("%s Removed: %d, min_height_to_keep: %d\n", __func__, num_removed, min_height_to_keep);
     }
@@ -3644,6 +4623,41 @@ int CSMSG::PruneFundingTxData()
 
 int CSMSG::SetBestBlock(ChainSyncCache &cache, const uint256 &block_hash, int height, int64_t time)
 {
+    if (m_outbox_unfunded) {
+        NotifyOutbox();
+    }
+    {
+        // A txn can be reconnected in a different block after a reorg
+        LOCK(cs_funding_cache);
+        if (height <= m_funding_cache_height) {
+            m_funding_cache.Clear();
+        }
+        m_funding_cache_height = height;
+    }
+    if (!m_track_funding_txns) {
+        return SMSG_NO_ERROR;
+    }
+    if (time < GetAdjustedTime() - KEEP_FUNDING_TX_DATA) {
+        // Skip old blocks
+        cache.m_skip = true;
+        return SMSG_NO_ERROR;
+    }
+
+    if (!PutFundingUndo(&cache.m_connect_block_batch, height, block_hash, cache.m_funded_txids) ||
+        !PutBestBlock(&cache.m_connect_block_batch, block_hash, height)) {
+        return errorN(SMSG_GENERAL_ERROR, "%s - PutBestBlock failed.", __func__);
+    }
+
+    return SMSG_NO_ERROR;
+}
+
+int CSMSG::DisconnectBlock(ChainSyncCache &cache, const uint256 &block_hash, int height, int64_t time, const uint256 &prev_hash, int prev_height)
+{
+    {
+        LOCK(cs_funding_cache);
+        m_funding_cache.Clear();
+        m_funding_cache_height = prev_height;
+    }
     if (!m_track_funding_txns) {
         return SMSG_NO_ERROR;
     }
@@ -3653,7 +4667,21 @@ int CSMSG::SetBestBlock(ChainSyncCache &cache, const uint256 &block_hash, int he
         return SMSG_NO_ERROR;
     }
 
-    if (!PutBestBlock(&cache.m_connect_block_batch, block_hash, height)) {
+    std::vector<uint256> txids;
+    {
+        LOCK(cs_smsgDB);
+        if (!m_chain_sync_db.IsOpen() && !m_chain_sync_db.Open("cw")) {
+            return SMSG_GENERAL_ERROR;
+        }
+        if (!m_chain_sync_db.ReadFundingUndo(height, block_hash, txids)) {
+            LogPrint(BCLog::SMSG, "%s: No undo record for block %s, height %d.\n", __func__, block_hash.ToString(), height);
+        }
+    }
+    for (const auto &txid : txids) {
+        DeleteFundingData(&cache.m_connect_block_batch, txid, height);
+    }
+    if (!DeleteFundingUndo(&cache.m_connect_block_batch, height, block_hash) ||
+        !PutBestBlock(&cache.m_connect_block_batch, prev_hash, prev_height)) {
         return errorN(SMSG_GENERAL_ERROR, "%s - PutBestBlock failed.", __func__);
     }
 
@@ -3677,12 +4705,22 @@ int CSMSG::WriteCache(ChainSyncCache &cache)
                 return SMSG_GENERAL_ERROR;
             }
         }
-        m_chain_sync_db.CommitBatch(&cache.m_connect_block_batch);
+        if (!m_chain_sync_db.CommitBatch(&cache.m_connect_block_batch, false)) {
+            return SMSG_GENERAL_ERROR;
+        }
     }
 
     return SMSG_NO_ERROR;
 }
 
+int CSMSG::FlushChainSync()
+{
+    if (!m_track_funding_txns) {
+        return SMSG_NO_ERROR;
+    }
+    return FlushDB(true) ? SMSG_NO_ERROR : SMSG_GENERAL_ERROR;
+}
+
 int CSMSG::ReadBestBlock(uint256 &block_hash, int &height)
 {
     if (!m_track_funding_txns) {
@@ -3703,6 +4741,11 @@ int CSMSG::ReadBestBlock(uint256 &block_hash, int &height)
 
 int CSMSG::ClearBestBlock()
 {
+    {
+        LOCK(cs_funding_cache);
+        m_funding_cache.Clear();
+        m_funding_cache_height = -1;
+    }
     LOCK(cs_smsgDB);
     SecMsgDB db;
     if (!db.Open("cw")) {
@@ -3712,6 +4755,34 @@ int CSMSG::ClearBestBlock()
     return SMSG_NO_ERROR;
 }
 
+void CSMSG::QueueNotification(const uint8_t *pHeader, const uint160 &hash, int64_t time_received)
+{
+    SecMsgNotification item;
+    item.timeReceived = time_received;
+    item.hash = hash;
+    item.vchHeader.assign(pHeader, pHeader + SMSG_HDR_LEN);
+
+    LOCK(cs_notify);
+    if (m_notify_queue.size() >= SMSG_NOTIFY_QUEUE_SIZE) {
+        // Consumers can catch up with smsgzmqpush from the cursor
+        m_notify_dropped++;
+        return;
+    }
+    m_notify_queue.push_back(std::move(item));
+    m_notify_cv.notify_one();
+}
+
+bool CSMSG::QueueReplay(std::deque<SecMsgNotification> &&items)
+{
+    LOCK(cs_notify);
+    if (!m_notify_replay.empty()) {
+        return false;
+    }
+    m_notify_replay = std::move(items);
+    m_notify_cv.notify_one();
+    return true;
+}
+
 int CSMSG::Validate(const SecureMessage *psmsg, const uint8_t *pPayload, uint32_t nPayload)
 {
     if (psmsg->IsPaidVersion()) {
@@ -3801,56 +4872,82 @@ int CSMSG::Validate(const SecureMessage *psmsg, const uint8_t *pPayload, uint32_
 
 /** Proof of work and checksum
   * May run in a thread, if shutdown detected, return.
+  * The nonce space is interleaved over m_pow_threads threads, the first to find a valid hash stops the others.
   */
 int CSMSG::SetHash(SecureMessage *psmsg, uint8_t *pPayload, uint32_t nPayload)
 {
-    int64_t nStart = GetTimeMillis();
-    uint8_t civ[32];
+    int64_t nStart = GetTimeMicros();
 
-    bool found = false;
+    std::atomic<bool> found{false};
+    std::atomic<uint64_t> num_hashes{0};
 
-    uint32_t nonce = 0;
-    memcpy(&nonce, &psmsg->nonce[0], 4);
+    uint32_t nonce_start = 0;
+    memcpy(&nonce_start, &psmsg->nonce[0], 4);
+    nonce_start = le32toh(nonce_start);
 
-    uint256 msg_hash;
+    uint32_t nonce_found = 0;
+    uint256 hash_found;
     arith_uint256 target_difficulty;
     {
     LOCK(cs_main);
     target_difficulty.SetCompact(particl::GetSmsgDifficulty(*m_node->chainman, psmsg->timestamp));
     }
 
-    unsigned char header_buffer[SMSG_HDR_LEN];
-    psmsg->WriteHeader(header_buffer);
+    unsigned char header_template[SMSG_HDR_LEN];
+    psmsg->WriteHeader(header_template);
 
-    // Break for HMAC_CTX_cleanup
-    for (;;) {
-        if (!fSecMsgEnabled) {
-           break;
-        }
-        uint32_t tmp_le = htole32(nonce);
-        memcpy(psmsg->nonce, &tmp_le, 4);
-        memcpy(header_buffer + 4, &tmp_le, 4);
+    const int num_threads = m_pow_threads;
+    Mutex cs_found;
+    auto search = [&](int thread_index) {
+        uint8_t civ[32];
+        unsigned char header_buffer[SMSG_HDR_LEN];
+        memcpy(header_buffer, header_template, SMSG_HDR_LEN);
 
-        for (int i = 0; i < 32; i+=4) {
-            memcpy(civ+i, psmsg->nonce, 4);
-        }
+        uint256 msg_hash;
+        uint64_t n = 0;
+        for (uint64_t nonce = (uint64_t)nonce_start + thread_index; nonce <= 0xFFFFFFFFU; nonce += num_threads, ++n) {
+            if (!fSecMsgEnabled || found) {
+                break;
+            }
+            uint32_t tmp_le = htole32((uint32_t)nonce);
+            memcpy(header_buffer + 4, &tmp_le, 4);
 
-        CHMAC_SHA256 ctx(&civ[0], 32);
-        ctx.Write((uint8_t*) header_buffer+4, SMSG_HDR_LEN-4);
-        ctx.Write((uint8_t*) pPayload, nPayload);
-        ctx.Finalize(msg_hash.begin());
+            for (int i = 0; i < 32; i+=4) {
+                memcpy(civ+i, &tmp_le, 4);
+            }
 
-        if (UintToArith256(msg_hash) <= target_difficulty) {
-            found = true;
-            break;
+            CHMAC_SHA256 ctx(&civ[0], 32);
+            ctx.Write((uint8_t*) header_buffer+4, SMSG_HDR_LEN-4);
+            ctx.Write((uint8_t*) pPayload, nPayload);
+            ctx.Finalize(msg_hash.begin());
+
+            if (UintToArith256(msg_hash) <= target_difficulty) {
+                LOCK(cs_found);
+                if (!found) {
+                    found = true;
+                    nonce_found = nonce;
+                    hash_found = msg_hash;
+                }
+                break;
+            }
         }
+        num_hashes += n;
+    };
 
-        if (nonce >= 0xFFFFFFFFU) {
-            LogPrint(BCLog::SMSG, "No match %u\n", nonce);
-            break;
-        }
-        nonce++;
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; ++i) {
+        threads.emplace_back([&search, i]() {
+            util::ThreadRename(strprintf("smsg-pow.%i", i));
+            search(i);
+        });
     }
+    search(0);
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    int64_t nTook = GetTimeMicros() - nStart;
+    m_pow_hashes += num_hashes;
 
     if (!fSecMsgEnabled) {
         LogPrint(BCLog::SMSG, "%s: Stopped, shutdown detected.\n", __func__);
@@ -3858,17 +4955,52 @@ int CSMSG::SetHash(SecureMessage *psmsg, uint8_t *pPayload, uint32_t nPayload)
     }
 
     if (!found) {
-        LogPrint(BCLog::SMSG, "%s: Failed, took %d ms, nonce %u\n", __func__, GetTimeMillis() - nStart, nonce);
+        LogPrint(BCLog::SMSG, "%s: Failed, took %d ms, %u hashes\n", __func__, nTook / 1000, num_hashes);
         return SMSG_GENERAL_ERROR;
     }
 
-    memcpy(psmsg->hash, msg_hash.begin(), 4);
+    uint32_t tmp_le = htole32(nonce_found);
+    memcpy(psmsg->nonce, &tmp_le, 4);
+    memcpy(psmsg->hash, hash_found.begin(), 4);
+    m_pow_messages++;
+    m_pow_us += nTook;
 
-    LogPrint(BCLog::SMSG, "%s: Took %d ms, nonce %u\n", __func__, GetTimeMillis() - nStart, nonce);
+    LogPrint(BCLog::SMSG, "%s: Took %d ms, nonce %u, %d threads\n", __func__, nTook / 1000, nonce_found, num_threads);
 
     return SMSG_NO_ERROR;
 };
 
+size_t CSMSG::CountQueued()
+{
+    LOCK(cs_smsgDB);
+    SecMsgDB db;
+    if (!db.Open("cr")) {
+        return 0;
+    }
+
+    size_t num_queued = 0;
+    uint8_t chKey[30];
+    leveldb::Iterator *it = db.pdb->NewIterator(leveldb::ReadOptions());
+    while (db.NextSmesgKey(it, DBK_QUEUED, chKey)) {
+        num_queued++;
+    }
+    delete it;
+    return num_queued;
+};
+
+void CSMSG::GetMemoryUsage(std::map<std::string, size_t> &usage)
+{
+    LOCK(cs_smsg);
+    size_t tokens = 0;
+    for (const auto &it : buckets) {
+        tokens += it.second.setTokens.DynamicMemoryUsage();
+    }
+    usage["buckets"] = memusage::DynamicUsage(buckets);
+    usage["tokens"] = tokens;
+    usage["purged"] = memusage::DynamicUsage(setPurged) + memusage::DynamicUsage(setPurgedTimestamps);
+    usage["addresses"] = memusage::DynamicUsage(addresses);
+};
+
 /** Create a secure message
   *
   * Using a similar method to bitmessage.
@@ -3878,7 +5010,7 @@ int CSMSG::SetHash(SecureMessage *psmsg, uint8_t *pPayload, uint32_t nPayload)
   * Some differences:
   * bitmessage uses curve sect283r1 this uses secp256k1
   */
-int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID &addressTo, const std::string &message)
+int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID &addressTo, const std::string &message, uint8_t dict_id)
 {
     bool fSendAnonymous = addressFrom.IsNull();
 
@@ -3916,9 +5048,10 @@ int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID
     // Generate 16 random bytes as IV.
     GetStrongRandBytes2(&smsg.iv[0], 16);
 
-    // Generate a new random EC key pair with private key called r and public key called R.
+    // Take a new random EC key pair with private key called r and public key called R.
     CKey keyR;
-    keyR.MakeNewKey(true); // make compressed key
+    CPubKey cpkR;
+    GetEphemeralKey(keyR, cpkR); // compressed key
 
     //uint256 P = keyR.ECDH(cpkDestK);
     secp256k1_pubkey pubkey;
@@ -3931,7 +5064,6 @@ int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID
         return errorN(SMSG_GENERAL_ERROR, "%s: secp256k1_ecdh failed.", __func__);
     }
 
-    CPubKey cpkR = keyR.GetPubKey();
     if (!cpkR.IsValid()) {
         return errorN(SMSG_GENERAL_ERROR, "%s: Could not get public key for key R.", __func__);
     }
@@ -3946,11 +5078,20 @@ int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID
     std::vector<uint8_t> key_e(&vchHashed[0], &vchHashed[0]+32);
     std::vector<uint8_t> key_m(&vchHashed[32], &vchHashed[32]+32);
 
-    std::vector<uint8_t> vchPayload, vchCompressed;
+    std::vector<uint8_t> vchPayload, vchCompressed, vchCompressedDict;
     uint8_t *pMsgData;
     uint32_t lenMsgData;
 
     uint32_t lenMsg = message.size();
+    if (dict_id != SMSG_DICT_NONE) {
+        // Small messages are compressed too when using a dictionary
+        if (!IsKnownDict(dict_id)) {
+            return errorN(SMSG_COMPRESS_FAILED, "%s: Unknown compression dictionary %d.", __func__, dict_id);
+        }
+        if (!CompressWithDict(dict_id, (const uint8_t*)message.data(), lenMsg, vchCompressedDict)) {
+            return errorN(SMSG_COMPRESS_FAILED, "%s: Could not compress message data.", __func__);
+        }
+    }
     if (lenMsg > 128) {
         // Only compress if over 128 bytes
         int worstCase = LZ4_compressBound(message.size());
@@ -3970,6 +5111,14 @@ int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID
         pMsgData = (uint8_t*)message.c_str();
         lenMsgData = lenMsg;
     }
+    if (dict_id != SMSG_DICT_NONE) {
+        if (vchCompressedDict.size() < lenMsgData) {
+            pMsgData = vchCompressedDict.data();
+            lenMsgData = vchCompressedDict.size();
+        } else {
+            dict_id = SMSG_DICT_NONE;
+        }
+    }
 
     if (fSendAnonymous) {
         try { vchPayload.resize(9 + lenMsgData); } catch (std::exception &e) {
@@ -3980,7 +5129,7 @@ int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID
 
         vchPayload[0] = 250; // id as anonymous message
         // Next 4 bytes are unused - there to ensure encrypted payload always > 8 bytes
-        memput_uint32_le(&vchPayload[5], lenMsg);  // Length of uncompressed plain text
+        memput_uint32_le(&vchPayload[5], PackPlainLength(lenMsg, dict_id));  // Length of uncompressed plain text
     } else {
         try { vchPayload.resize(SMSG_PL_HDR_LEN + lenMsgData); } catch (std::exception &e) {
             return errorN(SMSG_ALLOCATE_FAILED, "%s: vchPayload.resize %u threw: %s.", __func__, SMSG_PL_HDR_LEN + lenMsgData, e.what());
@@ -4002,7 +5151,7 @@ int CSMSG::Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID
         memcpy(&vchPayload[1], ckidFrom.begin(), 20); // memcpy(&vchPayload[1], ckidDest.pn, 20);
 
         memcpy(&vchPayload[1+20], &vchSignature[0], vchSignature.size());
-        memput_uint32_le(&vchPayload[1+20+65], lenMsg); // Length of uncompressed plain text
+        memput_uint32_le(&vchPayload[1+20+65], PackPlainLength(lenMsg, dict_id)); // Length of uncompressed plain text
     }
 
     SecMsgCrypter crypter;
@@ -4094,7 +5243,7 @@ int CSMSG::Import(SecureMessage *psmsg, std::string &sError, bool setread, bool
 int CSMSG::Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
     SecureMessage &smsg, std::string &sError, bool fPaid,
     size_t nRetention, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fFromFile, bool submit_msg, bool add_to_outbox,
-    bool fund_from_rct, size_t nRingSize, wallet::CCoinControl *coin_control, bool fund_paid_msg)
+    bool fund_from_rct, size_t nRingSize, wallet::CCoinControl *coin_control, bool fund_paid_msg, uint8_t dict_id)
 {
     bool fSendAnonymous = (addressFrom.IsNull());
 
@@ -4152,7 +5301,7 @@ int CSMSG::Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
 
     int rv;
     smsg = SecureMessage(fPaid, nRetention);
-    if ((rv = Encrypt(smsg, addressFrom, addressTo, sData)) != 0) {
+    if ((rv = Encrypt(smsg, addressFrom, addressTo, sData, dict_id)) != 0) {
         sError = GetString(rv);
         return errorN(rv, "%s: %s.", __func__, sError);
     }
@@ -4222,7 +5371,7 @@ int CSMSG::Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
 
         SecureMessage smsgForOutbox(fPaid, nRetention);
         smsgForOutbox.timestamp = smsg.timestamp;
-        if ((rv = Encrypt(smsgForOutbox, addressFrom, addressOutbox, sData)) != 0) {
+        if ((rv = Encrypt(smsgForOutbox, addressFrom, addressOutbox, sData, dict_id)) != 0) {
             LogPrintf("%s: Encrypt for outbox failed, %d.\n", __func__, rv);
         } else {
             if (fPaid) {
@@ -4433,6 +5582,161 @@ int CSMSG::FundMsgs(std::vector<SecureMessage*> v_smsgs, std::string &sError, bo
     return SMSG_NO_ERROR;
 };
 
+int CSMSG::FundStashedMsgs(const std::vector<std::vector<uint8_t> > &msgids, std::string &sError, bool fTestFee, CAmount *nFee, size_t *nTxBytes,
+    bool fund_from_rct, size_t nRingSize, wallet::CCoinControl *coin_control, uint256 &txid)
+{
+    if (msgids.empty()) {
+        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Must specify one or more message ids");
+    }
+    if (msgids.size() > SMSG_MAX_FUND_BATCH) {
+        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Too many messages, max %d", SMSG_MAX_FUND_BATCH);
+    }
+
+    std::vector<SecureMessage> v_smsgs(msgids.size());
+    std::vector<SecureMessage*> v_psmsgs(msgids.size());
+    std::vector<CKeyID> v_msg_addr_to(msgids.size());
+    {
+        LOCK(cs_smsgDB);
+        SecMsgDB dbMsg;
+        if (!dbMsg.Open("cr+")) {
+            return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Could not open DB");
+        }
+        for (size_t k = 0; k < msgids.size(); ++k) {
+            if (msgids[k].size() != 28) {
+                return errorN(SMSG_UNKNOWN_MESSAGE, sError, __func__, "msgid must be 28 bytes");
+            }
+            uint8_t chKey[30];
+            memcpy(chKey, DBK_STASHED.data(), 2);
+            memcpy(chKey + 2, msgids[k].data(), 28);
+            SecMsgStored smsgStored;
+            if (!dbMsg.ReadSmesg(chKey, smsgStored)) {
+                return errorN(SMSG_UNKNOWN_MESSAGE, sError, __func__, "Unknown message id '%s'", HexStr(msgids[k]));
+            }
+            auto &smsg = v_smsgs[k];
+            smsg = SecureMessage(smsgStored.vchMessage.data());
+            if (!smsg.IsPaidVersion()) {
+                return errorN(SMSG_UNKNOWN_MESSAGE, sError, __func__, "Non-paid message id '%s'", HexStr(msgids[k]));
+            }
+            try { smsg.pPayload = new uint8_t[smsg.nPayload]; } catch (std::exception &e) {
+                return errorN(SMSG_ALLOCATE_FAILED, sError, __func__, "Could not allocate payload %s", e.what());
+            }
+            memcpy(smsg.pPayload, &smsgStored.vchMessage[SMSG_HDR_LEN], smsg.nPayload);
+            v_msg_addr_to[k] = smsgStored.addrTo;
+            v_psmsgs[k] = &smsg;
+        }
+    }
+
+    int rv;
+    if (0 != (rv = FundMsgs(v_psmsgs, sError, fTestFee, nFee, nTxBytes, fund_from_rct, nRingSize, coin_control))) {
+        return rv;
+    }
+    if (fTestFee) {
+        return SMSG_NO_ERROR;
+    }
+    v_psmsgs[0]->GetFundingTxid(txid);
+
+    for (size_t k = 0; k < v_psmsgs.size(); ++k) {
+        const SecureMessage &smsg = *v_psmsgs[k];
+        std::string submit_error;
+        if (0 != SubmitMsg(smsg, v_msg_addr_to[k], false, submit_error)) {
+            LogPrintf("SubmitMsg failed: %s.\n", HexStr(msgids[k]));
+            continue;
+        }
+        // Erase from stash
+        LOCK(cs_smsgDB);
+        SecMsgDB dbMsg;
+        if (!dbMsg.Open("cr+")) {
+            return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Could not open DB");
+        }
+        uint8_t chKey[30];
+        memcpy(chKey, DBK_STASHED.data(), 2);
+        memcpy(chKey + 2, msgids[k].data(), 28);
+        dbMsg.EraseSmesg(chKey);
+    }
+    return SMSG_NO_ERROR;
+};
+
+int64_t CSMSG::QueueFunding(const std::vector<uint8_t> &msgid, bool fund_from_rct, size_t nRingSize)
+{
+    int64_t now = GetTime();
+    LOCK(cs_fund_queue);
+    auto &group = m_fund_queue[{fund_from_rct, fund_from_rct ? nRingSize : 0}];
+    SecMsgFundItem item;
+    item.msgid = msgid;
+    item.time_queued = now;
+    group.push_back(std::move(item));
+    m_fund_cv.notify_all();
+    if (group.size() >= m_fund_batch_size) {
+        return now;
+    }
+    return group.front().time_queued + m_fund_batch_window;
+};
+
+int64_t CSMSG::TakeFundBatches(int64_t now, std::vector<std::pair<SecMsgFundKey, std::vector<SecMsgFundItem> > > &batches)
+{
+    int64_t next_due = 0;
+    for (auto it = m_fund_queue.begin(); it != m_fund_queue.end();) {
+        auto &group = it->second;
+        while (!group.empty() &&
+               (group.size() >= m_fund_batch_size || group.front().time_queued + m_fund_batch_window <= now)) {
+            size_t n = std::min<size_t>(group.size(), m_fund_batch_size);
+            batches.emplace_back(it->first, std::vector<SecMsgFundItem>(group.begin(), group.begin() + n));
+            group.erase(group.begin(), group.begin() + n);
+        }
+        if (group.empty()) {
+            it = m_fund_queue.erase(it);
+            continue;
+        }
+        int64_t due = group.front().time_queued + m_fund_batch_window;
+        next_due = next_due == 0 ? due : std::min(next_due, due);
+        ++it;
+    }
+    return next_due;
+};
+
+void CSMSG::FundBatch(const SecMsgFundKey &key, const std::vector<SecMsgFundItem> &batch)
+{
+    std::vector<std::vector<uint8_t> > msgids;
+    for (const auto &item : batch) {
+        msgids.push_back(item.msgid);
+    }
+    uint256 txid;
+    std::string sError;
+#ifdef ENABLE_WALLET
+    wallet::CCoinControl cctl;
+    CAmount fee = 0;
+    size_t tx_bytes = 0;
+    if (0 != FundStashedMsgs(msgids, sError, false, &fee, &tx_bytes, key.first, key.second, &cctl, txid)) {
+        LogPrintf("%s: Funding %d queued messages failed: %s\n", __func__, msgids.size(), sError);
+        txid.SetNull();
+    } else {
+        LogPrint(BCLog::SMSG, "%s: Funded %d queued messages in %s, fee %d.\n", __func__, msgids.size(), txid.ToString(), fee);
+    }
+#else
+    sError = "Wallet is disabled.";
+#endif
+
+    int64_t now = GetTime();
+    {
+        LOCK(cs_fund_queue);
+        for (const auto &msgid : msgids) {
+            SecMsgFundResult result;
+            result.msgid = msgid;
+            result.txid = txid;
+            result.time = now;
+            result.batch_size = msgids.size();
+            result.error = txid.IsNull() ? sError : "";
+            m_fund_results.push_back(std::move(result));
+        }
+        while (m_fund_results.size() > SMSG_FUND_RESULTS_SIZE) {
+            m_fund_results.pop_front();
+        }
+    }
+    if (!txid.IsNull()) {
+        GetMainSignals().SecureMessagesFunded(txid, msgids);
+    }
+};
+
 int CSMSG::SubmitMsg(const SecureMessage &smsg, const CKeyID &addressTo, bool stash, std::string &sError) {
     bool fPaid = smsg.IsPaidVersion();
 
@@ -4468,6 +5772,9 @@ int CSMSG::SubmitMsg(const SecureMessage &smsg, const CKeyID &addressTo, bool st
             //NotifySecMsgSendQueueChanged(smsgOutbox);
         }
     }
+    if (!stash) {
+        NotifyOutbox();
+    }
 
     if (LogAcceptCategory(BCLog::SMSG, BCLog::Level::Debug)) {
         if (stash) {
@@ -4575,6 +5882,7 @@ int CSMSG::Decrypt(bool fTestOnly, const CKey &keyDest, const CKeyID &address, c
 
     msg.timestamp = smsg.timestamp;
     uint32_t lenData, lenPlain;
+    uint8_t dict_id;
 
     uint8_t *pMsgData;
     bool fFromAnonymous;
@@ -4590,12 +5898,23 @@ int CSMSG::Decrypt(bool fTestOnly, const CKey &keyDest, const CKeyID &address, c
         pMsgData = &vchPayload[SMSG_PL_HDR_LEN];
     }
 
+    dict_id = UnpackDictId(lenPlain);
+    lenPlain = UnpackPlainLength(lenPlain);
+    if (dict_id != SMSG_DICT_NONE && !IsKnownDict(dict_id)) {
+        return errorN(SMSG_GENERAL_ERROR, "%s: Unknown compression dictionary %d.", __func__, dict_id);
+    }
+
     try {
         msg.vchMessage.resize(lenPlain + 1);
     } catch (std::exception &e) {
         return errorN(SMSG_ALLOCATE_FAILED, "%s: msg.vchMessage.resize %u threw: %s.", __func__, lenPlain + 1, e.what());
     }
 
+    if (dict_id != SMSG_DICT_NONE) {
+        if (!DecompressWithDict(dict_id, pMsgData, lenData, &msg.vchMessage[0], lenPlain)) {
+            return errorN(SMSG_GENERAL_ERROR, "%s: Could not decompress message data.", __func__);
+        }
+    } else
     if (lenPlain > 128) {
         // Decompress
         if (LZ4_decompress_safe((char*) pMsgData, (char*) &msg.vchMessage[0], lenData, lenPlain) != (int) lenPlain) {
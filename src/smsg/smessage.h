@@ -10,16 +10,24 @@
 #include <threadinterrupt.h>
 #include <key_io.h>
 #include <serialize.h>
+#include <consensus/consensus.h>
 #include <lz4/lz4.h>
 #include <smsg/keystore.h>
 #include <interfaces/handler.h>
 #include <interfaces/node.h>
 #include <util/ui_change_type.h>
+#include <smsg/bucketfile.h>
+#include <smsg/compress.h>
 #include <smsg/db.h>
 #include <smsg/types.h>
+#include <lrucache.h>
+#include <util/hasher.h>
 
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <queue>
 #include <boost/signals2/signal.hpp>
 
 class UniValue;
@@ -31,13 +39,18 @@ class CCoinControl;
 class CNode;
 class PeerManager;
 class ArgsManager;
+class Minisketch;
+class CBlockIndex;
+class CScheduler;
 typedef int64_t NodeId;
 
 extern RecursiveMutex cs_main;
 
 namespace smsg {
 
-const int SMSG_VERSION = 1;
+const int SMSG_VERSION = 3;
+const int SMSG_VERSION_SKETCH = 2;      // Peers from this version reconcile buckets with minisketches
+const int SMSG_VERSION_TOKEN_HASH = 3;  // Peers from this version send order independent bucket hashes
 
 enum SecureMessageCodes {
     SMSG_NO_ERROR = 0,
@@ -90,12 +103,33 @@ extern uint32_t SMSG_RETENTION;
 const uint32_t SMSG_FREE_MSG_DAYS  = 2;
 
 const uint32_t SMSG_SEND_DELAY     = 2;                 // seconds, SecureMsgSendData will delay this long between firing
-const uint32_t SMSG_THREAD_DELAY   = 30;
+const uint32_t SMSG_THREAD_DELAY   = 30;                // seconds between housekeeping ticks
+const uint32_t SMSG_BUCKET_LOCK_TIMEOUT = 3 * SMSG_THREAD_DELAY; // seconds a bucket stays locked for a peer sent smsgWant
 
 const uint32_t SMSG_TIME_LEEWAY    = 24;
 const uint32_t SMSG_TIME_IGNORE    = 90;                // seconds a peer is ignored for if they fail to deliver messages for a smsgWant
 const uint32_t SMSG_DEFAULT_BANTIME = 8 * 60 * 60;
 const uint32_t SMSG_DEFAULT_MAXRCV = 4000;
+const uint32_t SMSG_DEFAULT_PEER_BYTES_RATE = 1024 * 1024; // bytes per second, per peer
+const uint32_t SMSG_DEFAULT_PEER_MSGS_RATE = 200;          // secure messages validated per second, per peer
+const int SMSG_DEFAULT_POW_THREADS = 1;
+const int SMSG_MAX_POW_THREADS = 16;
+const int SMSG_DEFAULT_RECEIVE_THREADS = 2;
+const int SMSG_MAX_RECEIVE_THREADS = 16;
+const size_t SMSG_RECEIVE_QUEUE_BYTES = 64 * 1024 * 1024; // received bunches waiting for validation, over all peers
+const uint32_t SMSG_RECEIVE_QUEUE_PEER = 4;               // bunches waiting for validation, per peer
+const size_t SMSG_FUNDING_CACHE_SIZE = 4096;       // txns
+const size_t SMSG_MAX_FUND_BATCH = (MAX_DATA_OUTPUT_SIZE - 1) / 24; // paid messages funded by one txn
+const uint32_t SMSG_DEFAULT_FUND_BATCH_SIZE = 16;  // queued paid messages funded together when the batch fills
+const int64_t SMSG_DEFAULT_FUND_BATCH_WINDOW = 10; // seconds, max time a queued paid message waits for the batch to fill
+const size_t SMSG_FUND_RESULTS_SIZE = 1000;        // outcomes of queued funding kept for smsgfundqueue
+const size_t SMSG_PUBKEY_CACHE_SIZE = 4096;        // keys read from the address db for sending
+const size_t SMSG_NOTIFY_QUEUE_SIZE = 10000;        // new message notifications waiting to be published
+const size_t SMSG_NOTIFY_BATCH_SIZE = 100;
+const uint32_t SMSG_DEFAULT_COMPACT_PERCENT = 50;   // rewrite bucket files when this share of the file is expired or purged payloads
+const int64_t SMSG_COMPACT_INTERVAL = 3600;         // seconds
+const size_t SMSG_MAX_BUCKET_WRITERS = 8;           // bucket files kept open for appending
+const size_t SMSG_BUCKET_WRITE_BUFFER = 64 * 1024;  // bytes buffered per open bucket file
 
 const uint32_t SMSG_MAX_MSG_BYTES  = 24000;             // the user input part
 const uint32_t SMSG_MAX_AMSG_BYTES = 512;               // the user input part (ANON)
@@ -233,6 +267,31 @@ public:
     std::vector<uint8_t>  vchMessage; // null terminated plaintext
 };
 
+/** Receiving key resolved ahead of scanning a set of messages */
+class SecMsgScanKey
+{
+public:
+    SecMsgScanKey(const CKey &key_, const CKeyID &address_, bool fReceiveAnon_)
+        : key(key_), address(address_), fReceiveAnon(fReceiveAnon_) {};
+
+    CKey key;
+    CKeyID address;
+    bool fReceiveAnon;
+};
+
+/** Stored message queued for trial decryption */
+class SecMsgScanItem
+{
+public:
+    SecMsgScanItem(const uint8_t *pHeader_, const uint8_t *pPayload_, uint32_t nPayload_)
+        : pHeader(pHeader_), pPayload(pPayload_), nPayload(nPayload_) {};
+
+    const uint8_t *pHeader;
+    const uint8_t *pPayload;
+    uint32_t nPayload;
+    int nKey = -1;          // index of the first key the MAC matched
+};
+
 class SecMsgToken
 {
 public:
@@ -248,6 +307,7 @@ public:
         }
         offset = o;
         ttl = ttl_;
+        m_payload_size = np;
     };
 
     bool operator <(const SecMsgToken &y) const
@@ -262,9 +322,11 @@ public:
 
     int64_t timestamp;
     uint8_t sample[8];      // first 8 bytes of payload
-    int64_t offset;         // offset in file
+    mutable int64_t offset; // offset in file, changed when the file is compacted
     int m_changed = 0;      // time changed relative to timestamp
     mutable uint32_t ttl;   // seconds
+    mutable uint32_t m_payload_size = 0; // nPayload of the record in the file
+    bool m_paid = false;    // Paid message, counted separately by the bucket
 };
 
 class SecMsgPurged // Purged token marker
@@ -306,6 +368,42 @@ public:
     int64_t timepurged;
 };
 
+/** Tokens of a bucket kept sorted in a vector.
+ *  Insertion appends when the token sorts last, tokens loaded with append() are merged in by merge().
+ */
+class SecMsgTokenSet
+{
+public:
+    typedef std::vector<SecMsgToken>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    const_iterator begin() const { return m_tokens.begin(); }
+    const_iterator end() const { return m_tokens.end(); }
+    size_t size() const { return m_tokens.size(); }
+    bool empty() const { return m_tokens.empty(); }
+    void clear()
+    {
+        m_tokens.clear();
+        m_num_sorted = 0;
+    }
+
+    std::pair<const_iterator, bool> insert(const SecMsgToken &token);
+    /** Add a token without sorting, merge() must be called before the set is used */
+    void append(const SecMsgToken &token) { m_tokens.push_back(token); }
+    /** Sort appended tokens into the set, duplicates are dropped */
+    void merge();
+
+    const_iterator find(const SecMsgToken &token) const;
+    /** Range of tokens with timestamp */
+    std::pair<const_iterator, const_iterator> equal_range(int64_t timestamp) const;
+
+    size_t DynamicMemoryUsage() const;
+
+private:
+    std::vector<SecMsgToken> m_tokens;
+    size_t m_num_sorted = 0;
+};
+
 class SecMsgBucket
 {
 public:
@@ -313,25 +411,52 @@ public:
     {
         timeChanged     = 0;
         hash            = 0;
-        nLeastTTL       = 0;
         nActive         = 0;
         nLockCount      = 0;
         nLockPeerId     = -1;
     };
 
+    /** Recompute the hash and counts from all tokens */
     void hashBucket(int64_t bucket_time);
-    size_t CountActive() const;
+    /** Add a token and update the hash, returns false if the bucket already has it */
+    bool AddToken(const SecMsgToken &token, int64_t now);
+    /** Set ttl of a stored token to 0 and remove it from the hash */
+    void ExpireToken(const SecMsgToken &token, int64_t now);
+    /** Update timeChanged if the hash changed since last called */
+    void MarkChanged(int64_t bucket_time);
+    /** Hash in the format used by peers at version */
+    uint32_t GetHash(int version) const;
+    /** Active messages, kept as tokens are added and expired. Tokens past their ttl are dropped by hashBucket at m_next_expiry */
+    size_t CountActive() const { return nActive; }
+    /** Payload bytes of expired and purged tokens a compaction would drop */
+    uint64_t CountDeadBytes(int64_t now) const;
 
     int64_t               timeChanged;
-    uint32_t              hash;           // token set should get ordered the same on each node
-    uint32_t              nLeastTTL;      // lowest ttl in seconds of messages in bucket
+    uint32_t              hash;           // sum of the hashes of active tokens, independent of order
     uint32_t              nActive;        // Number of untimedout messages in bucket
-    uint32_t              nLockCount;     // set when smsgWant first sent, unset at end of smsgMsg, ticks down in ThreadSecureMsg()
+    uint32_t              nLockCount;     // set when smsgWant first sent, unset at end of smsgMsg or at m_lock_timeout
     NodeId                nLockPeerId;    // id of peer that bucket is locked for
+    int64_t               m_next_expiry = 0;  // time the first active token expires, hashBucket is run after
+    int64_t               m_lock_timeout = 0; // time the lock is released if the peer sent no data
+    int64_t               m_expiry_queued = 0; // time of the queued expiry event, 0 if none
+    uint32_t              m_active_paid = 0;  // Number of active paid messages, included in nActive
+    uint64_t              m_active_bytes = 0; // Payload bytes of the active messages
 
-    std::set<SecMsgToken> setTokens;
+    SecMsgTokenSet setTokens;
+
+private:
+    void AddActive(const SecMsgToken &token);
+
+    uint32_t m_hash_changed = 0;            // hash when timeChanged was last set
+    mutable uint32_t m_hash_ordered = 0;    // hash over the active tokens in order, sent to peers before SMSG_VERSION_TOKEN_HASH
+    mutable bool m_hash_ordered_valid = false;
 };
 
+/** Short id of a token for reconciling bucket contents with minisketches */
+uint32_t GetTokenShortId(int64_t bucket_time, const SecMsgToken &token);
+/** Sketch of the unexpired tokens in a bucket, n_tokens is set to the number added */
+Minisketch MakeTokenSketch(int64_t bucket_time, const SecMsgTokenSet &tokens, size_t capacity, int64_t now, uint32_t &n_tokens);
+
 class SecMsgAddress
 {
 public:
@@ -420,6 +545,56 @@ public:
     };
 };
 
+/** Parsed funding data of a txn, cached by CheckFundingTx */
+class SecMsgFundingTx
+{
+public:
+    const CBlockIndex *pindex = nullptr;
+    std::vector<std::pair<uint160, uint32_t> > outputs; // msgid, amount
+};
+
+/** Bunch of received messages waiting to be validated and stored by the receive threads */
+class SecMsgReceiveItem
+{
+public:
+    CNode *pfrom = nullptr; // Referenced until the bunch is processed
+    PeerManager *peer_logic = nullptr;
+    int64_t bucket_time = 0;
+    uint32_t num_messages = 0;
+    std::vector<uint8_t> data;
+};
+
+/** Funding source of a queued paid message, fund_from_rct and ring size. Each batch is funded from one source */
+typedef std::pair<bool, size_t> SecMsgFundKey;
+
+/** Stashed paid message waiting to be funded with others by thread_smsg_fund */
+class SecMsgFundItem
+{
+public:
+    std::vector<uint8_t> msgid;
+    int64_t time_queued = 0;
+};
+
+/** Outcome of funding a queued paid message */
+class SecMsgFundResult
+{
+public:
+    std::vector<uint8_t> msgid;
+    uint256 txid; // Null if funding failed, the message is left stashed
+    int64_t time = 0;
+    size_t batch_size = 0;
+    std::string error;
+};
+
+/** Message waiting to be published to the NewSecureMessage listeners */
+class SecMsgNotification
+{
+public:
+    int64_t timeReceived = 0;
+    uint160 hash;
+    std::vector<uint8_t> vchHeader;
+};
+
 void AddOptions(ArgsManager& argsman);
 const char *GetString(size_t errorCode);
 
@@ -469,6 +644,14 @@ public:
     int WalletKeyChanged(CKeyID &keyId, const std::string &sLabel, ChangeType mode);
 
     int ScanMessage(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, bool reportToGui, bool &received_msg, bool unlocking=false);
+    /** Trial decrypt items across threads and store received messages to the inbox in batches */
+    int ScanMessages(std::vector<SecMsgScanItem> &items, bool unlocking, uint32_t &nFoundMessages) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+
+    void GetScanKeys(std::vector<SecMsgScanKey> &keys, bool &was_locked) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    /** Returns the index of the first key from nStart the message MAC matches, -1 if none */
+    int FindScanKey(const std::vector<SecMsgScanKey> &keys, size_t nStart, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload);
+    bool ResolveScanKey(const std::vector<SecMsgScanKey> &keys, int nKey, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, CKeyID &addressTo);
+    int StoreInbox(const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, const CKeyID &addressTo, bool reportToGui, SecMsgDB *pdb);
 
     int GetStoredKey(const CKeyID &ckid, CPubKey &cpkOut);
     int GetLocalKey(const CKeyID &ckid, CPubKey &cpkOut);
@@ -489,7 +672,15 @@ public:
     int Remove(const SecMsgToken &token) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
 
     int SmsgMisbehaving(CNode *pfrom, uint8_t n);
-    int Receive(PeerManager *peerLogic, CNode *pfrom, std::vector<uint8_t> &vchData);
+    /** Check the envelope of a bunch of messages and queue a copy for the receive threads */
+    int Receive(PeerManager *peerLogic, CNode *pfrom, Span<const uint8_t> vchData);
+    /** Validate and store a queued bunch, runs in the receive threads */
+    int ProcessBunch(PeerManager *peerLogic, CNode *pfrom, int64_t bktTime, uint32_t nBunch, Span<const uint8_t> vchData);
+    /** Release the lock on the bucket taken when its messages were requested */
+    void ReleaseBucketLock(int64_t bucket_time);
+    void StartReceiveThreads();
+    /** Join the receive threads and drop the queued bunches, must not be called with cs_smsg held */
+    void StopReceiveThreads();
 
     int CheckPurged(const SecureMessage *psmsg, const uint8_t *pPayload);
 
@@ -506,11 +697,20 @@ public:
     int Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
         SecureMessage &smsg, std::string &sError, bool fPaid, size_t nRetention,
         bool fTestFee=false, CAmount *nFee=nullptr, size_t *nTxBytes=nullptr, bool fFromFile=false, bool submit_msg=true, bool add_to_outbox=true,
-        bool fund_from_rct=false, size_t nRingSize=5, wallet::CCoinControl *coin_control=nullptr, bool fund_paid_msg=true);
+        bool fund_from_rct=false, size_t nRingSize=5, wallet::CCoinControl *coin_control=nullptr, bool fund_paid_msg=true, uint8_t dict_id=0);
 
     bool GetPowHash(const SecureMessage *psmsg, const uint8_t *pPayload, uint32_t nPayload, uint256 &hash);
     int HashMsg(const SecureMessage &smsg, const uint8_t *pPayload, uint32_t nPayload, uint160 &hash);
     int FundMsgs(std::vector<SecureMessage*> v_smsgs, std::string &sError, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fund_from_rct, size_t nRingSize, wallet::CCoinControl *coin_control);
+    /** Fund stashed messages in one txn and move them to the send queue, txid is set unless fTestFee */
+    int FundStashedMsgs(const std::vector<std::vector<uint8_t> > &msgids, std::string &sError, bool fTestFee, CAmount *nFee, size_t *nTxBytes,
+        bool fund_from_rct, size_t nRingSize, wallet::CCoinControl *coin_control, uint256 &txid);
+    /** Queue a stashed message to be funded by thread_smsg_fund, returns the time it is expected to be funded */
+    int64_t QueueFunding(const std::vector<uint8_t> &msgid, bool fund_from_rct, size_t nRingSize);
+    /** Remove the batches due at now from the funding queue, returns the time the next batch is due or 0 if the queue is empty */
+    int64_t TakeFundBatches(int64_t now, std::vector<std::pair<SecMsgFundKey, std::vector<SecMsgFundItem> > > &batches) EXCLUSIVE_LOCKS_REQUIRED(cs_fund_queue);
+    void FundBatch(const SecMsgFundKey &key, const std::vector<SecMsgFundItem> &batch);
+    void StopFundThread();
     /** Place message in send queue, proof of work will happen in a thread. */
     int SubmitMsg(const SecureMessage &smsg, const CKeyID &addressTo, bool stash, std::string &sError);
 
@@ -521,14 +721,48 @@ public:
     int CheckFundingTx(const Consensus::Params &consensus_params, const SecureMessage *psmsg, const uint8_t *pPayload);
     int PruneFundingTxData();
     int SetBestBlock(ChainSyncCache &cache, const uint256 &block_hash, int height, int64_t time);
+    /** Erase the funding rows listed in the block's undo record and move the best block back to prev.
+     *  Blocks synced before undo records were written only move the best block, their rows are pruned by height. */
+    int DisconnectBlock(ChainSyncCache &cache, const uint256 &block_hash, int height, int64_t time, const uint256 &prev_hash, int prev_height);
+    /** Write the cache unsynced, FlushChainSync syncs the blocks written since the last chainstate flush */
     int WriteCache(ChainSyncCache &cache);
+    int FlushChainSync();
     int ReadBestBlock(uint256 &block_hash, int &height);
     int ClearBestBlock();
 
+    /** Queue an expiry event for the bucket, when its first active token expires or it leaves the retention window */
+    void ScheduleBucketExpiry(int64_t bucket_time, SecMsgBucket &bucket, int64_t now) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    /** Lock the bucket for peer_id and queue the lock timeout event */
+    void LockBucket(int64_t bucket_time, SecMsgBucket &bucket, NodeId peer_id, int64_t now) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    /** Schedule bucket housekeeping to run at wake_time, unless an earlier run is already scheduled */
+    void ScheduleHousekeeping(int64_t wake_time, int64_t now) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    /** Expire buckets and release locks due at now, timed out locks are appended to timed_out_locks */
+    void ProcessBucketEvents(int64_t now, std::vector<std::pair<int64_t, NodeId> > &timed_out_locks) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    void RunBucketEvents(uint64_t epoch, int64_t wake_time);
+    void HousekeepingTick(uint64_t epoch);
+    void StartHousekeeping();
+    void StopHousekeeping();
+    /** Rewrite the bucket file, expired and purged records keep only their header and sample */
+    int CompactBucket(int64_t bucket_time, SecMsgBucket &bucket, int64_t now, uint64_t &reclaimed) EXCLUSIVE_LOCKS_REQUIRED(cs_smsg);
+    /** Compact buckets where at least min_dead_percent of the file can be dropped, returns the number of files rewritten */
+    size_t CompactBuckets(uint32_t min_dead_percent, uint64_t &reclaimed);
+    /** Wake the proof of work thread to process the outbox */
+    void NotifyOutbox();
+
+    /** Queue a new message notification, the notification is dropped if the queue is full */
+    void QueueNotification(const uint8_t *pHeader, const uint160 &hash, int64_t time_received);
+    /** Queue stored messages to be notified again, fails if a previous replay is still pending */
+    bool QueueReplay(std::deque<SecMsgNotification> &&items);
+
     int Validate(const SecureMessage *psmsg, const uint8_t *pPayload, uint32_t nPayload);
     int SetHash (SecureMessage *psmsg, uint8_t *pPayload, uint32_t nPayload);
+    /** Number of messages waiting for proof of work */
+    size_t CountQueued();
+    /** Memory held by the buckets, their tokens and the purged and address lists, by name */
+    void GetMemoryUsage(std::map<std::string, size_t> &usage);
 
-    int Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID &addressTo, const std::string &message);
+    /** dict_id selects a compression dictionary, see smsg/compress.h, falls back to plain LZ4 if that is smaller */
+    int Encrypt(SecureMessage &smsg, const CKeyID &addressFrom, const CKeyID &addressTo, const std::string &message, uint8_t dict_id = SMSG_DICT_NONE);
 
     int Decrypt(bool fTestOnly, const CKey &keyDest, const CKeyID &address, const uint8_t *pHeader, const uint8_t *pPayload, uint32_t nPayload, MessageData &msg);
     int Decrypt(bool fTestOnly, const CKey &keyDest, const CKeyID &address, const SecureMessage &smsg, MessageData &msg);
@@ -554,12 +788,85 @@ public:
     int64_t nLastProcessedPurged = 0;
     CAmount m_absurd_smsg_fee = 500 * COIN;
     uint16_t m_smsg_max_receive_count = SMSG_DEFAULT_MAXRCV;
+    uint32_t m_peer_bytes_rate = SMSG_DEFAULT_PEER_BYTES_RATE; // 0 is unlimited
+    uint32_t m_peer_msgs_rate = SMSG_DEFAULT_PEER_MSGS_RATE;   // 0 is unlimited
+    int m_pow_threads = SMSG_DEFAULT_POW_THREADS;
+    int m_receive_threads = SMSG_DEFAULT_RECEIVE_THREADS;
 
     std::map<int64_t, int64_t> m_show_requests;
 
+    // Bucket expiry and lock timeouts run as events on the node scheduler, ordered by time due
+    typedef std::pair<int64_t, int64_t> BucketEvent; // time due, bucket time
+    typedef std::priority_queue<BucketEvent, std::vector<BucketEvent>, std::greater<BucketEvent> > BucketEventQueue;
+    BucketEventQueue m_bucket_expiry_queue GUARDED_BY(cs_smsg);
+    BucketEventQueue m_bucket_lock_queue GUARDED_BY(cs_smsg);
+    CScheduler *m_housekeeping_scheduler GUARDED_BY(cs_smsg) = nullptr;
+    uint64_t m_housekeeping_epoch GUARDED_BY(cs_smsg) = 0; // Events from before the last restart are ignored
+    int64_t m_housekeeping_wake GUARDED_BY(cs_smsg) = 0;   // Earliest scheduled event, 0 if none
+    uint32_t m_housekeeping_ticks GUARDED_BY(cs_smsg) = 0;
+    int64_t m_last_pruned_funding_txns GUARDED_BY(cs_smsg) = 0;
+    int64_t m_last_compacted GUARDED_BY(cs_smsg) = 0;
+    uint32_t m_compact_percent = SMSG_DEFAULT_COMPACT_PERCENT; // 0 disables background compaction
+    uint64_t m_compacted_files GUARDED_BY(cs_smsg) = 0;
+    uint64_t m_compacted_bytes GUARDED_BY(cs_smsg) = 0;
+    BucketFileWriters m_bucket_writers{SMSG_MAX_BUCKET_WRITERS, SMSG_BUCKET_WRITE_BUFFER}; // Flushed every housekeeping tick
+
     CThreadInterrupt m_thread_interrupt;
-    std::thread thread_smsg;
     std::thread thread_smsg_pow;
+    std::thread thread_smsg_db;
+    std::thread thread_smsg_notify;
+    std::thread thread_smsg_fund;
+    std::vector<std::thread> threads_smsg_receive;
+
+    // Paid messages sent with batchfund wait stashed until thread_smsg_fund funds their batch, grouped by funding source
+    Mutex cs_fund_queue;
+    std::condition_variable m_fund_cv;
+    std::map<SecMsgFundKey, std::deque<SecMsgFundItem> > m_fund_queue GUARDED_BY(cs_fund_queue);
+    std::deque<SecMsgFundResult> m_fund_results GUARDED_BY(cs_fund_queue);
+    bool m_fund_stop GUARDED_BY(cs_fund_queue) = false;
+    uint32_t m_fund_batch_size = SMSG_DEFAULT_FUND_BATCH_SIZE;
+    int64_t m_fund_batch_window = SMSG_DEFAULT_FUND_BATCH_WINDOW;
+
+    // Received bunches are validated off the message handler thread, bounded by SMSG_RECEIVE_QUEUE_BYTES and SMSG_RECEIVE_QUEUE_PEER
+    Mutex cs_receive;
+    std::condition_variable m_receive_cv;
+    std::deque<SecMsgReceiveItem> m_receive_queue GUARDED_BY(cs_receive);
+    size_t m_receive_queue_bytes GUARDED_BY(cs_receive) = 0; // Includes the bunches being processed
+    bool m_receive_stop GUARDED_BY(cs_receive) = false;
+    uint64_t m_receive_processed GUARDED_BY(cs_receive) = 0;
+    uint64_t m_receive_dropped GUARDED_BY(cs_receive) = 0;
+
+    // Notifications are published in batches by thread_smsg_notify
+    Mutex cs_notify;
+    std::condition_variable m_notify_cv;
+    std::deque<SecMsgNotification> m_notify_queue GUARDED_BY(cs_notify);
+    std::deque<SecMsgNotification> m_notify_replay GUARDED_BY(cs_notify);
+    uint64_t m_notify_sent GUARDED_BY(cs_notify) = 0;
+    uint64_t m_notify_dropped GUARDED_BY(cs_notify) = 0;
+    int64_t m_notify_cursor_time GUARDED_BY(cs_notify) = 0; // Latest notified message, resume point for consumers
+    uint160 m_notify_cursor_hash GUARDED_BY(cs_notify);
+
+    // Trial decryption cost, totals over all scanned messages
+    std::atomic<uint64_t> m_trial_messages{0};
+    std::atomic<uint64_t> m_trial_keys{0};
+    std::atomic<uint64_t> m_trial_us{0};
+
+    // Proof of work for queued free messages
+    std::atomic<uint64_t> m_pow_messages{0};
+    std::atomic<uint64_t> m_pow_hashes{0};
+    std::atomic<uint64_t> m_pow_us{0};
+    std::atomic<int64_t> m_pow_current_start{0}; // Time in microseconds work on the current message started, 0 when idle
+    Mutex cs_outbox_wake;
+    std::condition_variable m_outbox_cv;
+    bool m_outbox_wake GUARDED_BY(cs_outbox_wake) = false;
+    std::atomic<bool> m_outbox_unfunded{false}; // Queued paid messages are waiting for their funding txn
+
+    Mutex cs_pubkey_cache;
+    LRUCache<CKeyID, CPubKey, SaltedSipHasher> m_pubkey_cache GUARDED_BY(cs_pubkey_cache) {SMSG_PUBKEY_CACHE_SIZE};
+
+    Mutex cs_funding_cache;
+    LRUCache<uint256, SecMsgFundingTx, SaltedTxidHasher> m_funding_cache GUARDED_BY(cs_funding_cache) {SMSG_FUNDING_CACHE_SIZE};
+    int m_funding_cache_height GUARDED_BY(cs_funding_cache) = -1; // Height of the last block passed to SetBestBlock
 
     bool m_track_funding_txns{false};
     leveldb::WriteBatch *m_connect_block_batch{nullptr};
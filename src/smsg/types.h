@@ -5,8 +5,12 @@
 #ifndef PARTICL_SMSG_TYPES_H
 #define PARTICL_SMSG_TYPES_H
 
+#include <uint256.h>
+
 #include <leveldb/write_batch.h>
 
+#include <vector>
+
 namespace smsg {
 
 const int32_t ACCEPT_FUNDING_TX_DEPTH = 1;
@@ -15,16 +19,19 @@ const int64_t PRUNE_FUNDING_TX_DATA = 3600;
 
 static const int MIN_SMSG_PROTO_VERSION = 90010;
 
+/** The smsg funding rows of one connected or disconnected block, carried in the block's CCoinsViewCache */
 class ChainSyncCache
 {
 public:
     void Clear() {
         m_skip = false;
         m_connect_block_batch.Clear();
+        m_funded_txids.clear();
     }
 
     bool m_skip = false;  // Don't commit if data is expired
     leveldb::WriteBatch m_connect_block_batch;
+    std::vector<uint256> m_funded_txids; // Written as the block's undo record by SetBestBlock
 };
 
 } // namespace smsg
@@ -0,0 +1,109 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <spentcoincache.h>
+
+#include <memusage.h>
+
+#include <algorithm>
+
+CSpentCoinCache::CSpentCoinCache(size_t max_blocks)
+    : m_slots(std::max<size_t>(1, max_blocks))
+{
+}
+
+void CSpentCoinCache::ClearSlot(Slot &slot)
+{
+    AssertLockHeld(m_mutex);
+    for (const auto &outpoint : slot.outpoints) {
+        // The coin may have been spent again at another height after a reorg
+        auto mi = m_coins.find(outpoint);
+        if (mi != m_coins.end() && (int)mi->second.spent_height == slot.height) {
+            m_coins.erase(mi);
+        }
+    }
+    slot.height = -1;
+    slot.outpoints.clear();
+}
+
+void CSpentCoinCache::AddBlock(int height, const std::vector<std::pair<COutPoint, SpentCoin> > &coins)
+{
+    if (height < 0) {
+        return;
+    }
+    LOCK(m_mutex);
+    Slot &slot = m_slots[(size_t)height % m_slots.size()];
+    ClearSlot(slot);
+    slot.height = height;
+    slot.outpoints.reserve(coins.size());
+    for (const auto &it : coins) {
+        slot.outpoints.push_back(it.first);
+        m_coins[it.first] = it.second;
+    }
+}
+
+bool CSpentCoinCache::Get(const COutPoint &outpoint, SpentCoin &coin)
+{
+    LOCK(m_mutex);
+    auto mi = m_coins.find(outpoint);
+    if (mi == m_coins.end()) {
+        m_misses++;
+        return false;
+    }
+    coin = mi->second;
+    m_hits++;
+    return true;
+}
+
+void CSpentCoinCache::Erase(const COutPoint &outpoint)
+{
+    LOCK(m_mutex);
+    m_coins.erase(outpoint);
+}
+
+bool CSpentCoinCache::TakeBlock(int height, std::vector<COutPoint> &outpoints)
+{
+    if (height < 0) {
+        return false;
+    }
+    LOCK(m_mutex);
+    Slot &slot = m_slots[(size_t)height % m_slots.size()];
+    if (slot.height != height) {
+        return false;
+    }
+    outpoints = slot.outpoints;
+    ClearSlot(slot);
+    return true;
+}
+
+void CSpentCoinCache::Clear()
+{
+    LOCK(m_mutex);
+    for (auto &slot : m_slots) {
+        slot.height = -1;
+        slot.outpoints.clear();
+    }
+    m_coins.clear();
+}
+
+CSpentCoinCache::Stats CSpentCoinCache::GetStats() const
+{
+    Stats stats;
+    LOCK(m_mutex);
+    stats.entries = m_coins.size();
+    stats.usage = memusage::DynamicUsage(m_coins) + memusage::DynamicUsage(m_slots);
+    for (const auto &it : m_coins) {
+        stats.usage += it.second.coin.DynamicMemoryUsage();
+    }
+    for (const auto &slot : m_slots) {
+        if (slot.height >= 0) {
+            stats.blocks++;
+        }
+        stats.usage += memusage::DynamicUsage(slot.outpoints);
+    }
+    stats.max_blocks = m_slots.size();
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    return stats;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_SPENTCOINCACHE_H
+#define PARTICL_SPENTCOINCACHE_H
+
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+#include <util/hasher.h>
+
+#include <atomic>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Spent coins of the last blocks, held in a ring of slots indexed by spend height.
+ *
+ * Mirrors the DB_SPENTCACHE rows in the block tree db, reorgs and kernel checks of
+ * recently spent coins are answered without a db read.
+ * A slot is dropped when its height is reused or the rows of the height are cleared.
+ */
+class CSpentCoinCache
+{
+public:
+    struct Stats {
+        size_t entries{0};
+        size_t blocks{0};
+        size_t max_blocks{0};
+        size_t usage{0}; // bytes held by the coins and slots
+        uint64_t hits{0};
+        uint64_t misses{0};
+    };
+
+    explicit CSpentCoinCache(size_t max_blocks);
+
+    /** Record the coins spent by the block at height, replaces the slot's previous block */
+    void AddBlock(int height, const std::vector<std::pair<COutPoint, SpentCoin> > &coins);
+    bool Get(const COutPoint &outpoint, SpentCoin &coin);
+    void Erase(const COutPoint &outpoint);
+    /** Remove the block at height, false if it is not in the ring */
+    bool TakeBlock(int height, std::vector<COutPoint> &outpoints);
+    void Clear();
+
+    Stats GetStats() const;
+
+private:
+    struct Slot {
+        int height{-1};
+        std::vector<COutPoint> outpoints;
+    };
+
+    void ClearSlot(Slot &slot) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    std::vector<Slot> m_slots GUARDED_BY(m_mutex);
+    std::unordered_map<COutPoint, SpentCoin, SaltedOutpointHasher> m_coins GUARDED_BY(m_mutex);
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
+
+#endif // PARTICL_SPENTCOINCACHE_H
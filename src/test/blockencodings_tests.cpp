@@ -110,6 +110,49 @@ BOOST_AUTO_TEST_CASE(SimpleRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(PrefillTierTest)
+{
+    CTxMemPool pool;
+    CBlock block(BuildBlockTestCase());
+    const size_t size_tx1 = block.vtx[1]->GetTotalSize();
+    auto prefill_tier = [&](const CTransaction& tx) {
+        return tx.GetHash() == block.vtx[2]->GetHash() ? 0 : 1;
+    };
+
+    // Lower tiers first, transactions exceeding the remaining size are skipped
+    for (const size_t max_prefill_size : {size_t{0}, size_tx1, size_t{100000}}) {
+        CBlockHeaderAndShortTxIDs shortIDs{block, prefill_tier, max_prefill_size};
+
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << shortIDs;
+        CBlockHeaderAndShortTxIDs shortIDs2;
+        stream >> shortIDs2;
+
+        const CompactBlockStats stats_before = GetCompactBlockStats();
+        PartiallyDownloadedBlock partialBlock(&pool);
+        LOCK2(cs_main, pool.cs);
+        BOOST_REQUIRE(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+        BOOST_CHECK(partialBlock.IsTxAvailable(0));
+        BOOST_CHECK_EQUAL(partialBlock.IsTxAvailable(1), max_prefill_size >= size_tx1);
+        BOOST_CHECK_EQUAL(partialBlock.IsTxAvailable(2), max_prefill_size == 100000);
+
+        std::vector<CTransactionRef> vtx_missing;
+        for (size_t i = 1; i < block.vtx.size(); ++i) {
+            if (!partialBlock.IsTxAvailable(i)) {
+                vtx_missing.push_back(block.vtx[i]);
+            }
+        }
+        CBlock block2;
+        BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_OK);
+        BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+
+        const CompactBlockStats stats = GetCompactBlockStats();
+        BOOST_CHECK_EQUAL(stats.blocks, stats_before.blocks + 1);
+        BOOST_CHECK_EQUAL(stats.txn_requested, stats_before.txn_requested + vtx_missing.size());
+        BOOST_CHECK_EQUAL(stats.blocks_requested_txn, stats_before.blocks_requested_txn + (vtx_missing.empty() ? 0 : 1));
+    }
+}
+
 class TestHeaderAndShortIDs {
     // Utility to encode custom CBlockHeaderAndShortTxIDs
 public:
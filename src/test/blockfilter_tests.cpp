@@ -125,6 +125,48 @@ BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
     BOOST_CHECK(default_ctor_block_filter_1.GetEncodedFilter() == default_ctor_block_filter_2.GetEncodedFilter());
 }
 
+BOOST_AUTO_TEST_CASE(blockfilter_particl_test)
+{
+    CScript script_stake, script_spend, script_ct, script_spent, script_coldstake, excluded_script;
+    script_stake << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG;
+    script_spend << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 2) << OP_EQUALVERIFY << OP_CHECKSIG;
+    script_ct << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 3) << OP_EQUALVERIFY << OP_CHECKSIG;
+    script_spent << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 4) << OP_EQUALVERIFY << OP_CHECKSIG;
+    excluded_script << OP_RETURN << std::vector<unsigned char>(4, 40);
+
+    script_coldstake << OP_ISCOINSTAKE << OP_IF;
+    script_coldstake.append(script_stake);
+    script_coldstake << OP_ELSE;
+    script_coldstake.append(script_spend);
+    script_coldstake << OP_ENDIF;
+
+    CMutableTransaction tx;
+    tx.nVersion = PARTICL_TXN_VERSION;
+    tx.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>(100, script_coldstake));
+    tx.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>(0, excluded_script));
+    OUTPUT_PTR<CTxOutCT> out_ct = MAKE_OUTPUT<CTxOutCT>();
+    out_ct->scriptPubKey = script_ct;
+    tx.vpout.push_back(out_ct);
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(tx));
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.emplace_back();
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(500, script_spent), 1000, false);
+
+    const GCSFilter& filter = BlockFilter(BlockFilterType::PARTICL, block, block_undo).GetFilter();
+    for (const CScript& script : {script_coldstake, script_stake, script_spend, script_ct, script_spent}) {
+        BOOST_CHECK(filter.Match(GCSFilter::Element(script.begin(), script.end())));
+    }
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(excluded_script.begin(), excluded_script.end())));
+
+    // The basic filter doesn't see vpout
+    const GCSFilter& basic_filter = BlockFilter(BlockFilterType::BASIC, block, block_undo).GetFilter();
+    BOOST_CHECK(!basic_filter.Match(GCSFilter::Element(script_ct.begin(), script_ct.end())));
+    BOOST_CHECK(basic_filter.Match(GCSFilter::Element(script_spent.begin(), script_spent.end())));
+}
+
 BOOST_AUTO_TEST_CASE(blockfilters_json_test)
 {
     UniValue json;
@@ -182,11 +224,14 @@ BOOST_AUTO_TEST_CASE(blockfilters_json_test)
 BOOST_AUTO_TEST_CASE(blockfilter_type_names)
 {
     BOOST_CHECK_EQUAL(BlockFilterTypeName(BlockFilterType::BASIC), "basic");
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BlockFilterType::PARTICL), "particl");
     BOOST_CHECK_EQUAL(BlockFilterTypeName(static_cast<BlockFilterType>(255)), "");
 
     BlockFilterType filter_type;
     BOOST_CHECK(BlockFilterTypeByName("basic", filter_type));
     BOOST_CHECK_EQUAL(filter_type, BlockFilterType::BASIC);
+    BOOST_CHECK(BlockFilterTypeByName("particl", filter_type));
+    BOOST_CHECK_EQUAL(filter_type, BlockFilterType::PARTICL);
 
     BOOST_CHECK(!BlockFilterTypeByName("unknown", filter_type));
 }
@@ -89,6 +89,7 @@ public:
             ret += entry.second.coin.DynamicMemoryUsage();
             ++count;
         }
+        ret += DynamicMemoryUsageRCT();
         BOOST_CHECK_EQUAL(GetCacheSize(), count);
         BOOST_CHECK_EQUAL(DynamicMemoryUsage(), ret);
     }
@@ -0,0 +1,83 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/coinscriptstatsindex.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+
+BOOST_AUTO_TEST_SUITE(coinscriptstatsindex_tests)
+
+static void IndexWaitSynced(BaseIndex& index)
+{
+    const auto timeout = GetTime<std::chrono::seconds>() + 120s;
+    while (!index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(timeout > GetTime<std::chrono::milliseconds>());
+        UninterruptibleSleep(100ms);
+    }
+}
+
+static CoinScriptStats ScanUTXOSet(CChainState& chainstate)
+{
+    CoinScriptStats stats;
+    LOCK(cs_main);
+    chainstate.ForceFlushStateToDisk();
+    std::unique_ptr<CCoinsViewCursor> pcursor(chainstate.CoinsDB().Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        Coin coin;
+        BOOST_REQUIRE(pcursor->GetValue(coin));
+        stats.Update(coin, true);
+    }
+    return stats;
+}
+
+static void CheckEqual(const CoinScriptStats& a, const CoinScriptStats& b)
+{
+    for (size_t i = 0; i < COIN_SCRIPT_TYPE_COUNT; ++i) {
+        BOOST_CHECK_EQUAL(a.types[i].num_plain, b.types[i].num_plain);
+        BOOST_CHECK_EQUAL(a.types[i].num_blinded, b.types[i].num_blinded);
+        BOOST_CHECK_EQUAL(a.types[i].total_amount, b.types[i].total_amount);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(coinscriptstatsindex_matches_utxo_set, TestChain100Setup)
+{
+    CChainState& chainstate = m_node.chainman->ActiveChainstate();
+    CoinScriptStatsIndex index{1 << 20, true};
+    BOOST_REQUIRE(index.Start(chainstate));
+    IndexWaitSynced(index);
+
+    const CBlockIndex* tip = WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip());
+    std::optional<CoinScriptStats> stats = index.LookUpStats(tip);
+    BOOST_REQUIRE(stats);
+    CheckEqual(*stats, ScanUTXOSet(chainstate));
+    BOOST_CHECK(stats->types[COIN_SCRIPT_OTHER].num_plain > 0);
+    BOOST_CHECK_EQUAL(stats->types[COIN_SCRIPT_PUBKEYHASH].num_plain, 0);
+
+    // Spend a coinbase output to a P2PKH output
+    const CScript script_pkh = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+    CMutableTransaction tx = CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 0, coinbaseKey, script_pkh, 10 * COIN, false);
+    CreateAndProcessBlock({tx}, script_pkh);
+    BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+
+    const CBlockIndex* new_tip = WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip());
+    std::optional<CoinScriptStats> new_stats = index.LookUpStats(new_tip);
+    BOOST_REQUIRE(new_stats);
+    CheckEqual(*new_stats, ScanUTXOSet(chainstate));
+    BOOST_CHECK_EQUAL(new_stats->types[COIN_SCRIPT_PUBKEYHASH].num_plain, 2);
+
+    // Stats of earlier blocks stay available
+    std::optional<CoinScriptStats> old_stats = index.LookUpStats(tip);
+    BOOST_REQUIRE(old_stats);
+    CheckEqual(*old_stats, *stats);
+
+    index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -15,6 +15,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <blind.h>
+#include <primitives/transaction.h>
 
 BOOST_FIXTURE_TEST_SUITE(ct_tests, BasicTestingSetup)
 
@@ -276,6 +277,135 @@ BOOST_AUTO_TEST_CASE(ct_test_bulletproofs)
     secp256k1_context_destroy(ctx);
 }
 
+BOOST_AUTO_TEST_CASE(ct_test_bulletproof_batch)
+{
+    SeedInsecureRand();
+    ECC_Start_Blinding();
+
+    const size_t num_outputs = BULLETPROOF_BATCH_SIZE + 3; // Span two chunks
+    std::vector<CTxOutValueTest> txouts(num_outputs);
+    for (size_t k = 0; k < num_outputs; ++k) {
+        CTxOutValueTest &txout = txouts[k];
+        uint64_t value = (k + 1) * COIN;
+        uint8_t blind[32];
+        InsecureRandBytes(blind, 32);
+        BOOST_REQUIRE(secp256k1_pedersen_commit(secp256k1_ctx_blind, &txout.commitment, blind, value, &secp256k1_generator_const_h, &secp256k1_generator_const_g));
+
+        uint256 nonce = InsecureRand256();
+        size_t nRangeProofLen = 5134;
+        txout.vchRangeproof.resize(nRangeProofLen);
+        const uint8_t *blindptrs[] = {blind};
+        BOOST_REQUIRE(secp256k1_bulletproof_rangeproof_prove(secp256k1_ctx_blind, blind_scratch, blind_gens, txout.vchRangeproof.data(), &nRangeProofLen,
+            &value, nullptr, blindptrs, 1, &secp256k1_generator_const_h, 64, nonce.begin(), nullptr, 0) == 1);
+        txout.vchRangeproof.resize(nRangeProofLen);
+    }
+
+    std::vector<CBulletproofBatchEntry> batch;
+    for (const auto &txout : txouts) {
+        BOOST_CHECK(txout.vchRangeproof.size() == GetBulletproofSize(1));
+        batch.push_back({txout.vchRangeproof.data(), txout.vchRangeproof.size(), &txout.commitment, false});
+    }
+    size_t n_failed = 0;
+    BOOST_CHECK(VerifyBulletproofBatch(batch, n_failed));
+
+    // Swap the commitments of two proofs in the second chunk
+    const size_t bad_index = BULLETPROOF_BATCH_SIZE + 1;
+    std::swap(batch[bad_index].commitment, batch[bad_index + 1].commitment);
+    BOOST_CHECK(!VerifyBulletproofBatch(batch, n_failed));
+    BOOST_CHECK(n_failed == bad_index);
+
+    ECC_Stop_Blinding();
+}
+
+BOOST_AUTO_TEST_CASE(ct_test_bulletproof_aggregate)
+{
+    SeedInsecureRand();
+    ECC_Start_Blinding();
+
+    BOOST_CHECK(!IsValidAggregateSize(1));
+    BOOST_CHECK(IsValidAggregateSize(2));
+    BOOST_CHECK(!IsValidAggregateSize(3));
+    BOOST_CHECK(IsValidAggregateSize(MAX_AGGREGATE_RANGEPROOFS));
+    BOOST_CHECK(!IsValidAggregateSize(MAX_AGGREGATE_RANGEPROOFS * 2));
+
+    const size_t num_outputs = 4;
+    std::vector<uint64_t> values(num_outputs);
+    std::vector<uint256> blinds(num_outputs), nonces(num_outputs);
+    std::vector<const uint8_t*> blindptrs(num_outputs);
+    std::vector<secp256k1_pedersen_commitment> commitments(num_outputs);
+    std::vector<std::vector<uint8_t> > vdata(num_outputs);
+    for (size_t k = 0; k < num_outputs; ++k) {
+        values[k] = (k + 1) * COIN;
+        blinds[k] = InsecureRand256();
+        nonces[k] = InsecureRand256();
+        blindptrs[k] = blinds[k].begin();
+        BOOST_REQUIRE(secp256k1_pedersen_commit(secp256k1_ctx_blind, &commitments[k], blinds[k].begin(), values[k], &secp256k1_generator_const_h, &secp256k1_generator_const_g));
+
+        vdata[k].resize(33); // ephemeral pubkey
+        vdata[k].push_back(DO_STEALTH_PREFIX);
+        vdata[k].resize(38);
+        BOOST_CHECK(GetAggregateAmountOffset(vdata[k]) == -1);
+        PutAggregateAmount(nonces[k], values[k], blinds[k].begin(), vdata[k]);
+        BOOST_CHECK(GetAggregateAmountOffset(vdata[k]) == 38);
+    }
+
+    size_t nRangeProofLen = 5134;
+    std::vector<uint8_t> rangeproof(nRangeProofLen);
+    BOOST_REQUIRE(secp256k1_bulletproof_rangeproof_prove(secp256k1_ctx_blind, blind_scratch, blind_gens, rangeproof.data(), &nRangeProofLen,
+        values.data(), nullptr, blindptrs.data(), num_outputs, &secp256k1_generator_const_h, 64, nonces[0].begin(), nullptr, 0) == 1);
+    rangeproof.resize(nRangeProofLen);
+    BOOST_CHECK(rangeproof.size() < 1000);
+    BOOST_CHECK(rangeproof.size() == GetBulletproofSize(num_outputs));
+
+    BOOST_CHECK(secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind, blind_scratch, blind_gens, rangeproof.data(), rangeproof.size(),
+        nullptr, commitments.data(), num_outputs, 64, &secp256k1_generator_const_h, nullptr, 0) == 1);
+    std::swap(commitments[1], commitments[2]);
+    BOOST_CHECK(secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind, blind_scratch, blind_gens, rangeproof.data(), rangeproof.size(),
+        nullptr, commitments.data(), num_outputs, 64, &secp256k1_generator_const_h, nullptr, 0) != 1);
+    std::swap(commitments[1], commitments[2]);
+
+    // Each recipient recovers its own amount from vData
+    std::vector<uint8_t> empty_proof;
+    for (size_t k = 0; k < num_outputs; ++k) {
+        uint64_t value_out = 0;
+        uint8_t blind_out[32];
+        BOOST_CHECK(RewindBulletproofOutput(k == 0 ? rangeproof : empty_proof, vdata[k], &commitments[k], nonces[k], value_out, blind_out) == 1);
+        BOOST_CHECK(value_out == values[k]);
+        BOOST_CHECK(memcmp(blind_out, blinds[k].begin(), 32) == 0);
+
+        // Wrong nonce doesn't open the commitment
+        BOOST_CHECK(RewindBulletproofOutput(empty_proof, vdata[k], &commitments[k], nonces[(k + 1) % num_outputs], value_out, blind_out) != 1);
+    }
+
+    uint256 entry, entry_reordered;
+    ComputeRangeProofCacheEntry(entry, commitments.data(), num_outputs, rangeproof);
+    std::swap(commitments[0], commitments[3]);
+    ComputeRangeProofCacheEntry(entry_reordered, commitments.data(), num_outputs, rangeproof);
+    BOOST_CHECK(entry != entry_reordered);
+
+    ECC_Stop_Blinding();
+}
+
+BOOST_AUTO_TEST_CASE(ct_rangeproof_cache_test)
+{
+    secp256k1_pedersen_commitment commitment;
+    memset(commitment.data, 1, 33);
+    std::vector<uint8_t> rangeproof(675, 2);
+
+    uint256 entry, entry_old_type;
+    ComputeRangeProofCacheEntry(entry, commitment, rangeproof, true);
+    ComputeRangeProofCacheEntry(entry_old_type, commitment, rangeproof, false);
+    BOOST_CHECK(entry != entry_old_type);
+
+    BOOST_CHECK(!RangeProofCacheContains(entry, false));
+    RangeProofCacheInsert(entry);
+    BOOST_CHECK(!RangeProofCacheContains(entry_old_type, false));
+    BOOST_CHECK(RangeProofCacheContains(entry, false));
+
+    // Checking a block marks the entry as erasable
+    BOOST_CHECK(RangeProofCacheContains(entry, true));
+}
+
 BOOST_AUTO_TEST_CASE(ct_parameters_test)
 {
     //for (size_t k = 0; k < 10000; ++k)
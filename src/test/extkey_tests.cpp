@@ -554,6 +554,84 @@ BOOST_AUTO_TEST_CASE(extkey_account)
     BOOST_CHECK(pak->nKey == 3);
 }
 
+BOOST_AUTO_TEST_CASE(extkey_derive_keys)
+{
+    CExtKey58 eKey58;
+    BOOST_CHECK(0 == eKey58.Set58("XPARHAr37YxmFP8wyjkaHAQWmp84GiyLikL7EL8j9BCx4LkB8Q1Bw5Kr8sA1GA3Ym53zNLcaxxFHr6u81JVTeCaD61c6fKS1YRAuti8Zu5SzJCjh"));
+    CStoredExtKey sk;
+    sk.kp = eKey58.GetKey();
+
+    // Threaded batch must match deriving one child at a time
+    uint32_t nStart = 7, nKeys = 300;
+    for (size_t nThreads : {1, 4}) {
+        std::vector<std::pair<uint32_t, CPubKey> > vDerived;
+        BOOST_CHECK(0 == sk.DeriveKeys(vDerived, nStart, nKeys, nThreads));
+        BOOST_REQUIRE(vDerived.size() == nKeys);
+        for (uint32_t k = 0; k < nKeys; ++k) {
+            CPubKey pk;
+            uint32_t nChildOut;
+            BOOST_CHECK(0 == sk.DeriveKey(pk, nStart + k, nChildOut));
+            BOOST_CHECK(vDerived[k].first == nChildOut);
+            BOOST_CHECK(vDerived[k].second == pk);
+        }
+    }
+
+    std::vector<std::pair<uint32_t, CPubKey> > vDerived;
+    BOOST_CHECK(0 != sk.DeriveKeys(vDerived, (uint32_t)1 << 31, 1));
+    BOOST_CHECK(0 == sk.DeriveKeys(vDerived, ((uint32_t)1 << 31) - 2, 10));
+    BOOST_CHECK(vDerived.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(extkey_account_lazy_packs)
+{
+    CExtKeyAccount eka;
+    uint160 i;
+    std::vector<CEKAKeyPack> vPack0, vPack1;
+    for (uint32_t k = 0; k < 4; ++k) {
+        i.SetHex(strprintf("0x%02x", k + 1));
+        (k < 2 ? vPack0 : vPack1).push_back(CEKAKeyPack(CKeyID(i), CEKAKey(1, k)));
+    }
+    for (const auto &entry : vPack0) {
+        eka.m_key_pack_index.Add(entry.id, 0);
+    }
+    for (const auto &entry : vPack1) {
+        eka.m_key_pack_index.Add(entry.id, 1);
+    }
+    eka.m_key_pack_index.Sort();
+    eka.m_key_cache.SetMaxSize(2);
+
+    size_t nReads = 0;
+    eka.m_read_key_pack = [&](uint32_t nPack, std::vector<CEKAKeyPack> &ekPak) {
+        nReads++;
+        ekPak = nPack == 0 ? vPack0 : vPack1;
+        return nPack < 2;
+    };
+    BOOST_CHECK(eka.NumSavedKeys() == 4);
+
+    i.SetHex("0x03");
+    const CEKAKey *pak = eka.FindSavedKey(CKeyID(i));
+    BOOST_REQUIRE(pak);
+    BOOST_CHECK(pak->nKey == 2);
+    BOOST_CHECK(nReads == 1);
+    BOOST_CHECK(eka.FindSavedKey(CKeyID(i)) && nReads == 1); // cached
+
+    // Unknown ids are rejected by the index without a read
+    i.SetHex("0x10");
+    BOOST_CHECK(HK_NO == eka.HaveSavedKey(CKeyID(i)));
+    BOOST_CHECK(nReads == 1);
+
+    // Least recently used entry is evicted
+    i.SetHex("0x01");
+    BOOST_CHECK(HK_YES == eka.HaveSavedKey(CKeyID(i)));
+    i.SetHex("0x02");
+    BOOST_CHECK(HK_YES == eka.HaveSavedKey(CKeyID(i)));
+    BOOST_CHECK(eka.m_key_cache.size() == 2);
+    BOOST_CHECK(nReads == 3);
+    i.SetHex("0x03");
+    BOOST_CHECK(HK_YES == eka.HaveSavedKey(CKeyID(i)));
+    BOOST_CHECK(nReads == 4);
+}
+
 BOOST_AUTO_TEST_CASE(extkey_misc_keys)
 {
     uint32_t nTest = 1;
@@ -35,4 +35,20 @@ BOOST_AUTO_TEST_CASE(test_query_parameters)
     uri = "/rest/endpoint/someresource.json&p1=v1&p2=v2";
     BOOST_CHECK(!GetQueryParameterFromUri(uri.c_str(), "p1").has_value());
 }
+
+BOOST_AUTO_TEST_CASE(test_jsonrpc_method_from_body)
+{
+    BOOST_CHECK_EQUAL(GetJSONRPCMethodFromBody(R"({"method":"getblockcount","params":[],"id":1})").value(), "getblockcount");
+    BOOST_CHECK_EQUAL(GetJSONRPCMethodFromBody(R"( { "id" : 1, "method" : "filtertransactions" })").value(), "filtertransactions");
+
+    // Nested and quoted keys are skipped
+    BOOST_CHECK_EQUAL(GetJSONRPCMethodFromBody(R"({"params":{"method":"a"},"id":"\"method\"","method":"b"})").value(), "b");
+    BOOST_CHECK_EQUAL(GetJSONRPCMethodFromBody(R"({"id":"method","method":"c"})").value(), "c");
+
+    // Batches, truncated bodies and non string methods aren't matched
+    BOOST_CHECK(!GetJSONRPCMethodFromBody(R"([{"method":"getblockcount"}])").has_value());
+    BOOST_CHECK(!GetJSONRPCMethodFromBody(R"({"params":[],"method":"getbl)").has_value());
+    BOOST_CHECK(!GetJSONRPCMethodFromBody(R"({"method":1})").has_value());
+    BOOST_CHECK(!GetJSONRPCMethodFromBody("").has_value());
+}
 BOOST_AUTO_TEST_SUITE_END()
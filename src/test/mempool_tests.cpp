@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <policy/policy.h>
 #include <txmempool.h>
 #include <util/system.h>
@@ -794,4 +795,171 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTestsDiamond)
     BOOST_CHECK_EQUAL(descendants, 4ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolInsightIndexTest)
+{
+    MempoolInsightIndex index;
+    const uint256 address_a = InsecureRand256(), address_b = InsecureRand256();
+    const uint256 tx1 = InsecureRand256(), tx2 = InsecureRand256();
+
+    index.AddAddressDeltas(tx1, {
+        {CMempoolAddressDeltaKey(ADDR_INDT_PUBKEY_ADDRESS, address_a, tx1, 0, 0), CMempoolAddressDelta(1, 100)},
+        {CMempoolAddressDeltaKey(ADDR_INDT_PUBKEY_ADDRESS, address_b, tx1, 1, 0), CMempoolAddressDelta(1, 200)},
+    });
+    index.AddAddressDeltas(tx2, {
+        {CMempoolAddressDeltaKey(ADDR_INDT_PUBKEY_ADDRESS, address_a, tx2, 0, 1), CMempoolAddressDelta(2, -100, tx1, 0)},
+    });
+    index.AddSpentOutputs(tx2, {{CSpentIndexKey(tx1, 0), CSpentIndexValue(tx2, 0, -1, 100, ADDR_INDT_PUBKEY_ADDRESS, address_a)}});
+    BOOST_CHECK(index.DynamicMemoryUsage() > 0);
+
+    std::vector<MempoolInsightIndex::AddressDelta> results;
+    index.GetAddressDeltas({{address_a, ADDR_INDT_PUBKEY_ADDRESS}}, results);
+    BOOST_CHECK_EQUAL(results.size(), 2U);
+    results.clear();
+    // Type is part of the key
+    index.GetAddressDeltas({{address_a, ADDR_INDT_SCRIPT_ADDRESS}}, results);
+    BOOST_CHECK(results.empty());
+
+    CSpentIndexValue value;
+    BOOST_CHECK(index.GetSpent(CSpentIndexKey(tx1, 0), value));
+    BOOST_CHECK(value.txid == tx2);
+    BOOST_CHECK(!index.GetSpent(CSpentIndexKey(tx1, 1), value));
+
+    index.RemoveAddressDeltas(tx2);
+    index.RemoveSpentOutputs(tx2);
+    index.GetAddressDeltas({{address_a, ADDR_INDT_PUBKEY_ADDRESS}, {address_b, ADDR_INDT_PUBKEY_ADDRESS}}, results);
+    BOOST_CHECK_EQUAL(results.size(), 2U);
+    BOOST_CHECK(!index.GetSpent(CSpentIndexKey(tx1, 0), value));
+
+    index.RemoveAddressDeltas(tx1);
+    results.clear();
+    index.GetAddressDeltas({{address_a, ADDR_INDT_PUBKEY_ADDRESS}, {address_b, ADDR_INDT_PUBKEY_ADDRESS}}, results);
+    BOOST_CHECK(results.empty());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSpillProofsTest)
+{
+    CTxMemPool pool;
+    BOOST_REQUIRE(pool.EnableProofSpill(gArgs.GetDataDirNet() / "mempool_proofs.dat"));
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction mtx;
+    mtx.nVersion = PARTICL_TXN_VERSION;
+    mtx.vin.push_back(CTxIn(InsecureRand256(), 0));
+    auto out_ct = MAKE_OUTPUT<CTxOutCT>();
+    out_ct->vRangeproof.resize(700, 0x42);
+    out_ct->scriptPubKey = CScript() << OP_TRUE;
+    mtx.vpout.push_back(out_ct);
+    out_ct.reset();
+    mtx.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>(1 * COIN, CScript() << OP_TRUE));
+
+    CTransactionRef tx = MakeTransactionRef(mtx);
+    const uint256 txid = tx->GetHash();
+    const uint256 wtxid = tx->GetWitnessHash();
+
+    LOCK2(cs_main, pool.cs);
+    pool.addUnchecked(entry.FromTx(tx));
+    const size_t usage_before = pool.DynamicMemoryUsage();
+
+    // Not spilled while referenced outside the mempool
+    pool.SpillProofs();
+    BOOST_CHECK_EQUAL(pool.GetProofSpillStats()->spilled_txns, 0U);
+
+    tx.reset();
+    pool.SpillProofs();
+    BOOST_CHECK_EQUAL(pool.GetProofSpillStats()->spilled_txns, 1U);
+    BOOST_CHECK(pool.DynamicMemoryUsage() < usage_before);
+    auto it = pool.GetIter(txid);
+    BOOST_REQUIRE(it);
+    BOOST_CHECK((*it)->GetTx().vpout[0]->GetPRangeproof()->empty());
+    BOOST_CHECK((*it)->GetTx().GetHash() == txid);
+
+    // Restored when the transaction leaves the mempool
+    tx = pool.get(txid);
+    BOOST_REQUIRE(tx);
+    BOOST_CHECK_EQUAL(tx->vpout[0]->GetPRangeproof()->size(), 700U);
+    BOOST_CHECK(tx->vpout[0]->GetPRangeproof()->at(699) == 0x42);
+    BOOST_CHECK(CTransaction(CMutableTransaction(*tx)).GetWitnessHash() == wtxid);
+    BOOST_CHECK_EQUAL(pool.GetProofSpillStats()->spilled_txns, 0U);
+    BOOST_CHECK_EQUAL(pool.GetProofSpillStats()->file_bytes, 0U);
+
+    // Requeued, spilled again once released
+    tx.reset();
+    pool.SpillProofs();
+    BOOST_CHECK_EQUAL(pool.GetProofSpillStats()->spilled_txns, 1U);
+
+    pool.removeRecursive(*pool.get(txid), REMOVAL_REASON_DUMMY);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK_EQUAL(pool.GetProofSpillStats()->spilled_txns, 0U);
+    BOOST_CHECK_EQUAL(pool.GetProofSpillStats()->live_bytes, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolEvictionCostTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx1));
+
+    // Pays a higher feerate than tx1, but verifying a ring of 11 costs more than that
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout.n = COutPoint::ANON_MARKER;
+    tx2.vin[0].SetAnonInfo(1, 11);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    BOOST_CHECK_EQUAL(GetEvictionCostVSize(CTransaction(tx1)), 0);
+    BOOST_CHECK_EQUAL(GetEvictionCostVSize(CTransaction(tx2)), 11 * EVICTION_VSIZE_PER_RING_MEMBER);
+    pool.addUnchecked(entry.Fee(15000LL).FromTx(tx2));
+
+    auto it2 = pool.mapTx.find(tx2.GetHash());
+    BOOST_CHECK_EQUAL(it2->GetEvictionSize(), (int64_t)it2->GetTxSize() + 11 * EVICTION_VSIZE_PER_RING_MEMBER);
+    BOOST_CHECK_EQUAL(it2->GetEvictionSizeWithDescendants(), (uint64_t)it2->GetEvictionSize());
+
+    pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4); // should remove the anon transaction
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tx1.GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tx2.GetHash())));
+
+    // Key images count towards the mempool usage
+    size_t usage = pool.DynamicMemoryUsage();
+    pool.mapKeyImages.Add(CCmpPubKey(), tx1.GetHash());
+    BOOST_CHECK(pool.KeyImageUsage() > 0);
+    BOOST_CHECK_EQUAL(pool.DynamicMemoryUsage(), usage + pool.KeyImageUsage());
+    pool.mapKeyImages.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(MempoolKeyImagesTest)
+{
+    CMempoolKeyImages key_images;
+    std::vector<CCmpPubKey> kis(100);
+    for (size_t i = 0; i < kis.size(); ++i) {
+        std::vector<uint8_t> vch(33);
+        vch[0] = 0x02;
+        GetRandBytes({vch.data() + 1, 32});
+        kis[i] = CCmpPubKey(vch.begin(), vch.end());
+        key_images.Add(kis[i], ArithToUint256(i));
+    }
+    BOOST_CHECK_EQUAL(key_images.Size(), kis.size());
+
+    uint256 txid;
+    for (size_t i = 0; i < kis.size(); ++i) {
+        BOOST_CHECK(key_images.Get(kis[i], txid));
+        BOOST_CHECK(txid == ArithToUint256(i));
+    }
+    key_images.Remove(kis[0]);
+    BOOST_CHECK(!key_images.Get(kis[0], txid));
+    BOOST_CHECK_EQUAL(key_images.Size(), kis.size() - 1);
+    key_images.Clear();
+    BOOST_CHECK_EQUAL(key_images.Size(), 0U);
+    BOOST_CHECK(!key_images.Get(kis[1], txid));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
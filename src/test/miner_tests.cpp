@@ -29,6 +29,7 @@
 #include <boost/test/unit_test.hpp>
 
 using node::BlockAssembler;
+using node::BlockTemplateCache;
 using node::CBlockTemplate;
 
 namespace miner_tests {
@@ -616,4 +617,43 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(block_template_cache)
+{
+    BlockTemplateCache cache{*m_node.chainman, *m_node.mempool, *m_node.scheduler};
+    SetMockTime(GetTime());
+
+    std::unique_ptr<CBlockTemplate> block_template = cache.Get();
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 1U);
+    BOOST_CHECK(block_template->block.hashPrevBlock == WITH_LOCK(::cs_main, return m_node.chainman->ActiveChain().Tip()->GetBlockHash()));
+
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = InsecureRand256();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 10000;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    const CTransactionRef ptx = MakeTransactionRef(tx);
+    {
+        LOCK2(::cs_main, m_node.mempool->cs);
+        m_node.mempool->addUnchecked(entry.Fee(10000).Time(GetTime()).FromTx(ptx));
+    }
+
+    // A template missing new transactions is served until it's too old
+    block_template = cache.Get();
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 1U);
+    SetMockTime(GetTime() + count_seconds(BlockTemplateCache::TEMPLATE_MAX_STALE) + 1);
+    block_template = cache.Get();
+    BOOST_REQUIRE_EQUAL(block_template->block.vtx.size(), 2U);
+    BOOST_CHECK(block_template->block.vtx[1]->GetHash() == ptx->GetHash());
+
+    // A template with a transaction no longer in the mempool is rebuilt
+    WITH_LOCK(m_node.mempool->cs, m_node.mempool->removeRecursive(*ptx, MemPoolRemovalReason::CONFLICT));
+    block_template = cache.Get();
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 1U);
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
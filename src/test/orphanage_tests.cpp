@@ -134,4 +134,38 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(orphanage.CountOrphans() == 0);
 }
 
+BOOST_AUTO_TEST_CASE(orphan_await_anon_index)
+{
+    TxOrphanageTest orphanage;
+    LOCK(g_cs_orphans);
+
+    std::vector<uint256> txids;
+    for (int i = 0; i < 4; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.hash = InsecureRand256();
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1*CENT;
+        CTransactionRef ptx = MakeTransactionRef(tx);
+        BOOST_CHECK(orphanage.AddTx(ptx, i));
+        txids.push_back(ptx->GetHash());
+    }
+    orphanage.AwaitAnonIndex(txids[0], 10);
+    orphanage.AwaitAnonIndex(txids[1], 12);
+    orphanage.AwaitAnonIndex(txids[2], 12);
+    orphanage.AwaitAnonIndex(txids[2], 20); // Moves to the new index
+
+    BOOST_CHECK(orphanage.ReleaseForAnonIndex(9).empty());
+    auto released = orphanage.ReleaseForAnonIndex(12);
+    BOOST_REQUIRE(released.size() == 2);
+    BOOST_CHECK(released[0] == std::make_pair(txids[0], NodeId{0}));
+    BOOST_CHECK(released[1] == std::make_pair(txids[1], NodeId{1}));
+    BOOST_CHECK(orphanage.ReleaseForAnonIndex(12).empty());
+    BOOST_CHECK(orphanage.CountOrphans() == 4); // Released orphans stay until processed
+
+    // Erased orphans are dropped from the index
+    orphanage.EraseTx(txids[2]);
+    BOOST_CHECK(orphanage.ReleaseForAnonIndex(100).empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
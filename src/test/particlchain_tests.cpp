@@ -11,19 +11,25 @@
 #include <consensus/tx_verify.h>
 #include <key/extkey.h>
 #include <pos/kernel.h>
+#include <pos/stakingperf.h>
 #include <chainparams.h>
 #include <blind.h>
+#include <anon.h>
 #include <validation.h>
+#include <spentcoincache.h>
 
 #include <script/sign.h>
 #include <policy/policy.h>
+#include <clientversion.h>
+#include <streams.h>
 
 #include <boost/test/unit_test.hpp>
 
 bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
                        const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore,
                        bool cacheFullScriptStore, PrecomputedTransactionData& txdata,
-                       std::vector<CScriptCheck> *pvChecks, bool fAnonChecks = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+                       std::vector<CScriptCheck> *pvChecks, bool fAnonChecks = true,
+                       std::vector<CAnonCheck> *pvAnonChecks = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 
 BOOST_FIXTURE_TEST_SUITE(particlchain_tests, ParticlBasicTestingSetup)
@@ -301,6 +307,30 @@ BOOST_AUTO_TEST_CASE(mixed_output_types)
     ECC_Stop_Blinding();
 }
 
+BOOST_AUTO_TEST_CASE(txn_hashes)
+{
+    // Both hashes are taken from one pass over a Particl txn, compare with separate serializations
+    CMutableTransaction txn;
+    txn.nVersion = PARTICL_TXN_VERSION;
+    txn.vin.push_back(CTxIn(uint256S("0x1234"), 1));
+    txn.vin[0].scriptWitness.stack.push_back(std::vector<uint8_t>(72, 0x01));
+    txn.vin[0].scriptWitness.stack.push_back(std::vector<uint8_t>(33, 0x02));
+    txn.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>(1 * COIN, CScript() << OP_TRUE));
+    OUTPUT_PTR<CTxOutCT> out_ct = MAKE_OUTPUT<CTxOutCT>();
+    out_ct->vRangeproof.resize(5134, 0x03);
+    txn.vpout.push_back(out_ct);
+
+    CTransaction tx(txn);
+    BOOST_CHECK(tx.GetHash() == SerializeHash(txn, SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS));
+    BOOST_CHECK(tx.GetWitnessHash() == SerializeHash(txn, SER_GETHASH, 0));
+    BOOST_CHECK(tx.GetHash() != tx.GetWitnessHash());
+
+    txn.vin[0].scriptWitness.stack.clear();
+    CTransaction tx_no_witness(txn);
+    BOOST_CHECK(tx_no_witness.GetHash() == tx.GetHash());
+    BOOST_CHECK(tx_no_witness.GetWitnessHash() == SerializeHash(txn, SER_GETHASH, 0));
+}
+
 BOOST_AUTO_TEST_CASE(op_iscoinstake_tests)
 {
     CKey k1, k2;
@@ -786,4 +816,419 @@ BOOST_AUTO_TEST_CASE(taproot)
     }
 }
 
+BOOST_AUTO_TEST_CASE(anon_output_height)
+{
+    // Anon outputs added per block
+    const std::vector<int64_t> new_outputs{0, 0, 3, 0, 1, 5, 0, 0, 2};
+    std::vector<CBlockIndex> blocks(new_outputs.size());
+    int64_t num_outputs = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        num_outputs += new_outputs[i];
+        blocks[i].nHeight = i;
+        blocks[i].nAnonOutputs = num_outputs;
+        blocks[i].pprev = i > 0 ? &blocks[i - 1] : nullptr;
+    }
+    CChain chain;
+    chain.SetTip(&blocks.back());
+
+    LOCK(cs_main);
+    BOOST_CHECK(GetAnonOutputHeight(chain, 0) == -1);
+    BOOST_CHECK(GetAnonOutputHeight(chain, num_outputs + 1) == -1);
+    int64_t anon_index = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        for (int64_t k = 0; k < new_outputs[i]; ++k) {
+            BOOST_CHECK(GetAnonOutputHeight(chain, ++anon_index) == (int)i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_index_compact)
+{
+    CBlockIndex index;
+    index.nHeight = 1234;
+    index.nTx = 3;
+    index.nVersion = PARTICL_BLOCK_VERSION;
+    index.nTime = 1600000000;
+    index.nFlags = BLOCK_PROOF_OF_STAKE | BLOCK_ACCEPTED;
+    index.bnStakeModifier = InsecureRand256();
+    index.nMoneySupply = 8000000 * COIN;
+    index.nAnonOutputs = 70000;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CDiskBlockIndex(&index);
+    size_t compact_size = ss.size();
+    CDiskBlockIndex read_index;
+    ss >> read_index;
+    BOOST_CHECK(read_index.nHeight == index.nHeight);
+    BOOST_CHECK(read_index.nFlags == index.nFlags);
+    BOOST_CHECK(read_index.bnStakeModifier == index.bnStakeModifier);
+    BOOST_CHECK(read_index.nMoneySupply == index.nMoneySupply);
+    BOOST_CHECK(read_index.nAnonOutputs == index.nAnonOutputs);
+    BOOST_CHECK(read_index.nTime == index.nTime);
+
+    // Records written before the compact format must still load
+    uint32_t status = 0;
+    int height = index.nHeight, version = CLIENT_VERSION;
+    ss << VARINT_MODE(version, VarIntMode::NONNEGATIVE_SIGNED) << VARINT_MODE(height, VarIntMode::NONNEGATIVE_SIGNED);
+    ss << VARINT(status) << VARINT(index.nTx);
+    ss << index.nFlags << index.bnStakeModifier << COutPoint(InsecureRand256(), 1) << index.nMoneySupply << index.nAnonOutputs;
+    ss << index.nVersion << uint256() << index.hashMerkleRoot << index.hashWitnessMerkleRoot;
+    ss << index.nTime << index.nBits << index.nNonce;
+    BOOST_CHECK(ss.size() > compact_size);
+    CDiskBlockIndex legacy_index;
+    ss >> legacy_index;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(legacy_index.nFlags == index.nFlags);
+    BOOST_CHECK(legacy_index.bnStakeModifier == index.bnStakeModifier);
+    BOOST_CHECK(legacy_index.nMoneySupply == index.nMoneySupply);
+    BOOST_CHECK(legacy_index.nAnonOutputs == index.nAnonOutputs);
+    BOOST_CHECK(legacy_index.GetBlockHash() == read_index.GetBlockHash());
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_batch)
+{
+    CBlockIndex index_prev;
+    index_prev.nHeight = 100;
+    index_prev.bnStakeModifier = InsecureRand256();
+    const unsigned int nBits = 0x1d00ffff;
+
+    std::vector<StakeKernelCandidate> candidates(32);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        candidates[i].prevout = COutPoint(InsecureRand256(), i);
+        candidates[i].amount = i % 8 == 0 ? 0 : COIN;
+        candidates[i].block_time = 1000;
+    }
+    candidates[1].block_time = 5000;
+    std::vector<int64_t> times;
+    for (int64_t t = 1600; t < 1600 + 16 * 100; t += 16) {
+        times.push_back(t);
+    }
+
+    std::vector<int64_t> kernel_times;
+    size_t num_found = CheckKernelBatch(&index_prev, nBits, candidates, times, kernel_times);
+    BOOST_REQUIRE(kernel_times.size() == candidates.size());
+
+    size_t num_expected = 0;
+    uint256 hash_proof, target_proof;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const auto &c = candidates[i];
+        int64_t expected_time = 0;
+        if (c.amount > 0 && i != 1) {
+            for (const auto t : times) {
+                if (CheckStakeKernelHash(&index_prev, nBits, c.block_time, c.amount, c.prevout, t, hash_proof, target_proof)) {
+                    expected_time = t;
+                    break;
+                }
+            }
+        }
+        num_expected += expected_time != 0;
+        BOOST_CHECK(kernel_times[i] == expected_time);
+    }
+    BOOST_CHECK(num_found == num_expected);
+    BOOST_CHECK(num_found > 0);
+
+    std::vector<uint256> hashes;
+    GetStakeKernelHashes(index_prev.bnStakeModifier, 1000, candidates[2].prevout, times, hashes);
+    BOOST_REQUIRE(hashes.size() == times.size());
+    for (size_t k = 0; k < times.size(); ++k) {
+        CheckStakeKernelHash(&index_prev, nBits, 1000, COIN, candidates[2].prevout, times[k], hash_proof, target_proof);
+        BOOST_CHECK(hashes[k] == hash_proof);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(stake_caches)
+{
+    LRUCache<uint256, int, SaltedTxidHasher> cache(3);
+    std::vector<uint256> keys;
+    for (int i = 0; i < 4; ++i) {
+        keys.push_back(InsecureRand256());
+    }
+    int v;
+    cache.Insert(keys[0], 0);
+    cache.Insert(keys[1], 1);
+    cache.Insert(keys[2], 2);
+    BOOST_CHECK(cache.Get(keys[0], v) && v == 0); // keys[1] is now the least recently used
+    cache.Insert(keys[3], 3);
+    BOOST_CHECK(cache.size() == 3);
+    BOOST_CHECK(!cache.Get(keys[1], v));
+    BOOST_CHECK(cache.Peek(keys[2]) && *cache.Peek(keys[2]) == 2);
+    cache.Insert(keys[2], 5);
+    BOOST_CHECK(cache.Get(keys[2], v) && v == 5);
+    BOOST_CHECK(cache.Erase(keys[3]));
+    BOOST_CHECK(!cache.Erase(keys[3]));
+
+    LRUCacheStats stats = cache.GetStats();
+    BOOST_CHECK(stats.entries == 2);
+    BOOST_CHECK(stats.max_entries == 3);
+    BOOST_CHECK(stats.hits == 4);
+    BOOST_CHECK(stats.misses == 1);
+    BOOST_CHECK(cache.DynamicMemoryUsage() > 0);
+    cache.Clear();
+    BOOST_CHECK(cache.size() == 0);
+    BOOST_CHECK(cache.GetStats().hits == 4);
+
+    // The first block seen for a kernel wins
+    CMutableTransaction tx;
+    tx.nVersion = PARTICL_TXN_VERSION;
+    tx.SetType(TXN_COINSTAKE);
+    tx.vin.push_back(CTxIn(COutPoint(InsecureRand256(), 1)));
+    CBlock block_a, block_b;
+    block_a.vtx.push_back(MakeTransactionRef(tx));
+    block_b = block_a;
+    block_b.nTime = 1;
+    const COutPoint &kernel = tx.vin[0].prevout;
+
+    particl::ClearStakeSeen();
+    BOOST_CHECK(particl::CheckStakeUnique(block_a, false));
+    BOOST_CHECK(particl::CheckStakeUnused(kernel));
+    BOOST_CHECK(particl::CheckStakeUnique(block_a));
+    BOOST_CHECK(!particl::CheckStakeUnused(kernel));
+    BOOST_CHECK(particl::CheckStakeUnique(block_a));
+    BOOST_CHECK(!particl::CheckStakeUnique(block_b));
+    particl::ClearStakeSeen();
+    BOOST_CHECK(particl::CheckStakeUnused(kernel));
+}
+
+static double ReferencePoSKernelPS(const CBlockIndex *pindex)
+{
+    const CBlockIndex *pindexPrevStake = nullptr;
+    double dStakeKernelsTriedAvg = 0;
+    int nStakesHandled = 0, nStakesTime = 0;
+    while (pindex && nStakesHandled < 72) {
+        if (pindex->IsProofOfStake()) {
+            if (pindexPrevStake) {
+                int nShift = (pindexPrevStake->nBits >> 24) & 0xff;
+                double dDiff = (double)0x0000ffff / (double)(pindexPrevStake->nBits & 0x00ffffff);
+                for (; nShift < 29; nShift++) dDiff *= 256.0;
+                for (; nShift > 29; nShift--) dDiff /= 256.0;
+                dStakeKernelsTriedAvg += dDiff * 4294967296.0;
+                nStakesTime += pindexPrevStake->nTime - pindex->nTime;
+                nStakesHandled++;
+            }
+            pindexPrevStake = pindex;
+        }
+        pindex = pindex->pprev;
+    }
+    return nStakesTime ? dStakeKernelsTriedAvg / nStakesTime : 0;
+}
+
+BOOST_AUTO_TEST_CASE(pos_kernelps_window)
+{
+    const size_t num_blocks = 300;
+    std::vector<uint256> hashes(num_blocks);
+    std::vector<CBlockIndex> chain(num_blocks);
+    for (size_t i = 0; i < num_blocks; ++i) {
+        hashes[i] = InsecureRand256();
+        CBlockIndex &index = chain[i];
+        index.phashBlock = &hashes[i];
+        index.nHeight = i;
+        index.pprev = i > 0 ? &chain[i - 1] : nullptr;
+        index.nTime = 1000 + i * 16 + InsecureRandRange(8);
+        index.nBits = 0x1d00ffff - InsecureRandRange(0x8000);
+        if (i > 10 && InsecureRandRange(4) != 0) {
+            index.SetProofOfStake();
+        }
+        index.BuildSkip();
+    }
+
+    LOCK(cs_main);
+    auto check_tip = [&](size_t n_tip) {
+        CBlockIndex *tip = &chain[n_tip];
+        double expected = ReferencePoSKernelPS(tip) * (Params().GetStakeTimestampMask(n_tip) + 1);
+        double result = GetPoSKernelPS(tip);
+        BOOST_CHECK_CLOSE(result + 1.0, expected + 1.0, 0.0001);
+    };
+
+    for (size_t i = 0; i < 200; ++i) {
+        PoSKernelPSConnectTip(&chain[i]);
+        check_tip(i);
+    }
+    check_tip(50); // Not the tip
+
+    // Disconnect past the window and reconnect
+    for (size_t i = 199; i > 100; --i) {
+        PoSKernelPSDisconnectTip(&chain[i]);
+        check_tip(i - 1);
+    }
+    for (size_t i = 101; i < num_blocks; ++i) {
+        PoSKernelPSConnectTip(&chain[i]);
+        check_tip(i);
+    }
+
+    // Connecting out of order rebuilds the window
+    PoSKernelPSConnectTip(&chain[150]);
+    check_tip(150);
+}
+
+BOOST_AUTO_TEST_CASE(staking_perf_histogram)
+{
+    StakingPerfHistogram histogram;
+    histogram.Add(-5);
+    histogram.Add(0);
+    histogram.Add(1);
+    histogram.Add(3);
+    histogram.Add(4);
+    histogram.Add(std::numeric_limits<int64_t>::max());
+
+    StakingPerfHistogram::Snapshot snapshot = histogram.GetSnapshot();
+    BOOST_CHECK(snapshot.count == 6);
+    BOOST_CHECK(snapshot.max_us == (uint64_t)std::numeric_limits<int64_t>::max());
+    BOOST_CHECK(snapshot.buckets[0] == 2);
+    BOOST_CHECK(snapshot.buckets[1] == 1);
+    BOOST_CHECK(snapshot.buckets[2] == 1);
+    BOOST_CHECK(snapshot.buckets[3] == 1);
+    BOOST_CHECK(snapshot.buckets[StakingPerfHistogram::NUM_BUCKETS - 1] == 1);
+
+    histogram.Reset();
+    snapshot = histogram.GetSnapshot();
+    BOOST_CHECK(snapshot.count == 0);
+    BOOST_CHECK(snapshot.buckets[0] == 0);
+
+    StakingPerf perf;
+    perf.RecordKernelSearch("", 10, GetTimeMicros());
+    BOOST_CHECK(perf.tip_to_kernel_check.GetSnapshot().count == 0);
+    perf.NotifyTip();
+    perf.RecordKernelSearch("", 10, GetTimeMicros());
+    perf.RecordKernelSearch("", 10, GetTimeMicros());
+    BOOST_CHECK(perf.tip_to_kernel_check.GetSnapshot().count == 1);
+    BOOST_CHECK(perf.kernel_search.GetSnapshot().count == 3);
+    BOOST_CHECK(perf.kernels_evaluated == 30);
+}
+
+BOOST_AUTO_TEST_CASE(block_signature_cache)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CMutableTransaction tx;
+    tx.nVersion = PARTICL_TXN_VERSION;
+    tx.SetType(TXN_COINSTAKE);
+    tx.vin.push_back(CTxIn(COutPoint(InsecureRand256(), 1)));
+    tx.vin[0].scriptWitness.stack.resize(2);
+    tx.vin[0].scriptWitness.stack[1] = ToByteVector(key.GetPubKey());
+    tx.vpout.push_back(MAKE_OUTPUT<CTxOutData>());
+    tx.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>(1 * COIN, CScript() << OP_TRUE));
+    auto pblock = std::make_shared<CBlock>();
+    pblock->vtx.push_back(MakeTransactionRef(tx));
+    BOOST_REQUIRE(pblock->IsProofOfStake());
+    BOOST_REQUIRE(key.Sign(pblock->GetHash(), pblock->vchBlockSig));
+
+    particl::ClearBlockSignatureCache();
+    uint64_t hits = particl::GetBlockSignatureCacheStats().hits;
+    BOOST_CHECK(CheckBlockSignature(*pblock));
+    BOOST_CHECK(CheckBlockSignature(*pblock));
+    BOOST_CHECK(particl::GetBlockSignatureCacheStats().entries == 1);
+    BOOST_CHECK(particl::GetBlockSignatureCacheStats().hits == hits + 1);
+
+    // A cached entry must not validate a different signature
+    CBlock block_bad = *pblock;
+    block_bad.vchBlockSig.back() ^= 1;
+    BOOST_CHECK(!CheckBlockSignature(block_bad));
+    block_bad = *pblock;
+    block_bad.nTime = 1;
+    BOOST_CHECK(!CheckBlockSignature(block_bad));
+
+    // Signatures verified by the worker threads are found by CheckBlockSignature
+    particl::ClearBlockSignatureCache();
+    particl::StartBlockSignatureThreads(2);
+    particl::QueueBlockSignatureCheck(pblock);
+    BOOST_CHECK(CheckBlockSignature(*pblock));
+    particl::StopBlockSignatureThreads();
+    BOOST_CHECK(particl::GetBlockSignatureCacheStats().entries == 1);
+}
+
+BOOST_AUTO_TEST_CASE(spent_coin_cache_test)
+{
+    CSpentCoinCache cache(3);
+    std::vector<std::vector<std::pair<COutPoint, SpentCoin> > > blocks(5);
+    for (int h = 0; h < 5; ++h) {
+        for (uint32_t n = 0; n < 4; ++n) {
+            Coin coin(CTxOut(h * 10 + n, CScript()), h, false);
+            blocks[h].emplace_back(COutPoint(InsecureRand256(), n), SpentCoin(coin, h));
+        }
+    }
+    for (int h = 0; h < 5; ++h) {
+        cache.AddBlock(h, blocks[h]);
+    }
+
+    // Heights 0 and 1 were replaced by 3 and 4
+    SpentCoin spent_coin;
+    BOOST_CHECK(!cache.Get(blocks[0][0].first, spent_coin));
+    BOOST_CHECK(!cache.Get(blocks[1][3].first, spent_coin));
+    BOOST_CHECK(cache.Get(blocks[2][1].first, spent_coin));
+    BOOST_CHECK(spent_coin.spent_height == 2 && spent_coin.coin.out.nValue == 21);
+    CSpentCoinCache::Stats stats = cache.GetStats();
+    BOOST_CHECK(stats.entries == 12 && stats.blocks == 3 && stats.max_blocks == 3);
+
+    // An outpoint spent again at a later height survives its earlier slot being dropped
+    cache.AddBlock(5, {{blocks[3][0].first, SpentCoin(blocks[3][0].second.coin, 5)}});
+    std::vector<COutPoint> outpoints;
+    BOOST_CHECK(!cache.TakeBlock(2, outpoints));
+    BOOST_CHECK(cache.TakeBlock(3, outpoints));
+    BOOST_CHECK(outpoints.size() == 4);
+    BOOST_CHECK(!cache.Get(blocks[3][2].first, spent_coin));
+    BOOST_CHECK(cache.Get(blocks[3][0].first, spent_coin) && spent_coin.spent_height == 5);
+    BOOST_CHECK(cache.Get(blocks[4][2].first, spent_coin));
+
+    cache.Erase(blocks[4][2].first);
+    BOOST_CHECK(!cache.Get(blocks[4][2].first, spent_coin));
+}
+
+BOOST_AUTO_TEST_CASE(output_arena_test)
+{
+    CMutableTransaction txn;
+    txn.nVersion = PARTICL_TXN_VERSION;
+    txn.vin.push_back(CTxIn(GetRandHash(), 0));
+    CScript script_pubkey = CScript() << OP_RETURN;
+    for (size_t i = 0; i < 300; ++i) {
+        switch (i % 4) {
+            case 0:
+                txn.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>(i, script_pubkey));
+                break;
+            case 1: {
+                auto out_ct = MAKE_OUTPUT<CTxOutCT>();
+                out_ct->vData.resize(33, i & 0xFF);
+                out_ct->vRangeproof.resize(600, i & 0xFF);
+                out_ct->scriptPubKey = script_pubkey;
+                txn.vpout.push_back(out_ct);
+                } break;
+            case 2: {
+                auto out_rct = MAKE_OUTPUT<CTxOutRingCT>();
+                out_rct->vData.resize(33, i & 0xFF);
+                txn.vpout.push_back(out_rct);
+                } break;
+            default: {
+                auto out_data = MAKE_OUTPUT<CTxOutData>();
+                out_data->vData.resize(i, i & 0xFF);
+                txn.vpout.push_back(out_data);
+                } break;
+        }
+    }
+    CTransaction tx_from_mutable(txn);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tx_from_mutable;
+    CTransactionRef tx;
+    ss >> tx;
+    BOOST_CHECK(tx->GetHash() == tx_from_mutable.GetHash());
+    BOOST_CHECK(tx->GetHash() == txn.GetHash());
+    BOOST_REQUIRE(tx->vpout.size() == 300);
+
+    // Outputs must stay valid while referenced after the transaction is released
+    CTxOutBaseRef kept_ct = tx->vpout[149];
+    CTxOutBaseRef kept_data = tx->vpout[299];
+    tx.reset();
+    BOOST_CHECK(kept_ct->GetType() == OUTPUT_CT);
+    BOOST_CHECK(kept_ct->GetPRangeproof()->size() == 600);
+    BOOST_CHECK(kept_data->GetType() == OUTPUT_DATA);
+    BOOST_CHECK(kept_data->GetPData()->size() == 299);
+
+    CDataStream ss_bad(SER_NETWORK, PROTOCOL_VERSION);
+    ss_bad << uint8_t(PARTICL_TXN_VERSION) << uint8_t(0) << uint32_t(0);
+    ss_bad << std::vector<CTxIn>();
+    WriteCompactSize(ss_bad, 2);
+    ss_bad << uint8_t(OUTPUT_STANDARD) << CAmount(1) << script_pubkey;
+    ss_bad << uint8_t(0xFF);
+    BOOST_CHECK_THROW(CTransaction(deserialize, ss_bad), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
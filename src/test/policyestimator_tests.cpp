@@ -180,4 +180,51 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BlockPolicyEstimatesByTxType)
+{
+    CBlockPolicyEstimator feeEst;
+    CTxMemPool mpool(&feeEst);
+    LOCK2(cs_main, mpool.cs);
+    TestMemPoolEntryHelper entry;
+    CAmount plainFee(2000), anonFee(20000);
+
+    CScript garbage;
+    for (unsigned int i = 0; i < 128; i++)
+        garbage.push_back('X');
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = garbage;
+    tx.vout.resize(1);
+    tx.vout[0].nValue=0LL;
+    CFeeRate plainRate(plainFee, GetVirtualTransactionSize(CTransaction(tx)));
+    CFeeRate anonRate(anonFee, GetVirtualTransactionSize(CTransaction(tx)));
+    BOOST_CHECK(GetFeeEstimateTxType(entry.FromTx(tx)) == FeeEstimateTxType::PLAIN);
+    tx.vin[0].prevout.n = COutPoint::ANON_MARKER;
+    BOOST_CHECK(GetFeeEstimateTxType(entry.FromTx(tx)) == FeeEstimateTxType::ANON);
+
+    // Every txn is mined in the next block, anon txns pay ten times the plain fee
+    std::vector<CTransactionRef> block;
+    int blocknum = 0;
+    while (blocknum < 20) {
+        for (int k = 0; k < 10; k++) {
+            tx.vin[0].prevout.hash = InsecureRand256();
+            tx.vin[0].prevout.n = 0;
+            mpool.addUnchecked(entry.Fee(plainFee).Time(GetTime()).Height(blocknum).FromTx(tx));
+            block.push_back(mpool.get(tx.GetHash()));
+            tx.vin[0].prevout.n = COutPoint::ANON_MARKER;
+            mpool.addUnchecked(entry.Fee(anonFee).Time(GetTime()).Height(blocknum).FromTx(tx));
+            block.push_back(mpool.get(tx.GetHash()));
+        }
+        mpool.removeForBlock(block, ++blocknum);
+        block.clear();
+    }
+
+    CFeeRate plainEst = feeEst.estimateSmartFee(2, nullptr, false, FeeEstimateTxType::PLAIN);
+    CFeeRate anonEst = feeEst.estimateSmartFee(2, nullptr, false, FeeEstimateTxType::ANON);
+    BOOST_CHECK(std::abs(plainEst.GetFeePerK() - plainRate.GetFeePerK()) < plainRate.GetFeePerK() / 10);
+    BOOST_CHECK(std::abs(anonEst.GetFeePerK() - anonRate.GetFeePerK()) < anonRate.GetFeePerK() / 10);
+    BOOST_CHECK(feeEst.estimateSmartFee(2, nullptr, false, FeeEstimateTxType::BLIND) == CFeeRate(0));
+    BOOST_CHECK(feeEst.estimateSmartFee(2, nullptr, false, FeeEstimateTxType::ALL) != CFeeRate(0));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,8 +5,16 @@
 #include <test/util/setup_common.h>
 #include <test/data/ringct.json.h>
 
+#include <anon.h>
+#include <coins.h>
 #include <crypto/sha256.h>
 #include <key/stealth.h>
+#include <random.h>
+#include <rctindex.h>
+#include <rctkeyimagefilter.h>
+#include <rctoutputcache.h>
+#include <rctoutputfile.h>
+#include <txdb.h>
 #include <util/strencodings.h>
 
 #include <secp256k1.h>
@@ -761,4 +769,288 @@ BOOST_AUTO_TEST_CASE(ringct_test_deterministic)
     secp256k1_context_destroy(ctx);
 }
 
+static CAnonOutput MakeTestAnonOutput(int64_t i)
+{
+    std::vector<uint8_t> pk(33);
+    pk[0] = 0x02;
+    GetRandBytes({pk.data() + 1, 32});
+    CAnonOutput ao;
+    ao.pubkey = CCmpPubKey(pk);
+    ao.commitment.data[0] = 0x08;
+    GetRandBytes({ao.commitment.data + 1, 32});
+    ao.outpoint = COutPoint(InsecureRand256(), (uint32_t)i);
+    ao.nBlockHeight = (int)i * 3;
+    ao.nCompromised = i % 2;
+    return ao;
+}
+
+static bool AnonOutputsEqual(const CAnonOutput &a, const CAnonOutput &b)
+{
+    return a.pubkey == b.pubkey &&
+           memcmp(a.commitment.data, b.commitment.data, 33) == 0 &&
+           a.outpoint == b.outpoint &&
+           a.nBlockHeight == b.nBlockHeight &&
+           a.nCompromised == b.nCompromised;
+}
+
+BOOST_AUTO_TEST_CASE(rct_output_file_test)
+{
+    fs::path dir = m_args.GetDataDirBase() / "rct";
+    // Span the first file boundary
+    const int64_t n = CRCTOutputFile::RECORDS_PER_FILE + 8;
+    std::vector<CAnonOutput> outputs;
+    outputs.emplace_back();
+    for (int64_t i = 1; i <= n; ++i) {
+        outputs.push_back(MakeTestAnonOutput(i));
+    }
+
+    CAnonOutput ao;
+    {
+        CRCTOutputFile table(dir, 0);
+        BOOST_CHECK(!table.Read(1, ao));
+        BOOST_CHECK(!table.Write(2, outputs[2])); // Would leave a gap
+        BOOST_CHECK(!table.Write(0, outputs[1]));
+        for (int64_t i = 1; i <= n; ++i) {
+            BOOST_REQUIRE(table.Write(i, outputs[i]));
+        }
+        BOOST_CHECK(table.GetLastIndex() == n);
+        BOOST_CHECK(table.Flush());
+
+        table.Truncate(n - 4);
+        BOOST_CHECK(table.GetLastIndex() == n - 4);
+        BOOST_CHECK(!table.Read(n - 3, ao));
+        BOOST_CHECK(table.Read(n - 4, ao));
+        BOOST_CHECK(AnonOutputsEqual(ao, outputs[n - 4]));
+
+        // Truncate never raises the last index
+        table.Truncate(n);
+        BOOST_CHECK(table.GetLastIndex() == n - 4);
+
+        // Rewrite a row after rolling back
+        outputs[n - 3] = MakeTestAnonOutput(n - 3);
+        BOOST_CHECK(table.Write(n - 3, outputs[n - 3]));
+        BOOST_CHECK(table.GetLastIndex() == n - 3);
+        BOOST_CHECK(table.Flush());
+    }
+
+    // Reopen with the persisted last index
+    CRCTOutputFile table(dir, n - 3);
+    BOOST_CHECK(table.GetLastIndex() == n - 3);
+    for (int64_t i = 1; i <= n - 3; ++i) {
+        BOOST_REQUIRE(table.Read(i, ao));
+        BOOST_CHECK(AnonOutputsEqual(ao, outputs[i]));
+    }
+    BOOST_CHECK(!table.Read(n - 2, ao));
+}
+
+BOOST_AUTO_TEST_CASE(rct_output_cache_test)
+{
+    // One entry per shard
+    CRCTOutputCache cache(CRCTOutputCache::NUM_SHARDS);
+    const int64_t shards = CRCTOutputCache::NUM_SHARDS;
+    CAnonOutput ao;
+    CAnonOutput ao1 = MakeTestAnonOutput(1);
+    CAnonOutput ao2 = MakeTestAnonOutput(1 + shards);
+
+    BOOST_CHECK(!cache.Get(1, ao));
+    cache.Put(1, ao1);
+    BOOST_CHECK(cache.Get(1, ao));
+    BOOST_CHECK(AnonOutputsEqual(ao, ao1));
+
+    // Same shard, evicts the older entry
+    cache.Put(1 + shards, ao2);
+    BOOST_CHECK(!cache.Get(1, ao));
+    BOOST_CHECK(cache.Get(1 + shards, ao));
+    BOOST_CHECK(AnonOutputsEqual(ao, ao2));
+
+    // Other shards are untouched
+    cache.Put(2, ao1);
+    BOOST_CHECK(cache.Get(1 + shards, ao));
+    BOOST_CHECK(cache.Get(2, ao));
+
+    cache.Erase(2);
+    BOOST_CHECK(!cache.Get(2, ao));
+
+    CRCTOutputCache::Stats stats = cache.GetStats();
+    BOOST_CHECK(stats.entries == 1);
+    BOOST_CHECK(stats.max_entries == CRCTOutputCache::NUM_SHARDS);
+    BOOST_CHECK(stats.hits == 4);
+    BOOST_CHECK(stats.misses == 3);
+
+    cache.Clear();
+    BOOST_CHECK(cache.GetStats().entries == 0);
+}
+
+BOOST_AUTO_TEST_CASE(rct_key_image_filter_test)
+{
+    CRCTKeyImageFilter filter(16);
+    std::vector<CCmpPubKey> inserted, others;
+    for (size_t i = 0; i < 1000; ++i) {
+        inserted.push_back(MakeTestAnonOutput(i).pubkey);
+        others.push_back(MakeTestAnonOutput(i).pubkey);
+    }
+    for (const auto &ki : inserted) {
+        filter.Insert(ki);
+    }
+
+    // Everything may be present until the filter is complete
+    BOOST_CHECK(!filter.IsReady());
+    for (const auto &ki : others) {
+        BOOST_CHECK(filter.MaybeContains(ki));
+    }
+
+    filter.SetReady();
+    for (const auto &ki : inserted) {
+        BOOST_CHECK(filter.MaybeContains(ki));
+    }
+    size_t false_positives = 0;
+    for (const auto &ki : others) {
+        if (filter.MaybeContains(ki)) {
+            false_positives++;
+        }
+    }
+    BOOST_CHECK(false_positives < 10);
+}
+
+BOOST_AUTO_TEST_CASE(rct_key_image_height_index_test)
+{
+    CBlockTreeDB block_tree_db(1 << 20, true);
+    std::vector<CCmpPubKey> key_images;
+    CDBBatch batch(block_tree_db);
+    for (int i = 0; i < 20; ++i) {
+        key_images.push_back(MakeTestAnonOutput(i).pubkey);
+        block_tree_db.WriteRCTKeyImage(batch, key_images.back(), CAnonKeyImageInfo(InsecureRand256(), 100 + i));
+    }
+    BOOST_REQUIRE(block_tree_db.WriteBatch(batch));
+
+    CAnonKeyImageInfo ki_data;
+    BOOST_CHECK(block_tree_db.EraseRCTKeyImage(key_images[2]));
+    BOOST_CHECK(!block_tree_db.ReadRCTKeyImage(key_images[2], ki_data));
+
+    // Removes heights 110 and above
+    BOOST_CHECK(block_tree_db.EraseRCTKeyImagesAfterHeight(109));
+    for (int i = 0; i < 20; ++i) {
+        BOOST_CHECK(block_tree_db.ReadRCTKeyImage(key_images[i], ki_data) == (i < 10 && i != 2));
+    }
+
+    size_t num_indexed = 0;
+    BOOST_CHECK(block_tree_db.RebuildRCTKeyImageHeightIndex(num_indexed));
+    BOOST_CHECK(num_indexed == 9);
+    BOOST_CHECK(block_tree_db.EraseRCTKeyImagesAfterHeight(104));
+    for (int i = 0; i < 20; ++i) {
+        BOOST_CHECK(block_tree_db.ReadRCTKeyImage(key_images[i], ki_data) == (i < 5 && i != 2));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rct_output_links_test)
+{
+    CBlockTreeDB block_tree_db(1 << 20, true);
+    std::vector<CCmpPubKey> pks;
+    for (int64_t i = 1; i <= 6; ++i) {
+        pks.push_back(MakeTestAnonOutput(i).pubkey);
+        if (i % 2 == 0) {
+            BOOST_REQUIRE(block_tree_db.WriteRCTOutputLink(pks.back(), i));
+        }
+    }
+    pks.push_back(pks[1]);
+
+    std::vector<int64_t> indices;
+    block_tree_db.ReadRCTOutputLinks(pks, indices);
+    BOOST_REQUIRE(indices.size() == pks.size());
+    for (size_t i = 0; i < 6; ++i) {
+        BOOST_CHECK(indices[i] == (i % 2 == 1 ? (int64_t)i + 1 : -1));
+    }
+    BOOST_CHECK(indices[6] == 2);
+}
+
+BOOST_AUTO_TEST_CASE(rct_bulk_load_test)
+{
+    CBlockTreeDB block_tree_db(1 << 20, true);
+    block_tree_db.SetRCTBulkLoad(true);
+    BOOST_CHECK(block_tree_db.IsRCTBulkLoad());
+
+    CDBBatch batch(block_tree_db);
+    for (int64_t i = 1; i <= 10; ++i) {
+        CAnonOutput ao = MakeTestAnonOutput(i);
+        block_tree_db.WriteRCTOutput(batch, i, ao);
+        block_tree_db.WriteRCTOutputLink(batch, ao.pubkey, i);
+        block_tree_db.WriteRCTKeyImage(batch, ao.pubkey, CAnonKeyImageInfo(InsecureRand256(), 100 + i));
+    }
+    // Rows are buffered, not added to the batch
+    BOOST_CHECK(batch.SizeEstimate() == 0);
+
+    CAnonOutput ao;
+    int64_t index;
+    CAnonKeyImageInfo ki_data;
+    CCmpPubKey pk3 = MakeTestAnonOutput(3).pubkey;
+    BOOST_CHECK(block_tree_db.ReadRCTOutput(3, ao) && ao.pubkey == pk3);
+    BOOST_CHECK(block_tree_db.ReadRCTOutputLink(pk3, index) && index == 3);
+    BOOST_CHECK(block_tree_db.ReadRCTKeyImage(pk3, ki_data) && ki_data.height == 103);
+
+    // Erasing writes the buffered rows first
+    BOOST_CHECK(block_tree_db.EraseRCTKeyImage(pk3));
+    BOOST_CHECK(!block_tree_db.ReadRCTKeyImage(pk3, ki_data));
+    BOOST_CHECK(block_tree_db.EraseRCTKeyImagesAfterHeight(105));
+
+    block_tree_db.SetRCTBulkLoad(false);
+    BOOST_CHECK(!block_tree_db.IsRCTBulkLoad());
+    for (int64_t i = 1; i <= 10; ++i) {
+        CCmpPubKey pk = MakeTestAnonOutput(i).pubkey;
+        BOOST_CHECK(block_tree_db.ReadRCTOutput(i, ao) && ao.pubkey == pk);
+        BOOST_CHECK(block_tree_db.ReadRCTOutputLink(pk, index) && index == i);
+        BOOST_CHECK(block_tree_db.ReadRCTKeyImage(pk, ki_data) == (i <= 5 && i != 3));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rct_prefetch_anon_inputs_test)
+{
+    CBlockTreeDB block_tree_db(1 << 20, true);
+    for (int64_t i = 1; i <= 8; ++i) {
+        BOOST_REQUIRE(block_tree_db.WriteRCTOutput(i, MakeTestAnonOutput(i)));
+    }
+
+    const size_t ring_size = 3;
+    CMutableTransaction txn;
+    txn.nVersion = PARTICL_TXN_VERSION;
+    txn.vin.resize(1);
+    txn.vin[0].prevout.n = COutPoint::ANON_MARKER;
+    txn.vin[0].SetAnonInfo(1, ring_size);
+    std::vector<uint8_t> vMI;
+    for (size_t i = 0; i < ring_size; ++i) {
+        part::PutVarInt(vMI, 1 + i * 2);
+    }
+    txn.vin[0].scriptWitness.stack = {vMI, std::vector<uint8_t>()};
+
+    PrefetchAnonInputs(block_tree_db, CTransaction(txn));
+    CRCTOutputCache::Stats stats;
+    BOOST_REQUIRE(block_tree_db.GetRCTOutputCacheStats(stats));
+    BOOST_CHECK(stats.entries == ring_size);
+    BOOST_CHECK(stats.misses == ring_size);
+
+    CAnonOutput ao;
+    BOOST_CHECK(block_tree_db.ReadRCTOutput(1, ao));
+    BOOST_REQUIRE(block_tree_db.GetRCTOutputCacheStats(stats));
+    BOOST_CHECK(stats.hits == 1);
+}
+
+BOOST_AUTO_TEST_CASE(rct_view_memory_usage_test)
+{
+    CCoinsView view_dummy;
+    CCoinsViewCache view(&view_dummy);
+    size_t usage_empty = view.DynamicMemoryUsage();
+
+    for (int64_t i = 1; i <= 100; ++i) {
+        CAnonOutput ao = MakeTestAnonOutput(i);
+        view.anonOutputLinks[ao.pubkey] = i;
+        view.anonOutputs.push_back(std::make_pair(i, ao));
+        view.keyImages[ao.pubkey] = ao.outpoint.hash;
+    }
+    size_t usage_rct = view.DynamicMemoryUsage();
+    BOOST_CHECK(usage_rct > usage_empty + 100 * (sizeof(CAnonOutput) + 2 * sizeof(CCmpPubKey)));
+
+    Coin coin(CTxOut(1, CScript() << std::vector<uint8_t>(100, 0x01)), 1, false);
+    view.spent_cache.push_back(std::make_pair(COutPoint(InsecureRand256(), 0), SpentCoin(coin, 2)));
+    BOOST_CHECK(view.DynamicMemoryUsage() >= usage_rct + sizeof(SpentCoin) + coin.DynamicMemoryUsage());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
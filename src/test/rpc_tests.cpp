@@ -243,6 +243,27 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_THROW(ParseNonRFCJSONValue("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_concurrent)
+{
+    BOOST_CHECK(tableRPC.isBatchConcurrent("getblockcount"));
+    BOOST_CHECK(!tableRPC.isBatchConcurrent("setban"));
+    BOOST_CHECK(!tableRPC.isBatchConcurrent("nonexistentmethod"));
+
+    if (RPCIsInWarmup(nullptr)) SetRPCWarmupFinished();
+    JSONRPCRequest jreq;
+    jreq.context = &m_node;
+    UniValue batch;
+    BOOST_REQUIRE(batch.read(R"([{"method":"getblockcount","id":1},{"method":"getbestblockhash","id":2},)"
+                             R"({"method":"uptime","id":3},{"method":"getblockcount","id":4},{"id":5}])"));
+    UniValue reply;
+    BOOST_REQUIRE(reply.read(JSONRPCExecBatch(jreq, batch)));
+    BOOST_REQUIRE_EQUAL(reply.size(), 5U);
+    for (size_t i = 0; i < reply.size(); ++i) {
+        BOOST_CHECK_EQUAL(find_value(reply[i], "id").getInt<int>(), (int)i + 1);
+        BOOST_CHECK_EQUAL(find_value(reply[i], "error").isNull(), i < 4);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(rpc_ban)
 {
     BOOST_CHECK_NO_THROW(CallRPC(std::string("clearbanned")));
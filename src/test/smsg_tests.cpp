@@ -3,8 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <smsg/smessage.h>
+#include <smsg/bucketfile.h>
 
 #include <test/util/setup_common.h>
+#include <minisketch.h>
+#include <timedata.h>
+#include <validation.h>
 #include <net.h>
 #include <xxhash/xxhash.h>
 #ifdef ENABLE_WALLET
@@ -38,6 +42,261 @@ BOOST_AUTO_TEST_CASE(smsg_test_ckeyId_inits_null)
     BOOST_CHECK(k.IsNull());
 }
 
+BOOST_AUTO_TEST_CASE(smsg_test_bucket_file_reader)
+{
+    fs::path path = m_args.GetDataDirNet() / "test_01.dat";
+    std::vector<uint8_t> file_data;
+    for (uint32_t n_payload : {8, 0, 20}) {
+        smsg::SecureMessage smsg;
+        smsg.timestamp = 1000 + n_payload;
+        smsg.nPayload = n_payload;
+        std::vector<uint8_t> record(smsg::SMSG_HDR_LEN + n_payload, (uint8_t)n_payload);
+        smsg.WriteHeader(record.data());
+        file_data.insert(file_data.end(), record.begin(), record.end());
+    }
+    size_t last_offset = file_data.size();
+    // Truncated record
+    file_data.insert(file_data.end(), file_data.begin(), file_data.begin() + smsg::SMSG_HDR_LEN + 4);
+
+    FILE *fp = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(fp);
+    BOOST_REQUIRE(fwrite(file_data.data(), 1, file_data.size(), fp) == file_data.size());
+    fclose(fp);
+
+    smsg::BucketFileReader file(path);
+    BOOST_REQUIRE(file.IsOpen());
+    smsg::SecureMessage smsg;
+    const uint8_t *pHeader, *pPayload;
+    size_t ofs, expect_ofs = 0;
+    for (uint32_t n_payload : {8, 0, 20}) {
+        BOOST_REQUIRE(file.Next(smsg, pHeader, pPayload, ofs));
+        BOOST_CHECK(ofs == expect_ofs);
+        BOOST_CHECK(smsg.nPayload == n_payload);
+        BOOST_CHECK(smsg.timestamp == 1000 + n_payload);
+        BOOST_CHECK(pPayload == pHeader + smsg::SMSG_HDR_LEN);
+        BOOST_CHECK(n_payload == 0 || pPayload[n_payload - 1] == n_payload);
+        expect_ofs += smsg::SMSG_HDR_LEN + n_payload;
+    }
+    BOOST_CHECK(expect_ofs == last_offset);
+    BOOST_CHECK(!file.Next(smsg, pHeader, pPayload, ofs));
+
+    BOOST_CHECK(!smsg::BucketFileReader(m_args.GetDataDirNet() / "missing_01.dat").IsOpen());
+}
+
+BOOST_AUTO_TEST_CASE(smsg_test_token_set)
+{
+    int64_t now = GetAdjustedTime();
+    int64_t bucket_time = now - (now % smsg::SMSG_BUCKET_LEN);
+    std::vector<smsg::SecMsgToken> tokens;
+    for (int i = 0; i < 20; ++i) {
+        uint8_t sample[8] = {0};
+        sample[0] = i;
+        tokens.emplace_back(bucket_time + (i / 2), sample, 8, i, 3600);
+    }
+
+    smsg::SecMsgTokenSet set_inserted, set_appended;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        // Out of order
+        BOOST_CHECK(set_inserted.insert(tokens[(i * 7) % tokens.size()]).second);
+    }
+    BOOST_CHECK(!set_inserted.insert(tokens[3]).second);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        set_appended.append(tokens[tokens.size() - 1 - i]);
+    }
+    set_appended.append(tokens[5]);
+    set_appended.merge();
+    BOOST_REQUIRE(set_inserted.size() == tokens.size());
+    BOOST_REQUIRE(set_appended.size() == tokens.size());
+    BOOST_CHECK(std::is_sorted(set_inserted.begin(), set_inserted.end()));
+    BOOST_CHECK(std::equal(set_inserted.begin(), set_inserted.end(), set_appended.begin(), [](const smsg::SecMsgToken &a, const smsg::SecMsgToken &b) {
+        return a.offset == b.offset;
+    }));
+
+    BOOST_CHECK(set_inserted.find(tokens[11])->offset == 11);
+    smsg::SecMsgToken missing = tokens[11];
+    missing.sample[1] = 1;
+    BOOST_CHECK(set_inserted.find(missing) == set_inserted.end());
+    auto range = set_inserted.equal_range(bucket_time + 3);
+    BOOST_CHECK(std::distance(range.first, range.second) == 2);
+    BOOST_CHECK(range.first->offset == 6);
+    range = set_inserted.equal_range(bucket_time + 100);
+    BOOST_CHECK(range.first == range.second);
+
+    // Incremental hash matches the full recomputation
+    smsg::SecMsgBucket bucket, bucket_full;
+    for (const auto &token : tokens) {
+        BOOST_CHECK(bucket.AddToken(token, now));
+        bucket_full.setTokens.append(token);
+    }
+    BOOST_CHECK(!bucket.AddToken(tokens[0], now));
+    bucket.ExpireToken(*bucket.setTokens.find(tokens[4]), now);
+    bucket_full.setTokens.merge();
+    bucket_full.ExpireToken(*bucket_full.setTokens.find(tokens[4]), now);
+    bucket_full.hashBucket(bucket_time);
+    BOOST_CHECK(bucket.nActive == tokens.size() - 1);
+    BOOST_CHECK(bucket.hash == bucket_full.hash);
+    BOOST_CHECK(bucket.nActive == bucket_full.nActive);
+    BOOST_CHECK(bucket.m_next_expiry == bucket_time + 3600);
+
+    // Peers before SMSG_VERSION_TOKEN_HASH get the ordered hash
+    XXH32_state_t *state = XXH32_createState();
+    XXH32_reset(state, 1);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (i != 4) {
+            XXH32_update(state, tokens[i].sample, 8);
+        }
+    }
+    BOOST_CHECK(bucket.GetHash(smsg::SMSG_VERSION_SKETCH) == XXH32_digest(state));
+    BOOST_CHECK(bucket.GetHash(smsg::SMSG_VERSION_TOKEN_HASH) == bucket.hash);
+    XXH32_freeState(state);
+}
+
+BOOST_AUTO_TEST_CASE(smsg_test_token_sketch)
+{
+    int64_t bucket_time = 1000000, now = bucket_time + 10;
+    smsg::SecMsgTokenSet tokens_a, tokens_b;
+    std::set<uint32_t> expect_diff;
+    for (int i = 0; i < 100; ++i) {
+        uint8_t sample[8];
+        memcpy(sample, &i, sizeof(i));
+        memset(sample + 4, 0, 4);
+        smsg::SecMsgToken token(bucket_time + i, sample, 8, 0, 3600);
+        if (i % 10 != 0) {
+            tokens_a.insert(token);
+        }
+        if (i % 15 != 0) {
+            tokens_b.insert(token);
+        }
+        if ((i % 10 == 0) != (i % 15 == 0)) {
+            expect_diff.insert(smsg::GetTokenShortId(bucket_time, token));
+        }
+    }
+    // Expired tokens are left out of the sketch
+    uint8_t sample[8] = {0xff};
+    tokens_a.insert(smsg::SecMsgToken(bucket_time - 7200, sample, 8, 0, 3600));
+
+    uint32_t n_a, n_b;
+    Minisketch sketch_a = smsg::MakeTokenSketch(bucket_time, tokens_a, 16, now, n_a);
+    Minisketch sketch_b = smsg::MakeTokenSketch(bucket_time, tokens_b, 16, now, n_b);
+    BOOST_CHECK(n_a == 90);
+    BOOST_CHECK(n_b == 93);
+
+    sketch_a.Merge(sketch_b);
+    std::optional<std::vector<uint64_t> > diff = sketch_a.Decode(16);
+    BOOST_REQUIRE(diff.has_value());
+    BOOST_CHECK(std::set<uint32_t>(diff->begin(), diff->end()) == expect_diff);
+
+    // Too many differences for the capacity
+    Minisketch sketch_small = smsg::MakeTokenSketch(bucket_time, tokens_a, 4, now, n_a);
+    sketch_small.Merge(smsg::MakeTokenSketch(bucket_time, smsg::SecMsgTokenSet(), 4, now, n_b));
+    BOOST_CHECK(!sketch_small.Decode(4).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(smsg_test_db_indexes)
+{
+    smsg::SecMsgDB db;
+    BOOST_REQUIRE(db.Open("cw"));
+    BOOST_REQUIRE(db.BuildIndexes());
+
+    CKeyID addr_a, addr_b;
+    memset(addr_a.begin(), 0xaa, 20);
+    memset(addr_b.begin(), 0xbb, 20);
+
+    // msgid is timestamp|hash, keys sort by the last timestamp byte here
+    auto make_key = [](uint8_t *chKey, int n) {
+        memcpy(chKey, smsg::DBK_INBOX.data(), 2);
+        memset(chKey + 2, 0, 8);
+        chKey[9] = n;
+        memset(chKey + 10, n, 20);
+    };
+
+    uint8_t chKey[30];
+    smsg::SecMsgStored stored;
+    stored.timeReceived = 1;
+    stored.folderId = 0;
+    stored.vchMessage.resize(4);
+    db.TxnBegin();
+    for (int i = 0; i < 10; ++i) {
+        make_key(chKey, i);
+        stored.status = (i % 2) ? SMSG_MASK_UNREAD : 0;
+        stored.addrTo = i < 4 ? addr_a : addr_b;
+        BOOST_CHECK(db.WriteSmesg(chKey, stored));
+    }
+    // Deltas of an open batch are visible
+    BOOST_CHECK_EQUAL(db.GetCount(smsg::DBK_INBOX, false), 10U);
+    BOOST_CHECK(db.TxnCommit());
+    BOOST_CHECK_EQUAL(db.GetCount(smsg::DBK_INBOX, false), 10U);
+    BOOST_CHECK_EQUAL(db.GetCount(smsg::DBK_INBOX, true), 5U);
+
+    // Mark one read, erase one unread and one read message
+    make_key(chKey, 1);
+    BOOST_CHECK(db.ReadSmesg(chKey, stored));
+    stored.status &= ~SMSG_MASK_UNREAD;
+    BOOST_CHECK(db.WriteSmesg(chKey, stored));
+    make_key(chKey, 3);
+    BOOST_CHECK(db.EraseSmesg(chKey));
+    make_key(chKey, 4);
+    BOOST_CHECK(db.EraseSmesg(chKey));
+    BOOST_CHECK_EQUAL(db.GetCount(smsg::DBK_INBOX, false), 8U);
+    BOOST_CHECK_EQUAL(db.GetCount(smsg::DBK_INBOX, true), 3U);
+
+    auto list = [&](const std::string &prefix, const uint8_t *from) {
+        std::vector<int> rv;
+        leveldb::Iterator *it = db.pdb->NewIterator(leveldb::ReadOptions());
+        while (db.NextIndexKey(it, prefix, smsg::DBK_INBOX, from, chKey)) {
+            rv.push_back(chKey[9]);
+        }
+        delete it;
+        return rv;
+    };
+    BOOST_CHECK(list(smsg::DBK_INDEX_UNREAD + smsg::DBK_INBOX, nullptr) == std::vector<int>({5, 7, 9}));
+    std::string prefix_a = smsg::DBK_INDEX_ADDRESS + smsg::DBK_INBOX + std::string((const char*)addr_a.begin(), 20);
+    BOOST_CHECK(list(prefix_a, nullptr) == std::vector<int>({0, 1, 2}));
+    make_key(chKey, 5);
+    uint8_t from[28];
+    memcpy(from, chKey + 2, 28);
+    BOOST_CHECK(list(smsg::DBK_INBOX, from) == std::vector<int>({6, 7, 8, 9}));
+
+    // A rebuild must reproduce the counters
+    BOOST_CHECK(db.pdb->Delete(leveldb::WriteOptions(), smsg::DBK_INDEX_VERSION).ok());
+    BOOST_CHECK(db.BuildIndexes());
+    BOOST_CHECK_EQUAL(db.GetCount(smsg::DBK_INBOX, false), 8U);
+    BOOST_CHECK_EQUAL(db.GetCount(smsg::DBK_INBOX, true), 3U);
+    BOOST_CHECK(list(prefix_a, nullptr) == std::vector<int>({0, 1, 2}));
+
+    LOCK(smsg::cs_smsgDB);
+    delete smsg::smsgDB;
+    smsg::smsgDB = nullptr;
+}
+
+BOOST_AUTO_TEST_CASE(smsg_test_pow_threads)
+{
+    std::vector<uint8_t> payload(100, 0x5a);
+    arith_uint256 target;
+    int64_t now = GetTime();
+    {
+        LOCK(cs_main);
+        target.SetCompact(particl::GetSmsgDifficulty(*m_node.chainman, now));
+    }
+
+    smsg::fSecMsgEnabled = true;
+    for (int num_threads : {1, 3}) {
+        smsg::SecureMessage smsg;
+        smsg.timestamp = now;
+        smsg.nPayload = payload.size();
+        memset(smsg.nonce, 0, 4);
+        smsgModule.m_pow_threads = num_threads;
+        BOOST_CHECK(smsgModule.SetHash(&smsg, payload.data(), payload.size()) == smsg::SMSG_NO_ERROR);
+
+        uint256 msg_hash;
+        BOOST_CHECK(smsgModule.GetPowHash(&smsg, payload.data(), payload.size(), msg_hash));
+        BOOST_CHECK(UintToArith256(msg_hash) <= target);
+        BOOST_CHECK(memcmp(smsg.hash, msg_hash.begin(), 4) == 0);
+    }
+    smsg::fSecMsgEnabled = false;
+    smsgModule.m_pow_threads = smsg::SMSG_DEFAULT_POW_THREADS;
+}
+
 #ifdef ENABLE_WALLET
 
 void CheckValid(smsg::SecureMessage &smsg, CKeyID &kFrom, CKeyID &kTo, bool expect_pass)
@@ -10,9 +10,11 @@
 #include <script/signingprovider.h>
 #include <test/util/setup_common.h>
 #include <util/strencodings.h>
+#include <util/time.h>
 
 #include <serialize.h>
 #include <streams.h>
+#include <set>
 #include <string>
 
 #include <boost/test/unit_test.hpp>
@@ -235,4 +237,137 @@ BOOST_AUTO_TEST_CASE(stealth_key)
     ECC_Stop_Stealth();
 }
 
+BOOST_AUTO_TEST_CASE(stealth_scanner)
+{
+    SeedInsecureRand();
+    FillableSigningProvider keystore;
+
+    ECC_Start_Stealth();
+
+    // Addresses 4 to 7 reuse the scan secrets of 0 to 3
+    std::vector<CStealthAddress> addresses(8);
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        makeNewStealthKey(addresses[i], keystore);
+        if (i >= 4) {
+            addresses[i].scan_secret = addresses[i - 4].scan_secret;
+            addresses[i].scan_pubkey = addresses[i - 4].scan_pubkey;
+        }
+        addresses[i].prefix.number_bits = i % 2 ? 4 : 0;
+        addresses[i].prefix.bitfield = i;
+    }
+
+    CStealthScanner scanner;
+    for (const auto &sx : addresses) {
+        BOOST_CHECK(scanner.AddKey(sx.scan_secret, sx.spend_pubkey, sx.prefix.number_bits, sx.prefix.bitfield));
+    }
+    BOOST_CHECK(!scanner.AddKey(addresses[0].scan_secret, ec_point(EC_COMPRESSED_SIZE, 0), 0, 0));
+    BOOST_CHECK_EQUAL(scanner.size(), addresses.size());
+
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        const CStealthAddress &sx = addresses[i];
+        CKey sEphem, secretShared;
+        ec_point pkSendTo;
+        int k, nTries = 24;
+        for (k = 0; k < nTries; ++k) {
+            InsecureNewKey(sEphem, true);
+            if (StealthSecret(sEphem, sx.scan_pubkey, sx.spend_pubkey, secretShared, pkSendTo) == 0)
+                break;
+        }
+        BOOST_REQUIRE_MESSAGE(k < nTries, "StealthSecret failed.");
+
+        ec_point ephem_pubkey;
+        SecretToPublicKey(sEphem, ephem_pubkey);
+        CKeyID id = CPubKey(pkSendTo).GetID();
+        uint32_t prefix = sx.prefix.bitfield;
+
+        CKey secretShared_verify;
+        BOOST_CHECK_EQUAL(scanner.Match(ephem_pubkey, prefix, true, id, secretShared_verify), (int)i);
+        BOOST_CHECK(secretShared == secretShared_verify);
+
+        // Prefixed addresses are not matched without the output prefix
+        CKey sShared;
+        BOOST_CHECK_EQUAL(scanner.Match(ephem_pubkey, prefix ^ 0xf, true, id, sShared), i % 2 ? CStealthScanner::NO_MATCH : (int)i);
+        BOOST_CHECK_EQUAL(scanner.Match(ephem_pubkey, 0, false, id, sShared), i % 2 ? CStealthScanner::NO_MATCH : (int)i);
+
+        BOOST_CHECK_EQUAL(scanner.Match(ephem_pubkey, prefix, true, CKeyID(), sShared), CStealthScanner::NO_MATCH);
+    }
+    CKey sShared;
+    BOOST_CHECK_EQUAL(scanner.Match(ec_point(EC_COMPRESSED_SIZE, 0), 0, false, CKeyID(), sShared), CStealthScanner::MATCH_FAILED);
+
+    scanner.clear();
+    BOOST_CHECK(scanner.empty());
+
+    ECC_Stop_Stealth();
+}
+
+BOOST_AUTO_TEST_CASE(ephemeral_key_pool)
+{
+    // Keys are generated inline while the pool is not running
+    CKey key;
+    CPubKey pubkey;
+    GetEphemeralKey(key, pubkey);
+    BOOST_CHECK(key.IsValid() && key.IsCompressed());
+    BOOST_CHECK(key.GetPubKey() == pubkey);
+    BOOST_CHECK_EQUAL(GetEphemeralKeyPoolSize(), 0U);
+
+    StartEphemeralKeyPool(32);
+    for (int i = 0; i < 100 && GetEphemeralKeyPoolSize() < 32; ++i) {
+        UninterruptibleSleep(std::chrono::milliseconds{20});
+    }
+    BOOST_CHECK_EQUAL(GetEphemeralKeyPoolSize(), 32U);
+
+    // Each pair is handed out once
+    std::set<CPubKey> seen;
+    for (size_t i = 0; i < 64; ++i) {
+        GetEphemeralKey(key, pubkey);
+        BOOST_CHECK(key.GetPubKey() == pubkey);
+        BOOST_CHECK(seen.insert(pubkey).second);
+    }
+
+    StopEphemeralKeyPool();
+    BOOST_CHECK_EQUAL(GetEphemeralKeyPoolSize(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(stealth_prefix_index)
+{
+    std::set<CStealthAddress> addresses;
+    for (size_t i = 0; i < 16; ++i) {
+        CStealthAddress sx;
+        sx.scan_pubkey.resize(EC_COMPRESSED_SIZE, 0);
+        sx.scan_pubkey[1] = i;
+        sx.prefix.number_bits = i % 4 == 0 ? 0 : (i % 4) * 4;
+        sx.prefix.bitfield = i * 0x01010101;
+        addresses.insert(sx);
+    }
+
+    CStealthPrefixIndex index;
+    for (const auto &sx : addresses) {
+        index.Add(&sx);
+    }
+    BOOST_CHECK_EQUAL(index.size(), addresses.size());
+
+    // Candidates must be exactly the addresses MatchStealthPrefix accepts
+    for (uint32_t prefix : {0x00000000u, 0x05050505u, 0x0a0a0a0au, 0x0f0f0f0fu, 0xdeadbeefu}) {
+        for (bool have_prefix : {true, false}) {
+            std::vector<const CStealthAddress*> candidates;
+            index.GetCandidates(prefix, have_prefix, candidates);
+            std::set<const CStealthAddress*> got(candidates.begin(), candidates.end());
+            BOOST_CHECK_EQUAL(got.size(), candidates.size());
+
+            std::set<const CStealthAddress*> expect;
+            for (const auto &sx : addresses) {
+                if (MatchStealthPrefix(sx.prefix.number_bits, sx.prefix.bitfield, prefix, have_prefix)) {
+                    expect.insert(&sx);
+                }
+            }
+            BOOST_CHECK(got == expect);
+        }
+    }
+
+    for (const auto &sx : addresses) {
+        index.Remove(&sx);
+    }
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
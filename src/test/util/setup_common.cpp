@@ -44,6 +44,7 @@
 #include <walletinitinterface.h>
 
 // Particl
+#include <blind.h>
 #include <insight/insight.h>
 #include <smsg/smessage.h>
 #include <smsg/manager.h>
@@ -154,6 +155,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName, const std::ve
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitRangeProofCache();
     m_node.chain = interfaces::MakeChain(m_node);
     fCheckBlockIndex = true;
 
@@ -91,4 +91,61 @@ BOOST_AUTO_TEST_CASE(unregister_all_during_call)
     BOOST_CHECK(destroyed);
 }
 
+struct TestOwnQueue final : public CValidationInterface {
+    std::function<void(const CBlockLocator&)> m_on_flushed;
+    void ChainStateFlushed(const CBlockLocator& locator) override { m_on_flushed(locator); }
+};
+
+BOOST_FIXTURE_TEST_CASE(own_queues_run_concurrently, BasicTestingSetup)
+{
+    CScheduler scheduler;
+    scheduler.m_service_thread = std::thread([&] { scheduler.serviceQueue(); });
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler, /*parallel_threads=*/2);
+
+    const int num_events = 10;
+    std::atomic<int> waiting{0};
+    std::vector<int> seen[2];
+    std::vector<std::shared_ptr<TestOwnQueue>> subs;
+    for (int i = 0; i < 2; ++i) {
+        auto sub = std::make_shared<TestOwnQueue>();
+        sub->m_on_flushed = [&, i](const CBlockLocator& locator) {
+            if (locator.vHave.empty()) {
+                // Both subscribers must be in their first callback at once
+                ++waiting;
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+                while (waiting < 2 && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                }
+            }
+            seen[i].push_back(locator.vHave.size());
+        };
+        RegisterSharedValidationInterface(sub, /*own_queue=*/true);
+        subs.push_back(sub);
+    }
+
+    for (int n = 0; n < num_events; ++n) {
+        GetMainSignals().ChainStateFlushed(CBlockLocator(std::vector<uint256>(n)));
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(waiting, 2);
+    for (const auto& s : seen) {
+        BOOST_REQUIRE_EQUAL(s.size(), size_t(num_events));
+        for (int n = 0; n < num_events; ++n) {
+            BOOST_CHECK_EQUAL(s[n], n);
+        }
+    }
+
+    // Events queued after unregistering are not delivered
+    UnregisterSharedValidationInterface(subs[0]);
+    GetMainSignals().ChainStateFlushed(CBlockLocator(std::vector<uint256>(1)));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(seen[0].size(), size_t(num_events));
+    BOOST_CHECK_EQUAL(seen[1].size(), size_t(num_events + 1));
+
+    UnregisterAllValidationInterfaces();
+    scheduler.stop();
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,16 +6,24 @@
 #include <txdb.h>
 
 #include <chain.h>
+#include <compat/endian.h>
+#include <hash.h>
+#include <memusage.h>
 #include <pow.h>
 #include <random.h>
 #include <shutdown.h>
+#include <streams.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <util/thread.h>
+#include <util/time.h>
+#include <util/trace.h>
 #include <util/translation.h>
 #include <util/vector.h>
 
 #include <validation.h>
 #include <insight/insight.h>
+#include <insight/blockdeltas.h>
 #include <chainparams.h>
 
 #include <stdint.h>
@@ -25,11 +33,22 @@ static constexpr uint8_t DB_COIN{'C'};
 static constexpr uint8_t DB_BLOCK_FILES{'f'};
 //static constexpr uint8_t DB_TXINDEX{'t'};
 static constexpr uint8_t DB_ADDRESSINDEX{'a'};
+/** CAddressIndexCompactKey rows, replacing DB_ADDRESSINDEX */
+static constexpr uint8_t DB_ADDRESSINDEX_COMPACT{'x'};
+/** Next DB_ADDRESSINDEX key to copy while the compact rows are built */
+static constexpr uint8_t DB_ADDRESSINDEX_MIGRATE{'y'};
 static constexpr uint8_t DB_ADDRESSUNSPENTINDEX{'u'};
-static constexpr uint8_t DB_TIMESTAMPINDEX{'s'};
-static constexpr uint8_t DB_BLOCKHASHINDEX{'z'};
+/** CAddressUnspentValueKey rows, DB_ADDRESSUNSPENTINDEX ordered by value */
+static constexpr uint8_t DB_ADDRESSUNSPENTVALUEINDEX{'v'};
+static constexpr uint8_t DB_ADDRESSBALANCEINDEX{'e'};
 static constexpr uint8_t DB_SPENTINDEX{'p'};
 static constexpr uint8_t DB_BALANCESINDEX{'i'};
+static constexpr uint8_t DB_BALANCESINDEX_HEIGHT{'j'};
+static constexpr uint8_t DB_BLOCKREWARDINDEX{'r'};
+/** BlockDeltasRecord rows written with the spent index while pruning */
+static constexpr uint8_t DB_BLOCKDELTASINDEX{'d'};
+/** Resume point of an unfinished rolling indices rebuild */
+static constexpr uint8_t DB_ROLLING_REBUILD{'W'};
 //static constexpr uint8_t DB_TXINDEX_BLOCK{'T'};
 static constexpr uint8_t DB_BLOCK_INDEX{'b'};
 
@@ -38,6 +57,17 @@ static constexpr uint8_t DB_HEAD_BLOCKS{'H'};
 static constexpr uint8_t DB_FLAG{'F'};
 static constexpr uint8_t DB_REINDEX_FLAG{'R'};
 static constexpr uint8_t DB_LAST_BLOCK{'l'};
+static constexpr uint8_t DB_RCTOUTPUT_FILE_LAST{'O'};
+static constexpr uint8_t DB_RCTKEYIMAGE_HEIGHT{'k'};
+
+static constexpr size_t ADDRESSINDEX_MIGRATE_BATCH_SIZE{10000};
+/** Directory of the separate insight index db, rows may be there while this is set */
+static constexpr uint8_t DB_INDEXDB_DIR{'D'};
+/** Key prefixes of the rows kept in the insight index db, and the DB_FLAG rows that describe them */
+static constexpr uint8_t INDEXDB_PREFIXES[] = {DB_ADDRESSINDEX, DB_ADDRESSINDEX_COMPACT, DB_ADDRESSINDEX_MIGRATE,
+    DB_ADDRESSUNSPENTINDEX, DB_ADDRESSUNSPENTVALUEINDEX, DB_ADDRESSBALANCEINDEX, DB_SPENTINDEX, DB_BALANCESINDEX,
+    DB_BALANCESINDEX_HEIGHT, DB_BLOCKREWARDINDEX, DB_BLOCKDELTASINDEX};
+static const char *INDEXDB_FLAGS[] = {"addressindexcompact", "addressunspentvalueindex"};
 
 /*
 static constexpr uint8_t DB_RCTOUTPUT = 'A';
@@ -50,6 +80,9 @@ static constexpr uint8_t DB_SPENTCACHE = 'S';
 static constexpr uint8_t DB_COINS{'c'};
 static constexpr uint8_t DB_TXINDEX_BLOCK{'T'};
 //               uint8_t DB_TXINDEX{'t'}
+// Moved to indexes/timestampindex, stale rows are not read
+//               uint8_t DB_TIMESTAMPINDEX{'s'}
+//               uint8_t DB_BLOCKHASHINDEX{'z'}
 
 std::optional<bilingual_str> CheckLegacyTxindex(CBlockTreeDB& block_tree_db)
 {
@@ -197,7 +230,188 @@ size_t CCoinsViewDB::EstimateSize() const
     return m_db->EstimateSize(DB_COIN, uint8_t(DB_COIN + 1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, bool compression, int maxOpenFiles) : CDBWrapper(gArgs.GetDataDirNet() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, compression, maxOpenFiles) {
+/** Db key or value copied as it is stored */
+struct CRawDBData
+{
+    std::vector<uint8_t> data;
+
+    template <typename Stream>
+    void Serialize(Stream &s) const { s.write(MakeByteSpan(data)); }
+    template <typename Stream>
+    void Unserialize(Stream &s) { data.resize(s.size()); s.read(MakeWritableByteSpan(data)); }
+};
+
+/** Move the insight index rows from one db to another, rows are written to the target before they are erased */
+static bool MoveIndexDBRows(CDBWrapper &from, CDBWrapper &to)
+{
+    std::vector<std::pair<uint8_t, std::string>> flags;
+    for (const char *name : INDEXDB_FLAGS) {
+        flags.emplace_back(DB_FLAG, name);
+    }
+    size_t total = 0;
+    for (const uint8_t prefix : INDEXDB_PREFIXES) {
+        std::unique_ptr<CDBIterator> pcursor(from.NewIterator());
+        pcursor->Seek(prefix);
+        CDBBatch batch_to(to), batch_from(from);
+        size_t num_moved = 0;
+        while (pcursor->Valid() && pcursor->StartsWith(prefix)) {
+            if (ShutdownRequested()) return false;
+            CRawDBData key, value;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(value)) {
+                return error("%s: Failed to read row.", __func__);
+            }
+            batch_to.Write(key, value);
+            batch_from.Erase(key);
+            if (++num_moved % ADDRESSINDEX_MIGRATE_BATCH_SIZE == 0) {
+                if (!to.WriteBatch(batch_to, true) || !from.WriteBatch(batch_from)) {
+                    return error("%s: Failed to write batch.", __func__);
+                }
+                batch_to.Clear();
+                batch_from.Clear();
+                LogPrintf("Moved %d insight index rows.\n", total + num_moved);
+            }
+            pcursor->Next();
+        }
+        if (!to.WriteBatch(batch_to, true) || !from.WriteBatch(batch_from)) {
+            return error("%s: Failed to write batch.", __func__);
+        }
+        total += num_moved;
+    }
+    for (const auto &key : flags) {
+        uint8_t value;
+        if (from.Read(key, value)) {
+            if (!to.Write(key, value, true) || !from.Erase(key)) {
+                return error("%s: Failed to move flag %s.", __func__, key.second);
+            }
+        }
+    }
+    if (total > 0) {
+        LogPrintf("Moved %d insight index rows.\n", total);
+        for (const uint8_t prefix : INDEXDB_PREFIXES) {
+            from.CompactRange(prefix, uint8_t(prefix + 1));
+        }
+    }
+    return true;
+}
+
+/** Block tree and insight index db cache sizes, the index db takes most of the share unless -indexdbcache is set */
+static std::pair<size_t, size_t> SplitBlockTreeCache(size_t nCacheSize, bool split)
+{
+    if (!split) {
+        return {nCacheSize, 0};
+    }
+    if (gArgs.IsArgSet("-indexdbcache")) {
+        return {nCacheSize, std::max(gArgs.GetIntArg("-indexdbcache", nMinDbCache), nMinDbCache) << 20};
+    }
+    return {nCacheSize / 4, nCacheSize - nCacheSize / 4};
+}
+
+static fs::path GetIndexDBDir(bool fMemory)
+{
+    if (fMemory || !gArgs.IsArgSet("-indexdbdir")) {
+        return {};
+    }
+    fs::path dir = gArgs.GetPathArg("-indexdbdir");
+    return dir.empty() ? dir : AbsPathForConfigVal(dir);
+}
+
+static bool HaveLegacyAddressIndex(CDBWrapper &db)
+{
+    std::pair<uint8_t, CAddressIndexKey> key = std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey());
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(key);
+    return pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, bool compression, int maxOpenFiles) : CDBWrapper(gArgs.GetDataDirNet() / "blocks" / "index", SplitBlockTreeCache(nCacheSize, !GetIndexDBDir(fMemory).empty()).first, fMemory, fWipe, false, compression, maxOpenFiles) {
+    const fs::path index_dir = GetIndexDBDir(fMemory);
+    if (!index_dir.empty()) {
+        const size_t index_cache_size = SplitBlockTreeCache(nCacheSize, true).second;
+        LogPrintf("Using %.1f MiB for the insight index database in %s\n", index_cache_size * (1.0 / 1024 / 1024), fs::PathToString(index_dir));
+        m_index_db = std::make_unique<CDBWrapper>(index_dir, index_cache_size, false, fWipe, false, compression, maxOpenFiles);
+    }
+    std::string stored_dir;
+    if (Read(DB_INDEXDB_DIR, stored_dir) && fs::PathFromString(stored_dir) != index_dir) {
+        // -indexdbdir changed, bring the rows back from the previous db
+        LogPrintf("Moving the insight indexes from %s.\n", stored_dir);
+        CDBWrapper prev_db(fs::PathFromString(stored_dir), 1 << 20, false, false, false, compression, maxOpenFiles);
+        if (!MoveIndexDBRows(prev_db, IndexDB())) {
+            throw std::runtime_error("Failed to move the insight indexes, restore the previous -indexdbdir");
+        }
+        Erase(DB_INDEXDB_DIR, true);
+    }
+    if (m_index_db) {
+        // Recorded first, an interrupted move resumes from either db
+        Write(DB_INDEXDB_DIR, fs::PathToString(index_dir), true);
+        if (!MoveIndexDBRows(*this, *m_index_db)) {
+            throw std::runtime_error("Failed to move the insight indexes to -indexdbdir");
+        }
+    }
+    if (!fMemory && gArgs.GetBoolArg("-rctoutputfile", DEFAULT_RCTOUTPUTFILE)) {
+        int64_t last_index = 0;
+        if (!Read(DB_RCTOUTPUT_FILE_LAST, last_index)) {
+            last_index = 0;
+        }
+        m_rct_output_file = std::make_unique<CRCTOutputFile>(gArgs.GetDataDirNet() / "blocks" / "rct", last_index);
+    }
+    bool have_ki_height_index = false;
+    if (!ReadFlag("rctkeyimageheightindex", have_ki_height_index)) {
+        // Nothing to index in a new db
+        std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, CCmpPubKey());
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(key);
+        if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_RCTKEYIMAGE) {
+            WriteFlag("rctkeyimageheightindex", true);
+        } else {
+            LogPrintf("Key image height index is incomplete, rollbacks will scan all key images. Run rebuildrctkeyimageheightindex to build it.\n");
+        }
+    }
+    bool address_index_compact = false;
+    uint8_t ch;
+    if (IndexDB().Read(std::make_pair(DB_FLAG, std::string("addressindexcompact")), ch)) {
+        address_index_compact = ch == uint8_t{'1'};
+    } else
+    if (!HaveLegacyAddressIndex(IndexDB())) {
+        // Nothing to migrate in a new db
+        address_index_compact = true;
+        IndexDB().Write(std::make_pair(DB_FLAG, std::string("addressindexcompact")), uint8_t{'1'});
+    }
+    m_address_index_compact = address_index_compact;
+    bool have_unspent_value_index = false;
+    if (IndexDB().Read(std::make_pair(DB_FLAG, std::string("addressunspentvalueindex")), ch)) {
+        have_unspent_value_index = ch == uint8_t{'1'};
+    } else {
+        std::pair<uint8_t, CAddressUnspentKey> key = std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey());
+        std::unique_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+        pcursor->Seek(key);
+        if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX) {
+            // Nothing to build in a new db
+            have_unspent_value_index = true;
+            IndexDB().Write(std::make_pair(DB_FLAG, std::string("addressunspentvalueindex")), uint8_t{'1'});
+        }
+    }
+    m_address_unspent_value_index = have_unspent_value_index;
+    int64_t rct_cache_size = gArgs.GetIntArg("-rctcache", DEFAULT_RCTCACHE);
+    if (rct_cache_size > 0) {
+        m_rct_output_cache = std::make_unique<CRCTOutputCache>(rct_cache_size);
+    }
+    int64_t spent_cache_blocks = gArgs.GetIntArg("-spentcache", DEFAULT_SPENTCACHE_BLOCKS);
+    if (spent_cache_blocks > 0) {
+        m_spent_coin_cache = std::make_unique<CSpentCoinCache>(spent_cache_blocks);
+    }
+}
+
+CBlockTreeDB::~CBlockTreeDB()
+{
+    FlushRCTBulkLoad();
+    m_key_image_filter_interrupt = true;
+    if (m_key_image_filter_thread.joinable()) {
+        m_key_image_filter_thread.join();
+    }
+    m_address_index_migrate_interrupt = true;
+    if (m_address_index_migrate_thread.joinable()) {
+        m_address_index_migrate_thread.join();
+    }
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -215,6 +429,24 @@ void CBlockTreeDB::ReadReindexing(bool &fReindexing) {
     fReindexing = Exists(DB_REINDEX_FLAG);
 }
 
+bool CBlockTreeDB::WriteRollingRebuild(int rewind_height, int start_height) {
+    return Write(DB_ROLLING_REBUILD, std::make_pair(rewind_height, start_height), true);
+}
+
+bool CBlockTreeDB::ReadRollingRebuild(int &rewind_height, int &start_height) {
+    std::pair<int, int> heights;
+    if (!Read(DB_ROLLING_REBUILD, heights)) {
+        return false;
+    }
+    rewind_height = heights.first;
+    start_height = heights.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseRollingRebuild() {
+    return Erase(DB_ROLLING_REBUILD, true);
+}
+
 bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
@@ -307,40 +539,104 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
+    LOCK(m_rct_bulk_mutex);
+    TakeRCTBulkRows(batch);
     return WriteBatch(batch, true);
 }
 
 bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+    const COutPoint outpoint(key.txid, key.outputIndex);
+    if (WITH_LOCK(m_spent_index_cache_mutex, return m_spent_index_cache.Get(outpoint, value))) {
+        return true;
+    }
+    if (!IndexDB().Read(std::make_pair(DB_SPENTINDEX, key), value)) {
+        return false;
+    }
+    WITH_LOCK(m_spent_index_cache_mutex, m_spent_index_cache.Insert(outpoint, value));
+    return true;
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
+void CBlockTreeDB::ReadSpentIndex(const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values) {
+    values.assign(keys.size(), CSpentIndexValue());
+    std::vector<size_t> order;
+    {
+        LOCK(m_spent_index_cache_mutex);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!m_spent_index_cache.Get(COutPoint(keys[i].txid, keys[i].outputIndex), values[i])) {
+                order.push_back(i);
+            }
+        }
+    }
+    // Sorted reads touch neighbouring db blocks, duplicates are read once
+    CSpentIndexKeyCompare cmp;
+    std::sort(order.begin(), order.end(), [&keys, &cmp](size_t a, size_t b) { return cmp(keys[a], keys[b]); });
+    std::vector<std::pair<COutPoint, CSpentIndexValue> > found;
+    for (size_t k = 0; k < order.size(); ++k) {
+        size_t i = order[k];
+        if (k > 0 && !cmp(keys[order[k - 1]], keys[i])) {
+            values[i] = values[order[k - 1]];
+            continue;
+        }
+        if (IndexDB().Read(std::make_pair(DB_SPENTINDEX, keys[i]), values[i])) {
+            found.emplace_back(COutPoint(keys[i].txid, keys[i].outputIndex), values[i]);
         } else {
-            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+            values[i].SetNull();
         }
     }
-    return WriteBatch(batch);
+    LOCK(m_spent_index_cache_mutex);
+    for (const auto &entry : found) {
+        m_spent_index_cache.Insert(entry.first, entry.second);
+    }
+}
+
+bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
+    CDBBatch batch(IndexDB());
+    {
+        LOCK(m_spent_index_cache_mutex);
+        for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+            if (it->second.IsNull()) {
+                batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
+                m_spent_index_cache.Erase(COutPoint(it->first.txid, it->first.outputIndex));
+            } else {
+                batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+            }
+        }
+    }
+    return IndexDB().WriteBatch(batch);
 }
 
 bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
+    LOCK(m_address_index_mutex);
+    CDBBatch batch(IndexDB());
+    // Values of the outputs written in this batch, an output can be created and spent in one block
+    std::map<COutPoint, CAmount> written;
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        const COutPoint outpoint(it->first.txhash, it->first.index);
         if (it->second.IsNull()) {
+            // The value ordered row is found through the value of the row erased
+            auto wit = written.find(outpoint);
+            CAddressUnspentValue prev;
+            if (wit != written.end()) {
+                batch.Erase(std::make_pair(DB_ADDRESSUNSPENTVALUEINDEX, CAddressUnspentValueKey(it->first, wit->second)));
+                written.erase(wit);
+            } else
+            if (IndexDB().Read(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), prev)) {
+                batch.Erase(std::make_pair(DB_ADDRESSUNSPENTVALUEINDEX, CAddressUnspentValueKey(it->first, prev.satoshis)));
+            }
             batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
         } else {
             batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTVALUEINDEX, CAddressUnspentValueKey(it->first, it->second.satoshis)), it->second);
+            written[outpoint] = it->second.satoshis;
         }
     }
-    return WriteBatch(batch);
+    return IndexDB().WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
-    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CAddressUnspentFilter *filter) {
+    const std::unique_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
 
     pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
 
@@ -350,7 +646,9 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                if (!filter || filter->Matches(nValue)) {
+                    unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                }
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -363,42 +661,172 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadAddressUnspentByValue(const uint256 &addressHash, int type,
+                                             std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                             const CAddressUnspentFilter &filter, size_t max_results, const CAddressUnspentValueKey *after) {
+    if (!m_address_unspent_value_index) {
+        return false;
+    }
+    const std::unique_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+
+    // Values above max_satoshis are skipped by the seek
+    CAddressUnspentValueKey seek_key(type, addressHash, filter.max_satoshis);
+    if (after && after->satoshis <= filter.max_satoshis) {
+        seek_key = *after;
+        seek_key.type = type;
+        seek_key.hashBytes = addressHash;
+    }
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTVALUEINDEX, seek_key));
+
+    size_t num_found = 0;
+    while (pcursor->Valid()) {
+        if (ShutdownRequested()) return false;
+        std::pair<uint8_t, CAddressUnspentValueKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTVALUEINDEX ||
+            key.second.type != (unsigned int)type || key.second.hashBytes != addressHash ||
+            key.second.satoshis < filter.min_satoshis) {
+            break;
+        }
+        if (after && key.second.satoshis == after->satoshis && key.second.txhash == after->txhash && key.second.index == after->index) {
+            pcursor->Next();
+            continue;
+        }
+        CAddressUnspentValue value;
+        if (!pcursor->GetValue(value)) {
+            return error("failed to get address unspent value");
+        }
+        if (filter.Matches(value)) {
+            unspentOutputs.emplace_back(CAddressUnspentKey(type, addressHash, key.second.txhash, key.second.index), value);
+            if (max_results > 0 && ++num_found >= max_results) {
+                break;
+            }
+        }
+        pcursor->Next();
+    }
+
+    return true;
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect, bool update_balances) {
+    LOCK(m_address_index_mutex);
+    const bool write_legacy = !m_address_index_compact;
+    CDBBatch batch(IndexDB());
+    std::map<std::pair<unsigned int, uint256>, CAddressBalanceValue> balances;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (update_balances) {
+            // Skip deltas already recorded, rewriting them must not count twice
+            CAmount existing;
+            if (ReadAddressIndexValue(it->first, existing)) {
+                continue;
+            }
+            CAddressBalanceValue &value = balances[std::make_pair(it->first.type, it->first.hashBytes)];
+            value.balance += it->second;
+            if (it->second > 0) {
+                value.received += it->second;
+            }
+        }
+        batch.Write(std::make_pair(DB_ADDRESSINDEX_COMPACT, CAddressIndexCompactKey(it->first)), it->second);
+        if (write_legacy) {
+            batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
+        }
+    }
+    if (!UpdateAddressBalanceIndex(batch, balances, false)) {
+        return false;
+    }
+    return IndexDB().WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
-    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect, bool update_balances) {
+    LOCK(m_address_index_mutex);
+    const bool write_legacy = !m_address_index_compact;
+    CDBBatch batch(IndexDB());
+    std::map<std::pair<unsigned int, uint256>, CAddressBalanceValue> balances;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (update_balances) {
+            // Remove the value that was stored, which may differ from the undo data for blinded outputs
+            CAmount stored;
+            if (!ReadAddressIndexValue(it->first, stored)) {
+                continue;
+            }
+            CAddressBalanceValue &value = balances[std::make_pair(it->first.type, it->first.hashBytes)];
+            value.balance += stored;
+            if (stored > 0) {
+                value.received += stored;
+            }
+        }
+        batch.Erase(std::make_pair(DB_ADDRESSINDEX_COMPACT, CAddressIndexCompactKey(it->first)));
+        if (write_legacy) {
+            batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+        }
+    }
+    if (!UpdateAddressBalanceIndex(batch, balances, true)) {
+        return false;
+    }
+    return IndexDB().WriteBatch(batch);
+}
 
+bool CBlockTreeDB::UpdateAddressBalanceIndex(CDBBatch &batch, const std::map<std::pair<unsigned int, uint256>, CAddressBalanceValue> &deltas, bool subtract) {
+    for (const auto &it : deltas) {
+        CAddressIndexIteratorKey key(it.first.first, it.first.second);
+        CAddressBalanceValue value;
+        if (!ReadAddressBalanceIndex(key.hashBytes, key.type, value)) {
+            return error("failed to read address balance index");
+        }
+        if (subtract) {
+            value.balance -= it.second.balance;
+            value.received -= it.second.received;
+        } else {
+            value.balance += it.second.balance;
+            value.received += it.second.received;
+        }
+        if (value.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSBALANCEINDEX, key));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSBALANCEINDEX, key), value);
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalanceIndex(const uint256 &addressHash, int type, CAddressBalanceValue &value) {
+    value.SetNull();
+    if (!IndexDB().Exists(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)))) {
+        return true;
+    }
+    return IndexDB().Read(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value);
+}
+
+static const CAddressIndexKey &GetAddressIndexKey(const CAddressIndexKey &key) { return key; }
+static const CAddressIndexKey &GetAddressIndexKey(const CAddressIndexCompactKey &key) { return key.key; }
+
+template <typename Key, typename IteratorKey, typename IteratorHeightKey>
+static bool ReadAddressIndexRows(CDBIterator &cursor, uint8_t prefix, const uint256 &addressHash, int type,
+                                 std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                 int start, int end, size_t max_results, const CAddressIndexKey *from) {
+    size_t num_results = 0;
+    if (from) {
+        cursor.Seek(std::make_pair(prefix, Key(*from)));
+    } else
     if (start > 0 && end > 0) {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+        cursor.Seek(std::make_pair(prefix, IteratorHeightKey(type, addressHash, start)));
     } else {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+        cursor.Seek(std::make_pair(prefix, IteratorKey(type, addressHash)));
     }
 
-    while (pcursor->Valid()) {
+    while (cursor.Valid()) {
         if (ShutdownRequested()) return false;
-        std::pair<uint8_t, CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
-            if (end > 0 && key.second.blockHeight > end) {
+        std::pair<uint8_t, Key> key;
+        if (cursor.GetKey(key) && key.first == prefix && GetAddressIndexKey(key.second).hashBytes == addressHash) {
+            if (end > 0 && GetAddressIndexKey(key.second).blockHeight > end) {
+                break;
+            }
+            if (max_results > 0 && num_results++ >= max_results) {
                 break;
             }
             CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
+            if (cursor.GetValue(nValue)) {
+                addressIndex.push_back(std::make_pair(GetAddressIndexKey(key.second), nValue));
+                cursor.Next();
             } else {
                 return error("failed to get address index value");
             }
@@ -410,60 +838,250 @@ bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex)
-{
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int start, int end, size_t max_results, const CAddressIndexKey *from) {
+    std::unique_ptr<CDBIterator> pcursor;
+    bool compact;
+    {
+        // The snapshot must not fall between the last copied batch and the switch to compact reads
+        LOCK(m_address_index_mutex);
+        pcursor.reset(IndexDB().NewIterator());
+        compact = m_address_index_compact;
+    }
+    if (compact) {
+        return ReadAddressIndexRows<CAddressIndexCompactKey, CAddressIndexCompactIteratorKey, CAddressIndexCompactIteratorHeightKey>(
+            *pcursor, DB_ADDRESSINDEX_COMPACT, addressHash, type, addressIndex, start, end, max_results, from);
+    }
+    return ReadAddressIndexRows<CAddressIndexKey, CAddressIndexIteratorKey, CAddressIndexIteratorHeightKey>(
+        *pcursor, DB_ADDRESSINDEX, addressHash, type, addressIndex, start, end, max_results, from);
+}
+
+bool CBlockTreeDB::ReadAddressIndexValue(const CAddressIndexKey &key, CAmount &value) {
+    if (m_address_index_compact) {
+        return IndexDB().Read(std::make_pair(DB_ADDRESSINDEX_COMPACT, CAddressIndexCompactKey(key)), value);
+    }
+    return IndexDB().Read(std::make_pair(DB_ADDRESSINDEX, key), value);
 }
 
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<std::pair<uint256, unsigned int> > &hashes)
+void CBlockTreeDB::StartAddressIndexMigration()
 {
-    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    const bool have_legacy = HaveLegacyAddressIndex(IndexDB());
+    if (m_address_index_migrate_thread.joinable() || (!have_legacy && m_address_unspent_value_index)) {
+        return;
+    }
+    m_address_index_migrate_thread = std::thread(&util::TraceThread, "addrmigrate", [this, have_legacy] {
+        if (have_legacy) {
+            if (!m_address_index_compact && !CopyLegacyAddressIndex()) {
+                return;
+            }
+            EraseLegacyAddressIndex();
+        }
+        if (!m_address_unspent_value_index) {
+            BuildAddressUnspentValueIndex();
+        }
+    });
+}
 
-    pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+bool CBlockTreeDB::CopyLegacyAddressIndex()
+{
+    std::pair<uint8_t, CAddressIndexKey> key = std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey());
+    if (IndexDB().Read(DB_ADDRESSINDEX_MIGRATE, key.second)) {
+        LogPrintf("Resuming address index migration at height %d.\n", key.second.blockHeight);
+    } else {
+        LogPrintf("Migrating address index to compact keys.\n");
+    }
 
-    while (pcursor->Valid()) {
-        if (ShutdownRequested()) return false;
-        std::pair<uint8_t, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
-            hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
+    size_t total = 0;
+    while (true) {
+        if (m_address_index_migrate_interrupt) return false;
+        // A new iterator per batch, rows erased by a disconnect must not be copied back
+        LOCK(m_address_index_mutex);
+        std::unique_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+        pcursor->Seek(key);
+
+        CDBBatch batch(IndexDB());
+        size_t num_copied = 0;
+        bool done = true;
+        while (pcursor->Valid()) {
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX) {
+                break;
+            }
+            if (num_copied >= ADDRESSINDEX_MIGRATE_BATCH_SIZE) {
+                done = false;
+                break;
+            }
+            CAmount value;
+            if (!pcursor->GetValue(value)) {
+                return error("%s: failed to get address index value", __func__);
+            }
+            batch.Write(std::make_pair(DB_ADDRESSINDEX_COMPACT, CAddressIndexCompactKey(key.second)), value);
+            num_copied++;
             pcursor->Next();
+        }
+        if (done) {
+            batch.Erase(DB_ADDRESSINDEX_MIGRATE);
+            batch.Write(std::make_pair(DB_FLAG, std::string("addressindexcompact")), uint8_t{'1'});
         } else {
+            batch.Write(DB_ADDRESSINDEX_MIGRATE, key.second);
+        }
+        if (!IndexDB().WriteBatch(batch)) {
+            return error("%s: failed to write batch", __func__);
+        }
+        total += num_copied;
+        if (done) {
+            m_address_index_compact = true;
+            LogPrintf("Address index migration copied %d rows.\n", total);
+            return true;
+        }
+    }
+}
+
+void CBlockTreeDB::EraseLegacyAddressIndex()
+{
+    std::pair<uint8_t, CAddressIndexKey> key = std::make_pair(DB_ADDRESSINDEX, CAddressIndexKey());
+    size_t total = 0;
+    std::unique_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+    pcursor->Seek(key);
+
+    CDBBatch batch(IndexDB());
+    while (pcursor->Valid()) {
+        if (m_address_index_migrate_interrupt) break;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX) {
             break;
         }
+        batch.Erase(key);
+        if (++total % ADDRESSINDEX_MIGRATE_BATCH_SIZE == 0) {
+            IndexDB().WriteBatch(batch);
+            batch.Clear();
+        }
+        pcursor->Next();
     }
+    IndexDB().WriteBatch(batch);
+    if (m_address_index_migrate_interrupt) return;
+    IndexDB().CompactRange(DB_ADDRESSINDEX, uint8_t(DB_ADDRESSINDEX + 1));
+    LogPrintf("Erased %d legacy address index rows.\n", total);
+}
 
-    return true;
+bool CBlockTreeDB::BuildAddressUnspentValueIndex()
+{
+    LogPrintf("Building the value ordered address unspent index.\n");
+    std::pair<uint8_t, CAddressUnspentKey> key = std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey());
+    size_t total = 0;
+    while (true) {
+        if (m_address_index_migrate_interrupt) return false;
+        // A new iterator per batch, rows erased by a spend must not be copied back
+        LOCK(m_address_index_mutex);
+        std::unique_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+        pcursor->Seek(key);
+
+        CDBBatch batch(IndexDB());
+        size_t num_copied = 0;
+        bool done = true;
+        while (pcursor->Valid()) {
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX) {
+                break;
+            }
+            if (num_copied >= ADDRESSINDEX_MIGRATE_BATCH_SIZE) {
+                done = false;
+                break;
+            }
+            CAddressUnspentValue value;
+            if (!pcursor->GetValue(value)) {
+                return error("%s: failed to get address unspent value", __func__);
+            }
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTVALUEINDEX, CAddressUnspentValueKey(key.second, value.satoshis)), value);
+            num_copied++;
+            pcursor->Next();
+        }
+        if (done) {
+            batch.Write(std::make_pair(DB_FLAG, std::string("addressunspentvalueindex")), uint8_t{'1'});
+        }
+        if (!IndexDB().WriteBatch(batch)) {
+            return error("%s: failed to write batch", __func__);
+        }
+        total += num_copied;
+        if (done) {
+            m_address_unspent_value_index = true;
+            LogPrintf("Value ordered address unspent index built from %d rows.\n", total);
+            return true;
+        }
+    }
 }
 
-bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
+bool CBlockTreeDB::WriteBlockBalancesIndex(const uint256 &key, int height, const BlockBalances &value)
+{
+    CDBBatch batch(IndexDB());
+    batch.Write(std::make_pair(DB_BALANCESINDEX, key), value);
+    // Overwritten when a reorg connects another block at height, readers must check the hash
+    batch.Write(std::make_pair(DB_BALANCESINDEX_HEIGHT, BlockBalancesHeightKey(height)), std::make_pair(key, value));
+    return IndexDB().WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
+bool CBlockTreeDB::ReadBlockBalancesIndex(const uint256 &key, BlockBalances &value)
+{
+    return IndexDB().Read(std::make_pair(DB_BALANCESINDEX, key), value);
+}
 
-    CTimestampBlockIndexValue lts;
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts)) {
-        return false;
+bool CBlockTreeDB::ReadBlockBalancesRange(int start_height, int end_height, int step,
+                                          std::vector<std::pair<int, std::pair<uint256, BlockBalances> > > &entries)
+{
+    assert(step > 0);
+    const std::unique_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+
+    int next_height = start_height;
+    pcursor->Seek(std::make_pair(DB_BALANCESINDEX_HEIGHT, BlockBalancesHeightKey(next_height)));
+    while (pcursor->Valid()) {
+        if (ShutdownRequested()) return false;
+        std::pair<uint8_t, BlockBalancesHeightKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BALANCESINDEX_HEIGHT || (int)key.second.height > end_height) {
+            break;
+        }
+        int height = key.second.height;
+        // Heights missing from the index are skipped, keep to the sample grid
+        if ((height - start_height) % step != 0) {
+            next_height = height + step - (height - start_height) % step;
+            pcursor->Seek(std::make_pair(DB_BALANCESINDEX_HEIGHT, BlockBalancesHeightKey(next_height)));
+            continue;
+        }
+        std::pair<uint256, BlockBalances> value;
+        if (!pcursor->GetValue(value)) {
+            return error("failed to get block balances value");
+        }
+        entries.emplace_back(height, value);
+        next_height = height + step;
+        if (step == 1) {
+            pcursor->Next();
+        } else {
+            pcursor->Seek(std::make_pair(DB_BALANCESINDEX_HEIGHT, BlockBalancesHeightKey(next_height)));
+        }
     }
 
-    ltimestamp = lts.ltimestamp;
     return true;
 }
 
-bool CBlockTreeDB::WriteBlockBalancesIndex(const uint256 &key, const BlockBalances &value)
+bool CBlockTreeDB::WriteBlockRewardIndex(const uint256 &key, const BlockReward &value)
 {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_BALANCESINDEX, key), value);
-    return WriteBatch(batch);
+    CDBBatch batch(IndexDB());
+    batch.Write(std::make_pair(DB_BLOCKREWARDINDEX, key), value);
+    return IndexDB().WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadBlockBalancesIndex(const uint256 &key, BlockBalances &value)
+bool CBlockTreeDB::ReadBlockRewardIndex(const uint256 &key, BlockReward &value)
+{
+    return IndexDB().Read(std::make_pair(DB_BLOCKREWARDINDEX, key), value);
+}
+
+bool CBlockTreeDB::WriteBlockDeltasIndex(const uint256 &key, const BlockDeltasRecord &value)
+{
+    CDBBatch batch(IndexDB());
+    batch.Write(std::make_pair(DB_BLOCKDELTASINDEX, key), value);
+    return IndexDB().WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadBlockDeltasIndex(const uint256 &key, BlockDeltasRecord &value)
 {
-    return Read(std::make_pair(DB_BALANCESINDEX, key), value);
+    return IndexDB().Read(std::make_pair(DB_BLOCKDELTASINDEX, key), value);
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
@@ -509,7 +1127,6 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->hashWitnessMerkleRoot    = diskindex.hashWitnessMerkleRoot;
                 pindexNew->nFlags                   = diskindex.nFlags & (uint32_t)~BLOCK_DELAYED;
                 pindexNew->bnStakeModifier          = diskindex.bnStakeModifier;
-                pindexNew->prevoutStake             = diskindex.prevoutStake;
                 //pindexNew->hashProof                = diskindex.hashProof;
 
                 pindexNew->nMoneySupply             = diskindex.nMoneySupply;
@@ -565,51 +1182,293 @@ size_t CBlockTreeDB::CountBlockIndex()
 
 bool CBlockTreeDB::ReadRCTOutput(int64_t i, CAnonOutput &ao)
 {
-    std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, i);
-    return Read(key, ao);
+    if (m_rct_output_cache && m_rct_output_cache->Get(i, ao)) {
+        return true;
+    }
+    if (m_rct_bulk_load) {
+        LOCK(m_rct_bulk_mutex);
+        const auto it = m_rct_bulk_outputs.find(i);
+        if (it != m_rct_bulk_outputs.end()) {
+            ao = it->second;
+            return true;
+        }
+    }
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
+    bool from_file = m_rct_output_file && m_rct_output_file->Read(i, ao);
+    if (!from_file) {
+        std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, i);
+        if (!Read(key, ao)) {
+            TRACE4(rct, read_output, i, false, false, GetTimeMicros() - start_us);
+            return false;
+        }
+    }
+    TRACE4(rct, read_output, i, true, from_file, GetTimeMicros() - start_us);
+    if (m_rct_output_cache) {
+        m_rct_output_cache->Put(i, ao);
+    }
+    return true;
+};
+
+size_t CBlockTreeDB::ReadRCTOutputs(int64_t start, size_t count, std::vector<CAnonOutput> &outputs)
+{
+    outputs.assign(count, CAnonOutput());
+    std::vector<bool> found(count, false);
+    std::vector<size_t> missing;
+    for (size_t k = 0; k < count; ++k) {
+        if (m_rct_bulk_load) {
+            LOCK(m_rct_bulk_mutex);
+            const auto it = m_rct_bulk_outputs.find(start + k);
+            if (it != m_rct_bulk_outputs.end()) {
+                outputs[k] = it->second;
+                found[k] = true;
+                continue;
+            }
+        }
+        if (m_rct_output_file && m_rct_output_file->Read(start + k, outputs[k])) {
+            found[k] = true;
+            continue;
+        }
+        missing.push_back(k);
+    }
+
+    if (!missing.empty()) {
+        // Indices are serialized little endian, sort by the key bytes so the cursor only moves forward
+        auto key_order = [](int64_t i) { return be64toh(htole64((uint64_t)i)); };
+        std::sort(missing.begin(), missing.end(), [&](size_t a, size_t b) { return key_order(start + a) < key_order(start + b); });
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        for (size_t k : missing) {
+            std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, start + (int64_t)k), found_key;
+            pcursor->Seek(key);
+            if (pcursor->Valid() && pcursor->GetKey(found_key) && found_key == key && pcursor->GetValue(outputs[k])) {
+                found[k] = true;
+            }
+        }
+    }
+
+    size_t n = 0;
+    while (n < count && found[n]) {
+        n++;
+    }
+    outputs.resize(n);
+    return n;
 };
 
 bool CBlockTreeDB::WriteRCTOutput(int64_t i, const CAnonOutput &ao)
 {
+    if (m_rct_output_cache) {
+        m_rct_output_cache->Erase(i);
+    }
     std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, i);
     CDBBatch batch(*this);
     batch.Write(key, ao);
+    if (!WriteRCTOutputFile(batch, {{i, ao}})) {
+        return false;
+    }
     return WriteBatch(batch);
 };
 
-bool CBlockTreeDB::EraseRCTOutput(int64_t i)
+void CBlockTreeDB::WriteRCTOutput(CDBBatch &batch, int64_t i, const CAnonOutput &ao)
 {
+    if (m_rct_output_cache) {
+        m_rct_output_cache->Erase(i);
+    }
+    if (m_rct_bulk_load) {
+        LOCK(m_rct_bulk_mutex);
+        m_rct_bulk_outputs[i] = ao;
+        WriteRCTBulkRowsIfFull();
+        return;
+    }
     std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, i);
+    batch.Write(key, ao);
+};
+
+bool CBlockTreeDB::EraseRCTOutput(int64_t i)
+{
     CDBBatch batch(*this);
-    batch.Erase(key);
+    EraseRCTOutput(batch, i);
     return WriteBatch(batch);
 };
 
+void CBlockTreeDB::EraseRCTOutput(CDBBatch &batch, int64_t i)
+{
+    FlushRCTBulkLoad();
+    if (m_rct_output_cache) {
+        m_rct_output_cache->Erase(i);
+    }
+    std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, i);
+    batch.Erase(key);
+    if (m_rct_output_file) {
+        m_rct_output_file->Truncate(i - 1);
+        batch.Write(DB_RCTOUTPUT_FILE_LAST, m_rct_output_file->GetLastIndex());
+    }
+};
+
+bool CBlockTreeDB::WriteRCTOutputFile(CDBBatch &batch, const std::vector<std::pair<int64_t, CAnonOutput> > &vao)
+{
+    if (!m_rct_output_file || vao.empty()) {
+        return true;
+    }
+    for (const auto &it : vao) {
+        if (!m_rct_output_file->Write(it.first, it.second)) {
+            // Rows past a gap stay in the db only, reads fall through to leveldb
+            LogPrint(BCLog::COINDB, "%s: Stopped at index %d, last %d.\n", __func__, it.first, m_rct_output_file->GetLastIndex());
+            break;
+        }
+    }
+    // Rows must reach the disk before the db records them as present
+    if (!m_rct_output_file->Flush()) {
+        return error("%s: Flush failed.", __func__);
+    }
+    batch.Write(DB_RCTOUTPUT_FILE_LAST, m_rct_output_file->GetLastIndex());
+    return true;
+};
+
+bool CBlockTreeDB::SyncRCTOutputFile(int64_t nAnonOutputs)
+{
+    FlushRCTBulkLoad();
+    if (!m_rct_output_file) {
+        return true;
+    }
+    int64_t last_index = m_rct_output_file->GetLastIndex();
+    if (last_index > nAnonOutputs) {
+        LogPrintf("RCT output file is ahead of the chain, truncating %d to %d.\n", last_index, nAnonOutputs);
+        m_rct_output_file->Truncate(nAnonOutputs);
+        last_index = nAnonOutputs;
+    }
+    if (last_index > 0) {
+        CAnonOutput ao_file, ao_db;
+        if (!m_rct_output_file->Read(last_index, ao_file) ||
+            !Read(std::pair<uint8_t, int64_t>(DB_RCTOUTPUT, last_index), ao_db) ||
+            ao_file.pubkey != ao_db.pubkey ||
+            ao_file.outpoint != ao_db.outpoint ||
+            memcmp(ao_file.commitment.data, ao_db.commitment.data, 33) != 0) {
+            LogPrintf("RCT output file does not match the db at index %d, rebuilding.\n", last_index);
+            m_rct_output_file->Truncate(0);
+            last_index = 0;
+        }
+    }
+    if (last_index < nAnonOutputs) {
+        LogPrintf("Migrating %d RCT outputs to the flat file table.\n", nAnonOutputs - last_index);
+        for (int64_t i = last_index + 1; i <= nAnonOutputs; ++i) {
+            CAnonOutput ao;
+            if (!Read(std::pair<uint8_t, int64_t>(DB_RCTOUTPUT, i), ao)) {
+                LogPrintf("%s: RCT output %d missing from the db.\n", __func__, i);
+                break;
+            }
+            if (!m_rct_output_file->Write(i, ao)) {
+                LogPrintf("%s: Write failed at index %d, disabling the RCT output file.\n", __func__, i);
+                m_rct_output_file.reset();
+                return Write(DB_RCTOUTPUT_FILE_LAST, int64_t{0});
+            }
+        }
+    }
+    if (!m_rct_output_file->Flush()) {
+        return error("%s: Flush failed.", __func__);
+    }
+    return Write(DB_RCTOUTPUT_FILE_LAST, m_rct_output_file->GetLastIndex());
+};
+
+bool CBlockTreeDB::GetRCTOutputCacheStats(CRCTOutputCache::Stats &stats) const
+{
+    if (!m_rct_output_cache) {
+        return false;
+    }
+    stats = m_rct_output_cache->GetStats();
+    return true;
+};
+
 
 bool CBlockTreeDB::ReadRCTOutputLink(const CCmpPubKey &pk, int64_t &i)
 {
+    if (!m_output_link_filter.MaybeContains(pk)) {
+        return false;
+    }
+    if (m_rct_bulk_load) {
+        LOCK(m_rct_bulk_mutex);
+        const auto it = m_rct_bulk_links.find(pk);
+        if (it != m_rct_bulk_links.end()) {
+            i = it->second;
+            return true;
+        }
+    }
     std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTOUTPUT_LINK, pk);
     return Read(key, i);
 };
 
+void CBlockTreeDB::ReadRCTOutputLinks(const std::vector<CCmpPubKey> &pks, std::vector<int64_t> &indices)
+{
+    indices.assign(pks.size(), -1);
+    std::vector<size_t> order;
+    for (size_t i = 0; i < pks.size(); ++i) {
+        if (m_output_link_filter.MaybeContains(pks[i])) {
+            order.push_back(i);
+        }
+    }
+    // Sorted reads touch neighbouring db blocks, duplicates are read once
+    std::sort(order.begin(), order.end(), [&pks](size_t a, size_t b) { return pks[a] < pks[b]; });
+    for (size_t k = 0; k < order.size(); ++k) {
+        size_t i = order[k];
+        if (k > 0 && pks[i] == pks[order[k - 1]]) {
+            indices[i] = indices[order[k - 1]];
+            continue;
+        }
+        int64_t index;
+        if (ReadRCTOutputLink(pks[i], index)) {
+            indices[i] = index;
+        }
+    }
+};
+
 bool CBlockTreeDB::WriteRCTOutputLink(const CCmpPubKey &pk, int64_t i)
 {
+    m_output_link_filter.Insert(pk);
     std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTOUTPUT_LINK, pk);
     CDBBatch batch(*this);
     batch.Write(key, i);
     return WriteBatch(batch);
 };
 
-bool CBlockTreeDB::EraseRCTOutputLink(const CCmpPubKey &pk)
+void CBlockTreeDB::WriteRCTOutputLink(CDBBatch &batch, const CCmpPubKey &pk, int64_t i)
 {
+    // Insert before the row is written or buffered, as for key images
+    m_output_link_filter.Insert(pk);
+    if (m_rct_bulk_load) {
+        LOCK(m_rct_bulk_mutex);
+        m_rct_bulk_links[pk] = i;
+        WriteRCTBulkRowsIfFull();
+        return;
+    }
     std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTOUTPUT_LINK, pk);
+    batch.Write(key, i);
+};
+
+bool CBlockTreeDB::EraseRCTOutputLink(const CCmpPubKey &pk)
+{
     CDBBatch batch(*this);
-    batch.Erase(key);
+    EraseRCTOutputLink(batch, pk);
     return WriteBatch(batch);
 };
 
+void CBlockTreeDB::EraseRCTOutputLink(CDBBatch &batch, const CCmpPubKey &pk)
+{
+    FlushRCTBulkLoad();
+    std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTOUTPUT_LINK, pk);
+    batch.Erase(key);
+};
+
 bool CBlockTreeDB::ReadRCTKeyImage(const CCmpPubKey &ki, CAnonKeyImageInfo &data)
 {
+    if (!m_key_image_filter.MaybeContains(ki)) {
+        return false;
+    }
+    if (m_rct_bulk_load) {
+        LOCK(m_rct_bulk_mutex);
+        const auto it = m_rct_bulk_key_images.find(ki);
+        if (it != m_rct_bulk_key_images.end()) {
+            data = it->second;
+            return true;
+        }
+    }
     std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, ki);
     // Versions before 0.19.2.15 store only the txid
     CDataStream ssValue(SER_DISK, CLIENT_VERSION);
@@ -629,21 +1488,73 @@ bool CBlockTreeDB::ReadRCTKeyImage(const CCmpPubKey &ki, CAnonKeyImageInfo &data
     return true;
 };
 
-bool CBlockTreeDB::EraseRCTKeyImage(const CCmpPubKey &ki)
+void CBlockTreeDB::WriteRCTKeyImage(CDBBatch &batch, const CCmpPubKey &ki, const CAnonKeyImageInfo &data)
 {
+    // Insert before the batch is written so the filter never misses a key image in the db
+    m_key_image_filter.Insert(ki);
+    if (m_rct_bulk_load) {
+        LOCK(m_rct_bulk_mutex);
+        m_rct_bulk_key_images[ki] = data;
+        WriteRCTBulkRowsIfFull();
+        return;
+    }
     std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, ki);
+    batch.Write(key, data);
+    if (data.height >= 0) {
+        batch.Write(std::make_pair(DB_RCTKEYIMAGE_HEIGHT, CAnonKeyImageHeightKey(data.height, ki)), 0);
+    }
+};
+
+bool CBlockTreeDB::EraseRCTKeyImage(const CCmpPubKey &ki)
+{
     CDBBatch batch(*this);
-    batch.Erase(key);
+    EraseRCTKeyImage(batch, ki);
     return WriteBatch(batch);
 };
 
-bool CBlockTreeDB::EraseRCTKeyImagesAfterHeight(int height)
+void CBlockTreeDB::EraseRCTKeyImage(CDBBatch &batch, const CCmpPubKey &ki)
 {
-    std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, CCmpPubKey());
+    FlushRCTBulkLoad();
+    std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, ki);
+    CAnonKeyImageInfo data;
+    if (ReadRCTKeyImage(ki, data) && data.height >= 0) {
+        batch.Erase(std::make_pair(DB_RCTKEYIMAGE_HEIGHT, CAnonKeyImageHeightKey(data.height, ki)));
+    }
+    batch.Erase(key);
+};
 
+bool CBlockTreeDB::EraseRCTKeyImagesAfterHeight(int height)
+{
+    if (!FlushRCTBulkLoad()) {
+        return false;
+    }
     CDBBatch batch(*this);
     size_t total = 0, removing = 0;
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    bool have_ki_height_index = false;
+    if (ReadFlag("rctkeyimageheightindex", have_ki_height_index) && have_ki_height_index) {
+        std::pair<uint8_t, CAnonKeyImageHeightKey> key = std::make_pair(DB_RCTKEYIMAGE_HEIGHT, CAnonKeyImageHeightKey(height + 1, CCmpPubKey()));
+        pcursor->Seek(key);
+        while (pcursor->Valid()) {
+            if (ShutdownRequested()) return false;
+            if (pcursor->GetKey(key) && key.first == DB_RCTKEYIMAGE_HEIGHT) {
+                removing++;
+                batch.Erase(key);
+                batch.Erase(std::pair<uint8_t, CCmpPubKey>(DB_RCTKEYIMAGE, key.second.ki));
+                pcursor->Next();
+            } else {
+                break;
+            }
+        }
+        LogPrintf("Removing %d key images after height %d.\n", removing, height);
+        if (removing < 1) {
+            return true;
+        }
+        return WriteBatch(batch);
+    }
+
+    std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, CCmpPubKey());
     pcursor->Seek(key);
 
     while (pcursor->Valid()) {
@@ -658,6 +1569,7 @@ bool CBlockTreeDB::EraseRCTKeyImagesAfterHeight(int height)
                         removing++;
                         std::pair<uint8_t, CCmpPubKey> erase_key = std::make_pair(DB_RCTKEYIMAGE, key.second);
                         batch.Erase(erase_key);
+                        batch.Erase(std::make_pair(DB_RCTKEYIMAGE_HEIGHT, CAnonKeyImageHeightKey(ki_data.height, key.second)));
                     }
                 } else {
                     return error("%s: failed to read value", __func__);
@@ -676,16 +1588,418 @@ bool CBlockTreeDB::EraseRCTKeyImagesAfterHeight(int height)
     return WriteBatch(batch);
 };
 
+bool CBlockTreeDB::RebuildRCTKeyImageHeightIndex(size_t &num_indexed)
+{
+    num_indexed = 0;
+    if (!FlushRCTBulkLoad()) {
+        return false;
+    }
+    if (!WriteFlag("rctkeyimageheightindex", false)) {
+        return false;
+    }
+
+    CDBBatch batch(*this);
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    std::pair<uint8_t, CAnonKeyImageHeightKey> height_key = std::make_pair(DB_RCTKEYIMAGE_HEIGHT, CAnonKeyImageHeightKey());
+    pcursor->Seek(height_key);
+    while (pcursor->Valid()) {
+        if (ShutdownRequested()) return false;
+        if (pcursor->GetKey(height_key) && height_key.first == DB_RCTKEYIMAGE_HEIGHT) {
+            batch.Erase(height_key);
+            if (batch.SizeEstimate() > (1 << 24)) {
+                if (!WriteBatch(batch)) {
+                    return false;
+                }
+                batch.Clear();
+            }
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, CCmpPubKey());
+    pcursor->Seek(key);
+    while (pcursor->Valid()) {
+        if (ShutdownRequested()) return false;
+        if (pcursor->GetKey(key) && key.first == DB_RCTKEYIMAGE) {
+            CAnonKeyImageInfo ki_data;
+            // Versions before 0.19.2.15 store only the txid
+            if (pcursor->GetValueSize() >= 36) {
+                if (!pcursor->GetValue(ki_data)) {
+                    return error("%s: failed to read value", __func__);
+                }
+                batch.Write(std::make_pair(DB_RCTKEYIMAGE_HEIGHT, CAnonKeyImageHeightKey(ki_data.height, key.second)), 0);
+                num_indexed++;
+                if (batch.SizeEstimate() > (1 << 24)) {
+                    if (!WriteBatch(batch)) {
+                        return false;
+                    }
+                    batch.Clear();
+                }
+            }
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+    if (!WriteBatch(batch)) {
+        return false;
+    }
+    LogPrintf("Indexed %d key images by height.\n", num_indexed);
+    return WriteFlag("rctkeyimageheightindex", true);
+};
+
+void CBlockTreeDB::TakeRCTBulkRows(CDBBatch &batch)
+{
+    AssertLockHeld(m_rct_bulk_mutex);
+    if (m_rct_bulk_outputs.empty() && m_rct_bulk_links.empty() && m_rct_bulk_key_images.empty()) {
+        return;
+    }
+    // Rows are appended in db key order, keeps the memtable inserts sequential
+    for (const auto &it : m_rct_bulk_outputs) {
+        batch.Write(std::pair<uint8_t, int64_t>(DB_RCTOUTPUT, it.first), it.second);
+    }
+    const auto key_order = [](const CCmpPubKey *a, const CCmpPubKey *b) {
+        return memcmp(a->begin(), b->begin(), 33) < 0;
+    };
+    std::vector<const CCmpPubKey*> keys;
+    keys.reserve(std::max(m_rct_bulk_links.size(), m_rct_bulk_key_images.size()));
+    for (const auto &it : m_rct_bulk_links) {
+        keys.push_back(&it.first);
+    }
+    std::sort(keys.begin(), keys.end(), key_order);
+    for (const auto *pk : keys) {
+        batch.Write(std::pair<uint8_t, CCmpPubKey>(DB_RCTOUTPUT_LINK, *pk), m_rct_bulk_links[*pk]);
+    }
+    keys.clear();
+    for (const auto &it : m_rct_bulk_key_images) {
+        keys.push_back(&it.first);
+    }
+    std::sort(keys.begin(), keys.end(), key_order);
+    for (const auto *ki : keys) {
+        const CAnonKeyImageInfo &data = m_rct_bulk_key_images[*ki];
+        batch.Write(std::pair<uint8_t, CCmpPubKey>(DB_RCTKEYIMAGE, *ki), data);
+        if (data.height >= 0) {
+            batch.Write(std::make_pair(DB_RCTKEYIMAGE_HEIGHT, CAnonKeyImageHeightKey(data.height, *ki)), 0);
+        }
+    }
+    m_rct_bulk_outputs.clear();
+    m_rct_bulk_links.clear();
+    m_rct_bulk_key_images.clear();
+    m_rct_bulk_written = true;
+};
+
+void CBlockTreeDB::WriteRCTBulkRowsIfFull()
+{
+    AssertLockHeld(m_rct_bulk_mutex);
+    if (m_rct_bulk_outputs.size() + m_rct_bulk_links.size() + m_rct_bulk_key_images.size() < RCT_BULK_LOAD_MAX_ROWS) {
+        return;
+    }
+    CDBBatch batch(*this);
+    TakeRCTBulkRows(batch);
+    if (!WriteBatch(batch)) {
+        LogPrintf("%s: Write failed.\n", __func__);
+    }
+};
+
+bool CBlockTreeDB::FlushRCTBulkLoad()
+{
+    if (!m_rct_bulk_load) {
+        return true;
+    }
+    // Hold the lock until the rows are in the db so readers never miss them
+    LOCK(m_rct_bulk_mutex);
+    CDBBatch batch(*this);
+    TakeRCTBulkRows(batch);
+    if (batch.SizeEstimate() == 0) {
+        return true;
+    }
+    return WriteBatch(batch);
+};
+
+void CBlockTreeDB::SetRCTBulkLoad(bool enable)
+{
+    if (enable == m_rct_bulk_load) {
+        return;
+    }
+    if (enable) {
+        LogPrint(BCLog::COINDB, "Entering RCT index bulk load mode.\n");
+        m_rct_bulk_load = true;
+        return;
+    }
+    if (!FlushRCTBulkLoad()) {
+        LogPrintf("%s: Writing buffered RCT rows failed.\n", __func__);
+    }
+    m_rct_bulk_load = false;
+
+    bool written;
+    {
+        LOCK(m_rct_bulk_mutex);
+        written = m_rct_bulk_written;
+        m_rct_bulk_written = false;
+    }
+    if (!written) {
+        return;
+    }
+    LogPrintf("Compacting the RCT index after bulk load.\n");
+    for (const uint8_t prefix : {uint8_t(DB_RCTOUTPUT), uint8_t(DB_RCTOUTPUT_LINK), uint8_t(DB_RCTKEYIMAGE)}) {
+        CompactRange(prefix, uint8_t(prefix + 1));
+    }
+};
+
+void CBlockTreeDB::StartRCTKeyImageFilterBuild()
+{
+    if ((m_key_image_filter.IsReady() && m_output_link_filter.IsReady()) || m_key_image_filter_thread.joinable()) {
+        return;
+    }
+    m_key_image_filter_thread = std::thread(&util::TraceThread, "kifilter", [this] {
+        for (const uint8_t prefix : {DB_RCTKEYIMAGE, DB_RCTOUTPUT_LINK}) {
+            CRCTKeyImageFilter &filter = prefix == DB_RCTKEYIMAGE ? m_key_image_filter : m_output_link_filter;
+            if (filter.IsReady()) {
+                continue;
+            }
+            std::pair<uint8_t, CCmpPubKey> key = std::make_pair(prefix, CCmpPubKey());
+            size_t total = 0;
+            std::unique_ptr<CDBIterator> pcursor(NewIterator());
+            pcursor->Seek(key);
+
+            while (pcursor->Valid()) {
+                if (m_key_image_filter_interrupt) return;
+                if (pcursor->GetKey(key) && key.first == prefix) {
+                    filter.Insert(key.second);
+                    total++;
+                    pcursor->Next();
+                } else {
+                    break;
+                }
+            }
+            filter.SetReady();
+            LogPrintf("%s filter loaded %d entries.\n", prefix == DB_RCTKEYIMAGE ? "Key image" : "Anon output", total);
+        }
+    });
+}
+
+/** Hash the serialised rows, CAnonOutput can't be serialised into a CHashWriter directly. */
+template <typename... Args>
+static void HashSnapshotRow(CHashWriter &hasher, const Args&... args)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ::SerializeMany(ss, args...);
+    hasher.write(MakeByteSpan(ss));
+}
+
+template <typename... Args>
+static void PutSnapshotRow(CAutoFile &file, CHashWriter &hasher, const Args&... args)
+{
+    ::SerializeMany(file, args...);
+    HashSnapshotRow(hasher, args...);
+}
+
+bool CBlockTreeDB::DumpSnapshotRCTState(CDBIterator &cursor, int64_t anon_outputs, CAutoFile &file, CHashWriter &hasher, const std::function<void()> &interruption_point)
+{
+    // Outputs are numbered from 1 without gaps, the index is implied by the order
+    for (int64_t i = 1; i <= anon_outputs; ++i) {
+        if (i % 5000 == 0) interruption_point();
+        std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, i);
+        cursor.Seek(key);
+        CAnonOutput ao;
+        if (!cursor.Valid() || !cursor.GetKey(key) || key.first != DB_RCTOUTPUT || key.second != i || !cursor.GetValue(ao)) {
+            return error("%s: RCT output %d missing.", __func__, i);
+        }
+        PutSnapshotRow(file, hasher, ao);
+    }
+
+    // Key images and spent cache rows are each followed by a true marker, a false marker ends the list
+    size_t num_rows = 0;
+    std::pair<uint8_t, CCmpPubKey> ki_key = std::make_pair(DB_RCTKEYIMAGE, CCmpPubKey());
+    cursor.Seek(ki_key);
+    while (cursor.Valid() && cursor.GetKey(ki_key) && ki_key.first == DB_RCTKEYIMAGE) {
+        if (++num_rows % 5000 == 0) interruption_point();
+        CAnonKeyImageInfo data;
+        bool read_ok;
+        if (cursor.GetValueSize() < 36) {
+            // Versions before 0.19.2.15 store only the txid
+            data.height = -1;
+            read_ok = cursor.GetValue(data.txid);
+        } else {
+            read_ok = cursor.GetValue(data);
+        }
+        if (!read_ok) {
+            return error("%s: Failed to read key image.", __func__);
+        }
+        PutSnapshotRow(file, hasher, true, ki_key.second, data);
+        cursor.Next();
+    }
+    PutSnapshotRow(file, hasher, false);
+
+    std::pair<uint8_t, COutPoint> sc_key = std::make_pair(DB_SPENTCACHE, COutPoint());
+    cursor.Seek(sc_key);
+    while (cursor.Valid() && cursor.GetKey(sc_key) && sc_key.first == DB_SPENTCACHE) {
+        SpentCoin coin;
+        if (!cursor.GetValue(coin)) {
+            return error("%s: Failed to read spent coin.", __func__);
+        }
+        PutSnapshotRow(file, hasher, true, sc_key.second, coin);
+        cursor.Next();
+    }
+    PutSnapshotRow(file, hasher, false);
+    return true;
+};
+
+bool CBlockTreeDB::LoadSnapshotRCTState(CAutoFile &file, int64_t anon_outputs, int base_height, CHashWriter &hasher, bool write)
+{
+    CDBBatch batch(*this);
+    std::vector<std::pair<int64_t, CAnonOutput> > vao;
+    auto write_batch = [&]() -> bool {
+        if (!write) {
+            return true;
+        }
+        if (!WriteRCTOutputFile(batch, vao) || !WriteBatch(batch)) {
+            return error("%s: Write failed.", __func__);
+        }
+        batch.Clear();
+        vao.clear();
+        return true;
+    };
+    // Spent cache rows are grouped by spend height so the in-memory cache gets whole blocks
+    std::map<int, std::vector<std::pair<COutPoint, SpentCoin> > > spent_coins;
+    size_t num_key_images = 0;
+    try {
+        for (int64_t i = 1; i <= anon_outputs; ++i) {
+            CAnonOutput ao;
+            file >> ao;
+            HashSnapshotRow(hasher, ao);
+            if (ao.nBlockHeight > base_height) {
+                return error("%s: RCT output %d above the snapshot base.", __func__, i);
+            }
+            if (write) {
+                WriteRCTOutput(batch, i, ao);
+                WriteRCTOutputLink(batch, ao.pubkey, i);
+                vao.emplace_back(i, ao);
+                if (batch.SizeEstimate() > 16 << 20 && !write_batch()) {
+                    return false;
+                }
+            }
+        }
+        bool more;
+        while (true) {
+            file >> more;
+            HashSnapshotRow(hasher, more);
+            if (!more) break;
+            CCmpPubKey ki;
+            CAnonKeyImageInfo data;
+            file >> ki >> data;
+            HashSnapshotRow(hasher, ki, data);
+            if (data.height > base_height) {
+                return error("%s: Key image above the snapshot base.", __func__);
+            }
+            num_key_images++;
+            if (write) {
+                WriteRCTKeyImage(batch, ki, data);
+                if (batch.SizeEstimate() > 16 << 20 && !write_batch()) {
+                    return false;
+                }
+            }
+        }
+        while (true) {
+            file >> more;
+            HashSnapshotRow(hasher, more);
+            if (!more) break;
+            COutPoint outpoint;
+            SpentCoin coin;
+            file >> outpoint >> coin;
+            HashSnapshotRow(hasher, outpoint, coin);
+            if ((int)coin.spent_height > base_height) {
+                return error("%s: Spent coin above the snapshot base.", __func__);
+            }
+            if (write) {
+                spent_coins[coin.spent_height].emplace_back(outpoint, coin);
+            }
+        }
+    } catch (const std::ios_base::failure&) {
+        return error("%s: Bad snapshot format or truncated snapshot.", __func__);
+    }
+    for (const auto &it : spent_coins) {
+        WriteSpentCache(batch, it.first, it.second);
+    }
+    if (write) {
+        LogPrintf("[snapshot] loaded %d anon outputs and %d key images\n", anon_outputs, num_key_images);
+    }
+    return write_batch();
+};
+
 bool CBlockTreeDB::ReadSpentCache(const COutPoint &outpoint, SpentCoin &coin)
 {
+    if (m_spent_coin_cache && m_spent_coin_cache->Get(outpoint, coin)) {
+        return true;
+    }
     std::pair<uint8_t, COutPoint> key = std::make_pair(DB_SPENTCACHE, outpoint);
     return Read(key, coin);
 };
 
+void CBlockTreeDB::WriteSpentCache(CDBBatch &batch, int height, const std::vector<std::pair<COutPoint, SpentCoin> > &coins)
+{
+    for (const auto &it : coins) {
+        std::pair<uint8_t, COutPoint> key = std::make_pair(DB_SPENTCACHE, it.first);
+        batch.Write(key, it.second);
+    }
+    if (m_spent_coin_cache) {
+        m_spent_coin_cache->AddBlock(height, coins);
+    }
+};
+
 bool CBlockTreeDB::EraseSpentCache(const COutPoint &outpoint)
 {
-    std::pair<uint8_t, COutPoint> key = std::make_pair(DB_SPENTCACHE, outpoint);
     CDBBatch batch(*this);
-    batch.Erase(key);
+    EraseSpentCache(batch, outpoint);
     return WriteBatch(batch);
 };
+
+void CBlockTreeDB::EraseSpentCache(CDBBatch &batch, const COutPoint &outpoint)
+{
+    if (m_spent_coin_cache) {
+        m_spent_coin_cache->Erase(outpoint);
+    }
+    std::pair<uint8_t, COutPoint> key = std::make_pair(DB_SPENTCACHE, outpoint);
+    batch.Erase(key);
+};
+
+bool CBlockTreeDB::EraseSpentCacheBlock(CDBBatch &batch, int height)
+{
+    std::vector<COutPoint> outpoints;
+    if (!m_spent_coin_cache || !m_spent_coin_cache->TakeBlock(height, outpoints)) {
+        return false;
+    }
+    for (const auto &outpoint : outpoints) {
+        std::pair<uint8_t, COutPoint> key = std::make_pair(DB_SPENTCACHE, outpoint);
+        batch.Erase(key);
+    }
+    return true;
+};
+
+bool CBlockTreeDB::GetSpentCoinCacheStats(CSpentCoinCache::Stats &stats) const
+{
+    if (!m_spent_coin_cache) {
+        return false;
+    }
+    stats = m_spent_coin_cache->GetStats();
+    return true;
+};
+
+size_t CBlockTreeDB::KeyImageFilterUsage() const
+{
+    return m_key_image_filter.DynamicMemoryUsage() + m_output_link_filter.DynamicMemoryUsage();
+}
+
+size_t CBlockTreeDB::RCTBulkLoadUsage()
+{
+    LOCK(m_rct_bulk_mutex);
+    return memusage::DynamicUsage(m_rct_bulk_outputs) + memusage::DynamicUsage(m_rct_bulk_links) + memusage::DynamicUsage(m_rct_bulk_key_images);
+}
+
+size_t CBlockTreeDB::SpentIndexCacheUsage()
+{
+    LOCK(m_spent_index_cache_mutex);
+    return m_spent_index_cache.DynamicMemoryUsage();
+}
@@ -11,20 +11,34 @@
 #include <chain.h>
 #include <insight/addressindex.h>
 #include <insight/spentindex.h>
-#include <insight/timestampindex.h>
 #include <insight/balanceindex.h>
+#include <insight/rewardindex.h>
+#include <lrucache.h>
 #include <rctindex.h>
+#include <rctkeyimagefilter.h>
+#include <rctoutputcache.h>
+#include <spentcoincache.h>
+#include <rctoutputfile.h>
 #include <primitives/block.h>
+#include <sync.h>
+#include <util/hasher.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 class CBlockFileInfo;
+class CAutoFile;
 class CBlockIndex;
+class CHashWriter;
 class uint256;
+struct BlockDeltasRecord;
 namespace Consensus {
 struct Params;
 };
@@ -35,6 +49,15 @@ const char DB_RCTOUTPUT_LINK = 'L';
 const char DB_RCTKEYIMAGE = 'K';
 const char DB_SPENTCACHE = 'S';
 
+//! -rctoutputfile default
+static const bool DEFAULT_RCTOUTPUTFILE = true;
+//! -rctcache default (number of anon outputs)
+static const int64_t DEFAULT_RCTCACHE = 50000;
+//! -spentcache default (number of blocks), covers the spent cache rows kept for MIN_BLOCKS_TO_KEEP blocks
+static const int64_t DEFAULT_SPENTCACHE_BLOCKS = 290;
+//! Buffered RCT index rows in bulk load mode before they are written
+static const size_t RCT_BULK_LOAD_MAX_ROWS = 250000;
+
 
 //! -dbcache default (MiB)
 static const int64_t nDefaultDbCache = 450;
@@ -86,35 +109,65 @@ public:
     void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 };
 
+/** Spent index entries CBlockTreeDB keeps in memory, for explorers resolving the outputs of recent txns */
+static constexpr size_t SPENT_INDEX_CACHE_SIZE{20000};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool compression = true, int maxOpenFiles = 1000);
+    ~CBlockTreeDB();
 
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     void ReadReindexing(bool &fReindexing);
+    /** Heights of a rolling indices rebuild, kept until it completes so an interrupted rebuild resumes */
+    bool WriteRollingRebuild(int rewind_height, int start_height);
+    bool ReadRollingRebuild(int &rewind_height, int &start_height);
+    bool EraseRollingRebuild();
 
     bool ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value);
+    /** Look up many spent index entries at once, entries not in the cache are read in key order. values are null where not found. */
+    void ReadSpentIndex(const std::vector<CSpentIndexKey> &keys, std::vector<CSpentIndexValue> &values);
+    /** Erased entries are dropped from the spent index cache */
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CAddressUnspentFilter *filter = nullptr);
+    /** Outputs of the address passing filter largest first, at most max_results if set and starting after the after key if set.
+     *  False if the value ordered rows are still being built. */
+    bool ReadAddressUnspentByValue(const uint256 &addressHash, int type,
+                                   std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                   const CAddressUnspentFilter &filter, size_t max_results = 0, const CAddressUnspentValueKey *after = nullptr);
+    bool HaveAddressUnspentValueIndex() const { return m_address_unspent_value_index; }
+    /** Write or erase address deltas, update_balances applies them to the per address totals in the same batch */
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool update_balances = false);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool update_balances = false);
+    /** Unknown addresses read as a null value */
+    bool ReadAddressBalanceIndex(const uint256 &addressHash, int type, CAddressBalanceValue &value);
     bool ReadAddressIndex(uint256 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<std::pair<uint256, unsigned int> > &vect) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
-    bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
+                          int start = 0, int end = 0, size_t max_results = 0, const CAddressIndexKey *from = nullptr);
+    /** Copy DB_ADDRESSINDEX rows to the compact format and build the value ordered unspent rows in a background thread,
+     *  reads use the legacy rows and sort by value until it completes. */
+    void StartAddressIndexMigration();
+    bool IsAddressIndexCompact() const { return m_address_index_compact; }
 
-    bool WriteBlockBalancesIndex(const uint256 &key, const BlockBalances &value);
+    bool WriteBlockBalancesIndex(const uint256 &key, int height, const BlockBalances &value);
     bool ReadBlockBalancesIndex(const uint256 &key, BlockBalances &value);
+    /** Read the height keyed balances of every step'th height in [start_height, end_height], heights not in the index are omitted */
+    bool ReadBlockBalancesRange(int start_height, int end_height, int step,
+                                std::vector<std::pair<int, std::pair<uint256, BlockBalances> > > &entries);
+
+    bool WriteBlockRewardIndex(const uint256 &key, const BlockReward &value);
+    bool ReadBlockRewardIndex(const uint256 &key, BlockReward &value);
+
+    bool WriteBlockDeltasIndex(const uint256 &key, const BlockDeltasRecord &value);
+    bool ReadBlockDeltasIndex(const uint256 &key, BlockDeltasRecord &value);
 
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
@@ -124,21 +177,114 @@ public:
 
 
     bool ReadRCTOutput(int64_t i, CAnonOutput &ao);
+    /** Read count consecutive outputs from start, stopping at the first unknown index.
+     *  Rows come from the flat file table where present, the rest from the db in key order
+     *  with one cursor. Bypasses the output cache. Returns the number of outputs read. */
+    size_t ReadRCTOutputs(int64_t start, size_t count, std::vector<CAnonOutput> &outputs);
     bool WriteRCTOutput(int64_t i, const CAnonOutput &ao);
     bool EraseRCTOutput(int64_t i);
+    void EraseRCTOutput(CDBBatch &batch, int64_t i);
+
+    /** Append rows to the flat file table, the new last index is recorded in batch. */
+    bool WriteRCTOutputFile(CDBBatch &batch, const std::vector<std::pair<int64_t, CAnonOutput> > &vao);
+    /** Bring the flat file table in line with the db, nAnonOutputs is taken from the chain tip. */
+    bool SyncRCTOutputFile(int64_t nAnonOutputs);
+    bool GetRCTOutputCacheStats(CRCTOutputCache::Stats &stats) const;
+    bool HaveRCTOutputCache() const { return m_rct_output_cache != nullptr; }
 
     bool ReadRCTOutputLink(const CCmpPubKey &pk, int64_t &i);
+    /** Look up many output links at once, pubkeys missing from the link filter skip the db and the rest are read in key order. indices is -1 where unknown. */
+    void ReadRCTOutputLinks(const std::vector<CCmpPubKey> &pks, std::vector<int64_t> &indices);
     bool WriteRCTOutputLink(const CCmpPubKey &pk, int64_t i);
+    /** Write to batch, or buffer the row in bulk load mode */
+    void WriteRCTOutput(CDBBatch &batch, int64_t i, const CAnonOutput &ao);
+    void WriteRCTOutputLink(CDBBatch &batch, const CCmpPubKey &pk, int64_t i);
     bool EraseRCTOutputLink(const CCmpPubKey &pk);
+    void EraseRCTOutputLink(CDBBatch &batch, const CCmpPubKey &pk);
 
     bool ReadRCTKeyImage(const CCmpPubKey &ki, CAnonKeyImageInfo &data);
+    void WriteRCTKeyImage(CDBBatch &batch, const CCmpPubKey &ki, const CAnonKeyImageInfo &data);
     bool EraseRCTKeyImage(const CCmpPubKey &ki);
+    void EraseRCTKeyImage(CDBBatch &batch, const CCmpPubKey &ki);
     bool EraseRCTKeyImagesAfterHeight(int height);
+    /** Rewrite the (height, keyimage) index from the key images in the db. */
+    bool RebuildRCTKeyImageHeightIndex(size_t &num_indexed);
+    /** Fill the key image and output link filters from the db in a background thread, lookups go to the db until it completes. */
+    void StartRCTKeyImageFilterBuild();
+
+    /**
+     * While enabled, RCT output, link and key image rows written with a batch are buffered and written
+     * in large key ordered batches, reads see the buffered rows and erases write them out first.
+     * Leaving the mode writes the remaining rows and compacts the RCT key ranges.
+     */
+    void SetRCTBulkLoad(bool enable);
+    bool IsRCTBulkLoad() const { return m_rct_bulk_load; }
+    /** Write the buffered rows, the block index sync batch calls this so the rows are durable before the coins db */
+    bool FlushRCTBulkLoad();
+
+    /** Write anon outputs 1 to anon_outputs, the key images and the spent cache rows seen by cursor to a UTXO snapshot */
+    bool DumpSnapshotRCTState(CDBIterator &cursor, int64_t anon_outputs, CAutoFile &file, CHashWriter &hasher, const std::function<void()> &interruption_point);
+    /** Read the rows written by DumpSnapshotRCTState, they are only stored when write is set so the hash can be checked first. */
+    bool LoadSnapshotRCTState(CAutoFile &file, int64_t anon_outputs, int base_height, CHashWriter &hasher, bool write);
 
     bool ReadSpentCache(const COutPoint &outpoint, SpentCoin &coin);
+    /** Write the coins spent by the block at height to batch and the in-memory cache */
+    void WriteSpentCache(CDBBatch &batch, int height, const std::vector<std::pair<COutPoint, SpentCoin> > &coins);
     bool EraseSpentCache(const COutPoint &outpoint);
+    void EraseSpentCache(CDBBatch &batch, const COutPoint &outpoint);
+    /** Erase the rows of the block at height using the in-memory cache, false if the block is not cached */
+    bool EraseSpentCacheBlock(CDBBatch &batch, int height);
+    bool GetSpentCoinCacheStats(CSpentCoinCache::Stats &stats) const;
+    /** Memory held by the key image and output link filters */
+    size_t KeyImageFilterUsage() const;
+    /** Memory held by the rows buffered in bulk load mode */
+    size_t RCTBulkLoadUsage() EXCLUSIVE_LOCKS_REQUIRED(!m_rct_bulk_mutex);
+    size_t SpentIndexCacheUsage() EXCLUSIVE_LOCKS_REQUIRED(!m_spent_index_cache_mutex);
 
     //bool WriteRCTOutputBatch(std::vector<std::pair<int64_t, CAnonOutput> > &vao);
+
+private:
+    /** Address, spent and balances index rows are kept in a separate db when -indexdbdir is set */
+    CDBWrapper &IndexDB() { return m_index_db ? *m_index_db : *this; }
+    std::unique_ptr<CDBWrapper> m_index_db;
+
+    bool UpdateAddressBalanceIndex(CDBBatch &batch, const std::map<std::pair<unsigned int, uint256>, CAddressBalanceValue> &deltas, bool subtract);
+    bool ReadAddressIndexValue(const CAddressIndexKey &key, CAmount &value) EXCLUSIVE_LOCKS_REQUIRED(m_address_index_mutex);
+    bool CopyLegacyAddressIndex();
+    bool BuildAddressUnspentValueIndex();
+    void EraseLegacyAddressIndex();
+
+    std::unique_ptr<CRCTOutputFile> m_rct_output_file;
+    std::unique_ptr<CRCTOutputCache> m_rct_output_cache;
+    std::unique_ptr<CSpentCoinCache> m_spent_coin_cache;
+
+    /** Only entries found in the db are cached, a spent output stays spent until the block is disconnected */
+    Mutex m_spent_index_cache_mutex;
+    LRUCache<COutPoint, CSpentIndexValue, SaltedOutpointHasher> m_spent_index_cache GUARDED_BY(m_spent_index_cache_mutex) {SPENT_INDEX_CACHE_SIZE};
+
+    /** Move the buffered RCT rows into batch, sorted by db key */
+    void TakeRCTBulkRows(CDBBatch &batch) EXCLUSIVE_LOCKS_REQUIRED(m_rct_bulk_mutex);
+    void WriteRCTBulkRowsIfFull() EXCLUSIVE_LOCKS_REQUIRED(m_rct_bulk_mutex);
+    Mutex m_rct_bulk_mutex;
+    std::atomic<bool> m_rct_bulk_load{false};
+    bool m_rct_bulk_written GUARDED_BY(m_rct_bulk_mutex){false};
+    std::map<int64_t, CAnonOutput> m_rct_bulk_outputs GUARDED_BY(m_rct_bulk_mutex);
+    std::unordered_map<CCmpPubKey, int64_t, SaltedCmpPubKeyHasher> m_rct_bulk_links GUARDED_BY(m_rct_bulk_mutex);
+    std::unordered_map<CCmpPubKey, CAnonKeyImageInfo, SaltedCmpPubKeyHasher> m_rct_bulk_key_images GUARDED_BY(m_rct_bulk_mutex);
+
+    CRCTKeyImageFilter m_key_image_filter;
+    CRCTKeyImageFilter m_output_link_filter;
+    std::thread m_key_image_filter_thread;
+    std::atomic<bool> m_key_image_filter_interrupt{false};
+
+    /** Held while address index and unspent rows are written, so the migration never copies a half applied block */
+    Mutex m_address_index_mutex;
+    /** Legacy rows are kept in step with the compact rows until this is set */
+    std::atomic<bool> m_address_index_compact{false};
+    /** DB_ADDRESSUNSPENTVALUEINDEX holds a row for every DB_ADDRESSUNSPENTINDEX row once this is set */
+    std::atomic<bool> m_address_unspent_value_index{false};
+    std::thread m_address_index_migrate_thread;
+    std::atomic<bool> m_address_index_migrate_interrupt{false};
 };
 
 std::optional<bilingual_str> CheckLegacyTxindex(CBlockTreeDB& block_tree_db);
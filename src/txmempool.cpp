@@ -29,15 +29,16 @@
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
 struct update_descendant_state
 {
-    update_descendant_state(int64_t _modifySize, CAmount _modifyFee, int64_t _modifyCount) :
-        modifySize(_modifySize), modifyFee(_modifyFee), modifyCount(_modifyCount)
+    update_descendant_state(int64_t _modifySize, int64_t _modifyEvictionSize, CAmount _modifyFee, int64_t _modifyCount) :
+        modifySize(_modifySize), modifyEvictionSize(_modifyEvictionSize), modifyFee(_modifyFee), modifyCount(_modifyCount)
     {}
 
     void operator() (CTxMemPoolEntry &e)
-        { e.UpdateDescendantState(modifySize, modifyFee, modifyCount); }
+        { e.UpdateDescendantState(modifySize, modifyEvictionSize, modifyFee, modifyCount); }
 
     private:
         int64_t modifySize;
+        int64_t modifyEvictionSize;
         CAmount modifyFee;
         int64_t modifyCount;
 };
@@ -75,6 +76,24 @@ bool TestLockPointValidity(CChain& active_chain, const LockPoints& lp)
     return true;
 }
 
+int64_t GetEvictionCostVSize(const CTransaction& tx)
+{
+    int64_t cost = 0;
+    for (const auto& txin : tx.vin) {
+        uint32_t nInputs, nRingSize;
+        if (txin.IsAnonInput() && txin.GetAnonInfo(nInputs, nRingSize)) {
+            cost += EVICTION_VSIZE_PER_RING_MEMBER * nInputs * nRingSize;
+        }
+    }
+    for (const auto& txout : tx.vpout) {
+        const std::vector<uint8_t>* rangeproof = txout->GetPRangeproof();
+        if (rangeproof && !rangeproof->empty()) {
+            cost += EVICTION_VSIZE_PER_RANGEPROOF;
+        }
+    }
+    return cost;
+}
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& tx, CAmount fee,
                                  int64_t time, unsigned int entry_height,
                                  bool spends_coinbase, int64_t sigops_cost, LockPoints lp)
@@ -86,8 +105,10 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& tx, CAmount fee,
       entryHeight{entry_height},
       spendsCoinbase{spends_coinbase},
       sigOpCost{sigops_cost},
+      m_eviction_size{(int64_t)GetTxSize() + GetEvictionCostVSize(*tx)},
       lockPoints{lp},
       nSizeWithDescendants{GetTxSize()},
+      nEvictionSizeWithDescendants{(uint64_t)m_eviction_size},
       nModFeesWithDescendants{nFee},
       nSizeWithAncestors{GetTxSize()},
       nModFeesWithAncestors{nFee},
@@ -110,6 +131,14 @@ size_t CTxMemPoolEntry::GetTxSize() const
     return GetVirtualTransactionSize(nTxWeight, sigOpCost);
 }
 
+CTransactionRef CTxMemPoolEntry::GetSharedTx() const
+{
+    if (!m_proof_slot.IsNull() && !m_proof_store->Restore(*this->tx, m_proof_slot)) {
+        throw std::runtime_error(strprintf("Failed to restore the rangeproofs of %s", this->tx->GetHash().ToString()));
+    }
+    return this->tx;
+}
+
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendants,
                                       const std::set<uint256>& setExclude, std::set<uint256>& descendants_to_remove,
                                       uint64_t ancestor_size_limit, uint64_t ancestor_count_limit)
@@ -139,11 +168,13 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendan
     // descendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
+    int64_t modifyEvictionSize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
     for (const CTxMemPoolEntry& descendant : descendants) {
         if (!setExclude.count(descendant.GetTx().GetHash())) {
             modifySize += descendant.GetTxSize();
+            modifyEvictionSize += descendant.GetEvictionSize();
             modifyFee += descendant.GetModifiedFee();
             modifyCount++;
             cachedDescendants[updateIt].insert(mapTx.iterator_to(descendant));
@@ -157,7 +188,7 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendan
             }
         }
     }
-    mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
+    mapTx.modify(updateIt, update_descendant_state(modifySize, modifyEvictionSize, modifyFee, modifyCount));
 }
 
 void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashesToUpdate, uint64_t ancestor_size_limit, uint64_t ancestor_count_limit)
@@ -350,9 +381,10 @@ void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors
     }
     const int64_t updateCount = (add ? 1 : -1);
     const int64_t updateSize = updateCount * it->GetTxSize();
+    const int64_t updateEvictionSize = updateCount * it->GetEvictionSize();
     const CAmount updateFee = updateCount * it->GetModifiedFee();
     for (txiter ancestorIt : setAncestors) {
-        mapTx.modify(ancestorIt, update_descendant_state(updateSize, updateFee, updateCount));
+        mapTx.modify(ancestorIt, update_descendant_state(updateSize, updateEvictionSize, updateFee, updateCount));
     }
 }
 
@@ -438,10 +470,12 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
     }
 }
 
-void CTxMemPoolEntry::UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount)
+void CTxMemPoolEntry::UpdateDescendantState(int64_t modifySize, int64_t modifyEvictionSize, CAmount modifyFee, int64_t modifyCount)
 {
     nSizeWithDescendants += modifySize;
     assert(int64_t(nSizeWithDescendants) > 0);
+    nEvictionSizeWithDescendants += modifyEvictionSize;
+    assert(int64_t(nEvictionSizeWithDescendants) >= m_eviction_size);
     nModFeesWithDescendants += modifyFee;
     nCountWithDescendants += modifyCount;
     assert(int64_t(nCountWithDescendants) > 0);
@@ -500,6 +534,15 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     cachedInnerUsage += entry.DynamicMemoryUsage();
 
     const CTransaction& tx = newit->GetTx();
+    if (m_proof_store) {
+        for (const auto &txout : tx.vpout) {
+            const std::vector<uint8_t> *rangeproof = txout->GetPRangeproof();
+            if (rangeproof && !rangeproof->empty()) {
+                m_proof_store->Queue(tx.GetHash());
+                break;
+            }
+        }
+    }
     std::set<uint256> setParentTransactions;
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
         if (tx.vin[i].IsAnonInput()) {
@@ -535,14 +578,13 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
 
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
-    LOCK(cs);
     const CTransaction& tx = entry.GetTx();
 
     if (!tx.IsParticlVersion()) {
         return;
     }
 
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<MempoolInsightIndex::AddressDelta> deltas;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -569,8 +611,7 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
 
         CMempoolAddressDeltaKey key(scriptType, uint256(hashBytes.data(), hashBytes.size()), txhash, j, 1);
         CMempoolAddressDelta delta(count_seconds(entry.GetTime()), nValue * -1, input.prevout.hash, input.prevout.n);
-        mapAddress.insert(std::make_pair(key, delta));
-        inserted.push_back(key);
+        deltas.push_back(std::make_pair(key, delta));
     }
 
     for (unsigned int k = 0; k < tx.vpout.size(); k++) {
@@ -595,54 +636,34 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             continue;
 
         CMempoolAddressDeltaKey key(scriptType, uint256(hashBytes.data(), hashBytes.size()), txhash, k, 0);
-        mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(count_seconds(entry.GetTime()), nValue)));
-        inserted.push_back(key);
+        deltas.push_back(std::make_pair(key, CMempoolAddressDelta(count_seconds(entry.GetTime()), nValue)));
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    m_insight_index.AddAddressDeltas(txhash, deltas);
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint256, int> > &addresses,
                                  std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results) const
 {
-    LOCK(cs);
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::const_iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
-        }
-    }
+    m_insight_index.GetAddressDeltas(addresses, results);
     return true;
 }
 
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
-    LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
-
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
-        }
-        mapAddressInserted.erase(it);
-    }
-
+    m_insight_index.RemoveAddressDeltas(txhash);
     return true;
 }
 
 void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
-    LOCK(cs);
-
     const CTransaction& tx = entry.GetTx();
 
     if (!tx.IsParticlVersion()) {
         return;
     }
 
-    std::vector<CSpentIndexKey> inserted;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spent;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -672,36 +693,20 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
         CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, nValue, scriptType, addressHash);
 
-        mapSpent.insert(std::make_pair(key, value));
-        inserted.push_back(key);
+        spent.push_back(std::make_pair(key, value));
     }
 
-    mapSpentInserted.insert(std::make_pair(txhash, inserted));
+    m_insight_index.AddSpentOutputs(txhash, spent);
 }
 
 bool CTxMemPool::getSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const
 {
-    LOCK(cs);
-    mapSpentIndex::const_iterator it = mapSpent.find(key);
-    if (it != mapSpent.end()) {
-        value = it->second;
-        return true;
-    }
-    return false;
+    return m_insight_index.GetSpent(key, value);
 }
 
 bool CTxMemPool::removeSpentIndex(const uint256 &txhash)
 {
-    LOCK(cs);
-    mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
-        }
-        mapSpentInserted.erase(it);
-    }
-
+    m_insight_index.RemoveSpentOutputs(txhash);
     return true;
 }
 
@@ -742,6 +747,9 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 
     totalTxSize -= it->GetTxSize();
     m_total_fee -= it->GetFee();
+    if (m_proof_store) {
+        m_proof_store->Release(it->m_proof_slot);
+    }
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
     mapTx.erase(it);
@@ -908,12 +916,19 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 
 void CTxMemPool::_clear()
 {
+    if (m_proof_store) {
+        for (const auto &entry : mapTx) {
+            m_proof_store->Release(entry.m_proof_slot);
+        }
+    }
     vTxHashes.clear();
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
     m_total_fee = 0;
     cachedInnerUsage = 0;
+    m_insight_index.Clear();
+    mapKeyImages.Clear();
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -1008,11 +1023,13 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
         CTxMemPoolEntry::Children setChildrenCheck;
         auto iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetHash(), 0));
         uint64_t child_sizes = 0;
+        uint64_t child_eviction_sizes = 0;
         for (; iter != mapNextTx.end() && iter->first->hash == it->GetTx().GetHash(); ++iter) {
             txiter childit = mapTx.find(iter->second->GetHash());
             assert(childit != mapTx.end()); // mapNextTx points to in-mempool transactions
             if (setChildrenCheck.insert(*childit).second) {
                 child_sizes += childit->GetTxSize();
+                child_eviction_sizes += childit->GetEvictionSize();
             }
         }
         assert(setChildrenCheck.size() == it->GetMemPoolChildrenConst().size());
@@ -1020,6 +1037,7 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         assert(it->GetSizeWithDescendants() >= child_sizes + it->GetTxSize());
+        assert(it->GetEvictionSizeWithDescendants() >= child_eviction_sizes + it->GetEvictionSize());
 
         TxValidationState dummy_state; // Not used. CheckTxInputs() should always pass
         dummy_state.SetStateInfo(GetTime(), spendheight, Params().GetConsensus(), fParticlMode, false);
@@ -1151,7 +1169,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
             std::string dummy;
             CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
             for (txiter ancestorIt : setAncestors) {
-                mapTx.modify(ancestorIt, update_descendant_state(0, nFeeDelta, 0));
+                mapTx.modify(ancestorIt, update_descendant_state(0, 0, nFeeDelta, 0));
             }
             // Now update all descendants' modified fees with ancestors
             setEntries setDescendants;
@@ -1184,17 +1202,7 @@ void CTxMemPool::ClearPrioritisation(const uint256& hash)
 
 bool CTxMemPool::HaveKeyImage(const CCmpPubKey &ki, uint256 &hash) const
 {
-    LOCK(cs);
-
-    std::map<CCmpPubKey, uint256>::const_iterator mi;
-    mi = mapKeyImages.find(ki);
-
-    if (mi != mapKeyImages.end()) {
-        hash = mi->second;
-        return true;
-    }
-
-    return false;
+    return mapKeyImages.Get(ki, hash);
 }
 
 const CTransaction* CTxMemPool::GetConflictTx(const COutPoint& prevout) const
@@ -1288,7 +1296,7 @@ void CCoinsViewMemPool::PackageAddTransaction(const CTransactionRef& tx)
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + KeyImageUsage() + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const uint256& txid, const bool unchecked) {
@@ -1388,6 +1396,57 @@ void CTxMemPool::trackPackageRemoved(const CFeeRate& rate) {
     }
 }
 
+bool CTxMemPool::EnableProofSpill(const fs::path &path)
+{
+    LOCK(cs);
+    assert(mapTx.empty());
+    m_proof_store = std::make_unique<CMempoolProofStore>(path);
+    if (!m_proof_store->IsOpen()) {
+        m_proof_store.reset();
+        return false;
+    }
+    return true;
+}
+
+void CTxMemPool::SpillProofs()
+{
+    AssertLockHeld(cs);
+    if (!m_proof_store) {
+        return;
+    }
+    // Transactions held elsewhere, by the wallet for example, are only retried a few times
+    static constexpr int MAX_SPILL_ATTEMPTS = 64;
+    for (const auto &it : m_proof_store->TakeQueue()) {
+        txiter mi = mapTx.find(it.first);
+        if (mi == mapTx.end() || !mi->m_proof_slot.IsNull()) {
+            continue;
+        }
+        if (mi->GetTxRefCount() > 1) {
+            if (it.second < MAX_SPILL_ATTEMPTS) {
+                m_proof_store->Queue(it.first, it.second + 1);
+            }
+            continue;
+        }
+        size_t freed;
+        if (!m_proof_store->Spill(mi->GetTx(), mi->m_proof_slot, freed)) {
+            continue;
+        }
+        mi->m_proof_store = m_proof_store.get();
+        if (mi->m_proof_usage_freed == 0) {
+            mi->m_proof_usage_freed = freed;
+            cachedInnerUsage -= freed;
+        }
+    }
+}
+
+std::optional<CMempoolProofStore::Stats> CTxMemPool::GetProofSpillStats() const
+{
+    if (!m_proof_store) {
+        return std::nullopt;
+    }
+    return m_proof_store->GetStats();
+}
+
 void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining) {
     AssertLockHeld(cs);
 
@@ -15,11 +15,15 @@
 #include <vector>
 
 #include <insight/addressindex.h>
+#include <insight/mempoolindex.h>
 #include <insight/spentindex.h>
 
 #include <coins.h>
 #include <consensus/amount.h>
 #include <indirectmap.h>
+#include <memusage.h>
+#include <mempoolkeyimages.h>
+#include <mempoolproofstore.h>
 #include <policy/feerate.h>
 #include <policy/packages.h>
 #include <primitives/transaction.h>
@@ -48,6 +52,18 @@ enum eMemPoolFlags
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
 
+/** Virtual size added per MLSAG ring member (inputs x ring size) when ranking txns for eviction */
+static const int64_t EVICTION_VSIZE_PER_RING_MEMBER = 60;
+/** Virtual size added per rangeproof when ranking txns for eviction */
+static const int64_t EVICTION_VSIZE_PER_RANGEPROOF = 100;
+
+/**
+ * Virtual size charged for the cost of verifying the anon inputs and rangeproofs of tx.
+ * A typical anon txn paying ANON_FEE_MULTIPLIER times the plain feerate ranks
+ * close to a plain txn for eviction.
+ */
+int64_t GetEvictionCostVSize(const CTransaction& tx);
+
 struct LockPoints {
     // Will be set to the blockchain height and median time past
     // values that would be necessary to satisfy all relative locktime
@@ -111,6 +127,7 @@ private:
     const unsigned int entryHeight; //!< Chain height when entering the mempool
     const bool spendsCoinbase;      //!< keep track of transactions that spend a coinbase
     const int64_t sigOpCost;        //!< Total sigop cost
+    const int64_t m_eviction_size;  //!< Virtual size plus GetEvictionCostVSize, used to rank txns for eviction
     CAmount feeDelta{0};            //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
 
@@ -119,6 +136,7 @@ private:
     // descendants as well.
     uint64_t nCountWithDescendants{1}; //!< number of descendant transactions
     uint64_t nSizeWithDescendants;   //!< ... and size
+    uint64_t nEvictionSizeWithDescendants; //!< ... and eviction size
     CAmount nModFeesWithDescendants; //!< ... and total fees (all including us)
 
     // Analogous statistics for ancestor transactions
@@ -134,7 +152,9 @@ public:
                     int64_t sigops_cost, LockPoints lp);
 
     const CTransaction& GetTx() const { return *this->tx; }
-    CTransactionRef GetSharedTx() const { return this->tx; }
+    /** Puts back rangeproofs moved to the side file, GetTx() may return the transaction without them. */
+    CTransactionRef GetSharedTx() const;
+    long GetTxRefCount() const { return this->tx.use_count(); }
     const CAmount& GetFee() const { return nFee; }
     size_t GetTxSize() const;
     size_t GetTxWeight() const { return nTxWeight; }
@@ -142,11 +162,11 @@ public:
     unsigned int GetHeight() const { return entryHeight; }
     int64_t GetSigOpCost() const { return sigOpCost; }
     CAmount GetModifiedFee() const { return nFee + feeDelta; }
-    size_t DynamicMemoryUsage() const { return nUsageSize; }
+    size_t DynamicMemoryUsage() const { return nUsageSize - m_proof_usage_freed; }
     const LockPoints& GetLockPoints() const { return lockPoints; }
 
     // Adjusts the descendant state.
-    void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
+    void UpdateDescendantState(int64_t modifySize, int64_t modifyEvictionSize, CAmount modifyFee, int64_t modifyCount);
     // Adjusts the ancestor state
     void UpdateAncestorState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount, int64_t modifySigOps);
     // Updates the fee delta used for mining priority score, and the
@@ -157,6 +177,8 @@ public:
 
     uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
     uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
+    int64_t GetEvictionSize() const { return m_eviction_size; }
+    uint64_t GetEvictionSizeWithDescendants() const { return nEvictionSizeWithDescendants; }
     CAmount GetModFeesWithDescendants() const { return nModFeesWithDescendants; }
 
     bool GetSpendsCoinbase() const { return spendsCoinbase; }
@@ -173,6 +195,12 @@ public:
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
     mutable Epoch::Marker m_epoch_marker; //!< epoch when last touched, useful for graph algorithms
+
+    mutable CMempoolProofStore::Slot m_proof_slot; //!< Rangeproofs moved to the side file, see CTxMemPool::SpillProofs
+    mutable CMempoolProofStore *m_proof_store{nullptr};
+    mutable size_t m_proof_usage_freed{0}; //!< Memory of the rangeproofs, not counted since they were first spilled
+
+    bool m_spends_blind{false}; //!< Spends blinded outputs, only known from the coins, see GetFeeEstimateTxType
 };
 
 // extracts a transaction hash from CTxMemPoolEntry or CTransactionRef
@@ -209,6 +237,7 @@ struct mempoolentry_wtxid
 /** \class CompareTxMemPoolEntryByDescendantScore
  *
  *  Sort an entry by max(score/size of entry's tx, score/size with all descendants).
+ *  Sizes are eviction sizes, including the validation cost of anon inputs and rangeproofs.
  */
 class CompareTxMemPoolEntryByDescendantScore
 {
@@ -235,15 +264,15 @@ public:
     {
         // Compare feerate with descendants to feerate of the transaction, and
         // return the fee/size for the max.
-        double f1 = (double)a.GetModifiedFee() * a.GetSizeWithDescendants();
-        double f2 = (double)a.GetModFeesWithDescendants() * a.GetTxSize();
+        double f1 = (double)a.GetModifiedFee() * a.GetEvictionSizeWithDescendants();
+        double f2 = (double)a.GetModFeesWithDescendants() * a.GetEvictionSize();
 
         if (f2 > f1) {
             mod_fee = a.GetModFeesWithDescendants();
-            size = a.GetSizeWithDescendants();
+            size = a.GetEvictionSizeWithDescendants();
         } else {
             mod_fee = a.GetModifiedFee();
-            size = a.GetTxSize();
+            size = a.GetEvictionSize();
         }
     }
 };
@@ -536,17 +565,11 @@ public:
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
-
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
+    /** Address and spent indices, locked separately from cs */
+    MempoolInsightIndex m_insight_index;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
-    mapSpentIndex mapSpent;
-
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
-    mapSpentIndexInserted mapSpentInserted;
+    /** Side file for rangeproofs, set with -mempoolspillproofs */
+    std::unique_ptr<CMempoolProofStore> m_proof_store;
 
     void UpdateParent(txiter entry, txiter parent, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
     void UpdateChild(txiter entry, txiter child, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -582,7 +605,7 @@ public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
     std::map<uint256, CAmount> mapDeltas GUARDED_BY(cs);
 
-    std::map<CCmpPubKey, uint256> mapKeyImages;
+    CMempoolKeyImages mapKeyImages; //!< Modified with cs held, read without
 
 
     /** Create a new CTxMemPool.
@@ -621,6 +644,9 @@ public:
     void addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const;
     bool removeSpentIndex(const uint256 &txhash);
+    size_t InsightIndexUsage() const { return m_insight_index.DynamicMemoryUsage(); }
+    /** Memory usage of mapKeyImages, counted in DynamicMemoryUsage too */
+    size_t KeyImageUsage() const { return mapKeyImages.DynamicMemoryUsage(); }
 
     void removeRecursive(const CTransaction& tx, MemPoolRemovalReason reason) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** After reorg, filter the entries that would no longer be valid in the next block, and update
@@ -652,6 +678,7 @@ public:
     void ApplyDelta(const uint256& hash, CAmount &nFeeDelta) const EXCLUSIVE_LOCKS_REQUIRED(cs);
     void ClearPrioritisation(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Doesn't lock cs, a key image added or removed concurrently may or may not be seen */
     bool HaveKeyImage(const CCmpPubKey &ki, uint256 &hash) const;
 
 public:
@@ -746,6 +773,12 @@ public:
       */
     void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Move rangeproofs to the side file at path once transactions are validated, before the mempool is used. */
+    bool EnableProofSpill(const fs::path &path);
+    /** Spill the rangeproofs of queued transactions the mempool holds the only reference to. */
+    void SpillProofs() EXCLUSIVE_LOCKS_REQUIRED(cs);
+    std::optional<CMempoolProofStore::Stats> GetProofSpillStats() const;
+
     /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
     int Expire(std::chrono::seconds time) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -86,6 +86,7 @@ int TxOrphanage::EraseTx(const uint256& txid)
     }
     m_orphan_list.pop_back();
     m_wtxid_to_orphan_it.erase(it->second.tx->GetWitnessHash());
+    EraseAnonIndex(it);
 
     m_orphans.erase(it);
     return 1;
@@ -157,6 +158,48 @@ void TxOrphanage::AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>
     }
 }
 
+void TxOrphanage::EraseAnonIndex(OrphanMap::iterator it)
+{
+    AssertLockHeld(g_cs_orphans);
+    if (it->second.anon_index == 0) {
+        return;
+    }
+    auto range = m_anon_index_to_orphan_it.equal_range(it->second.anon_index);
+    for (auto mi = range.first; mi != range.second; ++mi) {
+        if (mi->second == it) {
+            m_anon_index_to_orphan_it.erase(mi);
+            break;
+        }
+    }
+    it->second.anon_index = 0;
+}
+
+void TxOrphanage::AwaitAnonIndex(const uint256& txid, int64_t anon_index)
+{
+    AssertLockHeld(g_cs_orphans);
+    const auto it = m_orphans.find(txid);
+    if (it == m_orphans.end() || it->second.anon_index == anon_index) {
+        return;
+    }
+    EraseAnonIndex(it);
+    it->second.anon_index = anon_index;
+    m_anon_index_to_orphan_it.emplace(anon_index, it);
+    LogPrint(BCLog::MEMPOOL, "orphan tx %s awaits anon output %d\n", txid.ToString(), anon_index);
+}
+
+std::vector<std::pair<uint256, NodeId>> TxOrphanage::ReleaseForAnonIndex(int64_t last_anon_index)
+{
+    AssertLockHeld(g_cs_orphans);
+    std::vector<std::pair<uint256, NodeId>> released;
+    auto end = m_anon_index_to_orphan_it.upper_bound(last_anon_index);
+    for (auto mi = m_anon_index_to_orphan_it.begin(); mi != end; ++mi) {
+        mi->second->second.anon_index = 0;
+        released.emplace_back(mi->second->first, mi->second->second.fromPeer);
+    }
+    m_anon_index_to_orphan_it.erase(m_anon_index_to_orphan_it.begin(), end);
+    return released;
+}
+
 bool TxOrphanage::HaveTx(const GenTxid& gtxid) const
 {
     LOCK(g_cs_orphans);
@@ -47,6 +47,13 @@ public:
      * (ie orphans that may have found their final missing parent, and so should be reconsidered for the mempool) */
     void AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
 
+    /** Particl: Keep an orphan anon transaction until the chain's RCT output index reaches anon_index,
+     *  the highest ring member index it was found to be missing */
+    void AwaitAnonIndex(const uint256& txid, int64_t anon_index) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+
+    /** Remove and return the orphans awaiting anon outputs up to last_anon_index, with their originating peers */
+    std::vector<std::pair<uint256, NodeId>> ReleaseForAnonIndex(int64_t last_anon_index) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+
     /** Return how many entries exist in the orphange */
     size_t Size() LOCKS_EXCLUDED(::g_cs_orphans)
     {
@@ -60,6 +67,7 @@ protected:
         NodeId fromPeer;
         int64_t nTimeExpire;
         size_t list_pos;
+        int64_t anon_index{0}; // Awaited RCT output index, 0 if not waiting
     };
 
     /** Map from txid to orphan transaction record. Limited by
@@ -87,6 +95,11 @@ protected:
     /** Index from wtxid into the m_orphans to lookup orphan
      *  transactions using their witness ids. */
     std::map<uint256, OrphanMap::iterator> m_wtxid_to_orphan_it GUARDED_BY(g_cs_orphans);
+
+    /** Index from the awaited RCT output index into the m_orphans, see AwaitAnonIndex */
+    std::multimap<int64_t, OrphanMap::iterator> m_anon_index_to_orphan_it GUARDED_BY(g_cs_orphans);
+
+    void EraseAnonIndex(OrphanMap::iterator it) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
 };
 
 #endif // BITCOIN_TXORPHANAGE_H
@@ -128,7 +128,7 @@ int CLedgerDevice::GetFirmwareVersion(std::string &sFirmware, std::string &sErro
     in[apduSize++] = 0x00;
 
     int sw;
-    int result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    int result = SendApdu(in, apduSize, out, sizeof(out), &sw);
     Close();
 
     if (sw != SW_OK) {
@@ -159,7 +159,7 @@ int CLedgerDevice::GetInfo(UniValue &info, std::string &sError)
     in[apduSize++] = 0x00;
 
     int sw;
-    int result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    int result = SendApdu(in, apduSize, out, sizeof(out), &sw);
 
     if (sw != SW_OK) {
         Close();
@@ -196,7 +196,7 @@ int CLedgerDevice::GetInfo(UniValue &info, std::string &sError)
     in[apduSize++] = 0x00;
     in[apduSize++] = 0x00;
 
-    result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    result = SendApdu(in, apduSize, out, sizeof(out), &sw);
     if (sw == SW_OK) {
         int om = out[0];
         info.pushKV("operation_mode", strprintf("%.2x %s", om,
@@ -248,7 +248,7 @@ int CLedgerDevice::GetPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, bo
     }
 
     int sw;
-    int result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    int result = SendApdu(in, apduSize, out, sizeof(out), &sw);
     Close();
 
     if (sw != SW_OK) {
@@ -297,7 +297,7 @@ int CLedgerDevice::GetXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp,
     }
 
     int sw;
-    int result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    int result = SendApdu(in, apduSize, out, sizeof(out), &sw);
 
     // Get fingerprint
     if (sw == SW_OK && lenPath > 1 && result > 65) {
@@ -306,7 +306,7 @@ int CLedgerDevice::GetXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp,
         in[5] = lenPathParent;
         apduSize -= 4;
 
-        result = sendApduHidHidapi(handle, 1, in, apduSize, outB, sizeof(outB), &sw);
+        result = SendApdu(in, apduSize, outB, sizeof(outB), &sw);
     }
     Close();
 
@@ -388,7 +388,7 @@ int CLedgerDevice::SignMessage(const std::vector<uint32_t> &vPath, const std::st
     in[OFFSET_CDATA] = (apduSize - 5);
 
     int sw;
-    int result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    int result = SendApdu(in, apduSize, out, sizeof(out), &sw);
 
     if (sw != SW_OK) {
         Close();
@@ -412,7 +412,7 @@ int CLedgerDevice::SignMessage(const std::vector<uint32_t> &vPath, const std::st
     in[apduSize++] = 0x00;
     in[apduSize++] = 0x00;
     in[OFFSET_CDATA] = (apduSize - 5);
-    result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    result = SendApdu(in, apduSize, out, sizeof(out), &sw);
 
     Close();
 
@@ -449,6 +449,15 @@ int CLedgerDevice::SignMessage(const std::vector<uint32_t> &vPath, const std::st
     return 0;
 };
 
+int CLedgerDevice::SendApdu(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len, int *sw)
+{
+    if (IsCancelled()) {
+        *sw = 0;
+        return -1;
+    }
+    return sendApduHidHidapi(handle, 1, in, in_len, out, out_len, sw);
+};
+
 int CLedgerDevice::PrepareTransaction(CMutableTransaction &tx, const CCoinsViewCache &view, const FillableSigningProvider &keystore, int nHashType,
                                       int change_pos, const std::vector<uint32_t> &change_path)
 {
@@ -472,7 +481,7 @@ int CLedgerDevice::PrepareTransaction(CMutableTransaction &tx, const CCoinsViewC
     in[apduSize++] = 0x00;
     apduSize += part::PutVarInt(&in[apduSize], tx.vin.size());
 
-    result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    result = SendApdu(in, apduSize, out, sizeof(out), &sw);
     if (sw != SW_OK) {
         return errorN(1, m_error, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
     }
@@ -518,7 +527,7 @@ int CLedgerDevice::PrepareTransaction(CMutableTransaction &tx, const CCoinsViewC
 
         in[ofslen] = apduSize - (ofslen + 1);
 
-        result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+        result = SendApdu(in, apduSize, out, sizeof(out), &sw);
         if (sw != SW_OK) {
             return errorN(1, m_error, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
         }
@@ -546,7 +555,7 @@ int CLedgerDevice::PrepareTransaction(CMutableTransaction &tx, const CCoinsViewC
 
             in[ofslen] = apduSize - (ofslen+1);
 
-            result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+            result = SendApdu(in, apduSize, out, sizeof(out), &sw);
             if (sw != SW_OK) {
                 return errorN(1, m_error, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
             }
@@ -573,7 +582,7 @@ int CLedgerDevice::PrepareTransaction(CMutableTransaction &tx, const CCoinsViewC
             WriteBE32(&in[apduSize], change_path[k]);
         }
 
-        result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+        result = SendApdu(in, apduSize, out, sizeof(out), &sw);
         if (sw != SW_OK || result < 0) {
             return errorN(1, m_error, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
         }
@@ -630,7 +639,7 @@ int CLedgerDevice::PrepareTransaction(CMutableTransaction &tx, const CCoinsViewC
         memcpy(&in[apduSize], &vOutputData[offset], dataLength);
         apduSize += dataLength;
 
-        result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+        result = SendApdu(in, apduSize, out, sizeof(out), &sw);
         if (sw != SW_OK || result < 0) {
             return errorN(1, m_error, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
         }
@@ -638,12 +647,60 @@ int CLedgerDevice::PrepareTransaction(CMutableTransaction &tx, const CCoinsViewC
         offset += dataLength;
     }
 
+    // Collect the signable inputs, then request all signatures in one pass while the device is open
+    bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
+
+    m_cache.clear();
+    m_preparing = true;
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        const Coin &coin = view.AccessCoin(tx.vin[i].prevout);
+        if (coin.IsSpent() || coin.nType != OUTPUT_STANDARD) {
+            continue;
+        }
+
+        const CScript &prevPubKey = coin.out.scriptPubKey;
+        std::vector<uint8_t> vchAmount(8);
+        part::SetAmount(vchAmount, coin.out.nValue);
+        SignatureData sigdata = DataFromTransaction(tx, i, vchAmount, prevPubKey);
+
+        if (!fHashSingle || (i < tx.GetNumVOuts())) {
+            ProduceSignature(keystore, DeviceSignatureCreator(this, &tx, i, vchAmount, nHashType), prevPubKey, sigdata);
+        }
+    }
+    m_preparing = false;
+
+    for (auto &ci : m_cache) {
+        SignData &sd = ci.second;
+        if (0 != SignInput(sd.m_path, sd.m_shared_secret, &tx, ci.first, sd.m_scriptCode, sd.m_hashType, sd.m_amount, sd.m_signature, m_error)) {
+            m_cache.clear();
+            return 1;
+        }
+    }
+
     return 0;
 };
 
 int CLedgerDevice::SignTransaction(const std::vector<uint32_t> &vPath, const std::vector<uint8_t> &vSharedSecret, const CMutableTransaction *tx,
     int nIn, const CScript &scriptCode, int hashType, const std::vector<uint8_t>& amount, SigVersion sigversion,
     std::vector<uint8_t> &vchSig, std::string &sError)
+{
+    if (m_preparing) {
+        m_cache[nIn] = SignData(vPath, vSharedSecret, scriptCode, hashType, amount, sigversion);
+        return 0;
+    }
+    const auto ci = m_cache.find(nIn);
+    if (ci != m_cache.end() && !ci->second.m_signature.empty() &&
+        ci->second.m_path == vPath && ci->second.m_scriptCode == scriptCode && ci->second.m_hashType == hashType) {
+        vchSig = ci->second.m_signature;
+        return 0;
+    }
+
+    return SignInput(vPath, vSharedSecret, tx, nIn, scriptCode, hashType, amount, vchSig, sError);
+};
+
+int CLedgerDevice::SignInput(const std::vector<uint32_t> &vPath, const std::vector<uint8_t> &vSharedSecret, const CMutableTransaction *tx,
+    int nIn, const CScript &scriptCode, int hashType, const std::vector<uint8_t> &amount,
+    std::vector<uint8_t> &vchSig, std::string &sError)
 {
     if (!handle) {
         return errorN(1, sError, __func__, "Device not open.");
@@ -669,7 +726,7 @@ int CLedgerDevice::SignTransaction(const std::vector<uint32_t> &vPath, const std
     in[apduSize++] = 0x00;
     apduSize += part::PutVarInt(&in[apduSize], 1);
 
-    result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    result = SendApdu(in, apduSize, out, sizeof(out), &sw);
     if (sw != SW_OK) {
         return errorN(1, sError, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
     }
@@ -697,7 +754,7 @@ int CLedgerDevice::SignTransaction(const std::vector<uint32_t> &vPath, const std
 
     in[ofslen] = apduSize - (ofslen + 1);
 
-    result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    result = SendApdu(in, apduSize, out, sizeof(out), &sw);
     if (sw != SW_OK) {
         return errorN(1, sError, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
     }
@@ -723,7 +780,7 @@ int CLedgerDevice::SignTransaction(const std::vector<uint32_t> &vPath, const std
         }
 
         in[ofslen] = apduSize - (ofslen + 1);
-        result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+        result = SendApdu(in, apduSize, out, sizeof(out), &sw);
         if (sw != SW_OK) {
             return errorN(1, sError, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
         }
@@ -755,7 +812,7 @@ int CLedgerDevice::SignTransaction(const std::vector<uint32_t> &vPath, const std
     }
 
     in[ofslen] = apduSize - (ofslen+1);
-    result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
+    result = SendApdu(in, apduSize, out, sizeof(out), &sw);
     if (sw != SW_OK) {
         return errorN(1, sError, __func__, "Dongle error: %.4x %s", sw, GetLedgerString(sw));
     }
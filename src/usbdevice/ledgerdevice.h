@@ -18,7 +18,7 @@ public:
     CLedgerDevice(const DeviceType *pType_, const char *cPath_, const char *cSerialNo_, int nInterface_)
         : CUSBDevice(pType_, cPath_, cSerialNo_, nInterface_) {};
 
-    void Cleanup() override { Close(); };
+    void Cleanup() override { m_cache.clear(); Close(); };
     int Open() override;
     int Close() override;
 
@@ -38,6 +38,15 @@ public:
         std::vector<uint8_t> &vchSig, std::string &sError) override;
 
 protected:
+    /** Exchange one APDU with the device, fails without I/O once the request is cancelled */
+    int SendApdu(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len, int *sw);
+
+    /** Sign one input of a transaction hashed by PrepareTransaction */
+    int SignInput(const std::vector<uint32_t> &vPath, const std::vector<uint8_t> &vSharedSecret, const CMutableTransaction *tx,
+        int nIn, const CScript &scriptCode, int hashType, const std::vector<uint8_t> &amount,
+        std::vector<uint8_t> &vchSig, std::string &sError);
+
+
     hid_device *handle = nullptr;
 };
 
@@ -113,7 +113,7 @@ static RPCHelpMan deviceloadmnemonic()
 
     UniValue result(UniValue::VOBJ);
     std::string sError;
-    if (0 == pDevice->LoadMnemonic(wordcount, pinprotection, sError)) {
+    if (0 == usb_device::RunDeviceRequest(pDevice, [&]() { return pDevice->LoadMnemonic(wordcount, pinprotection, sError); }, sError)) {
         result.pushKV("complete", "Device loaded");
     } else {
         result.pushKV("error", sError);
@@ -144,7 +144,7 @@ static RPCHelpMan devicebackup()
 
     UniValue result(UniValue::VOBJ);
     std::string sError;
-    if (0 == pDevice->Backup(sError)) {
+    if (0 == usb_device::RunDeviceRequest(pDevice, [&]() { return pDevice->Backup(sError); }, sError)) {
         result.pushKV("complete", "Device backed up");
     } else {
         result.pushKV("error", sError);
@@ -234,7 +234,7 @@ static RPCHelpMan promptunlockdevice()
 
     UniValue result(UniValue::VOBJ);
     std::string sError;
-    if (0 != pDevice->PromptUnlock(sError)) {
+    if (0 != usb_device::RunDeviceRequest(pDevice, [&]() { return pDevice->PromptUnlock(sError); }, sError)) {
         throw JSONRPCError(RPC_INTERNAL_ERROR, sError);
     }
 
@@ -365,7 +365,7 @@ static RPCHelpMan getdevicepublickey()
 
     std::string sError;
     CPubKey pk;
-    if (0 != pDevice->GetPubKey(vPath, pk, true, sError)) {
+    if (0 != usb_device::RunDeviceRequest(pDevice, [&]() { return pDevice->GetPubKey(vPath, pk, true, sError); }, sError)) {
         throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("GetPubKey failed %s.", sError));
     }
 
@@ -453,7 +453,7 @@ static RPCHelpMan devicesignmessage()
 
     std::string sError, sMessage = request.params[1].get_str();
     std::vector<uint8_t> vchSig;
-    if (0 != pDevice->SignMessage(vPath, sMessage, vchSig, sError)) {
+    if (0 != usb_device::RunDeviceRequest(pDevice, [&]() { return pDevice->SignMessage(vPath, sMessage, vchSig, sError); }, sError)) {
         throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("SignMessage failed %s.", sError));
     }
 
@@ -569,7 +569,7 @@ static RPCHelpMan devicesignrawtransaction()
             GetPath(pathkey.vPath, paths[idx], request.params[4]);
 
             std::string sError;
-            if (0 != pDevice->GetPubKey(pathkey.vPath, pathkey.pk, false, sError)) {
+            if (0 != pDevice->GetCachedPubKey(pathkey.vPath, pathkey.pk, sError)) {
                 throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Device GetPubKey failed %s.", sError));
             }
 
@@ -681,7 +681,9 @@ static RPCHelpMan devicesignrawtransaction()
     // Prepare transaction
     int change_pos = -1;
     std::vector<uint32_t> change_path;
-    int prep = pDevice->PrepareTransaction(mtx, view, keystore, nHashType, change_pos, change_path);
+    int prep = usb_device::RunDeviceRequest(pDevice, [&]() {
+        return pDevice->PrepareTransaction(mtx, view, keystore, nHashType, change_pos, change_path);
+    }, pDevice->m_error);
     if (0 != prep) {
         throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("PrepareTransaction failed with code %d.", prep));
     }
@@ -1276,7 +1278,7 @@ static RPCHelpMan devicesignrawtransactionwithwallet()
             GetPath(pathkey.vPath, paths[idx], request.params[4]);
 
             std::string sError;
-            if (0 != pDevice->GetPubKey(pathkey.vPath, pathkey.pk, false, sError)) {
+            if (0 != pDevice->GetCachedPubKey(pathkey.vPath, pathkey.pk, sError)) {
                 throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Device GetPubKey failed %s.", sError));
             }
 
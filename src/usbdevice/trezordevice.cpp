@@ -108,14 +108,22 @@ int CTrezorDevice::WriteV1(uint16_t msg_type, const std::vector<uint8_t> &vec)
     return 0;
 };
 
-static int ReadWithTimeoutV1(webusb_device* handle, uint16_t& msg_type, std::vector<uint8_t>& vec, int timeout)
+static int ReadWithTimeoutV1(webusb_device* handle, uint16_t& msg_type, std::vector<uint8_t>& vec, int timeout, const CUSBDevice* device)
 {
     static const size_t BUFFER_LEN = 64;
+    static const int POLL_MS = 250;
     uint8_t buffer[BUFFER_LEN];
 
-    size_t result = webusb_read_timeout(handle, buffer, BUFFER_LEN, timeout);
+    // Poll for the first packet, the device may be waiting on the user
+    int result = 0;
+    for (int waited = 0; result == 0; waited += POLL_MS) {
+        if (waited >= timeout || device->IsCancelled()) {
+            return -1;
+        }
+        result = webusb_read_timeout(handle, buffer, BUFFER_LEN, std::min(POLL_MS, timeout - waited));
+    }
     if (result < 9) {
-        return result;
+        return -1;
     }
     if (buffer[0] != '?' || buffer[1] != '#' || buffer[2] != '#') {
         return -1;
@@ -138,7 +146,7 @@ static int ReadWithTimeoutV1(webusb_device* handle, uint16_t& msg_type, std::vec
     while (read < len_full) {
         int result = webusb_read_timeout(handle, buffer, BUFFER_LEN, timeout);
         if (result < 1) {
-            return result;
+            return -1;
         }
         if (buffer[0] != '?') {
             return -1;
@@ -153,7 +161,7 @@ static int ReadWithTimeoutV1(webusb_device* handle, uint16_t& msg_type, std::vec
 
 int CTrezorDevice::ReadV1(uint16_t &msg_type, std::vector<uint8_t> &vec)
 {
-    return ReadWithTimeoutV1(handle, msg_type, vec, 60000);
+    return ReadWithTimeoutV1(handle, msg_type, vec, 60000, this);
 };
 
 int CTrezorDevice::OpenIfUnlocked(std::string &sError)
@@ -15,25 +15,6 @@ typedef struct webusb_device webusb_device;
 class CTrezorDevice : public CUSBDevice
 {
 private:
-    class SignData
-    {
-    public:
-        SignData() {};
-        SignData(const CScript &scriptCode, int hashType, const std::vector<uint8_t> &amount)
-            : m_scriptCode(scriptCode), m_hashType(hashType), m_amount(amount) {};
-        SignData(const std::vector<uint32_t> &path, const std::vector<uint8_t> &shared_secret,
-                 const CScript &scriptCode, int hashType, const std::vector<uint8_t> &amount, SigVersion sigversion)
-            : m_path(path), m_shared_secret(shared_secret),
-              m_scriptCode(scriptCode), m_hashType(hashType), m_amount(amount), m_sigversion(sigversion) {};
-        std::vector<uint32_t> m_path;
-        std::vector<uint8_t> m_shared_secret;
-        CScript m_scriptCode;
-        int m_hashType = 0;
-        std::vector<uint8_t> m_amount;
-        SigVersion m_sigversion = SigVersion::BASE;
-        std::vector<uint8_t> m_signature;
-    };
-
     std::string GetCoinName();
 
 public:
@@ -75,8 +56,6 @@ public:
     bool HavePrevTxn(const uint256 &txid) override;
     int AddPrevTxn(CTransactionRef tx) override;
 
-    bool m_preparing = false;
-    std::map<int, SignData> m_cache;
     std::map<uint256, CMutableTransaction> m_tx_cache;
 private:
     int WriteV1(uint16_t msg_type, const std::vector<uint8_t> &vec);
@@ -5,6 +5,10 @@
 #include <usbdevice/usbdevice.h>
 
 #include <key/extkey.h>
+#include <key/keyutil.h>
+#include <shutdown.h>
+#include <sync.h>
+#include <util/thread.h>
 #include <usbdevice/debugdevice.h>
 #include <usbdevice/ledgerdevice.h>
 #include <usbdevice/trezordevice.h>
@@ -22,6 +26,12 @@
 
 #include <google/protobuf/stubs/common.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <thread>
+
 namespace usb_device {
 
 const DeviceType usbDeviceTypes[] = {
@@ -38,8 +48,123 @@ const DeviceType webusbDeviceTypes[] = {
     DeviceType(0x1209, 0x53c1, "Trezor", "One", USBDEVICE_TREZOR_ONE),
 };
 
+namespace {
+/** Xpubs received from a device, the first xpub fetched is used to detect a different seed behind the same device id */
+struct DeviceKeyCache
+{
+    std::vector<uint32_t> check_path;
+    std::map<std::vector<uint32_t>, CExtPubKey> xpubs;
+};
+Mutex cs_device_key_cache;
+std::map<std::string, DeviceKeyCache> device_key_cache GUARDED_BY(cs_device_key_cache);
+
+/** Runs the queued requests for one device in order */
+class DeviceIOThread
+{
+public:
+    DeviceIOThread()
+    {
+        m_thread = std::thread(&util::TraceThread, "devio", [this] { Run(); });
+    }
+    ~DeviceIOThread()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    std::future<int> Push(std::function<int()> request) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        std::packaged_task<int()> task(std::move(request));
+        std::future<int> result = task.get_future();
+        {
+            LOCK(m_mutex);
+            m_queue.push_back(std::move(task));
+        }
+        m_cv.notify_one();
+        return result;
+    }
+
+private:
+    void Run() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        for (;;) {
+            std::packaged_task<int()> task;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_queue.empty(); });
+                if (m_queue.empty()) {
+                    return;
+                }
+                task = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            task();
+        }
+    }
+
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::packaged_task<int()>> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+};
+Mutex cs_device_io;
+std::map<std::string, std::unique_ptr<DeviceIOThread>> device_io_threads GUARDED_BY(cs_device_io);
+} // namespace
+
+void ClearDeviceKeyCache()
+{
+    LOCK(cs_device_key_cache);
+    device_key_cache.clear();
+}
+
+int RunDeviceRequest(CUSBDevice *pDevice, const std::function<int()> &request, std::string &sError)
+{
+    DeviceIOThread *io_thread;
+    {
+        LOCK(cs_device_io);
+        std::unique_ptr<DeviceIOThread> &t = device_io_threads[pDevice->GetCacheId()];
+        if (!t) {
+            t = std::make_unique<DeviceIOThread>();
+        }
+        io_thread = t.get();
+    }
+
+    pDevice->m_cancel = false;
+    std::future<int> result = io_thread->Push([pDevice, &request]() {
+        if (pDevice->IsCancelled()) {
+            return 1;
+        }
+        return request();
+    });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{gArgs.GetIntArg("-devicetimeout", DEFAULT_DEVICE_TIMEOUT)};
+    while (result.wait_for(std::chrono::milliseconds{250}) != std::future_status::ready) {
+        bool shutdown = ShutdownRequested();
+        if (shutdown || std::chrono::steady_clock::now() > deadline) {
+            // Wait for the request to unwind, it may reference state owned by the caller
+            pDevice->m_cancel = true;
+            result.wait();
+            return errorN(1, sError, __func__, shutdown ? "Shutdown requested." : "Device request timed out.");
+        }
+    }
+    return result.get();
+}
+
 void ShutdownHardwareIntegration()
 {
+    {
+        LOCK(cs_device_io);
+        device_io_threads.clear();
+    }
+    ClearDeviceKeyCache();
+
     // Safe to call ShutdownProtobufLibrary multiple times
     google::protobuf::ShutdownProtobufLibrary();
 }
@@ -56,6 +181,136 @@ int CUSBDevice::GetInfo(UniValue &info, std::string &sError)
     return 0;
 };
 
+std::string CUSBDevice::GetCacheId() const
+{
+    return strprintf("%d/%s", pType ? pType->type : USBDEVICE_UNKNOWN, cSerialNo);
+}
+
+int CUSBDevice::CheckKeyCache(std::string &sError)
+{
+    if (m_key_cache_checked) {
+        return 0;
+    }
+    const std::string cache_id = GetCacheId();
+    std::vector<uint32_t> check_path;
+    CExtPubKey ekp_cached;
+    {
+        LOCK(cs_device_key_cache);
+        const auto mi = device_key_cache.find(cache_id);
+        if (mi != device_key_cache.end()) {
+            check_path = mi->second.check_path;
+            ekp_cached = mi->second.xpubs[check_path];
+        }
+    }
+    if (!check_path.empty()) {
+        CExtPubKey ekp_check;
+        if (0 != GetXPub(check_path, ekp_check, sError)) {
+            return 1;
+        }
+        if (!(ekp_check == ekp_cached)) {
+            LogPrintf("%s: Device %s returned a different key, clearing cached keys.\n", __func__, cache_id);
+            LOCK(cs_device_key_cache);
+            device_key_cache.erase(cache_id);
+        }
+    }
+    m_key_cache_checked = true;
+    return 0;
+}
+
+int CUSBDevice::GetCachedXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp, std::string &sError)
+{
+    if (vPath.empty()) {
+        return GetXPub(vPath, ekp, sError);
+    }
+    const std::string cache_id = GetCacheId();
+    if (0 != CheckKeyCache(sError)) {
+        return 1;
+    }
+
+    {
+        LOCK(cs_device_key_cache);
+        const auto mi = device_key_cache.find(cache_id);
+        if (mi != device_key_cache.end()) {
+            const auto mk = mi->second.xpubs.find(vPath);
+            if (mk != mi->second.xpubs.end()) {
+                ekp = mk->second;
+                return 0;
+            }
+        }
+    }
+
+    // Derive from the nearest cached xpub if only non hardened steps remain
+    for (size_t n = vPath.size() - 1; n > 0; --n) {
+        if (IsHardened(vPath[n])) {
+            break;
+        }
+        std::vector<uint32_t> parent_path(vPath.begin(), vPath.begin() + n);
+        CExtPubKey ekp_parent;
+        {
+            LOCK(cs_device_key_cache);
+            const auto mi = device_key_cache.find(cache_id);
+            if (mi == device_key_cache.end()) {
+                break;
+            }
+            const auto mk = mi->second.xpubs.find(parent_path);
+            if (mk == mi->second.xpubs.end()) {
+                continue;
+            }
+            ekp_parent = mk->second;
+        }
+        for (size_t k = n; k < vPath.size(); ++k) {
+            CExtPubKey ekp_child;
+            if (!ekp_parent.Derive(ekp_child, vPath[k])) {
+                return errorN(1, sError, __func__, "CExtPubKey Derive failed.");
+            }
+            ekp_parent = ekp_child;
+        }
+        ekp = ekp_parent;
+        return 0;
+    }
+
+    if (0 != GetXPub(vPath, ekp, sError)) {
+        return 1;
+    }
+
+    LOCK(cs_device_key_cache);
+    DeviceKeyCache &cache = device_key_cache[cache_id];
+    if (cache.check_path.empty()) {
+        cache.check_path = vPath;
+    }
+    cache.xpubs[vPath] = ekp;
+    return 0;
+}
+
+int CUSBDevice::GetCachedPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, std::string &sError)
+{
+    // Find the last hardened step, keys below it can be derived on the host
+    size_t n_parent = vPath.size();
+    while (n_parent > 0 && !IsHardened(vPath[n_parent - 1])) {
+        n_parent--;
+    }
+
+    if (n_parent > 0 && n_parent < vPath.size()) {
+        std::vector<uint32_t> parent_path(vPath.begin(), vPath.begin() + n_parent);
+        CExtPubKey ekp;
+        if (0 != GetCachedXPub(parent_path, ekp, sError)) {
+            return 1;
+        }
+        for (size_t k = n_parent; k < vPath.size(); ++k) {
+            CExtPubKey ekp_child;
+            if (!ekp.Derive(ekp_child, vPath[k])) {
+                return errorN(1, sError, __func__, "CExtPubKey Derive failed.");
+            }
+            ekp = ekp_child;
+        }
+        pk = ekp.pubkey;
+        return 0;
+    }
+
+    // Hardened keys can only come from the device
+    return GetPubKey(vPath, pk, false, sError);
+}
+
 static bool MatchLedgerInterface(struct hid_device_info *cur_dev)
 {
 #ifdef MAC_OSX
@@ -7,12 +7,15 @@
 
 #include <string.h>
 #include <assert.h>
+#include <map>
 #include <vector>
 #include <string>
 
 #include <pubkey.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
+#include <atomic>
+#include <functional>
 #include <memory>
 
 struct CExtPubKey;
@@ -31,6 +34,9 @@ enum DeviceTypeID {
     USBDEVICE_SIZE,
 };
 
+/** Seconds to wait for a device request before cancelling it */
+static const int64_t DEFAULT_DEVICE_TIMEOUT = 300;
+
 void ShutdownHardwareIntegration();
 
 class CPathKey
@@ -99,6 +105,26 @@ extern const DeviceType usbDeviceTypes[];
 class CUSBDevice
 {
 public:
+    /** Input data collected by PrepareTransaction, to request all signatures from the device in one pass */
+    class SignData
+    {
+    public:
+        SignData() {};
+        SignData(const CScript &scriptCode, int hashType, const std::vector<uint8_t> &amount)
+            : m_scriptCode(scriptCode), m_hashType(hashType), m_amount(amount) {};
+        SignData(const std::vector<uint32_t> &path, const std::vector<uint8_t> &shared_secret,
+                 const CScript &scriptCode, int hashType, const std::vector<uint8_t> &amount, SigVersion sigversion)
+            : m_path(path), m_shared_secret(shared_secret),
+              m_scriptCode(scriptCode), m_hashType(hashType), m_amount(amount), m_sigversion(sigversion) {};
+        std::vector<uint32_t> m_path;
+        std::vector<uint8_t> m_shared_secret;
+        CScript m_scriptCode;
+        int m_hashType = 0;
+        std::vector<uint8_t> m_amount;
+        SigVersion m_sigversion = SigVersion::BASE;
+        std::vector<uint8_t> m_signature;
+    };
+
     CUSBDevice() {};
     virtual ~CUSBDevice() {};
     CUSBDevice(const DeviceType *pType_, const char *cPath_, const char *cSerialNo_, int nInterface_) : pType(pType_)
@@ -126,6 +152,14 @@ public:
     virtual int GetPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, bool display, std::string &sError) { return 0; };
     virtual int GetXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp, std::string &sError) { return 0; };
 
+    /**
+     * As GetXPub and GetPubKey, served from the process wide xpub cache of this device where possible.
+     * Public keys below the last hardened step of vPath are derived on the host from the cached parent xpub.
+     * Cached xpubs are revalidated against the device once per CUSBDevice instance.
+     */
+    int GetCachedXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp, std::string &sError);
+    int GetCachedPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, std::string &sError);
+
     virtual int SignMessage(const std::vector<uint32_t> &vPath, const std::string &sMessage, std::vector<uint8_t> &vchSig, std::string &sError) { return 0; };
 
     virtual int PrepareTransaction(CMutableTransaction &tx, const CCoinsViewCache &view, const FillableSigningProvider &keystore, int nHashType,
@@ -153,8 +187,34 @@ public:
     char cSerialNo[128];
     int nInterface;
     std::string m_error;
+
+    /** Set while PrepareTransaction collects inputs, SignTransaction only records the SignData */
+    bool m_preparing = false;
+    std::map<int, SignData> m_cache;
+
+    /** Set when the request running on the I/O thread should give up */
+    std::atomic<bool> m_cancel{false};
+    bool IsCancelled() const { return m_cancel.load(std::memory_order_relaxed); }
+
+    /** Identifies the physical device across instances */
+    std::string GetCacheId() const;
+
+private:
+    /** Drop the cached keys of this device if it no longer returns the same check xpub */
+    int CheckKeyCache(std::string &sError);
+    bool m_key_cache_checked = false;
 };
 
+/** Clear the cached device keys */
+void ClearDeviceKeyCache();
+
+/**
+ * Run request on the I/O thread of pDevice, requests to one device are queued and run in order.
+ * Waits up to -devicetimeout seconds, on timeout or shutdown the device is cancelled and the
+ * request is waited for to unwind, pDevice and any state captured by request must outlive the call.
+ */
+int RunDeviceRequest(CUSBDevice *pDevice, const std::function<int()> &request, std::string &sError);
+
 
 void ListHIDDevices(std::vector<std::unique_ptr<CUSBDevice> > &vDevices);
 void ListWebUSBDevices(std::vector<std::unique_ptr<CUSBDevice> > &vDevices);
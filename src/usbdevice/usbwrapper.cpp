@@ -416,6 +416,9 @@ int webusb_read_timeout(webusb_device *dev, unsigned char *data, size_t length,
         &transferred,
         milliseconds);
 
+    if (res == LIBUSB_ERROR_TIMEOUT && transferred == 0) {
+        return 0;
+    }
     if (res) {
         LogPrintf("%s: Transfer failed with %d.\n", __func__, res);
         return -1;
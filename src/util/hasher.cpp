@@ -11,6 +11,8 @@ SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand<uint64_t>()), k1(GetRand<uint6
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand<uint64_t>()), k1(GetRand<uint64_t>()) {}
 
+SaltedCmpPubKeyHasher::SaltedCmpPubKeyHasher() : k0(GetRand<uint64_t>()), k1(GetRand<uint64_t>()) {}
+
 SaltedSipHasher::SaltedSipHasher() : m_k0(GetRand<uint64_t>()), m_k1(GetRand<uint64_t>()) {}
 
 size_t SaltedSipHasher::operator()(const Span<const unsigned char>& script) const
@@ -7,6 +7,7 @@
 
 #include <crypto/siphash.h>
 #include <primitives/transaction.h>
+#include <pubkey.h>
 #include <uint256.h>
 
 class SaltedTxidHasher
@@ -92,4 +93,18 @@ public:
     size_t operator()(const Span<const unsigned char>& script) const;
 };
 
+class SaltedCmpPubKeyHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedCmpPubKeyHasher();
+
+    size_t operator()(const CCmpPubKey& pk) const noexcept {
+        return CSipHasher(k0, k1).Write(pk.begin(), pk.size()).Finalize();
+    }
+};
+
 #endif // BITCOIN_UTIL_HASHER_H
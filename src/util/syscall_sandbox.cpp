@@ -557,6 +557,7 @@ public:
         allowed_syscalls.insert(__NR_mmap);       // map files or devices into memory
         allowed_syscalls.insert(__NR_mprotect);   // set protection on a region of memory
         allowed_syscalls.insert(__NR_mremap);     // remap a file in memory
+        allowed_syscalls.insert(__NR_msync);      // synchronize a file with a memory map
         allowed_syscalls.insert(__NR_munlock);    // unlock memory
         allowed_syscalls.insert(__NR_munmap);     // unmap files or devices into memory
     }
@@ -15,6 +15,8 @@
 #include <consensus/tx_check.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <core_memusage.h>
+#include <crypto/sha256.h>
 #include <cuckoocache.h>
 #include <flatfile.h>
 #include <hash.h>
@@ -48,6 +50,7 @@
 #include <util/rbf.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/thread.h>
 #include <util/trace.h>
 #include <util/translation.h>
 #include <validationinterface.h>
@@ -59,16 +62,23 @@
 #include <pos/kernel.h>
 #include <pos/miner.h>
 #include <anon.h>
+#include <blind.h>
 #include <rctindex.h>
 #include <insight/insight.h>
 #include <insight/balanceindex.h>
+#include <insight/blockdeltas.h>
 #include <net_processing.h>
+#include <validationstats.h>
 
 #include <algorithm>
+#include <condition_variable>
 #include <deque>
 #include <numeric>
 #include <optional>
+#include <set>
 #include <string>
+#include <thread>
+#include <tuple>
 
 using kernel::CCoinsStats;
 using kernel::CoinStatsHashType;
@@ -84,6 +94,7 @@ using node::fPruneMode;
 using node::fReindex;
 using node::nPruneTarget;
 using node::OpenBlockFile;
+using node::ParticlSnapshotHeader;
 using node::ReadBlockFromDisk;
 using node::SnapshotMetadata;
 using node::UNDOFILE_CHUNK_SIZE;
@@ -179,8 +190,8 @@ bool DelayBlock(BlockManager &blockman, const std::shared_ptr<const CBlock> &pbl
 void CheckDelayedBlocks(BlockManager &blockman, BlockValidationState &state, const uint256 &block_hash) LOCKS_EXCLUDED(cs_main);
 
 std::map<uint256, StakeConflict> mapStakeConflict;
-std::map<COutPoint, uint256> mapStakeSeen;
-std::list<COutPoint> listStakeSeen;
+Mutex cs_stake_seen;
+LRUCache<COutPoint, uint256, SaltedOutpointHasher> stakeSeenCache GUARDED_BY(cs_stake_seen) {MAX_STAKE_SEEN_SIZE};
 
 CoinStakeCache coinStakeCache GUARDED_BY(cs_main);
 CoinStakeCache smsgFeeCoinstakeCache;
@@ -206,7 +217,8 @@ std::list<DelayedBlock> list_delayed_blocks;
 bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
                        const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore,
                        bool cacheFullScriptStore, PrecomputedTransactionData& txdata,
-                       std::vector<CScriptCheck> *pvChecks = nullptr, bool fAnonChecks = true)
+                       std::vector<CScriptCheck> *pvChecks = nullptr, bool fAnonChecks = true,
+                       std::vector<CAnonCheck> *pvAnonChecks = nullptr)
                        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 bool CheckFinalTxAtTip(const CBlockIndex* active_chain_tip, const CTransaction& tx)
@@ -326,6 +338,8 @@ static void LimitMempoolSize(CTxMemPool& pool, CCoinsViewCache& coins_cache, siz
         LogPrint(BCLog::MEMPOOL, "Expired %i transactions from the memory pool\n", expired);
     }
 
+    pool.SpillProofs();
+
     std::vector<COutPoint> vNoSpendsRemaining;
     pool.TrimToSize(limit, &vNoSpendsRemaining);
     for (const COutPoint& removed : vNoSpendsRemaining)
@@ -496,6 +510,9 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, TxValidationS
 
 namespace {
 
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CAnonCheck> anoncheckqueue(16);
+
 class MemPoolAccept
 {
 public:
@@ -537,11 +554,13 @@ public:
 
         /** Particl - test if tx would get in the mempool without considering locks */
         const bool m_ignore_locks;
+        /** Particl - rangeproofs were verified when the tx was first received */
+        const bool m_skip_rangeproof;
 
         /** Parameters for single transaction mempool validation. */
         static ATMPArgs SingleAccept(const CChainParams& chainparams, int64_t accept_time,
                                      bool bypass_limits, std::vector<COutPoint>& coins_to_uncache,
-                                     bool test_accept, bool ignore_locks) {
+                                     bool test_accept, bool ignore_locks, bool skip_rangeproof) {
             return ATMPArgs{/* m_chainparams */ chainparams,
                             /* m_accept_time */ accept_time,
                             /* m_bypass_limits */ bypass_limits,
@@ -551,6 +570,7 @@ public:
                             /* m_package_submission */ false,
                             /* m_package_feerates */ false,
                             ignore_locks,
+                            skip_rangeproof,
             };
         }
 
@@ -566,6 +586,7 @@ public:
                             /* m_package_submission */ false, // not submitting to mempool
                             /* m_package_feerates */ false,
                             ignore_locks,
+                            /* m_skip_rangeproof */ false,
             };
         }
 
@@ -581,6 +602,7 @@ public:
                             /* m_package_submission */ true,
                             /* m_package_feerates */ true,
                             ignore_locks,
+                            /* m_skip_rangeproof */ false,
             };
         }
 
@@ -595,6 +617,7 @@ public:
                             /* m_package_submission */ false,
                             /* m_package_feerates */ false, // only 1 transaction
                             /* m_ignore_locks */ package_args.m_ignore_locks,
+                            /* m_skip_rangeproof */ package_args.m_skip_rangeproof,
             };
         }
 
@@ -609,7 +632,8 @@ public:
                  bool allow_bip125_replacement,
                  bool package_submission,
                  bool package_feerates,
-                 bool ignore_locks)
+                 bool ignore_locks,
+                 bool skip_rangeproof)
             : m_chainparams{chainparams},
               m_accept_time{accept_time},
               m_bypass_limits{bypass_limits},
@@ -618,7 +642,8 @@ public:
               m_allow_bip125_replacement{allow_bip125_replacement},
               m_package_submission{package_submission},
               m_package_feerates{package_feerates},
-              m_ignore_locks{ignore_locks}
+              m_ignore_locks{ignore_locks},
+              m_skip_rangeproof{skip_rangeproof}
         {
         }
     };
@@ -700,6 +725,12 @@ private:
     // only invoke this on transactions that have otherwise passed policy checks.
     bool PolicyScriptChecks(const ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Run the policy script and MLSAG checks of all package transactions on the script check
+    // threads. Ring members are resolved before the checks are queued, so the checks run against
+    // the RCT index as it was when collected. Returns false if any check fails, the caller should
+    // then run PolicyScriptChecks() serially to find the failing transaction and fill its state.
+    bool PackagePolicyScriptChecks(std::vector<Workspace>& workspaces) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Re-run the script checks, using consensus flags, and try to cache the
     // result in the scriptcache. This should be done after
     // PolicyScriptChecks(). This requires that all inputs either be in our
@@ -776,7 +807,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     std::unique_ptr<CTxMemPoolEntry>& entry = ws.m_entry;
 
     const Consensus::Params &consensus = Params().GetConsensus();
-    state.SetStateInfo(nAcceptTime, m_active_chainstate.m_chain.Height(), consensus, fParticlMode, (fBusyImporting && fSkipRangeproof));
+    state.SetStateInfo(nAcceptTime, m_active_chainstate.m_chain.Height(), consensus, fParticlMode, (fBusyImporting && fSkipRangeproof) || args.m_skip_rangeproof);
 
     if (!CheckTransaction(tx, state)) {
         return false; // state filled in by CheckTransaction
@@ -883,8 +914,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
         }
     }
 
-    if (state.m_has_anon_input && gArgs.GetBoolArg("-checkpeerheight", true) &&
-        m_active_chainstate.m_chain.Height() < particl::GetNumBlocksOfPeers() - 1) {
+    if (state.m_has_anon_input && particl::IsChainBehindPeers(m_active_chainstate.m_chain.Height())) {
         LogPrintf("%s: Ignoring anon transaction while chain syncs height %d - peers %d.\n",
             __func__, m_active_chainstate.m_chain.Height(), particl::GetNumBlocksOfPeers());
         return state.Error("Syncing");
@@ -953,6 +983,12 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     entry.reset(new CTxMemPoolEntry(ptx, ws.m_base_fees, nAcceptTime, m_active_chainstate.m_chain.Height(),
             fSpendsCoinbase, nSigOpsCost, lp));
     ws.m_vsize = entry->GetTxSize();
+    for (const CTxIn &txin : tx.vin) {
+        if (!txin.IsAnonInput() && m_view.AccessCoin(txin.prevout).nType == OUTPUT_CT) {
+            entry->m_spends_blind = true;
+            break;
+        }
+    }
 
     if (nSigOpsCost > MAX_STANDARD_TX_SIGOPS_COST)
         return state.Invalid(TxValidationResult::TX_NOT_STANDARD, "bad-txns-too-many-sigops",
@@ -1131,6 +1167,33 @@ bool MemPoolAccept::PolicyScriptChecks(const ATMPArgs& args, Workspace& ws)
     return true;
 }
 
+bool MemPoolAccept::PackagePolicyScriptChecks(std::vector<Workspace>& workspaces)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+
+    constexpr unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    CCheckQueueControl<CAnonCheck> anon_control(&anoncheckqueue);
+    for (Workspace& ws : workspaces) {
+        TxValidationState& state = ws.m_state;
+        state.m_chainstate = &m_active_chainstate;
+
+        std::vector<CScriptCheck> checks;
+        std::vector<CAnonCheck> anon_checks;
+        if (!CheckInputScripts(*ws.m_ptx, state, m_view, scriptVerifyFlags, true, false, ws.m_precomputed_txdata,
+                               &checks, true, &anon_checks)) {
+            return false;
+        }
+        control.Add(checks);
+        anon_control.Add(anon_checks);
+    }
+    const bool scripts_valid = control.Wait();
+    const bool anon_valid = anon_control.Wait();
+    return scripts_valid && anon_valid;
+}
+
 bool MemPoolAccept::ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws)
 {
     AssertLockHeld(cs_main);
@@ -1387,8 +1450,13 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
         return PackageMempoolAcceptResult(package_state, package_feerate, std::move(results));
     }
 
+    // Verify independent transactions in parallel when possible, the serial checks below are skipped
+    // if all passed and otherwise report the first failing transaction. Workspaces stay in package
+    // order, so SubmitPackage() still adds the transactions to the mempool in order.
+    const bool package_scripts_valid = txns.size() > 1 && g_parallel_script_checks &&
+                                       PackagePolicyScriptChecks(workspaces);
     for (Workspace& ws : workspaces) {
-        if (!PolicyScriptChecks(args, ws)) {
+        if (!package_scripts_valid && !PolicyScriptChecks(args, ws)) {
             // Exit early to avoid doing pointless work. Update the failed tx result; the rest are unfinished.
             package_state.Invalid(PackageValidationResult::PCKG_TX, "transaction failed");
             results.emplace(ws.m_ptx->GetWitnessHash(), MempoolAcceptResult::Failure(ws.m_state));
@@ -1548,7 +1616,7 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptPackage(const Package& package,
 } // anon namespace
 
 MempoolAcceptResult AcceptToMemoryPool(CChainState& active_chainstate, const CTransactionRef& tx,
-                                       int64_t accept_time, bool bypass_limits, bool test_accept, bool ignore_locks)
+                                       int64_t accept_time, bool bypass_limits, bool test_accept, bool ignore_locks, bool skip_rangeproof)
     EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
 {
     AssertLockHeld(::cs_main);
@@ -1557,7 +1625,7 @@ MempoolAcceptResult AcceptToMemoryPool(CChainState& active_chainstate, const CTr
     CTxMemPool& pool{*active_chainstate.GetMempool()};
 
     std::vector<COutPoint> coins_to_uncache;
-    auto args = MemPoolAccept::ATMPArgs::SingleAccept(chainparams, accept_time, bypass_limits, coins_to_uncache, test_accept, ignore_locks);
+    auto args = MemPoolAccept::ATMPArgs::SingleAccept(chainparams, accept_time, bypass_limits, coins_to_uncache, test_accept, ignore_locks, skip_rangeproof);
     const MempoolAcceptResult result = MemPoolAccept(pool, active_chainstate).AcceptSingleTransaction(tx, args);
     if (result.m_result_type != MempoolAcceptResult::ResultType::VALID) {
         // Remove coins that were not present in the coins cache before calling
@@ -1701,7 +1769,9 @@ bool CChainState::IsInitialBlockDownload() const
     m_cached_finished_ibd.store(true, std::memory_order_relaxed);
     }
     GetMainSignals().LeavingIBD();
+#ifdef ENABLE_WALLET
     WakeAllThreadStakeMiner();
+#endif
     return false;
 }
 
@@ -1835,6 +1905,7 @@ void InitScriptExecutionCache() {
  * If pvChecks is not nullptr, script checks are pushed onto it instead of being performed inline. Any
  * script checks which are not necessary (eg due to script execution cache hits) are, obviously,
  * not pushed onto pvChecks/run.
+ * Likewise, if pvAnonChecks is not nullptr the MLSAG checks for anon inputs are pushed onto it.
  *
  * Setting cacheSigStore/cacheFullScriptStore to false will remove elements from the corresponding cache
  * which are matched. This is useful for checking blocks where we will likely never need the cache
@@ -1848,7 +1919,8 @@ void InitScriptExecutionCache() {
 bool CheckInputScripts(const CTransaction& tx, TxValidationState &state,
                        const CCoinsViewCache &inputs, unsigned int flags, bool cacheSigStore,
                        bool cacheFullScriptStore, PrecomputedTransactionData& txdata,
-                       std::vector<CScriptCheck> *pvChecks, bool fAnonChecks)
+                       std::vector<CScriptCheck> *pvChecks, bool fAnonChecks,
+                       std::vector<CAnonCheck> *pvAnonChecks)
 {
     if (tx.IsCoinBase()) return true;
     if (pvChecks) {
@@ -1946,11 +2018,11 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState &state,
     }
 
     if (m_has_anon_input && fAnonChecks
-        && !VerifyMLSAG(tx, state)) {
+        && !VerifyMLSAG(tx, state, pvAnonChecks)) {
         return false;
     }
 
-    if (cacheFullScriptStore && !pvChecks) {
+    if (cacheFullScriptStore && !pvChecks && !pvAnonChecks) {
         // We executed all of the provided scripts, and were told to
         // cache the result. Do so now.
         g_scriptExecutionCache.insert(hashCacheEntry);
@@ -2232,22 +2304,29 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         }
     }
 
+    if (fParticlMode) {
+        m_chainman.m_smsgman->DisconnectBlock(view.smsg_cache, pindex->GetBlockHash(), pindex->nHeight, pindex->nTime,
+                                              pindex->pprev->GetBlockHash(), pindex->pprev->nHeight);
+    }
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash(), pindex->pprev->nHeight);
 
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void StartScriptCheckWorkerThreads(int threads_num)
 {
     scriptcheckqueue.StartWorkerThreads(threads_num);
+    anoncheckqueue.StartWorkerThreads(threads_num, "anonch");
+    particl::StartBlockSignatureThreads(std::min(threads_num, 2));
 }
 
 void StopScriptCheckWorkerThreads()
 {
     scriptcheckqueue.StopWorkerThreads();
+    anoncheckqueue.StopWorkerThreads();
+    particl::StopBlockSignatureThreads();
 }
 
 /**
@@ -2344,6 +2423,45 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
 
+bool CChainState::IsAssumedValid(const CBlockIndex* pindex) const
+{
+    AssertLockHeld(cs_main);
+    if (hashAssumeValid.IsNull() || !m_chainman.m_best_header) {
+        return false;
+    }
+    // We've been configured with the hash of a block which has been externally verified to have a valid history.
+    // A suitable default value is included with the software and updated from time to time.  Because validity
+    //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
+    // This setting doesn't force the selection of any particular chain but makes validating some faster by
+    //  effectively caching the result of part of the verification.
+    BlockMap::const_iterator  it = m_blockman.m_block_index.find(hashAssumeValid);
+    if (it != m_blockman.m_block_index.end()) {
+        if (it->second.GetAncestor(pindex->nHeight) == pindex &&
+            m_chainman.m_best_header->GetAncestor(pindex->nHeight) == pindex &&
+            m_chainman.m_best_header->nChainWork >= nMinimumChainWork) {
+            // This block is a member of the assumed verified chain and an ancestor of the best header.
+            // Script verification is skipped when connecting blocks under the
+            // assumevalid block. Assuming the assumevalid block is valid this
+            // is safe because block merkle hashes are still computed and checked,
+            // Of course, if an assumed valid block is invalid due to false scriptSigs
+            // this optimization would allow an invalid chain to be accepted.
+            // The equivalent time check discourages hash power from extorting the network via DOS attack
+            //  into accepting an invalid block through telling users they must manually set assumevalid.
+            //  Requiring a software change or burying the invalid block, regardless of the setting, makes
+            //  it hard to hide the implication of the demand.  This also avoids having release candidates
+            //  that are hardly doing any signature verification at all in testing without having to
+            //  artificially set the default assumed verified block further back.
+            // The test against nMinimumChainWork prevents the skipping when denied access to any chain at
+            //  least as good as the expected chain.
+            // Particl: Rangeproofs and MLSAG signatures are committed to by the merkle root too and are skipped
+            //  the same way, key images, ring members and commitment sums are still checked.
+            //  Stake kernels are skipped too, the coinstake inputs are still spent from the UTXO set.
+            return GetBlockProofEquivalentTime(*m_chainman.m_best_header, *pindex, *m_chainman.m_best_header, m_params.GetConsensus()) > 60 * 60 * 24 * 7 * 2;
+        }
+    }
+    return false;
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -2359,7 +2477,9 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     int64_t nTimeStart = GetTimeMicros();
 
     const Consensus::Params &consensus = Params().GetConsensus();
-    state.SetStateInfo(block.nTime, pindex->nHeight, consensus, fParticlMode, (fBusyImporting && fSkipRangeproof), true);
+    const bool fScriptChecks = !IsAssumedValid(pindex);
+    state.m_assume_valid = !fScriptChecks;
+    state.SetStateInfo(block.nTime, pindex->nHeight, consensus, fParticlMode, (fBusyImporting && fSkipRangeproof) || state.m_assume_valid, true);
 
     // Check it again in case a previous version let a bad block in
     // NOTE: We don't currently (re-)invoke ContextualCheckBlock() or
@@ -2384,14 +2504,22 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         return error("%s: Consensus::CheckBlock: %s", __func__, state.ToString());
     }
 
+    BlockValidationStats *validation_stats = state.m_validation_stats;
     if (block.IsProofOfStake()) {
-        pindex->bnStakeModifier = ComputeStakeModifierV2(pindex->pprev, pindex->prevoutStake.hash);
+        pindex->bnStakeModifier = ComputeStakeModifierV2(pindex->pprev, block.vtx[0]->vin[0].prevout.hash);
         m_blockman.m_dirty_blockindex.insert(pindex);
 
+        int64_t pos_start_us = GetTimeMicros();
         uint256 hashProof, targetProofOfStake;
-        if (!CheckProofOfStake(*this, state, pindex->pprev, *block.vtx[0], block.nTime, block.nBits, hashProof, targetProofOfStake)) {
+        // Like the scripts, the kernels of blocks under -assumevalid are skipped.
+        // The stake modifier above and the block signature in CheckBlock are still checked.
+        if (!state.m_assume_valid &&
+            !CheckProofOfStake(*this, state, pindex->pprev, *block.vtx[0], block.nTime, block.nBits, hashProof, targetProofOfStake)) {
             return error("%s: Check proof of stake failed.", __func__);
         }
+        if (validation_stats) {
+            validation_stats->Add(BVS_COINSTAKE_CHECK_US, GetTimeMicros() - pos_start_us);
+        }
     }
 
     // verify that the view's current state corresponds to the previous block
@@ -2411,37 +2539,6 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         return true;
     }
 
-    bool fScriptChecks = true;
-    if (!hashAssumeValid.IsNull()) {
-        // We've been configured with the hash of a block which has been externally verified to have a valid history.
-        // A suitable default value is included with the software and updated from time to time.  Because validity
-        //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
-        // This setting doesn't force the selection of any particular chain but makes validating some faster by
-        //  effectively caching the result of part of the verification.
-        BlockMap::const_iterator  it = m_blockman.m_block_index.find(hashAssumeValid);
-        if (it != m_blockman.m_block_index.end()) {
-            if (it->second.GetAncestor(pindex->nHeight) == pindex &&
-                m_chainman.m_best_header->GetAncestor(pindex->nHeight) == pindex &&
-                m_chainman.m_best_header->nChainWork >= nMinimumChainWork) {
-                // This block is a member of the assumed verified chain and an ancestor of the best header.
-                // Script verification is skipped when connecting blocks under the
-                // assumevalid block. Assuming the assumevalid block is valid this
-                // is safe because block merkle hashes are still computed and checked,
-                // Of course, if an assumed valid block is invalid due to false scriptSigs
-                // this optimization would allow an invalid chain to be accepted.
-                // The equivalent time check discourages hash power from extorting the network via DOS attack
-                //  into accepting an invalid block through telling users they must manually set assumevalid.
-                //  Requiring a software change or burying the invalid block, regardless of the setting, makes
-                //  it hard to hide the implication of the demand.  This also avoids having release candidates
-                //  that are hardly doing any signature verification at all in testing without having to
-                //  artificially set the default assumed verified block further back.
-                // The test against nMinimumChainWork prevents the skipping when denied access to any chain at
-                //  least as good as the expected chain.
-                fScriptChecks = (GetBlockProofEquivalentTime(*m_chainman.m_best_header, *pindex, *m_chainman.m_best_header, m_params.GetConsensus()) <= 60 * 60 * 24 * 7 * 2);
-            }
-        }
-    }
-
 
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
@@ -2555,6 +2652,7 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // doesn't invalidate pointers into the vector, and keep txsdata in scope
     // for as long as `control`.
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && g_parallel_script_checks ? &scriptcheckqueue : nullptr);
+    CCheckQueueControl<CAnonCheck> anon_control(fScriptChecks && g_parallel_script_checks ? &anoncheckqueue : nullptr);
     std::vector<PrecomputedTransactionData> txsdata(block.vtx.size());
 
     std::vector<int> prevheights;
@@ -2572,6 +2670,26 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     CAmount block_balances[3] = {0};
     bool reset_balances = false;
 
+    // Anon output pubkeys already in the link index, looked up for the whole block at once
+    std::unordered_map<CCmpPubKey, int64_t, SaltedCmpPubKeyHasher> known_anon_outputs;
+    if (!fVerifyingDB) {
+        std::vector<CCmpPubKey> anon_pks;
+        for (const auto &ptx : block.vtx) {
+            for (const auto &txout : ptx->vpout) {
+                if (txout->IsType(OUTPUT_RINGCT)) {
+                    anon_pks.push_back(((CTxOutRingCT*)txout.get())->pk);
+                }
+            }
+        }
+        std::vector<int64_t> anon_indices;
+        m_blockman.m_block_tree_db->ReadRCTOutputLinks(anon_pks, anon_indices);
+        for (size_t k = 0; k < anon_pks.size(); ++k) {
+            if (anon_indices[k] >= 0) {
+                known_anon_outputs[anon_pks[k]] = anon_indices[k];
+            }
+        }
+    }
+
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
@@ -2579,9 +2697,11 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         nInputs += tx.vin.size();
 
         TxValidationState tx_state;
-        tx_state.SetStateInfo(block.nTime, pindex->nHeight, consensus, fParticlMode, (fBusyImporting && fSkipRangeproof), true);
+        tx_state.m_assume_valid = state.m_assume_valid;
+        tx_state.SetStateInfo(block.nTime, pindex->nHeight, consensus, fParticlMode, (fBusyImporting && fSkipRangeproof) || tx_state.m_assume_valid, true);
         tx_state.m_chainman = state.m_chainman;
         tx_state.m_chainstate = this;
+        tx_state.m_validation_stats = validation_stats;
         if (!tx.IsCoinBase())
         {
             CAmount txfee = 0;
@@ -2676,7 +2796,11 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
                 }
 
                 if (tx_state.m_funds_smsg) {
+                    int64_t smsg_start_us = GetTimeMicros();
                     m_chainman.m_smsgman->StoreFundingTx(view.smsg_cache, tx, pindex);
+                    if (validation_stats) {
+                        validation_stats->AddTiming(BVS_SMSG_FUNDING_TXNS, BVS_SMSG_FUNDING_US, smsg_start_us);
+                    }
                 }
             }
         } else {
@@ -2697,17 +2821,30 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         if (!tx.IsCoinBase())
         {
             std::vector<CScriptCheck> vChecks;
+            std::vector<CAnonCheck> vAnonChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
             //TxValidationState tx_state;
-            if (fScriptChecks && !CheckInputScripts(tx, tx_state, view, flags, fCacheResults, fCacheResults, txsdata[i], g_parallel_script_checks ? &vChecks : nullptr)) {
+            if (fScriptChecks && !CheckInputScripts(tx, tx_state, view, flags, fCacheResults, fCacheResults, txsdata[i],
+                                                    g_parallel_script_checks ? &vChecks : nullptr, true,
+                                                    g_parallel_script_checks ? &vAnonChecks : nullptr)) {
                 control.Wait();
+                anon_control.Wait();
                 // Any transaction validation failure in ConnectBlock is a block consensus failure
                 state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
                               tx_state.GetRejectReason(), tx_state.GetDebugMessage());
                 return error("ConnectBlock(): CheckInputScripts on %s failed with %s",
                     txhash.ToString(), state.ToString());
             }
+            if (!fScriptChecks && tx_state.m_has_anon_input && !VerifyMLSAG(tx, tx_state, nullptr)) {
+                control.Wait();
+                anon_control.Wait();
+                state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                              tx_state.GetRejectReason(), tx_state.GetDebugMessage());
+                return error("ConnectBlock(): VerifyMLSAG on %s failed with %s",
+                    txhash.ToString(), state.ToString());
+            }
             control.Add(vChecks);
+            anon_control.Add(vAnonChecks);
 
             blockundo.vtxundo.push_back(CTxUndo());
             UpdateCoins(tx, view, blockundo.vtxundo.back(), pindex->nHeight);
@@ -2744,7 +2881,9 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
                 CTxOutRingCT *txout = (CTxOutRingCT*)tx.vpout[k].get();
 
                 int64_t nTestExists;
-                if (!fVerifyingDB && m_blockman.m_block_tree_db->ReadRCTOutputLink(txout->pk, nTestExists)) {
+                const auto known_it = known_anon_outputs.find(txout->pk);
+                if (known_it != known_anon_outputs.end()) {
+                    nTestExists = known_it->second;
                     control.Wait();
 
                     if (nTestExists > pindex->pprev->nAnonOutputs) {
@@ -2819,7 +2958,12 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         LogPrintf("ERROR: %s: CheckQueue failed\n", __func__);
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "block-validation-failed");
     }
+    if (!anon_control.Wait()) {
+        LogPrintf("ERROR: %s: AnonCheckQueue failed\n", __func__);
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "verify-mlsag-failed");
+    }
 
+    int64_t coinstake_start_us = GetTimeMicros();
     if (fParticlMode) {
         if (block.nTime >= consensus.clamp_tx_version_time) {
             nMoneyCreated -= nFees;  // nStakeReward includes fees
@@ -2979,6 +3123,9 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     }
 
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
+    if (validation_stats) {
+        validation_stats->Add(BVS_COINSTAKE_CHECK_US, nTime4 - coinstake_start_us);
+    }
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
     if (fJustCheck)
@@ -3009,17 +3156,8 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         m_blockman.m_dirty_blockindex.insert(pindex);
     }
 
-
-    if (fTimestampIndex) {
-        unsigned int logicalTS = pindex->nTime;
-        if (!m_blockman.m_block_tree_db->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash()))) {
-            return AbortNode(state, "Failed to write timestamp index");
-        }
-        if (!m_blockman.m_block_tree_db->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS))) {
-            return AbortNode(state, "Failed to write blockhash index");
-        }
-    }
     if (fBalancesIndex) {
+        int64_t balances_start_us = GetTimeMicros();
         BlockBalances values(block_balances);
         if (pindex->pprev && !reset_balances) {
             BlockBalances prev_balances;
@@ -3029,9 +3167,71 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
                 values.sum(prev_balances);
             }
         }
-        if (!m_blockman.m_block_tree_db->WriteBlockBalancesIndex(block.GetHash(), values)) {
+        if (!m_blockman.m_block_tree_db->WriteBlockBalancesIndex(block.GetHash(), pindex->nHeight, values)) {
             return AbortNode(state, "Failed to write balances index");
         }
+        if (validation_stats) {
+            validation_stats->AddTiming(BVS_INSIGHT_INDEX_WRITES, BVS_INSIGHT_INDEX_WRITE_US, balances_start_us);
+        }
+    }
+
+    if (fBlockRewardIndex && block.IsProofOfStake()) {
+        int64_t reward_start_us = GetTimeMicros();
+        const CTransaction &tx_coinstake = *block.vtx[0];
+        BlockReward reward;
+        reward.coinstake_txid = tx_coinstake.GetHash();
+        reward.stake_reward = m_params.GetProofOfStakeReward(pindex->pprev, 0);
+        reward.fees = nFees;
+
+        const TreasuryFundSettings *fundconf = m_params.GetTreasuryFundSettings(block.nTime);
+        CScript fund_script;
+        if (fundconf) {
+            fund_script = GetScriptForDestination(DecodeDestination(fundconf->sTreasuryFundAddresses));
+        }
+        CAmount value_out = 0;
+        for (const auto &txout : tx_coinstake.vpout) {
+            if (!txout->IsStandardOutput()) {
+                continue;
+            }
+            reward.outputs.emplace_back(*txout->GetPScriptPubKey(), txout->GetValue());
+            if (fundconf && *txout->GetPScriptPubKey() == fund_script) {
+                reward.treasury_reward += txout->GetValue();
+                continue;
+            }
+            value_out += txout->GetValue();
+        }
+        // The coinstake is not a coinbase, blockundo.vtxundo[0] holds the coins it spent
+        CAmount value_in = 0;
+        const CTxUndo &coinstake_undo = blockundo.vtxundo[0];
+        for (const auto &coin : coinstake_undo.vprevout) {
+            value_in += coin.out.nValue;
+        }
+        reward.block_reward = value_out - value_in;
+        if (!coinstake_undo.vprevout.empty()) {
+            reward.kernel_script = coinstake_undo.vprevout[0].out.scriptPubKey;
+        }
+        tx_coinstake.GetSmsgFeeRate(reward.smsg_fee_rate);
+        tx_coinstake.GetSmsgDifficulty(reward.smsg_difficulty);
+
+        if (!m_blockman.m_block_tree_db->WriteBlockRewardIndex(block.GetHash(), reward)) {
+            return AbortNode(state, "Failed to write block reward index");
+        }
+        if (validation_stats) {
+            validation_stats->AddTiming(BVS_INSIGHT_INDEX_WRITES, BVS_INSIGHT_INDEX_WRITE_US, reward_start_us);
+        }
+    }
+
+    // getblockdeltas reads the block file when it's available, pruned blocks are served from the record
+    if (fSpentIndex && fPruneMode) {
+        int64_t deltas_start_us = GetTimeMicros();
+        BlockDeltasRecord record;
+        GetBlockDeltasRecord(block, record);
+        if (!m_blockman.m_block_tree_db->WriteBlockDeltasIndex(block.GetHash(), record)) {
+            return AbortNode(state, "Failed to write block deltas index");
+        }
+        if (validation_stats) {
+            validation_stats->AddTiming(BVS_INSIGHT_INDEX_WRITES, BVS_INSIGHT_INDEX_WRITE_US, deltas_start_us);
+        }
     }
 
     assert(pindex->phashBlock);
@@ -3186,6 +3386,10 @@ bool CChainState::FlushStateToDisk(
                 if (!m_blockman.WriteBlockIndexDB()) {
                     return AbortNode(state, "Failed to write to block index database");
                 }
+                // Sync the smsg funding rows written per block since the last flush
+                if (fParticlMode && 0 != m_chainman.m_smsgman->FlushChainSync()) {
+                    LogPrintf("%s: smsg FlushChainSync failed.\n", __func__);
+                }
             }
             // Finally remove any pruned files
             if (fFlushForPrune) {
@@ -3260,6 +3464,9 @@ static void DoWarning(const bilingual_str& warning)
 
 static void ClearSpentCache(CChainState &chainstate, CDBBatch &batch, int height)
 {
+    if (chainstate.m_blockman.m_block_tree_db->EraseSpentCacheBlock(batch, height)) {
+        return;
+    }
     CBlockIndex* pblockindex = chainstate.m_chain[height];
     if (!pblockindex) {
         return;
@@ -3287,13 +3494,16 @@ bool FlushView(CCoinsViewCache *view, BlockValidationState& state, CChainState &
     if (!view->Flush())
         return false;
 
+    BlockValidationStats *validation_stats = state.m_validation_stats;
+    int64_t insight_start_us = GetTimeMicros();
+    size_t insight_writes = view->addressIndex.size() + view->addressUnspentIndex.size() + view->spentIndex.size();
     if (fAddressIndex) {
         if (fDisconnecting) {
-            if (!pblocktree->EraseAddressIndex(view->addressIndex)) {
+            if (!pblocktree->EraseAddressIndex(view->addressIndex, fAddressBalanceIndex)) {
                 return AbortNode(state, "Failed to delete address index");
             }
         } else {
-            if (!pblocktree->WriteAddressIndex(view->addressIndex)) {
+            if (!pblocktree->WriteAddressIndex(view->addressIndex, fAddressBalanceIndex)) {
                 return AbortNode(state, "Failed to write address index");
             }
         }
@@ -3308,58 +3518,69 @@ bool FlushView(CCoinsViewCache *view, BlockValidationState& state, CChainState &
         }
     }
 
+    if (validation_stats && (fAddressIndex || fSpentIndex)) {
+        validation_stats->Add(BVS_INSIGHT_INDEX_WRITES, insight_writes);
+        validation_stats->Add(BVS_INSIGHT_INDEX_WRITE_US, GetTimeMicros() - insight_start_us);
+    }
+
     view->addressIndex.clear();
     view->addressUnspentIndex.clear();
     view->spentIndex.clear();
 
     if (fDisconnecting) {
+        CDBBatch batch(*pblocktree);
+
         for (const auto &it : view->keyImages) {
-            if (!pblocktree->EraseRCTKeyImage(it.first)) {
-                return error("%s: EraseRCTKeyImage failed, txn %s.", __func__, it.second.ToString());
-            }
+            pblocktree->EraseRCTKeyImage(batch, it.first);
         }
         for (const auto &it : view->anonOutputLinks) {
-            if (!pblocktree->EraseRCTOutput(it.second)) {
-                return error("%s: EraseRCTOutput failed.", __func__);
-            }
-            if (!pblocktree->EraseRCTOutputLink(it.first)) {
-                return error("%s: EraseRCTOutputLink failed.", __func__);
-            }
+            pblocktree->EraseRCTOutput(batch, it.second);
+            pblocktree->EraseRCTOutputLink(batch, it.first);
         }
         for (const auto &it : view->spent_cache) {
-            if (!pblocktree->EraseSpentCache(it.first)) {
-                return error("%s: EraseSpentCache failed.", __func__);
-            }
+            pblocktree->EraseSpentCache(batch, it.first);
+        }
+        if (!pblocktree->WriteBatch(batch)) {
+            return error("%s: Erase index data failed.", __func__);
+        }
+        if (0 != chainstate.m_chainman.m_smsgman->WriteCache(view->smsg_cache)) {
+            return error("%s: smsgModule WriteCache failed.", __func__);
         }
     } else {
+        // Buffer the RCT index rows while catching up, they are written with the block index
+        pblocktree->SetRCTBulkLoad(fReindex || chainstate.IsInitialBlockDownload());
+        int64_t rct_start_us = GetTimeMicros();
         CDBBatch batch(*pblocktree);
 
         for (const auto &it : view->keyImages) {
             CAnonKeyImageInfo data(it.second, state.m_spend_height);
-            std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTKEYIMAGE, it.first);
-            batch.Write(key, data);
+            pblocktree->WriteRCTKeyImage(batch, it.first, data);
         }
         for (const auto &it : view->anonOutputs) {
-            std::pair<uint8_t, int64_t> key = std::make_pair(DB_RCTOUTPUT, it.first);
-            batch.Write(key, it.second);
+            pblocktree->WriteRCTOutput(batch, it.first, it.second);
         }
-        for (const auto &it : view->anonOutputLinks) {
-            std::pair<uint8_t, CCmpPubKey> key = std::make_pair(DB_RCTOUTPUT_LINK, it.first);
-            batch.Write(key, it.second);
+        if (!pblocktree->WriteRCTOutputFile(batch, view->anonOutputs)) {
+            return error("%s: WriteRCTOutputFile failed.", __func__);
         }
-        for (const auto &it : view->spent_cache) {
-            std::pair<uint8_t, COutPoint> key = std::make_pair(DB_SPENTCACHE, it.first);
-            batch.Write(key, it.second);
+        for (const auto &it : view->anonOutputLinks) {
+            pblocktree->WriteRCTOutputLink(batch, it.first, it.second);
         }
+        pblocktree->WriteSpentCache(batch, state.m_spend_height, view->spent_cache);
         if (state.m_spend_height > (int)MIN_BLOCKS_TO_KEEP) {
             ClearSpentCache(chainstate, batch, state.m_spend_height - (MIN_BLOCKS_TO_KEEP+1));
         }
         if (!pblocktree->WriteBatch(batch)) {
             return error("%s: Write index data failed.", __func__);
         }
+        int64_t smsg_start_us = GetTimeMicros();
         if (0 != chainstate.m_chainman.m_smsgman->WriteCache(view->smsg_cache)) {
             return error("%s: smsgModule WriteCache failed.", __func__);
         }
+        if (validation_stats) {
+            validation_stats->Add(BVS_RCT_INDEX_WRITES, view->keyImages.size() + view->anonOutputs.size());
+            validation_stats->Add(BVS_RCT_INDEX_WRITE_US, smsg_start_us - rct_start_us);
+            validation_stats->Add(BVS_SMSG_FUNDING_US, GetTimeMicros() - smsg_start_us);
+        }
     }
 
     view->nLastRCTOutput = 0;
@@ -3511,6 +3732,7 @@ bool CChainState::DisconnectTip(BlockValidationState& state, DisconnectedBlockTr
     }
 
     m_chain.SetTip(pindexDelete->pprev);
+    PoSKernelPSDisconnectTip(pindexDelete);
 
     UpdateTip(pindexDelete->pprev);
     // Let wallets know transactions went from 1-confirmed to
@@ -3597,12 +3819,15 @@ bool CChainState::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDiskTotal * MICRO, nTimeReadFromDiskTotal * MILLI / nBlocksTotal);
     {
         CCoinsViewCache view(&CoinsTip());
+        std::shared_ptr<BlockValidationStats> validation_stats = g_block_validation_stats.Get(pindexNew->GetBlockHash(), true);
+        state.m_validation_stats = validation_stats.get();
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view);
         if (pindexNew->nFlags & BLOCK_FAILED_DUPLICATE_STAKE) {
             state.nFlags |= BLOCK_FAILED_DUPLICATE_STAKE;
         }
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
+            state.m_validation_stats = nullptr;
             if (state.IsInvalid())
                 InvalidBlockFound(pindexNew, state);
             return error("%s: ConnectBlock %s failed, %s", __func__, pindexNew->GetBlockHash().ToString(), state.ToString());
@@ -3612,6 +3837,11 @@ bool CChainState::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = FlushView(&view, state, *this, false);
         assert(flushed);
+        state.m_validation_stats = nullptr;
+        if (validation_stats) {
+            validation_stats->Add(BVS_CONNECT_BLOCK_US, GetTimeMicros() - nTime2);
+            validation_stats->m_height = pindexNew->nHeight;
+        }
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
@@ -3630,6 +3860,7 @@ bool CChainState::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew
     }
     // Update m_chain & related variables.
     m_chain.SetTip(pindexNew);
+    PoSKernelPSConnectTip(pindexNew);
     UpdateTip(pindexNew);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
@@ -4230,10 +4461,41 @@ static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& st
 }
 
 
-bool CheckBlockSignature(const CBlock &block)
+namespace particl {
+static constexpr size_t MAX_BLOCK_SIG_QUEUE = 256;
+
+/**
+ * Verified block signatures, keyed by the block hash and signature.
+ * The pubkey is committed to through the coinstake in the merkle root.
+ */
+static Mutex cs_block_sig;
+static LRUCache<uint256, bool, SaltedTxidHasher> blockSigCache GUARDED_BY(cs_block_sig) {4096};
+static std::set<uint256> setBlockSigInFlight GUARDED_BY(cs_block_sig);
+static std::deque<std::shared_ptr<const CBlock> > queueBlockSig GUARDED_BY(cs_block_sig);
+static bool fBlockSigStop GUARDED_BY(cs_block_sig) = false;
+static std::condition_variable condBlockSigQueue;
+static std::condition_variable condBlockSigDone;
+static std::vector<std::thread> vBlockSigThreads;
+
+static uint256 GetBlockSignatureKey(const CBlock &block)
+{
+    uint256 hash = block.GetHash(), rv;
+    CSHA256().Write(hash.begin(), hash.size())
+             .Write(block.vchBlockSig.data(), block.vchBlockSig.size())
+             .Finalize(rv.begin());
+    return rv;
+}
+
+static bool VerifyBlockSignature(const CBlock &block)
+{
+    const auto &txin = block.vtx[0]->vin[0];
+    CPubKey pubKey(txin.scriptWitness.stack[1]);
+    return pubKey.Verify(block.GetHash(), block.vchBlockSig);
+}
+
+/** Checks that cannot fail once the signature is cached */
+static bool CheckBlockSignatureFormat(const CBlock &block)
 {
-    if (!block.IsProofOfStake())
-        return block.vchBlockSig.empty();
     if (block.vchBlockSig.empty())
         return false;
     if (block.vtx[0]->vin.size() < 1)
@@ -4245,9 +4507,120 @@ bool CheckBlockSignature(const CBlock &block)
 
     if (txin.scriptWitness.stack[1].size() != 33)
         return false;
+    return true;
+}
 
-    CPubKey pubKey(txin.scriptWitness.stack[1]);
-    return pubKey.Verify(block.GetHash(), block.vchBlockSig);
+static void BlockSignatureThread() EXCLUSIVE_LOCKS_REQUIRED(!cs_block_sig)
+{
+    while (true) {
+        std::shared_ptr<const CBlock> pblock;
+        uint256 key;
+        {
+            WAIT_LOCK(cs_block_sig, lock);
+            while (queueBlockSig.empty() && !fBlockSigStop) {
+                condBlockSigQueue.wait(lock);
+            }
+            if (fBlockSigStop) {
+                return;
+            }
+            pblock = queueBlockSig.front();
+            queueBlockSig.pop_front();
+            key = GetBlockSignatureKey(*pblock);
+            if (blockSigCache.Peek(key) || !setBlockSigInFlight.insert(key).second) {
+                continue;
+            }
+        }
+        bool valid = VerifyBlockSignature(*pblock);
+        {
+            LOCK(cs_block_sig);
+            setBlockSigInFlight.erase(key);
+            if (valid) {
+                blockSigCache.Insert(key, true);
+            }
+        }
+        condBlockSigDone.notify_all();
+    }
+}
+
+void StartBlockSignatureThreads(int threads_num)
+{
+    assert(vBlockSigThreads.empty());
+    for (int n = 0; n < threads_num; ++n) {
+        vBlockSigThreads.emplace_back([n]() {
+            util::ThreadRename(strprintf("blocksig.%i", n));
+            SetSyscallSandboxPolicy(SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK);
+            BlockSignatureThread();
+        });
+    }
+}
+
+void StopBlockSignatureThreads()
+{
+    WITH_LOCK(cs_block_sig, fBlockSigStop = true);
+    condBlockSigQueue.notify_all();
+    for (std::thread &t : vBlockSigThreads) {
+        t.join();
+    }
+    vBlockSigThreads.clear();
+    LOCK(cs_block_sig);
+    fBlockSigStop = false;
+    queueBlockSig.clear();
+}
+
+void QueueBlockSignatureCheck(const std::shared_ptr<const CBlock> &pblock)
+{
+    if (vBlockSigThreads.empty() ||
+        !pblock->IsProofOfStake() || !CheckBlockSignatureFormat(*pblock)) {
+        return;
+    }
+    {
+        LOCK(cs_block_sig);
+        if (queueBlockSig.size() >= MAX_BLOCK_SIG_QUEUE) {
+            return;
+        }
+        queueBlockSig.push_back(pblock);
+    }
+    condBlockSigQueue.notify_one();
+}
+
+LRUCacheStats GetBlockSignatureCacheStats()
+{
+    LOCK(cs_block_sig);
+    return blockSigCache.GetStats();
+}
+
+void ClearBlockSignatureCache()
+{
+    LOCK(cs_block_sig);
+    blockSigCache.Clear();
+}
+} // namespace particl
+
+bool CheckBlockSignature(const CBlock &block)
+{
+    if (!block.IsProofOfStake())
+        return block.vchBlockSig.empty();
+    if (!particl::CheckBlockSignatureFormat(block))
+        return false;
+
+    using namespace particl;
+    uint256 key = GetBlockSignatureKey(block);
+    {
+        // Wait for a worker already verifying this signature
+        WAIT_LOCK(cs_block_sig, lock);
+        while (setBlockSigInFlight.count(key)) {
+            condBlockSigDone.wait(lock);
+        }
+        if (blockSigCache.Peek(key)) {
+            return true;
+        }
+    }
+    if (!VerifyBlockSignature(block)) {
+        return false;
+    }
+    LOCK(cs_block_sig);
+    blockSigCache.Insert(key, true);
+    return true;
 };
 
 bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
@@ -4262,7 +4635,7 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
     if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
         return false;
 
-    state.SetStateInfo(block.nTime, -1, consensusParams, fParticlMode, (fBusyImporting && fSkipRangeproof), true);
+    state.SetStateInfo(block.nTime, -1, consensusParams, fParticlMode, (fBusyImporting && fSkipRangeproof) || state.m_assume_valid, true);
 
     // Signet only: check block solution
     if (consensusParams.signet_blocks && fCheckPOW && !CheckSignetBlockSolution(block, consensusParams)) {
@@ -4321,15 +4694,28 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
             return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-cb-multiple", "more than one coinbase");
     }
 
+    // Blocks checked before ConnectTip are counted to the block's validation stats too
+    std::shared_ptr<BlockValidationStats> pending_stats;
+    if (!state.m_validation_stats && fCheckPOW && fCheckMerkleRoot && g_block_validation_stats.IsEnabled()) {
+        pending_stats = g_block_validation_stats.Get(block.GetHash(), false);
+    }
+    BlockValidationStats *validation_stats = state.m_validation_stats ? state.m_validation_stats : pending_stats.get();
+
     // Check transactions
     // Must check for duplicate inputs (see CVE-2018-17144)
-    for (const auto& tx : block.vtx) {
+    // Bulletproofs are collected and verified together after the loop
+    std::vector<CBulletproofBatchEntry> bulletproof_batch;
+    std::vector<size_t> bulletproof_batch_tx; // Index into block.vtx for each entry in bulletproof_batch
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const auto &tx = block.vtx[i];
         TxValidationState tx_state;
-        tx_state.SetStateInfo(block.nTime, -1, consensusParams, fParticlMode, (fBusyImporting && fSkipRangeproof), true);
+        tx_state.SetStateInfo(block.nTime, -1, consensusParams, fParticlMode, (fBusyImporting && fSkipRangeproof) || state.m_assume_valid, true);
         tx_state.m_chainman = state.m_chainman;
         if (state.m_chainman) {
             tx_state.m_chainstate = &state.m_chainman->ActiveChainstate();
         }
+        tx_state.m_bulletproof_batch = &bulletproof_batch;
+        tx_state.m_validation_stats = validation_stats;
         if (!CheckTransaction(*tx, tx_state)) {
             // CheckBlock() does context-free validation checks. The only
             // possible failures are consensus failures.
@@ -4337,6 +4723,21 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
             return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, tx_state.GetRejectReason(),
                                  strprintf("Transaction check failed (tx hash %s) %s", tx->GetHash().ToString(), tx_state.GetDebugMessage()));
         }
+        bulletproof_batch_tx.resize(bulletproof_batch.size(), i);
+    }
+    if (!bulletproof_batch.empty()) {
+        size_t n_failed = 0;
+        int64_t batch_start_us = GetTimeMicros();
+        bool batch_valid = VerifyBulletproofBatch(bulletproof_batch, n_failed);
+        if (validation_stats) {
+            validation_stats->Add(BVS_RANGEPROOFS_VERIFIED, bulletproof_batch.size());
+            validation_stats->Add(BVS_RANGEPROOF_US, GetTimeMicros() - batch_start_us);
+        }
+        if (!batch_valid) {
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                 bulletproof_batch[n_failed].is_anon ? "bad-rctout-rangeproof-verify" : "bad-ctout-rangeproof-verify",
+                                 strprintf("Transaction check failed (tx hash %s)", block.vtx[bulletproof_batch_tx[n_failed]]->GetHash().ToString()));
+        }
     }
     unsigned int nSigOps = 0;
     for (const auto& tx : block.vtx)
@@ -4556,7 +4957,7 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
                 {
                     LogPrint(BCLog::POS, "%s: Ignoring CheckStakeUnique for block %s, chain height behind peers.\n", __func__, block.GetHash().ToString());
                     const COutPoint &kernel = block.vtx[0]->vin[0].prevout;
-                    mapStakeSeen[kernel] = block.GetHash();
+                    AddToMapStakeSeen(kernel, block.GetHash());
                 } else
                     return state.DoS(20, false, "bad-cs-duplicate", false, "duplicate coinstake");
                 */
@@ -4925,7 +5326,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, Block
 
     if (block.IsProofOfStake()) {
         pindex->SetProofOfStake();
-        pindex->prevoutStake = pblock->vtx[0]->vin[0].prevout;
+        const COutPoint &kernel = pblock->vtx[0]->vin[0].prevout;
         if (!pindex->pprev ||
             (pindex->pprev->bnStakeModifier.IsNull() &&
              pindex->pprev->GetBlockHash() != m_params.GetConsensus().hashGenesisBlock)) {
@@ -4940,7 +5341,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, Block
                 return particl::DelayBlock(m_blockman, pblock, state);
             }
         } else {
-            pindex->bnStakeModifier = ComputeStakeModifierV2(pindex->pprev, pindex->prevoutStake.hash);
+            pindex->bnStakeModifier = ComputeStakeModifierV2(pindex->pprev, kernel.hash);
         }
         pindex->nFlags = pindex->nFlags & (uint32_t)~BLOCK_DELAYED;
         m_blockman.m_dirty_blockindex.insert(pindex);
@@ -5020,10 +5421,21 @@ bool ChainstateManager::ProcessNewBlock(const std::shared_ptr<const CBlock>& blo
             state.nodeId = node_id;
         }
 
+        // Verify the block signature before taking cs_main, CheckBlock() will find it in the cache.
+        if (fParticlMode && block->IsProofOfStake()) {
+            CheckBlockSignature(*block);
+        }
+
         // CheckBlock() does not support multi-threaded block validation because CBlock::fChecked can cause data race.
         // Therefore, the following critical section must include the CheckBlock() call as well.
         LOCK(cs_main);
 
+        // Headers are synced first, CheckBlock() skips the rangeproofs of blocks under -assumevalid
+        const CBlockIndex *pindex_header = m_blockman.LookupBlockIndex(block->GetHash());
+        if (pindex_header && ActiveChainstate().IsAssumedValid(pindex_header)) {
+            state.m_assume_valid = true;
+        }
+
         // Skipping AcceptBlock() for CheckBlock() failures means that we will never mark a block as invalid if
         // CheckBlock() fails.  This is protective against consensus failure if there are any unknown forms of block
         // malleability that cause CheckBlock() to fail; see e.g. CVE-2012-2459 and
@@ -5082,7 +5494,7 @@ bool ChainstateManager::ProcessNewBlock(const std::shared_ptr<const CBlock>& blo
     return true;
 }
 
-MempoolAcceptResult ChainstateManager::ProcessTransaction(const CTransactionRef& tx, bool test_accept, bool ignore_locks)
+MempoolAcceptResult ChainstateManager::ProcessTransaction(const CTransactionRef& tx, bool test_accept, bool ignore_locks, bool skip_rangeproof)
 {
     AssertLockHeld(cs_main);
     CChainState& active_chainstate = ActiveChainstate();
@@ -5091,7 +5503,7 @@ MempoolAcceptResult ChainstateManager::ProcessTransaction(const CTransactionRef&
         state.Invalid(TxValidationResult::TX_NO_MEMPOOL, "no-mempool");
         return MempoolAcceptResult::Failure(state);
     }
-    auto result = AcceptToMemoryPool(active_chainstate, tx, GetTime(), /*bypass_limits=*/ false, test_accept, ignore_locks);
+    auto result = AcceptToMemoryPool(active_chainstate, tx, GetTime(), /*bypass_limits=*/ false, test_accept, ignore_locks, skip_rangeproof);
     active_chainstate.GetMempool()->check(active_chainstate.CoinsTip(), active_chainstate.m_chain.Height() + 1);
     return result;
 }
@@ -5186,6 +5598,128 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100, false);
 }
 
+/** Blocks VerifyDB reads and checks ahead of the sequential levels */
+static constexpr size_t VERIFYDB_PREFETCH_BLOCKS{64};
+static constexpr int MAX_VERIFYDB_THREADS{8};
+
+/**
+ * Runs the VerifyDB levels that don't touch the chainstate on worker threads,
+ * reading the block (level 0), CheckBlock (level 1) and reading the undo data (level 2)
+ * ahead of the consumer, which holds cs_main throughout.
+ * Workers only use the disk positions copied while constructing.
+ */
+class VerifyDBPrefetcher
+{
+public:
+    struct Item {
+        const CBlockIndex *pindex{nullptr};
+        FlatFilePos block_pos;
+        FlatFilePos undo_pos;
+        uint256 hash_prev;
+        CBlock block;
+        std::string error;
+        bool done{false};
+    };
+
+private:
+    const Consensus::Params &m_consensus_params;
+    const int m_check_level;
+    std::vector<Item> m_items;
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    size_t m_next GUARDED_BY(m_mutex){0};
+    size_t m_consumed GUARDED_BY(m_mutex){0};
+    bool m_interrupt GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads;
+
+    void Process(Item &item)
+    {
+        if (!ReadBlockFromDisk(item.block, item.block_pos, m_consensus_params)) {
+            item.error = strprintf("ReadBlockFromDisk failed at %d, hash=%s", item.pindex->nHeight, item.pindex->GetBlockHash().ToString());
+            return;
+        }
+        if (item.block.GetHash() != item.pindex->GetBlockHash()) {
+            item.error = strprintf("block hash doesn't match index at %d, hash=%s", item.pindex->nHeight, item.pindex->GetBlockHash().ToString());
+            return;
+        }
+        BlockValidationState state;
+        if (m_check_level >= 1 && !CheckBlock(item.block, state, m_consensus_params)) {
+            item.error = strprintf("found bad block at %d, hash=%s (%s)", item.pindex->nHeight, item.pindex->GetBlockHash().ToString(), state.ToString());
+            return;
+        }
+        if (m_check_level >= 2 && !item.undo_pos.IsNull()) {
+            CBlockUndo undo;
+            if (!UndoReadFromDisk(undo, item.undo_pos, item.hash_prev)) {
+                item.error = strprintf("found bad undo data at %d, hash=%s", item.pindex->nHeight, item.pindex->GetBlockHash().ToString());
+            }
+        }
+    }
+
+    void Loop()
+    {
+        while (true) {
+            size_t i;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                while (!m_interrupt && m_next < m_items.size() && m_next >= m_consumed + VERIFYDB_PREFETCH_BLOCKS) {
+                    m_cv.wait(lock);
+                }
+                if (m_interrupt || m_next >= m_items.size()) {
+                    return;
+                }
+                i = m_next++;
+            }
+            Process(m_items[i]);
+            {
+                LOCK(m_mutex);
+                m_items[i].done = true;
+            }
+            m_cv.notify_all();
+        }
+    }
+
+public:
+    VerifyDBPrefetcher(const Consensus::Params &consensus_params, int check_level, std::vector<Item> &&items, int num_threads)
+        : m_consensus_params(consensus_params), m_check_level(check_level), m_items(std::move(items))
+    {
+        for (int i = 0; i < num_threads; ++i) {
+            m_threads.emplace_back([this, i]() {
+                util::ThreadRename(strprintf("verifydb.%i", i));
+                Loop();
+            });
+        }
+    }
+
+    ~VerifyDBPrefetcher()
+    {
+        WITH_LOCK(m_mutex, m_interrupt = true);
+        m_cv.notify_all();
+        for (auto &t : m_threads) {
+            t.join();
+        }
+    }
+
+    size_t size() const { return m_items.size(); }
+
+    /** Wait for item i to be processed, items must be taken in order */
+    Item &Get(size_t i)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (!m_items[i].done) {
+            m_cv.wait(lock);
+        }
+        return m_items[i];
+    }
+
+    /** Free the block of item i, letting the workers move on */
+    void Release(size_t i)
+    {
+        m_items[i].block = CBlock();
+        WITH_LOCK(m_mutex, m_consumed = i + 1);
+        m_cv.notify_all();
+    }
+};
+
 bool CVerifyDB::VerifyDB(
     CChainState& chainstate,
     const Consensus::Params& consensus_params,
@@ -5208,22 +5742,15 @@ bool CVerifyDB::VerifyDB(
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
     CCoinsViewCache coins(&coinsview);
     CBlockIndex* pindex;
-    CBlockIndex* pindexFailure = nullptr;
+    const CBlockIndex* pindexFailure = nullptr;
     int nGoodTransactions = 0;
-    BlockValidationState state;
     int reportDone = 0;
     LogPrintf("[0%%]..."); /* Continued */
 
     const bool is_snapshot_cs{!chainstate.m_from_snapshot_blockhash};
 
+    std::vector<VerifyDBPrefetcher::Item> items;
     for (pindex = chainstate.m_chain.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-        const int percentageDone = std::max(1, std::min(99, (int)(((double)(chainstate.m_chain.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
-        if (reportDone < percentageDone / 10) {
-            // report every 10% step
-            LogPrintf("[%d%%]...", percentageDone); /* Continued */
-            reportDone = percentageDone / 10;
-        }
-        uiInterface.ShowProgress(_("Verifying blocks…").translated, percentageDone, false);
         if (pindex->nHeight <= chainstate.m_chain.Height() - nCheckDepth) {
             break;
         }
@@ -5233,41 +5760,47 @@ bool CVerifyDB::VerifyDB(
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        }
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, consensus_params)) {
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), state.ToString());
+        VerifyDBPrefetcher::Item item;
+        item.pindex = pindex;
+        item.block_pos = pindex->GetBlockPos();
+        item.undo_pos = pindex->GetUndoPos();
+        item.hash_prev = pindex->pprev->GetBlockHash();
+        items.push_back(std::move(item));
+    }
+
+    // Levels 0 to 2 run ahead on the worker threads, level 3 disconnects in order
+    int num_threads = std::clamp(GetNumCores() - 1, 1, MAX_VERIFYDB_THREADS);
+    VerifyDBPrefetcher prefetcher(consensus_params, nCheckLevel, std::move(items), num_threads);
+    for (size_t i = 0; i < prefetcher.size(); ++i) {
+        VerifyDBPrefetcher::Item &item = prefetcher.Get(i);
+        const CBlockIndex *pindex_check = item.pindex;
+        const int percentageDone = std::max(1, std::min(99, (int)(((double)(chainstate.m_chain.Height() - pindex_check->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
+        if (reportDone < percentageDone / 10) {
+            // report every 10% step
+            LogPrintf("[%d%%]...", percentageDone); /* Continued */
+            reportDone = percentageDone / 10;
         }
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            if (!pindex->GetUndoPos().IsNull()) {
-                if (!UndoReadFromDisk(undo, pindex)) {
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-                }
-            }
+        uiInterface.ShowProgress(_("Verifying blocks…").translated, percentageDone, false);
+        if (!item.error.empty()) {
+            return error("VerifyDB(): *** %s", item.error);
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
         size_t curr_coins_usage = coins.DynamicMemoryUsage() + chainstate.CoinsTip().DynamicMemoryUsage();
 
         if (nCheckLevel >= 3 && curr_coins_usage <= chainstate.m_coinstip_cache_size_bytes) {
-            assert(coins.GetBestBlock() == pindex->GetBlockHash());
-            DisconnectResult res = chainstate.DisconnectBlock(block, pindex, coins);
+            assert(coins.GetBestBlock() == pindex_check->GetBlockHash());
+            DisconnectResult res = chainstate.DisconnectBlock(item.block, pindex_check, coins);
             if (res == DISCONNECT_FAILED) {
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex_check->nHeight, pindex_check->GetBlockHash().ToString());
             }
             if (res == DISCONNECT_UNCLEAN) {
                 nGoodTransactions = 0;
-                pindexFailure = pindex;
+                pindexFailure = pindex_check;
             } else {
-                nGoodTransactions += block.vtx.size();
+                nGoodTransactions += item.block.vtx.size();
             }
         }
+        prefetcher.Release(i);
         if (ShutdownRequested()) return true;
     }
     if (pindexFailure) {
@@ -5518,15 +6051,17 @@ bool ChainstateManager::LoadBlockIndex()
         fAddressIndex = gArgs.GetBoolArg("-addressindex", particl::DEFAULT_ADDRESSINDEX);
         m_blockman.m_block_tree_db->WriteFlag("addressindex", fAddressIndex);
         LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-        fTimestampIndex = gArgs.GetBoolArg("-timestampindex", particl::DEFAULT_TIMESTAMPINDEX);
-        m_blockman.m_block_tree_db->WriteFlag("timestampindex", fTimestampIndex);
-        LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
+        fAddressBalanceIndex = fAddressIndex;
+        m_blockman.m_block_tree_db->WriteFlag("addressbalanceindex", fAddressBalanceIndex);
         fSpentIndex = gArgs.GetBoolArg("-spentindex", particl::DEFAULT_SPENTINDEX);
         m_blockman.m_block_tree_db->WriteFlag("spentindex", fSpentIndex);
         LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
         fBalancesIndex = gArgs.GetBoolArg("-balancesindex", particl::DEFAULT_BALANCESINDEX);
         m_blockman.m_block_tree_db->WriteFlag("balancesindex", fBalancesIndex);
         LogPrintf("%s: balances index %s\n", __func__, fBalancesIndex ? "enabled" : "disabled");
+        fBlockRewardIndex = gArgs.GetBoolArg("-blockrewardindex", particl::DEFAULT_BLOCKREWARDINDEX);
+        m_blockman.m_block_tree_db->WriteFlag("blockrewardindex", fBlockRewardIndex);
+        LogPrintf("%s: block reward index %s\n", __func__, fBlockRewardIndex ? "enabled" : "disabled");
     }
     return true;
 }
@@ -5558,126 +6093,317 @@ bool CChainState::LoadGenesisBlock()
     return true;
 }
 
+/** Records LoadExternalBlockFile reads and checks ahead of the in order accept */
+static constexpr size_t IMPORT_PREFETCH_BLOCKS{64};
+static constexpr int MAX_IMPORT_THREADS{8};
+/** Out of order blocks over this size in total are dropped for a position to read from disk again */
+static constexpr size_t MAX_UNKNOWN_PARENT_BYTES{64 << 20};
+
+/**
+ * Pipelines LoadExternalBlockFile, a reader thread scans the file for records
+ * and worker threads deserialize them and run CheckBlock, batched rangeproofs
+ * included, ahead of the consumer which accepts the blocks in file order.
+ */
+class ExternalBlockImporter
+{
+public:
+    struct Item {
+        uint64_t pos{0}; // Offset of the record data in the file
+        unsigned int size{0};
+        bool compressed{false};
+        std::vector<uint8_t> data;
+        std::shared_ptr<CBlock> block;
+        std::string error;
+        bool done{false};
+    };
+
+private:
+    CBufferedFile m_blkdat;
+    const CChainParams &m_params;
+    CChainState &m_chainstate;
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Item> m_items GUARDED_BY(m_mutex);
+    size_t m_first GUARDED_BY(m_mutex){0}; // Sequence number of m_items.front()
+    size_t m_next GUARDED_BY(m_mutex){0};
+    bool m_eof GUARDED_BY(m_mutex){false};
+    bool m_interrupt GUARDED_BY(m_mutex){false};
+    std::string m_abort_error GUARDED_BY(m_mutex);
+    std::vector<std::thread> m_threads;
+
+    void ReadLoop()
+    {
+        try {
+            uint64_t nRewind = m_blkdat.GetPos();
+            CMessageHeader::MessageStartChars compressed_start;
+            node::GetCompressedMessageStart(m_params.MessageStart(), compressed_start);
+            while (!m_blkdat.eof()) {
+                if (ShutdownRequested()) break;
+                {
+                    WAIT_LOCK(m_mutex, lock);
+                    while (!m_interrupt && m_items.size() >= IMPORT_PREFETCH_BLOCKS) {
+                        m_cv.wait(lock);
+                    }
+                    if (m_interrupt) break;
+                }
+
+                m_blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                m_blkdat.SetLimit(); // remove former limit
+                Item item;
+                try {
+                    // locate a header
+                    unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                    m_blkdat.FindByte(m_params.MessageStart()[0]);
+                    nRewind = m_blkdat.GetPos() + 1;
+                    m_blkdat >> buf;
+                    item.compressed = !memcmp(buf, compressed_start, CMessageHeader::MESSAGE_START_SIZE);
+                    if (!item.compressed && memcmp(buf, m_params.MessageStart(), CMessageHeader::MESSAGE_START_SIZE)) {
+                        continue;
+                    }
+                    // read size
+                    m_blkdat >> item.size;
+                    if (item.size < (item.compressed ? 5 : 80) || item.size > MAX_BLOCK_SERIALIZED_SIZE)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    break;
+                }
+                try {
+                    // read the record, deserialized on the workers
+                    item.pos = m_blkdat.GetPos();
+                    m_blkdat.SetLimit(item.pos + item.size);
+                    item.data.resize(item.size);
+                    m_blkdat.read(MakeWritableByteSpan(item.data));
+                    nRewind = m_blkdat.GetPos();
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: I/O error - %s\n", __func__, e.what());
+                    continue;
+                }
+                WITH_LOCK(m_mutex, m_items.push_back(std::move(item)));
+                m_cv.notify_all();
+            }
+        } catch (const std::runtime_error& e) {
+            WITH_LOCK(m_mutex, m_abort_error = e.what());
+        }
+        WITH_LOCK(m_mutex, m_eof = true);
+        m_cv.notify_all();
+    }
+
+    void Process(Item &item)
+    {
+        auto block = std::make_shared<CBlock>();
+        try {
+            if (item.compressed) {
+                std::vector<uint8_t> data;
+                if (!node::DecompressRecord(item.data, data)) {
+                    item.error = "Failed to decompress record";
+                    return;
+                }
+                CDataStream{data, SER_DISK, CLIENT_VERSION} >> *block;
+            } else {
+                CDataStream{item.data, SER_DISK, CLIENT_VERSION} >> *block;
+            }
+        } catch (const std::exception& e) {
+            item.error = e.what();
+            return;
+        }
+        item.data = std::vector<uint8_t>();
+
+        // Failures are left to AcceptBlock, which marks the block invalid
+        const uint256 hash = block->GetHash();
+        bool have_data = WITH_LOCK(cs_main, const CBlockIndex *pindex = m_chainstate.m_blockman.LookupBlockIndex(hash); return pindex && (pindex->nStatus & BLOCK_HAVE_DATA));
+        if (!have_data) {
+            BlockValidationState state;
+            CheckBlock(*block, state, m_params.GetConsensus());
+        }
+        item.block = block;
+    }
+
+    void WorkLoop()
+    {
+        while (true) {
+            Item *item;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                while (!m_interrupt && !m_eof && m_next >= m_first + m_items.size()) {
+                    m_cv.wait(lock);
+                }
+                if (m_interrupt || m_next >= m_first + m_items.size()) {
+                    return;
+                }
+                item = &m_items[m_next++ - m_first];
+            }
+            Process(*item);
+            WITH_LOCK(m_mutex, item->done = true);
+            m_cv.notify_all();
+        }
+    }
+
+public:
+    ExternalBlockImporter(FILE *file, const CChainParams &params, CChainState &chainstate, int num_threads)
+        // This takes over file and calls fclose() on it in the CBufferedFile destructor
+        : m_blkdat(file, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION),
+          m_params(params), m_chainstate(chainstate)
+    {
+        m_threads.emplace_back([this]() {
+            util::ThreadRename("loadblk.read");
+            ReadLoop();
+        });
+        for (int i = 0; i < num_threads; ++i) {
+            m_threads.emplace_back([this, i]() {
+                util::ThreadRename(strprintf("loadblk.%i", i));
+                WorkLoop();
+            });
+        }
+    }
+
+    ~ExternalBlockImporter()
+    {
+        WITH_LOCK(m_mutex, m_interrupt = true);
+        m_cv.notify_all();
+        for (auto &t : m_threads) {
+            t.join();
+        }
+    }
+
+    /** Wait for the next record in file order, returns false once all are taken */
+    bool Next(Item &item)
+    {
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (!(m_eof && m_items.empty()) && !(!m_items.empty() && m_items.front().done)) {
+                m_cv.wait(lock);
+            }
+            if (m_items.empty()) {
+                if (!m_abort_error.empty()) {
+                    AbortNode(std::string("System error: ") + m_abort_error);
+                }
+                return false;
+            }
+            item = std::move(m_items.front());
+            m_items.pop_front();
+            m_first++;
+        }
+        m_cv.notify_all();
+        return true;
+    }
+};
+
 void CChainState::LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp, ChainstateManager *chainman)
 {
     AssertLockNotHeld(m_chainstate_mutex);
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
+    // Blocks with unknown parent, kept in memory up to MAX_UNKNOWN_PARENT_BYTES.
+    // Beyond that only the disk position is kept (reindex) or the block is dropped.
+    struct UnknownParentBlock {
+        FlatFilePos pos;
+        std::shared_ptr<const CBlock> block;
+        size_t size{0};
+    };
+    static std::multimap<uint256, UnknownParentBlock> mapBlocksUnknownParent;
+    static size_t unknown_parent_bytes = 0;
     int64_t nStart = GetTimeMillis();
 
     fAddressIndex = gArgs.GetBoolArg("-addressindex", particl::DEFAULT_ADDRESSINDEX);
-    fTimestampIndex = gArgs.GetBoolArg("-timestampindex", particl::DEFAULT_TIMESTAMPINDEX);
     fSpentIndex = gArgs.GetBoolArg("-spentindex", particl::DEFAULT_SPENTINDEX);
     fBalancesIndex = gArgs.GetBoolArg("-balancesindex", particl::DEFAULT_BALANCESINDEX);
+    fBlockRewardIndex = gArgs.GetBoolArg("-blockrewardindex", particl::DEFAULT_BLOCKREWARDINDEX);
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        ExternalBlockImporter importer(fileIn, m_params, *this, std::clamp(GetNumCores() - 1, 1, MAX_IMPORT_THREADS));
+        ExternalBlockImporter::Item item;
+        while (importer.Next(item)) {
             if (ShutdownRequested()) return;
+            if (!item.block) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, item.error);
+                continue;
+            }
+            if (dbp)
+                dbp->nPos = item.pos;
+            std::shared_ptr<CBlock> pblock = std::move(item.block);
+            const CBlock& block = *pblock;
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(m_params.MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> buf;
-                if (memcmp(buf, m_params.MessageStart(), CMessageHeader::MESSAGE_START_SIZE)) {
+            uint256 hash = block.GetHash();
+            {
+                LOCK(cs_main);
+                // detect out of order blocks, and store them for later
+                if (hash != m_params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(block.hashPrevBlock)) {
+                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                            block.hashPrevBlock.ToString());
+                    UnknownParentBlock unknown;
+                    if (dbp)
+                        unknown.pos = *dbp;
+                    if (unknown_parent_bytes + item.size <= MAX_UNKNOWN_PARENT_BYTES) {
+                        unknown.block = pblock;
+                        unknown.size = item.size;
+                        unknown_parent_bytes += item.size;
+                    }
+                    if (unknown.block || dbp)
+                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, unknown));
                     continue;
                 }
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != m_params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                        continue;
-                    }
 
-                    // process in case the block isn't known yet
-                    const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                      BlockValidationState state;
-                      state.m_chainman = chainman;
-                      if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr)) {
-                          nLoaded++;
-                      }
-                      if (state.IsError()) {
-                          break;
-                      }
-                    } else if (hash != m_params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
+                // process in case the block isn't known yet
+                const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
+                if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+                  BlockValidationState state;
+                  state.m_chainman = chainman;
+                  if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr)) {
+                      nLoaded++;
+                  }
+                  if (state.IsError()) {
+                      break;
+                  }
+                } else if (hash != m_params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+                    LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
                 }
+            }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == m_params.GetConsensus().hashGenesisBlock) {
-                    BlockValidationState state;
-                    state.m_chainman = chainman;
-                    if (!ActivateBestChain(state, nullptr)) {
-                        break;
-                    }
+            // Activate the genesis block so normal node progress can continue
+            if (hash == m_params.GetConsensus().hashGenesisBlock) {
+                BlockValidationState state;
+                state.m_chainman = chainman;
+                if (!ActivateBestChain(state, nullptr)) {
+                    break;
                 }
+            }
 
-                NotifyHeaderTip(*this);
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, m_params.GetConsensus())) {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            dummy.m_chainman = chainman;
-                            if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
+            NotifyHeaderTip(*this);
+
+            // Recursively process earlier encountered successors of this block
+            std::deque<uint256> queue;
+            queue.push_back(hash);
+            while (!queue.empty()) {
+                uint256 head = queue.front();
+                queue.pop_front();
+                std::pair<std::multimap<uint256, UnknownParentBlock>::iterator, std::multimap<uint256, UnknownParentBlock>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                while (range.first != range.second) {
+                    std::multimap<uint256, UnknownParentBlock>::iterator it = range.first;
+                    std::shared_ptr<const CBlock> pblockrecursive = it->second.block;
+                    if (!pblockrecursive) {
+                        auto pblockread = std::make_shared<CBlock>();
+                        if (ReadBlockFromDisk(*pblockread, it->second.pos, m_params.GetConsensus())) {
+                            pblockrecursive = pblockread;
+                        }
+                    }
+                    if (pblockrecursive) {
+                        LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                                head.ToString());
+                        LOCK(cs_main);
+                        BlockValidationState dummy;
+                        dummy.m_chainman = chainman;
+                        if (AcceptBlock(pblockrecursive, dummy, nullptr, true, it->second.pos.IsNull() ? nullptr : &it->second.pos, nullptr))
+                        {
+                            nLoaded++;
+                            queue.push_back(pblockrecursive->GetHash());
                         }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip(*this);
                     }
+                    unknown_parent_bytes -= it->second.size;
+                    range.first++;
+                    mapBlocksUnknownParent.erase(it);
+                    NotifyHeaderTip(*this);
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
     } catch (const std::runtime_error& e) {
@@ -5951,6 +6677,47 @@ bool CChainState::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+/** Run the context-free checks of blinded txns over all cores, seeding the rangeproof cache for AcceptToMemoryPool */
+static void PreCheckMempoolTxns(CChainState& active_chainstate, const std::vector<std::pair<CTransactionRef, int64_t> > &txns)
+{
+    if (txns.empty()) {
+        return;
+    }
+    const int64_t start_us = GetTimeMicros();
+    const Consensus::Params &consensus = Params().GetConsensus();
+    const int spend_height = WITH_LOCK(cs_main, return active_chainstate.m_chain.Height());
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> n_failed{0};
+    auto check = [&]() {
+        // blind_scratch is guarded by cs_main, each thread verifies bulletproofs in its own scratch space
+        secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(secp256k1_ctx_blind, 1024 * 1024);
+        assert(scratch);
+        for (size_t i = next++; i < txns.size() && !ShutdownRequested(); i = next++) {
+            TxValidationState state;
+            // Same time as AcceptToMemoryPool so the proofs are cached under the same entries
+            state.SetStateInfo(txns[i].second, spend_height, consensus, fParticlMode, false);
+            state.m_scratch = scratch;
+            if (!CheckTransaction(*txns[i].first, state)) {
+                n_failed++;
+            }
+        }
+        secp256k1_scratch_space_destroy(secp256k1_ctx_blind, scratch);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min<int>(GetNumCores(), txns.size()); ++i) {
+        threads.emplace_back([&check, i]() {
+            util::ThreadRename(strprintf("loadmempool.%i", i));
+            check();
+        });
+    }
+    check();
+    for (auto &t : threads) {
+        t.join();
+    }
+    LogPrint(BCLog::MEMPOOL, "%s: Checked %d blinded txns on %d threads in %dms, %d failed\n", __func__,
+        txns.size(), threads.size() + 1, (GetTimeMicros() - start_us) / 1000, n_failed);
+}
+
 bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function)
 {
     int64_t nExpiryTimeout = gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
@@ -5976,6 +6743,10 @@ bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mocka
         }
         uint64_t num;
         file >> num;
+        // Read all entries first so the expensive rangeproof checks can run in parallel,
+        // the txns are then accepted in file order as dependent txns must follow their parents
+        std::vector<std::tuple<CTransactionRef, int64_t, int64_t> > entries;
+        std::vector<std::pair<CTransactionRef, int64_t> > blinded_txns;
         while (num) {
             --num;
             CTransactionRef tx;
@@ -5984,7 +6755,17 @@ bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mocka
             file >> tx;
             file >> nTime;
             file >> nFeeDelta;
+            if (fParticlMode && nTime > nNow - nExpiryTimeout && tx->IsParticlVersion() &&
+                std::any_of(tx->vpout.begin(), tx->vpout.end(), [](const CTxOutBaseRef &txout) {
+                    return txout->IsType(OUTPUT_CT) || txout->IsType(OUTPUT_RINGCT); })) {
+                blinded_txns.emplace_back(tx, nTime);
+            }
+            entries.emplace_back(std::move(tx), nTime, nFeeDelta);
+        }
+        PreCheckMempoolTxns(active_chainstate, blinded_txns);
+        blinded_txns.clear();
 
+        for (const auto &[tx, nTime, nFeeDelta] : entries) {
             CAmount amountdelta = nFeeDelta;
             if (amountdelta) {
                 pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
@@ -6372,6 +7153,36 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
     // method.
     coins_cache.SetBestBlock(base_blockhash, 5);
 
+    // The Particl section is hashed before any rows are written to the shared RCT index
+    ParticlSnapshotHeader particl_header;
+    long particl_rows_pos{-1};
+    CBlockTreeDB* block_tree_db = WITH_LOCK(::cs_main, return m_blockman.m_block_tree_db.get());
+    if (fParticlMode) {
+        if (au_data.hash_particl.IsNull()) {
+            LogPrintf("[snapshot] no expected hash for the Particl state at height %d - refusing to load snapshot\n", base_height);
+            return false;
+        }
+        try {
+            coins_file >> particl_header;
+        } catch (const std::ios_base::failure&) {
+            LogPrintf("[snapshot] bad snapshot format or truncated snapshot, missing Particl state\n");
+            return false;
+        }
+        CHashWriter particl_hasher(SER_GETHASH, 0);
+        particl_hasher << particl_header;
+        particl_rows_pos = std::ftell(coins_file.Get());
+        if (particl_rows_pos < 0 ||
+            !block_tree_db->LoadSnapshotRCTState(coins_file, particl_header.m_anon_outputs, base_height, particl_hasher, /*write=*/false)) {
+            LogPrintf("[snapshot] bad snapshot Particl state\n");
+            return false;
+        }
+        if (particl_hasher.GetHash() != au_data.hash_particl) {
+            LogPrintf("[snapshot] bad snapshot Particl state hash: expected %s, got %s\n",
+                au_data.hash_particl.ToString(), particl_hasher.GetHash().ToString());
+            return false;
+        }
+    }
+
     bool out_of_coins{false};
     try {
         coins_file >> outpoint;
@@ -6414,6 +7225,16 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
         return false;
     }
 
+    if (fParticlMode) {
+        // The background chainstate writes the same rows when it reaches the base block
+        CHashWriter particl_hasher(SER_GETHASH, 0);
+        if (std::fseek(coins_file.Get(), particl_rows_pos, SEEK_SET) != 0 ||
+            !block_tree_db->LoadSnapshotRCTState(coins_file, particl_header.m_anon_outputs, base_height, particl_hasher, /*write=*/true)) {
+            LogPrintf("[snapshot] failed to write Particl state\n");
+            return false;
+        }
+    }
+
     snapshot_chainstate.m_chain.SetTip(snapshot_start_block);
 
     // The remainder of this function requires modifying data protected by cs_main.
@@ -6462,6 +7283,12 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
 
     assert(index);
     index->nChainTx = au_data.nChainTx;
+    if (fParticlMode) {
+        // Normally set when the block is connected
+        index->nMoneySupply = particl_header.m_money_supply;
+        index->nAnonOutputs = particl_header.m_anon_outputs;
+        index->bnStakeModifier = particl_header.m_stake_modifier;
+    }
     snapshot_chainstate.setBlockIndexCandidates.insert(snapshot_start_block);
 
     LogPrintf("[snapshot] validated snapshot (%.2f MB)\n",
@@ -6639,6 +7466,11 @@ void SetNumBlocksOfPeers(int num_blocks)
     nPeerBlocks = num_blocks;
 }
 
+bool IsChainBehindPeers(int height)
+{
+    return gArgs.GetBoolArg("-checkpeerheight", true) && height < GetNumBlocksOfPeers() - 1;
+}
+
 int StakeConflict::Add(NodeId id)
 {
     nLastUpdated = GetTime();
@@ -6652,11 +7484,7 @@ int StakeConflict::Add(NodeId id)
 
 bool CoinStakeCache::GetCoinStake(CChainState &chainstate, const uint256 &blockHash, CTransactionRef &tx)
 {
-    for (const auto &i : lData) {
-        if (blockHash != i.first) {
-            continue;
-        }
-        tx = i.second;
+    if (m_data.Get(blockHash, tx)) {
         return true;
     }
 
@@ -6675,12 +7503,7 @@ bool CoinStakeCache::GetCoinStake(CChainState &chainstate, const uint256 &blockH
 
 bool CoinStakeCache::InsertCoinStake(const uint256 &blockHash, const CTransactionRef &tx)
 {
-    lData.emplace_front(blockHash, tx);
-
-    while (lData.size() > nMaxSize) {
-        lData.pop_back();
-    }
-
+    m_data.Insert(blockHash, tx);
     return true;
 }
 
@@ -6824,6 +7647,44 @@ size_t CountDelayedBlocks() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return list_delayed_blocks.size();
 }
 
+size_t DelayedBlocksUsage() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    size_t usage = memusage::MallocUsage(sizeof(DelayedBlock) + 2 * sizeof(void*)) * list_delayed_blocks.size();
+    for (const auto &p : list_delayed_blocks) {
+        usage += memusage::DynamicUsage(p.m_pblock) + RecursiveDynamicUsage(*p.m_pblock);
+    }
+    return usage;
+}
+
+size_t StakeConflictUsage() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    size_t usage = memusage::DynamicUsage(mapStakeConflict);
+    for (const auto &it : mapStakeConflict) {
+        usage += memusage::DynamicUsage(it.second.peerCount);
+    }
+    return usage;
+}
+
+size_t StakeSeenUsage()
+{
+    LOCK(cs_stake_seen);
+    return stakeSeenCache.DynamicMemoryUsage();
+}
+
+/** The stake kernel isn't kept in the block index, read it from the stored coinstake */
+static bool ReadStakeKernel(const CBlockIndex *pindex, COutPoint &kernel) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (!pindex->IsProofOfStake() || !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+        return false;
+    }
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()) || !block.IsProofOfStake()) {
+        return false;
+    }
+    kernel = block.vtx[0]->vin[0].prevout;
+    return true;
+}
+
 bool ProcessDuplicateStakeHeader(BlockManager &blockman, CBlockIndex *pindex, NodeId nodeId) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     if (!pindex) {
@@ -6872,9 +7733,10 @@ bool ProcessDuplicateStakeHeader(BlockManager &blockman, CBlockIndex *pindex, No
                     pindexPrev->nStatus &= (~BLOCK_FAILED_VALID);
                     blockman.m_dirty_blockindex.insert(pindexPrev);
 
-                    if (!pindexPrev->prevoutStake.IsNull()) {
+                    COutPoint kernel;
+                    if (ReadStakeKernel(pindexPrev, kernel)) {
                         uint256 prevhash = pindexPrev->GetBlockHash();
-                        particl::AddToMapStakeSeen(pindexPrev->prevoutStake, prevhash);
+                        particl::AddToMapStakeSeen(kernel, prevhash);
                     }
 
                     pindexPrev->nStatus &= (~BLOCK_FAILED_CHILD);
@@ -6886,8 +7748,9 @@ bool ProcessDuplicateStakeHeader(BlockManager &blockman, CBlockIndex *pindex, No
             pindex->nStatus &= (~BLOCK_FAILED_CHILD);
         //};
 
-        if (!pindex->prevoutStake.IsNull()) {
-            particl::AddToMapStakeSeen(pindex->prevoutStake, hash);
+        COutPoint kernel;
+        if (ReadStakeKernel(pindex, kernel)) {
+            particl::AddToMapStakeSeen(kernel, hash);
         }
         return true;
     }
@@ -6898,53 +7761,42 @@ bool ProcessDuplicateStakeHeader(BlockManager &blockman, CBlockIndex *pindex, No
 
 bool AddToMapStakeSeen(const COutPoint &kernel, const uint256 &blockHash)
 {
-    // Overwrites existing values
-
-    std::pair<std::map<COutPoint, uint256>::iterator,bool> ret;
-    ret = mapStakeSeen.insert(std::pair<COutPoint, uint256>(kernel, blockHash));
-    if (ret.second == false) { // existing element
-        ret.first->second = blockHash;
-    } else {
-        listStakeSeen.push_back(kernel);
-    }
-
+    // Overwrites existing values, evicts the least recently seen kernel when full
+    LOCK(cs_stake_seen);
+    stakeSeenCache.Insert(kernel, blockHash);
     return true;
 };
 
 bool CheckStakeUnused(const COutPoint &kernel)
 {
-    std::map<COutPoint, uint256>::const_iterator mi = mapStakeSeen.find(kernel);
-    return (mi == mapStakeSeen.end());
+    LOCK(cs_stake_seen);
+    return !stakeSeenCache.Peek(kernel);
 }
 
 bool CheckStakeUnique(const CBlock &block, bool fUpdate)
 {
-    LOCK(cs_main);
-
     uint256 blockHash = block.GetHash();
     const COutPoint &kernel = block.vtx[0]->vin[0].prevout;
 
-    std::map<COutPoint, uint256>::const_iterator mi = mapStakeSeen.find(kernel);
-    if (mi != mapStakeSeen.end()) {
-        if (mi->second == blockHash) {
+    LOCK(cs_stake_seen);
+    const uint256 *seen_hash = stakeSeenCache.Peek(kernel);
+    if (seen_hash) {
+        if (*seen_hash == blockHash) {
             return true;
         }
-        return error("%s: Stake kernel for %s first seen on %s.", __func__, blockHash.ToString(), mi->second.ToString());
+        return error("%s: Stake kernel for %s first seen on %s.", __func__, blockHash.ToString(), seen_hash->ToString());
     }
 
-    if (!fUpdate) {
-        return true;
-    }
-
-    while (listStakeSeen.size() > particl::MAX_STAKE_SEEN_SIZE) {
-        const COutPoint &oldest = listStakeSeen.front();
-        if (1 != mapStakeSeen.erase(oldest)) {
-            LogPrintf("%s: Warning: mapStakeSeen did not erase %s %n\n", __func__, oldest.hash.ToString(), oldest.n);
-        }
-        listStakeSeen.pop_front();
+    if (fUpdate) {
+        stakeSeenCache.Insert(kernel, blockHash);
     }
+    return true;
+};
 
-    return AddToMapStakeSeen(kernel, blockHash);
+void ClearStakeSeen()
+{
+    LOCK(cs_stake_seen);
+    stakeSeenCache.Clear();
 };
 
 bool ShouldAutoReindex(ChainstateManager &chainman)
@@ -6964,6 +7816,98 @@ bool ShouldAutoReindex(ChainstateManager &chainman)
     return false;
 };
 
+static Mutex g_rolling_rebuild_mutex;
+static RollingIndicesRebuildStatus g_rolling_rebuild_status GUARDED_BY(g_rolling_rebuild_mutex);
+
+static void SetRollingRebuildState(RollingIndicesRebuildStatus::State state, int rewind_height = 0, int start_height = 0)
+{
+    LOCK(g_rolling_rebuild_mutex);
+    g_rolling_rebuild_status.state = state;
+    if (state == RollingIndicesRebuildStatus::REWINDING) {
+        g_rolling_rebuild_status.rewind_height = rewind_height;
+        g_rolling_rebuild_status.start_height = start_height;
+    }
+}
+
+RollingIndicesRebuildStatus GetRollingIndicesRebuildStatus()
+{
+    LOCK(g_rolling_rebuild_mutex);
+    return g_rolling_rebuild_status;
+}
+
+std::string RollingIndicesRebuildStateName(RollingIndicesRebuildStatus::State state)
+{
+    switch (state) {
+        case RollingIndicesRebuildStatus::NONE: return "none";
+        case RollingIndicesRebuildStatus::REWINDING: return "rewinding";
+        case RollingIndicesRebuildStatus::RECONNECTING: return "reconnecting";
+        case RollingIndicesRebuildStatus::DONE: return "done";
+        case RollingIndicesRebuildStatus::FAILED: return "failed";
+    }
+    assert(false);
+}
+
+/** Bring the smsg funding rows in line with the active chain from the per block undo records,
+ *  disconnecting blocks back to the fork point and reconnecting the active blocks after it.
+ *  Returns false if the smsg best block is unknown and a full rebuild is needed.
+ */
+static bool RepairSmsgChainSync(ChainstateManager &chainman, const uint256 &best_smsg_block_hash)
+{
+    LOCK(cs_main);
+    const CChain &chain = chainman.ActiveChain();
+    const CBlockIndex *pindex = chainman.m_blockman.LookupBlockIndex(best_smsg_block_hash);
+    if (!pindex) {
+        LogPrintf("%s: SMSG best block %s not found.\n", __func__, best_smsg_block_hash.ToString());
+        return false;
+    }
+
+    int num_disconnected = 0, num_connected = 0;
+    while (pindex && !chain.Contains(pindex)) {
+        if (!pindex->pprev) {
+            return false;
+        }
+        smsg::ChainSyncCache cache;
+        if (0 != chainman.m_smsgman->DisconnectBlock(cache, pindex->GetBlockHash(), pindex->nHeight, pindex->nTime,
+                                                     pindex->pprev->GetBlockHash(), pindex->pprev->nHeight) ||
+            0 != chainman.m_smsgman->WriteCache(cache)) {
+            return false;
+        }
+        num_disconnected++;
+        pindex = pindex->pprev;
+    }
+
+    int64_t now = chainman.m_adjusted_time_callback();
+    const Consensus::Params &consensus_params = Params().GetConsensus();
+    for (pindex = chain.Next(pindex); pindex; pindex = chain.Next(pindex)) {
+        smsg::ChainSyncCache cache;
+        if (pindex->nTime >= now - smsg::KEEP_FUNDING_TX_DATA) {
+            CBlock block;
+            if (!node::ReadBlockFromDisk(block, pindex, consensus_params)) {
+                LogPrintf("%s: Failed to read block %s from disk.\n", __func__, pindex->GetBlockHash().ToString());
+                return false;
+            }
+            for (const auto &tx : block.vtx) {
+                if (tx->IsCoinStake() || tx->GetTotalSMSGFees() <= 0) {
+                    continue;
+                }
+                if (0 != chainman.m_smsgman->StoreFundingTx(cache, *tx, pindex)) {
+                    return false;
+                }
+            }
+        }
+        if (0 != chainman.m_smsgman->SetBestBlock(cache, pindex->GetBlockHash(), pindex->nHeight, pindex->nTime) ||
+            0 != chainman.m_smsgman->WriteCache(cache)) {
+            return false;
+        }
+        num_connected++;
+    }
+    if (0 != chainman.m_smsgman->FlushChainSync()) {
+        return false;
+    }
+    LogPrintf("%s: Disconnected %d, connected %d blocks.\n", __func__, num_disconnected, num_connected);
+    return true;
+}
+
 bool RebuildRollingIndices(ChainstateManager &chainman, CTxMemPool* mempool)
 {
     AssertLockNotHeld(cs_main);
@@ -6979,7 +7923,12 @@ bool RebuildRollingIndices(ChainstateManager &chainman, CTxMemPool* mempool)
     }
 
     auto &pblocktree{chainman.m_blockman.m_block_tree_db};
+    int rewind_height{0}, start_height{0};
+    bool resume = WITH_LOCK(cs_main, return pblocktree->ReadRollingRebuild(rewind_height, start_height));
     bool nV2 = false;
+    if (resume) {
+        LogPrintf("%s: Resuming rebuild, rewinding chain to block %d.\n", __func__, rewind_height);
+    } else
     if (gArgs.GetBoolArg("-rebuildrollingindices", false)) {
         LogPrintf("%s: Manual override, attempting to rewind chain.\n", __func__);
     } else
@@ -6987,6 +7936,7 @@ bool RebuildRollingIndices(ChainstateManager &chainman, CTxMemPool* mempool)
         chainman.m_smsgman->TrackFundingTxns() &&
         !best_smsg_block_hash.IsNull() &&
         best_smsg_block_hash != pindex_tip->GetBlockHash() &&
+        !RepairSmsgChainSync(chainman, best_smsg_block_hash) &&
         pindex_tip->nHeight > best_smsg_block_height) {
         LogPrintf("%s: SMSG best block mismatch, attempting to rewind chain. SMSG %s, %s.\n", __func__, best_smsg_block_hash.ToString(), pindex_tip->GetBlockHash().ToString());
         if (best_smsg_block_height < pindex_tip->nHeight) {
@@ -6998,58 +7948,90 @@ bool RebuildRollingIndices(ChainstateManager &chainman, CTxMemPool* mempool)
     } else {
         LogPrintf("%s: v2 marker not detected, attempting to rewind chain.\n", __func__);
     }
-    uiInterface.InitMessage(_("Rebuilding rolling indices...").translated);
 
     if (!mempool) {
         LogPrintf("%s: Requires mempool.\n", __func__);
+        SetRollingRebuildState(RollingIndicesRebuildStatus::FAILED);
         return false;
     }
 
-    int64_t now = chainman.m_adjusted_time_callback();
-    int rewound_tip_height;
-
-    {
+    if (!resume) {
         LOCK(cs_main);
+        int64_t now = chainman.m_adjusted_time_callback();
         CBlockIndex *pindex = pindex_tip;
-        int max_height_to_keep = pindex ? pindex->nHeight : 0;
+        rewind_height = pindex ? pindex->nHeight : 0;
         while (pindex && pindex->nTime >= now - smsg::KEEP_FUNDING_TX_DATA) {
             if (pindex->nHeight < last_known_height) {
                 break;
             }
-            max_height_to_keep = pindex->nHeight;
+            rewind_height = pindex->nHeight;
             pindex = pindex->pprev;
         }
-
-        LogPrintf("%s: Rewinding to block %d.\n", __func__, max_height_to_keep);
-        int num_disconnected = 0;
-
-        std::string str_error;
-        if (!RewindToHeight(chainman, *mempool, max_height_to_keep, num_disconnected, str_error)) {
-            LogPrintf("%s: RewindToHeight failed %s.\n", __func__, str_error);
+        start_height = pindex_tip ? pindex_tip->nHeight : 0;
+        if (!pblocktree->WriteRollingRebuild(rewind_height, start_height)) {
+            LogPrintf("%s: WriteRollingRebuild failed.\n", __func__);
+            SetRollingRebuildState(RollingIndicesRebuildStatus::FAILED);
             return false;
         }
-        rewound_tip_height = pindex_tip ? pindex_tip->nHeight : 0;
     }
+    SetRollingRebuildState(RollingIndicesRebuildStatus::REWINDING, rewind_height, start_height);
+    LogPrintf("%s: Rewinding to block %d.\n", __func__, rewind_height);
+
+    CChainState &chainstate = chainman.ActiveChainstate();
+    {
+        // Keep ActivateBestChain from reconnecting blocks while rewinding,
+        // cs_main is released between batches so RPC calls are served.
+        LOCK(chainstate.m_chainstate_mutex);
+        while (true) {
+            if (ShutdownRequested()) {
+                LogPrintf("%s: Shutdown requested, the rebuild resumes on the next start.\n", __func__);
+                return true;
+            }
+            LOCK(cs_main);
+            int tip_height = chainman.ActiveChain().Height();
+            if (tip_height <= rewind_height) {
+                break;
+            }
+            int to_height = std::max(rewind_height, tip_height - (int)REWIND_FLUSH_BLOCKS);
+            int num_disconnected = 0;
+            std::string str_error;
+            if (!RewindToHeight(chainman, *mempool, to_height, num_disconnected, str_error)) {
+                LogPrintf("%s: RewindToHeight failed %s.\n", __func__, str_error);
+                SetRollingRebuildState(RollingIndicesRebuildStatus::FAILED);
+                return false;
+            }
+            chainstate.ForceFlushStateToDisk();
+        }
+    }
+    SetRollingRebuildState(RollingIndicesRebuildStatus::RECONNECTING);
 
     BlockValidationState state;
     state.m_chainman = &chainman;
-    if (!chainman.ActiveChainstate().ActivateBestChain(state)) {
+    if (!chainstate.ActivateBestChain(state)) {
         LogPrintf("%s: ActivateBestChain failed %s.\n", __func__, state.ToString());
+        SetRollingRebuildState(RollingIndicesRebuildStatus::FAILED);
         return false;
     }
+    if (ShutdownRequested()) {
+        LogPrintf("%s: Shutdown requested, the rebuild resumes on the next start.\n", __func__);
+        return true;
+    }
 
     {
         LOCK(cs_main);
         // Ensure chainstate has been fully written to disk
-        chainman.ActiveChainstate().ForceFlushStateToDisk();
+        chainstate.ForceFlushStateToDisk();
 
-        LogPrintf("%s: Reprocessed chain from block %d to %d.\n", __func__, rewound_tip_height, chainman.ActiveChain().Tip()->nHeight);
+        LogPrintf("%s: Reprocessed chain from block %d to %d.\n", __func__, rewind_height, chainman.ActiveChain().Tip()->nHeight);
 
-        if (!chainman.m_blockman.m_block_tree_db->WriteFlag("v2", true)) {
+        if (!pblocktree->WriteFlag("v2", true) ||
+            !pblocktree->EraseRollingRebuild()) {
             LogPrintf("%s: WriteFlag failed.\n", __func__);
+            SetRollingRebuildState(RollingIndicesRebuildStatus::FAILED);
             return false;
         }
     }
+    SetRollingRebuildState(RollingIndicesRebuildStatus::DONE);
     return true;
 }
 
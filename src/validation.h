@@ -18,6 +18,7 @@
 #include <consensus/amount.h>
 #include <deploymentstatus.h>
 #include <fs.h>
+#include <lrucache.h>
 #include <node/blockstorage.h>
 #include <policy/feerate.h>
 #include <policy/packages.h>
@@ -156,6 +157,14 @@ void StopScriptCheckWorkerThreads();
 
 namespace particl {
 static constexpr size_t MAX_STAKE_SEEN_SIZE = 1000;
+
+/** Run threads verifying queued block signatures ahead of CheckBlock */
+void StartBlockSignatureThreads(int threads_num);
+void StopBlockSignatureThreads();
+/** Queue a received PoS block, the verified signature is cached for CheckBlockSignature */
+void QueueBlockSignatureCheck(const std::shared_ptr<const CBlock> &pblock);
+LRUCacheStats GetBlockSignatureCacheStats();
+void ClearBlockSignatureCache();
 inline int64_t FutureDrift(int64_t nTime) { return nTime + 15; } // FutureDriftV2
 
 static constexpr bool DEFAULT_CSINDEX = false;
@@ -163,6 +172,7 @@ static constexpr bool DEFAULT_ADDRESSINDEX = false;
 static constexpr bool DEFAULT_TIMESTAMPINDEX = false;
 static constexpr bool DEFAULT_SPENTINDEX = false;
 static constexpr bool DEFAULT_BALANCESINDEX = false;
+static constexpr bool DEFAULT_BLOCKREWARDINDEX = false;
 static constexpr unsigned int DEFAULT_DB_MAX_OPEN_FILES = 64; // set to 1000 for insight
 static constexpr bool DEFAULT_DB_COMPRESSION = false; // set to true for insight
 static constexpr bool DEFAULT_AUTOMATIC_BANS = true;
@@ -175,6 +185,8 @@ int GetNumPeers();
 int GetNumBlocksOfPeers();
 /** Set the median number of blocks that other nodes claim to have - debug only */
 void SetNumBlocksOfPeers(int num_blocks);
+/** Return true if anon txns are rejected at height as the chain is behind peers, see -checkpeerheight */
+bool IsChainBehindPeers(int height);
 
 /** Return the current utxo sum */
 CAmount GetUTXOSum(CChainState &chainstate);
@@ -300,11 +312,12 @@ struct PackageMempoolAcceptResult
  *                                It is also used to determine when the entry expires.
  * @param[in]  bypass_limits      When true, don't enforce mempool fee and capacity limits.
  * @param[in]  test_accept        When true, run validation checks but don't submit to mempool.
+ * @param[in]  skip_rangeproof    When true, don't verify rangeproofs, the tx must have passed CheckTransaction before.
  *
  * @returns a MempoolAcceptResult indicating whether the transaction was accepted/rejected with reason.
  */
 MempoolAcceptResult AcceptToMemoryPool(CChainState& active_chainstate, const CTransactionRef& tx,
-                                       int64_t accept_time, bool bypass_limits, bool test_accept, bool ignore_locks=false)
+                                       int64_t accept_time, bool bypass_limits, bool test_accept, bool ignore_locks=false, bool skip_rangeproof=false)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 /**
@@ -419,6 +432,8 @@ void InitScriptExecutionCache();
 
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
+/** Verify the coinstake key signed a PoS block, successful checks are cached */
+bool CheckBlockSignature(const CBlock &block);
 
 unsigned int GetNextTargetRequired(const CBlockIndex *pindexLast, const Consensus::Params &consensus);
 
@@ -667,7 +682,7 @@ public:
     bool ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
-    /** Import blocks from an external file */
+    /** Import blocks from an external file, records are read and checked on worker threads and accepted in file order */
     void LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp = nullptr, ChainstateManager *chainman = nullptr)
         EXCLUSIVE_LOCKS_REQUIRED(!m_chainstate_mutex);
 
@@ -722,6 +737,8 @@ public:
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
     bool ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
                       CCoinsViewCache& view, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Whether pindex is in the -assumevalid chain deep enough below the best header to skip script, rangeproof and MLSAG signature checks */
+    bool IsAssumedValid(const CBlockIndex* pindex) const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Apply the effects of a block disconnection on the UTXO set.
     bool DisconnectTip(BlockValidationState& state, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
@@ -1077,8 +1094,9 @@ public:
      *
      * @param[in]  tx              The transaction to submit for mempool acceptance.
      * @param[in]  test_accept     When true, run validation checks but don't submit to mempool.
+     * @param[in]  skip_rangeproof When true, don't verify rangeproofs again for a tx that passed CheckTransaction.
      */
-    [[nodiscard]] MempoolAcceptResult ProcessTransaction(const CTransactionRef& tx, bool test_accept=false, bool ignore_locks=false)
+    [[nodiscard]] MempoolAcceptResult ProcessTransaction(const CTransactionRef& tx, bool test_accept=false, bool ignore_locks=false, bool skip_rangeproof=false)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     //! Load the block tree and coins database from disk, initializing state if we're running with -reindex
@@ -1155,32 +1173,58 @@ public:
 class CoinStakeCache
 {
 public:
-    CoinStakeCache() {};
-    explicit CoinStakeCache(size_t max_size) : nMaxSize(max_size) {};
-    size_t nMaxSize = 16;
-    std::list<std::pair<uint256, CTransactionRef> > lData;
+    CoinStakeCache() : m_data(16) {};
+    explicit CoinStakeCache(size_t max_size) : m_data(max_size) {};
+    LRUCache<uint256, CTransactionRef, SaltedTxidHasher> m_data;
 
     bool GetCoinStake(CChainState &chainstate, const uint256 &blockHash, CTransactionRef &tx) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool InsertCoinStake(const uint256 &blockHash, const CTransactionRef &tx) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Memory held by the entries, the transactions may be shared with blocks and aren't counted */
+    size_t DynamicMemoryUsage() const { return m_data.DynamicMemoryUsage(); }
 };
 
 extern std::map<uint256, StakeConflict> mapStakeConflict;
 extern CoinStakeCache coinStakeCache;
-extern std::map<COutPoint, uint256> mapStakeSeen;
-extern std::list<COutPoint> listStakeSeen;
+extern CoinStakeCache smsgFeeCoinstakeCache;
+extern CoinStakeCache smsgDifficultyCoinstakeCache;
+extern Mutex cs_stake_seen;
+/** Block hash each recent stake kernel was first seen in */
+extern LRUCache<COutPoint, uint256, SaltedOutpointHasher> stakeSeenCache GUARDED_BY(cs_stake_seen);
 
 bool RemoveUnreceivedHeader(ChainstateManager &chainman, const uint256 &hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 size_t CountDelayedBlocks() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+size_t DelayedBlocksUsage() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+size_t StakeConflictUsage() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+size_t StakeSeenUsage() LOCKS_EXCLUDED(cs_stake_seen);
 
 
 
-bool AddToMapStakeSeen(const COutPoint &kernel, const uint256 &blockHash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-bool CheckStakeUnused(const COutPoint &kernel);
-bool CheckStakeUnique(const CBlock &block, bool fUpdate=true);
+bool AddToMapStakeSeen(const COutPoint &kernel, const uint256 &blockHash) LOCKS_EXCLUDED(cs_stake_seen);
+bool CheckStakeUnused(const COutPoint &kernel) LOCKS_EXCLUDED(cs_stake_seen);
+bool CheckStakeUnique(const CBlock &block, bool fUpdate=true) LOCKS_EXCLUDED(cs_stake_seen);
+void ClearStakeSeen() LOCKS_EXCLUDED(cs_stake_seen);
 
 /** Returns true if the block index needs to be reindexed. */
 bool ShouldAutoReindex(ChainstateManager &chainman) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-/** Returns true if the block index was rewound to rebuild the temporary indices. */
+/** Progress of RebuildRollingIndices, reported by getblockchaininfo */
+struct RollingIndicesRebuildStatus {
+    enum State {
+        NONE,
+        REWINDING,
+        RECONNECTING,
+        DONE,
+        FAILED,
+    };
+    State state{NONE};
+    int rewind_height{0};
+    int start_height{0};
+};
+RollingIndicesRebuildStatus GetRollingIndicesRebuildStatus();
+std::string RollingIndicesRebuildStateName(RollingIndicesRebuildStatus::State state);
+
+/** Rewind the chain and reconnect it to rebuild the temporary indices if required.
+ *  Runs from ThreadImport, rewinds REWIND_FLUSH_BLOCKS at a time and resumes after a restart.
+ *  Returns false on failure. */
 bool RebuildRollingIndices(ChainstateManager &chainman, CTxMemPool* mempool);
 
 int64_t GetSmsgFeeRate(ChainstateManager &chainman, const CBlockIndex *pindex, bool reduce_height=false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -12,10 +12,15 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <scheduler.h>
+#include <tinyformat.h>
+#include <util/thread.h>
 
+#include <atomic>
 #include <future>
+#include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 /**
  * MainSignalsImpl manages a list of shared_ptr<CValidationInterface> callbacks.
@@ -24,6 +29,11 @@
  * registered, and a std::list is used to store the callbacks that are
  * currently registered as well as any callbacks that are just unregistered
  * and about to be deleted when they are done executing.
+ *
+ * Background callbacks go through the shared m_schedulerClient queue, except
+ * for subscribers registered with own_queue. Those get a queue of their own,
+ * serviced by m_pool, so independent subscribers can process the same event
+ * concurrently while each still sees events in order.
  */
 class MainSignalsImpl
 {
@@ -33,24 +43,82 @@ private:
     //! count is equal to the number of current executions of that entry, plus 1
     //! if it's registered. It cannot be 0 because that would imply it is
     //! unregistered and also not being executed (so shouldn't exist).
-    struct ListEntry { std::shared_ptr<CValidationInterface> callbacks; int count = 1; };
+    //! queue is set while a subscriber registered with own_queue is registered.
+    struct ListEntry { std::shared_ptr<CValidationInterface> callbacks; int count = 1; bool own_queue = false; SingleThreadedSchedulerClient* queue = nullptr; };
     std::list<ListEntry> m_list GUARDED_BY(m_mutex);
     std::unordered_map<CValidationInterface*, std::list<ListEntry>::iterator> m_map GUARDED_BY(m_mutex);
 
+    CScheduler& m_scheduler;
+    CScheduler m_pool;
+    std::vector<std::thread> m_pool_threads;
+    //! Callbacks may still be pending when a subscriber unregisters, so queues
+    //! are kept until shutdown and reused by later subscribers.
+    std::list<SingleThreadedSchedulerClient> m_queues GUARDED_BY(m_mutex);
+    std::vector<SingleThreadedSchedulerClient*> m_idle_queues GUARDED_BY(m_mutex);
+
+    void ReleaseQueue(ListEntry& entry) EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        if (entry.queue) {
+            m_idle_queues.push_back(entry.queue);
+            entry.queue = nullptr;
+        }
+    }
+
+    std::vector<SingleThreadedSchedulerClient*> GetQueues() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        std::vector<SingleThreadedSchedulerClient*> queues;
+        for (auto& queue : m_queues) {
+            queues.push_back(&queue);
+        }
+        return queues;
+    }
+
 public:
     // We are not allowed to assume the scheduler only runs in one thread,
     // but must ensure all callbacks happen in-order, so we end up creating
     // our own queue here :(
     SingleThreadedSchedulerClient m_schedulerClient;
 
-    explicit MainSignalsImpl(CScheduler& scheduler LIFETIMEBOUND) : m_schedulerClient(scheduler) {}
+    explicit MainSignalsImpl(CScheduler& scheduler LIFETIMEBOUND, int parallel_threads)
+        : m_scheduler(scheduler), m_schedulerClient(scheduler)
+    {
+        for (int i = 0; i < parallel_threads; ++i) {
+            m_pool_threads.emplace_back([this, name = strprintf("vnotify.%i", i)]() {
+                util::TraceThread(name.c_str(), [this] { m_pool.serviceQueue(); });
+            });
+        }
+    }
 
-    void Register(std::shared_ptr<CValidationInterface> callbacks) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    ~MainSignalsImpl() { StopPool(); }
+
+    void StopPool()
+    {
+        m_pool.stop();
+        for (auto& thread : m_pool_threads) {
+            if (thread.joinable()) thread.join();
+        }
+        m_pool_threads.clear();
+    }
+
+    void Register(std::shared_ptr<CValidationInterface> callbacks, bool own_queue) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
     {
         LOCK(m_mutex);
         auto inserted = m_map.emplace(callbacks.get(), m_list.end());
         if (inserted.second) inserted.first->second = m_list.emplace(m_list.end());
-        inserted.first->second->callbacks = std::move(callbacks);
+        ListEntry& entry = *inserted.first->second;
+        entry.callbacks = std::move(callbacks);
+        entry.own_queue = own_queue;
+        if (!own_queue) {
+            ReleaseQueue(entry);
+        } else if (!entry.queue) {
+            if (!m_idle_queues.empty()) {
+                entry.queue = m_idle_queues.back();
+                m_idle_queues.pop_back();
+            } else {
+                entry.queue = &m_queues.emplace_back(m_pool_threads.empty() ? m_scheduler : m_pool);
+            }
+        }
     }
 
     void Unregister(CValidationInterface* callbacks) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
@@ -58,6 +126,7 @@ public:
         LOCK(m_mutex);
         auto it = m_map.find(callbacks);
         if (it != m_map.end()) {
+            ReleaseQueue(*it->second);
             if (!--it->second->count) m_list.erase(it->second);
             m_map.erase(it);
         }
@@ -71,15 +140,21 @@ public:
     {
         LOCK(m_mutex);
         for (const auto& entry : m_map) {
+            ReleaseQueue(*entry.second);
             if (!--entry.second->count) m_list.erase(entry.second);
         }
         m_map.clear();
     }
 
-    template<typename F> void Iterate(F&& f) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    //! Call f on every subscriber, or with shared_queue_only only on the subscribers without their own queue
+    template<typename F> void Iterate(F&& f, bool shared_queue_only = false) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
     {
         WAIT_LOCK(m_mutex, lock);
         for (auto it = m_list.begin(); it != m_list.end();) {
+            if (shared_queue_only && it->own_queue) {
+                ++it;
+                continue;
+            }
             ++it->count;
             {
                 REVERSE_LOCK(lock);
@@ -88,14 +163,65 @@ public:
             it = --it->count ? std::next(it) : m_list.erase(it);
         }
     }
+
+    //! Queue f for each subscriber registered with own_queue, skipped if the subscriber unregisters first
+    template<typename F> void AddToOwnQueues(const F& f) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        for (const auto& entry : m_map) {
+            SingleThreadedSchedulerClient* queue = entry.second->queue;
+            if (!queue) continue;
+            queue->AddToProcessQueue([this, f, callbacks = entry.second->callbacks] {
+                if (!WITH_LOCK(m_mutex, return m_map.count(callbacks.get()) > 0)) return;
+                f(*callbacks);
+            });
+        }
+    }
+
+    //! Run func once the shared queue and every subscriber queue have processed the callbacks queued before now
+    void CallAfterAllQueues(std::function<void()> func) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        std::vector<SingleThreadedSchedulerClient*> queues = GetQueues();
+        if (queues.empty()) {
+            m_schedulerClient.AddToProcessQueue(std::move(func));
+            return;
+        }
+        auto remaining = std::make_shared<std::atomic<size_t>>(queues.size() + 1);
+        auto shared_func = std::make_shared<std::function<void()>>(std::move(func));
+        auto arrive = [remaining, shared_func] {
+            if (--*remaining == 0) (*shared_func)();
+        };
+        for (auto* queue : queues) {
+            queue->AddToProcessQueue(arrive);
+        }
+        m_schedulerClient.AddToProcessQueue(arrive);
+    }
+
+    void EmptyQueues() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        StopPool();
+        m_schedulerClient.EmptyQueue();
+        for (auto* queue : GetQueues()) {
+            queue->EmptyQueue();
+        }
+    }
+
+    size_t CallbacksPending() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        size_t pending = m_schedulerClient.CallbacksPending();
+        for (auto* queue : GetQueues()) {
+            pending += queue->CallbacksPending();
+        }
+        return pending;
+    }
 };
 
 static CMainSignals g_signals;
 
-void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler)
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler, int parallel_threads)
 {
     assert(!m_internals);
-    m_internals = std::make_unique<MainSignalsImpl>(scheduler);
+    m_internals = std::make_unique<MainSignalsImpl>(scheduler, parallel_threads);
 }
 
 void CMainSignals::UnregisterBackgroundSignalScheduler()
@@ -106,14 +232,14 @@ void CMainSignals::UnregisterBackgroundSignalScheduler()
 void CMainSignals::FlushBackgroundCallbacks()
 {
     if (m_internals) {
-        m_internals->m_schedulerClient.EmptyQueue();
+        m_internals->EmptyQueues();
     }
 }
 
 size_t CMainSignals::CallbacksPending()
 {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    return m_internals->CallbacksPending();
 }
 
 CMainSignals& GetMainSignals()
@@ -121,18 +247,18 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks)
+void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks, bool own_queue)
 {
     // Each connection captures the shared_ptr to ensure that each callback is
     // executed before the subscriber is destroyed. For more details see #18338.
-    g_signals.m_internals->Register(std::move(callbacks));
+    g_signals.m_internals->Register(std::move(callbacks), own_queue);
 }
 
-void RegisterValidationInterface(CValidationInterface* callbacks)
+void RegisterValidationInterface(CValidationInterface* callbacks, bool own_queue)
 {
     // Create a shared_ptr with a no-op deleter - CValidationInterface lifecycle
     // is managed by the caller.
-    RegisterSharedValidationInterface({callbacks, [](CValidationInterface*){}});
+    RegisterSharedValidationInterface({callbacks, [](CValidationInterface*){}}, own_queue);
 }
 
 void UnregisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks)
@@ -157,7 +283,7 @@ void UnregisterAllValidationInterfaces()
 
 void CallFunctionInValidationInterfaceQueue(std::function<void()> func)
 {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    g_signals.m_internals->CallAfterAllQueues(std::move(func));
 }
 
 void SyncWithValidationInterfaceQueue()
@@ -175,14 +301,16 @@ void SyncWithValidationInterfaceQueue()
 // evaluating arguments when logging is not enabled.
 //
 // NOTE: The lambda captures all local variables by value.
-#define ENQUEUE_AND_LOG_EVENT(event, fmt, name, ...)           \
+// notify is called for each subscriber, from the shared queue or their own.
+#define ENQUEUE_AND_LOG_EVENT(notify, fmt, name, ...)          \
     do {                                                       \
         auto local_name = (name);                              \
         LOG_EVENT("Enqueuing " fmt, local_name, __VA_ARGS__);  \
         m_internals->m_schedulerClient.AddToProcessQueue([=] { \
             LOG_EVENT(fmt, local_name, __VA_ARGS__);           \
-            event();                                           \
+            m_internals->Iterate(notify, true);                \
         });                                                    \
+        m_internals->AddToOwnQueues(notify);                   \
     } while (0)
 
 #define LOG_EVENT(fmt, ...) \
@@ -193,57 +321,45 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
-    auto event = [pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
-    };
-    ENQUEUE_AND_LOG_EVENT(event, "%s: new block hash=%s fork block hash=%s (in IBD=%s)", __func__,
+    auto notify = [pindexNew, pindexFork, fInitialDownload](CValidationInterface& callbacks) { callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); };
+    ENQUEUE_AND_LOG_EVENT(notify, "%s: new block hash=%s fork block hash=%s (in IBD=%s)", __func__,
                           pindexNew->GetBlockHash().ToString(),
                           pindexFork ? pindexFork->GetBlockHash().ToString() : "null",
                           fInitialDownload);
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) {
-    auto event = [tx, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.TransactionAddedToMempool(tx, mempool_sequence); });
-    };
-    ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s wtxid=%s", __func__,
+    auto notify = [tx, mempool_sequence](CValidationInterface& callbacks) { callbacks.TransactionAddedToMempool(tx, mempool_sequence); };
+    ENQUEUE_AND_LOG_EVENT(notify, "%s: txid=%s wtxid=%s", __func__,
                           tx->GetHash().ToString(),
                           tx->GetWitnessHash().ToString());
 }
 
 void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) {
-    auto event = [tx, reason, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.TransactionRemovedFromMempool(tx, reason, mempool_sequence); });
-    };
-    ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s wtxid=%s", __func__,
+    auto notify = [tx, reason, mempool_sequence](CValidationInterface& callbacks) { callbacks.TransactionRemovedFromMempool(tx, reason, mempool_sequence); };
+    ENQUEUE_AND_LOG_EVENT(notify, "%s: txid=%s wtxid=%s", __func__,
                           tx->GetHash().ToString(),
                           tx->GetWitnessHash().ToString());
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.BlockConnected(pblock, pindex); });
-    };
-    ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s block height=%d", __func__,
+    auto notify = [pblock, pindex](CValidationInterface& callbacks) { callbacks.BlockConnected(pblock, pindex); };
+    ENQUEUE_AND_LOG_EVENT(notify, "%s: block hash=%s block height=%d", __func__,
                           pblock->GetHash().ToString(),
                           pindex->nHeight);
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex)
 {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.BlockDisconnected(pblock, pindex); });
-    };
-    ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s block height=%d", __func__,
+    auto notify = [pblock, pindex](CValidationInterface& callbacks) { callbacks.BlockDisconnected(pblock, pindex); };
+    ENQUEUE_AND_LOG_EVENT(notify, "%s: block hash=%s block height=%d", __func__,
                           pblock->GetHash().ToString(),
                           pindex->nHeight);
 }
 
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
-    auto event = [locator, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.ChainStateFlushed(locator); });
-    };
-    ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s", __func__,
+    auto notify = [locator](CValidationInterface& callbacks) { callbacks.ChainStateFlushed(locator); };
+    ENQUEUE_AND_LOG_EVENT(notify, "%s: block hash=%s", __func__,
                           locator.IsNull() ? "null" : locator.vHave.front().ToString());
 }
 
@@ -266,6 +382,10 @@ void CMainSignals::NewSecureMessage(const smsg::SecureMessage *psmsg, const uint
     m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.NewSecureMessage(psmsg, hash); });
 }
 
+void CMainSignals::SecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids) {
+    m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.SecureMessagesFunded(txid, msgids); });
+}
+
 void CMainSignals::LeavingIBD() {
     m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.LeavingIBD(); });
 }
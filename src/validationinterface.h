@@ -25,8 +25,12 @@ namespace smsg {
 class SecureMessage;
 }
 
-/** Register subscriber */
-void RegisterValidationInterface(CValidationInterface* callbacks);
+/** Background callbacks to subscribers registered with own_queue run on this many threads */
+static constexpr int DEFAULT_NOTIFICATION_THREADS{2};
+static constexpr int MAX_NOTIFICATION_THREADS{16};
+
+/** Register subscriber, with own_queue its background callbacks run on a serial queue of its own, concurrently with other subscribers */
+void RegisterValidationInterface(CValidationInterface* callbacks, bool own_queue = false);
 /** Unregister subscriber. DEPRECATED. This is not safe to use when the RPC server or main message handler thread is running. */
 void UnregisterValidationInterface(CValidationInterface* callbacks);
 /** Unregister all subscribers */
@@ -36,14 +40,15 @@ void UnregisterAllValidationInterfaces();
 // notification is sent. These are useful for race-free cleanup, since
 // unregistration is nonblocking and can return before the last notification is
 // processed.
-/** Register subscriber */
-void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks);
+/** Register subscriber, see RegisterValidationInterface */
+void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks, bool own_queue = false);
 /** Unregister subscriber */
 void UnregisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks);
 
 /**
  * Pushes a function to callback onto the notification queue, guaranteeing any
  * callbacks generated prior to now are finished when the function is called.
+ * func runs on the thread of the last subscriber queue to reach it.
  *
  * Be very careful blocking on func to be called if any locks are held -
  * validation interface clients may not be able to make progress as they often
@@ -75,7 +80,8 @@ void SyncWithValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main);
  * UpdatedBlockTip() callback may depend on an operation performed in
  * the BlockConnected() callback without worrying about explicit
  * synchronization. No ordering should be assumed across
- * ValidationInterface() subscribers.
+ * ValidationInterface() subscribers, subscribers registered with
+ * own_queue may run concurrently with each other and the shared queue.
  */
 class CValidationInterface {
 protected:
@@ -178,6 +184,8 @@ protected:
 
     virtual void TransactionAddedToWallet(const std::string &sWalletName, const CTransactionRef& tx) {};
     virtual void NewSecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash) {};
+    /** Notifies listeners when queued paid messages have been funded by txid */
+    virtual void SecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids) {};
     virtual void LeavingIBD() {};
 
     friend class CMainSignals;
@@ -189,17 +197,18 @@ class CMainSignals {
 private:
     std::unique_ptr<MainSignalsImpl> m_internals;
 
-    friend void ::RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface>);
+    friend void ::RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface>, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
 
 public:
-    /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
-    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Register a CScheduler to give callbacks which should run in the background (may only be called once)
+     *  Subscriber queues run on a pool of parallel_threads, or on scheduler if 0 */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler, int parallel_threads = 0);
     /** Unregister a CScheduler to give callbacks which should run in the background - these callbacks will now be dropped! */
     void UnregisterBackgroundSignalScheduler();
-    /** Call any remaining callbacks on the calling thread */
+    /** Stop the subscriber queue threads and call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
     size_t CallbacksPending();
@@ -217,6 +226,7 @@ public:
     /** Particl */
     void TransactionAddedToWallet(const std::string &sWalletName, const CTransactionRef& tx);
     void NewSecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash);
+    void SecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids);
     void LeavingIBD();
 };
 
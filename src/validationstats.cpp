@@ -0,0 +1,97 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <validationstats.h>
+
+#include <util/time.h>
+
+BlockValidationStatsStore g_block_validation_stats;
+
+const char *GetBlockValidationStatName(BlockValidationStat stat)
+{
+    switch (stat) {
+        case BVS_ANON_INPUTS: return "anoninputs";
+        case BVS_RING_MEMBERS_READ: return "ringmembersread";
+        case BVS_RING_MEMBERS_READ_US: return "ringmembersread_us";
+        case BVS_KEY_IMAGE_LOOKUPS: return "keyimagelookups";
+        case BVS_KEY_IMAGE_LOOKUP_US: return "keyimagelookup_us";
+        case BVS_MLSAGS_VERIFIED: return "mlsagsverified";
+        case BVS_MLSAG_US: return "mlsag_us";
+        case BVS_RANGEPROOFS_VERIFIED: return "rangeproofsverified";
+        case BVS_RANGEPROOF_US: return "rangeproof_us";
+        case BVS_RCT_INDEX_WRITES: return "rctindexwrites";
+        case BVS_RCT_INDEX_WRITE_US: return "rctindexwrite_us";
+        case BVS_INSIGHT_INDEX_WRITES: return "insightindexwrites";
+        case BVS_INSIGHT_INDEX_WRITE_US: return "insightindexwrite_us";
+        case BVS_COINSTAKE_CHECK_US: return "coinstakecheck_us";
+        case BVS_SMSG_FUNDING_TXNS: return "smsgfundingtxns";
+        case BVS_SMSG_FUNDING_US: return "smsgfunding_us";
+        case BVS_CONNECT_BLOCK_US: return "connectblock_us";
+        case BVS_MAX: break;
+    }
+    return "unknown";
+}
+
+void BlockValidationStats::AddTiming(BlockValidationStat count, BlockValidationStat time_us, int64_t start_us)
+{
+    Add(count, 1);
+    Add(time_us, GetTimeMicros() - start_us);
+}
+
+void BlockValidationStats::Reset()
+{
+    for (auto &v : m_values) {
+        v = 0;
+    }
+    m_height = -1;
+}
+
+void BlockValidationStatsStore::SetMaxBlocks(size_t max_blocks)
+{
+    LOCK(m_mutex);
+    m_max_blocks = max_blocks;
+    while (m_order.size() > max_blocks) {
+        m_stats.erase(m_order.front());
+        m_order.pop_front();
+    }
+}
+
+std::shared_ptr<BlockValidationStats> BlockValidationStatsStore::Get(const uint256 &block_hash, bool connecting)
+{
+    if (!IsEnabled()) {
+        return nullptr;
+    }
+    LOCK(m_mutex);
+    auto it = m_stats.find(block_hash);
+    if (it != m_stats.end()) {
+        if (it->second->m_height < 0) {
+            return it->second;
+        }
+        if (!connecting) {
+            return nullptr;
+        }
+        // Reconnecting after a reorg, count the work again
+        it->second->Reset();
+        return it->second;
+    }
+
+    while (!m_order.empty() && m_order.size() >= m_max_blocks) {
+        m_stats.erase(m_order.front());
+        m_order.pop_front();
+    }
+    auto stats = std::make_shared<BlockValidationStats>();
+    m_stats.emplace(block_hash, stats);
+    m_order.push_back(block_hash);
+    return stats;
+}
+
+std::shared_ptr<const BlockValidationStats> BlockValidationStatsStore::Find(const uint256 &block_hash) const
+{
+    LOCK(m_mutex);
+    auto it = m_stats.find(block_hash);
+    if (it == m_stats.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
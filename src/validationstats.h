@@ -0,0 +1,98 @@
+// Copyright (c) 2022 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_VALIDATIONSTATS_H
+#define PARTICL_VALIDATIONSTATS_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Default for -blockvalidationstats, 0 disables collecting the stats */
+static const unsigned int DEFAULT_BLOCK_VALIDATION_STATS = 0;
+
+/** Particl specific validation work counted per block, times are in microseconds */
+enum BlockValidationStat : size_t {
+    BVS_ANON_INPUTS,
+    BVS_RING_MEMBERS_READ,
+    BVS_RING_MEMBERS_READ_US,
+    BVS_KEY_IMAGE_LOOKUPS,
+    BVS_KEY_IMAGE_LOOKUP_US,
+    BVS_MLSAGS_VERIFIED,
+    BVS_MLSAG_US,
+    BVS_RANGEPROOFS_VERIFIED,
+    BVS_RANGEPROOF_US,
+    BVS_RCT_INDEX_WRITES,
+    BVS_RCT_INDEX_WRITE_US,
+    BVS_INSIGHT_INDEX_WRITES,
+    BVS_INSIGHT_INDEX_WRITE_US,
+    BVS_COINSTAKE_CHECK_US,
+    BVS_SMSG_FUNDING_TXNS,
+    BVS_SMSG_FUNDING_US,
+    BVS_CONNECT_BLOCK_US,
+    BVS_MAX,
+};
+
+/** Name of the stat in getblockvalidationstats */
+const char *GetBlockValidationStatName(BlockValidationStat stat);
+
+/** Counters of one block, may be updated from the script check threads */
+class BlockValidationStats
+{
+public:
+    void Add(BlockValidationStat stat, int64_t value)
+    {
+        m_values[stat].fetch_add(value, std::memory_order_relaxed);
+    }
+    /** Add one to count and the time since start_us to time_us */
+    void AddTiming(BlockValidationStat count, BlockValidationStat time_us, int64_t start_us);
+    int64_t Get(BlockValidationStat stat) const
+    {
+        return m_values[stat].load(std::memory_order_relaxed);
+    }
+    void Reset();
+
+    std::atomic<int> m_height{-1};
+
+private:
+    std::array<std::atomic<int64_t>, BVS_MAX> m_values{};
+};
+
+/**
+ * Stats of the most recently validated blocks, see -blockvalidationstats.
+ *
+ * Blocks are checked before they are connected, CheckBlock and ConnectTip
+ * add to the same entry. Entries of blocks which are never connected age
+ * out with the rest.
+ */
+class BlockValidationStatsStore
+{
+public:
+    void SetMaxBlocks(size_t max_blocks) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    bool IsEnabled() const { return m_max_blocks > 0; }
+
+    /**
+     * Return the entry of the block to add to, nullptr if disabled.
+     * An entry of a connected block is reset when connecting is set, else nullptr is returned.
+     */
+    std::shared_ptr<BlockValidationStats> Get(const uint256 &block_hash, bool connecting) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    std::shared_ptr<const BlockValidationStats> Find(const uint256 &block_hash) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    mutable Mutex m_mutex;
+    std::atomic<size_t> m_max_blocks{0};
+    std::map<uint256, std::shared_ptr<BlockValidationStats> > m_stats GUARDED_BY(m_mutex);
+    std::deque<uint256> m_order GUARDED_BY(m_mutex);
+};
+
+extern BlockValidationStatsStore g_block_validation_stats;
+
+#endif // PARTICL_VALIDATIONSTATS_H
@@ -4,6 +4,7 @@
 
 #include <wallet/hdwallet.h>
 
+#include <crypto/aes.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
 #include <crypto/sha256.h>
@@ -12,13 +13,17 @@
 #include <validation.h>
 #include <consensus/validation.h>
 #include <consensus/merkle.h>
+#include <core_memusage.h>
 #include <smsg/smessage.h>
 #include <key/crypter.h>
 #include <timedata.h>
 #include <node/miner.h>
 #include <pos/kernel.h>
 #include <pos/miner.h>
+#include <pos/stakingperf.h>
 #include <util/moneystr.h>
+#include <util/time.h>
+#include <util/trace.h>
 #include <util/translation.h>
 #include <script/script.h>
 #include <script/standard.h>
@@ -46,6 +51,9 @@
 #include <secp256k1_mlsag.h>
 
 #include <algorithm>
+#include <functional>
+#include <future>
+#include <ostream>
 #include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -85,6 +93,118 @@ static bool ExtractStealthPrefix(const std::vector<uint8_t> &vData, uint32_t &pr
     return false;
 }
 
+/** Runs fn(worker, i) for i in [0, n), each of up to max_workers threads takes every max_workers'th i */
+static bool ParallelFor(size_t n, size_t max_workers, const std::function<bool(size_t, size_t)> &fn)
+{
+    size_t num_workers = std::min(n, max_workers);
+    if (num_workers < 2) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!fn(0, i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::future<bool> > workers;
+    for (size_t w = 0; w < num_workers; ++w) {
+        workers.emplace_back(std::async(std::launch::async, [&fn, n, num_workers, w] {
+            bool rv = true;
+            for (size_t i = w; i < n; i += num_workers) {
+                rv &= fn(w, i);
+            }
+            return rv;
+        }));
+    }
+    bool rv = true;
+    for (auto &worker : workers) {
+        rv &= worker.get();
+    }
+    return rv;
+}
+
+//! Records each wallet load worker should decode at least, below this threads cost more than they save
+static constexpr size_t MIN_RECORDS_PER_LOAD_WORKER = 1000;
+//! Stealth addresses each NewStealthKeysFromAccount worker should derive at least
+static constexpr size_t MIN_STEALTH_KEYS_PER_WORKER = 8;
+//! Stealth recipients each ExpandTempRecipients worker should find shared secrets for at least
+static constexpr size_t MIN_STEALTH_RECIPIENTS_PER_WORKER = 8;
+//! Key images each WritePendingKeyImages worker should compute at least
+static constexpr size_t MIN_KEY_IMAGES_PER_WORKER = 32;
+//! Serialized size of a blinded change output excluding the rangeproof: version, commitment, ephemeral pubkey and p2pkh script
+static constexpr size_t CT_OUTPUT_BASE_SIZE = 97;
+//! Serialized size of an anon change output excluding the rangeproof: version, pubkey, commitment and ephemeral pubkey
+static constexpr size_t RINGCT_OUTPUT_BASE_SIZE = 104;
+//! Virtual size of an input spending a blinded p2pkh output
+static constexpr size_t CT_INPUT_VSIZE = 68;
+//! Blocks between passes of ArchiveSpentRecords, records are also archived when the wallet loads
+static constexpr int ARCHIVE_RECORDS_INTERVAL = 100;
+//! Outputs received while locked each unlock worker should process at least
+static constexpr size_t MIN_LOCKED_OUTPUTS_PER_WORKER = 8;
+//! Outputs received while locked processed per batch on unlock, at most REWOUND_OUTPUT_CACHE_SIZE
+static constexpr size_t LOCKED_OUTPUTS_BATCH_SIZE = 1000;
+
+static bool ParseBlindOutputScanData(const CTxOutBase *txout, CBlindOutputScanData &data)
+{
+    const std::vector<uint8_t> *vData = nullptr;
+    if (txout->IsType(OUTPUT_CT)) {
+        const CTxOutCT *ctout = (CTxOutCT*) txout;
+        if (!ExtractDestination(ctout->scriptPubKey, data.address)) {
+            data.address = CNoDestination();
+        }
+        vData = &ctout->vData;
+    } else
+    if (txout->IsType(OUTPUT_RINGCT)) {
+        const CTxOutRingCT *rctout = (CTxOutRingCT*) txout;
+        data.address = PKHash(rctout->pk.GetID());
+        vData = &rctout->vData;
+    } else {
+        return false;
+    }
+    if (vData->size() >= 33) {
+        data.ephem_pubkey.assign(vData->begin(), vData->begin() + 33);
+        data.have_prefix = ExtractStealthPrefix(*vData, data.prefix);
+    }
+    return true;
+}
+
+//! Number of parsed blocks kept, each wallet is notified of the same block in turn
+static constexpr size_t BLOCK_SCAN_CACHE_SIZE = 4;
+static Mutex g_block_scan_mutex;
+static std::vector<std::pair<uint256, std::shared_ptr<const BlockScanData> > > g_block_scan_cache GUARDED_BY(g_block_scan_mutex);
+
+std::shared_ptr<const BlockScanData> GetBlockScanData(const CBlock &block)
+{
+    const uint256 block_hash = block.GetHash();
+    {
+        LOCK(g_block_scan_mutex);
+        for (const auto &entry : g_block_scan_cache) {
+            if (entry.first == block_hash) {
+                return entry.second;
+            }
+        }
+    }
+
+    // Parsed without the lock, rescan threads prepare different blocks concurrently
+    auto data = std::make_shared<BlockScanData>();
+    for (const auto &tx : block.vtx) {
+        const uint256 &txid = tx->GetHash();
+        for (size_t n = 0; n < tx->vpout.size(); ++n) {
+            CBlindOutputScanData output;
+            if (ParseBlindOutputScanData(tx->vpout[n].get(), output)) {
+                data->emplace(COutPoint(txid, n), std::move(output));
+            }
+        }
+    }
+
+    LOCK(g_block_scan_mutex);
+    if (g_block_scan_cache.size() >= BLOCK_SCAN_CACHE_SIZE) {
+        g_block_scan_cache.erase(g_block_scan_cache.begin());
+    }
+    g_block_scan_cache.emplace_back(block_hash, data);
+    return data;
+}
+
 int CHDWallet::Finalise()
 {
     LOCK(cs_wallet);
@@ -129,11 +249,17 @@ void CHDWallet::AddOptions(ArgsManager& argsman)
     argsman.AddArg("-defaultlookaheadsize=<n>", strprintf("Number of keys to load into the lookahead pool per chain. (default: %u)", DEFAULT_LOOKAHEAD_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
     argsman.AddArg("-stealthv1lookaheadsize=<n>", strprintf("Number of V1 stealth keys to look ahead during a rescan. (default: %u)", DEFAULT_STEALTH_LOOKAHEAD_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
     argsman.AddArg("-stealthv2lookaheadsize=<n>", strprintf("Number of V2 stealth keys to look ahead during a rescan. (default: %u)", DEFAULT_STEALTH_LOOKAHEAD_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
+    argsman.AddArg("-rescanthreads=<n>", strprintf("Number of blocks to read and test against the stealth keys in parallel during a rescan, 0 to disable. (default: %u)", DEFAULT_RESCAN_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
+    argsman.AddArg("-recordssnapshot", strprintf("Write transaction records to a snapshot file next to the wallet db on shutdown, read at the next load if the db was not written to since. (default: %s)", DEFAULT_RECORDS_SNAPSHOT ? "true" : "false"), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
+    argsman.AddArg("-compactstoredtxns", strprintf("Store confirmed blinded transactions without their rangeproofs, full transactions are read from the block data when needed. Ignored on pruned nodes. (default: %s)", DEFAULT_COMPACT_STORED_TXNS ? "true" : "false"), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
+    argsman.AddArg("-lazykeypacks", strprintf("Keep only an index of saved account keys in memory and read their key packs from the wallet db when needed. (default: %s)", DEFAULT_LAZY_KEY_PACKS ? "true" : "false"), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
+    argsman.AddArg("-keypackcachesize=<n>", strprintf("Number of keys read from key packs kept in memory per account with -lazykeypacks. (default: %u)", DEFAULT_KEY_PACK_CACHE_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
     argsman.AddArg("-extkeysaveancestors", strprintf("On saving a key from the lookahead pool, save all unsaved keys leading up to it too. (default: %s)", "true"), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
+    argsman.AddArg("-checkbalancecache", strprintf("Recompute the wallet balances on every call and compare against the cached balances. (default: %u)", DEFAULT_CHECK_BALANCE_CACHE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::PART_WALLET);
     argsman.AddArg("-createdefaultmasterkey", strprintf("Generate a random master key and main account if no master key exists. (default: %s)", "false"), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
 
     argsman.AddArg("-staking", "Stake your coins to support network and gain reward (default: true)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
-    argsman.AddArg("-stakingthreads", "Number of threads to start for staking, max 1 per active wallet, will divide wallets evenly between threads (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
+    argsman.AddArg("-stakingthreads", strprintf("Number of threads to start for staking, max 1 per active wallet, wallets are shared between threads, 0 for one per core (default: %d)", DEFAULT_STAKING_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
     argsman.AddArg("-stakethreadconddelayms", "Number of milliseconds to delay staking for on error condition (default: 60000)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
     argsman.AddArg("-minstakeinterval=<n>", "Minimum time in seconds between successful stakes (default: 0)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
     argsman.AddArg("-minersleep=<n>", "Milliseconds between stake attempts. Lowering this param will not result in more stakes. (default: 500)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
@@ -260,6 +386,7 @@ bool CHDWallet::ProcessStakingSettings(std::string &sError)
         nWalletTreasuryFundCedePercent = 100;
     }
 
+    ClearCachedBalances(); // minstakeablevalue may have changed
     return true;
 };
 
@@ -270,6 +397,7 @@ bool CHDWallet::ProcessWalletSettings(std::string &sError)
     // Set defaults
     m_collapse_spent_mode = 0;
     m_min_collapse_depth = 3;
+    m_archive_record_depth = 0;
     m_mixin_selection_mode_default = MIXIN_SEL_RECENT;
     m_min_owned_value = 0;
 
@@ -287,6 +415,12 @@ bool CHDWallet::ProcessWalletSettings(std::string &sError)
                 AppendError(sError, "\"mode\" not integer.");
             }
         }
+        if (!json["recorddepth"].isNull()) {
+            try { m_archive_record_depth = json["recorddepth"].getInt<int>();
+            } catch (std::exception &e) {
+                AppendError(sError, "\"recorddepth\" not integer.");
+            }
+        }
     }
 
     if (GetSetting("anonoptions", json)) {
@@ -328,6 +462,69 @@ bool CHDWallet::ProcessWalletSettings(std::string &sError)
         m_min_collapse_depth = 2;
     }
 
+    {
+        LOCK(cs_wallet);
+        // Keep the progress, reset the settings
+        CConsolidationState defaults;
+        CConsolidationState &cs = m_consolidation;
+        cs.enabled = defaults.enabled;
+        cs.blind = defaults.blind;
+        cs.anon = defaults.anon;
+        cs.max_value = defaults.max_value;
+        cs.min_outputs = defaults.min_outputs;
+        cs.max_inputs = defaults.max_inputs;
+        cs.ring_size = defaults.ring_size;
+        cs.min_depth = defaults.min_depth;
+        cs.max_feerate = defaults.max_feerate;
+        if (GetSetting("consolidation", json)) {
+            try {
+                if (!json["enabled"].isNull()) {
+                    cs.enabled = json["enabled"].get_bool();
+                }
+                if (!json["blind"].isNull()) {
+                    cs.blind = json["blind"].get_bool();
+                }
+                if (!json["anon"].isNull()) {
+                    cs.anon = json["anon"].get_bool();
+                }
+                if (!json["maxvalue"].isNull()) {
+                    cs.max_value = AmountFromValue(json["maxvalue"]);
+                }
+                if (!json["minoutputs"].isNull()) {
+                    cs.min_outputs = json["minoutputs"].getInt<int>();
+                }
+                if (!json["maxinputs"].isNull()) {
+                    cs.max_inputs = json["maxinputs"].getInt<int>();
+                }
+                if (!json["ringsize"].isNull()) {
+                    cs.ring_size = json["ringsize"].getInt<int>();
+                }
+                if (!json["mindepth"].isNull()) {
+                    cs.min_depth = json["mindepth"].getInt<int>();
+                }
+                if (!json["maxfeerate"].isNull()) {
+                    cs.max_feerate = CFeeRate(AmountFromValue(json["maxfeerate"]));
+                }
+            } catch (std::exception &e) {
+                AppendError(sError, strprintf("consolidation: %s", e.what()));
+                cs.enabled = false;
+            }
+        }
+        if (cs.max_inputs < 2 || cs.max_inputs > MAX_ANON_INPUTS * 4) {
+            AppendError(sError, strprintf("\"maxinputs\" must be between 2 and %d.", MAX_ANON_INPUTS * 4));
+            cs.max_inputs = defaults.max_inputs;
+        }
+        if (cs.ring_size > MAX_RINGSIZE) {
+            AppendError(sError, strprintf("\"ringsize\" must be at most %d.", MAX_RINGSIZE));
+            cs.ring_size = defaults.ring_size;
+        }
+        if (cs.min_depth < 1) {
+            AppendError(sError, "\"mindepth\" must be >= 1.");
+            cs.min_depth = defaults.min_depth;
+        }
+        cs.next_run = 0;
+    }
+
     return true;
 };
 
@@ -386,7 +583,7 @@ bool CHDWallet::UnsetWalletFlagRV(CHDWalletDB *pwdb, uint64_t flag)
     return pwdb->WriteWalletFlags(m_wallet_flags);
 }
 
-static void AppendKey(const CHDWallet *pw, CKey &key, uint32_t nChild, UniValue &derivedKeys) EXCLUSIVE_LOCKS_REQUIRED(pw->cs_wallet)
+static UniValue DumpKeyJson(const CHDWallet *pw, CKey &key, uint32_t nChild) EXCLUSIVE_LOCKS_REQUIRED(pw->cs_wallet)
 {
     UniValue keyobj(UniValue::VOBJ);
 
@@ -413,14 +610,58 @@ static void AppendKey(const CHDWallet *pw, CKey &key, uint32_t nChild, UniValue
             keyobj.pushKV("destdata", objDestData);
         }
     }
-    derivedKeys.push_back(keyobj);
-    return;
+    return keyobj;
+};
+
+/** Writes the elements of a JSON array one per line as they are produced */
+class JsonArrayWriter
+{
+public:
+    JsonArrayWriter(std::ostream &os, const std::string &key) : m_os(os)
+    {
+        m_os << UniValue(key).write() << ":[";
+    }
+    /** Start the next element, for elements written in parts */
+    std::ostream &next()
+    {
+        m_os << (m_empty ? "\n" : ",\n");
+        m_empty = false;
+        return m_os;
+    }
+    void push_back(const UniValue &v)
+    {
+        next() << v.write();
+    }
+    void close()
+    {
+        m_os << (m_empty ? "]" : "\n]");
+    }
+private:
+    std::ostream &m_os;
+    bool m_empty = true;
 };
 
+/** Write the members of obj without the closing brace, more members can follow */
+static void WriteOpenObject(std::ostream &os, const UniValue &obj, const std::set<std::string> &skip = {})
+{
+    os << "{";
+    bool first = true;
+    for (size_t i = 0; i < obj.size(); ++i) {
+        if (skip.count(obj.getKeys()[i])) {
+            continue;
+        }
+        os << (first ? "" : ",") << UniValue(obj.getKeys()[i]).write() << ":" << obj.getValues()[i].write();
+        first = false;
+    }
+    if (!first) {
+        os << ",";
+    }
+}
+
 extern int ListLooseExtKeys(CHDWallet *pwallet, int nShowKeys, UniValue &ret, size_t &nKeys);
 extern int ListAccountExtKeys(CHDWallet *pwallet, int nShowKeys, UniValue &ret, size_t &nKeys);
 extern int ListLooseStealthAddresses(UniValue &arr, const CHDWallet *pwallet, bool fShowSecrets, bool fAddressBookInfo, bool show_pubkeys=false, bool bech32=false);
-bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
+bool CHDWallet::DumpJson(std::ostream &os, std::string &sError)
 {
     WalletLogPrintf("Dumping wallet to JSON.\n");
 
@@ -432,21 +673,29 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
 
     CHDWalletDB wdb(*m_database);
 
+    // Only the account metadata is held, derived and stealth keys are written as they are read
     size_t nKeys, nAcc;
     UniValue extkeys(UniValue::VARR);
     UniValue extaccs(UniValue::VARR);
     ListLooseExtKeys(this, 2, extkeys, nKeys);
     ListAccountExtKeys(this, 3, extaccs, nAcc);
 
+    os << "{" << UniValue("loose_extkeys").write() << ":" << extkeys.write() << ",\n";
+    JsonArrayWriter accounts(os, "accounts");
+
     CExtKey58 eKey58;
     for (size_t k = 0; k < extaccs.size(); ++k) {
         UniValue &acc = extaccs.get(k);
         size_t nChains = acc["chains"].size();
+        std::string acc_error;
+
+        WriteOpenObject(accounts.next(), acc, {"chains"});
+        JsonArrayWriter chains(os, "chains");
 
         std::vector<CExtKeyPair> vChains;
         vChains.resize(nChains);
         for (size_t c = 0; c < nChains; ++c) {
-            UniValue &chain = acc.get("chains").get(c);
+            const UniValue &chain = acc["chains"][c];
 
             const std::string &sEvkey = chain["evkey"].get_str();
 
@@ -471,33 +720,38 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
                 fIsStealth = true;
             }
 
-            UniValue derivedKeys(UniValue::VARR);
-            UniValue derivedKeysH(UniValue::VARR);
-
-
             if (fIsStealth) {
                 // Dump from pack instead
+                chains.push_back(chain);
             } else {
+                WriteOpenObject(chains.next(), chain);
+                JsonArrayWriter derivedKeys(os, "derived_keys");
                 CKey key;
                 uint32_t nChild = 0;
                 for (uint32_t k = 0; k < nDerives; ++k) {
                     if (kp.Derive(key, nChild)) {
-                        AppendKey(this, key, nChild, derivedKeys);
+                        derivedKeys.push_back(DumpKeyJson(this, key, nChild));
                     }
                     nChild++;
                 }
-                chain.pushKV("derived_keys", derivedKeys);
+                derivedKeys.close();
+                os << ",";
 
+                JsonArrayWriter derivedKeysH(os, "derived_keys_hardened");
                 for (uint32_t k = 0; k < nDerivesH; ++k) {
                     nChild = k;
                     SetHardenedBit(nChild);
                     if (kp.Derive(key, nChild)) {
-                        AppendKey(this, key, nChild, derivedKeysH);
+                        derivedKeysH.push_back(DumpKeyJson(this, key, nChild));
                     }
                 }
-                chain.pushKV("derived_keys_hardened", derivedKeysH);
+                derivedKeysH.close();
+                os << "}";
             }
         }
+        chains.close();
+        os << ",";
+
         // Read stealth keys from packs to keep metadata such as prefix
         size_t nPackStealthAddrs = 0;
         size_t nPackStealthKeys = 0;
@@ -514,13 +768,13 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
 
         if (!accIdAddr.IsValid(CChainParams::EXT_ACC_HASH)) {
             WalletLogPrintf("%s: ERROR - Invalid account id %s\n", __func__, acc["id"].get_str());
-            acc.pushKV("ERROR", "Invalid account id");
+            os << UniValue("ERROR").write() << ":" << UniValue("Invalid account id").write() << "}";
             continue;
         }
 
         accIdAddr.GetKeyID(idAcc, CChainParams::EXT_ACC_HASH);
         std::map<CKeyID, std::pair<CKey, std::string> > mapStealthKeySpend;
-        UniValue stealthAddresses(UniValue::VARR);
+        JsonArrayWriter stealthAddresses(os, "stealth_addresses");
         std::vector<CEKAStealthKeyPack> aksPak;
         for (uint32_t i = 0; i <= nPackStealthAddrs; ++i) {
             if (!wdb.ReadExtStealthKeyPack(idAcc, i, aksPak)) {
@@ -544,7 +798,7 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
                 size_t p = sxPacked.aks.akSpend.nParent;
                 if (p >= vChains.size()+1) {
                     WalletLogPrintf("%s: ERROR - chain out of range %d\n", __func__, p);
-                    acc.pushKV("ERROR", "Invalid chain offset.");
+                    acc_error = "Invalid chain offset.";
                     continue;
                 }
 
@@ -557,7 +811,7 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
                     sxAddr.pushKV("spend_priv", CBitcoinSecret(kSpend).ToString());
                 } else {
                     WalletLogPrintf("%s: ERROR - Derive failed %u\n", __func__, nChild);
-                    acc.pushKV("ERROR", "Derive spend key failed.");
+                    acc_error = "Derive spend key failed.";
                 }
                 mapStealthKeySpend[sxPacked.id] = std::make_pair(kSpend, sxStr);
 
@@ -590,10 +844,10 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
                 stealthAddresses.push_back(sxAddr);
             }
         }
+        stealthAddresses.close();
+        os << ",";
 
-        acc.pushKV("stealth_addresses", stealthAddresses);
-
-        UniValue stealthReceivedKeys(UniValue::VARR);
+        JsonArrayWriter stealthReceivedKeys(os, "keys_received_on_stealth_addresses");
         std::vector<CEKASCKeyPack> asckPak;
         for (uint32_t i = 0; i <= nPackStealthKeys; ++i) {
             if (!wdb.ReadExtStealthKeyChildPack(idAcc, i, asckPak)) {
@@ -609,13 +863,13 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
                 std::map<CKeyID, std::pair<CKey, std::string> >::const_iterator mi;
                 if ((mi = mapStealthKeySpend.find(keyPacked.asck.idStealthKey)) == mapStealthKeySpend.end()) {
                     WalletLogPrintf("%s: ERROR - Unknown stealth key %s\n", __func__, HexStr(keyPacked.asck.idStealthKey));
-                    acc.pushKV("ERROR", "Unknown stealth key.");
+                    acc_error = "Unknown stealth key.";
                 } else {
                     obj.pushKV("stealth_address", mi->second.second);
 
                     if (0 != StealthSharedToSecretSpend(keyPacked.asck.sShared, mi->second.first, kOut)) {
                         WalletLogPrintf("%s: ERROR - StealthSharedToSecretSpend failed\n", __func__);
-                        acc.pushKV("ERROR", "StealthSharedToSecretSpend failed.");
+                        acc_error = "StealthSharedToSecretSpend failed.";
                     } else {
                         obj.pushKV("privkey", CBitcoinSecret(kOut).ToString());
                     }
@@ -623,19 +877,20 @@ bool CHDWallet::DumpJson(UniValue &rv, std::string &sError)
                 stealthReceivedKeys.push_back(obj);
             }
         }
+        stealthReceivedKeys.close();
 
-        acc.pushKV("keys_received_on_stealth_addresses", stealthReceivedKeys);
+        if (!acc_error.empty()) {
+            os << "," << UniValue("ERROR").write() << ":" << UniValue(acc_error).write();
+        }
+        os << "}";
     }
-
-
-    rv.pushKV("loose_extkeys", extkeys);
-    rv.pushKV("accounts", extaccs);
+    accounts.close();
 
     UniValue stealthAddresses(UniValue::VARR);
     ListLooseStealthAddresses(stealthAddresses, this, true, true);
-    rv.pushKV("imported_stealth_addresses", stealthAddresses);
+    os << ",\n" << UniValue("imported_stealth_addresses").write() << ":" << stealthAddresses.write() << "}";
 
-    return true;
+    return os.good() ? true : wserrorN(false, sError, __func__, "Write failed.");
 };
 
 bool CHDWallet::LoadJson(const UniValue &inj, std::string &sError)
@@ -660,7 +915,7 @@ bool CHDWallet::LoadAddressBook(CHDWalletDB *pwdb)
     assert(pwdb);
     LOCK(cs_wallet);
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = pwdb->GetCursor())) {
         throw std::runtime_error(strprintf("%s: cannot create DB cursor", __func__).c_str());
     }
@@ -673,7 +928,7 @@ bool CHDWallet::LoadAddressBook(CHDWalletDB *pwdb)
 
     unsigned int fFlags = DB_SET_RANGE;
     ssKey << sPrefix;
-    while (pwdb->ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (pwdb->ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
         ssKey >> strType;
         if (strType != sPrefix) {
@@ -698,7 +953,7 @@ bool CHDWallet::LoadAddressBook(CHDWalletDB *pwdb)
     }
 
     LogPrint(BCLog::HDWALLET, "%s Loaded %d addresses.\n", GetDisplayName(), nCount);
-    pcursor->close();
+    pcursor.reset();
 
     return true;
 };
@@ -754,40 +1009,243 @@ bool CHDWallet::GetVote(int nHeight, uint32_t &token)
     return false;
 };
 
-bool CHDWallet::LoadTxRecords(CHDWalletDB *pwdb)
+//! Records snapshot file: magic, version, stamp, count, txid column, size column, serialised records, sha256d of all before
+static constexpr uint32_t RECORDS_SNAPSHOT_MAGIC = 0x70736e70;
+static constexpr uint32_t RECORDS_SNAPSHOT_VERSION = 1;
+
+static fs::path GetRecordsSnapshotPath(WalletDatabase &database)
 {
-    LogPrint(BCLog::HDWALLET, "Loading transaction records for %s.\n", GetName());
+    return fs::PathFromString(database.Filename() + ".snapshot");
+}
 
-    assert(pwdb);
+bool CHDWallet::ReadRecordsSnapshot(CHDWalletDB *pwdb, std::vector<std::pair<uint256, CDataStream> > &vRaw)
+{
+    AssertLockHeld(cs_wallet);
+
+    // The stamp is removed on every load, a snapshot is only valid until the wallet db is written to again
+    int32_t nStamp = 0;
+    if (!pwdb->ReadFlag("records_snapshot", nStamp)) {
+        return false;
+    }
+    pwdb->EraseFlag("records_snapshot");
+
+    fs::path path = GetRecordsSnapshotPath(GetDatabase());
+    if (!m_records_snapshot) {
+        fs::remove(path);
+        return false;
+    }
+
+    std::vector<uint8_t> vData;
+    FILE *file = fsbridge::fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t buf[1 << 16];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), file)) > 0) {
+        vData.insert(vData.end(), buf, buf + nRead);
+    }
+    fclose(file);
+    fs::remove(path);
+
+    if (vData.size() < 32 + 20 ||
+        Hash(Span<const uint8_t>(vData.data(), vData.size() - 32)) != uint256(vData.data() + vData.size() - 32, 32)) {
+        WalletLogPrintf("Warning: %s: Invalid records snapshot.\n", __func__);
+        return false;
+    }
+
+    try {
+        CDataStream ss(Span<const uint8_t>(vData.data(), vData.size() - 32), SER_DISK, CLIENT_VERSION);
+        uint32_t nMagic, nVersion;
+        int32_t nFileStamp;
+        uint64_t nRecords;
+        ss >> nMagic >> nVersion >> nFileStamp >> nRecords;
+        if (nMagic != RECORDS_SNAPSHOT_MAGIC || nVersion != RECORDS_SNAPSHOT_VERSION) {
+            WalletLogPrintf("Warning: %s: Unknown records snapshot version.\n", __func__);
+            return false;
+        }
+        if (nFileStamp != nStamp) {
+            WalletLogPrintf("%s: Records snapshot is stale.\n", __func__);
+            return false;
+        }
+        if (nRecords > ss.size() / (32 + 4)) {
+            throw std::ios_base::failure("bad record count");
+        }
+
+        std::vector<uint256> vHashes(nRecords);
+        std::vector<uint32_t> vSizes(nRecords);
+        for (auto &hash : vHashes) {
+            ss >> hash;
+        }
+        for (auto &size : vSizes) {
+            ss >> size;
+        }
+        vRaw.clear();
+        vRaw.reserve(nRecords);
+        for (size_t i = 0; i < nRecords; ++i) {
+            if (vSizes[i] > ss.size()) {
+                throw std::ios_base::failure("bad record size");
+            }
+            vRaw.emplace_back(vHashes[i], CDataStream(Span<const uint8_t>((const uint8_t*)ss.data(), vSizes[i]), SER_DISK, CLIENT_VERSION));
+            ss.ignore(vSizes[i]);
+        }
+    } catch (const std::exception &e) {
+        WalletLogPrintf("Warning: %s: Invalid records snapshot: %s.\n", __func__, e.what());
+        vRaw.clear();
+        return false;
+    }
+    return true;
+}
+
+bool CHDWallet::WriteRecordsSnapshot()
+{
     LOCK(cs_wallet);
 
-    Dbc *pcursor;
+    int32_t nStamp = (int32_t)GetRand<uint32_t>();
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << RECORDS_SNAPSHOT_MAGIC << RECORDS_SNAPSHOT_VERSION << nStamp << (uint64_t)mapRecords.size();
+    for (const auto &ri : mapRecords) {
+        ss << ri.first;
+    }
+    CDataStream ssRecords(SER_DISK, CLIENT_VERSION);
+    for (const auto &ri : mapRecords) {
+        size_t nBefore = ssRecords.size();
+        ssRecords << ri.second;
+        ss << (uint32_t)(ssRecords.size() - nBefore);
+    }
+    ss.write(MakeByteSpan(ssRecords));
+    ssRecords.clear();
+    ss << Hash(MakeUCharSpan(ss));
+
+    fs::path path = GetRecordsSnapshotPath(GetDatabase());
+    fs::path path_tmp = fs::PathFromString(fs::PathToString(path) + ".new");
+    FILE *file = fsbridge::fopen(path_tmp, "wb");
+    if (!file) {
+        return werror("%s: Cannot open %s.", __func__, fs::PathToString(path_tmp));
+    }
+    bool fOk = fwrite(ss.data(), 1, ss.size(), file) == ss.size() && FileCommit(file);
+    fclose(file);
+    if (!fOk || !RenameOver(path_tmp, path)) {
+        fs::remove(path_tmp);
+        return werror("%s: Cannot write %s.", __func__, fs::PathToString(path));
+    }
+
+    // Stamp last, a snapshot without a matching stamp in the db is ignored
+    if (!CHDWalletDB(GetDatabase()).WriteFlag("records_snapshot", nStamp)) {
+        return werror("%s: WriteFlag failed.", __func__);
+    }
+    WalletLogPrintf("Wrote %u transaction records to snapshot.\n", mapRecords.size());
+    return true;
+}
+
+bool CHDWallet::LoadAnonKeyImages(CHDWalletDB *pwdb)
+{
+    AssertLockHeld(cs_wallet);
+    m_anon_key_images.clear();
+
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = pwdb->GetCursor())) {
-        throw std::runtime_error(strprintf("%s: cannot create DB cursor", __func__).c_str());
+        return werror("%s: cannot create DB cursor", __func__);
     }
 
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
     CDataStream ssValue(SER_DISK, CLIENT_VERSION);
 
-    std::string strType, sPrefix = "rtx";
-    uint256 txhash;
+    std::string strType, sPrefix = "aki";
+    CCmpPubKey ki;
+    COutPoint op;
 
     unsigned int fFlags = DB_SET_RANGE;
     ssKey << sPrefix;
-    while (pwdb->ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (pwdb->ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
         ssKey >> strType;
         if (strType != sPrefix) {
             break;
         }
+        ssKey >> ki;
+        ssValue >> op;
+        m_anon_key_images.emplace_hint(m_anon_key_images.end(), ki, op);
+    }
 
-        ssKey >> txhash;
-        CTransactionRecord data;
-        ssValue >> data;
-        LoadToWallet(txhash, data);
+    LogPrint(BCLog::HDWALLET, "Loaded %u anon key images for %s.\n", m_anon_key_images.size(), GetName());
+    return true;
+};
+
+bool CHDWallet::LoadTxRecords(CHDWalletDB *pwdb)
+{
+    LogPrint(BCLog::HDWALLET, "Loading transaction records for %s.\n", GetName());
+
+    assert(pwdb);
+    LOCK(cs_wallet);
+
+    if (!LoadAnonKeyImages(pwdb)) {
+        throw std::runtime_error(strprintf("%s: cannot read anon key images", __func__).c_str());
+    }
+
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
+    if (!(pcursor = pwdb->GetCursor())) {
+        throw std::runtime_error(strprintf("%s: cannot create DB cursor", __func__).c_str());
     }
 
-    pcursor->close();
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+
+    std::string strType, sPrefix = "rtx";
+    uint256 txhash;
+
+    // The cursor only collects the serialised records, they are decoded by a pool of workers
+    int64_t nTime = GetTimeMillis();
+    std::vector<std::pair<uint256, CDataStream> > vRaw;
+    if (ReadRecordsSnapshot(pwdb, vRaw)) {
+        WalletLogPrintf("Read %u transaction records from snapshot.\n", vRaw.size());
+    } else {
+        unsigned int fFlags = DB_SET_RANGE;
+        ssKey << sPrefix;
+        while (pwdb->ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
+            fFlags = DB_NEXT;
+            ssKey >> strType;
+            if (strType != sPrefix) {
+                break;
+            }
+
+            ssKey >> txhash;
+            vRaw.emplace_back(txhash, ssValue);
+        }
+    }
+
+    pcursor.reset();
+    m_load_timings.records_read = GetTimeMillis() - nTime;
+
+    nTime = GetTimeMillis();
+    std::vector<CTransactionRecord> vRecords(vRaw.size());
+    std::vector<std::string> vErrors(vRaw.size());
+    size_t num_workers = std::min(vRaw.size() / MIN_RECORDS_PER_LOAD_WORKER + 1, (size_t) std::max(1, GetNumCores()));
+    bool decoded = ParallelFor(vRaw.size(), num_workers, [&](size_t w, size_t i) {
+        try {
+            vRaw[i].second >> vRecords[i];
+        } catch (const std::exception &e) {
+            vErrors[i] = e.what();
+            return false;
+        }
+        return true;
+    });
+    if (!decoded) {
+        for (size_t i = 0; i < vErrors.size(); ++i) {
+            if (!vErrors[i].empty()) {
+                throw std::runtime_error(strprintf("%s: cannot deserialize record %s: %s", __func__, vRaw[i].first.ToString(), vErrors[i]));
+            }
+        }
+    }
+    m_load_timings.records_decode = GetTimeMillis() - nTime;
+
+    // Insert in key order on this thread, as when reading one record at a time
+    nTime = GetTimeMillis();
+    for (size_t i = 0; i < vRaw.size(); ++i) {
+        LoadToWallet(vRaw[i].first, vRecords[i]);
+    }
+    vRaw.clear();
+    vRecords.clear();
 
     int32_t flag;
     if (!pwdb->ReadFlag("anon_vin_v2", flag)) {
@@ -804,7 +1262,7 @@ bool CHDWallet::LoadTxRecords(CHDWalletDB *pwdb)
                     *(ki.ncbegin()+32) = prevout.n;
 
                     COutPoint kiPrevout;
-                    if (!pwdb->ReadAnonKeyImage(ki, kiPrevout)) {
+                    if (!GetAnonKeyImageOutpoint(ki, kiPrevout)) {
                         WalletLogPrintf("Warning: Unknown keyimage %s.\n", HexStr(Span<const unsigned char>(ki.begin(), 33)));
                         continue;
                     }
@@ -843,7 +1301,10 @@ bool CHDWallet::LoadTxRecords(CHDWalletDB *pwdb)
         }
     }
 
-    WalletLogPrintf("mapRecords.size() = %u\n", mapRecords.size());
+    m_load_timings.records_insert = GetTimeMillis() - nTime;
+
+    WalletLogPrintf("mapRecords.size() = %u, read %dms, decode %dms (%u workers), insert %dms\n", mapRecords.size(),
+        m_load_timings.records_read, m_load_timings.records_decode, num_workers, m_load_timings.records_insert);
 
     return true;
 };
@@ -1032,6 +1493,7 @@ bool CHDWallet::Unlock(const SecureString &strWalletPassphrase, bool accept_no_k
 
         ProcessLockedStealthOutputs();
         ProcessLockedBlindedOutputs();
+        ResetTxnCaches(); // Values of outputs received while locked are known now
     }
     smsgModule.WalletUnlocked(this);
 
@@ -1207,7 +1669,8 @@ bool CHDWallet::GetTransaction(const uint256 &txhash, CTransactionRef &tx) const
     const auto mri = mapRecords.find(txhash);
     if (mri != mapRecords.end()) {
         CStoredTransaction stx;
-        if (!CHDWalletDB(*m_database).ReadStoredTx(txhash, stx)) {
+        CHDWalletDB wdb(*m_database);
+        if (!GetStoredTx(wdb, txhash, stx)) {
             WalletLogPrintf("%s: ReadStoredTx failed for %s.\n", __func__, txhash.ToString());
             return false;
         }
@@ -1442,14 +1905,14 @@ bool CHDWallet::ImportStealthAddress(const CStealthAddress &sxAddr, const CKey &
     LOCK(cs_wallet);
 
     // Must add before changing spend_secret
-    stealthAddresses.insert(sxAddr);
+    AddStealthAddressInMem(sxAddr);
 
     bool fOwned = skSpend.IsValid();
 
     if (fOwned) {
         // Owned addresses can only be added when wallet is unlocked
         if (IsLocked()) {
-            stealthAddresses.erase(sxAddr);
+            EraseStealthAddressInMem(sxAddr);
             return werror("%s: Wallet must be unlocked.", __func__);
         }
 
@@ -1457,14 +1920,14 @@ bool CHDWallet::ImportStealthAddress(const CStealthAddress &sxAddr, const CKey &
         auto spk_man = GetLegacyScriptPubKeyMan();
         if (spk_man) {
             if (!spk_man->AddKeyPubKey(skSpend, pk)) {
-                stealthAddresses.erase(sxAddr);
+                EraseStealthAddressInMem(sxAddr);
                 return werror("%s: AddKeyPubKey failed.", __func__);
             }
         }
     }
 
     if (!CHDWalletDB(*m_database).WriteStealthAddress(sxAddr)) {
-        stealthAddresses.erase(sxAddr);
+        EraseStealthAddressInMem(sxAddr);
         return werror("%s: WriteStealthAddress failed.", __func__);
     }
     UnsetWalletFlag(WALLET_FLAG_BLANK_WALLET);
@@ -1472,6 +1935,27 @@ bool CHDWallet::ImportStealthAddress(const CStealthAddress &sxAddr, const CKey &
     return true;
 };
 
+void CHDWallet::AddStealthAddressInMem(const CStealthAddress &sxAddr)
+{
+    AssertLockHeld(cs_wallet);
+    auto ret = stealthAddresses.insert(sxAddr);
+    if (ret.second) {
+        m_stealth_prefix_index.Add(&(*ret.first));
+    }
+};
+
+size_t CHDWallet::EraseStealthAddressInMem(const CStealthAddress &sxAddr)
+{
+    AssertLockHeld(cs_wallet);
+    auto si = stealthAddresses.find(sxAddr);
+    if (si == stealthAddresses.end()) {
+        return 0;
+    }
+    m_stealth_prefix_index.Remove(&(*si));
+    stealthAddresses.erase(si);
+    return 1;
+};
+
 bool CHDWallet::AddressBookChangedNotify(const CTxDestination &address, ChangeType nMode)
 {
     // Must run without cs_wallet locked
@@ -1521,24 +2005,42 @@ DBErrors CHDWallet::LoadWallet()
     m_rescan_stealth_v1_lookahead = gArgs.GetIntArg("-stealthv1lookaheadsize", DEFAULT_STEALTH_LOOKAHEAD_SIZE);
     m_rescan_stealth_v2_lookahead = gArgs.GetIntArg("-stealthv2lookaheadsize", DEFAULT_STEALTH_LOOKAHEAD_SIZE);
     m_default_lookahead = gArgs.GetIntArg("-defaultlookaheadsize", DEFAULT_LOOKAHEAD_SIZE);
+    m_rescan_prefetch_blocks = std::clamp((int)gArgs.GetIntArg("-rescanthreads", DEFAULT_RESCAN_THREADS), 0, 64);
+    m_check_balance_cache = gArgs.GetBoolArg("-checkbalancecache", DEFAULT_CHECK_BALANCE_CACHE);
+    m_lazy_key_packs = gArgs.GetBoolArg("-lazykeypacks", DEFAULT_LAZY_KEY_PACKS);
+    m_records_snapshot = gArgs.GetBoolArg("-recordssnapshot", DEFAULT_RECORDS_SNAPSHOT);
+    m_compact_stored_txns = gArgs.GetBoolArg("-compactstoredtxns", DEFAULT_COMPACT_STORED_TXNS);
+    m_key_pack_cache_size = std::max((int64_t)2, gArgs.GetIntArg("-keypackcachesize", DEFAULT_KEY_PACK_CACHE_SIZE));
 
     std::string sError;
     ProcessStakingSettings(sError);
     ProcessWalletSettings(sError);
 
+    int64_t nLoadStart = GetTimeMillis();
+    m_load_timings = CWalletLoadTimings();
     LoadMasterKeys();
 
     {
         // Prepare extended keys
+        int64_t nTime = GetTimeMillis();
         ExtKeyLoadMaster();
         ExtKeyLoadAccounts();
         ExtKeyLoadAccountPacks();
         ExtKeyLoadLoose();
+        m_load_timings.extkeys = GetTimeMillis() - nTime;
+
+        nTime = GetTimeMillis();
         LoadStealthAddresses();
+        m_load_timings.stealth = GetTimeMillis() - nTime;
+
+        nTime = GetTimeMillis();
         PrepareLookahead(); // Must happen after ExtKeyLoadAccountPacks
+        m_load_timings.lookahead = GetTimeMillis() - nTime;
     }
 
+    int64_t nTime = GetTimeMillis();
     auto rv = CWallet::LoadWallet();
+    m_load_timings.wallet = GetTimeMillis() - nTime;
     if (rv != DBErrors::LOAD_OK) {
         return rv;
     }
@@ -1564,6 +2066,11 @@ DBErrors CHDWallet::LoadWallet()
         LoadTxRecords(&wdb);
         LoadVoteTokens(&wdb);
     }
+    ArchiveSpentRecords();
+    m_load_timings.total = GetTimeMillis() - nLoadStart;
+    WalletLogPrintf("Loaded in %dms: extkeys %dms, stealth %dms, lookahead %dms, wallet %dms, records %dms\n",
+        m_load_timings.total, m_load_timings.extkeys, m_load_timings.stealth, m_load_timings.lookahead, m_load_timings.wallet,
+        m_load_timings.records_read + m_load_timings.records_decode + m_load_timings.records_insert);
 
     if (!pEKMaster) {
         if (gArgs.GetBoolArg("-createdefaultmasterkey", false)) {
@@ -1740,7 +2247,7 @@ bool CHDWallet::DelAddressBook(const CTxDestination &address)
             } else {
                 //fOwned = si->scan_secret.size() < 32 ? false : true;
 
-                if (stealthAddresses.erase(sxAddr) < 1
+                if (EraseStealthAddressInMem(sxAddr) < 1
                     || !CHDWalletDB(*m_database).EraseStealthAddress(sxAddr)) {
                     WalletLogPrintf("%s: Error: Remove stealthAddresses failed.\n", __func__);
                     return false;
@@ -1792,93 +2299,169 @@ int64_t CHDWallet::CountActiveAccountKeys() const
 
     for (const auto &mi : mapExtAccounts) {
         CExtKeyAccount *pa = mi.second;
-        nKeys += pa->mapKeys.size();
-        nKeys += pa->mapStealthChildKeys.size();
+        nKeys += pa->NumSavedKeys();
+        nKeys += pa->NumStealthChildKeys();
         //nKeys += pa->mapLookAhead.size();
     }
 
     return nKeys;
 };
 
-std::map<CTxDestination, CAmount> CHDWallet::GetAddressBalances() const
+static void AddAddressTxnOutput(std::vector<CAddressTxnTotals> &totals, const CTxDestination &dest, CAmount value, bool spent, int height)
 {
-    std::map<CTxDestination, CAmount> balances;
+    auto it = std::find_if(totals.begin(), totals.end(), [&dest](const CAddressTxnTotals &t) { return t.dest == dest; });
+    if (it == totals.end()) {
+        it = totals.emplace(totals.end());
+        it->dest = dest;
+        it->nHeight = height;
+    }
+    it->nReceived += value;
+    if (!spent) {
+        it->nBalance += value;
+    }
+}
 
-    {
-        LOCK(cs_wallet);
-        for (const auto& walletEntry : mapWallet) {
-            const CWalletTx *pcoin = &walletEntry.second;
+void CHDWallet::AddAddressTxnTotals(const CWalletTx &wtx, std::vector<CAddressTxnTotals> &totals, bool &is_volatile) const
+{
+    AssertLockHeld(cs_wallet);
 
-            if (!CachedTxIsTrusted(*this, *pcoin)) {
-                continue;
-            }
+    int nDepth = GetTxDepthInMainChain(wtx);
+    if (nDepth == 0 || (nDepth > 0 && GetTxBlocksToMaturity(wtx) > 0)) {
+        is_volatile = true;
+    }
+    if (!CachedTxIsTrusted(*this, wtx)
+        || IsTxImmatureCoinBase(wtx)
+        || nDepth < (CachedTxIsFromMe(*this, wtx, ISMINE_ALL) ? 0 : 1)) {
+        return;
+    }
 
-            if (IsTxImmatureCoinBase(*pcoin)) {
-                continue;
-            }
+    const uint256 &txid = wtx.GetHash();
+    int height = 0;
+    if (auto *conf = wtx.state<TxStateConfirmed>()) {
+        height = conf->confirmed_block_height;
+    }
+    for (unsigned int i = 0; i < wtx.tx->GetNumVOuts(); i++) {
+        const auto &txout = wtx.tx->vpout[i];
+        if (!txout->IsType(OUTPUT_STANDARD)) {
+            continue;
+        }
+        if (!IsMine(txout.get())) {
+            continue;
+        }
+        CTxDestination addr;
+        if (!ExtractDestination(*txout->GetPScriptPubKey(), addr)) {
+            continue;
+        }
+        AddAddressTxnOutput(totals, addr, txout->GetValue(), IsSpent(txid, i), height);
+    }
+};
 
-            int nDepth = GetTxDepthInMainChain(*pcoin);
-            if (nDepth < (CachedTxIsFromMe(*this, *pcoin, ISMINE_ALL) ? 0 : 1)) {
-                continue;
-            }
+void CHDWallet::AddAddressTxnTotals(const uint256 &txid, const CTransactionRecord &rtx, std::vector<CAddressTxnTotals> &totals, bool &is_volatile) const
+{
+    AssertLockHeld(cs_wallet);
 
-            for (unsigned int i = 0; i < pcoin->tx->GetNumVOuts(); i++) {
-                const auto &txout = pcoin->tx->vpout[i];
-                if (!txout->IsType(OUTPUT_STANDARD)) {
-                    continue;
-                }
-                if (!IsMine(txout.get())) {
-                    continue;
-                }
+    int nDepth = GetDepthInMainChain(rtx);
+    if (nDepth == 0) {
+        is_volatile = true;
+    }
+    if (!IsTrusted(txid, rtx)) {
+        return;
+    }
 
-                CTxDestination addr;
-                if (!ExtractDestination(*txout->GetPScriptPubKey(), addr)) {
-                    continue;
-                }
+    int height = nDepth > 0 ? rtx.block_height : 0;
+    for (const auto &r : rtx.vout) {
+        if (r.nType != OUTPUT_STANDARD
+            && r.nType != OUTPUT_CT
+            && r.nType != OUTPUT_RINGCT) {
+            continue;
+        }
+        if (!(r.nFlags & ORF_OWNED)) {
+            continue;
+        }
+        CTxDestination addr;
+        if (!ExtractDestination(r.scriptPubKey, addr)) {
+            continue;
+        }
+        AddAddressTxnOutput(totals, addr, r.nValue, IsSpent(txid, r.n), height);
+    }
+};
 
-                CAmount n = IsSpent(walletEntry.first, i) ? 0 : txout->GetValue();
+void CHDWallet::UpdateAddressTotals() const
+{
+    AssertLockHeld(cs_wallet);
 
-                if (!balances.count(addr)) {
-                    balances[addr] = 0;
-                }
-                balances[addr] += n;
-            }
+    if (!m_have_address_totals) {
+        m_have_address_totals = true;
+        m_address_txn_totals.clear();
+        m_address_totals.clear();
+        m_address_totals_dirty.clear();
+        m_address_totals_volatile.clear();
+        for (const auto &item : mapWallet) {
+            m_address_totals_dirty.insert(item.first);
         }
-
         for (const auto &ri : mapRecords) {
-            const uint256 &txhash = ri.first;
-            const CTransactionRecord &rtx = ri.second;
-
-            if (!IsTrusted(txhash, rtx)) {
-                continue;
-            }
+            m_address_totals_dirty.insert(ri.first);
+        }
+    }
 
-            for (const auto &r : rtx.vout) {
-                if (r.nType != OUTPUT_STANDARD
-                    && r.nType != OUTPUT_CT
-                    && r.nType != OUTPUT_RINGCT) {
-                    continue;
-                }
+    m_address_totals_dirty.insert(m_address_totals_volatile.begin(), m_address_totals_volatile.end());
+    m_address_totals_volatile.clear();
 
-                if (!(r.nFlags & ORF_OWNED)) {
+    for (const auto &txhash : m_address_totals_dirty) {
+        auto it = m_address_txn_totals.find(txhash);
+        if (it != m_address_txn_totals.end()) {
+            for (const auto &t : it->second) {
+                auto mi = m_address_totals.find(t.dest);
+                if (mi == m_address_totals.end()) {
                     continue;
                 }
-
-                CTxDestination addr;
-                if (!ExtractDestination(r.scriptPubKey, addr)) {
-                    continue;
+                mi->second -= t;
+                if (mi->second.IsNull()) {
+                    m_address_totals.erase(mi);
                 }
+            }
+            m_address_txn_totals.erase(it);
+        }
 
-                CAmount n =  IsSpent(txhash, r.n) ? 0 : r.nValue;
+        std::vector<CAddressTxnTotals> totals;
+        bool is_volatile = false;
+        MapWallet_t::const_iterator mwi;
+        MapRecords_t::const_iterator mri;
+        if ((mwi = mapWallet.find(txhash)) != mapWallet.end()) {
+            AddAddressTxnTotals(mwi->second, totals, is_volatile);
+        }
+        if ((mri = mapRecords.find(txhash)) != mapRecords.end()) {
+            AddAddressTxnTotals(txhash, mri->second, totals, is_volatile);
+        }
 
-                std::pair<std::map<CTxDestination, CAmount>::iterator, bool> ret;
-                ret = balances.insert(std::pair<CTxDestination, CAmount>(addr, n));
-                if (!ret.second) { // update existing record
-                    ret.first->second += n;
-                }
+        if (is_volatile) {
+            m_address_totals_volatile.insert(txhash);
+        }
+        if (!totals.empty()) {
+            for (const auto &t : totals) {
+                m_address_totals[t.dest] += t;
             }
+            m_address_txn_totals.emplace(txhash, std::move(totals));
         }
     }
+    m_address_totals_dirty.clear();
+};
+
+const std::map<CTxDestination, CAddressTotals> &CHDWallet::GetAddressTotals() const
+{
+    AssertLockHeld(cs_wallet);
+    UpdateAddressTotals();
+    return m_address_totals;
+};
+
+std::map<CTxDestination, CAmount> CHDWallet::GetAddressBalances() const
+{
+    std::map<CTxDestination, CAmount> balances;
+
+    LOCK(cs_wallet);
+    for (const auto &item : GetAddressTotals()) {
+        balances.emplace_hint(balances.end(), item.first, item.second.nBalance);
+    }
 
     return balances;
 }
@@ -2004,6 +2587,28 @@ std::set< std::set<CTxDestination> > CHDWallet::GetAddressGroupings() const
 
 isminetype CHDWallet::IsMine(const CScript &scriptPubKey, CKeyID &keyID,
     const CEKAKey *&pak, const CEKASCKey *&pasc, CExtKeyAccount *&pa, bool &isInvalid, SigVersion sigversion) const
+{
+    AssertLockHeld(cs_wallet);
+    if (sigversion != SigVersion::BASE) {
+        return IsMineScript(scriptPubKey, keyID, pak, pasc, pa, isInvalid, sigversion);
+    }
+
+    uint8_t flags = GetIsMineCacheFlags(scriptPubKey);
+    if (flags & ISMINE_CACHE_NO_HD) {
+        pak = nullptr;
+        pasc = nullptr;
+        pa = nullptr;
+        return ISMINE_NO;
+    }
+    isminetype mine = IsMineScript(scriptPubKey, keyID, pak, pasc, pa, isInvalid, sigversion);
+    if (mine == ISMINE_NO && !isInvalid) {
+        m_ismine_cache.Insert(scriptPubKey, flags | ISMINE_CACHE_NO_HD);
+    }
+    return mine;
+};
+
+isminetype CHDWallet::IsMineScript(const CScript &scriptPubKey, CKeyID &keyID,
+    const CEKAKey *&pak, const CEKASCKey *&pasc, CExtKeyAccount *&pa, bool &isInvalid, SigVersion sigversion) const
 {
     if (scriptPubKey.StartsWithICS()) {
         CScript scriptA, scriptB;
@@ -2011,12 +2616,12 @@ isminetype CHDWallet::IsMine(const CScript &scriptPubKey, CKeyID &keyID,
             return ISMINE_NO;
         }
 
-        isminetype typeB = IsMine(scriptB, keyID, pak, pasc, pa, isInvalid, sigversion);
+        isminetype typeB = IsMineScript(scriptB, keyID, pak, pasc, pa, isInvalid, sigversion);
         if (typeB & ISMINE_SPENDABLE) {
             return typeB;
         }
 
-        isminetype typeA = IsMine(scriptA, keyID, pak, pasc, pa, isInvalid, sigversion);
+        isminetype typeA = IsMineScript(scriptA, keyID, pak, pasc, pa, isInvalid, sigversion);
         if (typeA & ISMINE_SPENDABLE) {
             int ia = (int)typeA;
             ia &= ~ISMINE_SPENDABLE;
@@ -2141,13 +2746,40 @@ isminetype CHDWallet::IsMine(const CScript &scriptPubKey, CKeyID &keyID,
     return ISMINE_NO;
 };
 
+uint8_t CHDWallet::GetIsMineCacheFlags(const CScript &script) const
+{
+    AssertLockHeld(cs_wallet);
+    uint64_t epoch = m_ismine_cache_epoch;
+    if (epoch != m_ismine_cache_read_epoch) {
+        m_ismine_cache.Clear();
+        m_ismine_cache_read_epoch = epoch;
+        return 0;
+    }
+    const uint8_t *cached = m_ismine_cache.Peek(script);
+    return cached ? *cached : 0;
+};
+
+isminetype CHDWallet::IsMineCached(const CScript &script) const
+{
+    AssertLockHeld(cs_wallet);
+    uint8_t flags = GetIsMineCacheFlags(script);
+    if (flags & ISMINE_CACHE_NO_LEGACY) {
+        return ISMINE_NO;
+    }
+    isminetype mine = CWallet::IsMine(script);
+    if (mine == ISMINE_NO) {
+        m_ismine_cache.Insert(script, flags | ISMINE_CACHE_NO_LEGACY);
+    }
+    return mine;
+};
+
 isminetype CHDWallet::IsMine(const CTxOutBase *txout) const
 {
     switch (txout->nVersion) {
         case OUTPUT_STANDARD:
-            return IsMine(((CTxOutStandard*)txout)->scriptPubKey);
+            return IsMineCached(((CTxOutStandard*)txout)->scriptPubKey);
         case OUTPUT_CT:
-            return IsMine(((CTxOutCT*)txout)->scriptPubKey);
+            return IsMineCached(((CTxOutCT*)txout)->scriptPubKey);
         case OUTPUT_RINGCT:
             //CKeyID idk = ((CTxOutRingCT*)txout)->pk.GetID();
             //return HaveKey(idk);
@@ -2347,7 +2979,8 @@ CAmount CHDWallet::GetOutputValue(const COutPoint &op, bool fAllowTXIndex) const
             return rec->nValue;
         }
         CStoredTransaction stx;
-        if (!CHDWalletDB(*m_database).ReadStoredTx(op.hash, stx)) { // TODO: cache / use mapTempWallet
+        CHDWalletDB wdb(*m_database);
+        if (!GetStoredTx(wdb, op.hash, stx)) { // TODO: cache / use mapTempWallet
             WalletLogPrintf("%s: ReadStoredTx failed for %s.\n", __func__, op.hash.ToString());
             return 0;
         }
@@ -2482,9 +3115,14 @@ CAmount CHDWallet::GetSpendableBalance() const
 
     LOCK(cs_wallet);
 
-    for (const auto &ri : mapRecords) {
-        const auto &txhash = ri.first;
-        const auto &rtx = ri.second;
+    UpdateUnspentRecordSets();
+    for (const auto &unspent_txid : m_unspent_standard_txns) {
+        MapRecords_t::const_iterator mri = mapRecords.find(unspent_txid);
+        if (mri == mapRecords.end()) {
+            continue;
+        }
+        const auto &txhash = mri->first;
+        const auto &rtx = mri->second;
         if (!IsTrusted(txhash, rtx)) {
             continue;
         }
@@ -2531,9 +3169,14 @@ CAmount CHDWallet::GetBlindBalance()
 
     LOCK(cs_wallet);
 
-    for (const auto &ri : mapRecords) {
-        const auto &txhash = ri.first;
-        const auto &rtx = ri.second;
+    UpdateUnspentRecordSets();
+    for (const auto &unspent_txid : m_unspent_blind_txns) {
+        MapRecords_t::const_iterator mri = mapRecords.find(unspent_txid);
+        if (mri == mapRecords.end()) {
+            continue;
+        }
+        const auto &txhash = mri->first;
+        const auto &rtx = mri->second;
 
         if (!IsTrusted(txhash, rtx)) {
             continue;
@@ -2560,9 +3203,14 @@ CAmount CHDWallet::GetAnonBalance()
 
     LOCK(cs_wallet);
 
-    for (const auto &ri : mapRecords) {
-        const auto &txhash = ri.first;
-        const auto &rtx = ri.second;
+    UpdateUnspentRecordSets();
+    for (const auto &unspent_txid : m_unspent_anon_txns) {
+        MapRecords_t::const_iterator mri = mapRecords.find(unspent_txid);
+        if (mri == mapRecords.end()) {
+            continue;
+        }
+        const auto &txhash = mri->first;
+        const auto &rtx = mri->second;
 
         if (!IsTrusted(txhash, rtx)) {
             continue;
@@ -2605,145 +3253,252 @@ CAmount CHDWallet::GetStaked()
 
 bool CHDWallet::GetBalances(CHDWalletBalances &bal, bool avoid_reuse) const
 {
+    bool use_snapshot = !IsWalletFlagSet(WALLET_FLAG_AVOID_REUSE) && !m_check_balance_cache;
+    if (use_snapshot) {
+        LOCK(cs_wallet_snapshot);
+        if (m_balances_snapshot && m_balances_snapshot->first == m_wallet_state_version) {
+            bal = m_balances_snapshot->second;
+            return true;
+        }
+    }
+
+    LOCK(cs_wallet);
+
+    if (IsWalletFlagSet(WALLET_FLAG_AVOID_REUSE)) {
+        // Used addresses are not tracked per txn, marking a key spent changes the balance of other txns
+        return ComputeBalances(bal, avoid_reuse);
+    }
+
+    UpdateCachedBalances();
+    bal = m_cached_balances;
+
+    if (use_snapshot) {
+        LOCK(cs_wallet_snapshot);
+        m_balances_snapshot = std::make_pair(m_wallet_state_version.load(), bal);
+    }
+
+    if (m_check_balance_cache) {
+        CHDWalletBalances bal_check;
+        ComputeBalances(bal_check, avoid_reuse);
+        if (bal != bal_check) {
+            WalletLogPrintf("Error: %s - Cached balances differ from recomputed balances.\n", __func__);
+            m_have_cached_balances = false;
+            bal = bal_check;
+        }
+    }
+
+    return true;
+};
+
+bool CHDWallet::ComputeBalances(CHDWalletBalances &bal, bool avoid_reuse) const
+{
+    AssertLockHeld(cs_wallet);
     bal = CHDWalletBalances();
 
     isminefilter reuse_filter = avoid_reuse ? 0 : ISMINE_USED;
 
     bool allow_used_addresses = !IsWalletFlagSet(WALLET_FLAG_AVOID_REUSE) || (!avoid_reuse);
 
-    LOCK(cs_wallet);
-
     for (const auto &item : mapWallet) {
-        const CWalletTx &wtx = item.second;
+        AddWalletTxBalances(item.second, reuse_filter, bal);
+    }
+    for (const auto &ri : mapRecords) {
+        AddRecordBalances(ri.first, ri.second, allow_used_addresses, bal);
+    }
+    //if (!MoneyRange(nBalance))
+    //    throw std::runtime_error(std::string(__func__) + ": value out of range");
 
-        bal.nPartImmature += CachedTxGetImmatureCredit(*this, wtx);
-        //bal.nPartWatchOnlyImmature += wtx.GetImmatureWatchOnlyCredit(*locked_chain);
+    return true;
+};
 
-        int depth;
-        if (wtx.IsCoinStake() &&
-            (depth = GetTxDepthInMainChain(wtx)) > 0 && // checks for hashunset
-             GetTxBlocksToMaturity(wtx) > 0) {
-            CAmount nSpendable, nWatchOnly;
-            CHDWallet::GetCredit(*wtx.tx, nSpendable, nWatchOnly);
-            bal.nPartStaked += nSpendable;
-            bal.nPartWatchOnlyStaked += nWatchOnly;
-        }
+void CHDWallet::AddWalletTxBalances(const CWalletTx &wtx, isminefilter reuse_filter, CHDWalletBalances &bal) const
+{
+    AssertLockHeld(cs_wallet);
 
-        if (CachedTxIsTrusted(*this, wtx)) {
-            bal.nPart += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_SPENDABLE | reuse_filter);
-            bal.nPartWatchOnly += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_WATCH_ONLY | reuse_filter);
-        } else if (GetTxDepthInMainChain(wtx) == 0 && wtx.InMempool()) {
-            bal.nPartUnconf += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_SPENDABLE | reuse_filter);
-            bal.nPartWatchOnlyUnconf += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_WATCH_ONLY | reuse_filter);
-        }
+    bal.nPartImmature += CachedTxGetImmatureCredit(*this, wtx);
+    //bal.nPartWatchOnlyImmature += wtx.GetImmatureWatchOnlyCredit(*locked_chain);
+
+    int depth;
+    if (wtx.IsCoinStake() &&
+        (depth = GetTxDepthInMainChain(wtx)) > 0 && // checks for hashunset
+         GetTxBlocksToMaturity(wtx) > 0) {
+        CAmount nSpendable, nWatchOnly;
+        CHDWallet::GetCredit(*wtx.tx, nSpendable, nWatchOnly);
+        bal.nPartStaked += nSpendable;
+        bal.nPartWatchOnlyStaked += nWatchOnly;
+    }
+
+    if (CachedTxIsTrusted(*this, wtx)) {
+        bal.nPart += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_SPENDABLE | reuse_filter);
+        bal.nPartWatchOnly += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_WATCH_ONLY | reuse_filter);
+    } else if (GetTxDepthInMainChain(wtx) == 0 && wtx.InMempool()) {
+        bal.nPartUnconf += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_SPENDABLE | reuse_filter);
+        bal.nPartWatchOnlyUnconf += CachedTxGetAvailableCredit(*this, wtx, true, ISMINE_WATCH_ONLY | reuse_filter);
     }
+};
 
+void CHDWallet::AddRecordBalances(const uint256 &txhash, const CTransactionRecord &rtx, bool allow_used_addresses, CHDWalletBalances &bal) const
+{
+    AssertLockHeld(cs_wallet);
     const Consensus::Params &consensusParams = Params().GetConsensus();
-    for (const auto &ri : mapRecords) {
-        const auto &txhash = ri.first;
-        const auto &rtx = ri.second;
 
-        int depth;
-        bool fTrusted = IsTrusted(txhash, rtx, &depth);
-        bool fInMempool = false;
-        if (!fTrusted) {
-            fInMempool = InMempool(txhash);
-        }
+    int depth;
+    bool fTrusted = IsTrusted(txhash, rtx, &depth);
+    bool fInMempool = false;
+    if (!fTrusted) {
+        fInMempool = InMempool(txhash);
+    }
 
-        for (const auto &r : rtx.vout) {
-            if (!(r.nFlags & ORF_OWN_ANY)
-                || IsSpent(txhash, r.n)) {
-                continue;
-            }
-            bool watch_only = r.nFlags & ORF_OWN_WATCH;
-            bool force_watch_only = false;
+    for (const auto &r : rtx.vout) {
+        if (!(r.nFlags & ORF_OWN_ANY)
+            || IsSpent(txhash, r.n)) {
+            continue;
+        }
+        bool watch_only = r.nFlags & ORF_OWN_WATCH;
+        bool force_watch_only = false;
 #if !ENABLE_USBDEVICE
-            bool fNeedHardwareKey = (r.nFlags & ORF_HARDWARE_DEVICE);
-            if (fNeedHardwareKey) {
-                watch_only = true;
-                force_watch_only = true;
-            }
+        bool fNeedHardwareKey = (r.nFlags & ORF_HARDWARE_DEVICE);
+        if (fNeedHardwareKey) {
+            watch_only = true;
+            force_watch_only = true;
+        }
 #endif
-            switch (r.nType) {
-                case OUTPUT_RINGCT:
-                    if (!(r.nFlags & ORF_OWNED || r.nFlags & ORF_OWN_WATCH)) {
-                        continue;
-                    }
-                    if (fTrusted) {
-                        if (depth >= consensusParams.nMinRCTOutputDepth) {
-                            if (watch_only) {
-                                bal.nAnonWatchOnly += r.nValue;
-                            } else {
-                                bal.nAnon += r.nValue;
-                            }
+        switch (r.nType) {
+            case OUTPUT_RINGCT:
+                if (!(r.nFlags & ORF_OWNED || r.nFlags & ORF_OWN_WATCH)) {
+                    continue;
+                }
+                if (fTrusted) {
+                    if (depth >= consensusParams.nMinRCTOutputDepth) {
+                        if (watch_only) {
+                            bal.nAnonWatchOnly += r.nValue;
                         } else {
-                            if (watch_only) {
-                                bal.nAnonWatchOnlyImmature += r.nValue;
-                            } else {
-                                bal.nAnonImmature += r.nValue;
-                            }
+                            bal.nAnon += r.nValue;
                         }
-                    } else
-                    if (fInMempool) {
+                    } else {
                         if (watch_only) {
-                            bal.nAnonWatchOnlyUnconf += r.nValue;
+                            bal.nAnonWatchOnlyImmature += r.nValue;
                         } else {
-                            bal.nAnonUnconf += r.nValue;
+                            bal.nAnonImmature += r.nValue;
                         }
                     }
-                    break;
-                case OUTPUT_CT:
-                    if (!(r.nFlags & ORF_OWNED || r.nFlags & ORF_OWN_WATCH)) {
-                        continue;
+                } else
+                if (fInMempool) {
+                    if (watch_only) {
+                        bal.nAnonWatchOnlyUnconf += r.nValue;
+                    } else {
+                        bal.nAnonUnconf += r.nValue;
+                    }
+                }
+                break;
+            case OUTPUT_CT:
+                if (!(r.nFlags & ORF_OWNED || r.nFlags & ORF_OWN_WATCH)) {
+                    continue;
+                }
+                if (!allow_used_addresses && IsSpentKey(&r.scriptPubKey)) {
+                    continue;
+                }
+                if (fTrusted) {
+                    if (watch_only) {
+                        bal.nBlindWatchOnly += r.nValue;
+                    } else {
+                        bal.nBlind += r.nValue;
+                    }
+                } else
+                if (fInMempool) {
+                    if (watch_only) {
+                        bal.nBlindWatchOnlyUnconf += r.nValue;
+                    } else {
+                        bal.nBlindUnconf += r.nValue;
                     }
+                }
+                break;
+            case OUTPUT_STANDARD:
+                if (!force_watch_only && (r.nFlags & ORF_OWNED)) {
                     if (!allow_used_addresses && IsSpentKey(&r.scriptPubKey)) {
                         continue;
                     }
                     if (fTrusted) {
-                        if (watch_only) {
-                            bal.nBlindWatchOnly += r.nValue;
-                        } else {
-                            bal.nBlind += r.nValue;
-                        }
+                        bal.nPart += r.nValue;
                     } else
                     if (fInMempool) {
-                        if (watch_only) {
-                            bal.nBlindWatchOnlyUnconf += r.nValue;
-                        } else {
-                            bal.nBlindUnconf += r.nValue;
-                        }
+                        bal.nPartUnconf += r.nValue;
                     }
-                    break;
-                case OUTPUT_STANDARD:
-                    if (!force_watch_only && (r.nFlags & ORF_OWNED)) {
-                        if (!allow_used_addresses && IsSpentKey(&r.scriptPubKey)) {
-                            continue;
-                        }
-                        if (fTrusted) {
-                            bal.nPart += r.nValue;
-                        } else
-                        if (fInMempool) {
-                            bal.nPartUnconf += r.nValue;
-                        }
+                } else
+                if (watch_only) {
+                    if (fTrusted) {
+                        bal.nPartWatchOnly += r.nValue;
                     } else
-                    if (watch_only) {
-                        if (fTrusted) {
-                            bal.nPartWatchOnly += r.nValue;
-                        } else
-                        if (fInMempool) {
-                            bal.nPartWatchOnlyUnconf += r.nValue;
-                        }
+                    if (fInMempool) {
+                        bal.nPartWatchOnlyUnconf += r.nValue;
                     }
-                    break;
-                default:
-                    break;
-            }
+                }
+                break;
+            default:
+                break;
         }
     }
-    //if (!MoneyRange(nBalance))
-    //    throw std::runtime_error(std::string(__func__) + ": value out of range");
+};
 
-    return true;
+void CHDWallet::UpdateCachedBalances() const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!m_have_cached_balances) {
+        m_have_cached_balances = true;
+        m_cached_balances = CHDWalletBalances();
+        m_txn_balances.clear();
+        m_balances_dirty.clear();
+        m_balances_volatile.clear();
+        for (const auto &item : mapWallet) {
+            m_balances_dirty.insert(item.first);
+        }
+        for (const auto &ri : mapRecords) {
+            m_balances_dirty.insert(ri.first);
+        }
+    }
+
+    m_balances_dirty.insert(m_balances_volatile.begin(), m_balances_volatile.end());
+    m_balances_volatile.clear();
+
+    const Consensus::Params &consensusParams = Params().GetConsensus();
+    for (const auto &txhash : m_balances_dirty) {
+        auto it = m_txn_balances.find(txhash);
+        if (it != m_txn_balances.end()) {
+            m_cached_balances -= it->second;
+            m_txn_balances.erase(it);
+        }
+
+        CHDWalletBalances txn_bal;
+        bool is_volatile = false;
+        MapWallet_t::const_iterator mwi;
+        MapRecords_t::const_iterator mri;
+        if ((mwi = mapWallet.find(txhash)) != mapWallet.end()) {
+            const CWalletTx &wtx = mwi->second;
+            AddWalletTxBalances(wtx, 0, txn_bal);
+            int depth = GetTxDepthInMainChain(wtx);
+            if (depth == 0 || (depth > 0 && GetTxBlocksToMaturity(wtx) > 0)) {
+                is_volatile = true;
+            }
+        }
+        if ((mri = mapRecords.find(txhash)) != mapRecords.end()) {
+            const CTransactionRecord &rtx = mri->second;
+            AddRecordBalances(txhash, rtx, true, txn_bal);
+            int depth = GetDepthInMainChain(rtx);
+            if (depth >= 0 && depth < consensusParams.nMinRCTOutputDepth) {
+                is_volatile = true;
+            }
+        }
+
+        if (is_volatile) {
+            m_balances_volatile.insert(txhash);
+        }
+        if (txn_bal != CHDWalletBalances()) {
+            m_cached_balances += txn_bal;
+            m_txn_balances.emplace(txhash, txn_bal);
+        }
+    }
+    m_balances_dirty.clear();
 };
 
 CAmount CHDWallet::GetAvailableAnonBalance(const CCoinControl* coinControl) const
@@ -2966,10 +3721,73 @@ void CHDWallet::AddOutputRecordMetaData(CTransactionRecord &rtx, std::vector<CTe
     return;
 };
 
+/** Ephemeral and shared secrets of a stealth recipient */
+struct StealthSendSecrets {
+    bool fValid = false;
+    CKey sEphem;
+    CKey sShared;
+    ec_point pkSendTo;
+};
+
+/** Find an ephemeral key for sx, starting from sEphem if set */
+static bool MakeStealthSendSecrets(const CStealthAddress &sx, StealthSendSecrets &secrets)
+{
+    if (!secrets.sEphem.IsValid()) {
+        GetEphemeralKey(secrets.sEphem);
+    }
+    int k, nTries = 24;
+    for (k = 0; k < nTries; ++k) {
+        if (StealthSecret(secrets.sEphem, sx.scan_pubkey, sx.spend_pubkey, secrets.sShared, secrets.pkSendTo) == 0) {
+            break;
+        }
+        // if StealthSecret fails try again with new ephem key
+        GetEphemeralKey(secrets.sEphem);
+    }
+    secrets.fValid = k < nTries;
+    return secrets.fValid;
+}
+
+/**
+ * Run the ECDH of every stealth recipient in vecSend across threads, before ExpandTempRecipients inserts data outputs.
+ * Entries of recipients that don't need a new shared secret are left unset.
+ */
+static void MakeStealthSendSecrets(const std::vector<CTempRecipient> &vecSend, std::vector<StealthSendSecrets> &vSecrets)
+{
+    vSecrets.clear();
+    vSecrets.resize(vecSend.size());
+    std::vector<size_t> stealth_recipients;
+    for (size_t i = 0; i < vecSend.size(); ++i) {
+        const CTempRecipient &r = vecSend[i];
+        if (r.address.index() != DI::_CStealthAddress) {
+            continue;
+        }
+        if (r.nType == OUTPUT_STANDARD) {
+            // Always a new ephem key
+        } else
+        if (r.nType == OUTPUT_CT ||
+            (r.nType == OUTPUT_RINGCT && !(r.pkTo.IsValid() && r.vData.size() >= 33 && r.fNonceSet))) {
+            vSecrets[i].sEphem = r.sEphem;
+        } else {
+            continue;
+        }
+        stealth_recipients.push_back(i);
+    }
+
+    size_t num_workers = std::min(stealth_recipients.size() / MIN_STEALTH_RECIPIENTS_PER_WORKER + 1, (size_t) std::max(1, GetNumCores()));
+    ParallelFor(stealth_recipients.size(), num_workers, [&](size_t w, size_t j) {
+        size_t i = stealth_recipients[j];
+        return MakeStealthSendSecrets(std::get<CStealthAddress>(vecSend[i].address), vSecrets[i]);
+    });
+}
+
 int CHDWallet::ExpandTempRecipients(std::vector<CTempRecipient> &vecSend, CStoredExtKey *pc, std::string &sError)
 {
     LOCK(cs_wallet);
-    for (size_t i = 0; i < vecSend.size(); ++i) {
+
+    // Indexed by position in vecSend before data outputs are inserted
+    std::vector<StealthSendSecrets> vSecrets;
+    MakeStealthSendSecrets(vecSend, vSecrets);
+    for (size_t i = 0, nOrig = 0; i < vecSend.size(); ++i, ++nOrig) {
         CTempRecipient &r = vecSend[i];
 
         if (r.nType == OUTPUT_STANDARD) {
@@ -2977,19 +3795,13 @@ int CHDWallet::ExpandTempRecipients(std::vector<CTempRecipient> &vecSend, CStore
             if (r.address.index() == DI::_CStealthAddress) {
                 CStealthAddress sx = std::get<CStealthAddress>(r.address);
 
-                CKey sShared;
-                ec_point pkSendTo;
-
-                int k, nTries = 24;
-                for (k = 0; k < nTries; ++k) { // if StealthSecret fails try again with new ephem key
-                    r.sEphem.MakeNewKey(true);
-                    if (StealthSecret(r.sEphem, sx.scan_pubkey, sx.spend_pubkey, sShared, pkSendTo) == 0) {
-                        break;
-                    }
-                }
-                if (k >= nTries) {
+                const StealthSendSecrets &secrets = vSecrets[nOrig];
+                if (!secrets.fValid) {
                     return wserrorN(1, sError, __func__, "Could not generate receiving public key.");
                 }
+                r.sEphem = secrets.sEphem;
+                const CKey &sShared = secrets.sShared;
+                const ec_point &pkSendTo = secrets.pkSendTo;
 
                 CPubKey pkEphem = r.sEphem.GetPubKey();
                 r.pkTo = CPubKey(pkSendTo);
@@ -3085,32 +3897,19 @@ int CHDWallet::ExpandTempRecipients(std::vector<CTempRecipient> &vecSend, CStore
                 return errorN(1, sError, __func__, "TryDeriveNext failed.");
             */
             if (!sEphem.IsValid()) {
-                sEphem.MakeNewKey(true);
+                GetEphemeralKey(sEphem);
             }
 
             if (r.address.index() == DI::_CStealthAddress) {
                 CStealthAddress sx = std::get<CStealthAddress>(r.address);
 
-                CKey sShared;
-                ec_point pkSendTo;
-
-                int k, nTries = 24;
-                for (k = 0; k < nTries; ++k) {
-                    if (StealthSecret(sEphem, sx.scan_pubkey, sx.spend_pubkey, sShared, pkSendTo) == 0) {
-                        break;
-                    }
-                    // if StealthSecret fails try again with new ephem key
-                    /* TODO: Make optional
-                    if (0 != pc->DeriveNextKey(sEphem, nChild, true))
-                        return errorN(1, sError, __func__, "DeriveNextKey failed.");
-                    */
-                    sEphem.MakeNewKey(true);
-                }
-                if (k >= nTries) {
+                const StealthSendSecrets &secrets = vSecrets[nOrig];
+                if (!secrets.fValid) {
                     return wserrorN(1, sError, __func__, "Could not generate receiving public key.");
                 }
+                sEphem = secrets.sEphem;
 
-                r.pkTo = CPubKey(pkSendTo);
+                r.pkTo = CPubKey(secrets.pkSendTo);
                 PKHash pkhash = PKHash(r.pkTo);
 
                 r.scriptPubKey = GetScriptForDestination(pkhash);
@@ -3176,7 +3975,7 @@ int CHDWallet::ExpandTempRecipients(std::vector<CTempRecipient> &vecSend, CStore
                 return errorN(1, sError, __func__, "TryDeriveNext failed.");
             */
             if (!sEphem.IsValid()) {
-                sEphem.MakeNewKey(true);
+                GetEphemeralKey(sEphem);
             }
 
             if (r.pkTo.IsValid() && r.vData.size() >= 33 && r.fNonceSet) {
@@ -3185,25 +3984,13 @@ int CHDWallet::ExpandTempRecipients(std::vector<CTempRecipient> &vecSend, CStore
             if (r.address.index() == DI::_CStealthAddress) {
                 CStealthAddress sx = std::get<CStealthAddress>(r.address);
 
-                CKey sShared;
-                ec_point pkSendTo;
-                int k, nTries = 24;
-                for (k = 0; k < nTries; ++k) {
-                    if (StealthSecret(sEphem, sx.scan_pubkey, sx.spend_pubkey, sShared, pkSendTo) == 0) {
-                        break;
-                    }
-                    // if StealthSecret fails try again with new ephem key
-                    /* TODO: Make optional
-                    if (0 != pc->DeriveNextKey(sEphem, nChild, true))
-                        return errorN(1, sError, __func__, "DeriveNextKey failed.");
-                    */
-                    sEphem.MakeNewKey(true);
-                }
-                if (k >= nTries) {
+                const StealthSendSecrets &secrets = vSecrets[nOrig];
+                if (!secrets.fValid) {
                     return wserrorN(1, sError, __func__, "Could not generate receiving public key.");
                 }
+                sEphem = secrets.sEphem;
 
-                r.pkTo = CPubKey(pkSendTo);
+                r.pkTo = CPubKey(secrets.pkSendTo);
                 CKeyID idTo = r.pkTo.GetID();
 
                 if (sx.prefix.number_bits > 0) {
@@ -3289,26 +4076,157 @@ int CreateOutput(OUTPUT_PTR<CTxOutBase> &txbout, CTempRecipient &r, std::string
     return 0;
 };
 
-int CHDWallet::AddCTData(const CCoinControl *coinControl, CTxOutBase *txout, CTempRecipient &r, std::string &sError)
+static size_t GetNumSigningWorkers()
 {
-    secp256k1_pedersen_commitment *pCommitment = txout->GetPCommitment();
-    std::vector<uint8_t> *pvRangeproof = txout->GetPRangeproof();
+    return (size_t) std::max(1, GetNumCores());
+}
 
-    if (!pCommitment || !pvRangeproof) {
-        return wserrorN(1, sError, __func__, "Unable to get CT pointers for output type %d", txout->GetType());
+/** Split runs of consecutive outputs of the same type into power of two sized groups, to share an aggregated bulletproof */
+static void GroupCTOutputs(const std::vector<std::pair<CTxOutBase*, CTempRecipient*> > &outputs, bool aggregate, int single_n,
+    std::vector<std::pair<size_t, size_t> > &groups)
+{
+    groups.clear();
+    for (size_t i = 0; i < outputs.size();) {
+        size_t run = 1;
+        while (aggregate && outputs[i].second->n != single_n && i + run < outputs.size() &&
+               outputs[i + run].second->n != single_n &&
+               outputs[i + run].first->nVersion == outputs[i].first->nVersion &&
+               outputs[i + run].second->n == outputs[i].second->n + (int)run) {
+            run++;
+        }
+        while (run > 0) {
+            size_t n = 1;
+            while (n * 2 <= run && n * 2 <= MAX_AGGREGATE_RANGEPROOFS) {
+                n *= 2;
+            }
+            groups.emplace_back(i, n);
+            i += n;
+            run -= n;
+        }
     }
+}
 
-    uint64_t nValue = r.nAmount;
-    if (coinControl && coinControl->m_debug_exploit_anon > 0) {
-        nValue += coinControl->m_debug_exploit_anon;
-    }
-    if (!secp256k1_pedersen_commit(secp256k1_ctx_blind,
-        pCommitment, (uint8_t*)r.vBlind.data(),
-        nValue, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
-        return wserrorN(1, sError, __func__, "secp256k1_pedersen_commit failed.");
-    }
+static bool UseAggregateRangeProofs(const CCoinControl *coinControl)
+{
+    const Consensus::Params &consensus = Params().GetConsensus();
+    int64_t now = GetTime();
+    return now >= consensus.bulletproof_time && now >= consensus.aggregate_bulletproof_time &&
+           !(coinControl && coinControl->m_debug_exploit_anon > 0);
+}
+
+static bool CanSizeCTData()
+{
+    // Bulletproof lengths depend only on the number of commitments
+    return GetTime() >= Params().GetConsensus().bulletproof_time;
+}
+
+void CHDWallet::SizeCTData(const CCoinControl *coinControl, std::vector<std::pair<CTxOutBase*, CTempRecipient*> > &outputs, int single_n, size_t &nExtraBytes) const
+{
+    std::vector<std::pair<size_t, size_t> > groups;
+    GroupCTOutputs(outputs, UseAggregateRangeProofs(coinControl), single_n, groups);
+
+    nExtraBytes = 0;
+    for (const auto &group : groups) {
+        size_t first = group.first, n = group.second;
+        outputs[first].first->GetPRangeproof()->assign(GetBulletproofSize(n), 0);
+        for (size_t k = 0; k < n; ++k) {
+            const CTempRecipient &r = *outputs[first + k].second;
+            if (k > 0) {
+                outputs[first + k].first->GetPRangeproof()->clear();
+            }
+            if (n > 1) {
+                nExtraBytes += AGGREGATE_AMOUNT_SIZE;
+            }
+            if (r.sNarration.size() > 0) {
+                nExtraBytes += 1 + (r.sNarration.size() / AES_BLOCKSIZE + 1) * AES_BLOCKSIZE; // DO_NARR_CRYPT, padded ciphertext
+            }
+        }
+    }
+};
+
+int CHDWallet::ProveSizedCTData(const CCoinControl *coinControl, std::vector<std::pair<CTxOutBase*, CTempRecipient*> > &outputs, int single_n, std::string &sError)
+{
+    // The output at single_n is proven by the caller once its value or blind is final
+    outputs.erase(std::remove_if(outputs.begin(), outputs.end(),
+        [single_n](const std::pair<CTxOutBase*, CTempRecipient*> &output) { return output.second->n == single_n; }),
+        outputs.end());
+    return AddCTData(coinControl, outputs, sError, single_n);
+};
+
+int CHDWallet::AddCTData(const CCoinControl *coinControl, std::vector<std::pair<CTxOutBase*, CTempRecipient*> > &outputs, std::string &sError, int single_n)
+{
+    std::vector<std::pair<size_t, size_t> > groups;
+    GroupCTOutputs(outputs, UseAggregateRangeProofs(coinControl), single_n, groups);
+
+    auto add_group = [&](size_t g, std::string &error, secp256k1_scratch_space *scratch) {
+        size_t first = groups[g].first, n = groups[g].second;
+        if (n == 1) {
+            return AddCTData(coinControl, outputs[first].first, *outputs[first].second, error, scratch);
+        }
+        return AddAggregateCTData(coinControl, &outputs[first], n, error, scratch);
+    };
+
+    size_t num_workers = std::min(groups.size(), GetNumSigningWorkers());
+    if (num_workers < 2) {
+        for (size_t g = 0; g < groups.size(); ++g) {
+            if (0 != add_group(g, sError, nullptr)) {
+                return 1; // sError will be set
+            }
+        }
+        return 0;
+    }
+
+    // m_blind_scratch can't be shared, each worker proves with its own scratch space
+    std::vector<secp256k1_scratch_space*> scratches(num_workers, nullptr);
+    for (auto &scratch : scratches) {
+        scratch = secp256k1_scratch_space_create(secp256k1_ctx_blind, 1024 * 1024);
+    }
+    std::vector<std::string> errors(groups.size());
+    bool rv = ParallelFor(groups.size(), num_workers, [&](size_t w, size_t g) {
+        if (!scratches[w]) {
+            errors[g] = "secp256k1_scratch_space_create failed.";
+            return false;
+        }
+        return 0 == add_group(g, errors[g], scratches[w]);
+    });
+    for (auto &scratch : scratches) {
+        if (scratch) {
+            secp256k1_scratch_space_destroy(secp256k1_ctx_blind, scratch);
+        }
+    }
+
+    if (!rv) {
+        sError = "AddCTData failed.";
+        for (const auto &error : errors) {
+            if (!error.empty()) {
+                sError = error;
+                break;
+            }
+        }
+        return 1;
+    }
+    return 0;
+};
+
+int CHDWallet::SetCTCommitment(const CCoinControl *coinControl, CTxOutBase *txout, CTempRecipient &r, uint64_t &nValue, uint256 &nonce, std::string &sError)
+{
+    secp256k1_pedersen_commitment *pCommitment = txout->GetPCommitment();
+    std::vector<uint8_t> *pvRangeproof = txout->GetPRangeproof();
+
+    if (!pCommitment || !pvRangeproof) {
+        return wserrorN(1, sError, __func__, "Unable to get CT pointers for output type %d", txout->GetType());
+    }
+
+    nValue = r.nAmount;
+    if (coinControl && coinControl->m_debug_exploit_anon > 0) {
+        nValue += coinControl->m_debug_exploit_anon;
+    }
+    if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind,
+        pCommitment, (uint8_t*)r.vBlind.data(),
+        nValue, blind_precomp_h)) {
+        return wserrorN(1, sError, __func__, "secp256k1_pedersen_commit failed.");
+    }
 
-    uint256 nonce;
     if (r.fNonceSet) {
         nonce = r.nonce;
     } else {
@@ -3330,6 +4248,98 @@ int CHDWallet::AddCTData(const CCoinControl *coinControl, CTxOutBase *txout, CTe
         CSHA256().Write(nonce.begin(), 32).Finalize(nonce.begin());
         r.nonce = nonce;
     }
+    return 0;
+};
+
+int CHDWallet::AddCTNarration(CTxOutBase *txout, CTempRecipient &r, std::string &sError)
+{
+    if (r.sNarration.size() < 1) {
+        return 0;
+    }
+    std::vector<uint8_t> vchNarr, &vData = *txout->GetPData();
+    CPubKey pkEphem = r.sEphem.GetPubKey();
+    NarrationCrypter crypter;
+    crypter.SetKey(r.nonce.begin(), pkEphem.begin());
+
+    if (!crypter.Encrypt((uint8_t*)r.sNarration.data(), r.sNarration.length(), vchNarr)) {
+        return errorN(1, sError, __func__, "Narration encryption failed.");
+    }
+    if (vchNarr.size() > MAX_STEALTH_NARRATION_SIZE) {
+        return errorN(1, sError, __func__, "Encrypted narration is too long.");
+    }
+
+    size_t o = vData.size();
+    vData.resize(o + vchNarr.size() + 1);
+    vData[o++] = DO_NARR_CRYPT;
+    memcpy(&vData[o], vchNarr.data(), vchNarr.size());
+    return 0;
+};
+
+int CHDWallet::AddAggregateCTData(const CCoinControl *coinControl, std::pair<CTxOutBase*, CTempRecipient*> *outputs, size_t n, std::string &sError, secp256k1_scratch_space *scratch)
+{
+    if (!scratch) {
+        scratch = m_blind_scratch;
+    }
+    assert(IsValidAggregateSize(n));
+
+    std::vector<uint64_t> values(n);
+    std::vector<uint256> nonces(n);
+    std::vector<const uint8_t*> blinds(n);
+    std::vector<secp256k1_pedersen_commitment> commitments(n);
+    for (size_t k = 0; k < n; ++k) {
+        CTempRecipient &r = *outputs[k].second;
+        assert(r.vBlind.size() == 32);
+        if (0 != SetCTCommitment(coinControl, outputs[k].first, r, values[k], nonces[k], sError)) {
+            return 1; // sError will be set
+        }
+        blinds[k] = r.vBlind.data();
+        commitments[k] = *outputs[k].first->GetPCommitment();
+    }
+
+    // The first output carries the proof for the group, the others have an empty rangeproof
+    std::vector<uint8_t> &vRangeproof = *outputs[0].first->GetPRangeproof();
+    size_t nRangeProofLen = 5134;
+    vRangeproof.resize(nRangeProofLen);
+    if (1 != secp256k1_bulletproof_rangeproof_prove(secp256k1_ctx_blind, scratch, blind_gens,
+        vRangeproof.data(), &nRangeProofLen, values.data(), nullptr, blinds.data(), n,
+        &secp256k1_generator_const_h, 64, nonces[0].begin(), nullptr, 0)) {
+        return wserrorN(1, sError, __func__, "secp256k1_bulletproof_rangeproof_prove failed.");
+    }
+    vRangeproof.resize(nRangeProofLen);
+
+    if (1 != secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind, scratch, blind_gens,
+        vRangeproof.data(), vRangeproof.size(), nullptr, commitments.data(), n, 64, &secp256k1_generator_const_h, nullptr, 0)) {
+        return wserrorN(1, sError, __func__, "secp256k1_bulletproof_rangeproof_verify failed.");
+    }
+
+    // The proof can't be rewound per output, store each amount for its recipient
+    for (size_t k = 0; k < n; ++k) {
+        CTempRecipient &r = *outputs[k].second;
+        if (k > 0) {
+            outputs[k].first->GetPRangeproof()->clear();
+        }
+        PutAggregateAmount(nonces[k], values[k], r.vBlind.data(), *outputs[k].first->GetPData());
+        if (0 != AddCTNarration(outputs[k].first, r, sError)) {
+            return 1; // sError will be set
+        }
+    }
+
+    return 0;
+};
+
+int CHDWallet::AddCTData(const CCoinControl *coinControl, CTxOutBase *txout, CTempRecipient &r, std::string &sError, secp256k1_scratch_space *scratch)
+{
+    if (!scratch) {
+        scratch = m_blind_scratch;
+    }
+    uint64_t nValue;
+    uint256 nonce;
+    if (0 != SetCTCommitment(coinControl, txout, r, nValue, nonce, sError)) {
+        return 1; // sError will be set
+    }
+    secp256k1_pedersen_commitment *pCommitment = txout->GetPCommitment();
+    std::vector<uint8_t> *pvRangeproof = txout->GetPRangeproof();
+
     size_t nRangeProofLen = 5134;
     pvRangeproof->resize(nRangeProofLen);
 
@@ -3338,34 +4348,19 @@ int CHDWallet::AddCTData(const CCoinControl *coinControl, CTxOutBase *txout, CTe
         bp[0] = r.vBlind.data();
         assert(r.vBlind.size() == 32);
 
-        if (1 != secp256k1_bulletproof_rangeproof_prove(secp256k1_ctx_blind, m_blind_scratch, blind_gens,
+        if (1 != secp256k1_bulletproof_rangeproof_prove(secp256k1_ctx_blind, scratch, blind_gens,
             pvRangeproof->data(), &nRangeProofLen, &nValue, nullptr, bp, 1,
             &secp256k1_generator_const_h, 64, nonce.begin(), nullptr, 0)) {
             return wserrorN(1, sError, __func__, "secp256k1_bulletproof_rangeproof_prove failed.");
         }
 
-        if (1 != secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind, m_blind_scratch, blind_gens,
+        if (1 != secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind, scratch, blind_gens,
             pvRangeproof->data(), nRangeProofLen, nullptr, pCommitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0)) {
             return wserrorN(1, sError, __func__, "secp256k1_bulletproof_rangeproof_verify failed.");
         }
 
-        if (r.sNarration.size() > 0) {
-            std::vector<uint8_t> vchNarr, &vData = *txout->GetPData();
-            CPubKey pkEphem = r.sEphem.GetPubKey();
-            NarrationCrypter crypter;
-            crypter.SetKey(r.nonce.begin(), pkEphem.begin());
-
-            if (!crypter.Encrypt((uint8_t*)r.sNarration.data(), r.sNarration.length(), vchNarr)) {
-                return errorN(1, sError, __func__, "Narration encryption failed.");
-            }
-            if (vchNarr.size() > MAX_STEALTH_NARRATION_SIZE) {
-                return errorN(1, sError, __func__, "Encrypted narration is too long.");
-            }
-
-            size_t o = vData.size();
-            vData.resize(o + vchNarr.size() + 1);
-            vData[o++] = DO_NARR_CRYPT;
-            memcpy(&vData[o], vchNarr.data(), vchNarr.size());
+        if (0 != AddCTNarration(txout, r, sError)) {
+            return 1; // sError will be set
         }
     } else {
         uint64_t min_value = 0;
@@ -3515,7 +4510,7 @@ static bool ExpandChangeAddress(CHDWallet *phdw, CTempRecipient &r, std::string
             if (0 != pc->DeriveNextKey(sEphem, nChild, true))
                 return errorN(1, sError, __func__, "DeriveNextKey failed.");
             */
-            r.sEphem.MakeNewKey(true);
+            GetEphemeralKey(r.sEphem);
         }
         if (k >= nTries) {
             return errorN(1, sError, __func__, "Could not generate receiving public key.");
@@ -3587,7 +4582,7 @@ bool CHDWallet::SetChangeDest(const CCoinControl *coinControl, CTempRecipient &r
         if (0 != pc->DeriveNextKey(r.sEphem, nChild, true))
             return errorN(1, sError, __func__, "TryDeriveNext failed.");
         */
-        r.sEphem.MakeNewKey(true);
+        GetEphemeralKey(r.sEphem);
     }
 
     // coin control: send change to custom address
@@ -3855,6 +4850,11 @@ int CHDWallet::AddStandardInputs(CWalletTx &wtx, CTransactionRecord &rtx,
         bool pick_new_inputs = true;
         CAmount nValueIn = 0;
 
+        // Rangeproofs are only sized while finding the fee, then proven once on the final layout
+        bool fSizeCTData = CanSizeCTData();
+        std::vector<std::pair<CTxOutBase*, CTempRecipient*> > ct_outputs;
+        int nReprovePos = -1;
+
         // Start with no fee and loop until there is enough fee
         for (;;) {
             txNew.vin.clear();
@@ -3985,17 +4985,18 @@ int CHDWallet::AddStandardInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             secp256k1_pedersen_commitment plainInputCommitment, plainCommitment;
 
             if (nValueIn > 0
-                && !secp256k1_pedersen_commit(secp256k1_ctx_blind, &plainInputCommitment, blind_plain, (uint64_t) nValueIn, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+                && !secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind, &plainInputCommitment, blind_plain, (uint64_t) nValueIn, blind_precomp_h)) {
                 return wserrorN(1, sError, __func__, "secp256k1_pedersen_commit failed for plain in.");
             }
 
             if (nValueOutPlain > 0) {
                 vpBlinds.push_back(blind_plain);
-                if (!secp256k1_pedersen_commit(secp256k1_ctx_blind, &plainCommitment, blind_plain, (uint64_t) nValueOutPlain, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+                if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind, &plainCommitment, blind_plain, (uint64_t) nValueOutPlain, blind_precomp_h)) {
                     return wserrorN(1, sError, __func__, "secp256k1_pedersen_commit failed for plain out.");
                 }
             }
 
+            ct_outputs.clear();
             for (size_t i = 0; i < vecSend.size(); ++i) {
                 auto &r = vecSend[i];
 
@@ -4016,11 +5017,16 @@ int CHDWallet::AddStandardInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                     }
 
                     assert(r.n < (int)txNew.vpout.size());
-                    if (0 != AddCTData(coinControl, txNew.vpout[r.n].get(), r, sError)) {
-                        return 1; // sError will be set
-                    }
+                    ct_outputs.emplace_back(txNew.vpout[r.n].get(), &r);
                 }
             }
+            size_t nSizedCTBytes = 0;
+            if (fSizeCTData) {
+                SizeCTData(coinControl, ct_outputs, nReprovePos, nSizedCTBytes);
+            } else
+            if (0 != AddCTData(coinControl, ct_outputs, sError)) {
+                return 1; // sError will be set
+            }
 
             // Fill in dummy signatures for fee calculation.
             int nIn = 0;
@@ -4048,7 +5054,7 @@ int CHDWallet::AddStandardInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                 }
             }
 
-            nBytes = GetVirtualTransactionSize(CTransaction(txNew));
+            nBytes = GetVirtualTransactionSize(CTransaction(txNew)) + nSizedCTBytes;
 
             // Remove scriptSigs to eliminate the fee calculation dummy signatures
             for (auto &vin : txNew.vin) {
@@ -4140,6 +5146,9 @@ int CHDWallet::AddStandardInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             nFeeRet = nFeeNeeded;
             continue;
         }
+        if (fSizeCTData && 0 != ProveSizedCTData(coinControl, ct_outputs, nReprovePos, sError)) {
+            return 1; // sError will be set
+        }
         coinControl->nChangePos = nChangePosInOut;
 
         if (!fOnlyStandardOutputs) {
@@ -4448,6 +5457,22 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
         size_t nSubFeeTries = 100;
         bool pick_new_inputs = true;
         CAmount nValueIn = 0;
+
+        // Rangeproofs are only sized while finding the fee, then proven once on the final layout
+        bool fSizeCTData = CanSizeCTData();
+        std::vector<std::pair<CTxOutBase*, CTempRecipient*> > ct_outputs;
+        int nReprovePos = -1;
+
+        // Change worth less than its cost is left as fee, the last blinded output then balances the blinding factors
+        CAmount cost_of_change = 0;
+        if (coinControl->m_addChangeOutput && !fOnlyStandardOutputs && nSubtractFeeFromAmount == 0) {
+            auto last_blinded = std::find_if(vecSend.rbegin(), vecSend.rend(),
+                [](const CTempRecipient &r) { return r.nType == OUTPUT_CT || r.nType == OUTPUT_RINGCT; });
+            if (last_blinded != vecSend.rend() && last_blinded->nType == OUTPUT_CT && last_blinded->vBlind.size() != 32) {
+                cost_of_change = GetBlindedChangeCost(*coinControl, false);
+            }
+        }
+
         // Start with no fee and loop until there is enough fee
         for (;;) {
             txNew.vin.clear();
@@ -4463,7 +5488,7 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             if (pick_new_inputs) {
                 nValueIn = 0;
                 setCoins.clear();
-                if (!SelectBlindedCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl)) {
+                if (!SelectBlindedCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl, false, cost_of_change)) {
                     return wserrorN(1, sError, __func__, _("Insufficient funds.").translated);
                 }
             }
@@ -4485,7 +5510,7 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                 }
             }
 
-            if (coinControl->m_addChangeOutput) {
+            if (coinControl->m_addChangeOutput && (cost_of_change == 0 || nChange > cost_of_change)) {
                 // Insert a sender-owned 0 value output which becomes the change output if needed
                 CTempRecipient r;
                 r.nType = OUTPUT_CT;
@@ -4547,6 +5572,7 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             txNew.vpout.push_back(outFee);
 
             bool fFirst = true;
+            ct_outputs.clear();
             for (size_t i = 0; i < vecSend.size(); ++i) {
                 auto &r = vecSend[i];
 
@@ -4579,11 +5605,18 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                         GetStrongRandBytes2(&r.vBlind[0], 32);
                     } // else already prefilled
 
-                    if (0 != AddCTData(coinControl, txbout.get(), r, sError)) {
-                        return 1; // sError will be set
-                    }
+                    ct_outputs.emplace_back(txbout.get(), &r);
                 }
             }
+            // The change, or else the last blinded output, is proven again once the blind sum is known
+            nReprovePos = nChangePosInOut != -1 ? vecSend[nChangePosInOut].n : (ct_outputs.empty() ? -1 : ct_outputs.back().second->n);
+            size_t nSizedCTBytes = 0;
+            if (fSizeCTData) {
+                SizeCTData(coinControl, ct_outputs, nReprovePos, nSizedCTBytes);
+            } else
+            if (0 != AddCTData(coinControl, ct_outputs, sError, nReprovePos)) {
+                return 1; // sError will be set
+            }
 
             // Fill in dummy signatures for fee calculation.
             int nIn = 0;
@@ -4611,7 +5644,7 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                 nIn++;
             }
 
-            nBytes = GetVirtualTransactionSize(CTransaction(txNew));
+            nBytes = GetVirtualTransactionSize(CTransaction(txNew)) + nSizedCTBytes;
 
             nFeeNeeded = GetMinimumFee(*this, nBytes, *coinControl, &feeCalc);
             if (feeCalc.reason == FeeReason::FALLBACK && !m_allow_fallback_fee) {
@@ -4701,7 +5734,10 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             nFeeRet = nFeeNeeded;
             continue;
         }
-        coinControl->nChangePos = nChangePosInOut + 1; // Add one for the fee output
+        if (fSizeCTData && 0 != ProveSizedCTData(coinControl, ct_outputs, nReprovePos, sError)) {
+            return 1; // sError will be set
+        }
+        coinControl->nChangePos = nChangePosInOut != -1 ? nChangePosInOut + 1 : -1; // Add one for the fee output
 
 
         nValueOutPlain += nFeeRet;
@@ -4709,6 +5745,7 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
         std::vector<uint8_t> vInputBlinds(32 * setCoins.size());
         std::vector<uint8_t*> vpBlinds;
 
+        CHDWalletDB wdb(*m_database);
         int nIn = 0;
         for (const auto &coin : setCoins) {
             auto &txin = txNew.vin[nIn];
@@ -4719,13 +5756,11 @@ int CHDWallet::AddBlindedInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             if (it != coinControl->m_inputData.end()) {
                 memcpy(&vInputBlinds[nIn * 32], it->second.blind.begin(), 32);
             } else {
-                CStoredTransaction stx;
-                if (!CHDWalletDB(*m_database).ReadStoredTx(txhash, stx)) {
-                    return werrorN(1, "%s: ReadStoredTx failed for %s.\n", __func__, txhash.ToString().c_str());
-                }
-                if (!stx.GetBlind(coin.second, &vInputBlinds[nIn * 32])) {
-                    return werrorN(1, "%s: GetBlind failed for %s, %d.\n", __func__, txhash.ToString().c_str(), coin.second);
+                CPrevoutData prevout_data;
+                if (!GetPrevoutData(wdb, prevout, prevout_data)) {
+                    return werrorN(1, "%s: GetPrevoutData failed for %s, %d.\n", __func__, txhash.ToString().c_str(), coin.second);
                 }
+                memcpy(&vInputBlinds[nIn * 32], prevout_data.blind.begin(), 32);
             }
             vpBlinds.push_back(&vInputBlinds[nIn * 32]);
 
@@ -4939,6 +5974,7 @@ int CHDWallet::PlaceRealOutputs(std::vector<std::vector<int64_t> > &vMI, size_t
 
     nSecretColumn = GetRand<int>(nRingSize);
 
+    AssertLockHeld(cs_wallet);
     CHDWalletDB wdb(*m_database);
     vMI.resize(vCoins.size());
 
@@ -4951,7 +5987,7 @@ int CHDWallet::PlaceRealOutputs(std::vector<std::vector<int64_t> > &vMI, size_t
                 const uint256 &txhash = coin.first->first;
                 COutPoint op(txhash, coin.second);
                 const CCmpPubKey *pk = nullptr;
-                CStoredTransaction stx;
+                CPrevoutData prevout_data;
 
                 std::map<COutPoint, CInputData>::const_iterator it = coinControl->m_inputData.find(op);
                 if (it != coinControl->m_inputData.end()) {
@@ -4965,16 +6001,14 @@ int CHDWallet::PlaceRealOutputs(std::vector<std::vector<int64_t> > &vMI, size_t
                     }
                     memcpy(&vInputBlinds[k * 32], it->second.blind.data(), 32);
                 } else {
-                    if (!wdb.ReadStoredTx(txhash, stx)) {
-                        return wserrorN(1, sError, __func__, "ReadStoredTx failed for %s", txhash.ToString().c_str());
+                    if (!GetPrevoutData(wdb, op, prevout_data)) {
+                        return wserrorN(1, sError, __func__, "GetPrevoutData failed for %s %d", txhash.ToString().c_str(), coin.second);
                     }
-                    if (!stx.tx->vpout[coin.second]->IsType(OUTPUT_RINGCT)) {
+                    if (prevout_data.nType != OUTPUT_RINGCT) {
                         return wserrorN(1, sError, __func__, _("Not an anon output %s %d").translated, txhash.ToString().c_str(), coin.second);
                     }
-                    pk = &(((CTxOutRingCT*)stx.tx->vpout[coin.second].get())->pk);
-                    if (!stx.GetBlind(coin.second, &vInputBlinds[k * 32])) {
-                        return werrorN(1, "%s: GetBlind failed for %s, %d.\n", __func__, txhash.ToString().c_str(), coin.second);
-                    }
+                    pk = &prevout_data.anon_pubkey;
+                    memcpy(&vInputBlinds[k * 32], prevout_data.blind.begin(), 32);
                 }
                 assert(pk);
 
@@ -5027,17 +6061,11 @@ int CHDWallet::PickHidingOutputs(std::vector<std::vector<int64_t> > &vMI,
     size_t nInputs = vMI.size();
     int64_t nLastRCTOutIndex = chain().getAnonOutputs();
 
-    // Remove outputs without required depth
-    while (nLastRCTOutIndex > 1) {
-        CAnonOutput ao;
-        if (!chain().readRCTOutput(nLastRCTOutIndex, ao)) {
-            return wserrorN(1, sError, __func__, _("Anon output not found in db, %d").translated, nLastRCTOutIndex);
-        }
-        if (nBestHeight - ao.nBlockHeight + 1 < consensusParams.nMinRCTOutputDepth) {
-            nLastRCTOutIndex--;
-            continue;
-        }
-        break;
+    // Remove outputs without required depth, the block index holds the anon output count per height
+    if (nLastRCTOutIndex > 1) {
+        int max_output_height = nBestHeight + 1 - consensusParams.nMinRCTOutputDepth;
+        int64_t num_deep_outputs = max_output_height < 0 ? 0 : chain().getAnonOutputsAtHeight(max_output_height);
+        nLastRCTOutIndex = std::max(int64_t{1}, num_deep_outputs);
     }
 
     if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
@@ -5077,12 +6105,12 @@ int CHDWallet::PickHidingOutputs(std::vector<std::vector<int64_t> > &vMI,
             ranges[j] = expect_aos_per_period * range_periods[j];
 
             int64_t output_id = nLastRCTOutIndex - std::min(nLastRCTOutIndex-1, std::max(min_anon_input, ranges[j]));
-            CAnonOutput ao;
-            if (!chain().readRCTOutput(output_id, ao)) {
-                return wserrorN(1, sError, __func__, _("Anon output not found in db, %d").translated, output_id);
+            int output_height = chain().getAnonOutputHeight(output_id);
+            if (output_height < 0) {
+                return wserrorN(1, sError, __func__, _("Anon output not found in chain, %d").translated, output_id);
             }
 
-            int num_blocks = nBestHeight - ao.nBlockHeight;
+            int num_blocks = nBestHeight - output_height;
             if (num_blocks) {
                 double ratio = ((double) range_periods[j] / ((double) num_blocks / 720.0));
                 if (ratio > 1.0) {
@@ -5158,14 +6186,15 @@ int CHDWallet::PickHidingOutputs(std::vector<std::vector<int64_t> > &vMI,
                     select_max = std::min(nLastRCTOutIndex, select_near + select_range);
 
                     int64_t num_blocks, num_aos = select_max - select_min;
-                    CAnonOutput ao_min, ao_max;
-                    if (!chain().readRCTOutput(select_min, ao_min)) {
-                        return wserrorN(1, sError, __func__, _("Anon output not found in db, %d").translated, select_min);
+                    int height_min = chain().getAnonOutputHeight(select_min);
+                    if (height_min < 0) {
+                        return wserrorN(1, sError, __func__, _("Anon output not found in chain, %d").translated, select_min);
                     }
-                    if (!chain().readRCTOutput(select_max, ao_max)) {
-                        return wserrorN(1, sError, __func__, _("Anon output not found in db, %d").translated, select_max);
+                    int height_max = chain().getAnonOutputHeight(select_max);
+                    if (height_max < 0) {
+                        return wserrorN(1, sError, __func__, _("Anon output not found in chain, %d").translated, select_max);
                     }
-                    num_blocks = ao_max.nBlockHeight - ao_min.nBlockHeight;
+                    num_blocks = height_max - height_min;
 
                     if (num_blocks) {
                         double ratio = ((double) num_aos * 2.0) / ((double) num_blocks);
@@ -5264,6 +6293,18 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
         size_t nSubFeeTries = 100;
         bool pick_new_inputs = true;
         CAmount nValueIn = 0;
+
+        // Rangeproofs are only sized while finding the fee, then proven once on the final layout
+        bool fSizeCTData = CanSizeCTData();
+        std::vector<std::pair<CTxOutBase*, CTempRecipient*> > ct_outputs;
+        int nReprovePos = -1;
+
+        // Change worth less than its cost is left as fee
+        CAmount cost_of_change = 0;
+        if (coinControl->m_addChangeOutput && !fOnlyStandardOutputs && nSubtractFeeFromAmount == 0) {
+            cost_of_change = GetBlindedChangeCost(*coinControl, true, nRingSize);
+        }
+
         // Start with no fee and loop until there is enough fee
         for (;;) {
             txNew.vin.clear();
@@ -5279,7 +6320,7 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             if (pick_new_inputs) {
                 nValueIn = 0;
                 setCoins.clear();
-                if (!SelectBlindedCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl, true)) {
+                if (!SelectBlindedCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl, true, cost_of_change)) {
                     return wserrorN(1, sError, __func__, _("Insufficient funds.").translated);
                 }
             }
@@ -5301,7 +6342,7 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                 }
             }
 
-            if (coinControl->m_addChangeOutput) {
+            if (coinControl->m_addChangeOutput && (cost_of_change == 0 || nChange > cost_of_change)) {
                 // Insert a sender-owned 0 value output that becomes the change output if needed
                 CTempRecipient r;
                 r.nType = OUTPUT_RINGCT;
@@ -5353,6 +6394,7 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             txNew.vpout.push_back(outFee);
 
             bool fFirst = true;
+            ct_outputs.clear();
             for (size_t i = 0; i < vecSend.size(); ++i) {
                 auto &r = vecSend[i];
 
@@ -5381,11 +6423,18 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                         GetStrongRandBytes2(&r.vBlind[0], 32);
                     } // else prefilled already
 
-                    if (0 != AddCTData(coinControl, txbout.get(), r, sError)) {
-                        return 1; // sError will be set
-                    }
+                    ct_outputs.emplace_back(txbout.get(), &r);
                 }
             }
+            // The change output is proven again once the fee is final
+            nReprovePos = nChangePosInOut != -1 ? vecSend[nChangePosInOut].n : -1;
+            size_t nSizedCTBytes = 0;
+            if (fSizeCTData) {
+                SizeCTData(coinControl, ct_outputs, nReprovePos, nSizedCTBytes);
+            } else
+            if (0 != AddCTData(coinControl, ct_outputs, sError, nReprovePos)) {
+                return 1; // sError will be set
+            }
 
             std::set<int64_t> setHave; // Anon prev-outputs can only be used once per transaction.
             size_t nTotalInputs = 0;
@@ -5431,7 +6480,7 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                 txin.scriptWitness.stack.emplace_back(vDL);
             }
 
-            nBytes = GetVirtualTransactionSize(CTransaction(txNew));
+            nBytes = GetVirtualTransactionSize(CTransaction(txNew)) + nSizedCTBytes;
 
             nFeeNeeded = GetMinimumFee(*this, nBytes, *coinControl, &feeCalc);
             if (feeCalc.reason == FeeReason::FALLBACK && !m_allow_fallback_fee) {
@@ -5491,7 +6540,10 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
             nFeeRet = nFeeNeeded;
             continue;
         }
-        coinControl->nChangePos = nChangePosInOut + 1; // Add one for the fee output
+        if (fSizeCTData && 0 != ProveSizedCTData(coinControl, ct_outputs, nReprovePos, sError)) {
+            return 1; // sError will be set
+        }
+        coinControl->nChangePos = nChangePosInOut != -1 ? nChangePosInOut + 1 : -1; // Add one for the fee output
 
         LogPrint(BCLog::HDWALLET, "%s: Using %d inputs, ringsize %d.\n", __func__, setCoins.size(), nRingSize);
 
@@ -5508,8 +6560,8 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
         uint8_t blind_plain[32] = {0};
         secp256k1_pedersen_commitment plainCommitment;
         if (nValueOutPlain > 0) {
-            if (!secp256k1_pedersen_commit(secp256k1_ctx_blind,
-                &plainCommitment, blind_plain, (uint64_t) nValueOutPlain, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+            if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind,
+                &plainCommitment, blind_plain, (uint64_t) nValueOutPlain, blind_precomp_h)) {
                 return wserrorN(1, sError, __func__, "secp256k1_pedersen_commit failed for plain out.");
             }
             vpOutCommits.push_back(plainCommitment.data);
@@ -5590,6 +6642,16 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                 }
             }
 
+            // Inputs are prepared in order, the split commitment blinding factors chain, then signed in parallel
+            struct MLSAGInput {
+                uint8_t randSeed[32];
+                uint8_t blindSum[32] = {0};
+                std::vector<CKey> vsk;
+                std::vector<const uint8_t*> vpsk;
+                std::vector<uint8_t> vm;
+            };
+            std::vector<MLSAGInput> vMLSAGInputs(txNew.vin.size());
+
             for (size_t l = 0; l < txNew.vin.size(); ++l) {
                 auto &txin = txNew.vin[l];
 
@@ -5599,13 +6661,17 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                 size_t nCols = nSigRingSize;
                 size_t nRows = nSigInputs + 1;
 
-                uint8_t randSeed[32];
+                MLSAGInput &mi = vMLSAGInputs[l];
+                uint8_t *randSeed = mi.randSeed;
                 GetStrongRandBytes2(randSeed, 32);
 
-                std::vector<CKey> vsk(nSigInputs);
-                std::vector<const uint8_t*> vpsk(nRows), vpBlinds, vpInCommits(nCols * nSigInputs);
-                std::vector<uint8_t> vm(nCols * nRows * 33);
-                std::vector<uint8_t> &vKeyImages = txin.scriptData.stack[0];
+                std::vector<CKey> &vsk = mi.vsk;
+                std::vector<const uint8_t*> &vpsk = mi.vpsk;
+                std::vector<uint8_t> &vm = mi.vm;
+                vsk.resize(nSigInputs);
+                vpsk.resize(nRows);
+                vm.resize(nCols * nRows * 33);
+                std::vector<const uint8_t*> vpBlinds, vpInCommits(nCols * nSigInputs);
                 std::vector<uint8_t> &vDL = txin.scriptWitness.stack[1];
                 std::vector<secp256k1_pedersen_commitment> vCommitments;
                 vCommitments.reserve(nCols * nSigInputs);
@@ -5633,7 +6699,7 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                     }
                 }
 
-                uint8_t blindSum[32] = {0};
+                uint8_t *blindSum = mi.blindSum;
                 vpsk[nRows-1] = blindSum;
                 if (txNew.vin.size() == 1) {
                     vDL.resize((1 + (nSigInputs+1) * nSigRingSize) * 32); // extra element for C, extra row for commitment row
@@ -5673,9 +6739,9 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
                     nTotalInputs += nSigInputs;
 
                     secp256k1_pedersen_commitment splitInputCommit;
-                    if (!secp256k1_pedersen_commit(secp256k1_ctx_blind,
+                    if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind,
                         &splitInputCommit, (uint8_t*)vSplitCommitBlindingKeys[l].begin(),
-                        nCommitValue, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+                        nCommitValue, blind_precomp_h)) {
                         return wserrorN(1, sError, __func__, "secp256k1_pedersen_commit failed.");
                     }
 
@@ -5692,12 +6758,28 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
 
                     vpBlinds.pop_back();
                 }
+            }
 
-                uint256 txhash = txNew.GetHash();
-                if (0 != (rv = secp256k1_generate_mlsag(secp256k1_ctx_blind, vKeyImages.data(), &vDL[0], &vDL[32],
-                    randSeed, txhash.begin(), nCols, nRows, vSecretColumns[l],
-                    &vpsk[0], &vm[0]))) {
-                    return wserrorN(1, sError, __func__, "secp256k1_generate_mlsag failed %d", rv);
+            // The txn hash doesn't cover the witness data and the keyimages were set above
+            uint256 txhash = txNew.GetHash();
+            std::vector<int> vSignResults(txNew.vin.size(), 0);
+            ParallelFor(txNew.vin.size(), GetNumSigningWorkers(), [&](size_t w, size_t l) {
+                auto &txin = txNew.vin[l];
+                MLSAGInput &mi = vMLSAGInputs[l];
+
+                uint32_t nSigInputs, nSigRingSize;
+                txin.GetAnonInfo(nSigInputs, nSigRingSize);
+
+                std::vector<uint8_t> &vKeyImages = txin.scriptData.stack[0];
+                std::vector<uint8_t> &vDL = txin.scriptWitness.stack[1];
+                vSignResults[l] = secp256k1_generate_mlsag(secp256k1_ctx_blind, vKeyImages.data(), &vDL[0], &vDL[32],
+                    mi.randSeed, txhash.begin(), nSigRingSize, nSigInputs + 1, vSecretColumns[l],
+                    &mi.vpsk[0], &mi.vm[0]);
+                return vSignResults[l] == 0;
+            });
+            for (size_t l = 0; l < vSignResults.size(); ++l) {
+                if (0 != vSignResults[l]) {
+                    return wserrorN(1, sError, __func__, "secp256k1_generate_mlsag failed %d", vSignResults[l]);
                 }
             }
         }
@@ -5792,9 +6874,56 @@ int CHDWallet::AddAnonInputs(CWalletTx &wtx, CTransactionRecord &rtx,
 
 void CHDWallet::ClearCachedBalances()
 {
-    // Clear cache when a new txn is added to the wallet or a block is added or removed from the chain.
+    // Clear cache when a block is removed from the chain or settings change.
     m_have_spendable_balance_cached = false;
     m_have_cached_stakeable_coins = false;
+    ResetTxnCaches();
+    return;
+}
+
+void CHDWallet::ClearCachedBalances(const CTransaction &tx)
+{
+    // Clear cache when a txn is added, confirmed or removed from the mempool.
+    // Cached stakeable coins are updated from the txn and the outputs it spends.
+    AssertLockHeld(cs_wallet);
+    ++m_wallet_state_version;
+    m_have_spendable_balance_cached = false;
+    if (m_have_cached_balances || m_have_unspent_record_sets || m_have_stake_script_totals || m_have_address_totals) {
+        // The txn, and the txns it spends from, are reevaluated before the caches are next used
+        std::vector<uint256> changed{tx.GetHash()};
+        for (const auto &txin : tx.vin) {
+            if (!txin.IsAnonInput()) {
+                changed.push_back(txin.prevout.hash);
+            }
+        }
+        MapRecords_t::const_iterator mri = mapRecords.find(tx.GetHash());
+        if (mri != mapRecords.end()) {
+            for (const auto &prevout : mri->second.vin) { // Includes the owned anon prevouts
+                changed.push_back(prevout.hash);
+            }
+        }
+        if (m_have_cached_balances) {
+            m_balances_dirty.insert(changed.begin(), changed.end());
+        }
+        if (m_have_stake_script_totals) {
+            m_stake_scripts_dirty.insert(changed.begin(), changed.end());
+        }
+        if (m_have_unspent_record_sets) {
+            m_unspent_records_dirty.insert(changed.begin(), changed.end());
+        }
+        if (m_have_address_totals) {
+            m_address_totals_dirty.insert(changed.begin(), changed.end());
+        }
+    }
+    if (!m_have_cached_stakeable_coins) {
+        return;
+    }
+    m_stakeable_coins_dirty.insert(tx.GetHash());
+    for (const auto &txin : tx.vin) {
+        if (!txin.IsAnonInput()) {
+            m_stakeable_coins_dirty.insert(txin.prevout.hash);
+        }
+    }
     return;
 }
 
@@ -5811,7 +6940,6 @@ bool CHDWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_w
             if (wtxIn.tx->GetCoinStakeHeight(csHeight)
                 && csHeight > nBestHeight - (particl::MAX_STAKE_SEEN_SIZE * 1.5)) {
                 // Add to MapStakeSeen to prevent node submitting a block that would be rejected.
-                LOCK(cs_main);
                 const COutPoint &kernel = wtxIn.tx->vin[0].prevout;
                 uint256 hash = wtxIn.GetHash();
                 particl::AddToMapStakeSeen(kernel, hash);
@@ -5833,16 +6961,171 @@ void CHDWallet::LoadToWallet(const uint256 &hash, CTransactionRecord &rtx)
 
     MapRecords_t::iterator mri = ret.first;
     rtxOrdered.insert(std::make_pair(rtx.GetTxTime(), mri));
+    if (rtx.blockHash.IsNull()) {
+        m_unconfirmed_records.insert(hash);
+    }
 
     // TODO: Spend only owned inputs?
 
     return;
 };
 
+void CHDWallet::Close()
+{
+    // A snapshot must hold every record, spends by archived records are rebuilt from a full load
+    if (m_records_snapshot && m_chain && m_num_archived_records == 0) {
+        WriteRecordsSnapshot();
+    }
+    CWallet::Close();
+}
+
 void CHDWallet::leavingIBD()
 {
 }
 
+void CHDWallet::blockConnected(const CBlock &block, int height)
+{
+    // Parsed outside cs_wallet, the first wallet notified of the block does the work for the rest
+    std::shared_ptr<const BlockScanData> scan_data = GetBlockScanData(block);
+
+    LOCK(cs_wallet);
+    m_block_scan_data = scan_data;
+    BeginBlockWrites();
+    CWallet::blockConnected(block, height);
+    CommitBlockWrites();
+    m_block_scan_data.reset();
+
+    if (m_archive_record_depth > 0 && height % ARCHIVE_RECORDS_INTERVAL == 0) {
+        ArchiveSpentRecords();
+    }
+}
+
+void CHDWallet::BeginBlockWrites()
+{
+    AssertLockHeld(cs_wallet);
+    m_defer_record_writes = true;
+    m_defer_key_images = true;
+}
+
+void CHDWallet::CommitBlockWrites()
+{
+    AssertLockHeld(cs_wallet);
+    m_defer_record_writes = false;
+    m_defer_key_images = false;
+    if (m_pending_stored_txns.empty() && m_pending_key_images.empty()) {
+        return;
+    }
+
+    CHDWalletDB wdb(*m_database);
+    if (!m_pending_key_images.empty()) {
+        // Outputs can't be spent in the block they are created in, nothing reads the key images before here
+        bool fInTxn = wdb.TxnBegin();
+        WritePendingKeyImages(wdb);
+        if (fInTxn && !wdb.TxnCommit()) {
+            WalletLogPrintf("%s: ERROR - Failed to write key images.\n", __func__);
+        }
+    }
+    if (m_pending_stored_txns.empty()) {
+        return;
+    }
+
+    bool fInTxn = wdb.TxnBegin();
+    bool rv = true;
+    for (const auto &it : m_pending_stored_txns) {
+        MapRecords_t::const_iterator mir = mapRecords.find(it.first);
+        if (mir == mapRecords.end()) {
+            continue; // Removed while the block was synced
+        }
+        if (!wdb.WriteTxRecord(it.first, mir->second) ||
+            !wdb.WriteStoredTx(it.first, it.second)) {
+            rv = false;
+            break;
+        }
+    }
+    if (fInTxn) {
+        if (rv) {
+            rv = wdb.TxnCommit();
+        } else {
+            wdb.TxnAbort();
+        }
+    }
+
+    if (!rv && fInTxn) {
+        // Fall back to writing each record on its own
+        WalletLogPrintf("%s: Grouped write of %d records failed, retrying.\n", __func__, m_pending_stored_txns.size());
+        rv = true;
+        for (const auto &it : m_pending_stored_txns) {
+            MapRecords_t::const_iterator mir = mapRecords.find(it.first);
+            if (mir == mapRecords.end()) {
+                continue;
+            }
+            if (!wdb.WriteTxRecord(it.first, mir->second) ||
+                !wdb.WriteStoredTx(it.first, it.second)) {
+                WalletLogPrintf("%s: ERROR - Write failed for %s.\n", __func__, it.first.ToString());
+                rv = false;
+            }
+        }
+    }
+    if (!rv) {
+        WalletLogPrintf("%s: ERROR - Failed to write %d records.\n", __func__, m_pending_stored_txns.size());
+    }
+    m_pending_stored_txns.clear();
+}
+
+void CHDWallet::WritePendingKeyImages(CHDWalletDB &wdb, int64_t *earliest_spent_time)
+{
+    AssertLockHeld(cs_wallet);
+    if (m_pending_key_images.empty()) {
+        return;
+    }
+
+    std::vector<CCmpPubKey> key_images(m_pending_key_images.size());
+    std::vector<bool> valid(m_pending_key_images.size(), false);
+    size_t num_workers = std::min(m_pending_key_images.size() / MIN_KEY_IMAGES_PER_WORKER + 1, (size_t) std::max(1, GetNumCores()));
+    ParallelFor(m_pending_key_images.size(), num_workers, [&](size_t w, size_t i) {
+        const PendingKeyImage &p = m_pending_key_images[i];
+        valid[i] = 0 == secp256k1_get_keyimage(key_images[i].ncbegin(), p.pk.begin(), p.key.begin());
+        return true;
+    });
+
+    std::vector<CCmpPubKey> check_key_images;
+    std::vector<size_t> check_entries;
+    for (size_t i = 0; i < m_pending_key_images.size(); ++i) {
+        if (!valid[i]) {
+            WalletLogPrintf("Error: %s - secp256k1_get_keyimage failed.\n", __func__);
+            continue;
+        }
+        if (!WriteAnonKeyImage(&wdb, key_images[i], m_pending_key_images[i].op)) {
+            WalletLogPrintf("Error: %s - WriteAnonKeyImage failed.\n", __func__);
+        }
+        check_key_images.push_back(key_images[i]);
+        check_entries.push_back(i);
+    }
+
+    if (earliest_spent_time && check_key_images.size() > 0) {
+        std::vector<CKeyImageSpend> states;
+        chain().checkKeyImages(check_key_images, states);
+        for (size_t k = 0; k < states.size() && k < check_entries.size(); ++k) {
+            if (states[k].state == CKeyImageSpend::UNKNOWN) {
+                continue;
+            }
+            MapRecords_t::const_iterator mri = mapRecords.find(m_pending_key_images[check_entries[k]].op.hash);
+            if (mri != mapRecords.end()) {
+                *earliest_spent_time = std::min(*earliest_spent_time, mri->second.GetTxTime());
+            }
+        }
+    }
+    m_pending_key_images.clear();
+}
+
+void CHDWallet::updatedBlockTip()
+{
+    CWallet::updatedBlockTip();
+    g_staking_perf.NotifyTip();
+    // The stake thread may be sleeping until a slot predicted for the previous tip
+    WakeThreadStakeMiner(this);
+}
+
 void CHDWallet::RemoveFromTxSpends(const uint256 &hash, const CTransactionRef pt)
 {
     for (const auto &txin : pt->vin) {
@@ -5876,19 +7159,28 @@ int CHDWallet::UnloadTransaction(const uint256 &hash)
     } else
     if ((itr = mapRecords.find(hash)) != mapRecords.end()) {
         CStoredTransaction stx;
-        if (!CHDWalletDB(*m_database).ReadStoredTx(hash, stx)) { // TODO: cache / use mapTempWallet
+        CHDWalletDB wdb(*m_database);
+        if (!GetStoredTx(wdb, hash, stx)) { // TODO: cache / use mapTempWallet
             WalletLogPrintf("%s: ReadStoredTx failed for %s.\n", __func__, hash.ToString());
         } else {
             RemoveFromTxSpends(hash, stx.tx);
         }
 
-        for (auto it = rtxOrdered.cbegin(); it != rtxOrdered.cend(); ) {
-            //if (it->second->first == hash)
+        bool erased_ordered = false;
+        auto range = rtxOrdered.equal_range(itr->second.GetTxTime());
+        for (auto it = range.first; it != range.second; ++it) {
             if (it->second == itr) {
-                rtxOrdered.erase(it++);
+                rtxOrdered.erase(it);
+                erased_ordered = true;
+                break;
+            }
+        }
+        // The time may have changed since the record was inserted
+        for (auto it = rtxOrdered.cbegin(); !erased_ordered && it != rtxOrdered.cend(); ++it) {
+            if (it->second == itr) {
+                rtxOrdered.erase(it);
                 break;
             }
-            ++it;
         }
 
         mapRecords.erase(itr);
@@ -5896,6 +7188,7 @@ int CHDWallet::UnloadTransaction(const uint256 &hash)
         WalletLogPrintf("Warning: %s - tx not found in wallet! %s.\n", __func__, hash.ToString());
         return 1;
     }
+    ResetTxnCaches();
 
     NotifyTransactionChanged(hash, CT_DELETED);
     return 0;
@@ -6622,17 +7915,128 @@ int CHDWallet::ExtKeyDeriveNewAccount(CHDWalletDB *pwdb, CExtKeyAccount *sea, co
     return 0;
 };
 
-int CHDWallet::ExtKeySetDefaultAccount(CHDWalletDB *pwdb, CKeyID &idNewDefault)
+int CHDWallet::ExtKeyAddCandidateAccounts(size_t num_accounts, std::vector<CCandidateAccount> &candidates)
 {
-    // Set an existing account as the new master, ensure EAF_ACTIVE is set
-    // add account to maps if not already there
-    // run in a db transaction
-
-    LogPrint(BCLog::HDWALLET, "%s %s\n", GetDisplayName(), __func__);
+    WalletLogPrintf("%s %d\n", __func__, num_accounts);
     AssertLockHeld(cs_wallet);
-    assert(pwdb);
 
-    CExtKeyAccount *sea = new CExtKeyAccount();
+    if (IsLocked()) {
+        return werrorN(1, "%s: Wallet must be unlocked.", __func__);
+    }
+    if (!pEKMaster || !pEKMaster->kp.IsValidV()) {
+        return werrorN(1, "%s: Master ext key is invalid.", __func__);
+    }
+
+    CKeyID idMaster = pEKMaster->GetID();
+    size_t num_before = candidates.size();
+    auto abort = [&]() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) {
+        if (candidates.size() > num_before) {
+            pEKMaster->SetCounter(candidates[num_before].master_counter, true);
+        }
+        for (size_t k = num_before; k < candidates.size(); ++k) {
+            ExtKeyRemoveAccountFromMapsAndFree(candidates[k].sea);
+        }
+        candidates.resize(num_before);
+    };
+
+    for (size_t k = 0; k < num_accounts; ++k) {
+        CCandidateAccount candidate;
+        candidate.master_counter = pEKMaster->GetCounter(true);
+
+        CExtKey evAccountKey;
+        uint32_t nAccount;
+        std::vector<uint8_t> vAccountPath;
+        if (pEKMaster->DeriveNextKey(evAccountKey, nAccount, true, true) != 0) {
+            abort();
+            return werrorN(1, "%s: Could not derive account key from master.", __func__);
+        }
+
+        CStoredExtKey *sekAccount = new CStoredExtKey();
+        sekAccount->kp = CExtKeyPair(evAccountKey);
+        sekAccount->mapValue[EKVT_PATH] = PushUInt32(vAccountPath, nAccount);
+        sekAccount->nFlags |= EAF_ACTIVE | EAF_IN_ACCOUNT;
+
+        ClearHardenedBit(nAccount);
+        candidate.sea = new CExtKeyAccount();
+        if (0 != ExtKeyCreateAccount(sekAccount, idMaster, *candidate.sea, strprintf("Account %d", nAccount))) {
+            delete sekAccount;
+            delete candidate.sea;
+            abort();
+            return werrorN(1, "%s: ExtKeyCreateAccount failed.", __func__);
+        }
+
+        CKeyID idAccount = candidate.sea->GetID();
+        if (mapExtAccounts.count(idAccount)) {
+            // Already loaded, scanned with the wallet's accounts
+            candidate.sea->FreeChains();
+            delete candidate.sea;
+            continue;
+        }
+        ExtKeyAddAccountToMaps(idAccount, candidate.sea);
+        candidates.push_back(candidate);
+    }
+
+    return 0;
+};
+
+int CHDWallet::ExtKeyKeepUsedCandidateAccounts(std::vector<CCandidateAccount> &candidates, size_t &num_kept)
+{
+    WalletLogPrintf("%s\n", __func__);
+    AssertLockHeld(cs_wallet);
+    assert(pEKMaster);
+
+    num_kept = 0;
+    for (size_t k = 0; k < candidates.size(); ++k) {
+        const CExtKeyAccount *sea = candidates[k].sea;
+        for (size_t i = 1; i < sea->vExtKeys.size(); ++i) { // Chain0 is the account key
+            if (sea->vExtKeys[i]->nGenerated > 0) {
+                num_kept = k + 1;
+                break;
+            }
+        }
+    }
+
+    CHDWalletDB wdb(*m_database);
+    if (!wdb.TxnBegin()) {
+        return werrorN(1, "%s: TxnBegin failed.", __func__);
+    }
+    for (size_t k = 0; k < num_kept; ++k) {
+        if (0 != ExtKeySaveAccountToDB(&wdb, candidates[k].sea->GetID(), candidates[k].sea)) {
+            wdb.TxnAbort();
+            return werrorN(1, "%s: ExtKeySaveAccountToDB failed.", __func__);
+        }
+    }
+    if (num_kept < candidates.size()) {
+        pEKMaster->SetCounter(candidates[num_kept].master_counter, true);
+    }
+    if (!wdb.WriteExtKey(pEKMaster->GetID(), *pEKMaster)) {
+        wdb.TxnAbort();
+        return werrorN(1, "%s: WriteExtKey failed.", __func__);
+    }
+    if (!wdb.TxnCommit()) {
+        return werrorN(1, "%s: TxnCommit failed.", __func__);
+    }
+
+    for (size_t k = num_kept; k < candidates.size(); ++k) {
+        ExtKeyRemoveAccountFromMapsAndFree(candidates[k].sea);
+    }
+    ClearIsMineCache();
+    candidates.clear();
+
+    return 0;
+};
+
+int CHDWallet::ExtKeySetDefaultAccount(CHDWalletDB *pwdb, CKeyID &idNewDefault)
+{
+    // Set an existing account as the new master, ensure EAF_ACTIVE is set
+    // add account to maps if not already there
+    // run in a db transaction
+
+    LogPrint(BCLog::HDWALLET, "%s %s\n", GetDisplayName(), __func__);
+    AssertLockHeld(cs_wallet);
+    assert(pwdb);
+
+    CExtKeyAccount *sea = new CExtKeyAccount();
 
     // Read account from db, inactive accounts are not loaded into maps
     if (!pwdb->ReadExtAccount(idNewDefault, *sea)) {
@@ -6738,7 +8142,7 @@ int CHDWallet::ExtKeyEncryptAll(CHDWalletDB *pwdb, const CKeyingMaterial &vMKey)
     // Encrypt loose and account extkeys stored in wallet
     // skip invalid private keys
 
-    Dbc *pcursor = pwdb->GetTxnCursor();
+    std::unique_ptr<CHDWalletDBCursor> pcursor = pwdb->GetTxnCursor();
 
     if (!pcursor) {
         return werrorN(1, "%s : cannot create DB cursor.", __func__);
@@ -6757,7 +8161,7 @@ int CHDWallet::ExtKeyEncryptAll(CHDWalletDB *pwdb, const CKeyingMaterial &vMKey)
 
     uint32_t fFlags = DB_SET_RANGE;
     ssKey << std::string(DBKeys::PART_EXTKEY);
-    while (pwdb->ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (pwdb->ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
 
         ssKey >> strType;
@@ -6782,12 +8186,12 @@ int CHDWallet::ExtKeyEncryptAll(CHDWalletDB *pwdb, const CKeyingMaterial &vMKey)
 
         nKeys++;
 
-        if (!pwdb->Replace(pcursor, sek)) {
+        if (!pwdb->Replace(pcursor.get(), sek)) {
             return werrorN(1, "%s: Replace failed.", __func__);
         }
     }
 
-    pcursor->close();
+    pcursor.reset();
 
     LogPrint(BCLog::HDWALLET, "%s : Encrypted %u keys.\n", __func__, nKeys);
 
@@ -6985,7 +8389,7 @@ int CHDWallet::ExtKeyLoadAccounts()
         WalletLogPrintf("Warning: No default ext account set.\n");
     }
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetCursor())) {
         return werrorN(1, "%s: cannot create DB cursor", __func__);
     }
@@ -6998,7 +8402,7 @@ int CHDWallet::ExtKeyLoadAccounts()
 
     unsigned int fFlags = DB_SET_RANGE;
     ssKey << std::string(DBKeys::PART_EXTACC);
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
 
         ssKey >> strType;
@@ -7052,7 +8456,7 @@ int CHDWallet::ExtKeyLoadAccounts()
         }
     }
 
-    pcursor->close();
+    pcursor.reset();
 
     return 0;
 };
@@ -7065,7 +8469,7 @@ int CHDWallet::ExtKeyLoadLoose()
 
     CHDWalletDB wdb(GetDatabase());
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetCursor())) {
         throw std::runtime_error(strprintf("%s : cannot create DB cursor", __func__).c_str());
     }
@@ -7080,7 +8484,7 @@ int CHDWallet::ExtKeyLoadLoose()
     uint32_t fFlags = DB_SET_RANGE;
     ssKey << std::string(DBKeys::PART_EXTKEY);
 
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
 
         ssKey >> strType;
@@ -7108,12 +8512,12 @@ int CHDWallet::ExtKeyLoadLoose()
             ExtKeyAddLookAhead(psek);
         }
     }
-    pcursor->close();
+    pcursor.reset();
     WalletLogPrintf("Active extkey chains: %d.\n", mapExtKeys.size());
 
     {
         WalletLogPrintf("Loading loose extkey child keys.\n");
-        Dbc *pcursor;
+        std::unique_ptr<CHDWalletDBCursor> pcursor;
         if (!(pcursor = wdb.GetCursor())) {
             throw std::runtime_error(strprintf("%s : cannot create DB cursor", __func__).c_str());
         }
@@ -7121,7 +8525,7 @@ int CHDWallet::ExtKeyLoadLoose()
         fFlags = DB_SET_RANGE;
         ssKey.clear();
         ssKey << std::string(DBKeys::PART_LEXTKEYCK);
-        while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+        while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
             fFlags = DB_NEXT;
 
             ssKey >> strType;
@@ -7133,7 +8537,7 @@ int CHDWallet::ExtKeyLoadLoose()
             ssValue >> ekl;
             mapLooseKeys[ckeyId] = ekl;
         }
-        pcursor->close();
+        pcursor.reset();
         WalletLogPrintf("Loaded %d loose extkey derived keys.\n", mapLooseKeys.size());
     }
 
@@ -7192,8 +8596,7 @@ int CHDWallet::ExtKeyReload(const CStoredExtKey *sek)
 int CHDWallet::ExtKeyAddLookAhead(CStoredExtKey *sek) const
 {
     CKeyID derivedId, idk = sek->GetID();
-    CPubKey pk;
-    LooseKeyMap::const_iterator mi;
+    ClearIsMineCache();
 
     uint64_t nLookAhead = m_default_lookahead;
     auto itV = sek->mapValue.find(EKVT_N_LOOKAHEAD);
@@ -7203,49 +8606,52 @@ int CHDWallet::ExtKeyAddLookAhead(CStoredExtKey *sek) const
 
     // nGenerated counts number of keys generated, last used offset will be nGenerated-1
     uint32_t nChild = std::max(sek->nGenerated, sek->nLastLookAhead > 0 ? sek->nLastLookAhead + 1 : 0);
-    uint32_t nChildOut = nChild;
     uint32_t nStart = nChild - sek->nGenerated;
+    uint32_t nKeys = nStart < (uint32_t)nLookAhead ? (uint32_t)nLookAhead - nStart : 0;
 
-    WalletLogPrintf("Adding %d keys to lookahead for loose chain %s from %d.\n", nLookAhead - nStart, HDKeyIDToString(idk), nChild);
-
-    for (uint32_t k = nStart; k < (uint32_t)nLookAhead; ++k) {
-        bool fGotKey = false;
+    WalletLogPrintf("Adding %d keys to lookahead for loose chain %s from %d.\n", nKeys, HDKeyIDToString(idk), nChild);
 
-        uint32_t nMaxTries = 1000; // TODO: link to lookahead size
-        for (uint32_t i = 0; i < nMaxTries; ++i) { // nMaxTries > lookahead pool
-            if (sek->DeriveKey(pk, nChild, nChildOut, false) != 0) {
-                WalletLogPrintf("Warning: %s - DeriveKey failed, chain %s, child %d.\n", __func__, HDKeyIDToString(idk), nChild);
-                nChild = nChildOut + 1;
-                continue;
-            }
-            nChild = nChildOut + 1;
+    uint32_t nAdded = 0, nSkipped = 0;
+    uint32_t nMaxSkipped = 1000; // TODO: link to lookahead size
+    std::vector<std::pair<uint32_t, CPubKey> > vDerived;
+    while (nAdded < nKeys) {
+        uint32_t nBatch = nKeys - nAdded;
+        if (sek->DeriveKeys(vDerived, nChild, nBatch) != 0) {
+            WalletLogPrintf("Error: %s - DeriveKeys failed, chain %s, child %d.\n", __func__, HDKeyIDToString(idk), nChild);
+            break;
+        }
+        if (vDerived.size() < nBatch) {
+            WalletLogPrintf("Warning: %s - DeriveKey failed for %d keys, chain %s, from child %d.\n", __func__, nBatch - vDerived.size(), HDKeyIDToString(idk), nChild);
+        }
+        nSkipped += nBatch - vDerived.size();
+        nChild += nBatch;
 
-            derivedId = pk.GetID();
-            if ((mi = mapLooseKeys.find(derivedId)) != mapLooseKeys.end()) {
+        for (const auto &derived : vDerived) {
+            derivedId = derived.second.GetID();
+            if (mapLooseKeys.count(derivedId)) {
                 if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
                     WalletLogPrintf("%s: key exists in map skipping %s.\n", __func__, EncodeDestination(PKHash(derivedId)));
                 }
+                nSkipped++;
                 continue;
             }
-
-            if ((mi = mapLooseLookAhead.find(derivedId)) != mapLooseLookAhead.end()) {
+            if (mapLooseLookAhead.count(derivedId)) {
+                nSkipped++;
                 continue;
             }
 
-            fGotKey = true;
-            break;
-        }
+            mapLooseLookAhead[derivedId] = CEKLKey(idk, derived.first);
+            sek->nLastLookAhead = derived.first;
+            nAdded++;
 
-        if (!fGotKey) {
-            WalletLogPrintf("Error: %s - DeriveKey loop failed, chain %s, child %d.\n", __func__, HDKeyIDToString(idk), nChild);
-            continue;
+            if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
+                WalletLogPrintf("Added %d %s to loose-extkey look-ahead size %u.\n", derived.first, EncodeDestination(PKHash(derivedId)), mapLooseLookAhead.size());
+            }
         }
 
-        mapLooseLookAhead[derivedId] = CEKLKey(idk, nChildOut);
-        sek->nLastLookAhead = nChildOut;
-
-        if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-            WalletLogPrintf("Added %d %s to loose-extkey look-ahead size %u.\n", nChildOut, EncodeDestination(PKHash(derivedId)), mapLooseLookAhead.size());
+        if (nSkipped > nMaxSkipped) {
+            WalletLogPrintf("Error: %s - DeriveKey loop failed, chain %s, child %d.\n", __func__, HDKeyIDToString(idk), nChild);
+            break;
         }
     }
 
@@ -7315,6 +8721,7 @@ int CHDWallet::ExtKeyAddAccountToMaps(const CKeyID &idAccount, CExtKeyAccount *s
     LogPrint(BCLog::HDWALLET, "%s %s\n", GetDisplayName(), __func__);
     AssertLockHeld(cs_wallet);
     assert(sea);
+    ClearIsMineCache();
 
     for (size_t i = 0; i < sea->vExtKeys.size(); ++i) {
         CStoredExtKey *sek = sea->vExtKeys[i];
@@ -7372,6 +8779,23 @@ int CHDWallet::ExtKeyRemoveAccountFromMapsAndFree(const CKeyID &idAccount)
     return ExtKeyRemoveAccountFromMapsAndFree(mi->second);
 };
 
+void CHDWallet::ExtKeySetKeyPackReaders(CExtKeyAccount *sea)
+{
+    sea->m_key_pack_index.Sort();
+    sea->m_stealth_child_pack_index.Sort();
+    sea->m_key_cache.SetMaxSize(m_key_pack_cache_size);
+    sea->m_stealth_child_key_cache.SetMaxSize(m_key_pack_cache_size);
+
+    // Keys saved while the wallet is open go to mapKeys and mapStealthChildKeys, packs are only appended to so the index stays valid
+    CKeyID idAccount = sea->GetID();
+    sea->m_read_key_pack = [this, idAccount](uint32_t nPack, std::vector<CEKAKeyPack> &ekPak) {
+        return CHDWalletDB(*m_database).ReadExtKeyPack(idAccount, nPack, ekPak);
+    };
+    sea->m_read_stealth_child_key_pack = [this, idAccount](uint32_t nPack, std::vector<CEKASCKeyPack> &asckPak) {
+        return CHDWalletDB(*m_database).ReadExtStealthKeyChildPack(idAccount, nPack, asckPak);
+    };
+}
+
 int CHDWallet::ExtKeyLoadAccountPacks()
 {
     WalletLogPrintf("Loading ext account packs.\n");
@@ -7380,7 +8804,7 @@ int CHDWallet::ExtKeyLoadAccountPacks()
 
     CHDWalletDB wdb(*m_database);
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetCursor())) {
         return werrorN(1, "%s: cannot create DB cursor", __func__);
     }
@@ -7398,7 +8822,7 @@ int CHDWallet::ExtKeyLoadAccountPacks()
 
     unsigned int fFlags = DB_SET_RANGE;
     ssKey << std::string("epak");
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         ekPak.clear();
         fFlags = DB_NEXT;
 
@@ -7427,7 +8851,11 @@ int CHDWallet::ExtKeyLoadAccountPacks()
         std::vector<CEKAKeyPack>::iterator it;
         for (it = ekPak.begin(); it != ekPak.end(); ++it) {
             nKeys++;
-            sea->mapKeys[it->id] = it->ak;
+            if (m_lazy_key_packs) {
+                sea->m_key_pack_index.Add(it->id, nPack);
+            } else {
+                sea->mapKeys[it->id] = it->ak;
+            }
         }
     }
 
@@ -7438,7 +8866,7 @@ int CHDWallet::ExtKeyLoadAccountPacks()
     ssKey.clear();
     ssKey << std::string(DBKeys::PART_SXADDRKEYPACK);
     fFlags = DB_SET_RANGE;
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         aksPak.clear();
         fFlags = DB_NEXT;
 
@@ -7476,7 +8904,7 @@ int CHDWallet::ExtKeyLoadAccountPacks()
     ssKey.clear();
     ssKey << std::string("ecpk");
     fFlags = DB_SET_RANGE;
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         aksPak.clear();
         fFlags = DB_NEXT;
 
@@ -7505,7 +8933,12 @@ int CHDWallet::ExtKeyLoadAccountPacks()
 
         for (auto it = asckPak.begin(); it != asckPak.end(); ++it) {
             nStealthChildKeys++;
-            sea->mapStealthChildKeys[it->id] = it->asck;
+            if (m_lazy_key_packs) {
+                sea->m_stealth_child_pack_index.Add(it->id, nPack);
+                sea->m_num_packed_stealth_child_keys[it->asck.idStealthKey]++;
+            } else {
+                sea->mapStealthChildKeys[it->id] = it->asck;
+            }
         }
     }
 
@@ -7513,7 +8946,15 @@ int CHDWallet::ExtKeyLoadAccountPacks()
         WalletLogPrintf("Loaded %d stealth child keys\n", nStealthChildKeys);
     }
 
-    pcursor->close();
+    pcursor.reset();
+
+    if (m_lazy_key_packs) {
+        for (auto &mi : mapExtAccounts) {
+            CExtKeyAccount *sea = mi.second;
+            ExtKeySetKeyPackReaders(sea);
+        }
+        WalletLogPrintf("Indexed %d keys and %d stealth child keys, packs are read on demand.\n", nKeys, nStealthChildKeys);
+    }
 
     return 0;
 };
@@ -7521,6 +8962,7 @@ int CHDWallet::ExtKeyLoadAccountPacks()
 int CHDWallet::PrepareLookahead()
 {
     WalletLogPrintf("Preparing Lookahead pools.\n");
+    ClearIsMineCache();
 
     for (auto it = mapExtAccounts.cbegin(); it != mapExtAccounts.cend(); ++it) {
         CExtKeyAccount *sea = it->second;
@@ -7574,6 +9016,40 @@ int CHDWallet::ExtKeyAppendToPack(CHDWalletDB *pwdb, CExtKeyAccount *sea, const
     return 0;
 };
 
+int CHDWallet::ExtKeyAppendToPack(CHDWalletDB *pwdb, CExtKeyAccount *sea, const std::vector<std::pair<CKeyID, CEKAKey> > &vKeys, bool &fUpdateAcc) const
+{
+    // Must call WriteExtAccount after
+    // Each pack is written once, instead of once per key
+
+    CKeyID idAccount = sea->GetID();
+    std::vector<CEKAKeyPack> ekPak;
+    if (!pwdb->ReadExtKeyPack(idAccount, sea->nPack, ekPak)) {
+        // New pack
+        ekPak.clear();
+    }
+
+    fUpdateAcc = false;
+    for (size_t i = 0; i < vKeys.size(); ++i) {
+        try { ekPak.push_back(CEKAKeyPack(vKeys[i].first, vKeys[i].second)); } catch (std::exception& e) {
+            return werrorN(1, "%s push_back failed.", __func__);
+        }
+
+        bool fFull = (uint32_t)ekPak.size() >= MAX_KEY_PACK_SIZE-1;
+        if (!fFull && i + 1 < vKeys.size()) {
+            continue;
+        }
+        if (!pwdb->WriteExtKeyPack(idAccount, sea->nPack, ekPak)) {
+            return werrorN(1, "%s Save key pack %u failed.", __func__, sea->nPack);
+        }
+        if (fFull) {
+            fUpdateAcc = true;
+            sea->nPack++;
+            ekPak.clear();
+        }
+    }
+    return 0;
+};
+
 int CHDWallet::ExtKeyAppendToPack(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &idKey, const CEKASCKey &asck, bool &fUpdateAcc) const
 {
     // Must call WriteExtAccount after
@@ -7608,13 +9084,13 @@ int CHDWallet::ExtKeyAppendToPack(CHDWalletDB *pwdb, CExtKeyAccount *sea, const
 int CHDWallet::ExtKeySaveKey(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &keyId, const CEKAKey &ak) const
 {
     LogPrint(BCLog::HDWALLET, "%s %s %s.\n", __func__, sea->GetIDString58(), EncodeDestination(PKHash(keyId)));
+    ClearIsMineCache(); // Saving may extend the lookahead
 
     size_t nChain = ak.nParent;
     bool fUpdateAccTmp, fUpdateAcc = false;
     if (gArgs.GetBoolArg("-extkeysaveancestors", true)) {
         LOCK(sea->cs_account);
-        AccKeyMap::const_iterator mi = sea->mapKeys.find(keyId);
-        if (mi != sea->mapKeys.end()) {
+        if (sea->FindSavedKey(keyId)) {
             return false; // already saved
         }
 
@@ -7733,6 +9209,7 @@ int CHDWallet::ExtKeySaveKey(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CKeyI
 {
     LogPrint(BCLog::HDWALLET, "%s: %s %s.\n", __func__, sea->GetIDString58(), EncodeDestination(PKHash(keyId)));
     AssertLockHeld(cs_wallet);
+    ClearIsMineCache();
 
     if (!sea->SaveKey(keyId, asck)) {
         return werrorN(1, "%s SaveKey failed.", __func__);
@@ -7885,6 +9362,35 @@ int CHDWallet::ExtKeyGetIndex(CExtKeyAccount *sea, uint32_t &index)
     return 0;
 };
 
+int CHDWallet::GetChainAddressPath(CHDWalletDB *pwdb, CExtKeyAccount *sea, uint32_t nChain, std::vector<uint32_t> &vPath, bool &fUpdateAcc)
+{
+    fUpdateAcc = false;
+    std::map<uint32_t, std::vector<uint32_t> >::const_iterator it = sea->mapChainAddressPaths.find(nChain);
+    if (it != sea->mapChainAddressPaths.end()) {
+        vPath = it->second;
+        return 0;
+    }
+
+    const CStoredExtKey *sek = sea->GetChain(nChain);
+    if (!sek) {
+        return werrorN(1, "%s Unknown chain %d.", __func__, nChain);
+    }
+
+    vPath.clear();
+    uint32_t idIndex;
+    if (0 != ExtKeyGetIndex(pwdb, sea, idIndex, fUpdateAcc)) {
+        return werrorN(1, "%s ExtKeyGetIndex failed.", __func__);
+    }
+    vPath.push_back(idIndex); // First entry is the index to the account / master key
+    if (0 != AppendChainPath(sek, vPath)) {
+        vPath.clear();
+        return 1;
+    }
+
+    sea->mapChainAddressPaths[nChain] = vPath;
+    return 0;
+};
+
 int CHDWallet::NewKeyFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, CPubKey &pkOut,
     bool fInternal, bool fHardened, bool f256bit, bool fBech32, const char *plabel, OutputType output_type)
 {
@@ -7940,11 +9446,13 @@ int CHDWallet::NewKeyFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, CPu
     }
 
     std::vector<uint32_t> vPath;
-    uint32_t idIndex;
     if (plabel) {
         bool requireUpdateDB;
-        if (0 == ExtKeyGetIndex(pwdb, sea, idIndex, requireUpdateDB)) {
-            vPath.push_back(idIndex); // First entry is the index to the account / master key
+        if (0 == GetChainAddressPath(pwdb, sea, nExtKey, vPath, requireUpdateDB)) {
+            vPath.push_back(ks.nKey);
+        } else {
+            WalletLogPrintf("Warning: %s - missing path value.\n", __func__);
+            vPath.clear();
         }
         fUpdateAcc = requireUpdateDB ? true : fUpdateAcc;
     }
@@ -7960,24 +9468,164 @@ int CHDWallet::NewKeyFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, CPu
     sea->SaveKey(idKey, ks); // remove from lookahead, add to pool, add new lookahead
 
     if (plabel) {
-        if (0 == AppendChainPath(sek, vPath)) {
-            vPath.push_back(ks.nKey);
+        SetNewKeyAddressBook(pwdb, pkOut, vPath, f256bit, fBech32, plabel, output_type);
+    }
+
+    return 0;
+};
+
+void CHDWallet::SetNewKeyAddressBook(CHDWalletDB *pwdb, const CPubKey &pk, const std::vector<uint32_t> &vPath, bool f256bit, bool fBech32, const char *plabel, OutputType output_type)
+{
+    if (output_type == OutputType::BECH32) {
+        SetAddressBook(pwdb, WitnessV0KeyHash(pk), plabel, "receive", vPath, false);
+    } else
+    if (f256bit) {
+        CKeyID256 idKey256 = pk.GetID256();
+        SetAddressBook(pwdb, idKey256, plabel, "receive", vPath, false, fBech32);
+    } else {
+        SetAddressBook(pwdb, PKHash(pk), plabel, "receive", vPath, false, fBech32);
+    }
+};
+
+int CHDWallet::NewKeysFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, size_t nKeys, std::vector<CPubKey> &vPkOut,
+    bool fInternal, bool fHardened, bool f256bit, bool fBech32, const char *plabel, OutputType output_type)
+{
+    if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
+        WalletLogPrintf("%s %s, %u keys.\n", __func__, HDAccIDToString(idAccount), nKeys);
+        AssertLockHeld(cs_wallet);
+    }
+
+    assert(pwdb);
+    vPkOut.clear();
+    if (nKeys == 0) {
+        return 0;
+    }
+
+    if (fHardened) {
+        // Hardened keys need the secret key of the chain, derive one at a time
+        for (size_t i = 0; i < nKeys; ++i) {
+            CPubKey pk;
+            if (0 != NewKeyFromAccount(pwdb, idAccount, pk, fInternal, fHardened, f256bit, fBech32, plabel, output_type)) {
+                return werrorN(1, "%s NewKeyFromAccount failed.", __func__);
+            }
+            vPkOut.push_back(pk);
+        }
+        return 0;
+    }
+
+    ExtKeyAccountMap::iterator mi = mapExtAccounts.find(idAccount);
+    if (mi == mapExtAccounts.end()) {
+        return werrorN(2, "%s Unknown account.", __func__);
+    }
+
+    CExtKeyAccount *sea = mi->second;
+    CStoredExtKey *sek = nullptr;
+
+    uint32_t nExtKey = fInternal ? sea->nActiveInternal : sea->nActiveExternal;
+
+    if (nExtKey < sea->vExtKeys.size()) {
+        sek = sea->vExtKeys[nExtKey];
+    }
+
+    if (!sek) {
+        return werrorN(3, "%s Unknown chain.", __func__);
+    }
+
+    // Children that fail to derive are skipped, as in DeriveNextKey
+    uint32_t nChildBkp = sek->nGenerated;
+    uint32_t nChild = sek->nGenerated;
+    std::vector<std::pair<uint32_t, CPubKey> > vDerived, vBatch;
+    while (vDerived.size() < nKeys) {
+        uint32_t nBatch = nKeys - vDerived.size();
+        if (0 != sek->DeriveKeys(vBatch, nChild, nBatch) || nBatch > ((uint32_t)1 << 31) - nChild) {
+            return werrorN(4, "%s Derive failed.", __func__);
+        }
+        vDerived.insert(vDerived.end(), vBatch.begin(), vBatch.end());
+        nChild += nBatch;
+    }
+
+    std::vector<std::pair<CKeyID, CEKAKey> > vKeys;
+    vKeys.reserve(vDerived.size());
+    for (const auto &derived : vDerived) {
+        vKeys.emplace_back(derived.second.GetID(), CEKAKey(nExtKey, derived.first));
+    }
+
+    bool fUpdateAcc;
+    if (0 != ExtKeyAppendToPack(pwdb, sea, vKeys, fUpdateAcc)) {
+        return werrorN(5, "%s ExtKeyAppendToPack failed.", __func__);
+    }
+
+    sek->SetCounter(vDerived.back().first + 1, false);
+    if (!pwdb->WriteExtKey(sea->vExtKeyIDs[nExtKey], *sek)) {
+        sek->SetCounter(nChildBkp, false);
+        return werrorN(6, "%s Save account chain failed.", __func__);
+    }
+
+    std::vector<uint32_t> vPathPrefix;
+    bool fHavePath = false;
+    if (plabel) {
+        bool requireUpdateDB;
+        if (0 == GetChainAddressPath(pwdb, sea, nExtKey, vPathPrefix, requireUpdateDB)) {
+            fHavePath = true;
         } else {
             WalletLogPrintf("Warning: %s - missing path value.\n", __func__);
+        }
+        fUpdateAcc = requireUpdateDB ? true : fUpdateAcc;
+    }
+
+    if (fUpdateAcc) {
+        if (!pwdb->WriteExtAccount(idAccount, *sea)) {
+            sek->SetCounter(nChildBkp, false);
+            return werrorN(7, "%s Save account chain failed.", __func__);
+        }
+    }
+
+    vPkOut.reserve(vDerived.size());
+    std::vector<uint32_t> vPath;
+    for (size_t i = 0; i < vDerived.size(); ++i) {
+        sea->SaveKey(vKeys[i].first, vKeys[i].second); // remove from lookahead, add to pool, add new lookahead
+        vPkOut.push_back(vDerived[i].second);
+
+        if (plabel) {
             vPath.clear();
+            if (fHavePath) {
+                vPath = vPathPrefix;
+                vPath.push_back(vDerived[i].first);
+            }
+            SetNewKeyAddressBook(pwdb, vDerived[i].second, vPath, f256bit, fBech32, plabel, output_type);
         }
+    }
 
-        if (output_type == OutputType::BECH32) {
-            SetAddressBook(pwdb, WitnessV0KeyHash(pkOut), plabel, "receive", vPath, false);
-        } else
+    return 0;
+};
+
+int CHDWallet::NewKeysFromAccount(size_t nKeys, std::vector<CPubKey> &vPkOut, bool fInternal, bool fHardened, bool f256bit, bool fBech32, const char *plabel, OutputType output_type)
+{
+    {
+        LOCK(cs_wallet);
+        CHDWalletDB wdb(*m_database);
+
+        if (!wdb.TxnBegin()) {
+            return werrorN(1, "%s TxnBegin failed.", __func__);
+        }
+
+        if (0 != NewKeysFromAccount(&wdb, idDefaultAccount, nKeys, vPkOut, fInternal, fHardened, f256bit, fBech32, plabel, output_type)) {
+            wdb.TxnAbort();
+            return 1;
+        }
+
+        if (!wdb.TxnCommit()) {
+            return werrorN(1, "%s TxnCommit failed.", __func__);
+        }
+    }
+
+    for (const auto &pk : vPkOut) {
         if (f256bit) {
-            CKeyID256 idKey256 = pkOut.GetID256();
-            SetAddressBook(pwdb, idKey256, plabel, "receive", vPath, false, fBech32);
+            AddressBookChangedNotify(pk.GetID256(), CT_NEW);
         } else {
-            SetAddressBook(pwdb, PKHash(idKey), plabel, "receive", vPath, false, fBech32);
+            AddressBookChangedNotify(PKHash(pk), CT_NEW);
         }
     }
-
     return 0;
 };
 
@@ -8009,22 +9657,43 @@ int CHDWallet::NewKeyFromAccount(CPubKey &pkOut, bool fInternal, bool fHardened,
     return 0;
 };
 
-int CHDWallet::NewStealthKeyFromAccount(
-    CHDWalletDB *pwdb, const CKeyID &idAccount, const std::string &sLabel,
-    CEKAStealthKey &akStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32, uint32_t *pscankey_num, bool add_to_lookahead)
+static bool GetStealthKeyPrefix(const CKey &kSpend, uint32_t nPrefixBits, const char *pPrefix, uint32_t &nPrefix)
 {
-    // Scan secrets must be stored uncrypted - always derive hardened keys
-
-    if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-        WalletLogPrintf("%s %s%s.\n", __func__, HDAccIDToString(idAccount), pscankey_num ? " for lookahead" : "");
-        AssertLockHeld(cs_wallet);
-    }
-
-    assert(pwdb || pscankey_num);
-
-    if (IsLocked()) {
-        return werrorN(1, "%s Wallet must be unlocked to derive hardened keys.", __func__);
-    }
+    nPrefix = 0;
+    if (pPrefix) {
+        if (!ExtractStealthPrefix(pPrefix, nPrefix)) {
+            return false;
+        }
+    } else
+    if (nPrefixBits > 0) {
+        // If pPrefix is null, set nPrefix from the hash of kSpend
+        uint8_t tmp32[32];
+        CSHA256().Write(kSpend.begin(), 32).Finalize(tmp32);
+        memcpy(&nPrefix, tmp32, 4);
+        nPrefix = le32toh(nPrefix);
+    }
+
+    uint32_t nMask = SetStealthMask(nPrefixBits);
+    nPrefix = nPrefix & nMask;
+    return true;
+}
+
+int CHDWallet::NewStealthKeyFromAccount(
+    CHDWalletDB *pwdb, const CKeyID &idAccount, const std::string &sLabel,
+    CEKAStealthKey &akStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32, uint32_t *pscankey_num, bool add_to_lookahead)
+{
+    // Scan secrets must be stored uncrypted - always derive hardened keys
+
+    if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
+        WalletLogPrintf("%s %s%s.\n", __func__, HDAccIDToString(idAccount), pscankey_num ? " for lookahead" : "");
+        AssertLockHeld(cs_wallet);
+    }
+
+    assert(pwdb || pscankey_num);
+
+    if (IsLocked()) {
+        return werrorN(1, "%s Wallet must be unlocked to derive hardened keys.", __func__);
+    }
 
     ExtKeyAccountMap::iterator mi = mapExtAccounts.find(idAccount);
     if (mi == mapExtAccounts.end()) {
@@ -8061,22 +9730,10 @@ int CHDWallet::NewStealthKeyFromAccount(
     }
 
     uint32_t nPrefix = 0;
-    if (pPrefix) {
-        if (!ExtractStealthPrefix(pPrefix, nPrefix)) {
-            return werrorN(1, "%s ExtractStealthPrefix.", __func__);
-        }
-    } else
-    if (nPrefixBits > 0) {
-        // If pPrefix is null, set nPrefix from the hash of kSpend
-        uint8_t tmp32[32];
-        CSHA256().Write(kSpend.begin(), 32).Finalize(tmp32);
-        memcpy(&nPrefix, tmp32, 4);
-        nPrefix = le32toh(nPrefix);
+    if (!GetStealthKeyPrefix(kSpend, nPrefixBits, pPrefix, nPrefix)) {
+        return werrorN(1, "%s ExtractStealthPrefix.", __func__);
     }
 
-    uint32_t nMask = SetStealthMask(nPrefixBits);
-    nPrefix = nPrefix & nMask;
-
     CPubKey pkSpend = kSpend.GetPubKey();
     akStealthOut = CEKAStealthKey(nChain, nScanOut, kScan, nChain, nSpendOut, pkSpend, nPrefixBits, nPrefix);
     akStealthOut.sLabel = sLabel;
@@ -8120,6 +9777,118 @@ int CHDWallet::NewStealthKeyFromAccount(const std::string &sLabel, CEKAStealthKe
     return 0;
 };
 
+int CHDWallet::NewStealthKeysFromAccount(
+    CHDWalletDB *pwdb, const CKeyID &idAccount, size_t nKeys, const std::string &sLabel,
+    std::vector<CEKAStealthKey> &vAkStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32)
+{
+    AssertLockHeld(cs_wallet);
+    LogPrint(BCLog::HDWALLET, "%s %s, %u keys.\n", __func__, HDAccIDToString(idAccount), nKeys);
+
+    vAkStealthOut.clear();
+    if (IsLocked()) {
+        return werrorN(1, "%s Wallet must be unlocked to derive hardened keys.", __func__);
+    }
+
+    ExtKeyAccountMap::iterator mi = mapExtAccounts.find(idAccount);
+    if (mi == mapExtAccounts.end()) {
+        return werrorN(1, "%s Unknown account.", __func__);
+    }
+
+    CExtKeyAccount *sea = mi->second;
+    uint32_t nChain = sea->nActiveStealth;
+    CStoredExtKey *sek = sea->GetChain(nChain);
+    if (!sek) {
+        return werrorN(1, "%s Stealth chain unknown %d.", __func__, nChain);
+    }
+    if (!sek->kp.IsValidV()) {
+        return werrorN(1, "%s Ext key does not contain a secret.", __func__);
+    }
+
+    // Address i takes hardened children nChild + 2i and nChild + 2i + 1, as DeriveNextKey would
+    uint32_t nChild = sek->nHGenerated;
+    if (nKeys > ((uint32_t)1 << 30) || nChild >= ((uint32_t)1 << 31) - 2 * nKeys) {
+        return werrorN(1, "%s No more hardened keys can be derived from master.", __func__);
+    }
+
+    vAkStealthOut.resize(nKeys);
+    size_t num_workers = std::min(nKeys / MIN_STEALTH_KEYS_PER_WORKER + 1, (size_t) std::max(1, GetNumCores()));
+    bool derived = ParallelFor(nKeys, num_workers, [&](size_t w, size_t i) {
+        CKey kScan, kSpend;
+        uint32_t nScanOut = nChild + 2 * i, nSpendOut = nScanOut + 1;
+        SetHardenedBit(nScanOut);
+        SetHardenedBit(nSpendOut);
+        uint32_t nPrefix;
+        if (!sek->kp.Derive(kScan, nScanOut)
+            || !sek->kp.Derive(kSpend, nSpendOut)
+            || !GetStealthKeyPrefix(kSpend, nPrefixBits, pPrefix, nPrefix)) {
+            return false;
+        }
+        vAkStealthOut[i] = CEKAStealthKey(nChain, nScanOut, kScan, nChain, nSpendOut, kSpend.GetPubKey(), nPrefixBits, nPrefix);
+        vAkStealthOut[i].sLabel = sLabel;
+        return true;
+    });
+
+    if (!derived) {
+        // An invalid child shifts the following indices, derive one at a time
+        vAkStealthOut.clear();
+        for (size_t i = 0; i < nKeys; ++i) {
+            CEKAStealthKey akStealth;
+            if (0 != NewStealthKeyFromAccount(pwdb, idAccount, sLabel, akStealth, nPrefixBits, pPrefix, fBech32)) {
+                return 1;
+            }
+            vAkStealthOut.push_back(akStealth);
+        }
+        return 0;
+    }
+
+    if (0 != SaveStealthAddresses(pwdb, sea, vAkStealthOut, fBech32)) {
+        sek->SetCounter(nChild, true);
+        return werrorN(1, "SaveStealthAddresses failed.");
+    }
+
+    return 0;
+};
+
+int CHDWallet::NewStealthKeysFromAccount(size_t nKeys, bool fV2, const std::string &sLabel, std::vector<CEKAStealthKey> &vAkStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32)
+{
+    {
+        LOCK(cs_wallet);
+        CHDWalletDB wdb(*m_database);
+
+        if (!wdb.TxnBegin()) {
+            return werrorN(1, "%s TxnBegin failed.", __func__);
+        }
+
+        int rv = 0;
+        if (fV2) {
+            // The scan and spend keys of v2 addresses come from separate chains
+            vAkStealthOut.clear();
+            for (size_t i = 0; i < nKeys && rv == 0; ++i) {
+                CEKAStealthKey akStealth;
+                rv = NewStealthKeyV2FromAccount(&wdb, idDefaultAccount, sLabel, akStealth, nPrefixBits, pPrefix, fBech32);
+                vAkStealthOut.push_back(akStealth);
+            }
+        } else {
+            rv = NewStealthKeysFromAccount(&wdb, idDefaultAccount, nKeys, sLabel, vAkStealthOut, nPrefixBits, pPrefix, fBech32);
+        }
+        if (0 != rv) {
+            wdb.TxnAbort();
+            return 1;
+        }
+
+        if (!wdb.TxnCommit()) {
+            return werrorN(1, "%s TxnCommit failed.", __func__);
+        }
+    }
+
+    for (const auto &akStealth : vAkStealthOut) {
+        CStealthAddress sxAddr;
+        akStealth.SetSxAddr(sxAddr);
+        AddressBookChangedNotify(sxAddr, CT_NEW);
+    }
+    return 0;
+};
+
 int CHDWallet::InitAccountStealthV2Chains(CHDWalletDB *pwdb, CExtKeyAccount *sea)
 {
     AssertLockHeld(cs_wallet);
@@ -8207,35 +9976,22 @@ int CHDWallet::InitAccountStealthV2Chains(CHDWalletDB *pwdb, CExtKeyAccount *sea
 
 int CHDWallet::SaveStealthAddress(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CEKAStealthKey &akStealth, bool fBech32)
 {
-    LogPrint(BCLog::HDWALLET, "%s %s\n", GetDisplayName(), __func__);
+    return SaveStealthAddresses(pwdb, sea, {akStealth}, fBech32);
+};
+
+int CHDWallet::SaveStealthAddresses(CHDWalletDB *pwdb, CExtKeyAccount *sea, const std::vector<CEKAStealthKey> &vAkStealth, bool fBech32)
+{
+    LogPrint(BCLog::HDWALLET, "%s %s, %u addresses\n", GetDisplayName(), __func__, vAkStealth.size());
     assert(sea);
 
     std::vector<CEKAStealthKeyPack> aksPak;
-    CKeyID idKey = akStealth.GetID();
     CKeyID idAccount = sea->GetID();
-
-    uint32_t nScanChain = akStealth.nScanParent;
-    uint32_t nSpendChain = akStealth.akSpend.nParent;
-
-    bool is_v1_key = nScanChain == nSpendChain; // v2 stealth addresses use two chains.
-
-    CStoredExtKey *sekScan, *sekSpend;
-    if (!(sekScan = sea->GetChain(nScanChain))) {
-        return werrorN(1, "Unknown scan chain.");
-    }
-    if (!(sekSpend = sea->GetChain(nSpendChain))) {
-        return werrorN(1, "Unknown spend chain.");
-    }
-
-    // Update counters, necessary if stealthkey was lookahead
-    if (sekScan->nHGenerated <= WithoutHardenedBit(akStealth.nScanKey)) {
-        sekScan->nHGenerated = WithoutHardenedBit(akStealth.nScanKey) + 1;
-    }
-    if (sekSpend->nHGenerated <= WithoutHardenedBit(akStealth.akSpend.nKey)) {
-        sekSpend->nHGenerated = WithoutHardenedBit(akStealth.akSpend.nKey) + 1;
-    }
-
-    sea->mapStealthKeys[idKey] = akStealth;
+    std::vector<CKeyID> vAdded;
+    auto rollback = [&]() {
+        for (const auto &id : vAdded) {
+            sea->mapStealthKeys.erase(id);
+        }
+    };
 
     if (!pwdb->ReadExtStealthKeyPack(idAccount, sea->nPackStealth, aksPak)) {
         // New pack
@@ -8245,58 +10001,92 @@ int CHDWallet::SaveStealthAddress(CHDWalletDB *pwdb, CExtKeyAccount *sea, const
         }
     }
 
-    aksPak.push_back(CEKAStealthKeyPack(idKey, akStealth));
-    if (!pwdb->WriteExtStealthKeyPack(idAccount, sea->nPackStealth, aksPak)) {
-        sea->mapStealthKeys.erase(idKey);
-        return werrorN(1, "WriteExtStealthKeyPack failed.");
-    }
+    bool fUpdateAcc = false;
+    std::set<uint32_t> setChains;
+    for (size_t i = 0; i < vAkStealth.size(); ++i) {
+        const CEKAStealthKey &akStealth = vAkStealth[i];
+        CKeyID idKey = akStealth.GetID();
 
-    if (!pwdb->WriteExtKey(sea->vExtKeyIDs[nScanChain], *sekScan)
-        || (!is_v1_key && !pwdb->WriteExtKey(sea->vExtKeyIDs[nSpendChain], *sekSpend))) {
-        sea->mapStealthKeys.erase(idKey);
-        return werrorN(1, "WriteExtKey failed.");
-    }
+        uint32_t nScanChain = akStealth.nScanParent;
+        uint32_t nSpendChain = akStealth.akSpend.nParent;
 
-    std::vector<uint32_t> vPath;
-    uint32_t idIndex;
-    bool requireUpdateDB;
-    if (0 == ExtKeyGetIndex(pwdb, sea, idIndex, requireUpdateDB)) {
-        vPath.push_back(idIndex); // first entry is the index to the account / master key
-    }
+        CStoredExtKey *sekScan, *sekSpend;
+        if (!(sekScan = sea->GetChain(nScanChain))) {
+            rollback();
+            return werrorN(1, "Unknown scan chain.");
+        }
+        if (!(sekSpend = sea->GetChain(nSpendChain))) {
+            rollback();
+            return werrorN(1, "Unknown spend chain.");
+        }
 
-    // V1 stealth addrs use the path of the scan secret
-    bool have_path = false;
-    if (is_v1_key) {
-        if (0 == AppendChainPath(sekScan, vPath)) {
-            uint32_t nChild = akStealth.nScanKey;
-            vPath.push_back(SetHardenedBit(nChild));
-            have_path = true;
+        // Update counters, necessary if stealthkey was lookahead
+        if (sekScan->nHGenerated <= WithoutHardenedBit(akStealth.nScanKey)) {
+            sekScan->nHGenerated = WithoutHardenedBit(akStealth.nScanKey) + 1;
+        }
+        if (sekSpend->nHGenerated <= WithoutHardenedBit(akStealth.akSpend.nKey)) {
+            sekSpend->nHGenerated = WithoutHardenedBit(akStealth.akSpend.nKey) + 1;
+        }
+        setChains.insert(nScanChain);
+        setChains.insert(nSpendChain); // v2 stealth addresses use two chains.
+
+        sea->mapStealthKeys[idKey] = akStealth;
+        vAdded.push_back(idKey);
+
+        aksPak.push_back(CEKAStealthKeyPack(idKey, akStealth));
+        bool fFull = (uint32_t)aksPak.size() >= MAX_KEY_PACK_SIZE-1;
+        if (!fFull && i + 1 < vAkStealth.size()) {
+            continue;
+        }
+        if (!pwdb->WriteExtStealthKeyPack(idAccount, sea->nPackStealth, aksPak)) {
+            rollback();
+            return werrorN(1, "WriteExtStealthKeyPack failed.");
+        }
+        if (fFull) {
+            sea->nPackStealth++;
+            fUpdateAcc = true;
+            aksPak.clear();
         }
-    } else
-    if (0 == AppendChainPath(sekSpend, vPath)) {
-        vPath.push_back(akStealth.akSpend.nKey);
-        have_path = true;
     }
 
-    if (!have_path) {
-        WalletLogPrintf("Warning: %s - missing path value.\n", __func__);
-        vPath.clear();
+    for (uint32_t nChain : setChains) {
+        if (!pwdb->WriteExtKey(sea->vExtKeyIDs[nChain], *sea->GetChain(nChain))) {
+            rollback();
+            return werrorN(1, "WriteExtKey failed.");
+        }
     }
 
-    if ((uint32_t)aksPak.size() >= MAX_KEY_PACK_SIZE-1) {
-        sea->nPackStealth++;
+    std::vector<std::vector<uint32_t> > vPaths(vAkStealth.size());
+    for (size_t i = 0; i < vAkStealth.size(); ++i) {
+        const CEKAStealthKey &akStealth = vAkStealth[i];
+        bool is_v1_key = akStealth.nScanParent == akStealth.akSpend.nParent;
+
+        // V1 stealth addrs use the path of the scan secret
+        std::vector<uint32_t> &vPath = vPaths[i];
+        bool requireUpdateDB;
+        if (0 == GetChainAddressPath(pwdb, sea, is_v1_key ? akStealth.nScanParent : akStealth.akSpend.nParent, vPath, requireUpdateDB)) {
+            uint32_t nChild = akStealth.nScanKey;
+            vPath.push_back(is_v1_key ? SetHardenedBit(nChild) : akStealth.akSpend.nKey);
+        } else {
+            WalletLogPrintf("Warning: %s - missing path value.\n", __func__);
+            vPath.clear();
+        }
+        fUpdateAcc = requireUpdateDB ? true : fUpdateAcc;
     }
-    if (((uint32_t)aksPak.size() >= MAX_KEY_PACK_SIZE-1 || requireUpdateDB)
+
+    if (fUpdateAcc
         && !pwdb->WriteExtAccount(idAccount, *sea)) {
         return werrorN(1, "WriteExtAccount failed.");
     }
 
-    CStealthAddress sxAddr;
-    if (0 != akStealth.SetSxAddr(sxAddr)) {
-        return werrorN(1, "SetSxAddr failed.");
-    }
+    for (size_t i = 0; i < vAkStealth.size(); ++i) {
+        CStealthAddress sxAddr;
+        if (0 != vAkStealth[i].SetSxAddr(sxAddr)) {
+            return werrorN(1, "SetSxAddr failed.");
+        }
 
-    SetAddressBook(pwdb, sxAddr, akStealth.sLabel, "receive", vPath, false, fBech32);
+        SetAddressBook(pwdb, sxAddr, vAkStealth[i].sLabel, "receive", vPaths[i], false, fBech32);
+    }
 
     return 0;
 };
@@ -8548,6 +10338,7 @@ int CHDWallet::NewExtKeyFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount,
         nLookAhead = GetCompressedInt64(mvi->second, nLookAhead);
     }
     sea->AddLookAhead(chainNo, nLookAhead);
+    ClearIsMineCache();
 
     mapExtKeys[idNewChain] = sekOut;
 
@@ -9040,7 +10831,7 @@ int CHDWallet::LoadStealthAddresses()
 
     CHDWalletDB wdb(*m_database);
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetCursor())) {
         return werrorN(1, "%s: cannot create DB cursor", __func__);
     }
@@ -9054,7 +10845,7 @@ int CHDWallet::LoadStealthAddresses()
 
     unsigned int fFlags = DB_SET_RANGE;
     ssKey << std::string(DBKeys::PART_SXADDR);
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
 
         ssKey >> strType;
@@ -9067,9 +10858,9 @@ int CHDWallet::LoadStealthAddresses()
             WalletLogPrintf("Loading stealth address %s\n", sx.Encoded());
         }
 
-        stealthAddresses.insert(sx);
+        AddStealthAddressInMem(sx);
     }
-    pcursor->close();
+    pcursor.reset();
 
     LogPrint(BCLog::HDWALLET, "Loaded %u stealth address.\n", stealthAddresses.size());
 
@@ -9084,7 +10875,7 @@ int CHDWallet::LoadMasterKeys()
 
     CHDWalletDB wdb(*m_database);
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetCursor())) {
         return werrorN(1, "%s: cannot create DB cursor", __func__);
     }
@@ -9094,7 +10885,7 @@ int CHDWallet::LoadMasterKeys()
     unsigned int fFlags = DB_SET_RANGE;
     std::string strType;
     ssKey << std::string("mkey");
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
 
         ssKey >> strType;
@@ -9116,7 +10907,7 @@ int CHDWallet::LoadMasterKeys()
             nMasterKeyMaxID = nID;
         }
     }
-    pcursor->close();
+    pcursor.reset();
 
     return 0;
 };
@@ -9290,7 +11081,10 @@ bool CHDWallet::ProcessLockedStealthOutputs()
         return werror("%s: TxnBegin failed.", __func__);
     }
 
-    Dbc *pcursor;
+    // Read all locked keys first, the secrets are derived in parallel batches
+    std::vector<std::pair<CKeyID, CStealthKeyMetadata> > locked_keys;
+    {
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetTxnCursor())) {
         return werror("%s: Cannot create DB cursor.", __func__);
     }
@@ -9298,116 +11092,144 @@ bool CHDWallet::ProcessLockedStealthOutputs()
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
     CDataStream ssValue(SER_DISK, CLIENT_VERSION);
 
-    CPubKey pk;
-
     std::string strType;
     CKeyID idk;
     CStealthKeyMetadata sxKeyMeta;
 
-    size_t nProcessed = 0; // incl any failed attempts
-    size_t nExpanded = 0;
     unsigned int fFlags = DB_SET_RANGE;
     ssKey << std::string("sxkm");
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
         ssKey >> strType;
         if (strType != "sxkm") {
             break;
         }
 
-        nProcessed++;
-
         ssKey >> idk;
         ssValue >> sxKeyMeta;
+        locked_keys.emplace_back(idk, sxKeyMeta);
+    }
+    }
 
-        if (!GetPubKey(idk, pk)) {
-            WalletLogPrintf("%s Error: GetPubKey failed %s.\n", __func__, EncodeDestination(PKHash(idk)));
-            continue;
-        }
-
-        CStealthAddress sxFind;
-        sxFind.SetScanPubKey(sxKeyMeta.pkScan);
-
-        std::set<CStealthAddress>::iterator si = stealthAddresses.find(sxFind);
-        if (si == stealthAddresses.end()) {
-            WalletLogPrintf("%s Error: No stealth key found to add secret for %s.\n", __func__, EncodeDestination(PKHash(idk)));
-            continue;
-        }
+    struct LockedStealthKey {
+        CKeyID idk;
+        CPubKey pk;
+        CKey scan_secret;
+        CKey spend_secret;
+        ec_point pkEphem;
+        CKey secret;
+        bool valid = false;
+    };
 
-        if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-            WalletLogPrintf("Expanding secret for %s\n", EncodeDestination(PKHash(idk)));
-        }
+    size_t nProcessed = locked_keys.size(); // incl any failed attempts
+    size_t nExpanded = 0;
+    for (size_t batch_start = 0; batch_start < locked_keys.size(); batch_start += LOCKED_OUTPUTS_BATCH_SIZE) {
+        size_t batch_end = std::min(locked_keys.size(), batch_start + LOCKED_OUTPUTS_BATCH_SIZE);
+        ShowLockedOutputsProgress(batch_start, locked_keys.size());
+
+        std::vector<LockedStealthKey> batch;
+        batch.reserve(batch_end - batch_start);
+        for (size_t i = batch_start; i < batch_end; ++i) {
+            const CKeyID &idk = locked_keys[i].first;
+            const CStealthKeyMetadata &sxKeyMeta = locked_keys[i].second;
+
+            LockedStealthKey k;
+            k.idk = idk;
+            if (!GetPubKey(idk, k.pk)) {
+                WalletLogPrintf("%s Error: GetPubKey failed %s.\n", __func__, EncodeDestination(PKHash(idk)));
+                continue;
+            }
 
-        CKey sSpendR, sSpend;
+            CStealthAddress sxFind;
+            sxFind.SetScanPubKey(sxKeyMeta.pkScan);
 
-        if (!GetKey(si->spend_secret_id, sSpend)) {
-            WalletLogPrintf("%s Error: Stealth address has no spend_secret_id key for %s\n", __func__, EncodeDestination(PKHash(idk)));
-            continue;
-        }
+            std::set<CStealthAddress>::iterator si = stealthAddresses.find(sxFind);
+            if (si == stealthAddresses.end()) {
+                WalletLogPrintf("%s Error: No stealth key found to add secret for %s.\n", __func__, EncodeDestination(PKHash(idk)));
+                continue;
+            }
 
-        if (si->scan_secret.size() != EC_SECRET_SIZE) {
-            WalletLogPrintf("%s Error: Stealth address has no scan_secret key for %s\n", __func__, EncodeDestination(PKHash(idk)));
-            continue;
-        }
+            if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
+                WalletLogPrintf("Expanding secret for %s\n", EncodeDestination(PKHash(idk)));
+            }
 
-        if (sxKeyMeta.pkEphem.size() != EC_COMPRESSED_SIZE) {
-            WalletLogPrintf("%s Error: Incorrect Ephemeral point size (%d) for %s\n", __func__, sxKeyMeta.pkEphem.size(), EncodeDestination(PKHash(idk)));
-            continue;
-        }
+            if (!GetKey(si->spend_secret_id, k.spend_secret)) {
+                WalletLogPrintf("%s Error: Stealth address has no spend_secret_id key for %s\n", __func__, EncodeDestination(PKHash(idk)));
+                continue;
+            }
 
-        ec_point pkEphem;
-        pkEphem.resize(EC_COMPRESSED_SIZE);
-        memcpy(&pkEphem[0], sxKeyMeta.pkEphem.begin(), sxKeyMeta.pkEphem.size());
+            if (si->scan_secret.size() != EC_SECRET_SIZE) {
+                WalletLogPrintf("%s Error: Stealth address has no scan_secret key for %s\n", __func__, EncodeDestination(PKHash(idk)));
+                continue;
+            }
+            k.scan_secret = si->scan_secret;
 
-        if (StealthSecretSpend(si->scan_secret, pkEphem, sSpend, sSpendR) != 0) {
-            WalletLogPrintf("%s Error: StealthSecretSpend() failed for %s\n", __func__, EncodeDestination(PKHash(idk)));
-            continue;
-        }
+            if (sxKeyMeta.pkEphem.size() != EC_COMPRESSED_SIZE) {
+                WalletLogPrintf("%s Error: Incorrect Ephemeral point size (%d) for %s\n", __func__, sxKeyMeta.pkEphem.size(), EncodeDestination(PKHash(idk)));
+                continue;
+            }
 
-        if (!sSpendR.IsValid()) {
-            WalletLogPrintf("%s Error: Reconstructed key is invalid for %s\n", __func__, EncodeDestination(PKHash(idk)));
-            continue;
+            k.pkEphem.resize(EC_COMPRESSED_SIZE);
+            memcpy(&k.pkEphem[0], sxKeyMeta.pkEphem.begin(), sxKeyMeta.pkEphem.size());
+            batch.push_back(std::move(k));
         }
 
-        CPubKey cpkT = sSpendR.GetPubKey();
-        if (cpkT != pk) {
-            WalletLogPrintf("%s: Error: Generated secret does not match.\n", __func__);
-            if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-                LogPrintf("cpkT   %s\n", HexStr(cpkT));
-                LogPrintf("pubKey %s\n", HexStr(pk));
+        size_t num_workers = std::min(batch.size() / MIN_LOCKED_OUTPUTS_PER_WORKER + 1, (size_t) std::max(1, GetNumCores()));
+        ParallelFor(batch.size(), num_workers, [&](size_t w, size_t i) {
+            LockedStealthKey &k = batch[i];
+            if (StealthSecretSpend(k.scan_secret, k.pkEphem, k.spend_secret, k.secret) != 0) {
+                WalletLogPrintf("%s Error: StealthSecretSpend() failed for %s\n", __func__, EncodeDestination(PKHash(k.idk)));
+                return true;
             }
-            continue;
-        }
 
-        if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-            WalletLogPrintf("%s: Adding secret to key %s.\n", __func__, EncodeDestination(PKHash(idk)));
-        }
+            if (!k.secret.IsValid()) {
+                WalletLogPrintf("%s Error: Reconstructed key is invalid for %s\n", __func__, EncodeDestination(PKHash(k.idk)));
+                return true;
+            }
 
+            CPubKey cpkT = k.secret.GetPubKey();
+            if (cpkT != k.pk) {
+                WalletLogPrintf("%s: Error: Generated secret does not match.\n", __func__);
+                if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
+                    LogPrintf("cpkT   %s\n", HexStr(cpkT));
+                    LogPrintf("pubKey %s\n", HexStr(k.pk));
+                }
+                return true;
+            }
+            k.valid = true;
+            return true;
+        });
 
-        WalletBatch *batch = &wdb;
         auto spk_man = GetLegacyScriptPubKeyMan();
-        if (spk_man) {
-            LOCK(spk_man->cs_KeyStore);
-            if (!spk_man->AddKeyPubKeyWithDB(*batch, sSpendR, pk)) {
-                WalletLogPrintf("%s: Error: AddKeyPubKey failed.\n", __func__);
+        for (const auto &k : batch) {
+            if (!k.valid) {
                 continue;
             }
-        } else {
-            WalletLogPrintf("%s: Error: GetLegacyScriptPubKeyMan failed.\n", __func__);
-            continue;
-        }
+            if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
+                WalletLogPrintf("%s: Adding secret to key %s.\n", __func__, EncodeDestination(PKHash(k.idk)));
+            }
 
-        nExpanded++;
+            if (spk_man) {
+                LOCK(spk_man->cs_KeyStore);
+                if (!spk_man->AddKeyPubKeyWithDB(wdb, k.secret, k.pk)) {
+                    WalletLogPrintf("%s: Error: AddKeyPubKey failed.\n", __func__);
+                    continue;
+                }
+            } else {
+                WalletLogPrintf("%s: Error: GetLegacyScriptPubKeyMan failed.\n", __func__);
+                continue;
+            }
 
-        int rv = pcursor->del(0);
-        if (rv != 0) {
-            WalletLogPrintf("%s: Error: EraseStealthKeyMeta failed for %s, %d\n", __func__, EncodeDestination(PKHash(idk)), rv);
+            nExpanded++;
+
+            if (!wdb.EraseStealthKeyMeta(k.idk)) {
+                WalletLogPrintf("%s: Error: EraseStealthKeyMeta failed for %s\n", __func__, EncodeDestination(PKHash(k.idk)));
+            }
         }
     }
 
-    pcursor->close();
-
     wdb.TxnCommit();
+    ShowLockedOutputsProgress(locked_keys.size(), locked_keys.size());
 
     LogPrint(BCLog::HDWALLET, "%s: Expanded %u/%u key%s.\n", __func__, nExpanded, nProcessed, nProcessed == 1 ? "" : "s");
 
@@ -9431,7 +11253,10 @@ bool CHDWallet::ProcessLockedBlindedOutputs()
         return werror("%s: TxnBegin failed.", __func__);
     }
 
-    Dbc *pcursor;
+    // Read all locked outputs first, the rangeproofs are rewound in parallel batches
+    std::vector<COutPoint> locked_outputs;
+    {
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetTxnCursor())) {
         return werror("%s: Cannot create DB cursor.", __func__);
     }
@@ -9441,24 +11266,70 @@ bool CHDWallet::ProcessLockedBlindedOutputs()
     COutPoint op;
     std::string strType;
 
-    CStoredTransaction stx;
     unsigned int fFlags = DB_SET_RANGE;
     ssKey << std::string("lao");
-    while (wdb.ReadKeyAtCursor(pcursor, ssKey, fFlags) == 0) {
+    while (wdb.ReadKeyAtCursor(pcursor.get(), ssKey, fFlags) == 0) {
         fFlags = DB_NEXT;
         ssKey >> strType;
         if (strType != "lao") {
             break;
         }
 
-        nProcessed++;
-
         ssKey >> op;
 
-        int rv = pcursor->del(0);
+        int rv = pcursor->Erase();
         if (rv != 0) {
-            WalletLogPrintf("%s: Error: pcursor->del failed for %s, %d.\n", __func__, op.ToString(), rv);
+            WalletLogPrintf("%s: Error: Cursor erase failed for %s, %d.\n", __func__, op.ToString(), rv);
+        }
+        locked_outputs.push_back(op);
+    }
+    }
+
+    struct LockedOutputRewind {
+        CTxOutBaseRef txout;
+        uint256 nonce;
+        CRewoundOutput rewound;
+        bool valid = false;
+    };
+
+    CStoredTransaction stx;
+    int64_t earliest_spent_time = std::numeric_limits<int64_t>::max();
+    m_defer_key_images = true;
+    for (size_t batch_start = 0; batch_start < locked_outputs.size(); batch_start += LOCKED_OUTPUTS_BATCH_SIZE) {
+    size_t batch_end = std::min(locked_outputs.size(), batch_start + LOCKED_OUTPUTS_BATCH_SIZE);
+    ShowLockedOutputsProgress(batch_start, locked_outputs.size());
+
+    // Rewind the bulletproofs of the batch in parallel, OwnBlindOut and OwnAnonOut find the results in m_rewound_output_cache
+    std::vector<LockedOutputRewind> rewinds;
+    for (size_t i = batch_start; i < batch_end; ++i) {
+        const COutPoint &op = locked_outputs[i];
+        LockedOutputRewind r;
+        if (!wdb.ReadStoredTx(op.hash, stx) ||
+            stx.tx->vpout.size() <= op.n ||
+            !GetOwnedOutputNonce(stx.tx->vpout[op.n].get(), r.nonce)) {
+            continue;
+        }
+        r.txout = stx.tx->vpout[op.n];
+        rewinds.push_back(std::move(r));
+    }
+    size_t num_workers = std::min(rewinds.size() / MIN_LOCKED_OUTPUTS_PER_WORKER + 1, (size_t) std::max(1, GetNumCores()));
+    ParallelFor(rewinds.size(), num_workers, [&](size_t w, size_t i) {
+        LockedOutputRewind &r = rewinds[i];
+        uint64_t amount;
+        r.valid = 1 == RewindBulletproofOutput(*r.txout->GetPRangeproof(), *r.txout->GetPData(),
+            r.txout->GetPCommitment(), r.nonce, amount, r.rewound.blind.begin());
+        r.rewound.nValue = amount;
+        return true;
+    });
+    for (const auto &r : rewinds) {
+        if (r.valid) {
+            CacheRewoundOutput(r.nonce, *r.txout->GetPCommitment(), r.rewound);
         }
+    }
+
+    for (size_t i = batch_start; i < batch_end; ++i) {
+        const COutPoint &op = locked_outputs[i];
+        nProcessed++;
 
         MapRecords_t::iterator mir;
         mir = mapRecords.find(op.hash);
@@ -9498,14 +11369,19 @@ bool CHDWallet::ProcessLockedBlindedOutputs()
                 }
                 break;
             case OUTPUT_RINGCT:
+                {
+                size_t num_pending = m_pending_key_images.size();
                 if (OwnAnonOut(&wdb, op.hash, (CTxOutRingCT*)txout.get(), nullptr, n, *pout, stx, fUpdated) &&
                     !fHave) {
                     fUpdated = true;
                     rtx.InsertOutput(*pout);
                 }
-                if (earliest_anon_out_time > rtx.GetTxTime()) {
+                // Outputs with a new key image are checked against the chain in bulk below
+                if (m_pending_key_images.size() == num_pending &&
+                    earliest_anon_out_time > rtx.GetTxTime()) {
                     earliest_anon_out_time = rtx.GetTxTime();
                 }
+                }
                 break;
             default:
                 WalletLogPrintf("%s: Error: Output is unexpected type %d %s.\n", __func__, txout->nVersion, op.ToString());
@@ -9520,6 +11396,8 @@ bool CHDWallet::ProcessLockedBlindedOutputs()
 
             if (!wdb.WriteTxRecord(op.hash, rtx) ||
                 !wdb.WriteStoredTx(op.hash, stx)) {
+                m_defer_key_images = false;
+                m_pending_key_images.clear();
                 return false;
             }
 
@@ -9528,10 +11406,13 @@ bool CHDWallet::ProcessLockedBlindedOutputs()
 
         nExpanded++;
     }
-
-    pcursor->close();
+    WritePendingKeyImages(wdb, m_is_only_instance ? nullptr : &earliest_spent_time);
+    }
+    m_defer_key_images = false;
+    earliest_anon_out_time = std::min(earliest_anon_out_time, earliest_spent_time);
 
     wdb.TxnCommit();
+    ShowLockedOutputsProgress(locked_outputs.size(), locked_outputs.size());
     }
 
     // Trigger a rescan from the deepest anon out, spend info may need to be updated
@@ -9556,6 +11437,16 @@ bool CHDWallet::ProcessLockedBlindedOutputs()
     return true;
 };
 
+void CHDWallet::ShowLockedOutputsProgress(size_t done, size_t total)
+{
+    if (total <= LOCKED_OUTPUTS_BATCH_SIZE) {
+        return;
+    }
+    int percent = done >= total ? 100 : std::max(1, std::min(99, (int)(done * 100 / total)));
+    ShowProgress(strprintf("%s " + _("Processing outputs received while locked…").translated, GetDisplayName()), percent);
+    WalletLogPrintf("Processing outputs received while locked, %u/%u\n", done, total);
+}
+
 bool CHDWallet::CountRecords(std::string sPrefix, int64_t rv)
 {
     rv = 0;
@@ -9566,7 +11457,7 @@ bool CHDWallet::CountRecords(std::string sPrefix, int64_t rv)
         return werror("%s: TxnBegin failed.", __func__);
     }
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetTxnCursor())) {
         return werror("%s: Cannot create DB cursor.", __func__);
     }
@@ -9575,7 +11466,7 @@ bool CHDWallet::CountRecords(std::string sPrefix, int64_t rv)
     ssKey << sPrefix;
     std::string strType;
     unsigned int fFlags = DB_SET_RANGE;
-    while (wdb.ReadKeyAtCursor(pcursor, ssKey, fFlags) == 0) {
+    while (wdb.ReadKeyAtCursor(pcursor.get(), ssKey, fFlags) == 0) {
         fFlags = DB_NEXT;
         ssKey >> strType;
         if (strType != sPrefix) {
@@ -9585,27 +11476,13 @@ bool CHDWallet::CountRecords(std::string sPrefix, int64_t rv)
         rv++;
     }
 
-    pcursor->close();
+    pcursor.reset();
 
     wdb.TxnAbort();
 
     return true;
 };
 
-inline bool MatchPrefix(uint32_t nAddrBits, uint32_t addrPrefix, uint32_t outputPrefix, bool fHavePrefix)
-{
-    if (nAddrBits < 1) { // addresses without prefixes scan all incoming stealth outputs
-        return true;
-    }
-    if (!fHavePrefix) { // don't check when address has a prefix and no prefix on output
-        return false;
-    }
-
-    uint32_t mask = SetStealthMask(nAddrBits);
-
-    return (addrPrefix & mask) == (outputPrefix & mask);
-};
-
 void CHDWallet::ProcessStealthLookahead(CExtKeyAccount *ea, const CEKAStealthKey &aks, bool v2)
 {
     auto &use_set = v2 ? ea->setLookAheadStealthV2 : ea->setLookAheadStealth;
@@ -9692,8 +11569,15 @@ void CHDWallet::ProcessStealthLookahead(CExtKeyAccount *ea, const CEKAStealthKey
     }
 };
 
+static uint160 GetRescanStealthKeyId(const ec_point &scan_pubkey, const ec_point &spend_pubkey)
+{
+    uint160 id;
+    CHash160().Write(scan_pubkey).Write(spend_pubkey).Finalize(id);
+    return id;
+}
+
 bool CHDWallet::ProcessStealthOutput(const CTxDestination &address,
-    std::vector<uint8_t> &vchEphemPK, uint32_t prefix, bool fHavePrefix, CKey &sShared, bool fNeedShared)
+    std::vector<uint8_t> &vchEphemPK, uint32_t prefix, bool fHavePrefix, CKey &sShared, bool fNeedShared, bool skip_rescan_keys)
 {
     LOCK(cs_wallet);
     ec_point pkExtracted;
@@ -9713,17 +11597,18 @@ bool CHDWallet::ProcessStealthOutput(const CTxDestination &address,
         return true;
     }
 
-    std::set<CStealthAddress>::iterator it;
-    for (it = stealthAddresses.begin(); it != stealthAddresses.end(); ++it) {
-        if (!MatchPrefix(it->prefix.number_bits, it->prefix.bitfield, prefix, fHavePrefix)) {
-            continue;
-        }
-
-        if (!it->scan_secret.IsValid()) {
+    std::vector<const CStealthAddress*> candidates;
+    m_stealth_prefix_index.GetCandidates(prefix, fHavePrefix, candidates);
+    for (const CStealthAddress *sx : candidates) {
+        if (!sx->scan_secret.IsValid()) {
             continue; // stealth address is not owned
         }
+        if (skip_rescan_keys &&
+            m_rescan_stealth_key_ids.count(GetRescanStealthKeyId(sx->scan_pubkey, sx->spend_pubkey))) {
+            continue; // tested in PrepareRescanBlock
+        }
 
-        if (StealthSecret(it->scan_secret, vchEphemPK, it->spend_pubkey, sShared, pkExtracted) != 0) {
+        if (StealthSecret(sx->scan_secret, vchEphemPK, sx->spend_pubkey, sShared, pkExtracted) != 0) {
             WalletLogPrintf("%s: StealthSecret failed.\n", __func__);
             continue;
         }
@@ -9739,17 +11624,17 @@ bool CHDWallet::ProcessStealthOutput(const CTxDestination &address,
         }
 
         if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
-            WalletLogPrintf("Found stealth txn to address %s\n", it->Encoded());
+            WalletLogPrintf("Found stealth txn to address %s\n", sx->Encoded());
         }
 
         CStealthAddressIndexed sxi;
-        it->ToRaw(sxi.addrRaw);
+        sx->ToRaw(sxi.addrRaw);
         uint32_t sxId;
         if (!UpdateStealthAddressIndex(ckidMatch, sxi, sxId)) {
             return werror("%s: UpdateStealthAddressIndex failed.\n", __func__);
         }
 
-        if (!HaveKey(it->spend_secret_id)) {
+        if (!HaveKey(sx->spend_secret_id)) {
             const auto script = GetScriptForDestination(address);
             const auto pk_script = GetScriptForRawPubKey(pkE);  // LegacyScriptPubKeyMan::AddWatchOnlyInMem needs a pubkey to affect mapWatchKeys
             auto spk_man = GetLegacyScriptPubKeyMan();
@@ -9775,7 +11660,7 @@ bool CHDWallet::ProcessStealthOutput(const CTxDestination &address,
             }
 
             CPubKey cpkEphem(vchEphemPK);
-            CPubKey cpkScan(it->scan_pubkey);
+            CPubKey cpkScan(sx->scan_pubkey);
             CStealthKeyMetadata lockedSkMeta(cpkEphem, cpkScan);
 
             if (!CHDWalletDB(*m_database).WriteStealthKeyMeta(idExtracted, lockedSkMeta)) {
@@ -9786,7 +11671,7 @@ bool CHDWallet::ProcessStealthOutput(const CTxDestination &address,
             return true;
         }
 
-        if (!GetKey(it->spend_secret_id, sSpend)) {
+        if (!GetKey(sx->spend_secret_id, sSpend)) {
             // silently fail?
             if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug))
                 WalletLogPrintf("GetKey() stealth spend failed.\n");
@@ -9837,12 +11722,16 @@ bool CHDWallet::ProcessStealthOutput(const CTxDestination &address,
         for (auto it = ea->mapStealthKeys.cbegin(); it != ea->mapStealthKeys.cend(); ++it) {
             const CEKAStealthKey &aks = it->second;
 
-            if (!MatchPrefix(aks.nPrefixBits, aks.nPrefix, prefix, fHavePrefix)) {
+            if (!MatchStealthPrefix(aks.nPrefixBits, aks.nPrefix, prefix, fHavePrefix)) {
                 continue;
             }
             if (!aks.skScan.IsValid()) {
                 continue;
             }
+            if (skip_rescan_keys &&
+                m_rescan_stealth_key_ids.count(GetRescanStealthKeyId(aks.pkScan, aks.pkSpend))) {
+                continue;
+            }
             if (StealthSecret(aks.skScan, vchEphemPK, aks.pkSpend, sShared, pkExtracted) != 0) {
                 WalletLogPrintf("%s: StealthSecret failed.\n", __func__);
                 continue;
@@ -9900,6 +11789,192 @@ bool CHDWallet::ProcessStealthOutput(const CTxDestination &address,
     return false;
 };
 
+void CHDWallet::SetRescanStealthKeys()
+{
+    AssertLockHeld(cs_wallet);
+    ClearRescanStealthKeys();
+
+    for (const auto &sx : stealthAddresses) {
+        if (!sx.scan_secret.IsValid()) {
+            continue;
+        }
+        if (m_rescan_stealth_keys.AddKey(sx.scan_secret, sx.spend_pubkey, sx.prefix.number_bits, sx.prefix.bitfield)) {
+            m_rescan_stealth_key_ids.insert(GetRescanStealthKeyId(sx.scan_pubkey, sx.spend_pubkey));
+        }
+    }
+    for (const auto &mi : mapExtAccounts) {
+        for (const auto &it : mi.second->mapStealthKeys) {
+            const CEKAStealthKey &aks = it.second;
+            if (!aks.skScan.IsValid()) {
+                continue;
+            }
+            if (m_rescan_stealth_keys.AddKey(aks.skScan, aks.pkSpend, aks.nPrefixBits, aks.nPrefix)) {
+                m_rescan_stealth_key_ids.insert(GetRescanStealthKeyId(aks.pkScan, aks.pkSpend));
+            }
+        }
+    }
+}
+
+void CHDWallet::ClearRescanStealthKeys()
+{
+    AssertLockHeld(cs_wallet);
+    m_rescan_stealth_keys.clear();
+    m_rescan_stealth_key_ids.clear();
+    LOCK(m_rescan_hints_mutex);
+    m_rescan_stealth_hints.clear();
+}
+
+void CHDWallet::SetRescanFilter()
+{
+    AssertLockHeld(cs_wallet);
+    ClearRescanFilter();
+
+    if (!chain().hasBlockFilterIndex(BlockFilterType::PARTICL)) {
+        return;
+    }
+    // Stealth outputs pay to one time keys and watch only scripts can't be listed, read every block
+    bool have_stealth = !stealthAddresses.empty();
+    for (const auto &mi : mapExtAccounts) {
+        have_stealth |= !mi.second->mapStealthKeys.empty();
+    }
+    auto spk_man = GetLegacyScriptPubKeyMan();
+    if (have_stealth || (spk_man && spk_man->HaveWatchOnly())) {
+        WalletLogPrintf("%s: Wallet has %s, not using the %s block filter index.\n", __func__,
+                        have_stealth ? "stealth keys" : "watch only scripts", BlockFilterTypeName(BlockFilterType::PARTICL));
+        return;
+    }
+
+    auto add_script = [&](const CScript &script) {
+        m_rescan_filter_elements.emplace(script.begin(), script.end());
+    };
+    if (spk_man) {
+        LOCK(spk_man->cs_KeyStore);
+        for (const auto &id : spk_man->GetKeys()) {
+            CPubKey pk;
+            if (!spk_man->GetPubKey(id, pk)) {
+                continue;
+            }
+            add_script(GetScriptForRawPubKey(pk));
+            add_script(GetScriptForDestination(PKHash(pk)));
+            add_script(GetScriptForDestination(pk.GetID256()));
+        }
+        for (const auto &id : spk_man->GetCScripts()) {
+            CScript script;
+            CScriptID256 id256;
+            if (!spk_man->GetCScript(id, script) || !id256.Set(script)) {
+                continue;
+            }
+            add_script(GetScriptForDestination(ScriptHash(id)));
+            add_script(GetScriptForDestination(id256));
+        }
+    }
+
+    m_rescan_filter_active = true;
+    UpdateRescanFilter();
+    WalletLogPrintf("Matching rescan against the %s block filter index, %d scripts.\n",
+                    BlockFilterTypeName(BlockFilterType::PARTICL), m_rescan_filter_elements.size());
+}
+
+void CHDWallet::ClearRescanFilter()
+{
+    AssertLockHeld(cs_wallet);
+    if (m_rescan_filter_active) {
+        WalletLogPrintf("Rescan skipped %d blocks not matching the block filter.\n", m_rescan_filter_skipped);
+    }
+    m_rescan_filter_active = false;
+    m_rescan_filter_elements.clear();
+    m_rescan_filter_derived.clear();
+    m_rescan_filter_skipped = 0;
+}
+
+void CHDWallet::UpdateRescanFilter()
+{
+    AssertLockHeld(cs_wallet);
+    // Loose keys and account keys are all derived from ext keys in mapExtKeys.
+    // Change and coldstake spend outputs pay to 256 bit key ids, both forms are added.
+    for (const auto &it : mapExtKeys) {
+        const CStoredExtKey *sek = it.second;
+        uint32_t num_keys = std::max(sek->nGenerated, sek->nLastLookAhead > 0 ? sek->nLastLookAhead + 1 : 0);
+        if (sek->IsActive() && sek->IsReceiveEnabled()) {
+            uint64_t num_lookahead = m_default_lookahead;
+            auto itV = sek->mapValue.find(EKVT_N_LOOKAHEAD);
+            if (itV != sek->mapValue.end()) {
+                num_lookahead = GetCompressedInt64(itV->second, num_lookahead);
+            }
+            num_keys = std::max(num_keys, (uint32_t)std::min<uint64_t>(sek->nGenerated + num_lookahead, (uint32_t)1 << 31));
+        }
+        uint32_t &num_derived = m_rescan_filter_derived[it.first];
+        if (num_keys <= num_derived) {
+            continue;
+        }
+        std::vector<std::pair<uint32_t, CPubKey> > keys;
+        if (0 != sek->DeriveKeys(keys, num_derived, num_keys - num_derived, 0)) {
+            continue;
+        }
+        for (const auto &k : keys) {
+            CScript script = GetScriptForDestination(PKHash(k.second));
+            m_rescan_filter_elements.emplace(script.begin(), script.end());
+            script = GetScriptForDestination(k.second.GetID256());
+            m_rescan_filter_elements.emplace(script.begin(), script.end());
+        }
+        num_derived = num_keys;
+    }
+}
+
+std::optional<bool> CHDWallet::RescanFilterMatchesBlock(const uint256 &block_hash)
+{
+    LOCK(cs_wallet);
+    if (!m_rescan_filter_active) {
+        return std::nullopt;
+    }
+    UpdateRescanFilter();
+    std::optional<bool> rv = chain().blockFilterMatchesAny(BlockFilterType::PARTICL, block_hash, m_rescan_filter_elements);
+    if (rv && !*rv) {
+        m_rescan_filter_skipped++;
+    }
+    return rv;
+}
+
+void CHDWallet::PrepareRescanBlock(const CBlock &block)
+{
+    // Find the outputs no stealth key matches, ProcessStealthOutput skips the same ECDH in block order
+    // Runs without cs_wallet, only m_rescan_stealth_keys is read
+    if (m_rescan_stealth_keys.empty()) {
+        return;
+    }
+
+    std::shared_ptr<const BlockScanData> scan_data = GetBlockScanData(block);
+    std::vector<std::pair<COutPoint, bool> > hints;
+    for (const auto &it : *scan_data) {
+        const CBlindOutputScanData &output = it.second;
+        if (output.address.index() != DI::_PKHash ||
+            output.ephem_pubkey.empty()) {
+            continue;
+        }
+
+        // Failures are left to ProcessStealthOutput
+        CKey sShared;
+        CKeyID ckidMatch = ToKeyID(std::get<PKHash>(output.address));
+        bool matched = m_rescan_stealth_keys.Match(output.ephem_pubkey, output.prefix, output.have_prefix, ckidMatch, sShared) != CStealthScanner::NO_MATCH;
+        hints.emplace_back(it.first, matched);
+    }
+
+    LOCK(m_rescan_hints_mutex);
+    m_rescan_stealth_hints.insert(hints.begin(), hints.end());
+}
+
+bool CHDWallet::TakeRescanStealthHint(const COutPoint &outpoint)
+{
+    LOCK(m_rescan_hints_mutex);
+    auto it = m_rescan_stealth_hints.find(outpoint);
+    if (it == m_rescan_stealth_hints.end()) {
+        return false;
+    }
+    bool no_match = !it->second;
+    m_rescan_stealth_hints.erase(it);
+    return no_match;
+}
+
 int CHDWallet::CheckForStealthAndNarration(const CTxOutBase *pb, const CTxOutData *pdata, std::string &sNarr)
 {
     // Returns: -1 error, 0 nothing found, 1 narration, 2 stealth
@@ -10026,6 +12101,7 @@ void CHDWallet::FindStealthTransactions(const CTransaction &tx, mapValue_t &mapN
 bool CHDWallet::ScanForOwnedOutputs(const CTransaction &tx, size_t &nCT, size_t &nRingCT, mapValue_t &mapNarr)
 {
     AssertLockHeld(cs_wallet);
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
 
     bool fIsMine = false;
     mapNarr.clear();
@@ -10033,53 +12109,44 @@ bool CHDWallet::ScanForOwnedOutputs(const CTransaction &tx, size_t &nCT, size_t
     int32_t nOutputId = -1;
     for (const auto &txout : tx.vpout) {
         nOutputId++;
-        if (txout->IsType(OUTPUT_CT)) {
-            nCT++;
-            const CTxOutCT *ctout = (CTxOutCT*) txout.get();
-
-            CTxDestination address;
-            if (!ExtractDestination(ctout->scriptPubKey, address)) {
-                //WalletLogPrintf("%s: ExtractDestination failed.\n", __func__);
-                continue;
+        if (txout->IsType(OUTPUT_CT) || txout->IsType(OUTPUT_RINGCT)) {
+            bool is_ct = txout->IsType(OUTPUT_CT);
+            is_ct ? nCT++ : nRingCT++;
+
+            COutPoint outpoint(tx.GetHash(), nOutputId);
+            CBlindOutputScanData parsed;
+            const CBlindOutputScanData *output = nullptr;
+            if (m_block_scan_data) {
+                auto it = m_block_scan_data->find(outpoint);
+                if (it != m_block_scan_data->end()) {
+                    output = &it->second;
+                }
             }
-            if (IsMine(address)) {
-                fIsMine = true;
+            if (!output) {
+                ParseBlindOutputScanData(txout.get(), parsed);
+                output = &parsed;
             }
 
-            if (address.index() != DI::_PKHash) {
-                continue;
+            if (is_ct) {
+                if (output->address.index() == DI::_CNoDestination) {
+                    //WalletLogPrintf("%s: ExtractDestination failed.\n", __func__);
+                    continue;
+                }
+                if (IsMine(output->address)) {
+                    fIsMine = true;
+                }
             }
-
-
-            // Uncover stealth
-            uint32_t prefix = 0;
-            bool fHavePrefix = ExtractStealthPrefix(ctout->vData, prefix);
-
-            CKey sShared;
-            std::vector<uint8_t> vchEphemPK;
-            vchEphemPK.resize(33);
-            memcpy(&vchEphemPK[0], &ctout->vData[0], 33);
-
-            if (ProcessStealthOutput(address, vchEphemPK, prefix, fHavePrefix, sShared)) {
-                fIsMine = true;
+            if (output->address.index() != DI::_PKHash ||
+                output->ephem_pubkey.empty()) {
+                continue;
             }
-        } else
-        if (txout->IsType(OUTPUT_RINGCT)) {
-            nRingCT++;
-            const CTxOutRingCT *rctout = (CTxOutRingCT*) txout.get();
-
-            CKeyID idk = rctout->pk.GetID();
 
             // Uncover stealth
-            uint32_t prefix = 0;
-            bool fHavePrefix = ExtractStealthPrefix(rctout->vData, prefix);
-
             CKey sShared;
-            std::vector<uint8_t> vchEphemPK;
-            vchEphemPK.resize(33);
-            memcpy(&vchEphemPK[0], &rctout->vData[0], 33);
+            std::vector<uint8_t> vchEphemPK = output->ephem_pubkey;
 
-            if (ProcessStealthOutput(PKHash(idk), vchEphemPK, prefix, fHavePrefix, sShared)) {
+            bool skip_rescan_keys = TakeRescanStealthHint(outpoint);
+            if (ProcessStealthOutput(output->address, vchEphemPK, output->prefix, output->have_prefix, sShared, false, skip_rescan_keys)) {
                 fIsMine = true;
             }
         } else
@@ -10108,6 +12175,13 @@ bool CHDWallet::ScanForOwnedOutputs(const CTransaction &tx, size_t &nCT, size_t
         }
     }
 
+    TRACE6(wallet, scan_owned_outputs,
+        GetName().c_str(),
+        tx.GetHash().data(),
+        (uint64_t)nCT,
+        (uint64_t)nRingCT,
+        fIsMine,
+        GetTimeMicros() - start_us);
     return fIsMine;
 };
 
@@ -10190,6 +12264,80 @@ int CHDWallet::UnloadSpent(const uint256 &wtxid, int depth, const uint256 &wtxid
     return 1;
 };
 
+size_t CHDWallet::ArchiveSpentRecords()
+{
+    AssertLockHeld(cs_wallet);
+    if (!m_chain || m_archive_record_depth < 1) {
+        return 0;
+    }
+
+    // An output is archivable once spent by a txn that can't be reorged out either
+    auto is_spent_deep = [&](const uint256 &txhash, uint32_t n) {
+        const COutPoint outpoint(txhash, n);
+        if (m_collapsed_txn_inputs.find(outpoint) != m_collapsed_txn_inputs.end()) {
+            return true;
+        }
+        auto range = mapTxSpends.equal_range(outpoint);
+        for (auto it = range.first; it != range.second; ++it) {
+            MapRecords_t::const_iterator rit = mapRecords.find(it->second);
+            if (rit != mapRecords.end() && !rit->second.IsAbandoned() &&
+                GetDepthInMainChain(rit->second) >= m_archive_record_depth) {
+                return true;
+            }
+            MapWallet_t::const_iterator mit = mapWallet.find(it->second);
+            if (mit != mapWallet.end() && !mit->second.isAbandoned() &&
+                GetTxDepthInMainChain(mit->second) >= m_archive_record_depth) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<uint256> archive;
+    for (const auto &ri : mapRecords) {
+        const CTransactionRecord &rtx = ri.second;
+        if (rtx.IsAbandoned() || GetDepthInMainChain(rtx) < m_archive_record_depth) {
+            continue;
+        }
+        bool fully_spent = true;
+        for (const auto &r : rtx.vout) {
+            if ((r.nFlags & ORF_OWN_ANY) && !is_spent_deep(ri.first, r.n)) {
+                fully_spent = false;
+                break;
+            }
+        }
+        if (fully_spent) {
+            archive.push_back(ri.first);
+        }
+    }
+
+    for (const auto &txhash : archive) {
+        MapRecords_t::const_iterator mri = mapRecords.find(txhash);
+        if (mri == mapRecords.end()) {
+            continue;
+        }
+        // The spends of the record are removed with it, keep the inputs it spent marked as spent
+        for (const auto &prevout : mri->second.vin) {
+            if (m_collapsed_txns.find(prevout.hash) == m_collapsed_txns.end()) {
+                m_collapsed_txn_inputs.insert(prevout);
+            }
+        }
+        m_collapsed_txns.insert(txhash);
+        UnloadTransaction(txhash);
+
+        auto itl = m_collapsed_txn_inputs.lower_bound(COutPoint(txhash, 0));
+        while (itl != m_collapsed_txn_inputs.end() && itl->hash == txhash) {
+            m_collapsed_txn_inputs.erase(itl++);
+        }
+    }
+
+    m_num_archived_records += archive.size();
+    if (archive.size() > 0) {
+        WalletLogPrintf("Archived %u spent transaction record%s.\n", archive.size(), archive.size() == 1 ? "" : "s");
+    }
+    return archive.size();
+};
+
 void CHDWallet::PostProcessUnloadSpent()
 {
     LogPrint(BCLog::HDWALLET, "%s %s\n", GetDisplayName(), __func__);
@@ -10312,13 +12460,11 @@ bool CHDWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const SyncT
                     continue;
                 }
 
-                CHDWalletDB wdb(*m_database);
                 for (size_t k = 0; k < nInputs; ++k) {
                     const CCmpPubKey &ki = *((CCmpPubKey*)&vKeyImages[k*33]);
                     COutPoint prevout;
 
-                    // TODO: Keep keyimages in memory
-                    if (!wdb.ReadAnonKeyImage(ki, prevout)) {
+                    if (!GetAnonKeyImageOutpoint(ki, prevout)) {
                         continue;
                     }
                     fIsFromMe = true;
@@ -10372,6 +12518,7 @@ bool CHDWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const SyncT
             if (fExisted && tx.IsCoinStake() && hash_block.IsNull()) {
                 uint256 hashTx = tx.GetHash();
                 WalletLogPrintf("Orphaning stake txn: %s\n", hashTx.ToString());
+                g_staking_perf.stakes_orphaned++;
 
                 // If block is later reconnected tx will be unabandoned by AddToWallet
                 if (!AbandonTransaction(hashTx)) {
@@ -10448,14 +12595,132 @@ void CHDWallet::SetTempTxnStatus(CWalletTx &wtx, const CTransactionRecord *rtx)
     wtx.nTimeReceived = rtx->nTimeReceived;
 };
 
+bool CHDWallet::GetStoredTx(CHDWalletDB &wdb, const uint256 &txid, CStoredTransaction &stx) const
+{
+    AssertLockHeld(cs_wallet);
+    const auto it = m_pending_stored_txns.find(txid);
+    if (it != m_pending_stored_txns.end()) {
+        stx = it->second;
+        return true;
+    }
+    return wdb.ReadStoredTx(txid, stx);
+}
+
+bool CHDWallet::ExpandStoredTx(const uint256 &txid, CStoredTransaction &stx) const
+{
+    AssertLockHeld(cs_wallet);
+    if (!stx.IsCompact()) {
+        return true;
+    }
+    const auto mri = mapRecords.find(txid);
+    if (mri == mapRecords.end() || mri->second.HashUnset() || mri->second.nIndex < 0) {
+        WalletLogPrintf("%s: No block for compact txn %s.\n", __func__, txid.ToString());
+        return false;
+    }
+    const CTransactionRecord &rtx = mri->second;
+
+    CBlock block;
+    if (!chain().findBlock(rtx.blockHash, FoundBlock().data(block)) ||
+        rtx.nIndex >= (int)block.vtx.size() ||
+        block.vtx[rtx.nIndex]->GetHash() != txid) {
+        WalletLogPrintf("%s: Could not read compact txn %s from block %s.\n", __func__, txid.ToString(), rtx.blockHash.ToString());
+        return false;
+    }
+    stx.tx = block.vtx[rtx.nIndex];
+    return true;
+}
+
+bool CHDWallet::GetPrevoutData(CHDWalletDB &wdb, const COutPoint &op, CPrevoutData &data) const
+{
+    AssertLockHeld(cs_wallet);
+    if (m_prevout_data_cache.Get(op, data)) {
+        return true;
+    }
+
+    CStoredTransaction stx;
+    if (!GetStoredTx(wdb, op.hash, stx)) {
+        return werror("%s: ReadStoredTx failed for %s.", __func__, op.hash.ToString());
+    }
+    if (op.n >= stx.tx->vpout.size()) {
+        return werror("%s: Output %d not found in %s.", __func__, op.n, op.hash.ToString());
+    }
+    data.nType = stx.tx->vpout[op.n]->GetType();
+    if (data.nType == OUTPUT_RINGCT) {
+        stx.GetAnonPubkey(op.n, data.anon_pubkey);
+    }
+    if (!stx.GetBlind(op.n, data.blind.begin())) {
+        return werror("%s: GetBlind failed for %s, %d.", __func__, op.hash.ToString(), op.n);
+    }
+    m_prevout_data_cache.Insert(op, data);
+    return true;
+}
+
+static uint256 RewoundOutputKey(const uint256 &nonce, const secp256k1_pedersen_commitment &commitment)
+{
+    uint256 key;
+    CSHA256().Write(nonce.begin(), 32).Write(commitment.data, 33).Finalize(key.begin());
+    return key;
+}
+
+bool CHDWallet::GetRewoundOutput(const uint256 &nonce, const secp256k1_pedersen_commitment &commitment, CRewoundOutput &rewound) const
+{
+    AssertLockHeld(cs_wallet);
+    return m_rewound_output_cache.Get(RewoundOutputKey(nonce, commitment), rewound);
+}
+
+void CHDWallet::CacheRewoundOutput(const uint256 &nonce, const secp256k1_pedersen_commitment &commitment, const CRewoundOutput &rewound) const
+{
+    AssertLockHeld(cs_wallet);
+    m_rewound_output_cache.Insert(RewoundOutputKey(nonce, commitment), rewound);
+}
+
+bool CHDWallet::GetOwnedOutputNonce(const CTxOutBase *txout, uint256 &nonce) const
+{
+    AssertLockHeld(cs_wallet);
+    const std::vector<uint8_t> *vData = txout->GetPData();
+    const std::vector<uint8_t> *vRangeproof = txout->GetPRangeproof();
+    if (!vData || !vRangeproof ||
+        vData->size() < 33 || vRangeproof->size() >= 1000) {
+        return false;
+    }
+
+    CKeyID idk;
+    if (txout->IsType(OUTPUT_CT)) {
+        const CEKAKey *pak = nullptr;
+        const CEKASCKey *pasc = nullptr;
+        CExtKeyAccount *pa = nullptr;
+        bool isInvalid = false;
+        if (!(IsMine(((const CTxOutCT*)txout)->scriptPubKey, idk, pak, pasc, pa, isInvalid) & ISMINE_ALL)) {
+            return false;
+        }
+    } else
+    if (txout->IsType(OUTPUT_RINGCT)) {
+        idk = ((const CTxOutRingCT*)txout)->pk.GetID();
+    } else {
+        return false;
+    }
+
+    CKey key;
+    if (!GetKey(idk, key)) {
+        return false;
+    }
+    CPubKey pkEphem;
+    pkEphem.Set(vData->begin(), vData->begin() + 33);
+    nonce = key.ECDH(pkEphem);
+    CSHA256().Write(nonce.begin(), 32).Finalize(nonce.begin());
+    return true;
+}
+
 int CHDWallet::InsertTempTxn(const uint256 &txid, const CTransactionRecord *rtx) const
 {
     LOCK(cs_wallet);
 
     CStoredTransaction stx;
-    if (!CHDWalletDB(*m_database).ReadStoredTx(txid, stx)) {
+    CHDWalletDB wdb(*m_database);
+    if (!GetStoredTx(wdb, txid, stx)) {
         return werrorN(1, "%s: ReadStoredTx failed for %s.\n", __func__, txid.ToString().c_str());
     }
+    ExpandStoredTx(txid, stx);
 
     auto ret = mapTempWallet.emplace(std::piecewise_construct, std::forward_as_tuple(txid), std::forward_as_tuple(stx.tx, TxStateInactive{}));
 
@@ -10551,6 +12816,13 @@ void ExtractNarration(const uint256 &nonce, const std::vector<uint8_t> &vData, s
     pkEphem.Set(vData.begin(), vData.begin() + 33);
 
     int nNarrOffset = -1;
+    int nAggOffset = GetAggregateAmountOffset(vData);
+    if (nAggOffset >= 0) {
+        size_t o = nAggOffset + AGGREGATE_AMOUNT_SIZE;
+        if (vData.size() > o && vData[o] == DO_NARR_CRYPT) {
+            nNarrOffset = o + 1;
+        }
+    } else
     if (vData.size() > 38 && vData[38] == DO_NARR_CRYPT) {
         nNarrOffset = 39;
     } else
@@ -10579,6 +12851,23 @@ void ExtractNarration(const uint256 &nonce, const std::vector<uint8_t> &vData, s
     sNarr = std::string(vchNarr.begin(), vchNarr.end());
 };
 
+/** True if an earlier rewind stored the blind of rout in stx, checked against the output commitment rather than rewinding the rangeproof again */
+static bool HaveRewoundOutput(const COutputRecord &rout, const CStoredTransaction &stx, const secp256k1_pedersen_commitment &commitment)
+{
+    if ((rout.nFlags & ORF_LOCKED) || rout.nValue < 0) {
+        return false;
+    }
+    uint8_t blind[32];
+    if (!stx.GetBlind(rout.n, blind)) {
+        return false;
+    }
+    secp256k1_pedersen_commitment check;
+    if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind, &check, blind, (uint64_t)rout.nValue, blind_precomp_h)) {
+        return false;
+    }
+    return memcmp(check.data, commitment.data, 33) == 0;
+}
+
 int CHDWallet::OwnBlindOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOutCT *pout, const CStoredExtKey *pc, uint32_t &nLastChild,
     COutputRecord &rout, CStoredTransaction &stx, bool &fUpdated)
 {
@@ -10633,6 +12922,10 @@ int CHDWallet::OwnBlindOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOu
         return 1;
     }
 
+    if (HaveRewoundOutput(rout, stx, pout->commitment)) {
+        return 1;
+    }
+
     if (pout->vData.size() < 33) {
         return werrorN(0, "%s: vData.size() < 33.", __func__);
     }
@@ -10657,10 +12950,14 @@ int CHDWallet::OwnBlindOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOu
 
     if (pout->vRangeproof.size() < 1000) {
         int rewind_rv = 0;
+        CRewoundOutput rewound;
+        if (!nonce.IsNull() && GetRewoundOutput(nonce, pout->commitment, rewound)) {
+            amountOut = rewound.nValue;
+            memcpy(blindOut, rewound.blind.begin(), 32);
+            rewind_rv = 1;
+        } else
         if (!nonce.IsNull()) {
-            rewind_rv = secp256k1_bulletproof_rangeproof_rewind(secp256k1_ctx_blind, blind_gens,
-                &amountOut, blindOut, pout->vRangeproof.data(), pout->vRangeproof.size(),
-                0, &pout->commitment, &secp256k1_generator_const_h, nonce.begin(), nullptr, 0);
+            rewind_rv = RewindBulletproofOutput(pout->vRangeproof, pout->vData, &pout->commitment, nonce, amountOut, blindOut);
         }
 
         // Try again with the watch_only_nonce
@@ -10690,13 +12987,11 @@ int CHDWallet::OwnBlindOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOu
                 watch_only_nonce = scan_secret.ECDH(pk_tweaked);
                 CSHA256().Write(watch_only_nonce.begin(), 32).Finalize(watch_only_nonce.begin());
 
-                rewind_rv = secp256k1_bulletproof_rangeproof_rewind(secp256k1_ctx_blind, blind_gens,
-                    &amountOut, blindOut, pout->vRangeproof.data(), pout->vRangeproof.size(),
-                    0, &pout->commitment, &secp256k1_generator_const_h, watch_only_nonce.begin(), nullptr, 0);
+                rewind_rv = RewindBulletproofOutput(pout->vRangeproof, pout->vData, &pout->commitment, watch_only_nonce, amountOut, blindOut);
             }
         }
         if (rewind_rv != 1) {
-            return werrorN(0, "%s: secp256k1_bulletproof_rangeproof_rewind failed.", __func__);
+            return werrorN(0, "%s: RewindBulletproofOutput failed.", __func__);
         }
 
         ExtractNarration(nonce, pout->vData, rout.sNarration);
@@ -10770,6 +13065,10 @@ int CHDWallet::OwnAnonOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOut
         return 1;
     }
 
+    if (HaveRewoundOutput(rout, stx, pout->commitment)) {
+        return 1;
+    }
+
     if (pout->vData.size() < 33) {
         return werrorN(0, "%s: vData.size() < 33.", __func__);
     }
@@ -10793,10 +13092,14 @@ int CHDWallet::OwnAnonOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOut
 
     if (pout->vRangeproof.size() < 1000) {
         int rewind_rv = 0;
+        CRewoundOutput rewound;
+        if (!nonce.IsNull() && GetRewoundOutput(nonce, pout->commitment, rewound)) {
+            amountOut = rewound.nValue;
+            memcpy(blindOut, rewound.blind.begin(), 32);
+            rewind_rv = 1;
+        } else
         if (!nonce.IsNull()) {
-            rewind_rv = secp256k1_bulletproof_rangeproof_rewind(secp256k1_ctx_blind, blind_gens,
-                &amountOut, blindOut, pout->vRangeproof.data(), pout->vRangeproof.size(),
-                0, &pout->commitment, &secp256k1_generator_const_h, nonce.begin(), nullptr, 0);
+            rewind_rv = RewindBulletproofOutput(pout->vRangeproof, pout->vData, &pout->commitment, nonce, amountOut, blindOut);
         }
 
         // Try again with the watch_only_nonce
@@ -10825,13 +13128,11 @@ int CHDWallet::OwnAnonOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOut
                 watch_only_nonce = scan_secret.ECDH(pk_tweaked);
                 CSHA256().Write(watch_only_nonce.begin(), 32).Finalize(watch_only_nonce.begin());
 
-                rewind_rv = secp256k1_bulletproof_rangeproof_rewind(secp256k1_ctx_blind, blind_gens,
-                    &amountOut, blindOut, pout->vRangeproof.data(), pout->vRangeproof.size(),
-                    0, &pout->commitment, &secp256k1_generator_const_h, watch_only_nonce.begin(), nullptr, 0);
+                rewind_rv = RewindBulletproofOutput(pout->vRangeproof, pout->vData, &pout->commitment, watch_only_nonce, amountOut, blindOut);
             }
         }
         if (rewind_rv != 1) {
-            return werrorN(0, "%s: secp256k1_bulletproof_rangeproof_rewind failed.", __func__);
+            return werrorN(0, "%s: RewindBulletproofOutput failed.", __func__);
         }
 
         ExtractNarration(nonce, pout->vData, rout.sNarration);
@@ -10871,10 +13172,13 @@ int CHDWallet::OwnAnonOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOut
     COutPoint op(txhash, rout.n);
     CCmpPubKey ki;
 
+    if (m_defer_key_images) {
+        m_pending_key_images.push_back({op, pout->pk, key});
+    } else
     if (0 != secp256k1_get_keyimage(ki.ncbegin(), pout->pk.begin(), key.begin())) {
         WalletLogPrintf("Error: %s - secp256k1_get_keyimage failed.\n", __func__);
     } else
-    if (!pwdb->WriteAnonKeyImage(ki, op)) {
+    if (!WriteAnonKeyImage(pwdb, ki, op)) {
         WalletLogPrintf("Error: %s - WriteAnonKeyImage failed.\n", __func__);
     }
 
@@ -10969,6 +13273,9 @@ bool CHDWallet::AddToRecord(CTransactionRecord &rtxIn, const CTransaction &tx, c
             SetTempTxnStatus(it->second, &rtx);
         }
     }
+    if (rtx.blockHash.IsNull()) {
+        m_unconfirmed_records.insert(txhash);
+    }
 
     // Anon input spend info depends on keys in wallet
     if (tx.vin.size() > 0 && tx.vin[0].IsAnonInput()) {  // Only check the first input, input types can't be mixed.
@@ -10990,7 +13297,7 @@ bool CHDWallet::AddToRecord(CTransactionRecord &rtxIn, const CTransaction &tx, c
 
             for (size_t k = 0; k < nInputs; ++k) {
                 const CCmpPubKey &ki = *((CCmpPubKey*)&vKeyImages[k * 33]);
-                if (!wdb.ReadAnonKeyImage(ki, op)) {
+                if (!GetAnonKeyImageOutpoint(ki, op)) {
                     //WalletLogPrintf("Warning: Unknown keyimage %s.\n", ki.ToString());
                     continue;
                 }
@@ -11067,7 +13374,7 @@ bool CHDWallet::AddToRecord(CTransactionRecord &rtxIn, const CTransaction &tx, c
     }
 
     CStoredTransaction stx;
-    if (!wdb.ReadStoredTx(txhash, stx)) {
+    if (!GetStoredTx(wdb, txhash, stx)) {
         stx.vBlinds.clear();
     }
 
@@ -11169,9 +13476,26 @@ bool CHDWallet::AddToRecord(CTransactionRecord &rtxIn, const CTransaction &tx, c
         }
 
         stx.tx = MakeTransactionRef(tx);
-        if (!wdb.WriteTxRecord(txhash, rtx) ||
-            !wdb.WriteStoredTx(txhash, stx)) {
-            return false;
+        if (m_compact_stored_txns && !hash_block.IsNull() && !rtx.IsAbandoned() && nIndex >= 0) {
+            // Locked outputs are rewound from the stored txn when the wallet is unlocked
+            bool have_locked = false;
+            for (const auto &r : rtx.vout) {
+                if (r.nFlags & ORF_LOCKED) {
+                    have_locked = true;
+                    break;
+                }
+            }
+            if (!have_locked && !chain().havePruned()) {
+                stx.Compact();
+            }
+        }
+        if (m_defer_record_writes) {
+            m_pending_stored_txns[txhash] = std::move(stx);
+        } else {
+            if (!wdb.WriteTxRecord(txhash, rtx) ||
+                !wdb.WriteStoredTx(txhash, stx)) {
+                return false;
+            }
         }
     }
 
@@ -11191,14 +13515,28 @@ bool CHDWallet::AddToRecord(CTransactionRecord &rtxIn, const CTransaction &tx, c
 
     std::string sName = GetName();
     GetMainSignals().TransactionAddedToWallet(sName, MakeTransactionRef(tx));
-    ClearCachedBalances();
+    ClearCachedBalances(tx);
 
     return true;
 };
 
 CWallet::ScanResult CHDWallet::ScanForWalletTransactions(const uint256& start_block, int start_height, std::optional<int> max_height, const WalletRescanReserver& reserver, bool fUpdate)
 {
-    CExtKeyAccount *sea = nullptr;
+    if (fUpdate && !WITH_LOCK(cs_wallet, return m_rescan_progress.has_value())) {
+        // Track the scan so it can be resumed if interrupted
+        return RescanHeightRanges({{start_height, max_height ? *max_height : -1}}, reserver);
+    }
+    size_t stealth_v1_lookahead = m_rescan_stealth_v1_lookahead;
+    size_t stealth_v2_lookahead = m_rescan_stealth_v2_lookahead;
+    {
+        LOCK(cs_wallet);
+        if (m_rescan_progress) {
+            stealth_v1_lookahead = m_rescan_progress->stealth_v1_lookahead;
+            stealth_v2_lookahead = m_rescan_progress->stealth_v2_lookahead;
+        }
+    }
+
+    CExtKeyAccount *sea = nullptr;
 
     if (!IsLocked()) {
         ExtKeyAccountMap::iterator mi = mapExtAccounts.find(idDefaultAccount);
@@ -11215,7 +13553,7 @@ CWallet::ScanResult CHDWallet::ScanForWalletTransactions(const uint256& start_bl
         CStoredExtKey *sek = sea->GetChain(nChain);
         if (sek) {
             uint32_t nKey = sek->nHGenerated;
-            for (size_t k = 0; k < m_rescan_stealth_v1_lookahead; ++k) {
+            for (size_t k = 0; k < stealth_v1_lookahead; ++k) {
                 NewStealthKeyFromAccount(nullptr, idDefaultAccount, "", akStealth, 0, nullptr, false, &nKey);
                 nKey += 1;
                 if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
@@ -11250,7 +13588,7 @@ CWallet::ScanResult CHDWallet::ScanForWalletTransactions(const uint256& start_bl
         if (!wdb.TxnBegin()) {
             WalletLogPrintf("%s TxnBegin failed.\n", __func__);
         } else
-        for (size_t k = 0; k < m_rescan_stealth_v2_lookahead; ++k) {
+        for (size_t k = 0; k < stealth_v2_lookahead; ++k) {
             NewStealthKeyV2FromAccount(&wdb, idDefaultAccount, "", akStealth, 0, nullptr, true, &nScanKey, &nSpendKey);
             nScanKey += 1;
             nSpendKey += 1;
@@ -11264,7 +13602,20 @@ CWallet::ScanResult CHDWallet::ScanForWalletTransactions(const uint256& start_bl
                         IsLocked() ? "Wallet is locked" : sea ? "Default account has no private key" : "Default account not found");
     }
 
+    {
+        LOCK(cs_wallet);
+        if (m_rescan_prefetch_blocks > 0) {
+            SetRescanStealthKeys();
+        }
+        SetRescanFilter();
+    }
+
     ScanResult rv = CWallet::ScanForWalletTransactions(start_block, start_height, max_height, reserver, fUpdate);
+    {
+        LOCK(cs_wallet);
+        ClearRescanStealthKeys();
+        ClearRescanFilter();
+    }
 
     // Remove lookahead keys
     if (sea) {
@@ -11281,26 +13632,182 @@ CWallet::ScanResult CHDWallet::ScanForWalletTransactions(const uint256& start_bl
     return rv;
 };
 
-std::vector<uint256> CHDWallet::ResendRecordTransactionsBefore(int64_t nTime)
+static void MergeRescanRanges(std::vector<std::pair<int, int> > &ranges)
 {
-    std::vector<uint256> result;
+    auto range_end = [](const std::pair<int, int> &r) {
+        return r.second < 0 ? std::numeric_limits<int64_t>::max() : (int64_t)r.second;
+    };
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<std::pair<int, int> > merged;
+    for (const auto &r : ranges) {
+        if (!merged.empty() && r.first <= range_end(merged.back()) + 1) {
+            if (range_end(r) > range_end(merged.back())) {
+                merged.back().second = r.second;
+            }
+            continue;
+        }
+        merged.push_back(r);
+    }
+    ranges = std::move(merged);
+}
+
+bool CHDWallet::GetRescanProgress(CRescanProgress &progress)
+{
+    CHDWalletDB wdb(*m_database);
+    if (!wdb.ReadRescanProgress(progress) || progress.ranges.empty()) {
+        return false;
+    }
+    if (!progress.locator.IsNull()) {
+        // Continue after the last block scanned that is still in the chain
+        std::optional<int> fork_height = chain().findLocatorFork(progress.locator);
+        if (fork_height && *fork_height >= progress.ranges[0].first) {
+            progress.ranges[0].first = *fork_height + 1;
+        }
+        if (progress.ranges[0].second >= 0 && progress.ranges[0].first > progress.ranges[0].second) {
+            progress.ranges.erase(progress.ranges.begin());
+        }
+        progress.locator.SetNull();
+        progress.last_height = -1;
+    }
+    return !progress.ranges.empty();
+}
 
+void CHDWallet::SaveRescanProgress(const uint256 &block_hash, int block_height)
+{
+    CBlockLocator locator;
+    if (!chain().findBlock(block_hash, FoundBlock().locator(locator))) {
+        return;
+    }
     LOCK(cs_wallet);
+    if (!m_rescan_progress) {
+        return;
+    }
+    m_rescan_progress->locator = locator;
+    m_rescan_progress->last_height = block_height;
+    CHDWalletDB wdb(*m_database);
+    if (!wdb.WriteRescanProgress(*m_rescan_progress)) {
+        WalletLogPrintf("%s: WriteRescanProgress failed.\n", __func__);
+    }
+    if (m_rescan_best_block_height && block_height > *m_rescan_best_block_height) {
+        // The wallet is synced up to the block, a restart continues from here
+        wdb.WriteBestBlock(locator);
+    }
+}
 
-    for (RtxOrdered_t::iterator it = rtxOrdered.begin(); it != rtxOrdered.end(); ++it) {
-        if (it->first > nTime) {
-            continue;
+CWallet::ScanResult CHDWallet::RescanHeightRanges(std::vector<std::pair<int, int> > ranges, const WalletRescanReserver &reserver)
+{
+    CRescanProgress progress;
+    if (GetRescanProgress(progress)) {
+        WalletLogPrintf("Merging %d height range(s) left by an interrupted rescan.\n", progress.ranges.size());
+        ranges.insert(ranges.end(), progress.ranges.begin(), progress.ranges.end());
+    }
+    MergeRescanRanges(ranges);
+    progress.ranges = ranges;
+    progress.locator.SetNull();
+    progress.last_height = -1;
+    progress.stealth_v1_lookahead = std::max<uint32_t>(progress.stealth_v1_lookahead, m_rescan_stealth_v1_lookahead);
+    progress.stealth_v2_lookahead = std::max<uint32_t>(progress.stealth_v2_lookahead, m_rescan_stealth_v2_lookahead);
+    {
+        LOCK(cs_wallet);
+        m_rescan_progress = progress;
+        CHDWalletDB wdb(*m_database);
+        if (!wdb.WriteRescanProgress(progress)) {
+            WalletLogPrintf("%s: WriteRescanProgress failed.\n", __func__);
+        }
+    }
+
+    // Ranges are scanned one after the other, a spend must be synced after the output it spends.
+    ScanResult result;
+    bool scanned_range = false;
+    for (;;) {
+        std::pair<int, int> range;
+        {
+            LOCK(cs_wallet);
+            if (m_rescan_progress->ranges.empty()) {
+                break;
+            }
+            range = m_rescan_progress->ranges.front();
+        }
+        if (scanned_range && (IsAbortingRescan() || chain().shutdownRequested())) {
+            result.status = ScanResult::USER_ABORT;
+            break;
+        }
+        int tip_height = chain().getHeight().value_or(-1);
+        if (range.first <= tip_height) {
+            std::optional<int> max_height;
+            if (range.second >= 0) {
+                max_height = std::min(range.second, tip_height);
+            }
+            std::optional<int> best_block_height;
+            CBlockLocator best_block;
+            if (!max_height && WalletBatch(GetDatabase()).ReadBestBlock(best_block)) {
+                // Scanning on from the wallet's best block, progress can be kept there too
+                best_block_height = chain().findLocatorFork(best_block);
+                if (best_block_height && *best_block_height + 1 < range.first) {
+                    best_block_height.reset();
+                }
+            }
+            WITH_LOCK(cs_wallet, m_rescan_best_block_height = best_block_height);
+            result = ScanForWalletTransactions(chain().getBlockHash(range.first), range.first, max_height, reserver, true);
+            scanned_range = true;
+            if (result.status != ScanResult::SUCCESS) {
+                break;
+            }
+        }
+        LOCK(cs_wallet);
+        m_rescan_progress->ranges.erase(m_rescan_progress->ranges.begin());
+        m_rescan_progress->locator.SetNull();
+        m_rescan_progress->last_height = -1;
+        CHDWalletDB wdb(*m_database);
+        if (!wdb.WriteRescanProgress(*m_rescan_progress)) {
+            WalletLogPrintf("%s: WriteRescanProgress failed.\n", __func__);
         }
+    }
+
+    LOCK(cs_wallet);
+    if (result.status != ScanResult::USER_ABORT) {
+        // A failed scan is not resumed, the blocks could not be read
+        CHDWalletDB wdb(*m_database);
+        if (!wdb.EraseRescanProgress()) {
+            WalletLogPrintf("%s: EraseRescanProgress failed.\n", __func__);
+        }
+    }
+    m_rescan_progress.reset();
+    m_rescan_best_block_height.reset();
+    return result;
+};
 
-        const uint256 &txhash = it->second->first;
-        CTransactionRecord &rtx = it->second->second;
+CWallet::ScanResult CHDWallet::ResumeRescan(const WalletRescanReserver &reserver)
+{
+    return RescanHeightRanges({}, reserver);
+};
+
+std::vector<uint256> CHDWallet::ResendRecordTransactionsBefore(int64_t nTime)
+{
+    std::vector<uint256> result;
+
+    LOCK(cs_wallet);
 
-        if (rtx.IsAbandoned()) {
+    // Sort them in chronological order, parents are submitted before their spends
+    std::multimap<int64_t, MapRecords_t::iterator> sorted;
+    for (auto it = m_unconfirmed_records.begin(); it != m_unconfirmed_records.end();) {
+        MapRecords_t::iterator mri = mapRecords.find(*it);
+        if (mri == mapRecords.end() ||
+            mri->second.IsAbandoned() ||
+            GetDepthInMainChain(mri->second) != 0) {
+            it = m_unconfirmed_records.erase(it);
             continue;
         }
-        if (GetDepthInMainChain(rtx) != 0) {
+        ++it;
+        if (mri->second.GetTxTime() > nTime) {
             continue;
         }
+        sorted.emplace(mri->second.GetTxTime(), mri);
+    }
+
+    for (const auto &it : sorted) {
+        const uint256 &txhash = it.second->first;
+        CTransactionRecord &rtx = it.second->second;
 
         MapWallet_t::iterator twi = mapTempWallet.find(txhash);
         if (twi == mapTempWallet.end()) {
@@ -11341,14 +13848,9 @@ void CHDWallet::ResendWalletTransactions()
         LOCK(cs_wallet);
 
         // Relay transactions
-        for (std::pair<const uint256, CWalletTx>& item : mapWallet) {
-            CWalletTx& wtx = item.second;
-            // only rebroadcast unconfirmed txes older than 5 minutes before the
-            // last block was found
-            if (wtx.nTimeReceived > m_best_block_time - 5 * 60) continue;
-            std::string unused_err_string;
-            if (SubmitTxMemoryPoolAndRelay(wtx, unused_err_string, true)) ++relayed_tx_count;
-        }
+        // only rebroadcast unconfirmed txes older than 5 minutes before the
+        // last block was found
+        relayed_tx_count = ResendWalletTransactionsBefore(m_best_block_time - 5 * 60).size();
 
         std::vector<uint256> relayed_records = ResendRecordTransactionsBefore(m_best_block_time - 5 * 60);
         relayed_tx_count += relayed_records.size();
@@ -11359,6 +13861,165 @@ void CHDWallet::ResendWalletTransactions()
     }
 };
 
+void CHDWallet::MaybeConsolidateOutputs()
+{
+    int64_t now = GetTime();
+    {
+        LOCK(cs_wallet);
+        if (!m_consolidation.enabled || now < m_consolidation.next_run) {
+            return;
+        }
+        m_consolidation.next_run = now + CONSOLIDATION_INTERVAL;
+    }
+    if (!chain().isReadyToBroadcast() || !fBroadcastTransactions) {
+        return;
+    }
+
+    LOCK(cs_wallet);
+    CConsolidationState &cs = m_consolidation;
+    cs.last_run = now;
+    if (IsLocked() || fUnlockForStakingOnly) {
+        cs.status = "Wallet is locked.";
+        return;
+    }
+    if (IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS)) {
+        cs.status = "Private keys are disabled.";
+        return;
+    }
+
+    // One consolidation in flight at a time, the next would select the same outputs
+    if (!cs.last_txid.IsNull()) {
+        MapRecords_t::const_iterator mri = mapRecords.find(cs.last_txid);
+        if (mri != mapRecords.end() && !mri->second.IsAbandoned() && GetDepthInMainChain(mri->second) < 1) {
+            cs.status = "Waiting for " + cs.last_txid.ToString() + " to confirm.";
+            return;
+        }
+    }
+
+    CCoinControl cctl;
+    cctl.m_min_depth = cs.min_depth;
+    CFeeRate wallet_feerate = GetMinimumFeeRate(*this, cctl, nullptr);
+    CFeeRate max_feerate = cs.max_feerate == CFeeRate(0) ? m_consolidate_feerate : cs.max_feerate;
+    if (wallet_feerate > max_feerate) {
+        cs.status = strprintf("Feerate %s is above %s.", wallet_feerate.ToString(), max_feerate.ToString());
+        return;
+    }
+
+    cs.status = "Idle.";
+    for (OutputTypes type : {OUTPUT_CT, OUTPUT_RINGCT}) {
+        if ((type == OUTPUT_CT && !cs.blind) || (type == OUTPUT_RINGCT && !cs.anon)) {
+            continue;
+        }
+        std::vector<COutputR> coins;
+        if (type == OUTPUT_CT) {
+            AvailableBlindedCoins(coins, &cctl, 1, cs.max_value, MAX_MONEY, 0, OutputOrder::VALUE_ASC);
+        } else {
+            AvailableAnonCoins(coins, &cctl, 1, cs.max_value, MAX_MONEY, 0, OutputOrder::VALUE_ASC);
+        }
+        coins.erase(std::remove_if(coins.begin(), coins.end(), [](const COutputR &c) {
+            return !c.fSpendable || c.fNeedHardwareKey;
+        }), coins.end());
+        (type == OUTPUT_CT ? cs.small_blind : cs.small_anon) = coins.size();
+        if (coins.size() <= cs.min_outputs) {
+            continue;
+        }
+
+        uint256 txid;
+        std::string sError;
+        if (0 != ConsolidateOutputs(type, coins, txid, sError)) {
+            cs.status = "Failed: " + sError;
+            WalletLogPrintf("%s: %s\n", __func__, cs.status);
+            return;
+        }
+        size_t num_inputs = std::min(coins.size(), type == OUTPUT_RINGCT ? std::min(cs.max_inputs, MAX_ANON_INPUTS) : cs.max_inputs);
+        cs.num_txns++;
+        cs.num_inputs += num_inputs;
+        cs.last_txid = txid;
+        cs.status = "Sent " + txid.ToString() + ".";
+        WalletLogPrintf("%s: Spent %d small %s outputs in %s\n", __func__, num_inputs, type == OUTPUT_CT ? "blind" : "anon", txid.ToString());
+        return;
+    }
+};
+
+int CHDWallet::ConsolidateOutputs(OutputTypes type, const std::vector<COutputR> &coins, uint256 &txid, std::string &sError)
+{
+    AssertLockHeld(cs_wallet);
+    size_t max_inputs = type == OUTPUT_RINGCT ? std::min(m_consolidation.max_inputs, MAX_ANON_INPUTS) : m_consolidation.max_inputs;
+    if (coins.size() < 2) {
+        return wserrorN(1, sError, __func__, "Too few inputs.");
+    }
+
+    CCoinControl cctl;
+    cctl.fAllowOtherInputs = false;
+    cctl.m_addChangeOutput = false;
+    cctl.nCoinType = type;
+    cctl.m_min_depth = m_consolidation.min_depth;
+    CAmount total = 0;
+    for (size_t i = 0; i < coins.size() && i < max_inputs; ++i) {
+        const COutputR &c = coins[i];
+        const COutputRecord *oR = c.rtx->second.GetOutput(c.i);
+        if (!oR) {
+            return wserrorN(1, sError, __func__, "Output record not found.");
+        }
+        cctl.Select(COutPoint(c.txhash, c.i));
+        total += oR->nValue;
+    }
+
+    CTempRecipient r;
+    r.nType = type;
+    r.SetAmount(total);
+    r.fSubtractFeeFromAmount = true;
+    if (type == OUTPUT_CT) {
+        CPubKey pk;
+        if (0 != GetChangeAddress(pk)) {
+            return wserrorN(1, sError, __func__, "GetChangeAddress failed.");
+        }
+        r.pkTo = pk;
+        r.address = PKHash(pk);
+    } else {
+        // Anon outputs can only be sent to a stealth address
+        ExtKeyAccountMap::iterator mi = mapExtAccounts.find(idDefaultAccount);
+        if (mi == mapExtAccounts.end()) {
+            return wserrorN(1, sError, __func__, "Default account not found.");
+        }
+        CStealthAddress sx;
+        if (!mi->second->mapStealthKeys.empty()) {
+            mi->second->mapStealthKeys.begin()->second.SetSxAddr(sx);
+        } else {
+            CEKAStealthKey akStealth;
+            if (0 != NewStealthKeyFromAccount("consolidation", akStealth, 0, nullptr)) {
+                return wserrorN(1, sError, __func__, "NewStealthKeyFromAccount failed.");
+            }
+            akStealth.SetSxAddr(sx);
+        }
+        r.address = sx;
+    }
+    std::vector<CTempRecipient> vecSend;
+    vecSend.push_back(r);
+
+    CTransactionRef tx_new;
+    CWalletTx wtx(tx_new, TxStateInactive{});
+    CTransactionRecord rtx;
+    CAmount nFee;
+    if (type == OUTPUT_CT) {
+        if (0 != AddBlindedInputs(wtx, rtx, vecSend, true, nFee, &cctl, sError)) {
+            return 1;
+        }
+    } else {
+        size_t ring_size = m_consolidation.ring_size > 0 ? m_consolidation.ring_size : DEFAULT_RING_SIZE;
+        if (0 != AddAnonInputs(wtx, rtx, vecSend, true, ring_size, 1, nFee, &cctl, sError)) {
+            return 1;
+        }
+    }
+
+    TxValidationState state;
+    if (!CommitTransaction(wtx, rtx, state, wtx.mapValue, wtx.vOrderForm, true)) {
+        return wserrorN(1, sError, __func__, "CommitTransaction failed: %s", state.ToString());
+    }
+    txid = wtx.GetHash();
+    return 0;
+};
+
 void CHDWallet::AvailableCoins(std::vector<COutput> &vCoins, const CCoinControl *coinControl, std::optional<CFeeRate> feerate, const CAmount &nMinimumAmount, const CAmount &nMaximumAmount, const CAmount &nMinimumSumAmount, const uint64_t nMaximumCount) const
 {
     AssertLockHeld(cs_wallet);
@@ -11494,7 +14155,12 @@ void CHDWallet::AvailableCoins(std::vector<COutput> &vCoins, const CCoinControl
         }
     }
 
-    for (MapRecords_t::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it) {
+    UpdateUnspentRecordSets();
+    for (const auto &unspent_txid : m_unspent_standard_txns) {
+        MapRecords_t::const_iterator it = mapRecords.find(unspent_txid);
+        if (it == mapRecords.end()) {
+            continue;
+        }
         const uint256 &txid = it->first;
         const CTransactionRecord &rtx = it->second;
 
@@ -11752,7 +14418,29 @@ std::optional<SelectionResult> CHDWallet::SelectCoins(const std::vector<COutput>
     return res;
 };
 
-void CHDWallet::AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoinControl *coinControl, const CAmount& nMinimumAmount, const CAmount& nMaximumAmount, const CAmount& nMinimumSumAmount, const uint64_t& nMaximumCount) const
+/** Visit the outpoints of index with values in [min_value, max_value] in order, stops when f returns true */
+template <typename F>
+static void ForEachUnspentByValue(const std::set<std::pair<CAmount, COutPoint> > &index, OutputOrder order, CAmount min_value, CAmount max_value, F f)
+{
+    auto lo = index.lower_bound({min_value, COutPoint(uint256(), 0)});
+    auto hi = max_value < MAX_MONEY ? index.lower_bound({max_value + 1, COutPoint(uint256(), 0)}) : index.end();
+    if (order == OutputOrder::VALUE_DESC) {
+        for (auto it = hi; it != lo;) {
+            --it;
+            if (f(it->second)) {
+                return;
+            }
+        }
+        return;
+    }
+    for (auto it = lo; it != hi; ++it) {
+        if (f(it->second)) {
+            return;
+        }
+    }
+}
+
+void CHDWallet::AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoinControl *coinControl, const CAmount& nMinimumAmount, const CAmount& nMaximumAmount, const CAmount& nMinimumSumAmount, const uint64_t& nMaximumCount, OutputOrder order, const OutputFilter &filter) const
 {
     AssertLockHeld(cs_wallet);
 
@@ -11795,16 +14483,18 @@ void CHDWallet::AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoin
 
     const Consensus::Params &consensusParams = Params().GetConsensus();
     bool exploit_fix_2_active = GetTime() >= consensusParams.exploit_fix_2_time;
-    for (MapRecords_t::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it) {
+    UpdateUnspentRecordSets();
+    // Returns true once nMinimumSumAmount or nMaximumCount is reached, if only is set other outputs of the txn are skipped
+    auto add_outputs = [&](MapRecords_t::const_iterator it, const COutputRecord *only) -> bool {
         const uint256 &txid = it->first;
         const CTransactionRecord &rtx = it->second;
 
         if (exploit_fix_2_active && rtx.block_height > 0) { // height 0 is mempool
             if (!spend_frozen && rtx.block_height <= consensusParams.m_frozen_blinded_height) {
-                continue;
+                return false;
             } else
             if (spend_frozen && rtx.block_height > consensusParams.m_frozen_blinded_height) {
-                continue;
+                return false;
             }
         }
 
@@ -11814,15 +14504,15 @@ void CHDWallet::AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoin
 
         int nDepth = GetDepthInMainChain(rtx);
         if (nDepth < 0)
-            continue;
+            return false;
 
         if (nDepth < min_depth || nDepth > max_depth)
-            continue;
+            return false;
 
         // We should not consider coins which aren't at least in our mempool
         // It's possible for these to be conflicted via ancestors which we may never be able to detect
         if (nDepth == 0 && !InMempool(txid))
-            continue;
+            return false;
 
         bool safeTx = IsTrusted(txid, rtx);
         if (nDepth == 0 && rtx.mapValue.count(RTXVT_REPLACES_TXID)) {
@@ -11834,11 +14524,11 @@ void CHDWallet::AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoin
         }
 
         if (only_safe && !safeTx) {
-            continue;
+            return false;
         }
 
         for (const auto &r : rtx.vout) {
-            if (r.nType != OUTPUT_CT) {
+            if ((only && &r != only) || r.nType != OUTPUT_CT) {
                 continue;
             }
 
@@ -11874,6 +14564,10 @@ void CHDWallet::AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoin
                 continue;
             }
 
+            if (filter && !filter(txid, r)) {
+                continue;
+            }
+
             bool fMature = true;
             bool fSpendable = (coinControl && !coinControl->fAllowWatchOnly && !(r.nFlags & ORF_OWNED)) ? false : true;
             bool fSolvable = true;
@@ -11885,21 +14579,41 @@ void CHDWallet::AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoin
                 nTotal += r.nValue;
 
                 if (nTotal >= nMinimumSumAmount) {
-                    return;
+                    return true;
                 }
             }
 
             // Checks the maximum number of UTXO's.
             if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
-                return;
+                return true;
             }
         }
+        return false;
+    };
+
+    if (order != OutputOrder::NONE) {
+        ForEachUnspentByValue(m_unspent_blind_by_value, order, nMinimumAmount, nMaximumAmount, [&](const COutPoint &op) {
+            MapRecords_t::const_iterator it = mapRecords.find(op.hash);
+            const COutputRecord *r = it != mapRecords.end() ? it->second.GetOutput(op.n) : nullptr;
+            return r && add_outputs(it, r);
+        });
+        return;
+    }
+
+    for (const auto &unspent_txid : m_unspent_blind_txns) {
+        MapRecords_t::const_iterator it = mapRecords.find(unspent_txid);
+        if (it == mapRecords.end()) {
+            continue;
+        }
+        if (add_outputs(it, nullptr)) {
+            return;
+        }
     }
 
     return;
 };
 
-bool CHDWallet::SelectBlindedCoins(const std::vector<COutputR> &vAvailableCoins, const CAmount &nTargetValue, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet, const CCoinControl *coinControl, bool random_selection) const
+bool CHDWallet::SelectBlindedCoins(const std::vector<COutputR> &vAvailableCoins, const CAmount &nTargetValue, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet, const CCoinControl *coinControl, bool random_selection, CAmount cost_of_change) const
 {
     std::vector<COutputR> vCoins(vAvailableCoins);
 
@@ -11960,6 +14674,12 @@ bool CHDWallet::SelectBlindedCoins(const std::vector<COutputR> &vAvailableCoins,
     size_t max_descendants = (size_t)std::max<int64_t>(1, gArgs.GetIntArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT));
     bool fRejectLongChains = gArgs.GetBoolArg("-walletrejectlongchains", DEFAULT_WALLET_REJECT_LONG_CHAINS);
     bool res = nTargetValue <= nValueFromPresetInputs;
+    if (!res && cost_of_change > 0) {
+        // Prefer a changeless input set, every blinded output costs a rangeproof to create and verify
+        size_t max_inputs = random_selection ? prefer_max_num_anon_inputs : 0;
+        res = AttemptBnBSelection(nTargetValue - nValueFromPresetInputs, cost_of_change, CoinEligibilityFilter(1, 6, 0), max_inputs, vCoins, setCoinsRet, nValueRet) ||
+            AttemptBnBSelection(nTargetValue - nValueFromPresetInputs, cost_of_change, CoinEligibilityFilter(1, 1, 0), max_inputs, vCoins, setCoinsRet, nValueRet);
+    }
     if (!res) {
         if (random_selection) {
             Shuffle(vCoins.begin(), vCoins.end(), FastRandomContext());
@@ -12029,7 +14749,60 @@ bool CHDWallet::SelectBlindedCoins(const std::vector<COutputR> &vAvailableCoins,
     return res;
 };
 
-void CHDWallet::AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinControl *coinControl, const CAmount& nMinimumAmount, const CAmount& nMaximumAmount, const CAmount& nMinimumSumAmount, const uint64_t& nMaximumCount) const
+void CHDWallet::UpdateUnspentRecordSets() const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!m_have_unspent_record_sets) {
+        m_have_unspent_record_sets = true;
+        m_unspent_standard_txns.clear();
+        m_unspent_blind_txns.clear();
+        m_unspent_anon_txns.clear();
+        m_unspent_blind_by_value.clear();
+        m_unspent_anon_by_value.clear();
+        m_unspent_txn_values.clear();
+        m_unspent_records_dirty.clear();
+        for (const auto &ri : mapRecords) {
+            m_unspent_records_dirty.insert(ri.first);
+        }
+    }
+
+    for (const auto &txid : m_unspent_records_dirty) {
+        m_unspent_standard_txns.erase(txid);
+        m_unspent_blind_txns.erase(txid);
+        m_unspent_anon_txns.erase(txid);
+        auto vi = m_unspent_txn_values.find(txid);
+        if (vi != m_unspent_txn_values.end()) {
+            for (const auto &v : vi->second) {
+                m_unspent_blind_by_value.erase({v.first, COutPoint(txid, v.second)});
+                m_unspent_anon_by_value.erase({v.first, COutPoint(txid, v.second)});
+            }
+            m_unspent_txn_values.erase(vi);
+        }
+        MapRecords_t::const_iterator mri = mapRecords.find(txid);
+        if (mri == mapRecords.end()) {
+            continue;
+        }
+        for (const auto &r : mri->second.vout) {
+            if (r.nType == OUTPUT_STANDARD && (r.nFlags & ORF_OWN_ANY) && !IsSpent(txid, r.n)) {
+                m_unspent_standard_txns.insert(txid);
+            } else
+            if (r.nType == OUTPUT_CT && (r.nFlags & ORF_OWN_ANY) && !IsSpent(txid, r.n)) {
+                m_unspent_blind_txns.insert(txid);
+                m_unspent_blind_by_value.insert({r.nValue, COutPoint(txid, r.n)});
+                m_unspent_txn_values[txid].emplace_back(r.nValue, r.n);
+            } else
+            if (r.nType == OUTPUT_RINGCT && (r.nFlags & ORF_OWNED) && !IsSpent(txid, r.n)) {
+                m_unspent_anon_txns.insert(txid);
+                m_unspent_anon_by_value.insert({r.nValue, COutPoint(txid, r.n)});
+                m_unspent_txn_values[txid].emplace_back(r.nValue, r.n);
+            }
+        }
+    }
+    m_unspent_records_dirty.clear();
+};
+
+void CHDWallet::AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinControl *coinControl, const CAmount& nMinimumAmount, const CAmount& nMaximumAmount, const CAmount& nMinimumSumAmount, const uint64_t& nMaximumCount, OutputOrder order, const OutputFilter &filter) const
 {
     AssertLockHeld(cs_wallet);
 
@@ -12050,16 +14823,18 @@ void CHDWallet::AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinCon
 
     const Consensus::Params &consensusParams = Params().GetConsensus();
     bool exploit_fix_2_active = GetTime() >= consensusParams.exploit_fix_2_time;
-    for (MapRecords_t::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it) {
+    UpdateUnspentRecordSets();
+    // Returns true once nMinimumSumAmount or nMaximumCount is reached, if only is set other outputs of the txn are skipped
+    auto add_outputs = [&](MapRecords_t::const_iterator it, const COutputRecord *only) -> bool {
         const uint256 &txid = it->first;
         const CTransactionRecord &rtx = it->second;
 
         if (exploit_fix_2_active && rtx.block_height > 0) { // height 0 is mempool
             if (!spend_frozen && rtx.block_height <= consensusParams.m_frozen_blinded_height) {
-                continue;
+                return false;
             } else
             if (spend_frozen && rtx.block_height > consensusParams.m_frozen_blinded_height) {
-                continue;
+                return false;
             }
         }
 
@@ -12071,23 +14846,23 @@ void CHDWallet::AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinCon
         bool fMature = nDepth >= consensusParams.nMinRCTOutputDepth;
         if (!fIncludeImmature &&
             !fMature) {
-            continue;
+            return false;
         }
 
         // Coins at depth 0 will never be available, no need to check depth0 cases
 
         if (nDepth < min_depth || nDepth > max_depth) {
-            continue;
+            return false;
         }
 
         bool safeTx = IsTrusted(txid, rtx);
 
         if (only_safe && !safeTx) {
-            continue;
+            return false;
         }
 
         for (const auto &r : rtx.vout) {
-            if (r.nType != OUTPUT_RINGCT) {
+            if ((only && &r != only) || r.nType != OUTPUT_RINGCT) {
                 continue;
             }
 
@@ -12124,6 +14899,10 @@ void CHDWallet::AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinCon
                 continue;
             }
 
+            if (filter && !filter(txid, r)) {
+                continue;
+            }
+
             bool fSpendable = (coinControl && !coinControl->fAllowWatchOnly && !(r.nFlags & ORF_OWNED)) ? false : true;
             bool fSolvable = true;
             bool fNeedHardwareKey = (r.nFlags & ORF_HARDWARE_DEVICE);
@@ -12134,15 +14913,35 @@ void CHDWallet::AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinCon
                 nTotal += r.nValue;
 
                 if (nTotal >= nMinimumSumAmount) {
-                    return;
+                    return true;
                 }
             }
 
             // Checks the maximum number of UTXO's.
             if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
-                return;
+                return true;
             }
         }
+        return false;
+    };
+
+    if (order != OutputOrder::NONE) {
+        ForEachUnspentByValue(m_unspent_anon_by_value, order, nMinimumAmount, nMaximumAmount, [&](const COutPoint &op) {
+            MapRecords_t::const_iterator it = mapRecords.find(op.hash);
+            const COutputRecord *r = it != mapRecords.end() ? it->second.GetOutput(op.n) : nullptr;
+            return r && add_outputs(it, r);
+        });
+        return;
+    }
+
+    for (const auto &unspent_txid : m_unspent_anon_txns) {
+        MapRecords_t::const_iterator it = mapRecords.find(unspent_txid);
+        if (it == mapRecords.end()) {
+            continue;
+        }
+        if (add_outputs(it, nullptr)) {
+            return;
+        }
     }
 
     Shuffle(vCoins.begin(), vCoins.end(), FastRandomContext());
@@ -12388,18 +15187,87 @@ static void ApproximateBestSubset(std::vector<std::pair<CAmount, std::pair<MapRe
     return;
 }
 
-bool CHDWallet::AttemptSelection(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter,
-    std::vector<COutputR> vCoins, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> >& setCoinsRet, CAmount& nValueRet) const
+CAmount CHDWallet::GetBlindedChangeCost(const CCoinControl &coin_control, bool anon, size_t ring_size) const
 {
-    setCoinsRet.clear();
-    nValueRet = 0;
-
-    // List of values less than target
-    std::pair<CAmount, std::pair<MapRecords_t::const_iterator,unsigned int> > coinLowestLarger;
-    coinLowestLarger.first = std::numeric_limits<CAmount>::max();
-    coinLowestLarger.second.first = mapRecords.end();
-    std::vector<std::pair<CAmount, std::pair<MapRecords_t::const_iterator,unsigned int> > > vValue;
-    CAmount nTotalLower = 0;
+    size_t output_bytes = GetBulletproofSize(1) + (anon ? RINGCT_OUTPUT_BASE_SIZE : CT_OUTPUT_BASE_SIZE);
+    size_t spend_vbytes = CT_INPUT_VSIZE;
+    if (anon) {
+        // Single input MLSAG: key image in scriptData, ring member indices and the signature in the witness
+        size_t witness_bytes = ring_size * (3 + 2 * 32) + 32 + 33 + 6;
+        spend_vbytes = 41 + 35 + witness_bytes / WITNESS_SCALE_FACTOR;
+    }
+    CFeeRate feerate = GetMinimumFeeRate(*this, coin_control, nullptr);
+    return feerate.GetFee(output_bytes) + m_discard_rate.GetFee(spend_vbytes);
+};
+
+bool CHDWallet::AttemptBnBSelection(const CAmount& nTargetValue, const CAmount& cost_of_change, const CoinEligibilityFilter& eligibility_filter, size_t max_inputs,
+    const std::vector<COutputR> &vCoins, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> >& setCoinsRet, CAmount& nValueRet) const
+{
+    std::map<COutPoint, MapRecords_t::const_iterator> coin_records;
+    std::vector<OutputGroup> groups;
+    for (const auto &r : vCoins) {
+        MapRecords_t::const_iterator rtxi = r.rtx;
+        const CTransactionRecord *rtx = &rtxi->second;
+
+        const CWalletTx *pcoin = GetWalletOrTempTx(r.txhash, rtx);
+        if (!pcoin) {
+            return werror("%s: GetWalletOrTempTx failed.\n", __func__);
+        }
+        bool from_me = CachedTxIsFromMe(*this, *pcoin, ISMINE_ALL);
+        if (r.nDepth < (from_me ? eligibility_filter.conf_mine : eligibility_filter.conf_theirs)) {
+            continue;
+        }
+
+        size_t ancestors, descendants;
+        chain().getTransactionAncestry(r.txhash, ancestors, descendants);
+        if (ancestors > eligibility_filter.max_ancestors || descendants > eligibility_filter.max_descendants) {
+             continue;
+        }
+
+        const COutputRecord *oR = rtx->GetOutput(r.i);
+        if (!oR) {
+            return werror("%s: GetOutput failed, %s, %d.\n", r.txhash.ToString(), r.i);
+        }
+        if (oR->nValue <= 0) {
+            continue;
+        }
+
+        // Selected by value, the fee loop of the caller adds the cost of the inputs to nTargetValue
+        COutput output(COutPoint(r.txhash, r.i), CTxOut(oR->nValue, oR->scriptPubKey), r.nDepth, -1, true, true, true, 0, from_me, CAmount{0});
+        OutputGroup group;
+        group.Insert(output, ancestors, descendants, false);
+        groups.push_back(group);
+        coin_records.emplace(output.outpoint, rtxi);
+    }
+
+    std::optional<SelectionResult> result = SelectCoinsBnB(groups, nTargetValue, cost_of_change);
+    if (!result || (max_inputs > 0 && result->GetInputSet().size() > max_inputs)) {
+        return false;
+    }
+
+    for (const auto &output : result->GetInputSet()) {
+        setCoinsRet.push_back(std::make_pair(coin_records[output.outpoint], output.outpoint.n));
+        nValueRet += output.txout.nValue;
+    }
+    if (LogAcceptCategory(BCLog::SELECTCOINS, BCLog::Level::Debug)) {
+        WalletLogPrintf("SelectBlindedCoins() changeless: %d inputs, total %s\n", result->GetInputSet().size(), FormatMoney(result->GetSelectedValue()));
+    }
+
+    return true;
+}
+
+bool CHDWallet::AttemptSelection(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter,
+    std::vector<COutputR> vCoins, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> >& setCoinsRet, CAmount& nValueRet) const
+{
+    setCoinsRet.clear();
+    nValueRet = 0;
+
+    // List of values less than target
+    std::pair<CAmount, std::pair<MapRecords_t::const_iterator,unsigned int> > coinLowestLarger;
+    coinLowestLarger.first = std::numeric_limits<CAmount>::max();
+    coinLowestLarger.second.first = mapRecords.end();
+    std::vector<std::pair<CAmount, std::pair<MapRecords_t::const_iterator,unsigned int> > > vValue;
+    CAmount nTotalLower = 0;
 
     Shuffle(vCoins.begin(), vCoins.end(), FastRandomContext());
 
@@ -12582,6 +15450,43 @@ bool CHDWallet::GetSpendingTxid(const uint256& hash, unsigned int n, uint256 &sp
     return false;
 };
 
+bool CHDWallet::GetAnonKeyImageOutpoint(const CCmpPubKey &ki, COutPoint &op) const
+{
+    AssertLockHeld(cs_wallet);
+    auto it = m_anon_key_images.find(ki);
+    if (it == m_anon_key_images.end()) {
+        return false;
+    }
+    op = it->second;
+    return true;
+};
+
+std::set<uint256> CHDWallet::GetKeyImageSpends(const CCmpPubKey &ki) const
+{
+    AssertLockHeld(cs_wallet);
+    std::set<uint256> result;
+    COutPoint op;
+    if (!GetAnonKeyImageOutpoint(ki, op)) {
+        return result;
+    }
+    // Spends of anon outputs are added to mapTxSpends by the outpoint, see AddToRecord
+    auto range = mapTxSpends.equal_range(op);
+    for (auto it = range.first; it != range.second; ++it) {
+        result.insert(it->second);
+    }
+    return result;
+};
+
+bool CHDWallet::WriteAnonKeyImage(CHDWalletDB *pwdb, const CCmpPubKey &ki, const COutPoint &op)
+{
+    AssertLockHeld(cs_wallet);
+    if (!pwdb->WriteAnonKeyImage(ki, op)) {
+        return false;
+    }
+    m_anon_key_images[ki] = op;
+    return true;
+};
+
 bool CHDWallet::IsSpentKey(const CScript *pscript) const
 {
     CTxDestination dst;
@@ -12779,6 +15684,8 @@ bool CHDWallet::AbandonTransaction(const uint256 &hashTx)
         }
     }
 
+    ResetTxnCaches(); // Spent state of the inputs changed
+
     return true;
 };
 
@@ -12874,6 +15781,7 @@ void CHDWallet::MarkConflicted(const uint256 &hashBlock, int conflicting_height,
     if (nChangedRecords > 0) { // HACK, alternative is to load CStoredTransaction to get vin
         MarkDirty();
     }
+    ResetTxnCaches();
 
     if (LogAcceptCategory(BCLog::HDWALLET, BCLog::Level::Debug)) {
         WalletLogPrintf("%s: %s, %s processed %d txns.\n", __func__, hashBlock.ToString(), hashTx.ToString(), done.size());
@@ -12953,6 +15861,7 @@ bool CHDWallet::SetSetting(const std::string &setting, const UniValue &json)
     if (!wdb.WriteWalletSetting(setting, sJson)) {
         return false;
     }
+    m_coinstake_templates_stale = true;
     return true;
 };
 
@@ -12965,6 +15874,7 @@ bool CHDWallet::EraseSetting(const std::string &setting)
     if (!wdb.EraseWalletSetting(setting)) {
         return false;
     }
+    m_coinstake_templates_stale = true;
     return true;
 };
 
@@ -13007,22 +15917,281 @@ size_t CHDWallet::CountColdstakeOutputs()
 {
     LOCK(cs_wallet);
 
-    size_t nColdstakeOutputs = 0;
-    std::vector<COutput> vAvailableCoins;
-    CAmount nMinimumAmount = 0, nMaximumAmount = MAX_MONEY, nMinimumSumAmount = 0;
-    uint64_t nMaximumCount = 0;
+    UpdateStakeScriptTotals();
+    return m_coldstake_totals.nOutputs;
+};
 
-    CCoinControl coinControl;
-    coinControl.m_include_immature = true;
-    coinControl.m_include_unsafe_inputs = true;
-    AvailableCoins(vAvailableCoins, &coinControl, std::nullopt, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount);
-    for (const auto &coin : vAvailableCoins) {
-        if (HasIsCoinstakeOp(coin.txout.scriptPubKey)) {
-            nColdstakeOutputs++;
+static size_t RecordsDynamicUsage(const MapRecords_t &records)
+{
+    size_t usage = memusage::DynamicUsage(records);
+    for (const auto &ri : records) {
+        const CTransactionRecord &rtx = ri.second;
+        usage += memusage::DynamicUsage(rtx.vin) + memusage::DynamicUsage(rtx.vout) + memusage::DynamicUsage(rtx.mapValue);
+        for (const auto &v : rtx.mapValue) {
+            usage += memusage::DynamicUsage(v.second);
+        }
+        for (const auto &r : rtx.vout) {
+            usage += memusage::DynamicUsage(r.scriptPubKey) + memusage::DynamicUsage(r.vPath);
+        }
+    }
+    return usage;
+}
+
+void CHDWallet::GetMemoryUsage(std::map<std::string, size_t> &usage) const
+{
+    LOCK(cs_wallet);
+
+    size_t transactions = memusage::DynamicUsage(mapWallet) +
+        memusage::MallocUsage(sizeof(memusage::stl_tree_node<TxSpends::value_type>)) * mapTxSpends.size();
+    for (const auto &wi : mapWallet) {
+        transactions += memusage::DynamicUsage(wi.second.tx) + RecursiveDynamicUsage(*wi.second.tx);
+    }
+    usage["transactions"] = transactions;
+
+    usage["records"] = RecordsDynamicUsage(mapRecords) + RecordsDynamicUsage(mapTempRecords) +
+        memusage::MallocUsage(sizeof(memusage::stl_tree_node<RtxOrdered_t::value_type>)) * rtxOrdered.size();
+
+    size_t keys = memusage::DynamicUsage(mapExtKeys) + memusage::DynamicUsage(mapExtAccounts) +
+        memusage::DynamicUsage(mapLooseKeys) + memusage::DynamicUsage(mapLooseLookAhead) +
+        memusage::DynamicUsage(stealthAddresses) + memusage::DynamicUsage(m_derived_keys);
+    keys += memusage::MallocUsage(sizeof(CStoredExtKey)) * mapExtKeys.size();
+    for (const auto &mi : mapExtAccounts) {
+        const CExtKeyAccount *sea = mi.second;
+        LOCK(sea->cs_account);
+        keys += memusage::MallocUsage(sizeof(CExtKeyAccount)) +
+            memusage::DynamicUsage(sea->mapKeys) + memusage::DynamicUsage(sea->mapLookAhead) +
+            memusage::DynamicUsage(sea->mapStealthKeys) + memusage::DynamicUsage(sea->mapStealthChildKeys) +
+            memusage::DynamicUsage(sea->setLookAheadStealth) + memusage::DynamicUsage(sea->setLookAheadStealthV2) +
+            memusage::DynamicUsage(sea->vExtKeys) + memusage::DynamicUsage(sea->vExtKeyIDs);
+    }
+    usage["keys"] = keys;
+
+    size_t caches = memusage::DynamicUsage(m_txn_balances) + memusage::DynamicUsage(m_balances_dirty) + memusage::DynamicUsage(m_balances_volatile) +
+        memusage::DynamicUsage(m_unspent_standard_txns) + memusage::DynamicUsage(m_unspent_blind_txns) + memusage::DynamicUsage(m_unspent_anon_txns) +
+        memusage::DynamicUsage(m_unspent_records_dirty) + memusage::DynamicUsage(m_unspent_blind_by_value) + memusage::DynamicUsage(m_unspent_anon_by_value) +
+        memusage::DynamicUsage(m_unspent_txn_values) +
+        memusage::DynamicUsage(m_stake_script_txns) + memusage::DynamicUsage(m_coldstake_by_stake_key) + memusage::DynamicUsage(m_coldstake_by_spend_key) +
+        memusage::DynamicUsage(m_address_txn_totals) + memusage::DynamicUsage(m_address_totals) +
+        memusage::DynamicUsage(m_cached_stakeable_coins) + memusage::DynamicUsage(m_stake_candidates) +
+        m_prevout_data_cache.DynamicMemoryUsage() + m_rewound_output_cache.DynamicMemoryUsage() + m_ismine_cache.DynamicMemoryUsage() +
+        memusage::DynamicUsage(m_anon_key_images);
+    for (const auto &vi : m_unspent_txn_values) {
+        caches += memusage::DynamicUsage(vi.second);
+    }
+    for (const auto &si : m_stake_script_txns) {
+        caches += memusage::DynamicUsage(si.second);
+    }
+    for (const auto &ai : m_address_txn_totals) {
+        caches += memusage::DynamicUsage(ai.second);
+    }
+    usage["caches"] = caches;
+};
+
+static void AddStakeScriptOutput(const CScript &script, bool fColdStake, CAmount nValue, bool fSafe, bool fSpendable, bool fStaking, std::vector<CStakeScriptOutput> &outputs)
+{
+    CStakeScriptOutput output;
+    output.fColdStake = fColdStake;
+    if (fColdStake) {
+        particl::ExtractStakingKeyID(script, output.idStake);
+        ExtractDestination(script, output.destSpend);
+    }
+    output.totals.nOutputs = 1;
+    output.totals.nValue = nValue;
+    if (fSafe) {
+        output.totals.nSafe = nValue;
+        output.totals.nSafeSpendable = fSpendable ? nValue : 0;
+        output.totals.nStaking = fStaking ? nValue : 0;
+    }
+    outputs.push_back(output);
+};
+
+void CHDWallet::AddStakeScriptOutputs(const CWalletTx &wtx, int nRequiredDepth, std::vector<CStakeScriptOutput> &outputs, bool &is_volatile) const
+{
+    // Same filters as AvailableCoins with immature and unsafe outputs included
+    const uint256 &txid = wtx.GetHash();
+    int nDepth = GetTxDepthInMainChain(wtx);
+    if (nDepth < 0) {
+        return;
+    }
+    if (nDepth == 0 && !wtx.InMempool()) {
+        return;
+    }
+    bool safeTx = CachedTxIsTrusted(*this, wtx);
+    if (nDepth == 0 && (wtx.mapValue.count("replaces_txid") || wtx.mapValue.count("replaced_by_txid"))) {
+        safeTx = false;
+    }
+
+    size_t num_outputs = outputs.size();
+    for (unsigned int i = 0; i < wtx.tx->vpout.size(); i++) {
+        if (!wtx.tx->vpout[i]->IsStandardOutput()) {
+            continue;
+        }
+        const CTxOutStandard *txout = wtx.tx->vpout[i]->GetStandardOutput();
+        const CScript &script = txout->scriptPubKey;
+        bool fColdStake = HasIsCoinstakeOp(script);
+        if (!fColdStake && !script.IsPayToPublicKeyHash() && !script.IsPayToPublicKeyHash256()) {
+            continue;
+        }
+        if (IsLockedCoin(txid, i) || IsSpent(txid, i)) {
+            continue;
+        }
+        isminetype mine = IsMine(txout);
+        if (mine == ISMINE_NO) {
+            continue;
+        }
+        bool fSpendable = (mine & ISMINE_SPENDABLE) != ISMINE_NO;
+        if (!fColdStake && !fSpendable) {
+            continue;
+        }
+        AddStakeScriptOutput(script, fColdStake, txout->nValue, safeTx, fSpendable, nDepth >= nRequiredDepth, outputs);
+    }
+
+    if (outputs.size() > num_outputs &&
+        (nDepth < Params().GetStakeMinConfirmations() || GetTxBlocksToMaturity(wtx) > 0)) {
+        is_volatile = true;
+    }
+};
+
+void CHDWallet::AddStakeScriptOutputs(const uint256 &txid, const CTransactionRecord &rtx, int nRequiredDepth, std::vector<CStakeScriptOutput> &outputs, bool &is_volatile) const
+{
+    int nDepth = GetDepthInMainChain(rtx);
+    if (nDepth < 0) {
+        return;
+    }
+    if (nDepth == 0 && !InMempool(txid)) {
+        return;
+    }
+    bool safeTx = IsTrusted(txid, rtx);
+    if (nDepth == 0 && (rtx.mapValue.count(RTXVT_REPLACES_TXID) || rtx.mapValue.count(RTXVT_REPLACED_BY_TXID))) {
+        safeTx = false;
+    }
+
+    size_t num_outputs = outputs.size();
+    for (const auto &r : rtx.vout) {
+        if (r.nType != OUTPUT_STANDARD ||
+            !(r.nFlags & ORF_OWN_ANY)) {
+            continue;
+        }
+        bool fColdStake = HasIsCoinstakeOp(r.scriptPubKey);
+        if (!fColdStake && !r.scriptPubKey.IsPayToPublicKeyHash() && !r.scriptPubKey.IsPayToPublicKeyHash256()) {
+            continue;
+        }
+        if (IsLockedCoin(txid, r.n) || IsSpent(txid, r.n)) {
+            continue;
+        }
+        bool fSpendable = r.nFlags & ORF_OWNED;
+        if (!fColdStake && !fSpendable) {
+            continue;
+        }
+        AddStakeScriptOutput(r.scriptPubKey, fColdStake, r.nValue, safeTx, fSpendable, nDepth >= nRequiredDepth, outputs);
+    }
+
+    if (outputs.size() > num_outputs && nDepth < Params().GetStakeMinConfirmations()) {
+        is_volatile = true;
+    }
+};
+
+void CHDWallet::UpdateStakeScriptTotals() const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!m_have_stake_script_totals) {
+        m_have_stake_script_totals = true;
+        m_stake_script_txns.clear();
+        m_coldstake_by_stake_key.clear();
+        m_coldstake_by_spend_key.clear();
+        m_coldstake_totals = CStakeScriptTotals();
+        m_hot_stake_totals = CStakeScriptTotals();
+        m_stake_scripts_dirty.clear();
+        m_stake_scripts_volatile.clear();
+        for (const auto &item : mapWallet) {
+            m_stake_scripts_dirty.insert(item.first);
+        }
+        for (const auto &ri : mapRecords) {
+            m_stake_scripts_dirty.insert(ri.first);
+        }
+    }
+
+    m_stake_scripts_dirty.insert(m_stake_scripts_volatile.begin(), m_stake_scripts_volatile.end());
+    m_stake_scripts_volatile.clear();
+    if (m_stake_scripts_dirty.empty()) {
+        return;
+    }
+
+    auto apply = [&](const CStakeScriptOutput &output, bool add) {
+        auto update = [&](CStakeScriptTotals &totals) {
+            if (add) {
+                totals += output.totals;
+            } else {
+                totals -= output.totals;
+            }
+        };
+        if (!output.fColdStake) {
+            update(m_hot_stake_totals);
+            return;
+        }
+        update(m_coldstake_totals);
+        auto it_stake = m_coldstake_by_stake_key.emplace(output.idStake, CStakeScriptTotals()).first;
+        update(it_stake->second);
+        if (it_stake->second.IsNull()) {
+            m_coldstake_by_stake_key.erase(it_stake);
+        }
+        auto it_spend = m_coldstake_by_spend_key.emplace(output.destSpend, CStakeScriptTotals()).first;
+        update(it_spend->second);
+        if (it_spend->second.IsNull()) {
+            m_coldstake_by_spend_key.erase(it_spend);
+        }
+    };
+
+    int nTipHeight = HaveChain() ? chain().getHeightInt() : 0;
+    int nRequiredDepth = std::min((int)(Params().GetStakeMinConfirmations()-1), (int)(nTipHeight / 2));
+    for (const auto &txhash : m_stake_scripts_dirty) {
+        auto it = m_stake_script_txns.find(txhash);
+        if (it != m_stake_script_txns.end()) {
+            for (const auto &output : it->second) {
+                apply(output, false);
+            }
+            m_stake_script_txns.erase(it);
+        }
+
+        std::vector<CStakeScriptOutput> outputs;
+        bool is_volatile = false;
+        MapWallet_t::const_iterator mwi;
+        MapRecords_t::const_iterator mri;
+        if ((mwi = mapWallet.find(txhash)) != mapWallet.end()) {
+            AddStakeScriptOutputs(mwi->second, nRequiredDepth, outputs, is_volatile);
+        }
+        if ((mri = mapRecords.find(txhash)) != mapRecords.end()) {
+            AddStakeScriptOutputs(txhash, mri->second, nRequiredDepth, outputs, is_volatile);
+        }
+
+        if (is_volatile) {
+            m_stake_scripts_volatile.insert(txhash);
+        }
+        if (!outputs.empty()) {
+            for (const auto &output : outputs) {
+                apply(output, true);
+            }
+            m_stake_script_txns.emplace(txhash, std::move(outputs));
         }
     }
+    m_stake_scripts_dirty.clear();
+};
+
+void CHDWallet::GetStakeScriptTotals(CStakeScriptTotals &coldstake, CStakeScriptTotals &hot,
+    std::map<CKeyID, CStakeScriptTotals> *by_stake_key, std::map<CTxDestination, CStakeScriptTotals> *by_spend_key) const
+{
+    LOCK(cs_wallet);
 
-    return nColdstakeOutputs;
+    UpdateStakeScriptTotals();
+    coldstake = m_coldstake_totals;
+    hot = m_hot_stake_totals;
+    if (by_stake_key) {
+        *by_stake_key = m_coldstake_by_stake_key;
+    }
+    if (by_spend_key) {
+        *by_spend_key = m_coldstake_by_spend_key;
+    }
 };
 
 void CHDWallet::ClearMapTempRecords()
@@ -13089,6 +16258,7 @@ bool CHDWallet::SetReserveBalance(CAmount nNewReserveBalance)
     LOCK(cs_wallet);
 
     nReserveBalance = nNewReserveBalance;
+    m_coinstake_templates_stale = true;
     NotifyReservedBalanceChanged(nReserveBalance);
     return true;
 };
@@ -13113,183 +16283,287 @@ uint64_t CHDWallet::GetStakeWeight() const
         nHeight = chain().getHeightInt() + 1;
     }
 
-    // Choose coins to use
-    std::set<COutput> setCoins;
-    CAmount nValueIn = 0;
-
-    // Select coins with suitable depth
-    if (!SelectCoinsForStaking(nBalance - nReserveBalance, GetTime(), nHeight, setCoins, nValueIn)) {
-        return 0;
+    {
+        LOCK(cs_wallet_snapshot);
+        if (m_stake_weight_snapshot &&
+            m_stake_weight_snapshot->version == m_wallet_state_version &&
+            m_stake_weight_snapshot->height == nHeight &&
+            m_stake_weight_snapshot->reserve_balance == nReserveBalance) {
+            return m_stake_weight_snapshot->weight;
+        }
     }
-    if (setCoins.empty()) {
-        return 0;
+
+    // Every stakeable coin is selected when together they don't exceed the target
+    UpdateCachedStakeableCoins(GetTime(), nHeight);
+    uint64_t version, nWeight = 0;
+    bool select_all;
+    {
+        LOCK(cs_wallet);
+        version = m_wallet_state_version;
+        select_all = m_cached_stakeable_value <= nBalance - nReserveBalance;
+        if (select_all) {
+            nWeight = m_cached_stakeable_value;
+        }
     }
-    uint64_t nWeight = 0;
 
-    for (const auto &pcoin : setCoins) {
-        nWeight += pcoin.txout.nValue;
+    if (!select_all) {
+        // Choose coins to use
+        std::set<COutput> setCoins;
+        CAmount nValueIn = 0;
+
+        // Select coins with suitable depth
+        if (SelectCoinsForStaking(nBalance - nReserveBalance, GetTime(), nHeight, setCoins, nValueIn)) {
+            for (const auto &pcoin : setCoins) {
+                nWeight += pcoin.txout.nValue;
+            }
+        }
     }
 
+    {
+        LOCK(cs_wallet_snapshot);
+        m_stake_weight_snapshot = StakeWeightSnapshot{version, nHeight, nReserveBalance, nWeight};
+    }
     return nWeight;
 };
 
-void CHDWallet::AvailableCoinsForStaking(std::vector<COutput> &vCoins, int64_t nTime, int nHeight) const
+void CHDWallet::AddStakeableOutputs(const uint256 &txid, int nTipHeight, int nRequiredDepth, std::vector<COutput> &vCoins) const
 {
-    ChainstateManager *pchainman{nullptr};
-    if (HaveChain()) {
-        pchainman = chain().getChainman();
+    MapWallet_t::const_iterator mwi = mapWallet.find(txid);
+    if (mwi != mapWallet.end()) {
+        AddStakeableOutputs(mwi->second, nTipHeight, nRequiredDepth, vCoins);
     }
-    if (!pchainman) {
-        WalletLogPrintf("Error: Chainstate manager not found.\n");
-        return;
+    MapRecords_t::const_iterator mri = mapRecords.find(txid);
+    if (mri != mapRecords.end()) {
+        AddStakeableOutputs(txid, mri->second, nTipHeight, nRequiredDepth, vCoins);
     }
+};
 
-    vCoins.clear();
-    m_greatest_txn_depth = 0;
-
-    {
-        LOCK(cs_wallet);
+void CHDWallet::AddStakeableOutputs(const CWalletTx &wtx, int nTipHeight, int nRequiredDepth, std::vector<COutput> &vCoins) const
+{
+    int min_stake_confirmations = Params().GetStakeMinConfirmations();
+    const uint256 &txid = wtx.GetHash();
+    CTransactionRef tx = wtx.tx;
 
-        int nHeight = pchainman->ActiveChain().Tip()->nHeight;
-        int min_stake_confirmations = Params().GetStakeMinConfirmations();
-        int nRequiredDepth = std::min(min_stake_confirmations-1, (int)(nHeight / 2));
+    int nDepth = GetTxDepthInMainChain(wtx);
+    if (nDepth > 0) {
+        m_stakeable_oldest_height = std::min(m_stakeable_oldest_height, nTipHeight - nDepth + 1);
+    }
+    if (nDepth < nRequiredDepth) {
+        if (nDepth > 0) {
+            m_maturing_stake_txns.emplace(nTipHeight - nDepth + 1, txid);
+        }
+        return;
+    }
+    if (wtx.IsCoinStake() && min_stake_confirmations < COINBASE_MATURITY) {
+        // min_stake_confirmations is only less than COINBASE_MATURITY in regtest mode
+        if (nDepth < std::min(COINBASE_MATURITY, (int)(nTipHeight / 2))) {
+            m_maturing_stake_txns.emplace(nTipHeight - nDepth + 1, txid);
+            return;
+        }
+    }
 
-        for (const auto &walletEntry : mapWallet) {
-            const CWalletTx *pcoin = &walletEntry.second;
-            CTransactionRef tx = pcoin->tx;
+    for (size_t i = 0; i < tx->vpout.size(); ++i) {
+        const auto &txout = tx->vpout[i];
+        if (!txout->IsType(OUTPUT_STANDARD)) {
+            continue;
+        }
+        if (txout->GetValue() < m_min_stakeable_value) {
+            continue;
+        }
+        COutPoint kernel(txid, i);
+        if (!particl::CheckStakeUnused(kernel) ||
+             IsSpent(txid, i) ||
+             IsLockedCoin(txid, i)) {
+            continue;
+        }
 
-            int nDepth = GetTxDepthInMainChain(*pcoin);
-            if (nDepth > m_greatest_txn_depth) {
-                m_greatest_txn_depth = nDepth;
-            }
-            if (nDepth < nRequiredDepth) {
-                continue;
-            }
-            if (pcoin->IsCoinStake() && min_stake_confirmations < COINBASE_MATURITY) {
-                // min_stake_confirmations is only less than COINBASE_MATURITY in regtest mode
-                if (nDepth < std::min(COINBASE_MATURITY, (int)(nHeight / 2))) {
-                    continue;
-                }
-            }
+        const CScript *pscriptPubKey = txout->GetPScriptPubKey();
+        CKeyID keyID;
+        if (!particl::ExtractStakingKeyID(*pscriptPubKey, keyID)) {
+            continue;
+        }
 
-            const uint256 &wtxid = walletEntry.first;
-            for (size_t i = 0; i < tx->vpout.size(); ++i) {
-                const auto &txout = tx->vpout[i];
-                if (!txout->IsType(OUTPUT_STANDARD)) {
-                    continue;
-                }
-                if (txout->GetValue() < m_min_stakeable_value) {
-                    continue;
-                }
-                COutPoint kernel(wtxid, i);
-                if (!particl::CheckStakeUnused(kernel) ||
-                     IsSpent(wtxid, i) ||
-                     IsLockedCoin(wtxid, i)) {
-                    continue;
-                }
+        isminetype mine = IsMine(keyID);
+        if (!(mine & ISMINE_SPENDABLE)) {
+            continue;
+        }
 
-                const CScript *pscriptPubKey = txout->GetPScriptPubKey();
-                CKeyID keyID;
-                if (!particl::ExtractStakingKeyID(*pscriptPubKey, keyID)) {
-                    continue;
-                }
+        bool fSpendableIn = true;
+        bool fSolvableIn = true;
+        bool fNeedHardwareKey = (mine & ISMINE_HARDWARE_DEVICE);
+        if (fNeedHardwareKey) {
+            continue;
+        }
 
-                isminetype mine = IsMine(keyID);
-                if (!(mine & ISMINE_SPENDABLE)) {
-                    continue;
-                }
+        CTxOut txout_old;
+        if (!txout->setTxout(txout_old)) {
+            continue;
+        }
+        int input_bytes = 0; // unnecessary
+        vCoins.emplace_back(COutPoint(txid, i), txout_old, nDepth, input_bytes, fSpendableIn, fSolvableIn, /*safe*/true, /*time, unneeded*/0, /*from_me, unneeded*/false, /*feerate*/std::nullopt, /*mature*/true, fNeedHardwareKey);
+    }
+};
 
-                bool fSpendableIn = true;
-                bool fSolvableIn = true;
-                bool fNeedHardwareKey = (mine & ISMINE_HARDWARE_DEVICE);
-                if (fNeedHardwareKey) {
-                    continue;
-                }
+void CHDWallet::AddStakeableOutputs(const uint256 &txid, const CTransactionRecord &rtx, int nTipHeight, int nRequiredDepth, std::vector<COutput> &vCoins) const
+{
+    int nDepth = GetDepthInMainChain(rtx);
+    if (nDepth > 0) {
+        m_stakeable_oldest_height = std::min(m_stakeable_oldest_height, nTipHeight - nDepth + 1);
+    }
+    if (nDepth < nRequiredDepth) {
+        if (nDepth > 0) {
+            m_maturing_stake_txns.emplace(nTipHeight - nDepth + 1, txid);
+        }
+        return;
+    }
 
-                CTxOut txout_old;
-                if (!txout->setTxout(txout_old)) {
-                    continue;
-                }
-                int input_bytes = 0; // unnecessary
-                vCoins.emplace_back(COutPoint(wtxid, i), txout_old, nDepth, input_bytes, fSpendableIn, fSolvableIn, /*safe*/true, /*time, unneeded*/0, /*from_me, unneeded*/false, /*feerate*/std::nullopt, /*mature*/true, fNeedHardwareKey);
-            }
+    MapWallet_t::const_iterator twi = mapTempWallet.end();
+    for (const auto &r : rtx.vout) {
+        if (r.nType != OUTPUT_STANDARD) {
+            continue;
+        }
+        if (r.nValue < m_min_stakeable_value) {
+            continue;
+        }
+        if (!(r.nFlags & ORF_OWNED || r.nFlags & ORF_STAKEONLY)) {
+            continue;
+        }
+        COutPoint kernel(txid, r.n);
+        if (!particl::CheckStakeUnused(kernel) ||
+            IsSpent(txid, r.n) ||
+            IsLockedCoin(txid, r.n)) {
+            continue;
         }
 
-        for (const auto &ri : mapRecords) {
-            const uint256 &txid = ri.first;
-            const CTransactionRecord &rtx = ri.second;
+        CKeyID keyID;
+        if (!particl::ExtractStakingKeyID(r.scriptPubKey, keyID)) {
+            continue;
+        }
 
-            int nDepth = GetDepthInMainChain(rtx);
-            if (nDepth > m_greatest_txn_depth) {
-                m_greatest_txn_depth = nDepth;
-            }
+        isminetype mine = IsMine(keyID);
+        if (!(mine & ISMINE_SPENDABLE)) {
+            continue;
+        }
+        if ((mine & ISMINE_HARDWARE_DEVICE)) {
+            continue;
+        }
 
-            if (nDepth < nRequiredDepth) {
-                continue;
+        if (twi == mapTempWallet.end() &&
+            (twi = mapTempWallet.find(txid)) == mapTempWallet.end()) {
+            if (0 != InsertTempTxn(txid, &rtx) ||
+                (twi = mapTempWallet.find(txid)) == mapTempWallet.end()) {
+                WalletLogPrintf("ERROR: %s - InsertTempTxn failed %s.\n", __func__, txid.ToString());
+                return;
             }
+        }
 
-            MapWallet_t::const_iterator twi = mapTempWallet.end();
-            for (const auto &r : rtx.vout) {
-                if (r.nType != OUTPUT_STANDARD) {
-                    continue;
-                }
-                if (r.nValue < m_min_stakeable_value) {
-                    continue;
-                }
-                if (!(r.nFlags & ORF_OWNED || r.nFlags & ORF_STAKEONLY)) {
-                    continue;
-                }
-                COutPoint kernel(txid, r.n);
-                if (!particl::CheckStakeUnused(kernel) ||
-                    IsSpent(txid, r.n) ||
-                    IsLockedCoin(txid, r.n)) {
-                    continue;
-                }
+        bool fSpendableIn = true;
+        bool fNeedHardwareKey = false;
+        CTxOut txout(r.nValue, r.scriptPubKey);
+        int input_bytes = 0; // unnecessary
+        vCoins.emplace_back(COutPoint(txid, r.n), txout, nDepth, input_bytes, fSpendableIn, /*solvable*/true, /*safe*/true, /*time, unneeded*/0, /*from_me, unneeded*/false, /*feerate*/std::nullopt, /*mature*/true, fNeedHardwareKey);
+    }
+};
 
-                CKeyID keyID;
-                if (!particl::ExtractStakingKeyID(r.scriptPubKey, keyID)) {
-                    continue;
-                }
+void CHDWallet::AvailableCoinsForStaking(std::vector<COutput> &vCoins, int64_t nTime, int nHeight) const
+{
+    ChainstateManager *pchainman{nullptr};
+    if (HaveChain()) {
+        pchainman = chain().getChainman();
+    }
+    if (!pchainman) {
+        WalletLogPrintf("Error: Chainstate manager not found.\n");
+        return;
+    }
 
-                isminetype mine = IsMine(keyID);
-                if (!(mine & ISMINE_SPENDABLE)) {
-                    continue;
-                }
-                if ((mine & ISMINE_HARDWARE_DEVICE)) {
-                    continue;
-                }
+    vCoins.clear();
 
-                if (twi == mapTempWallet.end() &&
-                    (twi = mapTempWallet.find(txid)) == mapTempWallet.end()) {
-                    if (0 != InsertTempTxn(txid, &rtx) ||
-                        (twi = mapTempWallet.find(txid)) == mapTempWallet.end()) {
-                        WalletLogPrintf("ERROR: %s - InsertTempTxn failed %s.\n", __func__, txid.ToString());
-                        return;
-                    }
-                }
+    {
+        LOCK(cs_wallet);
+
+        int nTipHeight = pchainman->ActiveChain().Tip()->nHeight;
+        int nRequiredDepth = std::min((int)Params().GetStakeMinConfirmations()-1, (int)(nTipHeight / 2));
 
-                bool fSpendableIn = true;
-                bool fNeedHardwareKey = false;
-                CTxOut txout(r.nValue, r.scriptPubKey);
-                int input_bytes = 0; // unnecessary
-                vCoins.emplace_back(COutPoint(txid, r.n), txout, nDepth, input_bytes, fSpendableIn, /*solvable*/true, /*safe*/true, /*time, unneeded*/0, /*from_me, unneeded*/false, /*feerate*/std::nullopt, /*mature*/true, fNeedHardwareKey);
+        m_maturing_stake_txns.clear();
+        m_stakeable_coins_dirty.clear();
+        m_stakeable_oldest_height = std::numeric_limits<int>::max();
+        for (const auto &walletEntry : mapWallet) {
+            AddStakeableOutputs(walletEntry.first, nTipHeight, nRequiredDepth, vCoins);
+        }
+        for (const auto &ri : mapRecords) {
+            if (mapWallet.count(ri.first)) {
+                continue; // Done above
             }
+            AddStakeableOutputs(ri.first, nTipHeight, nRequiredDepth, vCoins);
         }
+        m_stakeable_coins_height = nTipHeight;
+        m_greatest_txn_depth = m_stakeable_oldest_height <= nTipHeight ? nTipHeight - m_stakeable_oldest_height + 1 : 0;
     }
 
     Shuffle(vCoins.begin(), vCoins.end(), FastRandomContext());
     return;
 };
 
-bool CHDWallet::SelectCoinsForStaking(int64_t nTargetValue, int64_t nTime, int nHeight, std::set<COutput> &setCoinsRet, int64_t &nValueRet) const
+bool CHDWallet::UpdateCachedStakeableCoins(int64_t nTime, int nHeight) const
 {
-    if (m_have_cached_stakeable_coins) {
-        Shuffle(m_cached_stakeable_coins.begin(), m_cached_stakeable_coins.end(), FastRandomContext());
-    } else {
+    if (!m_have_cached_stakeable_coins) {
         m_cached_stakeable_coins.clear();
         AvailableCoinsForStaking(m_cached_stakeable_coins, nTime, nHeight);
         m_have_cached_stakeable_coins = true;
+        LOCK(cs_wallet);
+        m_cached_stakeable_value = 0;
+        for (const auto &output : m_cached_stakeable_coins) {
+            m_cached_stakeable_value += output.txout.nValue;
+        }
+        return true;
+    }
+
+    ChainstateManager *pchainman{nullptr};
+    if (HaveChain()) {
+        pchainman = chain().getChainman();
+    }
+    if (!pchainman) {
+        return false;
+    }
+
+    LOCK(cs_wallet);
+    int nTipHeight = pchainman->ActiveChain().Tip()->nHeight;
+    int nRequiredDepth = std::min((int)Params().GetStakeMinConfirmations()-1, (int)(nTipHeight / 2));
+
+    // Txns confirmed at or below nMatureHeight are deep enough to stake
+    int nMatureHeight = nTipHeight - nRequiredDepth + 1;
+    while (!m_maturing_stake_txns.empty() && m_maturing_stake_txns.begin()->first <= nMatureHeight) {
+        m_stakeable_coins_dirty.insert(m_maturing_stake_txns.begin()->second);
+        m_maturing_stake_txns.erase(m_maturing_stake_txns.begin());
+    }
+    if (nTipHeight != m_stakeable_coins_height) {
+        m_stakeable_coins_height = nTipHeight;
+        m_greatest_txn_depth = m_stakeable_oldest_height <= nTipHeight ? nTipHeight - m_stakeable_oldest_height + 1 : 0;
+    }
+    if (m_stakeable_coins_dirty.empty()) {
+        return false;
+    }
+
+    m_cached_stakeable_coins.erase(std::remove_if(m_cached_stakeable_coins.begin(), m_cached_stakeable_coins.end(),
+        [&](const COutput &output) { return m_stakeable_coins_dirty.count(output.outpoint.hash) > 0; }),
+        m_cached_stakeable_coins.end());
+    for (const auto &txid : m_stakeable_coins_dirty) {
+        AddStakeableOutputs(txid, nTipHeight, nRequiredDepth, m_cached_stakeable_coins);
+    }
+    m_stakeable_coins_dirty.clear();
+    m_cached_stakeable_value = 0;
+    for (const auto &output : m_cached_stakeable_coins) {
+        m_cached_stakeable_value += output.txout.nValue;
     }
+    m_greatest_txn_depth = m_stakeable_oldest_height <= nTipHeight ? nTipHeight - m_stakeable_oldest_height + 1 : 0;
+
+    return true;
+};
+
+bool CHDWallet::SelectCoinsForStaking(int64_t nTargetValue, int64_t nTime, int nHeight, std::set<COutput> &setCoinsRet, int64_t &nValueRet) const
+{
+    UpdateCachedStakeableCoins(nTime, nHeight);
+    Shuffle(m_cached_stakeable_coins.begin(), m_cached_stakeable_coins.end(), FastRandomContext());
 
     std::vector<COutput> &vCoins = m_cached_stakeable_coins;
 
@@ -13319,201 +16593,254 @@ bool CHDWallet::SelectCoinsForStaking(int64_t nTargetValue, int64_t nTime, int n
     return true;
 };
 
-bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHeight, int64_t nFees, CMutableTransaction &txNew, CKey &key)
+void CHDWallet::GetStakeCandidates(const CBlockIndex *pindexPrev, const std::vector<COutPoint> &prevouts, std::vector<StakeKernelCandidate> &candidates)
 {
-    ClearTxCreationState();
+    // Coin data only changes with the tip, read candidates not seen since under one lock
+    if (m_stake_candidates_tip != pindexPrev->GetBlockHash()) {
+        m_stake_candidates.clear();
+        m_stake_candidates_tip = pindexPrev->GetBlockHash();
+    }
+    std::vector<COutPoint> new_prevouts;
+    for (const auto &prevout : prevouts) {
+        if (!m_stake_candidates.count(prevout)) {
+            new_prevouts.push_back(prevout);
+        }
+    }
+    if (!new_prevouts.empty()) {
+        std::vector<StakeKernelCandidate> new_candidates;
+        GetKernelCandidates(chain().getChainman()->ActiveChainstate(), pindexPrev, new_prevouts, new_candidates);
+        for (const auto &candidate : new_candidates) {
+            m_stake_candidates[candidate.prevout] = candidate;
+        }
+    }
 
+    candidates.clear();
+    candidates.reserve(prevouts.size());
+    for (const auto &prevout : prevouts) {
+        candidates.push_back(m_stake_candidates[prevout]);
+    }
+};
+
+int64_t CHDWallet::GetNextStakeKernelTime(int64_t nSearchTime, int nBlockHeight)
+{
     ChainstateManager *pchainman{nullptr};
     if (HaveChain()) {
         pchainman = chain().getChainman();
     }
     if (!pchainman) {
-        LogPrintf("Error: Chainstate manager not found.\n");
-        return false;
+        return nSearchTime;
     }
-
-    CBlockIndex *pindexPrev = pchainman->ActiveChain().Tip();
-    arith_uint256 bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
-
-    CAmount nBalance = GetSpendableBalance();
-    if (nBalance <= nReserveBalance) {
-        return false;
-    }
-
-    // Choose coins to use
-    std::vector<COutput> vwtxPrev;
-    std::set<COutput> setCoins;
-    CAmount nValueIn = 0;
-
-    // Select coins with suitable depth
-    if (!SelectCoinsForStaking(nBalance - nReserveBalance, nTime, nBlockHeight, setCoins, nValueIn)) {
-        return false;
+    {
+        LOCK(cs_wallet);
+        // Coins are selected at random when part of the balance is reserved
+        if (nReserveBalance > 0) {
+            return nSearchTime;
+        }
     }
 
-    if (setCoins.empty()) {
-        return false;
+    CBlockIndex *pindexPrev = pchainman->ActiveChain().Tip();
+    bool coins_changed = UpdateCachedStakeableCoins(nSearchTime, nBlockHeight);
+    if (m_stake_kernel_table_tip != pindexPrev->GetBlockHash() ||
+        coins_changed ||
+        m_coinstake_templates_stale ||
+        nSearchTime >= m_stake_kernel_table_end) {
+        m_stake_kernel_table.clear();
+        m_stake_kernel_table_tip.SetNull();
+
+        std::vector<COutPoint> prevouts;
+        for (const auto &output : m_cached_stakeable_coins) {
+            prevouts.push_back(output.outpoint);
+        }
+        std::vector<StakeKernelCandidate> candidates;
+        GetStakeCandidates(pindexPrev, prevouts, candidates);
+        if (std::none_of(candidates.begin(), candidates.end(), [](const StakeKernelCandidate &c) { return c.amount > 0; })) {
+            return nSearchTime; // Let SignBlock report why nothing can stake
+        }
+
+        int64_t nSlot = Params().GetStakeTimestampMask(nBlockHeight) + 1;
+        std::vector<int64_t> times;
+        for (size_t i = 0; i < STAKE_KERNEL_TABLE_SLOTS; ++i) {
+            times.push_back(nSearchTime + (int64_t)i * nSlot);
+        }
+        unsigned int nBits = GetNextTargetRequired(pindexPrev, Params().GetConsensus());
+        std::vector<int64_t> kernel_times;
+        int64_t nSearchStart = GetTimeMicros();
+        CheckKernelBatch(pindexPrev, nBits, candidates, times, kernel_times);
+        g_staking_perf.RecordKernelSearch(GetName().c_str(), candidates.size() * times.size(), nSearchStart);
+        for (const auto t : kernel_times) {
+            if (t != 0) {
+                m_stake_kernel_table.insert(t);
+            }
+        }
+        // Build the coinstakes ahead of time, at the kernel slot only the fees, time and signatures are added
+        PrepareCoinStakeTemplates(pindexPrev, nBlockHeight, candidates, kernel_times);
+        m_stake_kernel_table_end = times.back() + nSlot;
+        m_stake_kernel_table_tip = pindexPrev->GetBlockHash();
+        if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+            WalletLogPrintf("%s: %d candidates, %d slots with a kernel before %d.\n", __func__, candidates.size(), m_stake_kernel_table.size(), m_stake_kernel_table_end);
+        }
     }
 
-    CAmount nCredit = 0;
-    CScript scriptPubKeyKernel;
+    auto it = m_stake_kernel_table.lower_bound(nSearchTime);
+    return it == m_stake_kernel_table.end() ? m_stake_kernel_table_end : *it;
+};
 
-    std::set<COutput>::iterator it = setCoins.begin();
+bool CHDWallet::GetCoinStakeKernelScript(const COutput &kernel, CKey &key, CScript &script_kernel, bool &try_next)
+{
+    AssertLockHeld(cs_wallet);
+    try_next = false;
 
-    for (; it != setCoins.end(); ++it) {
-        auto pcoin = *it;
-        if (ThreadStakeMinerStopped()) {
+    std::vector<valtype> vSolutions;
+    TxoutType whichType;
+
+    const CScript *pscriptPubKey = &kernel.txout.scriptPubKey;
+    CScript coinstakePath;
+    bool fConditionalStake = false;
+    if ((HasIsCoinstakeOp(*pscriptPubKey))) {
+        fConditionalStake = true;
+        if (!GetCoinstakeScriptPath(*pscriptPubKey, coinstakePath)) {
+            try_next = true;
             return false;
         }
+        pscriptPubKey = &coinstakePath;
+    }
 
-        int64_t nBlockTime;
-        if (CheckKernel(pchainman->ActiveChainstate(), pindexPrev, nBits, nTime, pcoin.outpoint, &nBlockTime)) {
-            LOCK(cs_wallet);
-            // Found a kernel
-            if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
-                WalletLogPrintf("%s: Kernel found.\n", __func__);
-            }
-
-            std::vector<valtype> vSolutions;
-            TxoutType whichType;
-
-            const CScript *pscriptPubKey = &pcoin.txout.scriptPubKey;
-            CScript coinstakePath;
-            bool fConditionalStake = false;
-            if ((HasIsCoinstakeOp(*pscriptPubKey))) {
-                fConditionalStake = true;
-                if (!GetCoinstakeScriptPath(*pscriptPubKey, coinstakePath)) {
-                    continue;
-                }
-                pscriptPubKey = &coinstakePath;
-            }
-
-            whichType = Solver(*pscriptPubKey, vSolutions);
+    whichType = Solver(*pscriptPubKey, vSolutions);
 
-            if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
-                WalletLogPrintf("%s: Parsed kernel type=%d.\n", __func__, particl::FromTxoutType(whichType));
-            }
-            CKeyID spendId;
-            if (whichType == TxoutType::PUBKEYHASH) {
-                spendId = CKeyID(uint160(vSolutions[0]));
-            } else
-            if (whichType == TxoutType::PUBKEYHASH256) {
-                spendId = CKeyID(uint256(vSolutions[0]));
-            } else {
-                if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
-                    WalletLogPrintf("%s: No support for kernel type=%d.\n", __func__, particl::FromTxoutType(whichType));
-                }
-                break;  // only support pay to address (pay to pubkey hash)
-            }
+    if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+        WalletLogPrintf("%s: Parsed kernel type=%d.\n", __func__, particl::FromTxoutType(whichType));
+    }
+    CKeyID spendId;
+    if (whichType == TxoutType::PUBKEYHASH) {
+        spendId = CKeyID(uint160(vSolutions[0]));
+    } else
+    if (whichType == TxoutType::PUBKEYHASH256) {
+        spendId = CKeyID(uint256(vSolutions[0]));
+    } else {
+        if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+            WalletLogPrintf("%s: No support for kernel type=%d.\n", __func__, particl::FromTxoutType(whichType));
+        }
+        return false;  // only support pay to address (pay to pubkey hash)
+    }
 
-            if (!GetKey(spendId, key)) {
-                if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
-                    WalletLogPrintf("%s: Failed to get key for kernel type=%d.\n", __func__, particl::FromTxoutType(whichType));
-                }
-                break;  // unable to find corresponding key
-            }
+    if (!GetKey(spendId, key)) {
+        if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+            WalletLogPrintf("%s: Failed to get key for kernel type=%d.\n", __func__, particl::FromTxoutType(whichType));
+        }
+        return false;  // unable to find corresponding key
+    }
 
-            if (fConditionalStake) {
-                scriptPubKeyKernel = pcoin.txout.scriptPubKey;
-            } else {
-                scriptPubKeyKernel << OP_DUP << OP_HASH160 << ToByteVector(spendId) << OP_EQUALVERIFY << OP_CHECKSIG;
-
-                // If the wallet has a coldstaking-change-address loaded, send the output to a coldstaking-script.
-                UniValue jsonSettings;
-                if (GetSetting("changeaddress", jsonSettings) &&
-                    jsonSettings["coldstakingaddress"].isStr()) {
-                    std::string sAddress;
-                    try { sAddress = jsonSettings["coldstakingaddress"].get_str();
-                    } catch (std::exception &e) {
-                        return werror("%s: Get coldstakingaddress failed %s.", __func__, e.what());
-                    }
+    script_kernel.clear();
+    if (fConditionalStake) {
+        script_kernel = kernel.txout.scriptPubKey;
+        return true;
+    }
+    script_kernel << OP_DUP << OP_HASH160 << ToByteVector(spendId) << OP_EQUALVERIFY << OP_CHECKSIG;
 
-                    if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
-                        WalletLogPrintf("%s: Sending output to coldstakingscript %s.\n", __func__, sAddress);
-                    }
+    // If the wallet has a coldstaking-change-address loaded, send the output to a coldstaking-script.
+    UniValue jsonSettings;
+    if (GetSetting("changeaddress", jsonSettings) &&
+        jsonSettings["coldstakingaddress"].isStr()) {
+        std::string sAddress;
+        try { sAddress = jsonSettings["coldstakingaddress"].get_str();
+        } catch (std::exception &e) {
+            return werror("%s: Get coldstakingaddress failed %s.", __func__, e.what());
+        }
 
-                    CTxDestination destColdStake = DecodeDestination(sAddress, true);
-                    CScript scriptStaking;
-                    if (!GetScriptForDest(scriptStaking, destColdStake, true, nullptr)) {
-                        return werror("%s: GetScriptForDest failed.", __func__);
-                    }
+        if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+            WalletLogPrintf("%s: Sending output to coldstakingscript %s.\n", __func__, sAddress);
+        }
 
-                    // Get new key from the active internal chain
-                    CPubKey pkSpend;
-                    if (0 != GetChangeAddress(pkSpend)) {
-                        return werror("%s: GetChangeAddress failed.", __func__);
-                    }
+        CTxDestination destColdStake = DecodeDestination(sAddress, true);
+        CScript scriptStaking;
+        if (!GetScriptForDest(scriptStaking, destColdStake, true, nullptr)) {
+            return werror("%s: GetScriptForDest failed.", __func__);
+        }
 
-                    CKeyID256 id256 = pkSpend.GetID256();
-                    scriptPubKeyKernel = GetScriptForDestination(id256);
+        // Get new key from the active internal chain
+        CPubKey pkSpend;
+        if (0 != GetChangeAddress(pkSpend)) {
+            return werror("%s: GetChangeAddress failed.", __func__);
+        }
 
-                    if (scriptStaking.IsPayToPublicKeyHash()) {
-                        CScript script = CScript() << OP_ISCOINSTAKE << OP_IF;
-                        script.append(scriptStaking);
-                        script << OP_ELSE;
-                        script.append(scriptPubKeyKernel);
-                        script << OP_ENDIF;
+        CKeyID256 id256 = pkSpend.GetID256();
+        script_kernel = GetScriptForDestination(id256);
 
-                        scriptPubKeyKernel = script;
-                    } else {
-                        return werror("%s: Unknown scriptStaking type, must be pay-to-public-key-hash.", __func__);
-                    }
-                }
-            }
+        if (scriptStaking.IsPayToPublicKeyHash()) {
+            CScript script = CScript() << OP_ISCOINSTAKE << OP_IF;
+            script.append(scriptStaking);
+            script << OP_ELSE;
+            script.append(script_kernel);
+            script << OP_ENDIF;
 
-            // Ensure txn is empty
-            txNew.vin.clear();
-            txNew.vout.clear();
-            txNew.vpout.clear();
+            script_kernel = script;
+        } else {
+            return werror("%s: Unknown scriptStaking type, must be pay-to-public-key-hash.", __func__);
+        }
+    }
+    return true;
+};
 
-            // Mark as coin stake transaction
-            txNew.nVersion = PARTICL_TXN_VERSION;
-            txNew.SetType(TXN_COINSTAKE);
+bool CHDWallet::BuildCoinStakeTemplate(const CBlockIndex *pindexPrev, const COutput &kernel, const std::set<COutput> &setCoins,
+                                       CAmount nBalance, int nBlockHeight, CCoinStakeTemplate &tmpl, bool &try_next)
+{
+    try_next = false;
+    {
+        LOCK(cs_wallet);
+        if (tmpl.script_kernel.empty() &&
+            !GetCoinStakeKernelScript(kernel, tmpl.key, tmpl.script_kernel, try_next)) {
+            return false;
+        }
+    }
+    tmpl.tip = pindexPrev->GetBlockHash();
+    tmpl.height = nBlockHeight;
+    tmpl.inputs.clear();
+    tmpl.prev_coinstake = nullptr;
 
-            txNew.vin.push_back(CTxIn(pcoin.outpoint));
+    CMutableTransaction &txNew = tmpl.tx;
+    // Ensure txn is empty
+    txNew.vin.clear();
+    txNew.vout.clear();
+    txNew.vpout.clear();
 
-            nCredit += pcoin.txout.nValue;
-            vwtxPrev.push_back(pcoin);
+    // Mark as coin stake transaction
+    txNew.nVersion = PARTICL_TXN_VERSION;
+    txNew.SetType(TXN_COINSTAKE);
 
-            OUTPUT_PTR<CTxOutData> out0 = MAKE_OUTPUT<CTxOutData>();
-            out0->vData.resize(4);
-            uint32_t tmp = htole32(nBlockHeight);
-            memcpy(&out0->vData[0], &tmp, 4);
+    txNew.vin.push_back(CTxIn(kernel.outpoint));
 
-            uint32_t voteToken = 0;
-            if (GetVote(nBlockHeight, voteToken)) {
-                size_t origSize = out0->vData.size();
-                out0->vData.resize(origSize + 5);
-                out0->vData[origSize] = DO_VOTE;
-                uint32_t tmp = htole32(voteToken);
-                memcpy(&out0->vData[origSize+1], &tmp, 4);
-            }
+    CAmount nCredit = kernel.txout.nValue;
+    tmpl.inputs.push_back(kernel);
 
-            txNew.vpout.push_back(out0);
+    OUTPUT_PTR<CTxOutData> out0 = MAKE_OUTPUT<CTxOutData>();
+    out0->vData.resize(4);
+    uint32_t tmp = htole32(nBlockHeight);
+    memcpy(&out0->vData[0], &tmp, 4);
 
-            OUTPUT_PTR<CTxOutStandard> out1 = MAKE_OUTPUT<CTxOutStandard>();
-            out1->nValue = 0;
-            out1->scriptPubKey = scriptPubKeyKernel;
-            txNew.vpout.push_back(out1);
+    uint32_t voteToken = 0;
+    if (GetVote(nBlockHeight, voteToken)) {
+        size_t origSize = out0->vData.size();
+        out0->vData.resize(origSize + 5);
+        out0->vData[origSize] = DO_VOTE;
+        uint32_t tmp = htole32(voteToken);
+        memcpy(&out0->vData[origSize+1], &tmp, 4);
+    }
 
-            if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
-                WalletLogPrintf("%s: Added kernel.\n", __func__);
-            }
+    txNew.vpout.push_back(out0);
 
-            setCoins.erase(it);
-            break;
-        }
-    }
+    OUTPUT_PTR<CTxOutStandard> out1 = MAKE_OUTPUT<CTxOutStandard>();
+    out1->nValue = 0;
+    out1->scriptPubKey = tmpl.script_kernel;
+    txNew.vpout.push_back(out1);
 
-    if (nCredit == 0 || nCredit > nBalance - WITH_LOCK(cs_wallet, return nReserveBalance)) {
-        return false;
+    if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+        WalletLogPrintf("%s: Added kernel.\n", __func__);
     }
 
     // Attempt to add more inputs
     // Only advantage here is to setup the next stake using this output as a kernel to have a higher chance of staking
     size_t nStakesCombined = 0;
-    it = setCoins.begin();
-    while (it != setCoins.end()) {
+    for (const auto &pcoin : setCoins) {
         if (nStakesCombined >= nMaxStakeCombine) {
             break;
         }
@@ -13528,11 +16855,9 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
             break;
         }
 
-        std::set<COutput>::iterator itc = it++; // copy the current iterator then increment it
-        auto pcoin = *itc;
-
         // Only add coins of the same key/address as kernel
-        if (pcoin.txout.scriptPubKey != scriptPubKeyKernel) {
+        if (pcoin.outpoint == kernel.outpoint ||
+            pcoin.txout.scriptPubKey != tmpl.script_kernel) {
             continue;
         }
 
@@ -13548,14 +16873,34 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
 
         txNew.vin.push_back(CTxIn(pcoin.outpoint));
         nCredit += pcoin.txout.nValue;
-        vwtxPrev.push_back(pcoin);
+        tmpl.inputs.push_back(pcoin);
 
         if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
             WalletLogPrintf("%s: Combining kernel %s, %d.\n", __func__, pcoin.outpoint.hash.ToString(), pcoin.outpoint.n);
         }
         nStakesCombined++;
-        setCoins.erase(itc);
     }
+    tmpl.credit = nCredit;
+
+    // The treasury and smsg fields carry forward from the previous coinstake
+    if (nBlockHeight > 1) { // genesis block is pow
+        LOCK(cs_main);
+        if (!particl::coinStakeCache.GetCoinStake(chain().getChainman()->ActiveChainstate(), pindexPrev->GetBlockHash(), tmpl.prev_coinstake)) {
+            return werror("%s: Failed to get previous coinstake: %s.", __func__, pindexPrev->GetBlockHash().ToString());
+        }
+    }
+
+    return true;
+};
+
+bool CHDWallet::FinishCoinStake(const CBlockIndex *pindexPrev, const CCoinStakeTemplate &tmpl, int64_t nTime, int nBlockHeight, int64_t nFees,
+                                CMutableTransaction &txNew, CKey &key)
+{
+    txNew = tmpl.tx;
+    key = tmpl.key;
+    CAmount nCredit = tmpl.credit;
+    const CScript &scriptPubKeyKernel = tmpl.script_kernel;
+    const CTransactionRef &txPrevCoinstake = tmpl.prev_coinstake;
 
     const Consensus::Params &consensusParams = Params().GetConsensus();
     // Get block reward
@@ -13565,7 +16910,6 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
     }
 
     // Process development fund
-    CTransactionRef txPrevCoinstake = nullptr;
     CAmount nRewardOut;
     const TreasuryFundSettings *pTreasuryFundSettings = Params().GetTreasuryFundSettings(nTime);
     if (!pTreasuryFundSettings || pTreasuryFundSettings->nMinTreasuryStakePercent <= 0) {
@@ -13577,15 +16921,8 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
         nRewardOut = nReward - nTreasuryPart;
 
         CAmount nTreasuryBfwd = 0;
-        if (nBlockHeight > 1) { // genesis block is pow
-            LOCK(cs_main);
-            if (!particl::coinStakeCache.GetCoinStake(chain().getChainman()->ActiveChainstate(), pindexPrev->GetBlockHash(), txPrevCoinstake)) {
-                return werror("%s: Failed to get previous coinstake: %s.", __func__, pindexPrev->GetBlockHash().ToString());
-            }
-
-            if (!txPrevCoinstake->GetTreasuryFundCfwd(nTreasuryBfwd)) {
-                nTreasuryBfwd = 0;
-            }
+        if (txPrevCoinstake && !txPrevCoinstake->GetTreasuryFundCfwd(nTreasuryBfwd)) {
+            nTreasuryBfwd = 0;
         }
 
         CAmount nTreasuryCfwd = nTreasuryBfwd + nTreasuryPart;
@@ -13622,11 +16959,7 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
     // Place SMSG fee rate
     if (nTime >= consensusParams.smsg_fee_time) {
         CAmount smsg_fee_rate = consensusParams.smsg_fee_msg_per_day_per_k;
-        if (nBlockHeight > 1) { // genesis block is pow
-            LOCK(cs_main);
-            if (!txPrevCoinstake && !particl::coinStakeCache.GetCoinStake(chain().getChainman()->ActiveChainstate(), pindexPrev->GetBlockHash(), txPrevCoinstake)) {
-                return werror("%s: Failed to get previous coinstake: %s.", __func__, pindexPrev->GetBlockHash().ToString());
-            }
+        if (txPrevCoinstake) {
             txPrevCoinstake->GetSmsgFeeRate(smsg_fee_rate);
         }
 
@@ -13658,14 +16991,9 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
     // Place SMSG difficulty
     {
         uint32_t last_compact = consensusParams.smsg_min_difficulty, next_compact = m_smsg_difficulty_target;
-        if (nBlockHeight > 1) { // genesis block is pow
-            LOCK(cs_main);
-            if (!txPrevCoinstake && !particl::coinStakeCache.GetCoinStake(chain().getChainman()->ActiveChainstate(), pindexPrev->GetBlockHash(), txPrevCoinstake)) {
-                return werror("%s: Failed to get previous coinstake: %s.", __func__, pindexPrev->GetBlockHash().ToString());
-            }
+        if (txPrevCoinstake) {
             txPrevCoinstake->GetSmsgDifficulty(last_compact);
         }
-
         if (m_smsg_difficulty_target == 0) {
             next_compact = last_compact;
             int auto_adjust = smsgModule.AdjustDifficulty(nTime);
@@ -13746,7 +17074,7 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
 
     // Sign
     int nIn = 0;
-    for (const auto &pcoin : vwtxPrev) {
+    for (const auto &pcoin : tmpl.inputs) {
         auto provider = GetLegacyScriptPubKeyMan();
         std::vector<uint8_t> vchAmount;
         part::SetAmount(vchAmount, pcoin.txout.nValue);
@@ -13766,10 +17094,154 @@ bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHei
         return werror("%s: Exceeded coinstake size limit.", __func__);
     }
 
-    // Successfully generated coinstake
     return true;
 };
 
+void CHDWallet::PrepareCoinStakeTemplates(const CBlockIndex *pindexPrev, int nBlockHeight,
+                                          const std::vector<StakeKernelCandidate> &candidates, const std::vector<int64_t> &kernel_times)
+{
+    if (m_coinstake_templates_stale.exchange(false)) {
+        m_coinstake_templates.clear();
+    }
+
+    std::vector<std::pair<int64_t, size_t> > kernels;
+    for (size_t i = 0; i < kernel_times.size() && i < m_cached_stakeable_coins.size(); ++i) {
+        if (kernel_times[i] != 0) {
+            kernels.emplace_back(kernel_times[i], i);
+        }
+    }
+    std::sort(kernels.begin(), kernels.end());
+    if (kernels.size() > MAX_COINSTAKE_TEMPLATES) {
+        kernels.resize(MAX_COINSTAKE_TEMPLATES);
+    }
+
+    const std::set<COutput> setCoins(m_cached_stakeable_coins.begin(), m_cached_stakeable_coins.end());
+    CAmount nBalance = GetSpendableBalance();
+    std::map<COutPoint, CCoinStakeTemplate> templates;
+    for (const auto &k : kernels) {
+        const COutput &kernel = m_cached_stakeable_coins[k.second];
+        CCoinStakeTemplate tmpl;
+        auto it = m_coinstake_templates.find(kernel.outpoint);
+        if (it != m_coinstake_templates.end()) {
+            if (it->second.tip == pindexPrev->GetBlockHash() && it->second.height == nBlockHeight) {
+                templates[kernel.outpoint] = std::move(it->second);
+                continue;
+            }
+            // Reuse the kernel script, a cold staking change address is derived only once per coin
+            tmpl.key = it->second.key;
+            tmpl.script_kernel = it->second.script_kernel;
+        }
+        bool try_next;
+        if (BuildCoinStakeTemplate(pindexPrev, kernel, setCoins, nBalance, nBlockHeight, tmpl, try_next)) {
+            templates[kernel.outpoint] = std::move(tmpl);
+        }
+    }
+    m_coinstake_templates = std::move(templates);
+    if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+        WalletLogPrintf("%s: %d coinstake templates at height %d.\n", __func__, m_coinstake_templates.size(), nBlockHeight);
+    }
+};
+
+bool CHDWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHeight, int64_t nFees, CMutableTransaction &txNew, CKey &key)
+{
+    ClearTxCreationState();
+
+    ChainstateManager *pchainman{nullptr};
+    if (HaveChain()) {
+        pchainman = chain().getChainman();
+    }
+    if (!pchainman) {
+        LogPrintf("Error: Chainstate manager not found.\n");
+        return false;
+    }
+
+    CBlockIndex *pindexPrev = pchainman->ActiveChain().Tip();
+    arith_uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+
+    CAmount nBalance = GetSpendableBalance();
+    if (nBalance <= nReserveBalance) {
+        return false;
+    }
+
+    // Choose coins to use
+    std::set<COutput> setCoins;
+    CAmount nValueIn = 0;
+
+    // Select coins with suitable depth
+    if (!SelectCoinsForStaking(nBalance - nReserveBalance, nTime, nBlockHeight, setCoins, nValueIn)) {
+        return false;
+    }
+
+    if (setCoins.empty()) {
+        return false;
+    }
+
+    std::vector<COutPoint> prevouts;
+    for (const auto &coin : setCoins) {
+        prevouts.push_back(coin.outpoint);
+    }
+    std::vector<StakeKernelCandidate> candidates;
+    GetStakeCandidates(pindexPrev, prevouts, candidates);
+    std::vector<int64_t> kernel_times;
+    int64_t nSearchStart = GetTimeMicros();
+    size_t nKernels = CheckKernelBatch(pindexPrev, nBits, candidates, {nTime}, kernel_times);
+    g_staking_perf.RecordKernelSearch(GetName().c_str(), candidates.size(), nSearchStart);
+    if (nKernels == 0) {
+        return false;
+    }
+    m_kernel_found_us = GetTimeMicros();
+
+    std::set<COutput>::iterator it = setCoins.begin();
+    for (size_t i = 0; it != setCoins.end(); ++it, ++i) {
+        const auto &pcoin = *it;
+        if (ThreadStakeMinerStopped()) {
+            return false;
+        }
+        if (kernel_times[i] == 0) {
+            continue;
+        }
+        // Found a kernel
+        if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+            WalletLogPrintf("%s: Kernel found.\n", __func__);
+        }
+
+        // A template prepared on this tip is usable while its inputs are still selected
+        bool stale = m_coinstake_templates_stale;
+        auto mi = m_coinstake_templates.find(pcoin.outpoint);
+        if (!stale &&
+            mi != m_coinstake_templates.end() &&
+            mi->second.tip == pindexPrev->GetBlockHash() &&
+            mi->second.height == nBlockHeight &&
+            std::all_of(mi->second.inputs.begin(), mi->second.inputs.end(), [&setCoins](const COutput &c) { return setCoins.count(c); })) {
+            if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
+                WalletLogPrintf("%s: Using prepared coinstake template.\n", __func__);
+            }
+        } else {
+            CCoinStakeTemplate tmpl;
+            if (!stale && mi != m_coinstake_templates.end()) {
+                tmpl.key = mi->second.key;
+                tmpl.script_kernel = mi->second.script_kernel;
+            }
+            bool try_next;
+            if (!BuildCoinStakeTemplate(pindexPrev, pcoin, setCoins, nBalance, nBlockHeight, tmpl, try_next)) {
+                if (try_next) {
+                    continue;
+                }
+                return false;
+            }
+            mi = m_coinstake_templates.insert_or_assign(pcoin.outpoint, std::move(tmpl)).first;
+        }
+
+        if (pcoin.txout.nValue > nBalance - WITH_LOCK(cs_wallet, return nReserveBalance)) {
+            return false;
+        }
+        return FinishCoinStake(pindexPrev, mi->second, nTime, nBlockHeight, nFees, txNew, key);
+    }
+
+    return false;
+};
+
 bool CHDWallet::SignBlock(node::CBlockTemplate *pblocktemplate, int nHeight, int64_t nSearchTime)
 {
     if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
@@ -13797,8 +17269,15 @@ bool CHDWallet::SignBlock(node::CBlockTemplate *pblocktemplate, int nHeight, int
         WalletLogPrintf("%s, nBits %d\n", __func__, pblock->nBits);
     }
 
+    [[maybe_unused]] const int64_t start_us = GetTimeMicros();
     CMutableTransaction txCoinStake;
-    if (CreateCoinStake(pblock->nBits, nSearchTime, nHeight, nFees, txCoinStake, key)) {
+    bool found_kernel = CreateCoinStake(pblock->nBits, nSearchTime, nHeight, nFees, txCoinStake, key);
+    TRACE4(staking, create_coinstake,
+        GetName().c_str(),
+        nHeight,
+        found_kernel,
+        GetTimeMicros() - start_us);
+    if (found_kernel) {
         if (LogAcceptCategory(BCLog::POS, BCLog::Level::Debug)) {
             WalletLogPrintf("%s: Kernel found.\n", __func__);
         }
@@ -13820,13 +17299,24 @@ bool CHDWallet::SignBlock(node::CBlockTemplate *pblocktemplate, int nHeight, int
             pblock->hashWitnessMerkleRoot = BlockWitnessMerkleRoot(*pblock, &mutated);
 
             // Append a signature to the block
-            return key.Sign(pblock->GetHash(), pblock->vchBlockSig);
+            bool signed_block = key.Sign(pblock->GetHash(), pblock->vchBlockSig);
+            TRACE4(staking, sign_block,
+                GetName().c_str(),
+                nHeight,
+                signed_block,
+                GetTimeMicros() - start_us);
+            return signed_block;
         }
     }
     {
         LOCK(cs_wallet);
         nLastCoinStakeSearchTime = nSearchTime;
     }
+    TRACE4(staking, sign_block,
+        GetName().c_str(),
+        nHeight,
+        false,
+        GetTimeMicros() - start_us);
     return false;
 };
 
@@ -13844,7 +17334,7 @@ int LoopExtKeysInDB(CHDWallet *pwallet, bool fInactive, bool fInAccount, LoopExt
 
     CHDWalletDB wdb(pwallet->GetDatabase());
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetCursor())) {
         throw std::runtime_error(strprintf("%s : cannot create DB cursor", __func__).c_str());
     }
@@ -13859,7 +17349,7 @@ int LoopExtKeysInDB(CHDWallet *pwallet, bool fInactive, bool fInAccount, LoopExt
     uint32_t fFlags = DB_SET_RANGE;
     ssKey << std::string(DBKeys::PART_EXTKEY);
 
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
 
         ssKey >> strType;
@@ -13875,7 +17365,7 @@ int LoopExtKeysInDB(CHDWallet *pwallet, bool fInactive, bool fInAccount, LoopExt
         }
         callback.ProcessKey(ckeyId, sek);
     }
-    pcursor->close();
+    pcursor.reset();
 
     return 0;
 };
@@ -13887,7 +17377,7 @@ int LoopExtAccountsInDB(CHDWallet *pwallet, bool fInactive, LoopExtKeyCallback &
     CHDWalletDB wdb(pwallet->GetDatabase());
     // List accounts
 
-    Dbc *pcursor;
+    std::unique_ptr<CHDWalletDBCursor> pcursor;
     if (!(pcursor = wdb.GetCursor())) {
         throw std::runtime_error(strprintf("%s : cannot create DB cursor", __func__).c_str());
     }
@@ -13901,7 +17391,7 @@ int LoopExtAccountsInDB(CHDWallet *pwallet, bool fInactive, LoopExtKeyCallback &
     uint32_t fFlags = DB_SET_RANGE;
     ssKey << std::string(DBKeys::PART_EXTACC);
 
-    while (wdb.ReadAtCursor(pcursor, ssKey, ssValue, fFlags) == 0) {
+    while (wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, fFlags) == 0) {
         fFlags = DB_NEXT;
 
         ssKey >> strType;
@@ -13930,7 +17420,7 @@ int LoopExtAccountsInDB(CHDWallet *pwallet, bool fInactive, LoopExtKeyCallback &
         sea.FreeChains();
     }
 
-    pcursor->close();
+    pcursor.reset();
 
     return 0;
 };
@@ -14,10 +14,29 @@
 #include <key_io.h>
 #include <key/extkey.h>
 #include <key/stealth.h>
+#include <lrucache.h>
+#include <pos/kernel.h>
+#include <util/hasher.h>
+
+#include <iosfwd>
 
 using namespace wallet;
 
 static const size_t DEFAULT_STEALTH_LOOKAHEAD_SIZE = 5;
+static const int DEFAULT_RESCAN_THREADS = 4;
+static const bool DEFAULT_CHECK_BALANCE_CACHE = false;
+static const bool DEFAULT_LAZY_KEY_PACKS = false;
+static const bool DEFAULT_RECORDS_SNAPSHOT = false;
+static const bool DEFAULT_COMPACT_STORED_TXNS = false;
+//! Number of timestamp slots the stake kernel table covers
+static const size_t STAKE_KERNEL_TABLE_SLOTS = 32;
+//! Coins with a kernel in the table that get a coinstake prepared ahead of their slot
+static const size_t MAX_COINSTAKE_TEMPLATES = 4;
+//! Blinded prevouts and rewound outputs kept for repeated fundrawtransactionfrom calls
+static const size_t PREVOUT_DATA_CACHE_SIZE = 10000;
+static const size_t REWOUND_OUTPUT_CACHE_SIZE = 10000;
+//! Scripts remembered as not owned by IsMine
+static const size_t ISMINE_CACHE_SIZE = 50000;
 
 //! -fallbackfee default
 static const CAmount DEFAULT_FALLBACK_FEE_PART = 20000;
@@ -28,6 +47,85 @@ typedef std::map<CKeyID, CStoredExtKey*> ExtKeyMap;
 
 typedef std::map<uint256, CWalletTx> MapWallet_t;
 
+/** Order AvailableBlindedCoins and AvailableAnonCoins visit outputs in, the value orders read the unspent value index */
+enum class OutputOrder { NONE, VALUE_ASC, VALUE_DESC };
+/** Returns false to skip an output in AvailableBlindedCoins and AvailableAnonCoins, applied before nMaximumCount */
+typedef std::function<bool(const uint256 &txid, const COutputRecord &r)> OutputFilter;
+
+/** Milliseconds spent in each phase of CHDWallet::LoadWallet */
+struct CWalletLoadTimings
+{
+    int64_t extkeys = 0;
+    int64_t stealth = 0;
+    int64_t lookahead = 0;
+    int64_t wallet = 0;
+    int64_t records_read = 0;
+    int64_t records_decode = 0;
+    int64_t records_insert = 0;
+    int64_t total = 0;
+};
+
+/** Seconds between runs of the output consolidation */
+static constexpr int64_t CONSOLIDATION_INTERVAL = 10 * 60;
+
+/** Settings and progress of the background consolidation of small blinded and anon outputs, see walletsettings "consolidation" */
+struct CConsolidationState
+{
+    bool enabled = false;
+    bool blind = true;              // Consolidate blinded outputs
+    bool anon = true;               // Consolidate anon outputs
+    CAmount max_value = COIN;       // Outputs up to max_value are small
+    size_t min_outputs = 100;       // A type is consolidated while it holds more than min_outputs small outputs
+    size_t max_inputs = 32;         // Outputs spent per consolidation txn
+    size_t ring_size = 0;           // Ring size of anon consolidations, 0 for DEFAULT_RING_SIZE
+    int min_depth = 10;             // Small outputs are spent only once this deep, so fresh anon outputs don't appear in the same txn as their ancestors
+    CFeeRate max_feerate;           // Run only while the wallet feerate is at most this, -consolidatefeerate if 0
+
+    int64_t next_run = 0;
+    int64_t last_run = 0;
+    size_t small_blind = 0;         // Small outputs found by the last run
+    size_t small_anon = 0;
+    size_t num_txns = 0;            // Consolidation txns sent since the wallet was loaded
+    size_t num_inputs = 0;          // Outputs spent by them
+    uint256 last_txid;
+    std::string status;
+};
+
+/** An unsigned coinstake prepared for one kernel coin on top of tip.
+ *  Output values depend on the block fees and are set when the kernel time is reached.
+ */
+struct CCoinStakeTemplate
+{
+    uint256 tip;
+    int height = 0;
+    CMutableTransaction tx; // Inputs, the data output with height and vote, the kernel output
+    std::vector<wallet::COutput> inputs; // Kernel first, then the combined coins
+    CAmount credit = 0;     // Sum of inputs
+    CKey key;               // Signs the block
+    CScript script_kernel;  // Kept across tips, may hold a newly derived change key
+    CTransactionRef prev_coinstake; // Coinstake of tip, null when building on genesis
+};
+
+/** An account derived for discovery, held in the wallet maps but not saved until a rescan finds it used */
+struct CCandidateAccount
+{
+    CExtKeyAccount *sea = nullptr;
+    uint32_t master_counter = 0; // Hardened counter of the master key before the account was derived
+};
+
+/** Fields of a blinded output read by the stealth scan, independent of any wallet */
+struct CBlindOutputScanData
+{
+    CTxDestination address; // CNoDestination if not extracted
+    ec_point ephem_pubkey;  // empty if vData is too short
+    uint32_t prefix = 0;
+    bool have_prefix = false;
+};
+typedef std::map<COutPoint, CBlindOutputScanData> BlockScanData;
+
+/** Parse the blinded outputs of block, recent blocks are cached so all loaded wallets share one pass */
+std::shared_ptr<const BlockScanData> GetBlockScanData(const CBlock &block);
+
 class UniValue;
 typedef struct secp256k1_scratch_space_struct secp256k1_scratch_space;
 
@@ -52,6 +150,7 @@ public:
     }
 
     bool IsParticlWallet() const override { return true; };
+    void KeyStoreChanged() override { ClearIsMineCache(); };
 
     int Finalise();
     int FreeExtKeyMaps();
@@ -83,7 +182,8 @@ public:
     /** Unsets a single wallet flag, returns false on fail */
     bool UnsetWalletFlagRV(CHDWalletDB *pwdb, uint64_t flag);
 
-    bool DumpJson(UniValue &rv, std::string &sError);
+    /** Write the keys as one JSON object, arrays are written an element per line as they are read */
+    bool DumpJson(std::ostream &os, std::string &sError);
     bool LoadJson(const UniValue &inj, std::string &sError);
 
     bool LoadAddressBook(CHDWalletDB *pwdb);
@@ -92,6 +192,12 @@ public:
     bool GetVote(int nHeight, uint32_t &token);
 
     bool LoadTxRecords(CHDWalletDB *pwdb);
+    bool LoadAnonKeyImages(CHDWalletDB *pwdb) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    bool WriteAnonKeyImage(CHDWalletDB *pwdb, const CCmpPubKey &ki, const COutPoint &op) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Serialised records from the snapshot written by the last clean shutdown, false if it is missing or stale */
+    bool ReadRecordsSnapshot(CHDWalletDB *pwdb, std::vector<std::pair<uint256, CDataStream> > &vRaw) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    bool WriteRecordsSnapshot();
+    void Close() override;
 
     bool IsLocked() const override;
     bool EncryptWallet(const SecureString &strWalletPassphrase) override;
@@ -123,6 +229,8 @@ public:
     bool GetStealthAddressSpendKey(const CStealthAddress &sxAddr, CKey &key) const;
 
     bool ImportStealthAddress(const CStealthAddress &sxAddr, const CKey &skSpend);
+    void AddStealthAddressInMem(const CStealthAddress &sxAddr) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    size_t EraseStealthAddressInMem(const CStealthAddress &sxAddr) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     DBErrors LoadWallet() override;
     void Downgrade();
@@ -144,6 +252,8 @@ public:
     isminetype IsMine(const CScript &scriptPubKey, CKeyID &keyID,
         const CEKAKey *&pak, const CEKASCKey *&pasc, CExtKeyAccount *&pa, bool &isInvalid, SigVersion = SigVersion::BASE) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     isminetype IsMineP2SH(const CScript& script) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** CWallet::IsMine(script) through the negative cache */
+    isminetype IsMineCached(const CScript &script) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     isminetype IsMine(const CTxOutBase *txout) const override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool IsMine(const CTransaction& tx) const override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -178,6 +288,11 @@ public:
     CAmount GetStaked();
 
     bool GetBalances(CHDWalletBalances &bal, bool avoid_reuse = true) const;
+    /** Recomputes all balances from mapWallet and mapRecords, skipping the cache */
+    bool ComputeBalances(CHDWalletBalances &bal, bool avoid_reuse = true) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AddWalletTxBalances(const CWalletTx &wtx, isminefilter reuse_filter, CHDWalletBalances &bal) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AddRecordBalances(const uint256 &txhash, const CTransactionRecord &rtx, bool allow_used_addresses, CHDWalletBalances &bal) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void UpdateCachedBalances() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     CAmount GetAvailableAnonBalance(const CCoinControl* coinControl = nullptr) const;
     CAmount GetAvailableBlindBalance(const CCoinControl* coinControl = nullptr) const;
 
@@ -191,7 +306,21 @@ public:
     void AddOutputRecordMetaData(CTransactionRecord &rtx, std::vector<CTempRecipient> &vecSend);
     int ExpandTempRecipients(std::vector<CTempRecipient> &vecSend, CStoredExtKey *pc, std::string &sError);
 
-    int AddCTData(const CCoinControl *coinControl, CTxOutBase *txout, CTempRecipient &r, std::string &sError) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    int AddCTData(const CCoinControl *coinControl, CTxOutBase *txout, CTempRecipient &r, std::string &sError, secp256k1_scratch_space *scratch = nullptr);
+    /**
+     * Runs AddCTData for each output, rangeproofs are built in parallel.
+     * Once active consecutive outputs share aggregated rangeproofs, except the output at vpout position single_n.
+     */
+    int AddCTData(const CCoinControl *coinControl, std::vector<std::pair<CTxOutBase*, CTempRecipient*> > &outputs, std::string &sError, int single_n = -1) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Fills rangeproofs with placeholders of the final size, nExtraBytes is set to the vData bytes still to be added */
+    void SizeCTData(const CCoinControl *coinControl, std::vector<std::pair<CTxOutBase*, CTempRecipient*> > &outputs, int single_n, size_t &nExtraBytes) const;
+    /** Proves the outputs sized by SizeCTData, except the output at single_n */
+    int ProveSizedCTData(const CCoinControl *coinControl, std::vector<std::pair<CTxOutBase*, CTempRecipient*> > &outputs, int single_n, std::string &sError) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Sets the commitment and nonce of a blinded output */
+    int SetCTCommitment(const CCoinControl *coinControl, CTxOutBase *txout, CTempRecipient &r, uint64_t &nValue, uint256 &nonce, std::string &sError);
+    int AddCTNarration(CTxOutBase *txout, CTempRecipient &r, std::string &sError);
+    /** Proves n consecutive outputs of the same type with one bulletproof */
+    int AddAggregateCTData(const CCoinControl *coinControl, std::pair<CTxOutBase*, CTempRecipient*> *outputs, size_t n, std::string &sError, secp256k1_scratch_space *scratch = nullptr);
 
     bool SetChangeDest(const CCoinControl *coinControl, CTempRecipient &r, std::string &sError) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
@@ -226,9 +355,14 @@ public:
 
 
     void ClearCachedBalances() override;
+    void ClearCachedBalances(const CTransaction &tx) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void LoadToWallet(const uint256 &hash, CTransactionRecord &rtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void leavingIBD() override;
+    void blockConnected(const CBlock &block, int height) override;
+    void BeginBlockWrites() override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void CommitBlockWrites() override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void updatedBlockTip() override;
 
     /** Remove txn from mapwallet and TxSpends */
     void RemoveFromTxSpends(const uint256 &hash, const CTransactionRef pt) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -253,6 +387,10 @@ public:
     int ExtKeyCreateAccount(CStoredExtKey *ekAccount, CKeyID &idMaster, CExtKeyAccount &ekaOut, const std::string &sLabel) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     /** Derive a new account from the master key and save to wallet */
     int ExtKeyDeriveNewAccount(CHDWalletDB *pwdb, CExtKeyAccount *sea, const std::string &sLabel, const std::string &sPath="") EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Derive the next num_accounts accounts from the master key into the maps only, so one rescan checks them all */
+    int ExtKeyAddCandidateAccounts(size_t num_accounts, std::vector<CCandidateAccount> &candidates) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Save the candidates up to the last with a used chain, drop the rest and rewind the master key counter past the last kept */
+    int ExtKeyKeepUsedCandidateAccounts(std::vector<CCandidateAccount> &candidates, size_t &num_kept) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int ExtKeySetDefaultAccount(CHDWalletDB *pwdb, CKeyID &idNewDefault) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     int ExtKeyEncrypt(CStoredExtKey *sek, const CKeyingMaterial &vMKey, bool fLockKey);
@@ -290,10 +428,13 @@ public:
     int ExtKeyRemoveAccountFromMapsAndFree(CExtKeyAccount *sea) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int ExtKeyRemoveAccountFromMapsAndFree(const CKeyID &idAccount) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int ExtKeyLoadAccountPacks();
+    /** With -lazykeypacks, sort the account's key pack index and read packs missing from the maps through the wallet db */
+    void ExtKeySetKeyPackReaders(CExtKeyAccount *sea);
     int PrepareLookahead();
 
     int ExtKeyAppendToPack(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &idKey, const CEKAKey &ak, bool &fUpdateAcc) const;
     int ExtKeyAppendToPack(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &idKey, const CEKASCKey &asck, bool &fUpdateAcc) const;
+    int ExtKeyAppendToPack(CHDWalletDB *pwdb, CExtKeyAccount *sea, const std::vector<std::pair<CKeyID, CEKAKey> > &vKeys, bool &fUpdateAcc) const;
 
     int ExtKeySaveKey(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &keyId, const CEKAKey &ak) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int ExtKeySaveKey(CExtKeyAccount *sea, const CKeyID &keyId, const CEKAKey &ak) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -309,15 +450,26 @@ public:
     int ExtKeyNewIndex(CHDWalletDB *pwdb, const CKeyID &idKey, uint32_t &index) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int ExtKeyGetIndex(CHDWalletDB *pwdb, CExtKeyAccount *sea, uint32_t &index, bool &fUpdate) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int ExtKeyGetIndex(CExtKeyAccount *sea, uint32_t &index);
+    /** Address book path prefix of keys on a chain of the account, the account index followed by the chain path */
+    int GetChainAddressPath(CHDWalletDB *pwdb, CExtKeyAccount *sea, uint32_t nChain, std::vector<uint32_t> &vPath, bool &fUpdateAcc) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     int NewKeyFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, CPubKey &pkOut, bool fInternal, bool fHardened, bool f256bit=false, bool fBech32=false, const char *plabel=nullptr, OutputType output_type=OutputType::LEGACY) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int NewKeyFromAccount(CPubKey &pkOut, bool fInternal=false, bool fHardened=false, bool f256bit=false, bool fBech32=false, const char *plabel=nullptr, OutputType output_type=OutputType::LEGACY); // wrapper - use default account
+    void SetNewKeyAddressBook(CHDWalletDB *pwdb, const CPubKey &pk, const std::vector<uint32_t> &vPath, bool f256bit, bool fBech32, const char *plabel, OutputType output_type) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Derive nKeys new keys, non-hardened keys are derived in parallel and saved together */
+    int NewKeysFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, size_t nKeys, std::vector<CPubKey> &vPkOut, bool fInternal, bool fHardened, bool f256bit=false, bool fBech32=false, const char *plabel=nullptr, OutputType output_type=OutputType::LEGACY) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    int NewKeysFromAccount(size_t nKeys, std::vector<CPubKey> &vPkOut, bool fInternal=false, bool fHardened=false, bool f256bit=false, bool fBech32=false, const char *plabel=nullptr, OutputType output_type=OutputType::LEGACY); // wrapper - use default account, in one db txn
 
     int NewStealthKeyFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, const std::string &sLabel, CEKAStealthKey &akStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32=false, uint32_t *pscankey_num=nullptr, bool add_to_lookahead=true) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int NewStealthKeyFromAccount(const std::string &sLabel, CEKAStealthKey &akStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32=false); // wrapper - use default account
 
     int InitAccountStealthV2Chains(CHDWalletDB *pwdb, CExtKeyAccount *sea) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Derive nKeys v1 stealth addresses in parallel and save them together */
+    int NewStealthKeysFromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, size_t nKeys, const std::string &sLabel, std::vector<CEKAStealthKey> &vAkStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32=false) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    int NewStealthKeysFromAccount(size_t nKeys, bool fV2, const std::string &sLabel, std::vector<CEKAStealthKey> &vAkStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32=false); // wrapper - use default account, in one db txn
     int SaveStealthAddress(CHDWalletDB *pwdb, CExtKeyAccount *sea, const CEKAStealthKey &akStealth, bool fBech32) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Save stealth addresses derived from sea, each key pack and chain is written once */
+    int SaveStealthAddresses(CHDWalletDB *pwdb, CExtKeyAccount *sea, const std::vector<CEKAStealthKey> &vAkStealth, bool fBech32) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int NewStealthKeyV2FromAccount(CHDWalletDB *pwdb, const CKeyID &idAccount, const std::string &sLabel, CEKAStealthKey &akStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32=false, uint32_t *pscankey_num=nullptr, uint32_t *pspendkey_num=nullptr, bool add_to_lookahead=true) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int NewStealthKeyV2FromAccount(const std::string &sLabel, CEKAStealthKey &akStealthOut, uint32_t nPrefixBits, const char *pPrefix, bool fBech32=false); // wrapper - use default account
 
@@ -379,11 +531,26 @@ public:
     bool GetStealthSecret(const CStealthAddress &sx, CKey &key_out) const;
     bool ProcessLockedStealthOutputs() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool ProcessLockedBlindedOutputs() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Progress of the Process* functions above, shown only when there's more than one batch */
+    void ShowLockedOutputsProgress(size_t done, size_t total);
     bool CountRecords(std::string sPrefix, int64_t rv);
 
     void ProcessStealthLookahead(CExtKeyAccount *ea, const CEKAStealthKey &aks, bool v2) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool ProcessStealthOutput(const CTxDestination &address,
-        std::vector<uint8_t> &vchEphemPK, uint32_t prefix, bool fHavePrefix, CKey &sShared, bool fNeedShared=false);
+        std::vector<uint8_t> &vchEphemPK, uint32_t prefix, bool fHavePrefix, CKey &sShared, bool fNeedShared=false, bool skip_rescan_keys=false);
+
+    void SetRescanStealthKeys() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void ClearRescanStealthKeys() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void PrepareRescanBlock(const CBlock &block) override;
+    /** True if outpoint was matched against m_rescan_stealth_keys without a match, removes the hint */
+    bool TakeRescanStealthHint(const COutPoint &outpoint);
+
+    /** Match the rescan against the particl block filter index if running, and the wallet holds no stealth keys or watch only scripts */
+    void SetRescanFilter() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void ClearRescanFilter() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Add the scripts of keys generated or looked ahead since the last call */
+    void UpdateRescanFilter() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    std::optional<bool> RescanFilterMatchesBlock(const uint256 &block_hash) override EXCLUSIVE_LOCKS_REQUIRED(!cs_wallet);
 
     int CheckForStealthAndNarration(const CTxOutBase *pb, const CTxOutData *pdata, std::string &sNarr);
     void FindStealthTransactions(const CTransaction &tx, mapValue_t &mapNarr);
@@ -392,6 +559,8 @@ public:
 
     int UnloadSpent(const uint256 &wtxid, int depth, const uint256 &wtxid_from);
     void PostProcessUnloadSpent();
+    /** Unload records with every owned output spent, when they and their spends are m_archive_record_depth deep */
+    size_t ArchiveSpentRecords() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     using CWallet::AddToSpends;
     bool HaveSpend(const COutPoint &outpoint, const uint256 &txid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -405,6 +574,17 @@ public:
 
     void SetTempTxnStatus(CWalletTx &wtx, const CTransactionRecord *rtx) const;
     int InsertTempTxn(const uint256 &txid, const CTransactionRecord *rtx) const;
+    /** Read stx from the writes pending for the block being synced or from the db */
+    bool GetStoredTx(CHDWalletDB &wdb, const uint256 &txid, CStoredTransaction &stx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Replace a compact stx.tx with the full txn from the block it was confirmed in */
+    bool ExpandStoredTx(const uint256 &txid, CStoredTransaction &stx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Blind and anon pubkey of a blinded prevout, from m_prevout_data_cache or the stored txn */
+    bool GetPrevoutData(CHDWalletDB &wdb, const COutPoint &op, CPrevoutData &data) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Recall the rewind of an output by its nonce and commitment, set by createrawparttransaction and fundrawtransactionfrom */
+    bool GetRewoundOutput(const uint256 &nonce, const secp256k1_pedersen_commitment &commitment, CRewoundOutput &rewound) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void CacheRewoundOutput(const uint256 &nonce, const secp256k1_pedersen_commitment &commitment, const CRewoundOutput &rewound) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Rewind nonce of an owned blinded output with a bulletproof, as OwnBlindOut and OwnAnonOut derive it */
+    bool GetOwnedOutputNonce(const CTxOutBase *txout, uint256 &nonce) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     const CWalletTx *GetWalletOrTempTx(const uint256& hash, const CTransactionRecord *rtx) const;
 
     int OwnStandardOut(const CTxOutStandard *pout, const CTxOutData *pdata, COutputRecord &rout, bool &fUpdated) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -417,8 +597,21 @@ public:
     bool AddToRecord(CTransactionRecord &rtxIn, const CTransaction &tx, const TxState& state, bool fFlushOnClose=true) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     ScanResult ScanForWalletTransactions(const uint256& start_block, int start_height, std::optional<int> max_height, const WalletRescanReserver& reserver, bool fUpdate) override;
+    void SaveRescanProgress(const uint256 &block_hash, int block_height) override;
+    /** Scan the height ranges in order, merged with each other and with the ranges left by an interrupted rescan.
+     *  Progress is kept in the wallet db until all ranges are scanned, an end of -1 scans up to the tip.
+     */
+    ScanResult RescanHeightRanges(std::vector<std::pair<int, int> > ranges, const WalletRescanReserver &reserver);
+    /** Continue the rescan interrupted by abortrescan or a shutdown, if any */
+    ScanResult ResumeRescan(const WalletRescanReserver &reserver);
+    /** Read the ranges left to scan by an interrupted rescan, ranges[0] starts after the last block scanned */
+    bool GetRescanProgress(CRescanProgress &progress);
     std::vector<uint256> ResendRecordTransactionsBefore(int64_t nTime);
     void ResendWalletTransactions() override;
+    /** Spend the smallest outputs of each enabled type into one output to the wallet, once per CONSOLIDATION_INTERVAL */
+    void MaybeConsolidateOutputs() override;
+    /** Spend up to m_consolidation.max_inputs of the coins to the wallet in one txn of type, committed and relayed */
+    int ConsolidateOutputs(OutputTypes type, const std::vector<COutputR> &coins, uint256 &txid, std::string &sError) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /**
      * populate vCoins with vector of available COutputs.
@@ -427,10 +620,16 @@ public:
     std::optional<SelectionResult> SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue,
         const CCoinControl& coin_control, const CoinSelectionParams& coin_selection_params) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
-    void AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t& nMaximumCount = 0) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
-    bool SelectBlindedCoins(const std::vector<COutputR>& vAvailableCoins, const CAmount& nTargetValue, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet, const CCoinControl *coinControl = nullptr, bool random_selection = false) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AvailableBlindedCoins(std::vector<COutputR>& vCoins, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t& nMaximumCount = 0,
+        OutputOrder order = OutputOrder::NONE, const OutputFilter &filter = {}) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** cost_of_change > 0 tries branch and bound first, for an input set within cost_of_change of nTargetValue */
+    bool SelectBlindedCoins(const std::vector<COutputR>& vAvailableCoins, const CAmount& nTargetValue, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet, const CCoinControl *coinControl = nullptr, bool random_selection = false, CAmount cost_of_change = 0) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Fee to create a blinded or anon change output now and to spend it later */
+    CAmount GetBlindedChangeCost(const CCoinControl &coin_control, bool anon, size_t ring_size = 0) const;
 
-    void AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t& nMaximumCount = 0) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AvailableAnonCoins(std::vector<COutputR> &vCoins, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t& nMaximumCount = 0,
+        OutputOrder order = OutputOrder::NONE, const OutputFilter &filter = {}) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void UpdateUnspentRecordSets() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     const CTxOutBase* FindNonChangeParentOutput(const CTransaction& tx, int output) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool GetAddressFromOutputRecord(const uint256 &txhash, const COutputRecord *pout, CTxDestination &address) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -442,6 +641,7 @@ public:
     std::map<CTxDestination, std::vector<COutputR>> ListCoins(OutputTypes nType) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     bool AttemptSelection(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, std::vector<COutputR> vCoins, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet) const;
+    bool AttemptBnBSelection(const CAmount& nTargetValue, const CAmount& cost_of_change, const CoinEligibilityFilter& eligibility_filter, size_t max_inputs, const std::vector<COutputR> &vCoins, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet) const;
 
     bool IsSpent(const uint256& hash, unsigned int n) const override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool GetSpendingTxid(const uint256& hash, unsigned int n, uint256 &spent_by_txid) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -456,6 +656,11 @@ public:
 
     std::set<uint256> GetConflicts(const uint256 &txid) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /** Find the owned anon output with key image ki, from memory */
+    bool GetAnonKeyImageOutpoint(const CCmpPubKey &ki, COutPoint &op) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Wallet txns spending the owned anon output with key image ki, including abandoned and conflicted txns */
+    std::set<uint256> GetKeyImageSpends(const CCmpPubKey &ki) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /** Return whether transaction can be abandoned */
     bool TransactionCanBeAbandoned(const uint256& hashTx) const override;
 
@@ -475,6 +680,19 @@ public:
     bool GetPrevout(const COutPoint &prevout, CTxOutBaseRef &txout) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     size_t CountColdstakeOutputs();
+    /** Memory held by the records, transactions, key maps and caches, by name. Heap owned by map values is approximated. */
+    void GetMemoryUsage(std::map<std::string, size_t> &usage) const;
+    void AddStakeScriptOutputs(const CWalletTx &wtx, int nRequiredDepth, std::vector<CStakeScriptOutput> &outputs, bool &is_volatile) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AddStakeScriptOutputs(const uint256 &txid, const CTransactionRecord &rtx, int nRequiredDepth, std::vector<CStakeScriptOutput> &outputs, bool &is_volatile) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void UpdateStakeScriptTotals() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Totals of the unspent cold stake and P2PKH outputs, the cold stake outputs are also summed by stake and spend key if the maps are set */
+    void GetStakeScriptTotals(CStakeScriptTotals &coldstake, CStakeScriptTotals &hot,
+        std::map<CKeyID, CStakeScriptTotals> *by_stake_key = nullptr, std::map<CTxDestination, CStakeScriptTotals> *by_spend_key = nullptr) const;
+    void AddAddressTxnTotals(const CWalletTx &wtx, std::vector<CAddressTxnTotals> &totals, bool &is_volatile) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AddAddressTxnTotals(const uint256 &txid, const CTransactionRecord &rtx, std::vector<CAddressTxnTotals> &totals, bool &is_volatile) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void UpdateAddressTotals() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Totals of the owned outputs in trusted txns per address, the outputs GetAddressBalances sums */
+    const std::map<CTxDestination, CAddressTotals> &GetAddressTotals() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void ClearMapTempRecords();
 
     /** Return a script for any destination type (normal/stealth/extended) */
@@ -483,9 +701,32 @@ public:
     bool SetReserveBalance(CAmount nNewReserveBalance);
     void SetStakeLimitHeight(int stake_limit);
     uint64_t GetStakeWeight() const;
+    void AddStakeableOutputs(const uint256 &txid, int nTipHeight, int nRequiredDepth, std::vector<COutput> &vCoins) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AddStakeableOutputs(const CWalletTx &wtx, int nTipHeight, int nRequiredDepth, std::vector<COutput> &vCoins) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AddStakeableOutputs(const uint256 &txid, const CTransactionRecord &rtx, int nTipHeight, int nRequiredDepth, std::vector<COutput> &vCoins) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AvailableCoinsForStaking(std::vector<COutput> &vCoins, int64_t nTime, int nHeight) const;
+    /** Bring m_cached_stakeable_coins up to date, returns true if the set was changed */
+    bool UpdateCachedStakeableCoins(int64_t nTime, int nHeight) const;
     bool SelectCoinsForStaking(int64_t nTargetValue, int64_t nTime, int nHeight, std::set<COutput> &setCoinsRet, int64_t &nValueRet) const;
+    void GetStakeCandidates(const CBlockIndex *pindexPrev, const std::vector<COutPoint> &prevouts, std::vector<StakeKernelCandidate> &candidates);
+    /** Derive the key and the output script for a kernel coin, try_next is set if another kernel may be used instead */
+    bool GetCoinStakeKernelScript(const COutput &kernel, CKey &key, CScript &script_kernel, bool &try_next) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Select the inputs and read the parent coinstake, script_kernel and key are reused when set */
+    bool BuildCoinStakeTemplate(const CBlockIndex *pindexPrev, const COutput &kernel, const std::set<COutput> &setCoins,
+                                CAmount nBalance, int nBlockHeight, CCoinStakeTemplate &tmpl, bool &try_next);
+    /** Set the reward, treasury and smsg fields for nTime and nFees and sign */
+    bool FinishCoinStake(const CBlockIndex *pindexPrev, const CCoinStakeTemplate &tmpl, int64_t nTime, int nBlockHeight, int64_t nFees,
+                         CMutableTransaction &txNew, CKey &key);
+    /** Build templates for the earliest kernels in the table, called when the table is rebuilt */
+    void PrepareCoinStakeTemplates(const CBlockIndex *pindexPrev, int nBlockHeight,
+                                   const std::vector<StakeKernelCandidate> &candidates, const std::vector<int64_t> &kernel_times);
     bool CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHeight, int64_t nFees, CMutableTransaction &txNew, CKey &key);
+    /**
+     * Return the first timestamp slot from nSearchTime where a stakeable coin meets the target.
+     * Kernel hashes are computed once per tip for STAKE_KERNEL_TABLE_SLOTS slots, if none pass
+     * the end of the table is returned. Returns nSearchTime when the table can't predict a stake.
+     */
+    int64_t GetNextStakeKernelTime(int64_t nSearchTime, int nBlockHeight);
     bool SignBlock(node::CBlockTemplate *pblocktemplate, int nHeight, int64_t nSearchTime);
     std::unique_ptr<node::CBlockTemplate> CreateNewBlock();
 
@@ -494,6 +735,14 @@ public:
     size_t CountTxSpends() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) { return mapTxSpends.size(); };
 
     int64_t nLastCoinStakeSearchTime = 0;
+    uint256 m_stake_candidates_tip; // tip the cached kernel data was read at
+    std::map<COutPoint, StakeKernelCandidate> m_stake_candidates;
+    uint256 m_stake_kernel_table_tip;
+    int64_t m_stake_kernel_table_end = 0; // first slot past the table
+    std::set<int64_t> m_stake_kernel_table; // slots where a candidate meets the target
+    int64_t m_kernel_found_us = 0; // when CreateCoinStake last found a kernel
+    std::map<COutPoint, CCoinStakeTemplate> m_coinstake_templates; // staking thread only
+    std::atomic_bool m_coinstake_templates_stale {false}; // set when settings change
     uint32_t nStealth, nFoundStealth; // for reporting, zero before use
     int64_t nReserveBalance = 0;
     size_t nStakeThread = 9999999; // unset
@@ -503,6 +752,86 @@ public:
     mutable std::atomic_bool m_have_spendable_balance_cached {false};
     mutable CAmount m_spendable_balance_cached = 0;
 
+    /** GetBalances totals summed from per txn balances, txns in m_balances_dirty are recomputed before use */
+    mutable std::atomic_bool m_have_cached_balances {false};
+    mutable CHDWalletBalances m_cached_balances;
+    mutable std::map<uint256, CHDWalletBalances> m_txn_balances; // only txns with a nonzero balance
+    mutable std::set<uint256> m_balances_dirty;
+    mutable std::set<uint256> m_balances_volatile; // unconfirmed or immature txns, depend on the tip and mempool
+    bool m_check_balance_cache = false; // Compare the cached balances against a full recompute
+
+    /** Txids of records with unspent owned outputs by type, candidates for the Available*Coins and balance loops */
+    mutable std::atomic_bool m_have_unspent_record_sets {false};
+    mutable std::set<uint256> m_unspent_standard_txns;
+    mutable std::set<uint256> m_unspent_blind_txns;
+    mutable std::set<uint256> m_unspent_anon_txns;
+    mutable std::set<uint256> m_unspent_records_dirty;
+    /** Unspent owned blinded and anon outputs by value, m_unspent_txn_values holds the entries of each txid for removal */
+    typedef std::set<std::pair<CAmount, COutPoint> > UnspentValueIndex;
+    mutable UnspentValueIndex m_unspent_blind_by_value;
+    mutable UnspentValueIndex m_unspent_anon_by_value;
+    mutable std::map<uint256, std::vector<std::pair<CAmount, uint32_t> > > m_unspent_txn_values;
+
+    /** Outputs in stakeable scripts per txn and their totals, txns in m_stake_scripts_dirty are reevaluated before use */
+    mutable std::atomic_bool m_have_stake_script_totals {false};
+    mutable std::map<uint256, std::vector<CStakeScriptOutput> > m_stake_script_txns; // only txns with stakeable outputs
+    mutable std::map<CKeyID, CStakeScriptTotals> m_coldstake_by_stake_key;
+    mutable std::map<CTxDestination, CStakeScriptTotals> m_coldstake_by_spend_key;
+    mutable CStakeScriptTotals m_coldstake_totals;
+    mutable CStakeScriptTotals m_hot_stake_totals; // P2PKH and P2PKH256 outputs
+    mutable std::set<uint256> m_stake_scripts_dirty;
+    mutable std::set<uint256> m_stake_scripts_volatile; // unconfirmed, immature or not yet deep enough to stake
+
+    /** Owned outputs received per address and per txn, txns in m_address_totals_dirty are reevaluated before use */
+    mutable std::atomic_bool m_have_address_totals {false};
+    mutable std::map<uint256, std::vector<CAddressTxnTotals> > m_address_txn_totals; // only txns paying to owned addresses
+    mutable std::map<CTxDestination, CAddressTotals> m_address_totals;
+    mutable std::set<uint256> m_address_totals_dirty;
+    mutable std::set<uint256> m_address_totals_volatile; // unconfirmed or immature txns
+
+    /** Outputs never change once their txn is stored, entries need no invalidation */
+    mutable LRUCache<COutPoint, CPrevoutData, SaltedOutpointHasher> m_prevout_data_cache GUARDED_BY(cs_wallet) {PREVOUT_DATA_CACHE_SIZE};
+    mutable LRUCache<uint256, CRewoundOutput, SaltedTxidHasher> m_rewound_output_cache GUARDED_BY(cs_wallet) {REWOUND_OUTPUT_CACHE_SIZE};
+
+    /** Scripts found not to be owned, flagged per IsMine path (ISMINE_CACHE_NO_*).
+     *  Only negative results are kept, found keys must still be resolved to be promoted out of the lookahead.
+     *  ClearIsMineCache is called wherever keys, lookahead, chains or accounts are added, it only bumps
+     *  m_ismine_cache_epoch so the keystores can call it without taking cs_wallet.
+     */
+    enum : uint8_t { ISMINE_CACHE_NO_HD = 1, ISMINE_CACHE_NO_LEGACY = 2 };
+    mutable LRUCache<CScript, uint8_t, SaltedSipHasher> m_ismine_cache GUARDED_BY(cs_wallet) {ISMINE_CACHE_SIZE};
+    mutable std::atomic<uint64_t> m_ismine_cache_epoch {0};
+    mutable uint64_t m_ismine_cache_read_epoch GUARDED_BY(cs_wallet) {0};
+    void ClearIsMineCache() const { m_ismine_cache_epoch++; }
+    /** Returns the cached ISMINE_CACHE_NO_* flags of script, 0 if not cached */
+    uint8_t GetIsMineCacheFlags(const CScript &script) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * Balances and stake weight published for readers that shouldn't wait on cs_wallet while the staking
+     * thread or block processing holds it. A snapshot is current while m_wallet_state_version is unchanged,
+     * the version is bumped with cs_wallet held wherever the txn caches are invalidated.
+     */
+    mutable std::atomic<uint64_t> m_wallet_state_version {0};
+    mutable Mutex cs_wallet_snapshot;
+    mutable std::optional<std::pair<uint64_t, CHDWalletBalances> > m_balances_snapshot GUARDED_BY(cs_wallet_snapshot);
+    struct StakeWeightSnapshot {
+        uint64_t version;
+        int height;
+        CAmount reserve_balance;
+        uint64_t weight;
+    };
+    mutable std::optional<StakeWeightSnapshot> m_stake_weight_snapshot GUARDED_BY(cs_wallet_snapshot);
+
+    /** Drop the per txn caches, for changes not passed through ClearCachedBalances(tx) */
+    void ResetTxnCaches() const
+    {
+        ++m_wallet_state_version;
+        m_have_cached_balances = false;
+        m_have_unspent_record_sets = false;
+        m_have_stake_script_totals = false;
+        m_have_address_totals = false;
+    }
+
     enum eStakingState {
         NOT_STAKING = 0,
         IS_STAKING = 1,
@@ -515,6 +844,8 @@ public:
     std::atomic<eStakingState> m_is_staking {NOT_STAKING};
 
     std::set<CStealthAddress> stealthAddresses;
+    /** Owned and watched entries of stealthAddresses by prefix, maintained by Add/EraseStealthAddressInMem */
+    CStealthPrefixIndex m_stealth_prefix_index;
 
     CStoredExtKey *pEKMaster = nullptr;
     CKeyID idDefaultAccount;
@@ -527,6 +858,12 @@ public:
 
     MapRecords_t mapRecords;
     RtxOrdered_t rtxOrdered;
+    /** Owned anon outputs by key image, mirrors the aki records of the wallet db */
+    std::map<CCmpPubKey, COutPoint> m_anon_key_images GUARDED_BY(cs_wallet);
+    /** Records that may be unconfirmed and not abandoned, resends run over these instead of rtxOrdered.
+     *  Entries since confirmed, conflicted, abandoned or removed are dropped by ResendRecordTransactionsBefore. */
+    std::set<uint256> m_unconfirmed_records;
+    CConsolidationState m_consolidation GUARDED_BY(cs_wallet);
     mutable MapRecords_t mapTempRecords; // Hack for sending unmined inputs through fundrawtransactionfrom
 
     std::vector<CVoteToken> vVoteTokens;
@@ -542,6 +879,11 @@ public:
 
     mutable std::atomic_bool m_have_cached_stakeable_coins {false};
     mutable std::vector<COutput> m_cached_stakeable_coins;
+    mutable CAmount m_cached_stakeable_value = 0; // sum of m_cached_stakeable_coins
+    mutable std::set<uint256> m_stakeable_coins_dirty; // txids to reevaluate in m_cached_stakeable_coins
+    mutable std::multimap<int, uint256> m_maturing_stake_txns; // txids by height confirmed, not yet deep enough to stake
+    mutable int m_stakeable_coins_height = 0; // tip height m_cached_stakeable_coins was updated at
+    mutable int m_stakeable_oldest_height = std::numeric_limits<int>::max(); // lowest confirmed height seen
 
     bool fUnlockForStakingOnly = false; // Use coldstaking instead
 
@@ -553,8 +895,10 @@ public:
 
     int m_collapse_spent_mode = 0;
     int m_min_collapse_depth = 3;
+    int m_archive_record_depth = 0; // 0 disabled
+    size_t m_num_archived_records = 0;
     std::map<uint256, std::set<uint256> > mapTxCollapsedSpends;
-    std::set<uint256> m_collapsed_txns;
+    std::set<uint256> m_collapsed_txns; // Includes archived records
     std::set<COutPoint> m_collapsed_txn_inputs;
 
     int64_t m_smsg_fee_rate_target = 0;
@@ -564,6 +908,45 @@ public:
     size_t m_rescan_stealth_v1_lookahead = DEFAULT_STEALTH_LOOKAHEAD_SIZE;
     size_t m_rescan_stealth_v2_lookahead = DEFAULT_STEALTH_LOOKAHEAD_SIZE;
     size_t m_default_lookahead = DEFAULT_LOOKAHEAD_SIZE;
+    CWalletLoadTimings m_load_timings;
+    bool m_lazy_key_packs = DEFAULT_LAZY_KEY_PACKS;
+    bool m_records_snapshot = DEFAULT_RECORDS_SNAPSHOT;
+    bool m_compact_stored_txns = DEFAULT_COMPACT_STORED_TXNS;
+    size_t m_key_pack_cache_size = DEFAULT_KEY_PACK_CACHE_SIZE;
+
+    /** Stealth scan keys copied at the start of a rescan, not modified while blocks are prepared */
+    CStealthScanner m_rescan_stealth_keys;
+    std::set<uint160> m_rescan_stealth_key_ids GUARDED_BY(cs_wallet);
+    Mutex m_rescan_hints_mutex;
+    /** Outputs of prepared blocks tested against m_rescan_stealth_keys, true if a key matched */
+    std::map<COutPoint, bool> m_rescan_stealth_hints GUARDED_BY(m_rescan_hints_mutex);
+    /** Set while a rescan skips the blocks the particl block filter rules out */
+    bool m_rescan_filter_active GUARDED_BY(cs_wallet) = false;
+    /** Scripts of the wallet matched against the block filters, grows as keys are generated during the rescan */
+    GCSFilter::ElementSet m_rescan_filter_elements GUARDED_BY(cs_wallet);
+    /** Number of keys of each ext key in m_rescan_filter_elements */
+    std::map<CKeyID, uint32_t> m_rescan_filter_derived GUARDED_BY(cs_wallet);
+    size_t m_rescan_filter_skipped GUARDED_BY(cs_wallet) = 0;
+    /** Set while RescanHeightRanges runs, written to the wallet db by SaveRescanProgress */
+    std::optional<CRescanProgress> m_rescan_progress GUARDED_BY(cs_wallet);
+    /** Wallet best block when the range scanned started from it, the best block is advanced with the scan */
+    std::optional<int> m_rescan_best_block_height GUARDED_BY(cs_wallet);
+    /** Shared parse of the block being connected, set while blockConnected runs */
+    std::shared_ptr<const BlockScanData> m_block_scan_data GUARDED_BY(cs_wallet);
+    /** Set while a block is synced, AddToRecord queues its writes to be committed in one db txn in CommitBlockWrites */
+    bool m_defer_record_writes GUARDED_BY(cs_wallet) = false;
+    std::map<uint256, CStoredTransaction> m_pending_stored_txns GUARDED_BY(cs_wallet);
+    /** Owned anon outputs whose key images OwnAnonOut left to WritePendingKeyImages, queued while m_defer_key_images is set */
+    struct PendingKeyImage {
+        COutPoint op;
+        CCmpPubKey pk;
+        CKey key;
+    };
+    bool m_defer_key_images GUARDED_BY(cs_wallet) = false;
+    std::vector<PendingKeyImage> m_pending_key_images GUARDED_BY(cs_wallet);
+    /** Compute the queued key images in parallel and write them with wdb.
+     *  If earliest_spent_time is set it's lowered to the txn time of outputs whose key images are in the chain or mempool. */
+    void WritePendingKeyImages(CHDWalletDB &wdb, int64_t *earliest_spent_time = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     bool m_smsg_enabled = true;
     CAmount m_min_stakeable_value = 1;  // Wallet will not try to stake outputs below this value
@@ -574,6 +957,9 @@ public:
 private:
     void ParseAddressForMetaData(const CTxDestination &addr, COutputRecord &rec);
 
+    isminetype IsMineScript(const CScript &scriptPubKey, CKeyID &keyID,
+        const CEKAKey *&pak, const CEKASCKey *&pasc, CExtKeyAccount *&pa, bool &isInvalid, SigVersion sigversion) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     template<typename... Params>
     bool werror(std::string fmt, Params... parameters) const {
         return error(("%s " + fmt).c_str(), GetDisplayName(), parameters...);
@@ -10,6 +10,9 @@
 #include <key/stealth.h>
 #include <primitives/transaction.h>
 #include <uint256.h>
+#ifdef USE_SQLITE
+#include <wallet/sqlite.h>
+#endif
 
 #include <serialize.h>
 #include <stdint.h>
@@ -35,6 +38,192 @@ public:
     }
 };
 
+class CHDWalletDBCursorBDB : public CHDWalletDBCursor
+{
+public:
+    CHDWalletDBCursorBDB(BerkeleyBatch *bb, Dbc *pcursor) : m_bb(bb), m_cursor(pcursor) {};
+    ~CHDWalletDBCursorBDB() override { m_cursor->close(); };
+
+    int Read(CDataStream &ssKey, CDataStream *pssValue, unsigned int fFlags) override
+    {
+        BerkeleyBatch::SafeDbt datKey, datValue;
+        if (fFlags == DB_SET || fFlags == DB_SET_RANGE) {
+            datKey.set_data(ssKey.data(), ssKey.size());
+        }
+        Dbt datValuePartial;
+        datValuePartial.set_flags(DB_DBT_PARTIAL); // don't read data, dlen and doff are 0 after memset
+
+        int ret = pssValue ? m_cursor->get(datKey, datValue, fFlags)
+                           : m_cursor->get(datKey, &datValuePartial, fFlags);
+        if (ret != 0) {
+            if (datKey.get_data() == ssKey.data()) {
+                datKey.set_data(nullptr, 0); // Avoid free in ~SafeDbt
+            }
+            return ret;
+        }
+        if (datKey.get_data() == nullptr || (pssValue && datValue.get_data() == nullptr)) {
+            return 99999;
+        }
+
+        // Convert to streams
+        ssKey.SetType(SER_DISK);
+        ssKey.clear();
+        ssKey.write(AsBytes(Span{(char*)datKey.get_data(), datKey.get_size()}));
+
+        if (pssValue) {
+            pssValue->SetType(SER_DISK);
+            pssValue->clear();
+            pssValue->write(AsBytes(Span{(char*)datValue.get_data(), datValue.get_size()}));
+        }
+        return 0;
+    }
+
+    int Replace(CDataStream &ssValue) override
+    {
+        if (m_bb->fReadOnly) {
+            assert(!"Replace called on database in read-only mode");
+        }
+        Dbt datValue(ssValue.data(), ssValue.size());
+        int ret = m_cursor->put(nullptr, &datValue, DB_CURRENT);
+        if (ret != 0) {
+            LogPrintf("CursorPut ret %d - %s\n", ret, DbEnv::strerror(ret));
+        }
+        return ret;
+    }
+
+    int Erase() override
+    {
+        return m_cursor->del(0);
+    }
+
+private:
+    BerkeleyBatch *m_bb;
+    Dbc *m_cursor;
+};
+
+#ifdef USE_SQLITE
+/** SQLite statements can't be kept open across writes, each read is a fresh range lookup
+ *  from the last key returned, so records erased or replaced at the cursor are well defined. */
+class CHDWalletDBCursorSQLite : public CHDWalletDBCursor
+{
+public:
+    explicit CHDWalletDBCursorSQLite(SQLiteBatch *batch) : m_batch(batch) {};
+
+    int Read(CDataStream &ssKey, CDataStream *pssValue, unsigned int fFlags) override
+    {
+        bool after;
+        if (fFlags == DB_SET_RANGE) {
+            m_key.clear();
+            m_key.write(MakeByteSpan(ssKey));
+            after = false;
+        } else
+        if (fFlags == DB_NEXT) {
+            after = m_positioned; // Unpositioned DB_NEXT reads the first record
+        } else {
+            return EINVAL;
+        }
+
+        bool complete;
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        if (!m_batch->ReadAtOrAfter(m_key, ssValue, after, complete)) {
+            return 99999;
+        }
+        if (complete) {
+            return DB_NOTFOUND;
+        }
+        m_positioned = true;
+
+        ssKey.SetType(SER_DISK);
+        ssKey.clear();
+        ssKey.write(MakeByteSpan(m_key));
+        if (pssValue) {
+            pssValue->SetType(SER_DISK);
+            *pssValue = std::move(ssValue);
+        }
+        return 0;
+    }
+
+    int Replace(CDataStream &ssValue) override
+    {
+        if (!m_positioned) {
+            return EINVAL;
+        }
+        return m_batch->Write(MakeUCharSpan(m_key), MakeUCharSpan(ssValue)) ? 0 : 99999;
+    }
+
+    int Erase() override
+    {
+        if (!m_positioned) {
+            return EINVAL;
+        }
+        return m_batch->Erase(MakeUCharSpan(m_key)) ? 0 : 99999;
+    }
+
+private:
+    SQLiteBatch *m_batch;
+    CDataStream m_key{SER_DISK, CLIENT_VERSION};
+    bool m_positioned = false;
+};
+#endif
+
+bool CHDWalletDB::InTxn()
+{
+    if (BerkeleyBatch *bb = dynamic_cast<BerkeleyBatch*>(m_batch.get())) {
+        return bb->pdb && bb->activeTxn;
+    }
+#ifdef USE_SQLITE
+    if (SQLiteBatch *sb = dynamic_cast<SQLiteBatch*>(m_batch.get())) {
+        return sb->HasActiveTxn();
+    }
+#endif
+    return false;
+}
+
+std::unique_ptr<CHDWalletDBCursor> CHDWalletDB::GetTxnCursor()
+{
+    if (BerkeleyBatch *bb = dynamic_cast<BerkeleyBatch*>(m_batch.get())) {
+        if (!bb->pdb || !bb->activeTxn) {
+            return nullptr;
+        }
+        Dbc *pcursor = nullptr;
+        int ret = bb->pdb->cursor(bb->activeTxn, &pcursor, 0);
+        if (ret != 0 || !pcursor) {
+            return nullptr;
+        }
+        return std::make_unique<CHDWalletDBCursorBDB>(bb, pcursor);
+    }
+#ifdef USE_SQLITE
+    if (SQLiteBatch *sb = dynamic_cast<SQLiteBatch*>(m_batch.get())) {
+        if (!sb->HasActiveTxn()) {
+            return nullptr;
+        }
+        return std::make_unique<CHDWalletDBCursorSQLite>(sb);
+    }
+#endif
+    return nullptr;
+}
+
+std::unique_ptr<CHDWalletDBCursor> CHDWalletDB::GetCursor()
+{
+    if (BerkeleyBatch *bb = dynamic_cast<BerkeleyBatch*>(m_batch.get())) {
+        if (!bb->pdb) {
+            return nullptr;
+        }
+        Dbc *pcursor = nullptr;
+        int ret = bb->pdb->cursor(nullptr, &pcursor, 0);
+        if (ret != 0 || !pcursor) {
+            return nullptr;
+        }
+        return std::make_unique<CHDWalletDBCursorBDB>(bb, pcursor);
+    }
+#ifdef USE_SQLITE
+    if (SQLiteBatch *sb = dynamic_cast<SQLiteBatch*>(m_batch.get())) {
+        return std::make_unique<CHDWalletDBCursorSQLite>(sb);
+    }
+#endif
+    return nullptr;
+}
+
 bool CHDWalletDB::WriteStealthKeyMeta(const CKeyID &keyId, const CStealthKeyMetadata &sxKeyMeta)
 {
     return WriteIC(std::make_pair(std::string("sxkm"), keyId), sxKeyMeta, true);
@@ -219,6 +408,21 @@ bool CHDWalletDB::EraseVoteTokens()
     return EraseIC(std::string("votes"));
 };
 
+bool CHDWalletDB::ReadRescanProgress(CRescanProgress &progress, uint32_t nFlags)
+{
+    return m_batch->Read(std::string("rescanprogress"), progress, nFlags);
+};
+
+bool CHDWalletDB::WriteRescanProgress(const CRescanProgress &progress)
+{
+    return WriteIC(std::string("rescanprogress"), progress, true);
+};
+
+bool CHDWalletDB::EraseRescanProgress()
+{
+    return EraseIC(std::string("rescanprogress"));
+};
+
 
 bool CHDWalletDB::WriteTxRecord(const uint256 &hash, const CTransactionRecord &rtx)
 {
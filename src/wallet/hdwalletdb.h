@@ -5,11 +5,14 @@
 #ifndef PARTICL_WALLET_HDWALLETDB_H
 #define PARTICL_WALLET_HDWALLETDB_H
 
+#include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <support/cleanse.h>
 #include <wallet/bdb.h>
 #include <wallet/walletdb.h>
 #include <key/types.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -76,6 +79,7 @@ prefixes
 
     pool
 
+    rescanprogress      - CRescanProgress of an interrupted rescan
     ris                 - reverse stealth index key: hashed raw stealth address bytes, value: uint32_t
     rtx                 - CTransactionRecord
 
@@ -205,138 +209,86 @@ public:
     }
 };
 
-/** Access to the wallet database */
-class CHDWalletDB : public WalletBatch
+/** Height ranges left to scan by an interrupted rescan, stored under "rescanprogress".
+ *  locator is the last block scanned in ranges[0], null if ranges[0] was not started.
+ */
+class CRescanProgress
 {
 public:
-    CHDWalletDB(WalletDatabase& dbw, bool _fFlushOnClose = true) : WalletBatch(dbw, _fFlushOnClose)
-    {
-    };
+    std::vector<std::pair<int, int> > ranges; // Inclusive, an end of -1 scans up to the tip
+    CBlockLocator locator;
+    int last_height = -1;
+    uint32_t stealth_v1_lookahead = 0;
+    uint32_t stealth_v2_lookahead = 0;
 
-    bool InTxn()
+    SERIALIZE_METHODS(CRescanProgress, obj)
     {
-        BerkeleyBatch *bb = static_cast<BerkeleyBatch*>(m_batch.get());
-        return bb && bb->pdb && bb->activeTxn;
+        READWRITE(obj.ranges);
+        READWRITE(obj.locator);
+        READWRITE(obj.last_height);
+        READWRITE(obj.stealth_v1_lookahead);
+        READWRITE(obj.stealth_v2_lookahead);
     }
+};
 
-    Dbc *GetTxnCursor()
-    {
-        BerkeleyBatch *bb = static_cast<BerkeleyBatch*>(m_batch.get());
-        if (!bb || !bb->pdb || !bb->activeTxn) {
-            return nullptr;
-        }
+/** Cursor over the records of a wallet database batch, BDB or SQLite.
+ *  Reads follow BDB cursor semantics, DB_SET_RANGE positions at the first key >= ssKey
+ *  and DB_NEXT moves to the following key, DB_NOTFOUND is returned past the last record.
+ */
+class CHDWalletDBCursor
+{
+public:
+    virtual ~CHDWalletDBCursor() {};
+
+    /** Read the key, and value if pssValue is set, returns 0 on success */
+    virtual int Read(CDataStream &ssKey, CDataStream *pssValue, unsigned int fFlags) = 0;
+    /** Overwrite the value of the record at the cursor */
+    virtual int Replace(CDataStream &ssValue) = 0;
+    /** Erase the record at the cursor, the position is kept for DB_NEXT */
+    virtual int Erase() = 0;
+};
 
-        DbTxn *ptxnid = bb->activeTxn; // call TxnBegin first
+/** Access to the wallet database */
+class CHDWalletDB : public WalletBatch
+{
+public:
+    CHDWalletDB(WalletDatabase& dbw, bool _fFlushOnClose = true) : WalletBatch(dbw, _fFlushOnClose)
+    {
+    };
 
-        Dbc *pcursor = nullptr;
-        int ret = bb->pdb->cursor(ptxnid, &pcursor, 0);
-        if (ret != 0) {
-            return nullptr;
-        }
-        return pcursor;
-    }
+    bool InTxn();
 
-    Dbc *GetCursor()
-    {
-        BerkeleyBatch *bb = static_cast<BerkeleyBatch*>(m_batch.get());
-        if (!bb || !bb->pdb) {
-            return nullptr;
-        }
-        Dbc* pcursor = nullptr;
-        int ret = bb->pdb->cursor(nullptr, &pcursor, 0);
-        if (ret != 0)
-            return nullptr;
-        return pcursor;
-    }
+    /** Cursor within the active txn, call TxnBegin first */
+    std::unique_ptr<CHDWalletDBCursor> GetTxnCursor();
+    std::unique_ptr<CHDWalletDBCursor> GetCursor();
 
     template< typename T>
-    bool Replace(Dbc *pcursor, const T &value)
+    bool Replace(CHDWalletDBCursor *pcursor, const T &value)
     {
-        BerkeleyBatch *bb = static_cast<BerkeleyBatch*>(m_batch.get());
         if (!pcursor) {
             return false;
         }
 
-        if (bb->fReadOnly) {
-            assert(!"Replace called on database in read-only mode");
-        }
-
         // Value
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
-        Dbt datValue(&ssValue[0], ssValue.size());
-
-        // Write
-        int ret = pcursor->put(nullptr, &datValue, DB_CURRENT);
 
-        if (ret != 0) {
-            LogPrintf("CursorPut ret %d - %s\n", ret, DbEnv::strerror(ret));
-        }
+        int ret = pcursor->Replace(ssValue);
         // Clear memory in case it was a private key
-        memset(datValue.get_data(), 0, datValue.get_size());
+        memory_cleanse(ssValue.data(), ssValue.size());
 
         return (ret == 0);
     }
 
-    int ReadAtCursor(Dbc *pcursor, CDataStream &ssKey, CDataStream &ssValue, unsigned int fFlags=DB_NEXT)
+    int ReadAtCursor(CHDWalletDBCursor *pcursor, CDataStream &ssKey, CDataStream &ssValue, unsigned int fFlags=DB_NEXT)
     {
-        // Read at cursor
-        BerkeleyBatch::SafeDbt datKey, datValue;
-        if (fFlags == DB_SET || fFlags == DB_SET_RANGE || fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE) {
-            datKey.set_data(ssKey.data(), ssKey.size());
-        }
-        if (fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE) {
-            datValue.set_data(ssValue.data(), ssValue.size());
-        }
-        int ret = pcursor->get(datKey, datValue, fFlags);
-        if (ret != 0) {
-            if (datKey.get_data() == ssKey.data()) {
-                datKey.set_data(nullptr, 0); // Avoid free in ~SafeDbt
-            }
-            if (datValue.get_data() == ssValue.data()) {
-                datValue.set_data(nullptr, 0); // Avoid free in ~SafeDbt
-            }
-            return ret;
-        } else
-        if (datKey.get_data() == nullptr || datValue.get_data() == nullptr) {
-            return 99999;
-        }
-
-        // Convert to streams
-        ssKey.SetType(SER_DISK);
-        ssKey.clear();
-        ssKey.write(AsBytes(Span{(char*)datKey.get_data(), datKey.get_size()}));
-
-        ssValue.SetType(SER_DISK);
-        ssValue.clear();
-        ssValue.write(AsBytes(Span{(char*)datValue.get_data(), datValue.get_size()}));
-        return 0;
+        return pcursor->Read(ssKey, &ssValue, fFlags);
     }
 
-    int ReadKeyAtCursor(Dbc *pcursor, CDataStream &ssKey, unsigned int fFlags=DB_NEXT)
+    int ReadKeyAtCursor(CHDWalletDBCursor *pcursor, CDataStream &ssKey, unsigned int fFlags=DB_NEXT)
     {
-        // Read key at cursor
-        BerkeleyBatch::SafeDbt datKey;
-        if (fFlags == DB_SET || fFlags == DB_SET_RANGE) {
-            datKey.set_data(&ssKey[0], ssKey.size());
-        }
-        Dbt datValue;
-        datValue.set_flags(DB_DBT_PARTIAL); // don't read data, dlen and doff are 0 after memset
-
-        int ret = pcursor->get(datKey, &datValue, fFlags);
-        if (ret != 0) {
-            return ret;
-        }
-        if (datKey.get_data() == nullptr) {
-            return 99999;
-        }
-
-        // Convert to streams
-        ssKey.SetType(SER_DISK);
-        ssKey.clear();
-        ssKey.write(AsBytes(Span{(char*)datKey.get_data(), datKey.get_size()}));
-        return 0;
+        return pcursor->Read(ssKey, nullptr, fFlags);
     }
 
 
@@ -394,6 +346,10 @@ public:
     bool WriteVoteTokens(const std::vector<CVoteToken> &vVoteTokens);
     bool EraseVoteTokens();
 
+    bool ReadRescanProgress(CRescanProgress &progress, uint32_t nFlags=DB_READ_UNCOMMITTED);
+    bool WriteRescanProgress(const CRescanProgress &progress);
+    bool EraseRescanProgress();
+
     bool WriteTxRecord(const uint256 &hash, const CTransactionRecord &rtx);
     bool EraseTxRecord(const uint256 &hash);
 
@@ -73,6 +73,95 @@ const COutputRecord *CTransactionRecord::GetChangeOutput() const
     return nullptr;
 };
 
+static CAmount CHDWalletBalances::* const BALANCE_FIELDS[] = {
+    &CHDWalletBalances::nPart,
+    &CHDWalletBalances::nPartUnconf,
+    &CHDWalletBalances::nPartStaked,
+    &CHDWalletBalances::nPartImmature,
+    &CHDWalletBalances::nPartWatchOnly,
+    &CHDWalletBalances::nPartWatchOnlyUnconf,
+    &CHDWalletBalances::nPartWatchOnlyStaked,
+    &CHDWalletBalances::nPartWatchOnlyImmature,
+    &CHDWalletBalances::nBlind,
+    &CHDWalletBalances::nBlindUnconf,
+    &CHDWalletBalances::nBlindWatchOnly,
+    &CHDWalletBalances::nBlindWatchOnlyUnconf,
+    &CHDWalletBalances::nAnon,
+    &CHDWalletBalances::nAnonUnconf,
+    &CHDWalletBalances::nAnonImmature,
+    &CHDWalletBalances::nAnonWatchOnly,
+    &CHDWalletBalances::nAnonWatchOnlyUnconf,
+    &CHDWalletBalances::nAnonWatchOnlyImmature,
+};
+static_assert(sizeof(BALANCE_FIELDS) / sizeof(BALANCE_FIELDS[0]) * sizeof(CAmount) == sizeof(CHDWalletBalances), "BALANCE_FIELDS must list every member");
+
+CHDWalletBalances &CHDWalletBalances::operator+=(const CHDWalletBalances &b)
+{
+    for (auto field : BALANCE_FIELDS) {
+        this->*field += b.*field;
+    }
+    return *this;
+}
+
+CHDWalletBalances &CHDWalletBalances::operator-=(const CHDWalletBalances &b)
+{
+    for (auto field : BALANCE_FIELDS) {
+        this->*field -= b.*field;
+    }
+    return *this;
+}
+
+bool CHDWalletBalances::operator==(const CHDWalletBalances &b) const
+{
+    for (auto field : BALANCE_FIELDS) {
+        if (this->*field != b.*field) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CStakeScriptTotals &CStakeScriptTotals::operator+=(const CStakeScriptTotals &b)
+{
+    nOutputs += b.nOutputs;
+    nValue += b.nValue;
+    nSafe += b.nSafe;
+    nSafeSpendable += b.nSafeSpendable;
+    nStaking += b.nStaking;
+    return *this;
+}
+
+CStakeScriptTotals &CStakeScriptTotals::operator-=(const CStakeScriptTotals &b)
+{
+    nOutputs -= b.nOutputs;
+    nValue -= b.nValue;
+    nSafe -= b.nSafe;
+    nSafeSpendable -= b.nSafeSpendable;
+    nStaking -= b.nStaking;
+    return *this;
+}
+
+CAddressTotals &CAddressTotals::operator+=(const CAddressTxnTotals &b)
+{
+    nReceived += b.nReceived;
+    nBalance += b.nBalance;
+    nTxns++;
+    txn_heights[b.nHeight]++;
+    return *this;
+}
+
+CAddressTotals &CAddressTotals::operator-=(const CAddressTxnTotals &b)
+{
+    nReceived -= b.nReceived;
+    nBalance -= b.nBalance;
+    nTxns--;
+    auto it = txn_heights.find(b.nHeight);
+    if (it != txn_heights.end() && --it->second < 1) {
+        txn_heights.erase(it);
+    }
+    return *this;
+}
+
 bool CStoredTransaction::InsertBlind(int n, const uint8_t *p)
 {
     for (auto &bp : vBlinds) {
@@ -110,3 +199,36 @@ bool CStoredTransaction::GetAnonPubkey(int n, CCmpPubKey &anon_pubkey) const
     anon_pubkey = ((CTxOutRingCT*)pout)->pk;
     return true;
 }
+
+void CStoredTransaction::Compact()
+{
+    if (!tx || IsCompact()) {
+        return;
+    }
+    CMutableTransaction mtx(*tx);
+    bool have_rangeproof = false;
+    for (auto &txout : mtx.vpout) {
+        std::vector<uint8_t> *pvRangeproof = txout->GetPRangeproof();
+        if (pvRangeproof && !pvRangeproof->empty()) {
+            have_rangeproof = true;
+            std::vector<uint8_t>().swap(*pvRangeproof);
+        }
+    }
+    if (have_rangeproof) {
+        tx = MakeTransactionRef(std::move(mtx));
+    }
+}
+
+bool CStoredTransaction::IsCompact() const
+{
+    if (!tx) {
+        return false;
+    }
+    for (const auto &txout : tx->vpout) {
+        const std::vector<uint8_t> *pvRangeproof = txout->GetPRangeproof();
+        if (pvRangeproof && pvRangeproof->empty()) {
+            return true;
+        }
+    }
+    return false;
+}
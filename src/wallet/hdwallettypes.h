@@ -293,6 +293,78 @@ public:
     CAmount nAnonWatchOnly = 0;
     CAmount nAnonWatchOnlyUnconf = 0;
     CAmount nAnonWatchOnlyImmature = 0;
+
+    CHDWalletBalances &operator+=(const CHDWalletBalances &b);
+    CHDWalletBalances &operator-=(const CHDWalletBalances &b);
+    bool operator==(const CHDWalletBalances &b) const;
+    bool operator!=(const CHDWalletBalances &b) const { return !(*this == b); }
+};
+
+/** Unspent outputs in stakeable scripts, summed per stake or spend key by the wallet */
+class CStakeScriptTotals
+{
+public:
+    int64_t nOutputs = 0;
+    CAmount nValue = 0;
+    CAmount nSafe = 0;          // In trusted txns
+    CAmount nSafeSpendable = 0; // In trusted txns and spendable by this wallet
+    CAmount nStaking = 0;       // In trusted txns and deep enough to stake
+
+    CStakeScriptTotals &operator+=(const CStakeScriptTotals &b);
+    CStakeScriptTotals &operator-=(const CStakeScriptTotals &b);
+    bool IsNull() const { return nOutputs == 0; }
+};
+
+/** Owned outputs of a trusted wallet txn paying to one address, see CHDWallet::UpdateAddressTotals */
+class CAddressTxnTotals
+{
+public:
+    CTxDestination dest;
+    CAmount nReceived = 0;
+    CAmount nBalance = 0;       // Unspent part of nReceived
+    int nHeight = 0;            // 0 if unconfirmed
+};
+
+/** Running totals of the owned outputs received by an address */
+class CAddressTotals
+{
+public:
+    CAmount nReceived = 0;
+    CAmount nBalance = 0;
+    int64_t nTxns = 0;
+    std::map<int, int64_t> txn_heights; // Txns per height, to keep LastHeight when txns are removed
+
+    CAddressTotals &operator+=(const CAddressTxnTotals &b);
+    CAddressTotals &operator-=(const CAddressTxnTotals &b);
+    int LastHeight() const { return txn_heights.empty() ? 0 : txn_heights.rbegin()->first; }
+    bool IsNull() const { return nTxns == 0; }
+};
+
+/** Output of a wallet txn in a stakeable script, see CHDWallet::UpdateStakeScriptTotals */
+class CStakeScriptOutput
+{
+public:
+    bool fColdStake = false;
+    CKeyID idStake;
+    CTxDestination destSpend;   // Unset if not fColdStake
+    CStakeScriptTotals totals;  // Contribution of the output
+};
+
+/** Spending data of a blinded prevout kept in a CStoredTransaction, cached by CHDWallet::GetPrevoutData */
+class CPrevoutData
+{
+public:
+    uint8_t nType = OUTPUT_NULL;
+    uint256 blind;
+    CCmpPubKey anon_pubkey; // OUTPUT_RINGCT only
+};
+
+/** Amount and blinding factor recovered from the rangeproof of a blinded output */
+class CRewoundOutput
+{
+public:
+    CAmount nValue = 0;
+    uint256 blind;
 };
 
 class CStoredTransaction
@@ -305,6 +377,11 @@ public:
     bool GetBlind(int n, uint8_t *p) const;
     bool GetAnonPubkey(int n, CCmpPubKey &anon_pubkey) const;
 
+    /** Drop the rangeproofs of the blinded outputs, the txid is unchanged as they are witness data */
+    void Compact();
+    /** True if a blinded output is missing its rangeproof, the full txn must be read from the block */
+    bool IsCompact() const;
+
     SERIALIZE_METHODS(CStoredTransaction, obj)
     {
         READWRITE(obj.tx);
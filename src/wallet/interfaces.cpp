@@ -459,6 +459,50 @@ public:
 
         return result;
     }
+    std::vector<uint256> getWalletTxHashes() override
+    {
+        LOCK(m_wallet->cs_wallet);
+        std::vector<std::pair<int64_t, uint256> > ordered;
+        ordered.reserve(m_wallet->mapWallet.size());
+        for (const auto& item : m_wallet->wtxOrdered) {
+            ordered.emplace_back(item.second->GetTxTime(), item.second->GetHash());
+        }
+        if (m_wallet_part) {
+            for (const auto& item : m_wallet_part->rtxOrdered) {
+                ordered.emplace_back(item.second->second.GetTxTime(), item.second->first);
+            }
+        }
+        std::stable_sort(ordered.begin(), ordered.end(), [](const std::pair<int64_t, uint256>& a, const std::pair<int64_t, uint256>& b) {
+            return a.first > b.first;
+        });
+
+        std::vector<uint256> result;
+        result.reserve(ordered.size());
+        for (const auto& item : ordered) {
+            result.push_back(item.second);
+        }
+        return result;
+    }
+    std::vector<WalletTx> getWalletTxs(const std::vector<uint256>& txids) override
+    {
+        LOCK(m_wallet->cs_wallet);
+        std::vector<WalletTx> result;
+        result.reserve(txids.size());
+        for (const auto& txid : txids) {
+            auto mi = m_wallet->mapWallet.find(txid);
+            if (mi != m_wallet->mapWallet.end()) {
+                result.emplace_back(MakeWalletTx(*m_wallet, mi->second));
+                continue;
+            }
+            if (m_wallet_part) {
+                const auto mi = m_wallet_part->mapRecords.find(txid);
+                if (mi != m_wallet_part->mapRecords.end()) {
+                    result.emplace_back(MakeWalletTx(*m_wallet_part, mi));
+                }
+            }
+        }
+        return result;
+    }
     bool tryGetTxStatus(const uint256& txid,
         interfaces::WalletTxStatus& tx_status,
         int& num_blocks,
@@ -717,6 +761,10 @@ public:
         return MakeHandler(m_wallet->NotifyTransactionChanged.connect(
             [fn](const uint256& txid, ChangeType status) { fn(txid, status); }));
     }
+    std::unique_ptr<Handler> handleTransactionsChanged(TransactionsChangedFn fn) override
+    {
+        return MakeHandler(m_wallet->NotifyTransactionsChanged.connect(fn));
+    }
     std::unique_ptr<Handler> handleWatchOnlyChanged(WatchOnlyChangedFn fn) override
     {
         return MakeHandler(m_wallet->NotifyWatchonlyChanged.connect(fn));
@@ -813,6 +861,15 @@ public:
         return (m_wallet_part && m_wallet_part->IsHardwareLinkedWallet());
     }
 
+    std::map<std::string, size_t> getMemoryUsage() override
+    {
+        std::map<std::string, size_t> usage;
+        if (m_wallet_part) {
+            m_wallet_part->GetMemoryUsage(usage);
+        }
+        return usage;
+    }
+
     CAmount getCredit(const CTxOutBase *txout, isminefilter filter) override
     {
         if (!m_wallet_part)
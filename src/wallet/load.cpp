@@ -154,6 +154,7 @@ void StartWallets(WalletContext& context, CScheduler& scheduler)
         scheduler.scheduleEvery([&context] { MaybeCompactWalletDB(context); }, std::chrono::milliseconds{500});
     }
     scheduler.scheduleEvery([&context] { MaybeResendWalletTxs(context); }, std::chrono::milliseconds{1000});
+    scheduler.scheduleEvery([&context] { MaybeConsolidateWalletOutputs(context); }, std::chrono::seconds{10});
 }
 
 void FlushWallets(WalletContext& context)
@@ -15,6 +15,8 @@
 #include <univalue.h>
 
 namespace wallet {
+static const size_t MAX_NEW_ADDRESSES = 10000;
+
 RPCHelpMan getnewaddress()
 {
     return RPCHelpMan{"getnewaddress",
@@ -27,12 +29,21 @@ RPCHelpMan getnewaddress()
                     {"hardened", RPCArg::Type::BOOL, RPCArg::Default{false}, "Derive a hardened key."},
                     {"256bit", RPCArg::Type::BOOL, RPCArg::Default{false}, "Use 256bit hash type."},
                     {"address_type", RPCArg::Type::STR, RPCArg::DefaultHint{"set by -addresstype"}, "The address type to use. Options are \"legacy\", \"p2sh-segwit\", and \"bech32\", and \"bech32m\"."},
+                    {"count", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, strprintf("Number of addresses to generate, max %d. The keys are derived together and saved in one database transaction.", MAX_NEW_ADDRESSES)},
                 },
-                RPCResult{
-                    RPCResult::Type::STR, "address", "The new particl address"
+                {
+                    RPCResult{"if count is not set",
+                        RPCResult::Type::STR, "address", "The new particl address"
+                    },
+                    RPCResult{"if count is set",
+                        RPCResult::Type::ARR, "", "", {
+                            {RPCResult::Type::STR, "address", "The new particl address"},
+                        }
+                    },
                 },
                 RPCExamples{
                     HelpExampleCli("getnewaddress", "")
+            + HelpExampleCli("getnewaddress", "\"\" false false false \"legacy\" 100")
             + HelpExampleRpc("getnewaddress", "")
                 },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
@@ -80,6 +91,15 @@ RPCHelpMan getnewaddress()
             throw JSONRPCError(RPC_INVALID_PARAMETER, "256bit must be used with address_type \"legacy\"");
         }
 
+        size_t count = 0;
+        if (request.params.size() > 5 && !request.params[5].isNull()) {
+            int64_t count_in = request.params[5].getInt<int64_t>();
+            if (count_in < 1 || count_in > (int64_t)MAX_NEW_ADDRESSES) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %d", MAX_NEW_ADDRESSES));
+            }
+            count = count_in;
+        }
+
         CPubKey newKey;
         CHDWallet *phdw = GetParticlWallet(pwallet.get());
         {
@@ -94,24 +114,42 @@ RPCHelpMan getnewaddress()
                 throw JSONRPCError(RPC_WALLET_ERROR, "No default account set.");
             }
         }
-        if (0 != phdw->NewKeyFromAccount(newKey, false, fHardened, f256bit, fBech32, label.c_str(), output_type)) {
-            throw JSONRPCError(RPC_WALLET_ERROR, "NewKeyFromAccount failed.");
+        std::vector<CPubKey> newKeys;
+        if (count > 0) {
+            if (0 != phdw->NewKeysFromAccount(count, newKeys, false, fHardened, f256bit, fBech32, label.c_str(), output_type)) {
+                throw JSONRPCError(RPC_WALLET_ERROR, "NewKeysFromAccount failed.");
+            }
+        } else {
+            if (0 != phdw->NewKeyFromAccount(newKey, false, fHardened, f256bit, fBech32, label.c_str(), output_type)) {
+                throw JSONRPCError(RPC_WALLET_ERROR, "NewKeyFromAccount failed.");
+            }
+            newKeys.push_back(newKey);
         }
 
-        if (output_type != OutputType::LEGACY) {
-            CTxDestination dest;
-            LegacyScriptPubKeyMan* spk_man = pwallet->GetLegacyScriptPubKeyMan();
-            if (spk_man) {
-                spk_man->LearnRelatedScripts(newKey, output_type);
+        UniValue addresses(UniValue::VARR);
+        for (const auto &pk : newKeys) {
+            std::string address;
+            if (output_type != OutputType::LEGACY) {
+                CTxDestination dest;
+                LegacyScriptPubKeyMan* spk_man = pwallet->GetLegacyScriptPubKeyMan();
+                if (spk_man) {
+                    spk_man->LearnRelatedScripts(pk, output_type);
+                }
+                dest = GetDestinationForKey(pk, output_type);
+                address = EncodeDestination(dest);
+            } else
+            if (f256bit) {
+                CKeyID256 idKey256 = pk.GetID256();
+                address = CBitcoinAddress(idKey256, fBech32).ToString();
+            } else {
+                address = CBitcoinAddress(PKHash(pk), fBech32).ToString();
             }
-            dest = GetDestinationForKey(newKey, output_type);
-            return EncodeDestination(dest);
-        }
-        if (f256bit) {
-            CKeyID256 idKey256 = newKey.GetID256();
-            return CBitcoinAddress(idKey256, fBech32).ToString();
+            if (count == 0) {
+                return address;
+            }
+            addresses.push_back(address);
         }
-        return CBitcoinAddress(PKHash(newKey), fBech32).ToString();
+        return addresses;
     }
 
     LOCK(pwallet->cs_wallet);
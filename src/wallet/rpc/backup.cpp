@@ -887,11 +887,9 @@ RPCHelpMan dumpwallet()
         std::string sError;
         file << "\n# --- Begin JSON --- \n";
 
-        UniValue rv(UniValue::VOBJ);
-        if (!GetParticlWallet(pwallet.get())->DumpJson(rv, sError)) {
+        if (!GetParticlWallet(pwallet.get())->DumpJson(file, sError)) {
             throw JSONRPCError(RPC_WALLET_ERROR, "DumpJson failed " + sError);
         }
-        file << rv.write(1);
 
         file << "\n# --- End JSON --- \n";
     }
@@ -506,9 +506,8 @@ RPCHelpMan getbalances()
     // the user could have gotten from another RPC command prior to now
     wallet.BlockUntilSyncedToCurrentChain();
 
-    LOCK(wallet.cs_wallet);
-
     if (IsParticlWallet(&wallet)) {
+        // GetBalances takes cs_wallet only when the published snapshot is stale
         const CHDWallet *pwhd = GetParticlWallet(&wallet);
         CHDWalletBalances bal;
         pwhd->GetBalances(bal);
@@ -560,6 +559,8 @@ RPCHelpMan getbalances()
         return balances;
     }
 
+    LOCK(wallet.cs_wallet);
+
     const auto bal = GetBalance(wallet);
     UniValue balances{UniValue::VOBJ};
     {
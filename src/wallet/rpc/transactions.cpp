@@ -1297,10 +1297,27 @@ RPCHelpMan rescanblockchain()
 {
     return RPCHelpMan{"rescanblockchain",
                 "\nRescan the local blockchain for wallet related transactions.\n"
-                "Note: Use \"getwalletinfo\" to query the scanning progress.\n",
+                "Note: Use \"getwalletinfo\" to query the scanning progress.\n"
+                "Progress is saved, a rescan interrupted by abortrescan or a shutdown is resumed when the wallet is loaded,\n"
+                "or when rescanblockchain is called without start_height and stop_height.\n",
                 {
-                    {"start_height", RPCArg::Type::NUM, RPCArg::Default{0}, "block height where the rescan should start"},
+                    {"start_height", RPCArg::Type::NUM, RPCArg::DefaultHint{"0, or where an interrupted rescan stopped"}, "block height where the rescan should start"},
                     {"stop_height", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "the last block height that should be scanned. If none is provided it will rescan up to the tip at return time of this call."},
+                    {"options", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED_NAMED_ARG, "",
+                        {
+                            {"ranges", RPCArg::Type::ARR, RPCArg::Optional::OMITTED, "Height ranges to scan instead of start_height and stop_height.\n"
+                                "Overlapping ranges are merged, the merged ranges are scanned in height order.",
+                                {
+                                    {"", RPCArg::Type::ARR, RPCArg::Optional::OMITTED, "[start_height, stop_height], a stop_height of -1 scans up to the tip",
+                                        {
+                                            {"start_height", RPCArg::Type::NUM, RPCArg::Optional::NO, ""},
+                                            {"stop_height", RPCArg::Type::NUM, RPCArg::Optional::NO, ""},
+                                        },
+                                    },
+                                },
+                            },
+                        },
+                        "options"},
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "",
@@ -1311,6 +1328,7 @@ RPCHelpMan rescanblockchain()
                 },
                 RPCExamples{
                     HelpExampleCli("rescanblockchain", "100000 120000")
+            + HelpExampleCli("rescanblockchain", "null null '{\"ranges\":[[1000,2000],[100000,-1]]}'")
             + HelpExampleRpc("rescanblockchain", "100000, 120000")
                 },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
@@ -1331,10 +1349,49 @@ RPCHelpMan rescanblockchain()
     int start_height = 0;
     std::optional<int> stop_height;
     uint256 start_block;
+    std::vector<std::pair<int, int> > ranges;
     {
         LOCK(pwallet->cs_wallet);
         int tip_height = pwallet->GetLastBlockHeight();
 
+        if (!request.params[2].isNull()) {
+            const UniValue &options = request.params[2].get_obj();
+            RPCTypeCheckObj(options,
+                {
+                    {"ranges", UniValueType(UniValue::VARR)},
+                }, true, true);
+            if (options.exists("ranges")) {
+                if (!pwallet->IsParticlWallet()) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "ranges requires a Particl wallet");
+                }
+                if (!request.params[0].isNull() || !request.params[1].isNull()) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "ranges can't be used with start_height or stop_height");
+                }
+                const UniValue &uv_ranges = options["ranges"].get_array();
+                for (size_t i = 0; i < uv_ranges.size(); ++i) {
+                    const UniValue &uv_range = uv_ranges[i];
+                    if (!uv_range.isArray() || uv_range.size() != 2) {
+                        throw JSONRPCError(RPC_INVALID_PARAMETER, "Each range must be [start_height, stop_height]");
+                    }
+                    int range_start = uv_range[0].getInt<int>();
+                    int range_stop = uv_range[1].getInt<int>();
+                    if (range_start < 0 || range_start > tip_height) {
+                        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid start_height in range %d", i));
+                    }
+                    if (range_stop != -1 && (range_stop < range_start || range_stop > tip_height)) {
+                        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid stop_height in range %d", i));
+                    }
+                    if (!pwallet->chain().hasBlocks(pwallet->GetLastBlockHash(), range_start, range_stop < 0 ? std::nullopt : std::optional<int>(range_stop))) {
+                        throw JSONRPCError(RPC_MISC_ERROR, "Can't rescan beyond pruned data. Use RPC call getblockchaininfo to determine your pruned height.");
+                    }
+                    ranges.emplace_back(range_start, range_stop);
+                }
+                if (ranges.empty()) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "No ranges");
+                }
+            }
+        }
+
         if (!request.params[0].isNull()) {
             start_height = request.params[0].getInt<int>();
             if (start_height < 0 || start_height > tip_height) {
@@ -1359,8 +1416,19 @@ RPCHelpMan rescanblockchain()
         CHECK_NONFATAL(pwallet->chain().findAncestorByHeight(pwallet->GetLastBlockHash(), start_height, FoundBlock().hash(start_block)));
     }
 
-    CWallet::ScanResult result =
-        pwallet->ScanForWalletTransactions(start_block, start_height, stop_height, reserver, true /* fUpdate */);
+    CWallet::ScanResult result;
+    CRescanProgress progress;
+    if (!ranges.empty()) {
+        start_height = std::min_element(ranges.begin(), ranges.end())->first;
+        result = GetParticlWallet(pwallet.get())->RescanHeightRanges(ranges, reserver);
+    } else
+    if (pwallet->IsParticlWallet() && request.params[0].isNull() && request.params[1].isNull() &&
+        GetParticlWallet(pwallet.get())->GetRescanProgress(progress)) {
+        start_height = progress.ranges[0].first;
+        result = GetParticlWallet(pwallet.get())->ResumeRescan(reserver);
+    } else {
+        result = pwallet->ScanForWalletTransactions(start_block, start_height, stop_height, reserver, true /* fUpdate */);
+    }
     switch (result.status) {
     case CWallet::ScanResult::SUCCESS:
         break;
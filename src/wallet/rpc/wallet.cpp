@@ -52,6 +52,18 @@ static RPCHelpMan getwalletinfo()
                         {RPCResult::Type::STR_AMOUNT, "immature_balance", "DEPRECATED. Identical to getbalances().mine.immature"},
                         {RPCResult::Type::STR_AMOUNT, "immature_anon_balance", /*optional=*/true, "DEPRECATED. Identical to getbalances().mine.anon_immature"},
                         {RPCResult::Type::STR_AMOUNT, "reserve", /*optional=*/true, "the reserve balance of the wallet in " + CURRENCY_UNIT},
+                        {RPCResult::Type::OBJ, "consolidation", /*optional=*/true, "progress of the background consolidation of small outputs, see walletsettings \"consolidation\"",
+                        {
+                            {RPCResult::Type::BOOL, "enabled", "whether consolidation is enabled"},
+                            {RPCResult::Type::STR, "status", "result of the last run"},
+                            {RPCResult::Type::NUM_TIME, "last_run", "the " + UNIX_EPOCH_TIME + " of the last run, 0 if not run yet"},
+                            {RPCResult::Type::NUM_TIME, "next_run", "the " + UNIX_EPOCH_TIME + " of the next run, 0 for the next scheduler tick"},
+                            {RPCResult::Type::NUM, "small_blind_outputs", "spendable blinded outputs up to maxvalue found by the last run"},
+                            {RPCResult::Type::NUM, "small_anon_outputs", "spendable anon outputs up to maxvalue found by the last run"},
+                            {RPCResult::Type::NUM, "txns", "consolidation transactions sent since the wallet was loaded"},
+                            {RPCResult::Type::NUM, "inputs_consolidated", "outputs spent by them"},
+                            {RPCResult::Type::STR_HEX, "last_txid", /*optional=*/true, "the last consolidation transaction"},
+                        }},
                         {RPCResult::Type::STR_AMOUNT, "watchonly_balance", /*optional=*/true, "the available watchonly balance of the wallet in " + CURRENCY_UNIT},
                         {RPCResult::Type::STR_AMOUNT, "watchonly_staked_balance", /*optional=*/true, "the staked watchonly balance of the wallet in " + CURRENCY_UNIT},
                         {RPCResult::Type::STR_AMOUNT, "watchonly_unconfirmed_balance", /*optional=*/true, "the unconfirmed watchonly balance of the wallet in " + CURRENCY_UNIT},
@@ -71,6 +83,17 @@ static RPCHelpMan getwalletinfo()
                             {RPCResult::Type::NUM, "duration", "elapsed seconds since scan start"},
                             {RPCResult::Type::NUM, "progress", "scanning progress percentage [0.0, 1.0]"},
                         }, /*skip_type_check=*/true},
+                        {RPCResult::Type::OBJ, "load_timings", /*optional=*/true, "milliseconds spent in each phase of loading the wallet",
+                        {
+                            {RPCResult::Type::NUM, "extkeys", "loading extended keys and account key packs"},
+                            {RPCResult::Type::NUM, "stealth", "loading stealth addresses"},
+                            {RPCResult::Type::NUM, "lookahead", "deriving lookahead keys"},
+                            {RPCResult::Type::NUM, "wallet", "loading the base wallet records"},
+                            {RPCResult::Type::NUM, "records_read", "reading transaction records from the database"},
+                            {RPCResult::Type::NUM, "records_decode", "deserializing transaction records"},
+                            {RPCResult::Type::NUM, "records_insert", "adding transaction records to the wallet"},
+                            {RPCResult::Type::NUM, "total", "total load time"},
+                        }},
                         {RPCResult::Type::BOOL, "descriptors", "whether this wallet uses descriptors for scriptPubKey management"},
                         {RPCResult::Type::BOOL, "external_signer", "whether this wallet is configured to use an external signer such as a hardware wallet"},
                     }},
@@ -142,6 +165,23 @@ static RPCHelpMan getwalletinfo()
 
         obj.pushKV("reserve",   ValueFromAmount(pwhd->nReserveBalance));
 
+        const CConsolidationState &cs = pwhd->m_consolidation;
+        if (cs.enabled || cs.num_txns > 0) {
+            UniValue consolidation(UniValue::VOBJ);
+            consolidation.pushKV("enabled", cs.enabled);
+            consolidation.pushKV("status", cs.status);
+            consolidation.pushKV("last_run", cs.last_run);
+            consolidation.pushKV("next_run", cs.next_run);
+            consolidation.pushKV("small_blind_outputs", (uint64_t)cs.small_blind);
+            consolidation.pushKV("small_anon_outputs", (uint64_t)cs.small_anon);
+            consolidation.pushKV("txns", (uint64_t)cs.num_txns);
+            consolidation.pushKV("inputs_consolidated", (uint64_t)cs.num_inputs);
+            if (!cs.last_txid.IsNull()) {
+                consolidation.pushKV("last_txid", cs.last_txid.ToString());
+            }
+            obj.pushKV("consolidation", consolidation);
+        }
+
         obj.pushKV("encryptionstatus", !pwhd->IsCrypted()
             ? "Unencrypted" : pwhd->IsLocked() ? "Locked" : pwhd->fUnlockForStakingOnly ? "Unlocked, staking only" : "Unlocked");
 
@@ -183,6 +223,19 @@ static RPCHelpMan getwalletinfo()
     } else {
         obj.pushKV("scanning", false);
     }
+    if (IsParticlWallet(pwallet.get())) {
+        const CWalletLoadTimings &timings = GetParticlWallet(pwallet.get())->m_load_timings;
+        UniValue load_timings(UniValue::VOBJ);
+        load_timings.pushKV("extkeys", timings.extkeys);
+        load_timings.pushKV("stealth", timings.stealth);
+        load_timings.pushKV("lookahead", timings.lookahead);
+        load_timings.pushKV("wallet", timings.wallet);
+        load_timings.pushKV("records_read", timings.records_read);
+        load_timings.pushKV("records_decode", timings.records_decode);
+        load_timings.pushKV("records_insert", timings.records_insert);
+        load_timings.pushKV("total", timings.total);
+        obj.pushKV("load_timings", load_timings);
+    }
     obj.pushKV("descriptors", pwallet->IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS));
     obj.pushKV("external_signer", pwallet->IsWalletFlagSet(WALLET_FLAG_EXTERNAL_SIGNER));
     return obj;
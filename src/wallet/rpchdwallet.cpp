@@ -41,6 +41,7 @@
 #include <key/mnemonic.h>
 #include <pos/miner.h>
 #include <pos/kernel.h>
+#include <pos/voteindex.h>
 #include <crypto/sha256.h>
 #include <warnings.h>
 #include <shutdown.h>
@@ -63,6 +64,8 @@ void EnsureWalletIsUnlocked(const CHDWallet *pwallet)
 };
 
 static const std::string WALLET_ENDPOINT_BASE = "/wallet/";
+//! Max count of getnewstealthaddress
+static const size_t MAX_NEW_STEALTH_ADDRESSES = 10000;
 
 static inline uint32_t reversePlace(const uint8_t *p)
 {
@@ -1638,6 +1641,7 @@ static UniValue extkeyimportinternal(const JSONRPCRequest &request, bool fGenesi
     std::string sError;
     int64_t nScanFrom = 1;
     int create_extkeys = 0;
+    int discover_accounts = 0;
 
     if (request.params.size() > 1) {
         sPassphrase = request.params[1].get_str();
@@ -1669,6 +1673,7 @@ static UniValue extkeyimportinternal(const JSONRPCRequest &request, bool fGenesi
                 {"lookaheadsize", UniValueType(UniValue::VNUM)},
                 {"stealthv1lookaheadsize", UniValueType(UniValue::VNUM)},
                 {"stealthv2lookaheadsize", UniValueType(UniValue::VNUM)},
+                {"discoveraccounts", UniValueType(UniValue::VNUM)},
             },
             true, true);
 
@@ -1700,6 +1705,12 @@ static UniValue extkeyimportinternal(const JSONRPCRequest &request, bool fGenesi
             }
             pwallet->m_rescan_stealth_v2_lookahead = override_stealthv2lookaheadsize;
         }
+        if (options.exists("discoveraccounts")) {
+            discover_accounts = options["discoveraccounts"].getInt<int>();
+            if (discover_accounts < 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "discoveraccounts must be positive.");
+            }
+        }
     }
     if (request.params.size() > 7) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Unknown parameter '%s'", request.params[6].get_str()));
@@ -1814,8 +1825,34 @@ static UniValue extkeyimportinternal(const JSONRPCRequest &request, bool fGenesi
         }
     }
 
+    size_t num_discovered = 0;
     if (nScanFrom >= 0) {
-        pwallet->RescanFromTime(nScanFrom, reserver, true);
+        // Candidate accounts are scanned together with the default account, another batch
+        // follows only while the last candidate was used.
+        std::vector<CCandidateAccount> candidates;
+        for (;;) {
+            if (discover_accounts > 0) {
+                LOCK(pwallet->cs_wallet);
+                if (0 != (rv = pwallet->ExtKeyAddCandidateAccounts(discover_accounts, candidates))) {
+                    throw JSONRPCError(RPC_WALLET_ERROR, strprintf("ExtKeyAddCandidateAccounts failed, %s.", ExtKeyGetString(rv)));
+                }
+            }
+            pwallet->RescanFromTime(nScanFrom, reserver, true);
+            if (candidates.empty()) {
+                break;
+            }
+            size_t num_kept = 0, num_candidates = candidates.size();
+            {
+                LOCK(pwallet->cs_wallet);
+                if (0 != (rv = pwallet->ExtKeyKeepUsedCandidateAccounts(candidates, num_kept))) {
+                    throw JSONRPCError(RPC_WALLET_ERROR, strprintf("ExtKeyKeepUsedCandidateAccounts failed, %s.", ExtKeyGetString(rv)));
+                }
+            }
+            num_discovered += num_kept;
+            if (num_kept < num_candidates) {
+                break;
+            }
+        }
         pwallet->MarkDirty();
         LOCK(pwallet->cs_wallet);
         pwallet->ReacceptWalletTransactions();
@@ -1849,6 +1886,9 @@ static UniValue extkeyimportinternal(const JSONRPCRequest &request, bool fGenesi
 
     result.pushKV("account_id", sea->GetIDString58());
     result.pushKV("account_label", sea->sLabel);
+    if (discover_accounts > 0) {
+        result.pushKV("discovered_accounts", (int)num_discovered);
+    }
 
     result.pushKV("note", "Please backup your wallet.");
 
@@ -1881,6 +1921,8 @@ static RPCHelpMan extkeyimportmaster()
                             {"lookaheadsize", RPCArg::Type::NUM, RPCArg::Default{(int)DEFAULT_LOOKAHEAD_SIZE}, "Override the defaultlookaheadsize parameter."},
                             {"stealthv1lookaheadsize", RPCArg::Type::NUM, RPCArg::Default{(int)DEFAULT_STEALTH_LOOKAHEAD_SIZE}, "Override the stealthv1lookaheadsize parameter."},
                             {"stealthv2lookaheadsize", RPCArg::Type::NUM, RPCArg::Default{(int)DEFAULT_STEALTH_LOOKAHEAD_SIZE}, "Override the stealthv2lookaheadsize parameter."},
+                            {"discoveraccounts", RPCArg::Type::NUM, RPCArg::Default{0}, "Derive this many accounts after the default account to check in the same rescan.\n"
+        "       Accounts up to the last to receive a transaction are kept, another batch is checked if the last account was used."},
                         },
                         "options"},
                 },
@@ -1925,6 +1967,8 @@ static RPCHelpMan extkeygenesisimport()
                             {"lookaheadsize", RPCArg::Type::NUM, RPCArg::Default{(int)DEFAULT_LOOKAHEAD_SIZE}, "Override the defaultlookaheadsize parameter."},
                             {"stealthv1lookaheadsize", RPCArg::Type::NUM, RPCArg::Default{(int)DEFAULT_STEALTH_LOOKAHEAD_SIZE}, "Override the stealthv1lookaheadsize parameter."},
                             {"stealthv2lookaheadsize", RPCArg::Type::NUM, RPCArg::Default{(int)DEFAULT_STEALTH_LOOKAHEAD_SIZE}, "Override the stealthv2lookaheadsize parameter."},
+                            {"discoveraccounts", RPCArg::Type::NUM, RPCArg::Default{0}, "Derive this many accounts after the default account to check in the same rescan.\n"
+        "       Accounts up to the last to receive a transaction are kept, another batch is checked if the last account was used."},
                         },
                         "options"},
                 },
@@ -2073,12 +2117,21 @@ static RPCHelpMan getnewstealthaddress()
             "           Stealth addresses with prefixes will scan only incoming stealth transactions with a matching prefix."},
                     {"bech32", RPCArg::Type::BOOL, RPCArg::Default{false}, "Use Bech32 encoding."},
                     {"makeV2", RPCArg::Type::BOOL, RPCArg::Default{false}, "Generate an address from the same scheme used for hardware wallets."},
+                    {"count", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, strprintf("Number of addresses to generate, max %d. The keys are derived together and saved in one database transaction.", MAX_NEW_STEALTH_ADDRESSES)},
                 },
-                RPCResult{
-                    RPCResult::Type::STR, "address", "The new stealth address"
+                {
+                    RPCResult{"if count is not set",
+                        RPCResult::Type::STR, "address", "The new stealth address"
+                    },
+                    RPCResult{"if count is set",
+                        RPCResult::Type::ARR, "", "", {
+                            {RPCResult::Type::STR, "address", "The new stealth address"},
+                        }
+                    },
                 },
                 RPCExamples{
             HelpExampleCli("getnewstealthaddress", "\"lblTestSxAddrPrefix\" 3 \"0b101\"") +
+            HelpExampleCli("getnewstealthaddress", "\"\" 0 \"\" true false 100") +
             HelpExampleRpc("getnewstealthaddress", "\"lblTestSxAddrPrefix\", 3, \"0b101\"")
                 },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
@@ -2111,6 +2164,24 @@ static RPCHelpMan getnewstealthaddress()
         throw JSONRPCError(RPC_INVALID_PARAMETER, "bech32 must be true when using makeV2.");
     }
 
+    if (request.params.size() > 5 && !request.params[5].isNull()) {
+        int64_t count = request.params[5].getInt<int64_t>();
+        if (count < 1 || count > (int64_t)MAX_NEW_STEALTH_ADDRESSES) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %d", MAX_NEW_STEALTH_ADDRESSES));
+        }
+        std::vector<CEKAStealthKey> vAkStealth;
+        if (0 != pwallet->NewStealthKeysFromAccount(count, fMakeV2, sLabel, vAkStealth, num_prefix_bits, sPrefix_num.empty() ? nullptr : sPrefix_num.c_str(), fBech32)) {
+            throw JSONRPCError(RPC_WALLET_ERROR, "NewStealthKeysFromAccount failed.");
+        }
+        UniValue addresses(UniValue::VARR);
+        for (const auto &akStealth : vAkStealth) {
+            CStealthAddress sxAddr;
+            akStealth.SetSxAddr(sxAddr);
+            addresses.push_back(sxAddr.ToString(fBech32));
+        }
+        return addresses;
+    }
+
     CEKAStealthKey akStealth;
     std::string sError;
     if (fMakeV2) {
@@ -2511,14 +2582,7 @@ static RPCHelpMan liststealthaddresses()
                     }
                 }
 
-                int num_received = 0;
-                CKeyID idStealthKey = aks.GetID();
-                for (const auto &entry : pa->mapStealthChildKeys) {
-                    if (entry.second.idStealthKey == idStealthKey) {
-                        num_received++;
-                    }
-                }
-                objA.pushKV("received_addresses", num_received);
+                objA.pushKV("received_addresses", (int)pa->NumStealthChildKeys(aks.GetID()));
             }
             objA.pushKV("Address", sxAddr.ToString(show_in_bech32 || is_v2_address));
 
@@ -2955,7 +3019,7 @@ static RPCHelpMan clearwallettransactions()
             throw JSONRPCError(RPC_MISC_ERROR, "TxnBegin failed.");
         }
 
-        Dbc *pcursor = wdb.GetTxnCursor();
+        std::unique_ptr<CHDWalletDBCursor> pcursor = wdb.GetTxnCursor();
         if (!pcursor) {
             throw JSONRPCError(RPC_MISC_ERROR, "GetTxnCursor failed.");
         }
@@ -2967,7 +3031,7 @@ static RPCHelpMan clearwallettransactions()
         uint256 hash;
         uint32_t fFlags = DB_SET_RANGE;
         ssKey << std::string("tx");
-        while (wdb.ReadKeyAtCursor(pcursor, ssKey, fFlags) == 0) {
+        while (wdb.ReadKeyAtCursor(pcursor.get(), ssKey, fFlags) == 0) {
             fFlags = DB_NEXT;
 
             ssKey >> strType;
@@ -2992,8 +3056,8 @@ static RPCHelpMan clearwallettransactions()
             //    throw std::runtime_error("UnloadTransaction failed.");
             pwallet->UnloadTransaction(hash); // ignore failure
 
-            if ((rv = pcursor->del(0)) != 0) {
-                throw JSONRPCError(RPC_MISC_ERROR, "pcursor->del failed.");
+            if ((rv = pcursor->Erase()) != 0) {
+                throw JSONRPCError(RPC_MISC_ERROR, "Cursor erase failed.");
             }
 
             nRemoved++;
@@ -3003,7 +3067,7 @@ static RPCHelpMan clearwallettransactions()
             fFlags = DB_SET_RANGE;
             ssKey.clear();
             ssKey << std::string("rtx");
-            while (wdb.ReadKeyAtCursor(pcursor, ssKey, fFlags) == 0) {
+            while (wdb.ReadKeyAtCursor(pcursor.get(), ssKey, fFlags) == 0) {
                 fFlags = DB_NEXT;
 
                 ssKey >> strType;
@@ -3013,8 +3077,8 @@ static RPCHelpMan clearwallettransactions()
 
                 pwallet->UnloadTransaction(hash); // ignore failure
 
-                if ((rv = pcursor->del(0)) != 0) {
-                    throw JSONRPCError(RPC_MISC_ERROR, "pcursor->del failed.");
+                if ((rv = pcursor->Erase()) != 0) {
+                    throw JSONRPCError(RPC_MISC_ERROR, "Cursor erase failed.");
                 }
 
                 // TODO: Remove CStoredTransaction
@@ -3023,7 +3087,7 @@ static RPCHelpMan clearwallettransactions()
             }
         }
 
-        pcursor->close();
+        pcursor.reset();
         if (!wdb.TxnCommit()) {
             throw JSONRPCError(RPC_MISC_ERROR, "TxnCommit failed.");
         }
@@ -3881,55 +3945,118 @@ static RPCHelpMan filtertransactions()
     // for transactions and records
     UniValue transactions(UniValue::VARR);
 
-    // transaction processing
-    const CHDWallet::TxItems &txOrdered = pwallet->wtxOrdered;
-    CWallet::TxItems::const_reverse_iterator tit = txOrdered.rbegin();
-    if (type == "all" || type == "standard")
-    while (tit != txOrdered.rend()) {
-        CWalletTx *const pwtx = tit->second;
-        int64_t txTime = pwtx->GetTxTime();
-        if (txTime < timeFrom) break;
-        if (txTime <= timeTo)
-            ParseOutputs(
-                transactions,
-                *pwtx,
-                pwallet,
-                watchonly,
-                search,
-                category,
-                fWithReward,
-                fBech32,
-                hide_zero_coinstakes,
-                vTreasuryFundScripts,
-                show_change,
-                show_smsg_fees);
-        tit++;
-    }
-
     int type_i = WordToType(type);
-    // records processing
-    const RtxOrdered_t &rtxOrdered = pwallet->rtxOrdered;
-    RtxOrdered_t::const_reverse_iterator rit = rtxOrdered.rbegin();
-    while (rit != rtxOrdered.rend()) {
-        const uint256 &hash = rit->second->first;
-        const CTransactionRecord &rtx = rit->second->second;
-        int64_t txTime = rtx.GetTxTime();
-        if (txTime < timeFrom) break;
-        if (txTime <= timeTo)
-            ParseRecords(
-                transactions,
-                hash,
-                rtx,
-                pwallet,
-                watchonly,
-                search,
-                category,
-                type_i,
-                show_blinding_factors,
-                show_anon_spends,
-                show_change,
-                show_smsg_fees);
-        rit++;
+    bool include_wtx = type == "all" || type == "standard";
+    if (sort == "time") {
+        // Order by txn time before parsing, only the entries up to the requested page are built
+        struct TimeOrderedTx {
+            int64_t time;
+            CWalletTx *pwtx;
+            const MapRecords_t::value_type *prtx;
+        };
+        std::vector<TimeOrderedTx> ordered;
+        if (include_wtx) {
+            for (const auto &item : pwallet->wtxOrdered) {
+                int64_t txTime = item.second->GetTxTime();
+                if (txTime >= timeFrom && txTime <= timeTo) {
+                    ordered.push_back({txTime, item.second, nullptr});
+                }
+            }
+        }
+        for (const auto &item : pwallet->rtxOrdered) {
+            int64_t txTime = item.second->second.GetTxTime();
+            if (txTime >= timeFrom && txTime <= timeTo) {
+                ordered.push_back({txTime, nullptr, &(*item.second)});
+            }
+        }
+        std::stable_sort(ordered.begin(), ordered.end(), [] (const TimeOrderedTx &a, const TimeOrderedTx &b) -> bool {
+            return a.time > b.time;
+        });
+
+        size_t num_needed = count == 0 ? std::numeric_limits<size_t>::max() : (size_t)skip + count;
+        for (const auto &item : ordered) {
+            if (transactions.size() >= num_needed) {
+                break;
+            }
+            if (item.pwtx) {
+                ParseOutputs(
+                    transactions,
+                    *item.pwtx,
+                    pwallet,
+                    watchonly,
+                    search,
+                    category,
+                    fWithReward,
+                    fBech32,
+                    hide_zero_coinstakes,
+                    vTreasuryFundScripts,
+                    show_change,
+                    show_smsg_fees);
+            } else {
+                ParseRecords(
+                    transactions,
+                    item.prtx->first,
+                    item.prtx->second,
+                    pwallet,
+                    watchonly,
+                    search,
+                    category,
+                    type_i,
+                    show_blinding_factors,
+                    show_anon_spends,
+                    show_change,
+                    show_smsg_fees);
+            }
+        }
+    } else {
+        const CHDWallet::TxItems &txOrdered = pwallet->wtxOrdered;
+        CWallet::TxItems::const_reverse_iterator tit = txOrdered.rbegin();
+        if (include_wtx)
+        while (tit != txOrdered.rend()) {
+            CWalletTx *const pwtx = tit->second;
+            int64_t txTime = pwtx->GetTxTime();
+            if (txTime < timeFrom) break;
+            if (txTime <= timeTo)
+                ParseOutputs(
+                    transactions,
+                    *pwtx,
+                    pwallet,
+                    watchonly,
+                    search,
+                    category,
+                    fWithReward,
+                    fBech32,
+                    hide_zero_coinstakes,
+                    vTreasuryFundScripts,
+                    show_change,
+                    show_smsg_fees);
+            tit++;
+        }
+
+        // records processing
+        const RtxOrdered_t &rtxOrdered = pwallet->rtxOrdered;
+        RtxOrdered_t::const_reverse_iterator rit = rtxOrdered.rbegin();
+        while (rit != rtxOrdered.rend()) {
+            const uint256 &hash = rit->second->first;
+            const CTransactionRecord &rtx = rit->second->second;
+            int64_t txTime = rtx.GetTxTime();
+            if (txTime < timeFrom) break;
+            if (txTime <= timeTo)
+                ParseRecords(
+                    transactions,
+                    hash,
+                    rtx,
+                    pwallet,
+                    watchonly,
+                    search,
+                    category,
+                    type_i,
+                    show_blinding_factors,
+                    show_anon_spends,
+                    show_change,
+                    show_smsg_fees);
+            rit++;
+        }
     }
 
     // Sort
@@ -4001,12 +4128,23 @@ enum SortCodes
 {
     SRT_LABEL_ASC,
     SRT_LABEL_DESC,
+    SRT_BALANCE_DESC,
+    SRT_RECEIVED_DESC,
+    SRT_TXNS_DESC,
+    SRT_LAST_SEEN_DESC,
 };
 
 class AddressComp {
 public:
     int nSortCode;
-    AddressComp(int nSortCode_) : nSortCode(nSortCode_) {}
+    const std::map<CTxDestination, CAddressTotals> &totals;
+    AddressComp(int nSortCode_, const std::map<CTxDestination, CAddressTotals> &totals_) : nSortCode(nSortCode_), totals(totals_) {}
+    const CAddressTotals &GetTotals(const CTxDestination &dest) const
+    {
+        static const CAddressTotals empty;
+        auto mi = totals.find(dest);
+        return mi == totals.end() ? empty : mi->second;
+    }
     bool operator() (
         const std::map<CTxDestination, CAddressBookData>::iterator a,
         const std::map<CTxDestination, CAddressBookData>::iterator b) const
@@ -4015,6 +4153,14 @@ public:
         {
             case SRT_LABEL_DESC:
                 return b->second.GetLabel().compare(a->second.GetLabel()) < 0;
+            case SRT_BALANCE_DESC:
+                return GetTotals(a->first).nBalance > GetTotals(b->first).nBalance;
+            case SRT_RECEIVED_DESC:
+                return GetTotals(a->first).nReceived > GetTotals(b->first).nReceived;
+            case SRT_TXNS_DESC:
+                return GetTotals(a->first).nTxns > GetTotals(b->first).nTxns;
+            case SRT_LAST_SEEN_DESC:
+                return GetTotals(a->first).LastHeight() > GetTotals(b->first).LastHeight();
             default:
                 break;
         };
@@ -4033,10 +4179,12 @@ static RPCHelpMan filteraddresses()
                 {
                     {"offset", RPCArg::Type::NUM, RPCArg::Default{0}, ""},
                     {"count", RPCArg::Type::NUM, RPCArg::Default{0x7FFFFFFF}, "Max no. of addresses to return"},
-                    {"sort_code", RPCArg::Type::NUM, RPCArg::Default{0}, "0: sort by label ascending, 1: sort by label descending."},
+                    {"sort_code", RPCArg::Type::NUM, RPCArg::Default{0}, "0: sort by label ascending, 1: sort by label descending,\n"
+                        "2: balance descending, 3: received descending, 4: txns descending, 5: last seen height descending."},
                     {"match_str", RPCArg::Type::STR, RPCArg::Default{""}, "Filter by label."},
                     {"match_owned", RPCArg::Type::NUM, RPCArg::Default{0}, "0: off, 1: owned, 2: non-owned"},
                     {"show_path", RPCArg::Type::BOOL, RPCArg::Default{true}, ""},
+                    {"show_totals", RPCArg::Type::BOOL, RPCArg::Default{false}, "Show the balance, received, txns and last_seen_height of each address."},
                 },
                 RPCResult{
                     RPCResult::Type::ANY, "", ""
@@ -4100,6 +4248,18 @@ static RPCHelpMan filteraddresses()
         } else
         if (sCode == "1") {
             nSortCode = SRT_LABEL_DESC;
+        } else
+        if (sCode == "2") {
+            nSortCode = SRT_BALANCE_DESC;
+        } else
+        if (sCode == "3") {
+            nSortCode = SRT_RECEIVED_DESC;
+        } else
+        if (sCode == "4") {
+            nSortCode = SRT_TXNS_DESC;
+        } else
+        if (sCode == "5") {
+            nSortCode = SRT_LAST_SEEN_DESC;
         } else {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown sort_code.");
         }
@@ -4126,6 +4286,7 @@ static RPCHelpMan filteraddresses()
     }
 
     int nShowPath = request.params.size() > 5 ? (GetBool(request.params[5]) ? 1 : 0) : 1;
+    bool show_totals = request.params.size() > 6 ? GetBool(request.params[6]) : false;
 
     UniValue result(UniValue::VARR);
     {
@@ -4155,7 +4316,13 @@ static RPCHelpMan filteraddresses()
             vitMapAddressBook.push_back(it);
         }
 
-        std::sort(vitMapAddressBook.begin(), vitMapAddressBook.end(), AddressComp(nSortCode));
+        if (nOffset >= (int)vitMapAddressBook.size()) {
+            return result;
+        }
+        // Kept per address as txns change, only sorted here
+        const std::map<CTxDestination, CAddressTotals> &totals = pwallet->GetAddressTotals();
+        auto vit_end = vitMapAddressBook.begin() + std::min((int64_t)vitMapAddressBook.size(), (int64_t)nOffset + nCount);
+        std::partial_sort(vitMapAddressBook.begin(), vit_end, vitMapAddressBook.end(), AddressComp(nSortCode, totals));
 
         std::map<uint32_t, std::string> mapKeyIndexCache;
         std::vector<std::map<CTxDestination, CAddressBookData>::iterator>::iterator vit;
@@ -4169,6 +4336,15 @@ static RPCHelpMan filteraddresses()
             entry.pushKV("address", address.ToString());
             entry.pushKV("label", item->second.GetLabel());
             entry.pushKV("owned", item->second.nOwned == 1 ? "true" : "false");
+            if (show_totals) {
+                static const CAddressTotals no_totals;
+                auto mi = totals.find(item->first);
+                const CAddressTotals &address_totals = mi == totals.end() ? no_totals : mi->second;
+                entry.pushKV("balance", ValueFromAmount(address_totals.nBalance));
+                entry.pushKV("received", ValueFromAmount(address_totals.nReceived));
+                entry.pushKV("txns", address_totals.nTxns);
+                entry.pushKV("last_seen_height", address_totals.LastHeight());
+            }
 
             if (nShowPath > 0) {
                 if (item->second.vPath.size() > 0) {
@@ -4391,6 +4567,16 @@ static RPCHelpMan manageaddressbook()
     };
 }
 
+static UniValue CacheStatsToJSON(const LRUCacheStats &stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", (uint64_t)stats.entries);
+    obj.pushKV("maxentries", (uint64_t)stats.max_entries);
+    obj.pushKV("hits", stats.hits);
+    obj.pushKV("misses", stats.misses);
+    return obj;
+}
+
 static RPCHelpMan getstakinginfo()
 {
     return RPCHelpMan{"getstakinginfo",
@@ -4418,6 +4604,16 @@ static RPCHelpMan getstakinginfo()
                         {RPCResult::Type::NUM, "netstakeweight", "The current stake weight of the network"},
                         {RPCResult::Type::NUM, "expectedtime", "Estimated time for next stake"},
                         {RPCResult::Type::STR, "cause", /*optional=*/true, "If not staking, possible reason why"},
+                        {RPCResult::Type::OBJ_DYN, "caches", "Node stake caches",
+                        {
+                            {RPCResult::Type::OBJ, "name", "coinstake, stakeseen, smsgfee or smsgdifficulty",
+                            {
+                                {RPCResult::Type::NUM, "entries", "Number of cached entries"},
+                                {RPCResult::Type::NUM, "maxentries", "Maximum number of cached entries"},
+                                {RPCResult::Type::NUM, "hits", "Lookups served from the cache"},
+                                {RPCResult::Type::NUM, "misses", "Lookups not found in the cache"},
+                            }},
+                        }},
                 }},
                 RPCExamples{
             HelpExampleCli("getstakinginfo", "") +
@@ -4526,6 +4722,16 @@ static RPCHelpMan getstakinginfo()
 
     obj.pushKV("expectedtime", nExpectedTime);
 
+    UniValue caches(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        caches.pushKV("coinstake", CacheStatsToJSON(particl::coinStakeCache.m_data.GetStats()));
+        caches.pushKV("smsgfee", CacheStatsToJSON(particl::smsgFeeCoinstakeCache.m_data.GetStats()));
+        caches.pushKV("smsgdifficulty", CacheStatsToJSON(particl::smsgDifficultyCoinstakeCache.m_data.GetStats()));
+    }
+    caches.pushKV("stakeseen", CacheStatsToJSON(WITH_LOCK(particl::cs_stake_seen, return particl::stakeSeenCache.GetStats())));
+    obj.pushKV("caches", caches);
+
     return obj;
 },
     };
@@ -4536,6 +4742,7 @@ static RPCHelpMan getcoldstakinginfo()
     return RPCHelpMan{"getcoldstakinginfo",
                 "\nReturns an object containing coldstaking related information.\n",
                 {
+                    {"show_keys", RPCArg::Type::BOOL, RPCArg::Default{false}, "Include the cold stake outputs summed by stake and spend address."},
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "", {
@@ -4545,9 +4752,27 @@ static RPCHelpMan getcoldstakinginfo()
                         {RPCResult::Type::STR_AMOUNT, "coin_in_coldstakeable_script", "Current amount of coin in scripts stakeable by the wallet with the coldstakingaddress"},
                         {RPCResult::Type::STR_AMOUNT, "percent_in_coldstakeable_script", "Percentage of coin in coldstakeable scripts"},
                         {RPCResult::Type::STR_AMOUNT, "currently_staking", "Amount of coin estimated to be currently staking by this wallet"},
+                        {RPCResult::Type::ARR, "stake_addresses", /*optional=*/true, "If show_keys is set", {
+                            {RPCResult::Type::OBJ, "", "", {
+                                {RPCResult::Type::STR, "address", "The stake address"},
+                                {RPCResult::Type::BOOL, "have_key", "If this wallet holds the stake key"},
+                                {RPCResult::Type::NUM, "num_outputs", "Number of unspent outputs, including untrusted"},
+                                {RPCResult::Type::STR_AMOUNT, "value", "Value of the unspent outputs in trusted txns"},
+                                {RPCResult::Type::STR_AMOUNT, "staking", "Value of the unspent outputs deep enough to stake"},
+                            }},
+                        }},
+                        {RPCResult::Type::ARR, "spend_addresses", /*optional=*/true, "If show_keys is set", {
+                            {RPCResult::Type::OBJ, "", "", {
+                                {RPCResult::Type::STR, "address", "The spend address"},
+                                {RPCResult::Type::NUM, "num_outputs", "Number of unspent outputs, including untrusted"},
+                                {RPCResult::Type::STR_AMOUNT, "value", "Value of the unspent outputs in trusted txns"},
+                                {RPCResult::Type::STR_AMOUNT, "staking", "Value of the unspent outputs deep enough to stake"},
+                            }},
+                        }},
                 }},
                 RPCExamples{
             HelpExampleCli("getcoldstakinginfo", "") +
+            HelpExampleCli("getcoldstakinginfo", "true") +
             "\nAs a JSON-RPC call\n"
             + HelpExampleRpc("getcoldstakinginfo", "")
                 },
@@ -4564,70 +4789,40 @@ static RPCHelpMan getcoldstakinginfo()
     // the user could have gotten from another RPC command prior to now
     pwallet->BlockUntilSyncedToCurrentChain();
 
-    UniValue obj(UniValue::VOBJ);
-
-    std::vector<COutput> vecOutputs;
+    bool show_keys = request.params[0].isNull() ? false : request.params[0].get_bool();
 
-    bool include_unsafe = false;
-    CAmount nMinimumAmount = 0;
-    CAmount nMaximumAmount = MAX_MONEY;
-    CAmount nMinimumSumAmount = MAX_MONEY;
-    uint64_t nMaximumCount = 0;
-    int nHeight, nRequiredDepth;
+    UniValue obj(UniValue::VOBJ);
 
-    {
-        CCoinControl cctl;
-        cctl.m_avoid_address_reuse = false;
-        cctl.m_min_depth = 0;
-        cctl.m_max_depth = 0x7FFFFFFF;
-        cctl.m_include_unsafe_inputs = include_unsafe;
-        cctl.m_include_immature = true;
-        LOCK(pwallet->cs_wallet);
-        nHeight = pwallet->chain().getHeightInt();
-        nRequiredDepth = std::min((int)(Params().GetStakeMinConfirmations()-1), (int)(nHeight / 2));
-        pwallet->AvailableCoins(vecOutputs, &cctl, std::nullopt, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount);
-    }
+    // Totals are kept up to date by the wallet, only the stake keys need to be checked here
+    CStakeScriptTotals coldstake_totals, hot_totals;
+    std::map<CKeyID, CStakeScriptTotals> by_stake_key;
+    std::map<CTxDestination, CStakeScriptTotals> by_spend_key;
+    pwallet->GetStakeScriptTotals(coldstake_totals, hot_totals, &by_stake_key, show_keys ? &by_spend_key : nullptr);
 
     LOCK(pwallet->cs_wallet);
 
-    CAmount nStakeable = 0;
+    CAmount nStakeable = hot_totals.nSafe;
     CAmount nColdStakeable = 0;
-    CAmount nWalletStaking = 0;
-
-    CKeyID keyID;
-    CScript coinstakePath;
-    for (const auto &out : vecOutputs) {
-        const CScript *scriptPubKey = &out.txout.scriptPubKey;
-        CAmount nValue = out.txout.nValue;
-
-        if (scriptPubKey->IsPayToPublicKeyHash() || scriptPubKey->IsPayToPublicKeyHash256()) {
-            if (!out.spendable) {
-                continue;
-            }
-            nStakeable += nValue;
-        } else
-        if (scriptPubKey->IsPayToPublicKeyHash256_CS() || scriptPubKey->IsPayToScriptHash256_CS() || scriptPubKey->IsPayToScriptHash_CS()) {
-            // Show output on both the spending and staking wallets
-            if (!out.spendable) {
-                if (!particl::ExtractStakingKeyID(*scriptPubKey, keyID)
-                    || !pwallet->HaveKey(keyID)) {
-                    continue;
-                }
-            }
-            nColdStakeable += nValue;
+    CAmount nWalletStaking = hot_totals.nStaking;
+
+    UniValue stake_addresses(UniValue::VARR);
+    for (const auto &it : by_stake_key) {
+        // Show output on both the spending and staking wallets
+        bool have_key = !it.first.IsNull() && pwallet->HaveKey(it.first);
+        if (have_key) {
+            nColdStakeable += it.second.nSafe;
+            nWalletStaking += it.second.nStaking;
         } else {
-            continue;
-        }
-
-        if (out.depth < nRequiredDepth) {
-            continue;
-        }
-
-        if (!particl::ExtractStakingKeyID(*scriptPubKey, keyID)) {
-            continue;
+            nColdStakeable += it.second.nSafeSpendable;
         }
-        if (pwallet->HaveKey(keyID)) {
-            nWalletStaking += nValue;
+        if (show_keys) {
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("address", EncodeDestination(PKHash(it.first)));
+            entry.pushKV("have_key", have_key);
+            entry.pushKV("num_outputs", it.second.nOutputs);
+            entry.pushKV("value", ValueFromAmount(it.second.nSafe));
+            entry.pushKV("staking", ValueFromAmount(it.second.nStaking));
+            stake_addresses.push_back(entry);
         }
     }
 
@@ -4664,12 +4859,41 @@ static RPCHelpMan getcoldstakinginfo()
         UniValue(UniValue::VNUM, strprintf("%.2f", nTotal == 0 ? 0.0 : (nColdStakeable * 10000 / nTotal) / 100.0)));
     obj.pushKV("currently_staking", ValueFromAmount(nWalletStaking));
 
+    if (show_keys) {
+        UniValue spend_addresses(UniValue::VARR);
+        for (const auto &it : by_spend_key) {
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("address", EncodeDestination(it.first));
+            entry.pushKV("num_outputs", it.second.nOutputs);
+            entry.pushKV("value", ValueFromAmount(it.second.nSafe));
+            entry.pushKV("staking", ValueFromAmount(it.second.nStaking));
+            spend_addresses.push_back(entry);
+        }
+        obj.pushKV("stake_addresses", stake_addresses);
+        obj.pushKV("spend_addresses", spend_addresses);
+    }
+
     return obj;
 },
     };
 };
 
 
+static OutputOrder ParseOutputOrder(const UniValue &options)
+{
+    if (!options.exists("sort")) {
+        return OutputOrder::NONE;
+    }
+    const std::string &sort = options["sort"].get_str();
+    if (sort == "amount") {
+        return OutputOrder::VALUE_ASC;
+    }
+    if (sort == "amount_desc") {
+        return OutputOrder::VALUE_DESC;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown sort: " + sort);
+}
+
 static RPCHelpMan listunspentanon()
 {
     return RPCHelpMan{"listunspentanon",
@@ -4697,6 +4921,8 @@ static RPCHelpMan listunspentanon()
                             {"frozen", RPCArg::Type::BOOL, RPCArg::Default{false}, "Show frozen outputs only"},
                             {"include_tainted_frozen", RPCArg::Type::BOOL, RPCArg::Default{false}, "Show tainted frozen outputs"},
                             {"show_pubkeys", RPCArg::Type::BOOL, RPCArg::Default{false}, "Show anon output public keys"},
+                            {"check_keyimages", RPCArg::Type::BOOL, RPCArg::Default{false}, "Look up the keyimages of the outputs in the chain and mempool, requires an unlocked wallet"},
+                            {"sort", RPCArg::Type::STR, RPCArg::DefaultHint{"unsorted"}, "\"amount\" or \"amount_desc\", order by value, with maximumCount returns the smallest or largest outputs"},
                         },
                         "query_options"},
                 },
@@ -4711,6 +4937,8 @@ static RPCHelpMan listunspentanon()
                             {RPCResult::Type::STR_AMOUNT, "amount", "the transaction output amount in " + CURRENCY_UNIT},
                             {RPCResult::Type::NUM, "confirmations", "The number of confirmations"},
                             {RPCResult::Type::STR_HEX, "pubkey", /*optional=*/true, "If \"show_pubkeys\""},
+                            {RPCResult::Type::STR, "keyimage_state", /*optional=*/true, "If \"check_keyimages\", \"spent\", \"mempool\" or \"unknown\""},
+                            {RPCResult::Type::STR_HEX, "spent_by", /*optional=*/true, "If \"check_keyimages\", txid found spending the keyimage"},
                             {RPCResult::Type::BOOL, "safe", "Whether this output is considered safe to spend. Unconfirmed transactions\n"
                                                             "from outside keys and unconfirmed replacement transactions are considered unsafe\n"
                                                             "and are not eligible for spending by fundrawtransaction and sendtoaddress."},
@@ -4769,10 +4997,12 @@ static RPCHelpMan listunspentanon()
     bool fCCFormat = false;
     bool fIncludeImmature = false;
     bool show_pubkeys = false;
+    bool check_keyimages = false;
     CAmount nMinimumAmount = 1;
     CAmount nMaximumAmount = MAX_MONEY;
     CAmount nMinimumSumAmount = MAX_MONEY;
     uint64_t nMaximumCount = 0;
+    OutputOrder order = OutputOrder::NONE;
 
     if (!request.params[4].isNull()) {
         const UniValue& options = request.params[4].get_obj();
@@ -4784,6 +5014,8 @@ static RPCHelpMan listunspentanon()
                 {"frozen",                  UniValueType(UniValue::VBOOL)},
                 {"include_tainted_frozen",  UniValueType(UniValue::VBOOL)},
                 {"show_pubkeys",            UniValueType(UniValue::VBOOL)},
+                {"check_keyimages",         UniValueType(UniValue::VBOOL)},
+                {"sort",                    UniValueType(UniValue::VSTR)},
             }, true, false);
 
         if (options.exists("minimumAmount")) {
@@ -4813,6 +5045,10 @@ static RPCHelpMan listunspentanon()
         if (options.exists("show_pubkeys")) {
             show_pubkeys = options["show_pubkeys"].get_bool();
         }
+        if (options.exists("check_keyimages")) {
+            check_keyimages = options["check_keyimages"].get_bool();
+        }
+        order = ParseOutputOrder(options);
     }
 
     // Make sure the results are valid at least up to the most recent block
@@ -4828,14 +5064,32 @@ static RPCHelpMan listunspentanon()
         cctl.m_include_immature = fIncludeImmature;
         cctl.m_include_unsafe_inputs = include_unsafe;
         LOCK(pwallet->cs_wallet);
-        // TODO: filter on stealth address
-        pwallet->AvailableAnonCoins(vecOutputs, &cctl, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount);
+        // Filter before maximumCount is applied
+        OutputFilter filter;
+        if (setAddress.size()) {
+            filter = [&](const uint256 &txid, const COutputRecord &r) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet) {
+                uint32_t sidx;
+                CStealthAddress sx;
+                if (r.vPath.size() < 5 || r.vPath[0] != ORA_STEALTH) {
+                    return false;
+                }
+                memcpy(&sidx, &r.vPath[1], 4);
+                return pwallet->GetStealthByIndex(sidx, sx) && setAddress.count(CBitcoinAddress(CTxDestination(sx)));
+            };
+        }
+        pwallet->AvailableAnonCoins(vecOutputs, &cctl, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount, order, filter);
     }
 
     LOCK(pwallet->cs_wallet);
 
     CHDWalletDB wdb(pwallet->GetDatabase());
 
+    if (check_keyimages) {
+        EnsureWalletIsUnlocked(pwallet);
+    }
+    std::vector<CCmpPubKey> key_images;
+    std::vector<size_t> key_image_entries;
+
     for (const auto &out : vecOutputs)
     {
         if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
@@ -4868,18 +5122,12 @@ static RPCHelpMan listunspentanon()
                     if (i != pwallet->m_address_book.end()) {
                         entry.pushKV("label", i->second.GetLabel());
                     }
-                    if (setAddress.size() && !setAddress.count(CBitcoinAddress(CTxDestination(sx)))) {
-                        continue;
-                    }
                 }
             }
         }
 
         if (!entry.exists("address")) {
             entry.pushKV("address", "unknown");
-            if (setAddress.size()) {
-                continue;
-            }
         }
         if (fCCFormat) {
             entry.pushKV("time", out.rtx->second.GetTxTime());
@@ -4895,22 +5143,53 @@ static RPCHelpMan listunspentanon()
             entry.pushKV("mature", out.fMature);
         }
 
-        if (show_pubkeys) {
+        if (show_pubkeys || check_keyimages) {
             CStoredTransaction stx;
-            CCmpPubKey anon_pubkey;
+            CCmpPubKey anon_pubkey, ki;
+            CKey spend_key;
             if (!wdb.ReadStoredTx(out.txhash, stx)) {
                 entry.pushKV("error", "Missing stored txn.");
             } else
             if (!stx.GetAnonPubkey(out.i, anon_pubkey)) {
                 entry.pushKV("error", "Could not get anon pubkey.");
             } else {
-                entry.pushKV("pubkey", HexStr(anon_pubkey));
+                if (show_pubkeys) {
+                    entry.pushKV("pubkey", HexStr(anon_pubkey));
+                }
+                if (check_keyimages) {
+                    if (!pwallet->GetKey(anon_pubkey.GetID(), spend_key) ||
+                        0 != GetKeyImage(ki, anon_pubkey, spend_key)) {
+                        entry.pushKV("error", "Could not get keyimage.");
+                    } else {
+                        key_images.push_back(ki);
+                        key_image_entries.push_back(results.size());
+                    }
+                }
             }
         }
 
         results.push_back(entry);
     }
 
+    if (key_images.size() > 0) {
+        std::vector<CKeyImageSpend> states;
+        pwallet->chain().checkKeyImages(key_images, states);
+
+        std::vector<UniValue> entries = results.getValues();
+        for (size_t k = 0; k < key_images.size(); ++k) {
+            UniValue &entry = entries[key_image_entries[k]];
+            const CKeyImageSpend &ks = states[k];
+            if (ks.state == CKeyImageSpend::UNKNOWN) {
+                entry.pushKV("keyimage_state", "unknown");
+                continue;
+            }
+            entry.pushKV("keyimage_state", ks.state == CKeyImageSpend::IN_CHAIN ? "spent" : "mempool");
+            entry.pushKV("spent_by", ks.txid.ToString());
+        }
+        results.setArray();
+        results.push_backV(entries);
+    }
+
     return results;
 },
     };
@@ -4941,6 +5220,7 @@ static RPCHelpMan listunspentblind()
                             {"cc_format", RPCArg::Type::BOOL, RPCArg::Default{false}, "Format output for coincontrol"},
                             {"frozen", RPCArg::Type::BOOL, RPCArg::Default{false}, "Show frozen outputs only"},
                             {"include_tainted_frozen", RPCArg::Type::BOOL, RPCArg::Default{false}, "Show tainted frozen outputs"},
+                            {"sort", RPCArg::Type::STR, RPCArg::DefaultHint{"unsorted"}, "\"amount\" or \"amount_desc\", order by value, with maximumCount returns the smallest or largest outputs"},
                         },
                         "query_options"},
                 },
@@ -4999,6 +5279,7 @@ static RPCHelpMan listunspentblind()
     CAmount nMaximumAmount = MAX_MONEY;
     CAmount nMinimumSumAmount = MAX_MONEY;
     uint64_t nMaximumCount = 0;
+    OutputOrder order = OutputOrder::NONE;
 
     if (!request.params[4].isNull()) {
         const UniValue& options = request.params[4].get_obj();
@@ -5009,7 +5290,7 @@ static RPCHelpMan listunspentblind()
                 {"cc_format",               UniValueType(UniValue::VBOOL)},
                 {"frozen",                  UniValueType(UniValue::VBOOL)},
                 {"include_tainted_frozen",  UniValueType(UniValue::VBOOL)},
-
+                {"sort",                    UniValueType(UniValue::VSTR)},
             }, true, false);
 
         if (options.exists("minimumAmount")) {
@@ -5033,6 +5314,7 @@ static RPCHelpMan listunspentblind()
         if (options.exists("include_tainted_frozen")) {
             cctl.m_include_tainted_frozen = options["include_tainted_frozen"].get_bool();
         }
+        order = ParseOutputOrder(options);
     }
 
     std::set<CBitcoinAddress> setAddress;
@@ -5070,7 +5352,24 @@ static RPCHelpMan listunspentblind()
         cctl.m_max_depth = nMaxDepth;
         cctl.m_include_unsafe_inputs = include_unsafe;
         LOCK(pwallet->cs_wallet);
-        pwallet->AvailableBlindedCoins(vecOutputs, &cctl, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount);
+        // Filter before maximumCount is applied, matches the output address or the stealth address it was derived from
+        OutputFilter filter;
+        if (setAddress.size()) {
+            filter = [&](const uint256 &txid, const COutputRecord &r) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet) {
+                CTxDestination dest;
+                if (!ExtractDestination(r.scriptPubKey, dest)) {
+                    return false;
+                }
+                if (setAddress.count(CBitcoinAddress(dest))) {
+                    return true;
+                }
+                CStealthAddress sx;
+                return dest.index() == DI::_PKHash &&
+                       pwallet->GetStealthLinked(ToKeyID(std::get<PKHash>(dest)), sx) &&
+                       setAddress.count(CBitcoinAddress(CTxDestination(sx)));
+            };
+        }
+        pwallet->AvailableBlindedCoins(vecOutputs, &cctl, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount, order, filter);
     }
 
     LOCK(pwallet->cs_wallet);
@@ -5092,8 +5391,6 @@ static RPCHelpMan listunspentblind()
         const CScript *scriptPubKey = &pout->scriptPubKey;
         bool fValidAddress = ExtractDestination(*scriptPubKey, address);
         bool reused = avoid_reuse && pwallet->IsSpentKey(out.txhash, out.i);
-        if (setAddress.size() && (!fValidAddress || !setAddress.count(CBitcoinAddress(address))))
-            continue;
 
         UniValue entry(UniValue::VOBJ);
         entry.pushKV("txid", out.txhash.GetHex());
@@ -5698,7 +5995,48 @@ UniValue SendTypeToInner(const JSONRPCRequest &request)
     JSONRPCRequest req = request;
     req.params.erase(0, 2);
 
-    return SendToInner(req, typeIn, typeOut);
+    size_t max_outputs_per_txn = 0;
+    if (req.params.size() > 6 && req.params[6].isObject() && req.params[6].exists("max_outputs_per_txn")) {
+        int64_t n = req.params[6]["max_outputs_per_txn"].getInt<int64_t>();
+        if (n < 1) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "max_outputs_per_txn must be positive.");
+        }
+        if (req.params[6].exists("inputs")) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "max_outputs_per_txn can't be used with inputs.");
+        }
+        max_outputs_per_txn = n;
+    }
+    if (max_outputs_per_txn == 0 || !req.params[0].isArray() || req.params[0].size() <= max_outputs_per_txn) {
+        return SendToInner(req, typeIn, typeOut);
+    }
+
+    // Build one txn per max_outputs_per_txn outputs, each is committed before the next selects its inputs
+    const UniValue outputs = req.params[0].get_array();
+    UniValue results(UniValue::VARR);
+    std::string committed;
+    for (size_t i = 0; i < outputs.size(); i += max_outputs_per_txn) {
+        UniValue chunk(UniValue::VARR);
+        for (size_t k = i; k < std::min(outputs.size(), i + max_outputs_per_txn); ++k) {
+            chunk.push_back(outputs[k]);
+        }
+        req.params.getValues_nc()[0] = chunk;
+        try {
+            UniValue rv = SendToInner(req, typeIn, typeOut);
+            if (rv.isStr()) {
+                committed += (committed.empty() ? "" : ", ") + rv.get_str();
+            } else
+            if (rv.exists("txid")) {
+                committed += (committed.empty() ? "" : ", ") + rv["txid"].get_str();
+            }
+            results.push_back(rv);
+        } catch (const UniValue &e) {
+            if (committed.empty() || !e.isObject()) {
+                throw;
+            }
+            throw JSONRPCError(e["code"].getInt<int>(), strprintf("%s Already sent: %s.", e["message"].get_str(), committed));
+        }
+    }
+    return results;
 }
 
 static RPCHelpMan sendtypeto()
@@ -5770,6 +6108,8 @@ static RPCHelpMan sendtypeto()
                             {"includeWatching", RPCArg::Type::BOOL, RPCArg::Default{false}, "Also select inputs which are watch only."},
                             {"minimumAmount", RPCArg::Type::AMOUNT, RPCArg::Default{FormatMoney(0)}, "Minimum value of each UTXO to select in " + CURRENCY_UNIT + ""},
                             {"maximumAmount", RPCArg::Type::AMOUNT, RPCArg::DefaultHint{"unlimited"}, "Maximum value of each UTXO to select in " + CURRENCY_UNIT + ""},
+                            {"max_outputs_per_txn", RPCArg::Type::NUM, RPCArg::DefaultHint{"unlimited"}, "Split the outputs into transactions of at most this many outputs, sent one after another.\n"
+                            "                              Returns an array of the results of each transaction. Can't be used with inputs."},
                         },
                     },
                 },
@@ -5786,7 +6126,10 @@ static RPCHelpMan sendtypeto()
                         {RPCResult::Type::OBJ_DYN, "outputs_fee", "", {
                             {RPCResult::Type::STR_AMOUNT, "address", "fee for output"},
                             }},
-                    }}
+                    }},
+                    RPCResult{"If max_outputs_per_txn splits the outputs", RPCResult::Type::ARR, "", "", {
+                        {RPCResult::Type::ELISION, "", "The result of each transaction, as above"},
+                    }},
                 },
                 RPCExamples{
             HelpExampleCli("sendtypeto", "anon part \"[{\\\"address\\\":\\\"PbpVcjgYatnkKgveaeqhkeQBFwjqR7jKBR\\\",\\\"amount\\\":0.1}]\"")
@@ -6817,8 +7160,7 @@ static RPCHelpMan debugwallet()
     if (clear_stakes_seen) {
         LOCK(cs_main);
         particl::mapStakeConflict.clear();
-        particl::mapStakeSeen.clear();
-        particl::listStakeSeen.clear();
+        particl::ClearStakeSeen();
         return "Cleared stakes seen.";
     }
 
@@ -6838,6 +7180,7 @@ static RPCHelpMan debugwallet()
         result.pushKV("mapTxCollapsedSpends_size", (int)pwallet->mapTxCollapsedSpends.size());
         result.pushKV("m_collapsed_txns_size", (int)pwallet->m_collapsed_txns.size());
         result.pushKV("m_collapsed_txn_inputs_size", (int)pwallet->m_collapsed_txn_inputs.size());
+        result.pushKV("m_num_archived_records", (int)pwallet->m_num_archived_records);
         result.pushKV("m_is_only_instance", pwallet->m_is_only_instance);
         result.pushKV("map_ext_accounts_size", (int)pwallet->mapExtAccounts.size());
         result.pushKV("map_ext_keys_size", (int)pwallet->mapExtKeys.size());                    // Includes account keys
@@ -7000,6 +7343,8 @@ static RPCHelpMan debugwallet()
             };
             pwallet->WalletLogPrintf("Checking mapRecord plain values, blinding factors and anon spends.\n");
             CHDWalletDB wdb(pwallet->GetDatabase());
+            std::vector<CCmpPubKey> check_key_images;
+            std::vector<COutPoint> check_outpoints;
             for (const auto &ri : pwallet->mapRecords) {
                 const uint256 &txhash = ri.first;
                 const CTransactionRecord &rtx = ri.second;
@@ -7044,22 +7389,31 @@ static RPCHelpMan debugwallet()
                             add_error("Could not get keyimage.", txhash, r.n);
                             continue;
                         }
-                        CAnonKeyImageInfo ki_data;
-                        bool spent_in_chain = pwallet->chain().readRCTKeyImage(ki, ki_data);
-                        uint256 spent_by;
-                        bool spent_in_wallet = pwallet->GetSpendingTxid(txhash, r.n, spent_by);
-
-                        if (spent_in_chain && !spent_in_wallet) {
-                            add_error("Spent in chain but not wallet.", txhash, r.n);
-                            errors.get(errors.size() - 1).pushKV("spent_by", ki_data.txid.ToString());
-                        } else
-                        if (!spent_in_chain && spent_in_wallet) {
-                            add_error("Spent in wallet but not chain.", txhash, r.n);
-                            errors.get(errors.size() - 1).pushKV("spent_by", spent_by.ToString());
-                        }
+                        check_key_images.push_back(ki);
+                        check_outpoints.emplace_back(txhash, r.n);
                     }
                 }
             }
+
+            // Key images are looked up together after the records are checked
+            std::vector<CKeyImageSpend> states;
+            pwallet->chain().checkKeyImages(check_key_images, states);
+            for (size_t k = 0; k < check_key_images.size(); ++k) {
+                const COutPoint &op = check_outpoints[k];
+                bool spent_in_chain = states[k].state == CKeyImageSpend::IN_CHAIN;
+                uint256 spent_by;
+                bool spent_in_wallet = pwallet->GetSpendingTxid(op.hash, op.n, spent_by);
+
+                if (spent_in_chain && !spent_in_wallet) {
+                    bool known_spend = pwallet->GetKeyImageSpends(check_key_images[k]).count(states[k].txid);
+                    add_error(known_spend ? "Spent in chain by an abandoned or conflicted wallet txn." : "Spent in chain but not wallet.", op.hash, op.n);
+                    errors.get(errors.size() - 1).pushKV("spent_by", states[k].txid.ToString());
+                } else
+                if (!spent_in_chain && spent_in_wallet) {
+                    add_error("Spent in wallet but not chain.", op.hash, op.n);
+                    errors.get(errors.size() - 1).pushKV("spent_by", spent_by.ToString());
+                }
+            }
         }
         if (pwallet->CountColdstakeOutputs() > 0) {
             UniValue jsonSettings;
@@ -7111,6 +7465,20 @@ static RPCHelpMan walletsettings()
                 "{\n"
                 "  \"mode\"                      (int, optional, default=0) Mode, 0 disabled, 1 coinstake only, 2 all txns.\n"
                 "  \"mindepth\"                  (int, optional, default=3) Number of spends before outputs are unloaded.\n"
+                "  \"recorddepth\"               (int, optional, default=0) Unload blinded and anon records with all outputs spent once they and\n"
+                "                                the spending txns have this many confirmations, 0 disabled. Checked on load and every 100 blocks.\n"
+                "}\n"
+                "\"consolidation\" Join small blinded and anon outputs in the background while the wallet feerate is low.\n"
+                "{\n"
+                "  \"enabled\"                   (bool, optional, default=false) Toggle consolidation, checked every 10 minutes.\n"
+                "  \"blind\"                     (bool, optional, default=true) Consolidate blinded outputs.\n"
+                "  \"anon\"                      (bool, optional, default=true) Consolidate anon outputs.\n"
+                "  \"maxvalue\"                  (amount, optional, default=1) Outputs up to this value are joined.\n"
+                "  \"minoutputs\"                (int, optional, default=100) Consolidate a type while it holds more than this many small outputs.\n"
+                "  \"maxinputs\"                 (int, optional, default=32) Outputs spent per txn, anon txns spend at most " + ToString(MAX_ANON_INPUTS) + ".\n"
+                "  \"ringsize\"                  (int, optional, default=" + ToString(DEFAULT_RING_SIZE) + ") Ring size of anon txns.\n"
+                "  \"mindepth\"                  (int, optional, default=10) Only spend outputs with at least this many confirmations.\n"
+                "  \"maxfeerate\"                (amount, optional, default=-consolidatefeerate) Only run while the wallet feerate in " + CURRENCY_UNIT + "/kvB is at most this.\n"
                 "}\n"
                 "\"other\" {\n"
                 "  \"onlyinstance\"              (bool, optional, default=true) Set to false if other wallets spending from the same keys exist.\n"
@@ -7346,6 +7714,32 @@ static RPCHelpMan walletsettings()
                 if (!json["mindepth"].isNum()) {
                     throw JSONRPCError(RPC_INVALID_PARAMETER, "mindepth must be a number.");
                 }
+            } else
+            if (sKey == "recorddepth") {
+                if (!json["recorddepth"].isNum() || json["recorddepth"].getInt<int>() < 0) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "recorddepth must be a non-negative number.");
+                }
+            } else {
+                warnings.push_back("Unknown key " + sKey);
+            }
+        }
+    } else
+    if (sSetting == "consolidation") {
+        for (const auto &sKey : vKeys) {
+            if (sKey == "enabled" || sKey == "blind" || sKey == "anon") {
+                if (!json[sKey].isBool()) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, sKey + " must be boolean.");
+                }
+            } else
+            if (sKey == "minoutputs" || sKey == "maxinputs" || sKey == "ringsize" || sKey == "mindepth") {
+                if (!json[sKey].isNum() || json[sKey].getInt<int>() < 0) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, sKey + " must be a non-negative number.");
+                }
+            } else
+            if (sKey == "maxvalue" || sKey == "maxfeerate") {
+                if (AmountFromValue(json[sKey]) < 0) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, sKey + " can't be negative.");
+                }
             } else {
                 warnings.push_back("Unknown key " + sKey);
             }
@@ -7891,51 +8285,10 @@ static RPCHelpMan tallyvotes()
     int nStartHeight = request.params[1].getInt<int>();
     int nEndHeight = request.params[2].getInt<int>();
 
-    CBlock block;
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-
-    std::map<int, int> mapVotes;
-    std::pair<std::map<int, int>::iterator, bool> ri;
-
-    int nBlocks = 0;
-    CBlockIndex *pindex = chainman.ActiveChain().Tip();
-    if (pindex)
-    do {
-        if (pindex->nHeight < nStartHeight) {
-            break;
-        }
-        if (pindex->nHeight <= nEndHeight) {
-            if (!node::ReadBlockFromDisk(block, pindex, consensusParams)) {
-                continue;
-            }
-
-            if (block.vtx.size() < 1
-                || !block.vtx[0]->IsCoinStake()) {
-                continue;
-            }
-
-            std::vector<uint8_t> &vData = ((CTxOutData*)block.vtx[0]->vpout[0].get())->vData;
-            if (vData.size() < 9 || vData[4] != DO_VOTE) {
-                ri = mapVotes.insert(std::pair<int, int>(0, 1));
-                if (!ri.second) ri.first->second++;
-            } else {
-                uint32_t voteToken;
-                memcpy(&voteToken, &vData[5], 4);
-                voteToken = le32toh(voteToken);
-                int option = 0; // default to abstain
-
-                // count only if related to current issue:
-                if ((int) (voteToken & 0xFFFF) == issue) {
-                    option = (voteToken >> 16) & 0xFFFF;
-                }
-
-                ri = mapVotes.insert(std::pair<int, int>(option, 1));
-                if (!ri.second) ri.first->second++;
-            }
-
-            nBlocks++;
-        }
-    } while ((pindex = pindex->pprev));
+    g_vote_index.Sync(chainman, Params().GetConsensus());
+    VoteIndex::Tally tally = g_vote_index.TallyVotes(issue, nStartHeight, nEndHeight);
+    int nBlocks = tally.blocks_counted;
+    const std::map<int, int> &mapVotes = tally.votes;
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("proposal", issue);
@@ -8382,6 +8735,12 @@ static RPCHelpMan createrawparttransaction()
                 throw JSONRPCError(RPC_WALLET_ERROR, strprintf("AddCTData failed: %s.", sError));
             }
             amount.pushKV("nonce", r.nonce.ToString());
+
+            // fundrawtransactionfrom can take the amount and blind from the cache instead of rewinding
+            CRewoundOutput rewound;
+            rewound.nValue = r.nAmount;
+            rewound.blind = blind;
+            pwallet->CacheRewoundOutput(r.nonce, *txbout->GetPCommitment(), rewound);
         }
 
         if (r.nType != OUTPUT_DATA) {
@@ -8723,11 +9082,21 @@ static RPCHelpMan fundrawtransactionfrom()
             memset(msg, 0, mlen);
             uint64_t amountOut;
             uint256 blind;
+            CRewoundOutput rewound;
             if (txout->GetPRangeproof()->size() < 1000) {
-                if (1 != secp256k1_bulletproof_rangeproof_rewind(secp256k1_ctx_blind, blind_gens,
-                    &amountOut, blindOut, txout->GetPRangeproof()->data(), txout->GetPRangeproof()->size(),
-                    0, txout->GetPCommitment(), &secp256k1_generator_const_h, r.nonce.begin(), nullptr, 0)) {
-                    throw JSONRPCError(RPC_MISC_ERROR, strprintf("secp256k1_bulletproof_rangeproof_rewind failed, output %d.", n));
+                // Repeated calls over the same outputs skip the rewind, the blind is checked against the commitment below
+                if (WITH_LOCK(pwallet->cs_wallet, return pwallet->GetRewoundOutput(r.nonce, *txout->GetPCommitment(), rewound))) {
+                    amountOut = rewound.nValue;
+                    memcpy(blindOut, rewound.blind.begin(), 32);
+                } else {
+                    if (1 != secp256k1_bulletproof_rangeproof_rewind(secp256k1_ctx_blind, blind_gens,
+                        &amountOut, blindOut, txout->GetPRangeproof()->data(), txout->GetPRangeproof()->size(),
+                        0, txout->GetPCommitment(), &secp256k1_generator_const_h, r.nonce.begin(), nullptr, 0)) {
+                        throw JSONRPCError(RPC_MISC_ERROR, strprintf("secp256k1_bulletproof_rangeproof_rewind failed, output %d.", n));
+                    }
+                    rewound.nValue = amountOut;
+                    memcpy(rewound.blind.begin(), blindOut, 32);
+                    WITH_LOCK(pwallet->cs_wallet, pwallet->CacheRewoundOutput(r.nonce, *txout->GetPCommitment(), rewound));
                 }
 
                 ExtractNarration(r.nonce, r.vData, r.sNarration);
@@ -8788,9 +9157,9 @@ static RPCHelpMan fundrawtransactionfrom()
             }
 
             secp256k1_pedersen_commitment commitment;
-            if (!secp256k1_pedersen_commit(secp256k1_ctx_blind,
+            if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind,
                 &commitment, (const uint8_t*)(itb->second.begin()),
-                ita->second, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+                ita->second, blind_precomp_h)) {
                 throw JSONRPCError(RPC_MISC_ERROR, strprintf("secp256k1_pedersen_commit failed, output %d.", i));
             }
 
@@ -8957,9 +9326,9 @@ static RPCHelpMan verifycommitment()
     CAmount nValue = AmountFromValue(request.params[2]);
 
     secp256k1_pedersen_commitment commitment;
-    if (!secp256k1_pedersen_commit(secp256k1_ctx_blind,
+    if (!secp256k1_pedersen_commit_precomp(secp256k1_ctx_blind,
         &commitment, blind.begin(),
-        nValue, &secp256k1_generator_const_h, &secp256k1_generator_const_g)) {
+        nValue, blind_precomp_h)) {
         throw JSONRPCError(RPC_MISC_ERROR, strprintf("secp256k1_pedersen_commit failed."));
     }
 
@@ -9492,6 +9861,8 @@ static bool PruneBlockFile(ChainstateManager &chainman, FILE *fp, bool test_only
     const CChainParams &chainparams = Params();
     CBufferedFile blkdat(fp, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
     uint64_t nRewind = blkdat.GetPos();
+    CMessageHeader::MessageStartChars compressed_start;
+    node::GetCompressedMessageStart(chainparams.MessageStart(), compressed_start);
 
     while (!blkdat.eof()) {
         if (ShutdownRequested()) return false;
@@ -9500,17 +9871,19 @@ static bool PruneBlockFile(ChainstateManager &chainman, FILE *fp, bool test_only
         nRewind++; // start one byte further next time, in case of failure
         blkdat.SetLimit(); // remove former limit
         unsigned int nSize = 0;
+        bool compressed = false;
         try {
             // locate a header
             unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
             blkdat.FindByte(chainparams.MessageStart()[0]);
             nRewind = blkdat.GetPos()+1;
             blkdat >> buf;
-            if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+            compressed = !memcmp(buf, compressed_start, CMessageHeader::MESSAGE_START_SIZE);
+            if (!compressed && memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
                 continue;
             // read size
             blkdat >> nSize;
-            if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            if (nSize < (compressed ? 5 : 80) || nSize > MAX_BLOCK_SERIALIZED_SIZE)
                 continue;
         } catch (const std::exception&) {
             // no valid block header found; don't complain
@@ -9523,7 +9896,19 @@ static bool PruneBlockFile(ChainstateManager &chainman, FILE *fp, bool test_only
             blkdat.SetPos(nBlockPos);
             std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
             CBlock& block = *pblock;
-            blkdat >> block;
+            std::vector<uint8_t> payload;
+            if (compressed) {
+                // Compressed records are copied as they are
+                std::vector<uint8_t> data;
+                payload.resize(nSize);
+                blkdat.read(MakeWritableByteSpan(payload));
+                if (!node::DecompressRecord(payload, data)) {
+                    continue;
+                }
+                CDataStream{data, SER_DISK, CLIENT_VERSION} >> block;
+            } else {
+                blkdat >> block;
+            }
             uint256 blockhash = block.GetHash();
             nRewind = blkdat.GetPos();
 
@@ -9534,8 +9919,13 @@ static bool PruneBlockFile(ChainstateManager &chainman, FILE *fp, bool test_only
                 num_blocks_removed++;
             } else
             if (!test_only) {
-                fileout << chainparams.MessageStart() << nSize;
-                fileout << block;
+                if (compressed) {
+                    fileout << compressed_start << nSize;
+                    fileout.write(MakeByteSpan(payload));
+                } else {
+                    fileout << chainparams.MessageStart() << nSize;
+                    fileout << block;
+                }
             }
         } catch (const std::exception& e) {
             return error("%s: Deserialize or I/O error - %s\n", __func__, e.what());
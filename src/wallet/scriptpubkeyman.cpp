@@ -826,6 +826,7 @@ bool LegacyScriptPubKeyMan::AddKeyPubKeyWithDB(WalletBatch& batch, const CKey& s
         return false;
     }
     if (needsDB) encrypted_batch = nullptr;
+    m_storage.KeyStoreChanged();
 
     // check if we need to remove from watch-only
     CScript script;
@@ -998,6 +999,7 @@ bool LegacyScriptPubKeyMan::AddWatchOnlyWithDB(WalletBatch &batch, const CScript
 {
     if (!AddWatchOnlyInMem(dest))
         return false;
+    m_storage.KeyStoreChanged();
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -1670,6 +1672,7 @@ bool LegacyScriptPubKeyMan::AddCScriptWithDB(WalletBatch& batch, const CScript&
 {
     if (!FillableSigningProvider::AddCScript(redeemScript))
         return false;
+    m_storage.KeyStoreChanged();
     if (batch.WriteCScript(Hash160(redeemScript), redeemScript)) {
         m_storage.UnsetBlankWalletFlag(batch);
         return true;
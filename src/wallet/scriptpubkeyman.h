@@ -51,6 +51,8 @@ public:
     virtual bool GetKey(const CKeyID &address, CKey &keyOut) const = 0;
     virtual bool GetPubKey(const CKeyID &address, CPubKey &pkOut) const = 0;
     virtual bool GetKeyFromPool(CPubKey &key, bool internal = false) = 0;
+    //! Called after a key, script or watch-only script is added
+    virtual void KeyStoreChanged() = 0;
 };
 
 //! Default for -keypool
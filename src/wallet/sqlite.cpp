@@ -126,6 +126,8 @@ void SQLiteBatch::SetupSQLStatements()
         {&m_overwrite_stmt, "INSERT or REPLACE into main values(?, ?)"},
         {&m_delete_stmt, "DELETE FROM main WHERE key = ?"},
         {&m_cursor_stmt, "SELECT key, value FROM main"},
+        {&m_range_stmt, "SELECT key, value FROM main WHERE key >= ? ORDER BY key LIMIT 1"},
+        {&m_range_after_stmt, "SELECT key, value FROM main WHERE key > ? ORDER BY key LIMIT 1"},
     };
 
     for (const auto& [stmt_prepared, stmt_text] : statements) {
@@ -375,6 +377,8 @@ void SQLiteBatch::Close()
         {&m_overwrite_stmt, "overwrite"},
         {&m_delete_stmt, "delete"},
         {&m_cursor_stmt, "cursor"},
+        {&m_range_stmt, "range"},
+        {&m_range_after_stmt, "range after"},
     };
 
     for (const auto& [stmt_prepared, stmt_description] : statements) {
@@ -512,6 +516,59 @@ void SQLiteBatch::CloseCursor()
     m_cursor_init = false;
 }
 
+bool SQLiteBatch::HasActiveTxn()
+{
+    return m_database.m_db && sqlite3_get_autocommit(m_database.m_db) == 0;
+}
+
+bool SQLiteBatch::ReadAtOrAfter(CDataStream& key, CDataStream& value, bool after, bool& complete)
+{
+    complete = false;
+    if (!m_database.m_db) return false;
+    sqlite3_stmt* stmt = after ? m_range_after_stmt : m_range_stmt;
+    assert(stmt);
+
+    // Bind: leftmost parameter in statement is index 1
+    // An empty key must be bound as a zero length blob, a nullptr would bind NULL
+    if (key.empty()) {
+        int res = sqlite3_bind_zeroblob(stmt, 1, 0);
+        if (res != SQLITE_OK) {
+            LogPrintf("%s: Unable to bind key to statement: %s\n", __func__, sqlite3_errstr(res));
+            sqlite3_reset(stmt);
+            return false;
+        }
+    } else
+    if (!BindBlobToStatement(stmt, 1, key, "key")) {
+        return false;
+    }
+    int res = sqlite3_step(stmt);
+    if (res != SQLITE_ROW) {
+        sqlite3_clear_bindings(stmt);
+        sqlite3_reset(stmt);
+        if (res == SQLITE_DONE) {
+            complete = true;
+            return true;
+        }
+        LogPrintf("%s: Unable to execute statement: %s\n", __func__, sqlite3_errstr(res));
+        return false;
+    }
+
+    // Leftmost column in result is index 0, key is bound to the statement until reset
+    CDataStream key_found(SER_DISK, CLIENT_VERSION);
+    const std::byte* key_data{AsBytePtr(sqlite3_column_blob(stmt, 0))};
+    size_t key_data_size(sqlite3_column_bytes(stmt, 0));
+    key_found.write({key_data, key_data_size});
+    const std::byte* value_data{AsBytePtr(sqlite3_column_blob(stmt, 1))};
+    size_t value_data_size(sqlite3_column_bytes(stmt, 1));
+    value.clear();
+    value.write({value_data, value_data_size});
+
+    sqlite3_clear_bindings(stmt);
+    sqlite3_reset(stmt);
+    key = std::move(key_found);
+    return true;
+}
+
 bool SQLiteBatch::TxnBegin()
 {
     if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) == 0) return false;
@@ -27,6 +27,8 @@ private:
     sqlite3_stmt* m_overwrite_stmt{nullptr};
     sqlite3_stmt* m_delete_stmt{nullptr};
     sqlite3_stmt* m_cursor_stmt{nullptr};
+    sqlite3_stmt* m_range_stmt{nullptr};
+    sqlite3_stmt* m_range_after_stmt{nullptr};
 
     void SetupSQLStatements();
 
@@ -50,6 +52,11 @@ public:
     bool TxnBegin() override;
     bool TxnCommit() override;
     bool TxnAbort() override;
+
+    bool HasActiveTxn();
+    /** Read the first record with a key >= key, or > key if after is set, key is replaced with the key found.
+     *  Keys compare as memcmp, as in BDB, so this can stand in for a DB_SET_RANGE cursor. */
+    bool ReadAtOrAfter(CDataStream& key, CDataStream& value, bool after, bool& complete);
 };
 
 /** An instance of this class represents one SQLite3 database.
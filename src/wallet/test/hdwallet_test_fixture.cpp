@@ -41,8 +41,7 @@ HDWalletTestingSetup::~HDWalletTestingSetup()
     pwalletMain->Finalise();
     pwalletMain.reset();
 
-    particl::mapStakeSeen.clear();
-    particl::listStakeSeen.clear();
+    particl::ClearStakeSeen();
 
     ECC_Stop_Stealth();
     ECC_Stop_Blinding();
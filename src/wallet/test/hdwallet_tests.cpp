@@ -244,6 +244,42 @@ void makeNewStealthKey(CStealthAddress &sxAddr, FillableSigningProvider &keystor
     keystore.AddKeyPubKey(spend_secret, pkTemp);
 }
 
+BOOST_AUTO_TEST_CASE(ismine_cache)
+{
+    CHDWallet *pwallet = pwalletMain.get();
+
+    CKey key;
+    key.MakeNewKey(true);
+    CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
+    CTxOutStandard txout(1 * COIN, script);
+
+    auto is_mine_hd = [&]() {
+        CKeyID keyID;
+        const CEKAKey *pak = nullptr;
+        const CEKASCKey *pasc = nullptr;
+        CExtKeyAccount *pa = nullptr;
+        bool isInvalid = false;
+        return pwallet->IsMine(script, keyID, pak, pasc, pa, isInvalid);
+    };
+
+    {
+        LOCK(pwallet->cs_wallet);
+        BOOST_CHECK(is_mine_hd() == ISMINE_NO);
+        BOOST_CHECK(pwallet->IsMine(&txout) == ISMINE_NO);
+        // Cached
+        BOOST_CHECK(is_mine_hd() == ISMINE_NO);
+        BOOST_CHECK(pwallet->IsMine(&txout) == ISMINE_NO);
+    }
+
+    // Adding the key must invalidate the cached results
+    AddKey(*pwallet, key);
+    {
+        LOCK(pwallet->cs_wallet);
+        BOOST_CHECK(is_mine_hd() == ISMINE_SPENDABLE);
+        BOOST_CHECK(pwallet->IsMine(&txout) == ISMINE_SPENDABLE);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ext_key_index)
 {
     CHDWallet *pwallet = pwalletMain.get();
@@ -623,5 +659,38 @@ BOOST_AUTO_TEST_CASE(opiscoinstake_test)
     BOOST_CHECK(script_h256.IsPayToScriptHash256_CS());
 }
 
+BOOST_AUTO_TEST_CASE(stored_tx_compact)
+{
+    CMutableTransaction txn;
+    txn.nVersion = PARTICL_TXN_VERSION;
+    txn.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>());
+    txn.vpout.push_back(MAKE_OUTPUT<CTxOutCT>());
+    txn.vpout.back()->GetPRangeproof()->resize(700, 0x01);
+    txn.vpout.push_back(MAKE_OUTPUT<CTxOutRingCT>());
+    txn.vpout.back()->GetPRangeproof()->resize(700, 0x02);
+
+    CStoredTransaction stx;
+    stx.tx = MakeTransactionRef(txn);
+    BOOST_CHECK(!stx.IsCompact());
+    CTransactionRef tx_full = stx.tx;
+
+    stx.Compact();
+    BOOST_CHECK(stx.IsCompact());
+    BOOST_CHECK(stx.tx->GetHash() == tx_full->GetHash());
+    BOOST_CHECK(stx.tx->GetWitnessHash() != tx_full->GetWitnessHash());
+    BOOST_CHECK(stx.tx->vpout[1]->GetPRangeproof()->empty());
+    BOOST_CHECK(stx.tx->vpout[2]->GetPRangeproof()->empty());
+    // The outputs of the full txn are untouched
+    BOOST_CHECK(tx_full->vpout[1]->GetPRangeproof()->size() == 700);
+
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << stx;
+    BOOST_CHECK(ss.size() < ::GetSerializeSize(*tx_full, PROTOCOL_VERSION));
+    CStoredTransaction stx_read;
+    ss >> stx_read;
+    BOOST_CHECK(stx_read.IsCompact());
+    BOOST_CHECK(stx_read.tx->GetHash() == tx_full->GetHash());
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -28,6 +28,10 @@
 
 #include <secp256k1_mlsag.h>
 
+#if defined(HAVE_CONSENSUS_LIB)
+#include <script/particlconsensus.h>
+#endif
+
 #include <chrono>
 #include <thread>
 
@@ -134,6 +138,42 @@ BOOST_AUTO_TEST_CASE(rct_test)
     BOOST_REQUIRE(Consensus::CheckTxInputs(*wtx.tx, state, view, nSpendHeight, txfee));
     BOOST_REQUIRE(VerifyMLSAG(*wtx.tx, state));
 
+#if defined(HAVE_CONSENSUS_LIB)
+    {
+    // Verify through libparticlconsensus with the ring members read here
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << *wtx.tx;
+    std::vector<uint8_t> ring_pubkeys, ring_commitments;
+    for (const auto &txin : wtx.tx->vin) {
+        uint32_t n_inputs, ring_size;
+        txin.GetAnonInfo(n_inputs, ring_size);
+        const std::vector<uint8_t> &vMI = txin.scriptWitness.stack[0];
+        size_t ofs = 0, nb = 0;
+        for (size_t k = 0; k < n_inputs * ring_size; ++k) {
+            uint64_t anon_index;
+            BOOST_REQUIRE(0 == part::GetVarInt(vMI, ofs, anon_index, nb));
+            ofs += nb;
+            CAnonOutput ao;
+            BOOST_REQUIRE(m_node.chainman->m_blockman.m_block_tree_db->ReadRCTOutput(anon_index, ao));
+            ring_pubkeys.insert(ring_pubkeys.end(), ao.pubkey.begin(), ao.pubkey.end());
+            ring_commitments.insert(ring_commitments.end(), ao.commitment.data, ao.commitment.data + 33);
+        }
+    }
+    const unsigned int n_members = ring_pubkeys.size() / 33;
+    auto run_inline = [](void*, bitcoinconsensus_task task, void* task_data) { task(task_data); };
+    bitcoinconsensus_error err;
+    BOOST_CHECK(bitcoinconsensus_verify_mlsag(UCharCast(ss.data()), ss.size(), ring_pubkeys.data(), ring_commitments.data(), n_members, nullptr, nullptr, &err) == 1);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+    BOOST_CHECK(bitcoinconsensus_verify_mlsag(UCharCast(ss.data()), ss.size(), ring_pubkeys.data(), ring_commitments.data(), n_members, run_inline, nullptr, &err) == 1);
+    BOOST_CHECK(bitcoinconsensus_verify_mlsag(UCharCast(ss.data()), ss.size(), ring_pubkeys.data(), ring_commitments.data(), n_members - 1, nullptr, nullptr, &err) == 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_RING_MEMBERS);
+    std::swap_ranges(ring_pubkeys.begin(), ring_pubkeys.begin() + 33, ring_pubkeys.end() - 33);
+    BOOST_CHECK(bitcoinconsensus_verify_mlsag(UCharCast(ss.data()), ss.size(), ring_pubkeys.data(), ring_commitments.data(), n_members, run_inline, nullptr, &err) == 0);
+    BOOST_CHECK(bitcoinconsensus_verify_rangeproofs(UCharCast(ss.data()), ss.size(), run_inline, nullptr, &err) == 1);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+    }
+#endif
+
     // Rewrite input matrix to add duplicate index
     CMutableTransaction mtx(*wtx.tx);
     CTxIn &txin = mtx.vin[0];
@@ -425,6 +425,31 @@ BOOST_AUTO_TEST_CASE(LoadReceiveRequests)
     BOOST_CHECK_EQUAL(values[1], "val_rr1");
 }
 
+BOOST_AUTO_TEST_CASE(CoalescedTransactionChanges)
+{
+    const uint256 h1{uint256S("01")}, h2{uint256S("02")};
+    std::vector<std::vector<std::pair<uint256, ChangeType>>> received;
+    boost::signals2::scoped_connection conn = m_wallet.NotifyTransactionsChanged.connect(
+        [&](const std::vector<std::pair<uint256, ChangeType>>& changes) { received.push_back(changes); });
+
+    m_wallet.BeginTransactionChanges();
+    m_wallet.NotifyTransactionChanged(h1, CT_NEW);
+    m_wallet.NotifyTransactionChanged(h1, CT_UPDATED);
+    m_wallet.NotifyTransactionChanged(h2, CT_UPDATED);
+    BOOST_CHECK(received.empty());
+    m_wallet.EndTransactionChanges();
+    BOOST_REQUIRE_EQUAL(received.size(), 1U);
+    BOOST_REQUIRE_EQUAL(received[0].size(), 2U);
+    BOOST_CHECK(received[0][0] == std::make_pair(h1, CT_NEW));
+    BOOST_CHECK(received[0][1] == std::make_pair(h2, CT_UPDATED));
+
+    // Changes outside a batch are sent alone
+    m_wallet.NotifyTransactionChanged(h2, CT_DELETED);
+    BOOST_REQUIRE_EQUAL(received.size(), 2U);
+    BOOST_REQUIRE_EQUAL(received[1].size(), 1U);
+    BOOST_CHECK(received[1][0] == std::make_pair(h2, CT_DELETED));
+}
+
 // Test some watch-only LegacyScriptPubKeyMan methods by the procedure of loading (LoadWatchOnly),
 // checking (HaveWatchOnly), getting (GetWatchPubKey) and removing (RemoveWatchOnly) a
 // given PubKey, resp. its corresponding P2PK Script. Results of the impact on
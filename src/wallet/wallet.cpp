@@ -42,6 +42,8 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <deque>
+#include <future>
 #include <optional>
 
 #include <wallet/hdwallet.h>
@@ -874,6 +876,7 @@ void CWallet::MarkDirty()
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
     }
+    ClearCachedBalances();
 }
 
 bool CWallet::MarkReplaced(const uint256& originalHash, const uint256& newHash)
@@ -1016,6 +1019,10 @@ CWalletTx* CWallet::AddToWallet(CTransactionRef tx, const TxState& state, const
         }
     }
 
+    if (wtx.isUnconfirmed()) {
+        m_unconfirmed_txids.insert(hash);
+    }
+
     //// debug print
     WalletLogPrintf("AddToWallet %s  %s%s\n", hash.ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -1059,7 +1066,7 @@ CWalletTx* CWallet::AddToWallet(CTransactionRef tx, const TxState& state, const
 
     std::string sName = GetName();
     GetMainSignals().TransactionAddedToWallet(sName, wtx.tx);
-    ClearCachedBalances();
+    ClearCachedBalances(*wtx.tx);
 
     return &wtx;
 }
@@ -1095,6 +1102,9 @@ bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx
     if (/* insertion took place */ ins.second) {
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
     }
+    if (wtx.isUnconfirmed()) {
+        m_unconfirmed_txids.insert(hash);
+    }
     AddToSpends(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
@@ -1318,7 +1328,7 @@ void CWallet::transactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRe
         RefreshMempoolStatus(it->second, chain());
     }
 
-    ClearCachedBalances();
+    ClearCachedBalances(*tx);
 
     // Handle transactions that were removed from the mempool because they
     // conflict with transactions in a newly connected block.
@@ -1358,11 +1368,13 @@ void CWallet::blockConnected(const CBlock& block, int height)
 
     m_last_block_processed_height = height;
     m_last_block_processed = block_hash;
+    BeginTransactionChanges();
     for (size_t index = 0; index < block.vtx.size(); index++) {
         SyncTransaction(block.vtx[index], TxStateConfirmed{block_hash, height, static_cast<int>(index)});
         transactionRemovedFromMempool(block.vtx[index], MemPoolRemovalReason::BLOCK, 0 /* mempool_sequence */);
+        ClearCachedBalances(*block.vtx[index]);
     }
-    ClearCachedBalances();
+    EndTransactionChanges();
 }
 
 void CWallet::blockDisconnected(const CBlock& block, int height)
@@ -1375,12 +1387,65 @@ void CWallet::blockDisconnected(const CBlock& block, int height)
     // future with a stickier abandoned state or even removing abandontransaction call.
     m_last_block_processed_height = height - 1;
     m_last_block_processed = block.hashPrevBlock;
+    BeginTransactionChanges();
     for (const CTransactionRef& ptx : block.vtx) {
         SyncTransaction(ptx, TxStateInactive{});
     }
+    EndTransactionChanges();
     ClearCachedBalances();
 }
 
+void CWallet::QueueTransactionChange(const uint256& hash, ChangeType status)
+{
+    {
+        LOCK(m_tx_changes_mutex);
+        if (m_tx_changes_depth > 0) {
+            auto it = m_tx_changes_pos.find(hash);
+            if (it == m_tx_changes_pos.end()) {
+                m_tx_changes_pos.emplace(hash, m_tx_changes.size());
+                m_tx_changes.emplace_back(hash, status);
+            } else
+            if (!(m_tx_changes[it->second].second == CT_NEW && status == CT_UPDATED)) {
+                // A txn added and then updated in the same batch is still new
+                m_tx_changes[it->second].second = status;
+            }
+            return;
+        }
+    }
+    NotifyTransactionsChanged({{hash, status}});
+}
+
+void CWallet::BeginTransactionChanges()
+{
+    LOCK(m_tx_changes_mutex);
+    m_tx_changes_depth++;
+}
+
+void CWallet::EndTransactionChanges()
+{
+    {
+        LOCK(m_tx_changes_mutex);
+        assert(m_tx_changes_depth > 0);
+        if (--m_tx_changes_depth > 0) {
+            return;
+        }
+    }
+    FlushTransactionChanges();
+}
+
+void CWallet::FlushTransactionChanges()
+{
+    std::vector<std::pair<uint256, ChangeType>> changes;
+    {
+        LOCK(m_tx_changes_mutex);
+        changes.swap(m_tx_changes);
+        m_tx_changes_pos.clear();
+    }
+    if (!changes.empty()) {
+        NotifyTransactionsChanged(changes);
+    }
+}
+
 void CWallet::updatedBlockTip()
 {
     m_best_block_time = GetTime();
@@ -1763,23 +1828,57 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
     double progress_end = chain().guessVerificationProgress(end_hash);
     double progress_current = progress_begin;
     int block_height = start_height;
+
+    // Blocks read ahead of block_hash, prepared while earlier blocks are scanned
+    std::deque<std::pair<uint256, std::future<CBlock>>> prefetched;
+    auto prefetch_block = [&](const uint256& hash) {
+        prefetched.emplace_back(hash, std::async(std::launch::async, [this, hash] {
+            CBlock block;
+            chain().findBlock(hash, FoundBlock().data(block));
+            if (!block.IsNull()) {
+                PrepareRescanBlock(block);
+            }
+            return block;
+        }));
+    };
+
+    BeginTransactionChanges();
     while (!fAbortRescan && !chain().shutdownRequested()) {
         if (progress_end - progress_begin > 0.0) {
             m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
         } else { // avoid divide-by-zero for single block scan range (i.e. start and stop hashes are equal)
             m_scanning_progress = 0;
         }
+        if (block_height % 100 == 0) {
+            // Send the changes of the rescan in chunks of 100 blocks
+            FlushTransactionChanges();
+        }
         if (block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
             ShowProgress(strprintf("%s " + _("Rescanning…").translated, GetDisplayName()), std::max(1, std::min(99, (int)(m_scanning_progress * 100))));
         }
         if (Clock::now() >= current_time + LOG_INTERVAL) {
             current_time = Clock::now();
             WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", block_height, progress_current);
+            if (result.last_scanned_height) {
+                SaveRescanProgress(result.last_scanned_block, *result.last_scanned_height);
+            }
         }
 
+        // Blocks ruled out by the wallet's block filter are not read
+        const std::optional<bool> filter_match = RescanFilterMatchesBlock(block_hash);
+        const bool fetch_block = !filter_match || *filter_match;
+
         // Read block data
         CBlock block;
-        chain().findBlock(block_hash, FoundBlock().data(block));
+        if (!fetch_block) {
+            prefetched.clear();
+        } else if (!prefetched.empty() && prefetched.front().first == block_hash) {
+            block = prefetched.front().second.get();
+            prefetched.pop_front();
+        } else {
+            prefetched.clear();
+            chain().findBlock(block_hash, FoundBlock().data(block));
+        }
 
         // Find next block separately from reading data above, because reading
         // is slow and there might be a reorg while it is read.
@@ -1788,7 +1887,32 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         uint256 next_block_hash;
         chain().findBlock(block_hash, FoundBlock().inActiveChain(block_still_active).nextBlock(FoundBlock().inActiveChain(next_block).hash(next_block_hash)));
 
-        if (!block.IsNull()) {
+        if (m_rescan_prefetch_blocks > 0 && !filter_match && next_block && (!max_height || block_height < *max_height)) {
+            if (prefetched.empty() || prefetched.front().first != next_block_hash) {
+                prefetched.clear();
+                prefetch_block(next_block_hash);
+            }
+            while ((int)prefetched.size() < m_rescan_prefetch_blocks &&
+                   (!max_height || block_height + (int)prefetched.size() < *max_height)) {
+                bool have_next = false;
+                uint256 hash;
+                chain().findBlock(prefetched.back().first, FoundBlock().nextBlock(FoundBlock().inActiveChain(have_next).hash(hash)));
+                if (!have_next) {
+                    break;
+                }
+                prefetch_block(hash);
+            }
+        }
+
+        if (!fetch_block) {
+            if (!block_still_active) {
+                result.last_failed_block = block_hash;
+                result.status = ScanResult::FAILURE;
+                break;
+            }
+            result.last_scanned_block = block_hash;
+            result.last_scanned_height = block_height;
+        } else if (!block.IsNull()) {
             LOCK(cs_wallet);
             if (!block_still_active) {
                 // Abort scan if current block is no longer active, to prevent
@@ -1797,9 +1921,11 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                 result.status = ScanResult::FAILURE;
                 break;
             }
+            BeginBlockWrites();
             for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
                 SyncTransaction(block.vtx[posInBlock], TxStateConfirmed{block_hash, block_height, static_cast<int>(posInBlock)}, fUpdate, /*rescanning_old_block=*/true);
             }
+            CommitBlockWrites();
             // scan succeeded, record block as most recent successfully scanned
             result.last_scanned_block = block_hash;
             result.last_scanned_height = block_height;
@@ -1832,7 +1958,11 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             }
         }
     }
+    EndTransactionChanges();
     ShowProgress(strprintf("%s " + _("Rescanning…").translated, GetDisplayName()), 100); // hide progress dialog in GUI
+    if (block_height && (fAbortRescan || chain().shutdownRequested()) && result.last_scanned_height) {
+        SaveRescanProgress(result.last_scanned_block, *result.last_scanned_height);
+    }
     if (block_height && fAbortRescan) {
         WalletLogPrintf("Rescan aborted at block %d. Progress=%f\n", block_height, progress_current);
         result.status = ScanResult::USER_ABORT;
@@ -1929,9 +2059,14 @@ std::vector<uint256> CWallet::ResendWalletTransactionsBefore(int64_t nTime)
 
     // Sort them in chronological order
     std::multimap<unsigned int, CWalletTx*> mapSorted;
-    for (std::pair<const uint256, CWalletTx>& item : mapWallet)
-    {
-        CWalletTx& wtx = item.second;
+    for (auto it = m_unconfirmed_txids.begin(); it != m_unconfirmed_txids.end();) {
+        auto mi = mapWallet.find(*it);
+        if (mi == mapWallet.end() || !mi->second.isUnconfirmed()) {
+            it = m_unconfirmed_txids.erase(it);
+            continue;
+        }
+        ++it;
+        CWalletTx& wtx = mi->second;
         // Don't rebroadcast if newer than nTime:
         if (wtx.nTimeReceived > nTime)
             continue;
@@ -1977,15 +2112,9 @@ void CWallet::ResendWalletTransactions()
         LOCK(cs_wallet);
 
         // Relay transactions
-        for (std::pair<const uint256, CWalletTx>& item : mapWallet) {
-            CWalletTx& wtx = item.second;
-            // Attempt to rebroadcast all txes more than 5 minutes older than
-            // the last block. SubmitTxMemoryPoolAndRelay() will not rebroadcast
-            // any confirmed or conflicting txs.
-            if (wtx.nTimeReceived > m_best_block_time - 5 * 60) continue;
-            std::string unused_err_string;
-            if (SubmitTxMemoryPoolAndRelay(wtx, unused_err_string, true)) ++submitted_tx_count;
-        }
+        // Attempt to rebroadcast all unconfirmed txes more than 5 minutes
+        // older than the last block.
+        submitted_tx_count = ResendWalletTransactionsBefore(m_best_block_time - 5 * 60).size();
     } // cs_wallet
 
     if (submitted_tx_count > 0) {
@@ -2002,6 +2131,13 @@ void MaybeResendWalletTxs(WalletContext& context)
     }
 }
 
+void MaybeConsolidateWalletOutputs(WalletContext& context)
+{
+    for (const std::shared_ptr<CWallet>& pwallet : GetWallets(context)) {
+        pwallet->MaybeConsolidateOutputs();
+    }
+}
+
 
 /** @defgroup Actions
  *
@@ -2514,6 +2650,7 @@ bool CWallet::LockCoin(const COutPoint& output, WalletBatch* batch)
 {
     AssertLockHeld(cs_wallet);
     setLockedCoins.insert(output);
+    ClearCachedBalances();
     if (batch) {
         return batch->WriteLockedUTXO(output);
     }
@@ -2524,6 +2661,7 @@ bool CWallet::UnlockCoin(const COutPoint& output, WalletBatch* batch)
 {
     AssertLockHeld(cs_wallet);
     bool was_locked = setLockedCoins.erase(output);
+    ClearCachedBalances();
     if (batch && was_locked) {
         return batch->EraseLockedUTXO(output);
     }
@@ -2539,6 +2677,7 @@ bool CWallet::UnlockAllCoins()
         success &= batch.EraseLockedUTXO(*it);
     }
     setLockedCoins.clear();
+    ClearCachedBalances();
     return success;
 }
 
@@ -3132,6 +3271,20 @@ bool CWallet::AttachChain(const std::shared_ptr<CWallet>& walletInstance, interf
         walletInstance->chainStateFlushed(chain.getTipLocator());
         walletInstance->GetDatabase().IncrementUpdateCounter();
     }
+    if (walletInstance->IsParticlWallet()) {
+        // Continue a rescan interrupted by abortrescan or a shutdown, the startup rescan above merges with it
+        CHDWallet *phdw = GetParticlWallet(walletInstance.get());
+        CRescanProgress progress;
+        if (phdw->GetRescanProgress(progress)) {
+            chain.initMessage(_("Rescanning…").translated);
+            walletInstance->WalletLogPrintf("Resuming rescan of %d height range(s) from block %i...\n", progress.ranges.size(), progress.ranges[0].first);
+            WalletRescanReserver reserver(*walletInstance);
+            if (!reserver.reserve() || ScanResult::SUCCESS != phdw->ResumeRescan(reserver).status) {
+                error = _("Failed to rescan the wallet during initialization");
+                return false;
+            }
+        }
+    }
     walletInstance->m_attaching_chain = false;
 
     return true;
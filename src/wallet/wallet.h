@@ -296,6 +296,14 @@ private:
     std::atomic<double> m_scanning_progress{0};
     friend class WalletRescanReserver;
 
+    //! Changes queued for NotifyTransactionsChanged while a batch is open, in the order first seen.
+    Mutex m_tx_changes_mutex;
+    int m_tx_changes_depth GUARDED_BY(m_tx_changes_mutex){0};
+    std::vector<std::pair<uint256, ChangeType>> m_tx_changes GUARDED_BY(m_tx_changes_mutex);
+    std::map<uint256, size_t> m_tx_changes_pos GUARDED_BY(m_tx_changes_mutex);
+    boost::signals2::scoped_connection m_tx_changes_connection;
+    void QueueTransactionChange(const uint256& hash, ChangeType status) EXCLUSIVE_LOCKS_REQUIRED(!m_tx_changes_mutex);
+
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion GUARDED_BY(cs_wallet){FEATURE_BASE};
 
@@ -400,6 +408,7 @@ private:
 
 public:
     bool IsParticlWallet() const override { return false; };
+    void KeyStoreChanged() override {};
     /**
      * Main wallet lock.
      * This lock protects all the fields added by CWallet.
@@ -431,6 +440,7 @@ public:
             m_min_fee = CFeeRate(DEFAULT_TRANSACTION_MINFEE_BTC);
             m_default_max_tx_fee = DEFAULT_TRANSACTION_MAXFEE_BTC;
         }
+        m_tx_changes_connection = NotifyTransactionChanged.connect([this](const uint256& hash, ChangeType status) { QueueTransactionChange(hash, status); });
     }
 
     virtual ~CWallet()
@@ -453,6 +463,11 @@ public:
     typedef std::multimap<int64_t, CWalletTx*> TxItems;
     TxItems wtxOrdered;
 
+    /** Txids of mapWallet entries that may be unconfirmed, resends run over these instead of mapWallet.
+     *  Added to when a tx is loaded or its state changes, entries found confirmed, conflicted, abandoned or
+     *  removed are dropped by ResendWalletTransactionsBefore. */
+    std::set<uint256> m_unconfirmed_txids GUARDED_BY(cs_wallet);
+
     int64_t nOrderPosNext GUARDED_BY(cs_wallet) = 0;
     uint64_t nAccountingEntryNumber = 0;
 
@@ -556,6 +571,8 @@ public:
 
     //! For ParticlWallet, clear cached balances from wallet called at new block and adding new transaction
     virtual void ClearCachedBalances() {};
+    //! For ParticlWallet, clear cached balances affected by tx
+    virtual void ClearCachedBalances(const CTransaction &tx) { ClearCachedBalances(); };
     void MarkDirty();
 
     //! Callback for updating transaction metadata in mapWallet.
@@ -590,9 +607,22 @@ public:
         uint256 last_failed_block;
     };
     virtual ScanResult ScanForWalletTransactions(const uint256& start_block, int start_height, std::optional<int> max_height, const WalletRescanReserver& reserver, bool fUpdate);
+    //! Number of blocks ScanForWalletTransactions reads and prepares ahead, in parallel. 0 to read each block when it is scanned.
+    int m_rescan_prefetch_blocks{0};
+    //! Called for each block read ahead by ScanForWalletTransactions, without cs_wallet and from several threads at once.
+    virtual void PrepareRescanBlock(const CBlock& block) {};
+    //! Called around the transactions of each block scanned by ScanForWalletTransactions, to group the database writes they cause.
+    virtual void BeginBlockWrites() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) {};
+    virtual void CommitBlockWrites() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) {};
+    //! Called by ScanForWalletTransactions every minute and when the scan is interrupted, with the last block scanned.
+    virtual void SaveRescanProgress(const uint256& block_hash, int block_height) {};
+    //! Called by ScanForWalletTransactions before reading each block, false skips the block as holding nothing for the wallet. std::nullopt if no filter applies.
+    virtual std::optional<bool> RescanFilterMatchesBlock(const uint256& block_hash) { return std::nullopt; };
     void transactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override;
     void ReacceptWalletTransactions() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     virtual void ResendWalletTransactions();
+    //! Called from the wallet scheduler, particl wallets consolidate small blinded and anon outputs if enabled.
+    virtual void MaybeConsolidateOutputs() {};
 
     OutputType TransactionChangeType(const std::optional<OutputType>& change_type, const std::vector<CRecipient>& vecSend) const;
 
@@ -756,7 +786,7 @@ public:
     void Flush();
 
     //! Close wallet database
-    void Close();
+    virtual void Close();
 
     /** Wallet is about to be unloaded */
     boost::signals2::signal<void ()> NotifyUnload;
@@ -777,6 +807,18 @@ public:
      */
     boost::signals2::signal<void(const uint256& hashTx, ChangeType status)> NotifyTransactionChanged;
 
+    /**
+     * The same changes as NotifyTransactionChanged, coalesced per connected block or rescan chunk.
+     * Each txid appears once, changes outside of a batch are sent alone.
+     */
+    boost::signals2::signal<void(const std::vector<std::pair<uint256, ChangeType>>& changes)> NotifyTransactionsChanged;
+
+    //! Open a batch of NotifyTransactionsChanged changes, batches nest, the changes are sent when the outermost ends.
+    void BeginTransactionChanges() EXCLUSIVE_LOCKS_REQUIRED(!m_tx_changes_mutex);
+    void EndTransactionChanges() EXCLUSIVE_LOCKS_REQUIRED(!m_tx_changes_mutex);
+    //! Send the changes queued so far, the batch stays open.
+    void FlushTransactionChanges() EXCLUSIVE_LOCKS_REQUIRED(!m_tx_changes_mutex);
+
     /** Show progress e.g. for rescan */
     boost::signals2::signal<void (const std::string &title, int nProgress)> ShowProgress;
 
@@ -972,6 +1014,7 @@ public:
  * their transactions. Actual rebroadcast schedule is managed by the wallets themselves.
  */
 void MaybeResendWalletTxs(WalletContext& context);
+void MaybeConsolidateWalletOutputs(WalletContext& context);
 
 /** RAII object to check and reserve a wallet rescan */
 class WalletRescanReserver
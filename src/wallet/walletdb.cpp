@@ -1138,6 +1138,31 @@ bool WalletBatch::EraseAllByPrefix(std::string sPrefix)
         return error("%s: TxnBegin failed.\n", __func__);
     }
 
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    std::string strType;
+    ssKey << sPrefix;
+#ifdef USE_SQLITE
+    if (SQLiteBatch *sb = dynamic_cast<SQLiteBatch*>(m_batch.get())) {
+        bool complete, after = false;
+        while (sb->ReadAtOrAfter(ssKey, ssValue, after, complete) && !complete) {
+            CDataStream ssKeyRead(ssKey);
+            ssKeyRead >> strType;
+            if (IsKeyType(strType) || strType != sPrefix) {
+                break;
+            }
+            if (!m_batch->Erase(MakeUCharSpan(ssKey))) {
+                LogPrintf("%s: Erase failed\n", __func__);
+            }
+            m_database.IncrementUpdateCounter();
+            after = true;
+        }
+        TxnCommit();
+        return true;
+    }
+#endif
+
+#ifdef USE_BDB
     BerkeleyBatch *bb = static_cast<BerkeleyBatch*>(m_batch.get());
     // Get cursor
     Dbc *pcursor = nullptr;
@@ -1146,10 +1171,6 @@ bool WalletBatch::EraseAllByPrefix(std::string sPrefix)
         return error("%s: GetCursor failed.\n", __func__);
     }
 
-    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-    std::string strType;
-    ssKey << sPrefix;
     while (bb->ReadAtCursor2(pcursor, ssKey, ssValue, true) == 0) {
         ssKey >> strType;
         if (IsKeyType(strType) || strType != sPrefix) {
@@ -1162,6 +1183,7 @@ bool WalletBatch::EraseAllByPrefix(std::string sPrefix)
         m_database.IncrementUpdateCounter();
     }
     pcursor->close();
+#endif
 
     TxnCommit();
 
@@ -9,6 +9,7 @@
 #include <wallet/wallettool.h>
 
 #include <fs.h>
+#include <hash.h>
 #include <util/system.h>
 #include <util/translation.h>
 #include <wallet/dump.h>
@@ -17,6 +18,9 @@
 #include <wallet/walletutil.h>
 #include <wallet/hdwallet.h>
 
+#include <map>
+#include <set>
+
 namespace wallet {
 namespace WalletTool {
 
@@ -121,6 +125,307 @@ static void WalletShowInfo(CWallet* wallet_instance)
     tfm::format(std::cout, "Address Book: %zu\n", wallet_instance->m_address_book.size());
 }
 
+/** Particl index and bookkeeping records, read in one pass over the database without loading the wallet */
+struct ParticlRecords
+{
+    std::set<uint256> records;                      // rtx
+    std::set<uint256> stored_txns;                  // stx
+    std::set<CKeyID> accounts;                      // eacc
+    std::map<CKeyID, size_t> key_packs;             // epak, espk and ecpk per account
+    std::map<uint32_t, uint160> sx_index;           // ins, hash of the raw address per id
+    std::map<uint160, uint32_t> sx_index_reverse;   // ris
+    std::map<CKeyID, uint32_t> sx_links;            // lns
+    std::map<uint32_t, CKeyID> ek_index;            // ine
+    int32_t sx_last_index = 0, ek_last_index = 0;
+    size_t num_records = 0, num_unreadable = 0;
+
+    uint32_t MaxSxIndex() const { return sx_index.empty() ? 0 : sx_index.rbegin()->first; }
+    uint32_t MaxEkIndex() const { return ek_index.empty() ? 0 : ek_index.rbegin()->first; }
+};
+
+static bool ReadParticlRecords(CHDWalletDB &wdb, ParticlRecords &recs)
+{
+    std::unique_ptr<CHDWalletDBCursor> pcursor = wdb.GetCursor();
+    if (!pcursor) {
+        tfm::format(std::cerr, "GetCursor failed.\n");
+        return false;
+    }
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    std::string str_type;
+    int ret;
+    while ((ret = wdb.ReadAtCursor(pcursor.get(), ssKey, ssValue, DB_NEXT)) == 0) {
+        recs.num_records++;
+        try {
+            ssKey >> str_type;
+            if (str_type == "rtx" || str_type == "stx") {
+                uint256 txid;
+                ssKey >> txid;
+                (str_type == "rtx" ? recs.records : recs.stored_txns).insert(txid);
+            } else
+            if (str_type == DBKeys::PART_EXTACC) {
+                CKeyID id;
+                ssKey >> id;
+                recs.accounts.insert(id);
+            } else
+            if (str_type == "epak" || str_type == DBKeys::PART_SXADDRKEYPACK || str_type == "ecpk") {
+                CKeyID id;
+                ssKey >> id;
+                recs.key_packs[id]++;
+            } else
+            if (str_type == "ins") {
+                uint32_t id;
+                CStealthAddressIndexed sxi;
+                ssKey >> id;
+                ssValue >> sxi;
+                recs.sx_index[id] = Hash160(sxi.addrRaw);
+            } else
+            if (str_type == "ris") {
+                uint160 hash;
+                uint32_t id;
+                ssKey >> hash;
+                ssValue >> id;
+                recs.sx_index_reverse[hash] = id;
+            } else
+            if (str_type == "lns") {
+                CKeyID id;
+                uint32_t sx_id;
+                ssKey >> id;
+                ssValue >> sx_id;
+                recs.sx_links[id] = sx_id;
+            } else
+            if (str_type == "ine") {
+                uint32_t id;
+                CKeyID key_id;
+                ssKey >> id;
+                ssValue >> key_id;
+                recs.ek_index[id] = key_id;
+            } else
+            if (str_type == DBKeys::PART_FLAG) {
+                std::string name;
+                ssKey >> name;
+                if (name == "sxLastI") {
+                    ssValue >> recs.sx_last_index;
+                } else
+                if (name == "ekLastI") {
+                    ssValue >> recs.ek_last_index;
+                }
+            }
+        } catch (const std::exception &e) {
+            recs.num_unreadable++;
+        }
+    }
+    if (ret != DB_NOTFOUND) {
+        tfm::format(std::cerr, "Error reading records at cursor: %d\n", ret);
+        return false;
+    }
+    return true;
+}
+
+/** Stealth index ids in sx_index that ris does not map back to, ris entries without a matching ins entry */
+static void CheckStealthIndex(const ParticlRecords &recs, size_t &missing_reverse, size_t &bad_reverse)
+{
+    missing_reverse = 0;
+    bad_reverse = 0;
+    for (const auto &it : recs.sx_index) {
+        auto ri = recs.sx_index_reverse.find(it.second);
+        if (ri == recs.sx_index_reverse.end()) {
+            missing_reverse++;
+        }
+    }
+    for (const auto &it : recs.sx_index_reverse) {
+        auto si = recs.sx_index.find(it.second);
+        if (si == recs.sx_index.end() || si->second != it.first) {
+            bad_reverse++;
+        }
+    }
+}
+
+static bool ParticlWalletVerify(WalletDatabase &database)
+{
+    ParticlRecords recs;
+    {
+        CHDWalletDB wdb(database, false);
+        if (!ReadParticlRecords(wdb, recs)) {
+            return false;
+        }
+    }
+    size_t orphaned_stx = 0, dead_packs = 0, dangling_links = 0, missing_reverse, bad_reverse;
+    for (const auto &txid : recs.stored_txns) {
+        if (!recs.records.count(txid)) {
+            orphaned_stx++;
+        }
+    }
+    for (const auto &it : recs.key_packs) {
+        if (!recs.accounts.count(it.first)) {
+            dead_packs += it.second;
+        }
+    }
+    for (const auto &it : recs.sx_links) {
+        if (!recs.sx_index.count(it.second)) {
+            dangling_links++;
+        }
+    }
+    CheckStealthIndex(recs, missing_reverse, bad_reverse);
+    bool sx_last_ok = (uint32_t)recs.sx_last_index >= recs.MaxSxIndex();
+    bool ek_last_ok = (uint32_t)recs.ek_last_index >= recs.MaxEkIndex();
+
+    tfm::format(std::cout, "Records: %u\n", recs.num_records);
+    tfm::format(std::cout, "Unreadable records: %u\n", recs.num_unreadable);
+    tfm::format(std::cout, "Transaction records: %u\n", recs.records.size());
+    tfm::format(std::cout, "Stored transactions: %u\n", recs.stored_txns.size());
+    tfm::format(std::cout, "Stored transactions without a record: %u\n", orphaned_stx);
+    tfm::format(std::cout, "Accounts: %u\n", recs.accounts.size());
+    tfm::format(std::cout, "Key packs of removed accounts: %u\n", dead_packs);
+    tfm::format(std::cout, "Stealth index entries: %u\n", recs.sx_index.size());
+    tfm::format(std::cout, "Stealth index entries missing a reverse entry: %u\n", missing_reverse);
+    tfm::format(std::cout, "Invalid reverse stealth index entries: %u\n", bad_reverse);
+    tfm::format(std::cout, "Stealth links to missing index entries: %u\n", dangling_links);
+    tfm::format(std::cout, "Stealth last index: %s\n", sx_last_ok ? "ok" : "behind");
+    tfm::format(std::cout, "Extkey index entries: %u\n", recs.ek_index.size());
+    tfm::format(std::cout, "Extkey last index: %s\n", ek_last_ok ? "ok" : "behind");
+
+    if (recs.num_unreadable || missing_reverse || bad_reverse || dangling_links || !sx_last_ok || !ek_last_ok) {
+        tfm::format(std::cerr, "Wallet has inconsistent records, run the reindex command.\n");
+        return false;
+    }
+    return true;
+}
+
+/** Erase each record starting with prefix for which erase(ssKey) returns true, ssKey is positioned after the prefix */
+template<typename F>
+static bool EraseRecords(CHDWalletDB &wdb, const std::string &prefix, F erase, size_t &num_erased)
+{
+    std::unique_ptr<CHDWalletDBCursor> pcursor = wdb.GetTxnCursor();
+    if (!pcursor) {
+        tfm::format(std::cerr, "GetTxnCursor failed.\n");
+        return false;
+    }
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << prefix;
+    std::string str_type;
+    unsigned int fFlags = DB_SET_RANGE;
+    while (wdb.ReadKeyAtCursor(pcursor.get(), ssKey, fFlags) == 0) {
+        fFlags = DB_NEXT;
+        ssKey >> str_type;
+        if (str_type != prefix) {
+            break;
+        }
+        if (!erase(ssKey)) {
+            continue;
+        }
+        if (pcursor->Erase() != 0) {
+            tfm::format(std::cerr, "Cursor erase failed.\n");
+            return false;
+        }
+        num_erased++;
+    }
+    return true;
+}
+
+static bool ParticlWalletReindex(WalletDatabase &database)
+{
+    ParticlRecords recs;
+    CHDWalletDB wdb(database);
+    if (!ReadParticlRecords(wdb, recs)) {
+        return false;
+    }
+    if (!wdb.TxnBegin()) {
+        tfm::format(std::cerr, "TxnBegin failed.\n");
+        return false;
+    }
+
+    // Rebuild the reverse stealth index from the index, the first id of a duplicated address is kept
+    size_t num_erased = 0, num_links_erased = 0, num_written = 0;
+    if (!EraseRecords(wdb, "ris", [](CDataStream &) { return true; }, num_erased)) {
+        wdb.TxnAbort();
+        return false;
+    }
+    std::set<uint160> written;
+    for (const auto &it : recs.sx_index) {
+        if (!written.insert(it.second).second) {
+            continue;
+        }
+        if (!wdb.WriteStealthAddressIndexReverse(it.second, it.first)) {
+            tfm::format(std::cerr, "WriteStealthAddressIndexReverse failed.\n");
+            wdb.TxnAbort();
+            return false;
+        }
+        num_written++;
+    }
+    if (!EraseRecords(wdb, "lns", [&recs](CDataStream &ssKey) {
+            CKeyID id;
+            ssKey >> id;
+            auto it = recs.sx_links.find(id);
+            return it != recs.sx_links.end() && !recs.sx_index.count(it->second);
+        }, num_links_erased)) {
+        wdb.TxnAbort();
+        return false;
+    }
+    if (((uint32_t)recs.sx_last_index < recs.MaxSxIndex() && !wdb.WriteFlag("sxLastI", (int32_t)recs.MaxSxIndex())) ||
+        ((uint32_t)recs.ek_last_index < recs.MaxEkIndex() && !wdb.WriteFlag("ekLastI", (int32_t)recs.MaxEkIndex()))) {
+        tfm::format(std::cerr, "WriteFlag failed.\n");
+        wdb.TxnAbort();
+        return false;
+    }
+    if (!wdb.TxnCommit()) {
+        tfm::format(std::cerr, "TxnCommit failed.\n");
+        return false;
+    }
+    tfm::format(std::cout, "Reverse stealth index entries rewritten: %u, removed: %u\n", num_written, num_erased);
+    tfm::format(std::cout, "Stealth links to missing index entries removed: %u\n", num_links_erased);
+    tfm::format(std::cout, "Stealth last index: %u\n", std::max((uint32_t)recs.sx_last_index, recs.MaxSxIndex()));
+    tfm::format(std::cout, "Extkey last index: %u\n", std::max((uint32_t)recs.ek_last_index, recs.MaxEkIndex()));
+    return true;
+}
+
+static bool ParticlWalletCompact(WalletDatabase &database)
+{
+    size_t num_stx_erased = 0, num_packs_erased = 0;
+    {
+        ParticlRecords recs;
+        CHDWalletDB wdb(database);
+        if (!ReadParticlRecords(wdb, recs)) {
+            return false;
+        }
+        if (!wdb.TxnBegin()) {
+            tfm::format(std::cerr, "TxnBegin failed.\n");
+            return false;
+        }
+        auto erase_stx = [&recs](CDataStream &ssKey) {
+            uint256 txid;
+            ssKey >> txid;
+            return !recs.records.count(txid);
+        };
+        auto erase_pack = [&recs](CDataStream &ssKey) {
+            CKeyID id;
+            ssKey >> id;
+            return !recs.accounts.count(id);
+        };
+        if (!EraseRecords(wdb, "stx", erase_stx, num_stx_erased) ||
+            !EraseRecords(wdb, "epak", erase_pack, num_packs_erased) ||
+            !EraseRecords(wdb, DBKeys::PART_SXADDRKEYPACK, erase_pack, num_packs_erased) ||
+            !EraseRecords(wdb, "ecpk", erase_pack, num_packs_erased)) {
+            wdb.TxnAbort();
+            return false;
+        }
+        if (!wdb.TxnCommit()) {
+            tfm::format(std::cerr, "TxnCommit failed.\n");
+            return false;
+        }
+    }
+    tfm::format(std::cout, "Stored transactions without a record removed: %u\n", num_stx_erased);
+    tfm::format(std::cout, "Key packs of removed accounts removed: %u\n", num_packs_erased);
+
+    // Copy the remaining records into a new file, freeing the pages of removed records
+    if (!database.Rewrite()) {
+        tfm::format(std::cerr, "Rewrite failed.\n");
+        return false;
+    }
+    tfm::format(std::cout, "Database rewritten.\n");
+    return true;
+}
+
 bool ExecuteWalletToolFunc(const ArgsManager& args, const std::string& command)
 {
     if (args.IsArgSet("-format") && command != "createfromdump") {
@@ -226,6 +531,26 @@ bool ExecuteWalletToolFunc(const ArgsManager& args, const std::string& command)
             tfm::format(std::cerr, "%s\n", error.original);
         }
         return ret;
+    } else if (command == "verify" || command == "reindex" || command == "compact") {
+        if (!fParticlMode) {
+            tfm::format(std::cerr, "The %s command requires a Particl wallet.\n", command);
+            return false;
+        }
+        DatabaseOptions options;
+        ReadDatabaseArgs(args, options);
+        options.require_existing = true;
+        DatabaseStatus status;
+        bilingual_str error;
+        std::unique_ptr<WalletDatabase> database = MakeDatabase(path, options, status, error);
+        if (!database) {
+            tfm::format(std::cerr, "%s\n", error.original);
+            return false;
+        }
+        bool ret = command == "verify" ? ParticlWalletVerify(*database)
+                   : command == "reindex" ? ParticlWalletReindex(*database)
+                   : ParticlWalletCompact(*database);
+        database->Close();
+        return ret;
     } else {
         tfm::format(std::cerr, "Invalid command: %s\n", command);
         return false;
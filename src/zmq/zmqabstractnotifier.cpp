@@ -48,7 +48,17 @@ bool CZMQAbstractNotifier::NotifySecureMessage(const smsg::SecureMessage *psmsg,
     return true;
 }
 
+bool CZMQAbstractNotifier::NotifySecureMessagesFunded(const uint256 &/*txid*/, const std::vector<std::vector<uint8_t> > &/*msgids*/)
+{
+    return true;
+}
+
 bool CZMQAbstractNotifier::NotifyTransaction(const std::string &sWalletName, const CTransaction &/*transaction*/)
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyBlockContents(const CBlock &/*block*/, const CBlockIndex * /*pindex*/, bool /*connected*/)
+{
+    return true;
+}
@@ -6,15 +6,19 @@
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
+class CBlock;
 class CBlockIndex;
 class CTransaction;
 namespace smsg {
 class SecureMessage;
 }
 class uint160;
+class uint256;
 class CZMQAbstractNotifier;
 
 using CZMQNotifierFactory = std::unique_ptr<CZMQAbstractNotifier> (*)();
@@ -44,6 +48,9 @@ public:
         }
     }
 
+    bool GetBatchPerBlock() const { return batch_per_block; }
+    void SetBatchPerBlock(bool batch) { batch_per_block = batch; }
+
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
@@ -62,12 +69,17 @@ public:
 
     virtual bool NotifyTransaction(const std::string &sWalletName, const CTransaction &transaction);
     virtual bool NotifySecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash);
+    // Notifies of queued paid messages funded by one txn
+    virtual bool NotifySecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids);
+    // Notifies of the contents of every block connection or disconnection
+    virtual bool NotifyBlockContents(const CBlock &block, const CBlockIndex *pindex, bool connected);
 
 protected:
     void *psocket;
     std::string type;
     std::string address;
     int outbound_message_high_water_mark; // aka SNDHWM
+    bool batch_per_block{false};
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
@@ -111,6 +111,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
 
     factories["pubhashwtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashWalletTransactionNotifier>;
     factories["pubsmsg"] = CZMQAbstractNotifier::Create<CZMQPublishSMSGNotifier>;
+    factories["pubsmsgfunded"] = CZMQAbstractNotifier::Create<CZMQPublishSMSGFundedNotifier>;
+    factories["pubkeyimage"] = CZMQAbstractNotifier::Create<CZMQPublishKeyImageNotifier>;
+    factories["pubcoldstake"] = CZMQAbstractNotifier::Create<CZMQPublishColdStakeNotifier>;
+    factories["pubanonoutputs"] = CZMQAbstractNotifier::Create<CZMQPublishAnonOutputsNotifier>;
 
     std::list<std::unique_ptr<CZMQAbstractNotifier>> notifiers;
     for (const auto& entry : factories)
@@ -122,6 +126,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
             notifier->SetType(entry.first);
             notifier->SetAddress(address);
             notifier->SetOutboundMessageHighWaterMark(static_cast<int>(gArgs.GetIntArg(arg + "hwm", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM)));
+            notifier->SetBatchPerBlock(gArgs.GetBoolArg("-zmqbatchperblock", DEFAULT_ZMQ_BATCH_PER_BLOCK));
             notifiers.push_back(std::move(notifier));
         }
     }
@@ -276,6 +281,10 @@ void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBloc
     TryForEachAndRemoveFailed(notifiers, [pindexConnected](CZMQAbstractNotifier* notifier) {
         return notifier->NotifyBlockConnect(pindexConnected);
     });
+
+    TryForEachAndRemoveFailed(notifiers, [&pblock, pindexConnected](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockContents(*pblock, pindexConnected, true);
+    });
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected)
@@ -291,6 +300,10 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
     TryForEachAndRemoveFailed(notifiers, [pindexDisconnected](CZMQAbstractNotifier* notifier) {
         return notifier->NotifyBlockDisconnect(pindexDisconnected);
     });
+
+    TryForEachAndRemoveFailed(notifiers, [&pblock, pindexDisconnected](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockContents(*pblock, pindexDisconnected, false);
+    });
 }
 
 void CZMQNotificationInterface::TransactionAddedToWallet(const std::string &sWalletName, const CTransactionRef& ptx)
@@ -309,4 +322,11 @@ void CZMQNotificationInterface::NewSecureMessage(const smsg::SecureMessage *psms
     });
 }
 
+void CZMQNotificationInterface::SecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids)
+{
+    TryForEachAndRemoveFailed(notifiers, [&txid, &msgids](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifySecureMessagesFunded(txid, msgids);
+    });
+}
+
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
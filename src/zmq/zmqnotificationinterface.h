@@ -18,6 +18,9 @@ class SecureMessage;
 }
 class CZMQAbstractNotifier;
 
+/** Default for -zmqbatchperblock */
+static const bool DEFAULT_ZMQ_BATCH_PER_BLOCK = false;
+
 class CZMQNotificationInterface final : public CValidationInterface
 {
 public:
@@ -40,6 +43,7 @@ protected:
 
     void TransactionAddedToWallet(const std::string &sWalletName, const CTransactionRef& tx) override;
     void NewSecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash) override;
+    void SecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids) override;
 
 private:
     CZMQNotificationInterface();
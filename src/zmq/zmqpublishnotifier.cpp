@@ -27,6 +27,7 @@
 // Particl
 #include <util/strencodings.h>
 #include <smsg/smessage.h>
+#include <script/interpreter.h>
 
 using node::ReadBlockFromDisk;
 
@@ -39,6 +40,10 @@ static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_SEQUENCE  = "sequence";
 static const char *MSG_HASHWTX   = "hashwtx";
 static const char *MSG_SMSG      = "smsg";
+static const char *MSG_SMSGFUNDED = "smsgfunded";
+static const char *MSG_KEYIMAGE  = "keyimage";
+static const char *MSG_COLDSTAKE = "coldstake";
+static const char *MSG_ANONOUTPUTS = "anonoutputs";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -84,6 +89,31 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+static int zmq_send_part(void *sock, const void* data, size_t size, bool more)
+{
+    zmq_msg_t msg;
+
+    int rc = zmq_msg_init_size(&msg, size);
+    if (rc != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+
+    if (size > 0) {
+        memcpy(zmq_msg_data(&msg), data, size);
+    }
+
+    rc = zmq_msg_send(&msg, sock, more ? ZMQ_SNDMORE : 0);
+    if (rc == -1) {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msg);
+        return -1;
+    }
+
+    zmq_msg_close(&msg);
+    return 0;
+}
+
 static bool IsZMQAddressIPV6(const std::string &zmq_address)
 {
     const std::string tcp_prefix = "tcp://";
@@ -237,6 +267,31 @@ bool CZMQAbstractPublishNotifier::SendZmqMessage(const char *command, const void
     return true;
 }
 
+bool CZMQAbstractPublishNotifier::SendZmqMessage(const char *command, const std::vector<std::vector<uint8_t> > &parts)
+{
+    assert(psocket);
+
+    /* send command, the data parts & a LE 4byte sequence number */
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(msgseq, nSequence);
+    if (zmq_send_part(psocket, command, strlen(command), true) == -1) {
+        return false;
+    }
+    for (const auto &part : parts) {
+        if (zmq_send_part(psocket, part.data(), part.size(), true) == -1) {
+            return false;
+        }
+    }
+    if (zmq_send_part(psocket, msgseq, sizeof(msgseq), false) == -1) {
+        return false;
+    }
+
+    /* increment memory only sequence number after sending */
+    nSequence++;
+
+    return true;
+}
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
@@ -356,3 +411,135 @@ bool CZMQPublishSMSGNotifier::NotifySecureMessage(const smsg::SecureMessage *psm
     ss << hash;
     return SendZmqMessage(MSG_SMSG, &(*ss.begin()), ss.size());
 }
+
+static void AppendHash(std::vector<uint8_t> &data, const uint256 &hash)
+{
+    for (unsigned int i = 0; i < 32; i++) {
+        data.push_back(hash.begin()[31 - i]);
+    }
+}
+
+bool CZMQPublishSMSGFundedNotifier::NotifySecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish smsgfunded %s, %d messages\n", txid.GetHex(), msgids.size());
+    std::vector<uint8_t> data;
+    data.reserve(32 + msgids.size() * 28);
+    AppendHash(data, txid);
+    for (const auto &msgid : msgids) {
+        data.insert(data.end(), msgid.begin(), msgid.end());
+    }
+    return SendZmqMessage(MSG_SMSGFUNDED, data.data(), data.size());
+}
+
+bool CZMQAbstractBlockItemNotifier::NotifyBlockContents(const CBlock &block, const CBlockIndex *pindex, bool connected)
+{
+    std::vector<std::vector<uint8_t> > items;
+    GetBlockItems(block, items);
+    if (items.empty()) {
+        return true;
+    }
+
+    const char *topic = GetTopic();
+    const char label = connected ? /* Block (C)onnect */ 'C' : /* Block (D)isconnect */ 'D';
+    LogPrint(BCLog::ZMQ, "zmq: Publish %s %u items of block %s to %s\n", topic, items.size(), pindex->GetBlockHash().GetHex(), this->address);
+
+    if (batch_per_block) {
+        //   | topic | <32-byte block hash><1-byte label> | <item> ... | <uint32 sequence>
+        std::vector<std::vector<uint8_t> > parts(1);
+        parts[0].reserve(33);
+        AppendHash(parts[0], pindex->GetBlockHash());
+        parts[0].push_back(label);
+        parts.insert(parts.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+        return SendZmqMessage(topic, parts);
+    }
+
+    //   | topic | <1-byte label><item> | <uint32 sequence>
+    std::vector<uint8_t> data;
+    for (const auto &item : items) {
+        data.clear();
+        data.push_back(label);
+        data.insert(data.end(), item.begin(), item.end());
+        if (!SendZmqMessage(topic, data.data(), data.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *CZMQPublishKeyImageNotifier::GetTopic() const
+{
+    return MSG_KEYIMAGE;
+}
+
+void CZMQPublishKeyImageNotifier::GetBlockItems(const CBlock &block, std::vector<std::vector<uint8_t> > &items) const
+{
+    // <33-byte key image><32-byte spending transaction hash>
+    for (const auto &tx : block.vtx) {
+        for (const auto &txin : tx->vin) {
+            if (!txin.IsAnonInput()) {
+                continue;
+            }
+            uint32_t nInputs, nRingSize;
+            txin.GetAnonInfo(nInputs, nRingSize);
+            if (txin.scriptData.stack.empty() ||
+                txin.scriptData.stack[0].size() != nInputs * 33) {
+                continue;
+            }
+            const std::vector<uint8_t> &vKeyImages = txin.scriptData.stack[0];
+            for (size_t k = 0; k < nInputs; ++k) {
+                std::vector<uint8_t> item(vKeyImages.begin() + k * 33, vKeyImages.begin() + (k + 1) * 33);
+                AppendHash(item, tx->GetHash());
+                items.push_back(std::move(item));
+            }
+        }
+    }
+}
+
+const char *CZMQPublishColdStakeNotifier::GetTopic() const
+{
+    return MSG_COLDSTAKE;
+}
+
+void CZMQPublishColdStakeNotifier::GetBlockItems(const CBlock &block, std::vector<std::vector<uint8_t> > &items) const
+{
+    // <32-byte transaction hash><4-byte LE output index><script>
+    for (const auto &tx : block.vtx) {
+        for (size_t k = 0; k < tx->vpout.size(); ++k) {
+            const CScript *pscript = tx->vpout[k]->GetPScriptPubKey();
+            if (!pscript || !HasIsCoinstakeOp(*pscript)) {
+                continue;
+            }
+            std::vector<uint8_t> item;
+            item.reserve(32 + 4 + pscript->size());
+            AppendHash(item, tx->GetHash());
+            uint8_t n[4];
+            WriteLE32(n, k);
+            item.insert(item.end(), n, n + 4);
+            item.insert(item.end(), pscript->begin(), pscript->end());
+            items.push_back(std::move(item));
+        }
+    }
+}
+
+bool CZMQPublishAnonOutputsNotifier::NotifyBlockContents(const CBlock &block, const CBlockIndex *pindex, bool connected)
+{
+    // The anon outputs of a block are indexed consecutively after those of the previous block
+    const int64_t first_index = (pindex->pprev ? pindex->pprev->nAnonOutputs : 0) + 1;
+    const int64_t num_outputs = pindex->nAnonOutputs - first_index + 1;
+    if (num_outputs < 1) {
+        return true;
+    }
+    LogPrint(BCLog::ZMQ, "zmq: Publish anonoutputs %d-%d of block %s to %s\n", first_index, pindex->nAnonOutputs, pindex->GetBlockHash().GetHex(), this->address);
+
+    //   <32-byte block hash><1-byte label><8-byte LE first index><8-byte LE count>
+    std::vector<uint8_t> data;
+    data.reserve(32 + 1 + 16);
+    AppendHash(data, pindex->GetBlockHash());
+    data.push_back(connected ? 'C' : 'D');
+    uint8_t buf[8];
+    WriteLE64(buf, first_index);
+    data.insert(data.end(), buf, buf + 8);
+    WriteLE64(buf, num_outputs);
+    data.insert(data.end(), buf, buf + 8);
+    return SendZmqMessage(MSG_ANONOUTPUTS, data.data(), data.size());
+}
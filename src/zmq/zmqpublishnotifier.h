@@ -7,6 +7,9 @@
 
 #include <zmq/zmqabstractnotifier.h>
 
+#include <stdint.h>
+#include <vector>
+
 class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
@@ -23,6 +26,8 @@ public:
           * message sequence number
     */
     bool SendZmqMessage(const char *command, const void* data, size_t size);
+    /* send zmq multipart message with one data part per entry in parts */
+    bool SendZmqMessage(const char *command, const std::vector<std::vector<uint8_t> > &parts);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
@@ -76,4 +81,45 @@ public:
     bool NotifySecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash) override;
 };
 
+/** Publishes the funding txid followed by the 28 byte ids of the queued paid messages it funds */
+class CZMQPublishSMSGFundedNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifySecureMessagesFunded(const uint256 &txid, const std::vector<std::vector<uint8_t> > &msgids) override;
+};
+
+/**
+ * Publishes one message per item found in connected and disconnected blocks,
+ * or one message per block holding all its items when -zmqbatchperblock is set.
+ */
+class CZMQAbstractBlockItemNotifier : public CZMQAbstractPublishNotifier
+{
+protected:
+    virtual const char *GetTopic() const = 0;
+    virtual void GetBlockItems(const CBlock &block, std::vector<std::vector<uint8_t> > &items) const = 0;
+
+public:
+    bool NotifyBlockContents(const CBlock &block, const CBlockIndex *pindex, bool connected) override;
+};
+
+class CZMQPublishKeyImageNotifier : public CZMQAbstractBlockItemNotifier
+{
+protected:
+    const char *GetTopic() const override;
+    void GetBlockItems(const CBlock &block, std::vector<std::vector<uint8_t> > &items) const override;
+};
+
+class CZMQPublishColdStakeNotifier : public CZMQAbstractBlockItemNotifier
+{
+protected:
+    const char *GetTopic() const override;
+    void GetBlockItems(const CBlock &block, std::vector<std::vector<uint8_t> > &items) const override;
+};
+
+class CZMQPublishAnonOutputsNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockContents(const CBlock &block, const CBlockIndex *pindex, bool connected) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
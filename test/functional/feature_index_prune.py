@@ -24,6 +24,7 @@ class FeatureIndexPruneTest(BitcoinTestFramework):
     def sync_index(self, height):
         expected_filter = {
             'basic block filter index': {'synced': True, 'best_block_height': height},
+            'particl block filter index': {'synced': True, 'best_block_height': height},
         }
         self.wait_until(lambda: self.nodes[0].getindexinfo() == expected_filter)
 
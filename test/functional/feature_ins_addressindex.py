@@ -9,7 +9,7 @@
 #
 
 from test_framework.test_particl import ParticlTestFramework, bytes_to_wif
-from test_framework.util import assert_equal
+from test_framework.util import assert_equal, assert_raises_rpc_error
 from test_framework.script import taproot_construct
 from test_framework.key import generate_privkey, compute_xonly_pubkey
 from test_framework.segwit_addr import encode_segwit_address
@@ -196,6 +196,18 @@ class AddressIndexTest(ParticlTestFramework):
         deltasAll = nodes[1].getaddressdeltas({"addresses": [address2]})
         assert_equal(len(deltasAll), 4)
 
+        # Check that deltas can be paged through
+        page = nodes[1].getaddressdeltas({"addresses": [address2], "limit": 3})
+        assert_equal(len(page['deltas']), 3)
+        deltasPaged = page['deltas']
+        while 'next' in page:
+            page = nodes[1].getaddressdeltas({"addresses": [address2], "limit": 3, "cursor": page['next']})
+            deltasPaged += page['deltas']
+        assert_equal(deltasPaged, deltasAll)
+        txidsPage = nodes[1].getaddresstxids({"addresses": [address2], "limit": 4})
+        assert('next' not in txidsPage)
+        assert_equal(txidsPage['txids'], nodes[1].getaddresstxids({"addresses": [address2]}))
+
         # Check that deltas can be returned from range of block heights
         deltas = nodes[1].getaddressdeltas({"addresses": [address2], "start": 3, "end": 3})
         assert_equal(len(deltas), 1)
@@ -220,6 +232,12 @@ class AddressIndexTest(ParticlTestFramework):
         balance4 = nodes[1].getaddressbalance(address2)
         assert_equal(balance4['balance'], 4500000000)
 
+        # The stored totals must be rolled back with the deltas
+        assert(nodes[1].getinsightinfo()['addressbalanceindex'])
+        deltas = nodes[1].getaddressdeltas({"addresses": [address2]})
+        assert_equal(balance4['balance'], sum(d['satoshis'] for d in deltas))
+        assert_equal(balance4['received'], sum(d['satoshis'] for d in deltas if d['satoshis'] > 0))
+
         utxos2 = nodes[1].getaddressutxos({"addresses": [address2]})
         assert_equal(len(utxos2), 3)
         assert_equal(utxos2[0]["satoshis"], 1000000000)
@@ -244,6 +262,29 @@ class AddressIndexTest(ParticlTestFramework):
         assert(utxos3[2]['txid'] == txidsort1)
         assert(utxos3[3]['txid'] == txidsort2)
 
+        self.log.info("Testing utxo filters and paging...")
+        utxos_by_value = nodes[1].getaddressutxos({"addresses": [address2], "sort": "value"})
+        assert_equal(sorted(u['satoshis'] for u in utxos3), sorted(u['satoshis'] for u in utxos_by_value))
+        assert(all(a['satoshis'] >= b['satoshis'] for a, b in zip(utxos_by_value, utxos_by_value[1:])))
+        for sort, expect in (("value", utxos_by_value), ("height", utxos3)):
+            paged = []
+            page = nodes[1].getaddressutxos({"addresses": [address2], "sort": sort, "limit": 3})
+            paged += page['utxos']
+            assert('next' in page)
+            page = nodes[1].getaddressutxos({"addresses": [address2], "sort": sort, "limit": 3, "cursor": page['next']})
+            paged += page['utxos']
+            assert('next' not in page)
+            assert_equal(paged, expect)
+        max_satoshis = utxos_by_value[0]['satoshis'] - 1
+        ro = nodes[1].getaddressutxos({"addresses": [address2], "sort": "value", "limit": 1, "maxSatoshis": max_satoshis})
+        assert_equal(ro['utxos'], [u for u in utxos_by_value if u['satoshis'] <= max_satoshis][:1])
+        ro = nodes[1].getaddressutxos({"addresses": [address2], "minHeight": 5, "maxHeight": 9})
+        assert_equal([u['height'] for u in ro], [5, 9])
+        assert_equal(nodes[1].getaddressutxos({"addresses": [address2], "types": ["blind"]}), [])
+        assert_equal(nodes[1].getaddressutxos({"addresses": [address2], "types": ["standard"]}), utxos3)
+        height_cursor = nodes[1].getaddressutxos({"addresses": [address2], "limit": 1})['next']
+        assert_raises_rpc_error(-8, 'Invalid "cursor"', nodes[1].getaddressutxos, {"addresses": [address2], "sort": "value", "cursor": height_cursor})
+
         # Check mempool indexing
         self.log.info("Testing mempool indexing...")
 
@@ -67,6 +67,23 @@ class BalancesIndexTest(ParticlTestFramework):
         txoutsetinfo = nodes[1].gettxoutsetinfo()
         assert(blockbalances['plain'] == txoutsetinfo['total_amount'])
 
+        self.log.info('Test getblockbalancesrange')
+        r = nodes[1].getblockbalancesrange(0, 100)
+        assert(len(r) == 3)
+        for i, entry in enumerate(r):
+            assert(entry['height'] == i)
+            assert(entry['blockhash'] == nodes[0].getblockhash(i))
+            single = nodes[1].getblockbalances(entry['blockhash'])
+            assert(all(entry[k] == single[k] for k in ('plain', 'blind', 'anon')))
+
+        r = nodes[1].getblockbalancesrange(0, 2, {'step': 2, 'in_sats': True})
+        assert([entry['height'] for entry in r] == [0, 2])
+        assert(r[1]['blind'] == 900000000)
+
+        block_time_1 = nodes[0].getblockheader(nodes[0].getblockhash(1))['time']
+        r = nodes[1].getblockbalancesrange(block_time_1, block_time_1, {'bytime': True})
+        assert(len(r) == 1 and r[0]['height'] == 1)
+
 
 if __name__ == '__main__':
     BalancesIndexTest().main()
@@ -6,8 +6,11 @@
 import re
 import json
 
+from decimal import Decimal
+
 from test_framework.test_particl import ParticlTestFramework
 from test_framework.authproxy import JSONRPCException
+from test_framework.util import assert_equal
 
 
 class TxIndexTest(ParticlTestFramework):
@@ -31,6 +34,21 @@ class TxIndexTest(ParticlTestFramework):
 
         self.sync_all()
 
+    def check_delegations(self, node, addr_stake):
+        # Totals must match the sum of the unspent outputs
+        expect = {}
+        for o in node.listcoldstakeunspent(addr_stake):
+            num, value = expect.get(o['addrspend'], (0, 0))
+            expect[o['addrspend']] = (num + 1, value + o['value'])
+        ro = node.listcoldstakedelegations(addr_stake)
+        assert('next' not in ro)
+        assert_equal(ro['num_unspent'], sum(v[0] for v in expect.values()))
+        assert_equal(ro['value'], Decimal(sum(v[1] for v in expect.values())) / 100000000)
+        assert_equal(len(ro['delegations']), len(expect))
+        for d in ro['delegations']:
+            assert_equal((d['num_unspent'], d['value'] * 100000000), expect[d['addrspend']])
+        return ro
+
     def run_test(self):
         nodes = self.nodes
 
@@ -118,6 +136,8 @@ class TxIndexTest(ParticlTestFramework):
         self.stakeBlocks(1, nStakeNode=2)
         ro = nodes[2].listcoldstakeunspent(addrStake)
         assert(len(ro) == 3)
+        ro = self.check_delegations(nodes[2], addrStake)
+        assert_equal(ro['num_unspent'], 3)
 
         ro = nodes[2].listcoldstakeunspent(addrStake, 4, {'mature_only': True})
         assert(len(ro) == 1)
@@ -133,6 +153,8 @@ class TxIndexTest(ParticlTestFramework):
         assert(ro[0]['height'] == 2)
         assert(ro[1]['height'] == 2)
         assert(len(ro) == 2)
+        ro = self.check_delegations(nodes[2], addrStake)
+        assert_equal(ro['num_unspent'], 2)
 
         ro = nodes[1].listcoldstakeunspent(addrStake)
         assert(len(ro) == 3)
@@ -189,6 +211,14 @@ class TxIndexTest(ParticlTestFramework):
                 num_found += 1
         assert(num_found == 2)
 
+        ro = self.check_delegations(nodes[2], addrStake)
+        assert_equal(len(ro['delegations']), 3)
+        page = nodes[2].listcoldstakedelegations(addrStake, {'limit': 2})
+        assert_equal(page['delegations'], ro['delegations'][:2])
+        page = nodes[2].listcoldstakedelegations(addrStake, {'limit': 2, 'cursor': page['next']})
+        assert_equal(page['delegations'], ro['delegations'][2:])
+        assert('next' not in page)
+
 
 if __name__ == '__main__':
     TxIndexTest().main()
@@ -84,6 +84,12 @@ class SpentIndexTest(ParticlTestFramework):
         assert_equal(info["index"], 0)
         assert_equal(info["height"], 1)
 
+        # Check that many outputs can be resolved in one call
+        infos = self.nodes[1].getspentinfo([{"txid": unspent[0]["txid"], "index": unspent[0]["vout"]}, {"txid": sent_txid, "index": 0}])
+        assert_equal(len(infos), 2)
+        assert_equal(infos[0], info)
+        assert_equal(infos[1], None)
+
         print("Testing getrawtransaction method...")
 
         # Check that verbose raw transaction includes spent info
@@ -144,6 +150,29 @@ class SpentIndexTest(ParticlTestFramework):
                 break
         assert(fFound)
 
+        # Repeated calls are served from the cache, the chain dependent fields stay current
+        assert_equal(nodes[3].getblockdeltas(block1_hash), block)
+        self.stakeBlocks(1)
+        block_next = nodes[3].getblockdeltas(block1_hash)
+        assert_equal(block_next["confirmations"], block["confirmations"] + 1)
+        assert_equal(block_next["nextblockhash"], nodes[3].getbestblockhash())
+        assert_equal(block_next["deltas"], block["deltas"])
+        assert_equal(block_next["size"], nodes[3].getblock(block1_hash)["size"])
+        block_tip = nodes[3].getblockdeltas(nodes[3].getbestblockhash())
+        assert_equal(block_tip["deltas"][0]["index"], 0)
+
+        self.log.info('Test getblockdeltas with -prune')
+        self.restart_node(2, extra_args=self.extra_args[2] + ['-prune=1', '-wallet=default_wallet'])
+        self.connect_nodes(0, 2)
+        txid3 = nodes[0].sendtoaddress(addrs[0], 2)
+        self.sync_mempools([nodes[0], nodes[2]])
+        self.stakeBlocks(1)
+        self.sync_blocks()
+        best_hash = nodes[2].getbestblockhash()
+        block_pruned = nodes[2].getblockdeltas(best_hash)
+        assert_equal(block_pruned["deltas"], nodes[3].getblockdeltas(best_hash)["deltas"])
+        assert(txid3 in [d["txid"] for d in block_pruned["deltas"]])
+
         print("Passed\n")
 
 
@@ -67,6 +67,22 @@ class TimestampIndexTest(ParticlTestFramework):
 
         assert_equal(hashes, blockhashes)
 
+        print('Checking limit and continuing after the last result...')
+        first = self.nodes[1].getblockhashes(high, low, {'logicalTimes': True, 'limit': 2})
+        assert_equal([e['blockhash'] for e in first], blockhashes[:2])
+        rest = self.nodes[1].getblockhashes(high, low, {'limit': 2, 'afterTime': first[-1]['logicalts'], 'afterHash': first[-1]['blockhash']})
+        assert_equal(rest, blockhashes[2:])
+
+        print('Checking active chain lookups without the index...')
+        assert_equal(self.nodes[0].getblockhashes(high, low, {'noOrphans': True}), blockhashes)
+        assert_equal(self.nodes[1].getblockhashes(high, low, {'noOrphans': True}), blockhashes)
+        assert_equal(self.nodes[0].getblockhashes(high, low, {'noOrphans': True, 'limit': 1, 'afterTime': first[0]['logicalts'], 'afterHash': first[0]['blockhash']}), blockhashes[1:2])
+
+        print('Checking the index syncs after being enabled...')
+        self.restart_node(2, extra_args=['-debug', '-timestampindex'])
+        self.wait_until(lambda: self.nodes[2].getindexinfo('timestampindex')['timestampindex']['synced'])
+        assert_equal(self.nodes[2].getblockhashes(high, low), blockhashes)
+
         print('Passed\n')
 
 
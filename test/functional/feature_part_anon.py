@@ -15,7 +15,7 @@ class AnonTest(ParticlTestFramework):
     def set_test_params(self):
         self.setup_clean_chain = True
         self.num_nodes = 3
-        self.extra_args = [ ['-debug','-noacceptnonstdtxn','-reservebalance=10000000'] for i in range(self.num_nodes)]
+        self.extra_args = [ ['-debug','-noacceptnonstdtxn','-reservebalance=10000000','-checkbalancecache'] for i in range(self.num_nodes)]
 
     def skip_test_if_missing_module(self):
         self.skip_if_no_wallet()
@@ -79,6 +79,18 @@ class AnonTest(ParticlTestFramework):
 
         assert(nodes[1].anonoutput()['lastindex'] == 28)
 
+        self.log.info('Test anonoutput range')
+        ro = nodes[1].anonoutput('1', 30, {'include_compromised': True})
+        assert(ro['start'] == 1)
+        assert(ro['count'] == 28)
+        assert(len(ro['outputs']) == 28)
+        assert(ro['outputs'][4] == nodes[1].anonoutput('5', None, {'include_compromised': True}))
+        assert(ro['outputs'][27]['index'] == 28)
+        ro_hex = nodes[1].anonoutput('3', 4, {'format': 'hex'})
+        assert(ro_hex['count'] == 4)
+        assert(len(ro_hex['hex']) == 4 * 108 * 2)
+        assert(ro['outputs'][2]['publickey'] in ro_hex['hex'][:2 + 66])
+
         txnHashes.clear()
         txnHashes.append(nodes[1].sendtypeto('anon', 'anon', [{'address': sxAddrTo0_1, 'amount': 101, 'narr': 'node1 -> node0 a->a'}, ], '', '', 5, 1))
         txnHashes.append(nodes[1].sendtypeto('anon', 'anon', [{'address': sxAddrTo0_1, 'amount': 0.1}, ], '', '', 5, 2))
@@ -394,9 +406,40 @@ class AnonTest(ParticlTestFramework):
         assert(spent['spent'] is True)
         assert(spent['txid'] == spending_txid)
 
+        spent = nodes[0].checkkeyimages([keyimage, used_keyimage, keyimage])
+        assert(len(spent) == 3)
+        assert(spent[0]['state'] == 'unknown')
+        assert(spent[1]['state'] == 'spent')
+        assert(spent[1]['txid'] == spending_txid)
+        assert(spent[2] == spent[0])
+
+        unspents = nodes[0].listunspentanon(0, 999999, [], True, {'check_keyimages': True})
+        for utxo in unspents:
+            assert(utxo['keyimage_state'] == 'unknown')
+
+        self.log.info('Test consolidation settings')
+        assert('consolidation' not in nodes[0].getwalletinfo())
+        ro = nodes[0].walletsettings('consolidation', {'enabled': True, 'maxinputs': 1})
+        assert('maxinputs' in ro['error'])
+        ro = nodes[0].walletsettings('consolidation', {'enabled': True, 'minoutputs': 1000, 'maxvalue': 0.5, 'ringsize': 5})
+        assert('error' not in ro)
+        assert(ro['consolidation']['minoutputs'] == 1000)
+        self.wait_until(lambda: nodes[0].getwalletinfo()['consolidation']['last_run'] > 0)
+        ro = nodes[0].getwalletinfo()['consolidation']
+        assert(ro['enabled'] is True)
+        assert(ro['txns'] == 0)
+        assert(ro['small_anon_outputs'] < 1000)
+        nodes[0].walletsettings('consolidation', {})
+        assert('consolidation' not in nodes[0].getwalletinfo())
+
         self.log.info('Test rollbackrctindex')
         nodes[0].rollbackrctindex()
 
+        self.log.info('Check cached balances matched recomputed balances')
+        for i in range(self.num_nodes):
+            with open(self.options.tmpdir + '/node{}/regtest/debug.log'.format(i), 'r', encoding='utf8') as fp:
+                assert('Cached balances differ' not in fp.read())
+
 
 if __name__ == '__main__':
     AnonTest().main()
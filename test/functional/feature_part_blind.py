@@ -5,6 +5,7 @@
 
 from test_framework.test_particl import ParticlTestFramework, isclose
 from test_framework.authproxy import JSONRPCException
+from test_framework.util import assert_equal
 
 
 class BlindTest(ParticlTestFramework):
@@ -12,6 +13,7 @@ class BlindTest(ParticlTestFramework):
         self.setup_clean_chain = True
         self.num_nodes = 4
         self.extra_args = [['-debug', '-noacceptnonstdtxn', '-reservebalance=10000000'] for i in range(self.num_nodes)]
+        self.extra_args[2].append('-coinscriptstatsindex')
 
     def skip_test_if_missing_module(self):
         self.skip_if_no_wallet()
@@ -168,6 +170,22 @@ class BlindTest(ParticlTestFramework):
         assert(nodes[1].lockunspent(True, [unspent[0]]) == True)
         assert(len(nodes[1].listunspentblind(minconf=0)) == len(unspent))
 
+        self.log.info('Test listunspentblind sort and address filter')
+        unspent = nodes[2].listunspentblind(minconf=0)
+        amounts = sorted([u['amount'] for u in unspent])
+        ro = nodes[2].listunspentblind(0, 9999999, [], True, {'sort': 'amount'})
+        assert([u['amount'] for u in ro] == amounts)
+        ro = nodes[2].listunspentblind(0, 9999999, [], True, {'sort': 'amount_desc', 'maximumCount': 1})
+        assert(len(ro) == 1 and ro[0]['amount'] == amounts[-1])
+        sx = unspent[0]['stealth_address']
+        ro = nodes[2].listunspentblind(0, 9999999, [sx], True, {'maximumCount': 1})
+        assert(len(ro) == 1 and ro[0]['stealth_address'] == sx)
+        try:
+            nodes[2].listunspentblind(0, 9999999, [], True, {'sort': 'time'})
+            raise AssertionError('Should have failed.')
+        except JSONRPCException as e:
+            assert('Unknown sort' in e.error['message'])
+
         outputs = [{'address': sxAddrTo2_3, 'amount': 2.691068, 'subfee': True},]
         ro = nodes[1].sendtypeto('blind', 'part', outputs, 'comment_to', 'comment_from', 4, 64, True)
         feePerKB = (1000.0 / ro['bytes']) * float(ro['fee'])
@@ -220,6 +238,29 @@ class BlindTest(ParticlTestFramework):
         assert(ro['height'] == 4)
         assert(ro['paytopubkeyhash']['num_blinded'] > 5)
 
+        self.sync_all()
+        self.wait_until(lambda: nodes[2].getindexinfo('coinscriptstatsindex')['coinscriptstatsindex']['synced'])
+        assert_equal(nodes[2].gettxoutsetinfobyscript(), ro)
+        ro_prev = nodes[2].gettxoutsetinfobyscript(3)
+        assert(ro_prev['height'] == 3)
+
+        self.log.info('Test splitting a large payout')
+        sx_payout = nodes[3].getnewstealthaddress('payout', '0', '', False, False, 25)
+        outputs = [{'address': sx, 'amount': 0.01} for sx in sx_payout]
+        txids = nodes[0].sendtypeto('part', 'blind', outputs, '', '', 5, 1, False, {'max_outputs_per_txn': 10})
+        assert_equal(len(txids), 3)
+        assert_equal(len(set(txids)), 3)
+        for txid in txids:
+            assert(self.wait_for_mempool(nodes[3], txid))
+        received = [tx for tx in nodes[3].listtransactions('*', 100) if tx['txid'] in txids]
+        assert_equal(set(tx['txid'] for tx in received), set(txids))
+
+        try:
+            nodes[0].sendtypeto('part', 'blind', outputs, '', '', 5, 1, False, {'max_outputs_per_txn': 10, 'inputs': []})
+            raise AssertionError('Should have failed.')
+        except JSONRPCException as e:
+            assert('can\'t be used with inputs' in e.error['message'])
+
 
 if __name__ == '__main__':
     BlindTest().main()
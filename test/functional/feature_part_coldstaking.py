@@ -110,6 +110,16 @@ class ColdStakingTest(ParticlTestFramework):
         ro = nodes[0].deriverangekeys(0, 0, coldstakingaddr)
         assert(ro[0] == keyhash_to_p2pkh_part(bytes.fromhex(hashCoinstake)))
 
+        ro = nodes[0].getcoldstakinginfo(True)
+        assert_equal(len(ro['stake_addresses']), 1)
+        assert_equal(ro['stake_addresses'][0]['address'], keyhash_to_p2pkh_part(bytes.fromhex(hashCoinstake)))
+        assert_equal(ro['stake_addresses'][0]['have_key'], False)
+        assert_equal(ro['stake_addresses'][0]['num_outputs'], 1)
+        assert_equal(ro['stake_addresses'][0]['value'], Decimal('9899.999572'))
+        assert_equal(len(ro['spend_addresses']), 1)
+        assert_equal(ro['spend_addresses'][0]['value'], Decimal('9899.999572'))
+        assert('stake_addresses' not in nodes[0].getcoldstakinginfo())
+
 
         ro = nodes[0].extkey('list', 'true')
 
@@ -6,6 +6,7 @@
 import json
 
 from test_framework.test_particl import ParticlTestFramework, isclose
+from test_framework.util import assert_equal, assert_raises_rpc_error
 
 
 class ExtKeyTest(ParticlTestFramework):
@@ -176,6 +177,37 @@ class ExtKeyTest(ParticlTestFramework):
         extkeyinfo_3 = self.nodes[2].extkey('key', ext_addr3)
         assert(int(extkeyinfo_3['num_derives']) == 1)
 
+        self.log.info('Test getnewaddress with count')
+        addrs = node1.getnewaddress('bulk', False, False, False, 'legacy', 20)
+        assert_equal(len(addrs), 20)
+        assert_equal(len(set(addrs)), 20)
+        for addr in addrs:
+            ro = node1.getaddressinfo(addr)
+            assert(ro['ismine'] is True)
+            assert_equal(ro['labels'], ['bulk'])
+        addr_next = node1.getnewaddress()
+        assert(addr_next not in addrs)
+        assert_equal(len(node1.getnewaddress('', False, False, True, 'legacy', 1)), 1)
+        assert_raises_rpc_error(-8, 'count must be between', node1.getnewaddress, '', False, False, False, 'legacy', 0)
+
+        self.log.info('Test account discovery on import')
+        mnemonic = node1.mnemonic('new')['master']
+        node1.createwallet('discover_src')
+        w_src = node1.get_wallet_rpc('discover_src')
+        w_src.extkeyimportmaster(mnemonic)
+        ro = w_src.extkey('deriveaccount', 'second account')
+        w_src.extkey('setdefaultaccount', ro['account'])
+        self.nodes[2].sendtoaddress(w_src.getnewaddress(), 1.0)
+        self.stakeBlocks(1)
+
+        node1.createwallet('discover_dst')
+        w_dst = node1.get_wallet_rpc('discover_dst')
+        ro = w_dst.extkeyimportmaster(mnemonic, '', False, 'Master Key', 'Default Account', 0, {'discoveraccounts': 2})
+        assert_equal(ro['discovered_accounts'], 1)
+        assert_equal(w_dst.getbalances()['mine']['trusted'], 1.0)
+        ro = w_dst.extkey('deriveaccount', 'third account')
+        assert_equal(ro['account'], w_src.extkey('deriveaccount', 'third account')['account'])
+
 
 if __name__ == '__main__':
     ExtKeyTest().main()
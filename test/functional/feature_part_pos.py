@@ -232,6 +232,22 @@ class PosTest(ParticlTestFramework):
         header_after = nodes[0].getblockheader(nodes[0].getbestblockhash())
         assert(abs(header_before['moneysupply'] - (header_after['moneysupply'] + decimal.Decimal(100.0) - stakereward)) < 0.00000002 )
 
+        self.log.info('Test blockfilecompression')
+        self.restart_node(0, self.extra_args[0] + ['-wallet=default_wallet', '-blockfilecompression'])
+        self.connect_nodes_bi(0, 1)
+        self.connect_nodes_bi(0, 2)
+        self.connect_nodes_bi(0, 3)
+        txid = nodes[0].sendtoaddress(nodes[1].getnewaddress(), 1)
+        self.stakeBlocks(2)
+        best_hash = nodes[0].getbestblockhash()
+        block = nodes[0].getblock(best_hash, 2)
+        assert(nodes[0].getrawtransaction(txid, True)['txid'] == txid)
+        assert(nodes[0].getrawtransaction(block['tx'][0]['txid']) == block['tx'][0]['hex'])
+        assert(nodes[1].getblock(best_hash, 0) == nodes[0].getblock(best_hash, 0))
+        self.restart_node(0, self.extra_args[0] + ['-wallet=default_wallet', '-reindex'])
+        self.wait_until(lambda: nodes[0].getbestblockhash() == best_hash)
+        assert(nodes[0].getrawtransaction(txid, True)['txid'] == txid)
+
 
 if __name__ == '__main__':
     PosTest().main()
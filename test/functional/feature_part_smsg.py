@@ -3,6 +3,7 @@
 # Distributed under the MIT software license, see the accompanying
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+import json
 import time
 
 from test_framework.test_particl import ParticlTestFramework
@@ -157,6 +158,20 @@ class SmsgTest(ParticlTestFramework):
         ro = nodes[1].smsgsend(address1, address0, 'Test 1->0 no network, no outbox', False, 1, False, sendoptions)
         assert(len(nodes[1].smsgoutbox()['messages']) == 4)  # No change
 
+        self.log.info('Test smsgsend with compression_dict')
+        msg = json.dumps({'jsonrpc': '2.0', 'method': 'smsgsend', 'params': {'address': address0, 'amount': 1, 'type': 'MPA_BID'}, 'id': 1})
+        sendoptions = {'submitmsg': False, 'savemsg': False, 'compression_dict': 1}
+        ro = nodes[1].smsgsend(address1, address0, msg, False, 1, False, sendoptions)
+        msg_id = ro['msgid']
+        assert(nodes[0].smsgimport(ro['msg'])['msgid'] == msg_id)
+        ro = nodes[0].smsg(msg_id)
+        assert(ro['text'] == msg)
+        try:
+            nodes[1].smsgsend(address1, address0, msg, False, 1, False, {'compression_dict': 200})
+            assert(False), 'smsgsend with unknown dictionary.'
+        except JSONRPCException as e:
+            assert('Unknown compression_dict' in e.error['message'])
+
         self.log.info('Test nosmsg')
         assert('SMSG' not in self.dumpj(nodes[2].getnetworkinfo()['localservicesnames']))
 
@@ -164,7 +179,39 @@ class SmsgTest(ParticlTestFramework):
         nodes[0].smsgdebug('clearbanned')
 
         self.log.info('Test smsgpeers')
-        assert(len(nodes[0].smsgpeers()) == 2)
+        peers = nodes[0].smsgpeers()
+        assert(len(peers) == 2)
+        peer1 = [p for p in peers if p['msgs_received'] > 0 and p['smsgs_received'] > 0][0]
+        assert(peer1['bytes_received'] > 0)
+        assert(peer1['dropped_over_quota'] == 0)
+        assert(peer1['receive_queued'] == 0)
+        ro = nodes[0].smsggetinfo()
+        assert(ro['receive']['processed'] > 0)
+        assert(ro['receive']['dropped'] == 0)
+        totals = nodes[0].smsgbuckets('total')['total']
+        assert(ro['store']['messages'] == totals['messages'] > 0)
+        assert(ro['store']['paid_messages'] == totals['paid_messages'] == 0)
+        assert(ro['store']['free_messages'] == ro['store']['messages'])
+        assert(ro['store']['active_bytes'] == totals['active_bytes'] > 0)
+        assert(ro['store']['next_expiry'] > time.time())
+
+        self.log.info('Test getmemoryinfo particl')
+        ro = nodes[0].getmemoryinfo('particl')
+        assert(ro['coins']['cache'] > 0)
+        assert(ro['smsg']['tokens'] > 0)
+        assert(ro['wallets'][0]['records'] >= 0)
+        assert(ro['wallets'][0]['keys'] > 0)
+        assert('smsg' not in nodes[2].getmemoryinfo('particl'))
+
+        self.log.info('Test smsgpubkeyindex')
+        self.restart_node(1, extra_args=self.extra_args[1] + ['-smsgpubkeyindex', '-wallet=default_wallet'])
+        self.wait_until(lambda: nodes[1].getindexinfo('smsgpubkeyindex')['smsgpubkeyindex']['synced'])
+        assert(nodes[1].getindexinfo('smsgpubkeyindex')['smsgpubkeyindex']['best_block_height'] == nodes[1].getblockcount())
+        ro = nodes[1].smsgscanchain()
+        assert('Completed' in ro['result'])
+        ro = nodes[1].smsggetpubkey(address0)
+        assert(ro['address'] == address0)
+        assert(ro == nodes[1].smsggetpubkey(address0))
 
 
 if __name__ == '__main__':
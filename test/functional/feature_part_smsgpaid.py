@@ -22,6 +22,7 @@ class SmsgPaidTest(ParticlTestFramework):
         self.num_nodes = 3
         self.extra_args = [ ['-debug','-noacceptnonstdtxn','-reservebalance=10000000'] for i in range(self.num_nodes) ]
         self.extra_args[2].append('-disablewallet')
+        self.extra_args[0] += ['-smsgfundbatchsize=3', '-smsgfundbatchwindow=2']
 
     def skip_test_if_missing_module(self):
         self.skip_if_no_wallet()
@@ -303,6 +304,24 @@ class SmsgPaidTest(ParticlTestFramework):
             num_active += int(b['active messages'])
         assert(num_messages == num_active + 1)
 
+        self.log.info('Test smsgbuckets compact')
+        ro = nodes[0].smsgbuckets('compact')
+        assert(ro['compacted_files'] >= 1)
+        assert(ro['reclaimed_bytes'] > 0)
+        reclaimed_bytes = ro['reclaimed_bytes']
+        ro = nodes[0].smsgbuckets('compact')
+        assert(ro['compacted_files'] == 0)
+        ro = nodes[0].smsgbuckets()
+        assert(ro['total']['reclaimed_bytes'] == reclaimed_bytes)
+        assert(int(ro['total']['numpurged']) == 1)
+        # The purged token is kept
+        num_messages = 0
+        num_active = 0
+        for b in ro['buckets']:
+            num_messages += int(b['no. messages'])
+            num_active += int(b['active messages'])
+        assert(num_messages == num_active + 1)
+
 
         self.log.info('Test listunspent include_immature')
         without_immature = nodes[1].listunspent()
@@ -449,6 +468,28 @@ class SmsgPaidTest(ParticlTestFramework):
             txn = w_rpc.gettransaction(txid)
             assert('smsgs_funded' in txn)
 
+        self.log.info('Test batched funding')
+        msgids = []
+        for i in range(3):
+            sent_msg = nodes[0].smsgsend(address0, address1, f'Test batched msg {i}', True, 4, False, {'batchfund': True})
+            assert(sent_msg['result'] == 'Queued.')
+            msgids.append(sent_msg['msgid'])
+        self.wait_until(lambda: len(nodes[0].smsgfundqueue()['funded']) == 3)
+        ro = nodes[0].smsgfundqueue()
+        assert(ro['batch_size'] == 3)
+        assert(len(ro['queued']) == 0)
+        assert(set(e['msgid'] for e in ro['funded']) == set(msgids))
+        assert(len(set(e['txid'] for e in ro['funded'])) == 1)
+        assert(len(nodes[0].smsgoutbox('all', '', {'stashed': True})['messages']) == 0)
+
+        sent_msg = nodes[0].smsgsend(address0, address1, 'Test batch window', True, 4, False, {'batchfund': True})
+        self.wait_until(lambda: len(nodes[0].smsgfundqueue()['funded']) == 4)
+        ro = nodes[0].smsgfundqueue()['funded'][-1]
+        assert(ro['msgid'] == sent_msg['msgid'])
+        assert(ro['batch_size'] == 1)
+
+        assert_raises_rpc_error(-8, 'batchfund requires', nodes[0].smsgsend, address0, address1, 'Free msg', False, 4, False, {'batchfund': True})
+
 
 if __name__ == '__main__':
     SmsgPaidTest().main()
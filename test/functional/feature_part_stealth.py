@@ -243,6 +243,25 @@ class StealthTest(ParticlTestFramework):
         for sx in wi_ls[0]['Stealth Addresses']:
             assert(sx['Address'] in w1_ls_flat)
 
+        self.log.info('Test getnewstealthaddress count')
+        sx_bulk = nodes[2].getnewstealthaddress('bulk', '0', '', False, False, 20)
+        sx_bulk_v2 = nodes[2].getnewstealthaddress('bulk v2', '0', '', True, True, 3)
+        sx_after = nodes[2].getnewstealthaddress()
+        all_sx = sx_bulk + sx_bulk_v2 + [sx_after]
+        assert(len(sx_bulk) == 20 and len(sx_bulk_v2) == 3)
+        assert(len(set(all_sx)) == len(all_sx))
+        for sx in sx_bulk + sx_bulk_v2:
+            ro = nodes[2].getaddressinfo(sx)
+            assert(ro['ismine'] == True)
+            assert(ro['isstealthaddress'] == True)
+        assert(nodes[2].getaddressinfo(sx_bulk[19])['scan_path'] != nodes[2].getaddressinfo(sx_after)['scan_path'])
+        assert_raises_rpc_error(-8, 'count must be between', nodes[2].getnewstealthaddress, '', '0', '', False, False, 0)
+
+        txnHash = nodes[0].sendtoaddress(sx_bulk[19], 1)
+        assert(self.wait_for_mempool(nodes[2], txnHash))
+        ro = nodes[2].listtransactions('*', 10)
+        assert(any(tx['txid'] == txnHash and tx['stealth_address'] == sx_bulk[19] for tx in ro))
+
         self.log.info('Test getblockhashafter')
         rv = nodes[0].getblockhashafter('2000-01 01:59')
         assert(rv == '6cd174536c0ada5bfa3b8fde16b98ae508fff6586f2ee24cf866867098f25907')
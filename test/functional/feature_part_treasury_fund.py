@@ -12,6 +12,7 @@ class TreasuryFundTest(ParticlTestFramework):
         self.setup_clean_chain = True
         self.num_nodes = 3
         self.extra_args = [['-debug', '-noacceptnonstdtxn', '-reservebalance=10000000', '-stakethreadconddelayms=500', '-txindex=1', '-maxtxfee=1'] for i in range(self.num_nodes)]
+        self.extra_args[1].append('-blockrewardindex')
 
     def skip_test_if_missing_module(self):
         self.skip_if_no_wallet()
@@ -82,6 +83,19 @@ class TreasuryFundTest(ParticlTestFramework):
         assert(block_reward_6['stakereward'] * COIN == expect_reward)
         assert(block_reward_6['blockreward'] * COIN == expect_reward + tx_fee - (((expect_reward + tx_fee) * 10) // 100))
 
+        self.log.info('Test the block reward index')
+        self.sync_all()
+        assert(nodes[1].getinsightinfo()['blockrewardindex'] is True)
+        block_rewards = nodes[1].getblockrewards(1, 20)
+        assert(len(block_rewards) == 12)
+        for r in block_rewards:
+            expect = nodes[0].getblockreward(r['height'])
+            assert('fees' not in expect)
+            assert('fees' in r)
+            del r['fees']
+            assert(r == expect)
+        assert(nodes[1].getblockreward(6)['fees'] * COIN == tx_fee)
+
         # Treasury fund cut from high fees block is greater than the stake reward
         block5_header = nodes[0].getblockheader(nodes[0].getblockhash(5))
         block6_header = nodes[0].getblockheader(nodes[0].getblockhash(6))
@@ -202,6 +202,12 @@ class ZMQTest(ParticlTestFramework):
         ro = nodes[0].smsgzmqpush({"timefrom": int(time.time()) + 1})
         assert(ro['numsent'] == 0)
 
+        # Cursor moves once the replay is published
+        self.wait_until(lambda: nodes[0].smsggetinfo()['notifications']['sent'] >= 2)
+        ro = nodes[0].smsgzmqpush({"resume": True})
+        assert(ro['numsent'] == 0)
+        assert(ro['cursor_hash'] != '00' * 20)
+
 
 if __name__ == '__main__':
     ZMQTest().main()
@@ -138,6 +138,7 @@ class DoSTest(ParticlTestFramework):
 
         peer_info = nodes[0].getpeerinfo()
         assert(peer_info[1]['loose_headers'] >= 200)
+        assert(nodes[0].getnetworkinfo()['loose_headers'] <= 8000 + 50 * len(peer_info))
         assert(peer_info[1]['banscore'] > 100)
 
         # Verify node under DOS isn't forwarding bad headers
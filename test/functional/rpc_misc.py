@@ -90,11 +90,12 @@ class RpcMiscTest(BitcoinTestFramework):
             {
                 "txindex": values,
                 "basic block filter index": values,
+                "particl block filter index": values,
                 "coinstatsindex": values,
             }
         )
         # Specifying an index by name returns only the status of that index
-        for i in {"txindex", "basic block filter index", "coinstatsindex"}:
+        for i in {"txindex", "basic block filter index", "particl block filter index", "coinstatsindex"}:
             assert_equal(node.getindexinfo(i), {i: values})
 
         # Specifying an unknown index name returns an empty result
@@ -601,6 +601,11 @@ class AtomicSwapTest(ParticlTestFramework):
             'amount': amountA,
         }, ]
         ro = nodes[0].createrawparttransaction([], outputs)
+        # Funding the same outputs again takes their amounts and blinds from the rewind cache
+        created_amount = ro['amounts']['0']
+        for i in range(2):
+            ro_funded = nodes[0].fundrawtransactionfrom('blind', ro['hex'], {}, ro['amounts'])
+            assert(any(v.get('blind') == created_amount['blind'] and v['value'] == created_amount['value'] for v in ro_funded['output_amounts'].values()))
         ro = nodes[0].fundrawtransactionfrom('blind', ro['hex'], {}, ro['amounts'])
         output_amounts_i = ro['output_amounts']
         ro = nodes[0].signrawtransactionwithwallet(ro['hex'])
@@ -423,6 +423,18 @@ class WalletParticlTest(ParticlTestFramework):
         assert(ro['start_height'] == 0)
         assert(nodes[2].getwalletinfo()['total_balance'] == 25000)
 
+        self.log.info('Test rescanblockchain ranges')
+        tip_height = nodes[2].getblockcount()
+        ro = nodes[2].rescanblockchain(None, None, {'ranges': [[0, 0], [0, tip_height], [tip_height, -1]]})
+        assert_equal(ro['start_height'], 0)
+        assert_equal(ro['stop_height'], tip_height)
+        assert(nodes[2].getwalletinfo()['total_balance'] == 25000)
+        assert_raises_rpc_error(-8, 'ranges can\'t be used with', nodes[2].rescanblockchain, 0, None, {'ranges': [[0, -1]]})
+        assert_raises_rpc_error(-8, 'Invalid stop_height in range 1', nodes[2].rescanblockchain, None, None, {'ranges': [[0, -1], [0, tip_height + 1]]})
+        assert_raises_rpc_error(-8, 'Each range must be', nodes[2].rescanblockchain, None, None, {'ranges': [[0]]})
+        # Nothing left to resume
+        assert_equal(nodes[2].rescanblockchain()['start_height'], 0)
+
 
         # Test extkeyaltversion
         epkPart = 'pparszNetDqyrvZksLHJkwJGwJ1r9JCcEyLeHatLjerxRuD3qhdTdrdo2mE6e1ewfd25EtiwzsECooU5YwhAzRN63iFid6v5AQn9N5oE9wfBYehn'
@@ -692,7 +704,26 @@ class WalletParticlTest(ParticlTestFramework):
 
         nodes[1].walletpassphrasechange('changedPass', 'changedPass2')
 
-        assert(len(nodes[2].listaddressgroupings()) == 5)
+        groupings = nodes[2].listaddressgroupings()
+        assert(len(groupings) == 5)
+
+        self.log.info('Test filteraddresses totals')
+        grouped_balances = {g[0]: g[1] for group in groupings for g in group}
+        ro = nodes[2].filteraddresses(0, 100, '2', '', '1', False, True)
+        assert(len(ro) > 1)
+        for i, entry in enumerate(ro):
+            assert(entry['received'] >= entry['balance'])
+            if i > 0:
+                assert(entry['balance'] <= ro[i - 1]['balance'])
+            if entry['address'] in grouped_balances:
+                assert(entry['balance'] == grouped_balances[entry['address']])
+        ro_page = nodes[2].filteraddresses(1, 1, '2', '', '1', False, True)
+        assert(len(ro_page) == 1)
+        assert(ro_page[0]['balance'] == ro[1]['balance'])
+        ro = nodes[2].filteraddresses(0, 100, '4', '', '1', False, True)
+        for i in range(1, len(ro)):
+            assert(ro[i]['txns'] <= ro[i - 1]['txns'])
+        assert(nodes[2].filteraddresses(len(ro), 10, '4', '', '1') == [])
 
         self.log.info('Test lockunspent')
         unspent = nodes[2].listunspent()
@@ -760,6 +791,19 @@ class WalletParticlTest(ParticlTestFramework):
         ''')
         self.assert_tool_output(out, '-wallet=w_created', '-legacy', 'create')
 
+        self.log.info('Test particl-wallet verify, reindex and compact')
+        nodes[0].unloadwallet('new_wallet_with_privkeys')
+        for command in ('verify', 'reindex', 'compact', 'verify'):
+            p = self.particl_wallet_process('-wallet=new_wallet_with_privkeys', command)
+            stdout, stderr = p.communicate()
+            assert_equal(stderr, '')
+            assert_equal(p.poll(), 0)
+        assert('Stored transactions without a record: 0' in stdout)
+        assert('Stealth last index: ok' in stdout)
+        nodes[0].loadwallet('new_wallet_with_privkeys')
+        w_rpc = nodes[0].get_wallet_rpc('new_wallet_with_privkeys')
+        assert(json.dumps(w_rpc.extkey('list', True)) == json.dumps(ek_list_before))
+
         self.log.info('Test permanent lockunspent')
         unspent = nodes[2].listunspent()
         assert(nodes[2].lockunspent(False, [unspent[0]], True) == True)
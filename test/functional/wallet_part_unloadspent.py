@@ -58,6 +58,30 @@ class WalletParticlUnloadSpentTest(ParticlTestFramework):
         assert(ro['unloadspent']['mode'] == 1)
         assert(ro['unloadspent']['mindepth'] == 2)
 
+        self.log.info('Test archiving spent records')
+        sx_addr = nodes[0].getnewstealthaddress()
+        nodes[0].sendtypeto('part', 'blind', [{'address': sx_addr, 'amount': 10},])
+        self.stakeBlocks(1)
+        for i in range(2):
+            blind_balance = nodes[0].getbalances()['mine']['blind_trusted']
+            nodes[0].sendtypeto('blind', 'blind', [{'address': sx_addr, 'amount': blind_balance, 'subfee': True},])
+            self.stakeBlocks(1)
+        self.stakeBlocks(2)
+
+        ro = nodes[0].walletsettings('unloadspent', {'mode':1, 'mindepth':2, 'recorddepth':2})
+        assert(ro['unloadspent']['recorddepth'] == 2)
+        b0 = nodes[0].getbalances()['mine']
+        d0 = nodes[0].debugwallet()
+        assert(d0['m_num_archived_records'] == 0)
+
+        self.stop_node(0)
+        self.start_node(0, self.extra_args[0] + ['-wallet=default_wallet',])
+
+        d0_archived = nodes[0].debugwallet()
+        assert(d0_archived['m_num_archived_records'] > 0)
+        assert(d0_archived['mapRecords_size'] + d0_archived['m_num_archived_records'] == d0['mapRecords_size'])
+        assert(nodes[0].getbalances()['mine'] == b0)
+
 
 if __name__ == '__main__':
     WalletParticlUnloadSpentTest().main()